@@ -0,0 +1,20 @@
+-- =====================================================
+-- Unified engine results
+-- =====================================================
+-- Migration: 005_unified_results.sql
+-- Description: Long-format store for UnifiedEngine results, written by
+--              orchestration::ResultWriter (one row per line item per period)
+
+CREATE TABLE IF NOT EXISTS unified_result (
+    run_id INTEGER NOT NULL,
+    entity_id TEXT NOT NULL,
+    scenario_id INTEGER NOT NULL,
+    period_id INTEGER NOT NULL,
+    line_item_code TEXT NOT NULL,
+    value REAL,  -- NULL for non-finite values
+
+    FOREIGN KEY (run_id) REFERENCES run_log(run_id) ON DELETE CASCADE
+);
+
+-- No primary key: inserts stay append-only; reads go by run and period
+CREATE INDEX idx_unified_result_run ON unified_result(run_id, scenario_id, period_id);
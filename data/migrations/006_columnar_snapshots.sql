@@ -0,0 +1,37 @@
+-- =====================================================
+-- Columnar result files
+-- =====================================================
+-- Migration: 006_columnar_snapshots.sql
+-- Description: Let run_output_snapshot reference columnar result files
+--              written by orchestration::ColumnarResultWriter
+--              (output_type 'results', format 'columnar')
+
+-- SQLite can't alter CHECK constraints: rebuild the table
+CREATE TABLE run_output_snapshot_new (
+    snapshot_id INTEGER PRIMARY KEY AUTOINCREMENT,
+    run_id INTEGER NOT NULL,
+    output_type TEXT NOT NULL CHECK (output_type IN (
+        'pl_summary',           -- P&L summary across all periods
+        'bs_summary',           -- BS summary
+        'cf_summary',           -- CF summary
+        'kpi_summary',          -- Key KPIs
+        'validation_report',    -- Validation results
+        'convergence_log',      -- Iteration convergence data
+        'results'               -- All line items of the run (file_path)
+    )),
+    json_data TEXT NOT NULL,    -- Complete output data as JSON (file summary for files)
+    format TEXT NOT NULL DEFAULT 'json' CHECK (format IN ('json', 'csv', 'parquet', 'columnar')),
+    file_path TEXT,             -- If exported to file
+    file_size_bytes INTEGER,
+    created_at TEXT NOT NULL DEFAULT (datetime('now')),
+
+    FOREIGN KEY (run_id) REFERENCES run_log(run_id) ON DELETE CASCADE,
+    CHECK (json_valid(json_data))
+);
+
+INSERT INTO run_output_snapshot_new SELECT * FROM run_output_snapshot;
+DROP TABLE run_output_snapshot;
+ALTER TABLE run_output_snapshot_new RENAME TO run_output_snapshot;
+
+CREATE INDEX idx_run_output_run ON run_output_snapshot(run_id);
+CREATE INDEX idx_run_output_type ON run_output_snapshot(output_type);
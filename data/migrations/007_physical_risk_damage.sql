@@ -0,0 +1,26 @@
+-- =====================================================
+-- Physical risk damage breakdown
+-- =====================================================
+-- Migration: 007_physical_risk_damage.sql
+-- Description: Individual asset-peril-period damages behind the summed
+--              physical risk drivers in scenario_drivers, written by
+--              PhysicalRiskEngine with set_damage_breakdown(true)
+
+CREATE TABLE IF NOT EXISTS physical_risk_damage (
+    scenario_id INTEGER NOT NULL,
+    period_id INTEGER NOT NULL,
+    asset_id INTEGER NOT NULL,
+    peril_id INTEGER,               -- NULL for hazard map damages
+    distance_km REAL NOT NULL,
+    adjusted_intensity REAL NOT NULL,
+    ppe_loss REAL NOT NULL,         -- In currency, positive = loss
+    inventory_loss REAL NOT NULL,
+    bi_loss REAL NOT NULL,
+    currency TEXT NOT NULL,
+
+    FOREIGN KEY (asset_id) REFERENCES asset_exposure(asset_id),
+    FOREIGN KEY (peril_id) REFERENCES physical_peril(peril_id)
+);
+
+-- Replaced per scenario; read by scenario and period
+CREATE INDEX idx_physical_risk_damage_scenario ON physical_risk_damage(scenario_id, period_id);
@@ -0,0 +1,22 @@
+-- =====================================================
+-- Stochastic physical event catalogues
+-- =====================================================
+-- Migration: 008_physical_event.sql
+-- Description: Events with annual occurrence rates, simulated by
+--              PhysicalRiskEngine::simulate_annual_losses() into annual
+--              loss statistics (expected loss, VaR, TVaR)
+
+CREATE TABLE IF NOT EXISTS physical_event (
+    event_id INTEGER PRIMARY KEY,
+    catalogue_code TEXT NOT NULL,     -- Event set, e.g. 'EU_FLOOD_STOCHASTIC'
+    peril_type TEXT NOT NULL,         -- Selects the damage functions
+    latitude REAL NOT NULL,
+    longitude REAL NOT NULL,
+    intensity REAL NOT NULL,
+    radius_km REAL DEFAULT 0,         -- 0: point event
+    annual_rate REAL NOT NULL CHECK (annual_rate >= 0),   -- Expected occurrences per year
+    description TEXT
+);
+
+-- Loaded per catalogue
+CREATE INDEX idx_physical_event_catalogue ON physical_event(catalogue_code, event_id);
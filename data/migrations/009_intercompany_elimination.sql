@@ -0,0 +1,19 @@
+-- =====================================================
+-- Intercompany eliminations
+-- =====================================================
+-- Migration: 009_intercompany_elimination.sql
+-- Description: Intercompany positions eliminated during the entity
+--              hierarchy rollup (orchestration::EliminationMatrix), at
+--              the lowest parent holding both entities
+
+CREATE TABLE IF NOT EXISTS intercompany_elimination (
+    elimination_id INTEGER PRIMARY KEY,
+    entity_code TEXT NOT NULL,          -- Entity holding the position
+    counterparty_code TEXT NOT NULL,    -- Entity the position is with
+    line_item_code TEXT NOT NULL,       -- e.g. 'IC_RECEIVABLE', 'IC_REVENUE'
+    share REAL NOT NULL DEFAULT 1.0,    -- Part of the line item that is with the counterparty
+    also_reduce TEXT,                   -- JSON array of line items containing it, e.g. '["RECEIVABLES"]'
+    CHECK (entity_code != counterparty_code)
+);
+
+CREATE INDEX idx_intercompany_elimination_entity ON intercompany_elimination(entity_code);
@@ -0,0 +1,32 @@
+-- =====================================================
+-- Environmentally-extended input-output (EEIO) tables
+-- =====================================================
+-- Migration: 010_eeio.sql
+-- Description: Sector intensities and technical coefficients of the
+--              spend-based Scope 3 model (carbon::EEIOModel) and the spend
+--              it evaluates; templates read the results as scope3:CATEGORY
+
+CREATE TABLE IF NOT EXISTS eeio_sector (
+    sector_code TEXT PRIMARY KEY,       -- Sector of a region, e.g. 'C24_DE'
+    sector_name TEXT,
+    direct_intensity REAL NOT NULL DEFAULT 0.0   -- tCO2e per unit of output
+);
+
+CREATE TABLE IF NOT EXISTS eeio_coefficient (
+    from_sector TEXT NOT NULL REFERENCES eeio_sector(sector_code),
+    to_sector TEXT NOT NULL REFERENCES eeio_sector(sector_code),
+    coefficient REAL NOT NULL,          -- Input of from_sector per unit of output of to_sector
+    PRIMARY KEY (from_sector, to_sector)
+);
+
+CREATE TABLE IF NOT EXISTS eeio_spend (
+    spend_id INTEGER PRIMARY KEY,
+    entity_id TEXT NOT NULL,
+    scenario_id INTEGER NOT NULL,
+    period_id INTEGER NOT NULL,
+    sector_code TEXT NOT NULL REFERENCES eeio_sector(sector_code),
+    category TEXT NOT NULL DEFAULT 'UPSTREAM',   -- Scope 3 category, e.g. 'UPSTREAM', 'DOWNSTREAM'
+    amount REAL NOT NULL                -- Spend in the currency the intensities are per unit of
+);
+
+CREATE INDEX idx_eeio_spend_scenario ON eeio_spend(scenario_id, entity_id, period_id);
@@ -0,0 +1,21 @@
+-- =====================================================
+-- Hazard intensity pathways
+-- =====================================================
+-- Migration: 011_physical_peril_pathway.sql
+-- Description: Per-period intensity factors of multi-period perils (e.g.
+--              RCP/SSP climate pathways), applied by PhysicalRiskEngine to
+--              each affected period of a physical_peril row. Periods
+--              without a factor keep the peril's intensity.
+
+CREATE TABLE IF NOT EXISTS physical_peril_pathway (
+    pathway_id INTEGER PRIMARY KEY,
+    scenario_id INTEGER NOT NULL,
+    peril_id INTEGER,                   -- One peril; NULL: every peril of peril_type in the scenario
+    peril_type TEXT,                    -- e.g. 'FLOOD' (with peril_id NULL)
+    period_id INTEGER NOT NULL,
+    intensity_factor REAL NOT NULL,     -- Multiplies the peril's intensity in period_id
+    CHECK (peril_id IS NOT NULL OR peril_type IS NOT NULL),
+    FOREIGN KEY (peril_id) REFERENCES physical_peril(peril_id)
+);
+
+CREATE INDEX idx_physical_peril_pathway_scenario ON physical_peril_pathway(scenario_id);
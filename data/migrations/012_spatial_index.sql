@@ -0,0 +1,18 @@
+-- =====================================================
+-- Spatial indexes
+-- =====================================================
+-- Migration: 012_spatial_index.sql
+-- Description: Built physical_risk::SpatialIndex k-d trees (e.g. of a
+--              hazard grid or the location mapping), one row per tree
+--              slot, so runs and input snapshots load them without
+--              rebuilding. Written by SpatialIndex::store().
+
+CREATE TABLE IF NOT EXISTS spatial_index_point (
+    index_code TEXT NOT NULL,           -- e.g. 'LOCATION_MAPPING'
+    slot INTEGER NOT NULL,              -- Position in the implicit tree
+    location_index INTEGER NOT NULL,    -- Into the locations the index was built from
+    x REAL NOT NULL,                    -- Unit vector of the location
+    y REAL NOT NULL,
+    z REAL NOT NULL,
+    PRIMARY KEY (index_code, slot)
+);
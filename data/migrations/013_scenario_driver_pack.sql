@@ -0,0 +1,39 @@
+-- =====================================================
+-- Packed scenario drivers
+-- =====================================================
+-- Migration: 013_scenario_driver_pack.sql
+-- Description: Optional packed copy of scenario_drivers, one row per
+--              (entity, scenario) holding a dense periods × drivers
+--              float64 matrix, written by unified::DriverPack and read
+--              by DriverValueProvider::prefetch() instead of the rows.
+--              scenario_drivers stays the table of record: the triggers
+--              drop a key's pack whenever its rows change.
+
+CREATE TABLE IF NOT EXISTS scenario_driver_pack (
+    entity_id TEXT NOT NULL,
+    scenario_id INTEGER NOT NULL,
+    period_ids TEXT NOT NULL,           -- JSON array, ascending: the matrix rows
+    drivers TEXT NOT NULL,              -- JSON array of [driver_code, unit_code]: the matrix columns
+    driver_values BLOB NOT NULL,        -- float64, period-major, host byte order (NaN: no row)
+    PRIMARY KEY (entity_id, scenario_id),
+    CHECK (json_valid(period_ids) AND json_valid(drivers))
+);
+
+CREATE TRIGGER IF NOT EXISTS trg_scenario_drivers_pack_insert
+AFTER INSERT ON scenario_drivers
+BEGIN
+    DELETE FROM scenario_driver_pack WHERE entity_id = NEW.entity_id AND scenario_id = NEW.scenario_id;
+END;
+
+CREATE TRIGGER IF NOT EXISTS trg_scenario_drivers_pack_update
+AFTER UPDATE ON scenario_drivers
+BEGIN
+    DELETE FROM scenario_driver_pack WHERE entity_id = OLD.entity_id AND scenario_id = OLD.scenario_id;
+    DELETE FROM scenario_driver_pack WHERE entity_id = NEW.entity_id AND scenario_id = NEW.scenario_id;
+END;
+
+CREATE TRIGGER IF NOT EXISTS trg_scenario_drivers_pack_delete
+AFTER DELETE ON scenario_drivers
+BEGIN
+    DELETE FROM scenario_driver_pack WHERE entity_id = OLD.entity_id AND scenario_id = OLD.scenario_id;
+END;
@@ -0,0 +1,19 @@
+-- =====================================================
+-- Run summaries
+-- =====================================================
+-- Migration: 014_run_summary.sql
+-- Description: Summary KPIs of each (run, scenario, entity), accumulated
+--              by orchestration::ResultWriter while the run's periods are
+--              written (orchestration::RunSummarySpec), so listing runs
+--              with their KPIs reads this table instead of unified_result.
+
+CREATE TABLE IF NOT EXISTS run_summary (
+    run_id INTEGER NOT NULL,
+    scenario_id INTEGER NOT NULL,
+    entity_id TEXT NOT NULL,
+    periods INTEGER NOT NULL,           -- Periods folded into the summary
+    summary TEXT NOT NULL,              -- JSON object: measure name → value (null: no period had one)
+    PRIMARY KEY (run_id, scenario_id, entity_id),
+    FOREIGN KEY (run_id) REFERENCES run_log(run_id) ON DELETE CASCADE,
+    CHECK (json_valid(summary))
+) WITHOUT ROWID;
@@ -0,0 +1,13 @@
+-- =====================================================
+-- Compiled statement templates
+-- =====================================================
+-- Migration: 015_template_binary.sql
+-- Description: Compiled form of each template's json_structure, written by
+--              core::StatementTemplate::save_to_database(): the parsed line
+--              items, formula dependencies and calculation order in a
+--              versioned binary layout. Loading checks it was compiled
+--              from the row's current JSON and otherwise parses the JSON,
+--              which stays the editable source of truth (NULL until the
+--              template is next saved).
+
+ALTER TABLE statement_template ADD COLUMN compiled_structure BLOB;
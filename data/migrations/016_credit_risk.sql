@@ -0,0 +1,25 @@
+-- =====================================================
+-- Credit exposures
+-- =====================================================
+-- Migration: 016_credit_risk.sql
+-- Description: Loan positions of lenders, evaluated by
+--              credit::CreditRiskEngine into scenario-conditional expected
+--              credit loss; the losses are written back per entity as
+--              ECL / CREDIT_EAD rows of scenario_drivers. Scenarios move the
+--              systematic factor with CREDIT_Z[_<segment>] drivers of the
+--              'CREDIT' entity.
+
+CREATE TABLE IF NOT EXISTS credit_exposure (
+    position_id INTEGER PRIMARY KEY,
+    entity_id TEXT NOT NULL,            -- Lender whose ECL driver the position feeds
+    segment TEXT NOT NULL DEFAULT 'DEFAULT',   -- Systematic factor, e.g. 'RETAIL_MORTGAGE'
+    ead REAL NOT NULL CHECK (ead >= 0),        -- Exposure at default
+    lgd REAL NOT NULL CHECK (lgd BETWEEN 0 AND 1),
+    pd REAL NOT NULL CHECK (pd BETWEEN 0 AND 1),   -- Through-the-cycle annual PD
+    asset_correlation REAL DEFAULT 0.12 CHECK (asset_correlation >= 0 AND asset_correlation < 1),
+    maturity_periods INTEGER,           -- Periods until repaid (NULL: beyond the horizon)
+    amortising INTEGER NOT NULL DEFAULT 0   -- 1: EAD falls linearly to 0 at maturity
+);
+
+-- Loaded grouped by entity
+CREATE INDEX idx_credit_exposure_entity ON credit_exposure(entity_id, position_id);
@@ -0,0 +1,11 @@
+-- =====================================================
+-- Capex vintages
+-- =====================================================
+-- Migration: 017_policy_kernels.sql
+-- Description: Straight-line life of each period's capex, depreciated by
+--              policy::VintageSchedule and read by templates as
+--              policy:DEPRECIATION (see PolicyProvider). The default of 40
+--              periods is 10 years of quarters.
+
+ALTER TABLE capex_policy ADD COLUMN useful_life_periods INTEGER NOT NULL DEFAULT 40
+    CHECK (useful_life_periods >= 1);
@@ -0,0 +1,98 @@
+/**
+ * @file bench_common.h
+ * @brief Synthetic databases and hardware counters shared by the benchmarks (see orchestration::WorkloadGenerator)
+ */
+
+#pragma once
+
+#include "core/hardware_counters.h"
+#include "database/database_factory.h"
+#include "database/idatabase.h"
+#include "orchestration/workload_generator.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+
+namespace finmodel {
+namespace bench {
+
+/**
+ * @brief In-memory database with the tables a run touches (and a USD/EUR rate)
+ */
+inline std::shared_ptr<database::IDatabase> create_bench_db() {
+    auto db = database::DatabaseFactory::create_sqlite(":memory:");
+    orchestration::WorkloadGenerator::create_schema(*db);
+    db->execute_raw("INSERT INTO fx_rate VALUES (1, 1, 'USD', 'EUR', 'average', 0.9);");
+    return db;
+}
+
+/**
+ * @brief In-memory database holding the workload of a spec
+ */
+inline std::shared_ptr<database::IDatabase> create_workload_db(const orchestration::WorkloadSpec& spec,
+                                                               orchestration::Workload& workload) {
+    auto db = create_bench_db();
+    workload = orchestration::WorkloadGenerator(spec).generate(*db);
+    return db;
+}
+
+/**
+ * @brief Spec of a single-entity, single-scenario workload (what a run benchmark times)
+ */
+inline orchestration::WorkloadSpec run_spec(size_t line_items, size_t depth, size_t periods) {
+    orchestration::WorkloadSpec spec;
+    spec.template_code = "BENCH_" + std::to_string(line_items) + "_" + std::to_string(depth);
+    spec.line_items = line_items;
+    spec.drivers = line_items / 10;
+    spec.depth = depth;
+    spec.periods = periods;
+    spec.scenarios = 1;
+    spec.entities = 1;
+    spec.assets = 0;
+    spec.perils = 0;
+    return spec;
+}
+
+/**
+ * @brief Hardware counters of a benchmark's timed loop, reported per item
+ *
+ * Construct right before the loop and call report() after it: adds ipc
+ * and cycles, L1D, LLC and branch misses per item to the benchmark's
+ * counters (only the events the machine counts; nothing where
+ * perf_event_open is refused).
+ */
+class LoopCounters {
+public:
+    LoopCounters() : before_(core::HardwareCounters::thread_counts()) {}
+
+    void report(benchmark::State& state, int64_t items) const {
+        if (!core::HardwareCounters::available() || items <= 0) {
+            return;
+        }
+        const auto used = core::HardwareCounters::thread_counts() - before_;
+        const auto per_item = [&](uint64_t count) { return static_cast<double>(count) / static_cast<double>(items); };
+        using Event = core::HardwareCounters::Event;
+        if (core::HardwareCounters::has(Event::CYCLES) && core::HardwareCounters::has(Event::INSTRUCTIONS)) {
+            state.counters["ipc"] = used.ipc();
+        }
+        if (core::HardwareCounters::has(Event::CYCLES)) {
+            state.counters["cycles_per_item"] = per_item(used.cycles());
+        }
+        if (core::HardwareCounters::has(Event::L1D_MISSES)) {
+            state.counters["l1d_misses_per_item"] = per_item(used.l1d_misses());
+        }
+        if (core::HardwareCounters::has(Event::LLC_MISSES)) {
+            state.counters["llc_misses_per_item"] = per_item(used.llc_misses());
+        }
+        if (core::HardwareCounters::has(Event::BRANCH_MISSES)) {
+            state.counters["branch_misses_per_item"] = per_item(used.branch_misses());
+        }
+    }
+
+private:
+    core::ScopedHardwareCounting counting_;   // Before before_: the group is read enabled
+    core::HardwareCounts before_;
+};
+
+} // namespace bench
+} // namespace finmodel
@@ -0,0 +1,59 @@
+/**
+ * @file bench_credit_risk.cpp
+ * @brief Expected credit loss of a loan portfolio under a factor path
+ */
+
+#include "credit/credit_risk_engine.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace finmodel;
+
+namespace {
+
+constexpr size_t PERIODS = 12;
+
+// Positions of 1000 lenders in 8 segments, a third of them amortising
+std::shared_ptr<const credit::CreditPortfolio> random_portfolio(size_t count) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> ead(1e4, 1e6);
+    std::uniform_real_distribution<double> lgd(0.1, 0.7);
+    std::uniform_real_distribution<double> pd(0.001, 0.08);
+    std::uniform_int_distribution<int> maturity(1, 40);
+    std::vector<credit::CreditPosition> positions(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& p = positions[i];
+        p.entity_id = "LENDER_" + std::to_string(i % 1000);
+        p.segment = "SEGMENT_" + std::to_string(i % 8);
+        p.ead = ead(rng);
+        p.lgd = lgd(rng);
+        p.pd = pd(rng);
+        p.maturity_periods = maturity(rng);
+        p.amortising = i % 3 == 0;
+    }
+    return std::make_shared<const credit::CreditPortfolio>(std::move(positions), 4);
+}
+
+// Args: positions, threads
+void BM_CreditRiskEngine_Calculate(benchmark::State& state) {
+    credit::CreditRiskEngine engine(random_portfolio(static_cast<size_t>(state.range(0))));
+    engine.set_parallel(static_cast<size_t>(state.range(1)));
+    credit::CreditFactorPath path;
+    for (size_t k = 0; k < PERIODS; ++k) {
+        path.period_ids.push_back(static_cast<PeriodID>(k + 1));
+        path.z[""].push_back(-0.2 * static_cast<double>(k));
+    }
+    for (auto _ : state) {
+        auto losses = engine.calculate(path);
+        benchmark::DoNotOptimize(losses.ecl.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(PERIODS));
+}
+BENCHMARK(BM_CreditRiskEngine_Calculate)
+    ->ArgsProduct({{10000, 100000, 1000000}, {1}})
+    ->Args({1000000, 4})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,63 @@
+/**
+ * @file bench_dependency_graph.cpp
+ * @brief DependencyGraph: building and ordering graphs of 100 to 10k line items
+ */
+
+#include "core/dependency_graph.h"
+#include <benchmark/benchmark.h>
+#include <string>
+
+using namespace finmodel;
+
+namespace {
+
+/// Each node depends on its predecessor and one pseudo-random earlier node
+core::DependencyGraph layered_graph(size_t nodes) {
+    core::DependencyGraph graph;
+    for (size_t i = 0; i < nodes; ++i) {
+        graph.add_node("L" + std::to_string(i));
+    }
+    for (size_t i = 1; i < nodes; ++i) {
+        graph.add_edge(static_cast<uint32_t>(i), static_cast<uint32_t>(i - 1));
+        graph.add_edge(static_cast<uint32_t>(i), static_cast<uint32_t>(((i * 2654435761ull) >> 7) % i));
+    }
+    return graph;
+}
+
+void BM_DependencyGraph_Build(benchmark::State& state) {
+    const size_t nodes = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(layered_graph(nodes).size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DependencyGraph_Build)->RangeMultiplier(10)->Range(100, 10000);
+
+void BM_DependencyGraph_TopologicalSort(benchmark::State& state) {
+    const auto graph = layered_graph(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(graph.topological_sort());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DependencyGraph_TopologicalSort)->RangeMultiplier(10)->Range(100, 10000);
+
+void BM_DependencyGraph_TopologicalOrder(benchmark::State& state) {
+    const auto graph = layered_graph(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(graph.topological_order());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DependencyGraph_TopologicalOrder)->RangeMultiplier(10)->Range(100, 10000);
+
+void BM_DependencyGraph_TopologicalLevels(benchmark::State& state) {
+    const auto graph = layered_graph(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(graph.topological_levels());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DependencyGraph_TopologicalLevels)->RangeMultiplier(10)->Range(100, 10000);
+
+} // namespace
@@ -0,0 +1,97 @@
+/**
+ * @file bench_formula.cpp
+ * @brief FormulaEvaluator: parse, compile, evaluate, dependency extraction
+ */
+
+#include "bench_common.h"
+#include "bs/providers/statement_value_provider.h"
+#include "core/formula_binding.h"
+#include "core/formula_evaluator.h"
+#include <benchmark/benchmark.h>
+
+using namespace finmodel;
+
+namespace {
+
+const char* const FORMULAS[] = {
+    "REVENUE - COGS",
+    "(REVENUE - COGS - OPEX) * (1 - TAX_RATE)",
+    "MAX(0, REVENUE * 0.1 + CASH[t-1] - MIN(COGS, OPEX) / 2) + IF(REVENUE > COGS, 1, 0)",
+};
+
+std::string formula_label(int64_t index) {
+    static const char* const LABELS[] = {"simple", "arithmetic", "functions"};
+    return LABELS[index];
+}
+
+// Statement values the formulas read ([t] and [t-1])
+struct FormulaFixture {
+    std::shared_ptr<database::IDatabase> db = bench::create_bench_db();
+    bs::StatementValueProvider statement{db};
+    std::vector<core::IValueProvider*> providers{&statement};
+    core::Context ctx{1, 2, 0};
+
+    FormulaFixture() {
+        statement.set_prior_period_values({{"CASH", 50.0}});
+        statement.set_current_values({{"REVENUE", 1000.0}, {"COGS", 400.0}, {"OPEX", 200.0},
+                                      {"TAX_RATE", 0.25}, {"CASH", 80.0}});
+    }
+};
+
+void BM_FormulaEvaluator_EvaluateText(benchmark::State& state) {
+    FormulaFixture fixture;
+    core::FormulaEvaluator evaluator;
+    const std::string formula = FORMULAS[state.range(0)];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(evaluator.evaluate(formula, fixture.providers, fixture.ctx));
+    }
+    state.SetLabel(formula_label(state.range(0)));
+}
+BENCHMARK(BM_FormulaEvaluator_EvaluateText)->DenseRange(0, 2);
+
+void BM_FormulaEvaluator_EvaluateCompiled(benchmark::State& state) {
+    FormulaFixture fixture;
+    core::FormulaEvaluator evaluator;
+    auto compiled = evaluator.compile(FORMULAS[state.range(0)]);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(evaluator.evaluate(*compiled, fixture.providers, fixture.ctx));
+    }
+    state.SetLabel(formula_label(state.range(0)));
+}
+BENCHMARK(BM_FormulaEvaluator_EvaluateCompiled)->DenseRange(0, 2);
+
+void BM_FormulaEvaluator_EvaluateBound(benchmark::State& state) {
+    FormulaFixture fixture;
+    core::FormulaEvaluator evaluator;
+    core::FormulaBinding bound(evaluator.compile(FORMULAS[state.range(0)]), fixture.providers);
+    const bench::LoopCounters counters;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(evaluator.evaluate(bound, fixture.ctx));
+    }
+    counters.report(state, state.iterations());
+    state.SetLabel(formula_label(state.range(0)));
+}
+BENCHMARK(BM_FormulaEvaluator_EvaluateBound)->DenseRange(0, 2);
+
+void BM_FormulaEvaluator_Compile(benchmark::State& state) {
+    core::FormulaEvaluator evaluator;
+    const std::string formula = FORMULAS[state.range(0)];
+    for (auto _ : state) {
+        evaluator.clear_cache();
+        benchmark::DoNotOptimize(evaluator.compile(formula));
+    }
+    state.SetLabel(formula_label(state.range(0)));
+}
+BENCHMARK(BM_FormulaEvaluator_Compile)->DenseRange(0, 2);
+
+void BM_FormulaEvaluator_ExtractDependencies(benchmark::State& state) {
+    core::FormulaEvaluator evaluator;
+    const std::string formula = FORMULAS[state.range(0)];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(evaluator.extract_dependencies(formula));
+    }
+    state.SetLabel(formula_label(state.range(0)));
+}
+BENCHMARK(BM_FormulaEvaluator_ExtractDependencies)->DenseRange(0, 2);
+
+} // namespace
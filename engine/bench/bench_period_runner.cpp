@@ -0,0 +1,184 @@
+/**
+ * @file bench_period_runner.cpp
+ * @brief End-to-end runs of synthetic workloads: 100 to 10k line items, shallow to deep DAGs
+ */
+
+#include "bench_common.h"
+#include "core/allocation_tracker.h"
+#include "core/numa_topology.h"
+#include "database/input_snapshot.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/task_scheduler.h"
+#include "orchestration/whatif_sessions.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+
+using namespace finmodel;
+
+namespace {
+
+constexpr size_t PERIODS = 12;
+
+// Args: line items, topological levels
+void BM_PeriodRunner_RunPeriods(benchmark::State& state) {
+    const size_t line_items = static_cast<size_t>(state.range(0));
+    orchestration::Workload workload;
+    auto db = bench::create_workload_db(bench::run_spec(line_items, static_cast<size_t>(state.range(1)), PERIODS),
+                                        workload);
+    const EntityID& entity = workload.leaf_entities.front();
+    const ScenarioID scenario = workload.scenario_ids.front();
+
+    orchestration::PeriodRunner runner(db);
+    auto warmup = runner.run_periods(entity, scenario, workload.period_ids, workload.opening,
+                                     workload.template_code);
+    if (!warmup.success) {
+        state.SkipWithError(("run failed: " + warmup.errors.front()).c_str());
+        return;
+    }
+
+    core::ScopedAllocationTracking tracking;
+    const auto allocated_before = core::AllocationTracker::thread_counts();
+    const bench::LoopCounters counters;
+    for (auto _ : state) {
+        auto results = runner.run_periods(entity, scenario, workload.period_ids, workload.opening,
+                                          workload.template_code);
+        benchmark::DoNotOptimize(results.success);
+    }
+    const auto allocated = core::AllocationTracker::thread_counts() - allocated_before;
+    const auto evaluations = state.iterations() * state.range(0) * static_cast<int64_t>(PERIODS);
+    state.SetItemsProcessed(evaluations);
+    counters.report(state, evaluations);
+    // Heap churn of the loop; the goal is 0 (meaningless with FINMODEL_TRACK_ALLOCATIONS=0)
+    state.counters["allocs_per_item"] = static_cast<double>(allocated.allocations) / static_cast<double>(evaluations);
+    state.counters["line_items"] = static_cast<double>(line_items);
+    state.counters["levels"] = static_cast<double>(workload.levels);
+}
+BENCHMARK(BM_PeriodRunner_RunPeriods)
+    ->ArgsProduct({{100, 1000, 10000}, {20}})
+    ->Args({1000, 5})
+    ->Args({1000, 100})
+    ->Unit(benchmark::kMillisecond);
+
+// Args: line items; one driver edit of the first period per iteration (target: under 100 ms)
+void BM_WhatIfSessions_Edit(benchmark::State& state) {
+    orchestration::Workload workload;
+    auto db = bench::create_workload_db(bench::run_spec(static_cast<size_t>(state.range(0)), 20, PERIODS), workload);
+
+    orchestration::JobSpec spec;
+    spec.entities = {workload.leaf_entities.front()};
+    spec.scenario_ids = {workload.scenario_ids.front()};
+    spec.period_ids = workload.period_ids;
+    spec.template_code = workload.template_code;
+    spec.opening_balances = workload.opening.line_items;
+    orchestration::WhatIfSessions sessions([db] { return db; });
+    const auto opened = sessions.open(spec);
+    if (!opened.results.success) {
+        state.SkipWithError(("run failed: " + opened.results.errors.front()).c_str());
+        return;
+    }
+
+    const std::string driver = orchestration::WorkloadGenerator::code("DRV", 0);
+    size_t recalculated = 0;
+    double value = 1.0;
+    for (auto _ : state) {
+        value += 1.0;
+        auto edited = sessions.edit(opened.session_id, {{workload.period_ids.front(), driver, value, ""}});
+        recalculated += edited.recalculated;
+        benchmark::DoNotOptimize(edited.results.success);
+    }
+    state.counters["recalculated_share"] = static_cast<double>(recalculated) /
+        (static_cast<double>(state.iterations()) * static_cast<double>(opened.recalculated));
+    state.counters["line_items"] = static_cast<double>(state.range(0));
+}
+BENCHMARK(BM_WhatIfSessions_Edit)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+// Args: sockets (NUMA nodes) used, with a pinned worker per CPU and a snapshot replica per
+// node; compare runs_per_socket across rows for the scaling per socket
+void BM_PeriodRunner_SocketScaling(benchmark::State& state) {
+    namespace fs = std::filesystem;
+    const auto& system = core::NumaTopology::system();
+    const auto sockets = static_cast<size_t>(state.range(0));
+    if (sockets > system.node_count()) {
+        state.SkipWithError(("machine has " + std::to_string(system.node_count()) + " NUMA node(s)").c_str());
+        return;
+    }
+    const core::NumaTopology topology({system.nodes().begin(), system.nodes().begin() + sockets});
+    size_t threads = 0;
+    for (const auto& node : topology.nodes()) {
+        threads += node.cpus.size();
+    }
+
+    // Workers need their own connections: the workload goes through a snapshot file
+    const fs::path dir = fs::temp_directory_path() / "finmodel_bench_scaling";
+    fs::create_directories(dir);
+    const std::string source = (dir / "inputs.db").string();
+    std::remove(source.c_str());
+    auto spec = bench::run_spec(1000, 20, PERIODS);
+    spec.scenarios = 4;
+    orchestration::Workload workload;
+    {
+        auto db = database::DatabaseFactory::create_sqlite(source);
+        orchestration::WorkloadGenerator::create_schema(*db);
+        db->execute_raw("INSERT INTO fx_rate VALUES (1, 1, 'USD', 'EUR', 'average', 0.9);");
+        workload = orchestration::WorkloadGenerator(spec).generate(*db);
+    }
+    std::vector<std::string> replicas;
+    for (size_t node = 0; node < sockets; ++node) {
+        replicas.push_back((dir / ("snapshot.node" + std::to_string(node))).string());
+        if (node == 0) {
+            database::InputSnapshot::compile(source, replicas[0]);
+        } else {
+            fs::copy_file(replicas[0], replicas[node], fs::copy_options::overwrite_existing);
+        }
+    }
+
+    orchestration::TaskScheduler scheduler(threads, topology, true);
+    std::vector<std::unique_ptr<orchestration::PeriodRunner>> runners(threads);
+    const size_t jobs = threads * 4;
+    std::atomic<size_t> failed{0};
+    auto run_all = [&] {
+        for (size_t job = 0; job < jobs; ++job) {
+            scheduler.submit([&, job](size_t worker) {
+                // Built on the worker's thread: engine, arena and results on its node
+                if (!runners[worker]) {
+                    runners[worker] = std::make_unique<orchestration::PeriodRunner>(
+                        database::InputSnapshot::open(replicas[scheduler.node_of(worker)]));
+                }
+                auto results = runners[worker]->run_periods(
+                    workload.leaf_entities.front(), workload.scenario_ids[job % workload.scenario_ids.size()],
+                    workload.period_ids, workload.opening, workload.template_code);
+                failed += results.success ? 0 : 1;
+            });
+        }
+        scheduler.wait();
+    };
+    run_all();  // Warm every worker's runner
+    if (failed > 0) {
+        state.SkipWithError("run failed");
+        return;
+    }
+
+    const auto stolen_before = scheduler.stats();
+    for (auto _ : state) {
+        run_all();
+    }
+    const auto stats = scheduler.stats();
+    const auto runs = static_cast<double>(state.iterations() * jobs);
+    state.SetItemsProcessed(static_cast<int64_t>(runs) * static_cast<int64_t>(spec.line_items * PERIODS));
+    state.counters["sockets"] = static_cast<double>(sockets);
+    state.counters["threads"] = static_cast<double>(threads);
+    state.counters["runs_per_socket"] = benchmark::Counter(runs / static_cast<double>(sockets),
+                                                           benchmark::Counter::kIsRate);
+    state.counters["remote_steal_share"] = stats.stolen > stolen_before.stolen
+        ? static_cast<double>(stats.stolen_remote - stolen_before.stolen_remote) /
+          static_cast<double>(stats.stolen - stolen_before.stolen)
+        : 0.0;
+
+    runners.clear();
+    fs::remove_all(dir);
+}
+BENCHMARK(BM_PeriodRunner_SocketScaling)->DenseRange(1, 4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
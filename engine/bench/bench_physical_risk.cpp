@@ -0,0 +1,142 @@
+/**
+ * @file bench_physical_risk.cpp
+ * @brief Physical risk kernels: haversine distances, damage curves and hazard map builds
+ */
+
+#include "bench_common.h"
+#include "physical_risk/damage_function.h"
+#include "physical_risk/geo_utils.h"
+#include "physical_risk/hazard_map_builder.h"
+#include <filesystem>
+#include <benchmark/benchmark.h>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace physical_risk;
+
+namespace {
+
+std::vector<std::pair<double, double>> random_locations(size_t count) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> lat(35.0, 60.0);
+    std::uniform_real_distribution<double> lon(-10.0, 30.0);
+    std::vector<std::pair<double, double>> locations(count);
+    for (auto& location : locations) {
+        location = {lat(rng), lon(rng)};
+    }
+    return locations;
+}
+
+std::vector<double> random_intensities(size_t count) {
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> intensity(0.0, 6.0);
+    std::vector<double> intensities(count);
+    for (auto& value : intensities) {
+        value = intensity(rng);
+    }
+    return intensities;
+}
+
+// Depth-damage curve of typical resolution (0.25 m steps up to 6 m)
+PiecewiseLinearDamageFunction flood_curve() {
+    std::vector<std::pair<double, double>> points;
+    for (int i = 0; i <= 24; ++i) {
+        const double depth = 0.25 * i;
+        points.emplace_back(depth, depth / (depth + 1.5));
+    }
+    return PiecewiseLinearDamageFunction(std::move(points), "benchmark flood curve");
+}
+
+void BM_GeoUtils_Haversine(benchmark::State& state) {
+    const auto locations = random_locations(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        double total = 0.0;
+        for (const auto& [lat, lon] : locations) {
+            total += GeoUtils::haversine_distance(47.37, 8.54, lat, lon);
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GeoUtils_Haversine)->RangeMultiplier(10)->Range(100, 100000);
+
+void BM_GeoUtils_HaversineBatch(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    const GeoCoordinates points(random_locations(count));
+    std::vector<size_t> indices(count);
+    std::iota(indices.begin(), indices.end(), size_t{0});
+    std::vector<double> distances(count);
+    const finmodel::bench::LoopCounters counters;
+    for (auto _ : state) {
+        GeoUtils::haversine_distance_batch(points, indices.data(), count, 47.37, 8.54, distances.data());
+        benchmark::DoNotOptimize(distances.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    counters.report(state, state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GeoUtils_HaversineBatch)->RangeMultiplier(10)->Range(100, 100000);
+
+void BM_DamageFunction_Calculate(benchmark::State& state) {
+    const auto curve = flood_curve();
+    const auto intensities = random_intensities(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        double total = 0.0;
+        for (double intensity : intensities) {
+            total += curve.calculate(intensity);
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DamageFunction_Calculate)->RangeMultiplier(10)->Range(100, 100000);
+
+void BM_DamageFunction_CalculateBatch(benchmark::State& state) {
+    const auto curve = flood_curve();
+    const auto intensities = random_intensities(static_cast<size_t>(state.range(0)));
+    std::vector<double> damage(intensities.size());
+    const finmodel::bench::LoopCounters counters;
+    for (auto _ : state) {
+        curve.calculate_batch(intensities, damage);
+        benchmark::DoNotOptimize(damage.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    counters.report(state, state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DamageFunction_CalculateBatch)->RangeMultiplier(10)->Range(100, 100000);
+
+// 1024 x 1024 cells of 0.02° over central Europe, 500 perils of 5-50 km;
+// range(0) threads
+void BM_HazardMapBuilder_Build(benchmark::State& state) {
+    HazardGridSpec spec;
+    spec.rows = 1024;
+    spec.cols = 1024;
+    spec.lat_origin = 44.0;
+    spec.lon_origin = 2.0;
+    spec.lat_step = 0.02;
+    spec.lon_step = 0.02;
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> lat(44.0, 64.0);
+    std::uniform_real_distribution<double> lon(2.0, 22.0);
+    std::uniform_real_distribution<double> radius(5.0, 50.0);
+    std::vector<PerilFootprint> footprints(500);
+    for (size_t i = 0; i < footprints.size(); ++i) {
+        footprints[i].peril_id = static_cast<int>(i);
+        footprints[i].latitude = lat(rng);
+        footprints[i].longitude = lon(rng);
+        footprints[i].intensity = 2.0;
+        footprints[i].radius_km = radius(rng);
+    }
+    HazardMapBuilder builder(spec, {1});
+    builder.set_parallel(static_cast<size_t>(state.range(0)));
+    const std::string path = (std::filesystem::temp_directory_path() / "finmodel_bench_hazard.fmhg").string();
+    size_t evaluations = 0;
+    for (auto _ : state) {
+        evaluations += builder.build(footprints, path).cell_evaluations;
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(static_cast<int64_t>(evaluations));
+}
+BENCHMARK(BM_HazardMapBuilder_Build)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
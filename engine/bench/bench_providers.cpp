@@ -0,0 +1,109 @@
+/**
+ * @file bench_providers.cpp
+ * @brief Value provider lookups: drivers, statement values, FX rates
+ */
+
+#include "bench_common.h"
+#include "bs/providers/statement_value_provider.h"
+#include "core/providers/fx_value_provider.h"
+#include "unified/providers/driver_value_provider.h"
+#include <benchmark/benchmark.h>
+
+using namespace finmodel;
+
+namespace {
+
+struct DriverFixture {
+    orchestration::Workload workload;
+    std::shared_ptr<database::IDatabase> db = bench::create_workload_db(bench::run_spec(1000, 20, 3), workload);
+    unified::DriverValueProvider drivers{db};
+    core::Context ctx{1, 1, 0};
+
+    DriverFixture() {
+        drivers.prefetch(entity(), 1, workload.period_ids);
+        drivers.set_context(entity(), 1, 1);
+        drivers.preload();
+    }
+
+    const EntityID& entity() const { return workload.leaf_entities.front(); }
+};
+
+void BM_DriverValueProvider_GetValue(benchmark::State& state) {
+    DriverFixture fixture;
+    const std::string key = "driver:" + orchestration::WorkloadGenerator::code("DRV", 42);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.drivers.get_value(key, fixture.ctx));
+    }
+}
+BENCHMARK(BM_DriverValueProvider_GetValue);
+
+void BM_DriverValueProvider_GetSlotValue(benchmark::State& state) {
+    DriverFixture fixture;
+    const int slot = fixture.drivers.resolve_slot("driver:" + orchestration::WorkloadGenerator::code("DRV", 42));
+    const bench::LoopCounters counters;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.drivers.get_slot_value(slot, fixture.ctx));
+    }
+    counters.report(state, state.iterations());
+}
+BENCHMARK(BM_DriverValueProvider_GetSlotValue);
+
+void BM_DriverValueProvider_SetContext(benchmark::State& state) {
+    DriverFixture fixture;
+    PeriodID period = 1;
+    for (auto _ : state) {
+        fixture.drivers.set_context(fixture.entity(), 1, period);
+        period = period % 3 + 1;
+    }
+}
+BENCHMARK(BM_DriverValueProvider_SetContext);
+
+struct StatementFixture {
+    std::shared_ptr<database::IDatabase> db = bench::create_bench_db();
+    bs::StatementValueProvider statement{db};
+    core::Context ctx{1, 2, 0};
+
+    StatementFixture() {
+        std::map<std::string, double> values;
+        for (size_t i = 0; i < 1000; ++i) {
+            values[orchestration::WorkloadGenerator::code("LI", i)] = static_cast<double>(i);
+        }
+        statement.set_prior_period_values(values);
+        statement.set_current_values(values);
+    }
+};
+
+void BM_StatementValueProvider_GetValue(benchmark::State& state) {
+    StatementFixture fixture;
+    const std::string key = orchestration::WorkloadGenerator::code("LI", 500) + (state.range(0) == 0 ? "" : "[t-1]");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.statement.get_value(key, fixture.ctx));
+    }
+    state.SetLabel(state.range(0) == 0 ? "current" : "prior period");
+}
+BENCHMARK(BM_StatementValueProvider_GetValue)->DenseRange(0, 1);
+
+void BM_StatementValueProvider_GetSlotValue(benchmark::State& state) {
+    StatementFixture fixture;
+    const int slot = fixture.statement.resolve_slot(orchestration::WorkloadGenerator::code("LI", 500));
+    const bench::LoopCounters counters;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.statement.get_slot_value(slot, fixture.ctx));
+    }
+    counters.report(state, state.iterations());
+}
+BENCHMARK(BM_StatementValueProvider_GetSlotValue);
+
+void BM_FXValueProvider_GetValue(benchmark::State& state) {
+    auto db = bench::create_bench_db();
+    core::FXValueProvider fx(db);
+    fx.set_context(1, 1);
+    core::Context ctx(1, 1, 0);
+    const std::string key = "FX_USD_EUR";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fx.get_value(key, ctx));   // Cached after the first query
+    }
+}
+BENCHMARK(BM_FXValueProvider_GetValue);
+
+} // namespace
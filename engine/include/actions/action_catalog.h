@@ -0,0 +1,106 @@
+/**
+ * @file action_catalog.h
+ * @brief Management actions of many scenarios, loaded and parsed once
+ *
+ * ActionEngine::load_actions() queries scenario_action and
+ * management_action and parses every transformation JSON on each call.
+ * An ActionCatalog does that once - one query for all the scenarios it
+ * covers - and keeps the actions ready to patch: transformation types
+ * parsed (Transformation::kind), formula_override formulas compiled, and
+ * each action's parameter signature. Lookups by (scenario, action code)
+ * are constant time. A catalogue is immutable after load(), so runs and
+ * parallel workers can share one (PeriodRunner::set_action_catalog()).
+ *
+ * Usage:
+ * @code
+ * auto catalog = ActionCatalog::load(*db, {1, 2, 3});
+ * for (const auto& entry : catalog->actions(2)) { ... }
+ * for (size_t i : catalog->find(2, "LED")) { catalog->actions(2)[i].action; }
+ * @endcode
+ */
+
+#pragma once
+
+#include "actions/action_engine.h"
+#include "database/idatabase.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace finmodel {
+namespace actions {
+
+/**
+ * @brief Parsed actions of a set of scenarios
+ */
+class ActionCatalog {
+public:
+    /**
+     * @brief Loaded action with a signature of the parameters its patches depend on
+     */
+    struct Entry {
+        ManagementAction action;
+        std::string signature;   ///< Period window and transformations, equal for equal patches
+    };
+
+    /**
+     * @brief Load the actions of some scenarios with one query
+     * @param db Database connection
+     * @param scenario_ids Scenarios to load (empty: every scenario)
+     *
+     * A formula_override that doesn't compile keeps a null
+     * compiled_formula; its formula then fails where it is calculated.
+     */
+    static std::shared_ptr<const ActionCatalog> load(database::IDatabase& db,
+                                                     const std::vector<int>& scenario_ids = {});
+
+    /**
+     * @brief Catalogue of already loaded actions (ordered by scenario, as from query_actions())
+     * @param scenario_ids Scenarios they cover (empty: every scenario)
+     */
+    ActionCatalog(std::vector<ManagementAction> actions, const std::vector<int>& scenario_ids);
+
+    /**
+     * @brief Whether the catalogue holds the actions of a scenario (possibly none)
+     */
+    bool covers(int scenario_id) const;
+
+    /**
+     * @brief Actions of a scenario, ordered by start period and action code
+     * @return Empty for a scenario without actions or not covered
+     */
+    const std::vector<Entry>& actions(int scenario_id) const;
+
+    /**
+     * @brief Indexes in actions(scenario_id) of the rows of an action
+     * @return Empty if the scenario has no such action
+     */
+    const std::vector<size_t>& find(int scenario_id, const std::string& action_code) const;
+
+    /**
+     * @brief Actions of all scenarios
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Signature of an action: everything ActionEngine::formula_patches() reads from it
+     */
+    static std::string signature(const ManagementAction& action);
+
+private:
+    struct Scenario {
+        std::vector<Entry> actions;
+        std::unordered_map<std::string, std::vector<size_t>> by_code;
+    };
+
+    std::unordered_map<int, Scenario> scenarios_;
+    std::unordered_set<int> covered_;
+    bool covers_all_ = false;
+    size_t size_ = 0;
+};
+
+} // namespace actions
+} // namespace finmodel
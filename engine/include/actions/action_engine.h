@@ -14,13 +14,27 @@
 
 #include "database/idatabase.h"
 #include "core/statement_template.h"
+#include "core/compiled_formula.h"
+#include <map>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <string>
 
 namespace finmodel {
 namespace actions {
 
+/**
+ * @brief Transformation type, parsed from Transformation::transformation_type
+ */
+enum class TransformationKind {
+    UNKNOWN,
+    MULTIPLY,
+    ADD,
+    REDUCE,
+    FORMULA_OVERRIDE
+};
+
 /**
  * @brief Single transformation to apply to a line item
  */
@@ -34,6 +48,10 @@ struct Transformation {
     std::string new_formula;        // For "formula_override"
 
     std::string comment;            // Optional explanation
+
+    // Set by parse_transformations(); UNKNOWN: read transformation_type
+    TransformationKind kind = TransformationKind::UNKNOWN;
+    std::shared_ptr<const core::CompiledFormula> compiled_formula;  // "formula_override" (ActionCatalog)
 };
 
 /**
@@ -104,6 +122,20 @@ public:
      */
     std::vector<ManagementAction> load_actions(int scenario_id);
 
+    /**
+     * @brief Load the actions of several scenarios with one query
+     * @param db Database connection
+     * @param scenario_ids Scenarios to load (empty: every scenario)
+     * @return Actions ordered by scenario, start period and action code
+     */
+    static std::vector<ManagementAction> query_actions(database::IDatabase& db,
+                                                       const std::vector<int>& scenario_ids);
+
+    /**
+     * @brief Type of a transformation (its kind, or transformation_type when not parsed)
+     */
+    static TransformationKind kind_of(const Transformation& transformation);
+
     /**
      * @brief Clone a template with a new code
      * @param base_template_code Source template code
@@ -132,6 +164,73 @@ public:
         int period_id
     );
 
+    /**
+     * @brief Formulas the active actions give a template's line items
+     * @param base Template the actions apply to (not modified)
+     * @param actions List of actions to consider
+     * @param period_id Period to check for action activity
+     * @return Line item code → transformed formula, only for transformed line items
+     *
+     * The sparse equivalent of apply_actions_to_template() on a clone:
+     * transformations of one line item compose in the same order. Pass the
+     * result to StatementTemplate::with_formulas() to get the overlay
+     * template without persisting anything.
+     */
+    std::map<std::string, std::string> formula_patches(
+        const core::StatementTemplate& base,
+        const std::vector<ManagementAction>& actions,
+        int period_id
+    ) const;
+
+    /**
+     * @brief Formulas of a template with every action's transformations, gated per period
+     * @param base Template the actions apply to (not modified)
+     * @param actions Every action of the scenario, whatever its period window
+     * @return Line item code → transformed formula, only for transformed line items
+     *
+     * Each transformation of an action is gated by the variable
+     * action:ACTION_CODE (see gated_formula()), so one overlay template
+     * and one compiled plan serve all periods; the runner sets each
+     * period's activations (unified::ActionActivationProvider) from the
+     * action windows and trigger state. With every action active the
+     * formulas equal formula_patches() of them.
+     */
+    std::map<std::string, std::string> parametric_patches(
+        const core::StatementTemplate& base,
+        const std::vector<ManagementAction>& actions
+    ) const;
+
+    /**
+     * @brief Formula of a line item after one transformation, applied as far as an action is active
+     * @param line_item_code Line item being transformed
+     * @param formula Its current formula (empty or none: the line item is a driver)
+     * @param transformation Transformation to apply
+     * @param action_code Action whose activation a (0 inactive, 1 active) gates it
+     * @return New formula, or std::nullopt for an unknown transformation type
+     *
+     * multiply, add and reduce scale with a: F * (1 + a (factor - 1)),
+     * F + a amount, F - a amount; formula_override replaces F while a is not 0.
+     */
+    static std::optional<std::string> gated_formula(
+        const std::string& line_item_code,
+        const std::optional<std::string>& formula,
+        const Transformation& transformation,
+        const std::string& action_code
+    );
+
+    /**
+     * @brief Formula of a line item after one transformation
+     * @param line_item_code Line item being transformed
+     * @param formula Its current formula (empty or none: the line item is a driver)
+     * @param transformation Transformation to apply
+     * @return New formula, or std::nullopt for an unknown transformation type
+     */
+    static std::optional<std::string> transform_formula(
+        const std::string& line_item_code,
+        const std::optional<std::string>& formula,
+        const Transformation& transformation
+    );
+
     /**
      * @brief Apply a single transformation to a line item
      * @param template_ptr Template to modify
@@ -150,7 +249,7 @@ public:
      * @param json_str JSON string from scenario_action table
      * @return Vector of parsed transformations
      */
-    std::vector<Transformation> parse_transformations(const std::string& json_str);
+    static std::vector<Transformation> parse_transformations(const std::string& json_str);
 
     /**
      * @brief Evaluate if an action should trigger in a given period
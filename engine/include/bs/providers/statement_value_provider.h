@@ -11,11 +11,17 @@
 
 #include "core/ivalue_provider.h"
 #include "core/context.h"
+#include "core/entity_dictionary.h"
+#include "core/time_series.h"
 #include "database/idatabase.h"
 #include "types/common_types.h"
 #include <memory>
+#include <optional>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
 
 namespace finmodel {
 namespace bs {
@@ -26,7 +32,10 @@ namespace bs {
  * Handles P&L, Balance Sheet, and Cash Flow values. Resolves references:
  * - Current period: "CASH" → current_values_["CASH"]
  * - Time-series: "CASH[t-1]" → opening_values_["CASH"]
- * - Database lookup: "CASH" (if not in current/opening) → fetch from DB
+ * - History: "CASH[t-k]" → values recorded by record_period() for period t-k
+ * - Database lookup: "CASH[t-k]" (period not recorded) → fetch from DB
+ * - Trailing windows: "SUM_WINDOW(REVENUE,4)" (see core::WindowRef) → running
+ *   sum of REVENUE over t-1 .. t-4, published by begin_period()
  *
  * This is the unified value provider for the UnifiedEngine, handling
  * all financial statement values in a single provider.
@@ -43,14 +52,24 @@ namespace bs {
  * // Resolve time-series reference
  * double opening_cash = provider.get_value("CASH[t-1]", ctx);
  * @endcode
+ *
+ * Storage: every code seen is assigned a stable slot, and current/opening
+ * values live in flat arrays indexed by slot. Bound formulas (FormulaBinding)
+ * read those arrays directly. The last history_depth() recorded periods
+ * are kept in a ring of slot arrays, so [t-k] references inside that window
+ * resolve from memory. Each trailing window keeps a core::RollingWindow of
+ * its line item, advanced by record_period(): a period costs the same
+ * however long the window is, and the window's value sits in its own slot.
  */
 class StatementValueProvider : public core::IValueProvider {
 public:
     /**
      * @brief Construct statement value provider
      * @param db Database interface for historical lookups
+     * @param entities Entity IDs shared with the engine (null: the provider loads its own)
      */
-    explicit StatementValueProvider(std::shared_ptr<database::IDatabase> db);
+    explicit StatementValueProvider(std::shared_ptr<database::IDatabase> db,
+                                    std::shared_ptr<core::EntityDictionary> entities = nullptr);
 
     /**
      * @brief Check if provider can resolve a key
@@ -68,12 +87,69 @@ public:
      */
     double get_value(const std::string& key, const core::Context& ctx) const override;
 
+    /**
+     * @brief get_value() without an exception when the value isn't there
+     *
+     * Misses of [t-k] keys beyond the recorded history still query
+     * balance_sheet_actuals.
+     */
+    std::optional<double> find_value(const std::string& key, const core::Context& ctx) const override;
+
+    /**
+     * @brief Resolve code to slot (registers the code if new)
+     * @param key Variable name (time-series keys like "CASH[t-1]" get no slot)
+     * @return Slot index, or NO_SLOT for time-series keys
+     */
+    int resolve_slot(const std::string& key) override;
+
+    /**
+     * @brief Check if current or opening value is available in slot
+     */
+    bool has_slot_value(int slot) const override;
+
+    /**
+     * @brief Get value from slot (same period selection as get_value())
+     * @throws std::runtime_error if no value is available
+     */
+    double get_slot_value(int slot, const core::Context& ctx) const override;
+
+    /**
+     * @brief get_slot_value() without an exception when no value is available
+     */
+    std::optional<double> find_slot_value(int slot, const core::Context& ctx) const override;
+
+    /**
+     * @brief Current and opening arrays in get_slot_value() order ([t] and [t-1] only)
+     */
+    size_t direct_arrays(int time_index, core::SlotArrays* out) const override;
+
     /**
      * @brief Set current period values (being calculated)
      * @param values Map of line item code → value
+     *
+     * Replaces all current values.
      */
     void set_current_values(const std::map<std::string, double>& values);
 
+    /**
+     * @brief Set a single current period value
+     * @param code Line item code
+     * @param value Calculated value
+     */
+    void set_current_value(const std::string& code, double value);
+
+    /**
+     * @brief Set a single current period value by slot
+     * @param slot Slot index from resolve_slot()
+     * @param value Calculated value
+     */
+    void set_current_slot_value(int slot, double value);
+
+    /**
+     * @brief Clear all current period values
+     */
+    void clear_current_values();
+
     /**
      * @brief Set opening balance sheet values (previous period)
      * @param opening_values Map of line item code → value
@@ -94,18 +170,147 @@ public:
      * @param entity_id Entity identifier
      * @param scenario_id Scenario identifier
      */
-    void set_context(const EntityID& entity_id, ScenarioID scenario_id);
+    void set_context(const EntityID& entity_id, ScenarioID scenario_id) {
+        set_context(entities_->intern(entity_id), scenario_id);
+    }
+
+    /**
+     * @brief Set context for database lookups
+     * @param entity Entity ID from the provider's EntityDictionary
+     * @param scenario_id Scenario identifier
+     */
+    void set_context(int entity, ScenarioID scenario_id);
+
+    /**
+     * @brief Publish the trailing windows' values for a period about to be calculated
+     * @param period_id Period being calculated
+     *
+     * A window that ends at the last recorded period is read as it is;
+     * any other (the first period of a run, after a gap) is refilled from
+     * the opening values for t-1, the recorded periods and
+     * balance_sheet_actuals (one query per window). Periods without a value
+     * are left out: AVG_WINDOW averages the ones there are, and both are 0
+     * with none. clear_current_values() keeps the published values.
+     */
+    void begin_period(PeriodID period_id);
+
+    /**
+     * @brief Values behind a trailing window variable (e.g. "AVG_WINDOW(REVENUE,4)")
+     * @return Null if the key isn't a window resolved before
+     */
+    const core::RollingWindow* window(const std::string& key) const;
+
+    /**
+     * @brief Keep the current values as the history of a period
+     * @param period_id Period the current values were calculated for
+     *
+     * Later [t-k] references to this period (same entity and scenario)
+     * read the recorded values instead of querying the database.
+     */
+    void record_period(PeriodID period_id);
+
+    /**
+     * @brief Record a period's values from elsewhere (e.g. a run checkpoint)
+     * @param period_id Period the values belong to
+     * @param values Line item code → value
+     *
+     * Same effect as calculating the period under the current context and
+     * calling record_period().
+     */
+    void restore_period(PeriodID period_id, const std::map<std::string, double>& values);
+
+    /**
+     * @brief Forget all recorded periods
+     */
+    void clear_history();
+
+    /**
+     * @brief Set how many recorded periods are kept
+     * @param periods Ring size (0 disables history; clears recorded periods)
+     */
+    void set_history_depth(size_t periods);
+
+    /**
+     * @brief Number of recorded periods kept
+     */
+    size_t history_depth() const { return history_.size(); }
+
+    /**
+     * @brief Number of [t-k] values read from the database so far
+     */
+    size_t database_reads() const { return database_reads_; }
 
 private:
+    /**
+     * @brief Values of one recorded period, indexed by slot
+     */
+    struct PeriodValues {
+        bool recorded = false;
+        PeriodID period_id = 0;
+        std::vector<double> values;
+        std::vector<uint8_t> present;
+    };
+
     std::shared_ptr<database::IDatabase> db_;
-    EntityID entity_id_;
+    std::shared_ptr<core::EntityDictionary> entities_;
+    int entity_ = core::EntityDictionary::NO_ENTITY;
     ScenarioID scenario_id_;
 
-    // Current period values (being calculated)
-    std::map<std::string, double> current_values_;
+    // Slot registry: code → slot index (slots are never removed)
+    std::unordered_map<std::string, int> slot_index_;
+    std::vector<std::string> slot_codes_;
 
-    // Opening balance sheet values (previous period)
-    std::map<std::string, double> opening_values_;
+    // Current period values (being calculated), indexed by slot
+    std::vector<double> current_values_;
+    std::vector<uint8_t> has_current_;
+
+    // Opening balance sheet values (previous period), indexed by slot
+    std::vector<double> opening_values_;
+    std::vector<uint8_t> has_opening_;
+
+    // Recorded periods: history_[period_id % depth] (ring, default 12 periods)
+    std::vector<PeriodValues> history_;
+
+    /**
+     * @brief Trailing window over a line item, created when its key is resolved
+     */
+    struct Window {
+        int slot;                   ///< Slot the window's value is published in
+        int source;                 ///< Slot of the line item
+        bool average;
+        core::RollingWindow values;
+        bool published = false;
+    };
+    std::vector<Window> windows_;
+
+    mutable size_t database_reads_ = 0;
+
+    /**
+     * @brief Recorded value of slot in a period
+     * @return Pointer to the value, or nullptr if not recorded
+     */
+    const double* history_value(int slot, PeriodID period_id) const;
+
+    /**
+     * @brief Refill a window with the periods before period_id
+     */
+    void seed_window(Window& window, PeriodID period_id);
+
+    /**
+     * @brief Get or create slot for code
+     */
+    int slot_for(const std::string& code);
+
+    /**
+     * @brief Find slot for code without creating it
+     * @return Slot index, or NO_SLOT if code never seen
+     */
+    int find_slot(const std::string& code) const;
+
+    /**
+     * @brief Replace opening values with map contents
+     */
+    void assign_opening(const std::map<std::string, double>& values);
 
     /**
      * @brief Parse time-series reference
@@ -120,10 +325,9 @@ private:
      * @brief Fetch value from database for historical period
      * @param code Line item code
      * @param period_id Period identifier
-     * @return Value from database
-     * @throws std::runtime_error if not found
+     * @return Value from database, or nothing if there is none (or no actuals table)
      */
-    double fetch_from_database(const std::string& code, PeriodID period_id) const;
+    std::optional<double> find_in_database(const std::string& code, PeriodID period_id) const;
 };
 
 } // namespace bs
@@ -0,0 +1,156 @@
+/**
+ * @file eeio_model.h
+ * @brief Environmentally-extended input-output (EEIO) model for Scope 3 emissions
+ *
+ * Spend-based Scope 3: a unit of spend in a sector (a sector of a region,
+ * e.g. 'C24_DE', basic metals in Germany) emits its direct intensity and,
+ * through the sectors it buys from, their intensities, and so on up the
+ * supply chain. With A the technical coefficients (A[i][j]: input from
+ * sector i per unit of output of sector j) and f the direct intensities,
+ * the total intensities are
+ *
+ *     m = f (I - A)^-1,   i.e.  (I - A)^T m = f
+ *
+ * EEIOModel factorises the sparse I - A once (Eigen::SparseLU) and keeps
+ * m: a few hundred sectors × regions are solved when the model is built,
+ * not per entity. Scope 3 of a spend vector s is then m · s, and
+ * evaluate() stacks the spend of every (entity, scenario, period,
+ * category) as the columns of one sparse matrix S, so all of them are
+ * one sparse product S^T m.
+ *
+ * Example Usage:
+ * @code
+ * auto model = EEIOModel::load(*db);
+ * auto scope3 = std::make_shared<const Scope3Results>(model.evaluate(*db));
+ * engine.set_scope3_results(scope3);   // templates read scope3:UPSTREAM, scope3:DOWNSTREAM, ...
+ * @endcode
+ */
+
+#pragma once
+
+#include "database/idatabase.h"
+#include "types/common_types.h"
+#include "core/eigen.h"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace carbon {
+
+/**
+ * @brief Input from one sector per unit of output of another
+ */
+struct EEIOCoefficient {
+    std::string from_sector;
+    std::string to_sector;
+    double coefficient = 0.0;
+};
+
+/**
+ * @brief Spend of an entity in a sector
+ */
+struct EEIOSpend {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    PeriodID period_id = 0;
+    std::string sector;
+    std::string category = "UPSTREAM";   ///< Scope 3 category the emissions are reported under
+    double amount = 0.0;                 ///< In the currency the intensities are per unit of
+};
+
+/**
+ * @brief Scope 3 emissions by entity, scenario, period and category
+ */
+struct Scope3Results {
+    struct Row {
+        EntityID entity_id;
+        ScenarioID scenario_id = 0;
+        PeriodID period_id = 0;
+        std::vector<double> emissions;   ///< tCO2e by category (as categories)
+    };
+
+    std::vector<std::string> categories;   ///< Sorted
+    std::vector<Row> rows;                 ///< Sorted by entity, scenario, period
+
+    /**
+     * @brief Row of an entity in a scenario period (null: no spend)
+     */
+    const Row* find(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id) const;
+
+    /**
+     * @brief Emissions of a category (0 without spend in it)
+     */
+    double get(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id,
+               const std::string& category) const;
+};
+
+/**
+ * @brief Sector intensities of an input-output table, solved once
+ */
+class EEIOModel {
+public:
+    /**
+     * @brief Model of the eeio_sector and eeio_coefficient tables
+     */
+    static EEIOModel load(database::IDatabase& db);
+
+    /**
+     * @brief Spend rows of eeio_spend (all scenarios, or those given)
+     */
+    static std::vector<EEIOSpend> query_spend(database::IDatabase& db,
+                                              const std::vector<ScenarioID>& scenario_ids = {});
+
+    /**
+     * @param sectors Sector codes
+     * @param direct_intensity tCO2e per unit of output of each sector
+     * @param coefficients Technical coefficients (duplicates add up)
+     * @throws std::invalid_argument on a coefficient of an unknown sector or
+     *         intensities that don't match the sectors
+     * @throws std::runtime_error if I - A is singular
+     */
+    EEIOModel(std::vector<std::string> sectors, const std::vector<double>& direct_intensity,
+              const std::vector<EEIOCoefficient>& coefficients);
+
+    size_t size() const { return sectors_.size(); }
+    const std::vector<std::string>& sectors() const { return sectors_; }
+
+    /**
+     * @brief Index of a sector (-1: unknown)
+     */
+    int sector(const std::string& code) const;
+
+    /**
+     * @brief Total (direct and supply chain) tCO2e per unit of spend, by sector
+     */
+    const Eigen::VectorXd& total_intensity() const { return total_; }
+
+    /**
+     * @brief Emissions of spend vectors
+     * @param spend Sectors × columns, one spend vector per column
+     * @return tCO2e by column
+     */
+    Eigen::VectorXd emissions(const Eigen::SparseMatrix<double>& spend) const;
+
+    /**
+     * @brief Scope 3 of spend rows, in one product
+     * @throws std::invalid_argument on spend in an unknown sector
+     */
+    Scope3Results evaluate(const std::vector<EEIOSpend>& spend) const;
+
+    /**
+     * @brief Scope 3 of the eeio_spend table (all scenarios, or those given)
+     */
+    Scope3Results evaluate(database::IDatabase& db, const std::vector<ScenarioID>& scenario_ids = {}) const {
+        return evaluate(query_spend(db, scenario_ids));
+    }
+
+private:
+    std::vector<std::string> sectors_;
+    std::unordered_map<std::string, int> index_;
+    Eigen::VectorXd total_;
+};
+
+} // namespace carbon
+} // namespace finmodel
@@ -20,15 +20,27 @@
  *               << point.marginal_cost_per_tco2e << " CHF/tCO2e, "
  *               << point.annual_reduction_tco2e << " tCO2e/year\n";
  * }
+ *
+ * // Dashboards: every (scenario, period) curve from one query, stored in one transaction
+ * auto curves = engine.calculate_mac_curves(scenario_ids, period_ids);
+ * engine.store_mac_curves(curves);
+ *
+ * // Cheapest actions cutting 2000 tCO2e/year in periods 3-5 for CHF 1M of CAPEX
+ * auto portfolio = engine.optimize_portfolio(scenario_id, {1000000.0, 2000.0, {3, 4, 5}});
  * @endcode
  */
 
 #pragma once
 
 #include "database/idatabase.h"
+#include <cstddef>
+#include <functional>
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 namespace finmodel {
 namespace carbon {
@@ -82,6 +94,39 @@ struct MACCurve {
     int high_cost_count;      // cost >= 100 CHF/tCO2e
 };
 
+/**
+ * @brief Budget and target of an abatement portfolio
+ */
+struct PortfolioOptions {
+    double capex_budget = 0.0;              // Capital expenditure the actions may take together (CHF)
+    double target_reduction_tco2e = 0.0;    // Annual reduction to reach in every target period (tCO2e/year)
+    std::vector<int> period_ids;            // Target periods (empty: annual reductions, windows ignored)
+    size_t max_nodes = 1000000;             // Branch-and-bound nodes before settling for the best found
+};
+
+/**
+ * @brief Actions selected for a budget and target
+ */
+struct AbatementPortfolio {
+    int scenario_id = 0;
+    bool feasible = false;                  // Some set of actions meets the target within the budget
+    bool optimal = false;                   // Proven cheapest (the node limit wasn't reached)
+    std::vector<MACPoint> points;           // Selected actions, by marginal cost (cumulative reductions set)
+
+    double total_capex = 0.0;               // CHF
+    double total_annual_cost = 0.0;         // CAPEX amortized + OPEX (CHF/year), minimised
+    double target_reduction_tco2e = 0.0;
+    std::vector<int> period_ids;            // As requested
+    std::vector<double> reductions;         // By target period (one value without periods), tCO2e/year
+    size_t nodes = 0;                       // Branch-and-bound nodes explored
+
+    // Set by verify_portfolio()
+    bool verified = false;                  // Full-engine reductions meet the target
+    std::vector<double> verified_reductions;
+
+    std::vector<std::string> action_codes() const;
+};
+
 /**
  * @brief Engine for calculating MAC curves
  */
@@ -110,6 +155,63 @@ public:
      */
     MACCurve calculate_mac_curve(int scenario_id, int period_id);
 
+    /**
+     * @brief Calculate the MAC curves of several scenarios and periods
+     * @param scenario_ids Scenario identifiers
+     * @param period_ids Period identifiers
+     * @return One curve per (scenario, period), scenario-major, in argument order
+     *
+     * Loads the actions of all scenarios in one query and ranks each
+     * scenario's actions once: an action's cost and reduction don't depend
+     * on the period, so each period's curve is the ranked actions active in
+     * it. Curves match calculate_mac_curve() for each pair.
+     */
+    std::vector<MACCurve> calculate_mac_curves(const std::vector<int>& scenario_ids,
+                                               const std::vector<int>& period_ids);
+
+    /**
+     * @brief Cheapest set of a scenario's actions that meets a target within a capex budget
+     * @param scenario_id Scenario whose actions are candidates
+     * @param options Budget, target and target periods
+     * @return Portfolio (see optimize_portfolio(points, options))
+     */
+    AbatementPortfolio optimize_portfolio(int scenario_id, const PortfolioOptions& options);
+
+    /**
+     * @brief Cheapest set of MAC points that meets a target within a capex budget
+     * @param points Candidate actions (windows from start_period / end_period)
+     * @param options Budget, target and target periods
+     * @return Selected actions minimising their total annual cost; not
+     *         feasible (no actions) if no set meets the target in every
+     *         target period within the budget
+     * @throws std::invalid_argument on a negative budget
+     *
+     * A 0-1 program instead of the 2^N combinations of
+     * ScenarioGenerator::generate_all_combinations(): depth-first branch
+     * and bound over the points in MAC order, pruned by the fractional
+     * reduction each period can still gain within the remaining budget and
+     * by the fractional cost of covering each period's remaining gap.
+     * Actions with savings are taken whenever the budget allows. Reductions
+     * add up, as on the MAC curve; verify_portfolio() checks them against
+     * the full engine.
+     */
+    static AbatementPortfolio optimize_portfolio(const std::vector<MACPoint>& points,
+                                                 const PortfolioOptions& options);
+
+    /// Reductions (tCO2e/year) the full engine calculates with the given
+    /// actions active, one per target period of the portfolio (or one)
+    using PortfolioRun = std::function<std::vector<double>(const std::vector<std::string>& action_codes)>;
+
+    /**
+     * @brief Check a portfolio's reductions with a full run of its actions
+     * @param portfolio Portfolio to verify (verified and verified_reductions are set)
+     * @param run Calculates the reductions of the selected actions
+     * @param tolerance Relative shortfall still accepted
+     * @return Whether the run meets the target in every target period
+     * @throws std::invalid_argument if run returns the wrong number of reductions
+     */
+    static bool verify_portfolio(AbatementPortfolio& portfolio, const PortfolioRun& run, double tolerance = 1e-6);
+
     /**
      * @brief Store MAC curve to database
      * @param curve MAC curve to store
@@ -118,6 +220,12 @@ public:
      */
     void store_mac_curve(const MACCurve& curve);
 
+    /**
+     * @brief Store several MAC curves in one transaction
+     * @param curves Curves to store (each replaces its scenario/period's points)
+     */
+    void store_mac_curves(const std::vector<MACCurve>& curves);
+
     /**
      * @brief Load MAC curve from database
      * @param scenario_id Scenario identifier
@@ -126,10 +234,62 @@ public:
      */
     MACCurve load_mac_curve(int scenario_id, int period_id);
 
+    /**
+     * @brief MAC curve kept in memory for live what-if edits
+     * @param scenario_id Scenario identifier
+     * @param period_id Period identifier
+     * @return Cached curve (calculated on first use, valid until cleared)
+     */
+    const MACCurve& cached_mac_curve(int scenario_id, int period_id);
+
+    /**
+     * @brief Change an action's costs in every cached curve of its scenario
+     * @param scenario_id Scenario identifier
+     * @param action_code Action to update
+     * @param capex New capital expenditure (CHF)
+     * @param opex_annual New annual operating cost (CHF/year)
+     * @return Number of cached curves that contain the action
+     *
+     * Each curve moves the action to its new rank with one binary search
+     * and one rotation, and recomputes cumulative reductions only between
+     * its old and new rank (the points after keep theirs): O(log N + k)
+     * per curve. The database is not changed; store_mac_curve() persists
+     * an edited curve.
+     */
+    size_t update_action_cost(int scenario_id, const std::string& action_code, double capex, double opex_annual);
+
+    /**
+     * @brief Drop cached curves (all of them, or one scenario's)
+     */
+    void clear_cached_curves();
+    void clear_cached_curves(int scenario_id);
+
 private:
     std::shared_ptr<database::IDatabase> db_;
     int capex_amortization_years_;
 
+    /// Curve of cached_mac_curve() and the rank of each of its actions
+    struct CachedCurve {
+        MACCurve curve;
+        std::unordered_map<std::string, size_t> rank;
+    };
+
+    // By (scenario, period)
+    std::map<std::pair<int, int>, CachedCurve> cached_curves_;
+
+    /**
+     * @brief Actions of the scenarios with costs and MAC set, sorted by MAC
+     * @return By scenario: (point, no end period)
+     */
+    std::map<int, std::vector<std::pair<MACPoint, bool>>> load_ranked_points(
+        const std::vector<int>& scenario_ids) const;
+
+    /**
+     * @brief Move one point of a ranked curve to its new cost
+     * @return False if the curve doesn't contain the action
+     */
+    bool reposition(CachedCurve& cached, const std::string& action_code, double capex, double opex_annual) const;
+
     /**
      * @brief Calculate marginal cost for an action
      * @param capex Capital expenditure (CHF)
@@ -142,6 +302,13 @@ private:
         double opex_annual,
         double emission_reduction_annual
     ) const;
+
+    /**
+     * @brief Curve of a period from its active actions
+     * @param ranked Active actions with costs and MAC set, sorted by MAC
+     */
+    static MACCurve build_curve(int scenario_id, int period_id,
+                                const std::vector<const MACPoint*>& ranked);
 };
 
 } // namespace carbon
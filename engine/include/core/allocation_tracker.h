@@ -0,0 +1,99 @@
+/**
+ * @file allocation_tracker.h
+ * @brief Heap allocation counts of the calling thread
+ *
+ * Built with FINMODEL_TRACK_ALLOCATIONS=1 (the default) the engine replaces
+ * the global operator new, which counts the allocations and bytes of each
+ * thread while tracking is enabled. Tracking is off until something
+ * retains it (a Profiler with track_allocations(), a benchmark), so
+ * untracked runs pay one relaxed load per allocation.
+ *
+ * Counts only grow: take thread_counts() before and after a scope and
+ * subtract. Frees aren't counted - the question is the churn of the
+ * calculation loop, not its footprint.
+ *
+ * Usage:
+ * @code
+ * ScopedAllocationTracking tracking;
+ * const auto before = AllocationTracker::thread_counts();
+ * engine.calculate(...);
+ * const auto used = AllocationTracker::thread_counts() - before;
+ * @endcode
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef FINMODEL_TRACK_ALLOCATIONS
+#define FINMODEL_TRACK_ALLOCATIONS 0
+#endif
+
+namespace finmodel {
+namespace core {
+
+/// False when built with FINMODEL_TRACK_ALLOCATIONS=0: all counts stay 0
+constexpr bool ALLOCATION_TRACKING_BUILT = FINMODEL_TRACK_ALLOCATIONS != 0;
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+
+    AllocationCounts operator-(const AllocationCounts& other) const {
+        return {allocations - other.allocations, bytes - other.bytes};
+    }
+    AllocationCounts& operator+=(const AllocationCounts& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+/**
+ * @brief Process-wide switch and per-thread counters of the replaced allocator
+ */
+class AllocationTracker {
+public:
+    /**
+     * @brief Enable tracking until the matching release() (nested holders allowed)
+     */
+    static void retain() { holders_.fetch_add(1, std::memory_order_relaxed); }
+    static void release() { holders_.fetch_sub(1, std::memory_order_relaxed); }
+
+    static bool enabled() { return holders_.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * @brief Allocations of the calling thread while tracking was enabled
+     */
+    static AllocationCounts thread_counts() { return counts_; }
+
+    /**
+     * @brief Count one allocation (called by the replaced operator new)
+     */
+    static void record(size_t bytes) noexcept {
+        if (enabled()) {
+            ++counts_.allocations;
+            counts_.bytes += bytes;
+        }
+    }
+
+private:
+    static inline std::atomic<int> holders_{0};
+    static inline thread_local AllocationCounts counts_{};
+};
+
+/**
+ * @brief Tracks allocations from construction to destruction
+ */
+class ScopedAllocationTracking {
+public:
+    ScopedAllocationTracking() { AllocationTracker::retain(); }
+    ~ScopedAllocationTracking() { AllocationTracker::release(); }
+
+    ScopedAllocationTracking(const ScopedAllocationTracking&) = delete;
+    ScopedAllocationTracking& operator=(const ScopedAllocationTracking&) = delete;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,75 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for data that lives no longer than one period
+ *
+ * An Arena hands out memory from large blocks and frees nothing until
+ * reset(), which rewinds it for the next period. It keeps its blocks:
+ * after a period that needed more than the first block, reset() replaces
+ * them by one block of their total size, so once a run has seen its
+ * largest period, periods allocate nothing from the heap.
+ *
+ * It is a std::pmr::memory_resource, so any std::pmr container can live
+ * in it. Not thread-safe: each scenario worker (PeriodRunner) owns one.
+ *
+ * Usage:
+ * @code
+ * Arena arena;
+ * for (PeriodID period : periods) {
+ *     arena.reset();
+ *     std::pmr::vector<double> scratch(n, 0.0, &arena);
+ *     ...
+ * }
+ * @endcode
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+class Arena : public std::pmr::memory_resource {
+public:
+    /**
+     * @param initial_bytes Size of the first block (allocated on first use)
+     */
+    explicit Arena(size_t initial_bytes = 64 * 1024);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Free everything allocated since the last reset (memory is kept)
+     */
+    void reset();
+
+    size_t bytes_used() const { return used_; }           ///< Since the last reset
+    size_t capacity() const;                              ///< Bytes in all blocks
+    uint64_t heap_allocations() const { return heap_allocations_; }  ///< Blocks ever allocated
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}  // Freed by reset()
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void add_block(size_t size);
+
+    size_t initial_bytes_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;        ///< Block allocations come from
+    size_t offset_ = 0;         ///< Next free byte in it
+    size_t used_ = 0;
+    uint64_t heap_allocations_ = 0;
+};
+
+} // namespace core
+} // namespace finmodel
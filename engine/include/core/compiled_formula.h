@@ -0,0 +1,151 @@
+/**
+ * @file compiled_formula.h
+ * @brief Immutable bytecode representation of a parsed formula
+ *
+ * FormulaEvaluator::compile() lowers a formula string into a flat postfix
+ * program that is executed on a small value stack. Formulas are parsed once
+ * and the same CompiledFormula is re-used for every period and scenario.
+ *
+ * Example: "MAX(0, EBIT * TAX_RATE)" compiles to
+ * @code
+ * PUSH_CONST  0        // 0.0
+ * LOAD_VAR    0        // EBIT
+ * LOAD_VAR    1        // TAX_RATE
+ * MUL
+ * CALL_BUILTIN 0       // MAX, 2 args
+ * @endcode
+ *
+ * IF and the logical operators compile to jumps, so untaken branches are
+ * never evaluated: "IF(A > 0, B, C)" becomes
+ * @code
+ * LOAD_VAR 0, PUSH_CONST 0, CMP_GT
+ * JUMP_IF_FALSE  → else
+ * LOAD_VAR 1                // B
+ * JUMP           → end
+ * else: LOAD_VAR 2          // C
+ * end:
+ * @endcode
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "function_registry.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Bytecode operations understood by the formula interpreter
+ */
+enum class OpCode : uint8_t {
+    PUSH_CONST,     ///< Push constants[operand]
+    LOAD_VAR,       ///< Push value of variables[operand]
+    NEG,            ///< Unary minus
+    ADD,            ///< a + b
+    SUB,            ///< a - b
+    MUL,            ///< a * b
+    DIV,            ///< a / b (throws on division by zero)
+    POW,            ///< a ^ b
+    CMP_LT,         ///< a < b  → 1.0 / 0.0
+    CMP_LE,         ///< a <= b → 1.0 / 0.0
+    CMP_GT,         ///< a > b  → 1.0 / 0.0
+    CMP_GE,         ///< a >= b → 1.0 / 0.0
+    CMP_EQ,         ///< a == b → 1.0 / 0.0
+    CMP_NE,         ///< a != b → 1.0 / 0.0
+    CALL_BUILTIN,   ///< Call registered function functions[operand] (resolved at compile time)
+    CALL,           ///< Call custom function functions[operand] with its arg_count stack values
+    TAX_COMPUTE,    ///< Call TAX_COMPUTE handler, functions[operand] holds the strategy
+    MEMO_CHECK,     ///< If shared value [operand] is cached: push it and jump to target
+    MEMO_STORE,     ///< Store top of stack as shared value [operand] (no pop)
+    JUMP,           ///< Jump to target
+    JUMP_IF_FALSE,  ///< Pop condition, jump to target if it is 0.0
+    SHORT_AND,      ///< If top is 0.0: leave 0.0 and jump to target, else pop
+    SHORT_OR,       ///< If top is non-zero: leave 1.0 and jump to target, else pop
+    TO_BOOL         ///< x → 1.0 / 0.0 (x != 0)
+};
+
+/**
+ * @brief Single bytecode instruction
+ */
+struct Instruction {
+    OpCode op;              ///< Operation
+    uint32_t operand = 0;   ///< Index into constants/variables/functions (op dependent)
+    uint32_t position = 0;  ///< Source position (for runtime error messages)
+    uint32_t target = 0;    ///< Jump target (jumps and MEMO_CHECK only)
+};
+
+/**
+ * @brief Variable reference resolved through the provider chain
+ */
+struct VariableRef {
+    std::string code;       ///< Variable code (e.g., "CASH", "driver:REVENUE")
+    int time_offset = 0;    ///< 0 for [t], -1 for [t-1], ...
+};
+
+/**
+ * @brief Function call site
+ */
+struct FunctionCall {
+    std::string name;               ///< Function name ("MIN", "TAX_COMPUTE:US_FEDERAL", ...)
+    uint32_t arg_count = 0;         ///< Number of stack arguments consumed
+    uint32_t function_id = 0;       ///< Registry ID (registered functions only)
+    BuiltinFunction builtin = nullptr;  ///< Implementation, or nullptr for custom functions
+    bool pure = false;              ///< Registered as pure (constant arguments can be folded)
+};
+
+/**
+ * @brief Immutable compiled formula (postfix bytecode)
+ *
+ * Built by FormulaEvaluator::compile() and executed by
+ * FormulaEvaluator::evaluate(const CompiledFormula&, ...). Holds no
+ * evaluation state, so one instance can be shared by any number of callers.
+ */
+class CompiledFormula {
+public:
+    /**
+     * @brief Get original formula text
+     */
+    const std::string& source() const { return source_; }
+
+    /**
+     * @brief Get instruction stream (postfix order)
+     */
+    const std::vector<Instruction>& code() const { return code_; }
+
+    /**
+     * @brief Get constant pool
+     */
+    const std::vector<double>& constants() const { return constants_; }
+
+    /**
+     * @brief Get variable references (one entry per distinct code/offset pair)
+     */
+    const std::vector<VariableRef>& variables() const { return variables_; }
+
+    /**
+     * @brief Get function call sites
+     */
+    const std::vector<FunctionCall>& functions() const { return functions_; }
+
+    /**
+     * @brief Maximum value stack depth needed to execute this formula
+     */
+    size_t max_stack_depth() const { return max_stack_depth_; }
+
+private:
+    friend class FormulaEvaluator;
+    friend class FormulaParser;
+    friend class FormulaOptimizer;
+
+    std::string source_;
+    std::vector<Instruction> code_;
+    std::vector<double> constants_;
+    std::vector<VariableRef> variables_;
+    std::vector<FunctionCall> functions_;
+    size_t max_stack_depth_ = 0;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -6,6 +6,7 @@
 #pragma once
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace finmodel {
@@ -17,9 +18,13 @@ namespace core {
  * The Context object encapsulates all state needed for formula evaluation:
  * - Which scenario, period, entity we're calculating
  * - Time index for time-series formulas (t vs t-1)
- * - Value cache for performance
  * - Recursion tracking for Phase B portfolio modeling
  *
+ * Context is a small trivially copyable key: evaluators copy it for every
+ * shifted variable reference, so it must not own heap memory. State that
+ * outlives a lookup (value memo, nested run lineage) lives in a RunState
+ * owned by the caller.
+ *
  * Time Index:
  * - 0 = current period [t]
  * - -1 = prior period [t-1]
@@ -31,8 +36,6 @@ namespace core {
  *
  * Future-proofed for Phase B:
  * - recursion_depth: Track nested scenario depth (prevent infinite loops)
- * - nested_run_ids: Track child scenario runs for lineage
- * - cached_values: Avoid recalculating same values within a run
  */
 class Context {
 public:
@@ -44,10 +47,6 @@ public:
 
     // Phase B: Nested scenario tracking (future use)
     int recursion_depth = 0;              ///< Current nesting level (0 = top level)
-    std::vector<int> nested_run_ids;      ///< Stack of parent run IDs
-
-    // Performance: Value cache
-    std::map<std::string, double> cached_values;  ///< Cache of calculated values
 
     /**
      * @brief Default constructor
@@ -98,6 +97,23 @@ public:
     int get_effective_period_id() const {
         return period_id + time_index;
     }
+};
+
+static_assert(std::is_trivially_copyable_v<Context>, "Context is copied per variable lookup");
+
+/**
+ * @brief State kept across lookups of one run, owned by the caller
+ *
+ * Split off Context so copying a Context never copies containers.
+ *
+ * Future-proofed for Phase B:
+ * - nested_run_ids: Track child scenario runs for lineage
+ * - cached_values: Avoid recalculating same values within a run
+ */
+class RunState {
+public:
+    std::vector<int> nested_run_ids;              ///< Stack of parent run IDs
+    std::map<std::string, double> cached_values;  ///< Cache of calculated values
 
     /**
      * @brief Cache a calculated value
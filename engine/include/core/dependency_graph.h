@@ -4,10 +4,12 @@
  */
 
 #pragma once
+#include "core/symbol_table.h"
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <map>
-#include <set>
 
 namespace finmodel {
 namespace core {
@@ -50,6 +52,12 @@ namespace core {
  *
  * graph.topological_sort();  // Throws with cycle description
  * @endcode
+ *
+ * Nodes are interned to dense IDs (in insertion order); callers building
+ * large graphs can keep the ID returned by add_node() and use the ID
+ * overloads to skip the string lookups. Codes are kept as Symbols of the
+ * global SymbolTable, so a graph holds no copies of them. Orderings are independent of
+ * insertion order: ties are broken by code, so results are deterministic.
  */
 class DependencyGraph {
 public:
@@ -58,11 +66,20 @@ public:
      */
     DependencyGraph() = default;
 
+    /// Returned by find_node() for unknown codes
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
     /**
      * @brief Add a node to the graph
      * @param code Node identifier (line item code)
+     * @return Node ID (the existing one if the node was added before)
      */
-    void add_node(const std::string& code);
+    uint32_t add_node(const std::string& code);
+
+    /**
+     * @brief Add a node by Symbol (no string hashing)
+     */
+    uint32_t add_node(Symbol symbol);
 
     /**
      * @brief Add a dependency edge
@@ -73,6 +90,32 @@ public:
      */
     void add_edge(const std::string& from, const std::string& to);
 
+    /**
+     * @brief Add a dependency edge between existing nodes
+     * @param from ID of the dependent node
+     * @param to ID of the dependency
+     */
+    void add_edge(uint32_t from, uint32_t to);
+
+    /**
+     * @brief Look up a node ID
+     * @param code Node identifier
+     * @return Node ID, or NO_NODE if the node isn't in the graph
+     */
+    uint32_t find_node(const std::string& code) const;
+    uint32_t find_node(Symbol symbol) const;
+
+    /**
+     * @brief Get the code of a node
+     * @param id Node ID (from add_node() or find_node())
+     */
+    const std::string& node_code(uint32_t id) const { return SymbolTable::global().name(symbols_[id]); }
+
+    /**
+     * @brief Get the Symbol of a node
+     */
+    Symbol node_symbol(uint32_t id) const { return symbols_[id]; }
+
     /**
      * @brief Get all direct dependencies of a node
      * @param code Node identifier
@@ -91,7 +134,7 @@ public:
      * @return Ordered list of codes (dependencies first)
      * @throws std::runtime_error if circular dependency detected
      *
-     * Uses Kahn's algorithm:
+     * Uses Kahn's algorithm in O(V + E) over the reverse edges:
      * 1. Find all nodes with no dependencies
      * 2. Remove them and add to result
      * 3. Remove their edges and repeat
@@ -106,6 +149,47 @@ public:
      */
     std::vector<std::string> topological_sort() const;
 
+    /**
+     * @brief Compute topological sort as node IDs
+     * @return Node IDs in the same order topological_sort() returns codes
+     * @throws std::runtime_error if circular dependency detected
+     */
+    std::vector<uint32_t> topological_order() const;
+
+    /**
+     * @brief Group nodes into topological levels
+     * @return Levels in dependency order; every node's dependencies are in
+     *         earlier levels, so nodes of one level can be calculated in parallel
+     * @throws std::runtime_error if circular dependency detected
+     *
+     * Example: Given dependencies:
+     *   GROSS_PROFIT → [REVENUE, COGS]
+     *   NET_INCOME → [GROSS_PROFIT, TAX]
+     *
+     * Result: [[COGS, REVENUE, TAX], [GROSS_PROFIT], [NET_INCOME]]
+     */
+    std::vector<std::vector<std::string>> topological_levels() const;
+
+    /**
+     * @brief Strongly connected components in dependency order
+     * @return Components; the dependencies of a component's nodes outside it
+     *         are all in earlier components
+     *
+     * A component of several nodes is a set of mutually dependent nodes
+     * (cycles through all of them), ordered so that few of them depend on
+     * a later one: each next node is the one with the fewest dependencies
+     * left in the component. A single node may still depend on itself.
+     * On an acyclic graph every component is one node, in
+     * topological_sort() order. Tarjan's algorithm, O(V + E), then Kahn's
+     * over the components.
+     *
+     * Example: Given dependencies:
+     *   INTEREST → [CASH], CASH → [NET], NET → [EBIT, INTEREST]
+     *
+     * Result: [[EBIT], [CASH, INTEREST, NET]]
+     */
+    std::vector<std::vector<std::string>> strongly_connected_components() const;
+
     /**
      * @brief Check for circular dependencies
      * @return true if graph has cycles
@@ -117,6 +201,7 @@ public:
      * @return Vector representing the cycle path, or empty if no cycle
      *
      * Example: If A→B→C→A, returns ["A", "B", "C", "A"]
+     * (iterative depth-first search, O(V + E))
      */
     std::vector<std::string> find_cycle() const;
 
@@ -128,34 +213,48 @@ public:
     /**
      * @brief Get number of nodes in graph
      */
-    size_t size() const { return nodes_.size(); }
+    size_t size() const { return symbols_.size(); }
 
     /**
      * @brief Check if graph is empty
      */
-    bool empty() const { return nodes_.empty(); }
+    bool empty() const { return symbols_.empty(); }
 
 private:
     /**
-     * @brief Helper for cycle detection using DFS
-     * @param node Current node being visited
-     * @param visiting Nodes currently in the DFS path (gray nodes)
-     * @param visited Nodes completely processed (black nodes)
-     * @param path Current DFS path
-     * @return true if cycle found
-     */
-    bool dfs_has_cycle(
-        const std::string& node,
-        std::set<std::string>& visiting,
-        std::set<std::string>& visited,
-        std::vector<std::string>& path
-    ) const;
-
-    // Adjacency list: node → set of nodes it depends on
-    std::map<std::string, std::set<std::string>> adjacency_;
-
-    // All nodes in graph (for nodes with no dependencies)
-    std::set<std::string> nodes_;
+     * @brief Edges in compressed sparse row form, nodes renumbered by code
+     *
+     * Rank r is the r-th node in code order; neighbours of a rank are
+     * sorted, so traversals visit nodes in code order.
+     */
+    struct Csr {
+        std::vector<uint32_t> node_of_rank;
+        std::vector<uint32_t> dependency_offsets;  ///< Size ranks + 1
+        std::vector<uint32_t> dependencies;        ///< Ranks each rank depends on
+        std::vector<uint32_t> dependent_offsets;   ///< Size ranks + 1
+        std::vector<uint32_t> dependents;          ///< Ranks depending on each rank
+    };
+
+    Csr build_csr() const;
+
+    /**
+     * @brief Kahn's algorithm over ranks
+     * @return Ranks in topological order (shorter than the graph on a cycle)
+     */
+    std::vector<uint32_t> kahn_order(const Csr& csr) const;
+
+    /**
+     * @brief Depth-first search for a cycle
+     * @return Node IDs of the cycle (first node repeated at the end), or empty
+     */
+    std::vector<uint32_t> find_cycle_ids(const Csr& csr) const;
+
+    // Node ID → code, and the reverse
+    std::vector<Symbol> symbols_;
+    std::unordered_map<Symbol, uint32_t> ids_;
+
+    // Edge list (from depends on to); duplicates are dropped in build_csr()
+    std::vector<std::pair<uint32_t, uint32_t>> edges_;
 };
 
 } // namespace core
@@ -0,0 +1,27 @@
+/**
+ * @file eigen.h
+ * @brief Eigen's dense and sparse cores, included without GCC's false positives
+ *
+ * Under -march=native GCC inlines Eigen's AVX-512 packet kernels deeply
+ * enough to lose track of which vector lanes have been written, and every
+ * translation unit that touches an Eigen expression then reports
+ * -Wmaybe-uninitialized / -Wuninitialized from avx512fintrin.h. Include Eigen
+ * through this header (or eigen_solvers.h for the factorisations) instead of
+ * <Eigen/...> directly, so the warnings stay off for Eigen alone and keep
+ * working for our own code.
+ */
+
+#pragma once
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file eigen_solvers.h
+ * @brief Eigen's dense and sparse factorisations, for the few sources that solve systems
+ *
+ * Kept apart from eigen.h so headers pulling in Eigen types don't pay for
+ * the decompositions; see eigen.h for why the diagnostics are suppressed.
+ */
+
+#pragma once
+
+#include "core/eigen.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+#include <Eigen/Dense>
+#include <Eigen/SparseLU>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
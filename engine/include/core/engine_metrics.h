@@ -0,0 +1,201 @@
+/**
+ * @file engine_metrics.h
+ * @brief Process-wide throughput, latency and cache counters for monitoring
+ *
+ * The engine counts what a production deployment watches - scenarios,
+ * periods and line items calculated, calculate latency, cache hit rates,
+ * time spent in the database, scheduler and result writer queue depths -
+ * while it runs.
+ * Recording is lock-free: every thread writes its own shard of counters
+ * (relaxed stores, one writer per shard), and a scrape sums the shards.
+ * The server mode publishes the sum in Prometheus text format
+ * (prometheus_text(), served at /metrics by web::Server).
+ *
+ * Unlike core::Profiler, which breaks one calculation down by stage and
+ * line item, these counters are always on and cost a few nanoseconds per
+ * record.
+ *
+ * Usage:
+ * @code
+ * EngineMetrics::add(EngineMetrics::Counter::PERIODS);
+ * {
+ *     EngineMetrics::CalculateTimer timer;   // Records the latency on scope exit
+ *     engine.calculate(...);
+ * }
+ * std::string text = EngineMetrics::global().prometheus_text();
+ * @endcode
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Sharded counters of the whole process
+ */
+class EngineMetrics {
+public:
+    enum class Counter : uint8_t {
+        SCENARIOS,              ///< Scenario runs finished (PeriodRunner::run_periods)
+        PERIODS,                ///< Periods calculated
+        LINE_ITEMS,             ///< Line item values calculated
+        CALCULATE_NANOSECONDS,  ///< Wall time inside UnifiedEngine::calculate
+        DB_NANOSECONDS,         ///< Wall time preparing and stepping SQLite statements
+        TEMPLATE_CACHE_HITS,
+        TEMPLATE_CACHE_MISSES,
+        STATEMENT_CACHE_HITS,   ///< Prepared statements reused
+        STATEMENT_CACHE_MISSES, ///< Statements prepared
+        RESULT_CACHE_HITS,      ///< Scenario runs read from a ResultCache
+        RESULT_CACHE_MISSES,    ///< Fingerprinted scenario runs calculated
+        RESULT_SPILLED_SCENARIOS, ///< Scenario results moved to disk by a memory budget (BudgetedResults)
+        RESULT_SPILLED_BYTES,   ///< Resident size of those results
+        TASKS_QUEUED,           ///< TaskScheduler tasks submitted
+        TASKS_STARTED,          ///< TaskScheduler tasks taken off a deque
+        TASK_NANOSECONDS,       ///< Wall time of TaskScheduler workers running tasks
+        WORKERS_STARTED,        ///< TaskScheduler workers created
+        WORKERS_STOPPED,        ///< TaskScheduler workers joined
+        RESULT_JOBS_QUEUED,     ///< Runs and periods handed to a ResultWriter
+        RESULT_JOBS_WRITTEN,    ///< Of those, stored (or dropped by a failed write pass)
+        RESULT_QUEUE_STALLS,    ///< Hand-offs that waited for a full ResultWriter queue
+        RESULT_STALL_NANOSECONDS, ///< Time they waited
+        COUNT
+    };
+    static constexpr size_t COUNTERS = static_cast<size_t>(Counter::COUNT);
+
+    /// Latency histogram: 8 buckets per power of two of nanoseconds, up to 2^40 ns (~18 min)
+    static constexpr size_t LATENCY_BUCKETS = 8 + 37 * 8;
+
+    /**
+     * @brief Summed counters at one point in time
+     */
+    struct Snapshot {
+        std::array<uint64_t, COUNTERS> counters{};
+        std::array<uint64_t, LATENCY_BUCKETS> latency{};   ///< Calculations per latency bucket
+        double uptime_seconds = 0.0;
+        double first_calculate_seconds = 0.0;   ///< Process start to the end of the first calculation (0: none yet)
+
+        uint64_t operator[](Counter counter) const { return counters[static_cast<size_t>(counter)]; }
+
+        uint64_t calculations() const;
+
+        /// Calculate latency at quantile q in [0, 1], in seconds (bucket midpoint; 0 when empty)
+        double latency_quantile(double q) const;
+    };
+
+    /**
+     * @brief The process-wide instance recorded into by the engine
+     */
+    static EngineMetrics& global();
+
+    /**
+     * @brief Add to a counter of the calling thread
+     */
+    static void add(Counter counter, uint64_t amount = 1) {
+        auto& value = local().counters[static_cast<size_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record one calculation's latency (and add it to CALCULATE_NANOSECONDS)
+     */
+    static void record_calculate(uint64_t nanoseconds);
+
+    /**
+     * @brief Times a scope as one calculation
+     */
+    class CalculateTimer {
+    public:
+        CalculateTimer() : begin_(std::chrono::steady_clock::now()) {}
+        ~CalculateTimer() { record_calculate(elapsed_nanoseconds(begin_)); }
+
+        CalculateTimer(const CalculateTimer&) = delete;
+        CalculateTimer& operator=(const CalculateTimer&) = delete;
+
+    private:
+        std::chrono::steady_clock::time_point begin_;
+    };
+
+    /**
+     * @brief Times a scope as database work (DB_NANOSECONDS)
+     */
+    class DatabaseTimer {
+    public:
+        DatabaseTimer() : begin_(std::chrono::steady_clock::now()) {}
+        ~DatabaseTimer() { add(Counter::DB_NANOSECONDS, elapsed_nanoseconds(begin_)); }
+
+        DatabaseTimer(const DatabaseTimer&) = delete;
+        DatabaseTimer& operator=(const DatabaseTimer&) = delete;
+
+    private:
+        std::chrono::steady_clock::time_point begin_;
+    };
+
+    static uint64_t elapsed_nanoseconds(std::chrono::steady_clock::time_point begin) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count());
+    }
+
+    /// Histogram bucket of a latency
+    static size_t latency_bucket(uint64_t nanoseconds);
+
+    EngineMetrics();
+    ~EngineMetrics();
+
+    EngineMetrics(const EngineMetrics&) = delete;
+    EngineMetrics& operator=(const EngineMetrics&) = delete;
+
+    /**
+     * @brief Sum of all threads' counters (threads that exited included)
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Prometheus text exposition of the counters
+     *
+     * Counters are cumulative; the per-second rates and worker utilisation
+     * cover the time since the previous call (since start for the first).
+     */
+    std::string prometheus_text();
+
+private:
+    struct Shard {
+        std::array<std::atomic<uint64_t>, COUNTERS> counters{};
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> latency{};
+    };
+
+    /// Owns the calling thread's shard; folds it into retired_ at thread exit
+    struct LocalShard {
+        Shard* shard = nullptr;
+        ~LocalShard();
+    };
+
+    static Shard& local() {
+        static thread_local LocalShard holder;
+        return holder.shard ? *holder.shard : attach(holder);
+    }
+    static Shard& attach(LocalShard& holder);
+
+    void add_shard(const Shard& shard, Snapshot& into) const;
+
+    const std::chrono::steady_clock::time_point started_;
+    std::atomic<uint64_t> first_calculate_ns_{0};   ///< Cold start: set once, by the first record_calculate()
+    mutable std::mutex mutex_;                   ///< Guards shards_, retired_ and the last scrape
+    std::vector<std::unique_ptr<Shard>> shards_;
+    Snapshot retired_;                           ///< Counters of exited threads
+
+    Snapshot last_scrape_;
+    std::chrono::steady_clock::time_point last_scrape_time_;
+};
+
+} // namespace core
+} // namespace finmodel
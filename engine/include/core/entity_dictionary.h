@@ -0,0 +1,99 @@
+/**
+ * @file entity_dictionary.h
+ * @brief Entity code → dense integer ID mapping
+ *
+ * Entities are identified by their code (EntityID) at the API boundary.
+ * Inside a run they are keyed by a dense integer instead: contexts,
+ * provider caches and incremental results compare ints rather than
+ * hashing or comparing strings, and two codes never share an ID.
+ *
+ * Usage:
+ *   EntityDictionary entities(db);           // Loads the entity table
+ *   int id = entities.intern("ENTITY_001");  // Dense ID, stable for the dictionary's lifetime
+ *   const EntityID& code = entities.code(id);
+ */
+
+#pragma once
+
+#include "types/common_types.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace database {
+    class IDatabase;
+}
+}
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Dense integer IDs for entity codes
+ *
+ * IDs are assigned in entity table order (entity_id) at load, then in
+ * first-use order for codes the table doesn't have (tests and ad-hoc
+ * entities don't need an entity row). IDs are never reused or
+ * renumbered, so they may be kept across reload().
+ */
+class EntityDictionary {
+public:
+    /// Returned by find() for codes without an ID
+    static constexpr int NO_ENTITY = -1;
+
+    /**
+     * @brief Construct and load the entity table
+     * @param db Database connection (null: codes are only interned on use)
+     */
+    explicit EntityDictionary(std::shared_ptr<finmodel::database::IDatabase> db = nullptr);
+
+    /**
+     * @brief Add codes of entity rows created since construction
+     *
+     * A database without an entity table loads nothing.
+     */
+    void reload();
+
+    /**
+     * @brief Get the ID of a code, assigning the next ID to new codes
+     */
+    int intern(const EntityID& code);
+
+    /**
+     * @brief Get the ID of a code
+     * @return ID, or NO_ENTITY if the code has none
+     */
+    int find(const EntityID& code) const {
+        auto it = index_.find(code);
+        return (it != index_.end()) ? it->second : NO_ENTITY;
+    }
+
+    /**
+     * @brief Code of an ID
+     */
+    const EntityID& code(int id) const { return codes_[id]; }
+
+    /**
+     * @brief entity_id of the code's entity table row
+     * @return Row ID, or nullopt for codes interned without a row
+     */
+    std::optional<int64_t> database_id(int id) const;
+
+    /**
+     * @brief Number of IDs assigned
+     */
+    size_t size() const { return codes_.size(); }
+
+private:
+    std::shared_ptr<finmodel::database::IDatabase> db_;
+    std::unordered_map<EntityID, int> index_;
+    std::vector<EntityID> codes_;
+    std::vector<int64_t> database_ids_;   ///< Per ID: entity table row, or -1
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,67 @@
+/**
+ * @file exact_sum.h
+ * @brief Sums of doubles without rounding error, in any order
+ *
+ * A floating-point sum depends on the order of its additions, so a
+ * reduction split over threads gives different last bits for different
+ * thread counts. ExactSum keeps the sum as an expansion: a short list of
+ * non-overlapping doubles whose exact (unrounded) total is the sum of every
+ * value added (Shewchuk's algorithm, as in Python's math.fsum). value()
+ * rounds that total once, correctly, so it is the same for any order of
+ * the values and any split into merged partial sums.
+ *
+ * Products are added exactly too (the rounding error of a * b comes from
+ * std::fma), which makes sums of squares and cross products reproducible.
+ *
+ * Example:
+ * @code
+ * ExactSum a, b;
+ * for (size_t i = 0; i < n; ++i) (i % 2 ? a : b).add(x[i]);
+ * a.merge(b);
+ * double total = a.value();   // == the sum of x added in any order, correctly rounded
+ * @endcode
+ */
+
+#pragma once
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Exactly accumulated sum of doubles
+ *
+ * Infinite and NaN values make the sum infinite or NaN as in ordinary
+ * arithmetic; so does a total beyond the double range. Products are exact
+ * unless they fall below the normal range (magnitudes under about 1e-292).
+ */
+class ExactSum {
+public:
+    void add(double value);
+
+    /// Add a * b without rounding it first
+    void add_product(double a, double b);
+
+    /// Add the values of another sum
+    void merge(const ExactSum& other);
+
+    /// Exact total, rounded to nearest (ties to even)
+    double value() const;
+
+    /**
+     * @brief Non-overlapping parts of the total, increasing in magnitude
+     *
+     * Their exact sum is the total (while it is finite); the split itself
+     * depends on the order of the additions.
+     */
+    const std::vector<double>& partials() const { return partials_; }
+
+    void clear();
+
+private:
+    std::vector<double> partials_;
+    double special_ = 0.0;   // Sum of the infinite and NaN values (and overflows)
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,160 @@
+/**
+ * @file formula_binding.h
+ * @brief Compiled formula bound to a fixed provider chain
+ *
+ * A FormulaBinding resolves every variable of a CompiledFormula to a list of
+ * (provider, slot) candidates once. Evaluating the binding then reads values
+ * straight out of provider slot arrays instead of scanning providers with
+ * string keys on every lookup.
+ *
+ * Example:
+ * @code
+ * FormulaEvaluator eval;
+ * FormulaBinding bound(eval.compile("REVENUE - COGS"), providers);
+ *
+ * for (int period : periods) {
+ *     Context ctx(scenario_id, period, entity_id);
+ *     double gp = eval.evaluate(bound, ctx);
+ * }
+ * @endcode
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiled_formula.h"
+#include "ivalue_provider.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief One candidate source for a bound variable
+ *
+ * slot == IValueProvider::NO_SLOT means the provider doesn't support slots
+ * for this code and is queried through has_value()/get_value() instead.
+ * Candidates with direct arrays (see IValueProvider::direct_arrays()) are
+ * read without calling the provider when the lookup's time index matches.
+ */
+struct ProviderSlot {
+    IValueProvider* provider = nullptr;
+    int slot = IValueProvider::NO_SLOT;
+    uint8_t direct_count = 0;   ///< Arrays in direct (0: use the virtual slot API)
+    int direct_time = 0;        ///< Time index the arrays answer for
+    SlotArrays direct[2];
+
+    /**
+     * @brief Resolve a code against a provider
+     * @param provider Provider
+     * @param code Variable code
+     * @param time_index Time index lookups will use (for direct arrays)
+     * @param out Candidate
+     * @return false if the provider can never serve the code (no candidate needed)
+     */
+    static bool resolve(IValueProvider* provider, const std::string& code, int time_index, ProviderSlot& out) {
+        out = ProviderSlot();
+        out.provider = provider;
+        out.slot = provider->resolve_slot(code);
+        if (out.slot == IValueProvider::NO_SLOT) {
+            return true;
+        }
+        if (!provider->slot_can_have_value(out.slot)) {
+            return false;
+        }
+        out.direct_count = static_cast<uint8_t>(provider->direct_arrays(time_index, out.direct));
+        out.direct_time = time_index;
+        return true;
+    }
+
+    /**
+     * @brief Read the value from direct arrays
+     * @param time_index Time index of the lookup
+     * @param value Output: value if found
+     * @return 1 if found, 0 if the provider has no value, -1 if the arrays
+     *         don't apply (use the virtual slot API)
+     */
+    int read_direct(int time_index, double& value) const {
+        if (direct_count == 0 || time_index != direct_time) {
+            return -1;
+        }
+        for (uint8_t i = 0; i < direct_count; ++i) {
+            if ((*direct[i].present)[slot]) {
+                value = (*direct[i].values)[slot];
+                return 1;
+            }
+        }
+        return 0;
+    }
+};
+
+/**
+ * @brief Compiled formula with variables resolved against a provider chain
+ *
+ * Candidates for each variable keep the provider order, so lookup semantics
+ * match FormulaEvaluator::evaluate(formula, providers, ctx): the first
+ * provider that currently has the value wins.
+ *
+ * Slots are stable for the lifetime of the providers, so a binding stays
+ * valid as long as the providers it was built from are alive.
+ */
+class FormulaBinding {
+public:
+    /**
+     * @brief Bind compiled formula to providers
+     * @param compiled Compiled formula
+     * @param providers Value providers (checked in order at evaluation time)
+     */
+    FormulaBinding(
+        std::shared_ptr<const CompiledFormula> compiled,
+        const std::vector<IValueProvider*>& providers
+    )
+        : compiled_(std::move(compiled))
+    {
+        const auto& vars = compiled_->variables();
+        offsets_.reserve(vars.size() + 1);
+        offsets_.push_back(0);
+        for (const auto& var : vars) {
+            for (auto* provider : providers) {
+                // Providers that can't serve the code are left out
+                ProviderSlot candidate;
+                if (ProviderSlot::resolve(provider, var.code, var.time_offset, candidate)) {
+                    slots_.push_back(candidate);
+                }
+            }
+            offsets_.push_back(static_cast<uint32_t>(slots_.size()));
+        }
+    }
+
+    /**
+     * @brief Get underlying compiled formula
+     */
+    const CompiledFormula& formula() const { return *compiled_; }
+
+    /**
+     * @brief Get shared handle to the compiled formula
+     */
+    const std::shared_ptr<const CompiledFormula>& compiled() const { return compiled_; }
+
+    /**
+     * @brief First candidate for variable index
+     */
+    const ProviderSlot* candidates_begin(size_t var_index) const {
+        return slots_.data() + offsets_[var_index];
+    }
+
+    /**
+     * @brief One past last candidate for variable index
+     */
+    const ProviderSlot* candidates_end(size_t var_index) const {
+        return slots_.data() + offsets_[var_index + 1];
+    }
+
+private:
+    std::shared_ptr<const CompiledFormula> compiled_;
+    std::vector<ProviderSlot> slots_;   ///< Candidates, flattened per variable
+    std::vector<uint32_t> offsets_;     ///< Variable i → slots_[offsets_[i], offsets_[i+1])
+};
+
+} // namespace core
+} // namespace finmodel
@@ -4,39 +4,75 @@
  */
 
 #pragma once
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <unordered_map>
 #include "ivalue_provider.h"
 #include "context.h"
+#include "compiled_formula.h"
+#include "formula_binding.h"
+#include "function_registry.h"
 
 namespace finmodel {
 namespace core {
 
+class SubexpressionCache;
+
 /**
  * @brief Formula evaluator supporting arithmetic, functions, and variables
  *
  * Supported Features:
  * - Arithmetic operators: +, -, *, /, ^, ()
- * - Functions: MIN(a,b), MAX(a,b), ABS(x), IF(cond,true_val,false_val)
+ * - Functions: MIN(a,b), MAX(a,b), ABS(x), IF(cond,true_val,false_val),
+ *   SUM(x,...), AVG(x,...), ROUND(x[,digits]), CLAMP(x,lo,hi),
+ *   AND(x,...), OR(x,...)
+ * - Logical operators: && and || (short-circuit, yield 1.0 / 0.0)
+ * - Lazy IF: only the taken branch is evaluated
  * - Variables from IValueProvider
  * - Time references: CASH[t-1], REVENUE[t], EMISSIONS[t-2]
+ * - Time series: SUM_WINDOW(X, n) and AVG_WINDOW(X, n) over X[t-1] .. X[t-n]
+ *   (one variable each, see WindowRef), GROWTH(X) = X / X[t-1] - 1
  * - Whitespace handling
  * - Clear error messages
  *
  * Grammar (Recursive Descent):
  * @code
- * expression   → comparison
+ * expression   → logical_or
+ * logical_or   → logical_and ('||' logical_and)*
+ * logical_and  → comparison ('&&' comparison)*
  * comparison   → arithmetic (('<' | '<=' | '>' | '>=' | '==' | '!=') arithmetic)?
  * arithmetic   → term (('+' | '-') term)*
  * term         → power (('*' | '/') power)*
  * power        → factor ('^' factor)?
- * factor       → number | '(' expression ')' | function | variable | unary_minus
+ * factor       → number | '(' expression ')' | window | function | variable | unary_minus
  * function     → identifier '(' expression (',' expression)* ')'
+ * window       → ('SUM_WINDOW' | 'AVG_WINDOW') '(' identifier ',' integer ')' | 'GROWTH' '(' identifier ')'
  * variable     → identifier ('[' time_ref ']')?
  * time_ref     → 't' | 't-1' | 't-2' | 't+1'
  * @endcode
  *
+ * Compilation:
+ * Formulas are compiled once into postfix bytecode (CompiledFormula) and
+ * cached by formula text, so evaluate(string) only parses a given formula
+ * the first time it is seen. Hot loops can hold on to the result of
+ * compile() and call evaluate(const CompiledFormula&, ...) directly.
+ *
+ * Functions:
+ * Function names are resolved against the evaluator's FunctionRegistry at
+ * compile time (arity errors are compile errors). Names that aren't
+ * registered are sent to the custom function handler at evaluation time.
+ *
+ * Threading:
+ * All const members are safe to call from any number of threads at once.
+ * Parsing state lives in a per-call FormulaParser, evaluation state in a
+ * per-call value stack, and the compiled formula cache is guarded by a
+ * shared mutex. One evaluator (and the CompiledFormulas it hands out) can
+ * therefore be shared by every worker thread. register_function() is meant
+ * for setup and must not race with compilation.
+ *
  * Example Usage:
  * @code
  * FormulaEvaluator eval;
@@ -54,6 +90,9 @@ namespace core {
  */
 class FormulaEvaluator {
 public:
+    /// Custom function handler: (function name, evaluated arguments) → result
+    using CustomFunctionHandler = std::function<double(const std::string&, const std::vector<double>&)>;
+
     /**
      * @brief Constructor
      */
@@ -77,126 +116,167 @@ public:
         const std::string& formula,
         const std::vector<IValueProvider*>& providers,
         const Context& ctx,
-        std::function<double(const std::string&, const std::vector<double>&)> custom_functions = nullptr
-    );
+        CustomFunctionHandler custom_functions = nullptr
+    ) const;
 
     /**
-     * @brief Extract variable dependencies from formula
-     * @param formula The formula string
-     * @return List of variable codes this formula depends on (no duplicates)
+     * @brief Evaluate a previously compiled formula
+     * @param compiled Compiled formula (from compile())
+     * @param providers List of value providers (checked in order)
+     * @param ctx Context with scenario, period, entity, time
+     * @param custom_functions Optional custom function handler
+     * @param shared_values Values of subexpressions shared between formulas
+     *        (see FormulaOptimizer::share_subexpressions); nullptr evaluates
+     *        shared subexpressions in place
+     * @return Evaluated result
+     * @throws std::runtime_error if variable not found, division by zero, or unknown function
      *
-     * Example: "REVENUE - COGS" returns ["REVENUE", "COGS"]
-     * Example: "MAX(REVENUE, MIN_REVENUE)" returns ["REVENUE", "MIN_REVENUE"]
-     * Example: "CASH[t-1] + NET_CF" returns ["CASH", "NET_CF"]
+     * Does not parse or look at the formula text.
      */
-    std::vector<std::string> extract_dependencies(const std::string& formula);
-
-private:
-    // ========================================================================
-    // Recursive Descent Parser Methods
-    // ========================================================================
-
-    /**
-     * @brief Parse top-level expression (delegates to comparison)
-     * expression → comparison
-     */
-    double parse_expression();
-
-    /**
-     * @brief Parse comparison expression
-     * comparison → arithmetic (('<' | '<=' | '>' | '>=' | '==' | '!=') arithmetic)?
-     */
-    double parse_comparison();
-
-    /**
-     * @brief Parse addition/subtraction expression
-     * arithmetic → term (('+' | '-') term)*
-     */
-    double parse_arithmetic();
-
-    /**
-     * @brief Parse multiplication/division term
-     * term → power (('*' | '/') power)*
-     */
-    double parse_term();
+    double evaluate(
+        const CompiledFormula& compiled,
+        const std::vector<IValueProvider*>& providers,
+        const Context& ctx,
+        const CustomFunctionHandler& custom_functions = nullptr,
+        SubexpressionCache* shared_values = nullptr
+    ) const;
 
     /**
-     * @brief Parse power operation
-     * power → factor ('^' factor)?
+     * @brief Evaluate a compiled formula bound to a provider chain
+     * @param bound Formula binding (variables resolved to provider slots)
+     * @param ctx Context with scenario, period, entity, time
+     * @param custom_functions Optional custom function handler
+     * @param shared_values Values of subexpressions shared between formulas (optional)
+     * @return Evaluated result
+     * @throws std::runtime_error if variable not found, division by zero, or unknown function
+     *
+     * Variable lookups go straight to provider slots; providers without slot
+     * support are queried through the string API as before.
      */
-    double parse_power();
+    double evaluate(
+        const FormulaBinding& bound,
+        const Context& ctx,
+        const CustomFunctionHandler& custom_functions = nullptr,
+        SubexpressionCache* shared_values = nullptr
+    ) const;
 
     /**
-     * @brief Parse factor (number, parentheses, function, variable, unary minus)
-     * factor → number | '(' expression ')' | function | variable | '-' factor
+     * @brief Compile formula to bytecode
+     * @param formula The formula string
+     * @return Immutable compiled formula (cached by formula text)
+     * @throws std::runtime_error on syntax error
+     *
+     * Constant subexpressions are folded (FormulaOptimizer::fold_constants).
      */
-    double parse_factor();
+    std::shared_ptr<const CompiledFormula> compile(const std::string& formula) const;
 
     /**
-     * @brief Parse function call
-     * function → identifier '(' expression (',' expression)* ')'
+     * @brief Number of compiled formulas held in the cache
      */
-    double parse_function(const std::string& func_name);
+    size_t cache_size() const;
 
     /**
-     * @brief Parse variable with optional time reference
-     * variable → identifier ('[' time_ref ']')?
+     * @brief Drop all cached compiled formulas
      */
-    double parse_variable(const std::string& var_name);
-
-    // ========================================================================
-    // Lexer Methods
-    // ========================================================================
+    void clear_cache();
 
     /**
-     * @brief Skip whitespace characters
+     * @brief Register additional function
+     * @param name Function name (must not clash with a registered function)
+     * @param min_args Minimum argument count
+     * @param max_args Maximum argument count (FunctionRegistry::VARIADIC for no limit)
+     * @param fn Implementation
+     * @param pure True if the result depends only on the arguments
+     * @throws std::invalid_argument on duplicate name or invalid arity
+     *
+     * Clears the compiled formula cache, since cached formulas may have
+     * resolved this name as a custom function. Not thread-safe: register
+     * functions before sharing the evaluator.
      */
-    void skip_whitespace();
+    void register_function(
+        const std::string& name,
+        uint32_t min_args,
+        uint32_t max_args,
+        BuiltinFunction fn,
+        bool pure = true
+    );
 
     /**
-     * @brief Peek at current character without consuming
-     * @return Current character, or '\0' if at end
+     * @brief Get functions known to the compiler
      */
-    char peek() const;
+    const FunctionRegistry& function_registry() const { return functions_; }
 
     /**
-     * @brief Get current character and advance position
-     * @return Current character, or '\0' if at end
+     * @brief Extract variable dependencies from formula
+     * @param formula The formula string
+     * @return List of variable codes this formula depends on (no duplicates)
+     *
+     * Example: "REVENUE - COGS" returns ["REVENUE", "COGS"]
+     * Example: "MAX(REVENUE, MIN_REVENUE)" returns ["REVENUE", "MIN_REVENUE"]
+     * Example: "CASH[t-1] + NET_CF" returns ["CASH", "NET_CF"]
      */
-    char next();
+    std::vector<std::string> extract_dependencies(const std::string& formula) const;
 
     /**
-     * @brief Check if character is alphabetic
+     * @brief Check if a formula is 0 whenever all its variables are 0
+     * @param compiled Compiled formula
+     * @return True for sums, differences, products and the like
+     *         ("A + B", "A * driver:RATE", "MAX(0, A) / 12"); false for
+     *         formulas with a non-zero constant term, divisions by a
+     *         variable (which raise at zero) or impure and custom functions
+     *
+     * Decided once per formula by evaluating it with every variable 0, so
+     * IF and the built-ins are covered exactly.
      */
-    bool is_alpha(char c) const;
+    static bool preserves_zero(const CompiledFormula& compiled);
 
     /**
-     * @brief Check if character is digit
+     * @brief Build "Variable not found" error for a reference
+     *
+     * Shared with callers that resolve variables themselves (e.g., the
+     * unified engine's lane mode) so error text stays identical.
      */
-    bool is_digit(char c) const;
+    static std::runtime_error variable_not_found(const VariableRef& var);
 
     /**
-     * @brief Check if character is alphanumeric or underscore
+     * @brief Get variable value through a formula binding
+     * @param bound Formula binding
+     * @param var_index Index into the compiled formula's variables
+     * @param ctx Current context
+     * @return Variable value
+     * @throws std::runtime_error if variable not found
+     *
+     * Used by callers that load inputs up front (e.g., native kernels).
      */
-    bool is_alnum(char c) const;
+    static double get_bound_value(
+        const FormulaBinding& bound,
+        size_t var_index,
+        const Context& ctx
+    );
 
-    /**
-     * @brief Read identifier (variable or function name)
-     * @return Identifier string
-     */
-    std::string read_identifier();
+private:
+    friend class LaneEvaluator;    // Re-uses call_function() for per-lane calls
+    friend class TangentEvaluator; // and for scalar calls on dual numbers
 
-    /**
-     * @brief Read number (integer or decimal)
-     * @return Number value
-     */
-    double read_number();
+    // ========================================================================
+    // Interpreter
+    // ========================================================================
 
     /**
-     * @brief Parse time reference like [t-1]
-     * @return Time offset (-1 for t-1, 0 for t, +1 for t+1, etc.)
+     * @brief Run bytecode on a value stack
+     * @param compiled Compiled formula
+     * @param load_var Callable (variable index) → value
+     * @param custom_functions Optional custom function handler
+     * @param shared_values Shared subexpression values (optional)
+     * @return Value left on top of the stack
      */
-    int parse_time_reference();
+    template <typename LoadVar>
+    static double execute(
+        const CompiledFormula& compiled,
+        LoadVar&& load_var,
+        const CustomFunctionHandler& custom_functions,
+        SubexpressionCache* shared_values
+    );
 
     // ========================================================================
     // Variable Resolution
@@ -204,22 +284,41 @@ private:
 
     /**
      * @brief Get variable value from providers
-     * @param code Variable code
-     * @param time_offset Time offset (0 for current, -1 for prior)
+     * @param var Variable reference (code and time offset)
+     * @param providers Value providers (checked in order)
+     * @param ctx Current context
      * @return Variable value
      * @throws std::runtime_error if variable not found
      */
-    double get_variable_value(const std::string& code, int time_offset);
+    static double get_variable_value(
+        const VariableRef& var,
+        const std::vector<IValueProvider*>& providers,
+        const Context& ctx
+    );
+
+    /**
+     * @brief Execute function call site
+     * @param call Function call site (registered or custom)
+     * @param args Pointer to first argument on the value stack
+     * @param custom_functions Custom function handler (used for unregistered names)
+     * @return Function result
+     * @throws std::runtime_error on unknown function (or what the custom handler throws)
+     */
+    static double call_function(
+        const FunctionCall& call,
+        const double* args,
+        const CustomFunctionHandler& custom_functions
+    );
 
     // ========================================================================
     // State Variables
     // ========================================================================
 
-    std::string formula_;                         ///< Formula being evaluated
-    size_t pos_;                                  ///< Current position in formula
-    std::vector<IValueProvider*> providers_;      ///< Value providers
-    Context ctx_;                                 ///< Current context
-    std::function<double(const std::string&, const std::vector<double>&)> custom_functions_;  ///< Custom function handler
+    FunctionRegistry functions_;                  ///< Functions resolved at compile time
+
+    /// Compiled formulas keyed by formula text (guarded by cache_mutex_)
+    mutable std::unordered_map<std::string, std::shared_ptr<const CompiledFormula>> compiled_cache_;
+    mutable std::shared_mutex cache_mutex_;
 };
 
 } // namespace core
@@ -0,0 +1,145 @@
+/**
+ * @file formula_optimizer.h
+ * @brief Bytecode optimisation passes for compiled formulas
+ *
+ * Two passes:
+ * - fold_constants(): literal-only arithmetic (and pure built-ins with
+ *   constant arguments) is evaluated once at compile time, so it is never
+ *   recomputed per period. FormulaEvaluator::compile() runs it on every
+ *   formula.
+ * - share_subexpressions(): subexpressions repeated across a template's
+ *   formulas (e.g. "REVENUE * driver:TAX_RATE") are evaluated once per
+ *   calculation and re-used through a SubexpressionCache.
+ *
+ * Example:
+ * @code
+ * std::vector<std::shared_ptr<const CompiledFormula>> formulas = ...;
+ * auto shared = FormulaOptimizer::share_subexpressions(formulas);
+ *
+ * SubexpressionCache cache(shared.shared_count);
+ * for (const auto& formula : shared.formulas) {
+ *     eval.evaluate(*formula, providers, ctx, &cache);
+ * }
+ * cache.clear();  // Values are only valid for one calculation pass
+ * @endcode
+ */
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "compiled_formula.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Values of shared subexpressions for one calculation pass
+ *
+ * A shared subexpression reads the same variables wherever it appears, so
+ * its value only stays valid while those variables don't change. Clear the
+ * cache whenever inputs change (for the unified engine: once per period).
+ */
+class SubexpressionCache {
+public:
+    /**
+     * @brief Create cache for a number of shared subexpressions
+     */
+    explicit SubexpressionCache(size_t count = 0)
+        : values_(count, 0.0)
+        , valid_(count, 0)
+    {
+    }
+
+    /**
+     * @brief Resize cache and invalidate all entries
+     */
+    void reset(size_t count) {
+        values_.assign(count, 0.0);
+        valid_.assign(count, 0);
+    }
+
+    /**
+     * @brief Invalidate all entries
+     */
+    void clear() { std::fill(valid_.begin(), valid_.end(), 0); }
+
+    /**
+     * @brief Number of entries
+     */
+    size_t size() const { return values_.size(); }
+
+    /**
+     * @brief Check if entry holds a value for the current pass
+     */
+    bool has(uint32_t id) const { return id < valid_.size() && valid_[id]; }
+
+    /**
+     * @brief Get entry value (only meaningful if has(id))
+     */
+    double get(uint32_t id) const { return values_[id]; }
+
+    /**
+     * @brief Store entry value
+     */
+    void set(uint32_t id, double value) {
+        if (id < values_.size()) {
+            values_[id] = value;
+            valid_[id] = 1;
+        }
+    }
+
+private:
+    std::vector<double> values_;
+    std::vector<uint8_t> valid_;
+};
+
+/**
+ * @brief Compiled formula optimisation passes
+ */
+class FormulaOptimizer {
+public:
+    /**
+     * @brief Result of share_subexpressions()
+     */
+    struct SharedFormulas {
+        /// Rewritten formulas, same order as the input
+        std::vector<std::shared_ptr<const CompiledFormula>> formulas;
+        /// Number of shared subexpressions (SubexpressionCache size)
+        size_t shared_count = 0;
+    };
+
+    /**
+     * @brief Fold constant subexpressions in place
+     * @param formula Formula to rewrite (must not contain jumps yet)
+     *
+     * Operations that would raise at runtime (division by a constant zero,
+     * built-ins that throw) are left in place so the error still surfaces
+     * when the formula is evaluated.
+     */
+    static void fold_constants(CompiledFormula& formula);
+
+    /**
+     * @brief Share subexpressions repeated across a set of formulas
+     * @param formulas Compiled formulas (e.g. every formula of a template)
+     * @param min_occurrences Minimum occurrences before a subexpression is shared
+     * @return Rewritten formulas and number of shared subexpressions
+     *
+     * Only subexpressions that read at least one variable and are free of
+     * custom functions (which may be stateful) are shared. Input formulas
+     * are not modified; formulas with nothing to share are returned as-is.
+     */
+    static SharedFormulas share_subexpressions(
+        const std::vector<std::shared_ptr<const CompiledFormula>>& formulas,
+        size_t min_occurrences = 2
+    );
+
+private:
+    /**
+     * @brief Recompute max stack depth after a rewrite
+     */
+    static void update_stack_depth(CompiledFormula& formula);
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,244 @@
+/**
+ * @file formula_parser.h
+ * @brief Recursive descent parser emitting formula bytecode
+ *
+ * A FormulaParser holds all state of one compilation (source view, cursor,
+ * stack depth) and lives only for a single FormulaEvaluator::compile()
+ * call, so compiling never touches shared mutable state and any number of
+ * threads can compile concurrently. See FormulaEvaluator for the grammar.
+ *
+ * Example:
+ * @code
+ * auto compiled = std::make_shared<CompiledFormula>();
+ * FormulaParser(source, *compiled, FunctionRegistry::builtins()).parse();
+ * @endcode
+ */
+
+#pragma once
+#include <cstdint>
+#include <set>
+#include <string_view>
+#include "compiled_formula.h"
+#include "function_registry.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Single-use parser for one formula
+ */
+class FormulaParser {
+public:
+    /**
+     * @brief Create parser
+     * @param source Formula text (must outlive the parser)
+     * @param target Formula receiving the bytecode
+     * @param functions Functions resolved at compile time
+     */
+    FormulaParser(std::string_view source, CompiledFormula& target, const FunctionRegistry& functions)
+        : formula_(source)
+        , target_(target)
+        , functions_(functions)
+    {
+    }
+
+    FormulaParser(const FormulaParser&) = delete;
+    FormulaParser& operator=(const FormulaParser&) = delete;
+
+    /**
+     * @brief Parse the whole formula into the target
+     * @throws std::runtime_error on syntax error
+     */
+    void parse();
+
+    /**
+     * @brief Collect identifiers of a formula (or function argument list)
+     * @param text Text to scan (results are views into it)
+     * @param deps Receives names referenced in the current period
+     * @param shifted Receives names referenced with a time offset
+     */
+    static void collect_dependencies(
+        std::string_view text,
+        std::set<std::string_view>& deps,
+        std::set<std::string_view>& shifted
+    );
+
+    /**
+     * @brief Check if character is alphabetic
+     */
+    static bool is_alpha(char c);
+
+    /**
+     * @brief Check if character is digit
+     */
+    static bool is_digit(char c);
+
+    /**
+     * @brief Check if character is alphanumeric or underscore
+     */
+    static bool is_alnum(char c);
+
+private:
+    // ========================================================================
+    // Recursive Descent Parser Methods (emit bytecode into target_)
+    // ========================================================================
+
+    /**
+     * @brief Parse top-level expression (delegates to logical_or)
+     * expression → logical_or
+     */
+    void parse_expression();
+
+    /**
+     * @brief Parse short-circuit OR
+     * logical_or → logical_and ('||' logical_and)*
+     */
+    void parse_logical_or();
+
+    /**
+     * @brief Parse short-circuit AND
+     * logical_and → comparison ('&&' comparison)*
+     */
+    void parse_logical_and();
+
+    /**
+     * @brief Parse comparison expression
+     * comparison → arithmetic (('<' | '<=' | '>' | '>=' | '==' | '!=') arithmetic)?
+     */
+    void parse_comparison();
+
+    /**
+     * @brief Parse addition/subtraction expression
+     * arithmetic → term (('+' | '-') term)*
+     */
+    void parse_arithmetic();
+
+    /**
+     * @brief Parse multiplication/division term
+     * term → power (('*' | '/') power)*
+     */
+    void parse_term();
+
+    /**
+     * @brief Parse power operation
+     * power → factor ('^' factor)?
+     */
+    void parse_power();
+
+    /**
+     * @brief Parse factor (number, parentheses, function, variable, unary minus)
+     * factor → number | '(' expression ')' | function | variable | '-' factor
+     */
+    void parse_factor();
+
+    /**
+     * @brief Parse function call
+     * function → identifier '(' expression (',' expression)* ')'
+     */
+    void parse_function(std::string_view func_name);
+
+    /**
+     * @brief Parse IF(cond, a, b) into jumps (only the taken branch runs)
+     */
+    void parse_lazy_if();
+
+    /**
+     * @brief Parse AND(...) / OR(...) into short-circuit jumps
+     * @param op SHORT_AND or SHORT_OR
+     */
+    void parse_short_circuit_call(std::string_view func_name, OpCode op);
+
+    /**
+     * @brief Parse a trailing window: SUM_WINDOW(code, n) or AVG_WINDOW(code, n)
+     * window → ('SUM_WINDOW' | 'AVG_WINDOW') '(' identifier ',' integer ')'
+     */
+    void parse_window(std::string_view func_name);
+
+    /**
+     * @brief Parse GROWTH(code), compiled as code / code[t-1] - 1
+     */
+    void parse_growth();
+
+    /**
+     * @brief Parse variable with optional time reference
+     * variable → identifier ('[' time_ref ']')?
+     */
+    void parse_variable(std::string_view var_name);
+
+    // ========================================================================
+    // Lexer Methods
+    // ========================================================================
+
+    /**
+     * @brief Skip whitespace characters
+     */
+    void skip_whitespace();
+
+    /**
+     * @brief Peek at current character without consuming
+     * @return Current character, or '\0' if at end
+     */
+    char peek() const;
+
+    /**
+     * @brief Get current character and advance position
+     * @return Current character, or '\0' if at end
+     */
+    char next();
+
+    /**
+     * @brief Read identifier (variable or function name)
+     * @return View into the formula text (valid while it is being parsed)
+     */
+    std::string_view read_identifier();
+
+    /**
+     * @brief Read number (integer or decimal)
+     * @return Number value
+     */
+    double read_number();
+
+    /**
+     * @brief Parse time reference like [t-1]
+     * @return Time offset (-1 for t-1, 0 for t, +1 for t+1, etc.)
+     */
+    int parse_time_reference();
+
+    // ========================================================================
+    // Bytecode Emission
+    // ========================================================================
+
+    /**
+     * @brief Append instruction and track stack depth
+     * @param op Operation
+     * @param operand Operand index (op dependent)
+     * @param stack_effect Net change in stack depth caused by this instruction
+     */
+    void emit(OpCode op, uint32_t operand, int stack_effect);
+
+    /**
+     * @brief Append jump with target still unknown
+     * @return Index of the jump instruction (pass to patch_jump())
+     */
+    size_t emit_jump(OpCode op, int stack_effect);
+
+    /**
+     * @brief Point jump at the next instruction to be emitted
+     */
+    void patch_jump(size_t jump_index);
+
+    /**
+     * @brief Intern variable reference in the formula being compiled
+     * @return Index into CompiledFormula::variables()
+     */
+    uint32_t add_variable(std::string_view code, int time_offset);
+
+    std::string_view formula_;              ///< Formula being parsed (never copied)
+    size_t pos_ = 0;                        ///< Current position in formula
+    CompiledFormula& target_;               ///< Formula being emitted
+    const FunctionRegistry& functions_;     ///< Functions resolved at compile time
+    int stack_depth_ = 0;                   ///< Stack depth at current emission point
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,148 @@
+/**
+ * @file function_registry.h
+ * @brief Registry of built-in formula functions
+ *
+ * Function names are resolved against the registry once, when a formula is
+ * compiled. Each call site then carries a plain function pointer, so the
+ * interpreter never compares names or relies on exceptions to find out that
+ * a name isn't a custom function.
+ *
+ * Built-ins:
+ * - MIN(a, b), MAX(a, b), ABS(x), IF(cond, true_val, false_val)
+ * - SUM(x, ...), AVG(x, ...)
+ * - ROUND(x) / ROUND(x, digits)
+ * - CLAMP(x, lo, hi)
+ * - AND(x, ...), OR(x, ...)
+ *
+ * IF, AND and OR are compiled to jumps (lazy evaluation); their registry
+ * entries reserve the names and carry the arity rules.
+ *
+ * Example:
+ * @code
+ * FormulaEvaluator eval;
+ * eval.register_function("SQRT", 1, 1, [](const double* args, uint32_t) {
+ *     return std::sqrt(args[0]);
+ * });
+ * @endcode
+ */
+
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Built-in function implementation
+ * @param args Pointer to first argument
+ * @param argc Number of arguments (already checked against the definition)
+ */
+using BuiltinFunction = double (*)(const double* args, uint32_t argc);
+
+/**
+ * @brief Function definition held by the registry
+ */
+struct FunctionDef {
+    std::string name;           ///< Function name as written in formulas
+    uint32_t id = 0;            ///< Stable registry ID
+    uint32_t min_args = 0;      ///< Minimum argument count
+    uint32_t max_args = 0;      ///< Maximum argument count (FunctionRegistry::VARIADIC for no limit)
+    bool pure = true;           ///< Result depends only on arguments (safe to fold constants)
+    BuiltinFunction fn = nullptr;
+};
+
+/**
+ * @brief Name → function definition table
+ *
+ * IDs are assigned in registration order, so the standard built-ins keep
+ * the same IDs (see BuiltinId) in every registry created from builtins().
+ */
+class FunctionRegistry {
+public:
+    static constexpr uint32_t VARIADIC = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * @brief IDs of the standard built-ins
+     */
+    enum BuiltinId : uint32_t {
+        FN_MIN,
+        FN_MAX,
+        FN_ABS,
+        FN_IF,
+        FN_SUM,
+        FN_AVG,
+        FN_ROUND,
+        FN_CLAMP,
+        FN_AND,
+        FN_OR,
+        BUILTIN_COUNT
+    };
+
+    /**
+     * @brief Create empty registry
+     */
+    FunctionRegistry() = default;
+
+    /**
+     * @brief Registry with the standard built-ins
+     */
+    static const FunctionRegistry& builtins();
+
+    /**
+     * @brief Register function
+     * @param name Function name (must not already be registered)
+     * @param min_args Minimum argument count
+     * @param max_args Maximum argument count (VARIADIC for no limit)
+     * @param fn Implementation
+     * @param pure True if the result depends only on the arguments
+     * @return ID of the new function
+     * @throws std::invalid_argument on duplicate name or invalid arity
+     */
+    uint32_t register_function(
+        const std::string& name,
+        uint32_t min_args,
+        uint32_t max_args,
+        BuiltinFunction fn,
+        bool pure = true
+    );
+
+    /**
+     * @brief Look up function by name
+     * @return Definition, or nullptr if not registered
+     */
+    const FunctionDef* find(std::string_view name) const;
+
+    /**
+     * @brief Get function by ID
+     */
+    const FunctionDef& get(uint32_t id) const { return functions_[id]; }
+
+    /**
+     * @brief Number of registered functions
+     */
+    size_t size() const { return functions_.size(); }
+
+    /**
+     * @brief Check argument count against a definition
+     * @throws std::runtime_error if argc is out of range
+     */
+    static void check_arity(const FunctionDef& def, uint32_t argc);
+
+private:
+    /// Lets find() look up a string_view without building a std::string
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    std::vector<FunctionDef> functions_;
+    std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>> index_;
+};
+
+} // namespace core
+} // namespace finmodel
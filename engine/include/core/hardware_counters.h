@@ -0,0 +1,136 @@
+/**
+ * @file hardware_counters.h
+ * @brief CPU performance counters of the calling thread (perf_event_open)
+ *
+ * Wall-clock time alone doesn't say why a layout is faster. While tracking
+ * is retained, each thread that asks for its counts opens one perf event
+ * group of its own (user space only, so perf_event_paranoid up to 2 is
+ * enough) with cycles, instructions, L1 data read misses, last-level cache
+ * misses and branch misses. Reading the group is one read() call, so
+ * counters are meant for stages and benchmark loops, not single line
+ * items.
+ *
+ * Events the machine or the hypervisor doesn't offer are left out (their
+ * counts stay 0, has() says which are counted); off Linux, or where
+ * perf_event_open is refused, nothing is counted. When the kernel
+ * multiplexes the group, counts are scaled to the time it was enabled.
+ *
+ * Like AllocationTracker, counts only grow: take thread_counts() before
+ * and after a scope and subtract.
+ *
+ * Usage:
+ * @code
+ * ScopedHardwareCounting counting;
+ * const auto before = HardwareCounters::thread_counts();
+ * engine.calculate(...);
+ * const auto used = HardwareCounters::thread_counts() - before;
+ * double ipc = used.ipc();
+ * @endcode
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Counts of the hardware events, by HardwareCounters::Event
+ */
+struct HardwareCounts {
+    std::array<uint64_t, 5> values{};
+
+    uint64_t cycles() const { return values[0]; }
+    uint64_t instructions() const { return values[1]; }
+    uint64_t l1d_misses() const { return values[2]; }
+    uint64_t llc_misses() const { return values[3]; }
+    uint64_t branch_misses() const { return values[4]; }
+
+    /// Instructions per cycle (0 without cycles)
+    double ipc() const {
+        return cycles() > 0 ? static_cast<double>(instructions()) / static_cast<double>(cycles()) : 0.0;
+    }
+
+    HardwareCounts operator-(const HardwareCounts& other) const {
+        HardwareCounts out;
+        for (size_t i = 0; i < values.size(); ++i) {
+            out.values[i] = values[i] - other.values[i];
+        }
+        return out;
+    }
+    HardwareCounts& operator+=(const HardwareCounts& other) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] += other.values[i];
+        }
+        return *this;
+    }
+};
+
+/**
+ * @brief Process-wide switch and per-thread perf event groups
+ */
+class HardwareCounters {
+public:
+    enum class Event : uint8_t {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,     ///< L1 data cache read misses
+        LLC_MISSES,     ///< Last-level cache misses
+        BRANCH_MISSES
+    };
+    static constexpr size_t EVENT_COUNT = 5;
+
+    static const char* event_name(Event event);
+
+    /**
+     * @brief Enable counting until the matching release() (nested holders allowed)
+     */
+    static void retain() { holders_.fetch_add(1, std::memory_order_relaxed); }
+    static void release() { holders_.fetch_sub(1, std::memory_order_relaxed); }
+
+    static bool enabled() { return holders_.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * @brief Counts of the calling thread since its group was opened (zeros while disabled)
+     *
+     * The first call of a thread with counting enabled opens its group.
+     */
+    static HardwareCounts thread_counts();
+
+    /**
+     * @brief Whether the calling thread counts an event (opens its group if needed)
+     */
+    static bool has(Event event);
+
+    /**
+     * @brief Whether the calling thread counts anything
+     */
+    static bool available();
+
+    /**
+     * @brief Why the calling thread counts nothing (empty when available())
+     */
+    static std::string unavailable_reason();
+
+private:
+    static inline std::atomic<int> holders_{0};
+};
+
+/**
+ * @brief Counts hardware events from construction to destruction
+ */
+class ScopedHardwareCounting {
+public:
+    ScopedHardwareCounting() { HardwareCounters::retain(); }
+    ~ScopedHardwareCounting() { HardwareCounters::release(); }
+
+    ScopedHardwareCounting(const ScopedHardwareCounting&) = delete;
+    ScopedHardwareCounting& operator=(const ScopedHardwareCounting&) = delete;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -4,8 +4,13 @@
  */
 
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
 namespace finmodel {
 namespace core {
@@ -13,6 +18,17 @@ namespace core {
 // Forward declaration
 class Context;
 
+/**
+ * @brief Provider-owned arrays a slot can be read from without a virtual call
+ *
+ * Slot s has value (*values)[s] when (*present)[s] != 0. The vectors are
+ * members of the provider, so the pointers stay valid while it lives.
+ */
+struct SlotArrays {
+    const std::vector<double>* values = nullptr;
+    const std::vector<uint8_t>* present = nullptr;
+};
+
 /**
  * @brief Interface for providing values during formula evaluation
  *
@@ -49,6 +65,26 @@ class Context;
  * Context ctx(scenario_id, period_id, entity_id);
  * double result = eval.evaluate("REVENUE - COGS", providers, ctx);
  * @endcode
+ *
+ * Slot Binding (optional):
+ * Providers that store their values in flat arrays can override
+ * resolve_slot() / has_slot_value() / get_slot_value(). FormulaBinding
+ * resolves each formula variable to a slot once, after which lookups are
+ * plain array reads instead of string-keyed has_value()/get_value() calls.
+ * Providers that don't override these keep working through the string API.
+ *
+ * Static Resolution (optional):
+ * slot_can_have_value() lets a binding drop providers that can never serve
+ * a code, and direct_arrays() hands out the arrays behind get_slot_value()
+ * so bound lookups skip the virtual calls entirely.
+ *
+ * Misses (optional):
+ * The evaluator looks values up with find_value() / find_slot_value(),
+ * which return nothing instead of throwing when a provider that claims a
+ * code has no value for it (e.g. a driver absent in some scenarios), and
+ * tries the next provider. The defaults catch get_value()'s exception;
+ * providers on hot paths override them so a miss is a branch, and build
+ * their error messages only in get_value(), for callers that report them.
  */
 class IValueProvider {
 public:
@@ -74,6 +110,111 @@ public:
      * but get_value() might still throw if CASH doesn't exist for the period.
      */
     virtual bool has_value(const std::string& code) const = 0;
+
+    /**
+     * @brief Value of a code, or nothing if this provider doesn't have one
+     * @param code The variable code
+     * @param ctx Context containing period, scenario, entity, time index
+     * @return Same as get_value() where has_value() is true and get_value() doesn't throw
+     */
+    virtual std::optional<double> find_value(const std::string& code, const Context& ctx) const {
+        if (!has_value(code)) {
+            return std::nullopt;
+        }
+        try {
+            return get_value(code, ctx);
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    // ========================================================================
+    // Slot Binding
+    // ========================================================================
+
+    /// Returned by resolve_slot() when the provider has no slot for a code
+    static constexpr int NO_SLOT = -1;
+
+    /**
+     * @brief Resolve a variable code to a stable slot index
+     * @param code The variable code
+     * @return Slot index (valid for the provider's lifetime), or NO_SLOT
+     *
+     * A slot may be returned for a code whose value is not available yet;
+     * availability is checked per lookup with has_slot_value().
+     */
+    virtual int resolve_slot(const std::string& code) {
+        (void)code;
+        return NO_SLOT;
+    }
+
+    /**
+     * @brief Check if a value is currently available in a slot
+     * @param slot Slot index from resolve_slot()
+     * @return true if get_slot_value() would find a value
+     */
+    virtual bool has_slot_value(int slot) const {
+        (void)slot;
+        return false;
+    }
+
+    /**
+     * @brief Get value from a slot
+     * @param slot Slot index from resolve_slot()
+     * @param ctx Context containing period, scenario, entity, time index
+     * @return The value
+     * @throws std::runtime_error if no value is available
+     */
+    virtual double get_slot_value(int slot, const Context& ctx) const {
+        (void)ctx;
+        throw std::runtime_error("Provider does not support slot lookups (slot " +
+                                 std::to_string(slot) + ")");
+    }
+
+    /**
+     * @brief Value of a slot, or nothing if it has none (find_value() for slots)
+     * @param slot Slot index from resolve_slot()
+     * @param ctx Context containing period, scenario, entity, time index
+     */
+    virtual std::optional<double> find_slot_value(int slot, const Context& ctx) const {
+        if (!has_slot_value(slot)) {
+            return std::nullopt;
+        }
+        try {
+            return get_slot_value(slot, ctx);
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    /**
+     * @brief Check if a slot can ever have a value under the current configuration
+     * @param slot Slot index from resolve_slot()
+     * @return false if has_slot_value() stays false until the provider is
+     *         reconfigured (e.g. a driver provider's template mappings change)
+     *
+     * Bindings built under one configuration drop such candidates, so they
+     * must be used under the same configuration.
+     */
+    virtual bool slot_can_have_value(int slot) const {
+        (void)slot;
+        return true;
+    }
+
+    /**
+     * @brief Arrays that answer slot lookups at a time index
+     * @param time_index Context::time_index of the lookup
+     * @param out Filled with up to 2 arrays in lookup order (the first one
+     *        with the slot present has the value)
+     * @return Number of arrays, or 0 if lookups need get_slot_value()
+     *
+     * Must agree with has_slot_value() / get_slot_value() for every slot.
+     */
+    virtual size_t direct_arrays(int time_index, SlotArrays* out) const {
+        (void)time_index;
+        (void)out;
+        return 0;
+    }
 };
 
 } // namespace core
@@ -0,0 +1,106 @@
+/**
+ * @file low_discrepancy.h
+ * @brief Scrambled Sobol and Halton sequences for quasi-Monte Carlo runs
+ *
+ * Low-discrepancy points fill the unit cube more evenly than random ones,
+ * so means over N points converge at close to 1/N instead of 1/√N for
+ * smooth integrands. Randomising them (a scramble per replicate) keeps the
+ * estimates unbiased and lets independent replicates measure their error.
+ *
+ * A path of a simulation takes one dimension per random input, e.g.
+ * period × driver; coordinate() maps (point, dimension, replicate
+ * scramble) to (0, 1) and normal_quantile() turns it into a normal deviate.
+ *
+ * Example:
+ * @code
+ * SobolSequence sobol(periods * drivers, seed);
+ * std::vector<uint32_t> shift = sobol.scramble(replicate);
+ * for (uint32_t i = 0; i < points; ++i) {
+ *     double z = normal_quantile(sobol.coordinate(i, dim, shift[dim]));
+ * }
+ * @endcode
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Inverse of the standard normal distribution function
+ *
+ * Acklam's rational approximation refined by one Halley step (full
+ * double precision). p outside (0, 1) gives ±infinity.
+ */
+double normal_quantile(double p);
+
+/**
+ * @brief Sobol points in base 2, randomised by a digital shift
+ *
+ * Dimension 0 is the van der Corput sequence; dimension d > 0 uses the
+ * d-th primitive polynomial over GF(2) (ordered by degree and value) with
+ * initial direction numbers drawn from the seed, so any number of
+ * dimensions is available.
+ */
+class SobolSequence {
+public:
+    /**
+     * @brief Direction numbers of the dimensions
+     * @param seed Draws the initial direction numbers (same seed, same sequence)
+     */
+    SobolSequence(size_t dimensions, uint64_t seed);
+
+    size_t dimensions() const { return directions_.size(); }
+
+    /**
+     * @brief Digital shift per dimension of one replicate (drawn from the seed)
+     */
+    std::vector<uint32_t> scramble(uint64_t replicate) const;
+
+    /**
+     * @brief Coordinate of a point in (0, 1)
+     * @param shift The dimension's scramble() value (0: unscrambled)
+     */
+    double coordinate(uint32_t index, size_t dimension, uint32_t shift = 0) const;
+
+private:
+    uint64_t seed_;
+    std::vector<std::array<uint32_t, 32>> directions_;
+};
+
+/**
+ * @brief Halton points with permuted digits, randomised by a rotation
+ *
+ * Dimension d is the radical inverse in the d-th prime base. Digits are
+ * permuted (a random permutation per dimension fixing 0, from the seed),
+ * which removes the correlation between dimensions of large bases.
+ */
+class HaltonSequence {
+public:
+    HaltonSequence(size_t dimensions, uint64_t seed);
+
+    size_t dimensions() const { return bases_.size(); }
+
+    /**
+     * @brief Cranley-Patterson rotation per dimension of one replicate (drawn from the seed)
+     */
+    std::vector<double> scramble(uint64_t replicate) const;
+
+    /**
+     * @brief Coordinate of a point in (0, 1)
+     * @param rotation The dimension's scramble() value (0: unrotated)
+     */
+    double coordinate(uint64_t index, size_t dimension, double rotation = 0.0) const;
+
+private:
+    uint64_t seed_;
+    std::vector<uint32_t> bases_;
+    std::vector<std::vector<uint32_t>> permutations_;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,224 @@
+/**
+ * @file mpsc_ring.h
+ * @brief Bounded multi-producer, single-consumer queue of reusable slots
+ *
+ * Producers claim a slot with one compare-and-swap on the tail and fill it
+ * in place; the consumer takes ready slots in claim order by swapping them
+ * with its own items, so the buffers inside the items (strings, vectors)
+ * circulate between the consumer and the ring instead of being allocated
+ * per item. Each slot carries a sequence number telling producers and the
+ * consumer whose turn it is (D. Vyukov's bounded queue).
+ *
+ * When every slot is taken, producers wait for the consumer to free some
+ * (backpressure) and count a stall; an idle consumer waits for the next
+ * item. Both waits are atomic waits: nothing is locked on the way in or
+ * out.
+ *
+ * Usage:
+ * @code
+ * MpscRing<Job> ring(1024);
+ * ring.push([&](Job& job) { job.values = values; });   // Any thread
+ *
+ * std::vector<Job> batch(ring.capacity());            // Consumer thread
+ * while (true) {
+ *     size_t n = ring.pop(batch.data(), batch.size());
+ *     if (n == 0) { if (ring.closed()) break; ring.wait(); continue; }
+ *     ...
+ * }
+ * @endcode
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Counters of an MpscRing
+ */
+struct MpscRingStats {
+    size_t capacity = 0;
+    size_t depth = 0;               ///< Items claimed and not taken yet
+    size_t max_depth = 0;           ///< Largest depth seen by a producer
+    uint64_t pushes = 0;
+    uint64_t stalls = 0;            ///< Pushes that found the ring full
+    uint64_t stall_nanoseconds = 0; ///< Time those pushes waited
+};
+
+/**
+ * @brief Fixed ring of T slots: push() from any thread, pop() from one
+ *
+ * T must be default-constructible and swappable.
+ */
+template <typename T>
+class MpscRing {
+public:
+    /**
+     * @param capacity Slots (rounded up to a power of two, at least 2)
+     */
+    explicit MpscRing(size_t capacity)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * @brief Claim a slot, fill it and hand it to the consumer
+     *
+     * Blocks while the ring is full. fill receives the slot's item as the
+     * consumer left it: it must set every field the consumer reads.
+     *
+     * @return Nanoseconds spent waiting for a free slot (0: the ring wasn't full)
+     */
+    template <typename Fill>
+    uint64_t push(Fill&& fill) {
+        uint64_t position = tail_.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point stalled{};
+        Slot* slot = nullptr;
+        while (true) {
+            // Read before the slot: a pop after it wakes the wait below
+            const uint64_t released = released_.load(std::memory_order_acquire);
+            slot = &slots_[position & mask_];
+            const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<int64_t>(sequence - position);
+            if (lag == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (lag < 0) {
+                // Full: the consumer hasn't taken this slot's previous item
+                if (stalled == std::chrono::steady_clock::time_point{}) {
+                    stalled = std::chrono::steady_clock::now();
+                    stalls_.fetch_add(1, std::memory_order_relaxed);
+                }
+                released_.wait(released, std::memory_order_acquire);
+                position = tail_.load(std::memory_order_relaxed);
+            } else {
+                position = tail_.load(std::memory_order_relaxed);   // Another producer took it
+            }
+        }
+        uint64_t waited = 0;
+        if (stalled != std::chrono::steady_clock::time_point{}) {
+            waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - stalled).count());
+            stall_ns_.fetch_add(waited, std::memory_order_relaxed);
+        }
+        const size_t depth = position + 1 - head_.load(std::memory_order_relaxed);
+        size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+        while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+        }
+
+        fill(slot->value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        published_.fetch_add(1, std::memory_order_release);
+        published_.notify_one();
+        return waited;
+    }
+
+    /**
+     * @brief Take ready items in claim order (consumer thread only)
+     *
+     * Each item is swapped with out[i]: out's previous items go back into
+     * the ring for producers to refill. Doesn't block.
+     *
+     * @return Items taken (at most max)
+     */
+    size_t pop(T* out, size_t max) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        size_t taken = 0;
+        for (; taken < max; ++taken, ++head) {
+            Slot& slot = slots_[head & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                break;   // Empty, or its producer is still filling it
+            }
+            using std::swap;
+            swap(out[taken], slot.value);
+            slot.sequence.store(head + capacity_, std::memory_order_release);
+        }
+        if (taken > 0) {
+            head_.store(head, std::memory_order_relaxed);
+            released_.fetch_add(1, std::memory_order_release);
+            released_.notify_all();
+        }
+        return taken;
+    }
+
+    /**
+     * @brief Block until an item may be ready or the ring is closed (consumer thread only)
+     *
+     * May return early; call pop() again.
+     */
+    void wait() {
+        const uint64_t published = published_.load(std::memory_order_acquire);
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (closed() || slots_[head & mask_].sequence.load(std::memory_order_acquire) == head + 1) {
+            return;
+        }
+        published_.wait(published, std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Wake the consumer for good: wait() returns at once from now on
+     *
+     * Items already pushed can still be popped.
+     */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        published_.fetch_add(1, std::memory_order_release);
+        published_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    /// Items pushed so far (claimed slots, filled or being filled)
+    uint64_t pushes() const { return tail_.load(std::memory_order_relaxed); }
+
+    MpscRingStats stats() const {
+        MpscRingStats stats;
+        stats.capacity = capacity_;
+        stats.pushes = tail_.load(std::memory_order_relaxed);
+        stats.depth = static_cast<size_t>(stats.pushes - std::min(stats.pushes, head_.load(std::memory_order_relaxed)));
+        stats.max_depth = max_depth_.load(std::memory_order_relaxed);
+        stats.stalls = stalls_.load(std::memory_order_relaxed);
+        stats.stall_nanoseconds = stall_ns_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Slot {
+        alignas(64) std::atomic<uint64_t> sequence{0};   // position: free; position + 1: filled
+        T value{};
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};       // Next position to claim (producers)
+    alignas(64) std::atomic<uint64_t> head_{0};       // Next position to take (consumer)
+    alignas(64) std::atomic<uint64_t> published_{0};  // Bumped per push: the consumer waits on it
+    alignas(64) std::atomic<uint64_t> released_{0};   // Bumped per pop: full producers wait on it
+    std::atomic<bool> closed_{false};
+    std::atomic<size_t> max_depth_{0};
+    std::atomic<uint64_t> stalls_{0};
+    std::atomic<uint64_t> stall_ns_{0};
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,210 @@
+/**
+ * @file native_kernel.h
+ * @brief Lower a template's compiled formulas into one native function
+ *
+ * For long stochastic runs the same template is evaluated millions of
+ * times, and even bytecode interpretation leaves time on the table. A
+ * NativeKernel turns a whole calculation order into a single straight-line
+ * C++ function over a flat state array, compiles it with the system C++
+ * compiler and loads it with dlopen().
+ *
+ * State layout is chosen by the caller: every formula reads its variables
+ * from state slots and writes its result to an output slot, so a later
+ * formula can read an earlier result directly.
+ *
+ * Built libraries are cached on disk, keyed by a hash of the generated
+ * source, so a template is compiled once per machine rather than once per
+ * run.
+ *
+ * Lane kernels (build_lanes()) run the same formulas for many scenario
+ * lanes over a structure-of-arrays state: slot s of lane l at
+ * state[s * lanes + l]. One source serves two devices - the host, where
+ * the system compiler builds a loop over the lanes, and CUDA, where nvcc
+ * builds one GPU thread per lane with the state copied to the device and
+ * back around each call.
+ *
+ * Example:
+ * @code
+ * std::vector<NativeKernel::Formula> formulas = {
+ *     {eval.compile("REVENUE - COGS"), 2, {0, 1}},   // state[2] = state[0] - state[1]
+ *     {eval.compile("GROSS * 0.25"),   3, {2}},      // state[3] = state[2] * 0.25
+ * };
+ * auto kernel = NativeKernel::build(formulas, 0, NativeKernelOptions{});
+ *
+ * double state[4] = {1000.0, 600.0, 0.0, 0.0};
+ * if (kernel->run(state) == 0) {
+ *     // state[3] == 100.0
+ * }
+ * @endcode
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiled_formula.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief How native kernels are built and where they are cached
+ */
+struct NativeKernelOptions {
+    bool enabled = false;       ///< Use native kernels where available (callers check this)
+    std::string cache_dir;      ///< Library cache, private to this user (empty: see NativeKernel::build())
+    std::string compiler = "c++";
+    /// Flags for building the shared library (FP contraction off keeps results
+    /// bit-identical with the interpreter)
+    std::string flags = "-O2 -fPIC -shared -ffp-contract=off";
+};
+
+/**
+ * @brief Where a lane kernel runs
+ */
+enum class LaneDevice {
+    HOST,   ///< System C++ compiler, lanes looped on the calling thread
+    CUDA    ///< nvcc, one GPU thread per lane (needs a CUDA device at load)
+};
+
+/**
+ * @brief How lane kernels are built (NativeKernel::build_lanes())
+ */
+struct LaneKernelOptions {
+    bool enabled = false;       ///< Use lane kernels where available (callers check this)
+    LaneDevice device = LaneDevice::HOST;
+    std::string cache_dir;      ///< Library cache, private to this user (empty: see NativeKernel::build())
+    std::string compiler = "c++";
+    std::string flags = "-O2 -fPIC -shared -ffp-contract=off";
+    std::string device_compiler = "nvcc";
+    /// No fused multiply-adds, as -ffp-contract=off on the host
+    std::string device_flags = "-O2 -shared -Xcompiler -fPIC -fmad=false";
+};
+
+/**
+ * @brief Loaded native kernel for a fixed list of formulas
+ *
+ * Semantics match FormulaEvaluator::evaluate() formula by formula, with two
+ * differences the caller handles:
+ * - Division by zero doesn't throw; run() returns the 1-based index of the
+ *   formula that hit it (re-run through the interpreter for the message)
+ * - Formulas with custom functions or TAX_COMPUTE aren't supported
+ *
+ * The kernel holds no mutable state, so one instance can be run from any
+ * number of threads (each with its own state array).
+ */
+class NativeKernel {
+public:
+    /**
+     * @brief One formula of the kernel
+     */
+    struct Formula {
+        std::shared_ptr<const CompiledFormula> compiled;
+        uint32_t output_slot = 0;               ///< State slot receiving the result
+        std::vector<uint32_t> variable_slots;   ///< State slot per CompiledFormula::variables() entry
+    };
+
+    /**
+     * @brief Generate kernel source
+     * @param formulas Formulas in evaluation order
+     * @param shared_count Number of shared subexpressions (MEMO_* operands)
+     * @param builtins Receives the function table the kernel expects at run()
+     * @return C++ source defining extern "C" finmodel_kernel()
+     * @throws std::invalid_argument if a formula can't be lowered
+     */
+    static std::string generate_source(
+        const std::vector<Formula>& formulas,
+        size_t shared_count,
+        std::vector<BuiltinFunction>& builtins
+    );
+
+    /**
+     * @brief Generate, compile (or fetch from the disk cache) and load a kernel
+     * @param formulas Formulas in evaluation order
+     * @param shared_count Number of shared subexpressions (MEMO_* operands)
+     * @param options Compiler and cache settings
+     * @return Loaded kernel
+     * @throws std::invalid_argument if a formula can't be lowered
+     * @throws std::runtime_error if compiling or loading fails, or if the
+     *         cache directory or library isn't private to this user
+     *
+     * Without a cache_dir, libraries are cached in $XDG_CACHE_HOME/finmodel/kernels,
+     * ~/.cache/finmodel/kernels or <temp>/finmodel_kernels_<uid>, created with
+     * mode 0700. Only libraries owned by this user and writable by nobody else
+     * are loaded. The compiler runs without a shell: compiler and flags are
+     * split at whitespace.
+     */
+    static std::shared_ptr<const NativeKernel> build(
+        const std::vector<Formula>& formulas,
+        size_t shared_count,
+        const NativeKernelOptions& options
+    );
+
+    /**
+     * @brief Generate lane kernel source
+     * @param formulas Formulas in evaluation order (slots as in generate_source())
+     * @param shared_count Number of shared subexpressions (MEMO_* operands)
+     * @param device Device the source is for
+     * @param builtins Receives the function table the kernel expects at run_lanes()
+     * @return C++ (HOST) or CUDA source defining extern "C" finmodel_lane_kernel()
+     * @throws std::invalid_argument if a formula can't be lowered (on CUDA,
+     *         also a built-in function that isn't inlined)
+     */
+    static std::string generate_lane_source(
+        const std::vector<Formula>& formulas,
+        size_t shared_count,
+        LaneDevice device,
+        std::vector<BuiltinFunction>& builtins
+    );
+
+    /**
+     * @brief Generate, compile (or fetch from the disk cache) and load a lane kernel
+     * @throws std::invalid_argument if a formula can't be lowered
+     * @throws std::runtime_error if compiling or loading fails, or no CUDA device is present
+     */
+    static std::shared_ptr<const NativeKernel> build_lanes(
+        const std::vector<Formula>& formulas,
+        size_t shared_count,
+        const LaneKernelOptions& options
+    );
+
+    /**
+     * @brief Run all formulas over a state array
+     * @param state State array (inputs filled in, outputs written)
+     * @return 0 on success, or the 1-based index of the formula that divided by zero
+     * @throws std::runtime_error if a built-in function throws
+     */
+    int run(double* state) const { return entry_(state, builtins_.data()); }
+
+    /**
+     * @brief Run a lane kernel over a structure-of-arrays state
+     * @param state slots × lanes values, slot-major
+     * @return 0 on success, the 1-based index of a formula that divided by
+     *         zero in some lane, or -1 if the device failed
+     */
+    int run_lanes(double* state, size_t slots, size_t lanes) const {
+        return lane_entry_(state, slots, lanes, builtins_.data());
+    }
+
+    /**
+     * @brief Path of the loaded shared library
+     */
+    const std::string& library_path() const { return library_path_; }
+
+private:
+    using EntryPoint = int (*)(double* state, const BuiltinFunction* builtins);
+    using LaneEntryPoint = int (*)(double* state, size_t slots, size_t lanes, const BuiltinFunction* builtins);
+
+    NativeKernel() = default;
+
+    std::shared_ptr<void> library_;             ///< dlopen() handle (closed on destruction)
+    EntryPoint entry_ = nullptr;
+    LaneEntryPoint lane_entry_ = nullptr;
+    std::vector<BuiltinFunction> builtins_;     ///< Function table passed to the kernel
+    std::string library_path_;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,94 @@
+/**
+ * @file numa_topology.h
+ * @brief NUMA nodes of the machine and pinning threads to them
+ *
+ * On a multi-socket server a thread reading memory of the other socket's
+ * node pays for every cache miss twice. Linux places a page on the node of
+ * the thread that first writes it, so a worker pinned to a node and
+ * allocating its own scratch and results keeps them local without any
+ * NUMA allocation API. NumaTopology reads the nodes and their CPUs from
+ * sysfs (no libnuma), spreads workers over them and pins threads.
+ *
+ * On machines without NUMA information (or outside Linux) the topology is
+ * one node holding every CPU, and pinning does nothing.
+ *
+ * Usage:
+ * @code
+ * const auto& numa = NumaTopology::system();
+ * auto placement = numa.place(threads);      // Node per worker
+ * // On worker w's thread
+ * numa.pin_current_thread(placement[w], w);
+ * @endcode
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief One NUMA node
+ */
+struct NumaNode {
+    int id = 0;                 ///< Kernel node number
+    std::vector<int> cpus;      ///< CPUs of the node, ascending
+};
+
+/**
+ * @brief NUMA nodes and their CPUs
+ */
+class NumaTopology {
+public:
+    /**
+     * @brief Topology of this machine (read once)
+     */
+    static const NumaTopology& system();
+
+    /**
+     * @brief Read a topology from a sysfs node directory
+     * @param node_root Directory holding node<N>/cpulist (e.g. /sys/devices/system/node)
+     * @return Nodes with CPUs; one node of every CPU if none can be read
+     */
+    static NumaTopology read(const std::string& node_root);
+
+    /**
+     * @brief Topology of given nodes (nodes without CPUs are dropped)
+     */
+    explicit NumaTopology(std::vector<NumaNode> nodes);
+
+    /**
+     * @brief Parse a kernel CPU list ("0-3,8,10-11")
+     * @throws std::invalid_argument on malformed input
+     */
+    static std::vector<int> parse_cpu_list(const std::string& list);
+
+    const std::vector<NumaNode>& nodes() const { return nodes_; }
+    size_t node_count() const { return nodes_.size(); }
+
+    /**
+     * @brief Node index (into nodes()) per worker
+     * @param workers Number of workers
+     *
+     * Workers fill the nodes in contiguous blocks in proportion to their
+     * CPUs, so neighbouring workers (which steal from each other first)
+     * share a node.
+     */
+    std::vector<size_t> place(size_t workers) const;
+
+    /**
+     * @brief Pin the calling thread to one CPU of a node
+     * @param node Node index (into nodes())
+     * @param slot Worker's position on the node (picks the CPU, wrapping around)
+     * @return False if pinning isn't supported or failed (the thread runs unpinned)
+     */
+    bool pin_current_thread(size_t node, size_t slot) const;
+
+private:
+    std::vector<NumaNode> nodes_;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,321 @@
+/**
+ * @file profiler.h
+ * @brief Hot-path timings of calculations: stages, line items, provider lookups
+ *
+ * A Profiler attached to a UnifiedEngine (set_profiler()) or PeriodRunner
+ * records how long each stage of a run takes (template load, driver load,
+ * calculate, validate, roll-forward, write), how often each line item is
+ * evaluated and for how long, and how provider lookups resolve. report()
+ * sorts line items by time, so template authors see their most expensive
+ * formulas first; trace_json() writes the stages in the Chrome trace event
+ * format (chrome://tracing, ui.perfetto.dev). With track_allocations() it
+ * also counts the heap allocations of every stage and line item (see
+ * AllocationTracker), to find the churn of the calculation loop. With
+ * track_hardware_counters() each stage also reads the CPU's performance
+ * counters (see HardwareCounters), reported as IPC and cache and branch
+ * misses per evaluated line item; line items aren't counted (one read()
+ * per evaluation would distort their times).
+ *
+ * Timers read the time-stamp counter (steady_clock where there is none),
+ * converted to seconds with a rate measured over the profiler's lifetime.
+ * Without a profiler attached a run pays one pointer test per timer; built
+ * with FINMODEL_PROFILING=0 the timers are compiled out.
+ *
+ * Usage:
+ * @code
+ * auto profiler = std::make_shared<Profiler>();
+ * profiler->track_allocations(true);
+ * profiler->track_hardware_counters(true);
+ * runner.set_profiler(profiler);
+ * runner.run_periods("E", 1, periods, opening, "TEMPLATE");
+ * std::cout << profiler->report(10);
+ * std::ofstream("trace.json") << profiler->trace_json();
+ * @endcode
+ */
+
+#pragma once
+#include "core/allocation_tracker.h"
+#include "core/hardware_counters.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+#ifndef FINMODEL_PROFILING
+#define FINMODEL_PROFILING 1
+#endif
+
+namespace finmodel {
+namespace core {
+
+/// False when built with FINMODEL_PROFILING=0: profiling branches fold away
+constexpr bool PROFILING_BUILT = FINMODEL_PROFILING != 0;
+
+/**
+ * @brief Stage, line item and lookup timings of calculations
+ *
+ * Stages and line items are recorded by one thread (the engine's); lookup
+ * counters may be bumped from parallel levels too.
+ */
+class Profiler {
+public:
+    /**
+     * @brief Stages of a period
+     */
+    enum class Stage : uint8_t {
+        TEMPLATE_LOAD,  ///< Template and calculation plan
+        DRIVER_LOAD,    ///< Drivers of a run (one query)
+        CALCULATE,      ///< Line items of a period
+        VALIDATE,       ///< Validation rules
+        ROLL_FORWARD,   ///< Closing balance sheet and prior values
+        WRITE           ///< Handing results to the writer
+    };
+    static constexpr size_t STAGE_COUNT = 6;
+
+    /**
+     * @brief Where a provider lookup (line item without formula) was answered
+     */
+    enum class Lookup : uint8_t {
+        DRIVER,         ///< Scenario drivers
+        STATEMENT,      ///< Calculated or opening statement values
+        OTHER,          ///< Any other provider
+        NOT_FOUND,      ///< No provider had it and the line item is 0 (counted as misses)
+        DATABASE        ///< [t-k] values queried from the database (counted as hits)
+    };
+    static constexpr size_t LOOKUP_COUNT = 5;
+
+    struct StageProfile {
+        Stage stage;
+        uint64_t count = 0;
+        double seconds = 0.0;
+        AllocationCounts allocated;     ///< While tracking allocations
+        HardwareCounts counters;        ///< While tracking hardware counters
+    };
+
+    struct LineItemProfile {
+        std::string code;
+        uint64_t evaluations = 0;
+        double seconds = 0.0;
+        AllocationCounts allocated;     ///< While tracking allocations
+    };
+
+    /**
+     * @brief Time, allocation and hardware counts of the calling thread at one point
+     */
+    struct Mark {
+        uint64_t ticks = 0;
+        AllocationCounts allocated;
+        HardwareCounts counters;        ///< stage_mark() only
+    };
+
+    struct LookupProfile {
+        Lookup source;
+        uint64_t hits = 0;        ///< Lookups this source answered
+        uint64_t misses = 0;      ///< Lookups it was asked and had no value for
+    };
+
+    /**
+     * @brief Start profiling
+     * @param max_trace_events Stage events kept for trace_json() (later ones are only counted)
+     */
+    explicit Profiler(size_t max_trace_events = 1 << 20);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /**
+     * @brief Current time-stamp counter reading
+     */
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    /**
+     * @brief Current ticks() and allocation counts
+     */
+    static Mark mark() { return {ticks(), AllocationTracker::thread_counts(), {}}; }
+
+    /**
+     * @brief mark() with the hardware counters (for stages)
+     */
+    static Mark stage_mark() {
+        return {ticks(), AllocationTracker::thread_counts(), HardwareCounters::thread_counts()};
+    }
+
+    static const char* stage_name(Stage stage);
+    static const char* lookup_name(Lookup source);
+
+    /**
+     * @brief Count heap allocations from now on (or stop)
+     *
+     * Enables the AllocationTracker while on; without allocator
+     * replacement built (FINMODEL_TRACK_ALLOCATIONS=0) counts stay 0.
+     */
+    void track_allocations(bool on);
+    bool tracks_allocations() const { return tracking_allocations_; }
+
+    /**
+     * @brief Read the hardware counters at stage boundaries from now on (or stop)
+     *
+     * Enables HardwareCounters while on; where perf_event_open is refused
+     * counts stay 0 and report() says why.
+     */
+    void track_hardware_counters(bool on);
+    bool tracks_hardware_counters() const { return tracking_counters_; }
+
+    /**
+     * @brief Record a stage that ran from begin to end (stage_mark())
+     */
+    void record_stage(Stage stage, const Mark& begin, const Mark& end);
+
+    /**
+     * @brief Id of a line item for record_line_item() (stable per profiler)
+     */
+    uint32_t line_item_id(const std::string& code);
+
+    /**
+     * @brief Record one evaluation of a line item
+     */
+    void record_line_item(uint32_t id, const Mark& begin, const Mark& end) {
+        auto& item = line_items_[id];
+        ++item.evaluations;
+        item.ticks += end.ticks - begin.ticks;
+        item.allocated += end.allocated - begin.allocated;
+    }
+
+    /**
+     * @brief Count a provider lookup (thread-safe)
+     */
+    void count_lookup(Lookup source, bool hit, uint64_t count = 1) {
+        auto& counter = lookups_[static_cast<size_t>(source)];
+        (hit ? counter.hits : counter.misses).fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stages in Stage order
+     */
+    std::vector<StageProfile> stages() const;
+
+    /**
+     * @brief Line items, most time first
+     */
+    std::vector<LineItemProfile> line_items() const;
+
+    /**
+     * @brief Evaluations of all line items (the per-item denominator of counters)
+     */
+    uint64_t line_item_evaluations() const;
+
+    /**
+     * @brief Lookups in Lookup order
+     */
+    std::vector<LookupProfile> lookups() const;
+
+    /**
+     * @brief Text report: stages, the top line items by time, lookups (and allocations and counters if tracked)
+     * @param top_line_items Line items listed (0: all)
+     */
+    std::string report(size_t top_line_items = 20) const;
+
+    /**
+     * @brief Stages as Chrome trace events ({"traceEvents": [...]}, times in microseconds)
+     */
+    std::string trace_json() const;
+
+    /**
+     * @brief Forget everything recorded (line item ids stay valid)
+     */
+    void clear();
+
+    /**
+     * @brief Seconds per tick, measured since construction
+     */
+    double seconds_per_tick() const;
+
+private:
+    struct StageTotals {
+        uint64_t count = 0;
+        uint64_t ticks = 0;
+        AllocationCounts allocated;
+        HardwareCounts counters;
+    };
+    struct LineItemTotals {
+        uint64_t evaluations = 0;
+        uint64_t ticks = 0;
+        AllocationCounts allocated;
+    };
+    struct LookupCounters {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+    struct TraceEvent {
+        Stage stage;
+        uint64_t begin;
+        uint64_t end;
+        AllocationCounts allocated;
+        HardwareCounts counters;
+    };
+
+    uint64_t start_ticks_;
+    std::chrono::steady_clock::time_point start_time_;
+    size_t max_trace_events_;
+    bool tracking_allocations_ = false;
+    bool tracking_counters_ = false;
+
+    std::array<StageTotals, STAGE_COUNT> stages_{};
+    std::vector<TraceEvent> trace_;
+    std::unordered_map<std::string, uint32_t> line_item_ids_;
+    std::vector<std::string> line_item_codes_;
+    std::vector<LineItemTotals> line_items_;
+    std::array<LookupCounters, LOOKUP_COUNT> lookups_;
+};
+
+/**
+ * @brief Records a stage from construction to destruction (nothing without a profiler)
+ */
+class ScopedStageTimer {
+public:
+    ScopedStageTimer(Profiler* profiler, Profiler::Stage stage)
+        : profiler_(profiler), stage_(stage), begin_(profiler ? Profiler::stage_mark() : Profiler::Mark{}) {}
+
+    ~ScopedStageTimer() {
+        if (profiler_) {
+            profiler_->record_stage(stage_, begin_, Profiler::stage_mark());
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    Profiler* profiler_;
+    Profiler::Stage stage_;
+    Profiler::Mark begin_;
+};
+
+} // namespace core
+} // namespace finmodel
+
+#define FINMODEL_PROFILE_CONCAT_(a, b) a##b
+#define FINMODEL_PROFILE_CONCAT(a, b) FINMODEL_PROFILE_CONCAT_(a, b)
+
+/// Time the rest of the enclosing scope as a Profiler::Stage (profiler may be null)
+#if FINMODEL_PROFILING
+#define FINMODEL_PROFILE_STAGE(profiler, stage) \
+    ::finmodel::core::ScopedStageTimer FINMODEL_PROFILE_CONCAT(finmodel_stage_timer_, __LINE__)((profiler), (stage))
+#else
+#define FINMODEL_PROFILE_STAGE(profiler, stage) ((void)0)
+#endif
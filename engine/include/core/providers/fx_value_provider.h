@@ -11,10 +11,11 @@
 #define FINMODEL_FX_VALUE_PROVIDER_H
 
 #include "core/ivalue_provider.h"
+#include "core/symbol_table.h"
 #include "database/idatabase.h"
-#include <map>
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 namespace finmodel {
 namespace core {
@@ -89,8 +90,8 @@ private:
     int period_id_;
     bool context_set_;
 
-    // Cache: "FX_USD_EUR_average" → 0.85
-    mutable std::map<std::string, double> rate_cache_;
+    // Cache: Symbol of "FX_USD_EUR" → 0.85 (hits don't parse the key)
+    mutable std::unordered_map<Symbol, double> rate_cache_;
 
     /**
      * @brief FX reference components
@@ -116,7 +117,7 @@ private:
     FXReference parse_fx_key(const std::string& key) const;
 
     /**
-     * @brief Load rate from database (or cache)
+     * @brief Load rate from database
      * @param from_currency From currency code (e.g., "USD")
      * @param to_currency To currency code (e.g., "EUR")
      * @param rate_type Rate type ("average", "closing", "opening")
@@ -128,19 +129,6 @@ private:
         const std::string& to_currency,
         const std::string& rate_type
     ) const;
-
-    /**
-     * @brief Build cache key
-     * @param from_currency From currency
-     * @param to_currency To currency
-     * @param rate_type Rate type
-     * @return Cache key (e.g., "FX_USD_EUR_average")
-     */
-    std::string make_cache_key(
-        const std::string& from_currency,
-        const std::string& to_currency,
-        const std::string& rate_type
-    ) const;
 };
 
 } // namespace core
@@ -0,0 +1,91 @@
+/**
+ * @file quantile_sketch.h
+ * @brief Streaming quantiles with a relative error bound, mergeable across threads
+ *
+ * Monte Carlo runs summarise millions of simulated values (annual losses,
+ * line items per period) without keeping them. A QuantileSketch counts
+ * values in logarithmic buckets: bucket k holds magnitudes in
+ * (γ^(k-1), γ^k], γ = (1 + α) / (1 - α), so every quantile is exact within
+ * relative accuracy α, and memory grows with the range of magnitudes
+ * rather than the number of values.
+ *
+ * Bucket counts are integers: merging per-thread sketches gives the same
+ * sketch for any split of the values.
+ *
+ * Example:
+ * @code
+ * QuantileSketch sketch(0.01);
+ * for (double loss : losses) sketch.add(loss);
+ * double var_99 = sketch.quantile(0.99);
+ * double tvar_99 = sketch.top_mean(losses.size() / 100);
+ * @endcode
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Log-bucket histogram of values (negative, zero and positive)
+ */
+class QuantileSketch {
+public:
+    /**
+     * @brief Empty sketch
+     * @throws std::invalid_argument unless relative_accuracy is in (0, 1)
+     */
+    explicit QuantileSketch(double relative_accuracy = 0.01);
+
+    /// Magnitudes below this count as zero (keeps rounding noise out of the buckets)
+    static constexpr double MIN_MAGNITUDE = 1e-9;
+
+    /// Add a value count times (NaN is ignored)
+    void add(double value, uint64_t count = 1);
+
+    /**
+     * @brief Add the values of another sketch
+     * @throws std::invalid_argument if its accuracy differs
+     */
+    void merge(const QuantileSketch& other);
+
+    uint64_t count() const { return negative_.total + zeros_ + positive_.total; }
+
+    /// Value at quantile q in [0, 1] (0 when empty)
+    double quantile(double q) const;
+
+    /// k-th largest value (1 = largest; 0 when out of range)
+    double top_value(uint64_t k) const;
+
+    /// Mean of the k largest values
+    double top_mean(uint64_t k) const;
+
+private:
+    // Counts of one sign's magnitudes, by bucket index
+    struct Store {
+        int offset = 0;                    // Bucket index of counts[0]
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+
+        void add(int index, uint64_t count);
+        void merge(const Store& other);
+    };
+
+    double gamma_;
+    double log_gamma_;
+    Store negative_;     // Magnitudes of negative values
+    Store positive_;
+    uint64_t zeros_ = 0;
+
+    double bucket_value(int index) const;
+
+    // Visit buckets from the largest value down: fn(value, count) returns false to stop
+    template <typename Fn>
+    void descending(Fn&& fn) const;
+};
+
+} // namespace core
+} // namespace finmodel
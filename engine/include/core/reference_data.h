@@ -0,0 +1,99 @@
+/**
+ * @file reference_data.h
+ * @brief Immutable FX rates and unit factors shared by engines, replaced as a whole
+ *
+ * Every UnifiedEngine used to load its own FXProvider and UnitConverter,
+ * so N parallel engines read fx_rate and unit_definition N times. A
+ * ReferenceDataStore loads them once into a ReferenceData snapshot that
+ * any number of engines on any threads read without locks: nothing in a
+ * snapshot changes after it is published.
+ *
+ * reload() loads a new snapshot and publishes it with one atomic store
+ * (read-copy-update): engines keep the snapshot they hold until their
+ * next scenario boundary (UnifiedEngine::refresh_reference_data()), and
+ * an old snapshot is freed when its last reader lets go.
+ *
+ * Usage:
+ * @code
+ * auto reference = std::make_shared<ReferenceDataStore>(db);
+ * PeriodRunner runner(db, reference);   // Scenario workers share it too
+ * ...
+ * reference->reload();                  // After new fx_rate rows: next scenarios see them
+ * @endcode
+ */
+
+#pragma once
+
+#include "core/unit_converter.h"
+#include "fx/fx_provider.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace finmodel {
+namespace database {
+    class IDatabase;
+}
+}
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief One published version of the reference data
+ */
+struct ReferenceData {
+    uint64_t version = 0;                     ///< 1 for the first snapshot, +1 per reload()
+    std::shared_ptr<const fx::FXProvider> fx;
+    std::shared_ptr<const UnitConverter> units;  ///< Converts currencies with fx
+};
+
+/**
+ * @brief Publishes ReferenceData snapshots loaded from one database
+ *
+ * current() is safe from any thread at any time; reload() calls are
+ * serialised with each other, never with readers.
+ */
+class ReferenceDataStore {
+public:
+    /**
+     * @brief Load the first snapshot
+     * @param db Connection the snapshots are loaded through (kept for reload())
+     * @param rate_type fx_rate.rate_type of the FX rates (empty: all rows)
+     * @throws DatabaseException if unit_definition or fx_rate can't be read
+     */
+    explicit ReferenceDataStore(std::shared_ptr<database::IDatabase> db, std::string rate_type = "");
+
+    ReferenceDataStore(const ReferenceDataStore&) = delete;
+    ReferenceDataStore& operator=(const ReferenceDataStore&) = delete;
+
+    /**
+     * @brief The latest snapshot (lock-free read of one atomic pointer)
+     */
+    std::shared_ptr<const ReferenceData> current() const { return current_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Version of the latest snapshot
+     */
+    uint64_t version() const { return current()->version; }
+
+    /**
+     * @brief Load fx_rate and unit_definition again and publish them as the next version
+     * @return The published snapshot
+     * @throws DatabaseException if loading fails (the current snapshot stays)
+     */
+    std::shared_ptr<const ReferenceData> reload();
+
+private:
+    std::shared_ptr<database::IDatabase> db_;
+    std::string rate_type_;
+    std::mutex reload_mutex_;   ///< Writers only
+    std::atomic<std::shared_ptr<const ReferenceData>> current_;
+
+    std::shared_ptr<const ReferenceData> load(uint64_t version) const;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -4,15 +4,29 @@
  *
  * Loads JSON-based P&L, BS, and CF templates from database
  * and provides structured access to line items, formulas, and validation rules.
+ *
+ * The JSON in statement_template.json_structure is the editable source of
+ * truth. save_to_database() also stores its compiled form in
+ * compiled_structure (migration 015_template_binary.sql): a versioned blob
+ * with the parsed line items, codes stored once, formula dependencies and
+ * the calculation order. load_from_database() uses the blob when it was
+ * compiled from the row's current JSON with this format version, so a load
+ * is a hash check and a copy instead of a JSON parse and a dependency
+ * graph; anything else (JSON edited in place, older rows, older schemas)
+ * parses the JSON as before.
  */
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
 #include <memory>
 #include <optional>
+#include <span>
+#include <unordered_map>
+#include "core/symbol_table.h"
 #include "types/common_types.h"
 
 namespace finmodel {
@@ -40,6 +54,7 @@ struct LineItem {
     bool is_computed;                           ///< True if calculated from formula
     std::vector<std::string> dependencies;      ///< List of line item codes this depends on
     SignConvention sign_convention;             ///< Sign convention (positive/negative/neutral)
+    Symbol symbol = NO_SYMBOL;                  ///< code in the global SymbolTable
 };
 
 /**
@@ -52,6 +67,54 @@ struct ValidationRule {
     std::string message;        ///< Error message to display
 };
 
+/**
+ * @brief How a template's circular references within a period are solved
+ *
+ * Off unless the template JSON has a "circular" object, e.g.
+ * {"circular": {"method": "anderson", "max_iterations": 50, "tolerance": 1e-10, "depth": 5}};
+ * a cycle is then a CircularBlock solved to its fixed point every period
+ * instead of an error.
+ */
+struct CircularPolicy {
+    enum class Method {
+        ANDERSON,   ///< Fixed-point iteration mixed over the last depth iterations
+        NEWTON      ///< Newton steps on the block's dual-number Jacobian
+    };
+
+    bool enabled = false;
+    Method method = Method::ANDERSON;
+    size_t max_iterations = 50;
+    double tolerance = 1e-10;   ///< Largest change of a value between iterations, relative to max(1, |value|)
+    size_t depth = 5;           ///< ANDERSON: iterations mixed (0: plain fixed-point iteration)
+};
+
+/**
+ * @brief Line items of the calculation order that depend on each other within a period
+ */
+struct CircularBlock {
+    size_t begin = 0;   ///< Index of the first one in the calculation order
+    size_t end = 0;     ///< One past the last one
+};
+
+/**
+ * @brief How a template's values relate to the length of a period
+ *
+ * Off unless the template JSON has a "time_scaling" object, e.g.
+ * {"time_scaling": {"basis_days": 365, "flow_drivers": ["REVENUE"], "stocks": ["CASH"], "rates": ["MARGIN"]}}.
+ * Flow drivers are then amounts per basis_days and read scaled by the
+ * period's days_in_period, so a schedule mixing months and years (see
+ * PeriodSetup::create_period_schedule()) keeps one driver input per
+ * year. stocks and rates tell orchestration::PeriodRollup how to combine
+ * periods; other line items are flows and summed.
+ */
+struct TimeScaling {
+    bool enabled = false;
+    double basis_days = 365.0;                 ///< Period length a flow driver's value is given for
+    std::vector<std::string> flow_drivers;     ///< Driver codes scaled by days_in_period / basis_days
+    std::vector<std::string> stocks;           ///< Line items at a point in time: the last period's value
+    std::vector<std::string> rates;            ///< Line items averaged over the days of the periods
+};
+
 /**
  * @brief Statement template loaded from database
  *
@@ -96,6 +159,70 @@ public:
         const std::string& json_content
     );
 
+    /// Layout version of to_binary() blobs; blobs of another version are ignored
+    static constexpr uint32_t BINARY_FORMAT_VERSION = 1;
+
+    /**
+     * @brief Load template from its compiled form
+     * @param data Blob from to_binary()
+     * @param json_content JSON the blob must have been compiled from
+     * @return Same template as load_from_json(json_content) with its
+     *         calculation order computed (unless it has a circular
+     *         dependency), or nullptr if the blob is damaged, of another
+     *         format version or compiled from other JSON
+     */
+    static std::unique_ptr<StatementTemplate> load_from_binary(
+        std::span<const std::uint8_t> data,
+        const std::string& json_content
+    );
+
+    /**
+     * @brief Compile template JSON for load_from_binary()
+     * @param json_content Complete JSON template definition
+     * @return Blob holding the parsed template and its calculation order
+     * @throws std::runtime_error on JSON parsing errors
+     */
+    static std::vector<std::uint8_t> to_binary(const std::string& json_content);
+
+    /**
+     * @brief Compiled form of to_json() (what save_to_database() stores)
+     */
+    std::vector<std::uint8_t> to_binary() const { return to_binary(to_json()); }
+
+    /**
+     * @brief Load template through the process-wide template cache
+     * @param db Database connection
+     * @param template_code Template code (e.g., "CORP_PL_001")
+     * @return Shared immutable template, or nullptr if not found
+     * @throws DatabaseException on database errors
+     * @throws std::runtime_error on JSON parsing errors
+     *
+     * The first call for a (database, code) pair runs load_from_database()
+     * and compute_calculation_order(); later calls hand out the same
+     * instance until save_to_database() or invalidate_cache() drops it.
+     * Cached templates are never modified, so they can be shared between
+     * threads. A template whose calculation order fails (circular
+     * dependency) is returned uncached, so compute_calculation_order()
+     * reports the error to the caller.
+     *
+     * Use load_from_database() for a private copy to edit.
+     */
+    static std::shared_ptr<const StatementTemplate> load_cached(
+        const std::shared_ptr<finmodel::database::IDatabase>& db,
+        const std::string& template_code
+    );
+
+    /**
+     * @brief Drop cached templates with this code (all databases)
+     * @param template_code Template code
+     */
+    static void invalidate_cache(const std::string& template_code);
+
+    /**
+     * @brief Drop all cached templates
+     */
+    static void clear_cache();
+
     /**
      * @brief Serialize template to JSON string
      * @return JSON representation of template
@@ -106,6 +233,9 @@ public:
      * @brief Save template to database
      * @param db Database connection
      * @throws std::runtime_error on database errors
+     *
+     * Stores to_json() and, where the schema has the column, its compiled
+     * form. Invalidates load_cached() entries for this template code.
      */
     void save_to_database(finmodel::database::IDatabase* db);
 
@@ -116,6 +246,37 @@ public:
      */
     std::unique_ptr<StatementTemplate> clone(const std::string& new_code) const;
 
+    /**
+     * @brief Copy this template with some formulas replaced (in memory only)
+     * @param new_code Code of the copy
+     * @param formulas Line item code → new formula; codes not in the template are ignored
+     * @return Copy with its calculation order computed
+     * @throws std::runtime_error if the new formulas create a circular dependency
+     *
+     * For overlays such as management actions: a memberwise copy (no JSON
+     * round trip) whose unpatched formulas keep their extracted dependencies.
+     */
+    std::unique_ptr<StatementTemplate> with_formulas(
+        const std::string& new_code,
+        const std::map<std::string, std::string>& formulas
+    ) const;
+
+    /**
+     * @brief Copy this template with only the line items some outputs need (in memory only)
+     * @param outputs Line item codes to keep with everything they depend on;
+     *        codes not in the template are ignored
+     * @return Copy (same code) with its calculation order computed
+     * @throws std::invalid_argument if none of the outputs is a line item
+     *
+     * Keeps the transitive dependencies of the outputs, including
+     * time-shifted ones ("X[t-1]"): those are calculated every period for
+     * the roll-forward into the next one. Declared dependencies count as
+     * well. Line items nothing requested depends on are dropped, so the
+     * plan built from the copy doesn't calculate them; validation rules
+     * over dropped line items are skipped (see ValidationRuleEngine).
+     */
+    std::unique_ptr<StatementTemplate> with_outputs(const std::vector<std::string>& outputs) const;
+
     /**
      * @brief Get template code
      */
@@ -158,6 +319,12 @@ public:
      */
     const LineItem* get_line_item(const std::string& code) const;
 
+    /**
+     * @brief Get line item by Symbol of its code
+     * @return Pointer to line item, or nullptr if not found
+     */
+    const LineItem* get_line_item(Symbol symbol) const;
+
     /**
      * @brief Update formula for a line item (for template transformations)
      * @param code Line item code
@@ -187,7 +354,8 @@ public:
      * builds a dependency graph, performs topological sort, and updates the
      * calculation_order_ field.
      *
-     * @throws std::runtime_error if circular dependency detected
+     * @throws std::runtime_error if circular dependency detected (unless
+     *         the CircularPolicy allows it: see get_circular_blocks())
      *
      * Example:
      * @code
@@ -196,8 +364,62 @@ public:
      * auto order = tmpl->get_calculation_order();
      * // Result: Line items ordered so dependencies are calculated first
      * @endcode
+     *
+     * Memoized: formula dependencies are extracted once per formula, and
+     * the resulting order is shared process-wide by every template with the
+     * same code and content_hash() (templates are re-loaded every period, so
+     * that's the cache that saves the per-period DAG rebuild). Calling it
+     * again on an unchanged template is a no-op.
+     *
+     * Const because the order is derived from the formulas; on a template
+     * from load_cached() it is already computed and only reads.
+     */
+    void compute_calculation_order() const;
+
+    /**
+     * @brief Circular blocks of the calculation order, in order (empty without cycles)
+     *
+     * Only valid after compute_calculation_order(). A block is a strongly
+     * connected component of the dependency graph (or one line item
+     * reading itself), ordered so that few of its line items read a later
+     * one of the block.
+     */
+    const std::vector<CircularBlock>& get_circular_blocks() const { return circular_blocks_; }
+
+    /**
+     * @brief How circular references are solved (disabled: they are an error)
      */
-    void compute_calculation_order();
+    const CircularPolicy& get_circular_policy() const { return circular_; }
+
+    /**
+     * @brief Allow or disallow circular references
+     * @throws std::invalid_argument for max_iterations 0 or a tolerance not above 0
+     * @throws std::runtime_error if the policy is disabled and the formulas are circular
+     */
+    void set_circular_policy(const CircularPolicy& policy);
+
+    /**
+     * @brief Period-length scaling of flow drivers (disabled: driver values are used as they are)
+     */
+    const TimeScaling& get_time_scaling() const { return time_scaling_; }
+
+    /**
+     * @brief Hash of the line item codes and formulas (and the circular and time scaling policies)
+     *
+     * Changes whenever a formula changes, so callers can key caches derived
+     * from the formulas on (template code, content_hash()).
+     */
+    size_t content_hash() const { return content_hash_; }
+
+    /**
+     * @brief Get dependencies extracted from a line item's formula
+     * @param code Line item code
+     * @return FormulaEvaluator::extract_dependencies() result ("[t-1]"
+     *         suffix for time-shifted references), empty without a formula
+     *
+     * Only valid after compute_calculation_order().
+     */
+    const std::vector<std::string>& get_formula_dependencies(const std::string& code) const;
 
     /**
      * @brief Get validation rules
@@ -237,17 +459,29 @@ private:
 
     // Template structure
     std::vector<LineItem> line_items_;
-    std::map<std::string, size_t> line_item_index_;  ///< code -> index in line_items_
-    std::vector<std::string> calculation_order_;
+    std::unordered_map<Symbol, size_t> line_item_index_;  ///< code -> index in line_items_
+    mutable std::vector<std::string> calculation_order_;
+    mutable std::vector<CircularBlock> circular_blocks_;
+    CircularPolicy circular_;
+    TimeScaling time_scaling_;
     std::vector<ValidationRule> validation_rules_;
     std::vector<std::string> denormalized_columns_;
 
+    // Memoized calculation order (see compute_calculation_order())
+    size_t content_hash_ = 0;
+    mutable bool order_valid_ = false;                          ///< calculation_order_ matches the formulas
+    mutable std::vector<std::vector<std::string>> formula_deps_; ///< Per line item, parallel to line_items_
+    mutable std::vector<uint8_t> formula_deps_valid_;                  ///< formula_deps_[i] extracted from current formula
+
     // Metadata flags
     bool supports_consolidation_ = false;
     std::string default_frequency_;
 
     // Internal JSON parsing
     void parse_json(const std::string& json_content);
+
+    // Recompute content_hash_ after formulas change
+    void update_content_hash();
 };
 
 } // namespace core
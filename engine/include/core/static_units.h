@@ -0,0 +1,162 @@
+/**
+ * @file static_units.h
+ * @brief Built-in units with conversion factors known at compile time
+ *
+ * Carbon, mass, energy, volume and distance units relate by fixed factors
+ * (1 MWh = 1000 kWh, whatever the database says the base unit is). Each
+ * built-in unit is a tag type carrying its dimension and its factor to the
+ * dimension's reference unit, so code that knows both units converts with
+ * one constant multiply:
+ *
+ *     double t = units::convert<units::kgCO2e, units::tCO2e>(500.0);   // 0.5
+ *
+ * Converting between dimensions doesn't compile. BUILTIN_UNITS lists the
+ * same units by code: UnitConverter takes the exact factor of a built-in
+ * unit row (instead of its rounded static_conversion_factor), and
+ * DriverValueProvider folds static factors into the driver block as the
+ * values are gathered. Currencies aren't built in: their rates vary by
+ * period and go through FXProvider.
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace finmodel {
+namespace core {
+namespace units {
+
+/**
+ * @brief What a built-in unit measures (units convert only within one)
+ */
+enum class Dimension : uint8_t {
+    CARBON,     ///< Reference: tCO2e
+    MASS,       ///< Reference: kg
+    ENERGY,     ///< Reference: kWh
+    VOLUME,     ///< Reference: L
+    DISTANCE    ///< Reference: km
+};
+
+/**
+ * @brief Tag of a built-in unit: value × factor = value in the reference unit
+ */
+template <Dimension D, double Factor>
+struct StaticUnit {
+    static constexpr Dimension dimension = D;
+    static constexpr double factor = Factor;
+};
+
+#define FINMODEL_STATIC_UNIT(NAME, CODE, DIMENSION, FACTOR)     \
+    struct NAME : StaticUnit<Dimension::DIMENSION, FACTOR> {  \
+        static constexpr std::string_view code = CODE;        \
+    }
+
+FINMODEL_STATIC_UNIT(tCO2e, "tCO2e", CARBON, 1.0);
+FINMODEL_STATIC_UNIT(kgCO2e, "kgCO2e", CARBON, 1e-3);
+FINMODEL_STATIC_UNIT(MtCO2e, "MtCO2e", CARBON, 1e6);
+FINMODEL_STATIC_UNIT(GtCO2e, "GtCO2e", CARBON, 1e9);
+FINMODEL_STATIC_UNIT(lbCO2e, "lbCO2e", CARBON, 0.45359237e-3);
+
+FINMODEL_STATIC_UNIT(kg, "kg", MASS, 1.0);
+FINMODEL_STATIC_UNIT(g, "g", MASS, 1e-3);
+FINMODEL_STATIC_UNIT(t, "t", MASS, 1e3);
+FINMODEL_STATIC_UNIT(lb, "lb", MASS, 0.45359237);
+FINMODEL_STATIC_UNIT(oz, "oz", MASS, 0.45359237 / 16.0);
+
+FINMODEL_STATIC_UNIT(kWh, "kWh", ENERGY, 1.0);
+FINMODEL_STATIC_UNIT(MWh, "MWh", ENERGY, 1e3);
+FINMODEL_STATIC_UNIT(GWh, "GWh", ENERGY, 1e6);
+FINMODEL_STATIC_UNIT(TWh, "TWh", ENERGY, 1e9);
+FINMODEL_STATIC_UNIT(J, "J", ENERGY, 1.0 / 3.6e6);
+FINMODEL_STATIC_UNIT(MJ, "MJ", ENERGY, 1.0 / 3.6);
+FINMODEL_STATIC_UNIT(GJ, "GJ", ENERGY, 1e3 / 3.6);
+FINMODEL_STATIC_UNIT(BTU, "BTU", ENERGY, 1055.05585262 / 3.6e6);
+
+FINMODEL_STATIC_UNIT(L, "L", VOLUME, 1.0);
+FINMODEL_STATIC_UNIT(mL, "mL", VOLUME, 1e-3);
+FINMODEL_STATIC_UNIT(m3, "m3", VOLUME, 1e3);
+FINMODEL_STATIC_UNIT(gal, "gal", VOLUME, 3.785411784);
+FINMODEL_STATIC_UNIT(gal_uk, "gal_uk", VOLUME, 4.54609);
+
+FINMODEL_STATIC_UNIT(km, "km", DISTANCE, 1.0);
+FINMODEL_STATIC_UNIT(m, "m", DISTANCE, 1e-3);
+FINMODEL_STATIC_UNIT(mi, "mi", DISTANCE, 1.609344);
+FINMODEL_STATIC_UNIT(ft, "ft", DISTANCE, 0.3048e-3);
+FINMODEL_STATIC_UNIT(nmi, "nmi", DISTANCE, 1.852);
+
+#undef FINMODEL_STATIC_UNIT
+
+/**
+ * @brief Factor converting From to To (a constant expression)
+ */
+template <typename From, typename To>
+constexpr double factor() {
+    static_assert(From::dimension == To::dimension, "units of different dimensions don't convert");
+    return From::factor / To::factor;
+}
+
+/**
+ * @brief Value of From in To
+ */
+template <typename From, typename To>
+constexpr double convert(double value) {
+    return value * factor<From, To>();
+}
+
+/**
+ * @brief Built-in unit by code
+ */
+struct BuiltinUnit {
+    std::string_view code;
+    Dimension dimension;
+    double factor;   ///< To the dimension's reference unit
+};
+
+namespace detail {
+template <typename... Units>
+constexpr std::array<BuiltinUnit, sizeof...(Units)> table() {
+    return {BuiltinUnit{Units::code, Units::dimension, Units::factor}...};
+}
+} // namespace detail
+
+inline constexpr auto BUILTIN_UNITS = detail::table<
+    tCO2e, kgCO2e, MtCO2e, GtCO2e, lbCO2e,
+    kg, g, t, lb, oz,
+    kWh, MWh, GWh, TWh, J, MJ, GJ, BTU,
+    L, mL, m3, gal, gal_uk,
+    km, m, mi, ft, nmi>();
+
+/**
+ * @brief Built-in unit of a code (null if the code isn't built in)
+ */
+constexpr const BuiltinUnit* find_builtin(std::string_view code) {
+    for (const auto& unit : BUILTIN_UNITS) {
+        if (unit.code == code) {
+            return &unit;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Factor converting one built-in unit to another
+ * @return Nothing unless both are built in and of one dimension
+ */
+constexpr std::optional<double> builtin_factor(std::string_view from, std::string_view to) {
+    const BuiltinUnit* from_unit = find_builtin(from);
+    const BuiltinUnit* to_unit = find_builtin(to);
+    if (!from_unit || !to_unit || from_unit->dimension != to_unit->dimension) {
+        return std::nullopt;
+    }
+    return from_unit->factor / to_unit->factor;
+}
+
+static_assert(factor<MWh, kWh>() == 1000.0);
+static_assert(*builtin_factor("kg", "t") == 1e-3);
+static_assert(!builtin_factor("kg", "kWh"));
+
+} // namespace units
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,78 @@
+/**
+ * @file streaming_statistics.h
+ * @brief Moments and quantiles of a stream of values, mergeable across threads
+ *
+ * Keeps count, the sum and the sum of squares of the values (ExactSum, so
+ * without rounding error), the range and a QuantileSketch - constant
+ * memory however many values are added. Every part is exact or an integer
+ * count, so the statistics are bit for bit the same for any order of the
+ * values and any split over batches and merged threads.
+ *
+ * Example:
+ * @code
+ * StreamingStatistics stats(0.01);
+ * for (double cash : values) stats.add(cash);
+ * other_thread_stats.merge(stats);
+ * double p95 = other_thread_stats.quantile(0.95);
+ * @endcode
+ */
+
+#pragma once
+#include "core/exact_sum.h"
+#include "core/quantile_sketch.h"
+#include <cstddef>
+#include <limits>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Count, mean, variance, range and quantiles of the values added
+ *
+ * NaN values are ignored.
+ */
+struct StreamingStatistics {
+    size_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    QuantileSketch sketch;
+
+    /**
+     * @throws std::invalid_argument unless relative_accuracy is in (0, 1)
+     */
+    explicit StreamingStatistics(double relative_accuracy = 0.01) : sketch(relative_accuracy) {}
+
+    void add(double value);
+
+    /// Add a batch of values
+    void add(const double* values, size_t size);
+
+    /**
+     * @brief Add the values of another accumulator
+     * @throws std::invalid_argument if its sketch accuracy differs
+     */
+    void merge(const StreamingStatistics& other);
+
+    /// Sum of the values, correctly rounded
+    double sum() const { return sum_.value(); }
+    double mean() const { return count > 0 ? sum_.value() / static_cast<double>(count) : 0.0; }
+
+    /**
+     * @brief Sum of squared deviations from the mean
+     *
+     * n · Σx² - (Σx)² is formed exactly and rounded once, so there is no
+     * cancellation error either.
+     */
+    double m2() const;
+
+    double variance() const { return count > 1 ? m2() / static_cast<double>(count - 1) : 0.0; }
+    double stddev() const;
+    double quantile(double q) const { return sketch.quantile(q); }
+
+private:
+    ExactSum sum_;
+    ExactSum squares_;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,102 @@
+/**
+ * @file symbol_table.h
+ * @brief Process-wide code → 32-bit symbol interning
+ *
+ * Line item, driver and currency codes are the same few thousand strings
+ * in every template, provider and result of a process. The symbol table
+ * gives each distinct code one Symbol, so hot lookups hash and compare a
+ * uint32_t instead of a string and keep one copy of the text. Codes are
+ * turned back into strings (name()) only where they leave the engine:
+ * reports, JSON, the database, error messages.
+ *
+ * Unlike EntityDictionary, which is per run and loaded from the entity
+ * table, symbols are global: a Symbol means the same code in every
+ * template and thread, for the life of the process.
+ *
+ * Usage:
+ * @code
+ * Symbol revenue = SymbolTable::global().intern("REVENUE");
+ * const std::string& code = SymbolTable::global().name(revenue);  // "REVENUE"
+ * @endcode
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace finmodel {
+namespace core {
+
+/// Interned code (dense, assigned in first-intern order from 0)
+using Symbol = uint32_t;
+
+/// Returned by find() for codes never interned
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+/**
+ * @brief Thread-safe interning of codes to dense Symbols
+ *
+ * intern() and find() take a lock (shared for codes already known);
+ * name() doesn't: names live in fixed chunks that never move, so a
+ * Symbol's name may be read while other threads intern.
+ */
+class SymbolTable {
+public:
+    SymbolTable();
+    ~SymbolTable();
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /**
+     * @brief The process-wide table used by templates, results and providers
+     */
+    static SymbolTable& global();
+
+    /**
+     * @brief Get the Symbol of a code, assigning the next one to new codes
+     * @throws std::length_error when the table is full
+     */
+    Symbol intern(std::string_view code);
+
+    /**
+     * @brief Get the Symbol of a code
+     * @return Symbol, or NO_SYMBOL if the code was never interned
+     */
+    Symbol find(std::string_view code) const;
+
+    /**
+     * @brief Code of a Symbol (reference valid for the table's lifetime)
+     */
+    const std::string& name(Symbol symbol) const {
+        return chunks_[symbol >> CHUNK_BITS][symbol & (CHUNK_SIZE - 1)];
+    }
+
+    /**
+     * @brief Number of Symbols assigned
+     */
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr uint32_t CHUNK_BITS = 12;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;   ///< Names per chunk
+    static constexpr uint32_t MAX_CHUNKS = 1u << 14;           ///< 67M symbols
+
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view code) const { return std::hash<std::string_view>{}(code); }
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string_view, Symbol, Hash, std::equal_to<>> index_;  ///< Views into chunks_
+    std::unique_ptr<std::unique_ptr<std::string[]>[]> chunks_;
+    std::atomic<size_t> size_{0};
+};
+
+} // namespace core
+} // namespace finmodel
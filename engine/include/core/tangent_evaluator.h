@@ -0,0 +1,111 @@
+/**
+ * @file tangent_evaluator.h
+ * @brief Forward-mode derivatives of compiled formulas (dual numbers)
+ *
+ * Sensitivities of a model to its drivers are usually found by bumping each
+ * driver and rerunning: N drivers cost N + 1 runs. TangentEvaluator runs a
+ * CompiledFormula once on dual numbers instead - every stack slot holds a
+ * value and its tangent, the derivative by each of several drivers at once
+ * (one direction per entry of a LaneArray, so each instruction is one Eigen
+ * array expression over the directions).
+ *
+ * Functions that aren't smooth use a one-sided derivative:
+ * - IF / && / ||  → tangent of the branch the value took (conditions have none)
+ * - MIN / MAX     → tangent of the argument returned (the first one on a tie)
+ * - ABS, CLAMP    → likewise; ABS(0) has tangent 0
+ * - ROUND, comparisons → 0
+ * - TAX_COMPUTE, custom and registered functions without a derivative →
+ *   slope of the function just right of the argument (the marginal rate of
+ *   the bracket the income is in)
+ *
+ * Example:
+ * @code
+ * auto compiled = eval.compile("REVENUE * (1 - TAX_RATE)");
+ *
+ * TangentEvaluator tangents(2);   // d/dREVENUE, d/dTAX_RATE
+ * LaneArray d(2);
+ * double value = tangents.evaluate(*compiled,
+ *     [&](const VariableRef& var, uint32_t, double& v, LaneArray& t) {
+ *         v = inputs.at(var.code);
+ *         t.setZero();
+ *         t[var.code == "REVENUE" ? 0 : 1] = 1.0;
+ *     }, d);
+ * // d = {1 - TAX_RATE, -REVENUE}
+ * @endcode
+ */
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "compiled_formula.h"
+#include "formula_evaluator.h"
+#include "lane_evaluator.h"
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Dual-number interpreter for CompiledFormula
+ *
+ * Values match FormulaEvaluator::evaluate() (same jumps, same errors).
+ * Shared subexpressions are evaluated in place.
+ *
+ * Holds a reusable scratch stack, so one instance must not be shared
+ * between threads.
+ */
+class TangentEvaluator {
+public:
+    /**
+     * @brief Loads the value and tangent of a variable
+     * @param var Variable reference (code and time offset)
+     * @param var_index Index into CompiledFormula::variables()
+     * @param value Output: value
+     * @param tangent Output: derivative by each direction, already sized to directions()
+     */
+    using Loader = std::function<void(const VariableRef& var, uint32_t var_index, double& value, LaneArray& tangent)>;
+
+    /**
+     * @param directions Number of derivatives carried per value
+     * @throws std::invalid_argument if directions is 0
+     */
+    explicit TangentEvaluator(size_t directions);
+
+    size_t directions() const { return directions_; }
+
+    /**
+     * @brief Evaluate a compiled formula and its derivatives
+     * @param compiled Compiled formula
+     * @param load Loader for variable values and tangents
+     * @param tangent Output: derivative of the result by each direction
+     * @param custom_functions Optional scalar custom function handler
+     * @return Value of the formula
+     * @throws std::runtime_error on evaluation errors
+     */
+    double evaluate(
+        const CompiledFormula& compiled,
+        const Loader& load,
+        LaneArray& tangent,
+        const FormulaEvaluator::CustomFunctionHandler& custom_functions = nullptr
+    );
+
+private:
+    /**
+     * @brief Call a function on stack slots [base, base + args) and leave the result at base
+     */
+    void call(const FunctionCall& call, size_t base, const FormulaEvaluator::CustomFunctionHandler& custom_functions);
+
+    /**
+     * @brief Tangent of a scalar function from one-sided differences by each argument
+     */
+    template <typename Function>
+    void differentiate(Function&& function, size_t base, uint32_t args, double value);
+
+    size_t directions_;
+    std::vector<double> values_;       ///< Scratch value stack
+    std::vector<LaneArray> tangents_;  ///< Scratch tangent stack (parallel to values_)
+    std::vector<double> scalar_args_;  ///< Scratch arguments for scalar calls
+};
+
+} // namespace core
+} // namespace finmodel
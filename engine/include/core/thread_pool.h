@@ -0,0 +1,97 @@
+/**
+ * @file thread_pool.h
+ * @brief Fixed-size worker pool for data-parallel loops
+ *
+ * Calculations that fan out over many independent items (line items of
+ * one topological level, scenarios of a run) use a ThreadPool instead of
+ * spawning threads per call. The pool runs one loop at a time; the
+ * calling thread works on it too.
+ *
+ * Example:
+ * @code
+ * ThreadPool pool(4);
+ * std::vector<double> out(items.size());
+ * pool.parallel_for(items.size(), [&](size_t begin, size_t end, size_t worker) {
+ *     for (size_t i = begin; i < end; ++i) {
+ *         out[i] = evaluate(items[i], scratch[worker]);
+ *     }
+ * });
+ * @endcode
+ */
+
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Fixed set of worker threads sharing parallel_for() loops
+ *
+ * parallel_for() may be called from one thread at a time (it is not
+ * reentrant); loop bodies must not call back into the same pool.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Loop body over [begin, end) run by one worker
+     * @param worker Worker index in [0, size()) (stable per thread, for per-worker scratch)
+     */
+    using RangeFunction = std::function<void(size_t begin, size_t end, size_t worker)>;
+
+    /**
+     * @brief Start worker threads
+     * @param threads Total threads including the caller (0: hardware concurrency)
+     */
+    explicit ThreadPool(size_t threads = 0);
+
+    /**
+     * @brief Stop and join worker threads
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Number of threads working on a loop (workers plus the caller)
+     */
+    size_t size() const { return workers_.size() + 1; }
+
+    /**
+     * @brief Run fn over [0, count) in chunks, blocking until all are done
+     * @param count Number of items
+     * @param fn Loop body
+     * @param grain Minimum items per chunk
+     * @throws The first exception thrown by fn (after all chunks finished)
+     */
+    void parallel_for(size_t count, const RangeFunction& fn, size_t grain = 1);
+
+private:
+    void worker_loop(size_t worker);
+    void run_chunks(size_t worker);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+
+    // Current loop (guarded by mutex_)
+    const RangeFunction* fn_ = nullptr;
+    size_t count_ = 0;
+    size_t chunk_ = 1;
+    size_t next_ = 0;           ///< First item not handed out yet
+    size_t busy_ = 0;           ///< Workers inside the current loop
+    size_t generation_ = 0;     ///< Bumped for every loop
+    std::exception_ptr error_;
+    bool stopping_ = false;
+};
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,137 @@
+/**
+ * @file time_series.h
+ * @brief Trailing windows and horizon measures over a series of periods
+ *
+ * A RollingWindow keeps the sum of the last n values of a series: adding a
+ * period adds its value and drops the one that left the window, so each
+ * period costs the same however long the window is (a formula with
+ * X[t-1] + ... + X[t-n] reads n values every period). npv() and irr()
+ * discount a whole series at once.
+ *
+ * Example:
+ * @code
+ * RollingWindow trailing(4);
+ * for (PeriodID p = 1; p <= 12; ++p) {
+ *     trailing.push(p, revenue[p]);
+ * }
+ * double ltm = trailing.sum();                            // Periods 9-12
+ * double value = npv(0.08, cash_flows.data(), cash_flows.size());
+ * @endcode
+ */
+
+#pragma once
+#include "types/common_types.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+/**
+ * @brief Sum and count of the last length() values of consecutive periods
+ *
+ * NaN values are periods without a value: they take a place in the window
+ * but aren't summed or counted. The sum is recalculated from the window
+ * each time it wraps around, so rounding doesn't build up over long runs.
+ */
+class RollingWindow {
+public:
+    /**
+     * @throws std::invalid_argument if length is 0
+     */
+    explicit RollingWindow(size_t length);
+
+    /**
+     * @brief Add the value of the period after last_period()
+     *
+     * A period that doesn't follow last_period() starts the window over.
+     */
+    void push(PeriodID period, double value);
+
+    /**
+     * @brief Forget every period
+     */
+    void reset();
+
+    size_t length() const { return values_.size(); }
+
+    /// Periods pushed since the window was (re)started, at most length()
+    size_t size() const { return size_; }
+
+    /// The window holds length() periods ending at last_period()
+    bool full() const { return size_ == values_.size(); }
+
+    /// Last period pushed (meaningless if size() is 0)
+    PeriodID last_period() const { return last_period_; }
+
+    /// Sum of the values in the window (0 if none)
+    double sum() const { return sum_; }
+
+    /// Values in the window that aren't NaN
+    size_t count() const { return count_; }
+
+    /// Mean of the values in the window (0 if none)
+    double mean() const { return count_ ? sum_ / static_cast<double>(count_) : 0.0; }
+
+private:
+    std::vector<double> values_;   ///< Ring: values_[head_] is the oldest once full
+    size_t head_ = 0;
+    size_t size_ = 0;
+    size_t count_ = 0;
+    double sum_ = 0.0;
+    PeriodID last_period_ = 0;
+};
+
+/**
+ * @brief Trailing window reference of a formula: SUM_WINDOW(X, n) or AVG_WINDOW(X, n)
+ *
+ * The formula parser compiles a window into one variable whose code is
+ * key() (e.g. "SUM_WINDOW(REVENUE,4)"); the statement provider serves it
+ * from a RollingWindow of the line item.
+ */
+struct WindowRef {
+    static constexpr size_t MAX_PERIODS = 1000;
+
+    std::string code;       ///< Line item the window is over
+    size_t periods = 0;     ///< Periods t-1 .. t-periods
+    bool average = false;   ///< AVG_WINDOW (else SUM_WINDOW)
+
+    /// Variable code of the window
+    std::string key() const;
+
+    /**
+     * @brief Window of a variable code
+     * @return Nothing if the code isn't a key()
+     */
+    static std::optional<WindowRef> parse(std::string_view key);
+};
+
+/**
+ * @brief Net present value of a series (the first value is discounted one period)
+ * @param rate Discount rate per period (greater than -1)
+ * @param values Values of consecutive periods
+ * @param size Number of values
+ *
+ * Same convention as the spreadsheet NPV(): values[i] is discounted by
+ * (1 + rate)^(i + 1).
+ */
+double npv(double rate, const double* values, size_t size);
+
+/**
+ * @brief Internal rate of return of a series (the first value isn't discounted)
+ * @param values Values of consecutive periods, e.g. an investment then returns
+ * @param size Number of values
+ * @param guess Rate Newton's method starts from
+ * @return Rate per period at which the values discount to 0, or NaN if
+ *         there is none (the values don't change sign)
+ *
+ * Same convention as the spreadsheet IRR(). Newton's method, with bisection
+ * as the fallback when it doesn't converge.
+ */
+double irr(const double* values, size_t size, double guess = 0.1);
+
+} // namespace core
+} // namespace finmodel
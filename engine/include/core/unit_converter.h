@@ -10,14 +10,27 @@
  *   UnitConverter converter(db, fx_provider);
  *   double tonnes = converter.to_base_unit(500.0, "kgCO2e");  // Static
  *   double eur = converter.to_base_unit(100.0, "USD", 5);     // Time-varying (period 5)
+ *
+ * Built-in units (kgCO2e, MWh, ...; see static_units.h) convert with their
+ * exact compile-time factors; code that knows its units at compile time
+ * uses units::convert<From, To>() without a converter.
+ *
+ * Bulk callers resolve a unit once and reuse its factor:
+ *   int usd = converter.unit_id("USD");
+ *   std::vector<double> factors;
+ *   converter.base_factors(usd, period_ids, factors);  // One factor per period
  */
 
 #pragma once
 
+#include "types/common_types.h"
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 #include <optional>
+#include <vector>
+#include <cstdint>
 
 namespace finmodel {
 namespace database {
@@ -34,11 +47,15 @@ namespace core {
 /**
  * @brief Unit conversion with static and time-varying support
  *
- * Loads unit definitions from database at construction, caches static conversions
- * for fast lookup, and delegates time-varying conversions (currency) to FXProvider.
+ * Loads unit definitions from database at construction, interns unit codes
+ * to integer IDs and precomputes the static factor between every pair of
+ * units. Time-varying conversions (currency) are delegated to FXProvider.
  */
 class UnitConverter {
 public:
+    /// Returned by unit_id() for unknown unit codes
+    static constexpr int NO_UNIT = -1;
+
     /**
      * @brief Construct unit converter
      * @param db Database connection
@@ -46,7 +63,7 @@ public:
      */
     explicit UnitConverter(
         std::shared_ptr<finmodel::database::IDatabase> db,
-        std::shared_ptr<finmodel::fx::FXProvider> fx_provider = nullptr
+        std::shared_ptr<const finmodel::fx::FXProvider> fx_provider = nullptr
     );
 
     /**
@@ -126,7 +143,54 @@ public:
      */
     std::string get_category(const std::string& unit_code) const;
 
+    /**
+     * @brief Interned ID of a unit
+     * @param unit_code Unit code
+     * @return ID, or NO_UNIT if the unit is unknown
+     */
+    int unit_id(std::string_view unit_code) const;
+
+    /**
+     * @brief Factor converting a unit to its base unit (value × factor = base value)
+     * @param unit_id Unit ID from unit_id()
+     * @param period_id Period ID (required for time-varying units)
+     * @return Conversion factor
+     * @throws std::invalid_argument if unit unknown or period_id missing for time-varying
+     * @throws std::runtime_error if no FX rate is available
+     */
+    double base_factor(int unit_id, std::optional<int> period_id = std::nullopt) const;
+
+    /**
+     * @brief Factor of a unit that converts the same in every period
+     * @param unit_id Unit ID from unit_id()
+     * @return Factor to the base unit, or nothing for a time-varying, invalid or unknown unit
+     *
+     * Built-in units (units::BUILTIN_UNITS) carry their exact factor.
+     */
+    std::optional<double> static_factor(int unit_id) const;
+
+    /**
+     * @brief Base unit factors of one unit for several periods
+     * @param unit_id Unit ID from unit_id()
+     * @param period_ids Periods
+     * @param factors Output: factors[i] converts a value of period_ids[i]
+     * @throws Same as base_factor()
+     *
+     * Static units fill one constant; a time-varying unit yields its FX column.
+     */
+    void base_factors(int unit_id, const std::vector<int>& period_ids, std::vector<double>& factors) const;
+
 private:
+    /**
+     * @brief How a unit converts to its base unit
+     */
+    enum class Conversion : uint8_t {
+        BASE,           ///< Is the base unit (factor 1)
+        STATIC,         ///< Constant factor
+        TIME_VARYING,   ///< FX rate per period
+        INVALID         ///< Unknown conversion_type
+    };
+
     /**
      * @brief Unit definition structure
      */
@@ -139,6 +203,9 @@ private:
         std::string base_unit_code;
         std::string display_symbol;
         std::string description;
+        Conversion conversion = Conversion::INVALID;
+        int fx_from_id = -1;  // FXProvider currency IDs of unit and base (TIME_VARYING only)
+        int fx_to_id = -1;
     };
 
     /**
@@ -146,6 +213,11 @@ private:
      */
     void load_unit_definitions();
 
+    /**
+     * @brief Fill static_factors_ for every pair of units
+     */
+    void build_static_factors();
+
     /**
      * @brief Get static conversion factor
      * @param unit_code Unit code
@@ -156,29 +228,25 @@ private:
 
     /**
      * @brief Get time-varying conversion factor via FXProvider
-     * @param unit_code Currency code
+     * @param def Currency unit
      * @param period_id Period ID
      * @return Conversion factor to base currency
      * @throws std::invalid_argument if FX provider not available or rate not found
      */
-    double get_time_varying_conversion_factor(
-        const std::string& unit_code,
-        int period_id
-    ) const;
+    double get_time_varying_conversion_factor(const UnitDefinition& def, int period_id) const;
 
     // Database and FX provider
     std::shared_ptr<finmodel::database::IDatabase> db_;
-    std::shared_ptr<finmodel::fx::FXProvider> fx_provider_;
-
-    // Cached unit definitions
-    std::unordered_map<std::string, UnitDefinition> unit_definitions_;
+    std::shared_ptr<const finmodel::fx::FXProvider> fx_provider_;
 
-    // Fast lookup maps
-    std::unordered_map<std::string, std::string> unit_to_category_;
+    // Interned unit definitions: unit_code → ID → definition
+    std::unordered_map<std::string, int, StringHash, std::equal_to<>> unit_index_;
+    std::vector<UnitDefinition> units_;
     std::unordered_map<std::string, std::string> category_to_base_unit_;
-    std::unordered_map<std::string, std::string> conversion_types_;
-    std::unordered_map<std::string, double> static_conversion_factors_;
-    std::unordered_map<std::string, std::string> display_symbols_;
+
+    // static_factors_[from * units_.size() + to] converts between two static
+    // (or base) units of one category; NaN for other pairs
+    std::vector<double> static_factors_;
 };
 
 } // namespace core
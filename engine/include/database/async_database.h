@@ -0,0 +1,292 @@
+#pragma once
+
+#include "idatabase.h"
+#include "result_set.h"
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace database {
+
+namespace detail {
+
+/**
+ * @brief Outcome of one asynchronous operation, shared by whoever completes it and whoever waits
+ */
+template <typename T>
+class AsyncState {
+public:
+    void complete(T value) {
+        finish([&] { value_.emplace(std::move(value)); });
+    }
+
+    void fail(std::exception_ptr error) {
+        finish([&] { error_ = std::move(error); });
+    }
+
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return done_;
+    }
+
+    /**
+     * @brief Resume waiter on completion; false if already complete (don't suspend)
+     */
+    bool suspend(std::coroutine_handle<> waiter) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_) {
+            return false;
+        }
+        waiter_ = waiter;
+        return true;
+    }
+
+    void wait() const {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return done_; });
+    }
+
+    T take() {
+        wait();
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return std::move(*value_);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::condition_variable done_cv_;
+    bool done_ = false;
+    std::optional<T> value_;
+    std::exception_ptr error_;
+    std::coroutine_handle<> waiter_;
+
+    template <typename Set>
+    void finish(Set set) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set();
+            done_ = true;
+            waiter = std::exchange(waiter_, {});
+        }
+        done_cv_.notify_all();
+        if (waiter) {
+            waiter.resume();  // On the completing thread
+        }
+    }
+};
+
+template <typename T>
+struct is_borrowed_cell : std::bool_constant<std::is_same_v<T, std::string_view> ||
+                                             std::is_same_v<T, std::span<const std::uint8_t>>> {};
+
+template <typename T>
+struct is_borrowed_cell<std::optional<T>> : is_borrowed_cell<T> {};
+
+} // namespace detail
+
+/**
+ * @brief Result of an AsyncDatabase operation, or of a coroutine returning it
+ *
+ * co_await it in a coroutine, or get() it on a thread. Operations start
+ * when they are created, so several can be in flight before the first is
+ * awaited. A coroutine declared to return AsyncResult<T> runs on the
+ * calling thread until its first co_await, and continues wherever the
+ * awaited operation completes (an AsyncDatabase executor thread).
+ *
+ * @tparam T Value type (not void)
+ */
+template <typename T>
+class AsyncResult {
+public:
+    static_assert(!std::is_void_v<T>, "AsyncResult: use a value type (e.g. bool) instead of void");
+
+    struct promise_type {
+        std::shared_ptr<detail::AsyncState<T>> state = std::make_shared<detail::AsyncState<T>>();
+
+        AsyncResult get_return_object() { return AsyncResult(state); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }  // Frame freed on completion; state lives on
+        void return_value(T value) { state->complete(std::move(value)); }
+        void unhandled_exception() { state->fail(std::current_exception()); }
+    };
+
+    explicit AsyncResult(std::shared_ptr<detail::AsyncState<T>> state) : state_(std::move(state)) {}
+
+    /**
+     * @brief Whether the value (or error) is there
+     */
+    bool ready() const { return state_->ready(); }
+
+    /**
+     * @brief Block until complete (without taking the value)
+     */
+    void wait() const { state_->wait(); }
+
+    /**
+     * @brief Block until complete and take the value (once)
+     * @throws What the operation threw
+     */
+    T get() { return state_->take(); }
+
+    bool await_ready() const { return state_->ready(); }
+    bool await_suspend(std::coroutine_handle<> waiter) { return state_->suspend(waiter); }
+    T await_resume() { return state_->take(); }
+
+private:
+    std::shared_ptr<detail::AsyncState<T>> state_;
+};
+
+/**
+ * @brief Database calls run by executor threads, awaited by coroutines
+ *
+ * A request handler or pipeline stage that would block on execute_query()
+ * hands the call to an executor instead and co_awaits it (or keeps going
+ * and get()s it later). Each executor thread opens its own connection
+ * with connect, on its first operation, and keeps it: give an SQLite
+ * database several executors for parallel WAL reads (with a factory like
+ * ConnectionPool::reader(), which opens one per thread), a PostgreSQL one
+ * as many as the server should see in parallel.
+ *
+ * Result sets don't leave the executor: query() copies rows into tuples
+ * and run() returns whatever its function builds from the connection.
+ * Awaiting coroutines resume on the executor thread that completed the
+ * operation; continuations that do heavy work should hand it on, and
+ * must not get() an operation of the same single-executor database.
+ *
+ * Usage:
+ * @code
+ * AsyncDatabase db([&pool] { return pool.reader(); }, 4);
+ *
+ * AsyncResult<double> total_revenue(AsyncDatabase& db, ScenarioID scenario) {
+ *     ParamMap params;    // Not a braced list in the co_await: GCC 12 rejects it
+ *     params["s"] = scenario;
+ *     auto rows = co_await db.query<double>(
+ *         "SELECT value FROM unified_result WHERE scenario_id = :s AND line_item_code = 'REVENUE'",
+ *         std::move(params));
+ *     double total = 0.0;
+ *     for (auto [value] : rows) total += value;
+ *     co_return total;
+ * }
+ *
+ * auto base = total_revenue(db, 1);     // Both queries in flight
+ * auto stress = total_revenue(db, 2);
+ * double delta = stress.get() - base.get();
+ * @endcode
+ */
+class AsyncDatabase {
+public:
+    using ConnectionFactory = std::function<std::shared_ptr<IDatabase>()>;
+
+    /**
+     * @brief Start the executor threads
+     * @param connect Opens one executor's connection (called on that executor's thread)
+     * @param executors Threads, and connections (0: one)
+     */
+    explicit AsyncDatabase(ConnectionFactory connect, size_t executors = 1);
+
+    /**
+     * @brief Run the operations still queued, then stop the executors and close their connections
+     */
+    ~AsyncDatabase();
+
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    /**
+     * @brief Call fn(connection) on an executor
+     * @return fn's value, or what it (or opening the connection) threw
+     */
+    template <typename Fn>
+    auto run(Fn fn) -> AsyncResult<std::invoke_result_t<Fn&, IDatabase&>> {
+        using T = std::invoke_result_t<Fn&, IDatabase&>;
+        auto state = std::make_shared<detail::AsyncState<T>>();
+        submit([state, fn = std::move(fn)](IDatabase* db, std::exception_ptr connect_error) mutable {
+            if (!db) {
+                state->fail(connect_error);
+                return;
+            }
+            std::optional<T> value;
+            try {
+                value.emplace(fn(*db));
+            } catch (...) {
+                state->fail(std::current_exception());
+                return;
+            }
+            state->complete(std::move(*value));  // Outside the try: a resumed coroutine's exceptions are its own
+        });
+        return AsyncResult<T>(std::move(state));
+    }
+
+    /**
+     * @brief Rows of a query, column i read as the i-th type (as ResultSet::rows())
+     * @tparam Ts Owning column types: std::string, not std::string_view
+     */
+    template <typename... Ts>
+    AsyncResult<std::vector<std::tuple<Ts...>>> query(std::string sql, ParamMap params = {}) {
+        static_assert((!detail::is_borrowed_cell<Ts>::value && ...),
+                      "AsyncDatabase::query: views into the result set don't outlive it");
+        return run([sql = std::move(sql), params = std::move(params)](IDatabase& db) {
+            std::vector<std::tuple<Ts...>> rows;
+            auto result = db.execute_query(sql, params);
+            for (auto row : result->template rows<Ts...>()) {
+                rows.push_back(std::move(row));
+            }
+            return rows;
+        });
+    }
+
+    /**
+     * @brief IDatabase::execute_update() on an executor
+     */
+    AsyncResult<int> update(std::string sql, ParamMap params = {});
+
+    /**
+     * @brief IDatabase::execute_batch() on an executor
+     */
+    AsyncResult<int> batch(std::string sql, std::vector<ParamMap> rows);
+
+    /**
+     * @brief Number of executor threads
+     */
+    size_t executors() const { return threads_.size(); }
+
+    /**
+     * @brief Operations queued or running
+     */
+    size_t pending() const;
+
+private:
+    using Job = std::function<void(IDatabase* db, std::exception_ptr connect_error)>;
+
+    ConnectionFactory connect_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::deque<Job> queue_;
+    size_t running_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    void submit(Job job);
+    void executor_loop();
+};
+
+} // namespace database
+} // namespace finmodel
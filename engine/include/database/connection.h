@@ -9,6 +9,7 @@
 #include "database/idatabase.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace finmodel {
 namespace database {
@@ -100,6 +101,11 @@ private:
  *
  * Provides a simpler interface for binding parameters and
  * stepping through results.
+ *
+ * The ? placeholders are rewritten to named parameters once, at
+ * construction, so every execution sends the same SQL text: with
+ * SQLiteDatabase that reuses one cached native statement, which reset()
+ * and rebinding re-run without preparing it again.
  */
 class PreparedStatement {
 public:
@@ -160,9 +166,10 @@ public:
 
 private:
     std::shared_ptr<IDatabase> db_;
-    std::string sql_;
+    std::string sql_;              ///< SQL with ? rewritten to :p0, :p1, ...
     std::shared_ptr<ResultSet> result_;
-    std::vector<ParamValue> params_;
+    ParamMap params_;              ///< Bound values by rewritten name (unbound: NULL)
+    std::vector<std::string> param_names_;
     int param_count_;
     bool executed_;
     bool has_row_;
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "idatabase.h"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+    class ThreadPool;
+    class UnitConverter;
+}
+}
+
+namespace finmodel {
+namespace database {
+
+/**
+ * @brief Read-only memory map of a whole file
+ */
+class MappedFile {
+public:
+    /**
+     * @throws std::runtime_error if the file can't be opened or mapped
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view data() const { return {data_, size_}; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * @brief How a CSV file is read into a table
+ */
+struct CsvImportOptions {
+    char delimiter = ',';
+    bool trim = true;                    ///< Strip spaces around unquoted cells (as the dashboard's parser)
+    size_t chunk_bytes = 4u << 20;       ///< Bytes parsed per task
+    core::ThreadPool* pool = nullptr;    ///< Parse chunks on it (null: this thread)
+
+    /// Columns stored as REAL, converted into the base unit of the unit
+    /// code given ("" or no converter: as read); every other column is TEXT
+    std::map<std::string, std::string> numeric_columns;
+    const core::UnitConverter* units = nullptr;
+
+    bool replace = true;                 ///< Drop an existing table first, else append to it
+};
+
+/**
+ * @brief Summary of an import
+ */
+struct CsvImportResult {
+    std::string table;
+    std::vector<std::string> columns;    ///< Header, in file order
+    size_t rows = 0;
+    size_t chunks = 0;                   ///< Parsed in parallel
+};
+
+/**
+ * @brief Bulk CSV loader for the staging_* tables
+ *
+ * The file is memory-mapped and cut into chunks of about chunk_bytes. A
+ * first parallel pass scans every chunk from each quoting state it could
+ * start in (by the parser's own rules, so a quote inside an unquoted cell
+ * stays a literal), so each chunk knows whether it starts inside a quoted
+ * cell and can find where its first record begins; the chunks are then
+ * parsed in parallel into parameter rows (cells found by scanning eight
+ * bytes at a time for the delimiter and line ends), and inserted in file
+ * order through IDatabase::execute_batch() in one transaction. On a SQLite
+ * connection not already in a transaction, the import runs in a
+ * BulkLoadSession: the secondary indexes of a table appended to are
+ * rebuilt once at the end, and the table is analyzed.
+ *
+ * The table has the layout the dashboard server gives staging tables:
+ * _rowid, one column per header cell, imported_at and is_mapped. Quoted
+ * cells follow RFC 4180 ("" inside quotes is a quote, quotes may span
+ * lines); empty lines are skipped.
+ *
+ * Usage:
+ * @code
+ * core::ThreadPool pool(8);
+ * CsvImportOptions options;
+ * options.pool = &pool;
+ * options.numeric_columns = {{"value", "kEUR"}};
+ * options.units = &converter;
+ * auto result = CsvImporter::import_file(*db, "scenario.csv", "staging_scenario_4", options);
+ * @endcode
+ */
+class CsvImporter {
+public:
+    /**
+     * @brief Load a CSV file into a table
+     * @throws std::runtime_error if the file can't be read, has no header,
+     *         a record has more cells than the header or a numeric cell isn't a number
+     * @throws std::invalid_argument for an unknown or time-varying unit, or a
+     *         numeric column the header doesn't have
+     */
+    static CsvImportResult import_file(IDatabase& db, const std::string& path, const std::string& table,
+                                       const CsvImportOptions& options = {});
+
+    /**
+     * @brief import_file() of CSV text already in memory
+     */
+    static CsvImportResult import_text(IDatabase& db, std::string_view text, const std::string& table,
+                                       const CsvImportOptions& options = {});
+
+    /**
+     * @brief Cells of every record (header first), records with fewer cells padded with ""
+     *
+     * As import_file() reads them, without the chunks: for previews and tests.
+     */
+    static std::vector<std::vector<std::string>> parse(std::string_view text, const CsvImportOptions& options = {});
+};
+
+} // namespace database
+} // namespace finmodel
@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <cstdint>
 #include <map>
+#include <span>
 #include <variant>
 
 namespace finmodel {
@@ -16,7 +17,8 @@ class ResultSet;
 // ParamValue and ParamMap will be defined in common_types.h
 // But we need them in the interface, so we define them here minimally
 // The actual implementation should include common_types.h
-using ParamValue = std::variant<int, double, std::string, std::nullptr_t>;
+using Blob = std::vector<std::uint8_t>;
+using ParamValue = std::variant<int, double, std::string, std::nullptr_t, Blob>;
 using ParamMap = std::map<std::string, ParamValue>;
 
 namespace database {
@@ -143,6 +145,50 @@ public:
         const std::string& sql,
         const finmodel::ParamMap& params) = 0;
 
+    /**
+     * @brief Execute one INSERT, UPDATE, or DELETE statement for many parameter rows
+     * @param sql SQL statement with named parameters
+     * @param rows Parameters of each execution
+     * @return Total number of rows affected
+     * @throws DatabaseException if a row fails (rows executed before it are rolled back)
+     *
+     * Runs in one transaction: the caller's if one is active, otherwise
+     * its own. Backends reuse one prepared statement for all rows; this
+     * default runs execute_update() per row.
+     *
+     * Example:
+     * @code
+     * std::vector<ParamMap> rows;
+     * for (const auto& [code, value] : drivers) {
+     *     rows.push_back({{"code", code}, {"value", value}});
+     * }
+     * db->execute_batch("INSERT INTO scenario_drivers (driver_code, value) VALUES (:code, :value)", rows);
+     * @endcode
+     */
+    virtual int execute_batch(
+        const std::string& sql,
+        std::span<const finmodel::ParamMap> rows) {
+        const bool own_transaction = !in_transaction();
+        if (own_transaction) {
+            begin_transaction();
+        }
+        int affected = 0;
+        try {
+            for (const auto& params : rows) {
+                affected += execute_update(sql, params);
+            }
+        } catch (...) {
+            if (own_transaction) {
+                rollback();
+            }
+            throw;
+        }
+        if (own_transaction) {
+            commit();
+        }
+        return affected;
+    }
+
     // === Transaction Management ===
 
     /**
@@ -236,6 +282,15 @@ public:
      * Useful for DDL statements (CREATE TABLE, etc.)
      */
     virtual void execute_raw(const std::string& sql) = 0;
+
+    /**
+     * @brief Write a working copy's new rows back to its database
+     * @return Rows written (always 0 for a connection that isn't a working copy)
+     * @throws DatabaseException if the write-back fails (the database is left unchanged)
+     *
+     * See DatabaseFactory::create_working_copy().
+     */
+    virtual size_t flush() { return 0; }
 };
 
 } // namespace database
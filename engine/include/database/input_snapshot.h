@@ -0,0 +1,76 @@
+#pragma once
+
+#include "idatabase.h"
+#include "types/common_types.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace database {
+
+/**
+ * @brief Summary of a compiled input snapshot
+ */
+struct InputSnapshotInfo {
+    std::string path;
+    int format_version = 0;
+    std::vector<std::string> tables;       ///< Input tables copied (those the source has)
+    std::vector<ScenarioID> scenario_ids;  ///< Scenarios kept, with ancestors (empty: all)
+    size_t rows = 0;                       ///< Rows copied
+};
+
+/**
+ * @brief Read-only, memory-mapped copy of everything a run reads
+ *
+ * compile() copies the input tables (templates, drivers, actions, units,
+ * FX rates, periods, entities, assets, perils, ...) into a new SQLite file,
+ * optionally keeping only the rows of some scenarios. Workers open() it
+ * immutable and memory-mapped: no locks, no WAL, and processes on one
+ * machine share its pages through the page cache. Every provider reads it
+ * as it reads the full database.
+ *
+ * Usage:
+ *   InputSnapshot::compile("finmodel.db", "run_inputs.db", {scenario_id});
+ *   // Per worker thread or process
+ *   auto db = InputSnapshot::open("run_inputs.db");
+ *   PeriodRunner runner(db);
+ */
+class InputSnapshot {
+public:
+    /// Version written to snapshot_info; open() rejects other versions
+    static constexpr int FORMAT_VERSION = 1;
+
+    /// Upper bound on the mapped size (SQLite maps min(file size, this))
+    static constexpr long long MMAP_BYTES = 1LL << 30;
+
+    /**
+     * @brief Tables copied by compile(), in copy order
+     */
+    static const std::vector<std::string>& input_tables();
+
+    /**
+     * @brief Write a snapshot of a database's inputs
+     * @param source_path Path of the source database file
+     * @param snapshot_path File to create (replaced if it exists)
+     * @param scenario_ids Scenarios to keep, parents included (empty: all rows)
+     * @return What was copied
+     * @throws DatabaseException if the source can't be read or the snapshot written
+     *
+     * Tables keep their definitions and indexes; rows of tables with a
+     * scenario_id column are filtered (rows without a scenario are kept).
+     * Views are copied when the tables they read were.
+     */
+    static InputSnapshotInfo compile(const std::string& source_path,
+                                     const std::string& snapshot_path,
+                                     const std::vector<ScenarioID>& scenario_ids = {});
+
+    /**
+     * @brief Open a snapshot read-only, immutable and memory-mapped
+     * @throws DatabaseException if the file isn't a snapshot of FORMAT_VERSION
+     */
+    static std::shared_ptr<IDatabase> open(const std::string& snapshot_path);
+};
+
+} // namespace database
+} // namespace finmodel
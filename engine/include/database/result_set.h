@@ -1,12 +1,23 @@
 #pragma once
 
+#include "database/idatabase.h"
 #include <string>
+#include <string_view>
 #include <optional>
+#include <span>
 #include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace finmodel {
 
+template <typename... Ts>
+class TypedRows;
+
 /**
  * @brief Iterator-style interface for query results
  *
@@ -36,10 +47,18 @@ namespace finmodel {
  * }
  * @endcode
  *
+ * Typed rows bind columns by position once instead of per cell by name:
+ * @code
+ * auto result = db->execute_query("SELECT driver_code, value, unit_code FROM scenario_drivers", {});
+ * for (auto [code, value, unit] : result->rows<std::string_view, double, std::string_view>()) {
+ *     // code and unit view the current row (valid until the next row)
+ * }
+ * @endcode
+ *
  * Type safety:
  * - Automatic type conversion where possible (e.g., int → double)
  * - Throws DatabaseException for incompatible conversions
- * - NULL handling via is_null() checks
+ * - NULL handling via is_null() checks, or std::optional<T> columns in rows()
  */
 class ResultSet {
 public:
@@ -145,6 +164,22 @@ public:
      */
     virtual std::string get_string(size_t index) const = 0;
 
+    /**
+     * @brief Get text value by column index without copying
+     * @param index Column index (0-based)
+     * @return View of the value (empty if NULL), valid until next() or reset()
+     * @throws DatabaseException if index out of range
+     */
+    virtual std::string_view get_text(size_t index) const = 0;
+
+    /**
+     * @brief Get blob value by column index without copying
+     * @param index Column index (0-based)
+     * @return View of the bytes (empty if NULL), valid until next() or reset()
+     * @throws DatabaseException if index out of range
+     */
+    virtual std::span<const std::uint8_t> get_blob(size_t index) const = 0;
+
     /**
      * @brief Check if column value is NULL by index
      * @param index Column index (0-based)
@@ -196,6 +231,117 @@ public:
      * of calling row_count() first.
      */
     virtual size_t row_count() const = 0;
+
+    // === Typed Access ===
+
+    /**
+     * @brief Current row's value of a column as T
+     * @tparam T int, int64_t, double, std::string, std::string_view, std::span<const std::uint8_t>
+     *           (a blob), or std::optional of one (nullopt if NULL)
+     * @param index Column index (0-based)
+     */
+    template <typename T>
+    T get(size_t index) const;
+
+    /**
+     * @brief Iterate over the remaining rows, column i read as the i-th type
+     * @return Range yielding std::tuple<Ts...> per row (steps with next())
+     * @throws DatabaseException if the query has fewer columns than types
+     */
+    template <typename... Ts>
+    TypedRows<Ts...> rows();
 };
 
+namespace detail {
+
+template <typename T>
+struct is_optional : std::false_type {};
+
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+} // namespace detail
+
+template <typename T>
+T ResultSet::get(size_t index) const {
+    if constexpr (detail::is_optional<T>::value) {
+        if (is_null(index)) {
+            return std::nullopt;
+        }
+        return get<typename T::value_type>(index);
+    } else if constexpr (std::is_same_v<T, int>) {
+        return get_int(index);
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+        return get_int64(index);
+    } else if constexpr (std::is_same_v<T, double>) {
+        return get_double(index);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return get_string(index);
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        return get_text(index);
+    } else if constexpr (std::is_same_v<T, std::span<const std::uint8_t>>) {
+        return get_blob(index);
+    } else {
+        static_assert(!sizeof(T), "ResultSet::get: unsupported column type");
+    }
+}
+
+/**
+ * @brief Input range over the rows of a ResultSet as typed tuples
+ */
+template <typename... Ts>
+class TypedRows {
+public:
+    using value_type = std::tuple<Ts...>;
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::tuple<Ts...>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+        using pointer = void;
+
+        iterator() = default;
+        explicit iterator(ResultSet* result) : result_(result) { advance(); }
+
+        reference operator*() const { return read(std::index_sequence_for<Ts...>{}); }
+        iterator& operator++() { advance(); return *this; }
+        void operator++(int) { advance(); }
+        bool operator==(const iterator& other) const { return result_ == other.result_; }
+        bool operator!=(const iterator& other) const { return result_ != other.result_; }
+
+    private:
+        ResultSet* result_ = nullptr;  ///< Null at the end
+
+        void advance() {
+            if (result_ && !result_->next()) {
+                result_ = nullptr;
+            }
+        }
+
+        template <size_t... I>
+        value_type read(std::index_sequence<I...>) const {
+            return value_type(result_->template get<Ts>(I)...);
+        }
+    };
+
+    explicit TypedRows(ResultSet* result) : result_(result) {}
+
+    iterator begin() { return iterator(result_); }
+    iterator end() { return iterator(); }
+
+private:
+    ResultSet* result_;
+};
+
+template <typename... Ts>
+TypedRows<Ts...> ResultSet::rows() {
+    if (column_count() < sizeof...(Ts)) {
+        throw database::DatabaseException("ResultSet::rows: " + std::to_string(sizeof...(Ts)) +
+                                          " types for " + std::to_string(column_count()) + " columns");
+    }
+    return TypedRows<Ts...>(this);
+}
+
 } // namespace finmodel
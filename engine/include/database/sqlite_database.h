@@ -6,10 +6,87 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace finmodel {
 namespace database {
 
+/**
+ * @brief Statement cache counters
+ */
+struct StatementCacheStats {
+    size_t hits = 0;        ///< Statements reused without sqlite3_prepare_v2
+    size_t misses = 0;      ///< Statements prepared
+    size_t size = 0;        ///< Statements currently cached
+    size_t capacity = 0;    ///< Maximum statements cached
+};
+
+/**
+ * @brief LRU cache of prepared statements of one connection, keyed by SQL text
+ *
+ * A statement is handed to one user at a time: acquiring SQL whose cached
+ * statement is still in use (e.g. a query run while iterating the results
+ * of the same query) prepares a second, uncached statement. Released
+ * statements are reset and their bindings cleared.
+ *
+ * Shared by the database and its open result sets, so result sets may
+ * outlive clear().
+ */
+class SQLiteStatementCache {
+public:
+    explicit SQLiteStatementCache(size_t capacity) : capacity_(capacity) {}
+    ~SQLiteStatementCache();
+
+    SQLiteStatementCache(const SQLiteStatementCache&) = delete;
+    SQLiteStatementCache& operator=(const SQLiteStatementCache&) = delete;
+
+    /**
+     * @brief Get a statement for sql with no bindings, not stepped yet
+     * @throws DatabaseException if the SQL doesn't prepare
+     */
+    sqlite3_stmt* acquire(sqlite3* db, const std::string& sql);
+
+    /**
+     * @brief Return a statement from acquire() (finalized if it isn't cached)
+     */
+    void release(sqlite3_stmt* stmt);
+
+    /**
+     * @brief Finalize idle statements and forget the rest (finalized on release)
+     */
+    void clear();
+
+    /**
+     * @brief Change the capacity, evicting least recently used statements
+     * @param capacity Maximum statements (0 disables caching)
+     */
+    void set_capacity(size_t capacity);
+
+    StatementCacheStats stats() const {
+        return {hits_, misses_, entries_.size(), capacity_};
+    }
+
+private:
+    struct Entry {
+        std::string sql;
+        sqlite3_stmt* stmt;
+        bool in_use;
+    };
+
+    size_t capacity_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> entries_;    ///< Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> by_sql_;
+    std::unordered_map<sqlite3_stmt*, std::list<Entry>::iterator> by_stmt_;
+
+    void evict(std::list<Entry>::iterator entry);
+    void trim();
+};
+
 /**
  * @brief SQLite implementation of IDatabase
  *
@@ -21,6 +98,7 @@ namespace database {
  *
  * Features:
  * - Named parameter support (:param_name)
+ * - Prepared statement cache: repeated SQL text skips sqlite3_prepare_v2
  * - Automatic transaction management
  * - Connection pooling (future)
  * - WAL mode for better concurrency
@@ -46,6 +124,37 @@ public:
 
     // IDatabase implementation
     void connect(const std::string& connection_string) override;
+
+    /**
+     * @brief Connect without write access (e.g. a WAL reader next to a writer connection)
+     * @param connection_string Path or URI of an existing database
+     * @throws DatabaseException if the database can't be opened
+     *
+     * The journal mode is left as the writer set it. Busy waits up to
+     * BUSY_TIMEOUT_MS instead of failing while a checkpoint holds a lock.
+     */
+    void connect_read_only(const std::string& connection_string);
+
+    /**
+     * @brief Connect to an in-memory copy of a database file
+     * @param source_path Database (or input snapshot) copied with the backup API
+     * @param memory_uri In-memory database to copy into (":memory:", or a
+     *        "file:NAME?mode=memory&cache=shared" URI other connections open too)
+     * @param write_back Tables whose rows added in memory flush() appends to target_path
+     * @param target_path Database flush() writes to
+     * @throws DatabaseException if the source can't be read
+     *
+     * Write-back tables missing in the source (e.g. the outputs of an input
+     * snapshot) are created as they are in the target, their AUTOINCREMENT
+     * ids continuing after the target's.
+     *
+     * flush() appends, in one transaction, the rows of the write-back tables
+     * with a rowid above the one they had at the copy (or the last flush()),
+     * with the columns of the copy. Updates and deletes of copied rows,
+     * and writes to every other table, stay in memory.
+     */
+    void connect_working_copy(const std::string& source_path, const std::string& memory_uri,
+                              const std::vector<std::string>& write_back, const std::string& target_path);
     void disconnect() override;
     bool is_connected() const override;
 
@@ -57,6 +166,16 @@ public:
         const std::string& sql,
         const ParamMap& params) override;
 
+    /**
+     * @brief Execute a statement for many parameter rows with one prepared statement
+     *
+     * Parameter indexes are resolved once per distinct set of names, so
+     * uniform rows only bind values.
+     */
+    int execute_batch(
+        const std::string& sql,
+        std::span<const ParamMap> rows) override;
+
     void begin_transaction() override;
     void commit() override;
     void rollback() override;
@@ -71,17 +190,141 @@ public:
 
     void execute_raw(const std::string& sql) override;
 
+    /**
+     * @throws DatabaseException inside a transaction, or if a write-back table
+     *         is missing in the target or a row conflicts with one there
+     */
+    size_t flush() override;
+
+    /// How long a connection waits for another one's lock before failing
+    static constexpr int BUSY_TIMEOUT_MS = 5000;
+
+    /// Statements kept prepared by default
+    static constexpr size_t DEFAULT_STATEMENT_CACHE_CAPACITY = 64;
+
+    /**
+     * @brief Hit/miss counters and occupancy of the prepared statement cache
+     */
+    StatementCacheStats statement_cache_stats() const { return statements_->stats(); }
+
+    /**
+     * @brief Set how many prepared statements are kept (0 prepares every query)
+     */
+    void set_statement_cache_capacity(size_t capacity) { statements_->set_capacity(capacity); }
+
+    /**
+     * @brief Finalize cached statements (e.g. before dropping many tables)
+     */
+    void clear_statement_cache() { statements_->clear(); }
+
+    /**
+     * @brief The SQLite connection, for extensions registered on it (virtual tables, functions)
+     * @return Null while disconnected
+     */
+    sqlite3* native_handle() const { return db_; }
+
 private:
     sqlite3* db_;
     bool connected_;
     bool in_transaction_;
     std::string connection_string_;
+    std::shared_ptr<SQLiteStatementCache> statements_;
+
+    // Working copy: where flush() writes, and per write-back table the highest rowid written
+    std::string write_back_path_;
+    std::vector<std::pair<std::string, int64_t>> write_back_;
 
     // Helper methods
+    void open(const std::string& connection_string, int flags);
     void bind_parameters(sqlite3_stmt* stmt, const ParamMap& params);
+    void bind_value(sqlite3_stmt* stmt, int index, const std::string& name, const ParamValue& value);
     void enable_wal_mode();
     void enable_foreign_keys();
     int get_parameter_index(sqlite3_stmt* stmt, const std::string& param_name);
+    int64_t max_rowid(const std::string& schema, const std::string& table);
+};
+
+
+/**
+ * @brief Options of a BulkLoadSession
+ */
+struct BulkLoadOptions {
+    /// PRAGMA synchronous while loading ("OFF": a crash may corrupt the file; "NORMAL" is safe in WAL mode)
+    std::string synchronous = "OFF";
+
+    /// Page cache while loading, in KiB
+    int64_t cache_size_kib = 256 * 1024;
+
+    /// Bytes of the file memory-mapped while loading
+    int64_t mmap_size = int64_t{1} << 30;
+
+    /// WAL pages before an automatic checkpoint while loading
+    int64_t wal_autocheckpoint = 10000;
+
+    /// Tables loaded: their secondary indexes are dropped (drop_indexes) and they are analyzed at the end
+    std::vector<std::string> tables;
+
+    /// Drop the non-unique indexes of tables while loading and rebuild them at the end
+    bool drop_indexes = false;
+
+    /// Refresh the query planner's statistics at the end (ANALYZE tables, or PRAGMA optimize without tables)
+    bool analyze = true;
+
+    /// Rows ANALYZE samples per index (PRAGMA analysis_limit; 0: all)
+    int analysis_limit = 1000;
+};
+
+/**
+ * @brief Connection settings for a large write, restored when it ends
+ *
+ * While the session lasts commits don't wait for the disk (synchronous),
+ * the page cache and memory map are larger, and the WAL grows longer
+ * before being checkpointed. With drop_indexes the non-unique indexes of
+ * the loaded tables are dropped and rebuilt once at the end, instead of
+ * updated row by row (UNIQUE indexes and constraints stay: rows are still
+ * checked against them).
+ *
+ * finish() rebuilds the indexes, restores the settings and analyzes the
+ * tables; the destructor does so too if finish() wasn't called (e.g. on an
+ * exception), ignoring errors.
+ *
+ * Usage:
+ * @code
+ * BulkLoadSession bulk(db, {.tables = {"unified_result"}, .drop_indexes = true});
+ * db.begin_transaction();
+ * db.execute_batch(insert_sql, rows);
+ * db.commit();
+ * bulk.finish();
+ * @endcode
+ */
+class BulkLoadSession {
+public:
+    /**
+     * @throws DatabaseException inside a transaction (pragmas and DDL must run outside one)
+     */
+    BulkLoadSession(SQLiteDatabase& db, BulkLoadOptions options = {});
+    ~BulkLoadSession();
+
+    BulkLoadSession(const BulkLoadSession&) = delete;
+    BulkLoadSession& operator=(const BulkLoadSession&) = delete;
+
+    /**
+     * @brief Rebuild dropped indexes, restore the settings and analyze (once)
+     * @throws DatabaseException if a step fails (the remaining steps still run)
+     */
+    void finish();
+
+    /**
+     * @brief Indexes dropped while loading (to be rebuilt by finish())
+     */
+    std::vector<std::string> dropped_indexes() const;
+
+private:
+    SQLiteDatabase& db_;
+    BulkLoadOptions options_;
+    bool finished_ = false;
+    std::vector<std::pair<std::string, std::string>> pragmas_;  ///< Name, value to restore
+    std::vector<std::pair<std::string, std::string>> indexes_;  ///< Name, CREATE INDEX statement
 };
 
 } // namespace database
@@ -93,12 +336,13 @@ namespace finmodel {
 /**
  * @brief SQLite-specific ResultSet implementation
  *
- * Wraps sqlite3_stmt for result iteration.
- * Automatically finalizes the statement on destruction.
+ * Wraps sqlite3_stmt for result iteration. On destruction the statement
+ * goes back to its statement cache, or is finalized without one.
  */
 class SQLiteResultSet : public ResultSet {
 public:
-    explicit SQLiteResultSet(sqlite3_stmt* stmt);
+    explicit SQLiteResultSet(sqlite3_stmt* stmt,
+                             std::shared_ptr<database::SQLiteStatementCache> cache = nullptr);
     ~SQLiteResultSet() override;
 
     // Disable copy, enable move
@@ -121,6 +365,8 @@ public:
     int64_t get_int64(size_t index) const override;
     double get_double(size_t index) const override;
     std::string get_string(size_t index) const override;
+    std::string_view get_text(size_t index) const override;
+    std::span<const std::uint8_t> get_blob(size_t index) const override;
     bool is_null(size_t index) const override;
 
     size_t column_count() const override;
@@ -133,10 +379,12 @@ public:
 
 private:
     sqlite3_stmt* stmt_;
+    std::shared_ptr<database::SQLiteStatementCache> cache_;
     bool has_row_;
     bool first_call_;
-    mutable std::map<std::string, size_t> column_index_cache_;
+    mutable std::unordered_map<std::string, size_t> column_index_cache_;
 
+    void release_statement();
     void build_column_index_cache() const;
     size_t get_column_index(const std::string& column) const;
 };
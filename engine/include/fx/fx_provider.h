@@ -3,7 +3,8 @@
  * @brief Foreign exchange rate provider for time-varying currency conversions
  *
  * Loads FX rates from database and provides period-specific conversion rates.
- * Supports caching for performance.
+ * Currencies are interned to small integer IDs and all rates are kept in a
+ * dense table, so a lookup by ID is a single indexed load.
  *
  * Usage:
  *   FXProvider fx(db);
@@ -17,6 +18,8 @@
 #include <vector>
 #include <unordered_map>
 #include <optional>
+#include <cmath>
+#include <cstddef>
 
 namespace finmodel {
 namespace database {
@@ -30,16 +33,23 @@ namespace fx {
 /**
  * @brief Provides foreign exchange rates for currency conversions
  *
- * Loads rates from fx_rate table and caches them for fast lookup.
+ * Loads rates from fx_rate table into a [from][to][period] table.
  * Rates are period-specific to support time-varying exchange rates.
+ * Missing pairs are filled at load time: first with the inverse of the
+ * opposite rate, then with a cross rate through the pivot currency (the
+ * currency quoted in most fx_rate rows).
  */
 class FXProvider {
 public:
+    /// Returned by currency_id() for currencies without rates
+    static constexpr int NO_CURRENCY = -1;
+
     /**
      * @brief Construct FX provider
      * @param db Database connection
+     * @param rate_type Only rows of this fx_rate.rate_type ("average", "closing"; empty: all rows)
      */
-    explicit FXProvider(std::shared_ptr<finmodel::database::IDatabase> db);
+    explicit FXProvider(std::shared_ptr<finmodel::database::IDatabase> db, std::string rate_type = "");
 
     /**
      * @brief Get exchange rate for a specific period
@@ -58,6 +68,42 @@ public:
         int period_id
     ) const;
 
+    /**
+     * @brief Get exchange rate by currency IDs
+     * @param from_id Source currency ID (from currency_id())
+     * @param to_id Target currency ID
+     * @param period_id Period ID
+     * @return Exchange rate
+     * @throws std::runtime_error if rate not found
+     */
+    double get_rate(int from_id, int to_id, int period_id) const;
+
+    /**
+     * @brief Look up an exchange rate by currency IDs
+     * @return Rate, or nullopt if no direct, inverse or cross rate exists
+     */
+    std::optional<double> find_rate(int from_id, int to_id, int period_id) const {
+        if (from_id == to_id && from_id != NO_CURRENCY) {
+            return 1.0;
+        }
+        size_t offset = static_cast<size_t>(period_id - first_period_);
+        if (from_id < 0 || to_id < 0 || offset >= period_columns_.size() || period_columns_[offset] < 0) {
+            return std::nullopt;
+        }
+        double rate = rates_[(static_cast<size_t>(from_id) * currency_count_ + to_id) * column_count_ +
+                             period_columns_[offset]];
+        return std::isnan(rate) ? std::nullopt : std::optional<double>(rate);
+    }
+
+    /**
+     * @brief Interned ID of a currency
+     * @param currency Currency code
+     * @return ID, or NO_CURRENCY if the currency has never appeared in fx_rate
+     *
+     * IDs stay valid across reload().
+     */
+    int currency_id(const std::string& currency) const;
+
     /**
      * @brief Check if rate exists
      * @param from_currency Source currency
@@ -79,60 +125,47 @@ public:
 
     /**
      * @brief Reload rates from database (clears cache)
+     *
+     * Not for an instance other threads read: core::ReferenceDataStore::reload()
+     * publishes a fresh provider instead.
      */
     void reload();
 
 private:
     /**
-     * @brief Rate cache key
+     * @brief Load all rates from database into cache
      */
-    struct RateKey {
-        std::string from_currency;
-        std::string to_currency;
-        int period_id;
-
-        bool operator==(const RateKey& other) const {
-            return from_currency == other.from_currency &&
-                   to_currency == other.to_currency &&
-                   period_id == other.period_id;
-        }
-    };
+    void load_rates();
 
     /**
-     * @brief Hash function for RateKey
+     * @brief Fill missing pairs with inverse and pivot cross rates
      */
-    struct RateKeyHash {
-        std::size_t operator()(const RateKey& key) const {
-            std::size_t h1 = std::hash<std::string>{}(key.from_currency);
-            std::size_t h2 = std::hash<std::string>{}(key.to_currency);
-            std::size_t h3 = std::hash<int>{}(key.period_id);
-            return h1 ^ (h2 << 1) ^ (h3 << 2);
-        }
-    };
+    void fill_derived_rates();
 
     /**
-     * @brief Load all rates from database into cache
+     * @brief Intern a currency code
      */
-    void load_rates();
-
-    /**
-     * @brief Get rate from cache or compute inverse
-     * @return Rate if found or computable, nullopt otherwise
-     */
-    std::optional<double> get_rate_from_cache(
-        const std::string& from_currency,
-        const std::string& to_currency,
-        int period_id
-    ) const;
+    int intern_currency(const std::string& currency);
 
     // Database connection
     std::shared_ptr<finmodel::database::IDatabase> db_;
+    std::string rate_type_;
+
+    // Interned currencies: code ↔ ID (append-only, so IDs survive reload())
+    std::unordered_map<std::string, int> currency_index_;
+    std::vector<std::string> currency_codes_;
+
+    // Periods: period_columns_[period_id - first_period_] → column (-1 without rates)
+    int first_period_ = 0;
+    std::vector<int> period_columns_;
+    size_t column_count_ = 0;
 
-    // Rate cache: (from, to, period) -> rate
-    mutable std::unordered_map<RateKey, double, RateKeyHash> rate_cache_;
+    // Rates: [from][to][column], NaN where no rate is known
+    size_t currency_count_ = 0;
+    std::vector<double> rates_;
 
     // Available currencies set
-    mutable std::vector<std::string> available_currencies_;
+    std::vector<std::string> available_currencies_;
 };
 
 } // namespace fx
@@ -0,0 +1,80 @@
+/**
+ * @file arrow_stream.h
+ * @brief Columnar result files as Apache Arrow IPC streams
+ *
+ * The dashboard compares scenarios over thousands of rows; as JSON built
+ * row by row that is megabytes of text to produce and parse. An Arrow IPC
+ * stream carries the same rows as typed column buffers the browser maps
+ * without parsing (apache-arrow's tableFromIPC / RecordBatchReader):
+ *
+ * - A schema message: scenario_id int32, period_id int32, then one
+ *   nullable float64 column per projected line item
+ * - One record batch per row group of the file that has matching rows
+ *   (row groups are read one at a time, so memory stays at one group)
+ * - The end-of-stream marker
+ *
+ * Cells without a value (NaN in the file) are nulls. The metadata
+ * flatbuffers are written directly (no Arrow library), in the platform's
+ * little-endian byte order.
+ *
+ * Usage:
+ * @code
+ * ColumnarResultReader reader("run_42.fmcr");
+ * ArrowResultQuery query;
+ * query.line_items = {"REVENUE", "CASH"};
+ * query.scenario_ids = {1, 7};
+ * ArrowResultStream::write(reader, query, [&](const std::string& bytes) {
+ *     return send(bytes);     // False stops the stream
+ * });
+ * @endcode
+ */
+
+#ifndef FINMODEL_ARROW_STREAM_H
+#define FINMODEL_ARROW_STREAM_H
+
+#include "types/common_types.h"
+#include "orchestration/columnar_results.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Columns and rows of a columnar file to stream
+ */
+struct ArrowResultQuery {
+    std::vector<std::string> line_items;    ///< Projected line items, in this order (empty: all)
+    std::vector<ScenarioID> scenario_ids;   ///< Scenarios to keep (empty: all)
+    std::vector<PeriodID> period_ids;       ///< Periods to keep (empty: all)
+};
+
+/**
+ * @brief Writes columnar results as an Arrow IPC stream
+ */
+class ArrowResultStream {
+public:
+    /// Media type of the stream
+    static constexpr const char* CONTENT_TYPE = "application/vnd.apache.arrow.stream";
+
+    /// Receives the stream one message at a time; false stops writing (e.g. the client went away)
+    using Sink = std::function<bool(const std::string& bytes)>;
+
+    /**
+     * @brief Write the schema, a record batch per row group with matching rows and the end marker
+     * @return Rows written
+     * @throws std::out_of_range for an unknown line item (before anything is written)
+     */
+    static size_t write(const ColumnarResultReader& reader, const ArrowResultQuery& query, const Sink& sink);
+
+    /**
+     * @brief The whole stream in memory
+     */
+    static std::string to_string(const ColumnarResultReader& reader, const ArrowResultQuery& query);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_ARROW_STREAM_H
@@ -0,0 +1,179 @@
+/**
+ * @file batch_run.h
+ * @brief Headless batch runs driven by a run manifest
+ *
+ * `scenario_engine run --manifest run.json` runs a whole sweep in one
+ * process: every entity × scenario over the manifest's periods, on the
+ * parallel runner, reading a memory-mapped input snapshot and writing
+ * through an asynchronous sink, instead of one process launch per
+ * scenario around a PeriodRunner.
+ *
+ * Manifest (paths relative to the working directory):
+ * @code
+ * {
+ *   "database": "finmodel.db",
+ *   "template": "CORP",
+ *   "entities": ["A", "B"],                 // or "entity": "A"
+ *   "scenarios": "1-1000",                  // or [1, 2, ..], or {"first": 1, "count": 1000}
+ *   "periods": "1-36",                      // or [1, 2, ..]
+ *   "opening": {"CASH": 100},
+ *   "validation": {"mode": "final_period"}, // ValidationPolicy::from_json()
+ *   "outputs": ["NET_INCOME", "CASH"],      // Line items to calculate and keep (default: all)
+ *   "output": {"type": "columnar", "path": "out/{entity}.fmcr"},
+ *                                           // or {"type": "delta", "path": "out/{entity}.fmdr"} (first scenario is the baseline),
+ *                                           // {"type": "database"[, "path": "results.db"]}, {"type": "none"}
+ *   "precision": "float32",                 // COLUMNAR: non-key line items as float32, or
+ *                                           // {"float32": ["EBITDA", ..], "double": ["CASH", ..]} (default: "double")
+ *   "snapshot": "run_inputs.db",            // Input snapshot to compile (false: read the database)
+ *   "in_memory": true,                      // Run on an in-memory copy, new results written back at the end
+ *   "result_cache": "result_cache",         // ResultCache directory: repeated runs are read, not calculated
+ *   "threads": 8,
+ *   "numa": true,                           // Workers pinned per NUMA node, a snapshot replica per node
+ *   "jobs_per_chunk": 256
+ * }
+ * @endcode
+ *
+ * Usage:
+ * @code
+ * RunManifest manifest = RunManifest::load("run.json");
+ * BatchSummary summary = BatchRunner(manifest).run();
+ * std::cout << summary.report();
+ * @endcode
+ */
+
+#ifndef FINMODEL_BATCH_RUN_H
+#define FINMODEL_BATCH_RUN_H
+
+#include "types/common_types.h"
+#include "orchestration/result_precision.h"
+#include "unified/validation_rule_engine.h"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Where a batch run's results go
+ */
+enum class BatchOutput {
+    NONE,       ///< Only counted
+    COLUMNAR,   ///< ColumnarResultWriter file per entity
+    DELTA,      ///< DeltaResultSet file per entity, against the first scenario
+    DATABASE    ///< run_log / unified_result through a ResultWriter
+};
+
+/**
+ * @brief Everything a batch run needs (see the file comment for the JSON form)
+ */
+struct RunManifest {
+    std::string database;
+    std::string template_code;
+    std::vector<EntityID> entities;
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<PeriodID> period_ids;
+    std::map<std::string, double> opening_balances;
+    unified::ValidationPolicy validation;
+    std::vector<std::string> outputs;   ///< PeriodRunner::set_output_selection() (empty: every line item)
+
+    BatchOutput output = BatchOutput::NONE;
+    /// COLUMNAR, DELTA: file ("{entity}" is replaced, required for several entities); DATABASE: results database (empty: database)
+    std::string output_path;
+    ResultPrecision precision;     ///< COLUMNAR: line items stored as float32
+
+    std::string snapshot_path;     ///< Input snapshot compiled before the run (empty: read database directly)
+    /// Read (and write DATABASE results) on an in-memory copy of the snapshot or database;
+    /// its new run_log / unified_result rows are written back to database when the run ends
+    bool in_memory = false;
+    std::string result_cache_dir;  ///< ResultCache directory (empty: no cache)
+    size_t threads = 0;            ///< Including the caller (0: hardware concurrency, 1: sequential)
+    /// Place workers by NUMA node (PeriodRunner::set_numa_placement()); with a snapshot
+    /// (and not in_memory) each further node reads its own copy, <snapshot>.node<N>
+    bool numa = false;
+    size_t jobs_per_chunk = 256;   ///< Jobs per run_jobs() call: bounds the results held at once
+
+    /**
+     * @throws std::invalid_argument on malformed JSON, a missing field or an invalid value
+     */
+    static RunManifest from_json(const std::string& json);
+
+    /**
+     * @throws std::invalid_argument if the file can't be read or from_json() fails
+     */
+    static RunManifest load(const std::string& path);
+
+    /**
+     * @brief "1-3,7" → 1 2 3 7
+     * @throws std::invalid_argument on a malformed list
+     */
+    static std::vector<int> parse_ids(const std::string& text);
+
+    /**
+     * @throws std::invalid_argument if there is nothing to run or the output is ambiguous
+     */
+    void validate() const;
+};
+
+/**
+ * @brief Counters of a finished batch run
+ */
+struct BatchSummary {
+    size_t runs = 0;              ///< Entity × scenario runs
+    size_t failed_runs = 0;       ///< Runs whose calculation reported errors
+    size_t periods = 0;           ///< Periods calculated
+    size_t line_items = 0;        ///< Line item values calculated
+    size_t rows_written = 0;      ///< COLUMNAR, DELTA: (scenario, period) rows; DATABASE: unified_result rows
+    double snapshot_seconds = 0.0;   ///< Input snapshot and in-memory copy
+    double run_seconds = 0.0;     ///< Calculation and output, without the snapshot
+    double write_back_seconds = 0.0; ///< in_memory: writing the results back to the database
+    size_t numa_nodes = 1;        ///< Nodes the workers were placed on
+    size_t stolen_remote = 0;     ///< Jobs a worker stole from another NUMA node
+    std::string first_error;
+
+    // DEFERRED validation with a COLUMNAR output: rules checked on the written files
+    size_t deferred_checks = 0;
+    size_t deferred_failures = 0;
+
+    double runs_per_second() const { return run_seconds > 0.0 ? runs / run_seconds : 0.0; }
+    double line_items_per_second() const { return run_seconds > 0.0 ? line_items / run_seconds : 0.0; }
+
+    /**
+     * @brief Human-readable throughput summary (several lines)
+     */
+    std::string report() const;
+};
+
+/**
+ * @brief Runs a manifest's jobs on the parallel runner into its output
+ */
+class BatchRunner {
+public:
+    /// Called after each chunk of jobs with the counters so far
+    using ProgressCallback = std::function<void(const BatchSummary&)>;
+
+    /**
+     * @throws std::invalid_argument if the manifest is invalid
+     */
+    explicit BatchRunner(RunManifest manifest);
+
+    void set_progress(ProgressCallback progress) { progress_ = std::move(progress); }
+
+    /**
+     * @brief Compile the snapshot (if any), run every job and close the output
+     * @throws database::DatabaseException if the inputs can't be read or the results stored
+     * @throws std::runtime_error if an output file can't be written
+     */
+    BatchSummary run();
+
+private:
+    RunManifest manifest_;
+    ProgressCallback progress_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_BATCH_RUN_H
@@ -0,0 +1,157 @@
+/**
+ * @file budgeted_results.h
+ * @brief Scenario results held within a memory budget, spilled to a columnar file beyond it
+ *
+ * run_multiple_scenarios() keeps every scenario's MultiPeriodResults until
+ * it returns, so a large enough sweep runs out of memory. BudgetedResults
+ * takes finished scenarios one at a time instead:
+ *
+ * - each run is added to a ResultAggregator (statistics and quantile
+ *   sketches of every line item and period stay resident, whatever the
+ *   budget)
+ * - its results are kept in memory and their bytes counted (bytes())
+ * - once the resident results pass the budget, all of them are appended
+ *   to a columnar result file (ColumnarResultWriter) and dropped; only a
+ *   summary of each spilled run (periods, success, errors) is kept
+ *
+ * Spilled scenarios are read back from the file after close() with a
+ * ColumnarResultReader. Spills are counted in spilled_bytes() and in the
+ * process metrics (finmodel_result_spilled_bytes_total,
+ * finmodel_result_spilled_scenarios_total).
+ *
+ * Usage:
+ * @code
+ * ResultBudget budget;
+ * budget.memory_bytes = 512u << 20;
+ * budget.spill_path = "sweep_42.fmcr";
+ * BudgetedResults results(periods, budget, ResultAggregator(periods, 0.01, {"CASH"}));
+ * runner.collect_scenarios("E", scenario_ids, periods, opening, "TEMPLATE", results);
+ * auto file = results.close();   // Set if anything was spilled
+ * @endcode
+ */
+
+#ifndef FINMODEL_BUDGETED_RESULTS_H
+#define FINMODEL_BUDGETED_RESULTS_H
+
+#include "types/common_types.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/result_aggregator.h"
+#include "orchestration/result_precision.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Memory budget of a run's results
+ */
+struct ResultBudget {
+    size_t memory_bytes = 0;        ///< Resident result bytes before they spill (0: no limit)
+    std::string spill_path;         ///< Columnar file spilled scenarios are written to
+    size_t rows_per_group = 8192;   ///< Of the spill file (rows buffered by its writer)
+    ResultPrecision precision;      ///< Of the spill file
+};
+
+/**
+ * @brief What is kept of a scenario once its results spilled
+ */
+struct SpilledScenario {
+    ScenarioID scenario_id = 0;
+    size_t periods = 0;             ///< Results written (rows of the spill file)
+    size_t bytes = 0;               ///< Resident size before the spill (BudgetedResults::bytes())
+    bool success = true;
+    std::vector<std::string> errors;
+};
+
+/**
+ * @brief Results of many scenarios within a memory budget (not thread-safe)
+ */
+class BudgetedResults {
+public:
+    /**
+     * @param period_ids Periods of every run, in result order
+     * @param statistics Aggregator every run is added to (usually empty)
+     * @throws std::invalid_argument for a budget without a spill path
+     */
+    BudgetedResults(std::vector<PeriodID> period_ids, ResultBudget budget, ResultAggregator statistics);
+
+    /**
+     * @brief Close the spill file if close() wasn't called (errors are dropped)
+     */
+    ~BudgetedResults();
+
+    BudgetedResults(const BudgetedResults&) = delete;
+    BudgetedResults& operator=(const BudgetedResults&) = delete;
+
+    /**
+     * @brief Add a finished scenario, spilling the resident ones if the budget is passed
+     * @throws std::invalid_argument if the scenario was already added or after close()
+     * @throws std::runtime_error if the spill file can't be written
+     */
+    void add(ScenarioID scenario_id, MultiPeriodResults&& results);
+
+    /**
+     * @brief Resident size of results: values, messages and per-period overhead
+     *
+     * Schemas are shared between runs and not counted.
+     */
+    static size_t bytes(const MultiPeriodResults& results);
+
+    const ResultAggregator& statistics() const { return statistics_; }
+    const std::vector<PeriodID>& period_ids() const { return period_ids_; }
+    const ResultBudget& budget() const { return budget_; }
+
+    /// Scenarios still in memory
+    const std::map<ScenarioID, MultiPeriodResults>& resident() const { return resident_; }
+
+    /// Scenarios whose results are in the spill file, in spill order
+    const std::vector<SpilledScenario>& spilled() const { return spilled_; }
+
+    size_t scenarios() const { return added_.size(); }   ///< Added so far
+    size_t resident_bytes() const { return resident_bytes_; }
+    size_t peak_resident_bytes() const { return peak_bytes_; }   ///< Most held at once (at most budget + one run)
+    size_t spilled_bytes() const { return spilled_bytes_; }      ///< Resident size of the spilled results
+
+    /**
+     * @brief Write out and close the spill file
+     * @return The file, if anything was spilled
+     * @throws std::runtime_error on write errors or if already closed
+     */
+    std::optional<ColumnarFileInfo> close();
+
+    /**
+     * @brief Move the resident results out (they no longer count against the budget)
+     */
+    std::map<ScenarioID, MultiPeriodResults> take_resident();
+
+private:
+    std::vector<PeriodID> period_ids_;
+    ResultBudget budget_;
+    ResultAggregator statistics_;
+    std::map<ScenarioID, MultiPeriodResults> resident_;
+    std::map<ScenarioID, size_t> resident_sizes_;
+    std::vector<SpilledScenario> spilled_;
+    std::set<ScenarioID> added_;
+    std::unique_ptr<ColumnarResultWriter> writer_;   ///< Opened by the first spill
+    size_t resident_bytes_ = 0;
+    size_t peak_bytes_ = 0;
+    size_t spilled_bytes_ = 0;
+    bool closed_ = false;
+
+    /**
+     * @brief Append every resident scenario to the spill file and drop it
+     */
+    void spill();
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_BUDGETED_RESULTS_H
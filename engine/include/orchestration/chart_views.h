@@ -0,0 +1,153 @@
+/**
+ * @file chart_views.h
+ * @brief Pre-aggregated chart views over columnar results
+ *
+ * A chart of 360 periods × 1000 scenarios has 360,000 points, far more
+ * than a chart is wide. Shipping them all makes dashboard latency grow
+ * with the sweep; these views reduce a line item to what is drawn:
+ *
+ * - fan_chart(): quantiles across scenarios per period (p5..p95 bands)
+ * - downsample(): one scenario's series reduced to at most N points by
+ *   Largest-Triangle-Three-Buckets, which keeps peaks and troughs
+ * - yearly(): one scenario's periods aggregated to years (sum for flows,
+ *   last for balances, mean for rates)
+ *
+ * Each view reads one line item column of the file. ChartViewCache keeps
+ * rendered views by (snapshot, query), least recently used evicted first:
+ * result files don't change once written.
+ *
+ * Usage:
+ * @code
+ * ColumnarResultReader reader("run_42.fmcr");
+ * auto fan = ChartViews::fan_chart(reader, "CASH", {0.05, 0.5, 0.95});
+ * auto line = ChartViews::downsample(reader, "CASH", 7, 400);
+ * @endcode
+ */
+
+#ifndef FINMODEL_CHART_VIEWS_H
+#define FINMODEL_CHART_VIEWS_H
+
+#include "types/common_types.h"
+#include "orchestration/columnar_results.h"
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Quantiles of a line item across scenarios, per period
+ */
+struct FanChart {
+    std::string line_item;
+    std::vector<double> quantiles;              ///< Probabilities, ascending
+    std::vector<PeriodID> period_ids;           ///< Ascending
+    std::vector<std::vector<double>> bands;     ///< Per quantile, value per period (NaN: no scenario has one)
+    std::vector<size_t> scenarios;              ///< Scenarios with a value, per period
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief Points of one scenario's line item
+ */
+struct ChartSeries {
+    std::string line_item;
+    ScenarioID scenario_id = 0;
+    std::vector<int> x;                         ///< Period IDs, or years for yearly()
+    std::vector<double> values;
+    size_t source_points = 0;                   ///< Points before reduction
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief How yearly() combines the periods of a year
+ */
+enum class YearAggregate {
+    SUM,    ///< Flows (revenue, cash flow)
+    LAST,   ///< Balances (cash, debt): value of the year's last period
+    MEAN    ///< Rates and ratios
+};
+
+/**
+ * @brief Parse "sum", "last" or "mean"
+ * @throws std::invalid_argument for anything else
+ */
+YearAggregate year_aggregate_from_string(const std::string& name);
+
+/**
+ * @brief Chart views of columnar result files
+ */
+class ChartViews {
+public:
+    /**
+     * @brief Quantiles across scenarios (linear interpolation between order statistics)
+     * @param quantiles Probabilities in [0, 1]
+     * @throws std::invalid_argument for a probability outside [0, 1]
+     * @throws std::out_of_range for an unknown line item
+     */
+    static FanChart fan_chart(const ColumnarResultReader& reader, const std::string& code,
+                              std::vector<double> quantiles);
+
+    /**
+     * @brief A scenario's series reduced to at most max_points (LTTB); periods without a value are left out
+     * @throws std::out_of_range for an unknown line item
+     */
+    static ChartSeries downsample(const ColumnarResultReader& reader, const std::string& code,
+                                  ScenarioID scenario_id, size_t max_points);
+
+    /**
+     * @brief A scenario's series aggregated per year
+     * @param year_of Year of each period (periods without one are left out)
+     * @throws std::out_of_range for an unknown line item
+     */
+    static ChartSeries yearly(const ColumnarResultReader& reader, const std::string& code, ScenarioID scenario_id,
+                              const std::unordered_map<PeriodID, int>& year_of, YearAggregate aggregate);
+
+    /**
+     * @brief Indexes of the points LTTB keeps (first and last always)
+     * @param x Ascending
+     * @param threshold Points to keep (below 3, or at least x.size(): all)
+     */
+    static std::vector<size_t> lttb(const std::vector<double>& x, const std::vector<double>& y, size_t threshold);
+};
+
+/**
+ * @brief Rendered views by key, least recently used evicted first (thread-safe)
+ */
+class ChartViewCache {
+public:
+    explicit ChartViewCache(size_t capacity) : capacity_(capacity) {}
+
+    /**
+     * @brief Cached view of key, or render() cached (render() runs unlocked; exceptions pass through)
+     */
+    std::string get(const std::string& key, const std::function<std::string()>& render);
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t size() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::string view;
+    };
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::list<Entry> entries_;    ///< Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> by_key_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_CHART_VIEWS_H
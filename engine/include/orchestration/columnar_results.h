@@ -0,0 +1,270 @@
+/**
+ * @file columnar_results.h
+ * @brief Columnar result files for large scenario sweeps
+ *
+ * A sweep of 1000 scenarios × 120 periods × 500 line items is 60M values;
+ * as database rows (ResultWriter) that is slow to write and to read back a
+ * single line item. A columnar result file stores one run instead:
+ *
+ * - Rows are (scenario, period) pairs, cut into row groups
+ * - Line item codes are stored once, in a dictionary; each row group holds
+ *   one chunk per line item
+ * - Value chunks are XOR-compressed against the previous value: unchanged
+ *   values take one byte, slowly moving ones a few
+ * - Every chunk has min/max/NaN-count statistics in the footer, so range
+ *   reads skip row groups that can't match
+ * - A ResultPrecision can store chosen line items as float32, halving
+ *   their chunks; they read back as the float32 value widened to double
+ *
+ * Reading a line item touches the footer, the key columns and that
+ * item's chunks only.
+ *
+ * Usage:
+ * @code
+ * ColumnarResultWriter writer("run_42.fmcr");
+ * for (auto& [scenario_id, results] : all_results) {
+ *     writer.append(scenario_id, period_ids, results);
+ * }
+ * auto file = writer.close();
+ * ColumnarResultWriter::record_snapshot(*db, run_id, file);
+ *
+ * ColumnarResultReader reader("run_42.fmcr");
+ * auto cash = reader.read("CASH");   // Every scenario and period
+ * @endcode
+ *
+ * Files use the platform's (little-endian) byte order.
+ */
+
+#ifndef FINMODEL_COLUMNAR_RESULTS_H
+#define FINMODEL_COLUMNAR_RESULTS_H
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/result_precision.h"
+#include "unified/result_row.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Summary of a closed columnar result file
+ */
+struct ColumnarFileInfo {
+    std::string path;
+    size_t rows = 0;          ///< (scenario, period) rows
+    size_t line_items = 0;    ///< Dictionary size
+    size_t row_groups = 0;
+    uint64_t bytes = 0;       ///< File size
+};
+
+/**
+ * @brief Position and statistics of one chunk (footer entry)
+ */
+struct ColumnarChunk {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    double min = 0.0;         ///< Over finite values (value chunks only)
+    double max = 0.0;
+    uint32_t nan_count = 0;   ///< Non-finite or missing values
+};
+
+/**
+ * @brief Rows of one line item read from a columnar file
+ */
+struct ColumnarSeries {
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<PeriodID> period_ids;
+    std::vector<double> values;   ///< NaN where the row has no value
+
+    size_t size() const { return values.size(); }
+};
+
+/**
+ * @brief Rows of one row group with several line items
+ */
+struct ColumnarBlock {
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<PeriodID> period_ids;
+    std::vector<std::vector<double>> columns;   ///< Per requested line item, NaN where a row has no value
+
+    size_t size() const { return scenario_ids.size(); }
+};
+
+/**
+ * @brief Writes results to a columnar file, one row group at a time
+ *
+ * Only the current row group is buffered. Line items may differ between
+ * results (e.g. action overlays add some): a row without a line item
+ * reads back as NaN.
+ */
+class ColumnarResultWriter {
+public:
+    /**
+     * @brief Create the file
+     * @param path File to write (replaced if it exists)
+     * @param rows_per_group Rows buffered before a row group is written
+     * @param precision Line items stored as float32 (default: none)
+     * @throws std::runtime_error if the file can't be created
+     */
+    explicit ColumnarResultWriter(const std::string& path, size_t rows_per_group = 8192,
+                                  ResultPrecision precision = {});
+
+    /**
+     * @brief Close the file if close() wasn't called (errors are dropped)
+     */
+    ~ColumnarResultWriter();
+
+    ColumnarResultWriter(const ColumnarResultWriter&) = delete;
+    ColumnarResultWriter& operator=(const ColumnarResultWriter&) = delete;
+
+    /**
+     * @brief Append one row
+     */
+    void append(ScenarioID scenario_id, PeriodID period_id, const unified::ResultRow& values);
+
+    /**
+     * @brief Append every period of a scenario's run
+     * @param period_ids Period of each result, as passed to run_periods()
+     * @throws std::invalid_argument if there are more results than periods
+     */
+    void append(ScenarioID scenario_id, const std::vector<PeriodID>& period_ids,
+                const MultiPeriodResults& results);
+
+    /**
+     * @brief Write the last row group and the footer
+     * @throws std::runtime_error on write errors or if already closed
+     */
+    ColumnarFileInfo close();
+
+    /**
+     * @brief Reference a closed file from run_output_snapshot
+     * @return snapshot_id
+     *
+     * Stored with output_type 'results' and format 'columnar' (migration
+     * 006_columnar_snapshots.sql); json_data holds the file summary.
+     */
+    static int64_t record_snapshot(database::IDatabase& db, int64_t run_id, const ColumnarFileInfo& info);
+
+private:
+    struct RowGroup {
+        uint32_t rows = 0;
+        ColumnarChunk scenarios;
+        ColumnarChunk periods;
+        std::vector<std::pair<uint32_t, ColumnarChunk>> columns;   ///< (code index, chunk)
+    };
+
+    std::string path_;
+    std::ofstream file_;
+    size_t rows_per_group_;
+    ResultPrecision precision_;
+    uint64_t offset_ = 0;
+    size_t rows_ = 0;
+    bool closed_ = false;
+
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, uint32_t> code_index_;
+    std::vector<uint8_t> float32_;   ///< Per code index: stored as float32
+    std::vector<RowGroup> groups_;
+
+    // Current row group, by column
+    std::vector<ScenarioID> scenario_ids_;
+    std::vector<PeriodID> period_ids_;
+    std::vector<std::vector<double>> values_;   ///< Per code index
+
+    void write_group();
+    ColumnarChunk write_chunk(const std::vector<uint8_t>& bytes);
+};
+
+/**
+ * @brief Reads line items from a columnar result file
+ *
+ * Construction reads the footer only; each read() seeks to the chunks it
+ * needs.
+ */
+class ColumnarResultReader {
+public:
+    /**
+     * @brief Open a file and read its footer
+     * @throws std::runtime_error if the file is missing or not a columnar result file
+     */
+    explicit ColumnarResultReader(const std::string& path);
+
+    /**
+     * @brief Number of (scenario, period) rows
+     */
+    size_t row_count() const { return rows_; }
+
+    /**
+     * @brief Number of row groups
+     */
+    size_t row_group_count() const { return groups_.size(); }
+
+    /**
+     * @brief Line item codes in the file
+     */
+    const std::vector<std::string>& line_items() const { return codes_; }
+
+    /**
+     * @brief Whether a line item is stored as float32 (see ResultPrecision)
+     * @throws std::out_of_range if the file has no such line item
+     */
+    bool is_float32(const std::string& code) const;
+
+    /**
+     * @brief All rows of a line item
+     * @throws std::out_of_range if the file has no such line item
+     */
+    ColumnarSeries read(const std::string& code) const;
+
+    /**
+     * @brief Rows whose value lies in [min_value, max_value]
+     *
+     * Row groups whose chunk statistics exclude the range are skipped
+     * without being read.
+     * @throws std::out_of_range if the file has no such line item
+     */
+    ColumnarSeries read_where(const std::string& code, double min_value, double max_value) const;
+
+    /**
+     * @brief One row group of several line items (keys decoded once)
+     * @param group Row group, below row_group_count()
+     * @param codes Line items, one column each
+     * @throws std::out_of_range for an unknown line item or row group
+     */
+    ColumnarBlock read_group(size_t group, const std::vector<std::string>& codes) const;
+
+    /**
+     * @brief Bytes read from the file so far (footer included)
+     */
+    uint64_t bytes_read() const { return bytes_read_; }
+
+private:
+    struct RowGroup {
+        uint32_t rows = 0;
+        ColumnarChunk scenarios;
+        ColumnarChunk periods;
+        std::unordered_map<uint32_t, ColumnarChunk> columns;   ///< Code index → chunk
+    };
+
+    mutable std::ifstream file_;
+    mutable uint64_t bytes_read_ = 0;
+    size_t rows_ = 0;
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, uint32_t> code_index_;
+    std::vector<uint8_t> float32_;   ///< Per code index (version 1 files: all double)
+    std::vector<RowGroup> groups_;
+
+    std::vector<uint8_t> read_chunk(const ColumnarChunk& chunk) const;
+    ColumnarSeries read_rows(const std::string& code, bool filter, double min_value, double max_value) const;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_COLUMNAR_RESULTS_H
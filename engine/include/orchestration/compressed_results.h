@@ -0,0 +1,163 @@
+/**
+ * @file compressed_results.h
+ * @brief Scenario results kept in memory as XOR-compressed line item series
+ *
+ * A projected line item moves smoothly from period to period: consecutive
+ * doubles share their sign, exponent and leading mantissa bits, and many
+ * (balances between flows, flat drivers) repeat exactly. A
+ * CompressedResultSet stores each line item's periods as one series,
+ * encoded as in Gorilla (Pelkonen et al., VLDB 2015): every value is
+ * XORed with the previous one and only the bits that differ are kept, in
+ * the window of the previous value when they fit. A repeated value costs
+ * one bit, a slowly drifting one typically 15-35 bits instead of 64.
+ *
+ * Series are cut into blocks of BLOCK_PERIODS periods, each starting
+ * with a raw value, so value() decodes one block rather than the whole
+ * horizon, and blocks decode independently. Values round-trip bit for
+ * bit (NaN payloads and -0.0 included), except line items a
+ * ResultPrecision stores as float32: those are rounded to float32 first,
+ * which clears the low 29 mantissa bits and roughly halves their series.
+ *
+ * Aggregations stream over a line item with scan(), which decodes one
+ * run's series at a time into a reused buffer:
+ * @code
+ * CompressedResultSet sweep(periods);
+ * for (ScenarioID s = 1; s <= 10000; ++s) {
+ *     sweep.add(s, runner.run_periods("A", s, periods, opening, "CORP"));
+ * }
+ * std::vector<core::QuantileSketch> cash(periods.size());
+ * sweep.scan("CASH", [&](ScenarioID, std::span<const double> series) {
+ *     for (size_t p = 0; p < series.size(); ++p) cash[p].add(series[p]);
+ * });
+ * @endcode
+ */
+
+#ifndef FINMODEL_COMPRESSED_RESULTS_H
+#define FINMODEL_COMPRESSED_RESULTS_H
+
+#include "types/common_types.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/result_precision.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Runs over the same periods, each line item's values XOR-encoded
+ *
+ * Line items only some runs have (action overlays) are missing (NaN)
+ * elsewhere. Not thread-safe for add(); reads may run concurrently.
+ */
+class CompressedResultSet {
+public:
+    /// Periods per independently decodable block
+    static constexpr size_t BLOCK_PERIODS = 64;
+
+    /**
+     * @param period_ids Periods of every run, in result order
+     * @param precision Line items rounded to float32 when stored (default: none)
+     */
+    explicit CompressedResultSet(std::vector<PeriodID> period_ids, ResultPrecision precision = {});
+
+    /**
+     * @brief Compress and store a run
+     * @throws std::invalid_argument if it has more results than periods, or the scenario is already stored
+     */
+    void add(ScenarioID scenario_id, const MultiPeriodResults& results);
+
+    const std::vector<PeriodID>& period_ids() const { return period_ids_; }
+    const std::vector<std::string>& line_items() const { return codes_; }
+
+    /**
+     * @brief Whether a line item is stored rounded to float32
+     * @throws std::out_of_range for an unknown line item
+     */
+    bool is_float32(const std::string& code) const { return float32_[code_index(code)] != 0; }
+
+    /**
+     * @brief Scenarios of the stored runs, in the order they were added
+     */
+    std::vector<ScenarioID> scenario_ids() const;
+
+    /**
+     * @brief Value of a cell (decodes the block holding it)
+     * @return NaN if the run has no value there
+     * @throws std::out_of_range for an unknown scenario, line item or period
+     */
+    double value(ScenarioID scenario_id, const std::string& code, PeriodID period_id) const;
+
+    /**
+     * @brief All periods of a line item in one run (NaN where it has no value)
+     * @throws std::out_of_range for an unknown scenario or line item
+     */
+    std::vector<double> series(ScenarioID scenario_id, const std::string& code) const;
+
+    /**
+     * @brief Decode a line item of every run, in the order they were added
+     *
+     * The span holds one value per period (NaN where missing) and is only
+     * valid during the call.
+     *
+     * @throws std::out_of_range for an unknown line item
+     */
+    void scan(const std::string& code,
+              const std::function<void(ScenarioID scenario_id, std::span<const double> series)>& visit) const;
+
+    /**
+     * @brief Dense results of a run again (line items in line_items() order)
+     * @throws std::out_of_range for an unknown scenario
+     */
+    MultiPeriodResults expand(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Bytes held by encoded series and block offsets (codes and messages excluded)
+     */
+    size_t bytes() const;
+
+    /**
+     * @brief Bytes the same runs take as dense rows (one double per line item and period)
+     */
+    size_t dense_bytes() const;
+
+private:
+    struct Run {
+        ScenarioID scenario_id = 0;
+        size_t width = 0;                ///< Line items when added (later codes are missing)
+        std::vector<uint64_t> bits;      ///< Series after series, blocks after blocks, MSB first
+        std::vector<uint32_t> offsets;   ///< Bit offset of code × blocks + block
+        bool success = true;
+        std::vector<uint8_t> period_success;   ///< One per period the run calculated
+        std::vector<std::string> errors;
+        unified::Diagnostics warnings;
+    };
+
+    uint32_t intern(const std::string& code);
+    const Run& find(ScenarioID scenario_id) const;
+    uint32_t code_index(const std::string& code) const;
+    size_t blocks() const { return (period_ids_.size() + BLOCK_PERIODS - 1) / BLOCK_PERIODS; }
+
+    /// Decode one block of a code into out (MISSING for codes the run doesn't have)
+    void decode_block(const Run& run, size_t code, size_t block, double* out) const;
+    void decode_series(const Run& run, size_t code, double* out) const;
+
+    std::vector<PeriodID> period_ids_;
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, uint32_t> code_index_;
+    ResultPrecision precision_;
+    std::vector<uint8_t> float32_;   ///< Per code index
+
+    std::vector<Run> runs_;
+    std::unordered_map<ScenarioID, size_t> run_index_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_COMPRESSED_RESULTS_H
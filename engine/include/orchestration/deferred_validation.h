@@ -0,0 +1,80 @@
+/**
+ * @file deferred_validation.h
+ * @brief Validation rules checked after a sweep, on its columnar results
+ *
+ * With ValidationMode::DEFERRED a PeriodRunner checks nothing while it
+ * runs; validate_columnar() then checks every (scenario, period) row of
+ * the ColumnarResultWriter file in one batch. [t-k] references read the
+ * same scenario's row k periods earlier, so the first periods of a
+ * scenario skip rules that look further back than the file goes.
+ *
+ * Usage:
+ * @code
+ * DeferredValidationReport report = validate_columnar(db, ColumnarResultReader("sweep.frc"), "TEMPLATE");
+ * if (report.has_errors()) { ... }
+ * @endcode
+ */
+
+#pragma once
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "orchestration/columnar_results.h"
+#include "unified/validation_rule_engine.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Outcome of validate_columnar()
+ */
+struct DeferredValidationReport {
+    std::vector<ScenarioID> scenario_ids;           ///< Of each row
+    std::vector<PeriodID> period_ids;               ///< Of each row
+    std::vector<unified::ColumnRuleResult> rules;   ///< Failing rows and first messages per rule
+
+    size_t rows() const { return scenario_ids.size(); }
+
+    /**
+     * @brief Rule evaluations (rows each rule applied to)
+     */
+    size_t checks() const;
+
+    /**
+     * @brief Check if any rule failed with ERROR severity
+     */
+    bool has_errors() const;
+
+    /**
+     * @brief Rules reading values the file doesn't have (not checked)
+     */
+    std::vector<std::string> skipped_rules() const;
+};
+
+/**
+ * @brief Check a template's validation rules against written results
+ * @param db Database with the template's rules
+ * @param results Columnar result file (rows of a scenario in period order)
+ * @param template_code Template whose rules are checked
+ * @param skip_warnings True to skip WARNING rules
+ * @param max_messages Failure messages kept per rule
+ *
+ * Rules are evaluated a column at a time over every row of the file
+ * (ValidationRuleEngine::execute_rules_columnar()); only the line items
+ * they read are loaded. A rule applies to a row when all its required
+ * line items have values there, as in the calculation.
+ */
+DeferredValidationReport validate_columnar(
+    std::shared_ptr<database::IDatabase> db,
+    const ColumnarResultReader& results,
+    const std::string& template_code,
+    bool skip_warnings = false,
+    size_t max_messages = 10
+);
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,175 @@
+/**
+ * @file delta_results.h
+ * @brief Scenario results stored as sparse deltas against a baseline run
+ *
+ * In a sensitivity sweep most (line item, period) cells of a variant equal
+ * the baseline's: a driver change only moves the formulas downstream of
+ * it. A DeltaResultSet keeps the baseline dense and each variant as a
+ * bitmap of its changed cells (one bit per cell) plus the changed values,
+ * instead of a full MultiPeriodResults per variant. A variant that moves
+ * 5% of its cells takes about 1/64 + 5% of its dense size.
+ *
+ * Comparison views read changes() - only the cells that differ, with
+ * their baseline value - without expanding a variant; expand() rebuilds
+ * the dense results. save() and load() keep a set in one file.
+ *
+ * Usage:
+ * @code
+ * DeltaResultSet sweep(periods, runner.run_periods("A", 1, periods, opening, "CORP"), 1);
+ * for (ScenarioID s = 2; s <= 10000; ++s) {
+ *     sweep.add(s, runner.run_periods("A", s, periods, opening, "CORP"));
+ * }
+ * for (const auto& cell : sweep.changes(42)) {
+ *     std::cout << cell.code << " " << cell.period_id << ": " << cell.baseline << " -> " << cell.value << "\n";
+ * }
+ * sweep.save("sweep_A.fmdr");
+ * @endcode
+ */
+
+#ifndef FINMODEL_DELTA_RESULTS_H
+#define FINMODEL_DELTA_RESULTS_H
+
+#include "types/common_types.h"
+#include "orchestration/period_runner.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief One cell of a variant that differs from the baseline
+ */
+struct ResultDelta {
+    PeriodID period_id = 0;
+    std::string code;
+    double baseline = 0.0;   ///< NaN if the baseline has no value
+    double value = 0.0;      ///< NaN if the variant has no value
+};
+
+/**
+ * @brief A baseline run and its variants, each stored as changed cells
+ *
+ * Cells compare bit for bit: a value that is only numerically equal
+ * (-0.0 and 0.0) is a change. Line items only some runs have (action
+ * overlays) are missing cells elsewhere.
+ */
+class DeltaResultSet {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    /**
+     * @param period_ids Periods of every run, in result order
+     * @param baseline Results the variants are compared with
+     * @param baseline_id Scenario of the baseline (value() and expand() accept it)
+     * @throws std::invalid_argument if the baseline has more results than periods
+     */
+    DeltaResultSet(std::vector<PeriodID> period_ids, const MultiPeriodResults& baseline, ScenarioID baseline_id = 0);
+
+    /**
+     * @brief Store a variant's changed cells
+     * @throws std::invalid_argument if it has more results than periods, or the scenario is already stored
+     */
+    void add(ScenarioID scenario_id, const MultiPeriodResults& results);
+
+    const std::vector<PeriodID>& period_ids() const { return period_ids_; }
+    const std::vector<std::string>& line_items() const { return codes_; }
+    ScenarioID baseline_id() const { return baseline_id_; }
+
+    /**
+     * @brief Scenarios of the stored variants, in the order they were added
+     */
+    std::vector<ScenarioID> variant_ids() const;
+
+    /**
+     * @brief Value of a cell (the baseline's unless the variant changed it)
+     * @return NaN if the run has no value there
+     * @throws std::out_of_range for an unknown scenario, line item or period
+     */
+    double value(ScenarioID scenario_id, const std::string& code, PeriodID period_id) const;
+
+    /**
+     * @brief Cells a variant changed, by period then line item
+     * @throws std::out_of_range for an unknown scenario
+     */
+    std::vector<ResultDelta> changes(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Number of cells a variant changed
+     * @throws std::out_of_range for an unknown scenario
+     */
+    size_t changed_cells(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Dense results of a run again (line items in line_items() order)
+     * @throws std::out_of_range for an unknown scenario
+     */
+    MultiPeriodResults expand(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Bytes held by values, bitmaps and indexes (codes and messages excluded)
+     */
+    size_t bytes() const;
+
+    /**
+     * @brief Bytes the same runs take as dense rows (one double per line item and period)
+     */
+    size_t dense_bytes() const;
+
+    /**
+     * @brief Write the set to a file (replaced)
+     * @throws std::runtime_error on write errors
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @throws std::runtime_error if the file is missing, damaged or of another format version
+     */
+    static DeltaResultSet load(const std::string& path);
+
+private:
+    struct Variant {
+        ScenarioID scenario_id = 0;
+        size_t width = 0;                ///< Line items when added: cell = period × width + line item
+        std::vector<uint64_t> bitmap;    ///< Changed cells
+        std::vector<uint32_t> ranks;     ///< Changed cells before each block of RANK_WORDS words
+        std::vector<double> values;      ///< Changed cells' values, in cell order
+        bool success = true;
+        std::vector<uint8_t> period_success;   ///< One per period the run calculated
+        std::vector<std::string> errors;
+        unified::Diagnostics warnings;
+    };
+
+    static constexpr size_t RANK_WORDS = 8;
+
+    DeltaResultSet() = default;
+
+    uint32_t intern(const std::string& code);
+    /// Dense cells of results over the current dictionary (missing: MISSING)
+    std::vector<double> cells(const MultiPeriodResults& results);
+    double baseline_cell(size_t period, size_t code) const;
+    double cell(const Variant& variant, size_t period, size_t code) const;
+    const Variant* find(ScenarioID scenario_id) const;   ///< Null: the baseline
+    static void build_ranks(Variant& variant);
+
+    std::vector<PeriodID> period_ids_;
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, uint32_t> code_index_;
+
+    ScenarioID baseline_id_ = 0;
+    size_t baseline_width_ = 0;
+    std::vector<double> baseline_;   ///< period × baseline_width_ cells
+    Variant baseline_run_;           ///< Baseline's success and messages (no cells)
+
+    std::vector<Variant> variants_;
+    std::unordered_map<ScenarioID, size_t> variant_index_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_DELTA_RESULTS_H
@@ -0,0 +1,166 @@
+/**
+ * @file distributed_sweep.h
+ * @brief Scenario sweeps split across worker processes on several machines
+ *
+ * A coordinator cuts a sweep (entities × scenarios over the same periods)
+ * into shards of one entity and a range of scenarios, and publishes them in
+ * a work directory that every node mounts:
+ *
+ *   inputs.db            Input snapshot (InputSnapshot), written once
+ *   sweep.spec           Periods, template, opening balances
+ *   shards/NNNN.shard    Every shard (entity, scenarios)
+ *   pending/NNNN.shard   Shards waiting for a worker
+ *   running/NNNN.<name>  Claimed by worker <name> (mtime: last heartbeat)
+ *   done/NNNN.result     Worker, timing, row count, result file
+ *   failed/NNNN.*.error  One file per failed attempt
+ *   results/NNNN.fmcr    Columnar results of the shard (ColumnarResultWriter)
+ *   sweep.finished       Written once every shard is done or out of attempts
+ *
+ * Workers claim a shard by renaming it from pending/ to running/ (atomic on
+ * one file system), so no two workers run the same shard. The coordinator
+ * requeues shards whose attempt failed or whose worker stopped sending
+ * heartbeats, up to max_attempts per shard.
+ *
+ * Usage:
+ * @code
+ * // Coordinator
+ * SweepCoordinator coordinator("/shared/sweep_42");
+ * coordinator.prepare("finmodel.db", spec);
+ * auto shards = coordinator.wait();
+ * std::cout << SweepCoordinator::report(shards);
+ *
+ * // Each worker process, on any node
+ * SweepWorker("/shared/sweep_42", "node7-1").run();
+ * @endcode
+ */
+
+#ifndef FINMODEL_DISTRIBUTED_SWEEP_H
+#define FINMODEL_DISTRIBUTED_SWEEP_H
+
+#include "types/common_types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Work of a distributed sweep
+ */
+struct SweepSpec {
+    std::vector<EntityID> entities;
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<PeriodID> period_ids;
+    std::string template_code;
+    std::map<std::string, double> opening_balances;   ///< Opening balance sheet of every run
+    size_t scenarios_per_shard = 64;
+};
+
+/**
+ * @brief State of one shard, as seen by the coordinator
+ */
+struct ShardStatus {
+    enum class State { PENDING, RUNNING, DONE, FAILED };
+
+    int shard = 0;
+    EntityID entity_id;
+    size_t scenarios = 0;
+    State state = State::PENDING;
+    int attempts = 0;             ///< Failed attempts so far
+    std::string worker;           ///< Running or finished on
+    double seconds = 0.0;         ///< Run time of the successful attempt
+    size_t rows = 0;              ///< Result rows written
+    size_t failed_runs = 0;       ///< Scenarios whose calculation reported errors
+    std::string result_path;
+    std::string error;            ///< Last attempt's error
+};
+
+/**
+ * @brief Publishes shards, requeues failed ones and collects results
+ */
+class SweepCoordinator {
+public:
+    /**
+     * @brief Constructor
+     * @param work_dir Directory shared with the workers (created by prepare())
+     * @param max_attempts Attempts per shard before it is given up
+     * @param lease_seconds A running shard without heartbeat for this long is requeued
+     */
+    explicit SweepCoordinator(std::string work_dir, int max_attempts = 3, double lease_seconds = 600.0);
+
+    /**
+     * @brief Write the input snapshot, the spec and the shards
+     * @param source_db_path Database the inputs are copied from
+     * @param spec Sweep to run
+     * @return Number of shards
+     * @throws std::invalid_argument for empty sweeps or codes that can't be stored
+     * @throws std::runtime_error if the work directory already holds a sweep
+     */
+    size_t prepare(const std::string& source_db_path, const SweepSpec& spec);
+
+    /**
+     * @brief Requeue failed and abandoned shards, then report every shard
+     *
+     * Writes sweep.finished once no shard is pending or running.
+     */
+    std::vector<ShardStatus> poll();
+
+    /**
+     * @brief poll() until every shard is done or failed
+     * @param poll_seconds Time between polls
+     * @param timeout_seconds Give up waiting after this long (0: never)
+     * @return Last poll()
+     */
+    std::vector<ShardStatus> wait(double poll_seconds = 1.0, double timeout_seconds = 0.0);
+
+    /**
+     * @brief Per-shard table: state, attempts, worker, time, rows
+     */
+    static std::string report(const std::vector<ShardStatus>& shards);
+
+private:
+    std::string work_dir_;
+    int max_attempts_;
+    double lease_seconds_;
+};
+
+/**
+ * @brief Claims and runs shards of a work directory
+ */
+class SweepWorker {
+public:
+    /**
+     * @brief Constructor
+     * @param work_dir Directory prepared by a SweepCoordinator
+     * @param name Worker name, unique across the sweep (e.g. host and process)
+     * @param threads Scenario threads per shard (see PeriodRunner::set_scenario_parallel())
+     */
+    SweepWorker(std::string work_dir, std::string name, size_t threads = 1);
+
+    /**
+     * @brief Claim and run one pending shard
+     * @return False if no shard was pending
+     *
+     * A failed attempt leaves an error file for the coordinator instead of
+     * throwing.
+     */
+    bool run_one();
+
+    /**
+     * @brief Run shards until the sweep finishes
+     * @param idle_seconds Also stop after this long without a pending shard
+     * @return Shards run
+     */
+    size_t run(double idle_seconds = 30.0);
+
+private:
+    std::string work_dir_;
+    std::string name_;
+    size_t threads_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_DISTRIBUTED_SWEEP_H
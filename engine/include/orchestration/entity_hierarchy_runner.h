@@ -0,0 +1,229 @@
+/**
+ * @file entity_hierarchy_runner.h
+ * @brief Bottom-up rollup of a run over an entity hierarchy
+ *
+ * Calculates every leaf entity under a root (entity.parent_entity_id) with
+ * PeriodRunner, in parallel after set_parallel(), then sums children into
+ * their parents level by level up to the root (see
+ * docs/entity-hierarchy-rollup.md). Children of one template share a
+ * ResultSchema layout, so a parent's period is one element-wise sum of its
+ * children's value arrays rather than a merge of code → value maps.
+ *
+ * With set_currency_translation(), a child reporting in another currency
+ * than its parent (entity.base_currency) is translated into the parent's
+ * as it is summed: its line items times a per-item rate vector - stocks at
+ * the period's closing rate, the others at its average rate - in the same
+ * pass as the sum, and the translation difference on its net assets added
+ * to a CTA column.
+ *
+ * With set_eliminations(), intercompany positions are eliminated at the
+ * lowest parent holding both sides (see intercompany_elimination.h).
+ *
+ * With set_entity_lanes(), leaves are instead calculated K at a time as
+ * entity lanes (UnifiedEngine::calculate_entity_lanes()): one driver query
+ * per batch, and each period's plan evaluated for all K leaves at once.
+ *
+ * Example:
+ * @code
+ * EntityHierarchyRunner runner(db);
+ * runner.set_parallel(16, [&pool] { return pool.reader(); });
+ * auto group = runner.run_hierarchy("CORPORATE", scenario_id, periods, opening_by_entity, "UNIFIED");
+ * double revenue = group.at("CORPORATE").results[0].get_value("REVENUE");
+ * @endcode
+ */
+
+#ifndef FINMODEL_ENTITY_HIERARCHY_RUNNER_H
+#define FINMODEL_ENTITY_HIERARCHY_RUNNER_H
+
+#include "types/common_types.h"
+#include "core/thread_pool.h"
+#include "database/idatabase.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/intercompany_elimination.h"
+#include "fx/fx_provider.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Entities under a root, parents before children
+ */
+struct EntityTree {
+    struct Node {
+        EntityID code;
+        int parent = -1;            ///< Index of the parent node (-1 for the root)
+        int depth = 0;              ///< 0 for the root
+        std::vector<int> children;  ///< Indexes of the child nodes
+        std::string currency;       ///< entity.base_currency (load_currencies())
+    };
+
+    std::vector<Node> nodes;        ///< Ordered by depth; nodes[0] is the root
+
+    bool is_leaf(int node) const { return nodes[node].children.empty(); }
+
+    /**
+     * @brief Indexes of the leaf nodes
+     */
+    std::vector<int> leaves() const;
+
+    /**
+     * @brief Load the entities under a root from the entity table
+     * @param db Database connection
+     * @param root_code Code of the root entity
+     * @throws std::runtime_error if the root doesn't exist
+     */
+    static EntityTree load(database::IDatabase& db, const EntityID& root_code);
+
+    /**
+     * @brief Read every node's currency from entity.base_currency
+     * @throws std::runtime_error if the entity table has no base_currency
+     */
+    void load_currencies(database::IDatabase& db);
+};
+
+/**
+ * @brief How children in other currencies are translated during a rollup
+ *
+ * CTA (cumulative translation adjustment) of a child translated from
+ * another currency, with N its net assets item in local currency and
+ * a, c the average and closing rates of the periods:
+ * N_t × c_t − (N_1 × a_1 + Σ_{s=2..t} (N_s − N_{s−1}) × a_s), i.e. its net
+ * assets at the closing rate less their history at average rates. A
+ * parent's CTA is the sum of its children's (translated at closing rates).
+ */
+struct CurrencyTranslation {
+    bool enabled = false;
+    std::vector<std::string> stocks;   ///< Line items at the closing rate; others at the average rate
+    std::string net_assets;            ///< Stock whose translation difference is the CTA (empty: no CTA)
+    std::string cta_code = "CTA";      ///< Column added to parents with translated children
+};
+
+/**
+ * @brief Runs a template over an entity hierarchy and rolls results up
+ *
+ * Leaves are calculated; every other entity is the line item-wise sum of
+ * its children (so the root is the sum of all leaves). Parents without
+ * drivers of their own are the normal case: their drivers aren't read.
+ */
+class EntityHierarchyRunner {
+public:
+    /**
+     * @brief Constructor
+     * @param db Database connection (entity tree, and leaves when run sequentially)
+     */
+    explicit EntityHierarchyRunner(std::shared_ptr<database::IDatabase> db);
+
+    /**
+     * @brief Calculate leaves and aggregate parents on worker threads
+     * @param threads Threads including the caller (0: hardware concurrency, 1: sequential)
+     * @param connect Opens each leaf worker's connection (see PeriodRunner::set_scenario_parallel())
+     */
+    void set_parallel(size_t threads, PeriodRunner::ConnectionFactory connect);
+
+    /**
+     * @brief Calculate leaves as entity lanes, width leaves per batch
+     * @param width Lanes per batch (0 or 1: a PeriodRunner run per leaf)
+     *
+     * Leaves of a batch share their opening line items' codes. Lanes skip
+     * what PeriodRunner adds to the engine's calculation: validation rules
+     * aren't applied and templates registered on period_runner() aren't
+     * seen. A scenario with management actions, and a batch that fails
+     * (e.g. a template with circular references), run per leaf instead.
+     */
+    void set_entity_lanes(size_t width);
+
+    /**
+     * @brief Translate children into their parent's currency as they are summed
+     *
+     * Rates are fx_rate rows of rate_type 'average' and 'closing' (a missing
+     * one falls back to the other). A child without a rate to its parent's
+     * currency in a period fails the parent's period.
+     */
+    void set_currency_translation(CurrencyTranslation translation);
+
+    /**
+     * @brief Eliminate intercompany positions during the rollup
+     * @param rules Rules, e.g. EliminationMatrix::query() (empty: none)
+     *
+     * A run builds the EliminationMatrix of its tree once and applies it to
+     * each level after summing it. With currency translation, positions are
+     * translated into the parent's currency as the items holding them.
+     */
+    void set_eliminations(std::vector<EliminationRule> rules);
+
+    /**
+     * @brief Run every entity under a root
+     * @param root_code Code of the root entity
+     * @param scenario_id Scenario identifier
+     * @param period_ids Periods to calculate (in order)
+     * @param initial_bs_by_entity Opening balance sheet per leaf (absent: empty)
+     * @param template_code Unified template code
+     * @return Results of every entity of the tree, leaves calculated, parents aggregated
+     *
+     * A parent fails if any of its children failed; its errors name the child.
+     */
+    std::map<EntityID, MultiPeriodResults> run_hierarchy(
+        const EntityID& root_code,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const std::map<EntityID, BalanceSheet>& initial_bs_by_entity,
+        const std::string& template_code
+    );
+
+    /**
+     * @brief Runner of the leaf entities
+     */
+    PeriodRunner& period_runner() { return runner_; }
+
+private:
+    std::shared_ptr<database::IDatabase> db_;
+    PeriodRunner runner_;
+    std::unique_ptr<core::ThreadPool> pool_;   ///< Parallel aggregation (set_parallel())
+    size_t lane_width_ = 0;                    ///< set_entity_lanes()
+    CurrencyTranslation translation_;
+    std::vector<EliminationRule> eliminations_;
+    std::unique_ptr<unified::UnifiedEngine> lane_engine_;
+
+    /**
+     * @brief Calculate a batch of leaves as entity lanes
+     * @return False if the batch failed (results untouched)
+     */
+    bool run_lanes(const std::vector<EntityID>& entity_ids, ScenarioID scenario_id,
+                   const std::vector<PeriodID>& period_ids, const std::vector<const BalanceSheet*>& openings,
+                   const std::string& template_code, std::vector<MultiPeriodResults>& results);
+
+    /**
+     * @brief Rates of one run's currency translation
+     */
+    struct Translator {
+        const CurrencyTranslation* settings = nullptr;
+        std::vector<PeriodID> period_ids;
+        std::shared_ptr<const fx::FXProvider> average;
+        std::shared_ptr<const fx::FXProvider> closing;
+
+        /**
+         * @brief Average and closing rate of a period (nullopt: no rate)
+         */
+        std::optional<std::pair<double, double>> rates(const std::string& from, const std::string& to,
+                                                       PeriodID period_id) const;
+    };
+
+    /**
+     * @brief Sum the children of a node into its results
+     * @param translator Translates children in other currencies (null: summed as they are)
+     */
+    static MultiPeriodResults aggregate(const EntityTree& tree, int node,
+                                        const std::vector<MultiPeriodResults>& results,
+                                        const Translator* translator = nullptr);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_ENTITY_HIERARCHY_RUNNER_H
@@ -0,0 +1,157 @@
+/**
+ * @file goal_seek.h
+ * @brief Solve for the driver values at which a line item hits a target
+ *
+ * "What revenue growth gives a net debt / EBITDA of 3x in 2030?" is a
+ * root of one line item of one period as a function of some drivers. A
+ * GoalSeeker finds it instead of trial-and-error reruns: the free drivers
+ * are shifted by the same amount in every period of the run, and
+ *
+ * - NEWTON steps by the adjoint gradient of the target by every free
+ *   driver (PeriodRunner::gradient(): one forward and one reverse pass
+ *   per iteration), the smallest shift that would close the gap, halved
+ *   while it doesn't bring the target closer
+ * - BRENT shifts every free driver by one common amount and brackets the
+ *   root between lower and upper (inverse quadratic interpolation with
+ *   bisection as the fallback; no derivatives)
+ *
+ * Driver rows are read once per goal seek and shifted in memory; runs are
+ * incremental (PeriodRunner::set_incremental()), so a trial only
+ * re-evaluates the formulas downstream of the free drivers. Periods after
+ * the target's period are not calculated.
+ *
+ * solve_all() runs independent goal seeks in parallel, each worker with
+ * its own connection and runner.
+ *
+ * Usage:
+ * @code
+ * GoalSeeker seeker([] { return DatabaseFactory::create_sqlite("finmodel.db"); });
+ * GoalSeekSpec spec;
+ * spec.entity_id = "E";
+ * spec.scenario_id = 1;
+ * spec.period_ids = {2026, 2027, 2028, 2029, 2030};
+ * spec.template_code = "CORP";
+ * spec.target_code = "NET_DEBT_TO_EBITDA";
+ * spec.target_value = 3.0;
+ * spec.free_drivers = {"REVENUE_GROWTH"};
+ * auto solved = seeker.solve(spec);
+ * double growth_shift = solved.shifts.at("REVENUE_GROWTH");
+ * @endcode
+ */
+
+#ifndef FINMODEL_GOAL_SEEK_H
+#define FINMODEL_GOAL_SEEK_H
+
+#include "orchestration/period_runner.h"
+#include "core/thread_pool.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Root finder of a goal seek
+ */
+enum class GoalSeekMethod {
+    NEWTON,   ///< Gradient steps over all free drivers
+    BRENT     ///< One common shift of the free drivers, bracketed by [lower, upper]
+};
+
+/**
+ * @brief One goal seek: a target line item and the drivers free to move
+ */
+struct GoalSeekSpec {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    std::vector<PeriodID> period_ids;         ///< Periods of the run, ascending
+    BalanceSheet initial_bs;
+    std::string template_code;
+
+    std::string target_code;                  ///< Line item to bring to target_value
+    PeriodID target_period = 0;               ///< Its period (0: the last one)
+    double target_value = 0.0;
+    std::vector<std::string> free_drivers;    ///< Driver codes, shifted in every period
+
+    GoalSeekMethod method = GoalSeekMethod::NEWTON;
+    double lower = -std::numeric_limits<double>::infinity();   ///< Smallest shift (BRENT: required)
+    double upper = std::numeric_limits<double>::infinity();    ///< Largest shift (BRENT: required)
+    double tolerance = 1e-6;                  ///< |value - target_value| accepted
+    size_t max_iterations = 50;
+};
+
+/**
+ * @brief Outcome of a goal seek
+ */
+struct GoalSeekResult {
+    std::string target_code;
+    PeriodID target_period = 0;
+    double target_value = 0.0;
+
+    std::map<std::string, double> shifts;     ///< Free driver code → amount added in every period
+    double value = 0.0;                       ///< Target line item at the shifts
+    bool converged = false;                   ///< |value - target_value| ≤ tolerance
+
+    bool success = true;                      ///< False for an invalid spec or a failed run
+    std::vector<std::string> errors;          ///< Also why a successful seek didn't converge
+
+    size_t iterations = 0;                    ///< Newton steps or Brent iterations
+    size_t evaluations = 0;                   ///< Runs of the periods (a gradient counts as one)
+};
+
+/**
+ * @brief Goal seeks on warm runners, one per worker
+ *
+ * One solve() or solve_all() at a time (calls are serialized).
+ */
+class GoalSeeker {
+public:
+    using ConnectionFactory = PeriodRunner::ConnectionFactory;
+
+    /**
+     * @param connect Opens a worker's connection (once per worker, when it first solves)
+     * @param threads Workers of solve_all(), including the caller (0: hardware concurrency)
+     */
+    explicit GoalSeeker(ConnectionFactory connect, size_t threads = 0);
+
+    GoalSeeker(const GoalSeeker&) = delete;
+    GoalSeeker& operator=(const GoalSeeker&) = delete;
+
+    /**
+     * @brief Solve one goal seek on the calling thread
+     *
+     * Invalid specs and failed runs come back with success false and errors.
+     */
+    GoalSeekResult solve(const GoalSeekSpec& spec);
+
+    /**
+     * @brief Solve independent goal seeks in parallel
+     * @return Results in specs order
+     */
+    std::vector<GoalSeekResult> solve_all(const std::vector<GoalSeekSpec>& specs);
+
+private:
+    struct Worker {
+        std::shared_ptr<database::IDatabase> db;
+        std::unique_ptr<PeriodRunner> runner;
+    };
+
+    Worker& worker(size_t index);
+    static GoalSeekResult solve(Worker& worker, const GoalSeekSpec& spec);
+
+    ConnectionFactory connect_;
+    core::ThreadPool pool_;
+    std::vector<Worker> workers_;   ///< By pool worker index
+    std::mutex mutex_;              ///< Held by solve() and solve_all()
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_GOAL_SEEK_H
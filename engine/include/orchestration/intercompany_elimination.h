@@ -0,0 +1,125 @@
+/**
+ * @file intercompany_elimination.h
+ * @brief Intercompany eliminations of an entity hierarchy rollup as sparse matrices
+ *
+ * A receivable of A from B and B's payable to A are both summed into any
+ * parent holding A and B; consolidated, they don't exist. An
+ * EliminationRule says which part of an entity's line item is with a
+ * counterparty. It is eliminated at the lowest common parent of the two
+ * (and so at every parent above it, which sums that parent). Each side of
+ * a position is its own rule: the receivable with A as the entity, the
+ * payable with B, so a mismatch between them stays in the group.
+ *
+ * EliminationMatrix turns the rules into one sparse matrix per line item
+ * and parent depth - parents × entities holding a position, the shares
+ * as entries - built once per tree. Eliminating a level is one
+ * sparse × dense product with the positions of all periods stacked, not
+ * a loop over pairs of entities.
+ *
+ * Usage:
+ * @code
+ * EntityHierarchyRunner runner(db);
+ * runner.set_eliminations(EliminationMatrix::query(*db));
+ * auto group = runner.run_hierarchy("GROUP", scenario_id, periods, opening, "UNIFIED");
+ * @endcode
+ */
+
+#ifndef FINMODEL_INTERCOMPANY_ELIMINATION_H
+#define FINMODEL_INTERCOMPANY_ELIMINATION_H
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "orchestration/period_runner.h"
+#include "core/eigen.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+struct EntityTree;
+
+/**
+ * @brief Part of an entity's line item that is with another entity
+ */
+struct EliminationRule {
+    EntityID entity_id;                     ///< Entity holding the position
+    EntityID counterparty_id;               ///< Entity the position is with
+    std::string line_item;                  ///< Line item holding it (e.g. IC_RECEIVABLE)
+    double share = 1.0;                     ///< Part of line_item that is with the counterparty
+    std::vector<std::string> also_reduce;   ///< Line items containing line_item (e.g. RECEIVABLES)
+};
+
+/**
+ * @brief Eliminations of a tree's rules, by line item and parent depth
+ */
+class EliminationMatrix {
+public:
+    /**
+     * @brief Rate from a currency into another in a period (NaN: none)
+     *
+     * Called with the eliminated line item, which decides between the
+     * average and the closing rate.
+     */
+    using Rate = std::function<double(const std::string& from_currency, const std::string& to_currency,
+                                      size_t period, const std::string& line_item)>;
+
+    /**
+     * @brief Rules from the intercompany_elimination table
+     * @throws std::runtime_error on an also_reduce that isn't a JSON array of codes
+     */
+    static std::vector<EliminationRule> query(database::IDatabase& db);
+
+    /**
+     * @param tree Entities of the rollup
+     * @param rules Rules; those with an entity outside the tree, or with
+     *              itself as the counterparty, are ignored
+     */
+    EliminationMatrix(const EntityTree& tree, const std::vector<EliminationRule>& rules);
+
+    bool empty() const { return blocks_.empty(); }
+
+    /**
+     * @brief Rules in the matrices
+     */
+    size_t size() const { return rules_; }
+
+    /**
+     * @brief Eliminate at the parents of one depth (after summing them)
+     * @param tree The tree the matrix was built for
+     * @param depth Depth of the parents
+     * @param results Results by node: positions are read from the children, parents are reduced
+     * @param rate Translates positions into a parent's currency (null: amounts as they are)
+     *
+     * An elimination reduces line_item and also_reduce in every period of
+     * the parent that has them. A position in a currency without a rate
+     * into the parent's is not eliminated (the rollup fails that period).
+     */
+    void apply(const EntityTree& tree, int depth, std::vector<MultiPeriodResults>& results,
+               const Rate& rate = nullptr) const;
+
+private:
+    struct Group {
+        std::string line_item;
+        std::vector<std::string> reduced;   ///< line_item, then also_reduce
+    };
+
+    struct Block {
+        size_t group = 0;
+        int depth = 0;
+        std::vector<int> parents;           ///< Rows: nodes at depth
+        std::vector<int> sources;           ///< Columns: nodes holding positions
+        Eigen::SparseMatrix<double, Eigen::RowMajor> shares;
+    };
+
+    std::vector<Group> groups_;
+    std::vector<Block> blocks_;             ///< Ordered by depth, deepest first
+    size_t rules_ = 0;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_INTERCOMPANY_ELIMINATION_H
@@ -0,0 +1,227 @@
+/**
+ * @file job_queue.h
+ * @brief Asynchronous scenario runs with progress events, cancellation and priorities
+ *
+ * The server mode accepts runs that take minutes (sweeps over many
+ * scenarios) next to what-if runs a user waits for. A JobQueue runs each
+ * submitted job - entities × scenarios over the same periods - on one of
+ * its worker threads and records its progress as a sequence of events
+ * (one per calculated period), which clients poll or stream.
+ *
+ * Priorities: INTERACTIVE jobs always start before BATCH jobs, and BATCH
+ * jobs hold at most batch_workers workers at once, so with more workers
+ * than that a what-if never waits for a sweep to finish.
+ *
+ * Usage:
+ * @code
+ * JobQueue jobs([] { return DatabaseFactory::create_sqlite("finmodel.db"); }, 4, 2);
+ * JobSpec spec = JobSpec::from_json(R"({"template": "CORP", "entity": "A",
+ *                                       "scenarios": [1, 2], "periods": [1, 2, 3]})");
+ * uint64_t id = jobs.submit(spec);
+ * size_t seen = 0;
+ * bool finished = false;
+ * while (!finished) {
+ *     for (const auto& event : jobs.events(id, seen, std::chrono::seconds(1), &finished)) {
+ *         seen = event.sequence;
+ *         std::cout << event.type << " " << event.data << "\n";
+ *     }
+ * }
+ * @endcode
+ */
+
+#ifndef FINMODEL_JOB_QUEUE_H
+#define FINMODEL_JOB_QUEUE_H
+
+#include "types/common_types.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace finmodel {
+namespace database {
+    class IDatabase;
+}
+}
+
+namespace finmodel {
+namespace orchestration {
+
+enum class JobPriority { INTERACTIVE, BATCH };
+
+enum class JobState { QUEUED, RUNNING, SUCCEEDED, FAILED, CANCELLED };
+
+const char* to_string(JobPriority priority);
+const char* to_string(JobState state);
+
+/**
+ * @brief What a job runs: every entity × scenario over the periods
+ */
+struct JobSpec {
+    std::vector<EntityID> entities;
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<PeriodID> period_ids;
+    std::string template_code;
+    std::map<std::string, double> opening_balances;   ///< Opening balance sheet of every run
+    JobPriority priority = JobPriority::INTERACTIVE;
+    bool write_results = false;                        ///< Store periods in run_log / results (ResultWriter)
+
+    /**
+     * @brief Parse a run spec
+     *
+     * {"template": "CODE", "entities": ["A", ..] (or "entity": "A"),
+     *  "scenarios": [1, ..], "periods": [1, ..], "opening": {"CASH": 100, ..},
+     *  "priority": "interactive" | "batch", "write_results": false}
+     *
+     * @throws std::invalid_argument on malformed JSON or a missing field
+     */
+    static JobSpec from_json(const std::string& json);
+
+    /**
+     * @throws std::invalid_argument if there is nothing to run
+     */
+    void validate() const;
+};
+
+/**
+ * @brief Progress of a job
+ */
+struct JobStatus {
+    uint64_t id = 0;
+    JobState state = JobState::QUEUED;
+    JobPriority priority = JobPriority::INTERACTIVE;
+    size_t runs = 0;              ///< Entity × scenario runs of the job
+    size_t runs_done = 0;
+    size_t failed_runs = 0;       ///< Runs whose calculation reported errors
+    size_t periods = 0;           ///< Periods of all runs
+    size_t periods_done = 0;
+    double seconds = 0.0;         ///< Running time so far
+    std::string error;            ///< First error of a failed job
+
+    bool finished() const {
+        return state == JobState::SUCCEEDED || state == JobState::FAILED || state == JobState::CANCELLED;
+    }
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief One step of a job's progress
+ *
+ * Types: "status" (state changes; data is the JobStatus), "period" (a
+ * calculated period) and "run" (a finished entity × scenario run).
+ */
+struct JobEvent {
+    uint64_t sequence = 0;   ///< 1, 2, ... per job
+    std::string type;
+    std::string data;        ///< JSON object
+};
+
+/**
+ * @brief Worker threads running submitted jobs by priority
+ */
+class JobQueue {
+public:
+    using ConnectionFactory = std::function<std::shared_ptr<database::IDatabase>()>;
+
+    /// Events kept per job; older ones are dropped (a client that far behind skips them)
+    static constexpr size_t MAX_EVENTS = 65536;
+
+    /// Finished jobs kept for status queries; the oldest are forgotten
+    static constexpr size_t MAX_FINISHED_JOBS = 1024;
+
+    /**
+     * @brief Start the workers
+     * @param connect Opens a connection for one job (and one more for its result writer)
+     * @param workers Jobs running at once
+     * @param batch_workers BATCH jobs running at once (at most workers)
+     * @throws std::invalid_argument if workers is 0
+     */
+    JobQueue(ConnectionFactory connect, size_t workers = 2, size_t batch_workers = 1);
+
+    /**
+     * @brief Cancel every job and join the workers
+     */
+    ~JobQueue();
+
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    /**
+     * @brief Queue a job
+     * @return Job ID
+     * @throws std::invalid_argument if the spec is invalid
+     */
+    uint64_t submit(JobSpec spec);
+
+    /**
+     * @brief Cancel a queued or running job
+     *
+     * A running job stops after the period it is calculating.
+     * @return False if there is no such job or it already finished
+     */
+    bool cancel(uint64_t id);
+
+    std::optional<JobStatus> status(uint64_t id) const;
+
+    /// Known jobs, oldest first
+    std::vector<JobStatus> list() const;
+
+    /**
+     * @brief Events of a job after the given sequence number
+     * @param after Last sequence number seen (0: from the start)
+     * @param wait Block at most this long while there are none
+     * @param finished Set when the job finished and no events are left after these
+     * @throws std::out_of_range if there is no such job
+     */
+    std::vector<JobEvent> events(uint64_t id, uint64_t after, std::chrono::milliseconds wait,
+                                 bool* finished = nullptr) const;
+
+private:
+    struct Job {
+        JobSpec spec;
+        JobStatus status;
+        std::chrono::steady_clock::time_point started;
+        bool cancel_requested = false;
+        std::deque<JobEvent> events;
+        uint64_t next_sequence = 1;
+    };
+
+    void worker_loop();
+    /// Run a job's runs on the calling worker; returns the job's first error
+    std::string run(const std::shared_ptr<Job>& job);
+    std::shared_ptr<Job> next_job();   ///< Called with mutex_ held
+
+    /// Called with mutex_ held
+    void emit(Job& job, std::string type, std::string data);
+    void emit_status(Job& job);
+    void forget_finished();
+
+    ConnectionFactory connect_;
+    const size_t batch_workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    mutable std::condition_variable progress_;   ///< New events of any job
+    std::map<uint64_t, std::shared_ptr<Job>> jobs_;
+    std::deque<std::shared_ptr<Job>> interactive_;
+    std::deque<std::shared_ptr<Job>> batch_;
+    size_t running_batch_ = 0;
+    uint64_t next_id_ = 1;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_JOB_QUEUE_H
@@ -0,0 +1,150 @@
+/**
+ * @file lane_triggers.h
+ * @brief Management action triggers evaluated over scenario lanes
+ *
+ * PeriodRunner decides which of a scenario's actions are active one
+ * scenario at a time: each period it evaluates the conditions of the
+ * triggers in their window against the prior period's values. When many
+ * paths of one scenario are calculated as lanes (StochasticRunner), the
+ * same triggers hold for every lane but their conditions don't -
+ * "CASH < 0" fires in some paths and not in others. LaneTriggers
+ * evaluates each condition once for all lanes (core::LaneEvaluator over
+ * the lanes' prior values) and keeps per-lane bitsets:
+ *
+ * - active_lanes(t): lanes in which trigger t is active in the period
+ * - sticky state: lanes in which a sticky conditional action has fired,
+ *   active until its end period (per action code, as PeriodRunner)
+ *
+ * groups() then partitions the lanes by their set of active triggers, so
+ * each group can be calculated with the overlay template of its actions.
+ *
+ * Usage:
+ * @code
+ * LaneTriggers triggers(LaneTriggers::query(*db, scenario_id), lanes);
+ * for (PeriodID p : period_ids) {
+ *     triggers.evaluate(p, &state);
+ *     for (const auto& group : triggers.groups()) { ... }
+ * }
+ * @endcode
+ */
+
+#ifndef FINMODEL_LANE_TRIGGERS_H
+#define FINMODEL_LANE_TRIGGERS_H
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "core/compiled_formula.h"
+#include "core/lane_evaluator.h"
+#include "unified/unified_engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Trigger configuration of one scenario_action row
+ */
+struct ActionTrigger {
+    std::string action_code;
+    std::string trigger_type;
+    std::string trigger_condition;
+    int trigger_period = -1;
+    int start_period = 0;
+    int end_period = -1;
+    bool trigger_sticky = true;
+};
+
+/**
+ * @brief Activity of a scenario's triggers in every lane, period after period
+ *
+ * Matches PeriodRunner lane by lane: UNCONDITIONAL and TIMED triggers are
+ * active in their window; a CONDITIONAL one from start_period on when its
+ * condition holds on the prior values (missing values read 0), sticky
+ * ones until end_period once met, non-sticky ones only while it holds and
+ * not in period 1. A condition that doesn't compile, or fails in any lane
+ * (e.g. a division by zero), is false in every lane.
+ */
+class LaneTriggers {
+public:
+    /**
+     * @brief Lanes that share one set of active triggers
+     */
+    struct Group {
+        std::vector<uint64_t> triggers;   ///< Bit t: trigger t active
+        std::vector<size_t> lanes;        ///< Ascending
+    };
+
+    /**
+     * @param triggers Trigger rows of the scenario the lanes run
+     * @param lanes Number of lanes
+     */
+    LaneTriggers(std::vector<ActionTrigger> triggers, size_t lanes);
+
+    /**
+     * @brief Trigger rows of a scenario from scenario_action, ordered by action code
+     */
+    static std::vector<ActionTrigger> query(database::IDatabase& db, ScenarioID scenario_id);
+
+    size_t lane_count() const { return lanes_; }
+    size_t size() const { return triggers_.size(); }
+    const ActionTrigger& trigger(size_t t) const { return triggers_[t]; }
+
+    /**
+     * @brief Forget which lanes sticky actions have fired in (a new batch of paths)
+     */
+    void reset();
+
+    /**
+     * @brief Work out every trigger's active lanes in a period
+     * @param period_id Period about to be calculated
+     * @param prior Lanes' values the period opens from (null: none, conditions read 0)
+     * @throws std::invalid_argument if prior doesn't have one value per lane
+     */
+    void evaluate(PeriodID period_id, const unified::LaneResult* prior);
+
+    /**
+     * @brief Lanes in which a trigger is active (bit lane), as of the last evaluate()
+     */
+    const std::vector<uint64_t>& active_lanes(size_t t) const { return active_[t]; }
+
+    bool active(size_t t, size_t lane) const {
+        return (active_[t][lane / 64] >> (lane % 64)) & 1;
+    }
+
+    /**
+     * @brief Lanes grouped by their set of active triggers, ordered by first lane
+     */
+    std::vector<Group> groups() const;
+
+private:
+    enum class Kind { WINDOW, CONDITIONAL, NEVER };
+
+    struct Compiled {
+        Kind kind = Kind::NEVER;
+        PeriodID first = 0;
+        PeriodID last = -1;                                     ///< -1: open-ended
+        size_t sticky = 0;                                      ///< Index in triggered_ (by action code)
+        std::shared_ptr<const core::CompiledFormula> condition;
+    };
+
+    void condition_lanes(const Compiled& trigger, const unified::LaneResult* prior, std::vector<uint64_t>& out);
+
+    std::vector<ActionTrigger> triggers_;
+    std::vector<Compiled> compiled_;
+    size_t lanes_ = 0;
+    size_t words_ = 0;                                  ///< uint64_t per lane bitset
+
+    std::vector<std::vector<uint64_t>> active_;         ///< By trigger
+    std::vector<std::vector<uint64_t>> triggered_;      ///< Sticky state, by action code
+    core::LaneEvaluator evaluator_;
+    core::LaneArray zeros_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_LANE_TRIGGERS_H
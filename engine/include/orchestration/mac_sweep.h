@@ -0,0 +1,135 @@
+/**
+ * @file mac_sweep.h
+ * @brief MAC analysis that runs full combinations only where actions interact
+ *
+ * The MAC of an action is meaningful on its own when actions are additive:
+ * the reduction of a combination is the sum of its actions' reductions. A
+ * MACSweep checks how far that holds instead of running all 2^N
+ * combinations:
+ *
+ * 1. Baseline plus N single-action scenarios (as generate_for_mac_analysis())
+ * 2. A sample of action pairs, each pair's interaction being its combined
+ *    reduction minus the two single reductions
+ * 3. Full combinations only within groups of actions linked by an
+ *    interaction above the threshold
+ *
+ * Each MAC point carries an error bound on its reduction: within a fully
+ * combined group the reduction is the action's average marginal
+ * contribution (Shapley value) and the bound its largest deviation over
+ * the group's combinations; elsewhere it is the single-action reduction
+ * and the bound the largest interaction measured for the action.
+ *
+ * Usage:
+ * @code
+ * MACSweep sweep(actions, [&](uint64_t active) {
+ *     int scenario_id = create_scenario(active);   // One bit per actions[i]
+ *     return runner.run_periods(entity, scenario_id, {1}, opening, "TEMPLATE")
+ *                  .results[0].get_value("TOTAL_EMISSIONS");
+ * });
+ * MACSweepResult mac = sweep.run();
+ * @endcode
+ */
+
+#pragma once
+
+#include "carbon/mac_curve_engine.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Action of a MAC sweep and its costs
+ */
+struct MACAction {
+    std::string action_code;
+    std::string action_name;
+    std::string action_category;
+    double capex = 0.0;          // One-time capital expenditure (CHF)
+    double opex_annual = 0.0;    // Annual operating cost (CHF/year)
+};
+
+/**
+ * @brief Sampling and threshold settings of a MACSweep
+ */
+struct MACSweepOptions {
+    size_t max_pairs = 64;                  ///< Pairs measured (every pair if there are fewer)
+    double interaction_threshold = 0.05;    ///< |interaction| / (|r_i| + |r_j|) above which a pair interacts
+    double min_interaction = 1e-6;          ///< Interactions below this (tCO2e) are ignored
+    size_t max_group_size = 10;             ///< Larger interacting groups keep the pairwise bound
+    int capex_amortization_years = 10;
+    uint64_t seed = 1;                      ///< Pair sampling seed
+};
+
+/**
+ * @brief MAC point with the uncertainty of its reduction
+ */
+struct MACSweepPoint {
+    carbon::MACPoint point;
+    double reduction_error = 0.0;   ///< annual_reduction_tco2e is exact within ± this
+    double mac_low = 0.0;           ///< MAC range over the reduction's error bound
+    double mac_high = 0.0;
+    bool combined = false;          ///< Reduction from full combinations of its group
+};
+
+/**
+ * @brief Result of a MACSweep
+ */
+struct MACSweepResult {
+    std::vector<MACSweepPoint> points;      ///< Sorted by marginal cost, lowest first
+    double baseline_emissions = 0.0;
+    size_t scenarios_run = 0;               ///< Distinct combinations calculated
+    size_t pairs_measured = 0;
+    std::vector<std::pair<std::string, std::string>> interacting_pairs;
+    std::vector<std::vector<std::string>> combined_groups;     ///< Groups run in full combinations
+};
+
+/**
+ * @brief Baseline, single-action and sampled pair runs, full combinations where needed
+ */
+class MACSweep {
+public:
+    /// Emissions (tCO2e/year) of the scenario with the given actions active
+    /// (bit i = actions[i])
+    using ScenarioRun = std::function<double(uint64_t active_actions)>;
+
+    /**
+     * @brief Constructor
+     * @param actions Actions to analyse (at most 63)
+     * @param run Calculates one combination (called once per distinct combination)
+     * @param options Sampling and threshold settings
+     * @throws std::invalid_argument for too many actions, no run function or bad options
+     */
+    MACSweep(std::vector<MACAction> actions, ScenarioRun run, MACSweepOptions options = {});
+
+    /**
+     * @brief Run the sweep
+     * @return MAC points with error bounds
+     */
+    MACSweepResult run();
+
+private:
+    std::vector<MACAction> actions_;
+    ScenarioRun run_;
+    MACSweepOptions options_;
+    std::map<uint64_t, double> emissions_;     // Combination → emissions, per run()
+
+    /**
+     * @brief Emissions of a combination (calculated on first use)
+     */
+    double emissions(uint64_t active_actions);
+
+    /**
+     * @brief Marginal cost as MACCurveEngine calculates it
+     */
+    double marginal_cost(const MACAction& action, double reduction) const;
+};
+
+} // namespace orchestration
+} // namespace finmodel
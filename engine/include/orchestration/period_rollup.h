@@ -0,0 +1,104 @@
+/**
+ * @file period_rollup.h
+ * @brief Quarterly and annual views of a run's periods, combined on read
+ *
+ * A run over a mixed schedule (PeriodSetup::create_period_schedule())
+ * stores monthly results where it calculated months; reports usually
+ * want quarters or years. A PeriodRollup groups the run's periods into
+ * calendar buckets once and combines a line item's values when it is
+ * read - nothing is stored:
+ *
+ * - flows (the default) are summed
+ * - stocks (core::TimeScaling::stocks) take the bucket's last value
+ * - rates (core::TimeScaling::rates) are averaged, weighted by days
+ *
+ * A period longer than its bucket (an annual period in a quarterly view)
+ * is a bucket of its own.
+ *
+ * Usage:
+ * @code
+ * auto years = PeriodRollup::load(*db, period_ids, PeriodGranularity::ANNUAL);
+ * years.set_time_scaling(tmpl->get_time_scaling());
+ * auto revenue = years.series(results, "REVENUE");   // One value per year
+ * @endcode
+ */
+
+#ifndef FINMODEL_PERIOD_ROLLUP_H
+#define FINMODEL_PERIOD_ROLLUP_H
+
+#include "orchestration/period_runner.h"
+#include "orchestration/period_setup.h"
+#include "core/statement_template.h"
+#include "database/idatabase.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Consecutive periods of a run combined into one reported period
+ */
+struct RollupBucket {
+    std::string label;     ///< 2024, 2024-Q1, or the period's own label when it is its own bucket
+    size_t first = 0;      ///< Index of its first period in the run
+    size_t last = 0;       ///< Index of its last period in the run
+    int days = 0;          ///< Sum of the periods' days_in_period
+};
+
+/**
+ * @brief Calendar buckets of a run's periods and how line items combine in them
+ */
+class PeriodRollup {
+public:
+    /**
+     * @brief Bucket a run's periods by the calendar quarter or year they start in
+     * @param db Connection with the period table
+     * @param period_ids Periods of the run, in order
+     * @param granularity QUARTERLY or ANNUAL (MONTHLY: a bucket per month)
+     * @throws std::invalid_argument if a period isn't in the period table
+     */
+    static PeriodRollup load(database::IDatabase& db, const std::vector<PeriodID>& period_ids,
+                             PeriodGranularity granularity);
+
+    /**
+     * @brief Rollup over given buckets
+     * @param buckets Consecutive, covering periods 0 .. periods - 1
+     * @param period_days days_in_period of each period of the run
+     * @throws std::invalid_argument if the buckets don't cover the periods in order
+     */
+    PeriodRollup(std::vector<RollupBucket> buckets, std::vector<int> period_days);
+
+    /**
+     * @brief Take the stocks and rates of a template (all line items are flows otherwise)
+     */
+    void set_time_scaling(const core::TimeScaling& scaling);
+
+    const std::vector<RollupBucket>& buckets() const { return buckets_; }
+
+    /**
+     * @brief A line item in one bucket
+     * @param results Run over the periods passed to load()
+     * @throws std::invalid_argument if results has another number of periods
+     */
+    double value(const MultiPeriodResults& results, const std::string& code, size_t bucket) const;
+
+    /**
+     * @brief A line item in every bucket, in order
+     */
+    std::vector<double> series(const MultiPeriodResults& results, const std::string& code) const;
+
+private:
+    std::vector<RollupBucket> buckets_;
+    std::vector<int> period_days_;
+    std::unordered_set<std::string> stocks_;
+    std::unordered_set<std::string> rates_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_PERIOD_ROLLUP_H
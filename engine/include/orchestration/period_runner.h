@@ -11,26 +11,47 @@
 #define FINMODEL_PERIOD_RUNNER_H
 
 #include "types/common_types.h"
+#include "database/async_database.h"
+#include "database/database_factory.h"
 #include "database/idatabase.h"
 #include "unified/unified_engine.h"
+#include "actions/action_engine.h"
+#include "actions/action_catalog.h"
+#include "orchestration/lane_triggers.h"
+#include "orchestration/result_aggregator.h"
+#include "orchestration/result_cache.h"
+#include "orchestration/result_writer.h"
+#include "orchestration/run_checkpoint.h"
+#include "orchestration/tail_latency.h"
+#include "orchestration/task_scheduler.h"
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
+#include <unordered_map>
 
 namespace finmodel {
 namespace orchestration {
 
+class BudgetedResults;
+
 /**
  * @brief Results from a multi-period calculation run
  */
 struct MultiPeriodResults {
     std::vector<unified::UnifiedResult> results;  // One per period
+    std::map<std::string, double> horizon;        ///< Horizon measures by name (PeriodRunner::set_horizon_measures())
 
     bool success = true;
+    size_t resumed_periods = 0;   ///< Leading periods not calculated: restored from a checkpoint
+    std::optional<PeriodID> stopped_period;   ///< Period a stop condition was met in, the run's last (PeriodRunner::set_stop_conditions())
+    std::string stop_reason;                  ///< Which condition, when stopped
     std::vector<std::string> errors;
-    std::vector<std::string> warnings;
+    unified::Diagnostics warnings;   ///< Periods' warnings, folded: one record per message over the run
 
     void add_error(const std::string& msg) {
         success = false;
@@ -38,7 +59,7 @@ struct MultiPeriodResults {
     }
 
     void add_warning(const std::string& msg) {
-        warnings.push_back(msg);
+        warnings.add(msg);
     }
 
     // Convenience methods to extract individual statements
@@ -67,6 +88,56 @@ struct MultiPeriodResults {
     }
 };
 
+/**
+ * @brief A value over a run's whole horizon (see PeriodRunner::set_horizon_measures())
+ */
+struct HorizonMeasure {
+    enum class Kind {
+        NPV,    ///< core::npv() of the line item's period values at rate
+        IRR     ///< core::irr() of the line item's period values (NaN if there is none)
+    };
+
+    std::string name;       ///< Key in MultiPeriodResults::horizon
+    Kind kind = Kind::NPV;
+    std::string code;       ///< Line item (periods without it count as 0)
+    double rate = 0.0;      ///< Discount rate per period (NPV)
+};
+
+/**
+ * @brief When a run ends before its last period (see PeriodRunner::set_stop_conditions())
+ */
+struct StopConditions {
+    std::string condition;          ///< Formula over the period's line items, stops when nonzero (empty: none)
+    bool on_error = false;          ///< Stop after the first failed period (a validation ERROR or calculation error)
+
+    bool empty() const { return condition.empty() && !on_error; }
+};
+
+/**
+ * @brief Derivatives of one output by every driver (PeriodRunner::gradient())
+ */
+struct DriverGradient {
+    std::string output;                     ///< Line item differentiated
+    PeriodID period_id = 0;                 ///< Its period (the run's last)
+    double value = 0.0;                     ///< Its value
+    std::map<std::string, double> drivers;  ///< Driver code → d output / d driver (moved in every period)
+
+    bool success = true;
+    std::vector<std::string> errors;
+
+    size_t recomputed_periods = 0;          ///< Periods calculated again to tape them
+    size_t peak_tape_bytes = 0;             ///< Largest tape held at once
+};
+
+/**
+ * @brief One unit of work of run_jobs(): an entity's periods under one scenario
+ */
+struct ScenarioJob {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    const BalanceSheet* initial_bs = nullptr;   ///< Opening balance sheet (null: the run's)
+};
+
 /**
  * @brief Orchestrates multi-period financial statement calculations
  *
@@ -94,12 +165,38 @@ struct MultiPeriodResults {
  */
 class PeriodRunner {
 public:
+    /// Opens a database connection for one scenario worker
+    using ConnectionFactory = std::function<std::shared_ptr<database::IDatabase>()>;
+
+    /// Opens a scenario worker's connection for its NUMA node (see set_numa_placement())
+    using NodeConnectionFactory = std::function<std::shared_ptr<database::IDatabase>(size_t node)>;
+
+    /**
+     * @brief Sees every period run_periods() calculates
+     * @return False to cancel the run (see set_period_observer())
+     */
+    using PeriodObserver = std::function<bool(const EntityID& entity_id, ScenarioID scenario_id,
+                                              PeriodID period_id, const unified::UnifiedResult& result)>;
+
     /**
      * @brief Constructor
      * @param db Database connection
      */
     explicit PeriodRunner(std::shared_ptr<database::IDatabase> db);
 
+    /**
+     * @brief Constructor on shared reference data
+     *
+     * The engine converts with the store's snapshot instead of loading
+     * FX rates and unit factors itself, and so do the scenario workers of
+     * set_parallel_scenarios(). A ReferenceDataStore::reload() applies
+     * from the next run_periods() on; a run in progress keeps its snapshot.
+     *
+     * @param db Database connection
+     * @param reference Store shared with other runners (not null)
+     */
+    PeriodRunner(std::shared_ptr<database::IDatabase> db, std::shared_ptr<core::ReferenceDataStore> reference);
+
     /**
      * @brief Run calculations for multiple periods
      * @param entity_id Entity identifier
@@ -117,10 +214,27 @@ public:
         const std::string& template_code
     );
 
+    /**
+     * @brief run_periods() from driver rows held in memory (no driver query)
+     * @param drivers Rows of the run, as from DriverValueProvider::fetch_rows() (possibly edited)
+     *
+     * For callers that keep a run's inputs warm and change them between
+     * runs (WhatIfSessions); with set_incremental() an edit only
+     * re-evaluates the formulas downstream of the changed drivers.
+     */
+    MultiPeriodResults run_periods(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const unified::DriverValueProvider::DriverRows& drivers
+    );
+
     /**
      * @brief Run multiple scenarios (for Monte Carlo simulations)
      * @param entity_id Entity identifier
-     * @param scenario_ids List of scenarios to run
+     * @param scenario_ids List of distinct scenarios to run (in parallel after set_scenario_parallel())
      * @param period_ids List of periods to calculate (same for all scenarios)
      * @param initial_bs Opening balance sheet (same for all scenarios)
      * @param template_code Unified template code
@@ -134,13 +248,658 @@ public:
         const std::string& template_code
     );
 
+    /**
+     * @brief Run (entity, scenario) jobs over the same periods
+     * @param jobs Jobs to run (each pair at most once)
+     * @param period_ids List of periods to calculate (same for all jobs)
+     * @param initial_bs Opening balance sheet of jobs without their own
+     * @param template_code Unified template code
+     * @return Results per job, in job order
+     *
+     * After set_scenario_parallel() every job is a task of the work-stealing
+     * scheduler, so jobs of very different cost still keep every worker
+     * busy. Jobs of the same scenario then start from the sticky triggers
+     * the scenario had before the call; afterwards it keeps all of them.
+     */
+    std::vector<MultiPeriodResults> run_jobs(
+        const std::vector<ScenarioJob>& jobs,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code
+    );
+
+    /**
+     * @brief Run (entity, scenario) jobs into statistics instead of results
+     * @param jobs Jobs to run (each pair at most once)
+     * @param period_ids List of periods to calculate (same for all jobs)
+     * @param initial_bs Opening balance sheet of jobs without their own
+     * @param template_code Unified template code
+     * @param into Statistics per line item and period the runs are added to
+     *
+     * Runs as run_jobs(), but each job's results are added to statistics
+     * and dropped as soon as it finishes, so memory doesn't grow with the
+     * number of jobs. Parallel workers fill their own aggregator, merged
+     * into `into` at the end (exactly: the statistics equal a sequential
+     * run's for any thread count).
+     */
+    void aggregate_jobs(
+        const std::vector<ScenarioJob>& jobs,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        ResultAggregator& into
+    );
+
+    /**
+     * @brief run_multiple_scenarios() into results held within a memory budget
+     * @param into Results and statistics the runs are added to (spilling to disk past its budget)
+     *
+     * Parallel workers hand finished scenarios to `into` one at a time
+     * (under a lock, which a spill holds while it writes).
+     */
+    void collect_scenarios(
+        const EntityID& entity_id,
+        const std::vector<ScenarioID>& scenario_ids,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        BudgetedResults& into
+    );
+
+    /**
+     * @brief run_multiple_scenarios() into statistics (see aggregate_jobs())
+     */
+    void aggregate_scenarios(
+        const EntityID& entity_id,
+        const std::vector<ScenarioID>& scenario_ids,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        ResultAggregator& into
+    );
+
+    /**
+     * @brief Enable or disable incremental reruns
+     * @param enabled True to keep each period's values between runs
+     *
+     * For what-if edits: after changing a driver, running the same periods
+     * again only re-evaluates formulas downstream of the change, including
+     * later periods reached through [t-1] references. Results are the same
+     * as a full run (see UnifiedEngine::set_incremental()).
+     */
+    void set_incremental(bool enabled);
+
+    /**
+     * @brief Start each new scenario from the previous scenario's state
+     * @param enabled True to seed incremental runs across scenarios
+     *
+     * For sweeps of action combinations: run the jobs in Gray code order
+     * (ScenarioGenerator::combinations(..., CombinationOrder::GRAY)) and
+     * each scenario differs from the one before by one action, so only the
+     * line items that action changes and their downstream ones are
+     * re-evaluated (see UnifiedEngine::set_incremental_seeding()). Parallel
+     * workers seed from the jobs they ran before. Implies set_incremental(true).
+     */
+    void set_incremental_seeding(bool enabled);
+
+    /**
+     * @brief Serve all periods of a scenario's actions with one template
+     * @param enabled True to gate the actions per period instead of one overlay per active set
+     *
+     * An overlay per active action set (the default) is rebuilt and
+     * compiled whenever a phased or triggered action switches on or off.
+     * Parametric actions compile every transformation of the scenario's
+     * actions once (ActionEngine::parametric_patches()), each gated by its
+     * action's activation, and set the activations per period from the
+     * action windows and trigger state: one template and one compiled
+     * plan for the whole run. Results agree with overlays up to rounding.
+     */
+    void set_parametric_actions(bool enabled);
+
+    /**
+     * @brief Read management actions from a catalogue loaded beforehand
+     * @param catalog Actions of the scenarios to run (null: load each scenario's actions per run)
+     *
+     * Runs otherwise query and parse a scenario's actions once per run;
+     * with a catalogue (actions::ActionCatalog::load()) the scenarios it
+     * covers are read from memory in every run and by every parallel
+     * worker. Scenarios it doesn't cover are loaded per run as before. The
+     * catalogue is not refreshed: set it again after changing the actions.
+     */
+    void set_action_catalog(std::shared_ptr<const actions::ActionCatalog> catalog);
+
+    /**
+     * @brief Scope 3 emissions templates read as scope3:CATEGORY
+     * @param results Emissions by entity, scenario and period (null: none)
+     *
+     * Evaluated beforehand for all entities and scenarios
+     * (carbon::EEIOModel::evaluate()) and shared by every parallel worker.
+     * Set it again after changing the spend.
+     */
+    void set_scope3_results(std::shared_ptr<const carbon::Scope3Results> results);
+
+    /**
+     * @brief Working capital and capex policies templates read as policy:NAME
+     * @throws std::out_of_range for a code without an active row
+     *
+     * Codes of wc_policy and capex_policy ("DEFAULT" until set), used by
+     * every parallel worker (see unified::PolicyProvider).
+     */
+    void select_policies(const std::string& wc_code, const std::string& capex_code);
+
+    /**
+     * @brief Make TAX_COMPUTE(x, "name") use a path-dependent strategy
+     *
+     * Each run starts the strategy from its initial state and carries it
+     * from period to period with the balance sheet (and in checkpoints);
+     * see UnifiedEngine::register_tax_strategy().
+     */
+    void register_tax_strategy(const std::string& name, std::shared_ptr<const pl::IStatefulTaxStrategy> strategy);
+
+    /**
+     * @brief Record stage, line item and lookup timings of later runs
+     * @param profiler Profiler (null: stop profiling)
+     *
+     * Adds the runner's driver load, roll-forward and write stages to the
+     * engine's (see UnifiedEngine::set_profiler()). Scenario workers
+     * (set_scenario_parallel()) are not profiled.
+     */
+    void set_profiler(std::shared_ptr<core::Profiler> profiler);
+
+    /**
+     * @brief Trace every run and keep the slowest ones
+     * @param tracker Latency histograms and exemplars (null: no traces), shared by scenario workers
+     *
+     * Each run records its driver load and per-period times, templates,
+     * template variants created and database fallbacks; runs the
+     * tracker's policy picks as exemplars store the trace with their
+     * run_log row (set_result_writer()). See TailLatencyTracker.
+     */
+    void set_tail_latency(std::shared_ptr<TailLatencyTracker> tracker) { tail_latency_ = std::move(tracker); }
+
+    /**
+     * @brief Choose which periods are checked against the template's validation rules
+     * @param policy Full (default), final period, every k-th period, sampled scenarios or deferred
+     *
+     * Sweeps over many scenarios spend a good share of each period on rule
+     * checks. Unvalidated periods report no validation results; with
+     * ValidationMode::DEFERRED nothing is checked during the run and
+     * validate_columnar() checks the written results afterwards. The
+     * policy is recorded in each run's configuration (ResultWriter::begin_run()).
+     */
+    void set_validation_policy(const unified::ValidationPolicy& policy);
+
+    const unified::ValidationPolicy& validation_policy() const { return validation_policy_; }
+
+    /**
+     * @brief Evaluate independent line items of each period on a thread pool
+     * @param threads Threads per period including the caller (0 or 1: sequential)
+     * @param min_level_width Narrower topological levels run sequentially
+     *
+     * Periods still run one after another (each opens from the last one's
+     * closing balance); see UnifiedEngine::set_parallel().
+     */
+    void set_parallel(size_t threads, size_t min_level_width = 64);
+
+    /**
+     * @brief Queue every calculated period for storage
+     * @param writer Result writer (null: results are only returned)
+     *
+     * Each run_periods() call becomes one run_log run; the writer stores it
+     * on its own thread, so calculation never waits for the database.
+     */
+    void set_result_writer(std::shared_ptr<ResultWriter> writer);
+
+    /**
+     * @brief Report each calculated period, e.g. as progress of a long run
+     * @param observer Called on the calculating thread after each period (null: none)
+     *
+     * An observer returning false cancels the run: run_periods() returns
+     * the periods calculated so far, with success false and a
+     * "cancelled" error. Scenario workers (set_scenario_parallel()) call
+     * their own runner's observer, which they don't have.
+     */
+    void set_period_observer(PeriodObserver observer) { period_observer_ = std::move(observer); }
+
+    /**
+     * @brief Read upcoming jobs' inputs on a background thread while a job calculates
+     * @param connect Opens a prefetch connection, once per connection, on
+     *        the thread using it (null: no prefetch)
+     * @param depth Jobs read ahead at most
+     * @param connections Connections reading in parallel (at most depth are busy)
+     *
+     * For sequential run_jobs() and run_multiple_scenarios(): a prefetch
+     * stage (database::AsyncDatabase) queries the drivers and action
+     * triggers of the next jobs on its own connections, so each job starts
+     * calculating without a query. With set_result_writer() periods are
+     * also stored on the writer's thread, which makes calculation the only
+     * stage on the calling thread. Results are the same as without prefetch.
+     */
+    void set_prefetch(ConnectionFactory connect, size_t depth = 2, size_t connections = 1);
+
+    /**
+     * @brief Save roll-forward state while running, and resume from it
+     * @param store Checkpoints of one run ID (null: no checkpoints)
+     * @param every_periods Save after every this many calculated periods (and after a call's last period)
+     *
+     * run_periods() then starts from the (entity, scenario)'s checkpoint
+     * if the store has one: periods up to its last period are skipped
+     * (period IDs must be ascending) and results hold only the periods
+     * calculated by this call; resumed_periods counts the skipped ones.
+     * Later periods come out the same as in an uninterrupted run.
+     * @throws std::runtime_error from run_periods() if a checkpoint was
+     *         taken with another template
+     */
+    void set_checkpoints(std::shared_ptr<CheckpointStore> store, size_t every_periods = 12);
+
+    /**
+     * @brief Read runs whose inputs were run before from a content-addressed cache
+     * @param cache Cache shared by the runner and its scenario workers (null: none)
+     *
+     * Each run_periods() call is fingerprinted by its template, the
+     * resolved driver values of its periods, its action triggers, the
+     * entity's actuals, the reference data (units, FX rates and the
+     * template's validation rules, read once per runner like the engine's
+     * own FX and unit tables), the opening balance sheet, the periods,
+     * which ones are validated and the output selection. A cached
+     * fingerprint's periods are returned (and written, and observed)
+     * without calculating; runs with
+     * the same fingerprint on parallel workers are calculated once. The
+     * scenario ID itself is not part of the fingerprint, so scenarios
+     * with equal effective inputs share an entry. Only successful runs
+     * are stored; runs with set_checkpoints() or
+     * set_sensitivity_drivers() bypass the cache. Tax strategies are
+     * identified by their registered names.
+     */
+    void set_result_cache(std::shared_ptr<ResultCache> cache);
+
+    /**
+     * @brief Values computed over each run's periods once at the end of run_periods()
+     * @param measures NPV and IRR of line items (empty: none)
+     *
+     * Measures are set in MultiPeriodResults::horizon for successful runs,
+     * over the periods in results (those after a checkpoint's resumed
+     * ones). Applies to the scenario workers as well.
+     * @throws std::invalid_argument for an NPV rate not above -1
+     */
+    void set_horizon_measures(std::vector<HorizonMeasure> measures);
+
+    /**
+     * @brief End runs at the first period meeting a condition, e.g. a covenant breach
+     * @param stop Condition formula and/or stop on failure (empty: run every period)
+     *
+     * After each calculated (or replayed) period the condition is
+     * evaluated over that period's line items, e.g.
+     * "TOTAL_EQUITY < 0" or "NET_DEBT / EBITDA > 3.5"; a condition that
+     * reads a line item the period doesn't have, or fails, is not met.
+     * When a condition is met, run_periods() returns right after the
+     * period: results end with it, stopped_period and stop_reason say
+     * where and why, and success is unaffected (a breach is an outcome,
+     * not an error). A scenario worker that stops takes the next
+     * scenario. Stopped runs aren't stored in the result cache. Applies to
+     * the scenario workers as well.
+     * @throws std::invalid_argument if the condition doesn't compile
+     */
+    void set_stop_conditions(StopConditions stop);
+
+    /**
+     * @brief Differentiate each period by some drivers in the same run
+     * @param driver_codes Driver codes (empty: no derivatives)
+     *
+     * Every calculated period's UnifiedResult::sensitivities then holds
+     * d line item / d driver for all the drivers (see
+     * unified::UnifiedEngine::set_sensitivity_drivers()), carried through
+     * the [t-1] roll-forward from the run's first period: one run instead
+     * of one bumped run per driver. Runs with sensitivities bypass the
+     * result cache; periods resumed from a checkpoint carry none, so later
+     * derivatives start at the first period calculated. Applies to the
+     * scenario workers as well.
+     */
+    void set_sensitivity_drivers(std::vector<std::string> driver_codes);
+
+    /**
+     * @brief Derivative of one output by every driver the run reads, from one reverse sweep
+     * @param output_code Line item differentiated, in the last period
+     * @param checkpoint_every Tape this many periods at a time (0: the whole run at once)
+     *
+     * The run's periods are calculated with the engine recording an
+     * unified::AdjointTape, which is then swept back from the output: one
+     * forward and one reverse pass whatever the number of drivers. With
+     * checkpoint_every = k, the forward pass keeps only a roll-forward
+     * checkpoint every k periods. Segments are then recomputed from their
+     * checkpoints, last first, and swept one at a time. Tape memory is
+     * bounded by k periods for about one more forward pass.
+     * Nothing is written, observed or cached. Period IDs must be ascending.
+     */
+    DriverGradient gradient(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const std::string& output_code,
+        size_t checkpoint_every = 0
+    );
+
+    /**
+     * @brief gradient() from driver rows held in memory (no driver query)
+     * @param drivers Rows of the run, as from DriverValueProvider::fetch_rows() (possibly edited)
+     */
+    DriverGradient gradient(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const std::string& output_code,
+        const unified::DriverValueProvider::DriverRows& drivers,
+        size_t checkpoint_every = 0
+    );
+
+    /**
+     * @brief Calculate and keep only some line items
+     * @param outputs Line item codes (empty: every line item)
+     *
+     * Each period calculates the outputs and the line items they depend on,
+     * including those read one period later as X[t-1] (see
+     * UnifiedEngine::set_output_selection()); the rest of the template is
+     * not calculated. Results, written periods and observed periods hold
+     * only the requested outputs the template has. Applies to the scenario
+     * workers as well.
+     */
+    void set_output_selection(std::vector<std::string> outputs);
+
+    /**
+     * @brief Run the jobs of run_multiple_scenarios() and run_jobs() on worker threads
+     * @param threads Threads including the caller (0: hardware concurrency, 1: sequential)
+     * @param connect Opens a worker's connection; called once per worker, on its own thread
+     *
+     * Scenarios only share their sticky action triggers, which are kept per
+     * scenario, so each worker runs whole jobs with its own
+     * PeriodRunner: engine, provider caches, action overlays and
+     * connection. The connections must be distinct (e.g. from the
+     * ConnectionPool overload, or InputSnapshot::open() so workers share
+     * one mapped input file). Results are the same as a sequential run.
+     * Templates registered on engine() aren't seen by workers.
+     */
+    void set_scenario_parallel(size_t threads, ConnectionFactory connect);
+
+    /**
+     * @brief set_scenario_parallel() with each worker reading through its pool reader
+     *
+     * The readers of an in-memory pool are its one writer connection, which
+     * isn't safe to share between threads: scenarios then run sequentially.
+     * The pool must outlive the runs.
+     */
+    void set_scenario_parallel(size_t threads, database::ConnectionPool& pool);
+
+    /**
+     * @brief Place scenario workers by NUMA node
+     * @param enabled Pin workers to cores of their node (see TaskScheduler)
+     * @param connect_node Opens a worker's connection for its node, e.g. on
+     *        the node's replica of an input snapshot (null: the
+     *        set_scenario_parallel() factory)
+     *
+     * Workers build their runner (engine, caches, arena) on their own
+     * thread and allocate their results there, so pinned workers keep them
+     * in their node's memory; with a replica per node their input pages
+     * are local too. Idle workers steal jobs from their own node first.
+     * Restarts the current scenario workers.
+     */
+    void set_numa_placement(bool enabled, NodeConnectionFactory connect_node = nullptr);
+
+    /**
+     * @brief Scheduler counters of the scenario workers (zero when sequential)
+     */
+    TaskSchedulerStats scenario_stats() const;
+
+    /**
+     * @brief Get the engine used for each period
+     */
+    const unified::UnifiedEngine& engine() const { return *engine_; }
+
 private:
     std::shared_ptr<database::IDatabase> db_;
+    core::Arena arena_;     ///< Scratch of the period being calculated, reset between periods
     std::unique_ptr<unified::UnifiedEngine> engine_;
+    std::shared_ptr<core::ReferenceDataStore> reference_;  ///< Null: engines load their own FX and units
+    std::shared_ptr<ResultWriter> writer_;
+    std::shared_ptr<TailLatencyTracker> tail_latency_;
+    size_t templates_created_ = 0;   ///< Action overlays registered with the engine so far
+    std::shared_ptr<CheckpointStore> checkpoints_;
+    std::shared_ptr<ResultCache> result_cache_;
+    PeriodObserver period_observer_;
+    size_t checkpoint_every_ = 12;
+    bool incremental_ = false;
+    bool incremental_seeding_ = false;
+    unified::ValidationPolicy validation_policy_;
+    std::vector<std::pair<std::string, std::shared_ptr<const pl::IStatefulTaxStrategy>>> tax_strategies_;
+
+    // Scenario workers (set_scenario_parallel()), created on first use
+    std::unique_ptr<TaskScheduler> scheduler_;
+    ConnectionFactory connect_;
+    bool numa_ = false;
+    NodeConnectionFactory connect_node_;
+    std::vector<std::unique_ptr<PeriodRunner>> scenario_workers_;
+
+    /**
+     * @brief Runner of a scenario worker, connected on first use
+     */
+    PeriodRunner& scenario_worker(size_t worker);
 
     // Track triggered conditional actions per scenario (sticky triggers)
     std::map<ScenarioID, std::set<std::string>> triggered_actions_;
 
+    /**
+     * @brief Loaded action with a signature of the parameters its patches depend on
+     */
+    using ScenarioAction = actions::ActionCatalog::Entry;
+
+    /**
+     * @brief Inputs of one job, read by the prefetch stage (absent: query failed, read as usual)
+     */
+    struct JobInputs {
+        std::optional<unified::DriverValueProvider::DriverRows> drivers;
+        std::optional<std::vector<ActionTrigger>> triggers;
+    };
+
+    // Prefetch stage (set_prefetch())
+    ConnectionFactory prefetch_connect_;
+    std::unique_ptr<database::AsyncDatabase> prefetch_db_;
+    size_t prefetch_depth_ = 2;
+    size_t prefetch_connections_ = 1;
+
+    /**
+     * @brief run_periods() starting from prefetched inputs
+     * @param prefetched Inputs read ahead (null: query them)
+     */
+    MultiPeriodResults run_periods(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const JobInputs* prefetched
+    );
+
+    /**
+     * @brief gradient() starting from prefetched inputs
+     * @param prefetched Inputs read ahead (null: query them)
+     */
+    DriverGradient gradient(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const std::string& output_code,
+        size_t checkpoint_every,
+        const JobInputs* prefetched
+    );
+
+    /**
+     * @brief Fingerprint of a run (see set_result_cache())
+     * @return Nothing if the run can't be fingerprinted (no such template): it is calculated
+     */
+    std::optional<RunFingerprint> run_fingerprint(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const unified::DriverValueProvider::DriverRows& drivers
+    );
+
+    // Horizon measures (set_horizon_measures())
+    std::vector<HorizonMeasure> horizon_measures_;
+
+    // Stop conditions (set_stop_conditions()); the formula compiled by trigger_evaluator_
+    StopConditions stop_;
+    std::shared_ptr<const core::CompiledFormula> stop_condition_;
+
+    /**
+     * @brief Why a run stops after a period
+     * @return Empty if it goes on
+     */
+    std::string stop_reason(ScenarioID scenario_id, PeriodID period_id, const unified::UnifiedResult& result) const;
+
+    // Drivers differentiated by (set_sensitivity_drivers())
+    std::vector<std::string> sensitivity_drivers_;
+
+    // gradient(): checkpoints kept in memory, and the one a run resumes from
+    std::function<void(const RunCheckpoint&)> checkpoint_sink_;
+    const RunCheckpoint* resume_from_ = nullptr;
+
+    /**
+     * @brief Set the horizon measures of a finished run
+     */
+    void add_horizon_measures(MultiPeriodResults& results) const;
+
+    /**
+     * @brief Hand a finished run's trace to the tracker
+     * @return Its JSON if it is an exemplar, else empty
+     */
+    std::string record_trace(std::optional<RunTrace>& trace, std::chrono::steady_clock::time_point started);
+
+    // Output selection (set_output_selection()): projected schema per calculated one
+    struct OutputProjection {
+        std::shared_ptr<const unified::ResultSchema> source;   ///< Held, so its address stays unique
+        std::shared_ptr<const unified::ResultSchema> schema;
+        std::vector<uint32_t> indexes;                         ///< Source index of each projected line item
+    };
+    std::vector<std::string> outputs_;
+    std::unordered_map<const unified::ResultSchema*, OutputProjection> output_projections_;
+
+    /**
+     * @brief Reduce a calculated period to the selected outputs
+     */
+    void project_outputs(unified::ResultRow& row);
+
+    // Fingerprinted template with its validation rules, and the reference data, once per runner
+    std::shared_ptr<const core::StatementTemplate> fingerprinted_template_;
+    RunFingerprint template_fingerprint_;
+    std::optional<RunFingerprint> reference_fingerprint_;
+
+    /// Receives a finished job: (job index, worker index, results)
+    using JobSink = std::function<void(size_t, size_t, MultiPeriodResults&&)>;
+
+    /**
+     * @brief Run jobs sequentially or on the scenario workers, handing each one's results to the sink
+     *
+     * The sink is called on the thread that ran the job (worker 0: sequential).
+     */
+    void for_each_job(
+        const std::vector<ScenarioJob>& jobs,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const JobSink& sink
+    );
+
+    /**
+     * @brief Run jobs in order, reading each job's inputs while the previous one calculates
+     */
+    void run_jobs_prefetched(
+        const std::vector<ScenarioJob>& jobs,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const JobSink& sink
+    );
+
+    // Actions of each scenario, read once per run_periods() call
+    std::map<ScenarioID, std::vector<ActionTrigger>> scenario_triggers_;
+    std::map<ScenarioID, std::shared_ptr<const actions::ActionCatalog>> scenario_actions_;
+    std::shared_ptr<const actions::ActionCatalog> action_catalog_;   ///< set_action_catalog()
+    std::shared_ptr<const carbon::Scope3Results> scope3_results_;    ///< set_scope3_results()
+    std::optional<std::pair<std::string, std::string>> policies_;   ///< select_policies() (working capital, capex)
+
+    // Action overlays registered with the engine: base code + formula patches → overlay code
+    std::map<std::string, std::string> action_templates_;
+
+    // Base code + sorted (active action, signature) pairs → overlay code
+    std::map<std::string, std::string> action_set_templates_;
+
+    // Base code + sorted (action, signature) pairs of a scenario → parametric overlay code
+    std::map<std::string, std::string> parametric_templates_;
+    bool parametric_actions_ = false;
+
+    /**
+     * @brief Trigger rows of a scenario (queried on first use in a run)
+     */
+    const std::vector<ActionTrigger>& triggers_for(ScenarioID scenario_id);
+
+    /**
+     * @brief Catalogue holding a scenario's actions: the shared one, or one loaded on first use in a run
+     */
+    const actions::ActionCatalog& catalog_for(ScenarioID scenario_id);
+
+    /**
+     * @brief Management actions of a scenario (catalog_for())
+     */
+    const std::vector<ScenarioAction>& actions_for(ScenarioID scenario_id) {
+        return catalog_for(scenario_id).actions(scenario_id);
+    }
+
+    /**
+     * @brief Trigger of a scenario_action row, prepared once per run
+     */
+    struct CompiledTrigger {
+        enum class Kind { WINDOW, CONDITIONAL, NEVER };
+
+        const ActionTrigger* row = nullptr;
+        Kind kind = Kind::NEVER;
+        PeriodID first = 0;                                       ///< First period it can be active in
+        PeriodID last = -1;                                       ///< Last one (-1: open-ended)
+        std::shared_ptr<const core::CompiledFormula> condition;   ///< CONDITIONAL (null: never true)
+    };
+
+    /**
+     * @brief A scenario's compiled triggers and the overlays its active sets resolved to
+     */
+    struct ScenarioTriggers {
+        std::vector<CompiledTrigger> triggers;
+
+        // Filled when a trigger first activates (loads the scenario's actions)
+        bool actions_mapped = false;
+        std::vector<std::vector<size_t>> trigger_actions;   ///< Trigger → its actions_for() indexes
+
+        // (base template, mask of effective actions) → template code
+        std::map<std::pair<std::string, std::vector<uint64_t>>, std::string> templates;
+
+        // Base template → parametric overlay code (set_parametric_actions())
+        std::map<std::string, std::string> parametric_templates;
+    };
+
+    // Compiled triggers of each scenario, rebuilt once per run_periods() call
+    std::map<ScenarioID, ScenarioTriggers> compiled_triggers_;
+    core::FormulaEvaluator trigger_evaluator_;
+
+    /**
+     * @brief Compiled triggers of a scenario (compiled on first use in a run)
+     */
+    ScenarioTriggers& compiled_triggers_for(ScenarioID scenario_id);
+
     /**
      * @brief Determine which template to use for a given period
      * @param scenario_id Scenario identifier
@@ -149,16 +908,16 @@ private:
      * @param prior_values Prior period values for conditional evaluation
      * @return Template code to use for this period
      *
-     * This method:
-     * 1. Queries scenario_action for actions applicable to this period
-     * 2. Evaluates trigger conditions (for CONDITIONAL actions)
-     * 3. Determines active action set based on triggers + timing
-     * 4. Returns appropriate template code (creates if needed)
+     * Triggers are read and compiled once per run (activity windows, and
+     * conditions compiled to bytecode); each period only evaluates the
+     * conditions in their window and updates a bitmask of active
+     * triggers. An active set already seen in the run maps straight to
+     * its template, otherwise create_or_get_action_template() builds it.
      *
      * Template naming convention:
      * - Base: "TEMPLATE_NAME"
-     * - With actions: "TEMPLATE_NAME_S{scenario_id}_P{period_id}_A{action_codes}"
-     *   Example: "TEST_UNIFIED_L10_S14_P5_A_LED_SOLAR"
+     * - With actions: "TEMPLATE_NAME+{action_code}+..." (in-memory overlay)
+     *   Example: "TEST_UNIFIED_L10+LED+SOLAR"
      */
     std::string get_template_for_period(
         ScenarioID scenario_id,
@@ -168,14 +927,18 @@ private:
     );
 
     /**
-     * @brief Create or retrieve cached template for action combination
-     * @param base_template_code Base template to clone
+     * @brief Create or retrieve the overlay template for an action combination
+     * @param base_template_code Base template the actions patch
      * @param scenario_id Scenario identifier
      * @param period_id Period identifier
      * @param active_actions List of actions to apply
      * @return Template code for the combined actions
      *
-     * Caches templates in database to avoid recreating identical combinations.
+     * The actions' effect is a sparse set of formula patches over the base
+     * template (ActionEngine::formula_patches()). Each distinct patch set
+     * becomes one in-memory template registered with the engine, shared by
+     * every scenario and period that produces it, so its calculation plan is
+     * built once. Nothing is written to statement_template.
      */
     std::string create_or_get_action_template(
         const std::string& base_template_code,
@@ -183,6 +946,18 @@ private:
         PeriodID period_id,
         const std::vector<std::string>& active_action_codes
     );
+
+    /**
+     * @brief Create or retrieve the parametric overlay of all of a scenario's actions
+     * @return Template code "TEMPLATE_NAME+{action_code}+...@periods"
+     *
+     * Shared like create_or_get_action_template() overlays: the same base
+     * and action parameters give the same template in every scenario.
+     */
+    std::string create_or_get_parametric_template(
+        const std::string& base_template_code,
+        ScenarioID scenario_id
+    );
 };
 
 } // namespace orchestration
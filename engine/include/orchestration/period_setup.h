@@ -14,6 +14,23 @@
 namespace finmodel {
 namespace orchestration {
 
+/**
+ * @brief Length of the periods of a schedule segment
+ */
+enum class PeriodGranularity {
+    MONTHLY,
+    QUARTERLY,
+    ANNUAL
+};
+
+/**
+ * @brief count consecutive periods of one granularity
+ */
+struct PeriodSegment {
+    PeriodGranularity granularity = PeriodGranularity::MONTHLY;
+    int count = 0;
+};
+
 /**
  * @brief Utilities for creating and managing periods
  */
@@ -40,6 +57,33 @@ public:
         int num_periods
     );
 
+    /**
+     * @brief Create consecutive periods of mixed granularity
+     * @param db Database connection
+     * @param start_date Starting date (YYYY-MM-DD format)
+     * @param segments Segments in chronological order, each starting where the previous one ends
+     * @return Vector of period IDs in chronological order
+     *
+     * Each period gets its calendar days_in_period, so flow drivers scale
+     * with its length (core::TimeScaling). The engine's [t-1] is the
+     * period before in the run, whatever its length: the first annual
+     * period opens with the last monthly one's closing values.
+     *
+     * Example:
+     * @code
+     * auto periods = PeriodSetup::create_period_schedule(
+     *     db.get(), "2024-01-01",
+     *     {{PeriodGranularity::MONTHLY, 36}, {PeriodGranularity::ANNUAL, 27}}
+     * );
+     * // 2024-01 .. 2026-12, then 2027 .. 2053
+     * @endcode
+     */
+    static std::vector<PeriodID> create_period_schedule(
+        database::IDatabase* db,
+        const std::string& start_date,
+        const std::vector<PeriodSegment>& segments
+    );
+
     /**
      * @brief Get all periods in chronological order
      * @param db Database connection
@@ -84,6 +128,9 @@ private:
 
     // Helper: Get last day of month
     static int last_day_of_month(int year, int month);
+
+    // Helper: Days since 1970-01-01
+    static long days_from_civil(const Date& date);
 };
 
 } // namespace orchestration
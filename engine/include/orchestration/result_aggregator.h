@@ -0,0 +1,111 @@
+/**
+ * @file result_aggregator.h
+ * @brief Statistics per line item and period across runs, in constant memory
+ *
+ * Sweeps over thousands of scenarios usually want distributions, not the
+ * runs themselves: a ResultAggregator takes each run's periods as they are
+ * calculated and keeps only a core::StreamingStatistics per (line item,
+ * period) - moments, range and a quantile sketch. Memory depends on the
+ * line items and periods, not on the number of runs.
+ *
+ * Not thread-safe: give each worker its own (empty_copy()) and merge()
+ * them at the end. Every statistic merges exactly: the result is the same
+ * bit for bit however the runs were split between the aggregators.
+ *
+ * Usage:
+ * @code
+ * ResultAggregator stats(periods, 0.01, {"CASH", "NET_INCOME"});
+ * runner.aggregate_scenarios("E", scenario_ids, periods, opening, "TEMPLATE", stats);
+ * double p5 = stats.get("CASH", periods.back())->quantile(0.05);
+ * @endcode
+ */
+
+#pragma once
+
+#include "types/common_types.h"
+#include "core/streaming_statistics.h"
+#include "unified/result_row.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+struct MultiPeriodResults;
+
+/**
+ * @brief StreamingStatistics per line item and period of many runs
+ */
+class ResultAggregator {
+public:
+    /**
+     * @brief Empty aggregator
+     * @param period_ids Periods with statistics (others are ignored)
+     * @param relative_accuracy Of quantiles
+     * @param line_items Line items with statistics (empty: all)
+     * @throws std::invalid_argument unless relative_accuracy is in (0, 1)
+     */
+    explicit ResultAggregator(std::vector<PeriodID> period_ids, double relative_accuracy = 0.01,
+                              std::vector<std::string> line_items = {});
+
+    /**
+     * @brief Aggregator with the same settings and no values
+     */
+    ResultAggregator empty_copy() const;
+
+    /**
+     * @brief Add one period's values of a run
+     */
+    void add(PeriodID period_id, const unified::ResultRow& values);
+
+    /**
+     * @brief Add a run's periods (those after its resumed ones)
+     *
+     * Failed runs are only counted, so every period's statistics cover
+     * the same runs.
+     */
+    void add(const MultiPeriodResults& results, const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Add another aggregator's statistics and run counts
+     * @throws std::invalid_argument if its periods, accuracy or line items differ
+     */
+    void merge(const ResultAggregator& other);
+
+    /**
+     * @brief Statistics of a line item in a period
+     * @return Null if the line item or period has none
+     */
+    const core::StreamingStatistics* get(const std::string& code, PeriodID period_id) const;
+
+    /// Line items with statistics (the tracked ones, or all in the order first seen)
+    const std::vector<std::string>& line_items() const { return codes_; }
+
+    const std::vector<PeriodID>& period_ids() const { return period_ids_; }
+    size_t runs() const { return runs_; }                 ///< Runs added by add(results, ...)
+    size_t failed_runs() const { return failed_runs_; }   ///< Of those, failed (not in the statistics)
+
+private:
+    std::vector<PeriodID> period_ids_;
+    double relative_accuracy_;
+    std::vector<std::string> tracked_;
+
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, size_t> slots_;
+    std::vector<std::vector<core::StreamingStatistics>> statistics_;   // [slot][period]
+    size_t runs_ = 0;
+    size_t failed_runs_ = 0;
+
+    // Slot of each line item of the last schema seen (-1: not tracked)
+    std::shared_ptr<const unified::ResultSchema> schema_;
+    std::vector<long> schema_slots_;
+
+    long slot(const std::string& code);
+    ptrdiff_t period_index(PeriodID period_id) const;
+};
+
+} // namespace orchestration
+} // namespace finmodel
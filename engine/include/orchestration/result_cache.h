@@ -0,0 +1,183 @@
+/**
+ * @file result_cache.h
+ * @brief Content-addressed results of whole scenario runs, shared across runs
+ *
+ * A run's results follow from its inputs alone: the template, the
+ * effective driver values, the reference data (units, FX rates,
+ * validation rules), the opening balance sheet and the periods. Sweeps
+ * and reruns often repeat runs with the same inputs - an unchanged
+ * scenario in tomorrow's rerun, or scenarios of a sweep that differ only
+ * in drivers the template never resolves to a different value. A
+ * RunFingerprint is a 128-bit hash of those inputs; with
+ * PeriodRunner::set_result_cache() a run whose fingerprint is cached is
+ * read instead of calculated, and runs of a sweep with equal fingerprints
+ * are calculated once: a second worker reaching the same fingerprint
+ * waits for the first one's results.
+ *
+ * Entries live in memory (least recently used ones are dropped) and, with
+ * a directory, in one file per fingerprint that later processes read.
+ *
+ * Usage:
+ * @code
+ * auto cache = std::make_shared<ResultCache>("result_cache");
+ * runner.set_result_cache(cache);
+ * auto first = runner.run_periods(entity, 1, periods, opening, "CORP");    // Calculated
+ * auto again = runner.run_periods(entity, 1, periods, opening, "CORP");    // Read from the cache
+ * @endcode
+ */
+
+#ifndef FINMODEL_RESULT_CACHE_H
+#define FINMODEL_RESULT_CACHE_H
+
+#include "unified/unified_engine.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief 128-bit content hash of a run's inputs
+ */
+struct RunFingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    /// 32 lowercase hex digits (the cache file name)
+    std::string hex() const;
+
+    bool operator==(const RunFingerprint& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const RunFingerprint& other) const { return !(*this == other); }
+    bool operator<(const RunFingerprint& other) const {
+        return high != other.high ? high < other.high : low < other.low;
+    }
+};
+
+/**
+ * @brief Builds a RunFingerprint from a sequence of values
+ *
+ * Stable across processes and platforms of the same byte order (no
+ * std::hash): fingerprints of cache files stay valid. Texts are length
+ * prefixed, so ("AB", "C") and ("A", "BC") differ.
+ */
+class FingerprintBuilder {
+public:
+    FingerprintBuilder& add_int(int64_t value);
+    FingerprintBuilder& add_double(double value);
+    FingerprintBuilder& add_text(std::string_view text);
+    FingerprintBuilder& add_fingerprint(const RunFingerprint& fingerprint);
+
+    RunFingerprint finish() const;
+
+private:
+    void bytes(const void* data, size_t size);
+
+    // Two independent lanes: FNV-1a and a multiply-xorshift
+    uint64_t a_ = 1469598103934665603ULL;
+    uint64_t b_ = 0x9E3779B97F4A7C15ULL;
+    uint64_t length_ = 0;
+};
+
+/**
+ * @brief Results of one run, as the cache keeps them
+ */
+struct CachedRun {
+    std::vector<unified::UnifiedResult> periods;
+    std::vector<std::string> errors;            ///< Run-level errors and warnings (MultiPeriodResults)
+    unified::Diagnostics warnings;
+    std::set<std::string> triggered_actions;    ///< Sticky triggers of the scenario after the run
+};
+
+/**
+ * @brief Counters of a ResultCache
+ */
+struct ResultCacheStats {
+    size_t memory_hits = 0;
+    size_t disk_hits = 0;
+    size_t shared = 0;     ///< Hits that waited for a concurrent run with the same fingerprint
+    size_t misses = 0;
+    size_t stores = 0;
+    size_t entries = 0;    ///< Runs held in memory
+};
+
+/**
+ * @brief Memory and disk tiers of cached runs, shared by a runner and its scenario workers
+ *
+ * Thread-safe. A miss claims the fingerprint for the caller, who must
+ * then store() the run's results or release() the claim; acquire() calls
+ * for a claimed fingerprint wait for that.
+ */
+class ResultCache {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    /**
+     * @param dir Directory of the cache files, created on first store (empty: memory only)
+     * @param memory_entries Runs kept in memory (at least 1)
+     */
+    explicit ResultCache(std::string dir = "", size_t memory_entries = 256);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @brief Cached results of a fingerprint, or a claim to calculate them
+     * @return Results (memory, or disk), or null: the caller now owns the fingerprint
+     *
+     * Damaged or outdated files count as misses and are removed.
+     */
+    std::shared_ptr<const CachedRun> acquire(const RunFingerprint& fingerprint);
+
+    /**
+     * @brief Keep a claimed fingerprint's results and hand them to waiting callers
+     * @throws std::runtime_error if the cache file can't be written (the results are still kept in memory)
+     */
+    void store(const RunFingerprint& fingerprint, CachedRun run);
+
+    /**
+     * @brief Give up a claim without results (failed or cancelled run)
+     */
+    void release(const RunFingerprint& fingerprint);
+
+    ResultCacheStats stats() const;
+
+    /**
+     * @brief Drop every entry, in memory and on disk
+     */
+    void clear();
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    struct Entry {
+        std::shared_ptr<const CachedRun> run;
+        uint64_t last_used = 0;
+    };
+
+    std::string path(const RunFingerprint& fingerprint) const;
+    /// Add to memory, dropping the least recently used entry if full (mutex_ held)
+    void remember(const RunFingerprint& fingerprint, std::shared_ptr<const CachedRun> run);
+
+    const std::string dir_;
+    const size_t memory_entries_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    std::map<RunFingerprint, Entry> entries_;
+    std::set<RunFingerprint> in_flight_;   ///< Claimed by a run calculating them
+    uint64_t clock_ = 0;
+    ResultCacheStats stats_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RESULT_CACHE_H
@@ -0,0 +1,54 @@
+/**
+ * @file result_precision.h
+ * @brief Which stored line items may drop to float32
+ *
+ * Results are always calculated in double. An exploratory sweep rarely
+ * needs 15 significant digits of every intermediate line item, though,
+ * and a float32 column takes half the memory and file size of a double
+ * one. A ResultPrecision tells a result store (ColumnarResultWriter,
+ * CompressedResultSet) which line items it may round to float32 when it
+ * stores them: all of them, or a chosen few, but never the key
+ * reconciliation items, which checks compare to the cent.
+ *
+ * Usage:
+ * @code
+ * ResultPrecision precision;
+ * precision.float32 = true;                       // Every line item but the key ones
+ * ColumnarResultWriter writer("sweep.fmcr", 8192, precision);
+ * @endcode
+ */
+
+#ifndef FINMODEL_RESULT_PRECISION_H
+#define FINMODEL_RESULT_PRECISION_H
+
+#include <set>
+#include <string>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Storage precision of line items (calculation stays in double)
+ */
+struct ResultPrecision {
+    bool float32 = false;                  ///< Store line items as float32 (default: all in double)
+    std::set<std::string> float32_items;   ///< With float32: only these (empty: every line item)
+    std::set<std::string> double_items = key_items();   ///< Kept in double regardless
+
+    /**
+     * @brief Line items balance sheet and cash checks reconcile: CASH, TOTAL_ASSETS, TOTAL_EQUITY
+     */
+    static std::set<std::string> key_items() { return {"CASH", "TOTAL_ASSETS", "TOTAL_EQUITY"}; }
+
+    /**
+     * @brief Whether code is stored as float32
+     */
+    bool is_float32(const std::string& code) const {
+        return float32 && !double_items.count(code) && (float32_items.empty() || float32_items.count(code));
+    }
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RESULT_PRECISION_H
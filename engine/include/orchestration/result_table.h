@@ -0,0 +1,167 @@
+/**
+ * @file result_table.h
+ * @brief SQL over in-memory and columnar results, without copying them into tables
+ *
+ * Analysts query sweeps with SQL: join with entity, filter scenarios,
+ * aggregate. Writing every value to unified_result first costs more than
+ * the sweep. A ResultTable instead exposes results where they already
+ * are - a CompressedResultSet of the current run, ColumnarResultReader
+ * files of earlier ones - as a SQLite virtual table:
+ *
+ * @code
+ * run_results(scenario_id INTEGER, entity_id TEXT, period_id INTEGER, line_item TEXT, value REAL)
+ * @endcode
+ *
+ * Constraints on scenario_id and period_id (=, <, <=, >, >=), entity_id
+ * and line_item (=, and IN for line_item) and value (ranges) are pushed
+ * into the scan: only the matching line items are decoded, a single
+ * scenario of a CompressedResultSet decodes one run, and value ranges on
+ * columnar files skip row groups by their statistics. Rows are produced
+ * one line item at a time, so memory stays at one line item's values.
+ * Cells without a value (NaN) have no row.
+ *
+ * Usage:
+ * @code
+ * auto sweep = std::make_shared<CompressedResultSet>(periods);
+ * ... sweep->add(scenario, results) ...
+ * auto table = std::make_shared<ResultTable>();
+ * table->add("ACME", sweep);
+ * table->add("BETA", std::make_shared<ColumnarResultReader>("run_42_BETA.fmcr"));
+ * ResultTable::register_module(*db, table);    // db: a SQLite connection
+ * db->execute_query("SELECT e.name, AVG(value) FROM run_results r JOIN entity e USING (entity_id) "
+ *                   "WHERE line_item = 'CASH' AND period_id = 12 GROUP BY e.name", {});
+ * @endcode
+ */
+
+#ifndef FINMODEL_RESULT_TABLE_H
+#define FINMODEL_RESULT_TABLE_H
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/compressed_results.h"
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Bounds pushed into a result scan (inclusive)
+ */
+struct ResultTableFilter {
+    ScenarioID scenario_min = std::numeric_limits<ScenarioID>::min();
+    ScenarioID scenario_max = std::numeric_limits<ScenarioID>::max();
+    PeriodID period_min = std::numeric_limits<PeriodID>::min();
+    PeriodID period_max = std::numeric_limits<PeriodID>::max();
+    double value_min = -std::numeric_limits<double>::infinity();
+    double value_max = std::numeric_limits<double>::infinity();
+
+    bool matches(ScenarioID scenario_id, PeriodID period_id, double value) const {
+        return scenario_id >= scenario_min && scenario_id <= scenario_max &&
+               period_id >= period_min && period_id <= period_max &&
+               value >= value_min && value <= value_max;   // False for NaN
+    }
+};
+
+/**
+ * @brief Results of one entity as seen by a ResultTable
+ */
+class ResultTableSource {
+public:
+    virtual ~ResultTableSource() = default;
+
+    /**
+     * @brief Line items, indexed by read()
+     */
+    virtual const std::vector<std::string>& line_items() const = 0;
+
+    /**
+     * @brief Rows (scenario, period, value) of a line item within the filter
+     * @param code Index into line_items()
+     * @param out Replaced by the matching rows (cells without a value left out)
+     */
+    virtual void read(size_t code, const ResultTableFilter& filter, ColumnarSeries& out) const = 0;
+
+    /**
+     * @brief Rows of one line item (for query planning)
+     */
+    virtual size_t rows_per_line_item() const = 0;
+};
+
+/**
+ * @brief A CompressedResultSet (the current run) as a result source
+ */
+class CompressedResultSource : public ResultTableSource {
+public:
+    explicit CompressedResultSource(std::shared_ptr<const CompressedResultSet> results);
+
+    const std::vector<std::string>& line_items() const override { return results_->line_items(); }
+    void read(size_t code, const ResultTableFilter& filter, ColumnarSeries& out) const override;
+    size_t rows_per_line_item() const override;
+
+private:
+    std::shared_ptr<const CompressedResultSet> results_;
+};
+
+/**
+ * @brief A columnar result file (a loaded run) as a result source
+ */
+class ColumnarResultSource : public ResultTableSource {
+public:
+    explicit ColumnarResultSource(std::shared_ptr<const ColumnarResultReader> reader);
+
+    const std::vector<std::string>& line_items() const override { return reader_->line_items(); }
+    void read(size_t code, const ResultTableFilter& filter, ColumnarSeries& out) const override;
+    size_t rows_per_line_item() const override { return reader_->row_count(); }
+
+private:
+    std::shared_ptr<const ColumnarResultReader> reader_;
+};
+
+/**
+ * @brief Results of several entities, queryable as a SQLite virtual table
+ *
+ * Sources are read-only and may be queried from several connections at
+ * once; add() must not run while the table is queried.
+ */
+class ResultTable {
+public:
+    /// Default table (and module) name
+    static constexpr const char* DEFAULT_NAME = "run_results";
+
+    struct Entry {
+        EntityID entity_id;
+        std::shared_ptr<const ResultTableSource> source;
+    };
+
+    void add(const EntityID& entity_id, std::shared_ptr<const ResultTableSource> source);
+    void add(const EntityID& entity_id, std::shared_ptr<const CompressedResultSet> results);
+    void add(const EntityID& entity_id, std::shared_ptr<const ColumnarResultReader> reader);
+
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    /**
+     * @brief Make a table queryable on a SQLite connection
+     * @param db SQLite connection (database::SQLiteDatabase)
+     * @param table Results (kept alive by the connection until replaced or closed)
+     * @param name Table name; registering a name again replaces its results
+     * @throws std::invalid_argument if db isn't a connected SQLite database
+     * @throws database::DatabaseException if SQLite rejects the module
+     *
+     * The table is eponymous: it exists under its name in every schema of
+     * the connection without a CREATE VIRTUAL TABLE, and is read-only.
+     */
+    static void register_module(database::IDatabase& db, std::shared_ptr<const ResultTable> table,
+                                const std::string& name = DEFAULT_NAME);
+
+private:
+    std::vector<Entry> entries_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RESULT_TABLE_H
@@ -0,0 +1,244 @@
+/**
+ * @file result_writer.h
+ * @brief Asynchronous persistence of calculated periods
+ *
+ * Calculation threads hand finished periods to a ResultWriter and carry on;
+ * a dedicated writer thread drains the queue and stores everything queued
+ * since its last pass in one transaction, one prepared INSERT for all rows
+ * (IDatabase::execute_batch()). Each run gets a run_log row whose
+ * json_config records the run's calculation and write times (and a slow
+ * run's trace, see TailLatencyTracker).
+ *
+ * The queue is a bounded lock-free ring (core::MpscRing) of reusable
+ * jobs: scenario workers hand periods over without taking a lock, and a
+ * period's line item values are copied into the buffer the slot already
+ * holds. When the writer falls behind and the ring is full, workers wait
+ * (backpressure) instead of growing the queue; queue depth and these
+ * stalls are in stats() and in core::EngineMetrics (/metrics).
+ *
+ * Rows are stored in long format in unified_result (migration
+ * 005_unified_results.sql): one row per (run, entity, scenario, period,
+ * line item).
+ *
+ * Usage:
+ * @code
+ * auto writer = std::make_shared<ResultWriter>(pool.writer());
+ * runner.set_result_writer(writer);   // run_periods() now queues every period
+ * auto results = runner.run_periods(...);
+ * writer->flush();                    // Wait until everything queued is stored
+ * @endcode
+ *
+ * The writer thread is the only user of its connection: give it one the
+ * calculation doesn't read through (e.g. ConnectionPool::writer() with the
+ * engine on a reader, or a separate results database).
+ *
+ * With summary measures (set_summary()) the writer also folds each run's
+ * periods into a RunSummary per (scenario, entity) as it stores them, and
+ * writes them to run_summary (migration 014_run_summary.sql) with the
+ * run's completion: KPIs without a second pass over the results.
+ *
+ * On a SQLite connection the writer holds a database::BulkLoadSession
+ * while it lives: commits don't wait for the disk and the WAL is
+ * checkpointed less often, and unified_result is analyzed when the writer
+ * is destroyed.
+ */
+
+#ifndef FINMODEL_RESULT_WRITER_H
+#define FINMODEL_RESULT_WRITER_H
+
+#include "types/common_types.h"
+#include "core/mpsc_ring.h"
+#include "database/idatabase.h"
+#include "orchestration/run_summary.h"
+#include "unified/result_row.h"
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace finmodel {
+namespace database {
+class BulkLoadSession;
+}
+
+namespace orchestration {
+
+/**
+ * @brief Counters of a ResultWriter
+ */
+struct ResultWriterStats {
+    size_t runs = 0;            ///< run_log rows inserted
+    size_t periods = 0;         ///< Periods written
+    size_t rows = 0;            ///< unified_result rows written
+    size_t transactions = 0;    ///< Write passes (one transaction each)
+    size_t summaries = 0;       ///< run_summary rows written
+    size_t exemplars = 0;       ///< Slow-run traces stored in run_log
+    double write_seconds = 0.0; ///< Time spent in write passes
+    size_t queue_capacity = 0;  ///< Jobs (runs begun or ended, periods) the queue holds
+    size_t queue_depth = 0;     ///< Jobs queued and not taken by the writer thread yet
+    size_t max_queue_depth = 0;
+    size_t stalls = 0;          ///< Jobs whose submission waited for a full queue
+    double stall_seconds = 0.0; ///< Time those submissions waited
+};
+
+/**
+ * @brief Queue of calculated periods stored by a background thread
+ *
+ * begin_run(), write_period() and end_run() only copy their arguments into
+ * the queue, and wait only if it is full. Jobs are applied in submission
+ * order, so a run's periods always follow its run_log row. A failed write pass is rolled back, its
+ * error kept, and rethrown by the next flush().
+ */
+class ResultWriter {
+public:
+    /// Handle of a run, valid for this writer
+    using RunHandle = int;
+
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 1024;
+
+    /**
+     * @brief Start the writer thread
+     * @param db Connection used only by the writer thread
+     * @param max_rows_per_transaction A write pass commits after this many rows
+     * @param defer_indexes Drop the secondary indexes of unified_result until
+     *        the writer is destroyed (for a writer storing many runs that
+     *        nothing queries until it is done)
+     * @param queue_capacity Jobs queued before submissions wait (rounded up to a power of two)
+     */
+    explicit ResultWriter(std::shared_ptr<database::IDatabase> db,
+                          size_t max_rows_per_transaction = 100000,
+                          bool defer_indexes = false,
+                          size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+
+    /**
+     * @brief Store everything queued, then stop the writer thread
+     *
+     * Errors are dropped: call flush() first to see them.
+     */
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    /**
+     * @brief Summarise runs begun from now on (empty spec: no summaries, the default)
+     *
+     * Periods of one run with the same scenario and entity share a
+     * run_summary row, written when end_run() is stored.
+     */
+    void set_summary(RunSummarySpec spec);
+
+    /**
+     * @brief Queue a run_log row with status 'running'
+     * @param scenario_id Scenario of the run
+     * @param config_json Run configuration (JSON object) kept in json_config
+     * @return Handle to pass to write_period() and end_run()
+     */
+    RunHandle begin_run(ScenarioID scenario_id, const std::string& config_json = "{}");
+
+    /**
+     * @brief Queue one calculated period of a run
+     * @param run Handle from begin_run()
+     * @param entity_id Entity code
+     * @param scenario_id Scenario identifier
+     * @param period_id Period identifier
+     * @param values Calculated line items (copied)
+     */
+    void write_period(RunHandle run, const EntityID& entity_id, ScenarioID scenario_id,
+                      PeriodID period_id, const unified::ResultRow& values);
+
+    /**
+     * @brief Queue completion of a run
+     * @param run Handle from begin_run()
+     * @param success Final status: 'completed' or 'failed'
+     * @param error_message Stored for failed runs
+     * @param calculation_seconds Time the run spent calculating
+     * @param exemplar_json Trace of a slow run (RunTrace::to_json(); empty: none)
+     *
+     * Sets completed_at and adds calculation_ms and write_ms (time spent
+     * storing the run's periods) to json_config, and the trace as exemplar.
+     */
+    void end_run(RunHandle run, bool success, const std::string& error_message = "",
+                 double calculation_seconds = 0.0, const std::string& exemplar_json = "");
+
+    /**
+     * @brief Wait until every queued job is stored
+     * @throws DatabaseException with the first error since the last flush()
+     */
+    void flush();
+
+    /**
+     * @brief run_log.run_id of a run
+     * @return Row ID, or -1 if the run's row isn't stored yet (see flush())
+     */
+    int64_t run_id(RunHandle run) const;
+
+    /**
+     * @brief Counters so far
+     */
+    ResultWriterStats stats() const;
+
+private:
+    enum class JobType { BEGIN, PERIOD, END };
+
+    /// A queue slot: filled in place, its buffers reused by later jobs
+    struct Job {
+        JobType type = JobType::PERIOD;
+        RunHandle run = 0;
+        ScenarioID scenario_id = 0;
+        PeriodID period_id = 0;
+        EntityID entity_id;
+        std::string text;             ///< BEGIN: config JSON; END: error message
+        std::string exemplar;         ///< END: slow-run trace JSON (empty: none)
+        unified::ResultRow values;    ///< PERIOD only (other jobs leave the previous values)
+        bool success = true;
+        double calculation_seconds = 0.0;
+        std::shared_ptr<const RunSummarySpec> summary;   ///< BEGIN: measures of the run (null: none)
+    };
+
+    struct RunInfo {
+        int64_t run_id = -1;
+        double write_seconds = 0.0;
+    };
+
+    std::shared_ptr<database::IDatabase> db_;
+    size_t max_rows_per_transaction_;
+    std::unique_ptr<database::BulkLoadSession> bulk_;  ///< Null for other databases
+
+    core::MpscRing<Job> queue_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    uint64_t written_ = 0;          ///< Jobs taken off the queue and applied
+    std::string error_;
+    RunHandle next_run_ = 0;
+    std::map<RunHandle, RunInfo> runs_;
+    ResultWriterStats stats_;
+    std::shared_ptr<const RunSummarySpec> summary_;
+
+    /// Summaries of runs being written, by (scenario, entity) (writer thread only)
+    std::map<RunHandle, std::map<std::pair<ScenarioID, EntityID>, RunSummary>> summaries_;
+    std::map<RunHandle, std::shared_ptr<const RunSummarySpec>> summary_specs_;
+
+    std::thread thread_;
+
+    /// Queue a job: fill sets its fields (after the ones every job resets)
+    template <typename Fill>
+    void enqueue(JobType type, RunHandle run, Fill&& fill);
+
+    void writer_loop();
+
+    /**
+     * @brief Store the first count jobs of a batch (writer thread)
+     */
+    void write_jobs(std::vector<Job>& jobs, size_t count);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RESULT_WRITER_H
@@ -0,0 +1,172 @@
+/**
+ * @file reverse_stress.h
+ * @brief Search the driver shocks at which a scenario just breaches a threshold
+ *
+ * A reverse stress test asks the opposite of a stress test: not "what does
+ * this shock do to capital" but "which shocks break it". Drivers are
+ * shifted by the same amount in every period (as GoalSeeker), each within
+ * a constrained range, and a run breaches when the breach line item
+ * crosses the threshold in any period. The margin of a run is its
+ * smallest distance to the threshold over the periods, negative once
+ * breached.
+ *
+ * Shifts are searched in units of each driver's range (upper - lower), so
+ * drivers of different scales are comparable; the severity of a shock is
+ * its length in these units. The breach boundary is located by
+ *
+ * - BISECTION along directions from the base scenario (every driver axis
+ *   both ways, then Sobol directions) to the edge of the driver box
+ * - GRADIENT steps on the adjoint gradient of the margin
+ *   (PeriodRunner::gradient(): one forward and one reverse pass per step)
+ *   towards the least severe breaching shock (Hasofer-Lind iteration)
+ * - ADAPTIVE: bisection, then rounds of directions scattered around the
+ *   least severe boundary scenarios found so far, each bracketed next to
+ *   its neighbour's boundary rather than over the whole box
+ *
+ * Each boundary scenario costs about log2(1 / tolerance) runs, against a
+ * grid's (1 / tolerance)^drivers. Runs stop at their first breaching
+ * period (PeriodRunner::set_stop_conditions()), directions are bisected
+ * in parallel, each worker with its own connection and runner, and
+ * driver rows are read once per search.
+ *
+ * Usage:
+ * @code
+ * ReverseStressSearch search([] { return DatabaseFactory::create_sqlite("finmodel.db"); });
+ * ReverseStressSpec spec;
+ * spec.entity_id = "BANK";
+ * spec.scenario_id = baseline;
+ * spec.period_ids = {2026, 2027, 2028};
+ * spec.template_code = "BANK_CAPITAL";
+ * spec.breach_code = "CET1_RATIO";
+ * spec.threshold = 0.08;
+ * spec.drivers = {{"GDP_GROWTH", -0.08, 0.0}, {"HOUSE_PRICES", -0.5, 0.0}};
+ * auto found = search.search(spec);
+ * for (const auto& scenario : found.boundary) { ... scenario.shifts ... }
+ * @endcode
+ */
+
+#ifndef FINMODEL_REVERSE_STRESS_H
+#define FINMODEL_REVERSE_STRESS_H
+
+#include "orchestration/period_runner.h"
+#include "core/thread_pool.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief How a reverse stress search locates the breach boundary
+ */
+enum class ReverseStressMethod {
+    BISECTION,    ///< Bisection along fixed directions
+    GRADIENT,     ///< Adjoint gradient steps to the least severe breach
+    ADAPTIVE      ///< Bisection, then directions concentrated near the least severe breaches
+};
+
+/**
+ * @brief A driver free to move in a reverse stress search
+ */
+struct StressDriver {
+    std::string driver_code;
+    double lower = 0.0;     ///< Smallest shift (≤ 0)
+    double upper = 0.0;     ///< Largest shift (≥ 0, above lower)
+};
+
+/**
+ * @brief One reverse stress search: a breach condition and the driver space
+ */
+struct ReverseStressSpec {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    std::vector<PeriodID> period_ids;           ///< Periods of the run, ascending
+    BalanceSheet initial_bs;
+    std::string template_code;
+
+    std::string breach_code;                    ///< Line item tested against threshold
+    double threshold = 0.0;
+    bool breach_below = true;                   ///< Breached below the threshold (false: above)
+    std::vector<StressDriver> drivers;          ///< Shifted in every period
+
+    ReverseStressMethod method = ReverseStressMethod::ADAPTIVE;
+    size_t directions = 16;                     ///< Directions bisected (at least the axes)
+    size_t refinements = 2;                     ///< ADAPTIVE: rounds of directions near the boundary
+    double tolerance = 1e-3;                    ///< Of the boundary's position, in driver ranges
+    size_t max_iterations = 50;                 ///< GRADIENT: steps
+    uint64_t seed = 1;                          ///< Of the Sobol directions and adaptive scatter
+};
+
+/**
+ * @brief A shock just past the breach boundary
+ */
+struct BoundaryScenario {
+    std::map<std::string, double> shifts;       ///< Driver code → amount added in every period
+    double severity = 0.0;                      ///< Length of the shock in driver ranges
+    double margin = 0.0;                        ///< Distance to the threshold (≤ 0: breached)
+    PeriodID breach_period = 0;                 ///< First period breaching (0: none)
+};
+
+/**
+ * @brief Outcome of a reverse stress search
+ */
+struct ReverseStressResult {
+    std::vector<BoundaryScenario> boundary;     ///< Least severe first
+    bool base_breached = false;                 ///< The unshifted scenario already breaches
+    size_t unbreached_directions = 0;           ///< Directions that reach the box edge without a breach
+
+    bool success = true;                        ///< False for an invalid spec or a failed run
+    std::vector<std::string> errors;
+
+    size_t evaluations = 0;                     ///< Runs of the periods (a gradient counts as one)
+};
+
+/**
+ * @brief Reverse stress searches on warm runners, one per worker
+ *
+ * One search() at a time (calls are serialized).
+ */
+class ReverseStressSearch {
+public:
+    using ConnectionFactory = PeriodRunner::ConnectionFactory;
+
+    /**
+     * @param connect Opens a worker's connection (once per worker, when it first runs)
+     * @param threads Workers bisecting directions, including the caller (0: hardware concurrency)
+     */
+    explicit ReverseStressSearch(ConnectionFactory connect, size_t threads = 0);
+
+    ReverseStressSearch(const ReverseStressSearch&) = delete;
+    ReverseStressSearch& operator=(const ReverseStressSearch&) = delete;
+
+    /**
+     * @brief Find boundary scenarios of a breach condition
+     *
+     * Invalid specs and failed runs come back with success false and errors.
+     */
+    ReverseStressResult search(const ReverseStressSpec& spec);
+
+private:
+    struct Worker {
+        std::shared_ptr<database::IDatabase> db;
+        std::unique_ptr<PeriodRunner> runner;
+    };
+
+    Worker& worker(size_t index);
+
+    ConnectionFactory connect_;
+    core::ThreadPool pool_;
+    std::vector<Worker> workers_;   ///< By pool worker index
+    std::mutex mutex_;              ///< Held by search()
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_REVERSE_STRESS_H
@@ -0,0 +1,111 @@
+/**
+ * @file run_checkpoint.h
+ * @brief Roll-forward state of long multi-period runs, saved to resume them
+ *
+ * run_periods() carries three things from one period to the next: the
+ * closing balance sheet, every line item's value (for [t-1] references)
+ * and the scenario's sticky action triggers; [t-k] references also read
+ * the last recorded periods. A RunCheckpoint is that state after a
+ * completed period. With PeriodRunner::set_checkpoints(), runs save it
+ * every few periods, and a rerun under the same run ID continues after
+ * the last saved period instead of starting over. A horizon can also be
+ * run in windows: each window's call continues where the previous one
+ * stopped.
+ *
+ * Usage:
+ * @code
+ * auto checkpoints = std::make_shared<CheckpointStore>("checkpoints", "stress_2026Q3");
+ * runner.set_checkpoints(checkpoints, 12);
+ * auto results = runner.run_periods(entity, scenario, periods, opening, "UNIFIED");
+ * // After a crash, the same call calculates only the periods after the last checkpoint
+ * @endcode
+ */
+
+#ifndef FINMODEL_RUN_CHECKPOINT_H
+#define FINMODEL_RUN_CHECKPOINT_H
+
+#include "types/common_types.h"
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Roll-forward state of one (entity, scenario) run after a period
+ */
+struct RunCheckpoint {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    std::string template_code;
+    PeriodID last_period = 0;                        ///< Last completed period
+    size_t periods_done = 0;                         ///< Periods calculated up to last_period
+
+    BalanceSheet closing_bs{};                       ///< Opening balance sheet of the next period
+    std::map<std::string, double> prior_values;      ///< Values read by [t-1] references
+    std::set<std::string> triggered_actions;         ///< Sticky triggers of the scenario
+    std::vector<std::pair<PeriodID, std::map<std::string, double>>> history;   ///< Recent periods, oldest first
+    std::map<std::string, std::vector<double>> tax_state;   ///< Path-dependent tax strategies' state (unified::TaxState)
+
+    std::vector<std::string> errors;                 ///< Errors of the periods up to last_period
+};
+
+/**
+ * @brief Checkpoint files of one run ID
+ *
+ * One file per (entity, scenario) in <root>/<run_id>/, replaced atomically
+ * on save, so a crash while saving leaves the previous checkpoint. Files
+ * of different entities and scenarios are independent: parallel scenario
+ * workers can share a store.
+ */
+class CheckpointStore {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    /**
+     * @brief Constructor
+     * @param root Directory of all checkpointed runs (created on first save)
+     * @param run_id Run identifier; reruns with the same ID resume
+     */
+    CheckpointStore(std::string root, std::string run_id);
+
+    const std::string& run_id() const { return run_id_; }
+
+    /**
+     * @brief Save the state of a run (replaces its previous checkpoint)
+     * @throws std::runtime_error on write errors
+     */
+    void save(const RunCheckpoint& checkpoint) const;
+
+    /**
+     * @brief Latest checkpoint of a run
+     * @return Nothing if the run never saved one
+     * @throws std::runtime_error if the file is damaged or of another format version
+     */
+    std::optional<RunCheckpoint> load(const EntityID& entity_id, ScenarioID scenario_id) const;
+
+    /**
+     * @brief Delete a run's checkpoint (a rerun then starts from its first period)
+     */
+    void remove(const EntityID& entity_id, ScenarioID scenario_id) const;
+
+    /**
+     * @brief Delete every checkpoint of the run ID
+     */
+    void clear() const;
+
+private:
+    std::string dir_;
+    std::string run_id_;
+
+    std::string path(const EntityID& entity_id, ScenarioID scenario_id) const;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RUN_CHECKPOINT_H
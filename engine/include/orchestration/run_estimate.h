@@ -0,0 +1,151 @@
+/**
+ * @file run_estimate.h
+ * @brief Predicted time, memory and output size of a batch run before it starts
+ *
+ * Whether a sweep takes 5 minutes or 5 hours follows from two things known
+ * up front: the shape of the template's plan (line items, bytecode,
+ * provider inputs, [t-k] database reads, critical path, see
+ * unified::PlanStatistics) and the size of the run (entities × scenarios ×
+ * periods, threads, output). RunEstimator combines them with per-operation
+ * costs measured on the machine (CostCalibration) for each backend:
+ *
+ * - SCALAR: the interpreter, one scenario per worker thread
+ * - LANES: scenarios in lane batches (a lane kernel if the plan allows one)
+ * - DISTRIBUTED: scalar workers on several nodes (SweepCoordinator shards)
+ *
+ * The default costs are those of the benchmark suite on a current x86
+ * core; `run_benchmarks --benchmark_format=json` output on the target
+ * machine calibrates them (CostCalibration::from_json()).
+ *
+ * Usage:
+ * @code
+ * RunManifest manifest = RunManifest::load("run.json");
+ * RunEstimate estimate = RunEstimator::estimate(manifest, CostCalibration::load("bench.json"));
+ * std::cout << estimate.report();
+ * @endcode
+ *
+ * Or: `scenario_engine estimate --manifest run.json [--calibration bench.json] [--nodes 4]`.
+ */
+
+#ifndef FINMODEL_RUN_ESTIMATE_H
+#define FINMODEL_RUN_ESTIMATE_H
+
+#include "orchestration/batch_run.h"
+#include "unified/unified_engine.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Costs of the operations a run is made of
+ */
+struct CostCalibration {
+    double period_ns = 5000.0;              ///< Per period: context, template, result row
+    double line_item_ns = 250.0;            ///< Per line item and period besides its formula
+    double instruction_ns = 3.0;            ///< Per bytecode instruction (interpreter)
+    double input_ns = 20.0;                 ///< Per provider input and period
+    double prior_period_read_ns = 50.0;     ///< Per [t-1] input and period
+    double history_read_ns = 20000.0;       ///< Per [t-k] database read and period
+    double lane_line_item_ns = 15.0;        ///< LANES: per line item, period and lane besides its formula
+    double lane_instruction_ns = 0.5;       ///< LANES: per instruction and lane, lane kernel
+    double lane_interpreter_instruction_ns = 1.5;   ///< LANES: per instruction and lane, interpreted
+    size_t lanes = 64;                      ///< LANES: scenarios per batch
+    double node_startup_s = 2.0;            ///< DISTRIBUTED: per worker process
+    double shard_s = 0.2;                   ///< DISTRIBUTED: per shard (lease, inputs, result file)
+    size_t scenarios_per_shard = 64;        ///< DISTRIBUTED: as SweepSpec::scenarios_per_shard
+    size_t process_bytes = 64u << 20;       ///< Resident size of an idle engine process
+    size_t line_item_bytes = 512;           ///< Per line item per worker (plan, bindings, caches)
+    size_t result_value_bytes = 16;         ///< Per line item value held until its chunk is written
+    size_t database_row_bytes = 48;         ///< DATABASE: unified_result row with its index entries
+
+    /**
+     * @brief Costs from JSON: these fields by name ({"instruction_ns": 2.5, ..}), or the
+     *        output of run_benchmarks --benchmark_format=json
+     *
+     * From benchmark output: BM_PeriodRunner_RunPeriods sets the per line
+     * item cost, BM_FormulaEvaluator_EvaluateBound/1 (9 instructions) the
+     * instruction cost, BM_DriverValueProvider_GetSlotValue the input cost
+     * and BM_StatementValueProvider_GetValue/1 the [t-1] read cost; costs
+     * without a benchmark keep their defaults.
+     * @throws std::invalid_argument on malformed JSON or a negative cost
+     */
+    static CostCalibration from_json(const std::string& json);
+
+    /**
+     * @throws std::invalid_argument if the file can't be read or from_json() fails
+     */
+    static CostCalibration load(const std::string& path);
+};
+
+/**
+ * @brief Backends a run can be estimated for
+ */
+enum class EstimateBackend {
+    SCALAR,
+    LANES,
+    DISTRIBUTED
+};
+
+const char* to_string(EstimateBackend backend);
+
+/**
+ * @brief Prediction for one backend
+ */
+struct BackendEstimate {
+    EstimateBackend backend = EstimateBackend::SCALAR;
+    size_t workers = 0;             ///< Threads calculating at once (over all nodes)
+    double cpu_seconds = 0.0;       ///< Summed over the workers
+    double wall_seconds = 0.0;
+    size_t peak_memory_bytes = 0;   ///< Per process (per node for DISTRIBUTED)
+};
+
+/**
+ * @brief Prediction for a run
+ */
+struct RunEstimate {
+    unified::PlanStatistics plan;
+    size_t runs = 0;                ///< Entity × scenario runs
+    size_t periods = 0;             ///< Periods calculated over all runs
+    size_t stored_line_items = 0;   ///< Line items kept per period
+    size_t output_bytes = 0;        ///< Size of what the output stores (0 for none)
+    std::vector<BackendEstimate> backends;
+
+    /**
+     * @brief Human-readable summary (several lines)
+     */
+    std::string report() const;
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief Predicts the cost of runs
+ */
+class RunEstimator {
+public:
+    /**
+     * @brief Estimate a run of a plan
+     * @param plan Plan of the manifest's template (with its output selection)
+     * @param manifest Run size, threads and output
+     * @param nodes DISTRIBUTED: worker nodes (each with the manifest's threads)
+     * @throws std::invalid_argument for 0 nodes
+     */
+    static RunEstimate estimate(const unified::PlanStatistics& plan, const RunManifest& manifest,
+                                const CostCalibration& calibration = {}, size_t nodes = 1);
+
+    /**
+     * @brief Estimate a manifest, reading its template's plan from its database
+     * @throws std::invalid_argument if the template doesn't exist
+     * @throws database::DatabaseException if the database can't be read
+     */
+    static RunEstimate estimate(const RunManifest& manifest, const CostCalibration& calibration = {},
+                                size_t nodes = 1);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RUN_ESTIMATE_H
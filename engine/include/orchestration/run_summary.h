@@ -0,0 +1,133 @@
+/**
+ * @file run_summary.h
+ * @brief Summary KPIs of a run, accumulated while its periods stream past
+ *
+ * Listing scenarios with their KPIs (final NET_INCOME, cumulative
+ * emissions, lowest CASH, covenant breaches) used to scan every result row
+ * of every run. A RunSummary folds each period into a fixed set of
+ * measures as it is written, so the KPIs are ready when the run ends;
+ * ResultWriter stores them in run_summary (migration 014_run_summary.sql),
+ * one row per (run, scenario, entity):
+ *
+ * @code
+ * SELECT scenario_id, json_extract(summary, '$.min_CASH') FROM run_summary WHERE run_id = 42
+ * @endcode
+ *
+ * Measures are written "[name=]aggregate:LINE_ITEM[:threshold]":
+ * - final:NET_INCOME      value in the last period with one
+ * - sum:EMISSIONS         total over the periods (cumulative)
+ * - min:CASH, max:DEBT, mean:MARGIN
+ * - below:CASH:0          periods with CASH < 0 (breaches)
+ * - above:LEVERAGE:4      periods with LEVERAGE > 4
+ *
+ * The default name is aggregate_LINE_ITEM ("min_CASH"). Periods without a
+ * finite value don't count; a measure no period contributed to is null.
+ *
+ * Usage:
+ * @code
+ * auto writer = std::make_shared<ResultWriter>(db);
+ * writer->set_summary(RunSummarySpec::parse({"final:NET_INCOME", "min:CASH", "breaches=below:CASH:0"}));
+ * @endcode
+ */
+
+#ifndef FINMODEL_RUN_SUMMARY_H
+#define FINMODEL_RUN_SUMMARY_H
+
+#include "unified/result_row.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief How a measure folds a line item's periods
+ */
+enum class SummaryAggregate {
+    FINAL,   ///< Last finite value
+    SUM,
+    MIN,
+    MAX,
+    MEAN,
+    BELOW,   ///< Periods below the threshold
+    ABOVE    ///< Periods above the threshold
+};
+
+/**
+ * @brief One summary measure
+ */
+struct SummaryMeasure {
+    std::string name;
+    std::string line_item;
+    SummaryAggregate aggregate = SummaryAggregate::FINAL;
+    double threshold = 0.0;   ///< BELOW and ABOVE
+
+    /**
+     * @brief Parse "[name=]aggregate:LINE_ITEM[:threshold]"
+     * @throws std::invalid_argument on a malformed measure
+     */
+    static SummaryMeasure parse(const std::string& text);
+};
+
+/**
+ * @brief Measures computed for every run
+ */
+struct RunSummarySpec {
+    std::vector<SummaryMeasure> measures;
+
+    bool empty() const { return measures.empty(); }
+
+    /**
+     * @brief Parse measures (see SummaryMeasure::parse())
+     * @throws std::invalid_argument on a malformed measure or a repeated name
+     */
+    static RunSummarySpec parse(const std::vector<std::string>& measures);
+};
+
+/**
+ * @brief Measures of one (run, scenario, entity), folded one period at a time
+ */
+class RunSummary {
+public:
+    explicit RunSummary(std::shared_ptr<const RunSummarySpec> spec);
+
+    /**
+     * @brief Fold in one period's results
+     */
+    void add(const unified::ResultRow& values);
+
+    /**
+     * @brief Periods folded in
+     */
+    size_t periods() const { return periods_; }
+
+    /**
+     * @brief Value of measure i (NaN if no period contributed)
+     */
+    double value(size_t measure) const;
+
+    /**
+     * @brief {"name": value, ...} (null for NaN)
+     */
+    std::string to_json() const;
+
+private:
+    struct State {
+        double value = 0.0;
+        size_t count = 0;
+    };
+
+    std::shared_ptr<const RunSummarySpec> spec_;
+    std::vector<State> states_;
+    size_t periods_ = 0;
+
+    // Line item positions in the last schema seen (rows of a run share one)
+    std::shared_ptr<const unified::ResultSchema> schema_;
+    std::vector<uint32_t> positions_;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_RUN_SUMMARY_H
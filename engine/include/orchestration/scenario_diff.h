@@ -0,0 +1,114 @@
+/**
+ * @file scenario_diff.h
+ * @brief Scenario minus base over chosen line items and periods
+ *
+ * The most common dashboard question is "what did this scenario change":
+ * scenario A minus B, or each of a peer set minus the baseline, often
+ * only the largest deviations. ScenarioDiffer answers it from stored
+ * results without building MultiPeriodResults maps:
+ *
+ * - columnar files: the requested line items are read one row group at a
+ *   time (read_group(), keys decoded once), scattered into one dense
+ *   column per scenario and line item, and each column is subtracted from
+ *   the base's in one pass
+ * - delta result sets: only cells a compared run or the base changed are
+ *   touched; every other cell is the baseline minus itself (0, or NaN
+ *   where the baseline has no value)
+ *
+ * With a top count, the cells with the largest |difference| are ranked as
+ * well (ties by scenario, line item, then period).
+ *
+ * Usage:
+ * @code
+ * ColumnarResultReader reader("run_42.fmcr");
+ * ScenarioDiffQuery query;
+ * query.base_id = 1;                        // Every other scenario minus scenario 1
+ * query.line_items = {"CASH", "NET_INCOME"};
+ * query.top = 20;
+ * ScenarioDiff diff = ScenarioDiffer::diff(reader, query);
+ * for (const auto& cell : diff.top) { ... }
+ * @endcode
+ */
+
+#ifndef FINMODEL_SCENARIO_DIFF_H
+#define FINMODEL_SCENARIO_DIFF_H
+
+#include "types/common_types.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/delta_results.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief What to compare
+ */
+struct ScenarioDiffQuery {
+    ScenarioID base_id = 0;                  ///< Subtracted from every compared scenario
+    std::vector<ScenarioID> scenario_ids;    ///< Compared scenarios (empty: every other one of the results)
+    std::vector<std::string> line_items;     ///< Empty: all
+    std::vector<PeriodID> period_ids;        ///< Empty: all (ascending)
+    size_t top = 0;                          ///< Cells to rank by largest |difference| (0: none)
+};
+
+/**
+ * @brief One cell of a ranking
+ */
+struct DiffCell {
+    ScenarioID scenario_id = 0;
+    std::string line_item;
+    PeriodID period_id = 0;
+    double base = 0.0;
+    double value = 0.0;
+    double difference = 0.0;   ///< value - base
+};
+
+/**
+ * @brief Differences of the compared scenarios from the base
+ */
+struct ScenarioDiff {
+    ScenarioID base_id = 0;
+    std::vector<ScenarioID> scenario_ids;
+    std::vector<std::string> line_items;
+    std::vector<PeriodID> period_ids;
+    std::vector<double> base;          ///< [line item][period], NaN where the base has no value
+    std::vector<double> differences;   ///< [scenario][line item][period], NaN where either run has no value
+    std::vector<DiffCell> top;         ///< Largest |difference| first (non-zero, finite differences only)
+
+    double base_of(size_t item, size_t period) const { return base[item * period_ids.size() + period]; }
+    double difference(size_t scenario, size_t item, size_t period) const {
+        return differences[(scenario * line_items.size() + item) * period_ids.size() + period];
+    }
+
+    /**
+     * @param with_differences Include the dense differences (nested [scenario][line item][period]),
+     *        else only the keys and the ranking
+     */
+    std::string to_json(bool with_differences = true) const;
+};
+
+/**
+ * @brief Vectorised comparison of stored scenario results
+ */
+class ScenarioDiffer {
+public:
+    /**
+     * @brief Scenarios of a columnar result file minus the base
+     * @throws std::out_of_range for a line item, or a base or compared scenario, the file doesn't have
+     */
+    static ScenarioDiff diff(const ColumnarResultReader& reader, const ScenarioDiffQuery& query);
+
+    /**
+     * @brief Runs of a delta result set minus the base (its baseline or a variant)
+     * @throws std::out_of_range for a line item, period or scenario the set doesn't have
+     */
+    static ScenarioDiff diff(const DeltaResultSet& set, const ScenarioDiffQuery& query);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_SCENARIO_DIFF_H
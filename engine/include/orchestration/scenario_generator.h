@@ -4,10 +4,18 @@
  *
  * Generates all possible combinations of actions (2^N scenarios for N actions)
  * Useful for Monte Carlo analysis and portfolio optimization
+ *
+ * generate_all_combinations() builds every configuration up front; for large
+ * N, ScenarioGenerator::combinations() returns a CombinationRange that
+ * produces them on demand as bitmasks, and only builds the ScenarioConfig
+ * (with its name and description) of the combinations that are kept.
  */
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <map>
@@ -26,6 +34,150 @@ struct ScenarioConfig {
     std::map<std::string, bool> action_flags;  // action_code -> is_active
 };
 
+/**
+ * @brief Order in which a CombinationRange produces its combinations
+ *
+ * BINARY counts through the masks (0, 1, 2, 3, ...). GRAY visits them in
+ * reflected Gray code order (0, 1, 3, 2, 6, ...): each combination differs
+ * from the one before by exactly one action, which incremental sweeps
+ * exploit (PeriodRunner::set_incremental_seeding()). Scenario IDs follow
+ * the mask in both orders, so a combination keeps its ID.
+ */
+enum class CombinationOrder { BINARY, GRAY };
+
+/**
+ * @brief One combination of a CombinationRange: bit j set = action j active
+ */
+struct ScenarioMask {
+    int scenario_id;
+    uint64_t actions;
+};
+
+/**
+ * @brief All 2^N combinations of N actions, produced on demand
+ *
+ * The range only holds the action codes; in BINARY order combination i is
+ * ScenarioMask {base_scenario_id + i, i}, the order of
+ * generate_all_combinations(). Parallel runners can take it in chunks
+ * with chunk().
+ *
+ * Usage:
+ * @code
+ * auto range = ScenarioGenerator::combinations(actions, 1000, "SWEEP");
+ * for (size_t first = 0; first < range.size(); first += 4096) {
+ *     for (const ScenarioMask& m : range.chunk(first, 4096)) {
+ *         if (range.is_active(m, "LED")) { ... }
+ *     }
+ * }
+ * ScenarioConfig persisted = range.config(range[5]);   // Name and description built here
+ * @endcode
+ */
+class CombinationRange {
+public:
+    /// Most actions a range can combine (one bit each)
+    static constexpr size_t MAX_ACTIONS = 63;
+
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = ScenarioMask;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ScenarioMask;
+
+        iterator() = default;
+        iterator(int base_scenario_id, uint64_t index, CombinationOrder order = CombinationOrder::BINARY)
+            : base_(base_scenario_id), index_(index), gray_(order == CombinationOrder::GRAY) {}
+
+        ScenarioMask operator*() const {
+            const uint64_t mask = gray_ ? (index_ ^ (index_ >> 1)) : index_;
+            return {base_ + static_cast<int>(mask), mask};
+        }
+        ScenarioMask operator[](difference_type n) const { return *(*this + n); }
+
+        iterator& operator++() { ++index_; return *this; }
+        iterator operator++(int) { iterator old = *this; ++index_; return old; }
+        iterator& operator--() { --index_; return *this; }
+        iterator operator--(int) { iterator old = *this; --index_; return old; }
+        iterator& operator+=(difference_type n) { index_ += n; return *this; }
+        iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+        friend iterator operator+(iterator it, difference_type n) { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const iterator& a, const iterator& b) {
+            return static_cast<difference_type>(a.index_ - b.index_);
+        }
+
+        friend bool operator==(const iterator& a, const iterator& b) { return a.index_ == b.index_; }
+        friend bool operator!=(const iterator& a, const iterator& b) { return a.index_ != b.index_; }
+        friend bool operator<(const iterator& a, const iterator& b) { return a.index_ < b.index_; }
+        friend bool operator>(const iterator& a, const iterator& b) { return a.index_ > b.index_; }
+        friend bool operator<=(const iterator& a, const iterator& b) { return a.index_ <= b.index_; }
+        friend bool operator>=(const iterator& a, const iterator& b) { return a.index_ >= b.index_; }
+
+    private:
+        int base_ = 0;
+        uint64_t index_ = 0;
+        bool gray_ = false;
+    };
+
+    /**
+     * @brief Constructor
+     * @param action_codes Actions to combine (bit j of a mask = action_codes[j])
+     * @param base_scenario_id Scenario ID of combination 0
+     * @param base_code_prefix Prefix of the scenario codes built by config()
+     * @param order Order of the combinations
+     * @throws std::invalid_argument for more than MAX_ACTIONS actions
+     */
+    CombinationRange(std::vector<std::string> action_codes,
+                     int base_scenario_id,
+                     std::string base_code_prefix = "SCENARIO",
+                     CombinationOrder order = CombinationOrder::BINARY);
+
+    size_t size() const { return static_cast<size_t>(count_); }
+    bool empty() const { return false; }
+    iterator begin() const { return iterator(base_scenario_id_, 0, order_); }
+    iterator end() const { return iterator(base_scenario_id_, count_, order_); }
+    ScenarioMask operator[](size_t index) const { return begin()[static_cast<std::ptrdiff_t>(index)]; }
+
+    const std::vector<std::string>& action_codes() const { return action_codes_; }
+    CombinationOrder order() const { return order_; }
+
+    /**
+     * @brief GRAY order: index of the action combination `index` toggles
+     * @param index Position in the range, 1 ≤ index < size()
+     * @return Action index that differs from combination index - 1
+     */
+    static size_t toggled_action(size_t index);
+
+    /**
+     * @brief Combinations [first, first + count), clipped to the range
+     */
+    std::vector<ScenarioMask> chunk(size_t first, size_t count) const;
+
+    /**
+     * @brief Check if an action is active in a combination (false for unknown codes)
+     */
+    bool is_active(const ScenarioMask& mask, const std::string& action_code) const;
+
+    /**
+     * @brief Active action codes of a combination, in action order
+     */
+    std::vector<std::string> active_actions(const ScenarioMask& mask) const;
+
+    /**
+     * @brief Full configuration of a combination (as generate_all_combinations() builds it)
+     */
+    ScenarioConfig config(const ScenarioMask& mask) const;
+
+private:
+    std::vector<std::string> action_codes_;
+    int base_scenario_id_;
+    std::string base_code_prefix_;
+    CombinationOrder order_;
+    uint64_t count_;
+};
+
 /**
  * @brief Generator for creating all 2^N action combinations
  */
@@ -54,6 +206,21 @@ public:
         const std::string& base_code_prefix = "SCENARIO"
     );
 
+    /**
+     * @brief All combinations of actions, produced on demand
+     * @param action_codes List of action codes to combine (at most CombinationRange::MAX_ACTIONS)
+     * @param base_scenario_id Starting scenario ID
+     * @param base_code_prefix Prefix for scenario codes
+     * @param order BINARY (as generate_all_combinations()) or GRAY code order
+     * @return Range of the same 2^N combinations as generate_all_combinations()
+     */
+    static CombinationRange combinations(
+        const std::vector<std::string>& action_codes,
+        int base_scenario_id,
+        const std::string& base_code_prefix = "SCENARIO",
+        CombinationOrder order = CombinationOrder::BINARY
+    );
+
     /**
      * @brief Check if an action is active in a scenario
      * @param config Scenario configuration
@@ -97,6 +264,8 @@ public:
     );
 
 private:
+    friend class CombinationRange;
+
     /**
      * @brief Generate scenario name from active actions
      * @param active_actions List of active action codes
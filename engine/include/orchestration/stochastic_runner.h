@@ -0,0 +1,374 @@
+/**
+ * @file stochastic_runner.h
+ * @brief Monte Carlo paths of a template with sampled drivers, kept as statistics
+ *
+ * PeriodRunner runs the periods of one scenario; a StochasticRunner runs
+ * many paths of the same scenario in which selected drivers are random:
+ *
+ * 1. Every path and period draws correlated standard normals (Cholesky
+ *    factor of the drivers' correlation matrix) and maps them to each
+ *    driver's distribution; other drivers come from the scenario
+ * 2. Paths are calculated in batches of lanes with
+ *    UnifiedEngine::calculate_lane_values(), period after period, each
+ *    period opening from the lanes' previous one (as run_periods())
+ * 3. Only statistics are kept: a core::StreamingStatistics per line item
+ *    and period
+ *
+ * Each path draws from its own Philox stream (seed, path), so statistics
+ * don't depend on the batch size (means and variances to the last bit).
+ *
+ * Variance reduction (StochasticOptions):
+ * - sampling: scrambled Sobol or Halton points (one dimension per period
+ *   and driver) instead of random normals; every batch is then one
+ *   randomised replicate of the first `lanes` points
+ * - antithetic: paths in pairs, the second with the negated normals
+ * - control_variate: means regressed on the sampled drivers' deviations
+ *   from their means (in the period and summed to it), which are known
+ *   to average zero
+ *
+ * Every line item and period reports the deterministic baseline (the
+ * drivers at their means, the run_periods() path), an estimate and its
+ * standard error from the spread of the batches' estimates - valid for
+ * all of the above. With a target_relative_error, the runner stops after
+ * the first batch at which every watched estimate is that close.
+ *
+ * Management actions (StochasticOptions::apply_actions): the scenario's
+ * triggers are evaluated for all lanes at once each period
+ * (LaneTriggers), so a conditional action fires in exactly the paths
+ * whose prior values meet its condition. Lanes with the same active
+ * actions are calculated together with that set's overlay template.
+ *
+ * Stop condition (StochasticOptions::stop_condition): a path ends at the
+ * first period whose values meet it, as PeriodRunner::set_stop_conditions()
+ * ends a run. Its lane is masked out of later periods' statistics, which
+ * are then those of the paths still running, and once half of a batch's
+ * lanes have stopped the rest are compacted so stopped paths cost nothing.
+ * StochasticResults::stopped_paths counts the paths stopped per period.
+ *
+ * Global sensitivity analysis (sensitivity()): Saltelli's design over the
+ * same sampled drivers. N base samples of two independent matrices A and
+ * B (Latin hypercube or Sobol points), and for every driver the matrix
+ * AB_i of A with driver i's values taken from B, are calculated as
+ * scenario lanes; first-order and total Sobol indices of the chosen
+ * outputs are then accumulated from sums over the samples (Saltelli 2010
+ * and Jansen estimators), so no sample's results are kept. Confidence
+ * intervals come from a Poisson bootstrap, also streamed: each sample
+ * weighs into every replicate's sums with a Poisson(1) count.
+ *
+ * Usage:
+ * @code
+ * StochasticRunner runner(db, {
+ *     {"REVENUE", DriverDistribution::LOGNORMAL, 1000.0, 150.0},
+ *     {"COSTS", DriverDistribution::NORMAL, 600.0, 50.0},
+ * }, correlation);
+ * StochasticOptions options;
+ * options.paths = 100000;
+ * auto stats = runner.run("E", scenario_id, periods, opening, "TEMPLATE", options);
+ * double p5 = stats.get("CASH", periods.back())->quantile(0.05);
+ * @endcode
+ */
+
+#pragma once
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include "core/streaming_statistics.h"
+#include "unified/unified_engine.h"
+#include "actions/action_catalog.h"
+#include "orchestration/lane_triggers.h"
+#include "core/eigen.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Distribution of a sampled driver
+ */
+enum class DriverDistribution {
+    NORMAL,       ///< mean + stddev × z
+    LOGNORMAL     ///< Positive, with the given mean and standard deviation of the value itself
+};
+
+/**
+ * @brief Driver sampled independently in every path and period
+ */
+struct StochasticDriver {
+    std::string driver_code;
+    DriverDistribution distribution = DriverDistribution::NORMAL;
+    double mean = 0.0;
+    double stddev = 0.0;
+};
+
+/**
+ * @brief Source of the drivers' standard normals
+ */
+enum class SamplingMethod {
+    PSEUDO_RANDOM,    ///< Philox stream per path
+    SOBOL,            ///< Sobol points with a digital shift per batch
+    HALTON            ///< Permuted Halton points with a rotation per batch
+};
+
+/**
+ * @brief Settings of StochasticRunner::run()
+ */
+struct StochasticOptions {
+    size_t paths = 1000;                    ///< At most (fewer with an early stop)
+    size_t lanes = 1024;                    ///< Paths calculated together (memory: lanes × line items)
+    uint64_t seed = 1;
+    double relative_accuracy = 0.01;        ///< Of quantiles
+    std::vector<std::string> line_items;    ///< Line items with statistics (empty: all)
+
+    SamplingMethod sampling = SamplingMethod::PSEUDO_RANDOM;
+    bool antithetic = false;                ///< Pairs of paths with negated normals (lanes must be even)
+    bool control_variate = false;           ///< Estimates adjusted by regression on the sampled drivers
+
+    /// Stop once every standard error ≤ this × |estimate| (0: run all paths)
+    double target_relative_error = 0.0;
+    size_t min_batches = 4;                 ///< Batches before stopping early (at least 2)
+    std::vector<std::string> convergence_line_items;  ///< Watched by the stop (empty: all tracked)
+
+    /// Apply the scenario's management actions path by path (see LaneTriggers)
+    bool apply_actions = false;
+
+    /// Paths end at the first period meeting this formula over its line items (empty: none)
+    std::string stop_condition;
+
+    /// Compiled lane kernels, on the host or a CUDA device (see UnifiedEngine::set_lane_kernels())
+    core::LaneKernelOptions lane_kernels;
+};
+
+/**
+ * @brief Sample design of a sensitivity analysis
+ */
+enum class SensitivityDesign {
+    LATIN_HYPERCUBE,  ///< One sample per stratum of every dimension
+    SOBOL             ///< Scrambled Sobol points
+};
+
+/**
+ * @brief Settings of StochasticRunner::sensitivity()
+ */
+struct SensitivityOptions {
+    size_t samples = 1024;                  ///< Base samples N (runs: N × (drivers + 2))
+    size_t lanes = 1024;                    ///< Runs calculated together (memory: lanes × line items)
+    SensitivityDesign design = SensitivityDesign::LATIN_HYPERCUBE;
+    uint64_t seed = 1;
+    std::vector<std::string> outputs;       ///< Line items analysed (required)
+
+    size_t bootstrap = 0;                   ///< Bootstrap replicates of the intervals (0: none)
+    double confidence = 0.95;               ///< Of the intervals
+
+    /// Apply the scenario's management actions path by path (see LaneTriggers)
+    bool apply_actions = false;
+
+    /// Compiled lane kernels, on the host or a CUDA device (see UnifiedEngine::set_lane_kernels())
+    core::LaneKernelOptions lane_kernels;
+};
+
+/**
+ * @brief Sobol indices of one driver for one output and period
+ */
+struct SobolIndex {
+    double first_order = 0.0;               ///< Share of the variance explained by the driver alone
+    double total = 0.0;                     ///< Share involving the driver, interactions included
+    double first_order_low = 0.0;           ///< Bootstrap interval (the estimate without bootstrap)
+    double first_order_high = 0.0;
+    double total_low = 0.0;
+    double total_high = 0.0;
+};
+
+/**
+ * @brief Variance decomposition of one output in one period
+ */
+struct OutputSensitivity {
+    size_t samples = 0;                     ///< Base samples in the estimates
+    double mean = 0.0;
+    double variance = 0.0;
+    std::vector<SobolIndex> drivers;        ///< In the runner's driver order (zero without variance)
+};
+
+/**
+ * @brief Sobol indices of a StochasticRunner::sensitivity()
+ */
+struct SensitivityResults {
+    std::vector<PeriodID> period_ids;
+    std::vector<std::string> driver_codes;
+    size_t evaluations = 0;                 ///< Runs calculated (failed batches included)
+
+    /// Output code → decomposition per period (period_ids order)
+    std::map<std::string, std::vector<OutputSensitivity>> outputs;
+
+    bool success = true;
+    std::vector<std::string> errors;
+
+    /**
+     * @brief Decomposition of an output in a period
+     * @return Null if the output or period wasn't analysed
+     */
+    const OutputSensitivity* get(const std::string& code, PeriodID period_id) const;
+};
+
+/**
+ * @brief Distribution of one line item in one period over the paths
+ */
+struct LineItemDistribution : core::StreamingStatistics {
+    double baseline = 0.0;           ///< Value with the sampled drivers at their means
+    double estimate = 0.0;           ///< Of the mean (the mean, or its control-variate adjustment)
+    double standard_error = 0.0;     ///< Of the estimate, over batches (0 below two batches)
+
+    explicit LineItemDistribution(double relative_accuracy) : core::StreamingStatistics(relative_accuracy) {}
+
+    /// standard_error / |estimate| (0 for a zero error, infinite for a zero estimate)
+    double relative_error() const;
+};
+
+/**
+ * @brief Statistics of a StochasticRunner::run()
+ */
+struct StochasticResults {
+    std::vector<PeriodID> period_ids;
+    size_t paths = 0;                 ///< Paths in the statistics
+    size_t failed_paths = 0;          ///< Paths of batches that failed (not in the statistics)
+    size_t batches = 0;               ///< Batches run
+    bool converged = false;           ///< Stopped early at the target relative error
+    std::vector<size_t> stopped_paths;  ///< Paths meeting the stop condition in each period (period_ids order)
+
+    /// Line item code → distribution per period (period_ids order)
+    std::map<std::string, std::vector<LineItemDistribution>> line_items;
+
+    bool success = true;
+    std::vector<std::string> errors;
+
+    /**
+     * @brief Distribution of a line item in a period
+     * @return Null if the line item or period has no statistics
+     */
+    const LineItemDistribution* get(const std::string& code, PeriodID period_id) const;
+};
+
+/**
+ * @brief Runs Monte Carlo paths of one scenario through lane evaluation
+ */
+class StochasticRunner {
+public:
+    /**
+     * @brief Constructor
+     * @param db Database connection
+     * @param drivers Sampled drivers
+     * @param correlation Correlation matrix of the drivers' normals (empty: independent)
+     * @throws std::invalid_argument for negative standard deviations, a
+     *         non-positive lognormal mean or a correlation matrix that isn't
+     *         a drivers × drivers positive definite matrix with unit diagonal
+     */
+    StochasticRunner(std::shared_ptr<database::IDatabase> db,
+                     std::vector<StochasticDriver> drivers,
+                     const Eigen::MatrixXd& correlation = Eigen::MatrixXd());
+
+    /**
+     * @brief Run paths over the periods
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario of the non-sampled drivers
+     * @param period_ids Periods to calculate (in order)
+     * @param initial_bs Opening balance sheet of every path
+     * @param template_code Unified template code
+     * @param options Paths, batch size, seed, tracked line items and variance reduction
+     * @return Statistics per line item and period
+     * @throws std::invalid_argument for no lanes, a bad accuracy, odd lanes
+     *         with antithetic paths, an early stop before two batches or a
+     *         stop condition that doesn't compile
+     *
+     * A formula error fails the batch it occurs in: its paths are left out
+     * and the error is reported once per period and message. A stop
+     * condition reading a line item the period doesn't have, or failing in
+     * any lane, is met in none.
+     */
+    StochasticResults run(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const StochasticOptions& options = {}
+    );
+
+    /**
+     * @brief First-order and total Sobol indices of outputs by the sampled drivers
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario of the non-sampled drivers
+     * @param period_ids Periods to calculate (in order)
+     * @param initial_bs Opening balance sheet of every run
+     * @param template_code Unified template code
+     * @param options Samples, design, outputs and bootstrap
+     * @return Indices per output and period
+     * @throws std::invalid_argument for no samples, no outputs, fewer
+     *         lanes than drivers + 2 or a confidence outside (0, 1)
+     *
+     * A driver is one factor over all periods: it draws a value per period
+     * from its distribution, as in run(). Indices assume independent
+     * drivers, so the correlation matrix is not applied. A formula error
+     * fails the batch it occurs in, as in run().
+     */
+    SensitivityResults sensitivity(
+        const EntityID& entity_id,
+        ScenarioID scenario_id,
+        const std::vector<PeriodID>& period_ids,
+        const BalanceSheet& initial_bs,
+        const std::string& template_code,
+        const SensitivityOptions& options
+    );
+
+    /**
+     * @brief Get the engine the paths are calculated with
+     */
+    const unified::UnifiedEngine& engine() const { return *engine_; }
+
+private:
+    std::shared_ptr<database::IDatabase> db_;
+    std::unique_ptr<unified::UnifiedEngine> engine_;
+    std::vector<StochasticDriver> drivers_;
+    Eigen::MatrixXd cholesky_;        // Lower factor of the correlation matrix
+
+    // Lognormal parameters of the underlying normal (NORMAL drivers: mean, stddev)
+    std::vector<double> location_;
+    std::vector<double> scale_;
+
+    /**
+     * @brief Value of driver j at a standard normal deviate
+     */
+    double driver_value(size_t j, double z) const;
+
+    // Action overlays registered with the engine: base code + formula patches → overlay code
+    std::map<std::string, std::string> action_templates_;
+
+    // Base code + effective actions (catalogue indexes) → overlay code, for the current run
+    std::map<std::pair<std::string, std::vector<size_t>>, std::string> action_sets_;
+
+    /**
+     * @brief Template of a base template with the actions of a trigger set that are active in a period
+     * @param active Bit t: trigger t of triggers active
+     * @return base_template_code itself when no action applies
+     */
+    std::string action_template(const std::string& base_template_code, const actions::ActionCatalog& catalog,
+                                ScenarioID scenario_id, const LaneTriggers& triggers,
+                                const std::vector<uint64_t>& active, PeriodID period_id);
+
+    /**
+     * @brief One period of a batch of lanes, each group of lanes with its actions' template
+     * @param triggers Triggers of the lanes (null: no actions, the base template for all)
+     */
+    unified::LaneResult calculate_period(const EntityID& entity_id, const std::vector<ScenarioID>& scenario_ids,
+                                         PeriodID period_id,
+                                         const unified::LaneResult& opening, const std::string& template_code,
+                                         const unified::LaneValues* overrides, LaneTriggers* triggers,
+                                         const actions::ActionCatalog* catalog);
+};
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,130 @@
+/**
+ * @file tail_latency.h
+ * @brief Latency histograms of scenario runs and traces of the slowest ones
+ *
+ * In a large sweep a few scenarios take many times the median, typically
+ * because they switch many action variants on and off (each a new
+ * template to build and compile) or read [t-k] values back from the
+ * database. A TailLatencyTracker attached to a PeriodRunner
+ * (set_tail_latency(), shared by its scenario workers) keeps histograms of
+ * run and period latencies, and each run carries a light trace: driver
+ * load and per-period calculate times, the template of every period and
+ * whether it was created for the run, database fallbacks and line item
+ * evaluations.
+ *
+ * A run slower than the policy's threshold, or than its percentile of the
+ * runs recorded before it, is an exemplar: the tracker keeps the slowest
+ * exemplars, and with a ResultWriter the trace is stored with the run in
+ * run_log.json_config ($.exemplar). Other traces are dropped.
+ *
+ * Usage:
+ * @code
+ * TailLatencyPolicy policy;
+ * policy.percentile = 0.99;
+ * auto tracker = std::make_shared<TailLatencyTracker>(policy);
+ * runner.set_tail_latency(tracker);
+ * runner.run_multiple_scenarios(...);
+ * for (const auto& trace : tracker->exemplars()) std::cout << trace.to_json() << '\n';
+ * @endcode
+ */
+
+#ifndef FINMODEL_TAIL_LATENCY_H
+#define FINMODEL_TAIL_LATENCY_H
+
+#include "core/quantile_sketch.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Which runs become exemplars
+ */
+struct TailLatencyPolicy {
+    double percentile = 0.99;        ///< Runs slower than this quantile of earlier runs (1: never)
+    double threshold_seconds = 0.0;  ///< Runs at least this slow, whatever the percentile (0: no threshold)
+    size_t min_runs = 20;            ///< Runs recorded before the percentile applies
+    size_t max_exemplars = 32;       ///< Slowest exemplars kept by the tracker
+};
+
+/**
+ * @brief One period of a traced run
+ */
+struct PeriodTrace {
+    PeriodID period_id = 0;
+    std::string template_code;     ///< Template calculated (an action variant or the base)
+    bool template_created = false; ///< The variant was built and compiled for this period
+    double seconds = 0.0;          ///< Template selection, calculation, roll-forward and write
+    double calculate_seconds = 0.0;
+    size_t evaluations = 0;        ///< Line item values calculated
+    size_t database_reads = 0;     ///< [t-k] values read from the database
+};
+
+/**
+ * @brief Trace of one scenario run
+ */
+struct RunTrace {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    double seconds = 0.0;
+    double driver_load_seconds = 0.0;
+    bool cached = false;           ///< Replayed from a ResultCache
+    std::vector<PeriodTrace> periods;
+    std::string reason;            ///< Why it is an exemplar ("threshold" or "p99"; empty otherwise)
+
+    size_t templates_created() const;
+    size_t evaluations() const;
+    size_t database_reads() const;
+
+    /// {"entity", "scenario", "seconds", ..., "periods": [...]}
+    std::string to_json() const;
+};
+
+/**
+ * @brief Run and period latency histograms with the slowest runs' traces (thread-safe)
+ */
+class TailLatencyTracker {
+public:
+    /**
+     * @throws std::invalid_argument for a percentile outside (0, 1] or a negative threshold
+     */
+    explicit TailLatencyTracker(TailLatencyPolicy policy = {});
+
+    const TailLatencyPolicy& policy() const { return policy_; }
+
+    /**
+     * @brief Add a finished run to the histograms
+     * @return Whether it is an exemplar (its reason is set; kept if among the slowest)
+     */
+    bool record(RunTrace& trace);
+
+    size_t runs() const;
+
+    /// Run latency at quantile q, in seconds (0 before any run)
+    double run_quantile(double q) const;
+
+    /// Period latency at quantile q, in seconds (0 before any period)
+    double period_quantile(double q) const;
+
+    /// Kept exemplars, slowest first
+    std::vector<RunTrace> exemplars() const;
+
+    /// Forget histograms and exemplars
+    void clear();
+
+private:
+    TailLatencyPolicy policy_;
+    mutable std::mutex mutex_;
+    core::QuantileSketch run_seconds_;
+    core::QuantileSketch period_seconds_;
+    std::vector<RunTrace> exemplars_;   ///< At most max_exemplars, unordered
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_TAIL_LATENCY_H
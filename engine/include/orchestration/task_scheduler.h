@@ -0,0 +1,176 @@
+/**
+ * @file task_scheduler.h
+ * @brief Work-stealing scheduler for uneven orchestration jobs
+ *
+ * core::ThreadPool suits loops of similar items. Orchestration jobs
+ * aren't similar: a scenario that triggers many management actions builds
+ * template overlays, a physical-risk scenario has far more drivers. The
+ * TaskScheduler gives every worker its own deque: a worker runs its newest
+ * task first and, when its deque is empty, steals the oldest task of
+ * another worker, so nobody idles while work is left anywhere.
+ *
+ * Tasks may submit further tasks (they land on the submitting worker's
+ * deque), which is how a subsystem splits its own work further.
+ *
+ * On multi-socket machines the scheduler can place its workers by NUMA
+ * node (core::NumaTopology): each worker thread is pinned to a core of its
+ * node, so what it allocates stays on that node, and an idle worker steals
+ * from workers of its own node before crossing to another.
+ *
+ * Example:
+ * @code
+ * TaskScheduler scheduler(8);
+ * std::vector<MultiPeriodResults> results(jobs.size());
+ * for (size_t i = 0; i < jobs.size(); ++i) {
+ *     scheduler.submit([&, i](size_t worker) {
+ *         results[i] = runners[worker]->run_periods(...);
+ *     });
+ * }
+ * scheduler.wait();   // The caller works too, as worker 0
+ * @endcode
+ */
+
+#ifndef FINMODEL_TASK_SCHEDULER_H
+#define FINMODEL_TASK_SCHEDULER_H
+
+#include "core/numa_topology.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Counters of a TaskScheduler
+ */
+struct TaskSchedulerStats {
+    size_t executed = 0;   ///< Tasks run
+    size_t stolen = 0;     ///< Tasks run by a worker other than the one they were queued on
+    size_t stolen_remote = 0;  ///< Of those, stolen from a worker of another NUMA node
+};
+
+/**
+ * @brief Worker threads with per-worker deques and work stealing
+ *
+ * submit() may be called from any thread, also from inside tasks; wait()
+ * from one thread at a time, not from inside a task.
+ */
+class TaskScheduler {
+public:
+    /**
+     * @brief Task body
+     * @param worker Worker index in [0, size()) (stable per thread, for per-worker state)
+     */
+    using Task = std::function<void(size_t worker)>;
+
+    /**
+     * @brief Start worker threads
+     * @param threads Total threads including the thread calling wait() (0: hardware concurrency)
+     * @param numa Place workers by NUMA node (core::NumaTopology::system()): threads
+     *        are pinned to cores of their node when there is more than one node
+     *        (the caller of wait() is worker 0 of node 0 and isn't pinned)
+     */
+    explicit TaskScheduler(size_t threads = 0, bool numa = false);
+
+    /**
+     * @brief Place workers on given nodes (for tests and explicit layouts)
+     * @param threads Total threads including the thread calling wait() (at least 1)
+     * @param topology Nodes to place the workers on
+     * @param pin Pin worker threads to the nodes' CPUs
+     */
+    TaskScheduler(size_t threads, const core::NumaTopology& topology, bool pin);
+
+    /**
+     * @brief Run the remaining tasks, then stop and join the workers
+     */
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Number of workers (threads plus the caller of wait())
+     */
+    size_t size() const { return queues_.size(); }
+
+    /**
+     * @brief NUMA node (index into the topology's nodes) of a worker (0 without placement)
+     */
+    size_t node_of(size_t worker) const { return nodes_[worker]; }
+
+    /**
+     * @brief Nodes the workers are placed on (1 without placement)
+     */
+    size_t node_count() const { return node_count_; }
+
+    /**
+     * @brief Queue a task
+     *
+     * From a task: on the running worker's deque. Otherwise: the deques
+     * take turns.
+     */
+    void submit(Task task);
+
+    /**
+     * @brief Run tasks on the calling thread until every submitted task finished
+     * @throws The first exception thrown by a task since the last wait()
+     * @throws std::logic_error if called from inside a task
+     */
+    void wait();
+
+    /**
+     * @brief Counters so far
+     */
+    TaskSchedulerStats stats() const;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;   ///< Per worker; 0 belongs to wait()
+    std::vector<std::thread> threads_;
+    std::vector<size_t> nodes_;                    ///< NUMA node per worker
+    size_t node_count_ = 1;
+    std::vector<std::vector<size_t>> victims_;     ///< Per worker: steal order (own node first)
+
+    std::mutex mutex_;                 ///< Guards sleeping (wake_), stopping_ and error_
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    std::atomic<size_t> queued_{0};    ///< Tasks in deques
+    std::atomic<size_t> pending_{0};   ///< Tasks submitted and not finished
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> executed_{0};
+    std::atomic<size_t> stolen_{0};
+    std::atomic<size_t> stolen_remote_{0};
+
+    /**
+     * @brief Queues, steal orders and threads for a placement
+     * @param topology Nodes to pin to (null: no pinning)
+     */
+    void start(size_t threads, std::vector<size_t> nodes, const core::NumaTopology* topology);
+
+    void worker_loop(size_t worker);
+
+    /**
+     * @brief Run one task: own deque's newest, else another deque's oldest
+     * @return False if every deque was empty
+     */
+    bool run_one(size_t worker);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_TASK_SCHEDULER_H
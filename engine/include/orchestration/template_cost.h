@@ -0,0 +1,142 @@
+/**
+ * @file template_cost.h
+ * @brief Static cost of a template's formulas, per line item and in total
+ *
+ * What a template costs per period follows from its formulas alone, before
+ * any driver is loaded. TemplateCostAnalyzer compiles every formula and
+ * reports, per line item:
+ *
+ * - ops: bytecode instructions, loads (variables read) and function calls
+ * - fan-in: line items of the same period it reads; fan-out: line items
+ *   reading it
+ * - depth: length of the longest dependency chain ending in it (the
+ *   template's largest depth is its critical path)
+ * - far references: [t-k] values older than the in-memory history
+ *   (StatementValueProvider::history_depth(), 12 periods by default), each
+ *   one a database read per period
+ * - IF branches: conditional jumps left after optimisation
+ *
+ * With scenarios, each scenario's actions are expanded as the runner does
+ * (ActionEngine::parametric_patches()) and the overlay template is costed
+ * too, so a pathological action set shows before a sweep runs it.
+ *
+ * Usage:
+ * @code
+ * TemplateCost cost = TemplateCostAnalyzer::analyze(db, "UNIFIED_PL_BS_CF", {1, 2});
+ * std::cout << cost.report();
+ * @endcode
+ *
+ * Or: `scenario_engine cost --db model.db --template UNIFIED_PL_BS_CF [--scenarios 1-2] [--history 12]`,
+ * and GET /templates/CODE/cost on the server.
+ */
+
+#ifndef FINMODEL_TEMPLATE_COST_H
+#define FINMODEL_TEMPLATE_COST_H
+
+#include "core/statement_template.h"
+#include "database/idatabase.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Cost of one line item's formula
+ */
+struct LineItemCost {
+    std::string code;
+    bool has_formula = false;       ///< Otherwise a provider lookup (base_value_source)
+    size_t ops = 0;                 ///< Bytecode instructions
+    size_t loads = 0;               ///< Variables read
+    size_t calls = 0;               ///< Function call sites
+    size_t if_branches = 0;
+    size_t far_references = 0;      ///< [t-k] references beyond the history depth
+    size_t fan_in = 0;              ///< Line items of the same period it reads
+    size_t fan_out = 0;             ///< Line items of the same period reading it
+    size_t depth = 0;               ///< Longest dependency chain ending here (1: reads no line item; 0: circular)
+    bool circular = false;          ///< Part of (or behind) a circular dependency
+    std::string error;              ///< Compile error (its counts are 0)
+};
+
+/**
+ * @brief Cost of a whole template
+ */
+struct CostTotals {
+    size_t line_items = 0;
+    size_t formulas = 0;
+    size_t ops = 0;
+    size_t loads = 0;
+    size_t calls = 0;
+    size_t if_branches = 0;
+    size_t far_references = 0;
+    size_t critical_path = 0;       ///< Largest depth
+    size_t max_fan_in = 0;
+    size_t max_fan_out = 0;
+    size_t circular = 0;            ///< Line items without a depth
+    size_t errors = 0;              ///< Formulas that don't compile
+};
+
+/**
+ * @brief Cost of a template with one scenario's actions applied
+ */
+struct OverlayCost {
+    ScenarioID scenario_id = 0;
+    size_t actions = 0;
+    size_t patched_line_items = 0;
+    CostTotals totals;
+};
+
+/**
+ * @brief Cost report of a template
+ */
+struct TemplateCost {
+    std::string template_code;
+    size_t history_depth = 0;
+    std::vector<LineItemCost> line_items;       ///< In template order
+    CostTotals totals;
+    std::vector<std::string> critical_path;     ///< Line items of the longest chain, first to last
+    std::vector<OverlayCost> overlays;          ///< In the order the scenarios were given
+
+    /**
+     * @brief Human-readable summary (several lines, the costliest line items first)
+     * @param top Line items listed
+     */
+    std::string report(size_t top = 10) const;
+
+    std::string to_json() const;
+};
+
+/**
+ * @brief Static analysis of template formulas
+ */
+class TemplateCostAnalyzer {
+public:
+    /// In-memory history of StatementValueProvider
+    static constexpr size_t DEFAULT_HISTORY_DEPTH = 12;
+
+    /**
+     * @brief Cost of a template (without actions)
+     * @param history_depth Periods of history kept in memory: [t-k] with k above it are far references
+     */
+    static TemplateCost analyze(const core::StatementTemplate& tmpl,
+                                size_t history_depth = DEFAULT_HISTORY_DEPTH);
+
+    /**
+     * @brief Cost of a stored template and of its overlays for some scenarios
+     * @param scenario_ids Scenarios whose actions are costed (empty: none)
+     * @throws std::invalid_argument if the template doesn't exist
+     * @throws database::DatabaseException if the database can't be read
+     */
+    static TemplateCost analyze(std::shared_ptr<database::IDatabase> db, const std::string& template_code,
+                                const std::vector<ScenarioID>& scenario_ids = {},
+                                size_t history_depth = DEFAULT_HISTORY_DEPTH);
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_TEMPLATE_COST_H
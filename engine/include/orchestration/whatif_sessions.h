@@ -0,0 +1,156 @@
+/**
+ * @file whatif_sessions.h
+ * @brief Warm per-user what-if sessions for the server mode
+ *
+ * A dashboard edit should not pay for opening the database, loading and
+ * compiling the template, reading drivers, FX rates and units before it
+ * calculates. A session keeps all of that in memory between requests:
+ * its own PeriodRunner (connection, compiled templates, provider caches),
+ * the run's driver rows, and the previous run's values, with incremental
+ * recalculation on. A driver edit patches the rows in memory and reruns
+ * the periods, which only re-evaluates the formulas downstream of the
+ * edited drivers - no query, no template load.
+ *
+ * Edits stay in the session: nothing is written to scenario_drivers.
+ *
+ * Usage:
+ * @code
+ * WhatIfSessions sessions([] { return DatabaseFactory::create_sqlite("finmodel.db"); });
+ * auto opened = sessions.open(JobSpec::from_json(R"({"template": "CORP", "entity": "A",
+ *                                                    "scenarios": [1], "periods": [1, 2, 3]})"));
+ * auto edited = sessions.edit(opened.session_id, {{2, "REVENUE", 1200.0}});
+ * double net = edited.results.results[1].get_value("NET_INCOME");
+ * @endcode
+ */
+
+#ifndef FINMODEL_WHATIF_SESSIONS_H
+#define FINMODEL_WHATIF_SESSIONS_H
+
+#include "orchestration/job_queue.h"
+#include "orchestration/period_runner.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief New value of one driver in one period
+ */
+struct DriverEdit {
+    PeriodID period_id = 0;
+    std::string driver_code;
+    double value = 0.0;
+    std::string unit_code;   ///< Empty: the unit the driver already has
+
+    /**
+     * @brief Parse edits: [{"period": 2, "driver": "REVENUE", "value": 1200, "unit": "EUR"}, ..]
+     *
+     * A single object is one edit; "unit" is optional.
+     * @throws std::invalid_argument on malformed JSON or a missing field
+     */
+    static std::vector<DriverEdit> list_from_json(const std::string& json);
+};
+
+/**
+ * @brief A session's latest run
+ */
+struct SessionResult {
+    uint64_t session_id = 0;
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    std::vector<PeriodID> period_ids;
+    MultiPeriodResults results;
+    size_t recalculated = 0;     ///< Formulas evaluated by the run, over all periods
+    double milliseconds = 0.0;   ///< Time the run took (edits: patch and rerun)
+
+    /**
+     * @brief {"session_id": N, ..., "periods": [{"period": P, "values": {"CODE": v, ..}}, ..]}
+     */
+    std::string to_json() const;
+};
+
+/**
+ * @brief Open what-if sessions, each with its warm runner and inputs
+ *
+ * Requests of different sessions run in parallel; those of one session
+ * run one after another.
+ */
+class WhatIfSessions {
+public:
+    using ConnectionFactory = PeriodRunner::ConnectionFactory;
+
+    /**
+     * @param connect Opens a session's connection (once per session)
+     * @param max_sessions Sessions kept; opening another one closes the least recently used
+     * @throws std::invalid_argument if max_sessions is 0
+     */
+    explicit WhatIfSessions(ConnectionFactory connect, size_t max_sessions = 64);
+
+    WhatIfSessions(const WhatIfSessions&) = delete;
+    WhatIfSessions& operator=(const WhatIfSessions&) = delete;
+
+    /**
+     * @brief Open a session and run it once
+     * @param spec One entity and one scenario (priority and write_results are ignored)
+     * @throws std::invalid_argument if the spec isn't a single run
+     * @throws database::DatabaseException if the database can't be read
+     */
+    SessionResult open(const JobSpec& spec);
+
+    /**
+     * @brief Change drivers of a session and rerun it incrementally
+     * @throws std::out_of_range if there is no such session
+     * @throws std::invalid_argument if an edit's period isn't one of the session's
+     */
+    SessionResult edit(uint64_t id, const std::vector<DriverEdit>& edits);
+
+    /**
+     * @brief A session's latest run
+     * @throws std::out_of_range if there is no such session
+     */
+    SessionResult result(uint64_t id) const;
+
+    /**
+     * @return False if there is no such session
+     */
+    bool close(uint64_t id);
+
+    size_t size() const;
+
+private:
+    struct Session {
+        mutable std::mutex mutex;   ///< Held while the session runs
+        std::unique_ptr<PeriodRunner> runner;
+        JobSpec spec;
+        BalanceSheet opening;
+        unified::DriverValueProvider::DriverRows drivers;
+        SessionResult last;
+        size_t recalculated = 0;    ///< Of the run in progress (period observer)
+        uint64_t last_used = 0;
+    };
+
+    std::shared_ptr<Session> find(uint64_t id) const;
+    /// Run the session's periods from its driver rows into session.last (session mutex held)
+    void run(Session& session);
+
+    ConnectionFactory connect_;
+    const size_t max_sessions_;
+
+    mutable std::mutex mutex_;
+    std::map<uint64_t, std::shared_ptr<Session>> sessions_;
+    uint64_t next_id_ = 1;
+    mutable uint64_t clock_ = 0;   ///< Advances on every use (least recently used eviction)
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_WHATIF_SESSIONS_H
@@ -0,0 +1,152 @@
+/**
+ * @file workload_generator.h
+ * @brief Large synthetic databases for benchmarks and capacity planning
+ *
+ * The fixtures under data/templates are a few dozen line items. A
+ * WorkloadGenerator writes a database of any size that the engine runs
+ * like a real one: a unified template whose line items form a DAG of a
+ * given depth and fan-in (with [t-1] accumulators as in a balance sheet),
+ * drivers of every leaf entity per period for a base scenario and child
+ * scenarios overriding part of them, an entity hierarchy, and assets,
+ * perils and damage functions for physical risk runs.
+ *
+ * Everything is drawn from core::PhiloxStream streams of the seed, one
+ * per table, so a spec always produces the same database, and e.g. more
+ * assets don't change the template.
+ *
+ * Usage:
+ * @code
+ * WorkloadSpec spec;
+ * spec.line_items = 10000;
+ * spec.depth = 40;
+ * auto db = DatabaseFactory::create_sqlite("workload.db");
+ * auto workload = WorkloadGenerator(spec).generate(*db);
+ * PeriodRunner runner(db);
+ * runner.run_periods(workload.leaf_entities[0], workload.scenario_ids[0], workload.period_ids,
+ *                    workload.opening, workload.template_code);
+ * @endcode
+ */
+
+#ifndef FINMODEL_WORKLOAD_GENERATOR_H
+#define FINMODEL_WORKLOAD_GENERATOR_H
+
+#include "types/common_types.h"
+#include "database/idatabase.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace orchestration {
+
+/**
+ * @brief Size and shape of a synthetic workload
+ */
+struct WorkloadSpec {
+    uint64_t seed = 42;
+    std::string template_code = "SYNTHETIC";
+
+    size_t line_items = 1000;       ///< Line items of the template (drivers included)
+    size_t drivers = 100;           ///< Line items read from drivers (the DAG's sources)
+    size_t depth = 20;              ///< Topological levels of the DAG (drivers are level 0)
+    size_t max_fan_in = 4;          ///< Most line items a formula reads
+    double prior_share = 0.1;       ///< Formulas that also read their own [t-1] value
+
+    size_t periods = 12;            ///< Monthly periods from start_date
+    std::string start_date = "2025-01-01";
+    size_t scenarios = 4;           ///< A base scenario and children of it
+    double override_share = 0.2;    ///< Drivers a child scenario overrides
+
+    size_t entities = 10;           ///< Entities in the hierarchy (root included)
+    size_t entity_fan_out = 3;      ///< Children per parent entity
+
+    size_t assets = 1000;           ///< Assets, spread over the leaf entities
+    size_t perils = 20;             ///< Perils per scenario
+
+    /**
+     * @throws std::invalid_argument if the counts can't form a workload
+     *         (no formulas, depth < 2, more drivers than line items, ...)
+     */
+    void validate() const;
+};
+
+/**
+ * @brief What generate() wrote
+ */
+struct Workload {
+    std::string template_code;
+    std::vector<PeriodID> period_ids;
+    std::vector<ScenarioID> scenario_ids;       ///< Base scenario first
+    EntityID root_entity;
+    std::vector<EntityID> leaf_entities;        ///< Entities with drivers and assets
+    size_t levels = 0;                          ///< Topological levels of the template
+    size_t driver_rows = 0;                     ///< Rows in scenario_drivers
+    BalanceSheet opening{};                     ///< Zero opening values of the [t-1] accumulators
+};
+
+/**
+ * @brief Writes synthetic workloads into a database
+ */
+class WorkloadGenerator {
+public:
+    /**
+     * @throws std::invalid_argument if the spec is invalid
+     */
+    explicit WorkloadGenerator(WorkloadSpec spec);
+
+    const WorkloadSpec& spec() const { return spec_; }
+
+    /**
+     * @brief Create the tables a workload needs (if they don't exist)
+     *
+     * The columns the engine reads: templates, scenarios, periods,
+     * entities, drivers, units, FX rates, actions, validation rules and
+     * the physical risk tables.
+     */
+    static void create_schema(database::IDatabase& db);
+
+    /**
+     * @brief Template JSON of the spec (what generate() stores)
+     */
+    std::string template_json() const;
+
+    /**
+     * @brief Create the schema and write the workload
+     * @param db Database without a workload of the same template code
+     * @return Template, scenarios, periods and entities written
+     */
+    Workload generate(database::IDatabase& db) const;
+
+    /**
+     * @brief Code of a synthetic line item, driver or entity ("LI_A", ..., "LI_BA", ...)
+     *
+     * Letters only: [t-k] references accept codes of [A-Z_].
+     */
+    static std::string code(const std::string& prefix, size_t index);
+
+private:
+    WorkloadSpec spec_;
+
+    // PhiloxStream streams of the seed
+    enum Stream : uint64_t { TEMPLATE = 1, DRIVERS, ENTITIES, ASSETS, PERILS };
+
+    /**
+     * @brief Line items per topological level (level 0: the drivers)
+     */
+    std::vector<size_t> level_sizes() const;
+
+    std::vector<ScenarioID> write_scenarios(database::IDatabase& db) const;
+    std::vector<EntityID> write_entities(database::IDatabase& db, EntityID& root) const;
+    size_t write_drivers(database::IDatabase& db, const std::vector<EntityID>& leaves,
+                         const std::vector<ScenarioID>& scenario_ids,
+                         const std::vector<PeriodID>& period_ids) const;
+    void write_physical_risk(database::IDatabase& db, const std::vector<EntityID>& leaves,
+                             const std::vector<ScenarioID>& scenario_ids,
+                             const std::vector<PeriodID>& period_ids) const;
+};
+
+} // namespace orchestration
+} // namespace finmodel
+
+#endif // FINMODEL_WORKLOAD_GENERATOR_H
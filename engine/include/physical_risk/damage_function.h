@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <span>
 #include <utility>
 
 namespace physical_risk {
@@ -29,6 +30,17 @@ public:
      */
     virtual double calculate(double intensity) const = 0;
 
+    /**
+     * @brief calculate() for a block of intensities
+     *
+     * The default calls calculate() per intensity; implementations override
+     * it with a loop that doesn't go through a virtual call per value.
+     *
+     * @param intensities Peril intensities
+     * @param out Receives one damage output per intensity (same size)
+     */
+    virtual void calculate_batch(std::span<const double> intensities, std::span<double> out) const;
+
     /**
      * @brief Get the function type name
      */
@@ -76,6 +88,7 @@ public:
     );
 
     double calculate(double intensity) const override;
+    void calculate_batch(std::span<const double> intensities, std::span<double> out) const override;
     std::string get_function_type() const override { return "PIECEWISE_LINEAR"; }
     std::string get_description() const override { return description_; }
 
@@ -88,6 +101,13 @@ private:
     std::vector<std::pair<double, double>> curve_points_;
     std::string description_;
 
+    // Curve points as separate intensity and damage arrays, searched by
+    // bisection instead of a scan
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+
+    double interpolate(double intensity) const;
+
     // Validate that curve points are sorted and reasonable
     void validate_curve_points() const;
 };
@@ -2,42 +2,74 @@
 
 #include "physical_risk/damage_function.h"
 #include "database/idatabase.h"
-#include <string>
-#include <memory>
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace physical_risk {
 
 /**
- * @brief Registry for loading and caching damage functions from database
+ * @brief What a damage function applies to (damage_function_definition.damage_target)
+ */
+enum class DamageTarget : uint8_t {
+    PPE,
+    INVENTORY,
+    BI
+};
+
+constexpr size_t DAMAGE_TARGET_COUNT = 3;
+
+/**
+ * @brief Registry of the damage functions in the database
+ *
+ * Loads every row of damage_function_definition once, at construction,
+ * and creates the IDamageFunction instances. Lookups never touch the
+ * database and don't modify the registry, so one registry can be shared
+ * by parallel physical risk workers (until reload()).
  *
- * Loads damage function definitions from damage_function_definition table
- * and creates appropriate IDamageFunction instances. Caches functions
- * for efficient repeated access.
+ * Peril types are interned: peril_type_id() resolves the name once, and
+ * get_function_for_peril(id, target) is then two array indexings.
+ *
+ * Location-specific curves of the damage_curve table (if it exists) are
+ * loaded too, per (peril type, archetype, value type): an asset whose
+ * asset_type is an archetype with a curve uses it instead of the peril
+ * type's damage_function_definition function. Every loaded function has a
+ * CurveId, its position in the registry, which DamageCurveAssignment
+ * resolves per asset ahead of the calculation.
  */
 class DamageFunctionRegistry {
 public:
+    using PerilTypeId = uint32_t;
+    static constexpr PerilTypeId UNKNOWN_PERIL = std::numeric_limits<PerilTypeId>::max();
+
+    using CurveId = uint32_t;
+    static constexpr CurveId NO_CURVE = std::numeric_limits<CurveId>::max();
+
     /**
-     * @brief Construct registry with database connection
+     * @brief Construct registry and load all damage functions
+     * @throws std::runtime_error if db is null, the definitions can't be read or a curve is invalid
      */
     explicit DamageFunctionRegistry(finmodel::database::IDatabase* db);
 
     /**
      * @brief Get damage function by function code
      *
-     * Loads from database on first access, then returns cached instance.
-     *
      * @param function_code Function code from database (e.g., "FLOOD_PPE_STANDARD")
      * @return Pointer to damage function, or nullptr if not found
      */
-    const IDamageFunction* get_function(const std::string& function_code);
+    const IDamageFunction* get_function(const std::string& function_code) const;
 
     /**
      * @brief Get damage function for specific peril type and target
      *
-     * Searches for a function matching the peril type and damage target.
-     * If multiple functions match, returns the first one found.
-     * Prioritizes functions with exact matches.
+     * If several functions match, returns the first one (lowest
+     * damage_function_id).
      *
      * @param peril_type Peril type (e.g., "FLOOD", "HURRICANE")
      * @param damage_target Damage target ("PPE", "INVENTORY", "BI")
@@ -46,29 +78,136 @@ public:
     const IDamageFunction* get_function_for_peril(
         const std::string& peril_type,
         const std::string& damage_target
-    );
+    ) const;
+
+    /**
+     * @brief Get damage function for an interned peril type and target
+     *
+     * @param peril_type From peril_type_id() (UNKNOWN_PERIL gives nullptr)
+     * @param damage_target Damage target
+     * @return Pointer to damage function, or nullptr if not found
+     */
+    const IDamageFunction* get_function_for_peril(PerilTypeId peril_type, DamageTarget damage_target) const {
+        return curve(curve_id(peril_type, damage_target));
+    }
+
+    /**
+     * @brief Curve of a peril type and target for any archetype (damage_function_definition)
+     * @return NO_CURVE if there is none
+     */
+    CurveId curve_id(PerilTypeId peril_type, DamageTarget damage_target) const {
+        return (peril_type < by_peril_.size())
+            ? by_peril_[peril_type][static_cast<size_t>(damage_target)]
+            : NO_CURVE;
+    }
 
     /**
-     * @brief Clear the cache and force reload from database
+     * @brief Curve of a peril type and target for an asset archetype
+     *
+     * The archetype's damage_curve row, else the peril type's curve.
+     *
+     * @return NO_CURVE if there is neither
+     */
+    CurveId curve_id(PerilTypeId peril_type, DamageTarget damage_target, const std::string& archetype) const;
+
+    /**
+     * @brief Function of a curve ID (nullptr for NO_CURVE)
      */
-    void clear_cache();
+    const IDamageFunction* curve(CurveId id) const {
+        return (id < functions_.size()) ? functions_[id].get() : nullptr;
+    }
 
     /**
-     * @brief Get number of cached functions
+     * @brief Number of interned peril types (IDs are below it)
      */
-    size_t get_cache_size() const { return cache_.size(); }
+    size_t peril_type_count() const { return by_peril_.size(); }
+
+    /**
+     * @brief Interned ID of a peril type
+     * @return UNKNOWN_PERIL if no damage function is defined for it
+     */
+    PerilTypeId peril_type_id(const std::string& peril_type) const;
+
+    /**
+     * @brief Damage target of its database name
+     * @return Nothing for names other than "PPE", "INVENTORY" and "BI"
+     */
+    static std::optional<DamageTarget> parse_damage_target(const std::string& damage_target);
+
+    /**
+     * @brief Load the definitions again (after they changed in the database)
+     *
+     * Not safe while other threads look functions up. Pointers from earlier
+     * lookups become invalid. On error the registry keeps its functions.
+     */
+    void reload();
+
+    /**
+     * @brief Get number of loaded functions
+     */
+    size_t size() const { return functions_.size(); }
 
 private:
+    using Curves = std::array<CurveId, DAMAGE_TARGET_COUNT>;
+
     finmodel::database::IDatabase* db_;
-    std::map<std::string, std::unique_ptr<IDamageFunction>> cache_;
+    std::vector<std::unique_ptr<IDamageFunction>> functions_;
+    std::unordered_map<std::string, const IDamageFunction*> by_code_;
+    std::unordered_map<std::string, PerilTypeId> peril_types_;
+    std::vector<Curves> by_peril_;
+    std::map<std::pair<PerilTypeId, std::string>, Curves> by_archetype_;   // damage_curve rows
+};
 
-    // Load function from database
-    std::unique_ptr<IDamageFunction> load_function_from_db(const std::string& function_code);
+/**
+ * @brief Damage curve of every asset, peril type and target, resolved once
+ *
+ * A dense assets × peril types × targets table of CurveIds, built when the
+ * assets are loaded so the damage calculation never resolves functions by
+ * name. Peril type and target pairs whose assets all share one curve are
+ * marked uniform: a block of them goes through that curve in one batch;
+ * other blocks are grouped by curve first.
+ */
+class DamageCurveAssignment {
+public:
+    using CurveId = DamageFunctionRegistry::CurveId;
+    using PerilTypeId = DamageFunctionRegistry::PerilTypeId;
+
+    /// shared_curve() of a peril type and target whose assets use several curves
+    static constexpr CurveId MIXED = DamageFunctionRegistry::NO_CURVE - 1;
+
+    DamageCurveAssignment() = default;
+
+    /**
+     * @param registry Curves to assign (CurveIds stay valid until its reload())
+     * @param archetypes Archetype of each asset (AssetExposure::asset_type)
+     */
+    DamageCurveAssignment(const DamageFunctionRegistry& registry, const std::vector<std::string>& archetypes);
 
-    // Build cache key for peril type and target
-    std::string make_peril_cache_key(const std::string& peril_type, const std::string& damage_target) const {
-        return peril_type + "|" + damage_target;
+    size_t assets() const { return assets_; }
+
+    /**
+     * @brief Curve of an asset (NO_CURVE: no damage)
+     */
+    CurveId curve(size_t asset, PerilTypeId peril_type, DamageTarget target) const {
+        return (peril_type < peril_types_)
+            ? curves_[(asset * peril_types_ + peril_type) * DAMAGE_TARGET_COUNT + static_cast<size_t>(target)]
+            : DamageFunctionRegistry::NO_CURVE;
     }
+
+    /**
+     * @brief Curve every asset uses for a peril type and target, or MIXED
+     */
+    CurveId shared_curve(PerilTypeId peril_type, DamageTarget target) const {
+        return (peril_type < peril_types_)
+            ? shared_[peril_type * DAMAGE_TARGET_COUNT + static_cast<size_t>(target)]
+            : DamageFunctionRegistry::NO_CURVE;
+    }
+
+private:
+    size_t assets_ = 0;
+    size_t peril_types_ = 0;
+    std::vector<CurveId> curves_;
+    std::vector<CurveId> shared_;
 };
 
 } // namespace physical_risk
@@ -0,0 +1,111 @@
+/**
+ * @file event_simulation.h
+ * @brief Building blocks of stochastic event-set simulation
+ *
+ * PhysicalRiskEngine::simulate_annual_losses() turns a catalogue of
+ * stochastic events (physical_event rows, each with an annual rate) into
+ * annual loss statistics:
+ *
+ * 1. Every event's loss per asset is calculated once (event loss table)
+ * 2. Each simulated year draws its events from a Poisson process over the
+ *    catalogue, with the year's own Philox stream: a year's losses don't
+ *    depend on which thread simulates it
+ * 3. Annual losses of the portfolio, its entities and (optionally) assets
+ *    go into LossSketch histograms; no per-year losses are kept
+ *
+ * Expected annual losses are exact (sum of rate × event loss); VaR and
+ * TVaR come from the sketches, within their relative accuracy.
+ */
+
+#pragma once
+
+#include "core/philox_stream.h"
+#include "core/quantile_sketch.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace physical_risk {
+
+/// Random numbers of a simulated year (stream = year)
+using PhiloxStream = finmodel::core::PhiloxStream;
+
+/// Annual losses of simulated years
+using LossSketch = finmodel::core::QuantileSketch;
+
+/**
+ * @brief Stochastic event of a catalogue (physical_event row)
+ */
+struct StochasticEvent {
+    int event_id;
+    std::string peril_type;
+    double latitude;
+    double longitude;
+    double intensity;
+    double radius_km;         // 0: point event (assets within 1km)
+    double annual_rate;       // Expected occurrences per year
+};
+
+/**
+ * @brief Settings of PhysicalRiskEngine::simulate_annual_losses()
+ */
+struct MonteCarloOptions {
+    size_t years = 10000;
+    uint64_t seed = 1;
+    std::vector<double> return_periods = {100.0, 250.0};
+    double relative_accuracy = 0.01;      // Of VaR and TVaR
+    bool per_asset = false;               // Also asset statistics (memory per affected asset)
+};
+
+/**
+ * @brief VaR and TVaR at one return period
+ */
+struct TailLoss {
+    double return_period;
+    double var;        // Annual loss exceeded once per return period
+    double tvar;       // Mean annual loss of the years at or beyond var
+};
+
+/**
+ * @brief Annual loss statistics of a portfolio, entity or asset
+ */
+struct LossStatistics {
+    double expected_annual_loss = 0.0;
+    std::vector<TailLoss> tail;           // One per MonteCarloOptions::return_periods
+
+    /// Tail entry of a return period (nullptr if not requested)
+    const TailLoss* at(double return_period) const;
+};
+
+/**
+ * @brief Expected annual losses of an asset from one peril type, per target
+ */
+struct AssetExpectedLoss {
+    int asset_id;
+    std::string asset_code;
+    std::string entity_code;
+    std::string peril_type;
+    std::string currency;
+    double ppe = 0.0;
+    double inventory = 0.0;
+    double bi = 0.0;
+};
+
+/**
+ * @brief Result of PhysicalRiskEngine::simulate_annual_losses()
+ *
+ * Losses are in asset currencies; entity and portfolio totals add them as-is.
+ */
+struct MonteCarloResult {
+    std::string catalogue_code;
+    size_t years = 0;
+    size_t events = 0;
+    LossStatistics portfolio;
+    std::map<std::string, LossStatistics> entities;      // By entity_code ("" = none)
+    std::map<int, LossStatistics> assets;                // By asset_id (per_asset only)
+    std::vector<AssetExpectedLoss> expected_losses;      // Affected assets, by asset and peril type
+};
+
+} // namespace physical_risk
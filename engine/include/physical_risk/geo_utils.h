@@ -1,11 +1,40 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
 #include <vector>
 #include <utility>
+#include <tuple>
 
 namespace physical_risk {
 
+/**
+ * @brief Locations as unit-sphere vectors in structure-of-arrays layout
+ *
+ * Precomputed once (one sin/cos per coordinate) for the batch functions of
+ * GeoUtils, whose loops then need no trigonometry until the final distance.
+ */
+class GeoCoordinates {
+public:
+    GeoCoordinates() = default;
+
+    /**
+     * @brief Convert locations
+     * @param locations (latitude, longitude) in decimal degrees
+     */
+    explicit GeoCoordinates(const std::vector<std::pair<double, double>>& locations);
+
+    size_t size() const { return x_.size(); }
+    const double* x() const { return x_.data(); }
+    const double* y() const { return y_.data(); }
+    const double* z() const { return z_.data(); }
+
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> z_;
+};
+
 /**
  * @brief Geospatial utilities for physical risk calculations
  *
@@ -42,6 +71,9 @@ public:
     /**
      * @brief Find the nearest location from a list of candidates
      *
+     * Scans every candidate; for many targets against the same candidates
+     * build a SpatialIndex once and use SpatialIndex::nearest().
+     *
      * @param target_lat Target latitude
      * @param target_lon Target longitude
      * @param candidates Vector of (latitude, longitude, index) tuples
@@ -65,6 +97,40 @@ public:
                                                   double distance_km,
                                                   double radius_km);
 
+    /**
+     * @brief Distances from one center to a block of locations
+     *
+     * Same distances as haversine_distance(), from the chord between unit
+     * vectors (chord² / 4 is the haversine term): the loop over the block
+     * is plain multiply-adds that the compiler vectorizes, and one atan2
+     * per location turns chords into kilometers.
+     *
+     * @param points Locations
+     * @param indices Locations to measure (e.g. from SpatialIndex::query_radius())
+     * @param count Number of indices
+     * @param center_lat Latitude of the center (decimal degrees)
+     * @param center_lon Longitude of the center (decimal degrees)
+     * @param distances_km Receives count distances
+     */
+    static void haversine_distance_batch(const GeoCoordinates& points,
+                                         const size_t* indices, size_t count,
+                                         double center_lat, double center_lon,
+                                         double* distances_km);
+
+    /**
+     * @brief calculate_intensity_with_decay() over a block of distances
+     *
+     * @param base_intensity Intensity at peril center
+     * @param distances_km Distances from peril center (km)
+     * @param count Number of distances
+     * @param radius_km Peril radius (km)
+     * @param intensities Receives count intensities
+     */
+    static void intensity_with_decay_batch(double base_intensity,
+                                           const double* distances_km, size_t count,
+                                           double radius_km,
+                                           double* intensities);
+
 private:
     // Earth's radius in kilometers (mean radius)
     static constexpr double EARTH_RADIUS_KM = 6371.0;
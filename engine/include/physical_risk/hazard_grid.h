@@ -0,0 +1,162 @@
+/**
+ * @file hazard_grid.h
+ * @brief Gridded hazard maps, memory-mapped from tiled binary files
+ *
+ * A hazard map gives an intensity per cell of a regular latitude/longitude
+ * grid, in one band per period (or return period), e.g. flood depths over
+ * a whole country. As PhysicalPeril rows a national map would be millions
+ * of point events; a HazardGrid instead samples the grid at each asset.
+ *
+ * The file is memory-mapped: only pages of tiles holding assets are read
+ * from disk. Cells are stored in square tiles, one block of float32 values
+ * per (tile, band), so the cell of a location is found with arithmetic
+ * (O(1)) and nearby assets share pages.
+ *
+ * Layout (platform byte order, little-endian):
+ *   "FMHG" u32 version
+ *   u32 rows, cols, bands, tile size
+ *   f64 latitude and longitude of cell (0, 0)'s center, f64 cell sizes
+ *   i32 band key × bands
+ *   float32 values: tiles row-major, per tile one block per band, cells
+ *   row-major within the block; edge tiles are padded; NaN = no data
+ *
+ * Usage:
+ * @code
+ * HazardGrid::from_csv("europe_flood_hazard.csv", "europe_flood.fmhg");
+ * auto grid = std::make_shared<const HazardGrid>("europe_flood.fmhg");
+ * double depth = grid->sample(47.37, 8.54, grid->band_index(2));   // Period 2
+ * @endcode
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace physical_risk {
+
+/**
+ * @brief Extent and resolution of a hazard grid
+ *
+ * Row r, column c is the cell centered at
+ * (lat_origin + r * lat_step, lon_origin + c * lon_step). Grids don't wrap
+ * around the antimeridian.
+ */
+struct HazardGridSpec {
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    double lat_origin = 0.0;      ///< Latitude of the southernmost row's centers
+    double lon_origin = 0.0;      ///< Longitude of the westernmost column's centers
+    double lat_step = 0.0;        ///< Cell size (degrees, > 0)
+    double lon_step = 0.0;
+};
+
+/**
+ * @brief Read-only, memory-mapped hazard grid file
+ *
+ * Lookups don't modify the grid: one grid can be shared by threads.
+ */
+class HazardGrid {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr uint32_t DEFAULT_TILE = 64;
+
+    /**
+     * @brief Map a grid file
+     * @throws std::runtime_error if the file can't be mapped or isn't a valid grid
+     */
+    explicit HazardGrid(const std::string& path);
+    ~HazardGrid();
+
+    HazardGrid(const HazardGrid&) = delete;
+    HazardGrid& operator=(const HazardGrid&) = delete;
+
+    const HazardGridSpec& spec() const { return spec_; }
+    uint32_t tile() const { return tile_; }
+    size_t bands() const { return band_keys_.size(); }
+    const std::vector<int>& band_keys() const { return band_keys_; }
+
+    /**
+     * @brief Band of a key (period or return period)
+     * @return bands() if no band has the key
+     */
+    size_t band_index(int key) const;
+
+    /**
+     * @brief Intensity of the cell containing a location (nearest cell center)
+     * @return NaN outside the grid or where the cell has no data
+     */
+    double cell_value(double lat, double lon, size_t band) const;
+
+    /**
+     * @brief Bilinear interpolation between the four surrounding cell centers
+     *
+     * Cells without data don't contribute (the others' weights are
+     * rescaled); beyond the outermost centers the edge cells are used.
+     *
+     * @return NaN outside the grid or if no surrounding cell has data
+     */
+    double sample(double lat, double lon, size_t band) const;
+
+    /**
+     * @brief sample() or cell_value() for a block of locations
+     * @param out Receives count intensities
+     */
+    void sample_batch(const double* lats, const double* lons, size_t count, size_t band,
+                      bool bilinear, double* out) const;
+
+    /**
+     * @brief Write a grid file
+     * @param values Band-major, then row-major: values[(band * rows + row) * cols + col]
+     * @throws std::invalid_argument for inconsistent sizes, std::runtime_error on write errors
+     */
+    static void write(const std::string& path, const HazardGridSpec& spec,
+                      const std::vector<int>& band_keys, const std::vector<float>& values,
+                      uint32_t tile = DEFAULT_TILE);
+
+    /**
+     * @brief Convert a hazard map CSV (scripts/generate_improved_hazard_maps.py) to a grid file
+     *
+     * Reads latitude, longitude and period_<N>_intensity* columns (band key
+     * N) of points on a regular grid; the cell size is the smallest spacing
+     * between distinct coordinates. Cells without a point have no data.
+     *
+     * @return Spec of the written grid
+     * @throws std::runtime_error if the CSV can't be read or has no intensity columns
+     */
+    static HazardGridSpec from_csv(const std::string& csv_path, const std::string& grid_path,
+                                   uint32_t tile = DEFAULT_TILE);
+
+    /**
+     * @brief Write the header, up to the first value block
+     *
+     * For writers producing the value blocks themselves (HazardMapBuilder);
+     * the arguments aren't checked.
+     */
+    static void write_header(std::ostream& out, const HazardGridSpec& spec,
+                             const std::vector<int>& band_keys, uint32_t tile);
+
+    /**
+     * @brief Byte offset of the block of (tile, band) in a file of this layout
+     * @param tile_index Tile row × tiles per grid row + tile column
+     */
+    static size_t block_offset(size_t bands, uint32_t tile, size_t tile_index, size_t band);
+
+private:
+    HazardGridSpec spec_;
+    std::vector<int> band_keys_;
+    uint32_t tile_ = 0;
+    uint32_t tile_cols_ = 0;      // Tiles per grid row
+
+    const uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    const uint8_t* values_ = nullptr;
+
+    // Value of a cell inside the grid (NaN = no data)
+    double value(uint32_t row, uint32_t col, size_t band) const;
+};
+
+} // namespace physical_risk
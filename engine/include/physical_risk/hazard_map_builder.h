@@ -0,0 +1,184 @@
+/**
+ * @file hazard_map_builder.h
+ * @brief Rasterise peril footprints into hazard grid files
+ *
+ * scripts/generate_improved_hazard_maps.py writes hazard maps as CSV
+ * points, which takes hours for national high-resolution grids. A
+ * HazardMapBuilder writes the HazardGrid file directly: every peril
+ * footprint (a center, an intensity, a radius and a decay shape, scaled
+ * per band) is rasterised into the cells within its radius.
+ *
+ * Tiles are independent: each is computed in its own buffer from the
+ * footprints whose bounding box reaches it, and its blocks are written at
+ * their offsets in the file, so tiles run in parallel (set_parallel()).
+ * Distances go through per-row and per-column unit-vector terms, one
+ * chord per cell in a loop the compiler vectorizes; only cells inside the
+ * radius take the arc distance and the decay.
+ *
+ * update() rewrites, in an existing file, only the tiles touched by
+ * perils that were added, removed or changed since the footprints it was
+ * built from. A tile's values don't depend on the other tiles or on the
+ * thread count, so an updated file is identical to a full rebuild.
+ *
+ * Usage:
+ * @code
+ * HazardMapBuilder builder(spec, {1, 2, 3});   // Bands: periods 1..3
+ * builder.set_parallel(8);
+ * std::vector<PerilFootprint> footprints;
+ * for (const auto& peril : perils) footprints.push_back(PerilFootprint::from_peril(peril, {1, 2, 3}));
+ * builder.build(footprints, "flood.fmhg");
+ * ...
+ * builder.update("flood.fmhg", footprints, changed_footprints);
+ * @endcode
+ */
+
+#pragma once
+
+#include "physical_risk/hazard_grid.h"
+#include "core/thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace physical_risk {
+
+struct PhysicalPeril;
+
+/**
+ * @brief How intensity falls off from a footprint's center to its radius
+ */
+enum class DecayShape {
+    LINEAR,      ///< intensity × (1 - d / radius), as GeoUtils::calculate_intensity_with_decay()
+    CONSTANT,    ///< Full intensity within the radius
+    GAUSSIAN     ///< intensity × exp(-4.5 (d / radius)²): σ = radius / 3, cut off at the radius
+};
+
+/**
+ * @brief Area of one peril event
+ *
+ * Cells whose centers are closer than radius_km take its decayed
+ * intensity; with radius_km <= 0 only the cell containing the center does,
+ * at full intensity.
+ */
+struct PerilFootprint {
+    int peril_id = 0;               ///< Identity across builds (update())
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double intensity = 0.0;
+    double radius_km = 0.0;
+    DecayShape decay = DecayShape::LINEAR;
+    std::vector<double> band_factors;   ///< Intensity factor per band (empty: 1 in every band)
+
+    bool operator==(const PerilFootprint&) const = default;
+
+    /**
+     * @brief Footprint of a physical_peril row, with one band per period
+     *
+     * A band's factor is the peril's intensity_pathway entry of that period,
+     * or 1 within [start_period, end_period] without a pathway; 0 in
+     * periods the peril doesn't affect.
+     */
+    static PerilFootprint from_peril(const PhysicalPeril& peril, const std::vector<int>& periods);
+};
+
+/**
+ * @brief How overlapping footprints combine in a cell
+ */
+enum class HazardCombine {
+    MAX,    ///< Most intense footprint
+    SUM     ///< Total over footprints (in footprint order)
+};
+
+/**
+ * @brief What a build or update wrote
+ */
+struct HazardBuildStats {
+    size_t tiles = 0;               ///< Tiles of the grid
+    size_t tiles_written = 0;
+    size_t cell_evaluations = 0;    ///< (cell, footprint) distances computed
+};
+
+/**
+ * @brief Writes hazard grid files from peril footprints
+ */
+class HazardMapBuilder {
+public:
+    /**
+     * @throws std::invalid_argument for an empty grid, band list or tile
+     */
+    HazardMapBuilder(const HazardGridSpec& spec, std::vector<int> band_keys,
+                     uint32_t tile = HazardGrid::DEFAULT_TILE);
+    ~HazardMapBuilder();
+
+    const HazardGridSpec& spec() const { return spec_; }
+    const std::vector<int>& band_keys() const { return band_keys_; }
+
+    /**
+     * @brief Build tiles on several threads (the file is the same for any count)
+     * @param threads Total threads including the caller (0 or 1: sequential)
+     */
+    void set_parallel(size_t threads);
+
+    void set_combine(HazardCombine combine) { combine_ = combine; }
+
+    /// Value of cells no footprint reaches (default 0; NaN: no data)
+    void set_background(float value) { background_ = value; }
+
+    /**
+     * @brief Write a whole grid file
+     * @throws std::invalid_argument for a footprint off the sphere or with the wrong number of band factors
+     * @throws std::runtime_error if the file can't be written
+     */
+    HazardBuildStats build(const std::vector<PerilFootprint>& footprints, const std::string& path) const;
+
+    /**
+     * @brief Rewrite the tiles of an existing file touched by changed footprints
+     *
+     * Footprints are matched by peril_id; a tile is rewritten if the old or
+     * new footprint of an added, removed or changed peril reaches it.
+     * Blocks are overwritten in place: map the file again afterwards
+     * (grids mapped before may or may not see the new values).
+     *
+     * @param previous Footprints the file was built from
+     * @param current Footprints it should now hold
+     * @throws std::runtime_error if the file isn't a grid of this builder's spec, bands and tile
+     */
+    HazardBuildStats update(const std::string& path, const std::vector<PerilFootprint>& previous,
+                            const std::vector<PerilFootprint>& current) const;
+
+private:
+    struct Footprint;   // Footprint prepared for the tile kernel
+    struct Scratch;     // Per-worker tile buffers
+
+    HazardGridSpec spec_;
+    std::vector<int> band_keys_;
+    uint32_t tile_;
+    size_t tile_rows_;
+    size_t tile_cols_;
+    HazardCombine combine_ = HazardCombine::MAX;
+    float background_ = 0.0f;
+    std::unique_ptr<finmodel::core::ThreadPool> pool_;   // set_parallel()
+
+    // Unit-vector terms of cell centers: per row (latitude) and per column (longitude)
+    std::vector<double> sin_lat_;
+    std::vector<double> cos_lat_;
+    std::vector<double> sin_lon_;
+    std::vector<double> cos_lon_;
+
+    Footprint prepare(const PerilFootprint& footprint) const;
+
+    // Tiles a prepared footprint reaches, appended to tiles
+    void covered_tiles(const Footprint& footprint, std::vector<size_t>& tiles) const;
+
+    // Compute the given tiles from all footprints and write their blocks to the open file
+    HazardBuildStats write_tiles(int fd, const std::string& path, const std::vector<Footprint>& footprints,
+                                 const std::vector<size_t>& tiles) const;
+
+    // One tile's blocks (band-major) into scratch.values; returns cell evaluations
+    size_t compute_tile(size_t tile_index, const std::vector<Footprint>& footprints,
+                        const std::vector<size_t>& members, Scratch& scratch) const;
+};
+
+} // namespace physical_risk
@@ -1,8 +1,13 @@
 #pragma once
 
+#include "physical_risk/event_simulation.h"
 #include "physical_risk/geo_utils.h"
+#include "physical_risk/hazard_grid.h"
+#include "physical_risk/spatial_index.h"
 #include "physical_risk/damage_function_registry.h"
 #include "database/idatabase.h"
+#include "core/thread_pool.h"
+#include <map>
 #include <string>
 #include <vector>
 #include <memory>
@@ -25,6 +30,22 @@ struct PhysicalPeril {
     int end_period;  // -1 means null (single period event)
     double radius_km;
     std::string description;
+
+    // Intensity factor of each affected period from start_period, e.g. the
+    // RCP/SSP pathway of a chronic peril (empty: constant intensity)
+    std::vector<double> intensity_pathway;
+};
+
+/**
+ * @brief Gridded hazard of a scenario, sampled at every asset
+ *
+ * Each band of the grid is the hazard of the period equal to its key.
+ */
+struct HazardMapPeril {
+    std::string peril_type;                   // Selects the damage functions (e.g. "FLOOD")
+    std::string peril_code;                   // Reported in DamageResult::peril_code
+    std::shared_ptr<const HazardGrid> grid;
+    bool bilinear = true;                     // Else the intensity of the asset's cell
 };
 
 /**
@@ -46,13 +67,17 @@ struct AssetExposure {
     std::string revenue_currency;
 };
 
+/// DamageResult::peril_id of damages not from a physical_peril row
+/// (HazardMapPeril and event catalogue damages)
+constexpr int HAZARD_MAP_PERIL_ID = 0;
+
 /**
  * @brief Result of damage calculation for a single asset-peril combination
  */
 struct DamageResult {
     int asset_id;
     std::string asset_code;
-    int peril_id;
+    int peril_id;               // HAZARD_MAP_PERIL_ID for hazard map and event catalogue damages
     std::string peril_code;
     std::string peril_type;
     int period;
@@ -73,7 +98,7 @@ struct DamageResult {
  * Workflow:
  * 1. Load physical perils for a scenario
  * 2. Load asset exposures
- * 3. For each peril, find affected assets (geospatial matching)
+ * 3. For each peril, find affected assets (SpatialIndex radius query)
  * 4. Apply damage functions to calculate impacts
  * 5. Generate scenario drivers for PeriodRunner to consume
  */
@@ -84,20 +109,75 @@ public:
      */
     explicit PhysicalRiskEngine(finmodel::database::IDatabase* db);
 
+    /**
+     * @brief Construct engine sharing a loaded damage function registry
+     *
+     * Parallel workers, each with its own connection, can share one registry.
+     *
+     * @throws std::runtime_error if db or registry is null
+     */
+    PhysicalRiskEngine(finmodel::database::IDatabase* db,
+                       std::shared_ptr<const DamageFunctionRegistry> registry);
+
     /**
      * @brief Process all physical perils for a scenario
      *
      * Main entry point. Loads perils and assets, calculates damages,
      * and generates scenario drivers that can be consumed by PeriodRunner.
+     * Losses are summed per period and driver code (perils of one type
+     * hitting an asset in the same period give one driver), and written in
+     * one transaction.
      *
      * @param scenario_id Scenario to process
      * @return Number of drivers generated
      */
     int process_scenario(int scenario_id);
 
+    /**
+     * @brief Also store every asset-peril-period damage in physical_risk_damage
+     *
+     * The per-peril breakdown behind the summed drivers, replaced with them
+     * (see data/migrations/007_physical_risk_damage.sql). Off by default.
+     */
+    void set_damage_breakdown(bool enabled) { damage_breakdown_ = enabled; }
+
+    /**
+     * @brief Calculate damages on several threads
+     *
+     * Every peril's nearby assets are cut into shards of at most
+     * shard_assets assets; shards run on a thread pool, each into its own
+     * result buffer, and the buffers are concatenated in shard order. The
+     * result is the same as with one thread, for any thread count.
+     *
+     * @param threads Total threads including the caller (0 or 1: sequential)
+     * @param shard_assets Assets per shard (at least 1)
+     */
+    void set_parallel(size_t threads, size_t shard_assets = 4096);
+
+    /**
+     * @brief Evaluate a hazard map in a scenario, besides its physical_peril rows
+     *
+     * The map's grid stays mapped while the engine holds it.
+     *
+     * @throws std::invalid_argument if the map has no grid
+     */
+    void add_hazard_map(int scenario_id, HazardMapPeril map);
+
+    /**
+     * @brief Forget all hazard maps
+     */
+    void clear_hazard_maps() { hazard_maps_.clear(); }
+
     /**
      * @brief Calculate damages for all asset-peril combinations
      *
+     * Results are ordered by peril (load order), asset and period, then
+     * by hazard map (as added), band and asset. A peril with an intensity
+     * pathway (physical_peril_pathway) has its intensity scaled in each
+     * affected period; distances and decay are computed once per asset
+     * and the damage functions evaluated for all periods in one call.
+     * Each asset's curves (by its asset_type, see DamageFunctionRegistry)
+     * are resolved once after the assets load.
      * Exposed for testing and manual analysis.
      *
      * @param scenario_id Scenario to analyze
@@ -105,31 +185,139 @@ public:
      */
     std::vector<DamageResult> calculate_damages(int scenario_id);
 
+    /**
+     * @brief Annual loss statistics of a stochastic event catalogue
+     *
+     * Each event's damages are calculated once, as a physical_peril row
+     * of its location, intensity and radius. Simulated years then draw
+     * Poisson-distributed occurrences of every event (its annual_rate)
+     * from Philox streams keyed by (seed, year), and their summed losses
+     * go into LossSketch histograms, merged across threads. Results
+     * depend on the seed only, not on the thread count (set_parallel()).
+     *
+     * @param catalogue_code physical_event rows to simulate
+     * @param options Years, seed, return periods and accuracy
+     * @throws std::invalid_argument for no years, return periods below 1
+     *         or an accuracy outside (0, 1)
+     */
+    MonteCarloResult simulate_annual_losses(const std::string& catalogue_code,
+                                            const MonteCarloOptions& options = {});
+
+    /**
+     * @brief Write drivers of a simulated catalogue into a scenario
+     *
+     * One driver per asset, peril type and target (as process_scenario(),
+     * which it replaces) in each of the periods: the expected annual loss,
+     * or with a return period the asset's VaR, split across its peril
+     * types and targets in proportion to their expected losses.
+     *
+     * @param periods Periods receiving the drivers
+     * @param return_period 0 for expected losses, else one of the simulated
+     *        return periods (needs MonteCarloOptions::per_asset)
+     * @return Number of drivers generated
+     * @throws std::invalid_argument if the result has no such asset statistics
+     */
+    int generate_loss_drivers(int scenario_id, const MonteCarloResult& result,
+                              const std::vector<int>& periods, double return_period = 0.0);
+
     /**
      * @brief Get damage function registry (for testing)
      */
-    DamageFunctionRegistry& get_registry() { return registry_; }
+    const DamageFunctionRegistry& get_registry() const { return *registry_; }
 
 private:
     finmodel::database::IDatabase* db_;
-    DamageFunctionRegistry registry_;
+    std::shared_ptr<const DamageFunctionRegistry> registry_;
 
-    // Load perils for scenario
+    // Load perils for scenario (with their intensity pathways)
     std::vector<PhysicalPeril> load_perils(int scenario_id);
 
+    // Intensity pathways of physical_peril_pathway, if the table exists
+    void load_pathways(int scenario_id, std::vector<PhysicalPeril>& perils);
+
     // Load active assets
     std::vector<AssetExposure> load_assets();
 
-    // Calculate damage for single asset-peril pair
+    // Load the events of a catalogue
+    std::vector<StochasticEvent> load_events(const std::string& catalogue_code);
+
+    // Assets near one peril with their distances, decayed intensities and
+    // damage function outputs, each evaluated for the whole block at once.
+    // Under an intensity pathway the intensities and outputs hold every
+    // affected period of an asset (asset-major), else one value per asset
+    struct DamageBlock {
+        std::vector<size_t> assets;
+        size_t periods = 1;
+        std::vector<double> distances_km;
+        std::vector<double> intensities;
+        std::vector<double> ppe_damage_pct;
+        std::vector<double> inventory_damage_pct;
+        std::vector<double> bi_downtime_days;
+
+        // Entries grouped by curve when a block's assets use several
+        std::vector<uint32_t> curve_order;
+        std::vector<size_t> curve_starts;
+        std::vector<double> gathered;
+        std::vector<double> computed;
+    };
+
+    std::unique_ptr<finmodel::core::ThreadPool> pool_;   // set_parallel()
+    size_t shard_assets_ = 4096;
+    bool damage_breakdown_ = false;
+    std::map<int, std::vector<HazardMapPeril>> hazard_maps_;   // By scenario
+
+    // Run fn over [0, count) on the pool after set_parallel(), else on this thread
+    size_t workers() const { return pool_ ? pool_->size() : 1; }
+    void for_each(size_t count, const finmodel::core::ThreadPool::RangeFunction& fn) const;
+
+    // Fill a block with assets near a peril (from the spatial index), over
+    // the periods of its intensity pathway
+    void evaluate_block(
+        const PhysicalPeril& peril,
+        const GeoCoordinates& coordinates,
+        const DamageCurveAssignment& curves,
+        const size_t* assets,
+        size_t count,
+        DamageBlock& block
+    ) const;
+
+    // Fill a block with assets [first, first + count) sampled in a hazard map band
+    void evaluate_hazard_block(
+        const HazardMapPeril& map,
+        size_t band,
+        const std::vector<double>& lats,
+        const std::vector<double>& lons,
+        const DamageCurveAssignment& curves,
+        size_t first,
+        size_t count,
+        DamageBlock& block
+    ) const;
+
+    // Damage function outputs of a block's intensities, each asset through
+    // its assigned curves (one batch per curve)
+    void apply_damage_functions(const std::string& peril_type, const DamageCurveAssignment& curves,
+                                DamageBlock& block) const;
+
+    // Curves of the loaded assets
+    DamageCurveAssignment assign_curves(const std::vector<AssetExposure>& assets) const;
+
+    // Calculate damage for single asset-peril pair (block entry i, the
+    // peril's affected period k)
     DamageResult calculate_damage(
         const AssetExposure& asset,
         const PhysicalPeril& peril,
-        int period
-    );
+        int period,
+        const DamageBlock& block,
+        size_t i,
+        size_t k = 0
+    ) const;
 
     // Generate scenario drivers from damage results
     int generate_drivers(int scenario_id, const std::vector<DamageResult>& damages);
 
+    // Replace the scenario's rows in physical_risk_damage (set_damage_breakdown())
+    void store_damage_breakdown(int scenario_id, const std::vector<DamageResult>& damages);
+
     // Helper: Map damage target to driver code
     std::string map_damage_to_driver(
         const std::string& peril_type,
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "database/idatabase.h"
+#include "core/thread_pool.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace physical_risk {
+
+/**
+ * @brief Static k-d tree of locations for radius and nearest-neighbour queries
+ *
+ * Locations are stored as points on the unit sphere, where the straight
+ * line (chord) between two points grows monotonically with their great
+ * circle distance: a radius query becomes a 3-D ball query, answered by
+ * visiting only the tree nodes whose half-space can reach the ball,
+ * O(log N + hits) for compact radii. The k nearest locations likewise are
+ * the k nearest unit vectors, found in O(log N + k) expected, instead of
+ * GeoUtils::find_nearest_location()'s scan over every candidate. Built
+ * once, then read-only (safe to query from several threads).
+ *
+ * store() writes the built tree into a database table (copied into input
+ * snapshots), so workers load() it without sorting again.
+ *
+ * Usage:
+ * @code
+ * SpatialIndex index(locations);   // (latitude, longitude) per asset
+ * for (size_t i : index.query_radius(peril.latitude, peril.longitude, peril.radius_km)) {
+ *     // assets[i] may be within the radius: confirm with haversine_distance()
+ * }
+ *
+ * // Grid cell of every asset, on a thread pool
+ * SpatialIndex cells(grid_points);
+ * cells.query_nearest_batch(asset_lats.data(), asset_lons.data(), assets, 1, cell.data(), km.data(), &pool);
+ * @endcode
+ */
+class SpatialIndex {
+public:
+    /// Index of query_nearest_batch() slots without a k-th location
+    static constexpr size_t NO_LOCATION = std::numeric_limits<size_t>::max();
+
+    /**
+     * @brief Location found by a nearest-neighbour query
+     */
+    struct Neighbor {
+        size_t index;           ///< Into the locations the index was built from
+        double distance_km;     ///< Great circle distance (as GeoUtils::haversine_distance())
+    };
+
+    SpatialIndex() = default;
+
+    /**
+     * @brief Build the index
+     * @param locations (latitude, longitude) in decimal degrees; indices refer to this vector
+     */
+    explicit SpatialIndex(const std::vector<std::pair<double, double>>& locations);
+
+    /**
+     * @brief Locations possibly within a great circle distance of a point
+     *
+     * @param lat Latitude of the center (decimal degrees)
+     * @param lon Longitude of the center (decimal degrees)
+     * @param radius_km Distance in kilometers
+     * @return Ascending indices of every location within radius_km; locations
+     *         a few meters further out may be included, never any closer one left out
+     */
+    std::vector<size_t> query_radius(double lat, double lon, double radius_km) const;
+
+    /**
+     * @brief The k locations nearest to a point
+     * @return min(k, size()) neighbours by ascending distance, ties by index
+     */
+    std::vector<Neighbor> query_nearest(double lat, double lon, size_t k) const;
+
+    /**
+     * @brief Nearest location to a point (NO_LOCATION for an empty index)
+     */
+    size_t nearest(double lat, double lon) const;
+
+    /**
+     * @brief k nearest locations of many points
+     * @param lats Latitudes of the points (decimal degrees)
+     * @param lons Longitudes of the points
+     * @param count Number of points
+     * @param k Neighbours per point
+     * @param indices Output, count × k: point q's neighbours at [q·k, q·k + k)
+     *        as query_nearest() orders them, NO_LOCATION past the last location
+     * @param distances_km Output, count × k (infinity past the last location); may be null
+     * @param pool Threads to query on (null: this thread); results don't depend on it
+     */
+    void query_nearest_batch(const double* lats, const double* lons, size_t count, size_t k,
+                             size_t* indices, double* distances_km,
+                             finmodel::core::ThreadPool* pool = nullptr) const;
+
+    /**
+     * @brief Write the tree into spatial_index_point (replacing an index of the same code)
+     */
+    void store(finmodel::database::IDatabase& db, const std::string& index_code) const;
+
+    /**
+     * @brief Read a tree written by store()
+     * @throws std::runtime_error if the table has no such index or its slots aren't a tree
+     */
+    static SpatialIndex load(finmodel::database::IDatabase& db, const std::string& index_code);
+
+    size_t size() const { return points_.size(); }
+
+private:
+    using Point = std::array<double, 3>;
+
+    // Tree in implicit form: the node of range [begin, end) is its median,
+    // split on axis depth % 3
+    std::vector<Point> points_;     // Unit vectors in tree order
+    std::vector<uint32_t> ids_;     // Location index of each tree slot
+
+    static Point to_unit_vector(double lat, double lon);
+
+    void build(const std::vector<Point>& source, size_t begin, size_t end, int axis);
+
+    void query(size_t begin, size_t end, int axis, const Point& center, double chord_sq,
+               std::vector<size_t>& out) const;
+
+    // Max-heap of the best (chord², location) pairs found so far
+    using Candidate = std::pair<double, uint32_t>;
+
+    void nearest(size_t begin, size_t end, int axis, const Point& center, size_t k,
+                 std::vector<Candidate>& heap) const;
+};
+
+} // namespace physical_risk
@@ -7,14 +7,27 @@
 #define FINMODEL_PL_TAX_ENGINE_H
 
 #include "pl/tax_strategy.h"
+#include "core/compiled_formula.h"
+#include "core/formula_evaluator.h"
 #include "database/connection.h"
+#include <cstdint>
 #include <memory>
 #include <map>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace finmodel {
 namespace pl {
 
+/**
+ * @brief Registered strategy, resolved once by name (TaxEngine::resolve())
+ *
+ * Stays valid, and refers to the same name, when the strategy is
+ * registered again.
+ */
+using TaxStrategyHandle = uint32_t;
+
 /**
  * @brief Tax computation engine
  *
@@ -44,6 +57,48 @@ public:
         const std::string& strategy_name = "US_FEDERAL"
     );
 
+    /**
+     * @brief Resolve a strategy name to a handle
+     * @throws std::runtime_error if no strategy has the name
+     */
+    TaxStrategyHandle resolve(const std::string& strategy_name) const;
+
+    /**
+     * @brief Compute tax with a resolved strategy
+     * @param strategy Handle from resolve()
+     * @param pre_tax_income Income before tax
+     * @param ctx Calculation context
+     * @return Tax amount (non-negative)
+     */
+    double compute_tax(TaxStrategyHandle strategy, double pre_tax_income, const core::Context& ctx) const;
+
+    /**
+     * @brief Compute tax on a block of incomes (e.g. one per scenario lane)
+     * @param strategy Handle from resolve()
+     * @param pre_tax_income Incomes before tax
+     * @param tax Receives one tax amount per income (same size)
+     * @param ctx Calculation context
+     * @throws std::invalid_argument if the sizes differ
+     */
+    void compute_tax(
+        TaxStrategyHandle strategy,
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        const core::Context& ctx
+    ) const;
+
+    /**
+     * @brief Custom function handler for a compiled formula's TAX_COMPUTE calls
+     * @param compiled Compiled formula (must outlive the handler)
+     * @return Handler to pass to FormulaEvaluator::evaluate() or LaneEvaluator::evaluate()
+     * @throws std::runtime_error if a call names an unknown strategy
+     *
+     * Strategies are resolved here, once per formula. Calls of the formula
+     * are recognised by their call site, so evaluation doesn't look up
+     * strategy names; other names are resolved as they come.
+     */
+    core::FormulaEvaluator::CustomFunctionHandler bind(const core::CompiledFormula& compiled) const;
+
     /**
      * @brief Get effective tax rate
      * @param pre_tax_income Income before tax
@@ -76,7 +131,9 @@ public:
 
 private:
     database::DatabaseConnection& db_;
-    std::map<std::string, std::unique_ptr<ITaxStrategy>> strategies_;
+    std::map<std::string, TaxStrategyHandle> handles_;
+    std::vector<std::unique_ptr<ITaxStrategy>> strategies_;   ///< By handle
+    std::map<std::string, double> no_params_;                  // Empty for now
 
     // Load default strategies
     void load_default_strategies();
@@ -42,6 +42,13 @@ public:
         const std::map<std::string, double>& params
     ) const override;
 
+    void calculate_tax_batch(
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        const core::Context& ctx,
+        const std::map<std::string, double>& params
+    ) const override;
+
     std::string name() const override;
     std::string description() const override;
 
@@ -23,6 +23,10 @@ namespace pl {
  * Tax calculation:
  *   For income = 75k:
  *   tax = 50k * 0.10 + 25k * 0.20 = 5k + 5k = 10k
+ *
+ * Brackets are flattened at construction into the income where each
+ * starts and the tax on all income below it, so a calculation is one
+ * binary search: tax = base_tax[i] + (income - start[i]) * rate[i].
  */
 class ProgressiveTaxStrategy : public ITaxStrategy {
 public:
@@ -47,11 +51,25 @@ public:
         const std::map<std::string, double>& params
     ) const override;
 
+    void calculate_tax_batch(
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        const core::Context& ctx,
+        const std::map<std::string, double>& params
+    ) const override;
+
     std::string name() const override;
     std::string description() const override;
 
 private:
     std::vector<Bracket> brackets_;
+
+    // Flattened brackets: the first starts at income 0
+    std::vector<double> starts_;
+    std::vector<double> rates_;
+    std::vector<double> base_tax_;
+
+    double bracket_tax(double pre_tax_income) const;
 };
 
 } // namespace pl
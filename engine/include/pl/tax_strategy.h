@@ -8,6 +8,8 @@
 
 #include <string>
 #include <map>
+#include <cstddef>
+#include <span>
 #include "core/context.h"
 
 namespace finmodel {
@@ -39,6 +41,25 @@ public:
         const std::map<std::string, double>& params
     ) const = 0;
 
+    /**
+     * @brief calculate_tax() for a block of incomes (e.g. one per scenario lane)
+     *
+     * The default calls calculate_tax() per income; implementations override
+     * it with a loop that doesn't go through a virtual call per value.
+     *
+     * @param pre_tax_income Incomes before tax
+     * @param tax Receives one tax amount per income (same size)
+     * @param ctx Calculation context
+     * @param params Strategy-specific parameters
+     * @throws std::invalid_argument if the sizes differ
+     */
+    virtual void calculate_tax_batch(
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        const core::Context& ctx,
+        const std::map<std::string, double>& params
+    ) const;
+
     /**
      * @brief Get strategy name
      * @return Strategy identifier (e.g., "FLAT_RATE", "PROGRESSIVE")
@@ -52,6 +73,62 @@ public:
     virtual std::string description() const = 0;
 };
 
+/**
+ * @brief Interface for tax strategies that depend on earlier periods
+ *
+ * E.g. loss carryforward: a period's tax depends on the losses of earlier
+ * ones. Instead of reading them back through [t-k] references, each
+ * scenario carries a fixed-size state (a loss pool, its vintages, ...)
+ * from one period to the next, which the caller keeps with its other
+ * roll-forward state (see UnifiedEngine::set_tax_state()).
+ */
+class IStatefulTaxStrategy {
+public:
+    virtual ~IStatefulTaxStrategy() = default;
+
+    /**
+     * @brief Number of values in a scenario's state
+     */
+    virtual size_t state_size() const = 0;
+
+    /**
+     * @brief State before a scenario's first period
+     * @param state Receives state_size() values
+     */
+    virtual void initial_state(std::span<double> state) const = 0;
+
+    /**
+     * @brief Calculate a period's tax and advance the state to the next period
+     * @param pre_tax_income Income before tax (can be negative)
+     * @param state The scenario's state_size() values, updated in place
+     * @return Tax amount (non-negative)
+     */
+    virtual double calculate_tax(double pre_tax_income, std::span<double> state) const = 0;
+
+    /**
+     * @brief calculate_tax() for one period of many scenario lanes
+     *
+     * The default calls calculate_tax() per lane on a copy of its state;
+     * implementations override it with a loop over the lanes.
+     *
+     * @param pre_tax_income Income of each lane
+     * @param tax Receives each lane's tax (same size)
+     * @param states state_size() values per lane, structure of arrays:
+     *        value i of lane l at states[i * lanes + l]
+     * @throws std::invalid_argument if the sizes don't match
+     */
+    virtual void calculate_tax_batch(
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        std::span<double> states
+    ) const;
+
+    /**
+     * @brief Get strategy name
+     */
+    virtual std::string name() const = 0;
+};
+
 } // namespace pl
 } // namespace finmodel
 
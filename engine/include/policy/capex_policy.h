@@ -0,0 +1,198 @@
+/**
+ * @file capex_policy.h
+ * @brief Capex policies and straight-line depreciation over capex vintages
+ *
+ * Each period's capex is a vintage depreciated straight-line over the
+ * policy's useful life L, starting the period after it was spent:
+ *
+ *     D&A_t = (capex_t-1 + ... + capex_t-L) / L
+ *
+ * A template would need L lagged terms ([t-1] ... [t-L]) for this.
+ * VintageSchedule keeps the last vintages in a ring with their running
+ * sum instead, so recording a period and reading its D&A are O(1)
+ * whatever L is. It is a template over the value type: a double for one
+ * run, or a core::LaneArray keeping the vintages of every lane of a lane
+ * run side by side.
+ *
+ * Policies live in capex_policy (useful_life_periods from
+ * data/migrations/017_policy_kernels.sql); templates read the selected
+ * one through PolicyProvider (policy:DEPRECIATION, policy:CAPEX, ...).
+ *
+ * Usage:
+ * @code
+ * VintageSchedule<double> vintages(policy.useful_life_periods, 0.0);
+ * for (...) {
+ *     double depreciation = vintages.depreciation();
+ *     double capex = policy.capex(revenue, depreciation);
+ *     vintages.add(capex);
+ * }
+ * @endcode
+ */
+
+#pragma once
+
+#include "database/idatabase.h"
+#include "core/eigen.h"
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace policy {
+
+namespace detail {
+
+/// A value of the type and lane count of another
+inline double constant_like(double, double value) { return value; }
+inline Eigen::ArrayXd constant_like(const Eigen::ArrayXd& like, double value) {
+    return Eigen::ArrayXd::Constant(like.size(), value);
+}
+
+} // namespace detail
+
+/**
+ * @brief One row of capex_policy
+ */
+struct CapexPolicy {
+    enum class Method { FIXED, REVENUE_PCT, DEPRECIATION_PCT };
+
+    std::string code;
+    Method method = Method::DEPRECIATION_PCT;
+    double fixed_amount = 0.0;       ///< FIXED: capex per period
+    double revenue_pct = 0.0;        ///< REVENUE_PCT: 0.05 = 5% of revenue
+    double depreciation_pct = 1.0;   ///< DEPRECIATION_PCT: 1.2 = 120% of D&A
+    int useful_life_periods = 40;    ///< Straight-line life of each vintage
+
+    /**
+     * @brief Active policies by code
+     * @throws database::DatabaseException if the table can't be read (e.g. before migration 017)
+     * @throws std::invalid_argument for an unknown method or a life below 1
+     */
+    static std::map<std::string, CapexPolicy> load(database::IDatabase& db);
+
+    /**
+     * @brief Method of a capex_policy.method value
+     * @throws std::invalid_argument for anything but fixed, revenue_pct and depreciation_pct
+     */
+    static Method parse_method(const std::string& method);
+
+    /**
+     * @brief Capex of a period under the policy
+     * @param revenue Revenue of the period (read by REVENUE_PCT)
+     * @param depreciation D&A of the period (read by DEPRECIATION_PCT)
+     */
+    template <typename T>
+    T capex(const T& revenue, const T& depreciation) const {
+        switch (method) {
+            case Method::FIXED:
+                return detail::constant_like(revenue, fixed_amount);
+            case Method::REVENUE_PCT:
+                return revenue * revenue_pct;
+            case Method::DEPRECIATION_PCT:
+            default:
+                return depreciation * depreciation_pct;
+        }
+    }
+};
+
+/**
+ * @brief Straight-line depreciation of the last L capex vintages
+ *
+ * The ring holds L + 1 vintages so the newest period can be recorded
+ * again (a recalculation) and read again before that, both in O(1).
+ */
+template <typename T>
+class VintageSchedule {
+public:
+    /**
+     * @param useful_life_periods L
+     * @param zero Zero of the value type (its lane count for arrays)
+     * @throws std::invalid_argument for a life below 1
+     */
+    VintageSchedule(int useful_life_periods, const T& zero)
+        : life_(useful_life_periods), zero_(zero), sum_(zero) {
+        if (useful_life_periods < 1) {
+            throw std::invalid_argument("VintageSchedule: useful life must be at least 1 period");
+        }
+        ring_.assign(static_cast<size_t>(useful_life_periods) + 1, zero);
+    }
+
+    int useful_life() const { return life_; }
+    size_t periods() const { return count_; }   ///< Vintages recorded since clear()
+
+    /**
+     * @brief Close a period: its capex becomes the newest vintage, the one L + 1 periods back drops out
+     */
+    void add(const T& capex) {
+        const size_t size = ring_.size();
+        if (count_ == size) {
+            sum_ -= ring_[head_];   // Oldest
+        } else {
+            ++count_;
+        }
+        ring_[head_] = capex;
+        sum_ += capex;
+        head_ = (head_ + 1) % size;
+        if (head_ == 0) {
+            // Re-add the ring once per lap so rounding of the running sum doesn't build up
+            sum_ = zero_;
+            for (const T& vintage : ring_) {
+                sum_ += vintage;
+            }
+        }
+    }
+
+    /**
+     * @brief Replace the newest vintage (the last period recorded again)
+     */
+    void replace_newest(const T& capex) {
+        if (count_ == 0) {
+            add(capex);
+            return;
+        }
+        T& newest = ring_[(head_ + ring_.size() - 1) % ring_.size()];
+        sum_ += capex - newest;
+        newest = capex;
+    }
+
+    /**
+     * @brief D&A of the period after the newest vintage: the last L vintages / L
+     */
+    T depreciation() const {
+        if (count_ == ring_.size()) {
+            return (sum_ - ring_[head_]) / static_cast<double>(life_);
+        }
+        return sum_ / static_cast<double>(life_);
+    }
+
+    /**
+     * @brief D&A of the newest vintage's own period: the L vintages before it / L
+     */
+    T depreciation_of_newest() const {
+        if (count_ == 0) {
+            return zero_;
+        }
+        return (sum_ - ring_[(head_ + ring_.size() - 1) % ring_.size()]) / static_cast<double>(life_);
+    }
+
+    void clear() {
+        std::fill(ring_.begin(), ring_.end(), zero_);
+        sum_ = zero_;
+        head_ = 0;
+        count_ = 0;
+    }
+
+private:
+    int life_;
+    T zero_;
+    T sum_;                 ///< Of every vintage in the ring
+    std::vector<T> ring_;   ///< L + 1 vintages, oldest at head_ once full
+    size_t head_ = 0;       ///< Slot of the next vintage
+    size_t count_ = 0;
+};
+
+} // namespace policy
+} // namespace finmodel
@@ -0,0 +1,76 @@
+/**
+ * @file wc_policy.h
+ * @brief Days-based working capital policies (DSO / DPO / DIO)
+ *
+ * A working capital policy sets each balance as days of its period flow:
+ *
+ *     receivables = revenue · DSO / days_in_period
+ *     payables    = cogs · DPO / days_in_period
+ *     inventory   = cogs · DIO / days_in_period
+ *
+ * Each balance is one multiplication per period, so the kernels are
+ * templates over the value type: a double for one run, or a
+ * core::LaneArray for all lanes of a lane run at once.
+ *
+ * Policies live in wc_policy (data/migrations/001_initial_schema.sql);
+ * templates read the selected one through PolicyProvider (policy:DSO_DAYS,
+ * policy:DSO_FACTOR, ...).
+ *
+ * Usage:
+ * @code
+ * auto policies = WorkingCapitalPolicy::load(*db);
+ * const auto& wc = policies.at("DEFAULT");
+ * double ar = wc.receivables(revenue, 91.0);
+ * core::LaneArray ap = wc.payables(cogs_lanes, 91.0);
+ * @endcode
+ */
+
+#pragma once
+
+#include "database/idatabase.h"
+#include <map>
+#include <string>
+
+namespace finmodel {
+namespace policy {
+
+/**
+ * @brief One row of wc_policy
+ */
+struct WorkingCapitalPolicy {
+    std::string code;
+    double dso_days = 30.0;   ///< Days sales outstanding
+    double dpo_days = 30.0;   ///< Days payable outstanding
+    double dio_days = 30.0;   ///< Days inventory outstanding
+
+    /**
+     * @brief Active policies by code
+     * @throws database::DatabaseException if the table can't be read
+     * @throws std::invalid_argument for negative days
+     */
+    static std::map<std::string, WorkingCapitalPolicy> load(database::IDatabase& db);
+
+    /// Balance of days outstanding of a period flow
+    template <typename T>
+    static T balance(const T& flow, double days, double days_in_period) {
+        return flow * (days / days_in_period);
+    }
+
+    template <typename T>
+    T receivables(const T& revenue, double days_in_period) const {
+        return balance(revenue, dso_days, days_in_period);
+    }
+
+    template <typename T>
+    T payables(const T& cogs, double days_in_period) const {
+        return balance(cogs, dpo_days, days_in_period);
+    }
+
+    template <typename T>
+    T inventory(const T& cogs, double days_in_period) const {
+        return balance(cogs, dio_days, days_in_period);
+    }
+};
+
+} // namespace policy
+} // namespace finmodel
@@ -0,0 +1,76 @@
+/**
+ * @file loss_carryforward_tax_strategy.h
+ * @brief Flat rate tax with net operating losses carried forward
+ */
+
+#ifndef FINMODEL_TAX_LOSS_CARRYFORWARD_TAX_STRATEGY_H
+#define FINMODEL_TAX_LOSS_CARRYFORWARD_TAX_STRATEGY_H
+
+#include "pl/tax_strategy.h"
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace finmodel {
+namespace pl {
+
+/**
+ * @brief Loss carryforward tax strategy
+ *
+ * A period with a loss pays no tax and adds the loss to the scenario's
+ * NOL pool. A profitable period offsets up to utilisation_limit of its
+ * income with the pool (oldest losses first) and pays rate on the rest:
+ *
+ *   used = min(pool, utilisation_limit * income)
+ *   tax  = rate * (income - used)
+ *
+ * With expiry_periods > 0 a loss can be used in the expiry_periods
+ * periods after it and is dropped afterwards; the state then keeps a ring
+ * of one vintage per period. Each period is O(1) amortised: expiry drops
+ * one vintage, and a vintage is used up at most once.
+ *
+ * State: [pool] without expiry, [pool, oldest vintage, vintages...] with it.
+ */
+class LossCarryforwardTaxStrategy : public IStatefulTaxStrategy {
+public:
+    /**
+     * @brief Construct with the NOL rules
+     * @param rate Tax rate (e.g., 0.21 for 21%)
+     * @param expiry_periods Periods a loss can be carried forward (0: no expiry)
+     * @param utilisation_limit Share of a period's income losses can offset (e.g. 0.8)
+     * @throws std::invalid_argument unless utilisation_limit is in [0, 1]
+     */
+    explicit LossCarryforwardTaxStrategy(double rate, size_t expiry_periods = 0, double utilisation_limit = 1.0);
+
+    // IStatefulTaxStrategy interface
+    size_t state_size() const override;
+    void initial_state(std::span<double> state) const override;
+    double calculate_tax(double pre_tax_income, std::span<double> state) const override;
+    void calculate_tax_batch(
+        std::span<const double> pre_tax_income,
+        std::span<double> tax,
+        std::span<double> states
+    ) const override;
+    std::string name() const override;
+
+    /**
+     * @brief Losses available to later periods in a state
+     */
+    static double loss_pool(std::span<const double> state) { return state[0]; }
+
+private:
+    double rate_;
+    size_t expiry_;
+    double limit_;
+
+    /**
+     * @brief One period; value(i) is a reference to state value i
+     */
+    template <typename State>
+    double step(double pre_tax_income, State&& value) const;
+};
+
+} // namespace pl
+} // namespace finmodel
+
+#endif // FINMODEL_TAX_LOSS_CARRYFORWARD_TAX_STRATEGY_H
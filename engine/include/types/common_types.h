@@ -1,12 +1,14 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <optional>
 #include <variant>
 #include <memory>
 #include <chrono>
+#include <cstdint>
 
 namespace finmodel {
 
@@ -17,8 +19,21 @@ using ScenarioID = int;
 using PeriodID = int;
 using DriverID = int;
 
-// Parameter variant for database queries
-using ParamValue = std::variant<int, double, std::string, std::nullptr_t>;
+/**
+ * @brief Hash for string-keyed unordered maps that can be probed with std::string_view
+ *
+ * std::unordered_map<std::string, V, StringHash, std::equal_to<>> finds
+ * keys from a view (e.g. a column of a database row) without building a
+ * std::string first.
+ */
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+};
+
+// Parameter variant for database queries (Blob binds as a BLOB)
+using Blob = std::vector<std::uint8_t>;
+using ParamValue = std::variant<int, double, std::string, std::nullptr_t, Blob>;
 using ParamMap = std::map<std::string, ParamValue>;
 
 /**
@@ -0,0 +1,178 @@
+/**
+ * @file adjoint_tape.h
+ * @brief Reverse-mode (adjoint) derivatives of a run by every driver
+ *
+ * Forward-mode sensitivities (UnifiedEngine::set_sensitivity_drivers())
+ * cost one direction per driver. With thousands of per-asset drivers and
+ * a few outputs, reverse mode is cheaper: the engine records each
+ * period's local derivatives on a tape - for every line item, what it
+ * read (an earlier line item, a driver, a line item of an earlier period)
+ * and the partial derivative by it - and one reverse sweep from an output
+ * then yields its derivative by every driver at once.
+ *
+ * The tape holds periods in any number of segments: sweep() consumes the
+ * periods recorded so far, newest first, and keeps the adjoints that flow
+ * into earlier periods for the next segment. A long run can so be taped a
+ * few periods at a time from the end (PeriodRunner::gradient() recomputes
+ * each segment from a checkpoint) with memory bounded by the segment.
+ *
+ * Usage:
+ * @code
+ * AdjointTape tape(period_ids);
+ * engine.set_tape(&tape);
+ * for (PeriodID p : period_ids) { engine.calculate(...); }
+ * tape.seed(period_ids.back(), "NET_INCOME", 1.0);
+ * tape.sweep();
+ * double d = tape.driver_adjoint("REVENUE");   // d NET_INCOME / d REVENUE
+ * @endcode
+ */
+
+#ifndef FINMODEL_ADJOINT_TAPE_H
+#define FINMODEL_ADJOINT_TAPE_H
+
+#include "types/common_types.h"
+#include "unified/result_row.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Local derivatives of recorded periods and the adjoints swept from them
+ *
+ * A driver's adjoint is the derivative when the driver moves by the same
+ * amount in every period of the run (as in a bumped scenario).
+ */
+class AdjointTape {
+public:
+    /**
+     * @brief What a line item read, with the partial derivative by it
+     */
+    struct Edge {
+        enum class Kind : uint8_t {
+            STEP,     ///< Line item index of the same period (an earlier step)
+            DRIVER,   ///< driver_code(index)
+            PERIOD    ///< Line item code(index) of an earlier period
+        };
+        Kind kind = Kind::STEP;
+        uint32_t index = 0;
+        PeriodID period = 0;      ///< PERIOD only
+        double weight = 0.0;      ///< Partial derivative
+    };
+
+    /**
+     * @param period_ids Periods of the run, ascending ([t-1] reads the one before)
+     */
+    explicit AdjointTape(std::vector<PeriodID> period_ids);
+
+    /**
+     * @brief Period of the run before a period (the one its opening values come from)
+     * @return Nothing for the run's first period or a period not in the run
+     */
+    std::optional<PeriodID> previous(PeriodID period_id) const;
+
+    /**
+     * @brief Whether a period belongs to the run
+     */
+    bool in_run(PeriodID period_id) const { return period_index_.count(period_id) != 0; }
+
+    // ------------------------------------------------------------------
+    // Recording (UnifiedEngine)
+    // ------------------------------------------------------------------
+
+    /**
+     * @brief Start a period; steps are then added in calculation order
+     * @param schema Line items of the period (the result's schema)
+     *
+     * Recorded periods from period_id on are dropped (a period calculated again).
+     */
+    void begin_period(PeriodID period_id, std::shared_ptr<const ResultSchema> schema);
+
+    /**
+     * @brief Add what the next step of the current period read
+     */
+    void add_step(const std::vector<Edge>& edges);
+
+    uint32_t driver_id(const std::string& driver_code);
+    uint32_t code_id(const std::string& code);
+    const std::string& driver_code(uint32_t id) const { return drivers_[id]; }
+    const std::string& code(uint32_t id) const { return codes_[id]; }
+
+    // ------------------------------------------------------------------
+    // Reverse sweep
+    // ------------------------------------------------------------------
+
+    /**
+     * @brief Add to the adjoint of a line item (1.0 on an output to differentiate it)
+     */
+    void seed(PeriodID period_id, const std::string& code, double adjoint = 1.0);
+
+    /**
+     * @brief Propagate the adjoints through the recorded periods, newest first, and drop them
+     *
+     * Adjoints of earlier periods not recorded yet are kept for the next sweep.
+     */
+    void sweep();
+
+    /**
+     * @brief Adjoints of every driver a swept period read, by driver code
+     */
+    std::map<std::string, double> driver_adjoints() const;
+
+    /**
+     * @brief Adjoint of one driver (0 if no swept period read it)
+     */
+    double driver_adjoint(const std::string& driver_code) const;
+
+    /**
+     * @brief Periods recorded and not swept yet
+     */
+    size_t recorded_periods() const { return periods_.size(); }
+
+    /**
+     * @brief Bytes held by the recorded periods
+     */
+    size_t bytes() const;
+
+    /**
+     * @brief Largest bytes() since construction
+     */
+    size_t peak_bytes() const { return peak_bytes_; }
+
+private:
+    struct Period {
+        PeriodID period_id = 0;
+        std::shared_ptr<const ResultSchema> schema;
+        std::vector<uint32_t> codes;       ///< code_id() of each step
+        std::vector<uint32_t> offsets;     ///< Step i's edges: edges[offsets[i], offsets[i+1])
+        std::vector<Edge> edges;
+    };
+
+    std::vector<PeriodID> period_ids_;
+    std::unordered_map<PeriodID, size_t> period_index_;
+
+    std::vector<Period> periods_;          ///< Recorded, ascending
+
+    std::vector<std::string> drivers_;
+    std::unordered_map<std::string, uint32_t> driver_ids_;
+    std::vector<std::string> codes_;
+    std::unordered_map<std::string, uint32_t> code_ids_;
+
+    std::map<std::pair<PeriodID, uint32_t>, double> pending_;   ///< (period, code_id) → adjoint not swept yet
+    std::vector<double> driver_adjoints_;                        ///< By driver_id
+    std::vector<double> step_adjoints_;                          ///< Scratch for sweep()
+    size_t peak_bytes_ = 0;
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_ADJOINT_TAPE_H
@@ -0,0 +1,152 @@
+/**
+ * @file diagnostics.h
+ * @brief Compact warning records, rendered to text only when read
+ *
+ * A sweep whose warning rules fire in every period used to build one
+ * message string per rule per period, and copy it again into the run's
+ * results. A Diagnostic is a 32-byte record instead: the ID of a message
+ * in the process-wide DiagnosticCatalog, an optional line item Symbol, the
+ * period and scenario, and the numeric value the message shows. The
+ * catalog holds each distinct text once (a validation rule's message is
+ * interned when its rules are loaded); the value is formatted into it
+ * only by message().
+ *
+ * Diagnostics folds repeats: records with the same message, line item and
+ * scenario become one, counted, spanning their first and last period. A
+ * period's UnifiedResult keeps its warnings in one; run_periods() merges
+ * them into the run's (MultiPeriodResults::warnings), so a rule failing in
+ * all 120 periods of a run is one record with a count of 120.
+ *
+ * Usage:
+ * @code
+ * static const uint32_t low_cash = DiagnosticCatalog::intern("Cash below floor (value: ", ")");
+ * result.warnings.add(low_cash, cash);
+ * ...
+ * for (const std::string& message : results.warnings.messages()) std::cout << message << '\n';
+ * // "Period 3: Cash below floor (value: -12.5) (4 times, periods 3-6)"
+ * @endcode
+ */
+
+#ifndef FINMODEL_DIAGNOSTICS_H
+#define FINMODEL_DIAGNOSTICS_H
+
+#include "core/symbol_table.h"
+#include "types/common_types.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Process-wide, thread-safe table of diagnostic message texts
+ *
+ * Entry 0 is the empty message. Texts are never removed: intern messages
+ * from rules and code, not from values.
+ */
+class DiagnosticCatalog {
+public:
+    /**
+     * @brief ID of a message without a value
+     */
+    static uint32_t intern(std::string_view text);
+
+    /**
+     * @brief ID of a message showing a value: before, the value, after
+     */
+    static uint32_t intern(std::string_view before, std::string_view after);
+
+    /**
+     * @brief Text of a message (the value formatted as an ostream does; ignored without one)
+     * @throws std::out_of_range for an ID not in the catalog
+     */
+    static std::string render(uint32_t id, double value);
+};
+
+/**
+ * @brief One diagnostic, or several folded into one record
+ */
+struct Diagnostic {
+    static constexpr PeriodID NO_PERIOD = INT_MIN;
+
+    uint32_t code = 0;                          ///< DiagnosticCatalog ID
+    core::Symbol line_item = core::NO_SYMBOL;   ///< Line item it is about (NO_SYMBOL: none)
+    PeriodID period = NO_PERIOD;                ///< First period (NO_PERIOD: within one period's result)
+    PeriodID last_period = NO_PERIOD;
+    ScenarioID scenario = 0;
+    uint32_t count = 1;                         ///< Occurrences folded into the record
+    double value = std::numeric_limits<double>::quiet_NaN();   ///< Value of the first occurrence
+};
+
+/**
+ * @brief Deduplicated, counted diagnostics of a period or a run
+ *
+ * Records stay in first-occurrence order. Adding a diagnostic that folds
+ * into an existing record doesn't allocate.
+ */
+class Diagnostics {
+public:
+    /**
+     * @brief Add an occurrence of a catalog message
+     * @param value Value shown by the message (if it shows one)
+     */
+    void add(uint32_t code, double value = std::numeric_limits<double>::quiet_NaN(),
+             core::Symbol line_item = core::NO_SYMBOL);
+
+    /**
+     * @brief Add an occurrence of a message given as text (interned)
+     */
+    void add(std::string_view text);
+
+    /**
+     * @brief Add a record, folding it into one of the same message, line item and scenario
+     */
+    void add(const Diagnostic& diagnostic);
+
+    /**
+     * @brief Add another set's records, stamping those without a period
+     */
+    void merge(const Diagnostics& other, PeriodID period, ScenarioID scenario);
+
+    bool empty() const { return records_.empty(); }
+
+    /// Distinct records
+    size_t size() const { return records_.size(); }
+
+    /// Occurrences over all records
+    size_t occurrences() const;
+
+    const std::vector<Diagnostic>& records() const { return records_; }
+
+    void clear() { records_.clear(); }
+
+    /**
+     * @brief Text of a record: "Period P: " when it has one, the message,
+     *        then " (N times, periods P-Q)" when folded
+     */
+    std::string message(size_t index) const;
+
+    /// message() of every record
+    std::vector<std::string> messages() const;
+
+    /**
+     * @brief Diagnostics of rendered messages (e.g. read back from a result cache)
+     */
+    static Diagnostics from_messages(const std::vector<std::string>& messages);
+
+    /// Heap bytes held
+    size_t memory_bytes() const { return records_.capacity() * sizeof(Diagnostic); }
+
+private:
+    std::vector<Diagnostic> records_;
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_DIAGNOSTICS_H
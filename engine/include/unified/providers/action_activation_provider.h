@@ -0,0 +1,76 @@
+/**
+ * @file action_activation_provider.h
+ * @brief Per-period activation of management actions for parametric templates
+ */
+
+#ifndef FINMODEL_UNIFIED_ACTION_ACTIVATION_PROVIDER_H
+#define FINMODEL_UNIFIED_ACTION_ACTIVATION_PROVIDER_H
+
+#include "core/ivalue_provider.h"
+#include "core/context.h"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Value provider for "action:CODE" variables
+ *
+ * A parametric action template (actions::ActionEngine::parametric_patches())
+ * gates every transformation of an action by action:CODE, so one template
+ * and one compiled plan serve all periods; the runner publishes each
+ * period's activations here before calculating it. An action without an
+ * activation is inactive (0).
+ *
+ * Example usage:
+ * @code
+ * provider.set_activation({{"EFFICIENCY", 1.0}});   // action:EFFICIENCY = 1, all others 0
+ * @endcode
+ */
+class ActionActivationProvider : public core::IValueProvider {
+public:
+    /**
+     * @brief Replace the activations (action code → 0 inactive, 1 active)
+     */
+    void set_activation(const std::map<std::string, double>& activation);
+
+    /**
+     * @brief Deactivate every action
+     */
+    void clear();
+
+    bool has_value(const std::string& key) const override { return is_action_key(key); }
+    double get_value(const std::string& key, const core::Context& ctx) const override;
+
+    /**
+     * @brief Slot of an action key; every other key shares NONE, which never has a value
+     */
+    int resolve_slot(const std::string& key) override;
+    bool has_slot_value(int slot) const override { return slot > NONE; }
+    bool slot_can_have_value(int slot) const override { return slot > NONE; }
+    double get_slot_value(int slot, const core::Context& ctx [[maybe_unused]]) const override {
+        return values_[static_cast<size_t>(slot)];
+    }
+
+    /**
+     * @brief Whether a formula variable is an action activation ("action:CODE")
+     */
+    static bool is_action_key(const std::string& key) {
+        return key.size() > 7 && key.compare(0, 7, "action:") == 0;
+    }
+
+private:
+    static constexpr int NONE = 0;
+
+    std::unordered_map<std::string, int> slots_;   ///< Action code → slot
+    std::vector<double> values_ = {0.0};           ///< By slot (NONE first)
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_UNIFIED_ACTION_ACTIVATION_PROVIDER_H
@@ -0,0 +1,94 @@
+/**
+ * @file driver_pack.h
+ * @brief Packed scenario drivers: one periods × drivers matrix per (entity, scenario)
+ */
+
+#ifndef FINMODEL_UNIFIED_DRIVER_PACK_H
+#define FINMODEL_UNIFIED_DRIVER_PACK_H
+
+#include "database/idatabase.h"
+#include "types/common_types.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief The scenario_drivers rows of one (entity, scenario) as a dense matrix
+ *
+ * scenario_driver_pack (migration 013) keeps a pack as one row: its
+ * periods, a dictionary of (driver_code, unit_code) columns and a BLOB of
+ * periods × columns float64 values (period-major, host byte order, NaN
+ * where the key has no row). DriverValueProvider::prefetch() reads the
+ * pack of a key instead of its rows, one fetch per (entity, scenario) of
+ * the scenario chain instead of one row per (period, driver).
+ *
+ * scenario_drivers stays the table writers and per-period lookups use; a
+ * pack is a copy of it. The migration's triggers delete a key's pack on
+ * any insert, update or delete of its rows, so a pack is never stale:
+ * repack after bulk writes (e.g. PhysicalRiskEngine::generate_drivers()).
+ *
+ * Usage:
+ * @code
+ * DriverPack::pack_all(*db);                 // After loading a scenario set
+ * provider.prefetch("CORP", 2, period_ids);  // Reads the packs of CORP and PHYSICAL_RISK
+ * @endcode
+ */
+struct DriverPack {
+    EntityID entity_id;
+    ScenarioID scenario_id = 0;
+    std::vector<PeriodID> period_ids;       ///< Ascending
+    std::vector<std::string> driver_codes;  ///< By column
+    std::vector<std::string> unit_codes;    ///< By column
+    std::vector<double> values;             ///< period_ids × columns, period-major (NaN: no row)
+
+    size_t columns() const { return driver_codes.size(); }
+
+    double value(size_t period, size_t column) const { return values[period * columns() + column]; }
+
+    /**
+     * @brief Pack the scenario_drivers rows of a key (empty without rows)
+     *
+     * One column per (driver_code, unit_code); of duplicate rows for a
+     * column and period the last one inserted wins.
+     */
+    static DriverPack build(database::IDatabase& db, const EntityID& entity_id, ScenarioID scenario_id);
+
+    /**
+     * @brief Write a pack, replacing the stored pack of its key
+     * @throws std::invalid_argument if values doesn't match the periods and columns
+     */
+    static void store(database::IDatabase& db, const DriverPack& pack);
+
+    /**
+     * @brief build() and store() one key
+     * @return Values packed
+     */
+    static size_t pack(database::IDatabase& db, const EntityID& entity_id, ScenarioID scenario_id);
+
+    /**
+     * @brief pack() every (entity, scenario) of scenario_drivers, in one transaction
+     * @return Keys packed
+     */
+    static size_t pack_all(database::IDatabase& db);
+
+    /**
+     * @brief Stored packs of some entities in some scenarios (one query)
+     * @return Packs found, in no particular order
+     * @throws std::runtime_error for a pack whose BLOB doesn't match its dictionary
+     */
+    static std::vector<DriverPack> load(database::IDatabase& db, const std::vector<EntityID>& entity_ids,
+                                        const std::vector<ScenarioID>& scenario_ids);
+
+    /**
+     * @brief Whether the database has a scenario_driver_pack table
+     */
+    static bool available(database::IDatabase& db);
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_UNIFIED_DRIVER_PACK_H
@@ -9,11 +9,24 @@
 #include "core/ivalue_provider.h"
 #include "core/context.h"
 #include "core/unit_converter.h"
+#include "core/entity_dictionary.h"
+#include "core/statement_template.h"
 #include "database/idatabase.h"
+#include "unified/providers/driver_pack.h"
 #include "types/common_types.h"
+#include <cmath>
+#include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
 
 namespace finmodel {
 namespace unified {
@@ -25,6 +38,13 @@ namespace unified {
  * to the formula evaluator. Handles plain driver codes like "REVENUE"
  * when they appear as line items with no formula.
  *
+ * A scenario with a parent_scenario_id in the scenario table only stores
+ * the drivers it changes: its own scenario_drivers rows override the
+ * parent's (recursively up to the root scenario). Ancestor rows are read
+ * once per (entity, scenario, period) and shared by all children, so a
+ * sweep of variants costs one query per variant returning only its
+ * overrides.
+ *
  * Example usage:
  * @code
  * DriverValueProvider provider(db);
@@ -42,10 +62,12 @@ public:
      * @brief Construct driver value provider
      * @param db Database interface for querying scenario_drivers
      * @param unit_converter Unit converter for converting driver values to base units
+     * @param entities Entity IDs shared with the engine (null: the provider loads its own)
      */
     explicit DriverValueProvider(
         std::shared_ptr<database::IDatabase> db,
-        std::shared_ptr<core::UnitConverter> unit_converter = nullptr
+        std::shared_ptr<const core::UnitConverter> unit_converter = nullptr,
+        std::shared_ptr<core::EntityDictionary> entities = nullptr
     );
 
     /**
@@ -54,7 +76,17 @@ public:
      * @param scenario_id Scenario identifier
      * @param period_id Period identifier
      */
-    void set_context(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id);
+    void set_context(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id) {
+        set_context(entities_->intern(entity_id), scenario_id, period_id);
+    }
+
+    /**
+     * @brief Set context for driver lookups
+     * @param entity Entity ID from the provider's EntityDictionary
+     * @param scenario_id Scenario identifier
+     * @param period_id Period identifier
+     */
+    void set_context(int entity, ScenarioID scenario_id, PeriodID period_id);
 
     /**
      * @brief Load template mappings from base_value_source
@@ -65,6 +97,156 @@ public:
      */
     void load_template_mappings(const std::string& template_code);
 
+    /**
+     * @brief Load template mappings from an in-memory template
+     * @param tmpl Template (e.g. an action overlay that isn't in the database)
+     *
+     * Same mappings as load_template_mappings(tmpl.get_template_code()) for
+     * a template stored in the database, without the query and JSON parse.
+     * Also takes the template's flow drivers (see set_time_scaling()).
+     */
+    void load_template_mappings(const core::StatementTemplate& tmpl);
+
+    /**
+     * @brief Scale flow drivers by the current period's length
+     * @param scaling Flow drivers and their basis (disabled: no driver is scaled)
+     *
+     * A flow driver's value is then value * days_in_period / basis_days of
+     * the context's period, read from the period table. Reading a flow
+     * driver in a period the table doesn't have throws.
+     */
+    void set_time_scaling(const core::TimeScaling& scaling);
+
+    /**
+     * @brief Factor a key's driver is scaled by in the current period
+     * @return days_in_period / basis_days for a flow driver, else 1
+     * @throws std::runtime_error for a flow driver in a period without days_in_period
+     */
+    double time_scale(const std::string& key) const;
+
+    /**
+     * @brief Driver a formula key reads
+     * @param key "driver:OPEX", or a line item code mapped by base_value_source
+     * @return Driver code (a bare code without a mapping is its own driver)
+     */
+    std::string driver_code(const std::string& key) const;
+
+    /**
+     * @brief Load the current context's drivers now
+     *
+     * Drivers are otherwise loaded by the first lookup. Lookups after
+     * preload() only read, so they may run concurrently.
+     */
+    void preload() const;
+
+    /**
+     * @brief Load the drivers of several periods with one query
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario identifier (parent scenarios are resolved as in set_context())
+     * @param period_ids Periods of the run
+     *
+     * Rows are converted to base units once and kept as a periods × drivers
+     * matrix; set_context() for one of these periods then only selects a
+     * row. Other contexts still query per period. The matrix is kept until
+     * the next prefetch() or clear_driver_cache().
+     *
+     * An (entity, scenario) with a DriverPack is read from its pack, the
+     * others from their scenario_drivers rows.
+     */
+    void prefetch(const EntityID& entity_id, ScenarioID scenario_id, const std::vector<PeriodID>& period_ids) {
+        prefetch(entities_->intern(entity_id), scenario_id, period_ids);
+    }
+
+    /**
+     * @brief Load the drivers of several periods with one query
+     * @param entity Entity ID from the provider's EntityDictionary
+     */
+    void prefetch(int entity, ScenarioID scenario_id, const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Load the drivers of several entities and periods with one query
+     * @param entities Entity IDs from the provider's EntityDictionary
+     * @param scenario_id Scenario of every entity
+     * @param period_ids Periods of the run
+     *
+     * One periods × drivers matrix per entity, as prefetch() of each;
+     * set_context() for any of them then only selects a row. Used by
+     * entity lanes (UnifiedEngine::calculate_entity_lanes()).
+     */
+    void prefetch(const std::vector<int>& entities, ScenarioID scenario_id, const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief scenario_drivers rows of a run, read ahead by fetch_rows()
+     *
+     * Keys of the chain with a DriverPack come as packs (shared between the
+     * entities of a multi-entity prefetch for PHYSICAL_RISK), without rows.
+     */
+    struct DriverRows {
+        struct Row {
+            ScenarioID scenario_id;
+            PeriodID period_id;
+            std::string driver_code;
+            double value;
+            std::string unit_code;
+        };
+
+        EntityID entity_id;
+        ScenarioID scenario_id = 0;
+        std::vector<ScenarioID> chain;   ///< Ancestors root first, then scenario_id
+        std::vector<Row> rows;
+        std::vector<std::shared_ptr<const DriverPack>> packs;
+    };
+
+    /**
+     * @brief Read the rows a prefetch() of a run needs
+     * @param db Connection to read from (only used during the call)
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario identifier
+     * @param period_ids Periods of the run
+     *
+     * Touches no provider, so it can run on another thread and connection
+     * while a provider calculates (see PeriodRunner::set_prefetch()).
+     */
+    static DriverRows fetch_rows(database::IDatabase& db, const EntityID& entity_id, ScenarioID scenario_id,
+                                 const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief prefetch() from rows read earlier by fetch_rows()
+     * @param rows Rows of the run
+     * @param period_ids Periods of the run (as passed to fetch_rows())
+     *
+     * Only converts units and builds the matrix; no query.
+     */
+    void prefetch(const DriverRows& rows, const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Forget prefetched drivers, cached scenario parents and ancestor driver values
+     *
+     * Call after changing scenario_drivers of a parent scenario or the
+     * scenario table; a scenario's own rows are otherwise read fresh
+     * unless they were prefetched.
+     */
+    void clear_driver_cache();
+
+    /**
+     * @brief Convert units with another converter from now on (e.g. a new core::ReferenceData)
+     *
+     * Forgets prefetched and cached drivers, which were converted with the old one.
+     */
+    void set_unit_converter(std::shared_ptr<const core::UnitConverter> unit_converter);
+
+    /// Builds the unit converter when a driver first needs one
+    using UnitConverterLoader = std::function<std::shared_ptr<const core::UnitConverter>()>;
+
+    /**
+     * @brief Build the converter on first use instead of up front
+     *
+     * A run whose drivers are never converted (or an engine that never
+     * runs) doesn't read unit_definition and fx_rate. A loader that throws
+     * is called again by the next conversion.
+     */
+    void set_unit_converter_loader(UnitConverterLoader loader);
+
     /**
      * @brief Check if provider can resolve a driver code
      * @param key Driver code (e.g., "REVENUE", "COGS")
@@ -81,25 +263,233 @@ public:
      */
     double get_value(const std::string& key, const core::Context& ctx) const override;
 
+    /**
+     * @brief get_value() without an exception for a missing driver or period length
+     */
+    std::optional<double> find_value(const std::string& key, const core::Context& ctx) const override;
+
+    /**
+     * @brief Resolve key ("driver:XXX" or mapped line item code) to a slot
+     * @param key Driver key as used in formulas
+     * @return Slot index (stable for provider lifetime)
+     *
+     * Line item keys are re-resolved to their driver whenever template
+     * mappings are reloaded, so a slot stays valid across templates.
+     */
+    int resolve_slot(const std::string& key) override;
+
+    /**
+     * @brief Check if the driver behind a slot exists in current context
+     */
+    bool has_slot_value(int slot) const override;
+
+    /**
+     * @brief False for line item keys without a driver mapping in the current template
+     */
+    bool slot_can_have_value(int slot) const override {
+        return key_driver_[slot] != NO_SLOT;
+    }
+
+    /**
+     * @brief Get driver value behind a slot
+     * @throws std::runtime_error if driver not found
+     */
+    double get_slot_value(int slot, const core::Context& ctx) const override;
+
+    /**
+     * @brief get_slot_value() without an exception for a missing driver or period length
+     */
+    std::optional<double> find_slot_value(int slot, const core::Context& ctx) const override;
+
 private:
     std::shared_ptr<database::IDatabase> db_;
-    std::shared_ptr<core::UnitConverter> unit_converter_;
-    EntityID entity_id_;
+    mutable std::shared_ptr<const core::UnitConverter> unit_converter_;
+    mutable UnitConverterLoader unit_loader_;   ///< Until the converter is built (set_unit_converter_loader())
+    std::shared_ptr<core::EntityDictionary> entities_;
+    int entity_ = core::EntityDictionary::NO_ENTITY;
     ScenarioID scenario_id_;
     PeriodID period_id_;
 
-    // Cache: driver_code → value (in base units)
-    mutable std::map<std::string, double> driver_cache_;
+    // Cache: driver slot → value (in base units); driver_index_ maps driver_code → slot
+    mutable std::unordered_map<std::string, int, StringHash, std::equal_to<>> driver_index_;
+    mutable std::vector<std::string> driver_codes_;
+    mutable std::vector<double> driver_values_;
+    mutable std::vector<uint8_t> driver_present_;
+    mutable std::vector<uint8_t> driver_flow_;   ///< By driver slot: scaled by period_scale_
     mutable bool cache_loaded_;
 
+    // Time scaling: days_in_period / basis_days of the context's period (NaN: not in the period table)
+    double basis_days_ = 0.0;
+    double period_scale_ = 1.0;
+    std::unordered_map<PeriodID, int> period_days_;
+
+    // Sparse driver rows of one scenario: (driver slot, value in base units)
+    using DriverLayer = std::vector<std::pair<int, double>>;
+
+    // Inheritance: scenario → parent (nullopt for root scenarios), and
+    // ancestor rows by (entity, scenario, period), shared between children
+    mutable std::map<ScenarioID, std::optional<ScenarioID>> scenario_parents_;
+    mutable std::map<std::tuple<int, ScenarioID, PeriodID>, std::shared_ptr<const DriverLayer>> ancestor_layers_;
+
+    // Run-level prefetch: per entity, one row of width drivers per period
+    struct PrefetchBlock {
+        size_t width = 0;
+        std::vector<double> values;
+        std::vector<uint8_t> present;
+    };
+    ScenarioID prefetch_scenario_ = 0;
+    std::unordered_map<PeriodID, size_t> prefetch_rows_;     ///< Same rows in every block
+    std::unordered_map<int, PrefetchBlock> prefetch_blocks_;  ///< By entity
+
+    // Current context's drivers: a prefetched row, or driver_values_ / driver_present_
+    mutable const double* row_values_ = nullptr;
+    mutable const uint8_t* row_present_ = nullptr;
+    mutable size_t row_width_ = 0;
+    bool row_prefetched_ = false;
+
     // Mapping: line_item_code → driver_code (from base_value_source)
     std::map<std::string, std::string> line_item_to_driver_map_;
 
+    // Key slots: formula key → driver slot (NO_SLOT if key has no driver mapping)
+    std::unordered_map<std::string, int> key_index_;
+    std::vector<std::string> key_codes_;
+    std::vector<int> key_driver_;
+
+    /**
+     * @brief Get or create driver slot for a driver code
+     */
+    int driver_slot(std::string_view driver_code) const;
+
+    /**
+     * @brief Map a formula key to its driver slot under current mappings
+     * @return Driver slot, or NO_SLOT if key is a bare code without mapping
+     */
+    int key_to_driver_slot(const std::string& key) const;
+
+    /**
+     * @brief Find driver slot for key without creating slots
+     * @return Driver slot, or NO_SLOT if unknown
+     */
+    int find_driver_slot(const std::string& key) const;
+
     /**
      * @brief Load all drivers for current context into cache
      */
     void load_drivers() const;
 
+    /**
+     * @brief Recompute period_scale_ for the context's period (reads the period table once)
+     */
+    void update_period_scale();
+
+    /// flow_scale() without the check: NaN for a flow driver in a period without days_in_period
+    double scale_of(int driver) const {
+        return driver_flow_[driver] ? period_scale_ : 1.0;
+    }
+
+    /**
+     * @brief Value of a driver of the current row (nothing if absent or unscalable)
+     */
+    std::optional<double> find_driver(int driver) const {
+        if (!row_has(driver)) {
+            return std::nullopt;
+        }
+        const double scale = scale_of(driver);
+        if (std::isnan(scale)) {
+            return std::nullopt;
+        }
+        return row_values_[driver] * scale;
+    }
+
+    double flow_scale(int driver) const {
+        if (!driver_flow_[driver]) {
+            return 1.0;
+        }
+        if (std::isnan(period_scale_)) {
+            throw std::runtime_error("DriverValueProvider: period " + std::to_string(period_id_) +
+                                     " has no days_in_period to scale flow driver " + driver_codes_[driver]);
+        }
+        return period_scale_;
+    }
+
+    /**
+     * @brief Point the current row at driver_values_ / driver_present_
+     */
+    void use_loaded_row() const;
+
+    /**
+     * @brief Check if a driver slot has a value in the current row
+     */
+    bool row_has(int driver) const {
+        return driver != NO_SLOT && static_cast<size_t>(driver) < row_width_ && row_present_[driver];
+    }
+
+    /**
+     * @brief The unit converter, built by the loader if it wasn't yet (null: none)
+     */
+    const core::UnitConverter* units() const;
+
+    /**
+     * @brief Convert a driver value to base units (unconverted if the unit is unknown)
+     */
+    double to_base_unit(double value, std::string_view unit_code, std::string_view driver_code,
+                        PeriodID period_id) const;
+
+    /**
+     * @brief Code of the current entity, as stored in scenario_drivers
+     */
+    const EntityID& entity_code() const;
+
+    /**
+     * @brief Query one scenario's own driver rows for the current entity and period
+     */
+    DriverLayer query_layer(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Ancestors of a scenario, root first (empty without a scenario table)
+     */
+    std::vector<ScenarioID> ancestors(ScenarioID scenario_id) const;
+
+    /**
+     * @brief Parent of a scenario from the scenario table (none without one)
+     */
+    static std::optional<ScenarioID> query_parent(database::IDatabase& db, ScenarioID scenario_id);
+
+    /**
+     * @brief Ancestors of a scenario, root first, stopping at a parent cycle
+     */
+    template <typename ParentOf>
+    static std::vector<ScenarioID> ancestor_chain(ScenarioID scenario_id, ParentOf parent_of);
+
+    /**
+     * @brief Append the scenario_drivers rows of a chain's scenarios in a period range
+     */
+    static void query_rows(database::IDatabase& db, const std::vector<PeriodID>& period_ids, DriverRows& out);
+
+    /**
+     * @brief query_rows() of several entities with one chain (chunked IN lists)
+     *
+     * PHYSICAL_RISK rows are appended to every entity's rows. Keys with a
+     * DriverPack are loaded first and left out of the row query.
+     */
+    static void query_rows(database::IDatabase& db, const std::vector<PeriodID>& period_ids,
+                           std::vector<DriverRows>& out);
+
+    /**
+     * @brief Drop prefetched blocks, keeping rows for a new prefetch of these periods
+     */
+    void reset_prefetch(const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Convert a run's rows to base units into an entity's prefetch block
+     */
+    void build_block(const DriverRows& fetched, PrefetchBlock& block);
+
+    /**
+     * @brief Re-point bound line item keys at their drivers after a mapping change
+     */
+    void remap_keys();
+
     /**
      * @brief Resolve line item code to driver code using mapping
      * @param line_item_code Line item code from template
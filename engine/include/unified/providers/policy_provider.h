@@ -0,0 +1,186 @@
+/**
+ * @file policy_provider.h
+ * @brief Working capital and capex policies for templates
+ */
+
+#ifndef FINMODEL_UNIFIED_POLICY_PROVIDER_H
+#define FINMODEL_UNIFIED_POLICY_PROVIDER_H
+
+#include "core/ivalue_provider.h"
+#include "core/context.h"
+#include "core/lane_evaluator.h"
+#include "database/idatabase.h"
+#include "policy/capex_policy.h"
+#include "policy/wc_policy.h"
+#include "types/common_types.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Value provider for "policy:NAME" variables
+ *
+ * Reads wc_policy and capex_policy once and serves the selected policies
+ * (both "DEFAULT" unless select() picks others), so a template writes
+ *
+ *     ACCOUNTS_RECEIVABLE = REVENUE * policy:DSO_FACTOR
+ *     DEPRECIATION        = policy:DEPRECIATION
+ *
+ * instead of days arithmetic and a chain of [t-k] terms. Names:
+ *
+ * - DSO_DAYS, DPO_DAYS, DIO_DAYS: days of the working capital policy
+ * - DSO_FACTOR, DPO_FACTOR, DIO_FACTOR: days / days_in_period of the
+ *   period (policy::WorkingCapitalPolicy::balance())
+ * - DEPRECIATION: straight-line D&A of the CAPEX line item of earlier
+ *   periods of the run (policy::VintageSchedule over the policy's
+ *   useful_life_periods)
+ * - USEFUL_LIFE: useful_life_periods
+ * - CAPEX: capex of a fixed or depreciation_pct policy
+ * - CAPEX_RATE: revenue_pct of a revenue_pct policy (CAPEX = REVENUE * policy:CAPEX_RATE)
+ *
+ * The engine records each calculated period's CAPEX (record(),
+ * record_lanes()); vintages are kept per entity and scenario, and per lane
+ * run for lane calculations, where every lane has its own vintages in one
+ * array. A run going back to an earlier period starts its vintages over.
+ * Names a policy doesn't have (no tables, or CAPEX under revenue_pct)
+ * have no value.
+ *
+ * Example usage:
+ * @code
+ * provider.select("LEAN", "GROWTH");
+ * @endcode
+ */
+class PolicyProvider : public core::IValueProvider {
+public:
+    /// Line item whose values are the capex vintages
+    static constexpr const char* CAPEX_LINE_ITEM = "CAPEX";
+
+    /**
+     * @brief Read the policies and period lengths (none without the tables)
+     * @throws std::invalid_argument for an invalid policy row
+     */
+    explicit PolicyProvider(std::shared_ptr<database::IDatabase> db);
+
+    /**
+     * @brief Read the tables again (keeps the selected codes if they still exist)
+     * @throws std::invalid_argument for an invalid policy row
+     */
+    void reload();
+
+    /**
+     * @brief Choose the policies templates read
+     * @throws std::out_of_range for a code without an active row
+     */
+    void select(const std::string& wc_code, const std::string& capex_code);
+
+    const policy::WorkingCapitalPolicy* working_capital() const { return wc_ ? &*wc_ : nullptr; }
+    const policy::CapexPolicy* capex() const { return capex_ ? &*capex_ : nullptr; }
+
+    /**
+     * @brief Period about to be calculated: reads the period table again if it hasn't the period's days
+     *
+     * Lookups only read the days read here or by reload(), so threads
+     * calculating a period's steps can share the provider.
+     */
+    void set_period(PeriodID period_id);
+
+    /**
+     * @brief Close a period of a run: its CAPEX becomes the newest vintage
+     */
+    void record(int entity_id, ScenarioID scenario_id, PeriodID period_id, double capex);
+
+    /**
+     * @brief record() for every lane of a lane run (lane_run())
+     */
+    void record_lanes(size_t run, PeriodID period_id, const core::LaneArray& capex);
+
+    /**
+     * @brief Key of a lane run's vintages: its entities and scenarios
+     */
+    static size_t lane_run(const std::vector<int>& entities, const std::vector<ScenarioID>& scenario_ids,
+                           size_t lanes);
+
+    /**
+     * @brief Every lane's value of a policy key in a lane run
+     * @return False if the key has no value
+     */
+    bool lane_values(const std::string& key, size_t run, PeriodID period_id, size_t lanes,
+                     core::LaneArray& out);
+
+    /**
+     * @brief Forget all vintages (a new run)
+     */
+    void clear_history();
+
+    bool has_value(const std::string& key) const override;
+    double get_value(const std::string& key, const core::Context& ctx) const override;
+    std::optional<double> find_value(const std::string& key, const core::Context& ctx) const override;
+
+    int resolve_slot(const std::string& key) override;
+    bool has_slot_value(int slot) const override;
+    bool slot_can_have_value(int slot) const override { return slot > NONE; }
+    double get_slot_value(int slot, const core::Context& ctx) const override;
+    std::optional<double> find_slot_value(int slot, const core::Context& ctx) const override;
+
+    /**
+     * @brief Whether a formula variable is a policy value ("policy:NAME")
+     */
+    static bool is_policy_key(const std::string& key) {
+        return key.size() > 7 && key.compare(0, 7, "policy:") == 0;
+    }
+
+private:
+    enum Field : int {
+        NONE = 0,
+        DSO_DAYS, DPO_DAYS, DIO_DAYS,
+        DSO_FACTOR, DPO_FACTOR, DIO_FACTOR,
+        DEPRECIATION, USEFUL_LIFE, CAPEX, CAPEX_RATE
+    };
+
+    struct Vintages {
+        policy::VintageSchedule<double> schedule;
+        PeriodID last = 0;
+    };
+
+    struct LaneVintages {
+        policy::VintageSchedule<core::LaneArray> schedule;
+        PeriodID last = 0;
+    };
+
+    static int field_of(const std::string& key);
+
+    /// Read days_in_period of every period (none without the table)
+    void read_periods();
+
+    /// days_in_period of a period (nothing if the period table didn't have it when read)
+    std::optional<double> period_days(PeriodID period_id) const;
+
+    /// days / days_in_period of a period
+    /// @throws std::runtime_error without days_in_period
+    double period_share(double days, PeriodID period_id) const;
+
+    /// Value of a field that doesn't depend on the run
+    double policy_value(int field, PeriodID period_id) const;
+
+    std::shared_ptr<database::IDatabase> db_;
+    std::map<std::string, policy::WorkingCapitalPolicy> wc_policies_;
+    std::map<std::string, policy::CapexPolicy> capex_policies_;
+    std::optional<policy::WorkingCapitalPolicy> wc_;   ///< Selected
+    std::optional<policy::CapexPolicy> capex_;         ///< Selected
+    std::unordered_map<PeriodID, double> period_days_;
+
+    std::map<std::pair<int, ScenarioID>, Vintages> runs_;
+    std::unordered_map<size_t, LaneVintages> lane_runs_;
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_UNIFIED_POLICY_PROVIDER_H
@@ -0,0 +1,83 @@
+/**
+ * @file scope3_provider.h
+ * @brief Spend-based Scope 3 emissions for templates
+ */
+
+#ifndef FINMODEL_UNIFIED_SCOPE3_PROVIDER_H
+#define FINMODEL_UNIFIED_SCOPE3_PROVIDER_H
+
+#include "core/ivalue_provider.h"
+#include "core/context.h"
+#include "core/entity_dictionary.h"
+#include "carbon/eeio_model.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Value provider for "scope3:CATEGORY" variables
+ *
+ * Serves the Scope 3 emissions a carbon::EEIOModel evaluated for the
+ * calculated entity, scenario and period, e.g. SCOPE3_UPSTREAM =
+ * scope3:UPSTREAM. A context or category without spend reads 0, like an
+ * inactive action.
+ *
+ * Example usage:
+ * @code
+ * provider.set_results(std::make_shared<const carbon::Scope3Results>(model.evaluate(*db)));
+ * @endcode
+ */
+class Scope3Provider : public core::IValueProvider {
+public:
+    /**
+     * @param entities Entity IDs of the contexts (shared with the other providers)
+     */
+    explicit Scope3Provider(std::shared_ptr<core::EntityDictionary> entities);
+
+    /**
+     * @brief Replace the emissions (null: none, every key reads 0)
+     */
+    void set_results(std::shared_ptr<const carbon::Scope3Results> results);
+
+    bool has_value(const std::string& key) const override { return is_scope3_key(key); }
+    double get_value(const std::string& key, const core::Context& ctx) const override;
+
+    /**
+     * @brief Slot of a scope3 key; every other key shares NONE, which never has a value
+     */
+    int resolve_slot(const std::string& key) override;
+    bool has_slot_value(int slot) const override { return slot > NONE; }
+    bool slot_can_have_value(int slot) const override { return slot > NONE; }
+    double get_slot_value(int slot, const core::Context& ctx) const override;
+
+    /**
+     * @brief Whether a formula variable is a Scope 3 category ("scope3:CATEGORY")
+     */
+    static bool is_scope3_key(const std::string& key) {
+        return key.size() > 7 && key.compare(0, 7, "scope3:") == 0;
+    }
+
+private:
+    static constexpr int NONE = 0;
+
+    void bind_slot(size_t slot);
+
+    std::shared_ptr<core::EntityDictionary> entities_;
+    std::shared_ptr<const carbon::Scope3Results> results_;
+    std::map<std::tuple<int, ScenarioID, PeriodID>, size_t> rows_;   ///< (entity ID, scenario, period) → results row
+
+    std::unordered_map<std::string, int> slots_;   ///< Category → slot
+    std::vector<std::string> categories_ = {""};   ///< By slot (NONE first)
+    std::vector<int> columns_ = {-1};              ///< By slot: category in the results (-1: none)
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_UNIFIED_SCOPE3_PROVIDER_H
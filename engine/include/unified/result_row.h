@@ -0,0 +1,215 @@
+/**
+ * @file result_row.h
+ * @brief Dense storage for calculated line item values
+ *
+ * A template's line items are fixed once its calculation plan is built, so
+ * results don't need a tree of (code, value) nodes per period: every
+ * result of a template shares one immutable ResultSchema (code → index)
+ * and keeps its values in one contiguous vector.
+ *
+ * Example:
+ * @code
+ * auto schema = std::make_shared<const ResultSchema>(
+ *     std::vector<std::string>{"REVENUE", "COGS", "GROSS_PROFIT"});
+ * ResultRow row(schema, {1000.0, 600.0, 400.0});
+ *
+ * double gp = row.at("GROSS_PROFIT");          // 400.0
+ * for (const auto& [code, value] : row) { ... } // Calculation order
+ * @endcode
+ */
+
+#ifndef FINMODEL_RESULT_ROW_H
+#define FINMODEL_RESULT_ROW_H
+
+#include "core/symbol_table.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace finmodel {
+namespace unified {
+
+/**
+ * @brief Immutable line item code → index mapping, shared by all results of a template
+ *
+ * Each line item also has its Symbol in the global core::SymbolTable:
+ * find(Symbol) and symbols() compare integers instead of hashing text.
+ */
+class ResultSchema {
+public:
+    /// Returned by find() for codes not in the schema
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+    /**
+     * @brief Build a schema
+     * @param codes Line item codes in calculation order (unique)
+     * @throws std::invalid_argument on duplicate codes
+     */
+    explicit ResultSchema(std::vector<std::string> codes);
+
+    /**
+     * @brief Number of line items
+     */
+    size_t size() const { return codes_.size(); }
+
+    /**
+     * @brief Code of the line item at index
+     */
+    const std::string& code(uint32_t index) const { return codes_[index]; }
+
+    /**
+     * @brief Symbol of the line item at index
+     */
+    core::Symbol symbol(uint32_t index) const { return symbols_[index]; }
+
+    /**
+     * @brief All codes in calculation order
+     */
+    const std::vector<std::string>& codes() const { return codes_; }
+
+    /**
+     * @brief All Symbols in calculation order (equal for schemas with equal codes)
+     */
+    const std::vector<core::Symbol>& symbols() const { return symbols_; }
+
+    /**
+     * @brief Look up a line item index
+     * @param code Line item code
+     * @return Index, or NO_INDEX if the template has no such line item
+     */
+    uint32_t find(const std::string& code) const;
+
+    /**
+     * @brief Look up a line item index by Symbol
+     * @return Index, or NO_INDEX if the template has no such line item
+     */
+    uint32_t find(core::Symbol symbol) const;
+
+private:
+    std::vector<std::string> codes_;
+    std::vector<core::Symbol> symbols_;
+    std::unordered_map<std::string_view, uint32_t> index_;   ///< Views into codes_
+    std::unordered_map<core::Symbol, uint32_t> symbol_index_;
+};
+
+/**
+ * @brief Calculated values of one period, stored densely against a shared schema
+ *
+ * Holds values for the first size() line items of the schema: a failed
+ * calculation keeps the line items calculated before the error.
+ * Iteration yields (code, value) pairs in calculation order.
+ */
+class ResultRow {
+public:
+    /**
+     * @brief Iterator over (code, value) pairs
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const std::string&, double>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+        using pointer = void;
+
+        const_iterator() = default;
+        const_iterator(const ResultRow* row, uint32_t index) : row_(row), index_(index) {}
+
+        reference operator*() const { return {row_->schema_->code(index_), row_->values_[index_]}; }
+        const_iterator& operator++() { ++index_; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++index_; return old; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        const ResultRow* row_ = nullptr;
+        uint32_t index_ = 0;
+    };
+
+    /**
+     * @brief Empty row (no line items)
+     */
+    ResultRow() = default;
+
+    /**
+     * @brief Row over a schema
+     * @param schema Shared schema
+     * @param values Values of the first values.size() line items of the schema
+     * @throws std::invalid_argument if there are more values than line items
+     */
+    ResultRow(std::shared_ptr<const ResultSchema> schema, std::vector<double> values);
+
+    /**
+     * @brief Schema the values are stored against (null for an empty row)
+     */
+    const std::shared_ptr<const ResultSchema>& schema() const { return schema_; }
+
+    /**
+     * @brief Values in schema order
+     */
+    const std::vector<double>& values() const { return values_; }
+
+    /**
+     * @brief Number of line items with a value
+     */
+    size_t size() const { return values_.size(); }
+
+    /**
+     * @brief Check if the row has no values
+     */
+    bool empty() const { return values_.empty(); }
+
+    /**
+     * @brief Get a pointer to a line item's value
+     * @param code Line item code
+     * @return Pointer into the row, or nullptr if the line item has no value
+     */
+    const double* find(const std::string& code) const;
+    const double* find(core::Symbol symbol) const;
+
+    /**
+     * @brief Check if a line item has a value
+     */
+    bool contains(const std::string& code) const { return find(code) != nullptr; }
+
+    /**
+     * @brief Get a line item's value
+     * @throws std::out_of_range if the line item has no value
+     */
+    double at(const std::string& code) const;
+
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, static_cast<uint32_t>(values_.size())}; }
+
+    /**
+     * @brief Copy into a code → value map
+     */
+    std::map<std::string, double> to_map() const;
+
+    /**
+     * @brief Make a code → value map hold this row (reusing its nodes where codes match)
+     */
+    void assign_to(std::map<std::string, double>& values) const;
+
+    /**
+     * @brief Same line items with the same values (schemas may be different objects)
+     */
+    bool operator==(const ResultRow& other) const;
+    bool operator!=(const ResultRow& other) const { return !(*this == other); }
+
+private:
+    std::shared_ptr<const ResultSchema> schema_;
+    std::vector<double> values_;
+};
+
+} // namespace unified
+} // namespace finmodel
+
+#endif // FINMODEL_RESULT_ROW_H
@@ -37,27 +37,71 @@
 
 #include "database/idatabase.h"
 #include "core/formula_evaluator.h"
+#include "core/formula_binding.h"
+#include "core/arena.h"
+#include "core/profiler.h"
+#include "core/formula_optimizer.h"
+#include "core/lane_evaluator.h"
+#include "core/tangent_evaluator.h"
+#include "core/native_kernel.h"
+#include "core/thread_pool.h"
+#include "core/entity_dictionary.h"
+#include "core/reference_data.h"
 #include "core/statement_template.h"
 #include "core/ivalue_provider.h"
 #include "types/common_types.h"
-#include "pl/providers/pl_value_provider.h"
+#include "pl/tax_strategy.h"
 #include "bs/providers/statement_value_provider.h"
-#include "cf/providers/cf_value_provider.h"
 #include "unified/providers/driver_value_provider.h"
+#include "unified/providers/action_activation_provider.h"
+#include "unified/providers/scope3_provider.h"
+#include "unified/providers/policy_provider.h"
 #include "unified/validation_rule_engine.h"
+#include "unified/diagnostics.h"
+#include "unified/result_row.h"
+#include "unified/adjoint_tape.h"
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <map>
+#include <tuple>
+#include <unordered_map>
 
 namespace finmodel {
 namespace unified {
 
+/**
+ * @brief Derivatives of one period's line items by a set of drivers (UnifiedEngine::set_sensitivity_drivers())
+ */
+struct Sensitivities {
+    std::shared_ptr<const std::vector<std::string>> drivers;  ///< Driver codes, one direction each
+    std::shared_ptr<const ResultSchema> schema;               ///< Line item codes in calculation order
+    std::vector<core::LaneArray> tangents;                    ///< tangents[i][d]: d schema->code(i) / d drivers[d]
+
+    bool empty() const { return tangents.empty(); }
+
+    /**
+     * @brief Derivatives of a line item by every driver
+     * @return Null if the line item wasn't calculated
+     */
+    const core::LaneArray* find(const std::string& code) const;
+
+    /**
+     * @brief Derivative of a line item by a driver
+     * @throws std::out_of_range for a line item or driver not in the sensitivities
+     */
+    double get(const std::string& code, const std::string& driver) const;
+};
+
 /**
  * @brief Result of unified calculation containing all line items
  */
 struct UnifiedResult {
-    /// All calculated line items (code → value)
-    std::map<std::string, double> line_items;
+    /// All calculated line items (code → value, in calculation order)
+    ResultRow line_items;
 
     /// Success flag
     bool success = true;
@@ -65,8 +109,11 @@ struct UnifiedResult {
     /// Error messages
     std::vector<std::string> errors;
 
-    /// Warning messages
-    std::vector<std::string> warnings;
+    /// Warnings, as catalog records (Diagnostics::messages() renders them)
+    Diagnostics warnings;
+
+    /// Derivatives by the sensitivity drivers (empty unless UnifiedEngine::set_sensitivity_drivers())
+    Sensitivities sensitivities;
 
     /**
      * @brief Get value for a line item
@@ -74,8 +121,8 @@ struct UnifiedResult {
      * @return Value, or 0.0 if not found
      */
     double get_value(const std::string& code) const {
-        auto it = line_items.find(code);
-        return (it != line_items.end()) ? it->second : 0.0;
+        const double* value = line_items.find(code);
+        return value ? *value : 0.0;
     }
 
     /**
@@ -84,7 +131,7 @@ struct UnifiedResult {
      * @return True if line item was calculated
      */
     bool has_value(const std::string& code) const {
-        return line_items.find(code) != line_items.end();
+        return line_items.contains(code);
     }
 
     /**
@@ -99,6 +146,14 @@ struct UnifiedResult {
      */
     BalanceSheet extract_balance_sheet() const;
 
+    /**
+     * @brief Extract Balance Sheet result into an existing one
+     *
+     * Reuses the map nodes of codes bs already has, so rolling a balance
+     * sheet forward period after period allocates nothing.
+     */
+    void extract_balance_sheet(BalanceSheet& bs) const;
+
     /**
      * @brief Extract Cash Flow result
      * @return Cash Flow statement structure
@@ -113,15 +168,69 @@ struct UnifiedResult {
 
     /**
      * @brief Get all line item values (all statements)
-     * @return Map of all line item codes → values
+     * @return View of all line item codes → values (no copy)
      *
      * Used by PeriodRunner to roll forward ALL values (not just BS) for [t-1] references.
+     * Prefer this over the extract_*() methods, which copy every line item into
+     * a statement structure.
      */
-    const std::map<std::string, double>& get_all_values() const {
+    const ResultRow& get_all_values() const {
         return line_items;
     }
 };
 
+/// Line item or driver code → one value per lane
+using LaneValues = std::unordered_map<std::string, core::LaneArray>;
+
+/**
+ * @brief One period's line items for every lane (UnifiedEngine::calculate_lane_values())
+ */
+struct LaneResult {
+    std::shared_ptr<const ResultSchema> schema;   ///< Line item codes in calculation order
+    std::vector<core::LaneArray> values;          ///< values[i]: lanes of schema->code(i)
+
+    /**
+     * @brief Lane values of a line item
+     * @return Null if the line item wasn't calculated
+     */
+    const core::LaneArray* find(const std::string& code) const;
+};
+
+/**
+ * @brief What calculated the last lane run (UnifiedEngine::last_lane_backend())
+ */
+enum class LaneBackend {
+    INTERPRETER,        ///< core::LaneEvaluator, formula by formula
+    HOST_KERNEL,        ///< Lane kernel compiled for the host
+    DEVICE_KERNEL       ///< Lane kernel on a CUDA device
+};
+
+/**
+ * @brief Shape of a template's calculation plan (UnifiedEngine::plan_statistics())
+ */
+struct PlanStatistics {
+    std::vector<std::string> codes;     ///< Line items in calculation order
+    size_t formulas = 0;                ///< Line items with a formula (the others are provider lookups)
+    size_t instructions = 0;            ///< Bytecode instructions of all formulas
+    size_t function_calls = 0;          ///< Function call sites of all formulas
+    size_t inputs = 0;                  ///< Values loaded from the providers each period
+    size_t prior_period_reads = 0;      ///< Inputs at [t-1] (kept in memory between periods)
+    size_t history_reads = 0;           ///< Inputs at other offsets (database queries)
+    size_t levels = 0;                  ///< Topological levels: the critical path
+    size_t widest_level = 0;            ///< Line items of the widest level
+    size_t circular_blocks = 0;
+    size_t shared_subexpressions = 0;
+    size_t state_size = 0;              ///< Values of a period's state (line items and inputs)
+    bool kernel_eligible = false;       ///< Native and lane kernels can run the plan
+
+    size_t line_items() const { return codes.size(); }
+};
+
+/**
+ * @brief Carried state of path-dependent tax strategies, by strategy name
+ */
+using TaxState = std::map<std::string, std::vector<double>>;
+
 /**
  * @brief Unified engine that calculates all statements in one pass
  *
@@ -133,10 +242,42 @@ class UnifiedEngine {
 public:
     /**
      * @brief Construct unified engine with database connection
+     *
+     * Reads only the entity table up front: unit definitions and FX rates are loaded
+     * when the first driver value is converted, templates and validation
+     * rules by the first calculate().
+     *
      * @param db Database interface
      */
     explicit UnifiedEngine(std::shared_ptr<database::IDatabase> db);
 
+    /**
+     * @brief Construct unified engine on shared reference data
+     *
+     * Converts driver units and currencies with the store's current
+     * snapshot instead of loading fx_rate and unit_definition itself.
+     *
+     * @param db Database interface
+     * @param reference Store shared with the other engines (not null)
+     */
+    UnifiedEngine(std::shared_ptr<database::IDatabase> db, std::shared_ptr<core::ReferenceDataStore> reference);
+
+    /**
+     * @brief Switch to the reference store's latest snapshot, if it changed
+     *
+     * Call between scenarios (PeriodRunner does, before each run): the
+     * snapshot stays fixed while a run's periods are calculated. Drops
+     * cached driver values converted with the old rates.
+     *
+     * @return true if a newer snapshot was taken (false without a store)
+     */
+    bool refresh_reference_data();
+
+    /**
+     * @brief Version of the reference snapshot in use (0 without a store)
+     */
+    uint64_t reference_version() const { return reference_snapshot_ ? reference_snapshot_->version : 0; }
+
     /**
      * @brief Calculate all financial statements in one pass
      * @param entity_id Entity identifier
@@ -155,6 +296,81 @@ public:
         const std::string& template_code
     );
 
+    /**
+     * @brief Calculate one period for a batch of scenarios in a single pass
+     * @param entity_id Entity identifier
+     * @param scenario_ids Scenario per lane
+     * @param period_id Period identifier
+     * @param opening_bs Opening balance sheet per lane (or one shared by all lanes)
+     * @param template_code Unified template code
+     * @return One result per lane, same as calling calculate() per scenario
+     * @throws std::invalid_argument if opening_bs doesn't match the lane count
+     *
+     * The template is loaded and ordered once, driver values are gathered
+     * into per-lane arrays, and every formula is evaluated for all lanes at
+     * once with core::LaneEvaluator. Use this when many scenario variants
+     * share the same template and differ only in their drivers.
+     *
+     * A formula error in any lane fails the whole batch.
+     */
+    std::vector<UnifiedResult> calculate_lanes(
+        const EntityID& entity_id,
+        const std::vector<ScenarioID>& scenario_ids,
+        PeriodID period_id,
+        const std::vector<BalanceSheet>& opening_bs,
+        const std::string& template_code
+    );
+
+    /**
+     * @brief calculate_lanes() kept in lane arrays, for runs of many lanes over many periods
+     * @param entity_id Entity identifier
+     * @param scenario_ids Scenario per lane
+     * @param period_id Period identifier
+     * @param opening Previous period of every lane (as opening balance sheets and [t-1] values)
+     * @param template_code Unified template code
+     * @param driver_overrides Driver values replacing the scenarios' ones in every lane (null: none)
+     * @return Line items of all lanes
+     * @throws std::runtime_error on a template or formula error in any lane
+     * @throws std::invalid_argument if opening or override values don't have one value per lane
+     *
+     * Same values as calculate_lanes() with one opening balance sheet per
+     * lane, without building per-lane results: the returned values are the
+     * next period's opening. Validation rules aren't applied. Overrides
+     * only apply to codes the template reads.
+     */
+    LaneResult calculate_lane_values(
+        const EntityID& entity_id,
+        const std::vector<ScenarioID>& scenario_ids,
+        PeriodID period_id,
+        const LaneResult& opening,
+        const std::string& template_code,
+        const LaneValues* driver_overrides = nullptr
+    );
+
+    /**
+     * @brief Calculate one period of many entities that share a template, as lanes
+     * @param entity_ids Entity per lane
+     * @param scenario_id Scenario of every lane
+     * @param period_id Period identifier
+     * @param opening Previous period of every lane (as calculate_lane_values())
+     * @param template_code Unified template code
+     * @return Line items of all lanes: a lanes × line items block in plan order
+     * @throws std::runtime_error on a template or formula error in any lane
+     * @throws std::invalid_argument if opening values don't have one value per lane
+     *
+     * calculate_lane_values() over entities instead of scenarios: the plan
+     * is compiled once and each formula evaluated for all entities at once.
+     * Drivers are read from a prefetch_drivers() of the entities when there
+     * is one. Validation rules aren't applied.
+     */
+    LaneResult calculate_entity_lanes(
+        const std::vector<EntityID>& entity_ids,
+        ScenarioID scenario_id,
+        PeriodID period_id,
+        const LaneResult& opening,
+        const std::string& template_code
+    );
+
     /**
      * @brief Validate result using data-driven validation rules
      * @param result Unified result to validate
@@ -172,42 +388,820 @@ public:
      */
     void set_prior_period_values(const std::map<std::string, double>& prior_values);
 
+    /**
+     * @brief Set the activation of management actions for the next calculate()
+     * @param activation Action code → 1 active, 0 inactive (missing: inactive)
+     *
+     * Read by parametric action templates as action:CODE (see
+     * ActionActivationProvider); other templates don't read it.
+     */
+    void set_action_activation(const std::map<std::string, double>& activation) {
+        action_provider_->set_activation(activation);
+    }
+
+    /**
+     * @brief Set the Scope 3 emissions templates read as scope3:CATEGORY
+     * @param results Emissions by entity, scenario and period (null: none, all read 0)
+     *
+     * See carbon::EEIOModel and Scope3Provider. Lane calculations
+     * (calculate_lanes(), calculate_entity_lanes()) don't read them.
+     */
+    void set_scope3_results(std::shared_ptr<const carbon::Scope3Results> results) {
+        scope3_provider_->set_results(std::move(results));
+    }
+
+    /**
+     * @brief Choose the working capital and capex policies templates read as policy:NAME
+     * @throws std::out_of_range for a code without an active row
+     *
+     * Both are "DEFAULT" otherwise. See PolicyProvider; forgets the capex
+     * vintages recorded so far.
+     */
+    void select_policies(const std::string& wc_code, const std::string& capex_code) {
+        policy_provider_->select(wc_code, capex_code);
+    }
+
+    /**
+     * @brief The policies templates read (read from wc_policy and capex_policy once)
+     */
+    const PolicyProvider& policies() const { return *policy_provider_; }
+
+    /**
+     * @brief Re-read scenario inheritance and parent scenario drivers
+     *
+     * Drivers of parent scenarios are cached between calculations (see
+     * DriverValueProvider); call this after changing them.
+     */
+    void clear_driver_cache();
+
+    /**
+     * @brief Set how many calculated periods [t-k] references can read from memory
+     * @param periods Periods kept per entity and scenario (default 12, 0: always query)
+     *
+     * Every successful calculate() records its values; a [t-k] reference
+     * to a recorded period of the same entity and scenario doesn't query
+     * balance_sheet_actuals.
+     */
+    void set_history_depth(size_t periods);
+
+    /**
+     * @brief Number of calculated periods [t-k] references read from memory
+     */
+    size_t history_depth() const;
+
+    /**
+     * @brief [t-k] values read from the database so far (not held in memory)
+     */
+    size_t database_reads() const;
+
+    /**
+     * @brief Forget the periods recorded for [t-k] references
+     */
+    void clear_statement_history();
+
+    /**
+     * @brief Record a period calculated earlier for [t-k] references
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario identifier
+     * @param period_id Period the values belong to
+     * @param values Line item code → value of that period
+     *
+     * For runs resumed from a checkpoint: later calculate() calls of the
+     * same entity and scenario read the period as if it had just been
+     * calculated.
+     */
+    void restore_statement_history(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id,
+                                   const std::map<std::string, double>& values);
+
+    /**
+     * @brief Load the drivers of all periods of a run with one query
+     * @param entity_id Entity identifier
+     * @param scenario_id Scenario identifier
+     * @param period_ids Periods about to be calculated
+     *
+     * calculate() for these periods then reads drivers from memory instead
+     * of querying scenario_drivers once per period (see
+     * DriverValueProvider::prefetch()). Kept until clear_driver_cache().
+     */
+    void prefetch_drivers(const EntityID& entity_id, ScenarioID scenario_id,
+                          const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief prefetch_drivers() from rows read ahead on another connection
+     * @param rows Rows from DriverValueProvider::fetch_rows()
+     * @param period_ids Periods about to be calculated
+     */
+    void prefetch_drivers(const DriverValueProvider::DriverRows& rows, const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Load the drivers of several entities' runs with one query
+     * @param entity_ids Entities about to be calculated as lanes
+     * @param scenario_id Scenario identifier
+     * @param period_ids Periods about to be calculated
+     *
+     * calculate_entity_lanes() then reads every lane's drivers from memory.
+     * Replaces the previous prefetch; kept until clear_driver_cache().
+     */
+    void prefetch_drivers(const std::vector<EntityID>& entity_ids, ScenarioID scenario_id,
+                          const std::vector<PeriodID>& period_ids);
+
+    /**
+     * @brief Re-read validation rules (each template's rules are loaded once)
+     */
+    void clear_validation_rules();
+
+    /**
+     * @brief Choose the validation rules calculate() checks
+     * @param enabled False: calculate() and calculate_lanes() check no rules
+     * @param skip_warnings True: rules of WARNING severity are never evaluated
+     *
+     * validate() itself always checks (except skipped warnings).
+     */
+    void set_validation(bool enabled, bool skip_warnings = false);
+
+    /**
+     * @brief Make TAX_COMPUTE(x, "name") use a path-dependent strategy
+     * @param name Strategy name in formulas
+     * @param strategy Strategy (e.g. pl::LossCarryforwardTaxStrategy)
+     *
+     * calculate() computes the tax from the opening state (set_tax_state())
+     * and leaves the state for the next period in tax_state(), so formulas
+     * need no [t-k] references to earlier losses. PeriodRunner::run_periods()
+     * carries it from period to period. Lane calculations don't support them.
+     */
+    void register_tax_strategy(const std::string& name, std::shared_ptr<const pl::IStatefulTaxStrategy> strategy);
+
+    /**
+     * @brief State the next calculate() starts from
+     * @param opening State per strategy name; strategies without one start from initial_state()
+     * @throws std::invalid_argument if a registered strategy's state has the wrong size
+     */
+    void set_tax_state(const TaxState& opening);
+
+    /**
+     * @brief State after the last calculate(), the next period's opening state
+     */
+    const TaxState& tax_state() const { return tax_state_; }
+
+    /**
+     * @brief Entity IDs used in calculation contexts (core::Context::entity_id)
+     */
+    const core::EntityDictionary& entities() const { return *entities_; }
+
+    /**
+     * @brief Make an in-memory template available under its code
+     * @param tmpl Template, e.g. an action overlay from StatementTemplate::with_formulas()
+     *
+     * calculate() and calculate_lanes() use a registered template instead of
+     * loading one from the database; nothing is written to statement_template.
+     * Registering a template with the same code replaces it.
+     */
+    void register_template(std::shared_ptr<const core::StatementTemplate> tmpl);
+
+    /**
+     * @brief Check if a template code was registered with register_template()
+     */
+    bool has_registered_template(const std::string& template_code) const {
+        return registered_templates_.count(template_code) != 0;
+    }
+
+    /**
+     * @brief The template calculate() uses for a code: the registered one, else the database's
+     * @return Null if there is no template with that code
+     */
+    std::shared_ptr<const core::StatementTemplate> find_template(const std::string& template_code) const;
+
+    /**
+     * @brief Calculate only some line items and what they depend on
+     * @param outputs Line item codes (empty: every line item)
+     *
+     * calculate() and calculate_lanes() use each template pruned with
+     * core::StatementTemplate::with_outputs(): results hold the outputs and
+     * their ancestors (a template without any of the outputs fails to
+     * calculate). The pruned copies are built once per template.
+     */
+    void set_output_selection(std::vector<std::string> outputs);
+
+    /**
+     * @brief Line items set with set_output_selection() (empty: all)
+     */
+    const std::vector<std::string>& output_selection() const { return outputs_; }
+
+    /**
+     * @brief Differentiate every line item by some drivers in the same pass
+     * @param driver_codes Driver codes (as in scenario_drivers; empty: no derivatives)
+     *
+     * After each successful calculate(), the formulas run once more on dual
+     * numbers (core::TangentEvaluator) and UnifiedResult::sensitivities
+     * holds d line item / d driver for every driver at once - instead of
+     * one bumped run per driver. A driver is differentiated as formulas read
+     * it (after unit conversion). [t-k] reads carry the derivatives of the
+     * periods this engine calculated before (same entity and scenario), so
+     * roll-forwards such as CASH[t-1] + NET accumulate them; opening values,
+     * actuals and path-dependent tax state count as constants.
+     * calculate_lanes() doesn't differentiate.
+     */
+    void set_sensitivity_drivers(std::vector<std::string> driver_codes);
+
+    /**
+     * @brief Record the local derivatives of each calculate() on a tape (null: stop)
+     * @param tape Tape kept alive by the caller while set (see AdjointTape)
+     *
+     * Every successful period is added to the tape after it is calculated:
+     * the partial derivative of each line item by every value it read,
+     * from one dual-number pass per formula. [t-1] reads are edges to the
+     * tape's previous period, windows and [t-k] reads to the periods they
+     * cover; periods outside the tape's run are constants.
+     */
+    void set_tape(AdjointTape* tape);
+
+    /**
+     * @brief Drivers set with set_sensitivity_drivers()
+     */
+    const std::vector<std::string>& sensitivity_drivers() const {
+        static const std::vector<std::string> none;
+        return sensitivity_drivers_ ? *sensitivity_drivers_ : none;
+    }
+
+    /**
+     * @brief Enable or disable native kernels for calculate()
+     * @param options Kernel options (options.enabled switches the backend on)
+     *
+     * With native kernels enabled, each template's calculation order is
+     * lowered into one compiled function (see core::NativeKernel) the first
+     * time the template is calculated, and calculate() runs that function
+     * instead of interpreting formula by formula. Periods the kernel can't
+     * reproduce exactly (a division by zero, a driver overriding a computed
+     * line item, an input that can't be resolved) fall back to the
+     * interpreter, so results and error messages don't change.
+     */
+    void set_native_kernels(const core::NativeKernelOptions& options);
+
+    /**
+     * @brief Check if a native kernel is loaded for a template
+     * @param template_code Template code
+     * @return True once calculate() has built a kernel for the template
+     */
+    bool has_native_kernel(const std::string& template_code) const;
+
+    /**
+     * @brief Shape of the plan calculate() would run for a template
+     * @param template_code Template code (registered or in the database)
+     * @return Counts of the plan (built and cached as by calculate())
+     * @throws std::invalid_argument if the template doesn't exist or has none of the selected outputs
+     * @throws std::runtime_error if its calculation order can't be computed
+     *
+     * For sizing runs before they start (see orchestration::RunEstimator).
+     */
+    PlanStatistics plan_statistics(const std::string& template_code);
+
+    /**
+     * @brief Enable or disable lane kernels for lane runs
+     * @param options Kernel options (options.enabled switches the backend on)
+     *
+     * calculate_lanes(), calculate_lane_values() and calculate_entity_lanes()
+     * then run a template's calculation order as one compiled function
+     * over all lanes (see core::NativeKernel::build_lanes()), on the host
+     * or on a CUDA device, instead of formula by formula. Drivers and
+     * openings are still gathered on the host each period. Periods the
+     * kernel can't reproduce exactly (lanes reading a line item from
+     * different sources, a division by zero, a division or function call
+     * inside a branch, a kernel that fails to build or a device error) go
+     * through the interpreter, so results and error messages don't change.
+     */
+    void set_lane_kernels(const core::LaneKernelOptions& options);
+
+    /**
+     * @brief Backend of the last successful lane run
+     */
+    LaneBackend last_lane_backend() const { return last_lane_backend_; }
+
+    /**
+     * @brief Evaluate independent line items of a period concurrently
+     * @param threads Threads per calculation including the caller (0 or 1: sequential)
+     * @param min_level_width Topological levels with fewer line items run sequentially
+     *
+     * Line items of one topological level don't read each other, so wide
+     * templates (e.g. one line per physical asset) can spread a level over
+     * a thread pool. Results match sequential calculation; if any line item
+     * fails, the period is recalculated in order so the error is reported
+     * exactly as before. Native kernels and incremental runs take
+     * precedence when enabled.
+     */
+    void set_parallel(size_t threads, size_t min_level_width = 64);
+
+    /**
+     * @brief Enable or disable incremental recalculation
+     * @param enabled True to keep every period's values between calls
+     *
+     * For what-if reruns: each calculate() remembers its line item values
+     * and formula inputs per (entity, scenario, period, template). When the
+     * same period is calculated again, only formulas reading a changed input
+     * (a driver, an opening / [t-1] value, or an upstream line item whose
+     * value changed) are evaluated; the others keep their previous value.
+     * A changed [t-1] value propagates into later periods the same way.
+     *
+     * Results match a full calculation; periods where that can't be
+     * guaranteed (an input error, a driver overriding a computed line item)
+     * are calculated in full. Disabling drops the remembered state.
+     */
+    void set_incremental(bool enabled);
+
+    /**
+     * @brief Start incremental runs of new scenarios from the previous scenario
+     * @param enabled True to seed a period never calculated for its scenario
+     *        from the latest calculation of the same entity and period
+     *
+     * For sweeps over related scenarios (e.g. action combinations in Gray
+     * code order, see CombinationOrder::GRAY): the first calculation of a
+     * period under a new scenario reuses every line item whose formula and
+     * inputs are as in the previous scenario's calculation of that period,
+     * even under another template, and re-evaluates only what an action or
+     * a driver changed and its downstream line items. The seed's state moves
+     * to the new scenario, so a sweep keeps one state per period. Implies
+     * set_incremental(true); results match a full calculation.
+     */
+    void set_incremental_seeding(bool enabled);
+
+    /**
+     * @brief Enable or disable sparse evaluation
+     * @param enabled True to skip formulas whose inputs are all zero
+     *
+     * For wide templates whose per-asset or per-action blocks are zero in
+     * most scenarios (loss drivers of unaffected assets, carbon lines of
+     * inactive actions). The plan marks formulas that are 0 whenever
+     * everything they read is 0 (see core::FormulaEvaluator::preserves_zero());
+     * each period its inputs are loaded into a non-zero bitmap, and such a
+     * formula whose reads are all zero is set to 0 without being evaluated,
+     * so a whole zero subgraph is skipped as the zeros propagate.
+     *
+     * Results match a full calculation; periods with circular blocks,
+     * formulas that don't compile or a driver overriding a computed line
+     * item are calculated in full. Native kernels, the parallel executor
+     * and incremental runs take precedence when enabled.
+     */
+    void set_sparse(bool enabled) { sparse_ = enabled; }
+
+    /**
+     * @brief Record timings of later calculations
+     * @param profiler Profiler (null: stop profiling)
+     *
+     * calculate() records its template load, calculate and validate stages
+     * and provider lookups; line items are timed one by one when they are
+     * interpreted in order (not inside a native kernel, a parallel level,
+     * an incremental rerun or a sparse run, which only count as the
+     * calculate stage).
+     */
+    void set_profiler(std::shared_ptr<core::Profiler> profiler);
+
+    /**
+     * @brief Profiler recording calculations (null if none)
+     */
+    const std::shared_ptr<core::Profiler>& profiler() const { return profiler_; }
+
+    /**
+     * @brief Memory for data that lives no longer than a calculate() call
+     * @param arena Arena the caller resets between periods (null: the heap)
+     *
+     * Holds the validation rule results of a period; PeriodRunner passes
+     * its scenario worker's arena.
+     */
+    void set_arena(core::Arena* arena) { arena_ = arena; }
+
+    /**
+     * @brief Number of formulas evaluated by the last calculate()
+     *
+     * Equals the template's formula count unless an incremental run
+     * skipped unchanged formulas or a sparse run skipped zero ones.
+     */
+    size_t last_recalculated_count() const { return last_recalculated_; }
+
+    /**
+     * @brief Number of formulas a sparse run set to 0 without evaluating them in the last calculate()
+     */
+    size_t last_skipped_count() const { return last_skipped_; }
+
+    /**
+     * @brief Iterations the last calculate() took to solve its circular blocks
+     *
+     * Summed over the template's blocks (see core::CircularPolicy); 0 for
+     * a template without circular references.
+     */
+    size_t last_circular_iterations() const { return last_circular_iterations_; }
+
 private:
     std::shared_ptr<database::IDatabase> db_;
+    std::shared_ptr<core::EntityDictionary> entities_;  // Shared with driver and statement providers
+    std::shared_ptr<core::ReferenceDataStore> reference_;            // Null: FX and units loaded by this engine
+    std::shared_ptr<const core::ReferenceData> reference_snapshot_;  // Snapshot the driver provider converts with
     core::FormulaEvaluator evaluator_;
 
     // Value providers
     std::unique_ptr<DriverValueProvider> driver_provider_;           // Scenario drivers from scenario_drivers table
     std::unique_ptr<bs::StatementValueProvider> statement_provider_; // All financial statement values (P&L, BS, CF)
+    std::unique_ptr<ActionActivationProvider> action_provider_;      // action:CODE of parametric action templates
+    std::unique_ptr<Scope3Provider> scope3_provider_;                // scope3:CATEGORY of spend-based Scope 3
+    std::unique_ptr<PolicyProvider> policy_provider_;                // policy:NAME of working capital and capex policies
 
     // Validation rule engine (data-driven validation)
     std::unique_ptr<ValidationRuleEngine> validation_engine_;
+    bool validation_enabled_ = true;
 
-    // Legacy providers (not used in unified engine, kept for backward compatibility)
-    std::unique_ptr<pl::PLValueProvider> pl_provider_;
-    std::unique_ptr<cf::CFValueProvider> cf_provider_;
+    // Path-dependent TAX_COMPUTE strategies (register_tax_strategy())
+    struct StatefulTax {
+        std::string name;
+        std::shared_ptr<const pl::IStatefulTaxStrategy> strategy;
+    };
+    std::unordered_map<std::string, StatefulTax> tax_strategies_;   ///< By call name ("TAX_COMPUTE:<name>")
+    TaxState opening_tax_state_;
+    TaxState tax_state_;
+    std::mutex tax_mutex_;                                           // Parallel levels compute taxes concurrently
+    core::FormulaEvaluator::CustomFunctionHandler tax_function_;     // Empty until a strategy is registered
+
+    /**
+     * @brief TAX_COMPUTE through a registered strategy, from the opening state
+     */
+    double compute_stateful_tax(const std::string& call_name, const std::vector<double>& args);
 
     // Provider list for evaluator
     std::vector<core::IValueProvider*> providers_;
 
-    // Current calculation state
-    std::map<std::string, double> current_values_;
+    // Lane values of one code from drivers or openings (defined in the source)
+    struct LaneColumn;
+    using LaneColumns = std::unordered_map<std::string, LaneColumn>;
+
+    // Calculation order entry of a lane run (defined in the source)
+    struct LaneStep;
+
+    /// Fills driver and opening columns of the codes a template reads
+    using LaneGather = std::function<void(const std::vector<std::string>& keys,
+                                          LaneColumns& drivers, LaneColumns& opening)>;
 
     /**
-     * @brief Calculate a single line item
-     * @param code Line item code
-     * @param formula Formula to evaluate (or empty if base value)
-     * @param sign Sign convention to apply
+     * @brief Evaluate a template's calculation order for all lanes at once
+     * @param out Schema and the values of the steps evaluated (all unless an error occurred)
+     * @return Error message (empty on success)
+     */
+    std::string evaluate_lanes(const std::string& template_code, size_t lanes,
+                               const LaneGather& gather, LaneResult& out);
+
+    /**
+     * @brief Evaluate gathered lanes through the template's lane kernel
+     * @return False if the interpreter must evaluate them instead (out untouched)
+     */
+    bool evaluate_lane_kernel(const std::string& template_code, size_t lanes,
+                              const std::vector<LaneStep>& steps, const LaneColumns& drivers,
+                              const LaneColumns& opening, LaneResult& out);
+
+    /**
+     * @brief Driver values of each lane's entity and scenario (loaded once per distinct pair)
+     * @param entities Entity per lane, or one shared by all lanes
+     * @param scenario_ids Scenario per lane, or one shared by all lanes
+     */
+    void gather_lane_drivers(const std::vector<int>& entities, const std::vector<ScenarioID>& scenario_ids,
+                             PeriodID period_id, const std::vector<std::string>& keys, LaneColumns& drivers);
+
+    /**
+     * @brief calculate_lane_values() and calculate_entity_lanes() of lanes of entities and scenarios
+     */
+    LaneResult lane_values(const char* caller, const std::vector<int>& entities,
+                           const std::vector<ScenarioID>& scenario_ids, size_t lanes, PeriodID period_id,
+                           const LaneResult& opening, const std::string& template_code,
+                           const LaneValues* driver_overrides);
+
+    /**
+     * @brief A template's calculation order, resolved once for repeated runs
+     *
+     * Formulas are optimised together and bound to providers_, and every
+     * line item gets a dense step index, so calculate() runs the plan with
+     * no string lookups: step i's value lives in calc_values_[i] and is
+     * published to statement_provider_ through its slot.
+     */
+    struct CalculationPlan {
+        size_t signature = 0;       ///< Hash of the template's (code, formula) pairs
+        size_t shared_count = 0;    ///< Subexpressions shared between formulas
+        std::unordered_map<std::string, core::FormulaBinding> bindings;  ///< Line item code → formula
+        std::unordered_map<std::string, std::string> compile_errors;     ///< Line item code → error
+        std::shared_ptr<const ResultSchema> schema;                      ///< Result layout (step order)
+
+        /// One calculation order entry
+        struct Step {
+            std::string code;                                   ///< Line item code
+            bool found = true;                                  ///< Line item exists in the template
+            SignConvention sign = SignConvention::NEUTRAL;
+            const core::FormulaBinding* binding = nullptr;      ///< Formula (null: provider lookup)
+            const std::string* compile_error = nullptr;         ///< Formula that failed to compile
+            std::vector<core::ProviderSlot> sources;            ///< providers_ candidates for a provider lookup
+            int statement_slot = core::IValueProvider::NO_SLOT; ///< statement_provider_ slot for the result
+            std::vector<uint32_t> variable_slots;               ///< State slot per formula variable
+            std::vector<uint32_t> reads;                        ///< State slots the value depends on
+            bool is_volatile = false;                           ///< Formula calls impure functions
+            bool preserves_zero = false;                        ///< Formula is 0 when all its reads are (sparse runs)
+            size_t identity = 0;                                ///< Hash of code, formula and reads (seeding)
+        };
+        std::vector<Step> steps;    ///< Calculation order
+
+        /// Formula variable not computed in this pass, loaded from the providers
+        struct Input {
+            uint32_t slot;                          ///< State slot
+            const core::FormulaBinding* binding;    ///< Binding of a formula reading it
+            uint32_t var_index;                     ///< Variable index in that binding
+            std::string key;                        ///< "code[offset]" (matches inputs across plans)
+        };
+
+        // State layout shared by the native kernel and incremental runs:
+        // slot i < steps.size() is step i, inputs follow
+        std::vector<Input> inputs;
+        std::vector<int> overrides;     ///< Driver slots that would replace a computed value read from the state
+        size_t state_size = 0;
+        bool reads_current_shifted = false; ///< A [t-k] read (k != 1) may see an earlier step's value
+        bool reads_history = false;         ///< A [t-k] read (k > 1) goes to the database
+
+        /// Step indices by topological level (a step only reads steps of earlier levels)
+        std::vector<std::vector<uint32_t>> levels;
+
+        /// Ranges of steps solved together to a fixed point (the template's circular blocks)
+        std::vector<core::CircularBlock> cycles;
+        core::CircularPolicy circular;
+
+        bool kernel_built = false;                          ///< Build attempted (kernel may still be null)
+        std::shared_ptr<const core::NativeKernel> kernel;   ///< Whole calculation order as one function
+        std::string kernel_error;                           ///< Why no kernel could be built
+
+        const core::Profiler* profiled_by = nullptr;        ///< Profiler profile_ids belong to
+        std::vector<uint32_t> profile_ids;                  ///< Profiler line item id per step
+    };
+
+    /**
+     * @brief State of an earlier calculate() kept for incremental runs
+     */
+    struct PreviousRun {
+        size_t signature = 0;           ///< CalculationPlan::signature the state belongs to
+        std::string template_code;      ///< Template of that plan
+        std::vector<double> values;     ///< Per state slot
+        std::vector<uint8_t> present;   ///< Input could be loaded (steps always present)
+    };
+
+    // Plans keyed by template code (rebuilt when the template's formulas change)
+    std::unordered_map<std::string, CalculationPlan> template_plans_;
+
+    // Shared subexpression values for the period being calculated
+    core::SubexpressionCache shared_values_;
+
+    // Step values of the period being calculated (parallel to CalculationPlan::steps)
+    std::vector<double> calc_values_;
+
+    // Native kernel backend (off unless enabled for the run)
+    core::NativeKernelOptions native_options_;
+    std::vector<double> kernel_state_;
+
+    // Lane kernel backend (off unless enabled), one kernel per template for
+    // the slot layout it was built with
+    struct LaneKernel {
+        size_t layout = 0;                                  ///< Hash of formulas and slot layout
+        std::shared_ptr<const core::NativeKernel> kernel;   ///< Null: build failed for this layout
+    };
+    core::LaneKernelOptions lane_options_;
+    std::unordered_map<std::string, LaneKernel> lane_kernels_;
+    std::vector<double> lane_state_;
+    LaneBackend last_lane_backend_ = LaneBackend::INTERPRETER;
+
+    // Parallel executor (off unless enabled), one subexpression cache per thread
+    std::unique_ptr<core::ThreadPool> pool_;
+    size_t parallel_min_width_ = 0;
+    std::vector<core::SubexpressionCache> worker_shared_values_;
+
+    // Timings of calculations (off unless set)
+    std::shared_ptr<core::Profiler> profiler_;
+    size_t profiled_database_reads_ = 0;
+
+    // Per-period scratch memory (not owned; null: the heap)
+    core::Arena* arena_ = nullptr;
+
+    // Template whose driver mappings are loaded (reloaded when another one is calculated)
+    std::shared_ptr<const core::StatementTemplate> mapped_template_;
+
+    /**
+     * @brief Lookup category of a provider in profiles
+     */
+    core::Profiler::Lookup profiled_source(const core::IValueProvider* provider) const;
+
+    // In-memory templates (action overlays), by code
+    std::unordered_map<std::string, std::shared_ptr<const core::StatementTemplate>> registered_templates_;
+
+    /**
+     * @brief Create the value providers, converting driver values with unit_converter
+     */
+    void init_providers(std::shared_ptr<const core::UnitConverter> unit_converter);
+
+    /**
+     * @brief Load a template and its driver mappings
+     * @param template_code Registered or database template code
+     * @return Template (pruned to the output selection), or null if there is none with that code
+     * @throws std::invalid_argument if the template has none of the selected outputs
+     */
+    std::shared_ptr<const core::StatementTemplate> load_template(const std::string& template_code);
+
+    // Output selection (set_output_selection()): pruned copy per selected-from template
+    std::vector<std::string> outputs_;
+    std::unordered_map<const core::StatementTemplate*,
+                       std::pair<std::shared_ptr<const core::StatementTemplate>,
+                                 std::shared_ptr<const core::StatementTemplate>>> pruned_templates_;
+
+    // Sensitivities (set_sensitivity_drivers()): tangents of the periods calculated
+    // before, newest last, for [t-k] reads
+    std::shared_ptr<const std::vector<std::string>> sensitivity_drivers_;
+    std::unique_ptr<core::TangentEvaluator> tangent_evaluator_;
+    std::deque<std::pair<PeriodID, Sensitivities>> tangent_history_;
+    std::pair<int, ScenarioID> tangent_context_{0, 0};
+
+    // Reverse mode (set_tape()): one evaluator per number of formula variables
+    AdjointTape* tape_ = nullptr;
+    std::vector<std::unique_ptr<core::TangentEvaluator>> tape_evaluators_;
+
+    /**
+     * @brief Where a value read by a step comes from, for derivatives
+     */
+    struct ReadSource {
+        enum class Kind { DRIVER, STEP, PERIOD };
+        Kind kind;
+        std::string code;       ///< Driver code (DRIVER) or line item code (PERIOD)
+        uint32_t step = 0;      ///< Step index of this period (STEP)
+        PeriodID period = 0;    ///< Earlier period (PERIOD)
+        double weight = 1.0;    ///< Derivative of the value by the source
+    };
+
+    /**
+     * @brief Sources of a value read by step done
+     * @param previous Period the opening values come from (none: opening values are constants)
+     * @param driver The driver provider serves the value
+     */
+    void read_sources(const CalculationPlan& plan, const std::string& code, int time_offset, size_t done,
+                      const core::Context& ctx, std::optional<PeriodID> previous, bool driver,
+                      std::vector<ReadSource>& out) const;
+
+    /**
+     * @brief Run step done on dual numbers and report what it read
+     *
+     * visit.seed(var_index, tangent) sets a formula variable's tangent;
+     * after the formula ran (tangent in partials), visit.read(code,
+     * time_offset, driver, var_index) is called per variable, or once with
+     * var_index SIZE_MAX for a provider lookup.
+     */
+    template <typename Visit>
+    void visit_reads(const CalculationPlan& plan, const core::Context& ctx, size_t done,
+                     core::TangentEvaluator& evaluator, core::LaneArray& partials, Visit&& visit);
+
+    /**
+     * @brief Differentiate the period calculate() just calculated into result.sensitivities
+     */
+    void calculate_sensitivities(const CalculationPlan& plan, const core::Context& ctx, UnifiedResult& result);
+
+    /**
+     * @brief Add the period calculate() just calculated to tape_
+     */
+    void record_tape(const CalculationPlan& plan, const core::Context& ctx, UnifiedResult& result);
+
+    /**
+     * @brief Results of the template's rules for a result (validate() without the messages)
+     */
+    std::pmr::vector<ValidationRuleResult> run_rules(const UnifiedResult& result, const std::string& template_code,
+                                                     const core::Context& ctx);
+
+    /**
+     * @brief Check the rules into result: failed errors unset success, failed warnings are added as records
+     */
+    void check_rules(UnifiedResult& result, const std::string& template_code, const core::Context& ctx);
+
+    /**
+     * @brief Tangent of a recorded period's line item (null if not recorded)
+     */
+    const core::LaneArray* recorded_tangent(const std::string& code, PeriodID period_id) const;
+
+    /**
+     * @brief The template to calculate for a loaded one: itself, or its pruned copy
+     * @throws std::invalid_argument if the template has none of the outputs
+     */
+    std::shared_ptr<const core::StatementTemplate> select_outputs(std::shared_ptr<const core::StatementTemplate> tmpl);
+
+    // Incremental recalculation (off unless enabled), keyed by (entity, scenario, period, template)
+    bool incremental_ = false;
+    std::map<std::tuple<int, ScenarioID, PeriodID, std::string>, PreviousRun> previous_runs_;
+    std::vector<uint8_t> changed_;      ///< Per state slot: differs from the previous run
+    size_t last_recalculated_ = 0;
+
+    // Sparse evaluation (off unless enabled)
+    bool sparse_ = false;
+    std::vector<uint8_t> nonzero_;      ///< Per state slot: value is not 0 this period
+    size_t last_skipped_ = 0;
+
+    // Circular blocks: iterations of the last calculate(), Newton evaluators by block size
+    size_t last_circular_iterations_ = 0;
+    std::vector<std::unique_ptr<core::TangentEvaluator>> circular_evaluators_;
+
+    // Seeding from other scenarios (off unless enabled): latest run per (entity, period)
+    bool seeding_ = false;
+    std::map<std::pair<int, PeriodID>, std::tuple<int, ScenarioID, PeriodID, std::string>> latest_runs_;
+    std::vector<uint8_t> unseeded_;     ///< Per step: no match in the seed, must be evaluated
+
+    /**
+     * @brief Start a run from the latest run of the same entity and period
+     * @param plan Plan about to be calculated
+     * @param key Previous run key of the calculation (has no previous run)
+     * @return False if there is no usable seed (unseeded_ is only set on success)
+     *
+     * Steps are matched by identity, inputs by key; the seed is removed.
+     */
+    bool seed_run(const CalculationPlan& plan, const std::tuple<int, ScenarioID, PeriodID, std::string>& key);
+
+    /**
+     * @brief Get (or build) the plan for a template
+     * @param tmpl Template with calculation order computed
+     * @return Plan valid until the template's formulas change
+     */
+    CalculationPlan& plan_for(const core::StatementTemplate& tmpl);
+
+    /**
+     * @brief Build the plan's native kernel (once per plan)
+     * @param plan Plan to extend
+     */
+    void build_kernel(CalculationPlan& plan);
+
+    /**
+     * @brief Calculate all line items through the plan's native kernel
+     * @param plan Plan with a loaded kernel
+     * @param ctx Calculation context
+     * @return False if this period must go through the interpreter instead
+     *         (otherwise calc_values_ holds every step's value)
+     */
+    bool calculate_native(const CalculationPlan& plan, const core::Context& ctx);
+
+    /**
+     * @brief Recalculate only the steps whose inputs changed since a previous run
+     * @param plan Plan the previous run was made with
+     * @param ctx Calculation context
+     * @param run Previous run (updated to this run's state)
+     * @param seeded The run was seeded from another one (unseeded_ steps are evaluated)
+     * @return False if this period must be calculated in full instead
+     *         (otherwise calc_values_ holds every step's value)
+     */
+    bool calculate_incremental(const CalculationPlan& plan, const core::Context& ctx, PreviousRun& run,
+                               bool seeded = false);
+
+    /**
+     * @brief Calculate the steps in order, skipping zero-preserving formulas with all-zero reads
+     * @param plan Plan to run
      * @param ctx Calculation context
+     * @return False if this period must be calculated in full instead
+     *         (otherwise calc_values_ holds every step's value)
+     */
+    bool calculate_sparse(const CalculationPlan& plan, const core::Context& ctx);
+
+    /**
+     * @brief Load the inputs of a period about to be calculated in full
+     * @param plan Plan the period is calculated with
+     * @param ctx Calculation context
+     * @param run Receives the inputs (calculate() adds the step values)
+     */
+    void remember_inputs(const CalculationPlan& plan, const core::Context& ctx, PreviousRun& run);
+
+    /**
+     * @brief Calculate a single calculation order step
+     * @param step Plan step (formula or provider lookup)
+     * @param ctx Calculation context
+     * @param shared_values Shared subexpression values of the calling thread
      * @return Calculated value
      */
-    double calculate_line_item(
-        const std::string& code,
-        const std::optional<std::string>& formula,
-        SignConvention sign,
-        const core::Context& ctx
+    double calculate_step(
+        const CalculationPlan::Step& step,
+        const core::Context& ctx,
+        core::SubexpressionCache& shared_values
     );
 
+    /**
+     * @brief Solve a circular block of steps to its fixed point
+     * @param plan Plan the block belongs to
+     * @param cycle Steps of the block (their inputs outside it are calculated)
+     * @param ctx Calculation context
+     * @return Iterations taken (calc_values_ and the statement values then hold the solution)
+     * @throws std::runtime_error if a formula fails or the block doesn't converge
+     *
+     * Each iteration evaluates the block's formulas in order, each reading
+     * the values of the ones before it from this iteration; the sweep
+     * starts from the opening values (0 without one). The next start is
+     * the sweep's result mixed with earlier ones (Anderson), or a Newton
+     * step on the sweep's Jacobian from a dual-number pass.
+     */
+    size_t solve_cycle(const CalculationPlan& plan, const core::CircularBlock& cycle, const core::Context& ctx);
+
+    /**
+     * @brief Calculate all steps level by level, wide levels on the thread pool
+     * @param plan Plan to run
+     * @param ctx Calculation context
+     * @return False if a step failed (calculate in order for the error instead)
+     */
+    bool calculate_parallel(const CalculationPlan& plan, const core::Context& ctx);
+
     /**
      * @brief Populate value providers with opening balance sheet
      * @param opening_bs Opening balance sheet
@@ -9,7 +9,14 @@
 #include "types/common_types.h"
 #include "database/idatabase.h"
 #include "core/formula_evaluator.h"
+#include "core/formula_binding.h"
+#include "unified/result_row.h"
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <map>
+#include <unordered_map>
+#include <optional>
 #include <vector>
 #include <string>
 
@@ -40,6 +47,7 @@ struct ValidationRule {
     double tolerance;
     ValidationSeverity severity;
     bool is_active;
+    uint32_t diagnostic = 0;    ///< DiagnosticCatalog ID of its failure message (0: interned when it fails)
 };
 
 /**
@@ -50,9 +58,82 @@ struct ValidationRuleResult {
     std::string rule_name;
     bool passed;
     ValidationSeverity severity;
-    std::string message;
+    uint32_t diagnostic = 0;    ///< DiagnosticCatalog ID of the failure message (0: passed)
     double calculated_value;
     double tolerance;
+
+    /// Failure message, with calculated_value ("" if passed)
+    std::string message() const;
+};
+
+/**
+ * @brief When a run checks its validation rules
+ */
+enum class ValidationMode {
+    FULL,               ///< Every period of every scenario
+    FINAL_PERIOD,       ///< The last period of each run
+    EVERY_K_PERIODS,    ///< Every k-th period of each run, and its last
+    SAMPLED,            ///< Every period of a random share of the scenarios
+    DEFERRED            ///< None while running: check the stored results afterwards
+};
+
+/**
+ * @brief Which periods of a run are validated
+ *
+ * For large sweeps: skipped periods are calculated as usual and reported
+ * as successful, so rule failures there go unnoticed until a FULL run (or
+ * a deferred check of the stored results).
+ */
+struct ValidationPolicy {
+    ValidationMode mode = ValidationMode::FULL;
+    size_t every_periods = 1;       ///< EVERY_K_PERIODS: k
+    double sample_fraction = 1.0;   ///< SAMPLED: share of scenarios validated
+    uint64_t seed = 0;              ///< SAMPLED: picks the scenarios (same seed, same scenarios)
+    bool skip_warnings = false;     ///< Never evaluate rules of WARNING severity
+
+    /**
+     * @brief Whether a period of a run is validated
+     * @param period_index Index of the period in the run (0-based)
+     * @param period_count Periods of the run
+     */
+    bool validates(ScenarioID scenario_id, size_t period_index, size_t period_count) const;
+
+    /**
+     * @brief The policy as a JSON object (recorded in run_log.json_config)
+     */
+    std::string to_json() const;
+
+    /**
+     * @brief Parse a policy written by to_json() (absent fields keep their defaults)
+     * @throws std::invalid_argument on malformed JSON or an unknown mode
+     */
+    static ValidationPolicy from_json(const std::string& json);
+};
+
+/**
+ * @brief Line item columns of a block of (scenario, period) rows
+ */
+struct ResultColumns {
+    size_t rows = 0;
+    std::unordered_map<std::string, const double*> columns;   ///< rows values each, NaN where a row has none
+    std::vector<uint32_t> history;   ///< Rows of the same scenario directly before each row (empty: none)
+};
+
+/**
+ * @brief One rule checked over a block of rows
+ */
+struct ColumnRuleResult {
+    std::string rule_code;
+    ValidationSeverity severity = ValidationSeverity::ERROR;
+    bool skipped = false;          ///< The rule reads values the block doesn't have
+    size_t checked = 0;            ///< Rows the rule applied to
+    size_t failed = 0;
+    std::vector<uint64_t> failed_rows;   ///< Bitmap: bit (row % 64) of word (row / 64) set where it failed
+    std::vector<std::pair<size_t, std::string>> messages;   ///< (row, message) of the first failures
+
+    bool failed_at(size_t row) const {
+        return row / 64 < failed_rows.size() && (failed_rows[row / 64] >> (row % 64) & 1) != 0;
+    }
 };
 
 /**
@@ -73,24 +154,87 @@ public:
     /**
      * @brief Load validation rules for a template
      * @param template_code Template code (e.g., "TEST_UNIFIED_L1")
+     *
+     * Each template's rules are queried once and kept until clear_rules(),
+     * so calling this before every period costs no query.
      */
     void load_rules_for_template(const std::string& template_code);
 
+    /**
+     * @brief Compile the loaded template's rules for one result layout
+     * @param evaluator Formula evaluator
+     * @param providers Provider chain the formulas read (must outlive the compiled rules)
+     * @param schema Layout of the results execute_rules() will check
+     *
+     * Formulas are compiled and bound to the providers' slots, and each
+     * rule's required line items become one position in the schema (a
+     * result holds them all if it has values past it), once per template
+     * and layout. execute_rules() on results of that layout then does no
+     * parsing and no string lookup; other results are checked as before.
+     */
+    void compile_rules(
+        const core::FormulaEvaluator& evaluator,
+        const std::vector<core::IValueProvider*>& providers,
+        const std::shared_ptr<const ResultSchema>& schema
+    );
+
+    /**
+     * @brief Leave rules of WARNING severity out of execute_rules()
+     */
+    void set_skip_warnings(bool skip) { skip_warnings_ = skip; }
+
+    /**
+     * @brief Forget loaded rules (the next load queries again)
+     */
+    void clear_rules();
+
     /**
      * @brief Execute all active rules against calculation results
      * @param result Calculation results to validate
-     * @param evaluator Formula evaluator (for executing rule formulas)
+     * @param evaluator Formula evaluator (for executing rule formulas; safe to share between threads)
      * @param providers Provider chain with access to current and historical values
      * @param ctx Calculation context
+     * @param memory Where the result vector lives (e.g. the period's core::Arena)
      * @return Vector of rule results (passed/failed with messages)
      */
-    std::vector<ValidationRuleResult> execute_rules(
+    std::pmr::vector<ValidationRuleResult> execute_rules(
         const UnifiedResult& result,
-        core::FormulaEvaluator& evaluator,
+        const core::FormulaEvaluator& evaluator,
         const std::vector<core::IValueProvider*>& providers,
-        const core::Context& ctx
+        const core::Context& ctx,
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource()
     ) const;
 
+    /**
+     * @brief Execute all active rules over a block of result rows at once
+     * @param block Line item columns (e.g. read from a ColumnarResultReader)
+     * @param evaluator Formula evaluator (for compiling rule formulas)
+     * @param max_messages Failure messages kept per rule
+     * @return One result per rule, in rule order
+     *
+     * Each rule is one LaneEvaluator pass with a lane per row; [t-k]
+     * reads the row k before, and rows with fewer earlier rows of their
+     * scenario skip the rule. A rule applies to a row when its required
+     * line items have values there, as in execute_rules(). Messages are
+     * those execute_rules() would give for the row. A rule whose pass
+     * throws (e.g. division by zero in some row) is checked row by row.
+     */
+    std::vector<ColumnRuleResult> execute_rules_columnar(
+        const ResultColumns& block,
+        const core::FormulaEvaluator& evaluator,
+        size_t max_messages = 10
+    ) const;
+
+    /**
+     * @brief Result of a rule whose formula evaluated to a value
+     */
+    static ValidationRuleResult check_rule(const ValidationRule& rule, double value);
+
+    /**
+     * @brief Result of a rule whose formula couldn't be evaluated
+     */
+    static ValidationRuleResult failed_rule(const ValidationRule& rule, const std::string& error);
+
     /**
      * @brief Check if any rules failed with ERROR severity
      * @param rule_results Results from execute_rules
@@ -101,11 +245,43 @@ public:
     /**
      * @brief Get all validation rules loaded
      */
-    const std::vector<ValidationRule>& get_rules() const { return rules_; }
+    const std::vector<ValidationRule>& get_rules() const { return rules_->rules; }
 
 private:
+    /**
+     * @brief How a rule's value is checked
+     */
+    enum class RuleCheck {
+        ZERO,           ///< equation, reconciliation: |value| within tolerance
+        NON_NEGATIVE,   ///< boundary: value not below -tolerance
+        NONE            ///< Other types: always passes
+    };
+
+    /**
+     * @brief Rule resolved against a result layout (compile_rules())
+     */
+    struct CompiledRule {
+        const ValidationRule* rule = nullptr;
+        RuleCheck check = RuleCheck::NONE;
+        std::optional<core::FormulaBinding> binding;    ///< Null if the formula didn't compile
+        std::string compile_error;
+        uint32_t required_size = 0;     ///< Values a result needs for the rule to apply (NO_INDEX: never)
+    };
+
+    /**
+     * @brief Rules of one template
+     */
+    struct TemplateRules {
+        std::vector<ValidationRule> rules;
+        std::shared_ptr<const ResultSchema> schema;     ///< Layout compiled is for (null: not compiled)
+        std::vector<CompiledRule> compiled;
+    };
+
     std::shared_ptr<database::IDatabase> db_;
-    std::vector<ValidationRule> rules_;
+    std::map<std::string, TemplateRules> loaded_;   ///< Template code → rules
+    TemplateRules no_rules_;
+    TemplateRules* rules_;                          ///< Rules of the last loaded template
+    bool skip_warnings_ = false;
 
     /**
      * @brief Check if all required line items exist in result
@@ -115,6 +291,29 @@ private:
         const std::vector<std::string>& required_items
     ) const;
 
+    /**
+     * @brief Result of a rule, passed until checked
+     */
+    static ValidationRuleResult start_result(const ValidationRule& rule);
+
+    /**
+     * @brief Check a rule's value into its result
+     */
+    static void check_value(const ValidationRule& rule, RuleCheck check, double value,
+                            ValidationRuleResult& rule_result);
+
+    static RuleCheck parse_check(const std::string& rule_type);
+
+    /**
+     * @brief Intern the failure message of a rule checked as check
+     */
+    static uint32_t intern_diagnostic(const ValidationRule& rule, RuleCheck check);
+
+    /**
+     * @brief Whether check_value() passes a value
+     */
+    static bool passes(const ValidationRule& rule, RuleCheck check, double value);
+
     /**
      * @brief Parse severity string to enum
      */
@@ -0,0 +1,263 @@
+/**
+ * @file server.h
+ * @brief HTTP endpoints of the engine's server mode
+ *
+ * `scenario_engine --mode server` serves, while the process runs:
+ * - GET /metrics: core::EngineMetrics in Prometheus text format
+ * - GET /health: {"status": "ok", ...} as long as the process answers
+ *
+ * and, with a job queue (set_jobs()), asynchronous scenario runs:
+ * - POST /jobs: run spec (JobSpec::from_json()) → 202 {"job_id": N, ...}
+ * - GET /jobs, GET /jobs/N: job status
+ * - GET /jobs/N/events[?after=K]: progress as Server-Sent Events, streamed
+ *   until the job finished
+ * - DELETE /jobs/N (or POST /jobs/N/cancel): cancel
+ *
+ * and, with what-if sessions (set_sessions()), interactive recalculation:
+ * - POST /sessions: single-run spec → 201 with its statements and a session_id
+ * - POST /sessions/N/drivers: driver edits (DriverEdit::list_from_json())
+ *   → the statements recalculated incrementally from the warm session
+ * - GET /sessions/N: latest statements; DELETE /sessions/N: close
+ *
+ * and, with a staging database and an import directory (set_imports()),
+ * bulk CSV uploads:
+ * - POST /imports: {"file": name of a file in the import directory,
+ *   "table": "staging_...", "replace": true, "delimiter": ",",
+ *   "numeric": {"value": "kEUR"}}
+ *   → the database::CsvImportResult, once the file is loaded
+ *
+ * and, with a results database (set_results()), columnar results for the
+ * dashboard:
+ * - GET /results/N[?line_items=CASH,REVENUE&scenarios=1,4-6&periods=1-12]:
+ *   the columnar file of run_output_snapshot N as an Arrow IPC stream
+ *   (orchestration::ArrowResultStream), streamed one row group at a time
+ * - GET /results/N/fan?line_item=CASH[&quantiles=0.05,0.5,0.95]: quantiles
+ *   across scenarios per period
+ * - GET /results/N/series?line_item=CASH&scenario=S[&points=500]: one
+ *   scenario downsampled (LTTB) to at most that many points
+ * - GET /results/N/yearly?line_item=CASH&scenario=S[&aggregate=sum|last|mean]:
+ *   one scenario per year (years from the period table)
+ * - GET /results/N/diff?base=B[&scenarios=2-9&line_items=CASH&periods=1-12&top=20]:
+ *   each scenario (default: every other one) minus scenario B
+ *   (orchestration::ScenarioDiffer); with top, only the largest deviations
+ *
+ * and, with a template database (set_templates()), static template costs:
+ * - GET /templates/CODE/cost[?scenarios=1,4-6&history=12]: the
+ *   orchestration::TemplateCost of a template as JSON, with the action
+ *   overlays of those scenarios
+ *
+ * Chart views (orchestration::ChartViews) and diffs are JSON, kept in an LRU cache by
+ * request: result files don't change once written.
+ *
+ * The server speaks just enough HTTP/1.1 for scrapers, probes and SSE
+ * clients: one request per connection, answered and closed, each
+ * connection on its own thread. At most set_max_connections() connections
+ * are served at once (the others are answered 503), and a request must
+ * arrive in full within set_request_timeout(). By default the server only listens
+ * on the loopback interface.
+ *
+ * Usage:
+ * @code
+ * web::Server server(8080);
+ * server.set_jobs(std::make_shared<orchestration::JobQueue>(connect, 4, 2));
+ * server.set_sessions(std::make_shared<orchestration::WhatIfSessions>(connect));
+ * server.start();             // Listens on a background thread
+ * ...
+ * server.stop();
+ * @endcode
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace finmodel {
+namespace database {
+    class IDatabase;
+}
+namespace orchestration {
+    class JobQueue;
+    class WhatIfSessions;
+    class ColumnarResultReader;
+    class ChartViewCache;
+    struct ArrowResultQuery;
+}
+}
+
+namespace finmodel {
+namespace web {
+
+/**
+ * @brief Response to one request
+ */
+struct HttpResponse {
+    int status = 200;
+    std::string content_type = "text/plain; charset=utf-8";
+    std::string body;
+};
+
+/**
+ * @brief Listener for the monitoring and job endpoints
+ */
+class Server {
+public:
+    /**
+     * @param port TCP port (0: any free port, see port() after start())
+     * @param address IPv4 address to bind ("0.0.0.0": every interface)
+     */
+    explicit Server(uint16_t port = 8080, std::string address = "127.0.0.1");
+
+    /**
+     * @brief Stops the listener
+     */
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /**
+     * @brief Connections served at once; further ones are answered 503 and closed (default 64)
+     * @throws std::invalid_argument if max_connections is 0
+     */
+    void set_max_connections(size_t max_connections);
+
+    /**
+     * @brief Time a client has to send its whole request, headers and body (default 5 s);
+     *        slower ones are answered 408 and closed
+     */
+    void set_request_timeout(std::chrono::milliseconds timeout) { request_timeout_ = timeout; }
+
+    /**
+     * @brief Serve the /jobs endpoints from a job queue (null: they answer 404)
+     */
+    void set_jobs(std::shared_ptr<orchestration::JobQueue> jobs) { jobs_ = std::move(jobs); }
+
+    /**
+     * @brief Serve the /sessions endpoints from a session store (null: they answer 404)
+     */
+    void set_sessions(std::shared_ptr<orchestration::WhatIfSessions> sessions) { sessions_ = std::move(sessions); }
+
+    using ConnectionFactory = std::function<std::shared_ptr<database::IDatabase>()>;
+
+    /**
+     * @brief Serve POST /imports into the database of connect (null or no directory: it answers 404)
+     * @param import_dir Directory of the files clients may load; a request names a
+     *        file in it, never a path (nothing outside it is read)
+     * @param threads Parsing threads per import, including the request's own (0 or 1: one)
+     */
+    void set_imports(ConnectionFactory connect, std::string import_dir, size_t threads = 1) {
+        imports_ = std::move(connect);
+        import_dir_ = std::move(import_dir);
+        import_threads_ = threads;
+    }
+
+    /**
+     * @brief Serve GET /results from the snapshots in the database of connect (null: it answers 404)
+     * @param cached_views Chart views kept (least recently used evicted first)
+     */
+    void set_results(ConnectionFactory connect, size_t cached_views = 256);
+
+    /**
+     * @brief Serve GET /templates/CODE/cost from the templates in the database of connect (null: it answers 404)
+     */
+    void set_templates(ConnectionFactory connect) { templates_ = std::move(connect); }
+
+    /**
+     * @brief Cache of rendered chart views (null before set_results())
+     */
+    const orchestration::ChartViewCache* chart_cache() const { return charts_.get(); }
+
+    /**
+     * @brief Bind the port (done by start() and run() if not called before)
+     * @throws std::runtime_error if the address can't be bound
+     */
+    void listen();
+
+    /**
+     * @brief Start answering on a background thread
+     * @throws std::runtime_error if the address can't be bound
+     */
+    void start();
+
+    /**
+     * @brief Stop answering, end event streams and join all threads
+     */
+    void stop();
+
+    /**
+     * @brief Answer requests on the calling thread until stop()
+     * @throws std::runtime_error if the address can't be bound
+     */
+    void run();
+
+    /**
+     * @brief Bound port (the chosen one for port 0, once listening)
+     */
+    uint16_t port() const { return port_; }
+
+    /**
+     * @brief Response to a request (routing only, no sockets)
+     * @param method HTTP method
+     * @param path Request target
+     * @param body Request body
+     *
+     * GET /jobs/N/events answers with the events so far instead of a stream,
+     * GET /results/N with the whole Arrow stream.
+     */
+    HttpResponse handle(const std::string& method, const std::string& path, const std::string& body = "") const;
+
+private:
+    HttpResponse handle_jobs(const std::string& method, const std::string& path, const std::string& body) const;
+    HttpResponse handle_sessions(const std::string& method, const std::string& path, const std::string& body) const;
+    HttpResponse handle_imports(const std::string& method, const std::string& body) const;
+    HttpResponse handle_results(const std::string& method, const std::string& path) const;
+    HttpResponse handle_chart(const std::string& path, uint64_t snapshot, const std::string& view) const;
+    HttpResponse handle_diff(const std::string& path, uint64_t snapshot) const;
+    HttpResponse handle_template_cost(const std::string& method, const std::string& path) const;
+
+    /// File of columnar result snapshot N ("" if there is none)
+    std::string result_file(uint64_t snapshot) const;
+
+    /// Result file and query of GET /results/N, or the response refusing it
+    HttpResponse open_results(const std::string& path, std::unique_ptr<orchestration::ColumnarResultReader>& reader,
+                              orchestration::ArrowResultQuery& query) const;
+
+    void serve_until_stopped();
+    void serve(int client);
+
+    /// Write a job's events to the client until it finished or the server stops
+    void stream_events(int client, uint64_t job, uint64_t after);
+
+    /// Write GET /results/N to the client one record batch at a time
+    void stream_results(int client, const std::string& path) const;
+
+    uint16_t port_;
+    std::string address_;
+    int listener_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::shared_ptr<orchestration::JobQueue> jobs_;
+    std::shared_ptr<orchestration::WhatIfSessions> sessions_;
+    ConnectionFactory imports_;
+    std::string import_dir_;
+    size_t import_threads_ = 1;
+    ConnectionFactory results_;
+    std::shared_ptr<orchestration::ChartViewCache> charts_;
+    ConnectionFactory templates_;
+
+    std::mutex connections_mutex_;
+    std::condition_variable connections_done_;
+    size_t connections_ = 0;   ///< Connection threads still running
+    size_t max_connections_ = 64;
+    std::chrono::milliseconds request_timeout_{5000};
+};
+
+} // namespace web
+} // namespace finmodel
@@ -0,0 +1,80 @@
+/**
+ * @file action_catalog.cpp
+ * @brief Loaded and parsed management actions of many scenarios
+ */
+
+#include "actions/action_catalog.h"
+#include "core/formula_evaluator.h"
+#include <sstream>
+
+namespace finmodel {
+namespace actions {
+
+std::shared_ptr<const ActionCatalog> ActionCatalog::load(database::IDatabase& db,
+                                                         const std::vector<int>& scenario_ids) {
+    return std::make_shared<const ActionCatalog>(ActionEngine::query_actions(db, scenario_ids), scenario_ids);
+}
+
+ActionCatalog::ActionCatalog(std::vector<ManagementAction> actions, const std::vector<int>& scenario_ids)
+    : covered_(scenario_ids.begin(), scenario_ids.end())
+    , covers_all_(scenario_ids.empty())
+    , size_(actions.size())
+{
+    core::FormulaEvaluator compiler;
+    for (auto& action : actions) {
+        for (auto* transformations : {&action.financial_transformations, &action.carbon_transformations}) {
+            for (auto& t : *transformations) {
+                t.kind = ActionEngine::kind_of(t);
+                if (t.kind == TransformationKind::FORMULA_OVERRIDE && !t.compiled_formula) {
+                    try {
+                        t.compiled_formula = compiler.compile(t.new_formula);
+                    } catch (const std::exception&) {
+                        // Left to fail where the overlay calculates it
+                    }
+                }
+            }
+        }
+
+        Scenario& scenario = scenarios_[action.scenario_id];
+        scenario.by_code[action.action_code].push_back(scenario.actions.size());
+        std::string action_signature = signature(action);
+        scenario.actions.push_back({std::move(action), std::move(action_signature)});
+    }
+}
+
+bool ActionCatalog::covers(int scenario_id) const {
+    return covers_all_ || covered_.count(scenario_id) != 0;
+}
+
+const std::vector<ActionCatalog::Entry>& ActionCatalog::actions(int scenario_id) const {
+    static const std::vector<Entry> none;
+    auto it = scenarios_.find(scenario_id);
+    return it == scenarios_.end() ? none : it->second.actions;
+}
+
+const std::vector<size_t>& ActionCatalog::find(int scenario_id, const std::string& action_code) const {
+    static const std::vector<size_t> none;
+    auto scenario = scenarios_.find(scenario_id);
+    if (scenario == scenarios_.end()) {
+        return none;
+    }
+    auto it = scenario->second.by_code.find(action_code);
+    return it == scenario->second.by_code.end() ? none : it->second;
+}
+
+std::string ActionCatalog::signature(const ManagementAction& action) {
+    std::ostringstream signature;
+    signature.precision(17);
+    signature << action.start_period << ',' << action.end_period;
+    for (const auto* transformations : {&action.financial_transformations, &action.carbon_transformations}) {
+        for (const auto& t : *transformations) {
+            signature << '|' << t.line_item_code << ',' << t.transformation_type << ',' << t.factor
+                      << ',' << t.amount << ',' << t.new_formula;
+        }
+        signature << ';';
+    }
+    return signature.str();
+}
+
+} // namespace actions
+} // namespace finmodel
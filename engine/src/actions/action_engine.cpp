@@ -22,6 +22,11 @@ ActionEngine::ActionEngine(std::shared_ptr<database::IDatabase> db)
 }
 
 std::vector<ManagementAction> ActionEngine::load_actions(int scenario_id) {
+    return query_actions(*db_, {scenario_id});
+}
+
+std::vector<ManagementAction> ActionEngine::query_actions(database::IDatabase& db,
+                                                          const std::vector<int>& scenario_ids) {
     std::vector<ManagementAction> actions;
 
     std::string sql = R"(
@@ -44,11 +49,21 @@ std::vector<ManagementAction> ActionEngine::load_actions(int scenario_id) {
             ma.action_category
         FROM scenario_action sa
         JOIN management_action ma ON sa.action_code = ma.action_code
-        WHERE sa.scenario_id = :scenario_id
-        ORDER BY sa.start_period, sa.action_code
     )";
 
-    auto result = db_->execute_query(sql, {{"scenario_id", scenario_id}});
+    ParamMap params;
+    if (!scenario_ids.empty()) {
+        sql += "WHERE sa.scenario_id IN (";
+        for (size_t i = 0; i < scenario_ids.size(); ++i) {
+            const std::string name = "scenario_" + std::to_string(i);
+            sql += (i == 0 ? ":" : ", :") + name;
+            params[name] = scenario_ids[i];
+        }
+        sql += ")\n";
+    }
+    sql += "ORDER BY sa.scenario_id, sa.start_period, sa.action_code";
+
+    auto result = db.execute_query(sql, params);
 
     while (result->next()) {
         ManagementAction action;
@@ -139,6 +154,7 @@ std::vector<Transformation> ActionEngine::parse_transformations(const std::strin
                 t.amount = item.value("amount", 0.0);
                 t.new_formula = item.value("new_formula", "");
                 t.comment = item.value("comment", "");
+                t.kind = kind_of(t);
 
                 if (!t.line_item_code.empty() && !t.transformation_type.empty()) {
                     transformations.push_back(t);
@@ -154,6 +170,7 @@ std::vector<Transformation> ActionEngine::parse_transformations(const std::strin
                 t.amount = details.value("amount", 0.0);
                 t.new_formula = details.value("new_formula", "");
                 t.comment = details.value("comment", "");
+                t.kind = kind_of(t);
 
                 if (!t.transformation_type.empty()) {
                     transformations.push_back(t);
@@ -218,6 +235,169 @@ int ActionEngine::apply_actions_to_template(
     return transformations_applied;
 }
 
+std::map<std::string, std::string> ActionEngine::formula_patches(
+    const core::StatementTemplate& base,
+    const std::vector<ManagementAction>& actions,
+    int period_id
+) const {
+    std::map<std::string, std::string> patches;
+
+    auto patch = [&](const Transformation& transformation) {
+        const auto* line_item = base.get_line_item(transformation.line_item_code);
+        if (!line_item) {
+            return;  // Line item doesn't exist in template - skip
+        }
+
+        // Later transformations of a line item wrap the earlier ones
+        auto patched = patches.find(transformation.line_item_code);
+        auto new_formula = transform_formula(
+            transformation.line_item_code,
+            patched != patches.end() ? std::optional<std::string>(patched->second) : line_item->formula,
+            transformation
+        );
+        if (new_formula) {
+            patches[transformation.line_item_code] = std::move(*new_formula);
+        }
+    };
+
+    for (const auto& action : actions) {
+        if (!action.is_active_in_period(period_id)) {
+            continue;
+        }
+        for (const auto& transformation : action.financial_transformations) {
+            patch(transformation);
+        }
+        for (const auto& transformation : action.carbon_transformations) {
+            patch(transformation);
+        }
+    }
+
+    return patches;
+}
+
+std::map<std::string, std::string> ActionEngine::parametric_patches(
+    const core::StatementTemplate& base,
+    const std::vector<ManagementAction>& actions
+) const {
+    std::map<std::string, std::string> patches;
+
+    auto patch = [&](const Transformation& transformation, const std::string& action_code) {
+        const auto* line_item = base.get_line_item(transformation.line_item_code);
+        if (!line_item) {
+            return;  // Line item doesn't exist in template - skip
+        }
+
+        // Later transformations of a line item wrap the earlier ones, as in formula_patches()
+        auto patched = patches.find(transformation.line_item_code);
+        auto new_formula = gated_formula(
+            transformation.line_item_code,
+            patched != patches.end() ? std::optional<std::string>(patched->second) : line_item->formula,
+            transformation,
+            action_code
+        );
+        if (new_formula) {
+            patches[transformation.line_item_code] = std::move(*new_formula);
+        }
+    };
+
+    for (const auto& action : actions) {
+        for (const auto& transformation : action.financial_transformations) {
+            patch(transformation, action.action_code);
+        }
+        for (const auto& transformation : action.carbon_transformations) {
+            patch(transformation, action.action_code);
+        }
+    }
+
+    return patches;
+}
+
+std::optional<std::string> ActionEngine::gated_formula(
+    const std::string& line_item_code,
+    const std::optional<std::string>& formula,
+    const Transformation& transformation,
+    const std::string& action_code
+) {
+    // Without a formula the line item is a driver, as in transform_formula()
+    const std::string base = (formula.has_value() && !formula->empty()) ? "(" + *formula + ")" : line_item_code;
+    const std::string active = "action:" + action_code;
+
+    switch (kind_of(transformation)) {
+        case TransformationKind::FORMULA_OVERRIDE:
+            return "IF(" + active + ", (" + transformation.new_formula + "), " + base + ")";
+        case TransformationKind::MULTIPLY:
+            return base + " * (1 + " + active + " * (" + std::to_string(transformation.factor) + " - 1))";
+        case TransformationKind::ADD:
+            return base + " + " + active + " * (" + std::to_string(transformation.amount) + ")";
+        case TransformationKind::REDUCE:
+            return base + " - " + active + " * (" + std::to_string(transformation.amount) + ")";
+        case TransformationKind::UNKNOWN:
+            break;
+    }
+
+    // Unknown transformation type
+    return std::nullopt;
+}
+
+std::optional<std::string> ActionEngine::transform_formula(
+    const std::string& line_item_code,
+    const std::optional<std::string>& formula,
+    const Transformation& transformation
+) {
+    const bool has_formula = formula.has_value() && !formula->empty();
+
+    switch (kind_of(transformation)) {
+        case TransformationKind::FORMULA_OVERRIDE:
+            // Completely replace the formula
+            return transformation.new_formula;
+
+        case TransformationKind::MULTIPLY:
+            // Wrap existing formula in multiplication
+            if (has_formula) {
+                return "(" + *formula + ") * " + std::to_string(transformation.factor);
+            }
+            // No formula to multiply - treat as driver
+            return line_item_code + " * " + std::to_string(transformation.factor);
+
+        case TransformationKind::ADD:
+            // Add amount to existing formula
+            if (has_formula) {
+                return "(" + *formula + ") + (" + std::to_string(transformation.amount) + ")";
+            }
+            return line_item_code + " + (" + std::to_string(transformation.amount) + ")";
+
+        case TransformationKind::REDUCE:
+            // Subtract amount from existing formula
+            if (has_formula) {
+                return "(" + *formula + ") - (" + std::to_string(transformation.amount) + ")";
+            }
+            return line_item_code + " - (" + std::to_string(transformation.amount) + ")";
+
+        case TransformationKind::UNKNOWN:
+            break;
+    }
+
+    // Unknown transformation type
+    return std::nullopt;
+}
+
+TransformationKind ActionEngine::kind_of(const Transformation& transformation) {
+    if (transformation.kind != TransformationKind::UNKNOWN) {
+        return transformation.kind;
+    }
+    const std::string& type = transformation.transformation_type;
+    if (type == "formula_override") {
+        return TransformationKind::FORMULA_OVERRIDE;
+    } else if (type == "multiply") {
+        return TransformationKind::MULTIPLY;
+    } else if (type == "add") {
+        return TransformationKind::ADD;
+    } else if (type == "reduce") {
+        return TransformationKind::REDUCE;
+    }
+    return TransformationKind::UNKNOWN;
+}
+
 bool ActionEngine::apply_transformation(
     std::shared_ptr<core::StatementTemplate> template_ptr,
     const std::string& line_item_code,
@@ -230,44 +410,14 @@ bool ActionEngine::apply_transformation(
         return false;
     }
 
-    std::string new_formula;
-
-    if (transformation.transformation_type == "formula_override") {
-        // Completely replace the formula
-        new_formula = transformation.new_formula;
-
-    } else if (transformation.transformation_type == "multiply") {
-        // Wrap existing formula in multiplication
-        if (line_item->formula.has_value() && !line_item->formula->empty()) {
-            new_formula = "(" + line_item->formula.value() + ") * " + std::to_string(transformation.factor);
-        } else {
-            // No formula to multiply - treat as driver
-            new_formula = line_item_code + " * " + std::to_string(transformation.factor);
-        }
-
-    } else if (transformation.transformation_type == "add") {
-        // Add amount to existing formula
-        if (line_item->formula.has_value() && !line_item->formula->empty()) {
-            new_formula = "(" + line_item->formula.value() + ") + (" + std::to_string(transformation.amount) + ")";
-        } else {
-            new_formula = line_item_code + " + (" + std::to_string(transformation.amount) + ")";
-        }
-
-    } else if (transformation.transformation_type == "reduce") {
-        // Subtract amount from existing formula
-        if (line_item->formula.has_value() && !line_item->formula->empty()) {
-            new_formula = "(" + line_item->formula.value() + ") - (" + std::to_string(transformation.amount) + ")";
-        } else {
-            new_formula = line_item_code + " - (" + std::to_string(transformation.amount) + ")";
-        }
-
-    } else {
+    auto new_formula = transform_formula(line_item_code, line_item->formula, transformation);
+    if (!new_formula) {
         // Unknown transformation type
         return false;
     }
 
     // Update the line item formula
-    template_ptr->update_line_item_formula(line_item_code, new_formula);
+    template_ptr->update_line_item_formula(line_item_code, *new_formula);
 
     // NOTE: We intentionally do NOT clear base_value_source here.
     // Keeping base_value_source allows the formula to reference driver codes directly.
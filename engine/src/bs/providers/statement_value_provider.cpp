@@ -7,38 +7,292 @@
 #include "core/context.h"
 #include "database/result_set.h"
 #include <stdexcept>
-#include <regex>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <iostream>
 
 namespace finmodel {
 namespace bs {
 
-StatementValueProvider::StatementValueProvider(std::shared_ptr<database::IDatabase> db)
-    : db_(db), entity_id_(""), scenario_id_(0) {
+StatementValueProvider::StatementValueProvider(std::shared_ptr<database::IDatabase> db,
+                                               std::shared_ptr<core::EntityDictionary> entities)
+    : db_(db), entities_(entities), scenario_id_(0), history_(12) {
     if (!db_) {
         throw std::runtime_error("StatementValueProvider: null database pointer");
     }
+    if (!entities_) {
+        entities_ = std::make_shared<core::EntityDictionary>(db_);
+    }
 }
 
 void StatementValueProvider::set_current_values(const std::map<std::string, double>& values) {
-    current_values_ = values;
+    clear_current_values();
+    for (const auto& [code, value] : values) {
+        set_current_slot_value(slot_for(code), value);
+    }
+}
+
+void StatementValueProvider::set_current_value(const std::string& code, double value) {
+    set_current_slot_value(slot_for(code), value);
+}
+
+void StatementValueProvider::set_current_slot_value(int slot, double value) {
+    current_values_[slot] = value;
+    has_current_[slot] = 1;
+}
+
+void StatementValueProvider::clear_current_values() {
+    std::fill(has_current_.begin(), has_current_.end(), 0);
+    for (const auto& window : windows_) {
+        has_current_[window.slot] = window.published;
+    }
 }
 
 void StatementValueProvider::set_opening_values(const std::map<std::string, double>& opening_values) {
-    opening_values_ = opening_values;
+    assign_opening(opening_values);
 }
 
 void StatementValueProvider::set_prior_period_values(const std::map<std::string, double>& prior_values) {
     // Merge into opening_values_ to support [t-1] references for all statement types
-    opening_values_ = prior_values;
+    assign_opening(prior_values);
+}
+
+void StatementValueProvider::assign_opening(const std::map<std::string, double>& values) {
+    std::fill(has_opening_.begin(), has_opening_.end(), 0);
+    for (const auto& [code, value] : values) {
+        int slot = slot_for(code);
+        opening_values_[slot] = value;
+        has_opening_[slot] = 1;
+    }
 }
 
-void StatementValueProvider::set_context(const EntityID& entity_id, ScenarioID scenario_id) {
-    entity_id_ = entity_id;
+void StatementValueProvider::set_context(int entity, ScenarioID scenario_id) {
+    if (entity != entity_ || scenario_id != scenario_id_) {
+        clear_history();  // Recorded periods belong to one entity and scenario
+    }
+    entity_ = entity;
     scenario_id_ = scenario_id;
 }
 
+void StatementValueProvider::begin_period(PeriodID period_id) {
+    for (auto& window : windows_) {
+        if (!window.values.full() || window.values.last_period() != period_id - 1) {
+            seed_window(window, period_id);
+        }
+        current_values_[window.slot] = window.average ? window.values.mean() : window.values.sum();
+        has_current_[window.slot] = 1;
+        window.published = true;
+    }
+}
+
+const core::RollingWindow* StatementValueProvider::window(const std::string& key) const {
+    const int slot = find_slot(key);
+    for (const auto& window : windows_) {
+        if (window.slot == slot && slot != NO_SLOT) {
+            return &window.values;
+        }
+    }
+    return nullptr;
+}
+
+void StatementValueProvider::seed_window(Window& window, PeriodID period_id) {
+    const PeriodID first = period_id - static_cast<PeriodID>(window.values.length());
+    std::vector<double> values(window.values.length(), std::numeric_limits<double>::quiet_NaN());
+    bool missing = false;
+    for (PeriodID period = first; period < period_id; ++period) {
+        double& value = values[static_cast<size_t>(period - first)];
+        if (period == period_id - 1 && has_opening_[window.source]) {
+            value = opening_values_[window.source];
+        } else if (const double* recorded = history_value(window.source, period)) {
+            value = *recorded;
+        } else {
+            missing = true;
+        }
+    }
+
+    // Periods before the run: the entity's actuals, one query for the window
+    if (missing) {
+        ++database_reads_;
+        const EntityID entity_code = (entity_ == core::EntityDictionary::NO_ENTITY) ? EntityID()
+                                                                                    : entities_->code(entity_);
+        try {
+            auto rows = db_->execute_query(
+                "SELECT period_id, value FROM balance_sheet_actuals "
+                "WHERE entity_id = :entity AND scenario_id = :scenario AND line_item_code = :code "
+                "AND period_id >= :first AND period_id < :last",
+                {{"entity", entity_code}, {"scenario", scenario_id_}, {"code", slot_codes_[window.source]},
+                 {"first", first}, {"last", period_id}});
+            while (rows && rows->next()) {
+                double& value = values[static_cast<size_t>(rows->get_int(0) - first)];
+                if (std::isnan(value)) {
+                    value = rows->get_double(1);
+                }
+            }
+        } catch (const std::exception&) {
+            // No actuals table: those periods have no value
+        }
+    }
+
+    window.values.reset();
+    for (PeriodID period = first; period < period_id; ++period) {
+        window.values.push(period, values[static_cast<size_t>(period - first)]);
+    }
+}
+
+void StatementValueProvider::record_period(PeriodID period_id) {
+    for (auto& window : windows_) {
+        window.values.push(period_id, has_current_[window.source] ? current_values_[window.source]
+                                                                  : std::numeric_limits<double>::quiet_NaN());
+    }
+    if (history_.empty()) {
+        return;
+    }
+    auto& entry = history_[static_cast<size_t>(period_id) % history_.size()];
+    entry.recorded = true;
+    entry.period_id = period_id;
+    entry.values.assign(current_values_.begin(), current_values_.end());
+    entry.present.assign(has_current_.begin(), has_current_.end());
+}
+
+void StatementValueProvider::restore_period(PeriodID period_id, const std::map<std::string, double>& values) {
+    for (auto& window : windows_) {
+        auto it = values.find(slot_codes_[window.source]);
+        window.values.push(period_id, it != values.end() ? it->second : std::numeric_limits<double>::quiet_NaN());
+    }
+    if (history_.empty()) {
+        return;
+    }
+    std::vector<int> slots;
+    slots.reserve(values.size());
+    for (const auto& [code, value] : values) {
+        slots.push_back(slot_for(code));
+    }
+    auto& entry = history_[static_cast<size_t>(period_id) % history_.size()];
+    entry.recorded = true;
+    entry.period_id = period_id;
+    entry.values.assign(slot_codes_.size(), 0.0);
+    entry.present.assign(slot_codes_.size(), 0);
+    size_t i = 0;
+    for (const auto& [code, value] : values) {
+        entry.values[slots[i]] = value;
+        entry.present[slots[i++]] = 1;
+    }
+}
+
+void StatementValueProvider::clear_history() {
+    for (auto& entry : history_) {
+        entry.recorded = false;
+    }
+    for (auto& window : windows_) {
+        window.values.reset();
+        window.published = false;
+        has_current_[window.slot] = 0;
+    }
+}
+
+void StatementValueProvider::set_history_depth(size_t periods) {
+    history_.assign(periods, PeriodValues());
+}
+
+const double* StatementValueProvider::history_value(int slot, PeriodID period_id) const {
+    if (history_.empty() || slot == NO_SLOT) {
+        return nullptr;
+    }
+    const auto& entry = history_[static_cast<size_t>(period_id) % history_.size()];
+    if (!entry.recorded || entry.period_id != period_id ||
+        static_cast<size_t>(slot) >= entry.present.size() || !entry.present[slot]) {
+        return nullptr;
+    }
+    return &entry.values[slot];
+}
+
+int StatementValueProvider::slot_for(const std::string& code) {
+    auto it = slot_index_.find(code);
+    if (it != slot_index_.end()) {
+        return it->second;
+    }
+
+    int slot = static_cast<int>(slot_codes_.size());
+    slot_index_.emplace(code, slot);
+    slot_codes_.push_back(code);
+    current_values_.push_back(0.0);
+    has_current_.push_back(0);
+    opening_values_.push_back(0.0);
+    has_opening_.push_back(0);
+    return slot;
+}
+
+int StatementValueProvider::find_slot(const std::string& code) const {
+    auto it = slot_index_.find(code);
+    return (it != slot_index_.end()) ? it->second : NO_SLOT;
+}
+
+int StatementValueProvider::resolve_slot(const std::string& key) {
+    std::string base_name;
+    int time_offset;
+    if (parse_time_series(key, base_name, time_offset)) {
+        // Explicit "[t-k]" keys keep going through get_value()
+        return NO_SLOT;
+    }
+    if (find_slot(key) == NO_SLOT) {
+        if (auto window = core::WindowRef::parse(key)) {
+            const int slot = slot_for(key);
+            windows_.push_back({slot, slot_for(window->code), window->average, core::RollingWindow(window->periods)});
+            return slot;
+        }
+    }
+    return slot_for(key);
+}
+
+bool StatementValueProvider::has_slot_value(int slot) const {
+    return has_current_[slot] || has_opening_[slot];
+}
+
+std::optional<double> StatementValueProvider::find_slot_value(int slot, const core::Context& ctx) const {
+    // Use ctx.time_index to determine which values to prefer
+    // Older periods come from the recorded history when available
+    if (ctx.time_index < -1) {
+        if (const double* value = history_value(slot, ctx.get_effective_period_id())) {
+            return *value;
+        }
+    }
+
+    // If ctx.time_index == -1, use opening values (previous period) first
+    if (ctx.time_index == -1) {
+        if (has_opening_[slot]) return opening_values_[slot];
+        if (has_current_[slot]) return current_values_[slot];
+    } else {
+        // Current period (and fallback for other offsets): current first
+        if (has_current_[slot]) return current_values_[slot];
+        if (has_opening_[slot]) return opening_values_[slot];
+    }
+    return std::nullopt;
+}
+
+double StatementValueProvider::get_slot_value(int slot, const core::Context& ctx) const {
+    if (auto value = find_slot_value(slot, ctx)) {
+        return *value;
+    }
+    throw std::runtime_error("StatementValueProvider: value not found for '" + slot_codes_[slot] + "'");
+}
+
+size_t StatementValueProvider::direct_arrays(int time_index, core::SlotArrays* out) const {
+    // Same preference as get_slot_value(); older periods need the history lookup
+    if (time_index == 0) {
+        out[0] = {&current_values_, &has_current_};
+        out[1] = {&opening_values_, &has_opening_};
+        return 2;
+    }
+    if (time_index == -1) {
+        out[0] = {&opening_values_, &has_opening_};
+        out[1] = {&current_values_, &has_current_};
+        return 2;
+    }
+    return 0;
+}
+
 bool StatementValueProvider::has_value(const std::string& key) const {
     std::string base_name;
     int time_offset;
@@ -51,19 +305,12 @@ bool StatementValueProvider::has_value(const std::string& key) const {
     }
 
     // Simple reference (no explicit time offset)
-    // Check if it's a BS line item we recognize
-    if (current_values_.find(key) != current_values_.end()) {
-        return true;
-    }
-    if (opening_values_.find(key) != opening_values_.end()) {
-        return true;
-    }
-
-    // Not a BS line item we recognize
-    return false;
+    // Check if it's a line item we hold a current or opening value for
+    int slot = find_slot(key);
+    return slot != NO_SLOT && has_slot_value(slot);
 }
 
-double StatementValueProvider::get_value(const std::string& key, const core::Context& ctx) const {
+std::optional<double> StatementValueProvider::find_value(const std::string& key, const core::Context& ctx) const {
     std::string base_name;
     int time_offset;
 
@@ -74,62 +321,62 @@ double StatementValueProvider::get_value(const std::string& key, const core::Con
         // time_offset adjusts relative to that
 
         int target_time_index = ctx.time_index + time_offset;
+        int slot = find_slot(base_name);
 
         if (target_time_index == ctx.time_index) {
-            // Current period: look in current_values_
-            auto it = current_values_.find(base_name);
-            if (it != current_values_.end()) {
-                return it->second;
+            // Current period: look in current values
+            if (slot != NO_SLOT && has_current_[slot]) {
+                return current_values_[slot];
             }
-            throw std::runtime_error("StatementValueProvider: current value not found for '" + base_name + "'");
+            return std::nullopt;
         } else if (target_time_index == ctx.time_index - 1) {
-            // Previous period: look in opening_values_
-            auto it = opening_values_.find(base_name);
-            if (it != opening_values_.end()) {
-                return it->second;
+            // Previous period: look in opening values
+            if (slot != NO_SLOT && has_opening_[slot]) {
+                return opening_values_[slot];
             }
-            throw std::runtime_error("StatementValueProvider: opening value not found for '" + base_name + "'");
+            return std::nullopt;
         } else {
-            // Other time periods: database lookup required
+            // Other time periods: recorded history, else database lookup
             // Create a context with the target time_index to get effective period
             core::Context target_ctx = ctx;
             target_ctx.time_index = target_time_index;
             PeriodID target_period = target_ctx.get_effective_period_id();
-            return fetch_from_database(base_name, target_period);
-        }
-    } else {
-        // Simple reference (no explicit time offset)
-        // Use ctx.time_index to determine which values map to use
-
-        // If ctx.time_index == 0, use current_values_ (current period)
-        // If ctx.time_index == -1, use opening_values_ (previous period)
-        if (ctx.time_index == 0) {
-            // Current period: check current_values_ first
-            auto it = current_values_.find(key);
-            if (it != current_values_.end()) {
-                return it->second;
-            }
-        } else if (ctx.time_index == -1) {
-            // Previous period: check opening_values_
-            auto it = opening_values_.find(key);
-            if (it != opening_values_.end()) {
-                return it->second;
+            if (const double* value = history_value(slot, target_period)) {
+                return *value;
             }
+            return find_in_database(base_name, target_period);
         }
+    }
 
-        // Fall back: check both maps for other time indices
-        auto it = current_values_.find(key);
-        if (it != current_values_.end()) {
-            return it->second;
-        }
+    // Simple reference (no explicit time offset)
+    int slot = find_slot(key);
+    if (slot == NO_SLOT) {
+        return std::nullopt;
+    }
+    return find_slot_value(slot, ctx);
+}
 
-        auto it_opening = opening_values_.find(key);
-        if (it_opening != opening_values_.end()) {
-            return it_opening->second;
-        }
+double StatementValueProvider::get_value(const std::string& key, const core::Context& ctx) const {
+    if (auto value = find_value(key, ctx)) {
+        return *value;
+    }
 
+    // Not found: say where it was looked for
+    std::string base_name;
+    int time_offset;
+    if (!parse_time_series(key, base_name, time_offset)) {
         throw std::runtime_error("StatementValueProvider: value not found for '" + key + "'");
     }
+    if (time_offset == 0) {
+        throw std::runtime_error("StatementValueProvider: current value not found for '" + base_name + "'");
+    }
+    if (time_offset == -1) {
+        throw std::runtime_error("StatementValueProvider: opening value not found for '" + base_name + "'");
+    }
+    core::Context target_ctx = ctx;
+    target_ctx.time_index = ctx.time_index + time_offset;
+    throw std::runtime_error("StatementValueProvider: database lookup failed for '" + base_name +
+                             "' in period " + std::to_string(target_ctx.get_effective_period_id()));
 }
 
 bool StatementValueProvider::parse_time_series(const std::string& key,
@@ -137,46 +384,65 @@ bool StatementValueProvider::parse_time_series(const std::string& key,
                                        int& time_offset) const {
     // Match pattern: "VARIABLE[t+offset]" or "VARIABLE[t-offset]" or "VARIABLE[t]"
     // Examples: "CASH[t-1]", "INVENTORY[t]", "REVENUE[t+1]"
+    // (same grammar as ^([A-Z_]+)\[t([+-]\d+)?\]$, scanned by hand: this runs per lookup)
 
-    std::regex time_series_regex(R"(^([A-Z_]+)\[t([+-]\d+)?\]$)");
-    std::smatch matches;
-
-    if (std::regex_match(key, matches, time_series_regex)) {
-        base_name = matches[1].str();
-
-        if (matches[2].matched) {
-            // Has explicit offset like [t-1] or [t+1]
-            time_offset = std::stoi(matches[2].str());
-        } else {
-            // Just [t] means current period
-            time_offset = 0;
+    const size_t open = key.find('[');
+    if (open == 0 || open == std::string::npos || key.size() < open + 3 ||
+        key[open + 1] != 't' || key.back() != ']') {
+        return false;
+    }
+    for (size_t i = 0; i < open; ++i) {
+        if (!((key[i] >= 'A' && key[i] <= 'Z') || key[i] == '_')) {
+            return false;
         }
+    }
 
-        return true;
+    const size_t close = key.size() - 1;
+    int offset = 0;
+    if (close > open + 2) {
+        // Has explicit offset like [t-1] or [t+1]
+        char sign = key[open + 2];
+        if ((sign != '+' && sign != '-') || close == open + 3) {
+            return false;
+        }
+        for (size_t i = open + 3; i < close; ++i) {
+            if (key[i] < '0' || key[i] > '9') {
+                return false;
+            }
+        }
+        offset = std::stoi(key.substr(open + 2, close - open - 2));
     }
+    // Just [t] means current period
 
-    return false;
+    base_name = key.substr(0, open);
+    time_offset = offset;
+    return true;
 }
 
-double StatementValueProvider::fetch_from_database(const std::string& code,
-                                           PeriodID period_id) const {
+std::optional<double> StatementValueProvider::find_in_database(const std::string& code,
+                                                               PeriodID period_id) const {
+    ++database_reads_;
+
     // Query balance_sheet_actuals for historical value
+    const EntityID entity_code = (entity_ == core::EntityDictionary::NO_ENTITY) ? EntityID()
+                                                                                : entities_->code(entity_);
     std::ostringstream query;
     query << "SELECT value FROM balance_sheet_actuals "
-          << "WHERE entity_id = '" << entity_id_ << "' "
+          << "WHERE entity_id = '" << entity_code << "' "
           << "AND scenario_id = " << scenario_id_ << " "
           << "AND period_id = " << period_id << " "
           << "AND line_item_code = '" << code << "'";
 
     finmodel::ParamMap params;
-    auto result = db_->execute_query(query.str(), params);
-
-    if (result && result->next()) {
-        return result->get_double(0);
+    try {
+        auto result = db_->execute_query(query.str(), params);
+        if (result && result->next()) {
+            return result->get_double(0);
+        }
+    } catch (const database::DatabaseException&) {
+        // No actuals table: nothing to find
     }
-
-    throw std::runtime_error("StatementValueProvider: database lookup failed for '" + code +
-                           "' in period " + std::to_string(period_id));
+    return std::nullopt;
 }
 
 } // namespace bs
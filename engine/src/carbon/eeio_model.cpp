@@ -0,0 +1,208 @@
+/**
+ * @file eeio_model.cpp
+ * @brief Implementation of the EEIO Scope 3 model
+ */
+
+#include "carbon/eeio_model.h"
+#include "database/result_set.h"
+#include "core/eigen_solvers.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace finmodel {
+namespace carbon {
+
+const Scope3Results::Row* Scope3Results::find(const EntityID& entity_id, ScenarioID scenario_id,
+                                              PeriodID period_id) const {
+    auto key = std::tie(entity_id, scenario_id, period_id);
+    auto it = std::lower_bound(rows.begin(), rows.end(), key, [](const Row& row, const auto& k) {
+        return std::tie(row.entity_id, row.scenario_id, row.period_id) < k;
+    });
+    if (it == rows.end() || std::tie(it->entity_id, it->scenario_id, it->period_id) != key) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+double Scope3Results::get(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id,
+                          const std::string& category) const {
+    const Row* row = find(entity_id, scenario_id, period_id);
+    auto it = std::lower_bound(categories.begin(), categories.end(), category);
+    if (!row || it == categories.end() || *it != category) {
+        return 0.0;
+    }
+    return row->emissions[static_cast<size_t>(it - categories.begin())];
+}
+
+EEIOModel EEIOModel::load(database::IDatabase& db) {
+    std::vector<std::string> sectors;
+    std::vector<double> intensities;
+    auto sector_rows = db.execute_query(
+        "SELECT sector_code, direct_intensity FROM eeio_sector ORDER BY sector_code", {});
+    for (auto [code, intensity] : sector_rows->rows<std::string, std::optional<double>>()) {
+        sectors.push_back(std::move(code));
+        intensities.push_back(intensity.value_or(0.0));
+    }
+
+    std::vector<EEIOCoefficient> coefficients;
+    auto coefficient_rows = db.execute_query(
+        "SELECT from_sector, to_sector, coefficient FROM eeio_coefficient", {});
+    for (auto [from, to, coefficient] : coefficient_rows->rows<std::string, std::string, double>()) {
+        coefficients.push_back({std::move(from), std::move(to), coefficient});
+    }
+    return EEIOModel(std::move(sectors), intensities, coefficients);
+}
+
+std::vector<EEIOSpend> EEIOModel::query_spend(database::IDatabase& db, const std::vector<ScenarioID>& scenario_ids) {
+    std::ostringstream query;
+    query << "SELECT entity_id, scenario_id, period_id, sector_code, category, amount FROM eeio_spend";
+    ParamMap params;
+    if (!scenario_ids.empty()) {
+        query << " WHERE scenario_id IN (";
+        for (size_t i = 0; i < scenario_ids.size(); ++i) {
+            const std::string name = "scenario_" + std::to_string(i);
+            query << (i ? ", :" : ":") << name;
+            params[name] = scenario_ids[i];
+        }
+        query << ")";
+    }
+
+    std::vector<EEIOSpend> spend;
+    auto result_set = db.execute_query(query.str(), params);
+    for (auto [entity, scenario_id, period_id, sector, category, amount] :
+         result_set->rows<std::string, int, int, std::string, std::optional<std::string>, double>()) {
+        EEIOSpend row;
+        row.entity_id = std::move(entity);
+        row.scenario_id = scenario_id;
+        row.period_id = period_id;
+        row.sector = std::move(sector);
+        if (category && !category->empty()) {
+            row.category = std::move(*category);
+        }
+        row.amount = amount;
+        spend.push_back(std::move(row));
+    }
+    return spend;
+}
+
+EEIOModel::EEIOModel(std::vector<std::string> sectors, const std::vector<double>& direct_intensity,
+                     const std::vector<EEIOCoefficient>& coefficients)
+    : sectors_(std::move(sectors))
+{
+    if (direct_intensity.size() != sectors_.size()) {
+        throw std::invalid_argument("EEIOModel: " + std::to_string(direct_intensity.size()) +
+                                    " intensities for " + std::to_string(sectors_.size()) + " sectors");
+    }
+    for (size_t i = 0; i < sectors_.size(); ++i) {
+        if (!index_.emplace(sectors_[i], static_cast<int>(i)).second) {
+            throw std::invalid_argument("EEIOModel: duplicate sector " + sectors_[i]);
+        }
+    }
+
+    // (I - A)^T directly: entry (j, i) is -A[i][j]
+    const auto n = static_cast<Eigen::Index>(sectors_.size());
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(coefficients.size() + sectors_.size());
+    for (Eigen::Index i = 0; i < n; ++i) {
+        triplets.emplace_back(i, i, 1.0);
+    }
+    for (const auto& entry : coefficients) {
+        const int from = sector(entry.from_sector);
+        const int to = sector(entry.to_sector);
+        if (from < 0 || to < 0) {
+            throw std::invalid_argument("EEIOModel: coefficient of unknown sector " +
+                                        (from < 0 ? entry.from_sector : entry.to_sector));
+        }
+        triplets.emplace_back(to, from, -entry.coefficient);
+    }
+    Eigen::SparseMatrix<double> leontief(n, n);
+    leontief.setFromTriplets(triplets.begin(), triplets.end());
+    leontief.makeCompressed();
+
+    Eigen::VectorXd direct(n);
+    for (Eigen::Index i = 0; i < n; ++i) {
+        direct[i] = direct_intensity[static_cast<size_t>(i)];
+    }
+    if (n == 0) {
+        total_ = direct;
+        return;
+    }
+
+    Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> solver;
+    solver.compute(leontief);
+    if (solver.info() != Eigen::Success) {
+        throw std::runtime_error("EEIOModel: I - A is singular, the input-output table has no solution");
+    }
+    total_ = solver.solve(direct);
+    if (solver.info() != Eigen::Success) {
+        throw std::runtime_error("EEIOModel: Leontief solve failed");
+    }
+}
+
+int EEIOModel::sector(const std::string& code) const {
+    auto it = index_.find(code);
+    return (it != index_.end()) ? it->second : -1;
+}
+
+Eigen::VectorXd EEIOModel::emissions(const Eigen::SparseMatrix<double>& spend) const {
+    if (spend.rows() != total_.size()) {
+        throw std::invalid_argument("EEIOModel: spend has " + std::to_string(spend.rows()) + " sectors, model " +
+                                    std::to_string(total_.size()));
+    }
+    return spend.transpose() * total_;
+}
+
+Scope3Results EEIOModel::evaluate(const std::vector<EEIOSpend>& spend) const {
+    Scope3Results results;
+
+    // Columns: (entity, scenario, period, category) in the order of the result rows
+    std::map<std::string, size_t> categories;
+    std::map<std::tuple<EntityID, ScenarioID, PeriodID>, size_t> rows;
+    for (const auto& entry : spend) {
+        categories.emplace(entry.category, 0);
+        rows.emplace(std::make_tuple(entry.entity_id, entry.scenario_id, entry.period_id), 0);
+    }
+    for (auto& [category, index] : categories) {
+        index = results.categories.size();
+        results.categories.push_back(category);
+    }
+    results.rows.reserve(rows.size());
+    for (auto& [key, index] : rows) {
+        index = results.rows.size();
+        results.rows.push_back({std::get<0>(key), std::get<1>(key), std::get<2>(key),
+                                std::vector<double>(categories.size(), 0.0)});
+    }
+
+    const size_t width = categories.size();
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(spend.size());
+    for (const auto& entry : spend) {
+        const int row = sector(entry.sector);
+        if (row < 0) {
+            throw std::invalid_argument("EEIOModel: spend of " + entry.entity_id + " in unknown sector " +
+                                        entry.sector);
+        }
+        const size_t column = rows.at(std::make_tuple(entry.entity_id, entry.scenario_id, entry.period_id)) * width +
+                              categories.at(entry.category);
+        triplets.emplace_back(row, static_cast<Eigen::Index>(column), entry.amount);
+    }
+
+    // Duplicate (sector, column) spend adds up
+    Eigen::SparseMatrix<double> matrix(total_.size(), static_cast<Eigen::Index>(results.rows.size() * width));
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    const Eigen::VectorXd emitted = emissions(matrix);
+
+    for (size_t r = 0; r < results.rows.size(); ++r) {
+        for (size_t c = 0; c < width; ++c) {
+            results.rows[r].emissions[c] = emitted[static_cast<Eigen::Index>(r * width + c)];
+        }
+    }
+    return results;
+}
+
+} // namespace carbon
+} // namespace finmodel
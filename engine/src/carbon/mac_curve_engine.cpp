@@ -6,9 +6,11 @@
 #include "carbon/mac_curve_engine.h"
 #include "database/result_set.h"
 #include <algorithm>
+#include <map>
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
+#include <limits>
 
 namespace finmodel {
 namespace carbon {
@@ -51,21 +53,16 @@ double MACCurveEngine::calculate_marginal_cost(
 }
 
 MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
-    MACCurve curve;
-    curve.scenario_id = scenario_id;
-    curve.period_id = period_id;
-    curve.total_reduction_potential = 0.0;
-    curve.total_annual_cost = 0.0;
-    curve.total_capex = 0.0;
-    curve.total_opex = 0.0;
-    curve.negative_cost_count = 0;
-    curve.low_cost_count = 0;
-    curve.medium_cost_count = 0;
-    curve.high_cost_count = 0;
+    return calculate_mac_curves({scenario_id}, {period_id}).front();
+}
 
-    // Query all actions active in this period for this scenario
+std::map<int, std::vector<std::pair<MACPoint, bool>>> MACCurveEngine::load_ranked_points(
+    const std::vector<int>& scenario_ids
+) const {
+    // All actions of the scenarios, in one query
     std::ostringstream query;
     query << "SELECT "
+          << "    sa.scenario_id, "
           << "    sa.action_code, "
           << "    ma.action_name, "
           << "    ma.action_category, "
@@ -76,23 +73,26 @@ MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
           << "    sa.end_period "
           << "FROM scenario_action sa "
           << "JOIN management_action ma ON sa.action_code = ma.action_code "
-          << "WHERE sa.scenario_id = :scenario_id "
-          << "  AND sa.start_period <= :period_id "
-          << "  AND (sa.end_period IS NULL OR sa.end_period >= :period_id) "
-          << "  AND ma.is_active = 1 "
-          << "ORDER BY sa.action_code";
-
+          << "WHERE sa.scenario_id IN (";
     ParamMap params;
-    params["scenario_id"] = scenario_id;
-    params["period_id"] = period_id;
+    for (size_t i = 0; i < scenario_ids.size(); ++i) {
+        const std::string name = "scenario_" + std::to_string(i);
+        query << (i ? ", :" : ":") << name;
+        params[name] = scenario_ids[i];
+    }
+    query << ") "
+          << "  AND sa.start_period IS NOT NULL "
+          << "  AND ma.is_active = 1 "
+          << "ORDER BY sa.scenario_id, sa.action_code";
 
     auto result_set = db_->execute_query(query.str(), params);
 
-    // Build MAC points
-    std::vector<MACPoint> points;
-
+    // Costs and MAC don't depend on the period: computed once per action
+    const double amortization = 1.0 / static_cast<double>(capex_amortization_years_);
+    std::map<int, std::vector<std::pair<MACPoint, bool>>> ranked;   // (point, no end period)
     while (result_set && result_set->next()) {
         MACPoint point;
+        const int scenario_id = result_set->get_int("scenario_id");
         point.action_code = result_set->get_string("action_code");
         point.action_name = result_set->get_string("action_name");
         point.action_category = result_set->get_string("action_category");
@@ -101,15 +101,15 @@ MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
         point.annual_reduction_tco2e = result_set->get_double("emission_reduction_annual");
         point.start_period = result_set->get_int("start_period");
 
-        if (!result_set->is_null("end_period")) {
+        const bool permanent = result_set->is_null("end_period");
+        if (!permanent) {
             point.end_period = result_set->get_int("end_period");
         } else {
             point.end_period = -1;  // Permanent action
         }
 
         // Calculate costs
-        double capex_annual = point.capex / static_cast<double>(capex_amortization_years_);
-        point.total_annual_cost = capex_annual + point.opex_annual;
+        point.total_annual_cost = point.capex * amortization + point.opex_annual;
 
         // Calculate marginal cost
         point.marginal_cost_per_tco2e = calculate_marginal_cost(
@@ -117,6 +117,71 @@ MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
             point.opex_annual,
             point.annual_reduction_tco2e
         );
+        point.cumulative_reduction_tco2e = 0.0;
+
+        ranked[scenario_id].emplace_back(std::move(point), permanent);
+    }
+
+    // Sort by marginal cost (lowest to highest), ties in action code order
+    for (auto& [scenario_id, points] : ranked) {
+        std::stable_sort(points.begin(), points.end(),
+            [](const auto& a, const auto& b) {
+                return a.first.marginal_cost_per_tco2e < b.first.marginal_cost_per_tco2e;
+            });
+    }
+    return ranked;
+}
+
+std::vector<MACCurve> MACCurveEngine::calculate_mac_curves(
+    const std::vector<int>& scenario_ids,
+    const std::vector<int>& period_ids
+) {
+    std::vector<MACCurve> curves;
+    if (scenario_ids.empty() || period_ids.empty()) {
+        return curves;
+    }
+    const auto ranked = load_ranked_points(scenario_ids);
+
+    // Each period's curve: the ranked actions active in it
+    static const std::vector<std::pair<MACPoint, bool>> no_actions;
+    curves.reserve(scenario_ids.size() * period_ids.size());
+    std::vector<const MACPoint*> active;
+    for (int scenario_id : scenario_ids) {
+        auto found = ranked.find(scenario_id);
+        const auto& points = (found != ranked.end()) ? found->second : no_actions;
+        for (int period_id : period_ids) {
+            active.clear();
+            for (const auto& [point, permanent] : points) {
+                if (point.start_period <= period_id && (permanent || point.end_period >= period_id)) {
+                    active.push_back(&point);
+                }
+            }
+            curves.push_back(build_curve(scenario_id, period_id, active));
+        }
+    }
+    return curves;
+}
+
+MACCurve MACCurveEngine::build_curve(
+    int scenario_id,
+    int period_id,
+    const std::vector<const MACPoint*>& ranked
+) {
+    MACCurve curve;
+    curve.scenario_id = scenario_id;
+    curve.period_id = period_id;
+    curve.total_reduction_potential = 0.0;
+    curve.total_annual_cost = 0.0;
+    curve.total_capex = 0.0;
+    curve.total_opex = 0.0;
+    curve.negative_cost_count = 0;
+    curve.low_cost_count = 0;
+    curve.medium_cost_count = 0;
+    curve.high_cost_count = 0;
+
+    double cumulative = 0.0;
+    for (const MACPoint* ranked_point : ranked) {
+        MACPoint point = *ranked_point;
 
         // Update totals
         curve.total_reduction_potential += point.annual_reduction_tco2e;
@@ -135,24 +200,12 @@ MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
             curve.high_cost_count++;
         }
 
-        points.push_back(point);
-    }
-
-    // Sort by marginal cost (lowest to highest)
-    std::sort(points.begin(), points.end(),
-        [](const MACPoint& a, const MACPoint& b) {
-            return a.marginal_cost_per_tco2e < b.marginal_cost_per_tco2e;
-        });
-
-    // Calculate cumulative reductions
-    double cumulative = 0.0;
-    for (auto& point : points) {
+        // Calculate cumulative reductions
         cumulative += point.annual_reduction_tco2e;
         point.cumulative_reduction_tco2e = cumulative;
+        curve.points.push_back(std::move(point));
     }
 
-    curve.points = std::move(points);
-
     // Calculate weighted average cost
     if (curve.total_reduction_potential > 1e-6) {
         curve.weighted_average_cost = curve.total_annual_cost / curve.total_reduction_potential;
@@ -164,40 +217,70 @@ MACCurve MACCurveEngine::calculate_mac_curve(int scenario_id, int period_id) {
 }
 
 void MACCurveEngine::store_mac_curve(const MACCurve& curve) {
-    // Delete existing points for this scenario/period
+    store_mac_curves({curve});
+}
+
+void MACCurveEngine::store_mac_curves(const std::vector<MACCurve>& curves) {
+    // Delete existing points for each scenario/period
     std::ostringstream delete_query;
     delete_query << "DELETE FROM mac_curve_point "
                  << "WHERE scenario_id = :scenario_id AND period_id = :period_id";
 
-    ParamMap delete_params;
-    delete_params["scenario_id"] = curve.scenario_id;
-    delete_params["period_id"] = curve.period_id;
-
-    db_->execute_update(delete_query.str(), delete_params);
-
     // Insert new points
-    for (const auto& point : curve.points) {
-        std::ostringstream insert_query;
-        insert_query << "INSERT INTO mac_curve_point ("
-                     << "    scenario_id, period_id, action_code, "
-                     << "    cumulative_reduction_tco2e, marginal_cost_per_tco2e, "
-                     << "    annual_reduction_tco2e, annual_cost_chf"
-                     << ") VALUES ("
-                     << "    :scenario_id, :period_id, :action_code, "
-                     << "    :cumulative_reduction_tco2e, :marginal_cost_per_tco2e, "
-                     << "    :annual_reduction_tco2e, :annual_cost_chf"
-                     << ")";
-
-        ParamMap params;
-        params["scenario_id"] = curve.scenario_id;
-        params["period_id"] = curve.period_id;
-        params["action_code"] = point.action_code;
-        params["cumulative_reduction_tco2e"] = point.cumulative_reduction_tco2e;
-        params["marginal_cost_per_tco2e"] = point.marginal_cost_per_tco2e;
-        params["annual_reduction_tco2e"] = point.annual_reduction_tco2e;
-        params["annual_cost_chf"] = point.total_annual_cost;
-
-        db_->execute_update(insert_query.str(), params);
+    std::ostringstream insert_query;
+    insert_query << "INSERT INTO mac_curve_point ("
+                 << "    scenario_id, period_id, action_code, "
+                 << "    cumulative_reduction_tco2e, marginal_cost_per_tco2e, "
+                 << "    annual_reduction_tco2e, annual_cost_chf"
+                 << ") VALUES ("
+                 << "    :scenario_id, :period_id, :action_code, "
+                 << "    :cumulative_reduction_tco2e, :marginal_cost_per_tco2e, "
+                 << "    :annual_reduction_tco2e, :annual_cost_chf"
+                 << ")";
+
+    std::vector<ParamMap> deletes;
+    std::vector<ParamMap> rows;
+    deletes.reserve(curves.size());
+    for (const auto& curve : curves) {
+        ParamMap delete_params;
+        delete_params["scenario_id"] = curve.scenario_id;
+        delete_params["period_id"] = curve.period_id;
+        deletes.push_back(std::move(delete_params));
+
+        for (const auto& point : curve.points) {
+            ParamMap params;
+            params["scenario_id"] = curve.scenario_id;
+            params["period_id"] = curve.period_id;
+            params["action_code"] = point.action_code;
+            params["cumulative_reduction_tco2e"] = point.cumulative_reduction_tco2e;
+            params["marginal_cost_per_tco2e"] = point.marginal_cost_per_tco2e;
+            params["annual_reduction_tco2e"] = point.annual_reduction_tco2e;
+            params["annual_cost_chf"] = point.total_annual_cost;
+            rows.push_back(std::move(params));
+        }
+    }
+    if (deletes.empty()) {
+        return;
+    }
+
+    // Replace the curves atomically
+    const bool own_transaction = !db_->in_transaction();
+    if (own_transaction) {
+        db_->begin_transaction();
+    }
+    try {
+        db_->execute_batch(delete_query.str(), deletes);
+        if (!rows.empty()) {
+            db_->execute_batch(insert_query.str(), rows);
+        }
+    } catch (...) {
+        if (own_transaction) {
+            db_->rollback();
+        }
+        throw;
+    }
+    if (own_transaction) {
+        db_->commit();
     }
 }
 
@@ -273,5 +356,411 @@ MACCurve MACCurveEngine::load_mac_curve(int scenario_id, int period_id) {
     return curve;
 }
 
+const MACCurve& MACCurveEngine::cached_mac_curve(int scenario_id, int period_id) {
+    const auto key = std::make_pair(scenario_id, period_id);
+    auto it = cached_curves_.find(key);
+    if (it == cached_curves_.end()) {
+        CachedCurve cached;
+        cached.curve = calculate_mac_curve(scenario_id, period_id);
+        for (size_t i = 0; i < cached.curve.points.size(); ++i) {
+            cached.rank[cached.curve.points[i].action_code] = i;
+        }
+        it = cached_curves_.emplace(key, std::move(cached)).first;
+    }
+    return it->second.curve;
+}
+
+size_t MACCurveEngine::update_action_cost(
+    int scenario_id,
+    const std::string& action_code,
+    double capex,
+    double opex_annual
+) {
+    size_t updated = 0;
+    for (auto it = cached_curves_.lower_bound({scenario_id, std::numeric_limits<int>::min()});
+         it != cached_curves_.end() && it->first.first == scenario_id; ++it) {
+        if (reposition(it->second, action_code, capex, opex_annual)) {
+            ++updated;
+        }
+    }
+    return updated;
+}
+
+void MACCurveEngine::clear_cached_curves() {
+    cached_curves_.clear();
+}
+
+void MACCurveEngine::clear_cached_curves(int scenario_id) {
+    cached_curves_.erase(cached_curves_.lower_bound({scenario_id, std::numeric_limits<int>::min()}),
+                         cached_curves_.upper_bound({scenario_id, std::numeric_limits<int>::max()}));
+}
+
+namespace {
+
+// Cost category counter of a marginal cost (see calculate_mac_curve())
+int& cost_category(MACCurve& curve, double marginal_cost) {
+    if (marginal_cost < 0) {
+        return curve.negative_cost_count;
+    } else if (marginal_cost < 50.0) {
+        return curve.low_cost_count;
+    } else if (marginal_cost < 100.0) {
+        return curve.medium_cost_count;
+    }
+    return curve.high_cost_count;
+}
+
+} // namespace
+
+bool MACCurveEngine::reposition(
+    CachedCurve& cached,
+    const std::string& action_code,
+    double capex,
+    double opex_annual
+) const {
+    // Points are ranked by (marginal cost, action code)
+    MACCurve& curve = cached.curve;
+    auto& points = curve.points;
+    auto before = [](const MACPoint& point, const std::pair<double, const std::string*>& key) {
+        return point.marginal_cost_per_tco2e < key.first ||
+               (point.marginal_cost_per_tco2e == key.first && point.action_code < *key.second);
+    };
+
+    auto found = cached.rank.find(action_code);
+    if (found == cached.rank.end()) {
+        return false;
+    }
+    const size_t from = found->second;
+    MACPoint& point = points[from];
+
+    // Totals and cost categories change by the difference
+    const double annual_cost = capex / static_cast<double>(capex_amortization_years_) + opex_annual;
+    const double marginal_cost = calculate_marginal_cost(capex, opex_annual, point.annual_reduction_tco2e);
+    cost_category(curve, point.marginal_cost_per_tco2e)--;
+    cost_category(curve, marginal_cost)++;
+    curve.total_capex += capex - point.capex;
+    curve.total_opex += opex_annual - point.opex_annual;
+    curve.total_annual_cost += annual_cost - point.total_annual_cost;
+    if (curve.total_reduction_potential > 1e-6) {
+        curve.weighted_average_cost = curve.total_annual_cost / curve.total_reduction_potential;
+    }
+
+    point.capex = capex;
+    point.opex_annual = opex_annual;
+    point.total_annual_cost = annual_cost;
+    point.marginal_cost_per_tco2e = marginal_cost;
+
+    // New rank among the other points (the vector is still ranked without it)
+    const std::pair<double, const std::string*> key(marginal_cost, &action_code);
+    size_t to = static_cast<size_t>(std::lower_bound(points.begin(), points.begin() + from, key, before) -
+                                    points.begin());
+    if (to == from) {
+        to = static_cast<size_t>(std::lower_bound(points.begin() + from + 1, points.end(), key, before) -
+                                 points.begin()) - 1;
+    }
+    if (to < from) {
+        std::rotate(points.begin() + to, points.begin() + from, points.begin() + from + 1);
+    } else if (to > from) {
+        std::rotate(points.begin() + from, points.begin() + from + 1, points.begin() + to + 1);
+    }
+
+    // Ranks and cumulative reductions change only between the old and new rank
+    const size_t first = std::min(from, to);
+    const size_t last = std::max(from, to);
+    double cumulative = (first > 0) ? points[first - 1].cumulative_reduction_tco2e : 0.0;
+    for (size_t i = first; i <= last; ++i) {
+        cumulative += points[i].annual_reduction_tco2e;
+        points[i].cumulative_reduction_tco2e = cumulative;
+        cached.rank[points[i].action_code] = i;
+    }
+    return true;
+}
+
+std::vector<std::string> AbatementPortfolio::action_codes() const {
+    std::vector<std::string> codes;
+    codes.reserve(points.size());
+    for (const auto& point : points) {
+        codes.push_back(point.action_code);
+    }
+    return codes;
+}
+
+namespace {
+
+// Depth-first branch and bound of optimize_portfolio(): item i is taken or
+// not at depth i, items in MAC order so the first portfolios found are the
+// ones the curve would pick
+class PortfolioSearch {
+public:
+    PortfolioSearch(const std::vector<const MACPoint*>& items, const PortfolioOptions& options)
+        : n_(items.size())
+        , periods_(std::max<size_t>(options.period_ids.size(), 1))
+        , budget_(options.capex_budget)
+        , target_(options.target_reduction_tco2e)
+        , tolerance_(1e-9 * std::max(1.0, std::abs(options.target_reduction_tco2e)))
+        , max_nodes_(options.max_nodes)
+        , capex_(n_)
+        , cost_(n_)
+        , reduction_(n_ * periods_, 0.0)
+        , by_yield_(periods_)
+        , by_price_(periods_)
+        , negative_cost_(n_ + 1, 0.0)
+        , negative_capex_(n_ + 1, 0.0)
+        , reached_(periods_, 0.0)
+        , chosen_(n_, 0)
+    {
+        for (size_t i = 0; i < n_; ++i) {
+            const MACPoint& point = *items[i];
+            capex_[i] = point.capex;
+            cost_[i] = point.total_annual_cost;
+            for (size_t p = 0; p < periods_; ++p) {
+                bool active = true;
+                if (!options.period_ids.empty()) {
+                    const int period_id = options.period_ids[p];
+                    active = point.start_period <= period_id && (point.end_period < 0 || point.end_period >= period_id);
+                }
+                reduction_[i * periods_ + p] = active ? point.annual_reduction_tco2e : 0.0;
+            }
+        }
+        for (size_t i = n_; i-- > 0;) {
+            negative_cost_[i] = negative_cost_[i + 1] + std::min(cost_[i], 0.0);
+            negative_capex_[i] = negative_capex_[i + 1] + std::min(capex_[i], 0.0);
+        }
+
+        // Per period: items gaining reduction by reduction per CHF of capex
+        // (free ones first), and those with a cost by cost per tonne
+        for (size_t p = 0; p < periods_; ++p) {
+            for (size_t i = 0; i < n_; ++i) {
+                if (reduction(i, p) <= 0.0) {
+                    continue;
+                }
+                by_yield_[p].push_back(i);
+                if (cost_[i] >= 0.0) {
+                    by_price_[p].push_back(i);
+                }
+            }
+            auto yield = [&](size_t i) {
+                return capex_[i] > 0.0 ? reduction(i, p) / capex_[i] : std::numeric_limits<double>::infinity();
+            };
+            std::stable_sort(by_yield_[p].begin(), by_yield_[p].end(),
+                             [&](size_t a, size_t b) { return yield(a) > yield(b); });
+            std::stable_sort(by_price_[p].begin(), by_price_[p].end(), [&](size_t a, size_t b) {
+                return cost_[a] / reduction(a, p) < cost_[b] / reduction(b, p);
+            });
+        }
+    }
+
+    void run() { visit(0); }
+
+    bool found() const { return found_; }
+    bool limited() const { return limited_; }
+    size_t nodes() const { return nodes_; }
+    const std::vector<uint8_t>& best() const { return best_; }
+
+private:
+    double reduction(size_t i, size_t p) const { return reduction_[i * periods_ + p]; }
+
+    void visit(size_t i) {
+        if (nodes_ >= max_nodes_) {
+            limited_ = true;
+            return;
+        }
+        ++nodes_;
+
+        bool met = true;
+        for (size_t p = 0; p < periods_ && met; ++p) {
+            met = reached_[p] >= target_ - tolerance_;
+        }
+        if (met && (!found_ || cost_used_ < best_cost_)) {
+            found_ = true;
+            best_cost_ = cost_used_;
+            best_ = chosen_;
+        }
+        if (i == n_ || !promising(i)) {
+            return;
+        }
+
+        if (capex_used_ + capex_[i] + negative_capex_[i + 1] <= budget_) {
+            take(i, 1.0);
+            visit(i + 1);
+            take(i, -1.0);
+        }
+        visit(i + 1);
+    }
+
+    void take(size_t i, double sign) {
+        chosen_[i] = sign > 0.0;
+        capex_used_ += sign * capex_[i];
+        cost_used_ += sign * cost_[i];
+        for (size_t p = 0; p < periods_; ++p) {
+            reached_[p] += sign * reduction(i, p);
+        }
+    }
+
+    // Whether items i.. can still give a feasible portfolio cheaper than the best
+    bool promising(size_t i) const {
+        const double available = budget_ - capex_used_ - negative_capex_[i];
+        if (available < 0.0) {
+            return false;
+        }
+        double cover = 0.0;   // Largest fractional cost of closing a period's gap
+        for (size_t p = 0; p < periods_; ++p) {
+            const double gap = target_ - tolerance_ - reached_[p];
+            if (gap <= 0.0) {
+                continue;
+            }
+
+            // Fractional knapsack: the most the remaining budget can still reduce
+            double gain = 0.0;
+            double budget = available;
+            for (size_t j : by_yield_[p]) {
+                if (j < i) {
+                    continue;
+                }
+                if (capex_[j] <= 0.0) {
+                    gain += reduction(j, p);
+                } else if (budget > 0.0) {
+                    const double share = std::min(1.0, budget / capex_[j]);
+                    gain += share * reduction(j, p);
+                    budget -= share * capex_[j];
+                }
+            }
+            if (gain < gap) {
+                return false;
+            }
+
+            // Actions with savings close the gap for free; the rest at their cost per tonne
+            double remaining = gap;
+            for (size_t j : by_yield_[p]) {
+                if (j >= i && cost_[j] < 0.0) {
+                    remaining -= reduction(j, p);
+                }
+            }
+            double cost = 0.0;
+            for (size_t j : by_price_[p]) {
+                if (remaining <= 0.0) {
+                    break;
+                }
+                if (j < i) {
+                    continue;
+                }
+                const double share = std::min(1.0, remaining / reduction(j, p));
+                cost += share * cost_[j];
+                remaining -= share * reduction(j, p);
+            }
+            cover = std::max(cover, cost);
+        }
+        return !found_ || cost_used_ + negative_cost_[i] + cover < best_cost_;
+    }
+
+    const size_t n_;
+    const size_t periods_;
+    const double budget_;
+    const double target_;
+    const double tolerance_;
+    const size_t max_nodes_;
+
+    std::vector<double> capex_;
+    std::vector<double> cost_;
+    std::vector<double> reduction_;                 ///< Item × period
+    std::vector<std::vector<size_t>> by_yield_;
+    std::vector<std::vector<size_t>> by_price_;
+    std::vector<double> negative_cost_;             ///< Suffix sums of savings
+    std::vector<double> negative_capex_;            ///< Suffix sums of negative capex
+
+    double capex_used_ = 0.0;
+    double cost_used_ = 0.0;
+    std::vector<double> reached_;
+    std::vector<uint8_t> chosen_;
+
+    bool found_ = false;
+    bool limited_ = false;
+    double best_cost_ = 0.0;
+    std::vector<uint8_t> best_;
+    size_t nodes_ = 0;
+};
+
+} // namespace
+
+AbatementPortfolio MACCurveEngine::optimize_portfolio(int scenario_id, const PortfolioOptions& options) {
+    std::vector<MACPoint> points;
+    auto ranked = load_ranked_points({scenario_id});
+    for (auto& [point, permanent] : ranked[scenario_id]) {
+        points.push_back(std::move(point));
+    }
+    AbatementPortfolio portfolio = optimize_portfolio(points, options);
+    portfolio.scenario_id = scenario_id;
+    return portfolio;
+}
+
+AbatementPortfolio MACCurveEngine::optimize_portfolio(const std::vector<MACPoint>& points,
+                                                      const PortfolioOptions& options) {
+    if (options.capex_budget < 0.0) {
+        throw std::invalid_argument("MACCurveEngine: capex budget must not be negative");
+    }
+
+    std::vector<const MACPoint*> items;
+    items.reserve(points.size());
+    for (const auto& point : points) {
+        items.push_back(&point);
+    }
+    std::stable_sort(items.begin(), items.end(), [](const MACPoint* a, const MACPoint* b) {
+        return a->marginal_cost_per_tco2e < b->marginal_cost_per_tco2e;
+    });
+
+    PortfolioSearch search(items, options);
+    search.run();
+
+    AbatementPortfolio portfolio;
+    portfolio.feasible = search.found();
+    portfolio.optimal = !search.limited();
+    portfolio.target_reduction_tco2e = options.target_reduction_tco2e;
+    portfolio.period_ids = options.period_ids;
+    portfolio.reductions.assign(std::max<size_t>(options.period_ids.size(), 1), 0.0);
+    portfolio.nodes = search.nodes();
+    if (!portfolio.feasible) {
+        return portfolio;
+    }
+
+    double cumulative = 0.0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!search.best()[i]) {
+            continue;
+        }
+        MACPoint point = *items[i];
+        cumulative += point.annual_reduction_tco2e;
+        point.cumulative_reduction_tco2e = cumulative;
+        portfolio.total_capex += point.capex;
+        portfolio.total_annual_cost += point.total_annual_cost;
+        for (size_t p = 0; p < portfolio.reductions.size(); ++p) {
+            if (options.period_ids.empty()) {
+                portfolio.reductions[p] += point.annual_reduction_tco2e;
+            } else {
+                const int period_id = options.period_ids[p];
+                if (point.start_period <= period_id && (point.end_period < 0 || point.end_period >= period_id)) {
+                    portfolio.reductions[p] += point.annual_reduction_tco2e;
+                }
+            }
+        }
+        portfolio.points.push_back(std::move(point));
+    }
+    return portfolio;
+}
+
+bool MACCurveEngine::verify_portfolio(AbatementPortfolio& portfolio, const PortfolioRun& run, double tolerance) {
+    portfolio.verified_reductions = run(portfolio.action_codes());
+    const size_t expected = std::max<size_t>(portfolio.period_ids.size(), 1);
+    if (portfolio.verified_reductions.size() != expected) {
+        throw std::invalid_argument("MACCurveEngine: verification returned " +
+                                    std::to_string(portfolio.verified_reductions.size()) + " reductions for " +
+                                    std::to_string(expected) + " target periods");
+    }
+
+    const double target = portfolio.target_reduction_tco2e;
+    const double shortfall = tolerance * std::max(1.0, std::abs(target));
+    portfolio.verified = std::all_of(portfolio.verified_reductions.begin(), portfolio.verified_reductions.end(),
+                                     [&](double reduction) { return reduction >= target - shortfall; });
+    return portfolio.verified;
+}
+
 } // namespace carbon
 } // namespace finmodel
@@ -0,0 +1,57 @@
+#include "core/arena.h"
+#include <algorithm>
+
+namespace finmodel {
+namespace core {
+
+Arena::Arena(size_t initial_bytes) : initial_bytes_(std::max<size_t>(initial_bytes, 64)) {}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) {
+        total += block.size;
+    }
+    return total;
+}
+
+void Arena::add_block(size_t size) {
+    blocks_.push_back({std::make_unique<std::byte[]>(size), size});
+    ++heap_allocations_;
+}
+
+void Arena::reset() {
+    // Grown past one block: one block of the total serves the next period
+    if (blocks_.size() > 1) {
+        const size_t total = capacity();
+        blocks_.clear();
+        add_block(total);
+    }
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    if (blocks_.empty()) {
+        add_block(std::max(initial_bytes_, bytes + alignment));
+    }
+    while (true) {
+        Block& block = blocks_[current_];
+        const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        const size_t start = ((base + offset_ + alignment - 1) & ~(uintptr_t{alignment} - 1)) - base;
+        if (start + bytes <= block.size) {
+            offset_ = start + bytes;
+            used_ += bytes;
+            return block.data.get() + start;
+        }
+        // Next block (kept from before a reset), or a new one twice the last
+        if (current_ + 1 == blocks_.size()) {
+            add_block(std::max(block.size * 2, bytes + alignment));
+        }
+        ++current_;
+        offset_ = 0;
+    }
+}
+
+} // namespace core
+} // namespace finmodel
@@ -6,7 +6,7 @@
 #include "core/dependency_graph.h"
 #include <stdexcept>
 #include <algorithm>
-#include <queue>
+#include <numeric>
 #include <sstream>
 
 namespace finmodel {
@@ -16,185 +16,402 @@ namespace core {
 // Public Interface
 // ============================================================================
 
-void DependencyGraph::add_node(const std::string& code) {
-    nodes_.insert(code);
-    // Initialize adjacency list entry if not exists
-    if (adjacency_.find(code) == adjacency_.end()) {
-        adjacency_[code] = std::set<std::string>();
+uint32_t DependencyGraph::add_node(const std::string& code) {
+    return add_node(SymbolTable::global().intern(code));
+}
+
+uint32_t DependencyGraph::add_node(Symbol symbol) {
+    auto [it, inserted] = ids_.emplace(symbol, static_cast<uint32_t>(symbols_.size()));
+    if (inserted) {
+        symbols_.push_back(symbol);
     }
+    return it->second;
 }
 
 void DependencyGraph::add_edge(const std::string& from, const std::string& to) {
     // Add both nodes to ensure they exist
-    add_node(from);
-    add_node(to);
+    uint32_t from_id = add_node(from);
+    uint32_t to_id = add_node(to);
 
     // Add edge: from depends on to
-    adjacency_[from].insert(to);
+    add_edge(from_id, to_id);
+}
+
+void DependencyGraph::add_edge(uint32_t from, uint32_t to) {
+    edges_.emplace_back(from, to);
+}
+
+uint32_t DependencyGraph::find_node(const std::string& code) const {
+    Symbol symbol = SymbolTable::global().find(code);
+    return (symbol != NO_SYMBOL) ? find_node(symbol) : NO_NODE;
+}
+
+uint32_t DependencyGraph::find_node(Symbol symbol) const {
+    auto it = ids_.find(symbol);
+    return (it != ids_.end()) ? it->second : NO_NODE;
 }
 
 std::vector<std::string> DependencyGraph::get_dependencies(const std::string& code) const {
-    auto it = adjacency_.find(code);
-    if (it == adjacency_.end()) {
+    uint32_t id = find_node(code);
+    if (id == NO_NODE) {
         return {};
     }
 
-    return std::vector<std::string>(it->second.begin(), it->second.end());
+    std::vector<std::string> dependencies;
+    for (const auto& [from, to] : edges_) {
+        if (from == id) {
+            dependencies.push_back(node_code(to));
+        }
+    }
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    return dependencies;
 }
 
 std::vector<std::string> DependencyGraph::get_all_nodes() const {
-    return std::vector<std::string>(nodes_.begin(), nodes_.end());
+    std::vector<std::string> nodes;
+    nodes.reserve(symbols_.size());
+    for (uint32_t id = 0; id < symbols_.size(); ++id) {
+        nodes.push_back(node_code(id));
+    }
+    std::sort(nodes.begin(), nodes.end());
+    return nodes;
 }
 
 std::vector<std::string> DependencyGraph::topological_sort() const {
-    // Check for cycles first
-    if (has_cycles()) {
-        auto cycle = find_cycle();
+    std::vector<std::string> result;
+    result.reserve(symbols_.size());
+    for (uint32_t id : topological_order()) {
+        result.push_back(node_code(id));
+    }
+    return result;
+}
+
+std::vector<uint32_t> DependencyGraph::topological_order() const {
+    Csr csr = build_csr();
+    std::vector<uint32_t> order = kahn_order(csr);
+
+    // Nodes left over are on or behind a cycle
+    if (order.size() != symbols_.size()) {
+        auto cycle = find_cycle_ids(csr);
         std::ostringstream oss;
         oss << "Circular dependency detected: ";
         for (size_t i = 0; i < cycle.size(); ++i) {
             if (i > 0) oss << " → ";
-            oss << cycle[i];
+            oss << node_code(cycle[i]);
         }
         throw std::runtime_error(oss.str());
     }
 
-    // Kahn's algorithm for topological sort
-    std::vector<std::string> result;
-    std::map<std::string, int> in_degree;
-
-    // Initialize in-degree for all nodes
-    for (const auto& node : nodes_) {
-        in_degree[node] = 0;
+    for (auto& node : order) {
+        node = csr.node_of_rank[node];
     }
+    return order;
+}
 
-    // Calculate in-degree (number of dependencies each node has)
-    // adjacency_[from] = {to1, to2} means "from depends on to1, to2"
-    // So from's in-degree = size of its dependency set
-    for (const auto& [node, dependencies] : adjacency_) {
-        in_degree[node] = dependencies.size();
+std::vector<std::vector<std::string>> DependencyGraph::topological_levels() const {
+    // Level = 1 + deepest dependency; the sort lists dependencies first
+    Csr csr = build_csr();
+    std::vector<uint32_t> order = kahn_order(csr);
+    if (order.size() != symbols_.size()) {
+        topological_order();  // Throws with the cycle
     }
 
-    // Queue of nodes with no dependencies (in-degree = 0)
-    std::queue<std::string> ready;
-    for (const auto& [node, degree] : in_degree) {
-        if (degree == 0) {
-            ready.push(node);
+    std::vector<uint32_t> level_of(order.size(), 0);
+    std::vector<std::vector<uint32_t>> rank_levels;
+    for (uint32_t rank : order) {
+        uint32_t level = 0;
+        for (uint32_t e = csr.dependency_offsets[rank]; e < csr.dependency_offsets[rank + 1]; ++e) {
+            level = std::max(level, level_of[csr.dependencies[e]] + 1);
+        }
+        level_of[rank] = level;
+        if (level >= rank_levels.size()) {
+            rank_levels.resize(level + 1);
         }
+        rank_levels[level].push_back(rank);
     }
 
-    // Process nodes in dependency order
-    while (!ready.empty()) {
-        std::string node = ready.front();
-        ready.pop();
-        result.push_back(node);
-
-        // For each node that depends on the current node,
-        // decrease its in-degree (one dependency satisfied)
-        for (const auto& [other_node, dependencies] : adjacency_) {
-            // If other_node depends on current node
-            if (dependencies.find(node) != dependencies.end()) {
-                in_degree[other_node]--;
+    // Ranks are in code order, so sorting them sorts each level by code
+    std::vector<std::vector<std::string>> levels(rank_levels.size());
+    for (size_t l = 0; l < rank_levels.size(); ++l) {
+        std::sort(rank_levels[l].begin(), rank_levels[l].end());
+        for (uint32_t rank : rank_levels[l]) {
+            levels[l].push_back(node_code(csr.node_of_rank[rank]));
+        }
+    }
+    return levels;
+}
 
-                // If all dependencies satisfied, add to ready queue
-                if (in_degree[other_node] == 0) {
-                    ready.push(other_node);
+std::vector<std::vector<std::string>> DependencyGraph::strongly_connected_components() const {
+    const Csr csr = build_csr();
+    const uint32_t n = static_cast<uint32_t>(csr.node_of_rank.size());
+    constexpr uint32_t UNSET = UINT32_MAX;
+
+    // Tarjan: a component is complete when its root's low link is its own
+    // index; components come out dependencies first
+    std::vector<uint32_t> index(n, UNSET);
+    std::vector<uint32_t> low(n, 0);
+    std::vector<uint8_t> on_stack(n, 0);
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> component_of(n, UNSET);
+    std::vector<std::vector<uint32_t>> components;
+    std::vector<std::pair<uint32_t, uint32_t>> path;  // Node and its next dependency to visit
+    uint32_t next_index = 0;
+    auto visit = [&](uint32_t rank) {
+        index[rank] = low[rank] = next_index++;
+        stack.push_back(rank);
+        on_stack[rank] = 1;
+        path.emplace_back(rank, csr.dependency_offsets[rank]);
+    };
+    for (uint32_t root = 0; root < n; ++root) {
+        if (index[root] != UNSET) {
+            continue;
+        }
+        visit(root);
+        while (!path.empty()) {
+            auto& [rank, next] = path.back();
+            if (next < csr.dependency_offsets[rank + 1]) {
+                const uint32_t dependency = csr.dependencies[next++];
+                if (index[dependency] == UNSET) {
+                    visit(dependency);
+                } else if (on_stack[dependency]) {
+                    low[rank] = std::min(low[rank], index[dependency]);
                 }
+                continue;
+            }
+
+            const uint32_t done = rank;
+            path.pop_back();
+            if (!path.empty()) {
+                low[path.back().first] = std::min(low[path.back().first], low[done]);
+            }
+            if (low[done] == index[done]) {
+                std::vector<uint32_t> component;
+                uint32_t member = UNSET;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = 0;
+                    component_of[member] = static_cast<uint32_t>(components.size());
+                    component.push_back(member);
+                } while (member != done);
+                std::sort(component.begin(), component.end());
+                components.push_back(std::move(component));
             }
         }
     }
 
-    // If we processed all nodes, we have valid topological order
-    if (result.size() != nodes_.size()) {
-        throw std::runtime_error("Failed to compute topological sort (internal error)");
+    // Kahn's algorithm over the components, seeded and expanded in rank
+    // order as kahn_order() (so single nodes come out in the same order)
+    std::vector<uint32_t> in_degree(components.size(), 0);
+    for (uint32_t rank = 0; rank < n; ++rank) {
+        for (uint32_t e = csr.dependency_offsets[rank]; e < csr.dependency_offsets[rank + 1]; ++e) {
+            if (component_of[csr.dependencies[e]] != component_of[rank]) {
+                ++in_degree[component_of[rank]];
+            }
+        }
+    }
+    std::vector<uint32_t> order;  // Doubles as the ready queue
+    order.reserve(components.size());
+    for (uint32_t rank = 0; rank < n; ++rank) {
+        const uint32_t c = component_of[rank];
+        if (components[c].front() == rank && in_degree[c] == 0) {
+            order.push_back(c);
+        }
+    }
+    for (size_t head = 0; head < order.size(); ++head) {
+        const uint32_t c = order[head];
+        for (uint32_t rank : components[c]) {
+            for (uint32_t e = csr.dependent_offsets[rank]; e < csr.dependent_offsets[rank + 1]; ++e) {
+                const uint32_t dependent = component_of[csr.dependents[e]];
+                if (dependent != c && --in_degree[dependent] == 0) {
+                    order.push_back(dependent);
+                }
+            }
+        }
     }
 
-    return result;
-}
+    std::vector<std::vector<std::string>> result;
+    result.reserve(order.size());
+    std::vector<uint32_t> left;  // Dependencies within the component not placed yet
+    for (uint32_t c : order) {
+        const auto& members = components[c];
+        std::vector<std::string> codes;
+        codes.reserve(members.size());
+        if (members.size() == 1) {
+            codes.push_back(node_code(csr.node_of_rank[members.front()]));
+            result.push_back(std::move(codes));
+            continue;
+        }
 
-bool DependencyGraph::has_cycles() const {
-    std::set<std::string> visiting;  // Nodes in current DFS path (gray)
-    std::set<std::string> visited;   // Fully processed nodes (black)
-    std::vector<std::string> path;   // Current path (for cycle detection)
-
-    // Try DFS from each unvisited node
-    for (const auto& node : nodes_) {
-        if (visited.find(node) == visited.end()) {
-            if (dfs_has_cycle(node, visiting, visited, path)) {
-                return true;
+        // Greedy: next the member with the fewest dependencies left (then by code)
+        left.assign(members.size(), 0);
+        auto position = [&](uint32_t rank) {
+            return static_cast<size_t>(std::lower_bound(members.begin(), members.end(), rank) - members.begin());
+        };
+        for (size_t i = 0; i < members.size(); ++i) {
+            const uint32_t rank = members[i];
+            for (uint32_t e = csr.dependency_offsets[rank]; e < csr.dependency_offsets[rank + 1]; ++e) {
+                left[i] += (component_of[csr.dependencies[e]] == c) ? 1 : 0;
+            }
+        }
+        std::vector<uint8_t> placed(members.size(), 0);
+        for (size_t step = 0; step < members.size(); ++step) {
+            size_t best = members.size();
+            for (size_t i = 0; i < members.size(); ++i) {
+                if (!placed[i] && (best == members.size() || left[i] < left[best])) {
+                    best = i;
+                }
+            }
+            placed[best] = 1;
+            const uint32_t rank = members[best];
+            codes.push_back(node_code(csr.node_of_rank[rank]));
+            for (uint32_t e = csr.dependent_offsets[rank]; e < csr.dependent_offsets[rank + 1]; ++e) {
+                if (component_of[csr.dependents[e]] == c) {
+                    --left[position(csr.dependents[e])];
+                }
             }
         }
+        result.push_back(std::move(codes));
     }
+    return result;
+}
 
-    return false;
+bool DependencyGraph::has_cycles() const {
+    return kahn_order(build_csr()).size() != symbols_.size();
 }
 
 std::vector<std::string> DependencyGraph::find_cycle() const {
-    std::set<std::string> visiting;
-    std::set<std::string> visited;
-    std::vector<std::string> path;
-
-    // Try DFS from each unvisited node
-    for (const auto& node : nodes_) {
-        if (visited.find(node) == visited.end()) {
-            path.clear();
-            if (dfs_has_cycle(node, visiting, visited, path)) {
-                // path now contains the cycle
-                return path;
-            }
-        }
+    std::vector<std::string> cycle;
+    for (uint32_t id : find_cycle_ids(build_csr())) {
+        cycle.push_back(node_code(id));
     }
-
-    return {};  // No cycle found
+    return cycle;
 }
 
 void DependencyGraph::clear() {
-    nodes_.clear();
-    adjacency_.clear();
+    symbols_.clear();
+    ids_.clear();
+    edges_.clear();
 }
 
 // ============================================================================
 // Private Methods
 // ============================================================================
 
-bool DependencyGraph::dfs_has_cycle(
-    const std::string& node,
-    std::set<std::string>& visiting,
-    std::set<std::string>& visited,
-    std::vector<std::string>& path
-) const {
-    // If already fully processed, no cycle through this node
-    if (visited.find(node) != visited.end()) {
-        return false;
-    }
-
-    // If we're currently visiting this node, we found a cycle!
-    if (visiting.find(node) != visiting.end()) {
-        // Add node again to show cycle completion
-        path.push_back(node);
-        return true;
-    }
-
-    // Mark as currently visiting (gray)
-    visiting.insert(node);
-    path.push_back(node);
-
-    // Visit all dependencies
-    auto it = adjacency_.find(node);
-    if (it != adjacency_.end()) {
-        for (const auto& dependency : it->second) {
-            if (dfs_has_cycle(dependency, visiting, visited, path)) {
-                return true;
+DependencyGraph::Csr DependencyGraph::build_csr() const {
+    const uint32_t n = static_cast<uint32_t>(symbols_.size());
+    Csr csr;
+
+    // Rank nodes by code so orderings don't depend on insertion order
+    csr.node_of_rank.resize(n);
+    std::iota(csr.node_of_rank.begin(), csr.node_of_rank.end(), 0u);
+    std::sort(csr.node_of_rank.begin(), csr.node_of_rank.end(),
+              [this](uint32_t a, uint32_t b) { return node_code(a) < node_code(b); });
+    std::vector<uint32_t> rank_of(n);
+    for (uint32_t rank = 0; rank < n; ++rank) {
+        rank_of[csr.node_of_rank[rank]] = rank;
+    }
+
+    // Sorted, duplicate-free edges in rank space
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(edges_.size());
+    for (const auto& [from, to] : edges_) {
+        edges.emplace_back(rank_of[from], rank_of[to]);
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    csr.dependency_offsets.assign(n + 1, 0);
+    csr.dependent_offsets.assign(n + 1, 0);
+    for (const auto& [from, to] : edges) {
+        ++csr.dependency_offsets[from + 1];
+        ++csr.dependent_offsets[to + 1];
+    }
+    for (uint32_t rank = 0; rank < n; ++rank) {
+        csr.dependency_offsets[rank + 1] += csr.dependency_offsets[rank];
+        csr.dependent_offsets[rank + 1] += csr.dependent_offsets[rank];
+    }
+
+    // Edges are sorted by (from, to), so both lists come out sorted
+    csr.dependencies.resize(edges.size());
+    csr.dependents.resize(edges.size());
+    std::vector<uint32_t> next_dependent(csr.dependent_offsets.begin(), csr.dependent_offsets.end() - 1);
+    for (size_t e = 0; e < edges.size(); ++e) {
+        csr.dependencies[e] = edges[e].second;
+        csr.dependents[next_dependent[edges[e].second]++] = edges[e].first;
+    }
+    return csr;
+}
+
+std::vector<uint32_t> DependencyGraph::kahn_order(const Csr& csr) const {
+    const uint32_t n = static_cast<uint32_t>(csr.node_of_rank.size());
+
+    // In-degree = number of dependencies each node has
+    std::vector<uint32_t> in_degree(n);
+    std::vector<uint32_t> order;  // Doubles as the ready queue
+    order.reserve(n);
+    for (uint32_t rank = 0; rank < n; ++rank) {
+        in_degree[rank] = csr.dependency_offsets[rank + 1] - csr.dependency_offsets[rank];
+        if (in_degree[rank] == 0) {
+            order.push_back(rank);
+        }
+    }
+
+    // For each node that depends on the current node, one dependency is satisfied
+    for (size_t head = 0; head < order.size(); ++head) {
+        uint32_t rank = order[head];
+        for (uint32_t e = csr.dependent_offsets[rank]; e < csr.dependent_offsets[rank + 1]; ++e) {
+            if (--in_degree[csr.dependents[e]] == 0) {
+                order.push_back(csr.dependents[e]);
             }
         }
     }
+    return order;
+}
 
-    // Done visiting this node - mark as visited (black)
-    visiting.erase(node);
-    visited.insert(node);
-    path.pop_back();
+std::vector<uint32_t> DependencyGraph::find_cycle_ids(const Csr& csr) const {
+    enum : uint8_t { WHITE, GRAY, BLACK };  // Unvisited, on the DFS path, done
+    const uint32_t n = static_cast<uint32_t>(csr.node_of_rank.size());
+    std::vector<uint8_t> color(n, WHITE);
 
-    return false;
+    // DFS path: node and its next dependency to visit
+    std::vector<std::pair<uint32_t, uint32_t>> path;
+    for (uint32_t root = 0; root < n; ++root) {
+        if (color[root] != WHITE) {
+            continue;
+        }
+        color[root] = GRAY;
+        path.emplace_back(root, csr.dependency_offsets[root]);
+
+        while (!path.empty()) {
+            auto& [rank, next] = path.back();
+            if (next == csr.dependency_offsets[rank + 1]) {
+                color[rank] = BLACK;
+                path.pop_back();
+                continue;
+            }
+
+            uint32_t dependency = csr.dependencies[next++];
+            if (color[dependency] == GRAY) {
+                // Cycle: from the dependency's place on the path back to it
+                std::vector<uint32_t> cycle;
+                auto start = std::find_if(path.begin(), path.end(),
+                                          [dependency](const auto& entry) { return entry.first == dependency; });
+                for (auto it = start; it != path.end(); ++it) {
+                    cycle.push_back(csr.node_of_rank[it->first]);
+                }
+                cycle.push_back(csr.node_of_rank[dependency]);
+                return cycle;
+            }
+            if (color[dependency] == WHITE) {
+                color[dependency] = GRAY;
+                path.emplace_back(dependency, csr.dependency_offsets[dependency]);
+            }
+        }
+    }
+
+    return {};  // No cycle found
 }
 
 } // namespace core
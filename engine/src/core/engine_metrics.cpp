@@ -0,0 +1,246 @@
+#include "core/engine_metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <sstream>
+#include <sys/resource.h>
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+using Counter = EngineMetrics::Counter;
+
+/// Bucket b covers [lower, upper) nanoseconds
+void bucket_bounds(size_t bucket, double& lower, double& upper) {
+    if (bucket < 8) {
+        lower = static_cast<double>(bucket);
+        upper = lower + 1.0;
+        return;
+    }
+    const int exponent = static_cast<int>((bucket - 8) / 8) + 3;
+    const double step = std::ldexp(1.0, exponent - 3);
+    lower = static_cast<double>(8 + (bucket - 8) % 8) * step;
+    upper = lower + step;
+}
+
+void counter(std::ostringstream& out, const char* name, const char* help, double value) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " counter\n" << name << ' ' << value << '\n';
+}
+
+void gauge(std::ostringstream& out, const char* name, const char* help, double value) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " gauge\n" << name << ' ' << value << '\n';
+}
+
+double ratio(uint64_t hits, uint64_t misses) {
+    return (hits + misses > 0) ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+}
+
+/// Difference of counters summed from different shards (may briefly run ahead of each other)
+uint64_t difference(uint64_t a, uint64_t b) {
+    return (a > b) ? a - b : 0;
+}
+
+double process_cpu_seconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+} // namespace
+
+uint64_t EngineMetrics::Snapshot::calculations() const {
+    uint64_t total = 0;
+    for (uint64_t count : latency) {
+        total += count;
+    }
+    return total;
+}
+
+double EngineMetrics::Snapshot::latency_quantile(double q) const {
+    const uint64_t total = calculations();
+    if (total == 0) {
+        return 0.0;
+    }
+    // Smallest bucket holding the ceil(q * total)-th calculation
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * total)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += latency[bucket];
+        if (seen >= rank) {
+            double lower = 0.0;
+            double upper = 0.0;
+            bucket_bounds(bucket, lower, upper);
+            return (lower + upper) * 0.5e-9;
+        }
+    }
+    return 0.0;
+}
+
+EngineMetrics& EngineMetrics::global() {
+    // Never destroyed: threads exiting after main() still fold their shards in
+    static EngineMetrics* metrics = new EngineMetrics();
+    return *metrics;
+}
+
+namespace {
+// Created during static initialisation: uptime counts from process start
+[[maybe_unused]] const EngineMetrics& startup_metrics = EngineMetrics::global();
+}
+
+EngineMetrics::EngineMetrics()
+    : started_(std::chrono::steady_clock::now()), last_scrape_time_(started_) {}
+
+EngineMetrics::~EngineMetrics() = default;
+
+size_t EngineMetrics::latency_bucket(uint64_t nanoseconds) {
+    if (nanoseconds < 8) {
+        return static_cast<size_t>(nanoseconds);
+    }
+    const int exponent = std::bit_width(nanoseconds) - 1;   // >= 3
+    const size_t bucket = 8 + static_cast<size_t>(exponent - 3) * 8 + ((nanoseconds >> (exponent - 3)) & 7);
+    return std::min(bucket, LATENCY_BUCKETS - 1);
+}
+
+void EngineMetrics::record_calculate(uint64_t nanoseconds) {
+    Shard& shard = local();
+    auto& bucket = shard.latency[latency_bucket(nanoseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    auto& total = shard.counters[static_cast<size_t>(Counter::CALCULATE_NANOSECONDS)];
+    total.store(total.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+
+    EngineMetrics& metrics = global();
+    if (metrics.first_calculate_ns_.load(std::memory_order_relaxed) == 0) {
+        uint64_t none = 0;
+        metrics.first_calculate_ns_.compare_exchange_strong(
+            none, std::max<uint64_t>(1, elapsed_nanoseconds(metrics.started_)), std::memory_order_relaxed);
+    }
+}
+
+EngineMetrics::Shard& EngineMetrics::attach(LocalShard& holder) {
+    EngineMetrics& metrics = global();
+    auto shard = std::make_unique<Shard>();
+    holder.shard = shard.get();
+    std::lock_guard<std::mutex> lock(metrics.mutex_);
+    metrics.shards_.push_back(std::move(shard));
+    return *holder.shard;
+}
+
+EngineMetrics::LocalShard::~LocalShard() {
+    if (!shard) {
+        return;
+    }
+    EngineMetrics& metrics = global();
+    std::lock_guard<std::mutex> lock(metrics.mutex_);
+    metrics.add_shard(*shard, metrics.retired_);
+    auto& shards = metrics.shards_;
+    shards.erase(std::find_if(shards.begin(), shards.end(),
+                              [this](const std::unique_ptr<Shard>& s) { return s.get() == shard; }));
+}
+
+void EngineMetrics::add_shard(const Shard& shard, Snapshot& into) const {
+    for (size_t i = 0; i < COUNTERS; ++i) {
+        into.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        into.latency[i] += shard.latency[i].load(std::memory_order_relaxed);
+    }
+}
+
+EngineMetrics::Snapshot EngineMetrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Snapshot snapshot = retired_;
+    for (const auto& shard : shards_) {
+        add_shard(*shard, snapshot);
+    }
+    snapshot.uptime_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+    snapshot.first_calculate_seconds = static_cast<double>(first_calculate_ns_.load(std::memory_order_relaxed)) * 1e-9;
+    return snapshot;
+}
+
+std::string EngineMetrics::prometheus_text() {
+    const Snapshot now = snapshot();
+    Snapshot last;
+    double interval = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto time = std::chrono::steady_clock::now();
+        last = last_scrape_;
+        interval = std::chrono::duration<double>(time - last_scrape_time_).count();
+        last_scrape_ = now;
+        last_scrape_time_ = time;
+    }
+    auto rate = [&](Counter c) { return (interval > 0.0) ? static_cast<double>(now[c] - last[c]) / interval : 0.0; };
+    auto seconds = [&](Counter c) { return static_cast<double>(now[c]) * 1e-9; };
+
+    const uint64_t workers = difference(now[Counter::WORKERS_STARTED], now[Counter::WORKERS_STOPPED]);
+    const double busy = static_cast<double>(now[Counter::TASK_NANOSECONDS] - last[Counter::TASK_NANOSECONDS]) * 1e-9;
+    const double utilisation = (workers > 0 && interval > 0.0)
+        ? std::min(1.0, busy / (static_cast<double>(workers) * interval)) : 0.0;
+
+    std::ostringstream out;
+    out.precision(12);
+    gauge(out, "finmodel_uptime_seconds", "Seconds since the engine started", now.uptime_seconds);
+    gauge(out, "finmodel_first_calculate_seconds", "Seconds from process start to the first calculated period",
+          now.first_calculate_seconds);
+
+    counter(out, "finmodel_scenarios_total", "Scenario runs finished", static_cast<double>(now[Counter::SCENARIOS]));
+    counter(out, "finmodel_periods_total", "Periods calculated", static_cast<double>(now[Counter::PERIODS]));
+    counter(out, "finmodel_line_items_total", "Line item values calculated", static_cast<double>(now[Counter::LINE_ITEMS]));
+    gauge(out, "finmodel_scenarios_per_second", "Scenario runs per second since the last scrape", rate(Counter::SCENARIOS));
+    gauge(out, "finmodel_periods_per_second", "Periods per second since the last scrape", rate(Counter::PERIODS));
+    gauge(out, "finmodel_line_items_per_second", "Line items per second since the last scrape", rate(Counter::LINE_ITEMS));
+
+    out << "# HELP finmodel_calculate_latency_seconds Latency of UnifiedEngine::calculate\n"
+        << "# TYPE finmodel_calculate_latency_seconds summary\n";
+    for (const char* q : {"0.5", "0.95", "0.99"}) {
+        out << "finmodel_calculate_latency_seconds{quantile=\"" << q << "\"} " << now.latency_quantile(std::stod(q)) << '\n';
+    }
+    out << "finmodel_calculate_latency_seconds_sum " << seconds(Counter::CALCULATE_NANOSECONDS) << '\n'
+        << "finmodel_calculate_latency_seconds_count " << now.calculations() << '\n';
+
+    counter(out, "finmodel_template_cache_hits_total", "Template loads served from the cache",
+            static_cast<double>(now[Counter::TEMPLATE_CACHE_HITS]));
+    counter(out, "finmodel_template_cache_misses_total", "Template loads parsed from the database",
+            static_cast<double>(now[Counter::TEMPLATE_CACHE_MISSES]));
+    gauge(out, "finmodel_template_cache_hit_ratio", "Template cache hits over all template loads",
+          ratio(now[Counter::TEMPLATE_CACHE_HITS], now[Counter::TEMPLATE_CACHE_MISSES]));
+    counter(out, "finmodel_statement_cache_hits_total", "Prepared statements reused",
+            static_cast<double>(now[Counter::STATEMENT_CACHE_HITS]));
+    counter(out, "finmodel_statement_cache_misses_total", "Statements prepared",
+            static_cast<double>(now[Counter::STATEMENT_CACHE_MISSES]));
+    gauge(out, "finmodel_statement_cache_hit_ratio", "Prepared statement cache hits over all statements",
+          ratio(now[Counter::STATEMENT_CACHE_HITS], now[Counter::STATEMENT_CACHE_MISSES]));
+    counter(out, "finmodel_result_cache_hits_total", "Scenario runs read from the result cache",
+            static_cast<double>(now[Counter::RESULT_CACHE_HITS]));
+    counter(out, "finmodel_result_cache_misses_total", "Fingerprinted scenario runs calculated",
+            static_cast<double>(now[Counter::RESULT_CACHE_MISSES]));
+    counter(out, "finmodel_result_spilled_scenarios_total", "Scenario results spilled to disk by a memory budget",
+            static_cast<double>(now[Counter::RESULT_SPILLED_SCENARIOS]));
+    counter(out, "finmodel_result_spilled_bytes_total", "In-memory bytes of the scenario results spilled to disk",
+            static_cast<double>(now[Counter::RESULT_SPILLED_BYTES]));
+
+    counter(out, "finmodel_db_seconds_total", "Wall time preparing and stepping SQLite statements",
+            seconds(Counter::DB_NANOSECONDS));
+    counter(out, "finmodel_calculate_seconds_total", "Wall time inside UnifiedEngine::calculate",
+            seconds(Counter::CALCULATE_NANOSECONDS));
+    counter(out, "process_cpu_seconds_total", "User and system CPU time of the process", process_cpu_seconds());
+
+    gauge(out, "finmodel_task_queue_depth", "TaskScheduler tasks queued and not started",
+          static_cast<double>(difference(now[Counter::TASKS_QUEUED], now[Counter::TASKS_STARTED])));
+    gauge(out, "finmodel_workers", "TaskScheduler workers alive", static_cast<double>(workers));
+    gauge(out, "finmodel_result_queue_depth", "ResultWriter jobs queued and not stored yet",
+          static_cast<double>(difference(now[Counter::RESULT_JOBS_QUEUED], now[Counter::RESULT_JOBS_WRITTEN])));
+    counter(out, "finmodel_result_queue_stalls_total", "Hand-offs to a ResultWriter that waited for queue space",
+            static_cast<double>(now[Counter::RESULT_QUEUE_STALLS]));
+    counter(out, "finmodel_result_queue_stall_seconds_total", "Time calculation threads waited for ResultWriter queue space",
+            seconds(Counter::RESULT_STALL_NANOSECONDS));
+    gauge(out, "finmodel_worker_utilization", "Share of worker time spent running tasks since the last scrape",
+          utilisation);
+    return out.str();
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,53 @@
+/**
+ * @file entity_dictionary.cpp
+ * @brief Entity code interning implementation
+ */
+
+#include "core/entity_dictionary.h"
+#include "database/idatabase.h"
+#include "database/result_set.h"
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+EntityDictionary::EntityDictionary(std::shared_ptr<database::IDatabase> db) : db_(std::move(db)) {
+    reload();
+}
+
+void EntityDictionary::reload() {
+    if (!db_) {
+        return;
+    }
+
+    std::unique_ptr<ResultSet> result_set;
+    try {
+        result_set = db_->execute_query("SELECT entity_id, code FROM entity ORDER BY entity_id", {});
+    } catch (const std::exception&) {
+        return;  // No entity table: codes are interned on use
+    }
+
+    while (result_set && result_set->next()) {
+        int id = intern(result_set->get_string(1));
+        database_ids_[id] = result_set->get_int64(0);
+    }
+}
+
+int EntityDictionary::intern(const EntityID& code) {
+    auto [it, inserted] = index_.emplace(code, static_cast<int>(codes_.size()));
+    if (inserted) {
+        codes_.push_back(code);
+        database_ids_.push_back(-1);
+    }
+    return it->second;
+}
+
+std::optional<int64_t> EntityDictionary::database_id(int id) const {
+    if (id < 0 || static_cast<size_t>(id) >= database_ids_.size() || database_ids_[id] < 0) {
+        return std::nullopt;
+    }
+    return database_ids_[id];
+}
+
+} // namespace core
+} // namespace finmodel
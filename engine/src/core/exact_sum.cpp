@@ -0,0 +1,99 @@
+#include "core/exact_sum.h"
+#include <cmath>
+#include <utility>
+
+namespace finmodel {
+namespace core {
+
+void ExactSum::add(double value) {
+    if (!std::isfinite(value)) {
+        special_ += value;
+        return;
+    }
+
+    // Two-sum against each partial, keeping the non-zero rounding errors
+    size_t kept = 0;
+    for (double partial : partials_) {
+        double x = value;
+        double y = partial;
+        if (std::abs(x) < std::abs(y)) {
+            std::swap(x, y);
+        }
+        const double hi = x + y;
+        if (!std::isfinite(hi)) {
+            special_ += hi;
+            partials_.clear();
+            return;
+        }
+        const double lo = y - (hi - x);
+        if (lo != 0.0) {
+            partials_[kept++] = lo;
+        }
+        value = hi;
+    }
+    partials_.resize(kept);
+    partials_.push_back(value);
+}
+
+void ExactSum::add_product(double a, double b) {
+    const double hi = a * b;
+    if (!std::isfinite(hi)) {
+        special_ += hi;
+        return;
+    }
+    add(hi);
+    add(std::fma(a, b, -hi));
+}
+
+void ExactSum::merge(const ExactSum& other) {
+    if (&other == this) {
+        const ExactSum copy = other;
+        merge(copy);
+        return;
+    }
+    special_ += other.special_;
+    for (double partial : other.partials_) {
+        add(partial);
+    }
+}
+
+double ExactSum::value() const {
+    if (special_ != 0.0 || std::isnan(special_)) {
+        return special_;
+    }
+    size_t n = partials_.size();
+    if (n == 0) {
+        return 0.0;
+    }
+
+    // Add from the largest part down until the rest can't change the rounding
+    double hi = partials_[--n];
+    double lo = 0.0;
+    while (n > 0) {
+        const double x = hi;
+        const double y = partials_[--n];
+        hi = x + y;
+        lo = y - (hi - x);
+        if (lo != 0.0) {
+            break;
+        }
+    }
+
+    // hi + lo was a tie rounded to even: the parts below decide the direction
+    if (n > 0 && ((lo < 0.0 && partials_[n - 1] < 0.0) || (lo > 0.0 && partials_[n - 1] > 0.0))) {
+        const double y = lo * 2.0;
+        const double x = hi + y;
+        if (y == x - hi) {
+            hi = x;
+        }
+    }
+    return hi;
+}
+
+void ExactSum::clear() {
+    partials_.clear();
+    special_ = 0.0;
+}
+
+} // namespace core
+} // namespace finmodel
@@ -4,17 +4,20 @@
  */
 
 #include "core/formula_evaluator.h"
+#include "core/formula_optimizer.h"
+#include "core/formula_parser.h"
 #include <cmath>
 #include <stdexcept>
 #include <sstream>
 #include <set>
 #include <algorithm>
+#include <mutex>
 
 namespace finmodel {
 namespace core {
 
 FormulaEvaluator::FormulaEvaluator()
-    : pos_(0)
+    : functions_(FunctionRegistry::builtins())
 {
 }
 
@@ -28,583 +31,368 @@ double FormulaEvaluator::evaluate(
     const std::string& formula,
     const std::vector<IValueProvider*>& providers,
     const Context& ctx,
-    std::function<double(const std::string&, const std::vector<double>&)> custom_functions
-) {
-    formula_ = formula;
-    pos_ = 0;
-    providers_ = providers;
-    ctx_ = ctx;
-    custom_functions_ = custom_functions;
+    CustomFunctionHandler custom_functions
+) const {
+    auto compiled = compile(formula);
+    return evaluate(*compiled, providers, ctx, custom_functions);
+}
+
+std::shared_ptr<const CompiledFormula> FormulaEvaluator::compile(const std::string& formula) const {
+    {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+        auto cached = compiled_cache_.find(formula);
+        if (cached != compiled_cache_.end()) {
+            return cached->second;
+        }
+    }
 
-    if (formula_.empty()) {
+    if (formula.empty()) {
         throw std::runtime_error("Empty formula");
     }
 
-    double result = parse_expression();
+    // All parse state lives in the parser, so threads compile independently
+    auto compiled = std::make_shared<CompiledFormula>();
+    compiled->source_ = formula;
+    FormulaParser(compiled->source_, *compiled, functions_).parse();
 
-    // Ensure we consumed entire formula
-    skip_whitespace();
-    if (pos_ < formula_.length()) {
-        std::ostringstream oss;
-        oss << "Unexpected characters after expression at position " << pos_
-            << ": '" << formula_.substr(pos_) << "'";
-        throw std::runtime_error(oss.str());
-    }
+    FormulaOptimizer::fold_constants(*compiled);
 
-    return result;
+    // Another thread may have compiled the same text meanwhile; keep the first
+    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+    auto [it, inserted] = compiled_cache_.emplace(formula, std::move(compiled));
+    return it->second;
 }
 
-std::vector<std::string> FormulaEvaluator::extract_dependencies(const std::string& formula) {
-    std::set<std::string> deps_set;  // Use set to avoid duplicates
-    formula_ = formula;
-    pos_ = 0;
+size_t FormulaEvaluator::cache_size() const {
+    std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+    return compiled_cache_.size();
+}
 
-    if (formula_.empty()) {
-        return {};
-    }
+void FormulaEvaluator::clear_cache() {
+    std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+    compiled_cache_.clear();
+}
+
+double FormulaEvaluator::evaluate(
+    const CompiledFormula& compiled,
+    const std::vector<IValueProvider*>& providers,
+    const Context& ctx,
+    const CustomFunctionHandler& custom_functions,
+    SubexpressionCache* shared_values
+) const {
+    const auto& vars = compiled.variables();
+    return execute(
+        compiled,
+        [&](uint32_t index) { return get_variable_value(vars[index], providers, ctx); },
+        custom_functions,
+        shared_values
+    );
+}
 
-    // Parse and collect all identifiers
-    while (pos_ < formula_.length()) {
-        skip_whitespace();
+double FormulaEvaluator::evaluate(
+    const FormulaBinding& bound,
+    const Context& ctx,
+    const CustomFunctionHandler& custom_functions,
+    SubexpressionCache* shared_values
+) const {
+    return execute(
+        bound.formula(),
+        [&](uint32_t index) { return get_bound_value(bound, index, ctx); },
+        custom_functions,
+        shared_values
+    );
+}
 
-        if (pos_ >= formula_.length()) break;
+// ============================================================================
+// Interpreter
+// ============================================================================
 
-        // Skip string literals
-        if (formula_[pos_] == '"' || formula_[pos_] == '\'') {
-            char quote = formula_[pos_++];
-            while (pos_ < formula_.length() && formula_[pos_] != quote) {
-                pos_++;
+template <typename LoadVar>
+double FormulaEvaluator::execute(
+    const CompiledFormula& compiled,
+    LoadVar&& load_var,
+    const CustomFunctionHandler& custom_functions,
+    SubexpressionCache* shared_values
+) {
+    // Small formulas run entirely on the native stack
+    constexpr size_t kInlineStack = 32;
+    double inline_stack[kInlineStack] = {};
+    std::vector<double> heap_stack;
+    double* stack = inline_stack;
+    if (compiled.max_stack_depth() > kInlineStack) {
+        heap_stack.resize(compiled.max_stack_depth());
+        stack = heap_stack.data();
+    }
+
+    size_t sp = 0;  // Next free stack slot
+
+    const auto& code = compiled.code();
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+                stack[sp++] = compiled.constants()[ins.operand];
+                break;
+            case OpCode::LOAD_VAR:
+                stack[sp++] = load_var(ins.operand);
+                break;
+            case OpCode::NEG:
+                stack[sp - 1] = -stack[sp - 1];
+                break;
+            case OpCode::ADD:
+                --sp;
+                stack[sp - 1] += stack[sp];
+                break;
+            case OpCode::SUB:
+                --sp;
+                stack[sp - 1] -= stack[sp];
+                break;
+            case OpCode::MUL:
+                --sp;
+                stack[sp - 1] *= stack[sp];
+                break;
+            case OpCode::DIV:
+                --sp;
+                if (stack[sp] == 0.0) {
+                    std::ostringstream oss;
+                    oss << "Division by zero at position " << ins.position;
+                    throw std::runtime_error(oss.str());
+                }
+                stack[sp - 1] /= stack[sp];
+                break;
+            case OpCode::POW:
+                --sp;
+                stack[sp - 1] = std::pow(stack[sp - 1], stack[sp]);
+                break;
+            case OpCode::CMP_LT:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] < stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CMP_LE:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] <= stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CMP_GT:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] > stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CMP_GE:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] >= stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CMP_EQ:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] == stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CMP_NE:
+                --sp;
+                stack[sp - 1] = (stack[sp - 1] != stack[sp]) ? 1.0 : 0.0;
+                break;
+            case OpCode::CALL_BUILTIN: {
+                const auto& call = compiled.functions()[ins.operand];
+                sp -= call.arg_count;
+                stack[sp] = call.builtin(stack + sp, call.arg_count);
+                ++sp;
+                break;
             }
-            if (pos_ < formula_.length()) {
-                pos_++;  // skip closing quote
+            case OpCode::CALL: {
+                const auto& call = compiled.functions()[ins.operand];
+                sp -= call.arg_count;
+                stack[sp] = call_function(call, stack + sp, custom_functions);
+                ++sp;
+                break;
             }
-            continue;
-        }
-
-        if (is_alpha(formula_[pos_])) {
-            std::string identifier = read_identifier();
-
-            // Check if it's a function call
-            skip_whitespace();
-            if (pos_ < formula_.length() && formula_[pos_] == '(') {
-                // It's a function - recursively extract deps from arguments
-                int depth = 1;
-                pos_++; // skip '('
-                size_t arg_start = pos_;
-
-                while (depth > 0 && pos_ < formula_.length()) {
-                    if (formula_[pos_] == '(') depth++;
-                    else if (formula_[pos_] == ')') depth--;
-
-                    if (depth > 0) {
-                        pos_++;
-                    }
+            case OpCode::TAX_COMPUTE: {
+                const auto& call = compiled.functions()[ins.operand];
+                if (!custom_functions) {
+                    throw std::runtime_error("TAX_COMPUTE requires custom function handler");
                 }
-
-                // Extract dependencies from function arguments
-                std::string args = formula_.substr(arg_start, pos_ - arg_start);
-                if (!args.empty()) {
-                    auto arg_deps = extract_dependencies(args);
-                    for (const auto& dep : arg_deps) {
-                        deps_set.insert(dep);
-                    }
+                // Strategy name is carried in the call name ("TAX_COMPUTE:<strategy>")
+                std::vector<double> args = {stack[sp - 1]};
+                stack[sp - 1] = custom_functions(call.name, args);
+                break;
+            }
+            case OpCode::MEMO_CHECK:
+                if (shared_values && shared_values->has(ins.operand)) {
+                    stack[sp++] = shared_values->get(ins.operand);
+                    pc = ins.target - 1;  // Loop increment lands on target
                 }
-
-                if (pos_ < formula_.length() && formula_[pos_] == ')') {
-                    pos_++;  // skip ')'
+                break;
+            case OpCode::MEMO_STORE:
+                if (shared_values) {
+                    shared_values->set(ins.operand, stack[sp - 1]);
                 }
-                continue;
-            }
-
-            // Check for time reference [t-1]
-            bool is_time_shifted = false;
-            if (pos_ < formula_.length() && formula_[pos_] == '[') {
-                is_time_shifted = true;
-                pos_++; // skip '['
-                while (pos_ < formula_.length() && formula_[pos_] != ']') {
-                    pos_++;
+                break;
+            case OpCode::JUMP:
+                pc = ins.target - 1;
+                break;
+            case OpCode::JUMP_IF_FALSE:
+                --sp;
+                if (stack[sp] == 0.0) {
+                    pc = ins.target - 1;
                 }
-                if (pos_ < formula_.length() && formula_[pos_] == ']') {
-                    pos_++;
+                break;
+            case OpCode::SHORT_AND:
+                if (stack[sp - 1] == 0.0) {
+                    stack[sp - 1] = 0.0;
+                    pc = ins.target - 1;
+                } else {
+                    --sp;
                 }
-            }
-
-            // Add to dependencies
-            // Skip "driver:" references - they fetch from scenario_drivers table,
-            // not from calculated line item values, so they're not true dependencies
-            if (identifier.length() > 7 && identifier.substr(0, 7) == "driver:") {
-                continue;  // Skip driver references in dependency graph
-            }
-
-            // For time-shifted references, we mark them specially with "[t-1]" suffix
-            // so the dependency graph can distinguish inter-period from intra-period deps
-            if (is_time_shifted) {
-                deps_set.insert(identifier + "[t-1]");
-            } else {
-                deps_set.insert(identifier);
-            }
-        } else {
-            pos_++;
-        }
-    }
-
-    // Convert set to vector
-    return std::vector<std::string>(deps_set.begin(), deps_set.end());
-}
-
-// ============================================================================
-// Recursive Descent Parser
-// ============================================================================
-
-double FormulaEvaluator::parse_expression() {
-    return parse_comparison();
-}
-
-double FormulaEvaluator::parse_comparison() {
-    double left = parse_arithmetic();
-
-    skip_whitespace();
-    char c = peek();
-
-    // Check for comparison operators
-    if (c == '<' || c == '>' || c == '=' || c == '!') {
-        std::string op;
-        op += next();  // consume first character
-
-        // Check for two-character operators (<=, >=, ==, !=)
-        skip_whitespace();
-        if (peek() == '=') {
-            op += next();
-        }
-
-        double right = parse_arithmetic();
-
-        // Evaluate comparison (return 1.0 for true, 0.0 for false)
-        if (op == "<") {
-            return (left < right) ? 1.0 : 0.0;
-        } else if (op == "<=") {
-            return (left <= right) ? 1.0 : 0.0;
-        } else if (op == ">") {
-            return (left > right) ? 1.0 : 0.0;
-        } else if (op == ">=") {
-            return (left >= right) ? 1.0 : 0.0;
-        } else if (op == "==") {
-            return (left == right) ? 1.0 : 0.0;
-        } else if (op == "!=") {
-            return (left != right) ? 1.0 : 0.0;
-        } else if (op == "=") {
-            // Single '=' treated as comparison (not assignment)
-            return (left == right) ? 1.0 : 0.0;
+                break;
+            case OpCode::SHORT_OR:
+                if (stack[sp - 1] != 0.0) {
+                    stack[sp - 1] = 1.0;
+                    pc = ins.target - 1;
+                } else {
+                    --sp;
+                }
+                break;
+            case OpCode::TO_BOOL:
+                stack[sp - 1] = (stack[sp - 1] != 0.0) ? 1.0 : 0.0;
+                break;
         }
     }
 
-    return left;
+    return stack[0];
 }
 
-double FormulaEvaluator::parse_arithmetic() {
-    double result = parse_term();
+std::vector<std::string> FormulaEvaluator::extract_dependencies(const std::string& formula) const {
+    // Names are collected as views into the formula; strings are only built
+    // for the result
+    std::set<std::string_view> deps;
+    std::set<std::string_view> shifted;
+    FormulaParser::collect_dependencies(formula, deps, shifted);
 
-    while (peek() == '+' || peek() == '-') {
-        char op = next();
-        double right = parse_term();
-        if (op == '+') {
-            result += right;
-        } else {
-            result -= right;
-        }
+    std::vector<std::string> result;
+    result.reserve(deps.size() + shifted.size());
+    for (auto dep : deps) {
+        result.emplace_back(dep);
     }
-
-    return result;
-}
-
-double FormulaEvaluator::parse_term() {
-    double result = parse_power();
-
-    while (peek() == '*' || peek() == '/') {
-        char op = next();
-        double right = parse_power();
-        if (op == '*') {
-            result *= right;
-        } else {
-            if (right == 0.0) {
-                std::ostringstream oss;
-                oss << "Division by zero at position " << pos_;
-                throw std::runtime_error(oss.str());
-            }
-            result /= right;
-        }
+    for (auto dep : shifted) {
+        // Time-shifted references are marked with a "[t-1]" suffix so the
+        // dependency graph can distinguish inter-period from intra-period deps
+        result.emplace_back(std::string(dep) + "[t-1]");
     }
-
+    std::sort(result.begin(), result.end());
     return result;
 }
 
-double FormulaEvaluator::parse_power() {
-    double result = parse_factor();
-
-    if (peek() == '^') {
-        next();
-        double exponent = parse_factor();
-        result = std::pow(result, exponent);
-    }
-
-    return result;
-}
-
-double FormulaEvaluator::parse_factor() {
-    skip_whitespace();
-
-    // Unary minus
-    if (peek() == '-') {
-        next();
-        return -parse_factor();
-    }
-
-    // Unary plus (just skip it)
-    if (peek() == '+') {
-        next();
-        return parse_factor();
-    }
-
-    // Parentheses
-    if (peek() == '(') {
-        next();
-        double result = parse_expression();
-        skip_whitespace();
-        if (peek() != ')') {
-            std::ostringstream oss;
-            oss << "Unmatched parentheses at position " << pos_;
-            throw std::runtime_error(oss.str());
+bool FormulaEvaluator::preserves_zero(const CompiledFormula& compiled) {
+    // A formula calling only pure built-ins is a function of its variables,
+    // so its value with every variable 0 is the value whenever they are all 0
+    for (const auto& call : compiled.functions()) {
+        if (!call.builtin || !call.pure) {
+            return false;
         }
-        next();
-        return result;
-    }
-
-    // Numbers
-    if (is_digit(peek()) || peek() == '.') {
-        return read_number();
     }
-
-    // Variables or functions
-    if (is_alpha(peek())) {
-        std::string identifier = read_identifier();
-
-        // Check if function call
-        skip_whitespace();
-        if (peek() == '(') {
-            return parse_function(identifier);
-        }
-
-        // Variable (possibly with time reference)
-        return parse_variable(identifier);
-    }
-
-    // Error
-    std::ostringstream oss;
-    oss << "Unexpected character '" << peek() << "' at position " << pos_;
-    throw std::runtime_error(oss.str());
-}
-
-double FormulaEvaluator::parse_function(const std::string& func_name) {
-    // Special handling for TAX_COMPUTE which takes (value, "strategy_name")
-    if (func_name == "TAX_COMPUTE") {
-        skip_whitespace();
-        if (peek() != '(') {
-            throw std::runtime_error("Expected '(' after TAX_COMPUTE");
-        }
-        next();
-
-        // First argument: pre-tax income value (expression)
-        double pre_tax_income = parse_expression();
-        skip_whitespace();
-
-        if (peek() != ',') {
-            throw std::runtime_error("TAX_COMPUTE requires 2 arguments: (pre_tax_income, \"strategy\")");
-        }
-        next();
-        skip_whitespace();
-
-        // Second argument: strategy name (string literal)
-        if (peek() != '"' && peek() != '\'') {
-            throw std::runtime_error("TAX_COMPUTE strategy must be a string literal");
-        }
-        char quote_char = next();
-        std::string strategy_name;
-        while (pos_ < formula_.length() && formula_[pos_] != quote_char) {
-            strategy_name += formula_[pos_++];
-        }
-        if (pos_ >= formula_.length() || formula_[pos_] != quote_char) {
-            throw std::runtime_error("Unterminated string literal in TAX_COMPUTE");
-        }
-        pos_++;  // Skip closing quote
-
-        skip_whitespace();
-        if (peek() != ')') {
-            throw std::runtime_error("Expected ')' after TAX_COMPUTE arguments");
-        }
-        next();
-
-        // Call custom function with strategy name encoded as special value
-        // We'll encode the strategy name's hash as a double (not ideal but works for now)
-        // Actually, let's use a different approach - store strategy in a map
-        std::vector<double> args = {pre_tax_income};
-
-        if (custom_functions_) {
-            // Pass strategy name as part of function name
-            return custom_functions_("TAX_COMPUTE:" + strategy_name, args);
-        }
-        throw std::runtime_error("TAX_COMPUTE requires custom function handler");
-    }
-
-    // Standard function parsing
-    // Expect '('
-    skip_whitespace();
-    if (peek() != '(') {
-        throw std::runtime_error("Expected '(' after function name: " + func_name);
-    }
-    next();
-
-    // Parse arguments
-    std::vector<double> args;
-    skip_whitespace();
-
-    // Handle empty argument list
-    if (peek() == ')') {
-        next();
-        throw std::runtime_error("Function " + func_name + " requires at least one argument");
-    }
-
-    // Parse first argument
-    args.push_back(parse_expression());
-    skip_whitespace();
-
-    // Parse remaining arguments
-    while (peek() == ',') {
-        next();
-        skip_whitespace();
-        args.push_back(parse_expression());
-        skip_whitespace();
-    }
-
-    // Expect ')'
-    if (peek() != ')') {
-        std::ostringstream oss;
-        oss << "Unmatched parentheses in function call '" << func_name
-            << "' at position " << pos_;
-        throw std::runtime_error(oss.str());
-    }
-    next();
-
-    // Try custom functions first
-    if (custom_functions_) {
-        try {
-            return custom_functions_(func_name, args);
-        } catch (const std::exception&) {
-            // Fall through to built-in functions
-        }
-    }
-
-    // Evaluate built-in functions
-    if (func_name == "MIN") {
-        if (args.size() != 2) {
-            throw std::runtime_error("MIN requires exactly 2 arguments, got " +
-                                   std::to_string(args.size()));
-        }
-        return std::min(args[0], args[1]);
-    }
-    else if (func_name == "MAX") {
-        if (args.size() != 2) {
-            throw std::runtime_error("MAX requires exactly 2 arguments, got " +
-                                   std::to_string(args.size()));
-        }
-        return std::max(args[0], args[1]);
-    }
-    else if (func_name == "ABS") {
-        if (args.size() != 1) {
-            throw std::runtime_error("ABS requires exactly 1 argument, got " +
-                                   std::to_string(args.size()));
-        }
-        return std::abs(args[0]);
-    }
-    else if (func_name == "IF") {
-        if (args.size() != 3) {
-            throw std::runtime_error("IF requires exactly 3 arguments, got " +
-                                   std::to_string(args.size()));
-        }
-        return (args[0] != 0.0) ? args[1] : args[2];
-    }
-
-    throw std::runtime_error("Unknown function: " + func_name);
-}
-
-double FormulaEvaluator::parse_variable(const std::string& var_name) {
-    int time_offset = 0;
-
-    // Check for time reference [t-1], [t], etc.
-    skip_whitespace();
-    if (peek() == '[') {
-        time_offset = parse_time_reference();
+    try {
+        const double value = execute(compiled, [](uint32_t) { return 0.0; }, nullptr, nullptr);
+        return value == 0.0;
+    } catch (const std::exception&) {
+        return false;  // e.g. a division by one of the variables
     }
-
-    return get_variable_value(var_name, time_offset);
 }
 
 // ============================================================================
-// Lexer Methods
+// Function Calls
 // ============================================================================
 
-void FormulaEvaluator::skip_whitespace() {
-    while (pos_ < formula_.length() && std::isspace(formula_[pos_])) {
-        pos_++;
-    }
-}
-
-char FormulaEvaluator::peek() const {
-    // Note: We need to skip whitespace in peek() for lookahead to work correctly
-    size_t temp_pos = pos_;
-    while (temp_pos < formula_.length() && std::isspace(formula_[temp_pos])) {
-        temp_pos++;
-    }
-    if (temp_pos < formula_.length()) {
-        return formula_[temp_pos];
+double FormulaEvaluator::call_function(
+    const FunctionCall& call,
+    const double* args,
+    const CustomFunctionHandler& custom_functions
+) {
+    if (call.builtin) {
+        return call.builtin(args, call.arg_count);
     }
-    return '\0';
-}
 
-char FormulaEvaluator::next() {
-    // Skip whitespace to stay in sync with peek()
-    skip_whitespace();
-    if (pos_ < formula_.length()) {
-        return formula_[pos_++];
+    if (custom_functions) {
+        // Its error (an unknown name, a failed strategy) is the formula's, as in LaneEvaluator
+        return custom_functions(call.name, std::vector<double>(args, args + call.arg_count));
     }
-    return '\0';
-}
-
-bool FormulaEvaluator::is_alpha(char c) const {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
-}
-
-bool FormulaEvaluator::is_digit(char c) const {
-    return c >= '0' && c <= '9';
-}
 
-bool FormulaEvaluator::is_alnum(char c) const {
-    return is_alpha(c) || is_digit(c);
+    throw std::runtime_error("Unknown function: " + call.name);
 }
 
-std::string FormulaEvaluator::read_identifier() {
-    std::string result;
-    while (pos_ < formula_.length() && (is_alnum(formula_[pos_]) || formula_[pos_] == ':')) {
-        result += formula_[pos_++];
-    }
-    return result;
+void FormulaEvaluator::register_function(
+    const std::string& name,
+    uint32_t min_args,
+    uint32_t max_args,
+    BuiltinFunction fn,
+    bool pure
+) {
+    functions_.register_function(name, min_args, max_args, fn, pure);
+    clear_cache();
 }
 
-double FormulaEvaluator::read_number() {
-    std::string num_str;
-
-    // Read digits before decimal point
-    while (pos_ < formula_.length() && is_digit(formula_[pos_])) {
-        num_str += formula_[pos_++];
-    }
+// ============================================================================
+// Variable Resolution
+// ============================================================================
 
-    // Read decimal point and digits after
-    if (pos_ < formula_.length() && formula_[pos_] == '.') {
-        num_str += formula_[pos_++];
-        while (pos_ < formula_.length() && is_digit(formula_[pos_])) {
-            num_str += formula_[pos_++];
+double FormulaEvaluator::get_variable_value(
+    const VariableRef& var,
+    const std::vector<IValueProvider*>& providers,
+    const Context& ctx
+) {
+    // Create context with time offset (a plain copy: Context owns no memory)
+    Context lookup_ctx = ctx;
+    lookup_ctx.time_index += var.time_offset;
+
+    // Try each provider in order; one without a value passes to the next
+    for (auto* provider : providers) {
+        if (auto value = provider->find_value(var.code, lookup_ctx)) {
+            return *value;
         }
     }
 
-    try {
-        return std::stod(num_str);
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Invalid number: " + num_str);
-    }
+    // Variable not found in any provider
+    throw variable_not_found(var);
 }
 
-int FormulaEvaluator::parse_time_reference() {
-    // Expect '['
-    if (peek() != '[') {
-        throw std::runtime_error("Expected '[' for time reference");
-    }
-    next();
-
-    skip_whitespace();
-
-    // Parse 't' or 't-1' or 't+1' or 't-2', etc.
-    if (peek() != 't' && peek() != 'T') {
-        throw std::runtime_error("Time reference must start with 't'");
-    }
-    next();
-
-    skip_whitespace();
-
-    int offset = 0;
-
-    // Check for +/- offset
-    if (peek() == '-' || peek() == '+') {
-        char op = next();
-        skip_whitespace();
-
-        // Read offset number
-        if (!is_digit(peek())) {
-            throw std::runtime_error("Expected number after '" + std::string(1, op) + "' in time reference");
-        }
-
-        std::string offset_str;
-        while (is_digit(peek())) {
-            offset_str += next();
+double FormulaEvaluator::get_bound_value(
+    const FormulaBinding& bound,
+    size_t var_index,
+    const Context& ctx
+) {
+    const VariableRef& var = bound.formula().variables()[var_index];
+
+    Context lookup_ctx = ctx;
+    lookup_ctx.time_index += var.time_offset;
+
+    // Same first-provider-wins order as get_variable_value(), but slot
+    // providers answer with an array read instead of a string lookup
+    for (auto* c = bound.candidates_begin(var_index); c != bound.candidates_end(var_index); ++c) {
+        // Statically resolved arrays: no provider call at all
+        double value;
+        int direct = c->read_direct(lookup_ctx.time_index, value);
+        if (direct == 1) {
+            return value;
+        } else if (direct == 0) {
+            continue;
         }
 
-        offset = std::stoi(offset_str);
-        if (op == '-') {
-            offset = -offset;
+        const std::optional<double> found = (c->slot != IValueProvider::NO_SLOT)
+            ? c->provider->find_slot_value(c->slot, lookup_ctx)
+            : c->provider->find_value(var.code, lookup_ctx);
+        if (found) {
+            return *found;
         }
     }
 
-    skip_whitespace();
-
-    // Expect ']'
-    if (peek() != ']') {
-        throw std::runtime_error("Expected ']' to close time reference");
-    }
-    next();
-
-    return offset;
+    throw variable_not_found(var);
 }
 
-// ============================================================================
-// Variable Resolution
-// ============================================================================
-
-double FormulaEvaluator::get_variable_value(const std::string& code, int time_offset) {
-    // Create context with time offset
-    Context time_ctx = ctx_;
-    time_ctx.time_index = ctx_.time_index + time_offset;
-
-    // Try each provider in order
-    for (auto* provider : providers_) {
-        if (provider->has_value(code)) {
-            try {
-                return provider->get_value(code, time_ctx);
-            } catch (const std::exception& e) {
-                // Provider claims to handle this code but failed
-                // Continue to next provider
-                continue;
-            }
-        }
-    }
-
-    // Variable not found in any provider
+std::runtime_error FormulaEvaluator::variable_not_found(const VariableRef& var) {
     std::ostringstream oss;
-    oss << "Variable not found: " << code;
-    if (time_offset != 0) {
+    oss << "Variable not found: " << var.code;
+    if (var.time_offset != 0) {
         oss << "[t";
-        if (time_offset > 0) oss << "+" << time_offset;
-        else oss << time_offset;
+        if (var.time_offset > 0) oss << "+" << var.time_offset;
+        else oss << var.time_offset;
         oss << "]";
     }
-    throw std::runtime_error(oss.str());
+    return std::runtime_error(oss.str());
 }
 
 } // namespace core
@@ -0,0 +1,518 @@
+/**
+ * @file formula_optimizer.cpp
+ * @brief Constant folding and subexpression sharing
+ */
+
+#include "core/formula_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+bool is_binary(OpCode op) {
+    switch (op) {
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: case OpCode::DIV:
+        case OpCode::POW:
+        case OpCode::CMP_LT: case OpCode::CMP_LE: case OpCode::CMP_GT:
+        case OpCode::CMP_GE: case OpCode::CMP_EQ: case OpCode::CMP_NE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+double apply_binary(OpCode op, double a, double b) {
+    switch (op) {
+        case OpCode::ADD: return a + b;
+        case OpCode::SUB: return a - b;
+        case OpCode::MUL: return a * b;
+        case OpCode::DIV: return a / b;
+        case OpCode::POW: return std::pow(a, b);
+        case OpCode::CMP_LT: return (a < b) ? 1.0 : 0.0;
+        case OpCode::CMP_LE: return (a <= b) ? 1.0 : 0.0;
+        case OpCode::CMP_GT: return (a > b) ? 1.0 : 0.0;
+        case OpCode::CMP_GE: return (a >= b) ? 1.0 : 0.0;
+        case OpCode::CMP_EQ: return (a == b) ? 1.0 : 0.0;
+        case OpCode::CMP_NE: return (a != b) ? 1.0 : 0.0;
+        default: return 0.0;
+    }
+}
+
+bool is_jump(OpCode op) {
+    return op == OpCode::JUMP || op == OpCode::JUMP_IF_FALSE ||
+           op == OpCode::SHORT_AND || op == OpCode::SHORT_OR || op == OpCode::MEMO_CHECK;
+}
+
+/**
+ * @brief Subtree being tracked while scanning postfix code
+ */
+struct Subtree {
+    uint32_t start;     ///< First instruction of the subtree
+    bool has_var;       ///< Reads at least one variable
+    bool shareable;     ///< Straight-line and free of custom / impure calls
+};
+
+/**
+ * @brief Lazy construct (IF / AND / OR) being tracked while scanning
+ */
+struct Branch {
+    uint32_t end;       ///< Instruction where all paths meet again (UINT32_MAX until known)
+    Subtree head;       ///< Merged subtree so far
+};
+
+/**
+ * @brief Canonical text of instructions [start, end] (constants by bit pattern)
+ */
+std::string subtree_key(const CompiledFormula& f, uint32_t start, uint32_t end) {
+    std::string key;
+    for (uint32_t i = start; i <= end; ++i) {
+        const auto& ins = f.code()[i];
+        key += static_cast<char>(ins.op);
+        switch (ins.op) {
+            case OpCode::PUSH_CONST: {
+                char bits[sizeof(double)];
+                std::memcpy(bits, &f.constants()[ins.operand], sizeof(double));
+                key.append(bits, sizeof(double));
+                break;
+            }
+            case OpCode::LOAD_VAR: {
+                const auto& var = f.variables()[ins.operand];
+                key += var.code;
+                key += '\0';
+                key += std::to_string(var.time_offset);
+                key += '\0';
+                break;
+            }
+            case OpCode::CALL_BUILTIN: {
+                const auto& call = f.functions()[ins.operand];
+                key += std::to_string(call.function_id) + ":" + std::to_string(call.arg_count);
+                key += '\0';
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return key;
+}
+
+/**
+ * @brief Occurrence of a shareable subtree
+ */
+struct Site {
+    size_t formula;
+    uint32_t start;
+    uint32_t end;   ///< Inclusive
+    uint32_t id;    ///< Provisional key index
+};
+
+} // namespace
+
+void FormulaOptimizer::fold_constants(CompiledFormula& f) {
+    std::vector<Instruction> out;
+    out.reserve(f.code_.size());
+    bool changed = false;
+
+    // Jump targets start a new basic block: never fold across them
+    std::vector<uint8_t> is_target(f.code_.size() + 1, 0);
+    for (const auto& ins : f.code_) {
+        if (is_jump(ins.op)) {
+            is_target[ins.target] = 1;
+        }
+    }
+    std::vector<uint32_t> new_index(f.code_.size() + 1, 0);
+    size_t block_start = 0;
+
+    auto const_back = [&](size_t n) {
+        if (out.size() < block_start + n) return false;
+        for (size_t k = 1; k <= n; ++k) {
+            if (out[out.size() - k].op != OpCode::PUSH_CONST) return false;
+        }
+        return true;
+    };
+    auto value_back = [&](size_t k) { return f.constants_[out[out.size() - k].operand]; };
+    auto replace = [&](size_t n, double value, uint32_t position) {
+        out.resize(out.size() - n);
+        f.constants_.push_back(value);
+        Instruction ins;
+        ins.op = OpCode::PUSH_CONST;
+        ins.operand = static_cast<uint32_t>(f.constants_.size() - 1);
+        ins.position = position;
+        out.push_back(ins);
+        changed = true;
+    };
+
+    for (size_t i = 0; i < f.code_.size(); ++i) {
+        const auto& ins = f.code_[i];
+        new_index[i] = static_cast<uint32_t>(out.size());
+        if (is_target[i]) {
+            block_start = out.size();
+        }
+        if (is_jump(ins.op)) {
+            block_start = out.size() + 1;
+        }
+
+        if (ins.op == OpCode::NEG && const_back(1)) {
+            replace(1, -value_back(1), ins.position);
+            continue;
+        }
+        if (is_binary(ins.op) && const_back(2)) {
+            double a = value_back(2);
+            double b = value_back(1);
+            if (!(ins.op == OpCode::DIV && b == 0.0)) {
+                replace(2, apply_binary(ins.op, a, b), ins.position);
+                continue;
+            }
+        }
+        if (ins.op == OpCode::CALL_BUILTIN) {
+            const auto& call = f.functions_[ins.operand];
+            if (call.pure && call.arg_count > 0 && const_back(call.arg_count)) {
+                std::vector<double> args(call.arg_count);
+                for (uint32_t a = 0; a < call.arg_count; ++a) {
+                    args[a] = value_back(call.arg_count - a);
+                }
+                try {
+                    double value = call.builtin(args.data(), call.arg_count);
+                    replace(call.arg_count, value, ins.position);
+                    continue;
+                } catch (const std::exception&) {
+                    // Keep the call so the error is raised at evaluation time
+                }
+            }
+        }
+        out.push_back(ins);
+    }
+
+    if (!changed) {
+        return;
+    }
+
+    new_index[f.code_.size()] = static_cast<uint32_t>(out.size());
+    for (auto& ins : out) {
+        if (is_jump(ins.op)) {
+            ins.target = new_index[ins.target];
+        }
+    }
+
+    // Drop constants that are no longer referenced
+    std::vector<double> pool;
+    for (auto& ins : out) {
+        if (ins.op == OpCode::PUSH_CONST) {
+            pool.push_back(f.constants_[ins.operand]);
+            ins.operand = static_cast<uint32_t>(pool.size() - 1);
+        }
+    }
+    f.constants_ = std::move(pool);
+    f.code_ = std::move(out);
+    update_stack_depth(f);
+}
+
+FormulaOptimizer::SharedFormulas FormulaOptimizer::share_subexpressions(
+    const std::vector<std::shared_ptr<const CompiledFormula>>& formulas,
+    size_t min_occurrences
+) {
+    SharedFormulas result;
+    result.formulas = formulas;
+    if (min_occurrences < 2) {
+        min_occurrences = 2;
+    }
+
+    // 1. Collect every shareable subtree of every formula
+    std::unordered_map<std::string, uint32_t> key_index;
+    std::vector<std::vector<Site>> key_sites;
+
+    for (size_t fi = 0; fi < formulas.size(); ++fi) {
+        const auto& f = *formulas[fi];
+        const auto& code = f.code();
+        bool rewritten = std::any_of(code.begin(), code.end(), [](const Instruction& ins) {
+            return ins.op == OpCode::MEMO_CHECK || ins.op == OpCode::MEMO_STORE;
+        });
+        if (rewritten) {
+            continue;
+        }
+
+        std::vector<Subtree> stack;
+        std::vector<Branch> branches;
+
+        auto merge = [](Subtree& into, const Subtree& other) {
+            into.start = std::min(into.start, other.start);
+            into.has_var = into.has_var || other.has_var;
+            into.shareable = into.shareable && other.shareable;
+        };
+        // All paths of the innermost branch(es) meet at i: fold into one subtree
+        auto close_branches = [&](uint32_t i) {
+            while (!branches.empty() && branches.back().end == i) {
+                Subtree merged = branches.back().head;
+                merge(merged, stack.back());
+                merged.shareable = false;  // Holds jumps
+                stack.back() = merged;
+                branches.pop_back();
+            }
+        };
+
+        for (uint32_t i = 0; i < code.size(); ++i) {
+            close_branches(i);
+            const auto& ins = code[i];
+            switch (ins.op) {
+                case OpCode::JUMP_IF_FALSE:
+                    // IF: condition is consumed, end is known at the then-branch JUMP
+                    branches.push_back({UINT32_MAX, stack.back()});
+                    stack.pop_back();
+                    continue;
+                case OpCode::JUMP:
+                    merge(branches.back().head, stack.back());
+                    branches.back().end = ins.target;
+                    stack.pop_back();
+                    continue;
+                case OpCode::SHORT_AND:
+                case OpCode::SHORT_OR:
+                    branches.push_back({ins.target, stack.back()});
+                    stack.pop_back();
+                    continue;
+                case OpCode::TO_BOOL:
+                    break;
+                case OpCode::PUSH_CONST:
+                    stack.push_back({i, false, true});
+                    continue;  // Leaves are never shared on their own
+                case OpCode::LOAD_VAR:
+                    stack.push_back({i, true, true});
+                    continue;
+                case OpCode::NEG:
+                    break;
+                case OpCode::TAX_COMPUTE:
+                    stack.back().shareable = false;
+                    break;
+                case OpCode::CALL:
+                case OpCode::CALL_BUILTIN: {
+                    const auto& call = f.functions()[ins.operand];
+                    Subtree merged{i, false, ins.op == OpCode::CALL_BUILTIN && call.pure};
+                    for (uint32_t a = 0; a < call.arg_count; ++a) {
+                        const Subtree& arg = stack.back();
+                        merged.start = arg.start;
+                        merged.has_var = merged.has_var || arg.has_var;
+                        merged.shareable = merged.shareable && arg.shareable;
+                        stack.pop_back();
+                    }
+                    stack.push_back(merged);
+                    break;
+                }
+                default: {
+                    // Binary operator
+                    Subtree b = stack.back();
+                    stack.pop_back();
+                    Subtree& a = stack.back();
+                    a.has_var = a.has_var || b.has_var;
+                    a.shareable = a.shareable && b.shareable;
+                    break;
+                }
+            }
+
+            const Subtree& top = stack.back();
+            if (top.shareable && top.has_var && i - top.start + 1 >= 3) {
+                std::string key = subtree_key(f, top.start, i);
+                auto [it, inserted] = key_index.emplace(std::move(key), static_cast<uint32_t>(key_sites.size()));
+                if (inserted) {
+                    key_sites.emplace_back();
+                }
+                key_sites[it->second].push_back({fi, top.start, i, it->second});
+            }
+        }
+        close_branches(static_cast<uint32_t>(code.size()));
+    }
+
+    // 2. Keep subtrees that repeat, drop ones that only ever appear inside
+    //    the same repeated parent (the parent already covers them)
+    std::vector<uint8_t> selected(key_sites.size(), 0);
+    std::vector<std::vector<Site>> formula_sites(formulas.size());
+    for (size_t k = 0; k < key_sites.size(); ++k) {
+        if (key_sites[k].size() >= min_occurrences) {
+            selected[k] = 1;
+            for (const auto& site : key_sites[k]) {
+                formula_sites[site.formula].push_back(site);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < key_sites.size(); ++k) {
+        if (!selected[k]) continue;
+
+        // Parents enclosing every occurrence of k
+        std::vector<uint32_t> common;
+        bool first = true;
+        for (const auto& site : key_sites[k]) {
+            std::vector<uint32_t> parents;
+            for (const auto& other : formula_sites[site.formula]) {
+                if (other.id != k && other.start <= site.start && other.end >= site.end) {
+                    parents.push_back(other.id);
+                }
+            }
+            std::sort(parents.begin(), parents.end());
+            if (first) {
+                common = std::move(parents);
+                first = false;
+            } else {
+                std::vector<uint32_t> both;
+                std::set_intersection(common.begin(), common.end(),
+                                      parents.begin(), parents.end(), std::back_inserter(both));
+                common = std::move(both);
+            }
+            if (common.empty()) break;
+        }
+
+        for (uint32_t parent : common) {
+            if (key_sites[parent].size() == key_sites[k].size()) {
+                selected[k] = 0;
+                break;
+            }
+        }
+    }
+
+    // 3. Number surviving subtrees in order of first appearance
+    std::vector<uint32_t> shared_id(key_sites.size(), UINT32_MAX);
+    uint32_t next_id = 0;
+    for (auto& sites : formula_sites) {
+        sites.erase(std::remove_if(sites.begin(), sites.end(),
+                                   [&](const Site& s) { return !selected[s.id]; }),
+                    sites.end());
+        std::sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) {
+            return a.start != b.start ? a.start < b.start : a.end > b.end;
+        });
+        for (const auto& site : sites) {
+            if (shared_id[site.id] == UINT32_MAX) {
+                shared_id[site.id] = next_id++;
+            }
+        }
+    }
+    result.shared_count = next_id;
+
+    // 4. Rewrite: [MEMO_CHECK id → after] subtree [MEMO_STORE id]
+    for (size_t fi = 0; fi < formulas.size(); ++fi) {
+        const auto& sites = formula_sites[fi];
+        if (sites.empty()) continue;
+
+        const auto& src = *formulas[fi];
+        auto rewritten = std::make_shared<CompiledFormula>(src);
+        std::vector<Instruction> code;
+        code.reserve(src.code_.size() + 2 * sites.size());
+
+        std::vector<size_t> open;       // MEMO_CHECK instructions awaiting their target
+        std::vector<const Site*> ends;  // Sites still open, innermost last
+        std::vector<uint32_t> new_index(src.code_.size() + 1, 0);
+        std::vector<size_t> copied_jumps;
+        size_t next_site = 0;
+
+        for (uint32_t j = 0; j < src.code_.size(); ++j) {
+            new_index[j] = static_cast<uint32_t>(code.size());
+
+            // Sites are sorted by start, outermost first
+            while (next_site < sites.size() && sites[next_site].start == j) {
+                Instruction check;
+                check.op = OpCode::MEMO_CHECK;
+                check.operand = shared_id[sites[next_site].id];
+                check.position = src.code_[j].position;
+                open.push_back(code.size());
+                ends.push_back(&sites[next_site]);
+                code.push_back(check);
+                ++next_site;
+            }
+
+            if (is_jump(src.code_[j].op)) {
+                copied_jumps.push_back(code.size());
+            }
+            code.push_back(src.code_[j]);
+
+            // Subtrees are properly nested, so the innermost open site closes first
+            while (!ends.empty() && ends.back()->end == j) {
+                Instruction store;
+                store.op = OpCode::MEMO_STORE;
+                store.operand = shared_id[ends.back()->id];
+                store.position = src.code_[j].position;
+                code.push_back(store);
+                code[open.back()].target = static_cast<uint32_t>(code.size());
+                open.pop_back();
+                ends.pop_back();
+            }
+        }
+
+        // Shared subtrees are straight-line, so existing jumps only need
+        // moving to the new position of their target
+        new_index[src.code_.size()] = static_cast<uint32_t>(code.size());
+        for (size_t index : copied_jumps) {
+            code[index].target = new_index[code[index].target];
+        }
+
+        rewritten->code_ = std::move(code);
+        update_stack_depth(*rewritten);
+        result.formulas[fi] = std::move(rewritten);
+    }
+
+    return result;
+}
+
+void FormulaOptimizer::update_stack_depth(CompiledFormula& f) {
+    // Forward data flow: jumps carry their depth to the target
+    const size_t n = f.code_.size();
+    constexpr int UNREACHED = -1;
+    std::vector<int> depth_in(n + 1, UNREACHED);
+    depth_in[0] = 0;
+    int max_depth = 0;
+
+    auto reach = [&](size_t index, int depth) {
+        depth_in[index] = std::max(depth_in[index], depth);
+        max_depth = std::max(max_depth, depth);
+    };
+
+    for (size_t i = 0; i < n; ++i) {
+        const auto& ins = f.code_[i];
+        int depth = depth_in[i];
+        if (depth == UNREACHED) {
+            continue;
+        }
+
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+            case OpCode::LOAD_VAR:
+                ++depth;
+                break;
+            case OpCode::CALL:
+            case OpCode::CALL_BUILTIN:
+                depth += 1 - static_cast<int>(f.functions_[ins.operand].arg_count);
+                break;
+            case OpCode::NEG:
+            case OpCode::TAX_COMPUTE:
+            case OpCode::MEMO_STORE:
+            case OpCode::TO_BOOL:
+                break;
+            case OpCode::MEMO_CHECK:
+                reach(ins.target, depth + 1);
+                break;
+            case OpCode::JUMP:
+                reach(ins.target, depth);
+                continue;  // No fall-through
+            case OpCode::JUMP_IF_FALSE:
+                --depth;
+                reach(ins.target, depth);
+                break;
+            case OpCode::SHORT_AND:
+            case OpCode::SHORT_OR:
+                reach(ins.target, depth);
+                --depth;
+                break;
+            default:
+                --depth;  // Binary operator
+                break;
+        }
+        reach(i + 1, depth);
+    }
+    f.max_stack_depth_ = static_cast<size_t>(max_depth);
+}
+
+} // namespace core
+} // namespace finmodel
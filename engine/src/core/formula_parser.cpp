@@ -0,0 +1,768 @@
+/**
+ * @file formula_parser.cpp
+ * @brief Formula parser implementation
+ */
+
+#include "core/formula_parser.h"
+#include "core/time_series.h"
+#include <cctype>
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace finmodel {
+namespace core {
+
+void FormulaParser::parse() {
+    parse_expression();
+
+    // Ensure we consumed entire formula
+    skip_whitespace();
+    if (pos_ < formula_.length()) {
+        std::ostringstream oss;
+        oss << "Unexpected characters after expression at position " << pos_
+            << ": '" << formula_.substr(pos_) << "'";
+        throw std::runtime_error(oss.str());
+    }
+}
+
+// ============================================================================
+// Recursive Descent Parser (emits postfix bytecode)
+// ============================================================================
+
+void FormulaParser::parse_expression() {
+    parse_logical_or();
+}
+
+void FormulaParser::parse_logical_or() {
+    parse_logical_and();
+
+    skip_whitespace();
+    while (peek() == '|') {
+        next();
+        if (peek() != '|') {
+            std::ostringstream oss;
+            oss << "Expected '||' at position " << pos_;
+            throw std::runtime_error(oss.str());
+        }
+        next();
+
+        // Right side only runs if the left side was false
+        size_t jump = emit_jump(OpCode::SHORT_OR, -1);
+        parse_logical_and();
+        emit(OpCode::TO_BOOL, 0, 0);
+        patch_jump(jump);
+        skip_whitespace();
+    }
+}
+
+void FormulaParser::parse_logical_and() {
+    parse_comparison();
+
+    skip_whitespace();
+    while (peek() == '&') {
+        next();
+        if (peek() != '&') {
+            std::ostringstream oss;
+            oss << "Expected '&&' at position " << pos_;
+            throw std::runtime_error(oss.str());
+        }
+        next();
+
+        // Right side only runs if the left side was true
+        size_t jump = emit_jump(OpCode::SHORT_AND, -1);
+        parse_comparison();
+        emit(OpCode::TO_BOOL, 0, 0);
+        patch_jump(jump);
+        skip_whitespace();
+    }
+}
+
+void FormulaParser::parse_comparison() {
+    parse_arithmetic();
+
+    skip_whitespace();
+    char c = peek();
+
+    // Check for comparison operators
+    if (c == '<' || c == '>' || c == '=' || c == '!') {
+        next();  // consume first character
+
+        // Check for two-character operators (<=, >=, ==, !=)
+        skip_whitespace();
+        const bool or_equal = (peek() == '=');
+        if (or_equal) {
+            next();
+        }
+
+        OpCode code;
+        if (c == '<') {
+            code = or_equal ? OpCode::CMP_LE : OpCode::CMP_LT;
+        } else if (c == '>') {
+            code = or_equal ? OpCode::CMP_GE : OpCode::CMP_GT;
+        } else if (c == '=') {
+            // Single '=' treated as comparison (not assignment)
+            code = OpCode::CMP_EQ;
+        } else if (or_equal) {
+            code = OpCode::CMP_NE;
+        } else {
+            std::ostringstream oss;
+            oss << "Unknown comparison operator '" << c << "' at position " << pos_;
+            throw std::runtime_error(oss.str());
+        }
+
+        parse_arithmetic();
+
+        // Comparison yields 1.0 for true, 0.0 for false
+        emit(code, 0, -1);
+    }
+}
+
+void FormulaParser::parse_arithmetic() {
+    parse_term();
+
+    while (peek() == '+' || peek() == '-') {
+        char op = next();
+        parse_term();
+        emit(op == '+' ? OpCode::ADD : OpCode::SUB, 0, -1);
+    }
+}
+
+void FormulaParser::parse_term() {
+    parse_power();
+
+    while (peek() == '*' || peek() == '/') {
+        char op = next();
+        parse_power();
+        emit(op == '*' ? OpCode::MUL : OpCode::DIV, 0, -1);
+    }
+}
+
+void FormulaParser::parse_power() {
+    parse_factor();
+
+    if (peek() == '^') {
+        next();
+        parse_factor();
+        emit(OpCode::POW, 0, -1);
+    }
+}
+
+void FormulaParser::parse_factor() {
+    skip_whitespace();
+
+    // Unary minus
+    if (peek() == '-') {
+        next();
+        parse_factor();
+        emit(OpCode::NEG, 0, 0);
+        return;
+    }
+
+    // Unary plus (just skip it)
+    if (peek() == '+') {
+        next();
+        parse_factor();
+        return;
+    }
+
+    // Parentheses
+    if (peek() == '(') {
+        next();
+        parse_expression();
+        skip_whitespace();
+        if (peek() != ')') {
+            std::ostringstream oss;
+            oss << "Unmatched parentheses at position " << pos_;
+            throw std::runtime_error(oss.str());
+        }
+        next();
+        return;
+    }
+
+    // Numbers
+    if (is_digit(peek()) || peek() == '.') {
+        double value = read_number();
+        target_.constants_.push_back(value);
+        emit(OpCode::PUSH_CONST, static_cast<uint32_t>(target_.constants_.size() - 1), +1);
+        return;
+    }
+
+    // Variables or functions
+    if (is_alpha(peek())) {
+        std::string_view identifier = read_identifier();
+
+        // Check if function call
+        skip_whitespace();
+        if (peek() == '(') {
+            parse_function(identifier);
+            return;
+        }
+
+        // Variable (possibly with time reference)
+        parse_variable(identifier);
+        return;
+    }
+
+    // Error
+    std::ostringstream oss;
+    oss << "Unexpected character '" << peek() << "' at position " << pos_;
+    throw std::runtime_error(oss.str());
+}
+
+void FormulaParser::parse_function(std::string_view func_name) {
+    // Special handling for TAX_COMPUTE which takes (value, "strategy_name")
+    if (func_name == "TAX_COMPUTE") {
+        skip_whitespace();
+        if (peek() != '(') {
+            throw std::runtime_error("Expected '(' after TAX_COMPUTE");
+        }
+        next();
+
+        // First argument: pre-tax income value (expression)
+        parse_expression();
+        skip_whitespace();
+
+        if (peek() != ',') {
+            throw std::runtime_error("TAX_COMPUTE requires 2 arguments: (pre_tax_income, \"strategy\")");
+        }
+        next();
+        skip_whitespace();
+
+        // Second argument: strategy name (string literal)
+        if (peek() != '"' && peek() != '\'') {
+            throw std::runtime_error("TAX_COMPUTE strategy must be a string literal");
+        }
+        char quote_char = next();
+        size_t name_end = formula_.find(quote_char, pos_);
+        if (name_end == std::string_view::npos) {
+            throw std::runtime_error("Unterminated string literal in TAX_COMPUTE");
+        }
+        std::string_view strategy_name = formula_.substr(pos_, name_end - pos_);
+        pos_ = name_end + 1;  // Skip closing quote
+
+        skip_whitespace();
+        if (peek() != ')') {
+            throw std::runtime_error("Expected ')' after TAX_COMPUTE arguments");
+        }
+        next();
+
+        // Strategy name travels as part of the function name passed to the handler
+        target_.functions_.push_back({"TAX_COMPUTE:" + std::string(strategy_name), 1});
+        emit(OpCode::TAX_COMPUTE, static_cast<uint32_t>(target_.functions_.size() - 1), 0);
+        return;
+    }
+
+    // Trailing windows and growth of a line item
+    if (func_name == "SUM_WINDOW" || func_name == "AVG_WINDOW") {
+        parse_window(func_name);
+        return;
+    }
+    if (func_name == "GROWTH") {
+        parse_growth();
+        return;
+    }
+
+    // Lazily evaluated built-ins
+    if (func_name == "IF") {
+        parse_lazy_if();
+        return;
+    }
+    if (func_name == "AND" || func_name == "OR") {
+        parse_short_circuit_call(func_name, func_name == "AND" ? OpCode::SHORT_AND : OpCode::SHORT_OR);
+        return;
+    }
+
+    // Standard function parsing
+    // Expect '('
+    skip_whitespace();
+    if (peek() != '(') {
+        throw std::runtime_error("Expected '(' after function name: " + std::string(func_name));
+    }
+    next();
+
+    // Parse arguments
+    uint32_t arg_count = 0;
+    skip_whitespace();
+
+    // Handle empty argument list
+    if (peek() == ')') {
+        next();
+        throw std::runtime_error("Function " + std::string(func_name) + " requires at least one argument");
+    }
+
+    // Parse first argument
+    parse_expression();
+    ++arg_count;
+    skip_whitespace();
+
+    // Parse remaining arguments
+    while (peek() == ',') {
+        next();
+        skip_whitespace();
+        parse_expression();
+        ++arg_count;
+        skip_whitespace();
+    }
+
+    // Expect ')'
+    if (peek() != ')') {
+        std::ostringstream oss;
+        oss << "Unmatched parentheses in function call '" << func_name
+            << "' at position " << pos_;
+        throw std::runtime_error(oss.str());
+    }
+    next();
+
+    // Registered functions are bound now; anything else goes to the custom handler
+    FunctionCall call{std::string(func_name), arg_count};
+    OpCode op = OpCode::CALL;
+    if (const FunctionDef* def = functions_.find(func_name)) {
+        FunctionRegistry::check_arity(*def, arg_count);
+        call.function_id = def->id;
+        call.builtin = def->fn;
+        call.pure = def->pure;
+        op = OpCode::CALL_BUILTIN;
+    }
+    target_.functions_.push_back(std::move(call));
+    emit(op, static_cast<uint32_t>(target_.functions_.size() - 1),
+         1 - static_cast<int>(arg_count));
+}
+
+void FormulaParser::parse_lazy_if() {
+    skip_whitespace();
+    if (peek() != '(') {
+        throw std::runtime_error("Expected '(' after function name: IF");
+    }
+    next();
+
+    skip_whitespace();
+    if (peek() == ')') {
+        next();
+        throw std::runtime_error("Function IF requires at least one argument");
+    }
+
+    // cond JUMP_IF_FALSE→else  a  JUMP→end  else: b  end:
+    size_t jump_else = 0;
+    size_t jump_end = 0;
+    uint32_t arg_count = 0;
+
+    parse_expression();
+    ++arg_count;
+    skip_whitespace();
+
+    while (peek() == ',') {
+        next();
+        if (arg_count == 1) {
+            jump_else = emit_jump(OpCode::JUMP_IF_FALSE, -1);
+        } else if (arg_count == 2) {
+            jump_end = emit_jump(OpCode::JUMP, 0);
+            patch_jump(jump_else);
+            stack_depth_ -= 1;  // Else branch starts without the then value
+        }
+        skip_whitespace();
+        parse_expression();
+        ++arg_count;
+        skip_whitespace();
+    }
+
+    if (peek() != ')') {
+        std::ostringstream oss;
+        oss << "Unmatched parentheses in function call 'IF' at position " << pos_;
+        throw std::runtime_error(oss.str());
+    }
+    next();
+
+    FunctionRegistry::check_arity(functions_.get(FunctionRegistry::FN_IF), arg_count);
+    patch_jump(jump_end);
+}
+
+void FormulaParser::parse_short_circuit_call(std::string_view func_name, OpCode op) {
+    skip_whitespace();
+    if (peek() != '(') {
+        throw std::runtime_error("Expected '(' after function name: " + std::string(func_name));
+    }
+    next();
+
+    skip_whitespace();
+    if (peek() == ')') {
+        next();
+        throw std::runtime_error("Function " + std::string(func_name) + " requires at least one argument");
+    }
+
+    // a SHORT→end  b SHORT→end ... z TO_BOOL  end:
+    std::vector<size_t> jumps;
+    parse_expression();
+    skip_whitespace();
+
+    while (peek() == ',') {
+        next();
+        jumps.push_back(emit_jump(op, -1));
+        skip_whitespace();
+        parse_expression();
+        skip_whitespace();
+    }
+
+    if (peek() != ')') {
+        std::ostringstream oss;
+        oss << "Unmatched parentheses in function call '" << func_name
+            << "' at position " << pos_;
+        throw std::runtime_error(oss.str());
+    }
+    next();
+
+    emit(OpCode::TO_BOOL, 0, 0);
+    for (size_t jump : jumps) {
+        patch_jump(jump);
+    }
+}
+
+void FormulaParser::parse_window(std::string_view func_name) {
+    const std::string name(func_name);
+    skip_whitespace();
+    if (peek() != '(') {
+        throw std::runtime_error("Expected '(' after function name: " + name);
+    }
+    next();
+
+    // First argument: line item code
+    skip_whitespace();
+    if (!is_alpha(peek())) {
+        throw std::runtime_error(name + " requires a line item code as its first argument");
+    }
+    WindowRef window;
+    window.code = std::string(read_identifier());
+    window.average = func_name == "AVG_WINDOW";
+    skip_whitespace();
+    if (peek() != ',') {
+        throw std::runtime_error(name + " requires 2 arguments: (line_item, periods)");
+    }
+    next();
+
+    // Second argument: window length (integer literal)
+    skip_whitespace();
+    if (!is_digit(peek())) {
+        throw std::runtime_error(name + " window length must be an integer literal");
+    }
+    while (is_digit(peek())) {
+        window.periods = window.periods * 10 + static_cast<size_t>(next() - '0');
+        if (window.periods > WindowRef::MAX_PERIODS) {
+            throw std::runtime_error(name + " window length out of range");
+        }
+    }
+    if (window.periods == 0) {
+        throw std::runtime_error(name + " window length must be at least 1");
+    }
+    skip_whitespace();
+    if (peek() != ')') {
+        throw std::runtime_error("Expected ')' after " + name + " arguments");
+    }
+    next();
+
+    // One variable: the provider keeps the window's running sum
+    emit(OpCode::LOAD_VAR, add_variable(window.key(), 0), +1);
+}
+
+void FormulaParser::parse_growth() {
+    skip_whitespace();
+    if (peek() != '(') {
+        throw std::runtime_error("Expected '(' after function name: GROWTH");
+    }
+    next();
+    skip_whitespace();
+    if (!is_alpha(peek())) {
+        throw std::runtime_error("GROWTH requires a line item code as its argument");
+    }
+    std::string_view code = read_identifier();
+    skip_whitespace();
+    if (peek() != ')') {
+        throw std::runtime_error("GROWTH requires 1 argument: (line_item)");
+    }
+    next();
+
+    // X / X[t-1] - 1
+    emit(OpCode::LOAD_VAR, add_variable(code, 0), +1);
+    emit(OpCode::LOAD_VAR, add_variable(code, -1), +1);
+    emit(OpCode::DIV, 0, -1);
+    target_.constants_.push_back(1.0);
+    emit(OpCode::PUSH_CONST, static_cast<uint32_t>(target_.constants_.size() - 1), +1);
+    emit(OpCode::SUB, 0, -1);
+}
+
+void FormulaParser::parse_variable(std::string_view var_name) {
+    int time_offset = 0;
+
+    // Check for time reference [t-1], [t], etc.
+    skip_whitespace();
+    if (peek() == '[') {
+        time_offset = parse_time_reference();
+    }
+
+    emit(OpCode::LOAD_VAR, add_variable(var_name, time_offset), +1);
+}
+
+// ============================================================================
+// Bytecode Emission
+// ============================================================================
+
+void FormulaParser::emit(OpCode op, uint32_t operand, int stack_effect) {
+    Instruction ins;
+    ins.op = op;
+    ins.operand = operand;
+    ins.position = static_cast<uint32_t>(pos_);
+    target_.code_.push_back(ins);
+
+    stack_depth_ += stack_effect;
+    if (stack_depth_ > static_cast<int>(target_.max_stack_depth_)) {
+        target_.max_stack_depth_ = static_cast<size_t>(stack_depth_);
+    }
+}
+
+size_t FormulaParser::emit_jump(OpCode op, int stack_effect) {
+    emit(op, 0, stack_effect);
+    return target_.code_.size() - 1;
+}
+
+void FormulaParser::patch_jump(size_t jump_index) {
+    target_.code_[jump_index].target = static_cast<uint32_t>(target_.code_.size());
+}
+
+uint32_t FormulaParser::add_variable(std::string_view code, int time_offset) {
+    auto& vars = target_.variables_;
+    for (size_t i = 0; i < vars.size(); ++i) {
+        if (vars[i].code == code && vars[i].time_offset == time_offset) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    vars.push_back({std::string(code), time_offset});
+    return static_cast<uint32_t>(vars.size() - 1);
+}
+
+// ============================================================================
+// Lexer Methods
+// ============================================================================
+
+void FormulaParser::skip_whitespace() {
+    while (pos_ < formula_.length() && std::isspace(formula_[pos_])) {
+        pos_++;
+    }
+}
+
+char FormulaParser::peek() const {
+    // Note: We need to skip whitespace in peek() for lookahead to work correctly
+    size_t temp_pos = pos_;
+    while (temp_pos < formula_.length() && std::isspace(formula_[temp_pos])) {
+        temp_pos++;
+    }
+    if (temp_pos < formula_.length()) {
+        return formula_[temp_pos];
+    }
+    return '\0';
+}
+
+char FormulaParser::next() {
+    // Skip whitespace to stay in sync with peek()
+    skip_whitespace();
+    if (pos_ < formula_.length()) {
+        return formula_[pos_++];
+    }
+    return '\0';
+}
+
+bool FormulaParser::is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool FormulaParser::is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool FormulaParser::is_alnum(char c) {
+    return is_alpha(c) || is_digit(c);
+}
+
+std::string_view FormulaParser::read_identifier() {
+    size_t start = pos_;
+    while (pos_ < formula_.length() && (is_alnum(formula_[pos_]) || formula_[pos_] == ':')) {
+        pos_++;
+    }
+    return formula_.substr(start, pos_ - start);
+}
+
+double FormulaParser::read_number() {
+    size_t start = pos_;
+
+    // Read digits before decimal point
+    while (pos_ < formula_.length() && is_digit(formula_[pos_])) {
+        pos_++;
+    }
+
+    // Read decimal point and digits after
+    if (pos_ < formula_.length() && formula_[pos_] == '.') {
+        pos_++;
+        while (pos_ < formula_.length() && is_digit(formula_[pos_])) {
+            pos_++;
+        }
+    }
+
+    std::string_view num_str = formula_.substr(start, pos_ - start);
+    double value = 0.0;
+    auto [end, ec] = std::from_chars(num_str.data(), num_str.data() + num_str.size(), value);
+    if (ec != std::errc() || end == num_str.data()) {
+        throw std::runtime_error("Invalid number: " + std::string(num_str));
+    }
+    return value;
+}
+
+int FormulaParser::parse_time_reference() {
+    // Expect '['
+    if (peek() != '[') {
+        throw std::runtime_error("Expected '[' for time reference");
+    }
+    next();
+
+    skip_whitespace();
+
+    // Parse 't' or 't-1' or 't+1' or 't-2', etc.
+    if (peek() != 't' && peek() != 'T') {
+        throw std::runtime_error("Time reference must start with 't'");
+    }
+    next();
+
+    skip_whitespace();
+
+    int offset = 0;
+
+    // Check for +/- offset
+    if (peek() == '-' || peek() == '+') {
+        char op = next();
+        skip_whitespace();
+
+        // Read offset number
+        if (!is_digit(peek())) {
+            throw std::runtime_error("Expected number after '" + std::string(1, op) + "' in time reference");
+        }
+
+        while (is_digit(peek())) {
+            offset = offset * 10 + (next() - '0');
+            if (offset > 1000000) {
+                throw std::runtime_error("Time reference offset out of range");
+            }
+        }
+
+        if (op == '-') {
+            offset = -offset;
+        }
+    }
+
+    skip_whitespace();
+
+    // Expect ']'
+    if (peek() != ']') {
+        throw std::runtime_error("Expected ']' to close time reference");
+    }
+    next();
+
+    return offset;
+}
+
+void FormulaParser::collect_dependencies(
+    std::string_view text,
+    std::set<std::string_view>& deps,
+    std::set<std::string_view>& shifted
+) {
+    size_t pos = 0;
+    while (pos < text.length()) {
+        while (pos < text.length() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+        if (pos >= text.length()) break;
+
+        // Skip string literals
+        if (text[pos] == '"' || text[pos] == '\'') {
+            char quote = text[pos++];
+            while (pos < text.length() && text[pos] != quote) {
+                pos++;
+            }
+            if (pos < text.length()) {
+                pos++;  // skip closing quote
+            }
+            continue;
+        }
+
+        if (!is_alpha(text[pos])) {
+            pos++;
+            continue;
+        }
+
+        size_t start = pos;
+        while (pos < text.length() && (is_alnum(text[pos]) || text[pos] == ':')) {
+            pos++;
+        }
+        std::string_view identifier = text.substr(start, pos - start);
+
+        while (pos < text.length() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+
+        // Function call - recursively extract deps from arguments
+        if (pos < text.length() && text[pos] == '(') {
+            int depth = 1;
+            pos++;  // skip '('
+            size_t arg_start = pos;
+            while (depth > 0 && pos < text.length()) {
+                if (text[pos] == '(') depth++;
+                else if (text[pos] == ')') depth--;
+
+                if (depth > 0) {
+                    pos++;
+                }
+            }
+
+            if (pos > arg_start) {
+                const std::string_view args = text.substr(arg_start, pos - arg_start);
+                if (identifier == "SUM_WINDOW" || identifier == "AVG_WINDOW") {
+                    // Windows end at t-1
+                    collect_dependencies(args, shifted, shifted);
+                } else if (identifier == "GROWTH") {
+                    collect_dependencies(args, deps, shifted);
+                    collect_dependencies(args, shifted, shifted);
+                } else {
+                    collect_dependencies(args, deps, shifted);
+                }
+            }
+            if (pos < text.length() && text[pos] == ')') {
+                pos++;  // skip ')'
+            }
+            continue;
+        }
+
+        // Check for time reference [t-1]
+        bool is_time_shifted = false;
+        if (pos < text.length() && text[pos] == '[') {
+            is_time_shifted = true;
+            pos++;  // skip '['
+            while (pos < text.length() && text[pos] != ']') {
+                pos++;
+            }
+            if (pos < text.length() && text[pos] == ']') {
+                pos++;
+            }
+        }
+
+        // Skip "driver:" and "action:" references - they fetch from scenario_drivers
+        // table or action activations, not from calculated line item values,
+        // so they're not true dependencies
+        if (identifier.length() > 7 &&
+            (identifier.substr(0, 7) == "driver:" || identifier.substr(0, 7) == "action:")) {
+            continue;
+        }
+
+        (is_time_shifted ? shifted : deps).insert(identifier);
+    }
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,133 @@
+/**
+ * @file function_registry.cpp
+ * @brief Built-in formula functions
+ */
+
+#include "core/function_registry.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+double fn_min(const double* args, uint32_t) { return std::min(args[0], args[1]); }
+double fn_max(const double* args, uint32_t) { return std::max(args[0], args[1]); }
+double fn_abs(const double* args, uint32_t) { return std::abs(args[0]); }
+double fn_if(const double* args, uint32_t) { return (args[0] != 0.0) ? args[1] : args[2]; }
+
+double fn_sum(const double* args, uint32_t argc) {
+    double total = 0.0;
+    for (uint32_t i = 0; i < argc; ++i) {
+        total += args[i];
+    }
+    return total;
+}
+
+double fn_avg(const double* args, uint32_t argc) {
+    return fn_sum(args, argc) / static_cast<double>(argc);
+}
+
+double fn_round(const double* args, uint32_t argc) {
+    // Half away from zero, like spreadsheet ROUND
+    if (argc == 1) {
+        return std::round(args[0]);
+    }
+    const double scale = std::pow(10.0, std::round(args[1]));
+    return std::round(args[0] * scale) / scale;
+}
+
+double fn_clamp(const double* args, uint32_t) {
+    if (args[1] > args[2]) {
+        throw std::runtime_error("CLAMP lower bound is greater than upper bound");
+    }
+    return std::min(std::max(args[0], args[1]), args[2]);
+}
+
+double fn_and(const double* args, uint32_t argc) {
+    for (uint32_t i = 0; i < argc; ++i) {
+        if (args[i] == 0.0) return 0.0;
+    }
+    return 1.0;
+}
+
+double fn_or(const double* args, uint32_t argc) {
+    for (uint32_t i = 0; i < argc; ++i) {
+        if (args[i] != 0.0) return 1.0;
+    }
+    return 0.0;
+}
+
+FunctionRegistry make_builtins() {
+    FunctionRegistry registry;
+    // Registration order must match FunctionRegistry::BuiltinId
+    registry.register_function("MIN", 2, 2, fn_min);
+    registry.register_function("MAX", 2, 2, fn_max);
+    registry.register_function("ABS", 1, 1, fn_abs);
+    registry.register_function("IF", 3, 3, fn_if);
+    registry.register_function("SUM", 1, FunctionRegistry::VARIADIC, fn_sum);
+    registry.register_function("AVG", 1, FunctionRegistry::VARIADIC, fn_avg);
+    registry.register_function("ROUND", 1, 2, fn_round);
+    registry.register_function("CLAMP", 3, 3, fn_clamp);
+    registry.register_function("AND", 1, FunctionRegistry::VARIADIC, fn_and);
+    registry.register_function("OR", 1, FunctionRegistry::VARIADIC, fn_or);
+    return registry;
+}
+
+} // namespace
+
+const FunctionRegistry& FunctionRegistry::builtins() {
+    static const FunctionRegistry registry = make_builtins();
+    return registry;
+}
+
+uint32_t FunctionRegistry::register_function(
+    const std::string& name,
+    uint32_t min_args,
+    uint32_t max_args,
+    BuiltinFunction fn,
+    bool pure
+) {
+    if (!fn) {
+        throw std::invalid_argument("Function " + name + " has no implementation");
+    }
+    if (min_args > max_args) {
+        throw std::invalid_argument("Function " + name + " has min_args > max_args");
+    }
+    if (index_.count(name)) {
+        throw std::invalid_argument("Function already registered: " + name);
+    }
+
+    uint32_t id = static_cast<uint32_t>(functions_.size());
+    functions_.push_back({name, id, min_args, max_args, pure, fn});
+    index_.emplace(name, id);
+    return id;
+}
+
+const FunctionDef* FunctionRegistry::find(std::string_view name) const {
+    auto it = index_.find(name);
+    return (it != index_.end()) ? &functions_[it->second] : nullptr;
+}
+
+void FunctionRegistry::check_arity(const FunctionDef& def, uint32_t argc) {
+    if (argc >= def.min_args && argc <= def.max_args) {
+        return;
+    }
+
+    std::string expected;
+    if (def.min_args == def.max_args) {
+        expected = "exactly " + std::to_string(def.min_args) +
+                   (def.min_args == 1 ? " argument" : " arguments");
+    } else if (def.max_args == VARIADIC) {
+        expected = "at least " + std::to_string(def.min_args) +
+                   (def.min_args == 1 ? " argument" : " arguments");
+    } else {
+        expected = std::to_string(def.min_args) + " to " + std::to_string(def.max_args) + " arguments";
+    }
+    throw std::runtime_error(def.name + " requires " + expected + ", got " + std::to_string(argc));
+}
+
+} // namespace core
+} // namespace finmodel
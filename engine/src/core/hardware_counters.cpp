@@ -0,0 +1,166 @@
+/**
+ * @file hardware_counters.cpp
+ * @brief perf_event_open groups of the hardware counters
+ */
+
+#include "core/hardware_counters.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+/**
+ * @brief The perf event group of one thread (closed when the thread ends)
+ */
+class EventGroup {
+public:
+    EventGroup() { open(); }
+
+    ~EventGroup() {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            close(fd);
+        }
+#endif
+    }
+
+    EventGroup(const EventGroup&) = delete;
+    EventGroup& operator=(const EventGroup&) = delete;
+
+    bool has(HardwareCounters::Event event) const {
+        for (auto counted : events_) {
+            if (counted == event) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool available() const { return !fds_.empty(); }
+    const std::string& reason() const { return reason_; }
+
+    HardwareCounts read_counts() const {
+        HardwareCounts counts;
+#if defined(__linux__)
+        if (fds_.empty()) {
+            return counts;
+        }
+        // PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING: nr, enabled, running, values
+        uint64_t buffer[3 + HardwareCounters::EVENT_COUNT] = {};
+        const ssize_t size = ::read(fds_.front(), buffer, sizeof(buffer));
+        if (size < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+            return counts;
+        }
+        const uint64_t enabled = buffer[1];
+        const uint64_t running = buffer[2];
+        const double scale = (running > 0 && running < enabled)
+                                 ? static_cast<double>(enabled) / static_cast<double>(running)
+                                 : 1.0;
+        const size_t count = std::min<size_t>(buffer[0], events_.size());
+        for (size_t i = 0; i < count; ++i) {
+            counts.values[static_cast<size_t>(events_[i])] =
+                static_cast<uint64_t>(static_cast<double>(buffer[3 + i]) * scale);
+        }
+#endif
+        return counts;
+    }
+
+private:
+    void open() {
+#if defined(__linux__)
+        struct Config {
+            HardwareCounters::Event event;
+            uint32_t type;
+            uint64_t config;
+        };
+        static const Config configs[] = {
+            {HardwareCounters::Event::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {HardwareCounters::Event::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {HardwareCounters::Event::L1D_MISSES, PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {HardwareCounters::Event::LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {HardwareCounters::Event::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (const auto& config : configs) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = config.type;
+            attr.config = config.config;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            const int leader = fds_.empty() ? -1 : fds_.front();
+            const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                // Not offered here (e.g. no LLC event in a VM): left out of the group
+                if (reason_.empty()) {
+                    reason_ = std::string("perf_event_open(") + HardwareCounters::event_name(config.event) +
+                              "): " + std::strerror(errno);
+                }
+                continue;
+            }
+            fds_.push_back(fd);
+            events_.push_back(config.event);
+        }
+        if (!fds_.empty()) {
+            reason_.clear();
+        }
+#else
+        reason_ = "hardware counters need Linux perf_event_open";
+#endif
+    }
+
+    std::vector<int> fds_;                          ///< Leader first
+    std::vector<HardwareCounters::Event> events_;   ///< Of fds_, in read order
+    std::string reason_;
+};
+
+EventGroup& thread_group() {
+    static thread_local EventGroup group;
+    return group;
+}
+
+} // namespace
+
+const char* HardwareCounters::event_name(Event event) {
+    switch (event) {
+        case Event::CYCLES: return "cycles";
+        case Event::INSTRUCTIONS: return "instructions";
+        case Event::L1D_MISSES: return "l1d_misses";
+        case Event::LLC_MISSES: return "llc_misses";
+        case Event::BRANCH_MISSES: return "branch_misses";
+    }
+    return "unknown";
+}
+
+HardwareCounts HardwareCounters::thread_counts() {
+    return enabled() ? thread_group().read_counts() : HardwareCounts{};
+}
+
+bool HardwareCounters::has(Event event) {
+    return thread_group().has(event);
+}
+
+bool HardwareCounters::available() {
+    return thread_group().available();
+}
+
+std::string HardwareCounters::unavailable_reason() {
+    return thread_group().reason();
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,304 @@
+/**
+ * @file lane_evaluator.cpp
+ * @brief Structure-of-arrays formula interpreter implementation
+ */
+
+#include "core/lane_evaluator.h"
+#include <limits>
+#include <stdexcept>
+#include <sstream>
+
+namespace finmodel {
+namespace core {
+
+LaneEvaluator::LaneEvaluator(size_t lane_count)
+    : lane_count_(lane_count)
+{
+    if (lane_count_ == 0) {
+        throw std::invalid_argument("LaneEvaluator requires at least one lane");
+    }
+}
+
+LaneArray LaneEvaluator::evaluate(
+    const CompiledFormula& compiled,
+    const LaneLoader& load,
+    const FormulaEvaluator::CustomFunctionHandler& custom_functions
+) {
+    // A mixed IF keeps its then value on the stack while else runs, so
+    // each IF may need one slot beyond the scalar depth
+    const auto& code = compiled.code();
+    size_t depth = compiled.max_stack_depth();
+    for (const auto& ins : code) {
+        if (ins.op == OpCode::JUMP_IF_FALSE) ++depth;
+    }
+    if (stack_.size() < depth) {
+        stack_.resize(depth, LaneArray(lane_count_));
+    }
+
+    size_t sp = 0;  // Next free stack slot
+    branches_.clear();
+
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        merge_branches(pc, sp);
+
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+                stack_[sp++].setConstant(compiled.constants()[ins.operand]);
+                break;
+            case OpCode::LOAD_VAR: {
+                LaneArray& out = stack_[sp++];
+                load(compiled.variables()[ins.operand], ins.operand, out);
+                if (static_cast<size_t>(out.size()) != lane_count_) {
+                    throw std::runtime_error("Lane loader returned " +
+                                           std::to_string(out.size()) + " values for " +
+                                           std::to_string(lane_count_) + " lanes: " +
+                                           compiled.variables()[ins.operand].code);
+                }
+                break;
+            }
+            case OpCode::NEG:
+                stack_[sp - 1] = -stack_[sp - 1];
+                break;
+            case OpCode::ADD:
+                --sp;
+                stack_[sp - 1] += stack_[sp];
+                break;
+            case OpCode::SUB:
+                --sp;
+                stack_[sp - 1] -= stack_[sp];
+                break;
+            case OpCode::MUL:
+                --sp;
+                stack_[sp - 1] *= stack_[sp];
+                break;
+            case OpCode::DIV:
+                --sp;
+                // A zero divisor in a lane a mixed branch discards isn't an error:
+                // its inf/NaN quotient is dropped by merge_branches()
+                if ((stack_[sp] == 0.0).any() && ((stack_[sp] == 0.0) && active_lanes()).any()) {
+                    std::ostringstream oss;
+                    oss << "Division by zero at position " << ins.position;
+                    throw std::runtime_error(oss.str());
+                }
+                stack_[sp - 1] /= stack_[sp];
+                break;
+            case OpCode::POW:
+                --sp;
+                stack_[sp - 1] = stack_[sp - 1].pow(stack_[sp]);
+                break;
+            case OpCode::CMP_LT:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] < stack_[sp]).cast<double>();
+                break;
+            case OpCode::CMP_LE:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] <= stack_[sp]).cast<double>();
+                break;
+            case OpCode::CMP_GT:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] > stack_[sp]).cast<double>();
+                break;
+            case OpCode::CMP_GE:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] >= stack_[sp]).cast<double>();
+                break;
+            case OpCode::CMP_EQ:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] == stack_[sp]).cast<double>();
+                break;
+            case OpCode::CMP_NE:
+                --sp;
+                stack_[sp - 1] = (stack_[sp - 1] != stack_[sp]).cast<double>();
+                break;
+            case OpCode::CALL_BUILTIN: {
+                const auto& call = compiled.functions()[ins.operand];
+                sp -= call.arg_count;
+                if (!call_vectorised(call, sp)) {
+                    call_per_lane(call, sp, custom_functions);
+                }
+                ++sp;
+                break;
+            }
+            case OpCode::CALL: {
+                const auto& call = compiled.functions()[ins.operand];
+                sp -= call.arg_count;
+                call_per_lane(call, sp, custom_functions);
+                ++sp;
+                break;
+            }
+            case OpCode::TAX_COMPUTE: {
+                const auto& call = compiled.functions()[ins.operand];
+                if (!custom_functions) {
+                    throw std::runtime_error("TAX_COMPUTE requires custom function handler");
+                }
+                // One argument, handled by the strategy named in the call
+                call_per_lane(call, sp - 1, custom_functions);
+                break;
+            }
+            case OpCode::MEMO_CHECK:
+            case OpCode::MEMO_STORE:
+                // Shared subexpressions are evaluated in place across lanes
+                break;
+            case OpCode::JUMP_IF_FALSE: {
+                --sp;
+                const LaneArray& cond = stack_[sp];
+                if ((cond != 0.0).all()) {
+                    // Every lane takes the then branch: skip else at its JUMP
+                    branches_.push_back({OpCode::JUMP, UINT32_MAX, LaneArray()});
+                } else if ((cond == 0.0).all()) {
+                    pc = ins.target - 1;
+                } else {
+                    // Mixed: run both branches and blend where they meet
+                    branches_.push_back({OpCode::JUMP_IF_FALSE, UINT32_MAX, (cond != 0.0).cast<double>()});
+                }
+                break;
+            }
+            case OpCode::JUMP: {
+                Branch& branch = branches_.back();
+                if (branch.op == OpCode::JUMP) {
+                    branches_.pop_back();
+                    pc = ins.target - 1;
+                } else {
+                    branch.end = ins.target;  // Fall through into else
+                }
+                break;
+            }
+            case OpCode::SHORT_AND:
+            case OpCode::SHORT_OR: {
+                LaneArray& top = stack_[sp - 1];
+                const bool is_and = (ins.op == OpCode::SHORT_AND);
+                const bool all_decided = is_and ? (top == 0.0).all() : (top != 0.0).all();
+                if (all_decided) {
+                    top.setConstant(is_and ? 0.0 : 1.0);
+                    pc = ins.target - 1;
+                } else if (is_and ? (top != 0.0).all() : (top == 0.0).all()) {
+                    --sp;  // No lane is decided yet
+                } else {
+                    branches_.push_back({ins.op, ins.target, (top != 0.0).cast<double>()});
+                    --sp;
+                }
+                break;
+            }
+            case OpCode::TO_BOOL:
+                stack_[sp - 1] = (stack_[sp - 1] != 0.0).cast<double>();
+                break;
+        }
+    }
+    merge_branches(code.size(), sp);
+
+    return stack_[0];
+}
+
+LaneMask LaneEvaluator::active_lanes() const {
+    LaneMask active = LaneMask::Constant(static_cast<Eigen::Index>(lane_count_), true);
+    for (const Branch& branch : branches_) {
+        switch (branch.op) {
+            case OpCode::JUMP_IF_FALSE:
+                // Then branch until its JUMP sets end, else branch after
+                if (branch.end == UINT32_MAX) {
+                    active = active && (branch.mask != 0.0);
+                } else {
+                    active = active && (branch.mask == 0.0);
+                }
+                break;
+            case OpCode::SHORT_AND:
+                active = active && (branch.mask != 0.0);   // Right side decides where the left was true
+                break;
+            case OpCode::SHORT_OR:
+                active = active && (branch.mask == 0.0);
+                break;
+            default:
+                break;
+        }
+    }
+    return active;
+}
+
+void LaneEvaluator::merge_branches(size_t pc, size_t& sp) {
+    while (!branches_.empty() && branches_.back().end == pc) {
+        const Branch& branch = branches_.back();
+        const auto taken = (branch.mask != 0.0);
+        switch (branch.op) {
+            case OpCode::JUMP_IF_FALSE:
+                // Stack: then value, else value
+                --sp;
+                stack_[sp - 1] = taken.select(stack_[sp - 1], stack_[sp]);
+                break;
+            case OpCode::SHORT_AND:
+                stack_[sp - 1] = taken.select(stack_[sp - 1], 0.0);
+                break;
+            case OpCode::SHORT_OR:
+                stack_[sp - 1] = taken.select(1.0, stack_[sp - 1]);
+                break;
+            default:
+                break;
+        }
+        branches_.pop_back();
+    }
+}
+
+bool LaneEvaluator::call_vectorised(const FunctionCall& call, size_t base) {
+    LaneArray& a = stack_[base];
+    switch (call.function_id) {
+        case FunctionRegistry::FN_MIN:
+            a = a.min(stack_[base + 1]);
+            return true;
+        case FunctionRegistry::FN_MAX:
+            a = a.max(stack_[base + 1]);
+            return true;
+        case FunctionRegistry::FN_ABS:
+            a = a.abs();
+            return true;
+        case FunctionRegistry::FN_IF:
+            a = (a != 0.0).select(stack_[base + 1], stack_[base + 2]);
+            return true;
+        case FunctionRegistry::FN_SUM:
+        case FunctionRegistry::FN_AVG:
+            for (uint32_t i = 1; i < call.arg_count; ++i) {
+                a += stack_[base + i];
+            }
+            if (call.function_id == FunctionRegistry::FN_AVG) {
+                a /= static_cast<double>(call.arg_count);
+            }
+            return true;
+        case FunctionRegistry::FN_CLAMP:
+            if ((stack_[base + 1] > stack_[base + 2]).any()) {
+                return false;  // Scalar path raises the error
+            }
+            a = a.max(stack_[base + 1]).min(stack_[base + 2]);
+            return true;
+        default:
+            return false;  // ROUND and user-registered functions
+    }
+}
+
+void LaneEvaluator::call_per_lane(
+    const FunctionCall& call,
+    size_t base,
+    const FormulaEvaluator::CustomFunctionHandler& custom_functions
+) {
+    scalar_args_.resize(call.arg_count);
+    LaneArray& result = stack_[base];
+
+    for (size_t lane = 0; lane < lane_count_; ++lane) {
+        for (uint32_t a = 0; a < call.arg_count; ++a) {
+            scalar_args_[a] = stack_[base + a][lane];
+        }
+        // Writing lane result into arg 0 is safe: it was copied above. A
+        // custom handler takes the scratch vector itself, so no lane allocates
+        try {
+            result[lane] = (!call.builtin && custom_functions)
+                ? custom_functions(call.name, scalar_args_)
+                : FormulaEvaluator::call_function(call, scalar_args_.data(), custom_functions);
+        } catch (const std::runtime_error&) {
+            if (branches_.empty() || active_lanes()[static_cast<Eigen::Index>(lane)]) {
+                throw;
+            }
+            result[lane] = std::numeric_limits<double>::quiet_NaN();   // Discarded by the merge
+        }
+    }
+}
+
+} // namespace core
+} // namespace finmodel
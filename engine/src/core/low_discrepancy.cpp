@@ -0,0 +1,246 @@
+#include "core/low_discrepancy.h"
+#include "core/philox_stream.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+constexpr double TWO_POW_32 = 4294967296.0;
+
+uint32_t random_bits(PhiloxStream& stream) {
+    return static_cast<uint32_t>(stream.uniform() * TWO_POW_32);
+}
+
+// Product of two polynomials over GF(2) modulo one of the given degree
+uint64_t multiply_mod(uint64_t a, uint64_t b, uint64_t poly, int degree) {
+    uint64_t result = 0;
+    while (b) {
+        if (b & 1) {
+            result ^= a;
+        }
+        b >>= 1;
+        a <<= 1;
+        if (a >> degree & 1) {
+            a ^= poly;
+        }
+    }
+    return result;
+}
+
+uint64_t power_mod(uint64_t exponent, uint64_t poly, int degree) {
+    uint64_t result = 1;
+    uint64_t base = degree > 1 ? 2 : 1;     // x (x ≡ 1 modulo x + 1)
+    while (exponent) {
+        if (exponent & 1) {
+            result = multiply_mod(result, base, poly, degree);
+        }
+        base = multiply_mod(base, base, poly, degree);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+// x has order 2^degree - 1 modulo the polynomial
+bool is_primitive(uint64_t poly, int degree) {
+    const uint64_t order = (uint64_t{1} << degree) - 1;
+    if (power_mod(order, poly, degree) != 1) {
+        return false;
+    }
+    uint64_t rest = order;
+    for (uint64_t q = 2; q * q <= rest; ++q) {
+        if (rest % q == 0) {
+            if (power_mod(order / q, poly, degree) == 1) {
+                return false;
+            }
+            while (rest % q == 0) {
+                rest /= q;
+            }
+        }
+    }
+    return rest == 1 || power_mod(order / rest, poly, degree) != 1;
+}
+
+} // namespace
+
+double normal_quantile(double p) {
+    if (!(p > 0.0)) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    if (!(p < 1.0)) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    static constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                   1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                   6.680131188771972e+01, -1.328068155288572e+01};
+    static constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                   -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                   3.754408661907416e+00};
+    constexpr double low = 0.02425;
+
+    double x;
+    if (p < low || p > 1.0 - low) {
+        const double q = std::sqrt(-2.0 * std::log(p < low ? p : 1.0 - p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        if (p > low) {
+            x = -x;
+        }
+    } else {
+        const double q = p - 0.5;
+        const double r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+            (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+    }
+
+    // Halley step on Φ(x) - p
+    const double e = 0.5 * std::erfc(-x / std::sqrt(2.0)) - p;
+    const double u = e * std::sqrt(2.0 * M_PI) * std::exp(x * x / 2.0);
+    return x - u / (1.0 + x * u / 2.0);
+}
+
+// SobolSequence implementation
+
+SobolSequence::SobolSequence(size_t dimensions, uint64_t seed) : seed_(seed), directions_(dimensions) {
+    if (dimensions == 0) {
+        return;
+    }
+    for (int bit = 0; bit < 32; ++bit) {
+        directions_[0][bit] = uint32_t{1} << (31 - bit);
+    }
+
+    PhiloxStream stream(seed, 0);
+    int degree = 1;
+    uint64_t poly = 0b11;
+    for (size_t dim = 1; dim < dimensions; ++dim) {
+        // Next primitive polynomial x^degree + ... + 1
+        while (!is_primitive(poly, degree)) {
+            poly += 2;
+            if (poly >> (degree + 1)) {
+                ++degree;
+                poly = (uint64_t{1} << degree) | 1;
+            }
+        }
+
+        // Initial m_i odd and below 2^i, then the Bratley-Fox recurrence
+        std::array<uint32_t, 32> m{};
+        for (int i = 1; i <= degree && i <= 32; ++i) {
+            m[i - 1] = (random_bits(stream) >> (32 - i)) | 1u;
+        }
+        for (int i = degree + 1; i <= 32; ++i) {
+            uint32_t value = m[i - degree - 1] ^ (m[i - degree - 1] << degree);
+            for (int k = 1; k < degree; ++k) {
+                if (poly >> (degree - k) & 1) {
+                    value ^= m[i - k - 1] << k;
+                }
+            }
+            m[i - 1] = value;
+        }
+        for (int i = 1; i <= 32; ++i) {
+            directions_[dim][i - 1] = m[i - 1] << (32 - i);
+        }
+
+        poly += 2;
+        if (poly >> (degree + 1)) {
+            ++degree;
+            poly = (uint64_t{1} << degree) | 1;
+        }
+    }
+}
+
+std::vector<uint32_t> SobolSequence::scramble(uint64_t replicate) const {
+    PhiloxStream stream(seed_, replicate + 1);
+    std::vector<uint32_t> shift(directions_.size());
+    for (auto& s : shift) {
+        s = random_bits(stream);
+    }
+    return shift;
+}
+
+double SobolSequence::coordinate(uint32_t index, size_t dimension, uint32_t shift) const {
+    const auto& v = directions_[dimension];
+    uint32_t x = shift;
+    for (int bit = 0; index; ++bit, index >>= 1) {
+        if (index & 1) {
+            x ^= v[bit];
+        }
+    }
+    return (static_cast<double>(x) + 0.5) / TWO_POW_32;
+}
+
+// HaltonSequence implementation
+
+HaltonSequence::HaltonSequence(size_t dimensions, uint64_t seed) : seed_(seed) {
+    bases_.reserve(dimensions);
+    for (uint32_t candidate = 2; bases_.size() < dimensions; ++candidate) {
+        bool prime = true;
+        for (uint32_t base : bases_) {
+            if (base * base > candidate) {
+                break;
+            }
+            if (candidate % base == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) {
+            bases_.push_back(candidate);
+        }
+    }
+
+    // Fisher-Yates over digits 1..base-1 (0 stays 0, so trailing zeros add nothing)
+    PhiloxStream stream(seed, 0);
+    permutations_.reserve(dimensions);
+    for (size_t dim = 0; dim < dimensions; ++dim) {
+        std::vector<uint32_t> permutation(bases_[dim]);
+        std::iota(permutation.begin(), permutation.end(), 0u);
+        if (dim > 0) {
+            for (uint32_t i = bases_[dim] - 1; i > 1; --i) {
+                const auto j = 1 + static_cast<uint32_t>(stream.uniform() * i);
+                std::swap(permutation[i], permutation[std::min(j, i)]);
+            }
+        }
+        permutations_.push_back(std::move(permutation));
+    }
+}
+
+std::vector<double> HaltonSequence::scramble(uint64_t replicate) const {
+    PhiloxStream stream(seed_, replicate + 1);
+    std::vector<double> rotation(bases_.size());
+    for (auto& r : rotation) {
+        r = stream.uniform();
+    }
+    return rotation;
+}
+
+double HaltonSequence::coordinate(uint64_t index, size_t dimension, double rotation) const {
+    const uint32_t base = bases_[dimension];
+    const auto& permutation = permutations_[dimension];
+    const double inverse = 1.0 / base;
+
+    // Radical inverse of index + 1 (index 0 would be the origin)
+    double value = 0.0;
+    double factor = inverse;
+    for (uint64_t i = index + 1; i; i /= base, factor *= inverse) {
+        value += permutation[i % base] * factor;
+    }
+    value += rotation;
+    if (value >= 1.0) {
+        value -= 1.0;
+    }
+    if (!(value > 0.0)) {
+        value = std::numeric_limits<double>::min();
+    }
+    return std::min(value, std::nextafter(1.0, 0.0));
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,643 @@
+/**
+ * @file native_kernel.cpp
+ * @brief Native kernel source generation, compilation and loading
+ */
+
+#include "core/native_kernel.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+/**
+ * @brief How generated code reads state and calls math
+ *
+ * Scalar kernels index the state directly and use <cmath>; lane kernels
+ * index a lane's column and stick to what CUDA device code can call.
+ */
+struct Dialect {
+    std::function<std::string(uint32_t)> slot;  ///< Expression for a state slot
+    const char* math = "std::";                 ///< Prefix of pow() / fabs()
+    bool lane_constants = false;                ///< Infinities and NaN via FINMODEL_INF / FINMODEL_NAN
+    bool table_functions = true;                ///< Built-ins may be called through the fns table
+};
+
+/**
+ * @brief Exact C++ literal for a double
+ */
+std::string literal(double value, bool lane_constants = false) {
+    if (std::isnan(value)) {
+        return lane_constants ? "FINMODEL_NAN" : "__builtin_nan(\"\")";
+    }
+    if (std::isinf(value)) {
+        if (lane_constants) {
+            return value > 0 ? "FINMODEL_INF" : "(-FINMODEL_INF)";
+        }
+        return value > 0 ? "__builtin_inf()" : "(-__builtin_inf())";
+    }
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%a", value);
+    return buf;
+}
+
+/**
+ * @brief Formula text for a one-line // comment of the generated source
+ *
+ * Formulas may span lines: a line break would end the comment and a
+ * backslash before one would splice the next line into it, so control
+ * characters and backslashes become spaces.
+ */
+std::string comment_text(const std::string& text) {
+    std::string line = text;
+    for (char& c : line) {
+        if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f || c == '\\') {
+            c = ' ';
+        }
+    }
+    return line;
+}
+
+/**
+ * @brief FNV-1a, stable across builds and runs (std::hash isn't)
+ */
+uint64_t stable_hash(const std::string& text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool is_builtin(const FunctionCall& call, FunctionRegistry::BuiltinId id) {
+    return call.builtin == FunctionRegistry::builtins().get(id).fn;
+}
+
+/**
+ * @brief Emit one formula as a block of straight-line code
+ */
+void emit_formula(
+    std::ostringstream& out,
+    size_t index,
+    const NativeKernel::Formula& formula,
+    const Dialect& dialect,
+    std::unordered_map<BuiltinFunction, size_t>& builtin_index,
+    std::vector<BuiltinFunction>& builtins
+) {
+    const CompiledFormula& compiled = *formula.compiled;
+    const auto& code = compiled.code();
+    if (formula.variable_slots.size() != compiled.variables().size()) {
+        throw std::invalid_argument("Native kernel: variable slots don't match formula '" +
+                                    compiled.source() + "'");
+    }
+
+    // Jump targets get labels; the stack depth there is recorded by the jump
+    std::vector<uint8_t> is_target(code.size() + 1, 0);
+    for (const auto& ins : code) {
+        switch (ins.op) {
+            case OpCode::JUMP:
+            case OpCode::JUMP_IF_FALSE:
+            case OpCode::SHORT_AND:
+            case OpCode::SHORT_OR:
+            case OpCode::MEMO_CHECK:
+                is_target[ins.target] = 1;
+                break;
+            default:
+                break;
+        }
+    }
+    std::vector<int> depth_at(code.size() + 1, -1);
+
+    const std::string prefix = "f" + std::to_string(index) + "_";
+    auto label = [&](size_t pc) { return prefix + std::to_string(pc); };
+    auto s = [](size_t i) { return "s[" + std::to_string(i) + "]"; };
+    auto jump_to = [&](uint32_t target, size_t depth) {
+        depth_at[target] = static_cast<int>(depth);
+        return "goto " + label(target) + ";";
+    };
+
+    out << "    // " << comment_text(compiled.source()) << "\n";
+    out << "    {\n";
+    out << "        double s[" << std::max<size_t>(compiled.max_stack_depth(), 1) << "];\n";
+
+    size_t sp = 0;
+    bool reachable = true;
+    for (size_t pc = 0; pc <= code.size(); ++pc) {
+        if (!reachable && depth_at[pc] >= 0) {
+            sp = static_cast<size_t>(depth_at[pc]);
+            reachable = true;
+        }
+        if (is_target[pc]) {
+            out << "    " << label(pc) << ": ;\n";
+        }
+        if (pc == code.size()) {
+            break;
+        }
+
+        const Instruction& ins = code[pc];
+        out << "        ";
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+                out << s(sp) << " = " << literal(compiled.constants()[ins.operand], dialect.lane_constants) << ";";
+                ++sp;
+                break;
+            case OpCode::LOAD_VAR:
+                out << s(sp) << " = " << dialect.slot(formula.variable_slots[ins.operand]) << ";";
+                ++sp;
+                break;
+            case OpCode::NEG:
+                out << s(sp - 1) << " = -" << s(sp - 1) << ";";
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL: {
+                const char* sym = ins.op == OpCode::ADD ? " += " : ins.op == OpCode::SUB ? " -= " : " *= ";
+                --sp;
+                out << s(sp - 1) << sym << s(sp) << ";";
+                break;
+            }
+            case OpCode::DIV:
+                --sp;
+                out << "if (" << s(sp) << " == 0.0) return " << (index + 1) << "; "
+                    << s(sp - 1) << " /= " << s(sp) << ";";
+                break;
+            case OpCode::POW:
+                --sp;
+                out << s(sp - 1) << " = " << dialect.math << "pow(" << s(sp - 1) << ", " << s(sp) << ");";
+                break;
+            case OpCode::CMP_LT:
+            case OpCode::CMP_LE:
+            case OpCode::CMP_GT:
+            case OpCode::CMP_GE:
+            case OpCode::CMP_EQ:
+            case OpCode::CMP_NE: {
+                static const char* const syms[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+                const char* sym = syms[static_cast<int>(ins.op) - static_cast<int>(OpCode::CMP_LT)];
+                --sp;
+                out << s(sp - 1) << " = (" << s(sp - 1) << sym << s(sp) << ") ? 1.0 : 0.0;";
+                break;
+            }
+            case OpCode::CALL_BUILTIN: {
+                const auto& call = compiled.functions()[ins.operand];
+                sp -= call.arg_count;
+                const size_t base = sp;
+                // Simple built-ins inline (same operand order as std::min/max)
+                if (is_builtin(call, FunctionRegistry::FN_MIN)) {
+                    out << s(base) << " = (" << s(base + 1) << " < " << s(base) << ") ? "
+                        << s(base + 1) << " : " << s(base) << ";";
+                } else if (is_builtin(call, FunctionRegistry::FN_MAX)) {
+                    out << s(base) << " = (" << s(base) << " < " << s(base + 1) << ") ? "
+                        << s(base + 1) << " : " << s(base) << ";";
+                } else if (is_builtin(call, FunctionRegistry::FN_ABS)) {
+                    out << s(base) << " = " << dialect.math << "fabs(" << s(base) << ");";
+                } else if (is_builtin(call, FunctionRegistry::FN_SUM) ||
+                           is_builtin(call, FunctionRegistry::FN_AVG)) {
+                    out << s(base) << " = (0.0";
+                    for (uint32_t a = 0; a < call.arg_count; ++a) {
+                        out << " + " << s(base + a);
+                    }
+                    out << ")";
+                    if (is_builtin(call, FunctionRegistry::FN_AVG)) {
+                        out << " / " << literal(static_cast<double>(call.arg_count));
+                    }
+                    out << ";";
+                } else {
+                    if (!dialect.table_functions) {
+                        throw std::invalid_argument("Native kernel: built-in '" + call.name +
+                                                    "' is not available on the device");
+                    }
+                    auto [it, inserted] = builtin_index.emplace(call.builtin, builtins.size());
+                    if (inserted) {
+                        builtins.push_back(call.builtin);
+                    }
+                    out << s(base) << " = fns[" << it->second << "](&" << s(base) << ", "
+                        << call.arg_count << "u);  // " << call.name;
+                }
+                ++sp;
+                break;
+            }
+            case OpCode::CALL:
+            case OpCode::TAX_COMPUTE:
+                throw std::invalid_argument("Native kernel: custom function '" +
+                                            compiled.functions()[ins.operand].name +
+                                            "' in formula '" + compiled.source() + "'");
+            case OpCode::MEMO_CHECK:
+                out << "if (memo_ok[" << ins.operand << "]) { " << s(sp) << " = memo["
+                    << ins.operand << "]; " << jump_to(ins.target, sp + 1) << " }";
+                break;
+            case OpCode::MEMO_STORE:
+                out << "memo[" << ins.operand << "] = " << s(sp - 1) << "; memo_ok["
+                    << ins.operand << "] = true;";
+                break;
+            case OpCode::JUMP:
+                out << jump_to(ins.target, sp);
+                reachable = false;
+                break;
+            case OpCode::JUMP_IF_FALSE:
+                --sp;
+                out << "if (" << s(sp) << " == 0.0) " << jump_to(ins.target, sp);
+                break;
+            case OpCode::SHORT_AND:
+                out << "if (" << s(sp - 1) << " == 0.0) { " << s(sp - 1) << " = 0.0; "
+                    << jump_to(ins.target, sp) << " }";
+                --sp;
+                break;
+            case OpCode::SHORT_OR:
+                out << "if (" << s(sp - 1) << " != 0.0) { " << s(sp - 1) << " = 1.0; "
+                    << jump_to(ins.target, sp) << " }";
+                --sp;
+                break;
+            case OpCode::TO_BOOL:
+                out << s(sp - 1) << " = (" << s(sp - 1) << " != 0.0) ? 1.0 : 0.0;";
+                break;
+        }
+        out << "\n";
+    }
+
+    out << "        " << dialect.slot(formula.output_slot) << " = s[0];\n";
+    out << "    }\n";
+}
+
+} // namespace
+
+std::string NativeKernel::generate_source(
+    const std::vector<Formula>& formulas,
+    size_t shared_count,
+    std::vector<BuiltinFunction>& builtins
+) {
+    builtins.clear();
+    std::unordered_map<BuiltinFunction, size_t> builtin_index;
+    Dialect dialect;
+    dialect.slot = [](uint32_t slot) { return "state[" + std::to_string(slot) + "]"; };
+
+    std::ostringstream out;
+    out << "// Generated by finmodel::core::NativeKernel - do not edit\n";
+    out << "#include <cmath>\n\n";
+    out << "typedef double (*finmodel_builtin)(const double*, unsigned);\n\n";
+    out << "extern \"C\" int finmodel_kernel(double* state, const finmodel_builtin* fns) {\n";
+    out << "    (void)fns;\n";
+    out << "    double memo[" << std::max<size_t>(shared_count, 1) << "];\n";
+    out << "    bool memo_ok[" << std::max<size_t>(shared_count, 1) << "] = {};\n";
+    out << "    (void)memo;\n";
+    out << "    (void)memo_ok;\n";
+
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        if (!formulas[i].compiled) {
+            throw std::invalid_argument("Native kernel: null formula");
+        }
+        emit_formula(out, i, formulas[i], dialect, builtin_index, builtins);
+    }
+
+    out << "    return 0;\n";
+    out << "}\n";
+    return out.str();
+}
+
+std::string NativeKernel::generate_lane_source(
+    const std::vector<Formula>& formulas,
+    size_t shared_count,
+    LaneDevice device,
+    std::vector<BuiltinFunction>& builtins
+) {
+    builtins.clear();
+    std::unordered_map<BuiltinFunction, size_t> builtin_index;
+    Dialect dialect;
+    dialect.slot = [](uint32_t slot) { return "state[" + std::to_string(slot) + "u * lanes + l]"; };
+    dialect.math = "";
+    dialect.lane_constants = true;
+    // Host function pointers mean nothing on the device
+    dialect.table_functions = device == LaneDevice::HOST;
+
+    std::ostringstream out;
+    out << "// Generated by finmodel::core::NativeKernel - do not edit\n";
+    out << "#include <math.h>\n";
+    out << "#include <stddef.h>\n\n";
+    out << "#ifdef __CUDACC__\n";
+    out << "#include <cuda_runtime.h>\n";
+    out << "#define FINMODEL_LANE __device__\n";
+    out << "#define FINMODEL_INF __longlong_as_double(0x7ff0000000000000LL)\n";
+    out << "#define FINMODEL_NAN __longlong_as_double(0x7ff8000000000000LL)\n";
+    out << "#else\n";
+    out << "#define FINMODEL_LANE\n";
+    out << "#define FINMODEL_INF __builtin_inf()\n";
+    out << "#define FINMODEL_NAN __builtin_nan(\"\")\n";
+    out << "#endif\n\n";
+    out << "typedef double (*finmodel_builtin)(const double*, unsigned);\n\n";
+
+    out << "static FINMODEL_LANE int finmodel_lane(double* state, size_t lanes, size_t l, "
+           "const finmodel_builtin* fns) {\n";
+    out << "    (void)fns;\n";
+    out << "    double memo[" << std::max<size_t>(shared_count, 1) << "];\n";
+    out << "    bool memo_ok[" << std::max<size_t>(shared_count, 1) << "] = {};\n";
+    out << "    (void)memo;\n";
+    out << "    (void)memo_ok;\n";
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        if (!formulas[i].compiled) {
+            throw std::invalid_argument("Native kernel: null formula");
+        }
+        emit_formula(out, i, formulas[i], dialect, builtin_index, builtins);
+    }
+    out << "    return 0;\n";
+    out << "}\n\n";
+
+    // Device: one thread per lane, the first failing lane's code wins.
+    // Host (or a CUDA source given to the host compiler): a loop over lanes.
+    out << R"(#ifdef __CUDACC__
+__global__ static void finmodel_lane_global(double* state, size_t lanes, int* error) {
+    const size_t l = blockIdx.x * (size_t)blockDim.x + threadIdx.x;
+    if (l >= lanes) return;
+    const int rc = finmodel_lane(state, lanes, l, 0);
+    if (rc != 0) atomicCAS(error, 0, rc);
+}
+
+extern "C" int finmodel_lane_kernel(double* state, size_t slots, size_t lanes, const finmodel_builtin* fns) {
+    (void)fns;
+    if (lanes == 0 || slots == 0) return 0;
+    const size_t bytes = slots * lanes * sizeof(double);
+    double* device_state = 0;
+    int* device_error = 0;
+    int error = 0;
+    if (cudaMalloc((void**)&device_state, bytes) != cudaSuccess) return -1;
+    if (cudaMalloc((void**)&device_error, sizeof(int)) != cudaSuccess) {
+        cudaFree(device_state);
+        return -1;
+    }
+    bool ok = cudaMemcpy(device_state, state, bytes, cudaMemcpyHostToDevice) == cudaSuccess &&
+              cudaMemcpy(device_error, &error, sizeof(int), cudaMemcpyHostToDevice) == cudaSuccess;
+    if (ok) {
+        const unsigned threads = 128;
+        finmodel_lane_global<<<(unsigned)((lanes + threads - 1) / threads), threads>>>(device_state, lanes, device_error);
+        ok = cudaGetLastError() == cudaSuccess &&
+             cudaMemcpy(state, device_state, bytes, cudaMemcpyDeviceToHost) == cudaSuccess &&
+             cudaMemcpy(&error, device_error, sizeof(int), cudaMemcpyDeviceToHost) == cudaSuccess;
+    }
+    cudaFree(device_state);
+    cudaFree(device_error);
+    return ok ? error : -1;
+}
+
+extern "C" int finmodel_lane_device_available(void) {
+    int count = 0;
+    return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+#else
+extern "C" int finmodel_lane_kernel(double* state, size_t slots, size_t lanes, const finmodel_builtin* fns) {
+    (void)slots;
+    for (size_t l = 0; l < lanes; ++l) {
+        const int rc = finmodel_lane(state, lanes, l, fns);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+extern "C" int finmodel_lane_device_available(void) {
+    return 1;
+}
+#endif
+)";
+    return out.str();
+}
+
+#if !defined(_WIN32)
+namespace {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Refuse a cache entry another user could have written
+ *
+ * Libraries in the cache are loaded into the process: the directory and
+ * every library must belong to this user, be writable by nobody else and
+ * not be links.
+ */
+void check_private(const fs::path& path) {
+    struct stat info;
+    if (::lstat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Native kernel: cannot stat " + path.string() + ": " + std::strerror(errno));
+    }
+    if (S_ISLNK(info.st_mode) || info.st_uid != ::geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        throw std::runtime_error("Native kernel: " + path.string() +
+                                 " must be owned by this user and writable by nobody else");
+    }
+}
+
+/**
+ * @brief Create a cache directory (mode 0700) unless it exists; check it is private
+ */
+void make_private_dir(const fs::path& dir) {
+    std::error_code ignored;
+    fs::create_directories(dir.parent_path(), ignored);
+    if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Native kernel: cannot create " + dir.string() + ": " + std::strerror(errno));
+    }
+    check_private(dir);
+}
+
+/**
+ * @brief Cache directory of this user: $XDG_CACHE_HOME/finmodel/kernels,
+ *        ~/.cache/finmodel/kernels, else <temp>/finmodel_kernels_<uid>
+ */
+fs::path default_cache_dir() {
+    for (auto [variable, below] : {std::pair{"XDG_CACHE_HOME", "finmodel/kernels"},
+                                   std::pair{"HOME", ".cache/finmodel/kernels"}}) {
+        const char* base = std::getenv(variable);
+        if (base && base[0] == '/') {
+            const fs::path dir = fs::path(base) / below;
+            try {
+                make_private_dir(dir);
+                return dir;
+            } catch (const std::runtime_error&) {
+                // Not writable (or not ours): the per-user temporary directory
+            }
+        }
+    }
+    const fs::path dir = fs::temp_directory_path() / ("finmodel_kernels_" + std::to_string(::geteuid()));
+    make_private_dir(dir);
+    return dir;
+}
+
+/**
+ * @brief Run compiler + flags (split at whitespace, no shell) on source, output and log in files
+ * @return Whether the compiler ran and exited with 0
+ */
+bool run_compiler(const std::string& compiler, const std::string& flags,
+                  const fs::path& output, const fs::path& source, const fs::path& log) {
+    std::vector<std::string> args;
+    std::istringstream words(compiler + " " + flags);
+    for (std::string word; words >> word;) {
+        args.push_back(word);
+    }
+    if (args.empty()) {
+        return false;
+    }
+    args.insert(args.end(), {"-o", output.string(), source.string()});
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t pid = 0;
+    const int spawned = ::posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (spawned != 0) {
+        std::ofstream(log) << "cannot run " << args[0] << ": " << std::strerror(spawned) << "\n";
+        return false;
+    }
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Compile source into the cache (unless already there) and load it
+ */
+std::shared_ptr<void> compile_and_load(
+    const std::string& source,
+    const std::string& compiler,
+    const std::string& flags,
+    const std::string& extension,
+    const std::string& cache_dir,
+    std::string& library_path
+) {
+    // The cache key covers the flags too: different flags, different binary
+    char key[32];
+    std::snprintf(key, sizeof(key), "%016llx",
+                  static_cast<unsigned long long>(stable_hash(compiler + " " + flags + "\n" + source)));
+
+    fs::path dir;
+    if (cache_dir.empty()) {
+        dir = default_cache_dir();
+    } else {
+        dir = cache_dir;
+        make_private_dir(dir);
+    }
+
+    const fs::path library = dir / ("finmodel_kernel_" + std::string(key) + ".so");
+    if (!fs::exists(fs::symlink_status(library))) {
+        const fs::path source_path = dir / ("finmodel_kernel_" + std::string(key) + extension);
+        {
+            std::ofstream file(source_path);
+            file << source;
+            if (!file) {
+                throw std::runtime_error("Native kernel: cannot write " + source_path.string());
+            }
+        }
+
+        // Build under a private name, then rename, so concurrent runs never
+        // load a half-written library
+        const fs::path partial = library.string() + ".tmp" + std::to_string(::getpid());
+        const fs::path log = dir / ("finmodel_kernel_" + std::string(key) + ".log");
+        if (!run_compiler(compiler, flags, partial, source_path, log)) {
+            std::error_code ignored;
+            fs::remove(partial, ignored);
+            throw std::runtime_error("Native kernel compilation failed (see " + log.string() + ")");
+        }
+        fs::permissions(partial, fs::perms::owner_all, fs::perm_options::replace);
+        fs::rename(partial, library);
+    }
+
+    check_private(library);
+    void* handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        throw std::runtime_error("Native kernel: cannot load " + library.string() + ": " + ::dlerror());
+    }
+    library_path = library.string();
+    return std::shared_ptr<void>(handle, [](void* h) { ::dlclose(h); });
+}
+
+} // namespace
+#endif
+
+std::shared_ptr<const NativeKernel> NativeKernel::build(
+    const std::vector<Formula>& formulas,
+    size_t shared_count,
+    const NativeKernelOptions& options
+) {
+#if defined(_WIN32)
+    (void)formulas;
+    (void)shared_count;
+    (void)options;
+    throw std::runtime_error("Native kernels are not supported on this platform");
+#else
+    std::shared_ptr<NativeKernel> kernel(new NativeKernel());
+    const std::string source = generate_source(formulas, shared_count, kernel->builtins_);
+    kernel->library_ = compile_and_load(source, options.compiler, options.flags, ".cpp",
+                                        options.cache_dir, kernel->library_path_);
+
+    kernel->entry_ = reinterpret_cast<EntryPoint>(::dlsym(kernel->library_.get(), "finmodel_kernel"));
+    if (!kernel->entry_) {
+        throw std::runtime_error("Native kernel: entry point missing in " + kernel->library_path_);
+    }
+    return kernel;
+#endif
+}
+
+std::shared_ptr<const NativeKernel> NativeKernel::build_lanes(
+    const std::vector<Formula>& formulas,
+    size_t shared_count,
+    const LaneKernelOptions& options
+) {
+#if defined(_WIN32)
+    (void)formulas;
+    (void)shared_count;
+    (void)options;
+    throw std::runtime_error("Native kernels are not supported on this platform");
+#else
+    std::shared_ptr<NativeKernel> kernel(new NativeKernel());
+    const std::string source = generate_lane_source(formulas, shared_count, options.device, kernel->builtins_);
+    const bool cuda = options.device == LaneDevice::CUDA;
+    kernel->library_ = compile_and_load(source,
+                                        cuda ? options.device_compiler : options.compiler,
+                                        cuda ? options.device_flags : options.flags,
+                                        cuda ? ".cu" : ".cpp",
+                                        options.cache_dir, kernel->library_path_);
+
+    void* handle = kernel->library_.get();
+    kernel->lane_entry_ = reinterpret_cast<LaneEntryPoint>(::dlsym(handle, "finmodel_lane_kernel"));
+    auto available = reinterpret_cast<int (*)()>(::dlsym(handle, "finmodel_lane_device_available"));
+    if (!kernel->lane_entry_ || !available) {
+        throw std::runtime_error("Native kernel: entry point missing in " + kernel->library_path_);
+    }
+    if (!available()) {
+        throw std::runtime_error("Native kernel: no CUDA device for " + kernel->library_path_);
+    }
+    return kernel;
+#endif
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,154 @@
+/**
+ * @file numa_topology.cpp
+ * @brief NUMA topology from sysfs and thread pinning
+ */
+
+#include "core/numa_topology.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+/**
+ * @brief Every CPU of the machine as one node
+ */
+std::vector<NumaNode> single_node() {
+    NumaNode node;
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+        node.cpus.push_back(static_cast<int>(cpu));
+    }
+    return {node};
+}
+
+} // namespace
+
+const NumaTopology& NumaTopology::system() {
+    static const NumaTopology topology = read("/sys/devices/system/node");
+    return topology;
+}
+
+NumaTopology NumaTopology::read(const std::string& node_root) {
+    namespace fs = std::filesystem;
+    std::vector<NumaNode> nodes;
+    std::error_code error;
+    for (fs::directory_iterator it(node_root, error), end; !error && it != end; it.increment(error)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        std::ifstream file(it->path() / "cpulist");
+        std::string list;
+        if (!std::getline(file, list)) {
+            continue;
+        }
+        try {
+            nodes.push_back({std::stoi(name.substr(4)), parse_cpu_list(list)});
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+    return NumaTopology(std::move(nodes));
+}
+
+NumaTopology::NumaTopology(std::vector<NumaNode> nodes) {
+    for (auto& node : nodes) {
+        if (!node.cpus.empty()) {
+            std::sort(node.cpus.begin(), node.cpus.end());
+            nodes_.push_back(std::move(node));
+        }
+    }
+    if (nodes_.empty()) {
+        nodes_ = single_node();
+    }
+}
+
+std::vector<int> NumaTopology::parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    auto number = [&]() {
+        size_t digits = 0;
+        int value = 0;
+        while (pos < list.size() && list[pos] >= '0' && list[pos] <= '9') {
+            value = value * 10 + (list[pos++] - '0');
+            ++digits;
+        }
+        if (digits == 0) {
+            throw std::invalid_argument("NumaTopology: malformed CPU list '" + list + "'");
+        }
+        return value;
+    };
+
+    while (pos < list.size() && list[pos] != '\n') {
+        const int first = number();
+        int last = first;
+        if (pos < list.size() && list[pos] == '-') {
+            ++pos;
+            last = number();
+        }
+        if (last < first) {
+            throw std::invalid_argument("NumaTopology: malformed CPU list '" + list + "'");
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (pos < list.size() && list[pos] == ',') {
+            ++pos;
+        }
+    }
+    return cpus;
+}
+
+std::vector<size_t> NumaTopology::place(size_t workers) const {
+    size_t total_cpus = 0;
+    for (const auto& node : nodes_) {
+        total_cpus += node.cpus.size();
+    }
+
+    // Worker w goes to the node covering position w / workers of the CPUs
+    std::vector<size_t> placement(workers, 0);
+    for (size_t w = 0; w < workers; ++w) {
+        const size_t cpu = w * total_cpus / workers;
+        size_t seen = 0;
+        for (size_t n = 0; n < nodes_.size(); ++n) {
+            seen += nodes_[n].cpus.size();
+            if (cpu < seen) {
+                placement[w] = n;
+                break;
+            }
+        }
+    }
+    return placement;
+}
+
+bool NumaTopology::pin_current_thread(size_t node, size_t slot) const {
+#if defined(__linux__)
+    if (node >= nodes_.size()) {
+        return false;
+    }
+    const auto& cpus = nodes_[node].cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[slot % cpus.size()], &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)node;
+    (void)slot;
+    return false;
+#endif
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,95 @@
+#include "core/philox_stream.h"
+#include <algorithm>
+#include <cmath>
+
+namespace finmodel {
+namespace core {
+
+namespace {
+
+constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+
+// Poisson draws by inversion stay accurate for means up to this; larger
+// means are split into pieces (sums of Poisson counts are Poisson)
+constexpr double POISSON_PIECE = 32.0;
+
+constexpr double TWO_PI = 6.283185307179586476925;
+
+} // namespace
+
+PhiloxStream::PhiloxStream(uint64_t seed, uint64_t stream)
+    : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}, stream_(stream) {
+}
+
+std::array<uint32_t, 4> PhiloxStream::block(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+    for (int round = 0; round < 10; ++round) {
+        const uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * counter[0];
+        const uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * counter[2];
+        counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+                   static_cast<uint32_t>(p1),
+                   static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+                   static_cast<uint32_t>(p0)};
+        key[0] += PHILOX_W0;
+        key[1] += PHILOX_W1;
+    }
+    return counter;
+}
+
+uint32_t PhiloxStream::next() {
+    if (used_ == buffer_.size()) {
+        buffer_ = block({static_cast<uint32_t>(position_), static_cast<uint32_t>(position_ >> 32),
+                         static_cast<uint32_t>(stream_), static_cast<uint32_t>(stream_ >> 32)},
+                        key_);
+        ++position_;
+        used_ = 0;
+    }
+    return buffer_[used_++];
+}
+
+double PhiloxStream::uniform() {
+    // 53 random bits, shifted by half a step off 0
+    const uint64_t bits = (static_cast<uint64_t>(next()) << 21) ^ (next() >> 11);
+    return (static_cast<double>(bits & ((1ULL << 53) - 1)) + 0.5) * 0x1.0p-53;
+}
+
+double PhiloxStream::normal() {
+    if (has_spare_normal_) {
+        has_spare_normal_ = false;
+        return spare_normal_;
+    }
+    const double radius = std::sqrt(-2.0 * std::log(uniform()));
+    const double angle = TWO_PI * uniform();
+    spare_normal_ = radius * std::sin(angle);
+    has_spare_normal_ = true;
+    return radius * std::cos(angle);
+}
+
+uint64_t PhiloxStream::poisson(double mean) {
+    if (!(mean > 0.0)) {
+        return 0;
+    }
+    uint64_t count = 0;
+    while (mean > 0.0) {
+        const double piece = std::min(mean, POISSON_PIECE);
+        mean -= piece;
+
+        // Inversion: smallest k with P(X <= k) >= u
+        const double u = uniform();
+        double p = std::exp(-piece);
+        double cumulative = p;
+        uint64_t k = 0;
+        while (cumulative < u && p > 0.0) {
+            ++k;
+            p *= piece / static_cast<double>(k);
+            cumulative += p;
+        }
+        count += k;
+    }
+    return count;
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,236 @@
+#include "core/profiler.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace finmodel {
+namespace core {
+
+Profiler::Profiler(size_t max_trace_events)
+    : start_ticks_(ticks()), start_time_(std::chrono::steady_clock::now()), max_trace_events_(max_trace_events) {}
+
+Profiler::~Profiler() {
+    track_allocations(false);
+    track_hardware_counters(false);
+}
+
+void Profiler::track_allocations(bool on) {
+    if (on == tracking_allocations_) {
+        return;
+    }
+    tracking_allocations_ = on;
+    if (on) {
+        AllocationTracker::retain();
+    } else {
+        AllocationTracker::release();
+    }
+}
+
+void Profiler::track_hardware_counters(bool on) {
+    if (on == tracking_counters_) {
+        return;
+    }
+    tracking_counters_ = on;
+    if (on) {
+        HardwareCounters::retain();
+    } else {
+        HardwareCounters::release();
+    }
+}
+
+const char* Profiler::stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::TEMPLATE_LOAD: return "template_load";
+        case Stage::DRIVER_LOAD: return "driver_load";
+        case Stage::CALCULATE: return "calculate";
+        case Stage::VALIDATE: return "validate";
+        case Stage::ROLL_FORWARD: return "roll_forward";
+        case Stage::WRITE: return "write";
+    }
+    return "unknown";
+}
+
+const char* Profiler::lookup_name(Lookup source) {
+    switch (source) {
+        case Lookup::DRIVER: return "driver";
+        case Lookup::STATEMENT: return "statement";
+        case Lookup::OTHER: return "other";
+        case Lookup::NOT_FOUND: return "not_found";
+        case Lookup::DATABASE: return "database";
+    }
+    return "unknown";
+}
+
+void Profiler::record_stage(Stage stage, const Mark& begin, const Mark& end) {
+    auto& totals = stages_[static_cast<size_t>(stage)];
+    ++totals.count;
+    totals.ticks += end.ticks - begin.ticks;
+    totals.allocated += end.allocated - begin.allocated;
+    totals.counters += end.counters - begin.counters;
+    if (trace_.size() < max_trace_events_) {
+        trace_.push_back({stage, begin.ticks, end.ticks, end.allocated - begin.allocated, end.counters - begin.counters});
+    }
+}
+
+uint32_t Profiler::line_item_id(const std::string& code) {
+    auto [it, added] = line_item_ids_.emplace(code, static_cast<uint32_t>(line_item_codes_.size()));
+    if (added) {
+        line_item_codes_.push_back(code);
+        line_items_.emplace_back();
+    }
+    return it->second;
+}
+
+double Profiler::seconds_per_tick() const {
+    const uint64_t elapsed_ticks = ticks() - start_ticks_;
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+    if (elapsed_ticks == 0 || elapsed <= 0.0) {
+        return 1e-9;
+    }
+    return elapsed / static_cast<double>(elapsed_ticks);
+}
+
+std::vector<Profiler::StageProfile> Profiler::stages() const {
+    const double scale = seconds_per_tick();
+    std::vector<StageProfile> out;
+    out.reserve(STAGE_COUNT);
+    for (size_t s = 0; s < STAGE_COUNT; ++s) {
+        out.push_back({static_cast<Stage>(s), stages_[s].count, static_cast<double>(stages_[s].ticks) * scale,
+                       stages_[s].allocated, stages_[s].counters});
+    }
+    return out;
+}
+
+std::vector<Profiler::LineItemProfile> Profiler::line_items() const {
+    const double scale = seconds_per_tick();
+    std::vector<LineItemProfile> out;
+    out.reserve(line_items_.size());
+    for (size_t i = 0; i < line_items_.size(); ++i) {
+        if (line_items_[i].evaluations > 0) {
+            out.push_back({line_item_codes_[i], line_items_[i].evaluations,
+                           static_cast<double>(line_items_[i].ticks) * scale, line_items_[i].allocated});
+        }
+    }
+    std::stable_sort(out.begin(), out.end(), [](const LineItemProfile& a, const LineItemProfile& b) {
+        return a.seconds > b.seconds;
+    });
+    return out;
+}
+
+uint64_t Profiler::line_item_evaluations() const {
+    uint64_t evaluations = 0;
+    for (const auto& item : line_items_) {
+        evaluations += item.evaluations;
+    }
+    return evaluations;
+}
+
+std::vector<Profiler::LookupProfile> Profiler::lookups() const {
+    std::vector<LookupProfile> out;
+    out.reserve(LOOKUP_COUNT);
+    for (size_t s = 0; s < LOOKUP_COUNT; ++s) {
+        out.push_back({static_cast<Lookup>(s), lookups_[s].hits.load(std::memory_order_relaxed),
+                       lookups_[s].misses.load(std::memory_order_relaxed)});
+    }
+    return out;
+}
+
+std::string Profiler::report(size_t top_line_items) const {
+    std::ostringstream out;
+    char line[160];
+
+    out << "Stages\n";
+    const auto evaluations = static_cast<double>(std::max<uint64_t>(line_item_evaluations(), 1));
+    for (const auto& stage : stages()) {
+        if (stage.count == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "  %-16s %10llu calls %12.3f ms", stage_name(stage.stage),
+                      static_cast<unsigned long long>(stage.count), stage.seconds * 1e3);
+        out << line;
+        if (tracking_allocations_) {
+            std::snprintf(line, sizeof(line), " %10llu allocs %12llu bytes",
+                          static_cast<unsigned long long>(stage.allocated.allocations),
+                          static_cast<unsigned long long>(stage.allocated.bytes));
+            out << line;
+        }
+        if (tracking_counters_ && stage.counters.cycles() > 0) {
+            // Misses per evaluated line item: comparable across template sizes
+            std::snprintf(line, sizeof(line), " ipc %5.2f  per item: %8.3f L1D %8.3f LLC %8.3f branch misses",
+                          stage.counters.ipc(), static_cast<double>(stage.counters.l1d_misses()) / evaluations,
+                          static_cast<double>(stage.counters.llc_misses()) / evaluations,
+                          static_cast<double>(stage.counters.branch_misses()) / evaluations);
+            out << line;
+        }
+        out << '\n';
+    }
+    if (tracking_counters_ && !HardwareCounters::available()) {
+        out << "  (no hardware counters: " << HardwareCounters::unavailable_reason() << ")\n";
+    }
+
+    const auto items = line_items();
+    const size_t shown = top_line_items == 0 ? items.size() : std::min(top_line_items, items.size());
+    out << "Line items (" << shown << " of " << items.size() << ", by time)\n";
+    for (size_t i = 0; i < shown; ++i) {
+        const auto& item = items[i];
+        std::snprintf(line, sizeof(line), "  %-32s %10llu evals %12.3f ms %10.1f ns/eval", item.code.c_str(),
+                      static_cast<unsigned long long>(item.evaluations), item.seconds * 1e3,
+                      item.seconds * 1e9 / static_cast<double>(item.evaluations));
+        out << line;
+        if (tracking_allocations_) {
+            std::snprintf(line, sizeof(line), " %8.2f allocs/eval",
+                          static_cast<double>(item.allocated.allocations) / static_cast<double>(item.evaluations));
+            out << line;
+        }
+        out << '\n';
+    }
+
+    out << "Lookups\n";
+    for (const auto& lookup : lookups()) {
+        if (lookup.hits == 0 && lookup.misses == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "  %-16s %10llu hits %10llu misses\n", lookup_name(lookup.source),
+                      static_cast<unsigned long long>(lookup.hits), static_cast<unsigned long long>(lookup.misses));
+        out << line;
+    }
+    return out.str();
+}
+
+std::string Profiler::trace_json() const {
+    const double us_per_tick = seconds_per_tick() * 1e6;
+    nlohmann::json events = nlohmann::json::array();
+    for (const auto& event : trace_) {
+        nlohmann::json args = {{"allocations", event.allocated.allocations}, {"bytes", event.allocated.bytes}};
+        if (tracking_counters_) {
+            for (size_t e = 0; e < HardwareCounters::EVENT_COUNT; ++e) {
+                args[HardwareCounters::event_name(static_cast<HardwareCounters::Event>(e))] = event.counters.values[e];
+            }
+        }
+        events.push_back({
+            {"name", stage_name(event.stage)},
+            {"cat", "finmodel"},
+            {"ph", "X"},
+            {"ts", static_cast<double>(event.begin - start_ticks_) * us_per_tick},
+            {"dur", static_cast<double>(event.end - event.begin) * us_per_tick},
+            {"pid", 1},
+            {"tid", 1},
+            {"args", std::move(args)}
+        });
+    }
+    return nlohmann::json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}}.dump();
+}
+
+void Profiler::clear() {
+    stages_ = {};
+    trace_.clear();
+    std::fill(line_items_.begin(), line_items_.end(), LineItemTotals{});
+    for (auto& counter : lookups_) {
+        counter.hits.store(0, std::memory_order_relaxed);
+        counter.misses.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace core
+} // namespace finmodel
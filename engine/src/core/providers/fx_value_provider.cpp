@@ -48,11 +48,22 @@ double FXValueProvider::get_value(const std::string& key, const Context& /* ctx
         throw std::runtime_error("FXValueProvider: context not set. Call set_context() first.");
     }
 
+    // Check cache first (keys are interned once their rate is loaded)
+    const Symbol symbol = SymbolTable::global().find(key);
+    if (symbol != NO_SYMBOL) {
+        auto it = rate_cache_.find(symbol);
+        if (it != rate_cache_.end()) {
+            return it->second;
+        }
+    }
+
     // Parse FX key
     FXReference fx_ref = parse_fx_key(key);
 
-    // Load rate (from cache or database)
-    return load_rate(fx_ref.from_currency, fx_ref.to_currency, fx_ref.rate_type);
+    // Load rate from database and cache it for this context
+    const double rate = load_rate(fx_ref.from_currency, fx_ref.to_currency, fx_ref.rate_type);
+    rate_cache_[SymbolTable::global().intern(key)] = rate;
+    return rate;
 }
 
 FXValueProvider::FXReference FXValueProvider::parse_fx_key(const std::string& key) const {
@@ -126,14 +137,6 @@ double FXValueProvider::load_rate(
     const std::string& to_currency,
     const std::string& rate_type
 ) const {
-    // Check cache first
-    std::string cache_key = make_cache_key(from_currency, to_currency, rate_type);
-
-    auto it = rate_cache_.find(cache_key);
-    if (it != rate_cache_.end()) {
-        return it->second;
-    }
-
     // Query database (use view which includes inverse rates automatically)
     std::ostringstream query;
     query << "SELECT rate FROM v_fx_rates "
@@ -154,9 +157,7 @@ double FXValueProvider::load_rate(
     auto result = db_->execute_query(query.str(), params);
 
     if (result && result->next()) {
-        double rate = result->get_double(0);
-        rate_cache_[cache_key] = rate;  // Cache for future use
-        return rate;
+        return result->get_double(0);
     }
 
     // Rate not found - error
@@ -167,15 +168,5 @@ double FXValueProvider::load_rate(
     throw std::runtime_error(error.str());
 }
 
-std::string FXValueProvider::make_cache_key(
-    const std::string& from_currency,
-    const std::string& to_currency,
-    const std::string& rate_type
-) const {
-    std::ostringstream oss;
-    oss << "FX_" << from_currency << "_" << to_currency << "_" << rate_type;
-    return oss.str();
-}
-
 } // namespace core
 } // namespace finmodel
@@ -0,0 +1,131 @@
+#include "core/quantile_sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+// Store implementation
+
+void QuantileSketch::Store::add(int index, uint64_t count) {
+    if (counts.empty()) {
+        offset = index;
+        counts.assign(1, 0);
+    } else if (index < offset) {
+        counts.insert(counts.begin(), static_cast<size_t>(offset - index), 0);
+        offset = index;
+    } else if (index >= offset + static_cast<int>(counts.size())) {
+        counts.resize(static_cast<size_t>(index - offset) + 1, 0);
+    }
+    counts[static_cast<size_t>(index - offset)] += count;
+    total += count;
+}
+
+void QuantileSketch::Store::merge(const Store& other) {
+    if (other.counts.empty()) {
+        return;
+    }
+    // Extend to both ends first, then add counts in place
+    add(other.offset, 0);
+    add(other.offset + static_cast<int>(other.counts.size()) - 1, 0);
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+        counts[static_cast<size_t>(other.offset - offset) + i] += other.counts[i];
+    }
+    total += other.total;
+}
+
+// QuantileSketch implementation
+
+QuantileSketch::QuantileSketch(double relative_accuracy) {
+    if (!(relative_accuracy > 0.0 && relative_accuracy < 1.0)) {
+        throw std::invalid_argument("QuantileSketch: relative accuracy must be in (0, 1)");
+    }
+    gamma_ = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+    log_gamma_ = std::log(gamma_);
+}
+
+void QuantileSketch::add(double value, uint64_t count) {
+    if (std::isnan(value) || count == 0) {
+        return;
+    }
+    const double magnitude = std::abs(value);
+    if (magnitude < MIN_MAGNITUDE) {
+        zeros_ += count;
+        return;
+    }
+    const int index = static_cast<int>(std::ceil(std::log(magnitude) / log_gamma_));
+    (value > 0.0 ? positive_ : negative_).add(index, count);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.gamma_ != gamma_) {
+        throw std::invalid_argument("QuantileSketch: merging sketches of different accuracy");
+    }
+    negative_.merge(other.negative_);
+    positive_.merge(other.positive_);
+    zeros_ += other.zeros_;
+}
+
+double QuantileSketch::bucket_value(int index) const {
+    // Within α of every magnitude in (γ^(k-1), γ^k]
+    return 2.0 * std::exp(index * log_gamma_) / (gamma_ + 1.0);
+}
+
+template <typename Fn>
+void QuantileSketch::descending(Fn&& fn) const {
+    for (size_t i = positive_.counts.size(); i-- > 0;) {
+        if (positive_.counts[i] > 0 && !fn(bucket_value(positive_.offset + static_cast<int>(i)), positive_.counts[i])) {
+            return;
+        }
+    }
+    if (zeros_ > 0 && !fn(0.0, zeros_)) {
+        return;
+    }
+    for (size_t i = 0; i < negative_.counts.size(); ++i) {
+        if (negative_.counts[i] > 0 && !fn(-bucket_value(negative_.offset + static_cast<int>(i)), negative_.counts[i])) {
+            return;
+        }
+    }
+}
+
+double QuantileSketch::quantile(double q) const {
+    if (count() == 0) {
+        return 0.0;
+    }
+    const auto rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(count() - 1));
+    return top_value(count() - rank);
+}
+
+double QuantileSketch::top_value(uint64_t k) const {
+    if (k == 0 || k > count()) {
+        return 0.0;
+    }
+    double result = 0.0;
+    uint64_t seen = 0;
+    descending([&](double value, uint64_t n) {
+        seen += n;
+        result = value;
+        return seen < k;
+    });
+    return result;
+}
+
+double QuantileSketch::top_mean(uint64_t k) const {
+    k = std::min(k, count());
+    if (k == 0) {
+        return 0.0;
+    }
+    uint64_t left = k;
+    double sum = 0.0;
+    descending([&](double value, uint64_t n) {
+        const uint64_t take = std::min(left, n);
+        sum += static_cast<double>(take) * value;
+        left -= take;
+        return left > 0;
+    });
+    return sum / static_cast<double>(k);
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,37 @@
+/**
+ * @file reference_data.cpp
+ * @brief Implementation of shared reference data snapshots
+ */
+
+#include "core/reference_data.h"
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+ReferenceDataStore::ReferenceDataStore(std::shared_ptr<database::IDatabase> db, std::string rate_type)
+    : db_(std::move(db))
+    , rate_type_(std::move(rate_type)) {
+    if (!db_) {
+        throw std::invalid_argument("ReferenceDataStore: null database pointer");
+    }
+    current_.store(load(1), std::memory_order_release);
+}
+
+std::shared_ptr<const ReferenceData> ReferenceDataStore::reload() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    auto next = load(current()->version + 1);
+    current_.store(next, std::memory_order_release);
+    return next;
+}
+
+std::shared_ptr<const ReferenceData> ReferenceDataStore::load(uint64_t version) const {
+    auto data = std::make_shared<ReferenceData>();
+    data->version = version;
+    data->fx = std::make_shared<const fx::FXProvider>(db_, rate_type_);
+    data->units = std::make_shared<const UnitConverter>(db_, data->fx);
+    return data;
+}
+
+} // namespace core
+} // namespace finmodel
@@ -1,22 +1,206 @@
 /**
  * @file statement_template.cpp
  * @brief Statement template implementation
+ *
+ * Layout of a compiled template (statement_template.compiled_structure):
+ *   "FMTB" u32 version, u64 FNV-1a hash of the JSON it was compiled from
+ *   Code dictionary (line item and dependency codes once each)
+ *   Metadata, line items, circular and time scaling policies, validation
+ *   rules, denormalized columns
+ *   Calculation order: computed flag, order, formula dependencies per line
+ *   item, circular blocks
+ *   u64 FNV-1a hash of everything before it
+ *
+ * Integers are varints, strings a varint length and bytes, codes a varint
+ * index into the dictionary.
  */
 
 #include "core/statement_template.h"
 #include "core/dependency_graph.h"
+#include "core/engine_metrics.h"
 #include "core/formula_evaluator.h"
 #include "database/idatabase.h"
 #include "database/result_set.h"
 #include <nlohmann/json.hpp>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 using json = nlohmann::json;
 
 namespace finmodel {
 namespace core {
 
+namespace {
+
+/**
+ * @brief Calculation order shared by templates with identical formulas
+ */
+struct CachedOrder {
+    std::vector<std::vector<std::string>> dependencies;  ///< Per line item
+    std::vector<std::string> order;
+    std::vector<CircularBlock> circular_blocks;
+};
+
+// Keyed by "<template code>#<content hash>". Action templates add variants over
+// a run, so the cache is bounded (dropped wholesale when full).
+constexpr size_t kMaxCachedOrders = 256;
+std::mutex order_cache_mutex;
+std::unordered_map<std::string, std::shared_ptr<const CachedOrder>> order_cache;
+
+std::string order_cache_key(const std::string& template_code, size_t content_hash) {
+    return template_code + "#" + std::to_string(content_hash);
+}
+
+/**
+ * @brief Loaded template shared through StatementTemplate::load_cached()
+ */
+struct CachedTemplate {
+    std::weak_ptr<database::IDatabase> db;   ///< Owner (weak: a new connection may reuse the address)
+    std::shared_ptr<const StatementTemplate> tmpl;
+};
+
+// Keyed by template code; one entry per database the code was loaded from
+std::mutex template_cache_mutex;
+std::unordered_map<std::string, std::vector<CachedTemplate>> template_cache;
+
+// ----------------------------------------------------------------------------
+// Compiled templates
+// ----------------------------------------------------------------------------
+
+constexpr char MAGIC[4] = {'F', 'M', 'T', 'B'};
+
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t fnv1a(const std::string& text) {
+    return fnv1a(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+class Encoder {
+public:
+    std::vector<uint8_t> out;
+
+    template <typename T>
+    void put(T value) {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    void strings(const std::vector<std::string>& values) {
+        varint(values.size());
+        for (const auto& value : values) {
+            string(value);
+        }
+    }
+
+    void optional(const std::optional<std::string>& value) {
+        put<uint8_t>(value ? 1 : 0);
+        if (value) {
+            string(*value);
+        }
+    }
+};
+
+/// Thrown on a damaged blob: load_from_binary() returns null
+struct DamagedBlob {};
+
+class Decoder {
+public:
+    Decoder(std::span<const uint8_t> data, size_t begin, size_t end) : data_(data), pos_(begin), end_(end) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            const uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw DamagedBlob{};
+    }
+
+    std::string string() {
+        const uint64_t size = varint();
+        need(size);
+        std::string value(reinterpret_cast<const char*>(data_.data() + pos_), size);
+        pos_ += size;
+        return value;
+    }
+
+    std::vector<std::string> strings() {
+        std::vector<std::string> values(count());
+        for (auto& value : values) {
+            value = string();
+        }
+        return values;
+    }
+
+    std::optional<std::string> optional() {
+        if (get<uint8_t>() == 0) {
+            return std::nullopt;
+        }
+        return string();
+    }
+
+    /// A count whose elements take at least one byte each
+    size_t count() {
+        const uint64_t n = varint();
+        if (n > end_ - pos_) {
+            throw DamagedBlob{};
+        }
+        return static_cast<size_t>(n);
+    }
+
+    bool at_end() const { return pos_ == end_; }
+
+private:
+    std::span<const uint8_t> data_;
+    size_t pos_;
+    size_t end_;
+
+    void need(uint64_t bytes) const {
+        if (bytes > end_ - pos_) {
+            throw DamagedBlob{};
+        }
+    }
+};
+
+} // namespace
+
 // Helper function for sign convention to string conversion
 static std::string sign_convention_to_string(SignConvention conv) {
     switch (conv) {
@@ -39,17 +223,36 @@ std::unique_ptr<StatementTemplate> StatementTemplate::load_from_database(
     ParamMap params;
     params["code"] = template_code;
 
-    auto result = db->execute_query(
-        "SELECT template_id, code, statement_type, industry, version, json_structure "
-        "FROM statement_template WHERE code = :code AND is_active = 1",
-        params
-    );
+    // Schemas before migration 015 have no compiled_structure column
+    std::unique_ptr<ResultSet> result;
+    bool has_compiled = true;
+    try {
+        result = db->execute_query(
+            "SELECT json_structure, compiled_structure "
+            "FROM statement_template WHERE code = :code AND is_active = 1",
+            params
+        );
+    } catch (const database::DatabaseException&) {
+        has_compiled = false;
+        result = db->execute_query(
+            "SELECT json_structure FROM statement_template WHERE code = :code AND is_active = 1",
+            params
+        );
+    }
 
     if (!result->next()) {
         return nullptr;  // Template not found
     }
 
-    std::string json_structure = result->get_string("json_structure");
+    std::string json_structure = result->get_string(0);
+
+    // The compiled form, unless the JSON was edited since it was saved
+    if (has_compiled && !result->is_null(1)) {
+        auto compiled = load_from_binary(result->get_blob(1), json_structure);
+        if (compiled) {
+            return compiled;
+        }
+    }
 
     // Create and parse template
     std::unique_ptr<StatementTemplate> tmpl(new StatementTemplate());
@@ -66,8 +269,278 @@ std::unique_ptr<StatementTemplate> StatementTemplate::load_from_json(
     return tmpl;
 }
 
+std::vector<uint8_t> StatementTemplate::to_binary(const std::string& json_content) {
+    // Compiled from a fresh parse, so loading the blob gives exactly what
+    // parsing the JSON would
+    std::unique_ptr<StatementTemplate> parsed = load_from_json(json_content);
+    try {
+        parsed->compute_calculation_order();
+    } catch (const std::exception&) {
+        // Stored without an order: compute_calculation_order() reports it after loading
+    }
+    const StatementTemplate& t = *parsed;
+
+    std::unordered_map<std::string, uint64_t> index;
+    std::vector<const std::string*> codes;
+    Encoder body;
+    auto code = [&](const std::string& value) {
+        auto [it, added] = index.emplace(value, codes.size());
+        if (added) {
+            codes.push_back(&it->first);
+        }
+        body.varint(it->second);
+    };
+    auto code_list = [&](const std::vector<std::string>& values) {
+        body.varint(values.size());
+        for (const auto& value : values) {
+            code(value);
+        }
+    };
+
+    for (const std::string* field : {&t.template_code_, &t.template_name_, &t.statement_type_, &t.industry_,
+                                     &t.version_, &t.description_}) {
+        body.string(*field);
+    }
+    body.varint(t.line_items_.size());
+    for (const auto& item : t.line_items_) {
+        code(item.code);
+        body.string(item.display_name);
+        body.put<int32_t>(item.level);
+        body.optional(item.formula);
+        body.optional(item.base_value_source);
+        body.optional(item.driver_code);
+        body.string(item.category);
+        body.put<uint8_t>((item.driver_applicable ? 1 : 0) | (item.is_computed ? 2 : 0));
+        body.put<uint8_t>(static_cast<uint8_t>(item.sign_convention));
+        code_list(item.dependencies);
+    }
+
+    body.put<uint8_t>(t.circular_.enabled ? 1 : 0);
+    body.put<uint8_t>(static_cast<uint8_t>(t.circular_.method));
+    body.varint(t.circular_.max_iterations);
+    body.put(t.circular_.tolerance);
+    body.varint(t.circular_.depth);
+
+    body.put<uint8_t>(t.time_scaling_.enabled ? 1 : 0);
+    body.put(t.time_scaling_.basis_days);
+    code_list(t.time_scaling_.flow_drivers);
+    code_list(t.time_scaling_.stocks);
+    code_list(t.time_scaling_.rates);
+
+    body.varint(t.validation_rules_.size());
+    for (const auto& rule : t.validation_rules_) {
+        body.string(rule.rule_id);
+        body.string(rule.rule);
+        body.string(rule.severity);
+        body.string(rule.message);
+    }
+    code_list(t.denormalized_columns_);
+    body.put<uint8_t>(t.supports_consolidation_ ? 1 : 0);
+    body.string(t.default_frequency_);
+
+    body.put<uint8_t>(t.order_valid_ ? 1 : 0);
+    code_list(t.calculation_order_);
+    if (t.order_valid_) {
+        for (const auto& dependencies : t.formula_deps_) {
+            code_list(dependencies);
+        }
+        body.varint(t.circular_blocks_.size());
+        for (const auto& block : t.circular_blocks_) {
+            body.varint(block.begin);
+            body.varint(block.end);
+        }
+    }
+
+    Encoder blob;
+    blob.out.insert(blob.out.end(), MAGIC, MAGIC + 4);
+    blob.put(BINARY_FORMAT_VERSION);
+    blob.put(fnv1a(json_content));
+    blob.varint(codes.size());
+    for (const std::string* value : codes) {
+        blob.string(*value);
+    }
+    blob.out.insert(blob.out.end(), body.out.begin(), body.out.end());
+    blob.put(fnv1a(blob.out.data(), blob.out.size()));
+    return std::move(blob.out);
+}
+
+std::unique_ptr<StatementTemplate> StatementTemplate::load_from_binary(
+    std::span<const uint8_t> data,
+    const std::string& json_content
+) {
+    const size_t header = sizeof(MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+    if (data.size() < header + sizeof(uint64_t) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        return nullptr;
+    }
+    const size_t end = data.size() - sizeof(uint64_t);
+    uint64_t hash;
+    std::memcpy(&hash, data.data() + end, sizeof(hash));
+    Decoder in(data, sizeof(MAGIC), end);
+    if (in.get<uint32_t>() != BINARY_FORMAT_VERSION || hash != fnv1a(data.data(), end) ||
+        in.get<uint64_t>() != fnv1a(json_content)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<StatementTemplate> tmpl(new StatementTemplate());
+    StatementTemplate& t = *tmpl;
+    try {
+        const std::vector<std::string> codes = in.strings();
+        auto code = [&]() -> const std::string& {
+            const uint64_t i = in.varint();
+            if (i >= codes.size()) {
+                throw DamagedBlob{};
+            }
+            return codes[i];
+        };
+        auto code_list = [&]() {
+            std::vector<std::string> values(in.count());
+            for (auto& value : values) {
+                value = code();
+            }
+            return values;
+        };
+
+        for (std::string* field : {&t.template_code_, &t.template_name_, &t.statement_type_, &t.industry_,
+                                   &t.version_, &t.description_}) {
+            *field = in.string();
+        }
+        t.line_items_.resize(in.count());
+        for (size_t i = 0; i < t.line_items_.size(); ++i) {
+            LineItem& item = t.line_items_[i];
+            item.code = code();
+            item.display_name = in.string();
+            item.level = in.get<int32_t>();
+            item.formula = in.optional();
+            item.base_value_source = in.optional();
+            item.driver_code = in.optional();
+            item.category = in.string();
+            const uint8_t flags = in.get<uint8_t>();
+            item.driver_applicable = (flags & 1) != 0;
+            item.is_computed = (flags & 2) != 0;
+            const uint8_t sign = in.get<uint8_t>();
+            if (sign > static_cast<uint8_t>(SignConvention::NEUTRAL)) {
+                throw DamagedBlob{};
+            }
+            item.sign_convention = static_cast<SignConvention>(sign);
+            item.dependencies = code_list();
+            item.symbol = SymbolTable::global().intern(item.code);
+            t.line_item_index_[item.symbol] = i;
+        }
+
+        t.circular_.enabled = in.get<uint8_t>() != 0;
+        t.circular_.method = in.get<uint8_t>() != 0 ? CircularPolicy::Method::NEWTON : CircularPolicy::Method::ANDERSON;
+        t.circular_.max_iterations = static_cast<size_t>(in.varint());
+        t.circular_.tolerance = in.get<double>();
+        t.circular_.depth = static_cast<size_t>(in.varint());
+
+        t.time_scaling_.enabled = in.get<uint8_t>() != 0;
+        t.time_scaling_.basis_days = in.get<double>();
+        t.time_scaling_.flow_drivers = code_list();
+        t.time_scaling_.stocks = code_list();
+        t.time_scaling_.rates = code_list();
+
+        t.validation_rules_.resize(in.count());
+        for (auto& rule : t.validation_rules_) {
+            rule.rule_id = in.string();
+            rule.rule = in.string();
+            rule.severity = in.string();
+            rule.message = in.string();
+        }
+        t.denormalized_columns_ = code_list();
+        t.supports_consolidation_ = in.get<uint8_t>() != 0;
+        t.default_frequency_ = in.string();
+        t.update_content_hash();
+
+        const bool ordered = in.get<uint8_t>() != 0;
+        t.calculation_order_ = code_list();
+        if (ordered) {
+            t.formula_deps_.resize(t.line_items_.size());
+            for (auto& dependencies : t.formula_deps_) {
+                dependencies = code_list();
+            }
+            t.formula_deps_valid_.assign(t.line_items_.size(), 1);
+            t.circular_blocks_.resize(in.count());
+            for (auto& block : t.circular_blocks_) {
+                block.begin = static_cast<size_t>(in.varint());
+                block.end = static_cast<size_t>(in.varint());
+                if (block.begin >= block.end || block.end > t.calculation_order_.size()) {
+                    throw DamagedBlob{};
+                }
+            }
+            t.order_valid_ = true;
+        }
+        if (!in.at_end()) {
+            throw DamagedBlob{};
+        }
+    } catch (const DamagedBlob&) {
+        return nullptr;
+    }
+    return tmpl;
+}
+
+std::shared_ptr<const StatementTemplate> StatementTemplate::load_cached(
+    const std::shared_ptr<finmodel::database::IDatabase>& db,
+    const std::string& template_code
+) {
+    if (!db) {
+        throw std::runtime_error("Database pointer is null");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(template_cache_mutex);
+        auto it = template_cache.find(template_code);
+        if (it != template_cache.end()) {
+            for (const auto& entry : it->second) {
+                if (entry.db.lock() == db) {
+                    EngineMetrics::add(EngineMetrics::Counter::TEMPLATE_CACHE_HITS);
+                    return entry.tmpl;
+                }
+            }
+        }
+    }
+
+    // Load outside the lock; if two threads race the first insert wins
+    EngineMetrics::add(EngineMetrics::Counter::TEMPLATE_CACHE_MISSES);
+    std::shared_ptr<StatementTemplate> loaded = load_from_database(db.get(), template_code);
+    if (!loaded) {
+        return nullptr;
+    }
+    try {
+        loaded->compute_calculation_order();
+    } catch (const std::exception&) {
+        return loaded;  // Not cached: the caller's compute_calculation_order() reports it
+    }
+
+    std::lock_guard<std::mutex> lock(template_cache_mutex);
+    auto& entries = template_cache[template_code];
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const CachedTemplate& entry) { return entry.db.expired(); }),
+                  entries.end());
+    for (const auto& entry : entries) {
+        if (entry.db.lock() == db) {
+            return entry.tmpl;
+        }
+    }
+    entries.push_back({db, loaded});
+    return loaded;
+}
+
+void StatementTemplate::invalidate_cache(const std::string& template_code) {
+    std::lock_guard<std::mutex> lock(template_cache_mutex);
+    template_cache.erase(template_code);
+}
+
+void StatementTemplate::clear_cache() {
+    std::lock_guard<std::mutex> lock(template_cache_mutex);
+    template_cache.clear();
+}
+
 const LineItem* StatementTemplate::get_line_item(const std::string& code) const {
-    auto it = line_item_index_.find(code);
+    return get_line_item(SymbolTable::global().find(code));
+}
+
+const LineItem* StatementTemplate::get_line_item(Symbol symbol) const {
+    auto it = line_item_index_.find(symbol);
     if (it == line_item_index_.end()) {
         return nullptr;
     }
@@ -75,13 +548,19 @@ const LineItem* StatementTemplate::get_line_item(const std::string& code) const
 }
 
 bool StatementTemplate::update_line_item_formula(const std::string& code, const std::string& new_formula) {
-    auto it = line_item_index_.find(code);
+    auto it = line_item_index_.find(SymbolTable::global().find(code));
     if (it == line_item_index_.end()) {
         return false;
     }
     line_items_[it->second].formula = new_formula;
     line_items_[it->second].is_computed = true;  // Mark as computed when formula is set
 
+    // Only this formula needs its dependencies re-extracted
+    formula_deps_valid_.resize(line_items_.size(), 0);
+    formula_deps_valid_[it->second] = 0;
+    order_valid_ = false;
+    update_content_hash();
+
     // Automatically recompute calculation order since dependencies may have changed
     try {
         compute_calculation_order();
@@ -89,6 +568,8 @@ bool StatementTemplate::update_line_item_formula(const std::string& code, const
         // If calculation order fails (e.g., circular dependency), rollback the formula change
         line_items_[it->second].formula = std::nullopt;
         line_items_[it->second].is_computed = false;
+        formula_deps_valid_[it->second] = 0;
+        update_content_hash();
         throw;  // Re-throw the exception
     }
 
@@ -96,7 +577,7 @@ bool StatementTemplate::update_line_item_formula(const std::string& code, const
 }
 
 bool StatementTemplate::clear_base_value_source(const std::string& code) {
-    auto it = line_item_index_.find(code);
+    auto it = line_item_index_.find(SymbolTable::global().find(code));
     if (it == line_item_index_.end()) {
         return false;
     }
@@ -104,50 +585,157 @@ bool StatementTemplate::clear_base_value_source(const std::string& code) {
     return true;
 }
 
-void StatementTemplate::compute_calculation_order() {
+void StatementTemplate::compute_calculation_order() const {
+    if (order_valid_) {
+        return;
+    }
+
+    const std::string cache_key = order_cache_key(template_code_, content_hash_);
+    {
+        std::lock_guard<std::mutex> lock(order_cache_mutex);
+        auto cached = order_cache.find(cache_key);
+        if (cached != order_cache.end()) {
+            formula_deps_ = cached->second->dependencies;
+            formula_deps_valid_.assign(line_items_.size(), 1);
+            calculation_order_ = cached->second->order;
+            circular_blocks_ = cached->second->circular_blocks;
+            order_valid_ = true;
+            return;
+        }
+    }
+
+    // Extract dependencies of formulas not seen yet
+    formula_deps_.resize(line_items_.size());
+    formula_deps_valid_.resize(line_items_.size(), 0);
+    FormulaEvaluator evaluator;
+    for (size_t i = 0; i < line_items_.size(); ++i) {
+        if (!formula_deps_valid_[i]) {
+            const auto& formula = line_items_[i].formula;
+            formula_deps_[i] = formula.has_value() ? evaluator.extract_dependencies(*formula)
+                                                   : std::vector<std::string>{};
+            formula_deps_valid_[i] = 1;
+        }
+    }
+
     // Create dependency graph
     DependencyGraph graph;
-    FormulaEvaluator evaluator;
 
     // Add all line items as nodes
+    std::vector<uint32_t> node_ids;
+    node_ids.reserve(line_items_.size());
     for (const auto& item : line_items_) {
-        graph.add_node(item.code);
+        node_ids.push_back(graph.add_node(item.symbol));
     }
 
-    // Extract dependencies from formulas and add edges
-    for (const auto& item : line_items_) {
-        if (item.formula.has_value()) {
-            // Extract dependencies from formula
-            std::vector<std::string> deps = evaluator.extract_dependencies(*item.formula);
-
-            // Add edge for each dependency: item depends on dep
-            for (const auto& dep : deps) {
-                // Check if this is a time-shifted reference (ends with "[t-1]")
-                std::string dep_code = dep;
-                bool is_time_shifted = false;
-                if (dep.size() > 5 && dep.substr(dep.size() - 5) == "[t-1]") {
-                    is_time_shifted = true;
-                    dep_code = dep.substr(0, dep.size() - 5);  // Strip "[t-1]"
-                }
+    // Add edge for each dependency: item depends on dep
+    std::vector<uint8_t> reads_itself(line_items_.size(), 0);
+    for (size_t i = 0; i < line_items_.size(); ++i) {
+        const auto& item = line_items_[i];
+        for (const auto& dep : formula_deps_[i]) {
+            // Check if this is a time-shifted reference (ends with "[t-1]")
+            std::string dep_code = dep;
+            bool is_time_shifted = false;
+            if (dep.size() > 5 && dep.substr(dep.size() - 5) == "[t-1]") {
+                is_time_shifted = true;
+                dep_code = dep.substr(0, dep.size() - 5);  // Strip "[t-1]"
+            }
 
-                // Skip time-shifted self-references (e.g., ACCOUNTS_PAYABLE[t-1] in ACCOUNTS_PAYABLE formula)
-                // These are inter-period dependencies, not intra-period circular dependencies
-                if (is_time_shifted && dep_code == item.code) {
-                    continue;
-                }
+            // Skip time-shifted self-references (e.g., ACCOUNTS_PAYABLE[t-1] in ACCOUNTS_PAYABLE formula)
+            // These are inter-period dependencies, not intra-period circular dependencies
+            if (is_time_shifted && dep_code == item.code) {
+                continue;
+            }
 
-                // Only add edge if dependency exists in this template
-                if (line_item_index_.find(dep_code) != line_item_index_.end()) {
-                    graph.add_edge(item.code, dep_code);
-                }
-                // Note: External dependencies (e.g., from other statements)
-                // are not added to graph - they're resolved at runtime via IValueProvider
+            // Only add edge if dependency exists in this template
+            uint32_t dep_id = graph.find_node(dep_code);
+            if (dep_id != DependencyGraph::NO_NODE) {
+                graph.add_edge(node_ids[i], dep_id);
+                reads_itself[i] = reads_itself[i] || dep_id == node_ids[i];
             }
+            // Note: External dependencies (e.g., from other statements)
+            // are not added to graph - they're resolved at runtime via IValueProvider
         }
     }
 
-    // Compute topological sort
-    calculation_order_ = graph.topological_sort();
+    // Compute topological sort; with circular references allowed, each
+    // cycle becomes a block of consecutive line items
+    circular_blocks_.clear();
+    if (!circular_.enabled) {
+        calculation_order_ = graph.topological_sort();
+    } else {
+        calculation_order_.clear();
+        for (auto& component : graph.strongly_connected_components()) {
+            const bool circular = component.size() > 1 ||
+                                  reads_itself[line_item_index_.at(SymbolTable::global().find(component.front()))];
+            if (circular) {
+                circular_blocks_.push_back({calculation_order_.size(), calculation_order_.size() + component.size()});
+            }
+            calculation_order_.insert(calculation_order_.end(), std::make_move_iterator(component.begin()),
+                                      std::make_move_iterator(component.end()));
+        }
+    }
+    order_valid_ = true;
+
+    auto entry = std::make_shared<CachedOrder>();
+    entry->dependencies = formula_deps_;
+    entry->order = calculation_order_;
+    entry->circular_blocks = circular_blocks_;
+    std::lock_guard<std::mutex> lock(order_cache_mutex);
+    if (order_cache.size() >= kMaxCachedOrders) {
+        order_cache.clear();
+    }
+    order_cache[cache_key] = std::move(entry);
+}
+
+const std::vector<std::string>& StatementTemplate::get_formula_dependencies(const std::string& code) const {
+    static const std::vector<std::string> none;
+    auto it = line_item_index_.find(SymbolTable::global().find(code));
+    if (it == line_item_index_.end() || it->second >= formula_deps_.size() ||
+        !formula_deps_valid_[it->second]) {
+        return none;
+    }
+    return formula_deps_[it->second];
+}
+
+void StatementTemplate::set_circular_policy(const CircularPolicy& policy) {
+    if (policy.max_iterations == 0 || !(policy.tolerance > 0.0)) {
+        throw std::invalid_argument("Circular policy needs max_iterations of at least 1 and a positive tolerance");
+    }
+    const CircularPolicy before = circular_;
+    circular_ = policy;
+    order_valid_ = false;
+    update_content_hash();
+    try {
+        compute_calculation_order();
+    } catch (const std::exception&) {
+        circular_ = before;
+        order_valid_ = false;
+        update_content_hash();
+        throw;
+    }
+}
+
+void StatementTemplate::update_content_hash() {
+    size_t hash = 0;
+    std::hash<std::string> hasher;
+    for (const auto& item : line_items_) {
+        size_t h = hasher(item.code) ^ (hasher(item.formula.value_or("")) * 31);
+        hash ^= h + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    if (circular_.enabled) {
+        const std::string policy = "circular:" + std::to_string(static_cast<int>(circular_.method)) + ":" +
+                                   std::to_string(circular_.max_iterations) + ":" +
+                                   std::to_string(circular_.tolerance) + ":" + std::to_string(circular_.depth);
+        hash ^= hasher(policy) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    if (time_scaling_.enabled) {
+        std::string policy = "time_scaling:" + std::to_string(time_scaling_.basis_days);
+        for (const auto& code : time_scaling_.flow_drivers) {
+            policy += ":" + code;
+        }
+        hash ^= hasher(policy) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    content_hash_ = hash;
 }
 
 void StatementTemplate::parse_json(const std::string& json_content) {
@@ -209,10 +797,43 @@ void StatementTemplate::parse_json(const std::string& json_content) {
                 }
 
                 // Add to vectors
+                item.symbol = SymbolTable::global().intern(item.code);
                 line_items_.push_back(item);
-                line_item_index_[item.code] = index++;
+                line_item_index_[item.symbol] = index++;
             }
         }
+        // Circular references solved within a period (off unless present)
+        if (j.contains("circular") && j["circular"].is_object()) {
+            const auto& circular = j["circular"];
+            circular_.enabled = circular.value("enabled", true);
+            const std::string method = circular.value("method", "anderson");
+            if (method == "anderson") {
+                circular_.method = CircularPolicy::Method::ANDERSON;
+            } else if (method == "newton") {
+                circular_.method = CircularPolicy::Method::NEWTON;
+            } else {
+                throw std::runtime_error("unknown circular method '" + method + "' (anderson or newton)");
+            }
+            circular_.max_iterations = circular.value("max_iterations", circular_.max_iterations);
+            circular_.tolerance = circular.value("tolerance", circular_.tolerance);
+            circular_.depth = circular.value("depth", circular_.depth);
+            if (circular_.max_iterations == 0 || !(circular_.tolerance > 0.0)) {
+                throw std::runtime_error("circular needs max_iterations of at least 1 and a positive tolerance");
+            }
+        }
+        // Flow drivers scaled by the period's length (off unless present)
+        if (j.contains("time_scaling") && j["time_scaling"].is_object()) {
+            const auto& scaling = j["time_scaling"];
+            time_scaling_.enabled = scaling.value("enabled", true);
+            time_scaling_.basis_days = scaling.value("basis_days", time_scaling_.basis_days);
+            if (!(time_scaling_.basis_days > 0.0)) {
+                throw std::runtime_error("time_scaling needs positive basis_days");
+            }
+            time_scaling_.flow_drivers = scaling.value("flow_drivers", std::vector<std::string>{});
+            time_scaling_.stocks = scaling.value("stocks", std::vector<std::string>{});
+            time_scaling_.rates = scaling.value("rates", std::vector<std::string>{});
+        }
+        update_content_hash();
 
         // Parse calculation order
         if (j.contains("calculation_order") && j["calculation_order"].is_array()) {
@@ -305,6 +926,23 @@ std::string StatementTemplate::to_json() const {
     }
     j["line_items"] = line_items_array;
 
+    if (circular_.enabled) {
+        j["circular"] = {
+            {"method", circular_.method == CircularPolicy::Method::NEWTON ? "newton" : "anderson"},
+            {"max_iterations", circular_.max_iterations},
+            {"tolerance", circular_.tolerance},
+            {"depth", circular_.depth},
+        };
+    }
+    if (time_scaling_.enabled) {
+        j["time_scaling"] = {
+            {"basis_days", time_scaling_.basis_days},
+            {"flow_drivers", time_scaling_.flow_drivers},
+            {"stocks", time_scaling_.stocks},
+            {"rates", time_scaling_.rates},
+        };
+    }
+
     // Validation rules (if any)
     if (!validation_rules_.empty()) {
         json rules_array = json::array();
@@ -368,6 +1006,17 @@ void StatementTemplate::save_to_database(finmodel::database::IDatabase* db) {
             }
         );
     }
+
+    // Compiled form next to the JSON (schemas before migration 015 only keep the JSON)
+    try {
+        db->execute_update(
+            "UPDATE statement_template SET compiled_structure = :compiled WHERE code = :code",
+            {{"compiled", to_binary(json_str)}, {"code", template_code_}}
+        );
+    } catch (const database::DatabaseException&) {
+    }
+
+    invalidate_cache(template_code_);
 }
 
 std::unique_ptr<StatementTemplate> StatementTemplate::clone(const std::string& new_code) const {
@@ -389,5 +1038,84 @@ std::unique_ptr<StatementTemplate> StatementTemplate::clone(const std::string& n
     return load_from_json(j.dump());
 }
 
+std::unique_ptr<StatementTemplate> StatementTemplate::with_formulas(
+    const std::string& new_code,
+    const std::map<std::string, std::string>& formulas
+) const {
+    std::unique_ptr<StatementTemplate> copy(new StatementTemplate(*this));
+    copy->template_code_ = new_code;
+    copy->formula_deps_valid_.resize(copy->line_items_.size(), 0);
+
+    for (const auto& [code, formula] : formulas) {
+        auto it = copy->line_item_index_.find(SymbolTable::global().find(code));
+        if (it == copy->line_item_index_.end()) {
+            continue;
+        }
+        copy->line_items_[it->second].formula = formula;
+        copy->line_items_[it->second].is_computed = true;
+        copy->formula_deps_valid_[it->second] = 0;
+    }
+
+    copy->order_valid_ = false;
+    copy->update_content_hash();
+    copy->compute_calculation_order();
+    return copy;
+}
+
+std::unique_ptr<StatementTemplate> StatementTemplate::with_outputs(const std::vector<std::string>& outputs) const {
+    compute_calculation_order();
+
+    // Walk dependencies backwards from the outputs
+    std::vector<uint8_t> keep(line_items_.size(), 0);
+    std::vector<size_t> pending;
+    auto require = [&](const std::string& code) {
+        auto it = line_item_index_.find(SymbolTable::global().find(code));
+        if (it != line_item_index_.end() && !keep[it->second]) {
+            keep[it->second] = 1;
+            pending.push_back(it->second);
+        }
+    };
+    for (const auto& code : outputs) {
+        require(code);
+    }
+    if (pending.empty()) {
+        throw std::invalid_argument("Template " + template_code_ + " has none of the requested outputs");
+    }
+    while (!pending.empty()) {
+        const size_t index = pending.back();
+        pending.pop_back();
+        for (const auto& dep : formula_deps_[index]) {
+            // Time-shifted references need the line item calculated in every period
+            if (dep.size() > 5 && dep.compare(dep.size() - 5, 5, "[t-1]") == 0) {
+                require(dep.substr(0, dep.size() - 5));
+            } else {
+                require(dep);
+            }
+        }
+        for (const auto& dep : line_items_[index].dependencies) {
+            require(dep);
+        }
+    }
+
+    std::unique_ptr<StatementTemplate> copy(new StatementTemplate(*this));
+    copy->line_items_.clear();
+    copy->line_item_index_.clear();
+    copy->formula_deps_.clear();
+    copy->formula_deps_valid_.clear();
+    for (size_t i = 0; i < line_items_.size(); ++i) {
+        if (keep[i]) {
+            copy->line_item_index_[line_items_[i].symbol] = copy->line_items_.size();
+            copy->line_items_.push_back(line_items_[i]);
+            copy->formula_deps_.push_back(formula_deps_[i]);
+            copy->formula_deps_valid_.push_back(1);
+        }
+    }
+
+    copy->order_valid_ = false;
+    copy->update_content_hash();
+    copy->compute_calculation_order();
+    return copy;
+}
+
 } // namespace core
 } // namespace finmodel
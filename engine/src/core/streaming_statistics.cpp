@@ -0,0 +1,71 @@
+#include "core/streaming_statistics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace finmodel {
+namespace core {
+
+void StreamingStatistics::add(double value) {
+    if (std::isnan(value)) {
+        return;
+    }
+    ++count;
+    sum_.add(value);
+    squares_.add_product(value, value);
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sketch.add(value);
+}
+
+void StreamingStatistics::add(const double* values, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        add(values[i]);
+    }
+}
+
+void StreamingStatistics::merge(const StreamingStatistics& other) {
+    sketch.merge(other.sketch);
+    if (other.count == 0) {
+        return;
+    }
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum_.merge(other.sum_);
+    squares_.merge(other.squares_);
+}
+
+double StreamingStatistics::m2() const {
+    if (count < 2) {
+        return 0.0;
+    }
+    const double sum = sum_.value();
+    const double squares = squares_.value();
+    if (!std::isfinite(sum)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (!std::isfinite(squares)) {
+        return squares;
+    }
+
+    // n · m2 = n Σx² - (Σx)², from the exact parts of both sums
+    const auto n = static_cast<double>(count);
+    ExactSum scaled;
+    for (double part : squares_.partials()) {
+        scaled.add_product(part, n);
+    }
+    const auto& parts = sum_.partials();
+    for (double a : parts) {
+        for (double b : parts) {
+            scaled.add_product(-a, b);
+        }
+    }
+    return std::max(0.0, scaled.value()) / n;
+}
+
+double StreamingStatistics::stddev() const {
+    return std::sqrt(variance());
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,55 @@
+#include "core/symbol_table.h"
+#include <mutex>
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+SymbolTable::SymbolTable() : chunks_(std::make_unique<std::unique_ptr<std::string[]>[]>(MAX_CHUNKS)) {}
+
+SymbolTable::~SymbolTable() = default;
+
+SymbolTable& SymbolTable::global() {
+    // Never destroyed: static objects may still look up names at exit
+    static SymbolTable* table = new SymbolTable();
+    return *table;
+}
+
+Symbol SymbolTable::find(std::string_view code) const {
+    std::shared_lock lock(mutex_);
+    auto it = index_.find(code);
+    return (it != index_.end()) ? it->second : NO_SYMBOL;
+}
+
+Symbol SymbolTable::intern(std::string_view code) {
+    {
+        std::shared_lock lock(mutex_);
+        auto it = index_.find(code);
+        if (it != index_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock lock(mutex_);
+    auto it = index_.find(code);
+    if (it != index_.end()) {
+        return it->second;   // Interned by another thread in between
+    }
+    const size_t next = size_.load(std::memory_order_relaxed);
+    if (next >= size_t{MAX_CHUNKS} * CHUNK_SIZE) {
+        throw std::length_error("SymbolTable: too many symbols");
+    }
+    const auto symbol = static_cast<Symbol>(next);
+    auto& chunk = chunks_[symbol >> CHUNK_BITS];
+    if (!chunk) {
+        chunk = std::make_unique<std::string[]>(CHUNK_SIZE);
+    }
+    std::string& name = chunk[symbol & (CHUNK_SIZE - 1)];
+    name.assign(code);
+    index_.emplace(std::string_view(name), symbol);
+    size_.store(next + 1, std::memory_order_release);
+    return symbol;
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,285 @@
+/**
+ * @file tangent_evaluator.cpp
+ * @brief Dual-number formula interpreter implementation
+ */
+
+#include "core/tangent_evaluator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace finmodel {
+namespace core {
+
+TangentEvaluator::TangentEvaluator(size_t directions)
+    : directions_(directions)
+{
+    if (directions_ == 0) {
+        throw std::invalid_argument("TangentEvaluator requires at least one direction");
+    }
+}
+
+double TangentEvaluator::evaluate(
+    const CompiledFormula& compiled,
+    const Loader& load,
+    LaneArray& tangent,
+    const FormulaEvaluator::CustomFunctionHandler& custom_functions
+) {
+    const size_t depth = std::max<size_t>(compiled.max_stack_depth(), 1);
+    if (values_.size() < depth) {
+        values_.resize(depth);
+        tangents_.resize(depth, LaneArray::Zero(directions_));
+    }
+
+    size_t sp = 0;  // Next free stack slot
+    const auto& code = compiled.code();
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        const Instruction& ins = code[pc];
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+                values_[sp] = compiled.constants()[ins.operand];
+                tangents_[sp++].setZero();
+                break;
+            case OpCode::LOAD_VAR: {
+                LaneArray& t = tangents_[sp];
+                load(compiled.variables()[ins.operand], ins.operand, values_[sp], t);
+                if (static_cast<size_t>(t.size()) != directions_) {
+                    throw std::runtime_error("Tangent loader returned " + std::to_string(t.size()) +
+                                             " derivatives for " + std::to_string(directions_) +
+                                             " directions: " + compiled.variables()[ins.operand].code);
+                }
+                ++sp;
+                break;
+            }
+            case OpCode::NEG:
+                values_[sp - 1] = -values_[sp - 1];
+                tangents_[sp - 1] = -tangents_[sp - 1];
+                break;
+            case OpCode::ADD:
+                --sp;
+                values_[sp - 1] += values_[sp];
+                tangents_[sp - 1] += tangents_[sp];
+                break;
+            case OpCode::SUB:
+                --sp;
+                values_[sp - 1] -= values_[sp];
+                tangents_[sp - 1] -= tangents_[sp];
+                break;
+            case OpCode::MUL:
+                --sp;
+                // (a b)' = a' b + a b'
+                tangents_[sp - 1] = tangents_[sp - 1] * values_[sp] + values_[sp - 1] * tangents_[sp];
+                values_[sp - 1] *= values_[sp];
+                break;
+            case OpCode::DIV:
+                --sp;
+                if (values_[sp] == 0.0) {
+                    std::ostringstream oss;
+                    oss << "Division by zero at position " << ins.position;
+                    throw std::runtime_error(oss.str());
+                }
+                // (a / b)' = (a' - (a / b) b') / b
+                values_[sp - 1] /= values_[sp];
+                tangents_[sp - 1] = (tangents_[sp - 1] - values_[sp - 1] * tangents_[sp]) / values_[sp];
+                break;
+            case OpCode::POW: {
+                --sp;
+                const double a = values_[sp - 1];
+                const double b = values_[sp];
+                const double value = std::pow(a, b);
+                // (a^b)' = b a^(b-1) a' + a^b ln(a) b', each term only where it moves
+                LaneArray& t = tangents_[sp - 1];
+                if ((t != 0.0).any()) {
+                    t *= b * std::pow(a, b - 1.0);
+                }
+                if (a > 0.0 && (tangents_[sp] != 0.0).any()) {
+                    t += value * std::log(a) * tangents_[sp];
+                }
+                values_[sp - 1] = value;
+                break;
+            }
+            case OpCode::CMP_LT:
+            case OpCode::CMP_LE:
+            case OpCode::CMP_GT:
+            case OpCode::CMP_GE:
+            case OpCode::CMP_EQ:
+            case OpCode::CMP_NE: {
+                --sp;
+                const double a = values_[sp - 1];
+                const double b = values_[sp];
+                bool result = false;
+                switch (ins.op) {
+                    case OpCode::CMP_LT: result = a < b; break;
+                    case OpCode::CMP_LE: result = a <= b; break;
+                    case OpCode::CMP_GT: result = a > b; break;
+                    case OpCode::CMP_GE: result = a >= b; break;
+                    case OpCode::CMP_EQ: result = a == b; break;
+                    default: result = a != b; break;
+                }
+                values_[sp - 1] = result ? 1.0 : 0.0;
+                tangents_[sp - 1].setZero();
+                break;
+            }
+            case OpCode::CALL_BUILTIN:
+            case OpCode::CALL: {
+                const auto& function = compiled.functions()[ins.operand];
+                sp -= function.arg_count;
+                call(function, sp, custom_functions);
+                ++sp;
+                break;
+            }
+            case OpCode::TAX_COMPUTE: {
+                const auto& function = compiled.functions()[ins.operand];
+                if (!custom_functions) {
+                    throw std::runtime_error("TAX_COMPUTE requires custom function handler");
+                }
+                auto tax = [&](const double* args) {
+                    return custom_functions(function.name, std::vector<double>(args, args + 1));
+                };
+                const double value = tax(&values_[sp - 1]);
+                differentiate(tax, sp - 1, 1, value);
+                values_[sp - 1] = value;
+                break;
+            }
+            case OpCode::MEMO_CHECK:
+            case OpCode::MEMO_STORE:
+                // Shared subexpressions are evaluated in place
+                break;
+            case OpCode::JUMP:
+                pc = ins.target - 1;
+                break;
+            case OpCode::JUMP_IF_FALSE:
+                --sp;
+                if (values_[sp] == 0.0) {
+                    pc = ins.target - 1;
+                }
+                break;
+            case OpCode::SHORT_AND:
+                if (values_[sp - 1] == 0.0) {
+                    tangents_[sp - 1].setZero();
+                    pc = ins.target - 1;
+                } else {
+                    --sp;
+                }
+                break;
+            case OpCode::SHORT_OR:
+                if (values_[sp - 1] != 0.0) {
+                    values_[sp - 1] = 1.0;
+                    tangents_[sp - 1].setZero();
+                    pc = ins.target - 1;
+                } else {
+                    --sp;
+                }
+                break;
+            case OpCode::TO_BOOL:
+                values_[sp - 1] = (values_[sp - 1] != 0.0) ? 1.0 : 0.0;
+                tangents_[sp - 1].setZero();
+                break;
+        }
+    }
+
+    tangent = tangents_[0];
+    return values_[0];
+}
+
+void TangentEvaluator::call(
+    const FunctionCall& call,
+    size_t base,
+    const FormulaEvaluator::CustomFunctionHandler& custom_functions
+) {
+    double* a = &values_[base];
+    LaneArray& t = tangents_[base];
+    const uint32_t n = call.arg_count;
+
+    // Tangent of the argument the function returned
+    auto select = [&](uint32_t arg) {
+        if (arg != 0) {
+            t = tangents_[base + arg];
+        }
+        a[0] = a[arg];
+    };
+
+    if (call.builtin) {
+        switch (call.function_id) {
+            case FunctionRegistry::FN_MIN:
+                select(a[1] < a[0] ? 1 : 0);
+                return;
+            case FunctionRegistry::FN_MAX:
+                select(a[1] > a[0] ? 1 : 0);
+                return;
+            case FunctionRegistry::FN_ABS:
+                if (a[0] < 0.0) {
+                    t = -t;
+                } else if (a[0] == 0.0) {
+                    t.setZero();
+                }
+                a[0] = std::abs(a[0]);
+                return;
+            case FunctionRegistry::FN_IF:
+                select(a[0] != 0.0 ? 1 : 2);
+                return;
+            case FunctionRegistry::FN_SUM:
+            case FunctionRegistry::FN_AVG:
+                for (uint32_t i = 1; i < n; ++i) {
+                    a[0] += a[i];
+                    t += tangents_[base + i];
+                }
+                if (call.function_id == FunctionRegistry::FN_AVG) {
+                    a[0] /= static_cast<double>(n);
+                    t /= static_cast<double>(n);
+                }
+                return;
+            case FunctionRegistry::FN_CLAMP: {
+                const double value = call.builtin(a, n);   // Raises the error for low > high
+                select(a[0] < a[1] ? 1 : (a[0] > a[2] ? 2 : 0));
+                a[0] = value;
+                return;
+            }
+            case FunctionRegistry::FN_ROUND:
+            case FunctionRegistry::FN_AND:
+            case FunctionRegistry::FN_OR:
+                a[0] = call.builtin(a, n);
+                t.setZero();
+                return;
+            default:
+                break;
+        }
+    }
+
+    // Any other function: scalar call, derivative from the function itself
+    auto function = [&](const double* args) {
+        return FormulaEvaluator::call_function(call, args, custom_functions);
+    };
+    const double value = function(a);
+    differentiate(function, base, n, value);
+    a[0] = value;
+}
+
+template <typename Function>
+void TangentEvaluator::differentiate(Function&& function, size_t base, uint32_t args, double value) {
+    scalar_args_.assign(values_.begin() + static_cast<std::ptrdiff_t>(base),
+                        values_.begin() + static_cast<std::ptrdiff_t>(base + args));
+    const double epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+
+    // Arguments whose tangent is 0 don't move the result; the others add
+    // their partial derivative (right of the argument) times their tangent
+    LaneArray result = LaneArray::Zero(static_cast<Eigen::Index>(directions_));
+    for (uint32_t i = 0; i < args; ++i) {
+        const LaneArray& t = tangents_[base + i];
+        if (!(t != 0.0).any()) {
+            continue;
+        }
+        const double x = scalar_args_[i];
+        scalar_args_[i] = x + epsilon * std::max(1.0, std::abs(x));
+        const double step = scalar_args_[i] - x;   // Exactly representable
+        const double partial = (function(scalar_args_.data()) - value) / step;
+        scalar_args_[i] = x;
+        result += partial * t;
+    }
+    tangents_[base] = result;
+}
+
+} // namespace core
+} // namespace finmodel
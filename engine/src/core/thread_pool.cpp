@@ -0,0 +1,113 @@
+/**
+ * @file thread_pool.cpp
+ * @brief Fixed-size worker pool implementation
+ */
+
+#include "core/thread_pool.h"
+#include <algorithm>
+
+namespace finmodel {
+namespace core {
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    // The caller is thread 0, workers are 1..threads-1
+    for (size_t worker = 1; worker < threads; ++worker) {
+        workers_.emplace_back([this, worker] { worker_loop(worker); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const RangeFunction& fn, size_t grain) {
+    if (count == 0) {
+        return;
+    }
+    if (workers_.empty() || count <= grain) {
+        fn(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        // A few chunks per thread balances uneven items without much locking
+        chunk_ = std::max(grain, count / (size() * 4) + 1);
+        next_ = 0;
+        busy_ = 1;  // The caller
+        error_ = nullptr;
+        ++generation_;
+    }
+    work_ready_.notify_all();
+
+    run_chunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    --busy_;
+    work_done_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+    size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_ready_.wait(lock, [&] { return stopping_ || (generation_ != seen && fn_); });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+        ++busy_;
+        lock.unlock();
+
+        run_chunks(worker);
+
+        lock.lock();
+        if (--busy_ == 0) {
+            work_done_.notify_all();
+        }
+    }
+}
+
+void ThreadPool::run_chunks(size_t worker) {
+    while (true) {
+        size_t begin;
+        size_t end;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (next_ >= count_) {
+                return;
+            }
+            begin = next_;
+            end = std::min(count_, begin + chunk_);
+            next_ = end;
+        }
+
+        try {
+            (*fn_)(begin, end, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+} // namespace core
+} // namespace finmodel
@@ -0,0 +1,168 @@
+#include "core/time_series.h"
+#include "core/eigen.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace finmodel {
+namespace core {
+
+RollingWindow::RollingWindow(size_t length) : values_(length) {
+    if (length == 0) {
+        throw std::invalid_argument("RollingWindow: length must be at least 1");
+    }
+}
+
+void RollingWindow::push(PeriodID period, double value) {
+    if (size_ > 0 && period != last_period_ + 1) {
+        reset();
+    }
+    last_period_ = period;
+
+    if (full()) {
+        const double oldest = values_[head_];
+        if (!std::isnan(oldest)) {
+            sum_ -= oldest;
+            --count_;
+        }
+    } else {
+        ++size_;
+    }
+    values_[head_] = value;
+    if (!std::isnan(value)) {
+        sum_ += value;
+        ++count_;
+    }
+    head_ = (head_ + 1) % values_.size();
+
+    // Once per lap: the sum of the window itself, not of every update so far
+    if (head_ == 0) {
+        sum_ = 0.0;
+        for (double v : values_) {
+            if (!std::isnan(v)) {
+                sum_ += v;
+            }
+        }
+    }
+}
+
+void RollingWindow::reset() {
+    head_ = 0;
+    size_ = 0;
+    count_ = 0;
+    sum_ = 0.0;
+}
+
+std::string WindowRef::key() const {
+    return std::string(average ? "AVG_WINDOW(" : "SUM_WINDOW(") + code + "," + std::to_string(periods) + ")";
+}
+
+std::optional<WindowRef> WindowRef::parse(std::string_view key) {
+    WindowRef window;
+    if (key.substr(0, 11) == "SUM_WINDOW(") {
+        window.average = false;
+    } else if (key.substr(0, 11) == "AVG_WINDOW(") {
+        window.average = true;
+    } else {
+        return std::nullopt;
+    }
+    const size_t comma = key.find(',', 11);
+    if (comma == std::string_view::npos || comma == 11 || key.back() != ')' || comma + 2 >= key.size()) {
+        return std::nullopt;
+    }
+    for (size_t i = comma + 1; i + 1 < key.size(); ++i) {
+        if (key[i] < '0' || key[i] > '9' || window.periods > MAX_PERIODS) {
+            return std::nullopt;
+        }
+        window.periods = window.periods * 10 + static_cast<size_t>(key[i] - '0');
+    }
+    if (window.periods == 0 || window.periods > MAX_PERIODS) {
+        return std::nullopt;
+    }
+    window.code = std::string(key.substr(11, comma - 11));
+    return window;
+}
+
+namespace {
+
+/// sum(values[i] * (1 + rate)^-(i + shift)) and its derivative by rate
+std::pair<double, double> discounted(double rate, const double* values, size_t size, double shift) {
+    const Eigen::Index n = static_cast<Eigen::Index>(size);
+    const Eigen::Map<const Eigen::ArrayXd> v(values, n);
+    const Eigen::ArrayXd t = Eigen::ArrayXd::LinSpaced(n, shift, shift + static_cast<double>(n) - 1.0);
+    const Eigen::ArrayXd factors = (-t * std::log1p(rate)).exp();
+    const double value = (v * factors).sum();
+    const double slope = -(t * v * factors).sum() / (1.0 + rate);
+    return {value, slope};
+}
+
+} // namespace
+
+double npv(double rate, const double* values, size_t size) {
+    if (rate <= -1.0) {
+        throw std::invalid_argument("npv: rate must be greater than -1");
+    }
+    if (size == 0) {
+        return 0.0;
+    }
+    return discounted(rate, values, size, 1.0).first;
+}
+
+double irr(const double* values, size_t size, double guess) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    bool positive = false;
+    bool negative = false;
+    for (size_t i = 0; i < size; ++i) {
+        positive = positive || values[i] > 0.0;
+        negative = negative || values[i] < 0.0;
+    }
+    if (!positive || !negative) {
+        return nan;
+    }
+
+    // Newton's method
+    double rate = guess > -1.0 ? guess : 0.1;
+    for (int iteration = 0; iteration < 50; ++iteration) {
+        const auto [value, slope] = discounted(rate, values, size, 0.0);
+        if (slope == 0.0 || !std::isfinite(slope)) {
+            break;
+        }
+        const double next = rate - value / slope;
+        if (!std::isfinite(next) || next <= -1.0) {
+            break;
+        }
+        if (std::abs(next - rate) <= 1e-12 * std::max(1.0, std::abs(rate))) {
+            return next;
+        }
+        rate = next;
+    }
+
+    // Bisection over a bracket with a sign change
+    double low = -0.99;
+    double high = 1.0;
+    double low_value = discounted(low, values, size, 0.0).first;
+    double high_value = discounted(high, values, size, 0.0).first;
+    while ((low_value > 0.0) == (high_value > 0.0)) {
+        if (high > 1e6) {
+            return nan;
+        }
+        high *= 10.0;
+        high_value = discounted(high, values, size, 0.0).first;
+    }
+    for (int iteration = 0; iteration < 200 && high - low > 1e-14 * std::max(1.0, std::abs(low)); ++iteration) {
+        const double mid = 0.5 * (low + high);
+        const double mid_value = discounted(mid, values, size, 0.0).first;
+        if ((mid_value > 0.0) == (low_value > 0.0)) {
+            low = mid;
+            low_value = mid_value;
+        } else {
+            high = mid;
+        }
+    }
+    return 0.5 * (low + high);
+}
+
+} // namespace core
+} // namespace finmodel
@@ -4,11 +4,13 @@
  */
 
 #include "core/unit_converter.h"
+#include "core/static_units.h"
 #include "database/idatabase.h"
 #include "database/result_set.h"
 #include "fx/fx_provider.h"
 #include <stdexcept>
 #include <sstream>
+#include <algorithm>
 #include <cmath>
 
 namespace finmodel {
@@ -16,7 +18,7 @@ namespace core {
 
 UnitConverter::UnitConverter(
     std::shared_ptr<database::IDatabase> db,
-    std::shared_ptr<fx::FXProvider> fx_provider
+    std::shared_ptr<const fx::FXProvider> fx_provider
 ) : db_(db), fx_provider_(fx_provider) {
     if (!db_) {
         throw std::invalid_argument("Database connection required");
@@ -60,67 +62,139 @@ void UnitConverter::load_unit_definitions() {
         def.display_symbol = result_set->get_string("display_symbol");
         def.description = result_set->get_string("description");
 
-        // Store definition
-        unit_definitions_[def.unit_code] = def;
+        // Resolve FX currency IDs once; lookups then index the rate table directly
+        if (fx_provider_ && def.conversion_type == "TIME_VARYING") {
+            def.fx_from_id = fx_provider_->currency_id(def.unit_code);
+            def.fx_to_id = fx_provider_->currency_id(def.base_unit_code);
+        }
 
-        // Build lookup maps
-        unit_to_category_[def.unit_code] = def.unit_category;
-        conversion_types_[def.unit_code] = def.conversion_type;
-        display_symbols_[def.unit_code] = def.display_symbol;
+        if (def.unit_code == def.base_unit_code) {
+            def.conversion = Conversion::BASE;
+        } else if (def.conversion_type == "STATIC") {
+            def.conversion = Conversion::STATIC;
+            // A built-in unit takes its exact factor unless the row defines another one
+            auto exact = units::builtin_factor(def.unit_code, def.base_unit_code);
+            if (exact && std::abs(def.static_conversion_factor - *exact) <= 1e-4 * *exact) {
+                def.static_conversion_factor = *exact;
+            }
+        } else if (def.conversion_type == "TIME_VARYING") {
+            def.conversion = Conversion::TIME_VARYING;
+        }
 
-        // Cache static conversion factors
-        if (def.conversion_type == "STATIC") {
-            static_conversion_factors_[def.unit_code] = def.static_conversion_factor;
+        // Store definition (a repeated code replaces the earlier row)
+        auto [it, inserted] = unit_index_.emplace(def.unit_code, static_cast<int>(units_.size()));
+        if (inserted) {
+            units_.push_back(std::move(def));
+        } else {
+            units_[it->second] = std::move(def);
         }
+        const UnitDefinition& stored = units_[it->second];
 
         // Build category → base unit map
-        if (category_to_base_unit_.find(def.unit_category) == category_to_base_unit_.end()) {
-            category_to_base_unit_[def.unit_category] = def.base_unit_code;
+        if (category_to_base_unit_.find(stored.unit_category) == category_to_base_unit_.end()) {
+            category_to_base_unit_[stored.unit_category] = stored.base_unit_code;
         }
     }
 
-    if (unit_definitions_.empty()) {
+    if (units_.empty()) {
         throw std::runtime_error("No unit definitions found in database");
     }
+
+    build_static_factors();
 }
 
-double UnitConverter::to_base_unit(
-    double value,
-    const std::string& unit_code,
-    std::optional<int> period_id
-) const {
-    // Check if unit exists
-    if (unit_definitions_.find(unit_code) == unit_definitions_.end()) {
-        throw std::invalid_argument("Unknown unit code: " + unit_code);
+void UnitConverter::build_static_factors() {
+    const size_t n = units_.size();
+    std::vector<double> to_base(n, std::nan(""));
+    for (size_t i = 0; i < n; ++i) {
+        if (units_[i].conversion == Conversion::BASE) {
+            to_base[i] = 1.0;
+        } else if (units_[i].conversion == Conversion::STATIC) {
+            to_base[i] = units_[i].static_conversion_factor;
+        }
     }
 
-    const auto& def = unit_definitions_.at(unit_code);
+    static_factors_.assign(n * n, std::nan(""));
+    for (size_t from = 0; from < n; ++from) {
+        for (size_t to = 0; to < n; ++to) {
+            if (units_[from].unit_category != units_[to].unit_category ||
+                std::isnan(to_base[from]) || std::isnan(to_base[to]) || std::abs(to_base[to]) < 1e-10) {
+                continue;  // Needs a period, a zero-factor error, or a category error
+            }
+            static_factors_[from * n + to] = to_base[from] / to_base[to];
+        }
+    }
+}
 
-    // If already in base unit, return as-is
-    if (unit_code == def.base_unit_code) {
-        return value;
+int UnitConverter::unit_id(std::string_view unit_code) const {
+    auto it = unit_index_.find(unit_code);
+    return (it != unit_index_.end()) ? it->second : NO_UNIT;
+}
+
+double UnitConverter::base_factor(int unit_id, std::optional<int> period_id) const {
+    if (unit_id < 0 || static_cast<size_t>(unit_id) >= units_.size()) {
+        throw std::invalid_argument("Unknown unit id: " + std::to_string(unit_id));
+    }
+    const UnitDefinition& def = units_[unit_id];
+
+    switch (def.conversion) {
+        case Conversion::BASE:
+            return 1.0;
+        case Conversion::STATIC:
+            return def.static_conversion_factor;
+        case Conversion::TIME_VARYING:
+            if (!period_id.has_value()) {
+                throw std::invalid_argument(
+                    "period_id required for time-varying unit: " + def.unit_code
+                );
+            }
+            return get_time_varying_conversion_factor(def, period_id.value());
+        case Conversion::INVALID:
+            break;
     }
+    throw std::runtime_error("Invalid conversion_type: " + def.conversion_type);
+}
 
-    // Check conversion type
-    if (def.conversion_type == "STATIC") {
-        // Static conversion: multiply by cached factor
-        return value * static_conversion_factors_.at(unit_code);
+std::optional<double> UnitConverter::static_factor(int unit_id) const {
+    if (unit_id < 0 || static_cast<size_t>(unit_id) >= units_.size()) {
+        return std::nullopt;
     }
-    else if (def.conversion_type == "TIME_VARYING") {
-        // Time-varying conversion: requires period_id
-        if (!period_id.has_value()) {
-            throw std::invalid_argument(
-                "period_id required for time-varying unit: " + unit_code
-            );
-        }
+    switch (units_[unit_id].conversion) {
+        case Conversion::BASE:
+            return 1.0;
+        case Conversion::STATIC:
+            return units_[unit_id].static_conversion_factor;
+        default:
+            return std::nullopt;
+    }
+}
 
-        // Delegate to FX provider
-        double factor = get_time_varying_conversion_factor(unit_code, period_id.value());
-        return value * factor;
+void UnitConverter::base_factors(
+    int unit_id,
+    const std::vector<int>& period_ids,
+    std::vector<double>& factors
+) const {
+    factors.resize(period_ids.size());
+    if (unit_id >= 0 && static_cast<size_t>(unit_id) < units_.size() &&
+        units_[unit_id].conversion == Conversion::TIME_VARYING) {
+        for (size_t i = 0; i < period_ids.size(); ++i) {
+            factors[i] = base_factor(unit_id, period_ids[i]);
+        }
+        return;
     }
-    else {
-        throw std::runtime_error("Invalid conversion_type: " + def.conversion_type);
+    std::fill(factors.begin(), factors.end(), base_factor(unit_id));
+}
+
+double UnitConverter::to_base_unit(
+    double value,
+    const std::string& unit_code,
+    std::optional<int> period_id
+) const {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT) {
+        throw std::invalid_argument("Unknown unit code: " + unit_code);
     }
+    return value * base_factor(id, period_id);
 }
 
 double UnitConverter::from_base_unit(
@@ -128,45 +202,22 @@ double UnitConverter::from_base_unit(
     const std::string& unit_code,
     std::optional<int> period_id
 ) const {
-    // Check if unit exists
-    if (unit_definitions_.find(unit_code) == unit_definitions_.end()) {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT) {
         throw std::invalid_argument("Unknown unit code: " + unit_code);
     }
-
-    const auto& def = unit_definitions_.at(unit_code);
-
-    // If already in base unit, return as-is
-    if (unit_code == def.base_unit_code) {
+    const UnitDefinition& def = units_[id];
+    if (def.conversion == Conversion::BASE) {
         return value;
     }
 
-    // Check conversion type
-    if (def.conversion_type == "STATIC") {
-        // Static conversion: divide by cached factor
-        double factor = static_conversion_factors_.at(unit_code);
-        if (std::abs(factor) < 1e-10) {
-            throw std::runtime_error("Invalid zero conversion factor for: " + unit_code);
-        }
-        return value / factor;
-    }
-    else if (def.conversion_type == "TIME_VARYING") {
-        // Time-varying conversion: requires period_id
-        if (!period_id.has_value()) {
-            throw std::invalid_argument(
-                "period_id required for time-varying unit: " + unit_code
-            );
-        }
-
-        // Delegate to FX provider
-        double factor = get_time_varying_conversion_factor(unit_code, period_id.value());
-        if (std::abs(factor) < 1e-10) {
-            throw std::runtime_error("Invalid zero FX rate for: " + unit_code);
-        }
-        return value / factor;
-    }
-    else {
-        throw std::runtime_error("Invalid conversion_type: " + def.conversion_type);
+    double factor = base_factor(id, period_id);
+    if (std::abs(factor) < 1e-10) {
+        throw std::runtime_error(
+            (def.conversion == Conversion::STATIC ? "Invalid zero conversion factor for: "
+                                                  : "Invalid zero FX rate for: ") + unit_code);
     }
+    return value / factor;
 }
 
 double UnitConverter::convert(
@@ -176,17 +227,18 @@ double UnitConverter::convert(
     std::optional<int> period_id
 ) const {
     // Check units exist
-    if (unit_definitions_.find(from_unit) == unit_definitions_.end()) {
+    int from_id = unit_id(from_unit);
+    int to_id = unit_id(to_unit);
+    if (from_id == NO_UNIT) {
         throw std::invalid_argument("Unknown source unit: " + from_unit);
     }
-    if (unit_definitions_.find(to_unit) == unit_definitions_.end()) {
+    if (to_id == NO_UNIT) {
         throw std::invalid_argument("Unknown target unit: " + to_unit);
     }
+    const UnitDefinition& from_def = units_[from_id];
+    const UnitDefinition& to_def = units_[to_id];
 
     // Check same category
-    const auto& from_def = unit_definitions_.at(from_unit);
-    const auto& to_def = unit_definitions_.at(to_unit);
-
     if (from_def.unit_category != to_def.unit_category) {
         throw std::invalid_argument(
             "Cannot convert between different categories: " +
@@ -194,6 +246,12 @@ double UnitConverter::convert(
         );
     }
 
+    // Static pairs: one precomputed factor
+    double factor = static_factors_[static_cast<size_t>(from_id) * units_.size() + to_id];
+    if (!std::isnan(factor)) {
+        return value * factor;
+    }
+
     // Convert: from_unit → base_unit → to_unit
     double in_base = to_base_unit(value, from_unit, period_id);
     double in_target = from_base_unit(in_base, to_unit, period_id);
@@ -202,23 +260,23 @@ double UnitConverter::convert(
 }
 
 bool UnitConverter::is_time_varying(const std::string& unit_code) const {
-    auto it = conversion_types_.find(unit_code);
-    if (it == conversion_types_.end()) {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT) {
         return false;  // Unknown unit, assume not time-varying
     }
-    return it->second == "TIME_VARYING";
+    return units_[id].conversion == Conversion::TIME_VARYING;
 }
 
 bool UnitConverter::is_valid_unit(const std::string& unit_code) const {
-    return unit_definitions_.find(unit_code) != unit_definitions_.end();
+    return unit_id(unit_code) != NO_UNIT;
 }
 
 std::string UnitConverter::get_display_symbol(const std::string& unit_code) const {
-    auto it = display_symbols_.find(unit_code);
-    if (it == display_symbols_.end()) {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT) {
         return unit_code;  // Fallback to code itself
     }
-    return it->second;
+    return units_[id].display_symbol;
 }
 
 std::string UnitConverter::get_base_unit(const std::string& category) const {
@@ -230,43 +288,37 @@ std::string UnitConverter::get_base_unit(const std::string& category) const {
 }
 
 std::string UnitConverter::get_category(const std::string& unit_code) const {
-    auto it = unit_to_category_.find(unit_code);
-    if (it == unit_to_category_.end()) {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT) {
         throw std::invalid_argument("Unknown unit code: " + unit_code);
     }
-    return it->second;
+    return units_[id].unit_category;
 }
 
 double UnitConverter::get_static_conversion_factor(const std::string& unit_code) const {
-    auto it = static_conversion_factors_.find(unit_code);
-    if (it == static_conversion_factors_.end()) {
+    int id = unit_id(unit_code);
+    if (id == NO_UNIT || units_[id].conversion_type != "STATIC") {
         throw std::invalid_argument(
             "Unit is not static or not found: " + unit_code
         );
     }
-    return it->second;
+    return units_[id].static_conversion_factor;
 }
 
-double UnitConverter::get_time_varying_conversion_factor(
-    const std::string& unit_code,
-    int period_id
-) const {
+double UnitConverter::get_time_varying_conversion_factor(const UnitDefinition& def, int period_id) const {
     if (!fx_provider_) {
         throw std::runtime_error(
-            "FX provider required for time-varying unit: " + unit_code +
+            "FX provider required for time-varying unit: " + def.unit_code +
             " (ensure FXProvider passed to UnitConverter constructor)"
         );
     }
 
-    // Get base currency for this unit's category
-    const auto& def = unit_definitions_.at(unit_code);
-    std::string base_currency = def.base_unit_code;
-
-    // Get FX rate from FXProvider
-    // FXProvider::get_rate(from_currency, to_currency, period_id)
-    double rate = fx_provider_->get_rate(unit_code, base_currency, period_id);
+    if (def.fx_from_id != fx::FXProvider::NO_CURRENCY && def.fx_to_id != fx::FXProvider::NO_CURRENCY) {
+        return fx_provider_->get_rate(def.fx_from_id, def.fx_to_id, period_id);
+    }
 
-    return rate;
+    // Currency without rates when units were loaded (e.g. added by FXProvider::reload())
+    return fx_provider_->get_rate(def.unit_code, def.base_unit_code, period_id);
 }
 
 } // namespace core
@@ -0,0 +1,350 @@
+/**
+ * @file credit_risk_engine.cpp
+ * @brief Implementation of the portfolio expected credit loss engine
+ */
+
+#include "credit/credit_risk_engine.h"
+#include "core/low_discrepancy.h"
+#include "database/result_set.h"
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+
+namespace finmodel {
+namespace credit {
+
+// ============================================================================
+// CreditPortfolio
+// ============================================================================
+
+CreditPortfolio CreditPortfolio::load(database::IDatabase& db) {
+    std::vector<CreditPosition> positions;
+    auto rows = db.execute_query(
+        "SELECT entity_id, segment, ead, lgd, pd, asset_correlation, maturity_periods, amortising "
+        "FROM credit_exposure ORDER BY entity_id, position_id", {});
+    for (auto [entity, segment, ead, lgd, pd, correlation, maturity, amortising] :
+         rows->rows<std::string, std::optional<std::string>, double, double, double,
+                    std::optional<double>, std::optional<int>, std::optional<int>>()) {
+        CreditPosition position;
+        position.entity_id = std::move(entity);
+        if (segment && !segment->empty()) {
+            position.segment = std::move(*segment);
+        }
+        position.ead = ead;
+        position.lgd = lgd;
+        position.pd = pd;
+        position.asset_correlation = correlation.value_or(position.asset_correlation);
+        position.maturity_periods = maturity.value_or(-1);
+        position.amortising = amortising.value_or(0) != 0;
+        positions.push_back(std::move(position));
+    }
+    return CreditPortfolio(std::move(positions));
+}
+
+CreditPortfolio::CreditPortfolio(std::vector<CreditPosition> positions, int periods_per_year)
+    : periods_per_year_(periods_per_year) {
+    if (periods_per_year < 1) {
+        throw std::invalid_argument("CreditPortfolio: periods_per_year must be at least 1");
+    }
+    std::stable_sort(positions.begin(), positions.end(), [](const CreditPosition& a, const CreditPosition& b) {
+        return a.entity_id < b.entity_id;
+    });
+
+    const size_t n = positions.size();
+    entity_.resize(n);
+    segment_.resize(n);
+    ead_.resize(n);
+    lgd_.resize(n);
+    maturity_.resize(n);
+    amortising_.resize(n);
+    period_pd_.resize(n);
+    threshold_.resize(n);
+    loading_.resize(n);
+
+    std::unordered_map<std::string, uint32_t> segment_index;
+    for (size_t i = 0; i < n; ++i) {
+        const CreditPosition& p = positions[i];
+        if (!(p.pd >= 0.0 && p.pd <= 1.0) || !(p.lgd >= 0.0 && p.lgd <= 1.0) || !(p.ead >= 0.0) ||
+            !(p.asset_correlation >= 0.0 && p.asset_correlation < 1.0)) {
+            throw std::invalid_argument("CreditPortfolio: position of " + p.entity_id +
+                                        " needs PD and LGD in [0, 1], EAD >= 0 and correlation in [0, 1)");
+        }
+        if (entities_.empty() || entities_.back() != p.entity_id) {
+            entities_.push_back(p.entity_id);
+            entity_starts_.push_back(i);
+        }
+        auto [segment, added] = segment_index.emplace(p.segment, static_cast<uint32_t>(segments_.size()));
+        if (added) {
+            segments_.push_back(p.segment);
+        }
+
+        entity_[i] = static_cast<uint32_t>(entities_.size() - 1);
+        segment_[i] = segment->second;
+        ead_[i] = p.ead;
+        lgd_[i] = p.lgd;
+        maturity_[i] = p.maturity_periods;
+        amortising_[i] = p.amortising ? 1 : 0;
+
+        // Vasicek: PD(Z) = Φ((Φ^-1(PD) - √ρ Z) / √(1 - ρ)), on the period PD
+        period_pd_[i] = (periods_per_year == 1)
+            ? p.pd : 1.0 - std::pow(1.0 - p.pd, 1.0 / static_cast<double>(periods_per_year));
+        const double scale = 1.0 / std::sqrt(1.0 - p.asset_correlation);
+        threshold_[i] = core::normal_quantile(period_pd_[i]) * scale;
+        loading_[i] = std::sqrt(p.asset_correlation) * scale;
+    }
+    entity_starts_.push_back(n);
+}
+
+// ============================================================================
+// CreditFactorPath
+// ============================================================================
+
+namespace {
+
+double path_value(const std::unordered_map<std::string, std::vector<double>>& values, const std::string& segment,
+                  size_t k, double fallback) {
+    auto it = values.find(segment);
+    if (it == values.end() || k >= it->second.size() || std::isnan(it->second[k])) {
+        it = values.find("");
+    }
+    if (it == values.end() || k >= it->second.size() || std::isnan(it->second[k])) {
+        return fallback;
+    }
+    return it->second[k];
+}
+
+} // namespace
+
+double CreditFactorPath::z_of(const std::string& segment, size_t k) const {
+    return path_value(z, segment, k, std::nan(""));
+}
+
+double CreditFactorPath::lgd_scale_of(const std::string& segment, size_t k) const {
+    return path_value(lgd_scale, segment, k, 1.0);
+}
+
+// ============================================================================
+// CreditRiskEngine
+// ============================================================================
+
+CreditRiskEngine::CreditRiskEngine(std::shared_ptr<const CreditPortfolio> portfolio, CreditRiskOptions options)
+    : portfolio_(std::move(portfolio)), options_(std::move(options)) {
+    if (!portfolio_) {
+        throw std::invalid_argument("CreditRiskEngine: portfolio must not be null");
+    }
+}
+
+void CreditRiskEngine::set_parallel(size_t threads, size_t shard_positions) {
+    if (shard_positions == 0) {
+        throw std::invalid_argument("CreditRiskEngine: shard size must be at least 1");
+    }
+    pool_.reset();
+    if (threads > 1) {
+        pool_ = std::make_unique<core::ThreadPool>(threads);
+    }
+    shard_positions_ = shard_positions;
+}
+
+CreditFactorPath CreditRiskEngine::load_factors(database::IDatabase& db, ScenarioID scenario_id,
+                                                const std::vector<PeriodID>& period_ids) const {
+    CreditFactorPath path;
+    path.period_ids = period_ids;
+    std::unordered_map<PeriodID, size_t> period_index;
+    for (size_t k = 0; k < period_ids.size(); ++k) {
+        period_index.emplace(period_ids[k], k);
+    }
+
+    auto rows = db.execute_query(
+        "SELECT period_id, driver_code, value FROM scenario_drivers "
+        "WHERE entity_id = :entity AND scenario_id = :scenario AND (driver_code LIKE :z OR driver_code LIKE :lgd)",
+        {{"entity", options_.factor_entity}, {"scenario", scenario_id},
+         {"z", options_.factor_driver + "%"}, {"lgd", options_.lgd_scale_driver + "%"}});
+    const double nan = std::nan("");
+    for (auto [period_id, code, value] : rows->rows<int, std::string, double>()) {
+        auto k = period_index.find(period_id);
+        if (k == period_index.end()) {
+            continue;
+        }
+        // DRIVER (all segments) or DRIVER_SEGMENT; LIKE only narrowed the rows down
+        auto target = [&](const std::string& driver) -> std::vector<double>* {
+            if (code == driver) {
+                return driver == options_.factor_driver ? &path.z[""] : &path.lgd_scale[""];
+            }
+            if (code.size() > driver.size() + 1 && code.compare(0, driver.size() + 1, driver + "_") == 0) {
+                auto& values = driver == options_.factor_driver ? path.z : path.lgd_scale;
+                return &values[code.substr(driver.size() + 1)];
+            }
+            return nullptr;
+        };
+        // LGD scale first, in case one driver code starts with the other
+        std::vector<double>* values = target(options_.lgd_scale_driver);
+        if (!values) {
+            values = target(options_.factor_driver);
+        }
+        if (values) {
+            values->resize(period_ids.size(), nan);
+            (*values)[k->second] = value;
+        }
+    }
+    return path;
+}
+
+CreditLosses CreditRiskEngine::calculate(const CreditFactorPath& path) const {
+    const CreditPortfolio& p = *portfolio_;
+    const size_t periods = path.period_ids.size();
+    const size_t segments = p.segments().size();
+
+    CreditLosses losses;
+    losses.entities = p.entities();
+    losses.period_ids = path.period_ids;
+    losses.ecl.assign(p.entities().size() * periods, 0.0);
+    losses.exposure.assign(p.entities().size() * periods, 0.0);
+    if (p.size() == 0 || periods == 0) {
+        return losses;
+    }
+
+    // Factor (NaN: none, the unconditional PD) and LGD scale of each segment and period, resolved once
+    std::vector<double> z(segments * periods);
+    std::vector<double> lgd_scale(segments * periods);
+    for (size_t s = 0; s < segments; ++s) {
+        for (size_t k = 0; k < periods; ++k) {
+            z[s * periods + k] = path.z_of(p.segments()[s], k);
+            lgd_scale[s * periods + k] = path.lgd_scale_of(p.segments()[s], k);
+        }
+    }
+
+    // Shards of positions; each sums its own entities (a contiguous range)
+    const size_t shard_count = (p.size() + shard_positions_ - 1) / shard_positions_;
+    struct Shard {
+        uint32_t first_entity = 0;
+        std::vector<double> ecl;        // (entity - first_entity) * periods + k
+        std::vector<double> exposure;
+    };
+    std::vector<Shard> shards(shard_count);
+
+    const uint32_t* entity = p.entity().data();
+    const uint32_t* segment = p.segment().data();
+    const double* ead = p.ead().data();
+    const double* lgd = p.lgd().data();
+    const int32_t* maturity = p.maturity().data();
+    const uint8_t* amortising = p.amortising().data();
+    const double* period_pd = p.period_pd().data();
+    const double* threshold = p.threshold().data();
+    const double* loading = p.loading().data();
+
+    auto run = [&](size_t begin, size_t end, size_t) {
+        std::vector<double> survival;
+        std::vector<double> pd;
+        std::vector<double> ead_k;
+        for (size_t s = begin; s < end; ++s) {
+            const size_t first = s * shard_positions_;
+            const size_t last = std::min(first + shard_positions_, p.size());
+            const size_t count = last - first;
+            Shard& shard = shards[s];
+            shard.first_entity = entity[first];
+            const size_t shard_entities = entity[last - 1] - shard.first_entity + 1;
+            shard.ecl.assign(shard_entities * periods, 0.0);
+            shard.exposure.assign(shard_entities * periods, 0.0);
+            survival.assign(count, 1.0);
+            pd.resize(count);
+            ead_k.resize(count);
+
+            for (size_t k = 0; k < periods; ++k) {
+                // Conditional PDs and remaining exposures (straight loops over the arrays)
+                for (size_t i = 0; i < count; ++i) {
+                    const size_t at = first + i;
+                    const double factor = z[segment[at] * periods + k];
+                    const double x = threshold[at] - loading[at] * factor;
+                    pd[i] = std::isnan(factor) ? period_pd[at] : 0.5 * std::erfc(-x * M_SQRT1_2);
+                }
+                const int32_t period = static_cast<int32_t>(k);
+                for (size_t i = 0; i < count; ++i) {
+                    const size_t at = first + i;
+                    const int32_t m = maturity[at];
+                    const double left = (m < 0) ? 1.0
+                        : (period >= m) ? 0.0
+                        : amortising[at] ? static_cast<double>(m - period) / static_cast<double>(m) : 1.0;
+                    ead_k[i] = ead[at] * left;
+                }
+
+                // Expected loss of the period, summed per entity
+                for (size_t i = 0; i < count; ++i) {
+                    const size_t at = first + i;
+                    const size_t row = (entity[at] - shard.first_entity) * periods + k;
+                    const double performing = survival[i] * ead_k[i];
+                    shard.exposure[row] += performing;
+                    shard.ecl[row] += performing * pd[i] * lgd[at] * lgd_scale[segment[at] * periods + k];
+                    survival[i] *= 1.0 - pd[i];
+                }
+            }
+        }
+    };
+    if (pool_) {
+        pool_->parallel_for(shard_count, run);
+    } else {
+        run(0, shard_count, 0);
+    }
+
+    // Shard sums in shard order: the same totals for any thread count
+    for (const Shard& shard : shards) {
+        const size_t offset = static_cast<size_t>(shard.first_entity) * periods;
+        for (size_t j = 0; j < shard.ecl.size(); ++j) {
+            losses.ecl[offset + j] += shard.ecl[j];
+            losses.exposure[offset + j] += shard.exposure[j];
+        }
+    }
+    return losses;
+}
+
+int CreditRiskEngine::process_scenario(database::IDatabase& db, ScenarioID scenario_id,
+                                       const std::vector<PeriodID>& period_ids) {
+    const CreditLosses losses = calculate(load_factors(db, scenario_id, period_ids));
+
+    std::vector<ParamMap> rows;
+    rows.reserve(losses.entities.size() * period_ids.size() * 2);
+    for (size_t e = 0; e < losses.entities.size(); ++e) {
+        for (size_t k = 0; k < period_ids.size(); ++k) {
+            for (const auto& [code, value] : {std::pair{&options_.loss_driver, losses.ecl_of(e, k)},
+                                              std::pair{&options_.exposure_driver, losses.exposure_of(e, k)}}) {
+                rows.push_back({{"entity_id", losses.entities[e]},
+                                {"sid", scenario_id},
+                                {"period_id", period_ids[k]},
+                                {"code", *code},
+                                {"value", value},
+                                {"unit_code", options_.unit_code}});
+            }
+        }
+    }
+
+    // Replace the scenario's credit drivers atomically
+    const bool own_transaction = !db.in_transaction();
+    if (own_transaction) {
+        db.begin_transaction();
+    }
+    try {
+        for (PeriodID period_id : period_ids) {
+            db.execute_update(
+                "DELETE FROM scenario_drivers WHERE scenario_id = :sid AND period_id = :period_id "
+                "AND driver_code IN (:loss, :exposure)",
+                {{"sid", scenario_id}, {"period_id", period_id},
+                 {"loss", options_.loss_driver}, {"exposure", options_.exposure_driver}});
+        }
+        db.execute_batch(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES (:entity_id, :sid, :period_id, :code, :value, :unit_code)",
+            rows);
+    } catch (...) {
+        if (own_transaction) {
+            db.rollback();
+        }
+        throw;
+    }
+    if (own_transaction) {
+        db.commit();
+    }
+    return static_cast<int>(rows.size());
+}
+
+} // namespace credit
+} // namespace finmodel
@@ -0,0 +1,90 @@
+#include "database/async_database.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace database {
+
+AsyncDatabase::AsyncDatabase(ConnectionFactory connect, size_t executors)
+    : connect_(std::move(connect)) {
+    if (!connect_) {
+        throw std::invalid_argument("AsyncDatabase: null connection factory");
+    }
+    const size_t count = std::max<size_t>(1, executors);
+    threads_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        threads_.emplace_back([this] { executor_loop(); });
+    }
+}
+
+AsyncDatabase::~AsyncDatabase() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+AsyncResult<int> AsyncDatabase::update(std::string sql, ParamMap params) {
+    return run([sql = std::move(sql), params = std::move(params)](IDatabase& db) {
+        return db.execute_update(sql, params);
+    });
+}
+
+AsyncResult<int> AsyncDatabase::batch(std::string sql, std::vector<ParamMap> rows) {
+    return run([sql = std::move(sql), rows = std::move(rows)](IDatabase& db) {
+        return db.execute_batch(sql, rows);
+    });
+}
+
+size_t AsyncDatabase::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + running_;
+}
+
+void AsyncDatabase::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(job));
+    }
+    work_ready_.notify_one();
+}
+
+void AsyncDatabase::executor_loop() {
+    std::shared_ptr<IDatabase> db;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;  // Stopping with nothing left to run
+        }
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        ++running_;
+        lock.unlock();
+
+        // Opened on the first operation; a failed open is retried by the next one
+        std::exception_ptr connect_error;
+        if (!db) {
+            try {
+                db = connect_();
+                if (!db) {
+                    throw DatabaseException("AsyncDatabase: connection factory returned null");
+                }
+            } catch (...) {
+                connect_error = std::current_exception();
+            }
+        }
+        job(db.get(), connect_error);
+        job = nullptr;   // Release captures before taking the lock
+
+        lock.lock();
+        --running_;
+    }
+}
+
+} // namespace database
+} // namespace finmodel
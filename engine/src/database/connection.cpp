@@ -6,7 +6,6 @@
 #include "database/connection.h"
 #include "database/database_factory.h"
 #include "database/result_set.h"
-#include <regex>
 #include <sstream>
 
 namespace finmodel {
@@ -62,61 +61,48 @@ void DatabaseConnection::rollback() {
 
 PreparedStatement::PreparedStatement(std::shared_ptr<IDatabase> db, const std::string& sql)
     : db_(db)
-    , sql_(sql)
     , param_count_(0)
     , executed_(false)
     , has_row_(false)
 {
-    // Count ? placeholders
+    // Replace ? with :p0, :p1, etc.
+    sql_.reserve(sql.size());
     for (char c : sql) {
-        if (c == '?') param_count_++;
+        if (c != '?') {
+            sql_ += c;
+            continue;
+        }
+        param_names_.push_back("p" + std::to_string(param_count_++));
+        sql_ += ':';
+        sql_ += param_names_.back();
+        params_[param_names_.back()] = nullptr;
     }
-
-    // Initialize params vector
-    params_.resize(param_count_, nullptr);
 }
 
 void PreparedStatement::bind(int index, int value) {
     if (index < 1 || index > param_count_) {
         throw std::runtime_error("Parameter index out of range");
     }
-    params_[index - 1] = value;
+    params_[param_names_[index - 1]] = value;
 }
 
 void PreparedStatement::bind(int index, double value) {
     if (index < 1 || index > param_count_) {
         throw std::runtime_error("Parameter index out of range");
     }
-    params_[index - 1] = value;
+    params_[param_names_[index - 1]] = value;
 }
 
 void PreparedStatement::bind(int index, const std::string& value) {
     if (index < 1 || index > param_count_) {
         throw std::runtime_error("Parameter index out of range");
     }
-    params_[index - 1] = value;
+    params_[param_names_[index - 1]] = value;
 }
 
 bool PreparedStatement::step() {
     if (!executed_) {
-        // Build ParamMap from positional params
-        ParamMap param_map;
-        for (size_t i = 0; i < params_.size(); ++i) {
-            param_map["p" + std::to_string(i)] = params_[i];
-        }
-
-        // Replace ? with :p0, :p1, etc.
-        std::string converted_sql = sql_;
-        int param_idx = 0;
-        size_t pos = 0;
-        while ((pos = converted_sql.find('?', pos)) != std::string::npos) {
-            converted_sql.replace(pos, 1, ":p" + std::to_string(param_idx));
-            param_idx++;
-            pos += 3;
-        }
-
-        // Execute query
-        result_ = db_->execute_query(converted_sql, param_map);
+        result_ = db_->execute_query(sql_, params_);
         executed_ = true;
     }
 
@@ -0,0 +1,481 @@
+/**
+ * @file csv_importer.cpp
+ * @brief Memory-mapped, chunk-parallel CSV loader for staging tables
+ */
+
+#include "database/csv_importer.h"
+#include "database/sqlite_database.h"
+#include "core/thread_pool.h"
+#include "core/unit_converter.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace finmodel {
+namespace database {
+
+namespace {
+
+constexpr uint64_t LOW_BITS = 0x0101010101010101ULL;
+constexpr uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+/// High bit of every zero byte of a word (exact up to its lowest zero byte)
+inline uint64_t zero_bytes(uint64_t word) {
+    return (word - LOW_BITS) & ~word & HIGH_BITS;
+}
+
+/// First delimiter or line end in [p, end) (end if none), eight bytes per step
+const char* find_cell_end(const char* p, const char* end, char delimiter) {
+    if constexpr (std::endian::native == std::endian::little) {
+        const uint64_t delimiters = LOW_BITS * static_cast<uint8_t>(delimiter);
+        const uint64_t newlines = LOW_BITS * static_cast<uint8_t>('\n');
+        const uint64_t returns = LOW_BITS * static_cast<uint8_t>('\r');
+        while (end - p >= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            const uint64_t hits = zero_bytes(word ^ delimiters) | zero_bytes(word ^ newlines) |
+                                  zero_bytes(word ^ returns);
+            if (hits) {
+                return p + (std::countr_zero(hits) >> 3);
+            }
+            p += 8;
+        }
+    }
+    while (p < end && *p != delimiter && *p != '\n' && *p != '\r') {
+        ++p;
+    }
+    return p;
+}
+
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * Cells of the record at p into cells[0, count), p moved past its line end.
+ * False at the end of the text; empty lines are skipped.
+ */
+bool next_record(const char*& p, const char* end, const CsvImportOptions& options,
+                 std::vector<std::string>& cells, size_t& count) {
+    const char delimiter = options.delimiter;
+    for (;;) {
+        while (p < end && (*p == '\n' || *p == '\r')) {
+            ++p;
+        }
+        if (p >= end) {
+            return false;
+        }
+
+        count = 0;
+        bool quoted_cell = false;
+        for (;;) {
+            if (cells.size() <= count) {
+                cells.emplace_back();
+            }
+            std::string& cell = cells[count++];
+            cell.clear();
+            if (options.trim) {
+                while (p < end && is_blank(*p) && *p != delimiter) {
+                    ++p;
+                }
+            }
+
+            if (p < end && *p == '"') {
+                quoted_cell = true;
+                ++p;
+                for (;;) {
+                    const auto* quote = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+                    if (!quote) {
+                        cell.append(p, end);   // Unterminated: the rest of the text
+                        p = end;
+                        break;
+                    }
+                    cell.append(p, quote);
+                    p = quote + 1;
+                    if (p < end && *p == '"') {
+                        cell.push_back('"');
+                        ++p;
+                        continue;
+                    }
+                    break;
+                }
+                p = find_cell_end(p, end, delimiter);   // Ignores anything after the closing quote
+            } else {
+                const char* stop = find_cell_end(p, end, delimiter);
+                const char* last = stop;
+                if (options.trim) {
+                    while (last > p && is_blank(last[-1])) {
+                        --last;
+                    }
+                }
+                cell.assign(p, last);
+                p = stop;
+            }
+
+            if (p < end && *p == delimiter) {
+                ++p;
+                continue;
+            }
+            if (p < end && *p == '\r') {
+                ++p;
+            }
+            if (p < end && *p == '\n') {
+                ++p;
+            }
+            break;
+        }
+
+        // A line of blanks only is empty too
+        if (count > 1 || quoted_cell || !cells[0].empty()) {
+            return true;
+        }
+    }
+}
+
+/// Where next_record() is within a line, as far as quoting goes
+enum class ScanState : uint8_t {
+    CELL_START,   ///< Before a cell's first byte (a quote here opens a quoted cell)
+    UNQUOTED,     ///< In an unquoted cell, or after a quoted cell's closing quote
+    QUOTED,       ///< In a quoted cell: line ends are part of the cell
+    QUOTE,        ///< Just after a quote in a quoted cell: closing, or the first of ""
+};
+constexpr size_t SCAN_STATES = 4;
+
+/// State after next_record() reads c in state; outside QUOTED a line end ends the record
+ScanState scan_step(ScanState state, char c, const CsvImportOptions& options) {
+    switch (state) {
+        case ScanState::QUOTED:
+            return c == '"' ? ScanState::QUOTE : ScanState::QUOTED;
+        case ScanState::QUOTE:
+            if (c == '"') {
+                return ScanState::QUOTED;
+            }
+            break;
+        case ScanState::CELL_START:
+            if (c == '"') {
+                return ScanState::QUOTED;
+            }
+            if (options.trim && is_blank(c) && c != options.delimiter) {
+                return ScanState::CELL_START;
+            }
+            break;
+        case ScanState::UNQUOTED:
+            break;
+    }
+    if (c == options.delimiter || c == '\n' || c == '\r') {
+        return ScanState::CELL_START;
+    }
+    return ScanState::UNQUOTED;   // Quotes in an unquoted cell are literal
+}
+
+std::string_view without_bom(std::string_view text) {
+    if (text.size() >= 3 && text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        text.remove_prefix(3);   // UTF-8 byte order mark
+    }
+    return text;
+}
+
+std::string quote_identifier(const std::string& name) {
+    std::string quoted = "\"";
+    for (char c : name) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+/// Records of one chunk as insert parameters
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::vector<ParamMap> rows;
+    std::optional<std::pair<size_t, std::string>> error;   // (record in the chunk, message)
+};
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("MappedFile: cannot open " + path);
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: cannot read " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("MappedFile: cannot map " + path);
+        }
+        ::madvise(map, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(map);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::vector<std::vector<std::string>> CsvImporter::parse(std::string_view text, const CsvImportOptions& options) {
+    std::vector<std::vector<std::string>> records;
+    text = without_bom(text);
+    const char* p = text.data();
+    const char* end = p + text.size();
+    std::vector<std::string> cells;
+    size_t count = 0;
+    size_t width = 0;
+    while (next_record(p, end, options, cells, count)) {
+        width = records.empty() ? count : width;
+        std::vector<std::string> record(cells.begin(), cells.begin() + static_cast<std::ptrdiff_t>(count));
+        if (record.size() < width) {
+            record.resize(width);
+        }
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+CsvImportResult CsvImporter::import_file(IDatabase& db, const std::string& path, const std::string& table,
+                                         const CsvImportOptions& options) {
+    const MappedFile file(path);
+    return import_text(db, file.data(), table, options);
+}
+
+CsvImportResult CsvImporter::import_text(IDatabase& db, std::string_view text, const std::string& table,
+                                         const CsvImportOptions& options) {
+    text = without_bom(text);
+    const char* data = text.data();
+    const char* data_end = data + text.size();
+
+    CsvImportResult result;
+    result.table = table;
+    std::vector<std::string> cells;
+    size_t width = 0;
+    const char* body = data;
+    if (!next_record(body, data_end, options, cells, width)) {
+        throw std::runtime_error("CsvImporter: " + table + ": no header");
+    }
+    result.columns.assign(cells.begin(), cells.begin() + static_cast<std::ptrdiff_t>(width));
+    for (size_t c = 0; c < width; ++c) {
+        const auto& name = result.columns[c];
+        if (name.empty()) {
+            throw std::runtime_error("CsvImporter: " + table + ": column " + std::to_string(c + 1) + " has no name");
+        }
+        if (std::find(result.columns.begin(), result.columns.begin() + static_cast<std::ptrdiff_t>(c), name) !=
+            result.columns.begin() + static_cast<std::ptrdiff_t>(c)) {
+            throw std::runtime_error("CsvImporter: " + table + ": duplicate column " + name);
+        }
+    }
+
+    // Numeric columns and their base unit factors (NaN: text)
+    std::vector<double> factors(width, std::numeric_limits<double>::quiet_NaN());
+    for (const auto& [column, unit] : options.numeric_columns) {
+        auto it = std::find(result.columns.begin(), result.columns.end(), column);
+        if (it == result.columns.end()) {
+            throw std::invalid_argument("CsvImporter: " + table + " has no column " + column);
+        }
+        double factor = 1.0;
+        if (!unit.empty() && options.units) {
+            if (options.units->is_time_varying(unit)) {
+                throw std::invalid_argument("CsvImporter: unit " + unit + " of " + column +
+                                            " varies by period");
+            }
+            factor = options.units->to_base_unit(1.0, unit);
+        }
+        factors[static_cast<size_t>(it - result.columns.begin())] = factor;
+    }
+
+    // Chunks of the body, each starting at the first record after its byte
+    // offset, found by following next_record()'s quoting from that offset
+    const size_t body_size = static_cast<size_t>(data_end - body);
+    const size_t chunk_bytes = std::max<size_t>(options.chunk_bytes, 1);
+    const size_t chunk_count = std::max<size_t>((body_size + chunk_bytes - 1) / chunk_bytes, 1);
+    auto run = [&](size_t count, auto&& fn) {
+        auto range = [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                fn(i);
+            }
+        };
+        if (options.pool) {
+            options.pool->parallel_for(count, range);
+        } else {
+            range(0, count, 0);
+        }
+    };
+    auto offset = [&](size_t c) { return body + std::min(c * chunk_bytes, body_size); };
+
+    // Every chunk is scanned from each state it may start in; chaining the
+    // exit states gives the state next_record() is in at each offset
+    std::vector<std::array<ScanState, SCAN_STATES>> exits(chunk_count);
+    run(chunk_count, [&](size_t c) {
+        std::array<ScanState, SCAN_STATES> states = {
+            ScanState::CELL_START, ScanState::UNQUOTED, ScanState::QUOTED, ScanState::QUOTE};
+        const char* p = offset(c);
+        const char* stop = offset(c + 1);
+        auto converged = [&] {
+            return std::all_of(states.begin() + 1, states.end(), [&](ScanState s) { return s == states[0]; });
+        };
+        for (; p < stop && !converged(); ++p) {
+            for (auto& state : states) {
+                state = scan_step(state, *p, options);
+            }
+        }
+        if (p < stop) {   // The states agree from here on
+            for (; p < stop; ++p) {
+                states[0] = scan_step(states[0], *p, options);
+            }
+            states.fill(states[0]);
+        }
+        exits[c] = states;
+    });
+    std::vector<Chunk> chunks(chunk_count);
+    std::vector<ScanState> entry(chunk_count, ScanState::CELL_START);
+    for (size_t c = 1; c < chunk_count; ++c) {
+        entry[c] = exits[c - 1][static_cast<size_t>(entry[c - 1])];
+    }
+    run(chunk_count, [&](size_t c) {
+        const char* p = offset(c);
+        if (c > 0) {
+            ScanState state = entry[c];
+            while (p < data_end) {
+                const bool record_end = state != ScanState::QUOTED && (*p == '\n' || *p == '\r');
+                state = scan_step(state, *p++, options);
+                if (record_end) {
+                    break;
+                }
+            }
+        }
+        chunks[c].begin = p;
+        if (c > 0) {
+            chunks[c - 1].end = p;   // Written once per boundary, read after run()
+        }
+    });
+    chunks.back().end = data_end;
+    result.chunks = chunk_count;
+
+    std::vector<std::string> names(width);
+    std::string insert = "INSERT INTO " + quote_identifier(table) + " (";
+    std::string values;
+    for (size_t c = 0; c < width; ++c) {
+        names[c] = "c" + std::to_string(c);
+        insert += (c ? ", " : "") + quote_identifier(result.columns[c]);
+        values += (c ? ", :" : ":") + names[c];
+    }
+    insert += ") VALUES (" + values + ")";
+
+    auto parse_chunk = [&](Chunk& chunk) {
+        std::vector<std::string> row_cells(width);
+        size_t count = 0;
+        const char* p = chunk.begin;
+        while (!chunk.error && p < chunk.end && next_record(p, chunk.end, options, row_cells, count)) {
+            if (count > width) {
+                chunk.error.emplace(chunk.rows.size(), "has " + std::to_string(count) + " cells, the header " +
+                                                       std::to_string(width));
+                break;
+            }
+            ParamMap row;
+            for (size_t c = 0; c < width; ++c) {
+                std::string& cell = row_cells[c];
+                if (c >= count) {
+                    cell.clear();
+                }
+                if (std::isnan(factors[c])) {
+                    row.emplace(names[c], std::move(cell));
+                    continue;
+                }
+                if (cell.empty()) {
+                    row.emplace(names[c], nullptr);
+                    continue;
+                }
+                const char* first = cell.data() + (cell[0] == '+' ? 1 : 0);
+                double value = 0.0;
+                auto [last, ec] = std::from_chars(first, cell.data() + cell.size(), value);
+                if (ec != std::errc() || last != cell.data() + cell.size()) {
+                    chunk.error.emplace(chunk.rows.size(), result.columns[c] + " '" + cell + "' is not a number");
+                    break;
+                }
+                row.emplace(names[c], value * factors[c]);
+            }
+            if (!chunk.error) {
+                chunk.rows.push_back(std::move(row));
+            }
+        }
+    };
+
+    const bool own_transaction = !db.in_transaction();
+    // Indexes of an appended-to table are rebuilt once (a replaced one loses them with the table)
+    std::optional<BulkLoadSession> bulk;
+    if (auto* sqlite = dynamic_cast<SQLiteDatabase*>(&db); sqlite && own_transaction) {
+        BulkLoadOptions bulk_options;
+        bulk_options.tables = {table};
+        bulk_options.drop_indexes = !options.replace;
+        bulk.emplace(*sqlite, bulk_options);
+    }
+    if (own_transaction) {
+        db.begin_transaction();
+    }
+    try {
+        if (options.replace) {
+            db.execute_update("DROP TABLE IF EXISTS " + quote_identifier(table), {});
+        }
+        std::string create = "CREATE TABLE IF NOT EXISTS " + quote_identifier(table) +
+                             " (_rowid INTEGER PRIMARY KEY AUTOINCREMENT";
+        for (size_t c = 0; c < width; ++c) {
+            create += ", " + quote_identifier(result.columns[c]) + (std::isnan(factors[c]) ? " TEXT" : " REAL");
+        }
+        create += ", imported_at DATETIME DEFAULT CURRENT_TIMESTAMP, is_mapped INTEGER DEFAULT 0)";
+        db.execute_update(create, {});
+
+        // Waves of chunks: parsed in parallel, inserted in order, then freed
+        const size_t wave = std::max<size_t>(options.pool ? options.pool->size() * 2 : 1, 1);
+        for (size_t first = 0; first < chunk_count; first += wave) {
+            const size_t last = std::min(first + wave, chunk_count);
+            run(last - first, [&](size_t i) { parse_chunk(chunks[first + i]); });
+            for (size_t c = first; c < last; ++c) {
+                if (chunks[c].error) {
+                    throw std::runtime_error("CsvImporter: " + table + ": record " +
+                                             std::to_string(result.rows + chunks[c].error->first + 1) + " " +
+                                             chunks[c].error->second);
+                }
+                db.execute_batch(insert, chunks[c].rows);
+                result.rows += chunks[c].rows.size();
+                std::vector<ParamMap>().swap(chunks[c].rows);
+            }
+        }
+        if (own_transaction) {
+            db.commit();
+        }
+    } catch (...) {
+        if (own_transaction) {
+            db.rollback();
+        }
+        throw;
+    }
+    if (bulk) {
+        bulk->finish();
+    }
+    return result;
+}
+
+} // namespace database
+} // namespace finmodel
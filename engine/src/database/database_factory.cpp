@@ -1,7 +1,9 @@
 #include "database/database_factory.h"
+#include "database/postgresql_database.h"
 #include "database/sqlite_database.h"
 #include <stdexcept>
 #include <algorithm>
+#include <sstream>
 
 namespace finmodel {
 namespace database {
@@ -13,16 +15,28 @@ std::shared_ptr<IDatabase> DatabaseFactory::create(const DatabaseConfig& config)
                    [](unsigned char c){ return std::tolower(c); });
 
     if (type_lower == "sqlite" || type_lower == "sqlite3") {
+        auto option = [&config](const std::string& name) {
+            auto it = config.options.find(name);
+            return it != config.options.end() ? it->second : std::string();
+        };
+        if (option("working_copy") == "1" || option("working_copy") == "true") {
+            WorkingCopyOptions copy;
+            std::stringstream tables(option("write_back"));
+            for (std::string table; std::getline(tables, table, ',');) {
+                if (!table.empty()) {
+                    copy.write_back.push_back(table);
+                }
+            }
+            copy.target = option("target");
+            copy.shared_name = option("shared_name");
+            return create_working_copy(config.connection_string, copy);
+        }
         auto db = std::make_shared<SQLiteDatabase>();
         db->connect(config.connection_string);
         return db;
     }
     else if (type_lower == "postgresql" || type_lower == "postgres") {
-        // Future implementation (M6+)
-        throw DatabaseException(
-            "PostgreSQL support not yet implemented. "
-            "Use SQLite for now, or implement PostgreSQLDatabase class."
-        );
+        return create_postgresql(config.connection_string);
     }
     else if (type_lower == "mysql") {
         // Future implementation (M6+)
@@ -34,7 +48,7 @@ std::shared_ptr<IDatabase> DatabaseFactory::create(const DatabaseConfig& config)
     else {
         throw DatabaseException(
             "Unknown database type: '" + config.type + "'. "
-            "Supported types: sqlite, postgresql (future), mysql (future)"
+            "Supported types: sqlite, postgresql, mysql (future)"
         );
     }
 }
@@ -45,5 +59,75 @@ std::shared_ptr<IDatabase> DatabaseFactory::create_sqlite(const std::string& con
     return db;
 }
 
+std::shared_ptr<IDatabase> DatabaseFactory::create_postgresql(const std::string& connection_string) {
+#if FINMODEL_POSTGRESQL
+    auto db = std::make_shared<PostgreSQLDatabase>();
+    db->connect(connection_string);
+    return db;
+#else
+    (void)connection_string;
+    throw DatabaseException("PostgreSQL support not built: configure with -DFINMODEL_POSTGRESQL=ON");
+#endif
+}
+
+bool DatabaseFactory::is_postgresql(const std::string& connection_string) {
+    return connection_string.rfind("postgresql://", 0) == 0 || connection_string.rfind("postgres://", 0) == 0;
+}
+
+std::shared_ptr<IDatabase> DatabaseFactory::create_working_copy(const std::string& source_path,
+                                                               const WorkingCopyOptions& options) {
+    auto db = std::make_shared<SQLiteDatabase>();
+    db->connect_working_copy(source_path, options.uri(), options.write_back,
+                             options.target.empty() ? source_path : options.target);
+    return db;
+}
+
+ConnectionPool::ConnectionPool(const std::string& connection_string)
+    : connection_string_(connection_string)
+    , in_memory_(connection_string.empty() || connection_string == ":memory:" ||
+                 connection_string.find("mode=memory") != std::string::npos)
+    , writer_(DatabaseFactory::is_postgresql(connection_string) ? DatabaseFactory::create_postgresql(connection_string)
+                                                                 : DatabaseFactory::create_sqlite(connection_string))
+{
+}
+
+std::shared_ptr<IDatabase> ConnectionPool::reader() {
+    if (in_memory_) {
+        return writer_;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = readers_.find(std::this_thread::get_id());
+    if (found != readers_.end()) {
+        return found->second;
+    }
+    std::shared_ptr<IDatabase> db;
+    if (DatabaseFactory::is_postgresql(connection_string_)) {
+#if FINMODEL_POSTGRESQL
+        auto postgresql = std::make_shared<PostgreSQLDatabase>();
+        postgresql->connect_read_only(connection_string_);
+        db = postgresql;
+#else
+        db = DatabaseFactory::create_postgresql(connection_string_);  // Throws
+#endif
+    } else {
+        auto sqlite = std::make_shared<SQLiteDatabase>();
+        sqlite->connect_read_only(connection_string_);
+        db = sqlite;
+    }
+    readers_.emplace(std::this_thread::get_id(), db);
+    return db;
+}
+
+size_t ConnectionPool::reader_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return readers_.size();
+}
+
+void ConnectionPool::close_readers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    readers_.clear();
+}
+
 } // namespace database
 } // namespace finmodel
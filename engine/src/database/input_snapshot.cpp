@@ -0,0 +1,189 @@
+#include "database/input_snapshot.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include "database/sqlite_database.h"
+#include <cstdio>
+
+namespace finmodel {
+namespace database {
+
+namespace {
+
+/**
+ * @brief "file:" URI of a path opened immutable (no locking, no change detection)
+ */
+std::string immutable_uri(const std::string& path) {
+    std::string uri = "file:";
+    for (char c : path) {
+        switch (c) {
+            case '%': uri += "%25"; break;
+            case '?': uri += "%3f"; break;
+            case '#': uri += "%23"; break;
+            default: uri += c;
+        }
+    }
+    return uri + "?immutable=1";
+}
+
+std::string json_array(const std::vector<ScenarioID>& ids) {
+    std::string json = "[";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        json += (i ? "," : "") + std::to_string(ids[i]);
+    }
+    return json + "]";
+}
+
+} // namespace
+
+const std::vector<std::string>& InputSnapshot::input_tables() {
+    static const std::vector<std::string> tables = {
+        "entity", "period", "driver", "statement_template", "scenario",
+        "funding_policy", "capex_policy", "wc_policy", "tax_strategies",
+        "scenario_drivers", "scenario_driver_pack", "scenario_action", "management_action",
+        "validation_rule", "template_validation_rule",
+        "unit_definition", "fx_rate", "balance_sheet_actuals",
+        "asset_exposure", "physical_peril", "physical_peril_pathway",
+        "damage_function_definition", "spatial_index_point"
+    };
+    return tables;
+}
+
+InputSnapshotInfo InputSnapshot::compile(const std::string& source_path,
+                                         const std::string& snapshot_path,
+                                         const std::vector<ScenarioID>& scenario_ids) {
+    std::remove(snapshot_path.c_str());
+    std::remove((snapshot_path + "-wal").c_str());
+    std::remove((snapshot_path + "-shm").c_str());
+
+    InputSnapshotInfo info;
+    info.path = snapshot_path;
+    info.format_version = FORMAT_VERSION;
+
+    {
+        auto db = DatabaseFactory::create_sqlite(snapshot_path);
+        // Rollback journal: immutable readers must not need a -wal file.
+        // Parents of filtered rows may be missing, so no FK checks.
+        db->execute_raw("PRAGMA journal_mode = DELETE; PRAGMA foreign_keys = OFF;");
+        db->execute_update("ATTACH DATABASE :path AS src", {{"path", source_path}});
+
+        // Requested scenarios and the parents they inherit drivers from
+        std::string scenarios;
+        if (!scenario_ids.empty()) {
+            info.scenario_ids = scenario_ids;
+            try {
+                auto chain = db->execute_query(
+                    "WITH RECURSIVE chain(id) AS ("
+                    "  SELECT value FROM json_each(:ids)"
+                    "  UNION"
+                    "  SELECT s.parent_scenario_id FROM src.scenario s JOIN chain ON s.scenario_id = chain.id"
+                    "  WHERE s.parent_scenario_id IS NOT NULL"
+                    ") SELECT id FROM chain ORDER BY id",
+                    {{"ids", json_array(scenario_ids)}});
+                info.scenario_ids.clear();
+                for (auto [id] : chain->rows<int>()) {
+                    info.scenario_ids.push_back(id);
+                }
+            } catch (const DatabaseException&) {
+                // No scenario table: no inheritance
+            }
+            scenarios = json_array(info.scenario_ids);
+        }
+
+        db->begin_transaction();
+        try {
+            for (const auto& table : input_tables()) {
+                auto definition = db->execute_query(
+                    "SELECT sql FROM src.sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+                if (!definition->next()) {
+                    continue;  // The source doesn't have this input
+                }
+                db->execute_raw(definition->get_string(0));
+                definition.reset();
+
+                std::string copy = "INSERT INTO main." + table + " SELECT * FROM src." + table;
+                ParamMap params;
+                if (!scenarios.empty()) {
+                    auto column = db->execute_query(
+                        "SELECT 1 FROM pragma_table_info(:name, 'src') WHERE name = 'scenario_id'",
+                        {{"name", table}});
+                    if (column->next()) {
+                        copy += " WHERE scenario_id IS NULL OR scenario_id IN (SELECT value FROM json_each(:ids))";
+                        params["ids"] = scenarios;
+                    }
+                }
+                info.rows += db->execute_update(copy, params);
+                info.tables.push_back(table);
+
+                auto indexes = db->execute_query(
+                    "SELECT sql FROM src.sqlite_master WHERE type = 'index' AND tbl_name = :name AND sql IS NOT NULL",
+                    {{"name", table}});
+                std::vector<std::string> index_sql;
+                for (auto [sql] : indexes->rows<std::string>()) {
+                    index_sql.push_back(std::move(sql));
+                }
+                indexes.reset();
+                for (const auto& sql : index_sql) {
+                    db->execute_raw(sql);
+                }
+            }
+
+            auto views = db->execute_query("SELECT sql FROM src.sqlite_master WHERE type = 'view'", {});
+            std::vector<std::string> view_sql;
+            for (auto [sql] : views->rows<std::string>()) {
+                view_sql.push_back(std::move(sql));
+            }
+            views.reset();
+            for (const auto& sql : view_sql) {
+                try {
+                    db->execute_raw(sql);
+                } catch (const DatabaseException&) {
+                    // Reads a table that isn't an input
+                }
+            }
+
+            db->execute_raw("CREATE TABLE snapshot_info (key TEXT PRIMARY KEY, value TEXT NOT NULL)");
+            db->execute_update(
+                "INSERT INTO snapshot_info (key, value) VALUES "
+                "('format_version', :version), ('created_at', datetime('now')), "
+                "('source', :source), ('scenarios', :scenarios)",
+                {
+                    {"version", std::to_string(FORMAT_VERSION)},
+                    {"source", source_path},
+                    {"scenarios", scenarios.empty() ? std::string("all") : scenarios}
+                });
+            db->commit();
+        } catch (...) {
+            db->rollback();
+            throw;
+        }
+
+        db->execute_raw("DETACH DATABASE src");
+    }
+
+    return info;
+}
+
+std::shared_ptr<IDatabase> InputSnapshot::open(const std::string& snapshot_path) {
+    auto db = std::make_shared<SQLiteDatabase>();
+    db->connect_read_only(immutable_uri(snapshot_path));
+    db->execute_raw("PRAGMA mmap_size = " + std::to_string(MMAP_BYTES));
+
+    std::string version;
+    try {
+        auto result = db->execute_query(
+            "SELECT value FROM snapshot_info WHERE key = 'format_version'", {});
+        if (result->next()) {
+            version = result->get_string(0);
+        }
+    } catch (const DatabaseException&) {
+        // Not a snapshot
+    }
+    if (version != std::to_string(FORMAT_VERSION)) {
+        throw DatabaseException("Not an input snapshot of format version " +
+                                std::to_string(FORMAT_VERSION) + ": " + snapshot_path);
+    }
+    return db;
+}
+
+} // namespace database
+} // namespace finmodel
@@ -0,0 +1,871 @@
+#include "database/postgresql_database.h"
+#include "core/engine_metrics.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+#include <stdexcept>
+#include <utility>
+
+#if FINMODEL_POSTGRESQL
+#include <libpq-fe.h>
+#endif
+
+namespace finmodel {
+namespace database {
+
+// ========== Statement translation (no libpq needed) ==========
+
+namespace {
+
+bool is_name_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+std::string trim(const std::string& text) {
+    const auto first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    size_t begin = 0;
+    while (true) {
+        const size_t comma = list.find(',', begin);
+        items.push_back(trim(list.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin)));
+        if (comma == std::string::npos) {
+            return items;
+        }
+        begin = comma + 1;
+    }
+}
+
+} // namespace
+
+PositionalSql PostgreSQLDatabase::to_positional(const std::string& sql) {
+    PositionalSql out;
+    out.sql.reserve(sql.size());
+    std::map<std::string, size_t> numbers;
+
+    size_t i = 0;
+    auto copy_until = [&](const std::string& end) {
+        const size_t found = sql.find(end, i);
+        const size_t stop = (found == std::string::npos) ? sql.size() : found + end.size();
+        out.sql.append(sql, i, stop - i);
+        i = stop;
+    };
+
+    while (i < sql.size()) {
+        const char c = sql[i];
+        const char next = (i + 1 < sql.size()) ? sql[i + 1] : '\0';
+        if (c == '\'' || c == '"') {
+            // Quoted text or identifier; a doubled quote continues it
+            size_t end = i + 1;
+            while (end < sql.size()) {
+                if (sql[end] == c) {
+                    if (end + 1 < sql.size() && sql[end + 1] == c) {
+                        end += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++end;
+            }
+            const size_t stop = std::min(end + 1, sql.size());
+            out.sql.append(sql, i, stop - i);
+            i = stop;
+        } else if (c == '-' && next == '-') {
+            copy_until("\n");
+        } else if (c == '/' && next == '*') {
+            copy_until("*/");
+        } else if (c == '$' && (next == '$' || is_name_start(next))) {
+            // Dollar quoting: $$...$$ or $tag$...$tag$
+            size_t end = i + 1;
+            while (end < sql.size() && is_name_char(sql[end])) {
+                ++end;
+            }
+            if (end < sql.size() && sql[end] == '$') {
+                const std::string tag = sql.substr(i, end - i + 1);
+                out.sql += tag;
+                i = end + 1;
+                copy_until(tag);
+            } else {
+                out.sql += c;
+                ++i;
+            }
+        } else if (c == ':' && next == ':') {
+            out.sql += "::";  // Cast
+            i += 2;
+        } else if (c == ':' && is_name_start(next)) {
+            size_t end = i + 1;
+            while (end < sql.size() && is_name_char(sql[end])) {
+                ++end;
+            }
+            std::string name = sql.substr(i + 1, end - i - 1);
+            auto [number, added] = numbers.try_emplace(name, numbers.size() + 1);
+            if (added) {
+                out.parameters.push_back(std::move(name));
+            }
+            out.sql += '$';
+            out.sql += std::to_string(number->second);
+            i = end;
+        } else {
+            out.sql += c;
+            ++i;
+        }
+    }
+    return out;
+}
+
+std::optional<CopyTarget> PostgreSQLDatabase::copy_target(const std::string& sql) {
+    static const std::regex insert(
+        R"(^\s*INSERT\s+INTO\s+((?:"[^"]+"|[A-Za-z_][A-Za-z0-9_$]*)(?:\.(?:"[^"]+"|[A-Za-z_][A-Za-z0-9_$]*))?))"
+        R"(\s*\(([^()]*)\)\s*VALUES\s*\(([^()]*)\)\s*;?\s*$)",
+        std::regex::icase | std::regex::ECMAScript);
+    static const std::regex parameter(R"(^:([A-Za-z_][A-Za-z0-9_]*)$)");
+
+    std::smatch match;
+    if (!std::regex_match(sql, match, insert)) {
+        return std::nullopt;
+    }
+    CopyTarget target;
+    target.table = match[1].str();
+    target.columns = split_list(match[2].str());
+    const std::vector<std::string> values = split_list(match[3].str());
+    if (values.size() != target.columns.size()) {
+        return std::nullopt;
+    }
+    for (const std::string& value : values) {
+        std::smatch name;
+        if (!std::regex_match(value, name, parameter)) {
+            return std::nullopt;  // An expression or literal: COPY can't compute it
+        }
+        target.parameters.push_back(name[1].str());
+    }
+    return target;
+}
+
+#if FINMODEL_POSTGRESQL
+
+// ========== PostgreSQLDatabase Implementation ==========
+
+namespace {
+
+// Type OIDs (pg_type.dat) binary COPY encodes
+constexpr unsigned BOOL_OID = 16;
+constexpr unsigned BYTEA_OID = 17;
+constexpr unsigned INT8_OID = 20;
+constexpr unsigned INT2_OID = 21;
+constexpr unsigned INT4_OID = 23;
+constexpr unsigned TEXT_OID = 25;
+constexpr unsigned FLOAT4_OID = 700;
+constexpr unsigned FLOAT8_OID = 701;
+constexpr unsigned BPCHAR_OID = 1042;
+constexpr unsigned VARCHAR_OID = 1043;
+
+bool copy_supported(unsigned oid) {
+    switch (oid) {
+        case BOOL_OID: case BYTEA_OID: case INT8_OID: case INT2_OID: case INT4_OID:
+        case TEXT_OID: case FLOAT4_OID: case FLOAT8_OID: case BPCHAR_OID: case VARCHAR_OID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct ResultDeleter {
+    void operator()(PGresult* result) const { PQclear(result); }
+};
+using ResultPtr = std::unique_ptr<PGresult, ResultDeleter>;
+
+std::string error_text(const char* message) {
+    std::string text = (message && *message) ? message : "Unknown error";
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.pop_back();
+    }
+    return text;
+}
+
+/// A result that means success, or the exception its error message makes
+PGresult* checked(PGresult* result, PGconn* conn, const std::string& sql) {
+    const ExecStatusType status = result ? PQresultStatus(result) : PGRES_FATAL_ERROR;
+    if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK || status == PGRES_COPY_IN) {
+        return result;
+    }
+    const std::string message = error_text(result ? PQresultErrorMessage(result) : PQerrorMessage(conn));
+    PQclear(result);
+    throw DatabaseException(message, sql);
+}
+
+std::string double_text(double value) {
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);  // Shortest round-trip form
+    return std::string(buffer, ec == std::errc() ? end : buffer);
+}
+
+/// Text format value of a parameter (or binary for a Blob)
+struct Bound {
+    std::string text;
+    bool is_null = false;
+    bool binary = false;
+};
+
+Bound bind_text(const ParamValue& value) {
+    Bound bound;
+    std::visit([&bound](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            bound.is_null = true;
+        } else if constexpr (std::is_same_v<T, int>) {
+            bound.text = std::to_string(v);
+        } else if constexpr (std::is_same_v<T, double>) {
+            bound.text = double_text(v);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            bound.text = v;
+        } else {
+            bound.text.assign(reinterpret_cast<const char*>(v.data()), v.size());
+            bound.binary = true;
+        }
+    }, value);
+    return bound;
+}
+
+template <typename T>
+void put_big_endian(std::string& out, T value) {
+    using U = std::make_unsigned_t<T>;
+    U bits = static_cast<U>(value);
+    for (int shift = static_cast<int>(sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+        out += static_cast<char>((bits >> shift) & 0xFF);
+    }
+}
+
+template <typename T>
+T parse_number(const std::string& text, const std::string& column) {
+    T value{};
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        throw DatabaseException("COPY: column " + column + " given '" + text + "'");
+    }
+    return value;
+}
+
+double as_double(const ParamValue& value, const std::string& column) {
+    if (const int* i = std::get_if<int>(&value)) {
+        return *i;
+    }
+    if (const double* d = std::get_if<double>(&value)) {
+        return *d;
+    }
+    if (const std::string* s = std::get_if<std::string>(&value)) {
+        return parse_number<double>(*s, column);
+    }
+    throw DatabaseException("COPY: column " + column + " given a BLOB");
+}
+
+int64_t as_integer(const ParamValue& value, const std::string& column) {
+    if (const int* i = std::get_if<int>(&value)) {
+        return *i;
+    }
+    if (const double* d = std::get_if<double>(&value)) {
+        if (*d != static_cast<double>(static_cast<int64_t>(*d))) {
+            throw DatabaseException("COPY: integer column " + column + " given " + double_text(*d));
+        }
+        return static_cast<int64_t>(*d);
+    }
+    if (const std::string* s = std::get_if<std::string>(&value)) {
+        return parse_number<int64_t>(*s, column);
+    }
+    throw DatabaseException("COPY: column " + column + " given a BLOB");
+}
+
+/// One field of a binary COPY tuple: length, then the value in network byte order
+void put_field(std::string& out, const ParamValue& value, unsigned oid, const std::string& column) {
+    if (std::holds_alternative<std::nullptr_t>(value)) {
+        put_big_endian<int32_t>(out, -1);
+        return;
+    }
+    switch (oid) {
+        case BOOL_OID:
+            put_big_endian<int32_t>(out, 1);
+            out += static_cast<char>(as_double(value, column) != 0.0 ? 1 : 0);
+            return;
+        case INT2_OID:
+            put_big_endian<int32_t>(out, 2);
+            put_big_endian(out, static_cast<int16_t>(as_integer(value, column)));
+            return;
+        case INT4_OID:
+            put_big_endian<int32_t>(out, 4);
+            put_big_endian(out, static_cast<int32_t>(as_integer(value, column)));
+            return;
+        case INT8_OID:
+            put_big_endian<int32_t>(out, 8);
+            put_big_endian(out, as_integer(value, column));
+            return;
+        case FLOAT4_OID: {
+            const float f = static_cast<float>(as_double(value, column));
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            put_big_endian<int32_t>(out, 4);
+            put_big_endian(out, bits);
+            return;
+        }
+        case FLOAT8_OID: {
+            const double d = as_double(value, column);
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            put_big_endian<int32_t>(out, 8);
+            put_big_endian(out, bits);
+            return;
+        }
+        default: {  // text, varchar, char, bytea: the bytes themselves
+            const Bound bound = bind_text(value);
+            if (bound.binary && oid != BYTEA_OID) {
+                throw DatabaseException("COPY: text column " + column + " given a BLOB");
+            }
+            put_big_endian(out, static_cast<int32_t>(bound.text.size()));
+            out += bound.text;
+            return;
+        }
+    }
+}
+
+/// attname of a column as written in SQL (unquoted names fold to lower case)
+std::string column_key(const std::string& column) {
+    if (column.size() >= 2 && column.front() == '"' && column.back() == '"') {
+        return column.substr(1, column.size() - 2);
+    }
+    std::string key = column;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+    return key;
+}
+
+} // namespace
+
+PostgreSQLDatabase::~PostgreSQLDatabase() {
+    disconnect();
+}
+
+void PostgreSQLDatabase::connect(const std::string& connection_string) {
+    open(connection_string);
+}
+
+void PostgreSQLDatabase::connect_read_only(const std::string& connection_string) {
+    open(connection_string);
+    ResultPtr(execute_simple("SET SESSION CHARACTERISTICS AS TRANSACTION READ ONLY"));
+}
+
+void PostgreSQLDatabase::open(const std::string& connection_string) {
+    disconnect();
+    conn_ = PQconnectdb(connection_string.c_str());
+    if (PQstatus(conn_) != CONNECTION_OK) {
+        last_error_ = error_text(PQerrorMessage(conn_));
+        PQfinish(conn_);
+        conn_ = nullptr;
+        throw DatabaseException("Failed to connect to PostgreSQL: " + last_error_);
+    }
+    PQsetNoticeProcessor(conn_, [](void*, const char*) {}, nullptr);  // NOTICEs aren't errors
+}
+
+void PostgreSQLDatabase::disconnect() {
+    if (!conn_) {
+        return;
+    }
+    if (in_transaction_) {
+        PQclear(PQexec(conn_, "ROLLBACK"));
+        in_transaction_ = false;
+    }
+    PQfinish(conn_);
+    conn_ = nullptr;
+    statements_.clear();
+    column_types_.clear();
+}
+
+bool PostgreSQLDatabase::is_connected() const {
+    return conn_ != nullptr && PQstatus(conn_) == CONNECTION_OK;
+}
+
+PGresult* PostgreSQLDatabase::execute_simple(const std::string& sql) {
+    if (!conn_) {
+        throw DatabaseException("Not connected to database");
+    }
+    core::EngineMetrics::DatabaseTimer timer;
+    try {
+        return checked(PQexec(conn_, sql.c_str()), conn_, sql);
+    } catch (const DatabaseException& e) {
+        last_error_ = e.what();
+        throw;
+    }
+}
+
+const PostgreSQLDatabase::Prepared& PostgreSQLDatabase::prepare(const std::string& sql) {
+    auto found = statements_.find(sql);
+    if (found != statements_.end()) {
+        core::EngineMetrics::add(core::EngineMetrics::Counter::STATEMENT_CACHE_HITS);
+        return found->second;
+    }
+    core::EngineMetrics::add(core::EngineMetrics::Counter::STATEMENT_CACHE_MISSES);
+
+    if (statements_.size() >= STATEMENT_CACHE_CAPACITY) {
+        ResultPtr(execute_simple("DEALLOCATE ALL"));
+        statements_.clear();
+    }
+    PositionalSql positional = to_positional(sql);
+    Prepared prepared{sql, "finmodel_" + std::to_string(next_statement_++), std::move(positional.parameters)};
+    {
+        core::EngineMetrics::DatabaseTimer timer;
+        try {
+            ResultPtr(checked(PQprepare(conn_, prepared.name.c_str(), positional.sql.c_str(),
+                                        static_cast<int>(prepared.parameters.size()), nullptr),
+                              conn_, sql));
+        } catch (const DatabaseException& e) {
+            last_error_ = e.what();
+            throw;
+        }
+    }
+    return statements_.emplace(sql, std::move(prepared)).first->second;
+}
+
+PGresult* PostgreSQLDatabase::execute_prepared(const Prepared& statement, const ParamMap& params) {
+    for (const auto& [name, value] : params) {
+        if (std::find(statement.parameters.begin(), statement.parameters.end(), name) ==
+            statement.parameters.end()) {
+            throw DatabaseException("Parameter not found in statement: " + name);
+        }
+    }
+
+    // Parameters the caller didn't bind are NULL, as in SQLite
+    const size_t count = statement.parameters.size();
+    std::vector<Bound> bound(count);
+    std::vector<const char*> values(count, nullptr);
+    std::vector<int> lengths(count, 0);
+    std::vector<int> formats(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        auto value = params.find(statement.parameters[i]);
+        if (value == params.end()) {
+            continue;
+        }
+        bound[i] = bind_text(value->second);
+        if (!bound[i].is_null) {
+            values[i] = bound[i].text.c_str();
+            lengths[i] = static_cast<int>(bound[i].text.size());
+            formats[i] = bound[i].binary ? 1 : 0;
+        }
+    }
+
+    core::EngineMetrics::DatabaseTimer timer;
+    try {
+        return checked(PQexecPrepared(conn_, statement.name.c_str(), static_cast<int>(count), values.data(),
+                                      lengths.data(), formats.data(), 0),
+                       conn_, statement.sql);
+    } catch (const DatabaseException& e) {
+        last_error_ = e.what();
+        throw;
+    }
+}
+
+std::unique_ptr<ResultSet> PostgreSQLDatabase::execute_query(const std::string& sql, const ParamMap& params) {
+    if (!conn_) {
+        throw DatabaseException("Not connected to database");
+    }
+    return std::make_unique<PostgreSQLResultSet>(execute_prepared(prepare(sql), params));
+}
+
+int PostgreSQLDatabase::execute_update(const std::string& sql, const ParamMap& params) {
+    if (!conn_) {
+        throw DatabaseException("Not connected to database");
+    }
+    ResultPtr result(execute_prepared(prepare(sql), params));
+    return std::atoi(PQcmdTuples(result.get()));
+}
+
+int PostgreSQLDatabase::execute_batch(const std::string& sql, std::span<const ParamMap> rows) {
+    if (!conn_) {
+        throw DatabaseException("Not connected to database");
+    }
+    if (rows.empty()) {
+        return 0;
+    }
+
+    const bool own_transaction = !in_transaction_;
+    if (own_transaction) {
+        begin_transaction();
+    }
+    int affected = 0;
+    try {
+        std::optional<int> copied;
+        if (auto target = copy_target(sql)) {
+            copied = copy_rows(*target, rows);
+        }
+        if (copied) {
+            affected = *copied;
+        } else {
+            const Prepared& statement = prepare(sql);
+            for (const auto& params : rows) {
+                ResultPtr result(execute_prepared(statement, params));
+                affected += std::atoi(PQcmdTuples(result.get()));
+            }
+        }
+    } catch (...) {
+        if (own_transaction) {
+            rollback();
+        }
+        throw;
+    }
+    if (own_transaction) {
+        commit();
+    }
+    return affected;
+}
+
+const std::vector<std::pair<std::string, unsigned>>& PostgreSQLDatabase::table_columns(const std::string& table) {
+    auto found = column_types_.find(table);
+    if (found != column_types_.end()) {
+        return found->second;
+    }
+    std::vector<std::pair<std::string, unsigned>> columns;
+    auto result = execute_query(
+        "SELECT attname, atttypid::bigint FROM pg_attribute "
+        "WHERE attrelid = CAST(:table AS regclass) AND attnum > 0 AND NOT attisdropped ORDER BY attnum",
+        {{"table", table}});
+    while (result->next()) {
+        columns.emplace_back(result->get_string(0), static_cast<unsigned>(result->get_int64(1)));
+    }
+    return column_types_.emplace(table, std::move(columns)).first->second;
+}
+
+std::optional<int> PostgreSQLDatabase::copy_rows(const CopyTarget& target, std::span<const ParamMap> rows) {
+    const auto& table = table_columns(target.table);
+    std::vector<unsigned> types;
+    for (const std::string& column : target.columns) {
+        const std::string key = column_key(column);
+        auto found = std::find_if(table.begin(), table.end(), [&key](const auto& c) { return c.first == key; });
+        if (found == table.end() || !copy_supported(found->second)) {
+            return std::nullopt;  // Unknown here, or a type sent as text: let the server convert it row by row
+        }
+        types.push_back(found->second);
+    }
+    for (const auto& row : rows) {
+        for (const auto& [name, value] : row) {
+            if (std::find(target.parameters.begin(), target.parameters.end(), name) == target.parameters.end()) {
+                throw DatabaseException("Parameter not found in statement: " + name);
+            }
+        }
+    }
+
+    std::string columns;
+    for (const std::string& column : target.columns) {
+        columns += (columns.empty() ? "" : ", ") + column;
+    }
+    const std::string copy = "COPY " + target.table + " (" + columns + ") FROM STDIN (FORMAT binary)";
+    ResultPtr(execute_simple(copy));
+
+    constexpr size_t SEND_BYTES = size_t{1} << 20;
+    const ParamValue null_value = nullptr;
+    std::string buffer("PGCOPY\n\377\r\n\0", 11);
+    put_big_endian<int32_t>(buffer, 0);  // Flags
+    put_big_endian<int32_t>(buffer, 0);  // Header extension length
+
+    core::EngineMetrics::DatabaseTimer timer;
+    auto send = [this, &copy](const std::string& data) {
+        if (PQputCopyData(conn_, data.data(), static_cast<int>(data.size())) != 1) {
+            throw DatabaseException(error_text(PQerrorMessage(conn_)), copy);
+        }
+    };
+    try {
+        for (const auto& row : rows) {
+            put_big_endian(buffer, static_cast<int16_t>(target.columns.size()));
+            for (size_t c = 0; c < target.columns.size(); ++c) {
+                auto value = row.find(target.parameters[c]);
+                put_field(buffer, value != row.end() ? value->second : null_value, types[c], target.columns[c]);
+            }
+            if (buffer.size() >= SEND_BYTES) {
+                send(buffer);
+                buffer.clear();
+            }
+        }
+        put_big_endian<int16_t>(buffer, -1);  // Trailer
+        send(buffer);
+    } catch (const DatabaseException& e) {
+        PQputCopyEnd(conn_, e.what());  // Abort: the server discards the rows sent
+        while (PGresult* result = PQgetResult(conn_)) {
+            PQclear(result);
+        }
+        last_error_ = e.what();
+        throw;
+    }
+
+    if (PQputCopyEnd(conn_, nullptr) != 1) {
+        last_error_ = error_text(PQerrorMessage(conn_));
+        throw DatabaseException(last_error_, copy);
+    }
+    int copied = 0;
+    std::string error;
+    while (PGresult* result = PQgetResult(conn_)) {
+        if (PQresultStatus(result) == PGRES_COMMAND_OK) {
+            copied = std::atoi(PQcmdTuples(result));
+        } else if (error.empty()) {
+            error = error_text(PQresultErrorMessage(result));
+        }
+        PQclear(result);
+    }
+    if (!error.empty()) {
+        last_error_ = error;
+        throw DatabaseException(error, copy);
+    }
+    return copied;
+}
+
+void PostgreSQLDatabase::begin_transaction() {
+    if (!is_connected()) {
+        throw DatabaseException("Not connected to database");
+    }
+    if (in_transaction_) {
+        throw DatabaseException("Transaction already active");
+    }
+    ResultPtr(execute_simple("BEGIN"));
+    in_transaction_ = true;
+}
+
+void PostgreSQLDatabase::commit() {
+    if (!is_connected()) {
+        throw DatabaseException("Not connected to database");
+    }
+    if (!in_transaction_) {
+        throw DatabaseException("No active transaction to commit");
+    }
+    in_transaction_ = false;  // COMMIT of a failed transaction rolls it back: either way it's over
+    ResultPtr result(execute_simple("COMMIT"));
+    if (std::strcmp(PQcmdStatus(result.get()), "ROLLBACK") == 0) {
+        throw DatabaseException("Failed to commit transaction: it was aborted by an earlier error");
+    }
+}
+
+void PostgreSQLDatabase::rollback() {
+    if (!conn_ || !in_transaction_) {
+        return;
+    }
+    in_transaction_ = false;
+    PQclear(PQexec(conn_, "ROLLBACK"));
+}
+
+bool PostgreSQLDatabase::in_transaction() const {
+    return in_transaction_;
+}
+
+int64_t PostgreSQLDatabase::last_insert_id() const {
+    if (!conn_) {
+        return 0;
+    }
+    // lastval() fails before the session's first nextval(); inside a
+    // transaction the failure must not abort the caller's work
+    if (in_transaction_) {
+        ResultPtr savepoint(PQexec(conn_, "SAVEPOINT finmodel_lastval"));
+        if (PQresultStatus(savepoint.get()) != PGRES_COMMAND_OK) {
+            return 0;
+        }
+    }
+    ResultPtr result(PQexec(conn_, "SELECT lastval()"));
+    const bool ok = PQresultStatus(result.get()) == PGRES_TUPLES_OK && PQntuples(result.get()) == 1;
+    if (in_transaction_) {
+        if (!ok) {
+            PQclear(PQexec(conn_, "ROLLBACK TO SAVEPOINT finmodel_lastval"));
+        }
+        PQclear(PQexec(conn_, "RELEASE SAVEPOINT finmodel_lastval"));
+    }
+    return ok ? std::strtoll(PQgetvalue(result.get(), 0, 0), nullptr, 10) : 0;
+}
+
+std::string PostgreSQLDatabase::last_error() const {
+    return last_error_;
+}
+
+std::string PostgreSQLDatabase::database_type() const {
+    return "postgresql";
+}
+
+std::vector<std::string> PostgreSQLDatabase::list_tables() {
+    auto result = execute_query(
+        "SELECT tablename FROM pg_tables WHERE schemaname = current_schema() ORDER BY tablename", {});
+    std::vector<std::string> tables;
+    while (result->next()) {
+        tables.push_back(result->get_string(0));
+    }
+    return tables;
+}
+
+std::vector<std::string> PostgreSQLDatabase::describe_table(const std::string& table_name) {
+    auto result = execute_query(
+        "SELECT column_name FROM information_schema.columns "
+        "WHERE table_schema = current_schema() AND table_name = :table ORDER BY ordinal_position",
+        {{"table", table_name}});
+    std::vector<std::string> columns;
+    while (result->next()) {
+        columns.push_back(result->get_string(0));
+    }
+    if (columns.empty()) {
+        throw DatabaseException("Table does not exist: " + table_name);
+    }
+    return columns;
+}
+
+void PostgreSQLDatabase::execute_raw(const std::string& sql) {
+    ResultPtr(execute_simple(sql));
+    column_types_.clear();  // DDL may have changed a table COPY writes to
+}
+
+// ========== PostgreSQLResultSet Implementation ==========
+
+PostgreSQLResultSet::PostgreSQLResultSet(PGresult* result)
+    : result_(result)
+    , rows_(PQntuples(result)) {
+    const int count = PQnfields(result_);
+    for (int i = 0; i < count; ++i) {
+        columns_.emplace(PQfname(result_, i), static_cast<size_t>(i));
+    }
+}
+
+PostgreSQLResultSet::~PostgreSQLResultSet() {
+    PQclear(result_);
+}
+
+bool PostgreSQLResultSet::next() {
+    blobs_.clear();
+    if (row_ + 1 >= rows_) {
+        row_ = rows_;
+        return false;
+    }
+    ++row_;
+    return true;
+}
+
+void PostgreSQLResultSet::reset() {
+    blobs_.clear();
+    row_ = -1;
+}
+
+void PostgreSQLResultSet::check_row() const {
+    if (row_ < 0 || row_ >= rows_) {
+        throw DatabaseException("No current row - call next() first");
+    }
+}
+
+size_t PostgreSQLResultSet::index_of(const std::string& column) const {
+    auto found = columns_.find(column);
+    if (found == columns_.end()) {
+        throw DatabaseException("Column not found: " + column);
+    }
+    return found->second;
+}
+
+int PostgreSQLResultSet::get_int(const std::string& column) const { return get_int(index_of(column)); }
+int64_t PostgreSQLResultSet::get_int64(const std::string& column) const { return get_int64(index_of(column)); }
+double PostgreSQLResultSet::get_double(const std::string& column) const { return get_double(index_of(column)); }
+std::string PostgreSQLResultSet::get_string(const std::string& column) const { return get_string(index_of(column)); }
+bool PostgreSQLResultSet::is_null(const std::string& column) const { return is_null(index_of(column)); }
+
+int PostgreSQLResultSet::get_int(size_t index) const {
+    return static_cast<int>(get_int64(index));
+}
+
+int64_t PostgreSQLResultSet::get_int64(size_t index) const {
+    const std::string_view text = get_text(index);
+    if (text == "t" || text == "f") {
+        return text == "t" ? 1 : 0;  // Booleans
+    }
+    int64_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        return static_cast<int64_t>(get_double(index));  // numeric, or a float like SQLite converts
+    }
+    return value;
+}
+
+double PostgreSQLResultSet::get_double(size_t index) const {
+    const std::string text(get_text(index));
+    return text.empty() ? 0.0 : std::strtod(text.c_str(), nullptr);  // Also reads NaN and Infinity
+}
+
+std::string PostgreSQLResultSet::get_string(size_t index) const {
+    return std::string(get_text(index));
+}
+
+std::string_view PostgreSQLResultSet::get_text(size_t index) const {
+    check_row();
+    if (index >= column_count()) {
+        throw DatabaseException("Column index out of range: " + std::to_string(index));
+    }
+    const int column = static_cast<int>(index);
+    if (PQgetisnull(result_, row_, column)) {
+        return {};
+    }
+    return std::string_view(PQgetvalue(result_, row_, column), static_cast<size_t>(PQgetlength(result_, row_, column)));
+}
+
+std::span<const std::uint8_t> PostgreSQLResultSet::get_blob(size_t index) const {
+    const std::string_view text = get_text(index);
+    if (PQftype(result_, static_cast<int>(index)) != BYTEA_OID) {
+        return {reinterpret_cast<const std::uint8_t*>(text.data()), text.size()};
+    }
+    auto [blob, added] = blobs_.try_emplace(index);
+    if (added && !text.empty()) {
+        size_t length = 0;
+        unsigned char* bytes = PQunescapeBytea(reinterpret_cast<const unsigned char*>(text.data()), &length);
+        if (!bytes) {
+            throw DatabaseException("Failed to decode bytea column " + column_name(index));
+        }
+        blob->second.assign(bytes, bytes + length);
+        PQfreemem(bytes);
+    }
+    return blob->second;
+}
+
+bool PostgreSQLResultSet::is_null(size_t index) const {
+    check_row();
+    return PQgetisnull(result_, row_, static_cast<int>(index)) != 0;
+}
+
+size_t PostgreSQLResultSet::column_count() const {
+    return static_cast<size_t>(PQnfields(result_));
+}
+
+std::string PostgreSQLResultSet::column_name(size_t index) const {
+    if (index >= column_count()) {
+        throw DatabaseException("Column index out of range: " + std::to_string(index));
+    }
+    return PQfname(result_, static_cast<int>(index));
+}
+
+std::vector<std::string> PostgreSQLResultSet::column_names() const {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < column_count(); ++i) {
+        names.push_back(column_name(i));
+    }
+    return names;
+}
+
+std::optional<size_t> PostgreSQLResultSet::column_index(const std::string& name) const {
+    auto found = columns_.find(name);
+    return found != columns_.end() ? std::optional<size_t>(found->second) : std::nullopt;
+}
+
+bool PostgreSQLResultSet::has_rows() const {
+    return rows_ > 0;
+}
+
+size_t PostgreSQLResultSet::row_count() const {
+    return static_cast<size_t>(rows_);
+}
+
+#endif // FINMODEL_POSTGRESQL
+
+} // namespace database
+} // namespace finmodel
@@ -1,19 +1,117 @@
 #include "database/sqlite_database.h"
 #include "database/idatabase.h"
+#include "core/engine_metrics.h"
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <iterator>
+#include <utility>
 
 namespace finmodel {
 namespace database {
 
+// ========== SQLiteStatementCache Implementation ==========
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+    clear();
+}
+
+sqlite3_stmt* SQLiteStatementCache::acquire(sqlite3* db, const std::string& sql) {
+    auto found = by_sql_.find(sql);
+    if (found != by_sql_.end() && !found->second->in_use) {
+        ++hits_;
+        core::EngineMetrics::add(core::EngineMetrics::Counter::STATEMENT_CACHE_HITS);
+        entries_.splice(entries_.begin(), entries_, found->second);
+        found->second->in_use = true;
+        return found->second->stmt;
+    }
+
+    ++misses_;
+    core::EngineMetrics::add(core::EngineMetrics::Counter::STATEMENT_CACHE_MISSES);
+    sqlite3_stmt* stmt = nullptr;
+    int rc;
+    {
+        core::EngineMetrics::DatabaseTimer timer;
+        rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    }
+    if (rc != SQLITE_OK) {
+        std::string error = sqlite3_errmsg(db);
+        sqlite3_finalize(stmt);
+        throw DatabaseException("Failed to prepare query: " + error, sql);
+    }
+
+    // A second user of the same SQL gets a private statement; SQL without
+    // a statement (only whitespace or comments) prepares to null
+    if (!stmt || capacity_ == 0 || found != by_sql_.end()) {
+        return stmt;
+    }
+
+    entries_.push_front({sql, stmt, true});
+    by_sql_.emplace(sql, entries_.begin());
+    by_stmt_.emplace(stmt, entries_.begin());
+    trim();
+    return stmt;
+}
+
+void SQLiteStatementCache::release(sqlite3_stmt* stmt) {
+    auto found = by_stmt_.find(stmt);
+    if (found == by_stmt_.end()) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    found->second->in_use = false;
+}
+
+void SQLiteStatementCache::clear() {
+    while (!entries_.empty()) {
+        evict(std::prev(entries_.end()));
+    }
+}
+
+void SQLiteStatementCache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    trim();
+}
+
+void SQLiteStatementCache::evict(std::list<Entry>::iterator entry) {
+    // Statements in use are finalized when their user releases them
+    if (!entry->in_use) {
+        sqlite3_finalize(entry->stmt);
+    }
+    by_sql_.erase(entry->sql);
+    by_stmt_.erase(entry->stmt);
+    entries_.erase(entry);
+}
+
+void SQLiteStatementCache::trim() {
+    while (entries_.size() > capacity_) {
+        evict(std::prev(entries_.end()));
+    }
+}
+
 // ========== SQLiteDatabase Implementation ==========
 
+namespace {
+
+// Identifier quoted for SQL text ("" inside quotes is a quote)
+std::string quote_identifier(const std::string& name) {
+    std::string quoted = "\"";
+    for (char c : name) {
+        quoted += (c == '"') ? "\"\"" : std::string(1, c);
+    }
+    return quoted + "\"";
+}
+
+} // namespace
+
 SQLiteDatabase::SQLiteDatabase()
     : db_(nullptr)
     , connected_(false)
     , in_transaction_(false)
     , connection_string_()
+    , statements_(std::make_shared<SQLiteStatementCache>(DEFAULT_STATEMENT_CACHE_CAPACITY))
 {
 }
 
@@ -26,6 +124,10 @@ SQLiteDatabase::SQLiteDatabase(SQLiteDatabase&& other) noexcept
     , connected_(other.connected_)
     , in_transaction_(other.in_transaction_)
     , connection_string_(std::move(other.connection_string_))
+    , statements_(std::exchange(other.statements_,
+                                std::make_shared<SQLiteStatementCache>(DEFAULT_STATEMENT_CACHE_CAPACITY)))
+    , write_back_path_(std::move(other.write_back_path_))
+    , write_back_(std::move(other.write_back_))
 {
     other.db_ = nullptr;
     other.connected_ = false;
@@ -39,6 +141,9 @@ SQLiteDatabase& SQLiteDatabase::operator=(SQLiteDatabase&& other) noexcept {
         connected_ = other.connected_;
         in_transaction_ = other.in_transaction_;
         connection_string_ = std::move(other.connection_string_);
+        std::swap(statements_, other.statements_);
+        write_back_path_ = std::move(other.write_back_path_);
+        write_back_ = std::move(other.write_back_);
         other.db_ = nullptr;
         other.connected_ = false;
         other.in_transaction_ = false;
@@ -47,18 +152,116 @@ SQLiteDatabase& SQLiteDatabase::operator=(SQLiteDatabase&& other) noexcept {
 }
 
 void SQLiteDatabase::connect(const std::string& connection_string) {
+    // SQLite connection string can be:
+    // - Simple path: "finmodel.db"
+    // - URI: "file:finmodel.db?mode=rwc"
+    // - In-memory: ":memory:"
+    open(connection_string, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI);
+    // Connections opened while another one runs (job workers) wait for its locks
+    sqlite3_busy_timeout(db_, BUSY_TIMEOUT_MS);
+
+    // Enable performance and safety features
+    try {
+        enable_wal_mode();
+        enable_foreign_keys();
+    } catch (...) {
+        disconnect();
+        throw;
+    }
+}
+
+void SQLiteDatabase::connect_read_only(const std::string& connection_string) {
+    open(connection_string, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI);
+    sqlite3_busy_timeout(db_, BUSY_TIMEOUT_MS);
+
+    try {
+        enable_foreign_keys();
+    } catch (...) {
+        disconnect();
+        throw;
+    }
+}
+
+void SQLiteDatabase::connect_working_copy(const std::string& source_path, const std::string& memory_uri,
+                                          const std::vector<std::string>& write_back,
+                                          const std::string& target_path) {
+    open(memory_uri, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI);
+    sqlite3_busy_timeout(db_, BUSY_TIMEOUT_MS);
+
+    try {
+        sqlite3* source = nullptr;
+        int rc = sqlite3_open_v2(source_path.c_str(), &source, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr);
+        if (rc != SQLITE_OK) {
+            std::string error = sqlite3_errmsg(source);
+            sqlite3_close(source);
+            throw DatabaseException("Failed to open " + source_path + " for a working copy: " + error);
+        }
+        sqlite3_busy_timeout(source, BUSY_TIMEOUT_MS);
+
+        // Every page in one step: the source can't change halfway
+        sqlite3_backup* backup = sqlite3_backup_init(db_, "main", source, "main");
+        if (backup == nullptr) {
+            std::string error = sqlite3_errmsg(db_);
+            sqlite3_close(source);
+            throw DatabaseException("Failed to copy " + source_path + ": " + error);
+        }
+        rc = sqlite3_backup_step(backup, -1);
+        sqlite3_backup_finish(backup);
+        sqlite3_close(source);
+        if (rc != SQLITE_DONE) {
+            throw DatabaseException("Failed to copy " + source_path + ": " + sqlite3_errstr(rc));
+        }
+
+        enable_foreign_keys();
+
+        // Write-back tables the source doesn't have (an input snapshot has no outputs): as in the target
+        std::unique_ptr<SQLiteDatabase> target;
+        for (const auto& table : write_back) {
+            auto exists = execute_query(
+                "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+            if (exists->next()) {
+                continue;
+            }
+            exists.reset();
+            if (!target) {
+                target = std::make_unique<SQLiteDatabase>();
+                target->connect_read_only(target_path);
+            }
+            auto definition = target->execute_query(
+                "SELECT sql FROM sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+            if (!definition->next()) {
+                continue;
+            }
+            execute_raw(definition->get_string(0));
+            definition.reset();
+            // AUTOINCREMENT ids continue after the target's, so written-back rows don't collide
+            const int64_t last = target->max_rowid("main", table);
+            auto sequence = execute_query("SELECT 1 FROM sqlite_master WHERE name = 'sqlite_sequence'", {});
+            if (last > 0 && sequence->next()) {
+                sequence.reset();
+                execute_update("INSERT INTO sqlite_sequence (name, seq) VALUES (:name, " + std::to_string(last) + ")",
+                               {{"name", table}});
+            }
+        }
+        target.reset();
+
+        write_back_path_ = target_path;
+        for (const auto& table : write_back) {
+            write_back_.emplace_back(table, max_rowid("main", table));
+        }
+    } catch (...) {
+        disconnect();
+        throw;
+    }
+}
+
+void SQLiteDatabase::open(const std::string& connection_string, int flags) {
     if (connected_) {
         throw DatabaseException("Already connected to database");
     }
 
     connection_string_ = connection_string;
 
-    // SQLite connection string can be:
-    // - Simple path: "finmodel.db"
-    // - URI: "file:finmodel.db?mode=rwc"
-    // - In-memory: ":memory:"
-
-    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI;
     int rc = sqlite3_open_v2(connection_string.c_str(), &db_, flags, nullptr);
 
     if (rc != SQLITE_OK) {
@@ -69,15 +272,6 @@ void SQLiteDatabase::connect(const std::string& connection_string) {
     }
 
     connected_ = true;
-
-    // Enable performance and safety features
-    try {
-        enable_wal_mode();
-        enable_foreign_keys();
-    } catch (...) {
-        disconnect();
-        throw;
-    }
 }
 
 void SQLiteDatabase::disconnect() {
@@ -94,9 +288,14 @@ void SQLiteDatabase::disconnect() {
         }
     }
 
-    sqlite3_close(db_);
+    // Result sets still open keep their statements until destroyed; close_v2
+    // defers closing the connection until then
+    statements_->clear();
+    sqlite3_close_v2(db_);
     db_ = nullptr;
     connected_ = false;
+    write_back_path_.clear();
+    write_back_.clear();
 }
 
 bool SQLiteDatabase::is_connected() const {
@@ -111,23 +310,17 @@ std::unique_ptr<ResultSet> SQLiteDatabase::execute_query(
         throw DatabaseException("Not connected to database");
     }
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-
-    if (rc != SQLITE_OK) {
-        std::string error = sqlite3_errmsg(db_);
-        throw DatabaseException("Failed to prepare query: " + error, sql);
-    }
+    sqlite3_stmt* stmt = statements_->acquire(db_, sql);
 
     // Bind parameters
     try {
         bind_parameters(stmt, params);
     } catch (...) {
-        sqlite3_finalize(stmt);
+        statements_->release(stmt);
         throw;
     }
 
-    return std::make_unique<SQLiteResultSet>(stmt);
+    return std::make_unique<SQLiteResultSet>(stmt, statements_);
 }
 
 int SQLiteDatabase::execute_update(
@@ -138,34 +331,110 @@ int SQLiteDatabase::execute_update(
         throw DatabaseException("Not connected to database");
     }
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
-
-    if (rc != SQLITE_OK) {
-        std::string error = sqlite3_errmsg(db_);
-        throw DatabaseException("Failed to prepare statement: " + error, sql);
-    }
+    sqlite3_stmt* stmt = statements_->acquire(db_, sql);
 
     // Bind parameters
     try {
         bind_parameters(stmt, params);
     } catch (...) {
-        sqlite3_finalize(stmt);
+        statements_->release(stmt);
         throw;
     }
 
-    // Execute
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-
+    // Execute (the error message must be read before the reset in release())
+    int rc;
+    {
+        core::EngineMetrics::DatabaseTimer timer;
+        rc = sqlite3_step(stmt);
+    }
     if (rc != SQLITE_DONE) {
         std::string error = sqlite3_errmsg(db_);
+        statements_->release(stmt);
         throw DatabaseException("Failed to execute statement: " + error, sql);
     }
+    statements_->release(stmt);
 
     return sqlite3_changes(db_);
 }
 
+int SQLiteDatabase::execute_batch(
+    const std::string& sql,
+    std::span<const ParamMap> rows)
+{
+    if (!is_connected()) {
+        throw DatabaseException("Not connected to database");
+    }
+    if (rows.empty()) {
+        return 0;
+    }
+
+    const bool own_transaction = !in_transaction_;
+    if (own_transaction) {
+        begin_transaction();
+    }
+    core::EngineMetrics::DatabaseTimer timer;
+    sqlite3_stmt* stmt = nullptr;
+    int affected = 0;
+    try {
+        stmt = statements_->acquire(db_, sql);
+
+        // Parameter indexes of the previous row's names, reused while rows have the same names
+        std::vector<const std::string*> names;
+        std::vector<int> indexes;
+        for (const auto& params : rows) {
+            bool same_names = names.size() == params.size();
+            if (same_names) {
+                size_t i = 0;
+                for (const auto& entry : params) {
+                    if (*names[i++] != entry.first) {
+                        same_names = false;
+                        break;
+                    }
+                }
+            }
+            if (!same_names) {
+                names.clear();
+                indexes.clear();
+                for (const auto& entry : params) {
+                    int index = get_parameter_index(stmt, entry.first);
+                    if (index == 0) {
+                        throw DatabaseException("Parameter not found in statement: " + entry.first);
+                    }
+                    names.push_back(&entry.first);
+                    indexes.push_back(index);
+                }
+            }
+
+            size_t i = 0;
+            for (const auto& [name, value] : params) {
+                bind_value(stmt, indexes[i++], name, value);
+            }
+            int rc = sqlite3_step(stmt);
+            if (rc != SQLITE_DONE) {
+                std::string error = sqlite3_errmsg(db_);
+                throw DatabaseException("Failed to execute statement: " + error, sql);
+            }
+            affected += sqlite3_changes(db_);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+    } catch (...) {
+        if (stmt) {
+            statements_->release(stmt);
+        }
+        if (own_transaction) {
+            rollback();
+        }
+        throw;
+    }
+
+    statements_->release(stmt);
+    if (own_transaction) {
+        commit();
+    }
+    return affected;
+}
+
 void SQLiteDatabase::begin_transaction() {
     if (!is_connected()) {
         throw DatabaseException("Not connected to database");
@@ -300,8 +569,76 @@ void SQLiteDatabase::execute_raw(const std::string& sql) {
     }
 }
 
+size_t SQLiteDatabase::flush() {
+    if (write_back_path_.empty()) {
+        return 0;
+    }
+    if (in_transaction_) {
+        throw DatabaseException("Can't flush a working copy inside a transaction");
+    }
+
+    execute_update("ATTACH DATABASE :path AS write_back", {{"path", write_back_path_}});
+    size_t written = 0;
+    std::vector<int64_t> marks;
+    try {
+        begin_transaction();
+        for (const auto& [table, mark] : write_back_) {
+            const int64_t last = max_rowid("main", table);
+            marks.push_back(last);
+            if (last <= mark) {
+                continue;  // Nothing added (or no such table in memory)
+            }
+            auto target = execute_query(
+                "SELECT 1 FROM write_back.sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+            if (!target->next()) {
+                throw DatabaseException("Write-back table " + table + " is missing in " + write_back_path_);
+            }
+            target.reset();
+
+            std::string columns;
+            auto info = execute_query("SELECT name FROM pragma_table_info(:name, 'main')", {{"name", table}});
+            for (auto [column] : info->rows<std::string>()) {
+                columns += (columns.empty() ? "" : ", ") + quote_identifier(column);
+            }
+            info.reset();
+            // Rowids are 64-bit, bound parameters only int: the mark is written into the statement
+            written += static_cast<size_t>(execute_update(
+                "INSERT INTO write_back." + quote_identifier(table) + " (" + columns + ") SELECT " + columns +
+                " FROM main." + quote_identifier(table) + " WHERE rowid > " + std::to_string(mark), {}));
+        }
+        commit();
+    } catch (...) {
+        rollback();
+        statements_->clear();
+        try {
+            execute_raw("DETACH DATABASE write_back");
+        } catch (const DatabaseException&) {
+        }
+        throw;
+    }
+    // Statements naming write_back would fail once it's detached
+    statements_->clear();
+    execute_raw("DETACH DATABASE write_back");
+
+    for (size_t i = 0; i < write_back_.size(); ++i) {
+        write_back_[i].second = marks[i];
+    }
+    return written;
+}
+
 // Private helper methods
 
+int64_t SQLiteDatabase::max_rowid(const std::string& schema, const std::string& table) {
+    auto exists = execute_query(
+        "SELECT 1 FROM " + schema + ".sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+    if (!exists->next()) {
+        return 0;
+    }
+    exists.reset();
+    auto last = execute_query("SELECT COALESCE(MAX(rowid), 0) FROM " + schema + "." + quote_identifier(table), {});
+    return last->next() ? last->get_int64(0) : 0;
+}
+
 void SQLiteDatabase::bind_parameters(sqlite3_stmt* stmt, const ParamMap& params) {
     for (const auto& [name, value] : params) {
         // Get parameter index (SQLite uses 1-based indexing)
@@ -311,36 +648,47 @@ void SQLiteDatabase::bind_parameters(sqlite3_stmt* stmt, const ParamMap& params)
             throw DatabaseException("Parameter not found in statement: " + name);
         }
 
-        // Bind based on variant type
-        std::visit([stmt, index, &name](auto&& arg) {
-            using T = std::decay_t<decltype(arg)>;
+        bind_value(stmt, index, name, value);
+    }
+}
+
+void SQLiteDatabase::bind_value(sqlite3_stmt* stmt, int index, const std::string& name,
+                                const ParamValue& value) {
+    // Bind based on variant type
+    std::visit([stmt, index, &name](auto&& arg) {
+        using T = std::decay_t<decltype(arg)>;
 
-            if constexpr (std::is_same_v<T, int>) {
-                int rc = sqlite3_bind_int(stmt, index, arg);
-                if (rc != SQLITE_OK) {
-                    throw DatabaseException("Failed to bind int parameter: " + name);
-                }
+        if constexpr (std::is_same_v<T, int>) {
+            int rc = sqlite3_bind_int(stmt, index, arg);
+            if (rc != SQLITE_OK) {
+                throw DatabaseException("Failed to bind int parameter: " + name);
             }
-            else if constexpr (std::is_same_v<T, double>) {
-                int rc = sqlite3_bind_double(stmt, index, arg);
-                if (rc != SQLITE_OK) {
-                    throw DatabaseException("Failed to bind double parameter: " + name);
-                }
+        }
+        else if constexpr (std::is_same_v<T, double>) {
+            int rc = sqlite3_bind_double(stmt, index, arg);
+            if (rc != SQLITE_OK) {
+                throw DatabaseException("Failed to bind double parameter: " + name);
             }
-            else if constexpr (std::is_same_v<T, std::string>) {
-                int rc = sqlite3_bind_text(stmt, index, arg.c_str(), -1, SQLITE_TRANSIENT);
-                if (rc != SQLITE_OK) {
-                    throw DatabaseException("Failed to bind string parameter: " + name);
-                }
+        }
+        else if constexpr (std::is_same_v<T, std::string>) {
+            int rc = sqlite3_bind_text(stmt, index, arg.c_str(), -1, SQLITE_TRANSIENT);
+            if (rc != SQLITE_OK) {
+                throw DatabaseException("Failed to bind string parameter: " + name);
             }
-            else if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                int rc = sqlite3_bind_null(stmt, index);
-                if (rc != SQLITE_OK) {
-                    throw DatabaseException("Failed to bind NULL parameter: " + name);
-                }
+        }
+        else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            int rc = sqlite3_bind_null(stmt, index);
+            if (rc != SQLITE_OK) {
+                throw DatabaseException("Failed to bind NULL parameter: " + name);
             }
-        }, value);
-    }
+        }
+        else if constexpr (std::is_same_v<T, Blob>) {
+            int rc = sqlite3_bind_blob64(stmt, index, arg.data(), arg.size(), SQLITE_TRANSIENT);
+            if (rc != SQLITE_OK) {
+                throw DatabaseException("Failed to bind blob parameter: " + name);
+            }
+        }
+    }, value);
 }
 
 void SQLiteDatabase::enable_wal_mode() {
@@ -370,10 +718,11 @@ void SQLiteDatabase::enable_foreign_keys() {
 int SQLiteDatabase::get_parameter_index(sqlite3_stmt* stmt, const std::string& param_name) {
     // SQLite named parameters use :name, $name, @name, or ?name format
     // Try different prefixes
-    std::vector<std::string> prefixes = {":", "$", "@", ""};
+    static const char* const prefixes[] = {":", "$", "@", ""};
 
-    for (const auto& prefix : prefixes) {
-        std::string full_name = prefix + param_name;
+    std::string full_name;
+    for (const char* prefix : prefixes) {
+        full_name.assign(prefix).append(param_name);
         int index = sqlite3_bind_parameter_index(stmt, full_name.c_str());
         if (index > 0) {
             return index;
@@ -383,6 +732,131 @@ int SQLiteDatabase::get_parameter_index(sqlite3_stmt* stmt, const std::string& p
     return 0;  // Not found
 }
 
+// ========== BulkLoadSession Implementation ==========
+
+BulkLoadSession::BulkLoadSession(SQLiteDatabase& db, BulkLoadOptions options)
+    : db_(db)
+    , options_(std::move(options)) {
+    if (db_.in_transaction()) {
+        throw DatabaseException("Cannot start a bulk load inside a transaction");
+    }
+
+    const std::pair<const char*, std::string> settings[] = {
+        {"synchronous", options_.synchronous},
+        {"cache_size", std::to_string(-options_.cache_size_kib)},  // Negative: KiB rather than pages
+        {"mmap_size", std::to_string(options_.mmap_size)},
+        {"wal_autocheckpoint", std::to_string(options_.wal_autocheckpoint)},
+    };
+    try {
+        for (const auto& [name, value] : settings) {
+            auto current = db_.execute_query(std::string("PRAGMA ") + name, {});
+            if (!current->next()) {
+                continue;  // Not applicable to this connection (e.g. mmap_size of an in-memory database)
+            }
+            pragmas_.emplace_back(name, std::to_string(current->get_int64(0)));
+            current.reset();
+            db_.execute_raw(std::string("PRAGMA ") + name + " = " + value);
+        }
+
+        if (options_.drop_indexes) {
+            for (const auto& table : options_.tables) {
+                // origin 'c': CREATE INDEX (not the automatic index of a PRIMARY KEY or UNIQUE constraint)
+                auto found = db_.execute_query(
+                    "SELECT il.name, m.sql FROM pragma_index_list(:table) AS il "
+                    "JOIN sqlite_master AS m ON m.type = 'index' AND m.name = il.name "
+                    "WHERE il.\"unique\" = 0 AND il.origin = 'c' AND m.sql IS NOT NULL ORDER BY il.name",
+                    {{"table", table}});
+                std::vector<std::pair<std::string, std::string>> indexes;
+                while (found->next()) {
+                    indexes.emplace_back(found->get_string(0), found->get_string(1));
+                }
+                found.reset();
+                for (auto& index : indexes) {
+                    db_.execute_raw("DROP INDEX " + quote_identifier(index.first));
+                    indexes_.push_back(std::move(index));
+                }
+            }
+        }
+    } catch (...) {
+        finished_ = true;  // The destructor won't run: put back what was changed so far
+        for (const auto& [name, sql] : indexes_) {
+            try { db_.execute_raw(sql); } catch (const DatabaseException&) {}
+        }
+        for (auto it = pragmas_.rbegin(); it != pragmas_.rend(); ++it) {
+            try { db_.execute_raw("PRAGMA " + it->first + " = " + it->second); } catch (const DatabaseException&) {}
+        }
+        throw;
+    }
+}
+
+BulkLoadSession::~BulkLoadSession() {
+    try {
+        finish();
+    } catch (const std::exception&) {
+        // Already unwinding or abandoned: the settings are per connection and end with it
+    }
+}
+
+void BulkLoadSession::finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+
+    std::string error;
+    auto attempt = [&](const std::string& sql) {
+        try {
+            db_.execute_raw(sql);
+        } catch (const DatabaseException& e) {
+            if (error.empty()) {
+                error = e.what();
+            }
+        }
+    };
+
+    for (const auto& [name, sql] : indexes_) {
+        attempt(sql);
+    }
+    for (auto it = pragmas_.rbegin(); it != pragmas_.rend(); ++it) {
+        attempt("PRAGMA " + it->first + " = " + it->second);
+    }
+
+    if (options_.analyze) {
+        if (options_.tables.empty()) {
+            attempt("PRAGMA optimize");
+        } else {
+            std::string analysis_limit = "0";
+            auto current = db_.execute_query("PRAGMA analysis_limit", {});
+            if (current->next()) {
+                analysis_limit = std::to_string(current->get_int64(0));
+            }
+            current.reset();
+            attempt("PRAGMA analysis_limit = " + std::to_string(options_.analysis_limit));
+            for (const auto& table : options_.tables) {
+                auto exists = db_.execute_query(
+                    "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = :name", {{"name", table}});
+                if (exists->next()) {
+                    exists.reset();
+                    attempt("ANALYZE " + quote_identifier(table));
+                }
+            }
+            attempt("PRAGMA analysis_limit = " + analysis_limit);
+        }
+    }
+
+    if (!error.empty()) {
+        throw DatabaseException("Bulk load didn't finish cleanly: " + error);
+    }
+}
+
+std::vector<std::string> BulkLoadSession::dropped_indexes() const {
+    std::vector<std::string> names;
+    for (const auto& index : indexes_) {
+        names.push_back(index.first);
+    }
+    return names;
+}
+
 } // namespace database
 } // namespace finmodel
 
@@ -392,21 +866,34 @@ namespace finmodel {
 
 using database::DatabaseException;
 
-SQLiteResultSet::SQLiteResultSet(sqlite3_stmt* stmt)
+SQLiteResultSet::SQLiteResultSet(sqlite3_stmt* stmt,
+                                 std::shared_ptr<database::SQLiteStatementCache> cache)
     : stmt_(stmt)
+    , cache_(std::move(cache))
     , has_row_(false)
     , first_call_(true)
 {
 }
 
 SQLiteResultSet::~SQLiteResultSet() {
-    if (stmt_) {
+    release_statement();
+}
+
+void SQLiteResultSet::release_statement() {
+    if (!stmt_) {
+        return;
+    }
+    if (cache_) {
+        cache_->release(stmt_);
+    } else {
         sqlite3_finalize(stmt_);
     }
+    stmt_ = nullptr;
 }
 
 SQLiteResultSet::SQLiteResultSet(SQLiteResultSet&& other) noexcept
     : stmt_(other.stmt_)
+    , cache_(std::move(other.cache_))
     , has_row_(other.has_row_)
     , first_call_(other.first_call_)
     , column_index_cache_(std::move(other.column_index_cache_))
@@ -416,10 +903,9 @@ SQLiteResultSet::SQLiteResultSet(SQLiteResultSet&& other) noexcept
 
 SQLiteResultSet& SQLiteResultSet::operator=(SQLiteResultSet&& other) noexcept {
     if (this != &other) {
-        if (stmt_) {
-            sqlite3_finalize(stmt_);
-        }
+        release_statement();
         stmt_ = other.stmt_;
+        cache_ = std::move(other.cache_);
         has_row_ = other.has_row_;
         first_call_ = other.first_call_;
         column_index_cache_ = std::move(other.column_index_cache_);
@@ -433,7 +919,11 @@ bool SQLiteResultSet::next() {
         return false;
     }
 
-    int rc = sqlite3_step(stmt_);
+    int rc;
+    {
+        core::EngineMetrics::DatabaseTimer timer;
+        rc = sqlite3_step(stmt_);
+    }
 
     if (rc == SQLITE_ROW) {
         has_row_ = true;
@@ -507,12 +997,37 @@ std::string SQLiteResultSet::get_string(size_t index) const {
         throw DatabaseException("No current row - call next() first");
     }
 
+    return std::string(get_text(index));
+}
+
+std::string_view SQLiteResultSet::get_text(size_t index) const {
+    if (!has_row_) {
+        throw DatabaseException("No current row - call next() first");
+    }
+
+    // Text first, then its length (sqlite3_column_bytes after the conversion)
     const unsigned char* text = sqlite3_column_text(stmt_, static_cast<int>(index));
     if (text == nullptr) {
-        return "";
+        return {};
+    }
+
+    return std::string_view(reinterpret_cast<const char*>(text),
+                            static_cast<size_t>(sqlite3_column_bytes(stmt_, static_cast<int>(index))));
+}
+
+std::span<const std::uint8_t> SQLiteResultSet::get_blob(size_t index) const {
+    if (!has_row_) {
+        throw DatabaseException("No current row - call next() first");
+    }
+
+    // Blob first, then its length (as for text)
+    const void* blob = sqlite3_column_blob(stmt_, static_cast<int>(index));
+    if (blob == nullptr) {
+        return {};
     }
 
-    return std::string(reinterpret_cast<const char*>(text));
+    return {static_cast<const std::uint8_t*>(blob),
+            static_cast<size_t>(sqlite3_column_bytes(stmt_, static_cast<int>(index)))};
 }
 
 bool SQLiteResultSet::is_null(size_t index) const {
@@ -15,8 +15,8 @@
 namespace finmodel {
 namespace fx {
 
-FXProvider::FXProvider(std::shared_ptr<database::IDatabase> db)
-    : db_(db) {
+FXProvider::FXProvider(std::shared_ptr<database::IDatabase> db, std::string rate_type)
+    : db_(db), rate_type_(std::move(rate_type)) {
     if (!db_) {
         throw std::invalid_argument("Database connection required");
     }
@@ -24,44 +24,151 @@ FXProvider::FXProvider(std::shared_ptr<database::IDatabase> db)
 }
 
 void FXProvider::load_rates() {
-    rate_cache_.clear();
     available_currencies_.clear();
 
-    auto query = R"(
+    std::string query = R"(
         SELECT
             from_currency,
             to_currency,
             period_id,
             rate
         FROM fx_rate
-        ORDER BY from_currency, to_currency, period_id
     )";
+    ParamMap params;
+    if (!rate_type_.empty()) {
+        query += " WHERE rate_type = :rate_type";
+        params["rate_type"] = rate_type_;
+    }
+    query += " ORDER BY from_currency, to_currency, period_id";
 
-    auto result_set = db_->execute_query(query, {});
+    auto result_set = db_->execute_query(query, params);
 
+    struct Row {
+        int from_id;
+        int to_id;
+        int period_id;
+        double rate;
+    };
+    std::vector<Row> rows;
     std::unordered_set<std::string> currency_set;
 
     while (result_set->next()) {
-        RateKey key;
-        key.from_currency = result_set->get_string("from_currency");
-        key.to_currency = result_set->get_string("to_currency");
-        key.period_id = result_set->get_int("period_id");
-
-        double rate = result_set->get_double("rate");
+        std::string from_currency = result_set->get_string("from_currency");
+        std::string to_currency = result_set->get_string("to_currency");
 
-        // Store in cache
-        rate_cache_[key] = rate;
+        Row row;
+        row.from_id = intern_currency(from_currency);
+        row.to_id = intern_currency(to_currency);
+        row.period_id = result_set->get_int("period_id");
+        row.rate = result_set->get_double("rate");
+        rows.push_back(row);
 
         // Track available currencies
-        currency_set.insert(key.from_currency);
-        currency_set.insert(key.to_currency);
+        currency_set.insert(from_currency);
+        currency_set.insert(to_currency);
+    }
+
+    // Period columns: only periods that have rates take up table space
+    period_columns_.clear();
+    column_count_ = 0;
+    first_period_ = 0;
+    if (!rows.empty()) {
+        auto [lowest, highest] = std::minmax_element(rows.begin(), rows.end(),
+            [](const Row& a, const Row& b) { return a.period_id < b.period_id; });
+        first_period_ = lowest->period_id;
+        period_columns_.assign(static_cast<size_t>(highest->period_id - first_period_) + 1, -1);
+        for (const Row& row : rows) {
+            int& column = period_columns_[row.period_id - first_period_];
+            if (column < 0) {
+                column = static_cast<int>(column_count_++);
+            }
+        }
     }
 
+    // Store direct rates; a repeated (from, to, period) row keeps the last one
+    currency_count_ = currency_codes_.size();
+    rates_.assign(currency_count_ * currency_count_ * column_count_, std::nan(""));
+    for (const Row& row : rows) {
+        rates_[(static_cast<size_t>(row.from_id) * currency_count_ + row.to_id) * column_count_ +
+               period_columns_[row.period_id - first_period_]] = row.rate;
+    }
+    fill_derived_rates();
+
     // Convert set to vector
     available_currencies_.assign(currency_set.begin(), currency_set.end());
     std::sort(available_currencies_.begin(), available_currencies_.end());
 }
 
+void FXProvider::fill_derived_rates() {
+    const size_t n = currency_count_;
+    if (n == 0 || column_count_ == 0) {
+        return;
+    }
+    auto at = [this, n](size_t from, size_t to, size_t column) -> double& {
+        return rates_[(from * n + to) * column_count_ + column];
+    };
+
+    // Inverse of the opposite direction (direct rates always win)
+    std::vector<double> direct = rates_;
+    auto direct_at = [&direct, this, n](size_t from, size_t to, size_t column) {
+        return direct[(from * n + to) * column_count_ + column];
+    };
+    for (size_t from = 0; from < n; ++from) {
+        for (size_t to = 0; to < n; ++to) {
+            for (size_t column = 0; column < column_count_; ++column) {
+                if (from == to || !std::isnan(at(from, to, column))) {
+                    continue;
+                }
+                double inverse_rate = direct_at(to, from, column);
+                // Avoid division by zero
+                if (!std::isnan(inverse_rate) && std::abs(inverse_rate) >= 1e-10) {
+                    at(from, to, column) = 1.0 / inverse_rate;
+                }
+            }
+        }
+    }
+
+    // Cross rates through the most quoted currency
+    std::vector<size_t> quotes(n, 0);
+    for (size_t from = 0; from < n; ++from) {
+        for (size_t to = 0; to < n; ++to) {
+            for (size_t column = 0; column < column_count_; ++column) {
+                if (!std::isnan(direct_at(from, to, column))) {
+                    ++quotes[from];
+                    ++quotes[to];
+                }
+            }
+        }
+    }
+    const size_t pivot = std::max_element(quotes.begin(), quotes.end()) - quotes.begin();
+    for (size_t from = 0; from < n; ++from) {
+        for (size_t to = 0; to < n; ++to) {
+            if (from == to || from == pivot || to == pivot) {
+                continue;
+            }
+            for (size_t column = 0; column < column_count_; ++column) {
+                if (std::isnan(at(from, to, column))) {
+                    // NaN propagates if either leg is missing
+                    at(from, to, column) = at(from, pivot, column) * at(pivot, to, column);
+                }
+            }
+        }
+    }
+}
+
+int FXProvider::intern_currency(const std::string& currency) {
+    auto [it, inserted] = currency_index_.emplace(currency, static_cast<int>(currency_codes_.size()));
+    if (inserted) {
+        currency_codes_.push_back(currency);
+    }
+    return it->second;
+}
+
+int FXProvider::currency_id(const std::string& currency) const {
+    auto it = currency_index_.find(currency);
+    return (it != currency_index_.end()) ? it->second : NO_CURRENCY;
+}
+
 double FXProvider::get_rate(
     const std::string& from_currency,
     const std::string& to_currency,
@@ -72,8 +179,7 @@ double FXProvider::get_rate(
         return 1.0;
     }
 
-    // Try to get from cache (or compute inverse)
-    auto rate = get_rate_from_cache(from_currency, to_currency, period_id);
+    auto rate = find_rate(currency_id(from_currency), currency_id(to_currency), period_id);
     if (rate.has_value()) {
         return rate.value();
     }
@@ -95,8 +201,22 @@ bool FXProvider::has_rate(
         return true;
     }
 
-    auto rate = get_rate_from_cache(from_currency, to_currency, period_id);
-    return rate.has_value();
+    return find_rate(currency_id(from_currency), currency_id(to_currency), period_id).has_value();
+}
+
+double FXProvider::get_rate(int from_id, int to_id, int period_id) const {
+    auto rate = find_rate(from_id, to_id, period_id);
+    if (rate.has_value()) {
+        return rate.value();
+    }
+
+    auto code = [this](int id) {
+        return (id >= 0 && static_cast<size_t>(id) < currency_codes_.size()) ? currency_codes_[id] : "?";
+    };
+    std::ostringstream oss;
+    oss << "FX rate not found: " << code(from_id) << " -> " << code(to_id)
+        << " for period " << period_id;
+    throw std::runtime_error(oss.str());
 }
 
 std::vector<std::string> FXProvider::get_available_currencies() const {
@@ -107,33 +227,5 @@ void FXProvider::reload() {
     load_rates();
 }
 
-std::optional<double> FXProvider::get_rate_from_cache(
-    const std::string& from_currency,
-    const std::string& to_currency,
-    int period_id
-) const {
-    // Try direct lookup
-    RateKey direct_key{from_currency, to_currency, period_id};
-    auto it = rate_cache_.find(direct_key);
-    if (it != rate_cache_.end()) {
-        return it->second;
-    }
-
-    // Try inverse lookup (from B to A, then invert)
-    RateKey inverse_key{to_currency, from_currency, period_id};
-    it = rate_cache_.find(inverse_key);
-    if (it != rate_cache_.end()) {
-        double inverse_rate = it->second;
-        if (std::abs(inverse_rate) < 1e-10) {
-            // Avoid division by zero
-            return std::nullopt;
-        }
-        return 1.0 / inverse_rate;
-    }
-
-    // Rate not found
-    return std::nullopt;
-}
-
 } // namespace fx
 } // namespace finmodel
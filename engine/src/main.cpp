@@ -1,19 +1,322 @@
+#include "orchestration/batch_run.h"
+#include "orchestration/distributed_sweep.h"
+#include "orchestration/job_queue.h"
+#include "orchestration/run_estimate.h"
+#include "orchestration/template_cost.h"
+#include "orchestration/whatif_sessions.h"
+#include "core/thread_pool.h"
+#include "core/unit_converter.h"
+#include "database/csv_importer.h"
+#include "database/database_factory.h"
+#include "web/server.h"
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
-// Placeholder main - will be implemented in M1/M2
-int main(int argc, char* argv[]) {
+using namespace finmodel;
+
+namespace {
+
+void print_usage() {
     std::cout << "Financial Model Framework v1.0" << std::endl;
-    std::cout << "Milestone 1: Foundation & Setup" << std::endl;
     std::cout << std::endl;
     std::cout << "Usage: scenario_engine [options]" << std::endl;
+    std::cout << "  run --manifest <file> [--threads <n>]" << std::endl;
+    std::cout << "                         Run a batch manifest (entities × scenarios × periods) and" << std::endl;
+    std::cout << "                         print a throughput summary" << std::endl;
+    std::cout << "  estimate --manifest <file> [--calibration <file>] [--nodes <n>] [--threads <n>]" << std::endl;
+    std::cout << "                         Predict a manifest's time, peak memory and output size per backend" << std::endl;
+    std::cout << "                         (calibration: run_benchmarks --benchmark_format=json output)" << std::endl;
+    std::cout << "  cost --db <path> --template <code> [--scenarios <1,4-6>] [--history <n>] [--json 1]" << std::endl;
+    std::cout << "                         Static cost of a template's formulas (ops, IF branches, fan-in/out," << std::endl;
+    std::cout << "                         critical path, [t-k] database reads) and of the scenarios' action overlays" << std::endl;
+    std::cout << "  import --db <path> --file <csv> --table <name> [--threads <n>] [--delimiter <c>]" << std::endl;
+    std::cout << "         [--append 1] [--numeric <column>[=<unit>]]..." << std::endl;
+    std::cout << "                         Bulk-load a CSV file into a staging table" << std::endl;
     std::cout << "  --init-db              Initialize database schema" << std::endl;
-    std::cout << "  --mode server          Start web server" << std::endl;
+    std::cout << "  --mode server          Start web server (GET /metrics, GET /health)" << std::endl;
     std::cout << "  --port <port>          Server port (default: 8080)" << std::endl;
+    std::cout << "  --address <ip>         Server: IPv4 address to listen on (default: 127.0.0.1, all: 0.0.0.0)" << std::endl;
+    std::cout << "  --max-connections <n>  Server: connections served at once, more are answered 503 (default: 64)" << std::endl;
+    std::cout << "  --db <path>            Server: serve /jobs, what-if /sessions and /templates/CODE/cost from this database" << std::endl;
+    std::cout << "  --job-workers <n>      Server: jobs running at once (default: 2)" << std::endl;
+    std::cout << "  --batch-workers <n>    Server: batch jobs running at once (default: 1)" << std::endl;
+    std::cout << "  --sessions <n>         Server: warm what-if sessions kept (default: 64)" << std::endl;
+    std::cout << "  --import-dir <dir>     Server: serve POST /imports for the CSV files in this directory" << std::endl;
+    std::cout << "  --import-threads <n>   Server: parsing threads per POST /imports (default: 4)" << std::endl;
     std::cout << "  --scenario-id <id>     Run specific scenario" << std::endl;
     std::cout << "  --data-dir <path>      Data directory" << std::endl;
     std::cout << std::endl;
-    std::cout << "This is a placeholder. Implementation starts in M1." << std::endl;
+    std::cout << "Distributed sweeps (work directory on a file system shared by all nodes):" << std::endl;
+    std::cout << "  --mode coordinator --db <path> --work-dir <dir> --template <code>" << std::endl;
+    std::cout << "         --entities <A,B,..> --scenarios <1-100,..> --periods <1-360,..>" << std::endl;
+    std::cout << "         [--shard-size <n>] [--max-attempts <n>] [--lease <seconds>]" << std::endl;
+    std::cout << "         [--opening <CODE=value>]..." << std::endl;
+    std::cout << "  --mode worker --work-dir <dir> [--name <name>] [--threads <n>] [--idle <seconds>]" << std::endl;
+}
+
+std::vector<int> parse_ids(const std::string& text) {
+    return orchestration::RunManifest::parse_ids(text);
+}
+
+std::vector<std::string> parse_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::string default_worker_name() {
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    return std::string(host) + "-" + std::to_string(getpid());
+}
+
+int run_coordinator(const std::multimap<std::string, std::string>& args) {
+    auto arg = [&](const std::string& key, const std::string& fallback = "") {
+        auto it = args.find(key);
+        return (it != args.end()) ? it->second : fallback;
+    };
+
+    orchestration::SweepSpec spec;
+    spec.entities = parse_list(arg("--entities"));
+    spec.scenario_ids = parse_ids(arg("--scenarios"));
+    spec.period_ids = parse_ids(arg("--periods"));
+    spec.template_code = arg("--template");
+    spec.scenarios_per_shard = std::stoul(arg("--shard-size", "64"));
+    auto openings = args.equal_range("--opening");
+    for (auto it = openings.first; it != openings.second; ++it) {
+        const size_t eq = it->second.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("--opening expects CODE=value, got " + it->second);
+        }
+        spec.opening_balances[it->second.substr(0, eq)] = std::stod(it->second.substr(eq + 1));
+    }
+
+    orchestration::SweepCoordinator coordinator(arg("--work-dir"),
+                                                std::stoi(arg("--max-attempts", "3")),
+                                                std::stod(arg("--lease", "600")));
+    const size_t shards = coordinator.prepare(arg("--db"), spec);
+    std::cout << "Published " << shards << " shards in " << arg("--work-dir") << std::endl;
+
+    auto status = coordinator.wait();
+    std::cout << orchestration::SweepCoordinator::report(status);
+    for (const auto& shard : status) {
+        if (shard.state != orchestration::ShardStatus::State::DONE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int run_batch(const std::multimap<std::string, std::string>& args) {
+    auto manifest_path = args.find("--manifest");
+    if (manifest_path == args.end()) {
+        throw std::invalid_argument("run needs --manifest <file>");
+    }
+    auto manifest = orchestration::RunManifest::load(manifest_path->second);
+    auto threads = args.find("--threads");
+    if (threads != args.end()) {
+        manifest.threads = std::stoul(threads->second);
+    }
+
+    std::cout << "Running " << manifest.entities.size() * manifest.scenario_ids.size() << " runs of "
+              << manifest.period_ids.size() << " periods (" << manifest.template_code << ")" << std::endl;
+    orchestration::BatchRunner runner(manifest);
+    const size_t total = manifest.entities.size() * manifest.scenario_ids.size();
+    runner.set_progress([total](const orchestration::BatchSummary& so_far) {
+        std::cerr << "\r" << so_far.runs << "/" << total << " runs" << std::flush;
+    });
+    const auto summary = runner.run();
+    std::cerr << std::endl;
+    std::cout << summary.report();
+    return summary.failed_runs == 0 ? 0 : 1;
+}
+
+int run_estimate(const std::multimap<std::string, std::string>& args) {
+    auto manifest_path = args.find("--manifest");
+    if (manifest_path == args.end()) {
+        throw std::invalid_argument("estimate needs --manifest <file>");
+    }
+    auto manifest = orchestration::RunManifest::load(manifest_path->second);
+    auto threads = args.find("--threads");
+    if (threads != args.end()) {
+        manifest.threads = std::stoul(threads->second);
+    }
+    auto calibration_path = args.find("--calibration");
+    const auto calibration = calibration_path != args.end()
+        ? orchestration::CostCalibration::load(calibration_path->second)
+        : orchestration::CostCalibration{};
+    auto nodes = args.find("--nodes");
+
+    const auto estimate = orchestration::RunEstimator::estimate(
+        manifest, calibration, nodes != args.end() ? std::stoul(nodes->second) : 1);
+    std::cout << estimate.report();
+    return 0;
+}
+
+int run_cost(const std::multimap<std::string, std::string>& args) {
+    auto arg = [&](const std::string& key, const std::string& fallback = "") {
+        auto it = args.find(key);
+        return (it != args.end()) ? it->second : fallback;
+    };
+    if (arg("--db").empty() || arg("--template").empty()) {
+        throw std::invalid_argument("cost needs --db <path> and --template <code>");
+    }
+    const std::string scenarios = arg("--scenarios");
+    const auto cost = orchestration::TemplateCostAnalyzer::analyze(
+        database::DatabaseFactory::create_sqlite(arg("--db")), arg("--template"),
+        scenarios.empty() ? std::vector<int>{} : parse_ids(scenarios),
+        std::stoul(arg("--history", std::to_string(orchestration::TemplateCostAnalyzer::DEFAULT_HISTORY_DEPTH))));
+    if (arg("--json", "0") != "0") {
+        std::cout << cost.to_json() << std::endl;
+    } else {
+        std::cout << cost.report();
+    }
+    return 0;
+}
+
+int run_import(const std::multimap<std::string, std::string>& args) {
+    auto arg = [&](const std::string& key, const std::string& fallback = "") {
+        auto it = args.find(key);
+        return (it != args.end()) ? it->second : fallback;
+    };
+    if (arg("--db").empty() || arg("--file").empty() || arg("--table").empty()) {
+        throw std::invalid_argument("import needs --db <path>, --file <csv> and --table <name>");
+    }
+
+    std::shared_ptr<database::IDatabase> db = database::DatabaseFactory::create_sqlite(arg("--db"));
+    database::CsvImportOptions options;
+    const std::string delimiter = arg("--delimiter", ",");
+    if (delimiter.size() != 1) {
+        throw std::invalid_argument("--delimiter expects one character, got " + delimiter);
+    }
+    options.delimiter = delimiter[0];
+    options.replace = arg("--append", "0") == "0";
+    auto numeric = args.equal_range("--numeric");
+    for (auto it = numeric.first; it != numeric.second; ++it) {
+        const size_t eq = it->second.find('=');
+        options.numeric_columns[it->second.substr(0, eq)] =
+            (eq == std::string::npos) ? "" : it->second.substr(eq + 1);
+    }
+    std::unique_ptr<core::UnitConverter> units;
+    if (std::any_of(options.numeric_columns.begin(), options.numeric_columns.end(),
+                    [](const auto& column) { return !column.second.empty(); })) {
+        units = std::make_unique<core::UnitConverter>(db);
+        options.units = units.get();
+    }
+    std::unique_ptr<core::ThreadPool> pool;
+    const size_t threads = std::stoul(arg("--threads", "0"));
+    if (threads != 1) {
+        pool = std::make_unique<core::ThreadPool>(threads);
+        options.pool = pool.get();
+    }
+
+    const auto result = database::CsvImporter::import_file(*db, arg("--file"), arg("--table"), options);
+    std::cout << "Imported " << result.rows << " rows of " << result.columns.size() << " columns into "
+              << result.table << " (" << result.chunks << " chunks)" << std::endl;
+    return 0;
+}
+
+int run_worker(const std::multimap<std::string, std::string>& args) {
+    auto arg = [&](const std::string& key, const std::string& fallback = "") {
+        auto it = args.find(key);
+        return (it != args.end()) ? it->second : fallback;
+    };
+
+    const std::string name = arg("--name", default_worker_name());
+    orchestration::SweepWorker worker(arg("--work-dir"), name, std::stoul(arg("--threads", "1")));
+    const size_t shards = worker.run(std::stod(arg("--idle", "30")));
+    std::cout << "Worker " << name << " ran " << shards << " shards" << std::endl;
+    return 0;
+}
+
+int run_server(const std::multimap<std::string, std::string>& args) {
+    auto arg = [&](const std::string& key, const std::string& fallback) {
+        auto it = args.find(key);
+        return (it != args.end()) ? it->second : fallback;
+    };
+    web::Server server(static_cast<uint16_t>(std::stoi(arg("--port", "8080"))), arg("--address", "127.0.0.1"));
+    server.set_max_connections(std::stoul(arg("--max-connections", "64")));
+    auto db = args.find("--db");
+    if (db != args.end()) {
+        const std::string path = db->second;
+        auto count = [&](const std::string& key, const std::string& fallback) {
+            auto it = args.find(key);
+            return std::stoul(it != args.end() ? it->second : fallback);
+        };
+        auto connect = [path] { return database::DatabaseFactory::create_sqlite(path); };
+        server.set_jobs(std::make_shared<orchestration::JobQueue>(
+            connect, count("--job-workers", "2"), count("--batch-workers", "1")));
+        server.set_sessions(std::make_shared<orchestration::WhatIfSessions>(connect, count("--sessions", "64")));
+        auto import_dir = args.find("--import-dir");
+        if (import_dir != args.end()) {
+            server.set_imports(connect, import_dir->second, count("--import-threads", "4"));
+        }
+        server.set_templates(connect);
+    }
+    server.listen();
+    std::string served = "/metrics, /health";
+    if (db != args.end()) {
+        served += args.count("--import-dir") ? ", /jobs, /sessions, /imports and /templates" : ", /jobs, /sessions and /templates";
+    }
+    std::cout << "Serving " << served << " on port " << server.port() << std::endl;
+    server.run();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // "run", "estimate", "cost" and "import" are subcommands; everything else is --option value pairs
+    const std::string command = argc > 1 ? argv[1] : "";
+    const bool batch = command == "run";
+    const bool estimate = command == "estimate";
+    const bool cost = command == "cost";
+    const bool import = command == "import";
+    std::multimap<std::string, std::string> args;
+    for (int i = (batch || estimate || cost || import) ? 2 : 1; i + 1 < argc; i += 2) {
+        args.emplace(argv[i], argv[i + 1]);
+    }
+
+    auto mode = args.find("--mode");
+    try {
+        if (batch) {
+            return run_batch(args);
+        }
+        if (estimate) {
+            return run_estimate(args);
+        }
+        if (cost) {
+            return run_cost(args);
+        }
+        if (import) {
+            return run_import(args);
+        }
+        if (mode != args.end() && mode->second == "coordinator") {
+            return run_coordinator(args);
+        }
+        if (mode != args.end() && mode->second == "worker") {
+            return run_worker(args);
+        }
+        if (mode != args.end() && mode->second == "server") {
+            return run_server(args);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
+    print_usage();
     return 0;
 }
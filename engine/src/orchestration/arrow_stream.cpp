@@ -0,0 +1,368 @@
+/**
+ * @file arrow_stream.cpp
+ * @brief Arrow IPC stream messages (Schema, RecordBatch) over columnar result files
+ */
+
+#include "orchestration/arrow_stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Arrow format constants (Schema.fbs, Message.fbs)
+constexpr int16_t METADATA_V5 = 4;
+constexpr uint8_t HEADER_SCHEMA = 1;
+constexpr uint8_t HEADER_RECORD_BATCH = 3;
+constexpr uint8_t TYPE_INT = 2;
+constexpr uint8_t TYPE_FLOATING_POINT = 3;
+constexpr int16_t PRECISION_DOUBLE = 2;
+constexpr uint32_t CONTINUATION = 0xFFFFFFFFu;
+
+static_assert(sizeof(ScenarioID) == 4 && sizeof(PeriodID) == 4, "Key columns are streamed as int32");
+
+/**
+ * @brief A flatbuffer written front to back
+ *
+ * Flatbuffer references only point forward, so parents are written before
+ * their children: a reference field is left as a slot and set by point()
+ * once the child has been written.
+ */
+class FlatWriter {
+public:
+    /// Scalar field (size 1, 2, 4 or 8), or a reference slot (size 0)
+    struct Field {
+        int id;
+        int size;
+        uint64_t bits = 0;
+    };
+
+    FlatWriter() : bytes_(4, 0) {}   // Root reference
+
+    /**
+     * @brief Write a table
+     * @param slots Receives the position of each reference field, in the order given
+     * @return Table position
+     */
+    size_t table(std::vector<Field> fields, std::vector<size_t>* slots = nullptr) {
+        int ids = 0;
+        for (const auto& field : fields) {
+            ids = std::max(ids, field.id + 1);
+        }
+        align(4);
+        const size_t vtable = bytes_.size();
+        put<uint16_t>(static_cast<uint16_t>(4 + 2 * ids));
+        put<uint16_t>(0);
+        for (int i = 0; i < ids; ++i) {
+            put<uint16_t>(0);
+        }
+
+        align(4);
+        const size_t start = bytes_.size();
+        put<int32_t>(static_cast<int32_t>(start - vtable));
+
+        // Widest first: least padding
+        std::vector<size_t> order(fields.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return width(fields[a]) > width(fields[b]);
+        });
+        std::vector<size_t> positions(fields.size());
+        for (size_t i : order) {
+            const auto& field = fields[i];
+            align(width(field));
+            positions[i] = bytes_.size();
+            set<uint16_t>(vtable + 4 + 2 * static_cast<size_t>(field.id), static_cast<uint16_t>(positions[i] - start));
+            const uint64_t bits = field.bits;
+            for (int b = 0; b < width(field); ++b) {
+                bytes_.push_back(static_cast<uint8_t>(bits >> (8 * b)));
+            }
+        }
+        set<uint16_t>(vtable + 2, static_cast<uint16_t>(bytes_.size() - start));
+
+        if (slots) {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (fields[i].size == 0) {
+                    slots->push_back(positions[i]);
+                }
+            }
+        }
+        return start;
+    }
+
+    /**
+     * @brief Write a vector of references (set each slot with point())
+     */
+    size_t reference_vector(size_t count, std::vector<size_t>& slots) {
+        align(4);
+        const size_t start = bytes_.size();
+        put<uint32_t>(static_cast<uint32_t>(count));
+        for (size_t i = 0; i < count; ++i) {
+            slots.push_back(bytes_.size());
+            put<uint32_t>(0);
+        }
+        return start;
+    }
+
+    /**
+     * @brief Write a vector of structs made of int64 fields
+     * @param fields_per_struct int64 fields of each struct
+     */
+    size_t struct_vector(const std::vector<int64_t>& values, size_t fields_per_struct) {
+        // Elements 8-aligned, after the 4-byte length
+        while (bytes_.size() % 8 != 4) {
+            bytes_.push_back(0);
+        }
+        const size_t start = bytes_.size();
+        put<uint32_t>(static_cast<uint32_t>(values.size() / fields_per_struct));
+        for (int64_t value : values) {
+            put<int64_t>(value);
+        }
+        return start;
+    }
+
+    size_t string(const std::string& text) {
+        align(4);
+        const size_t start = bytes_.size();
+        put<uint32_t>(static_cast<uint32_t>(text.size()));
+        bytes_.insert(bytes_.end(), text.begin(), text.end());
+        bytes_.push_back(0);
+        return start;
+    }
+
+    /// Set a reference slot to an object written after it
+    void point(size_t slot, size_t target) {
+        set<uint32_t>(slot, static_cast<uint32_t>(target - slot));
+    }
+
+    /// Finish with the root table
+    std::string finish(size_t root) {
+        point(0, root);
+        return std::string(bytes_.begin(), bytes_.end());
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+
+    static int width(const Field& field) { return field.size == 0 ? 4 : field.size; }
+
+    void align(size_t alignment) {
+        while (bytes_.size() % alignment != 0) {
+            bytes_.push_back(0);
+        }
+    }
+
+    template <typename T>
+    void put(T value) {
+        const size_t at = bytes_.size();
+        bytes_.resize(at + sizeof(T));
+        std::memcpy(bytes_.data() + at, &value, sizeof(T));
+    }
+
+    template <typename T>
+    void set(size_t at, T value) {
+        std::memcpy(bytes_.data() + at, &value, sizeof(T));
+    }
+};
+
+uint64_t bits_of(int64_t value) {
+    return static_cast<uint64_t>(value);
+}
+
+/**
+ * @brief Message table around a header written by write_header
+ */
+template <typename WriteHeader>
+std::string metadata_message(uint8_t header_type, int64_t body_length, WriteHeader write_header) {
+    FlatWriter fb;
+    std::vector<size_t> slots;
+    const size_t root = fb.table({{0, 2, static_cast<uint16_t>(METADATA_V5)},
+                                  {1, 1, header_type},
+                                  {2, 0},
+                                  {3, 8, bits_of(body_length)}}, &slots);
+    fb.point(slots[0], write_header(fb));
+    return fb.finish(root);
+}
+
+std::string schema_message(const std::vector<std::string>& line_items) {
+    return metadata_message(HEADER_SCHEMA, 0, [&](FlatWriter& fb) {
+        std::vector<size_t> schema_slots;
+        const size_t schema = fb.table({{1, 0}}, &schema_slots);   // Endianness: Little (default)
+
+        std::vector<std::string> names = {"scenario_id", "period_id"};
+        names.insert(names.end(), line_items.begin(), line_items.end());
+        std::vector<size_t> field_slots;
+        fb.point(schema_slots[0], fb.reference_vector(names.size(), field_slots));
+
+        for (size_t i = 0; i < names.size(); ++i) {
+            const bool key = i < 2;
+            std::vector<size_t> slots;
+            const size_t field = fb.table({{0, 0},                                          // name
+                                           {1, 1, key ? 0u : 1u},                           // nullable
+                                           {2, 1, key ? TYPE_INT : TYPE_FLOATING_POINT},    // type_type
+                                           {3, 0},                                          // type
+                                           {5, 0}}, &slots);                                // children
+            fb.point(field_slots[i], field);
+            fb.point(slots[0], fb.string(names[i]));
+            fb.point(slots[1], key ? fb.table({{0, 4, 32}, {1, 1, 1}})                    // Int(32, signed)
+                                   : fb.table({{0, 2, static_cast<uint16_t>(PRECISION_DOUBLE)}}));
+            std::vector<size_t> none;
+            fb.point(slots[2], fb.reference_vector(0, none));
+        }
+        return schema;
+    });
+}
+
+/**
+ * @brief Framed message: continuation, metadata size, metadata padded to 8 bytes, body
+ */
+std::string encapsulate(const std::string& metadata, const std::string& body) {
+    const size_t padded = (metadata.size() + 7) / 8 * 8;
+    std::string out;
+    out.reserve(8 + padded + body.size());
+    const uint32_t continuation = CONTINUATION;
+    const int32_t size = static_cast<int32_t>(padded);
+    out.append(reinterpret_cast<const char*>(&continuation), 4);
+    out.append(reinterpret_cast<const char*>(&size), 4);
+    out += metadata;
+    out.append(padded - metadata.size(), '\0');
+    out += body;
+    return out;
+}
+
+/**
+ * @brief Record batch body and its nodes/buffers
+ */
+class BatchBody {
+public:
+    template <typename T>
+    void key_column(const std::vector<T>& values) {
+        nodes_.insert(nodes_.end(), {static_cast<int64_t>(values.size()), 0});
+        add_buffer("");
+        add_buffer(std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)));
+    }
+
+    void value_column(const std::vector<double>& values) {
+        std::string validity((values.size() + 7) / 8, '\0');
+        int64_t nulls = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (std::isnan(values[i])) {
+                ++nulls;
+            } else {
+                validity[i / 8] = static_cast<char>(validity[i / 8] | (1 << (i % 8)));
+            }
+        }
+        nodes_.insert(nodes_.end(), {static_cast<int64_t>(values.size()), nulls});
+        add_buffer(nulls == 0 ? std::string() : validity);   // No bitmap: all valid
+        add_buffer(std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double)));
+    }
+
+    std::string encode(int64_t rows) const {
+        const std::string metadata = metadata_message(HEADER_RECORD_BATCH, static_cast<int64_t>(body_.size()),
+            [&](FlatWriter& fb) {
+                std::vector<size_t> slots;
+                const size_t batch = fb.table({{0, 8, bits_of(rows)}, {1, 0}, {2, 0}}, &slots);
+                fb.point(slots[0], fb.struct_vector(nodes_, 2));
+                fb.point(slots[1], fb.struct_vector(buffers_, 2));
+                return batch;
+            });
+        return encapsulate(metadata, body_);
+    }
+
+private:
+    std::string body_;
+    std::vector<int64_t> nodes_;     ///< (length, null_count) per column
+    std::vector<int64_t> buffers_;   ///< (offset, length) per buffer
+
+    void add_buffer(const std::string& bytes) {
+        buffers_.insert(buffers_.end(), {static_cast<int64_t>(body_.size()), static_cast<int64_t>(bytes.size())});
+        body_ += bytes;
+        body_.append((8 - body_.size() % 8) % 8, '\0');
+    }
+};
+
+template <typename Id>
+bool keep(const std::vector<Id>& sorted, Id id) {
+    return sorted.empty() || std::binary_search(sorted.begin(), sorted.end(), id);
+}
+
+} // namespace
+
+size_t ArrowResultStream::write(const ColumnarResultReader& reader, const ArrowResultQuery& query, const Sink& sink) {
+    const std::vector<std::string>& line_items = query.line_items.empty() ? reader.line_items() : query.line_items;
+    for (const auto& code : line_items) {
+        if (std::find(reader.line_items().begin(), reader.line_items().end(), code) == reader.line_items().end()) {
+            throw std::out_of_range("ArrowResultStream: no line item '" + code + "'");
+        }
+    }
+    auto scenarios = query.scenario_ids;
+    auto periods = query.period_ids;
+    std::sort(scenarios.begin(), scenarios.end());
+    std::sort(periods.begin(), periods.end());
+
+    if (!sink(encapsulate(schema_message(line_items), ""))) {
+        return 0;
+    }
+
+    size_t written = 0;
+    for (size_t group = 0; group < reader.row_group_count(); ++group) {
+        ColumnarBlock block = reader.read_group(group, line_items);
+
+        // Matching rows only
+        std::vector<size_t> rows;
+        for (size_t row = 0; row < block.size(); ++row) {
+            if (keep(scenarios, block.scenario_ids[row]) && keep(periods, block.period_ids[row])) {
+                rows.push_back(row);
+            }
+        }
+        if (rows.empty()) {
+            continue;
+        }
+        if (rows.size() < block.size()) {
+            auto select = [&rows](auto& column) {
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    column[i] = column[rows[i]];
+                }
+                column.resize(rows.size());
+            };
+            select(block.scenario_ids);
+            select(block.period_ids);
+            for (auto& column : block.columns) {
+                select(column);
+            }
+        }
+
+        BatchBody body;
+        body.key_column(block.scenario_ids);
+        body.key_column(block.period_ids);
+        for (const auto& column : block.columns) {
+            body.value_column(column);
+        }
+        if (!sink(body.encode(static_cast<int64_t>(rows.size())))) {
+            return written;
+        }
+        written += rows.size();
+    }
+
+    const uint32_t end[2] = {CONTINUATION, 0};
+    sink(std::string(reinterpret_cast<const char*>(end), sizeof(end)));
+    return written;
+}
+
+std::string ArrowResultStream::to_string(const ColumnarResultReader& reader, const ArrowResultQuery& query) {
+    std::string out;
+    write(reader, query, [&out](const std::string& bytes) {
+        out += bytes;
+        return true;
+    });
+    return out;
+}
+
+} // namespace orchestration
+} // namespace finmodel
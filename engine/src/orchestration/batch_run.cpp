@@ -0,0 +1,400 @@
+/**
+ * @file batch_run.cpp
+ * @brief Manifest-driven batch runs
+ */
+
+#include "orchestration/batch_run.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/deferred_validation.h"
+#include "orchestration/delta_results.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/result_writer.h"
+#include "database/database_factory.h"
+#include "database/input_snapshot.h"
+#include "core/numa_topology.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+namespace {
+
+/// IDs as an array, a range string ("1-10,12") or a {"first", "count"} generator
+std::vector<int> ids_from(const json& value, const char* field) {
+    if (value.is_array()) {
+        return value.get<std::vector<int>>();
+    }
+    if (value.is_string()) {
+        return RunManifest::parse_ids(value.get<std::string>());
+    }
+    if (value.is_object()) {
+        const int first = value.at("first").get<int>();
+        const int count = value.at("count").get<int>();
+        if (count < 0) {
+            throw std::invalid_argument(std::string("Run manifest: ") + field + ".count must not be negative");
+        }
+        std::vector<int> ids(static_cast<size_t>(count));
+        for (int i = 0; i < count; ++i) {
+            ids[static_cast<size_t>(i)] = first + i;
+        }
+        return ids;
+    }
+    throw std::invalid_argument(std::string("Run manifest: ") + field + " must be an array, a range or a generator");
+}
+
+std::string entity_path(const std::string& pattern, const EntityID& entity_id) {
+    std::string path = pattern;
+    const size_t placeholder = path.find("{entity}");
+    if (placeholder != std::string::npos) {
+        path.replace(placeholder, 8, entity_id);
+    }
+    return path;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+// ============================================================================
+// RunManifest
+// ============================================================================
+
+std::vector<int> RunManifest::parse_ids(const std::string& text) {
+    std::vector<int> ids;
+    std::istringstream in(text);
+    std::string item;
+    try {
+        while (std::getline(in, item, ',')) {
+            const size_t dash = item.find('-', 1);
+            if (dash == std::string::npos) {
+                ids.push_back(std::stoi(item));
+            } else {
+                const int last = std::stoi(item.substr(dash + 1));
+                for (int id = std::stoi(item.substr(0, dash)); id <= last; ++id) {
+                    ids.push_back(id);
+                }
+            }
+        }
+    } catch (const std::logic_error&) {
+        throw std::invalid_argument("Malformed ID list: " + text);
+    }
+    return ids;
+}
+
+RunManifest RunManifest::from_json(const std::string& text) {
+    RunManifest manifest;
+    try {
+        const json j = json::parse(text);
+        if (!j.is_object()) {
+            throw std::invalid_argument("Run manifest must be a JSON object");
+        }
+        manifest.database = j.at("database").get<std::string>();
+        manifest.template_code = j.at("template").get<std::string>();
+        if (j.contains("entities")) {
+            manifest.entities = j["entities"].get<std::vector<EntityID>>();
+        } else {
+            manifest.entities.push_back(j.at("entity").get<std::string>());
+        }
+        manifest.scenario_ids = ids_from(j.at("scenarios"), "scenarios");
+        manifest.period_ids = ids_from(j.at("periods"), "periods");
+        if (j.contains("opening")) {
+            manifest.opening_balances = j["opening"].get<std::map<std::string, double>>();
+        }
+        if (j.contains("validation")) {
+            manifest.validation = unified::ValidationPolicy::from_json(j["validation"].dump());
+        }
+        if (j.contains("outputs")) {
+            manifest.outputs = j["outputs"].get<std::vector<std::string>>();
+        }
+        if (j.contains("output")) {
+            const json& output = j["output"];
+            const std::string type = output.value("type", "none");
+            if (type == "columnar") {
+                manifest.output = BatchOutput::COLUMNAR;
+                manifest.output_path = output.at("path").get<std::string>();
+            } else if (type == "delta") {
+                manifest.output = BatchOutput::DELTA;
+                manifest.output_path = output.at("path").get<std::string>();
+            } else if (type == "database") {
+                manifest.output = BatchOutput::DATABASE;
+                manifest.output_path = output.value("path", "");
+            } else if (type != "none") {
+                throw std::invalid_argument("Run manifest: output type must be columnar, delta, database or none, not " +
+                                            type);
+            }
+        }
+        if (j.contains("precision")) {
+            const json& precision = j["precision"];
+            if (precision.is_string()) {
+                const std::string name = precision.get<std::string>();
+                if (name != "float32" && name != "double") {
+                    throw std::invalid_argument("Run manifest: precision must be float32 or double, not " + name);
+                }
+                manifest.precision.float32 = (name == "float32");
+            } else {
+                manifest.precision.float32 = true;
+                if (precision.contains("float32")) {
+                    manifest.precision.float32_items = precision["float32"].get<std::set<std::string>>();
+                }
+                if (precision.contains("double")) {
+                    const auto kept = precision["double"].get<std::set<std::string>>();
+                    manifest.precision.double_items.insert(kept.begin(), kept.end());
+                }
+            }
+        }
+        if (j.contains("snapshot")) {
+            const json& snapshot = j["snapshot"];
+            manifest.snapshot_path = snapshot.is_boolean()
+                ? (snapshot.get<bool>() ? manifest.database + ".inputs" : "")
+                : snapshot.get<std::string>();
+        }
+        manifest.in_memory = j.value("in_memory", manifest.in_memory);
+        manifest.result_cache_dir = j.value("result_cache", "");
+        manifest.threads = j.value("threads", manifest.threads);
+        manifest.numa = j.value("numa", manifest.numa);
+        manifest.jobs_per_chunk = j.value("jobs_per_chunk", manifest.jobs_per_chunk);
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("Run manifest: ") + e.what());
+    }
+    manifest.validate();
+    return manifest;
+}
+
+RunManifest RunManifest::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::invalid_argument("Run manifest: can't read " + path);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return from_json(text.str());
+}
+
+void RunManifest::validate() const {
+    if (database.empty() || template_code.empty()) {
+        throw std::invalid_argument("Run manifest: database and template must not be empty");
+    }
+    if (entities.empty() || scenario_ids.empty() || period_ids.empty()) {
+        throw std::invalid_argument("Run manifest: entities, scenarios and periods must not be empty");
+    }
+    if (jobs_per_chunk == 0) {
+        throw std::invalid_argument("Run manifest: jobs_per_chunk must be at least 1");
+    }
+    if ((output == BatchOutput::COLUMNAR || output == BatchOutput::DELTA) && entities.size() > 1 &&
+        output_path.find("{entity}") == std::string::npos) {
+        throw std::invalid_argument("Run manifest: a file output of several entities needs {entity} in its path");
+    }
+    if (!snapshot_path.empty() && (snapshot_path == database || snapshot_path == output_path)) {
+        throw std::invalid_argument("Run manifest: snapshot must not replace the database or the output");
+    }
+}
+
+// ============================================================================
+// BatchSummary
+// ============================================================================
+
+std::string BatchSummary::report() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Runs:        " << runs << " (" << failed_runs << " failed)\n"
+        << "Periods:     " << periods << "\n"
+        << "Line items:  " << line_items << "\n"
+        << "Rows stored: " << rows_written << "\n"
+        << "Snapshot:    " << snapshot_seconds << " s\n"
+        << "Run:         " << run_seconds << " s\n";
+    if (write_back_seconds > 0.0) {
+        out << "Write-back:  " << write_back_seconds << " s\n";
+    }
+    if (numa_nodes > 1) {
+        out << "NUMA nodes:  " << numa_nodes << " (" << stolen_remote << " jobs stolen across nodes)\n";
+    }
+    out << std::setprecision(1)
+        << "Throughput:  " << runs_per_second() << " runs/s, " << line_items_per_second() << " line items/s\n";
+    if (deferred_checks > 0) {
+        out << "Deferred validation: " << deferred_checks << " checks, " << deferred_failures << " failed\n";
+    }
+    if (!first_error.empty()) {
+        out << "First error: " << first_error.substr(0, first_error.find('\n')) << "\n";
+    }
+    return out.str();
+}
+
+// ============================================================================
+// BatchRunner
+// ============================================================================
+
+BatchRunner::BatchRunner(RunManifest manifest) : manifest_(std::move(manifest)) {
+    manifest_.validate();
+}
+
+BatchSummary BatchRunner::run() {
+    const RunManifest& m = manifest_;
+    BatchSummary summary;
+
+    // Workers read a memory-mapped copy of the inputs: no locks next to the writer
+    const auto snapshot_start = std::chrono::steady_clock::now();
+    PeriodRunner::ConnectionFactory connect;
+    if (!m.snapshot_path.empty()) {
+        database::InputSnapshot::compile(m.database, m.snapshot_path, m.scenario_ids);
+        const std::string path = m.snapshot_path;
+        connect = [path] { return database::InputSnapshot::open(path); };
+    } else {
+        const std::string path = m.database;
+        connect = [path] { return database::DatabaseFactory::create_sqlite(path); };
+    }
+
+    // Or read it from memory, every worker on the same copy; DATABASE results are written back once at the end
+    std::shared_ptr<database::IDatabase> working_copy;
+    if (m.in_memory) {
+        database::WorkingCopyOptions copy;
+        copy.write_back = {"run_log", "unified_result"};
+        copy.target = m.database;
+        copy.shared_name = "batch_run_" + std::to_string(reinterpret_cast<std::uintptr_t>(this));
+        working_copy = database::DatabaseFactory::create_working_copy(
+            m.snapshot_path.empty() ? m.database : m.snapshot_path, copy);
+        const std::string uri = copy.uri();
+        connect = [uri] { return database::DatabaseFactory::create_sqlite(uri); };
+    }
+    summary.snapshot_seconds = seconds_since(snapshot_start);
+
+    const auto run_start = std::chrono::steady_clock::now();
+    // FX rates and units read once for every worker, from the snapshot when there is one
+    auto runner_db = connect();
+    PeriodRunner runner(runner_db, std::make_shared<core::ReferenceDataStore>(runner_db));
+    runner.set_validation_policy(m.validation);
+    if (m.threads != 1) {
+        runner.set_scenario_parallel(m.threads, connect);
+        if (m.numa) {
+            // Page cache pages sit on the node that read them first: one file per node
+            PeriodRunner::NodeConnectionFactory connect_node;
+            const size_t nodes = core::NumaTopology::system().node_count();
+            if (!m.snapshot_path.empty() && !m.in_memory && nodes > 1) {
+                std::vector<std::string> replicas = {m.snapshot_path};
+                for (size_t node = 1; node < nodes; ++node) {
+                    replicas.push_back(m.snapshot_path + ".node" + std::to_string(node));
+                    std::filesystem::copy_file(m.snapshot_path, replicas.back(),
+                                               std::filesystem::copy_options::overwrite_existing);
+                }
+                connect_node = [replicas](size_t node) {
+                    return database::InputSnapshot::open(replicas[node % replicas.size()]);
+                };
+            }
+            runner.set_numa_placement(true, connect_node);
+        }
+    }
+    if (!m.outputs.empty()) {
+        runner.set_output_selection(m.outputs);
+    }
+    if (!m.result_cache_dir.empty()) {
+        runner.set_result_cache(std::make_shared<ResultCache>(m.result_cache_dir));
+    }
+    std::shared_ptr<ResultWriter> writer;
+    if (m.output == BatchOutput::DATABASE) {
+        writer = std::make_shared<ResultWriter>(
+            !m.output_path.empty() ? database::DatabaseFactory::create_sqlite(m.output_path)
+            : working_copy         ? connect()
+                                   : database::DatabaseFactory::create_sqlite(m.database),
+            100000,
+            !working_copy);  // Its own connection: unified_result is indexed once, after the batch
+        runner.set_result_writer(writer);
+    }
+
+    BalanceSheet opening{};
+    opening.line_items = m.opening_balances;
+    std::vector<std::string> columnar_files;
+    for (const EntityID& entity_id : m.entities) {
+        std::unique_ptr<ColumnarResultWriter> columnar;
+        if (m.output == BatchOutput::COLUMNAR) {
+            columnar = std::make_unique<ColumnarResultWriter>(entity_path(m.output_path, entity_id), 8192, m.precision);
+        }
+        std::unique_ptr<DeltaResultSet> deltas;   // DELTA: created from the first scenario
+        for (size_t begin = 0; begin < m.scenario_ids.size(); begin += m.jobs_per_chunk) {
+            const size_t end = std::min(begin + m.jobs_per_chunk, m.scenario_ids.size());
+            std::vector<ScenarioJob> jobs;
+            jobs.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                jobs.push_back(ScenarioJob{entity_id, m.scenario_ids[i]});
+            }
+            auto results = runner.run_jobs(jobs, m.period_ids, opening, m.template_code);
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                ++summary.runs;
+                if (!results[i].success) {
+                    ++summary.failed_runs;
+                    if (summary.first_error.empty() && !results[i].errors.empty()) {
+                        summary.first_error = results[i].errors.front();
+                    }
+                }
+                summary.periods += results[i].results.size();
+                for (const auto& period : results[i].results) {
+                    summary.line_items += period.line_items.size();
+                }
+                if (columnar) {
+                    columnar->append(jobs[i].scenario_id, m.period_ids, results[i]);
+                } else if (m.output == BatchOutput::DELTA) {
+                    if (!deltas) {
+                        deltas = std::make_unique<DeltaResultSet>(m.period_ids, results[i], jobs[i].scenario_id);
+                    } else {
+                        deltas->add(jobs[i].scenario_id, results[i]);
+                    }
+                    summary.rows_written += results[i].results.size();
+                }
+            }
+            if (progress_) {
+                summary.run_seconds = seconds_since(run_start);
+                progress_(summary);
+            }
+        }
+        if (columnar) {
+            const ColumnarFileInfo info = columnar->close();
+            summary.rows_written += info.rows;
+            columnar_files.push_back(info.path);
+        }
+        if (deltas) {
+            deltas->save(entity_path(m.output_path, entity_id));
+        }
+    }
+    if (writer) {
+        writer->flush();
+        summary.rows_written = writer->stats().rows;
+    }
+    summary.run_seconds = seconds_since(run_start);
+    if (m.numa && m.threads != 1) {
+        summary.numa_nodes = core::NumaTopology::system().node_count();
+        summary.stolen_remote = runner.scenario_stats().stolen_remote;
+    }
+    if (working_copy) {
+        const auto write_back_start = std::chrono::steady_clock::now();
+        working_copy->flush();
+        summary.write_back_seconds = seconds_since(write_back_start);
+    }
+
+    if (m.validation.mode == unified::ValidationMode::DEFERRED) {
+        auto rules_db = connect();
+        for (const auto& file : columnar_files) {
+            const auto report = validate_columnar(rules_db, ColumnarResultReader(file), m.template_code,
+                                                  m.validation.skip_warnings);
+            summary.deferred_checks += report.checks();
+            for (const auto& rule : report.rules) {
+                summary.deferred_failures += rule.failed;
+            }
+        }
+    }
+    return summary;
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,121 @@
+/**
+ * @file budgeted_results.cpp
+ * @brief Byte accounting and spilling of scenario results
+ */
+
+#include "orchestration/budgeted_results.h"
+#include "core/engine_metrics.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+size_t string_bytes(const std::vector<std::string>& messages) {
+    size_t bytes = messages.capacity() * sizeof(std::string);
+    for (const auto& message : messages) {
+        bytes += message.capacity() > 15 ? message.capacity() + 1 : 0;   // Beyond the small-string buffer
+    }
+    return bytes;
+}
+
+} // namespace
+
+BudgetedResults::BudgetedResults(std::vector<PeriodID> period_ids, ResultBudget budget, ResultAggregator statistics)
+    : period_ids_(std::move(period_ids)), budget_(std::move(budget)), statistics_(std::move(statistics)) {
+    if (budget_.memory_bytes > 0 && budget_.spill_path.empty()) {
+        throw std::invalid_argument("BudgetedResults: a memory budget needs a spill path");
+    }
+}
+
+BudgetedResults::~BudgetedResults() {
+    if (writer_ && !closed_) {
+        try {
+            writer_->close();
+        } catch (...) {
+        }
+    }
+}
+
+size_t BudgetedResults::bytes(const MultiPeriodResults& results) {
+    size_t bytes = sizeof(MultiPeriodResults) + results.results.capacity() * sizeof(unified::UnifiedResult) +
+                   string_bytes(results.errors) + results.warnings.memory_bytes() +
+                   results.horizon.size() * (sizeof(std::string) + sizeof(double) + 32);
+    for (const auto& result : results.results) {
+        bytes += result.line_items.values().capacity() * sizeof(double) + string_bytes(result.errors) +
+                 result.warnings.memory_bytes();
+        for (const auto& tangent : result.sensitivities.tangents) {
+            bytes += sizeof(core::LaneArray) + static_cast<size_t>(tangent.size()) * sizeof(double);
+        }
+    }
+    return bytes;
+}
+
+void BudgetedResults::add(ScenarioID scenario_id, MultiPeriodResults&& results) {
+    if (closed_) {
+        throw std::invalid_argument("BudgetedResults: closed");
+    }
+    if (!added_.insert(scenario_id).second) {
+        throw std::invalid_argument("BudgetedResults: scenario " + std::to_string(scenario_id) + " added twice");
+    }
+    statistics_.add(results, period_ids_);
+
+    const size_t size = bytes(results);
+    resident_sizes_[scenario_id] = size;
+    resident_.emplace(scenario_id, std::move(results));
+    resident_bytes_ += size;
+    peak_bytes_ = std::max(peak_bytes_, resident_bytes_);
+    if (budget_.memory_bytes > 0 && resident_bytes_ > budget_.memory_bytes) {
+        spill();
+    }
+}
+
+void BudgetedResults::spill() {
+    if (!writer_) {
+        writer_ = std::make_unique<ColumnarResultWriter>(budget_.spill_path, budget_.rows_per_group,
+                                                         budget_.precision);
+    }
+    size_t spilled_bytes = 0;
+    for (auto& [scenario_id, results] : resident_) {
+        writer_->append(scenario_id, period_ids_, results);
+        SpilledScenario summary;
+        summary.scenario_id = scenario_id;
+        summary.periods = results.results.size();
+        summary.bytes = resident_sizes_.at(scenario_id);
+        summary.success = results.success;
+        summary.errors = std::move(results.errors);
+        spilled_bytes += summary.bytes;
+        spilled_.push_back(std::move(summary));
+    }
+    core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_SPILLED_SCENARIOS, resident_.size());
+    core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_SPILLED_BYTES, spilled_bytes);
+    spilled_bytes_ += spilled_bytes;
+    resident_.clear();
+    resident_sizes_.clear();
+    resident_bytes_ = 0;
+}
+
+std::optional<ColumnarFileInfo> BudgetedResults::close() {
+    if (closed_) {
+        throw std::runtime_error("BudgetedResults: already closed");
+    }
+    closed_ = true;
+    if (!writer_) {
+        return std::nullopt;
+    }
+    return writer_->close();
+}
+
+std::map<ScenarioID, MultiPeriodResults> BudgetedResults::take_resident() {
+    std::map<ScenarioID, MultiPeriodResults> taken;
+    taken.swap(resident_);
+    resident_sizes_.clear();
+    resident_bytes_ = 0;
+    return taken;
+}
+
+} // namespace orchestration
+} // namespace finmodel
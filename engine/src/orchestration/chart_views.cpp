@@ -0,0 +1,280 @@
+/**
+ * @file chart_views.cpp
+ * @brief Fan charts, LTTB downsampling and yearly aggregation of result columns
+ */
+
+#include "orchestration/chart_views.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+namespace {
+
+/**
+ * @brief Periods and values of one scenario, by period
+ */
+std::vector<std::pair<PeriodID, double>> scenario_rows(const ColumnarResultReader& reader, const std::string& code,
+                                                       ScenarioID scenario_id) {
+    const ColumnarSeries series = reader.read(code);
+    std::vector<std::pair<PeriodID, double>> rows;
+    for (size_t i = 0; i < series.size(); ++i) {
+        if (series.scenario_ids[i] == scenario_id && !std::isnan(series.values[i])) {
+            rows.emplace_back(series.period_ids[i], series.values[i]);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+} // namespace
+
+YearAggregate year_aggregate_from_string(const std::string& name) {
+    if (name == "sum") return YearAggregate::SUM;
+    if (name == "last") return YearAggregate::LAST;
+    if (name == "mean") return YearAggregate::MEAN;
+    throw std::invalid_argument("Unknown year aggregate '" + name + "' (sum, last or mean)");
+}
+
+std::string FanChart::to_json() const {
+    json j = {{"line_item", line_item}, {"quantiles", quantiles}, {"period_ids", period_ids},
+              {"bands", bands}, {"scenarios", scenarios}};
+    return j.dump();
+}
+
+std::string ChartSeries::to_json() const {
+    json j = {{"line_item", line_item}, {"scenario_id", scenario_id}, {"x", x},
+              {"values", values}, {"source_points", source_points}};
+    return j.dump();
+}
+
+FanChart ChartViews::fan_chart(const ColumnarResultReader& reader, const std::string& code,
+                               std::vector<double> quantiles) {
+    for (double q : quantiles) {
+        if (!(q >= 0.0 && q <= 1.0)) {
+            throw std::invalid_argument("ChartViews: quantile " + std::to_string(q) + " outside [0, 1]");
+        }
+    }
+    std::sort(quantiles.begin(), quantiles.end());
+
+    FanChart fan;
+    fan.line_item = code;
+    fan.quantiles = quantiles;
+    const ColumnarSeries series = reader.read(code);
+
+    // Slot per period, then the values bucketed by slot (counting sort)
+    fan.period_ids = series.period_ids;
+    std::sort(fan.period_ids.begin(), fan.period_ids.end());
+    fan.period_ids.erase(std::unique(fan.period_ids.begin(), fan.period_ids.end()), fan.period_ids.end());
+    std::vector<uint32_t> slot(series.size());
+    std::vector<size_t> start(fan.period_ids.size() + 1, 0);
+    for (size_t i = 0; i < series.size(); ++i) {
+        slot[i] = static_cast<uint32_t>(
+            std::lower_bound(fan.period_ids.begin(), fan.period_ids.end(), series.period_ids[i]) -
+            fan.period_ids.begin());
+        if (!std::isnan(series.values[i])) {
+            ++start[slot[i] + 1];
+        }
+    }
+    for (size_t p = 0; p < fan.period_ids.size(); ++p) {
+        start[p + 1] += start[p];
+    }
+    std::vector<double> bucketed(start.back());
+    std::vector<size_t> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < series.size(); ++i) {
+        if (!std::isnan(series.values[i])) {
+            bucketed[fill[slot[i]]++] = series.values[i];
+        }
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    fan.bands.assign(quantiles.size(), std::vector<double>(fan.period_ids.size(), nan));
+    fan.scenarios.resize(fan.period_ids.size());
+    for (size_t p = 0; p < fan.period_ids.size(); ++p) {
+        double* values = bucketed.data() + start[p];
+        const size_t count = start[p + 1] - start[p];
+        fan.scenarios[p] = count;
+        if (count == 0) {
+            continue;
+        }
+        std::sort(values, values + count);
+        for (size_t q = 0; q < quantiles.size(); ++q) {
+            const double position = quantiles[q] * static_cast<double>(count - 1);
+            const size_t below = static_cast<size_t>(position);
+            const size_t above = std::min(below + 1, count - 1);
+            const double weight = position - static_cast<double>(below);
+            fan.bands[q][p] = values[below] + weight * (values[above] - values[below]);
+        }
+    }
+    return fan;
+}
+
+std::vector<size_t> ChartViews::lttb(const std::vector<double>& x, const std::vector<double>& y, size_t threshold) {
+    const size_t n = x.size();
+    std::vector<size_t> kept;
+    if (threshold < 3 || threshold >= n) {
+        kept.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            kept[i] = i;
+        }
+        return kept;
+    }
+
+    // First and last points fixed; the rest split into threshold - 2 buckets
+    kept.reserve(threshold);
+    kept.push_back(0);
+    const double bucket = static_cast<double>(n - 2) / static_cast<double>(threshold - 2);
+    size_t previous = 0;
+    for (size_t b = 0; b < threshold - 2; ++b) {
+        const size_t from = static_cast<size_t>(std::floor(b * bucket)) + 1;
+        const size_t to = std::min(static_cast<size_t>(std::floor((b + 1) * bucket)) + 1, n - 1);
+
+        // Third corner: average of the next bucket (the last point after the last bucket)
+        const size_t next_from = to;
+        const size_t next_to = std::min(static_cast<size_t>(std::floor((b + 2) * bucket)) + 1, n);
+        double average_x = 0.0;
+        double average_y = 0.0;
+        for (size_t i = next_from; i < next_to; ++i) {
+            average_x += x[i];
+            average_y += y[i];
+        }
+        const double count = static_cast<double>(std::max<size_t>(1, next_to - next_from));
+        average_x /= count;
+        average_y /= count;
+
+        // Point of the bucket forming the largest triangle with the previous pick
+        double largest = -1.0;
+        size_t pick = from;
+        for (size_t i = from; i < to; ++i) {
+            const double area = std::abs((x[previous] - average_x) * (y[i] - y[previous]) -
+                                         (x[previous] - x[i]) * (average_y - y[previous]));
+            if (area > largest) {
+                largest = area;
+                pick = i;
+            }
+        }
+        kept.push_back(pick);
+        previous = pick;
+    }
+    kept.push_back(n - 1);
+    return kept;
+}
+
+ChartSeries ChartViews::downsample(const ColumnarResultReader& reader, const std::string& code,
+                                   ScenarioID scenario_id, size_t max_points) {
+    const auto rows = scenario_rows(reader, code, scenario_id);
+    std::vector<double> x(rows.size());
+    std::vector<double> y(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        x[i] = static_cast<double>(rows[i].first);
+        y[i] = rows[i].second;
+    }
+
+    ChartSeries series;
+    series.line_item = code;
+    series.scenario_id = scenario_id;
+    series.source_points = rows.size();
+    for (size_t i : lttb(x, y, max_points)) {
+        series.x.push_back(rows[i].first);
+        series.values.push_back(rows[i].second);
+    }
+    return series;
+}
+
+ChartSeries ChartViews::yearly(const ColumnarResultReader& reader, const std::string& code, ScenarioID scenario_id,
+                               const std::unordered_map<PeriodID, int>& year_of, YearAggregate aggregate) {
+    const auto rows = scenario_rows(reader, code, scenario_id);
+
+    // Periods in ID order: the year's last period is its last row
+    struct Year {
+        double sum = 0.0;
+        double last = 0.0;
+        size_t count = 0;
+    };
+    std::map<int, Year> years;
+    for (const auto& [period_id, value] : rows) {
+        auto found = year_of.find(period_id);
+        if (found == year_of.end()) {
+            continue;
+        }
+        Year& year = years[found->second];
+        year.sum += value;
+        year.last = value;
+        ++year.count;
+    }
+
+    ChartSeries series;
+    series.line_item = code;
+    series.scenario_id = scenario_id;
+    series.source_points = rows.size();
+    for (const auto& [year, totals] : years) {
+        series.x.push_back(year);
+        switch (aggregate) {
+            case YearAggregate::SUM: series.values.push_back(totals.sum); break;
+            case YearAggregate::LAST: series.values.push_back(totals.last); break;
+            case YearAggregate::MEAN: series.values.push_back(totals.sum / static_cast<double>(totals.count)); break;
+        }
+    }
+    return series;
+}
+
+// ============================================================================
+// ChartViewCache
+// ============================================================================
+
+std::string ChartViewCache::get(const std::string& key, const std::function<std::string()>& render) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = by_key_.find(key);
+        if (found != by_key_.end()) {
+            ++hits_;
+            entries_.splice(entries_.begin(), entries_, found->second);
+            return found->second->view;
+        }
+        ++misses_;
+    }
+
+    // Two requests for a new view may both render it; the second replaces the first
+    std::string view = render();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0) {
+        return view;
+    }
+    auto found = by_key_.find(key);
+    if (found != by_key_.end()) {
+        entries_.erase(found->second);
+        by_key_.erase(found);
+    }
+    entries_.push_front({key, view});
+    by_key_[key] = entries_.begin();
+    while (entries_.size() > capacity_) {
+        by_key_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+    return view;
+}
+
+size_t ChartViewCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t ChartViewCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+size_t ChartViewCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,563 @@
+/**
+ * @file columnar_results.cpp
+ * @brief Columnar result file writer and reader
+ *
+ * Layout:
+ *   "FMCR" u32 version
+ *   Row groups: scenario chunk, period chunk, one chunk per line item
+ *   Footer: code dictionary (version 2: each code followed by its precision
+ *           byte, 0 double, 1 float32), then per row group its row count and chunks
+ *   u64 footer offset, "FMCR"
+ *
+ * Key chunks hold zigzag varint deltas. Value chunks hold each double (or
+ * float32) XORed with the previous one: a header byte (leading zero bytes
+ * << 4 | trailing zero bytes), then the remaining middle bytes.
+ */
+
+#include "orchestration/columnar_results.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+constexpr char MAGIC[4] = {'F', 'M', 'C', 'R'};
+constexpr uint32_t FORMAT_VERSION = 2;   ///< 2: per line item precision
+constexpr uint8_t UNCHANGED = 0x80;   ///< Header of a value equal to the previous one
+
+// ----------------------------------------------------------------------------
+// Encoding
+// ----------------------------------------------------------------------------
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    const size_t at = out.size();
+    out.resize(at + sizeof(T));
+    std::memcpy(out.data() + at, &value, sizeof(T));
+}
+
+void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+std::vector<uint8_t> encode_keys(const std::vector<int>& keys) {
+    std::vector<uint8_t> out;
+    out.reserve(keys.size());
+    int64_t previous = 0;
+    for (int key : keys) {
+        int64_t delta = key - previous;
+        put_varint(out, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+        previous = key;
+    }
+    return out;
+}
+
+/// Bits (uint64_t for double, uint32_t for float32) XORed with the previous value's
+template <typename Bits, typename Value>
+std::vector<uint8_t> encode_xor(const std::vector<double>& values) {
+    constexpr int BYTES = sizeof(Bits);
+    std::vector<uint8_t> out;
+    out.reserve(values.size() * 2);
+    Bits previous = 0;
+    for (double value : values) {
+        const Bits bits = std::bit_cast<Bits>(static_cast<Value>(value));
+        const Bits x = bits ^ previous;
+        previous = bits;
+        if (x == 0) {
+            out.push_back(UNCHANGED);
+            continue;
+        }
+        const int leading = std::countl_zero(x) / 8;
+        const int trailing = std::countr_zero(x) / 8;
+        out.push_back(static_cast<uint8_t>(leading << 4 | trailing));
+        for (int byte = trailing; byte < BYTES - leading; ++byte) {
+            out.push_back(static_cast<uint8_t>(x >> (8 * byte)));
+        }
+    }
+    return out;
+}
+
+std::vector<uint8_t> encode_values(const std::vector<double>& values, bool float32) {
+    return float32 ? encode_xor<uint32_t, float>(values) : encode_xor<uint64_t, double>(values);
+}
+
+// ----------------------------------------------------------------------------
+// Decoding
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Bounds-checked cursor over a byte buffer
+ */
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    uint8_t byte() {
+        need(1);
+        return data_[pos_++];
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Columnar result file: malformed varint");
+    }
+
+    std::string string(size_t length) {
+        need(length);
+        std::string value(reinterpret_cast<const char*>(data_ + pos_), length);
+        pos_ += length;
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+
+    void need(size_t bytes) const {
+        if (size_ - pos_ < bytes) {
+            throw std::runtime_error("Columnar result file: truncated data");
+        }
+    }
+};
+
+std::vector<int> decode_keys(const std::vector<uint8_t>& bytes, size_t rows) {
+    ByteReader in(bytes.data(), bytes.size());
+    std::vector<int> keys(rows);
+    int64_t previous = 0;
+    for (auto& key : keys) {
+        uint64_t zigzag = in.varint();
+        previous += static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        key = static_cast<int>(previous);
+    }
+    return keys;
+}
+
+template <typename Bits, typename Value>
+std::vector<double> decode_xor(const std::vector<uint8_t>& bytes, size_t rows) {
+    constexpr int BYTES = sizeof(Bits);
+    ByteReader in(bytes.data(), bytes.size());
+    std::vector<double> values(rows);
+    Bits previous = 0;
+    for (auto& value : values) {
+        const uint8_t header = in.byte();
+        if (header != UNCHANGED) {
+            const int leading = header >> 4;
+            const int trailing = header & 0x0F;
+            if (leading + trailing >= BYTES) {
+                throw std::runtime_error("Columnar result file: malformed value chunk");
+            }
+            Bits x = 0;
+            for (int byte = trailing; byte < BYTES - leading; ++byte) {
+                x |= static_cast<Bits>(static_cast<Bits>(in.byte()) << (8 * byte));
+            }
+            previous ^= x;
+        }
+        value = static_cast<double>(std::bit_cast<Value>(previous));
+    }
+    return values;
+}
+
+std::vector<double> decode_values(const std::vector<uint8_t>& bytes, size_t rows, bool float32) {
+    return float32 ? decode_xor<uint32_t, float>(bytes, rows) : decode_xor<uint64_t, double>(bytes, rows);
+}
+
+void put_chunk(std::vector<uint8_t>& out, const ColumnarChunk& chunk) {
+    put(out, chunk.offset);
+    put(out, chunk.size);
+    put(out, chunk.min);
+    put(out, chunk.max);
+    put(out, chunk.nan_count);
+}
+
+ColumnarChunk get_chunk(ByteReader& in) {
+    ColumnarChunk chunk;
+    chunk.offset = in.get<uint64_t>();
+    chunk.size = in.get<uint64_t>();
+    chunk.min = in.get<double>();
+    chunk.max = in.get<double>();
+    chunk.nan_count = in.get<uint32_t>();
+    return chunk;
+}
+
+} // namespace
+
+// ============================================================================
+// ColumnarResultWriter
+// ============================================================================
+
+ColumnarResultWriter::ColumnarResultWriter(const std::string& path, size_t rows_per_group,
+                                           ResultPrecision precision)
+    : path_(path), file_(path, std::ios::binary | std::ios::trunc),
+      rows_per_group_(std::max<size_t>(1, rows_per_group)), precision_(std::move(precision))
+{
+    if (!file_) {
+        throw std::runtime_error("ColumnarResultWriter: cannot create " + path);
+    }
+    std::vector<uint8_t> header(MAGIC, MAGIC + 4);
+    put(header, FORMAT_VERSION);
+    write_chunk(header);
+}
+
+ColumnarResultWriter::~ColumnarResultWriter() {
+    if (!closed_) {
+        try {
+            close();
+        } catch (const std::exception&) {
+            // Destructors don't throw; the file is left incomplete
+        }
+    }
+}
+
+void ColumnarResultWriter::append(ScenarioID scenario_id, PeriodID period_id, const unified::ResultRow& values) {
+    if (closed_) {
+        throw std::runtime_error("ColumnarResultWriter: " + path_ + " is closed");
+    }
+
+    const size_t row = scenario_ids_.size();
+    scenario_ids_.push_back(scenario_id);
+    period_ids_.push_back(period_id);
+
+    for (const auto& [code, value] : values) {
+        auto [it, inserted] = code_index_.emplace(code, static_cast<uint32_t>(codes_.size()));
+        if (inserted) {
+            codes_.push_back(code);
+            float32_.push_back(precision_.is_float32(code) ? 1 : 0);
+            values_.emplace_back();
+        }
+        auto& column = values_[it->second];
+        column.resize(row, std::numeric_limits<double>::quiet_NaN());
+        column.push_back(value);
+    }
+    // Line items this row doesn't have
+    for (auto& column : values_) {
+        column.resize(row + 1, std::numeric_limits<double>::quiet_NaN());
+    }
+
+    ++rows_;
+    if (scenario_ids_.size() >= rows_per_group_) {
+        write_group();
+    }
+}
+
+void ColumnarResultWriter::append(ScenarioID scenario_id, const std::vector<PeriodID>& period_ids,
+                                  const MultiPeriodResults& results) {
+    if (results.results.size() > period_ids.size()) {
+        throw std::invalid_argument("ColumnarResultWriter: " + std::to_string(results.results.size()) +
+                                    " results for " + std::to_string(period_ids.size()) + " periods");
+    }
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        append(scenario_id, period_ids[p], results.results[p].get_all_values());
+    }
+}
+
+ColumnarChunk ColumnarResultWriter::write_chunk(const std::vector<uint8_t>& bytes) {
+    ColumnarChunk chunk;
+    chunk.offset = offset_;
+    chunk.size = bytes.size();
+    file_.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file_) {
+        throw std::runtime_error("ColumnarResultWriter: write to " + path_ + " failed");
+    }
+    offset_ += bytes.size();
+    return chunk;
+}
+
+void ColumnarResultWriter::write_group() {
+    if (scenario_ids_.empty()) {
+        return;
+    }
+
+    RowGroup group;
+    group.rows = static_cast<uint32_t>(scenario_ids_.size());
+    group.scenarios = write_chunk(encode_keys(scenario_ids_));
+    group.periods = write_chunk(encode_keys(period_ids_));
+
+    for (uint32_t index = 0; index < values_.size(); ++index) {
+        auto& column = values_[index];
+        if (float32_[index]) {
+            // Statistics of the values as they read back
+            for (double& value : column) {
+                value = static_cast<double>(static_cast<float>(value));
+            }
+        }
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        uint32_t nan_count = 0;
+        for (double value : column) {
+            if (std::isfinite(value)) {
+                min = std::min(min, value);
+                max = std::max(max, value);
+            } else {
+                ++nan_count;
+            }
+        }
+        if (nan_count < group.rows) {
+            // Line items no row of the group has get no chunk
+            ColumnarChunk chunk = write_chunk(encode_values(column, float32_[index] != 0));
+            chunk.min = min;
+            chunk.max = max;
+            chunk.nan_count = nan_count;
+            group.columns.emplace_back(index, chunk);
+        }
+        column.clear();
+    }
+
+    groups_.push_back(std::move(group));
+    scenario_ids_.clear();
+    period_ids_.clear();
+}
+
+ColumnarFileInfo ColumnarResultWriter::close() {
+    if (closed_) {
+        throw std::runtime_error("ColumnarResultWriter: " + path_ + " is already closed");
+    }
+    write_group();
+    closed_ = true;
+
+    std::vector<uint8_t> footer;
+    put(footer, static_cast<uint32_t>(codes_.size()));
+    for (size_t i = 0; i < codes_.size(); ++i) {
+        put(footer, static_cast<uint32_t>(codes_[i].size()));
+        footer.insert(footer.end(), codes_[i].begin(), codes_[i].end());
+        footer.push_back(float32_[i]);
+    }
+    put(footer, static_cast<uint32_t>(groups_.size()));
+    for (const auto& group : groups_) {
+        put(footer, group.rows);
+        put_chunk(footer, group.scenarios);
+        put_chunk(footer, group.periods);
+        put(footer, static_cast<uint32_t>(group.columns.size()));
+        for (const auto& [index, chunk] : group.columns) {
+            put(footer, index);
+            put_chunk(footer, chunk);
+        }
+    }
+    const uint64_t footer_offset = offset_;
+    put(footer, footer_offset);
+    footer.insert(footer.end(), MAGIC, MAGIC + 4);
+    write_chunk(footer);
+
+    file_.close();
+    if (!file_) {
+        throw std::runtime_error("ColumnarResultWriter: closing " + path_ + " failed");
+    }
+
+    ColumnarFileInfo info;
+    info.path = path_;
+    info.rows = rows_;
+    info.line_items = codes_.size();
+    info.row_groups = groups_.size();
+    info.bytes = offset_;
+    return info;
+}
+
+int64_t ColumnarResultWriter::record_snapshot(database::IDatabase& db, int64_t run_id,
+                                              const ColumnarFileInfo& info) {
+    std::ostringstream json;
+    json << "{\"rows\": " << info.rows << ", \"line_items\": " << info.line_items
+         << ", \"row_groups\": " << info.row_groups << ", \"format_version\": " << FORMAT_VERSION << "}";
+
+    db.execute_update(
+        "INSERT INTO run_output_snapshot (run_id, output_type, json_data, format, file_path, file_size_bytes) "
+        "VALUES (:run_id, 'results', :json_data, 'columnar', :file_path, :file_size_bytes)",
+        {
+            {"run_id", static_cast<int>(run_id)},
+            {"json_data", json.str()},
+            {"file_path", info.path},
+            {"file_size_bytes", static_cast<double>(info.bytes)}
+        }
+    );
+    return db.last_insert_id();
+}
+
+// ============================================================================
+// ColumnarResultReader
+// ============================================================================
+
+ColumnarResultReader::ColumnarResultReader(const std::string& path)
+    : file_(path, std::ios::binary)
+{
+    if (!file_) {
+        throw std::runtime_error("ColumnarResultReader: cannot open " + path);
+    }
+    const std::string not_columnar = "ColumnarResultReader: " + path + " is not a columnar result file";
+
+    // Tail: footer offset + magic
+    file_.seekg(0, std::ios::end);
+    const uint64_t size = static_cast<uint64_t>(file_.tellg());
+    constexpr uint64_t TAIL = sizeof(uint64_t) + 4;
+    if (size < 8 + TAIL) {
+        throw std::runtime_error(not_columnar);
+    }
+    ColumnarChunk tail;
+    tail.offset = size - TAIL;
+    tail.size = TAIL;
+    auto tail_bytes = read_chunk(tail);
+    if (std::memcmp(tail_bytes.data() + sizeof(uint64_t), MAGIC, 4) != 0) {
+        throw std::runtime_error(not_columnar);
+    }
+    ColumnarChunk header;
+    header.size = 8;
+    auto header_bytes = read_chunk(header);
+    uint32_t version = 0;
+    std::memcpy(&version, header_bytes.data() + 4, sizeof(uint32_t));
+    if (std::memcmp(header_bytes.data(), MAGIC, 4) != 0 || version == 0 || version > FORMAT_VERSION) {
+        throw std::runtime_error(not_columnar);
+    }
+
+    ColumnarChunk footer;
+    std::memcpy(&footer.offset, tail_bytes.data(), sizeof(uint64_t));
+    if (footer.offset < 8 || footer.offset > tail.offset) {
+        throw std::runtime_error(not_columnar);
+    }
+    footer.size = tail.offset - footer.offset;
+    auto footer_bytes = read_chunk(footer);
+
+    ByteReader in(footer_bytes.data(), footer_bytes.size());
+    const uint32_t code_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < code_count; ++i) {
+        codes_.push_back(in.string(in.get<uint32_t>()));
+        code_index_.emplace(codes_.back(), i);
+        float32_.push_back(version >= 2 ? in.byte() : 0);
+    }
+    const uint32_t group_count = in.get<uint32_t>();
+    groups_.resize(group_count);
+    for (auto& group : groups_) {
+        group.rows = in.get<uint32_t>();
+        group.scenarios = get_chunk(in);
+        group.periods = get_chunk(in);
+        const uint32_t columns = in.get<uint32_t>();
+        for (uint32_t c = 0; c < columns; ++c) {
+            uint32_t index = in.get<uint32_t>();
+            group.columns.emplace(index, get_chunk(in));
+        }
+        rows_ += group.rows;
+    }
+}
+
+std::vector<uint8_t> ColumnarResultReader::read_chunk(const ColumnarChunk& chunk) const {
+    std::vector<uint8_t> bytes(chunk.size);
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(chunk.offset));
+    file_.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(chunk.size));
+    if (!file_) {
+        throw std::runtime_error("ColumnarResultReader: truncated file");
+    }
+    bytes_read_ += chunk.size;
+    return bytes;
+}
+
+bool ColumnarResultReader::is_float32(const std::string& code) const {
+    auto found = code_index_.find(code);
+    if (found == code_index_.end()) {
+        throw std::out_of_range("ColumnarResultReader: no line item '" + code + "'");
+    }
+    return float32_[found->second] != 0;
+}
+
+ColumnarSeries ColumnarResultReader::read(const std::string& code) const {
+    return read_rows(code, false, 0.0, 0.0);
+}
+
+ColumnarSeries ColumnarResultReader::read_where(const std::string& code, double min_value, double max_value) const {
+    return read_rows(code, true, min_value, max_value);
+}
+
+ColumnarBlock ColumnarResultReader::read_group(size_t group, const std::vector<std::string>& codes) const {
+    if (group >= groups_.size()) {
+        throw std::out_of_range("ColumnarResultReader: no row group " + std::to_string(group));
+    }
+    std::vector<uint32_t> indexes;
+    indexes.reserve(codes.size());
+    for (const auto& code : codes) {
+        auto found = code_index_.find(code);
+        if (found == code_index_.end()) {
+            throw std::out_of_range("ColumnarResultReader: no line item '" + code + "'");
+        }
+        indexes.push_back(found->second);
+    }
+
+    const auto& rows = groups_[group];
+    ColumnarBlock block;
+    block.scenario_ids = decode_keys(read_chunk(rows.scenarios), rows.rows);
+    block.period_ids = decode_keys(read_chunk(rows.periods), rows.rows);
+    block.columns.reserve(indexes.size());
+    for (uint32_t index : indexes) {
+        auto column = rows.columns.find(index);
+        block.columns.push_back(column != rows.columns.end()
+            ? decode_values(read_chunk(column->second), rows.rows, float32_[index] != 0)
+            : std::vector<double>(rows.rows, std::numeric_limits<double>::quiet_NaN()));
+    }
+    return block;
+}
+
+ColumnarSeries ColumnarResultReader::read_rows(const std::string& code, bool filter,
+                                               double min_value, double max_value) const {
+    auto found = code_index_.find(code);
+    if (found == code_index_.end()) {
+        throw std::out_of_range("ColumnarResultReader: no line item '" + code + "'");
+    }
+
+    ColumnarSeries series;
+    if (!filter) {
+        series.scenario_ids.reserve(rows_);
+        series.period_ids.reserve(rows_);
+        series.values.reserve(rows_);
+    }
+
+    for (const auto& group : groups_) {
+        auto column = group.columns.find(found->second);
+        const bool has_chunk = (column != group.columns.end());
+        if (filter && (!has_chunk || column->second.nan_count == group.rows ||
+                       column->second.max < min_value || column->second.min > max_value)) {
+            continue;  // Statistics rule the whole group out
+        }
+
+        auto scenarios = decode_keys(read_chunk(group.scenarios), group.rows);
+        auto periods = decode_keys(read_chunk(group.periods), group.rows);
+        std::vector<double> values = has_chunk
+            ? decode_values(read_chunk(column->second), group.rows, float32_[found->second] != 0)
+            : std::vector<double>(group.rows, std::numeric_limits<double>::quiet_NaN());
+
+        for (uint32_t row = 0; row < group.rows; ++row) {
+            if (filter && !(values[row] >= min_value && values[row] <= max_value)) {
+                continue;
+            }
+            series.scenario_ids.push_back(scenarios[row]);
+            series.period_ids.push_back(periods[row]);
+            series.values.push_back(values[row]);
+        }
+    }
+    return series;
+}
+
+} // namespace orchestration
+} // namespace finmodel
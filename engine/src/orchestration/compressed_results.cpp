@@ -0,0 +1,359 @@
+/**
+ * @file compressed_results.cpp
+ * @brief XOR (Gorilla) encoding of result series
+ *
+ * A block is its first value's 64 bits, then per following value:
+ *   0                          same bits as the previous value
+ *   10 <bits>                  XOR fits the previous window: its meaningful bits
+ *   11 <6: leading zeros> <6: length - 1> <length bits>   a new window
+ * Leading zeros get six bits rather than Gorilla's five, so no XOR needs
+ * its window widened.
+ */
+
+#include "orchestration/compressed_results.h"
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+/// A NaN no calculation produces: the cell has no value (kept apart from calculated NaNs)
+constexpr uint64_t MISSING_BITS = 0x7FF80000000F4D15ULL;
+const double MISSING = std::bit_cast<double>(MISSING_BITS);
+
+/// Cells read by callers: missing ones are plain NaN
+double visible(double value) {
+    return std::bit_cast<uint64_t>(value) == MISSING_BITS ? std::numeric_limits<double>::quiet_NaN() : value;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint64_t>& words) : words_(words) {}
+
+    size_t position() const { return bits_; }
+
+    /// The low n bits of value (1 <= n <= 64), most significant first
+    void put(uint64_t value, unsigned n) {
+        if (n < 64) {
+            value &= (uint64_t{1} << n) - 1;
+        }
+        const unsigned used = static_cast<unsigned>(bits_ % 64);
+        if (used == 0) {
+            words_.push_back(0);
+        }
+        const unsigned room = 64 - used;
+        if (n <= room) {
+            words_.back() |= value << (room - n);
+        } else {
+            words_.back() |= value >> (n - room);
+            words_.push_back(value << (64 - (n - room)));
+        }
+        bits_ += n;
+    }
+
+private:
+    std::vector<uint64_t>& words_;
+    size_t bits_ = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const std::vector<uint64_t>& words, size_t position) : words_(words.data()), pos_(position) {}
+
+    /// The next n bits (1 <= n <= 64)
+    uint64_t get(unsigned n) {
+        const size_t word = pos_ / 64;
+        const unsigned used = static_cast<unsigned>(pos_ % 64);
+        uint64_t bits = words_[word] << used;
+        if (n > 64 - used) {
+            bits |= words_[word + 1] >> (64 - used);
+        }
+        pos_ += n;
+        return bits >> (64 - n);
+    }
+
+    bool bit() { return get(1) != 0; }
+
+private:
+    const uint64_t* words_;
+    size_t pos_;
+};
+
+void encode_block(BitWriter& out, const double* values, size_t count) {
+    uint64_t previous = std::bit_cast<uint64_t>(values[0]);
+    out.put(previous, 64);
+    unsigned leading = 65;   // No window yet
+    unsigned trailing = 0;
+    for (size_t i = 1; i < count; ++i) {
+        const uint64_t current = std::bit_cast<uint64_t>(values[i]);
+        const uint64_t x = current ^ previous;
+        previous = current;
+        if (x == 0) {
+            out.put(0, 1);
+            continue;
+        }
+        const auto lz = static_cast<unsigned>(std::countl_zero(x));
+        const auto tz = static_cast<unsigned>(std::countr_zero(x));
+        if (leading <= lz && trailing <= tz) {
+            out.put(0b10, 2);
+            out.put(x >> trailing, 64 - leading - trailing);
+        } else {
+            leading = lz;
+            trailing = tz;
+            const unsigned length = 64 - lz - tz;
+            out.put(0b11, 2);
+            out.put(lz, 6);
+            out.put(length - 1, 6);
+            out.put(x >> tz, length);
+        }
+    }
+}
+
+void decode_block_bits(BitReader& in, double* out, size_t count) {
+    uint64_t previous = in.get(64);
+    out[0] = std::bit_cast<double>(previous);
+    unsigned leading = 0;
+    unsigned trailing = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (in.bit()) {
+            if (in.bit()) {
+                leading = static_cast<unsigned>(in.get(6));
+                const unsigned length = static_cast<unsigned>(in.get(6)) + 1;
+                trailing = 64 - leading - length;
+            }
+            previous ^= in.get(64 - leading - trailing) << trailing;
+        }
+        out[i] = std::bit_cast<double>(previous);
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// Building
+// ============================================================================
+
+CompressedResultSet::CompressedResultSet(std::vector<PeriodID> period_ids, ResultPrecision precision)
+    : period_ids_(std::move(period_ids)), precision_(std::move(precision)) {}
+
+uint32_t CompressedResultSet::intern(const std::string& code) {
+    auto [it, added] = code_index_.emplace(code, static_cast<uint32_t>(codes_.size()));
+    if (added) {
+        codes_.push_back(code);
+        float32_.push_back(precision_.is_float32(code) ? 1 : 0);
+    }
+    return it->second;
+}
+
+void CompressedResultSet::add(ScenarioID scenario_id, const MultiPeriodResults& results) {
+    if (results.results.size() > period_ids_.size()) {
+        throw std::invalid_argument("CompressedResultSet: scenario " + std::to_string(scenario_id) + " has " +
+                                    std::to_string(results.results.size()) + " results for " +
+                                    std::to_string(period_ids_.size()) + " periods");
+    }
+    if (run_index_.count(scenario_id)) {
+        throw std::invalid_argument("CompressedResultSet: scenario " + std::to_string(scenario_id) +
+                                    " is already stored");
+    }
+
+    // Codes first: the width is the dictionary after this run's new codes.
+    // Periods of one template share a schema, which is looked up once.
+    std::vector<const std::vector<uint32_t>*> indexes(results.results.size());
+    std::map<const unified::ResultSchema*, std::vector<uint32_t>> schema_indexes;
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        const auto& row = results.results[p].line_items;
+        auto [it, added] = schema_indexes.try_emplace(row.schema().get());
+        if (added && row.schema()) {
+            for (const auto& code : row.schema()->codes()) {
+                it->second.push_back(intern(code));
+            }
+        }
+        indexes[p] = &it->second;
+    }
+
+    Run run;
+    run.scenario_id = scenario_id;
+    run.width = codes_.size();
+
+    // Transposed: one series of periods per line item
+    const size_t periods = period_ids_.size();
+    std::vector<double> series(run.width * periods, MISSING);
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        const auto& values = results.results[p].line_items.values();
+        for (size_t i = 0; i < values.size(); ++i) {
+            const uint32_t c = (*indexes[p])[i];
+            series[c * periods + p] = float32_[c] ? static_cast<double>(static_cast<float>(values[i])) : values[i];
+        }
+    }
+
+    BitWriter out(run.bits);
+    run.offsets.reserve(run.width * blocks());
+    for (size_t c = 0; c < run.width; ++c) {
+        for (size_t begin = 0; begin < periods; begin += BLOCK_PERIODS) {
+            if (out.position() > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("CompressedResultSet: scenario " + std::to_string(scenario_id) +
+                                        " is too large to encode");
+            }
+            run.offsets.push_back(static_cast<uint32_t>(out.position()));
+            encode_block(out, series.data() + c * periods + begin, std::min(BLOCK_PERIODS, periods - begin));
+        }
+    }
+    run.bits.shrink_to_fit();
+
+    run.success = results.success;
+    for (const auto& result : results.results) {
+        run.period_success.push_back(result.success ? 1 : 0);
+    }
+    run.errors = results.errors;
+    run.warnings = results.warnings;
+
+    run_index_.emplace(scenario_id, runs_.size());
+    runs_.push_back(std::move(run));
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+const CompressedResultSet::Run& CompressedResultSet::find(ScenarioID scenario_id) const {
+    auto it = run_index_.find(scenario_id);
+    if (it == run_index_.end()) {
+        throw std::out_of_range("CompressedResultSet: no scenario " + std::to_string(scenario_id));
+    }
+    return runs_[it->second];
+}
+
+uint32_t CompressedResultSet::code_index(const std::string& code) const {
+    auto it = code_index_.find(code);
+    if (it == code_index_.end()) {
+        throw std::out_of_range("CompressedResultSet: no line item " + code);
+    }
+    return it->second;
+}
+
+void CompressedResultSet::decode_block(const Run& run, size_t code, size_t block, double* out) const {
+    const size_t begin = block * BLOCK_PERIODS;
+    const size_t count = std::min(BLOCK_PERIODS, period_ids_.size() - begin);
+    if (code >= run.width) {
+        std::fill(out, out + count, MISSING);   // Code first seen after the run
+        return;
+    }
+    BitReader in(run.bits, run.offsets[code * blocks() + block]);
+    decode_block_bits(in, out, count);
+}
+
+void CompressedResultSet::decode_series(const Run& run, size_t code, double* out) const {
+    for (size_t b = 0; b < blocks(); ++b) {
+        decode_block(run, code, b, out + b * BLOCK_PERIODS);
+    }
+}
+
+std::vector<ScenarioID> CompressedResultSet::scenario_ids() const {
+    std::vector<ScenarioID> ids;
+    ids.reserve(runs_.size());
+    for (const auto& run : runs_) {
+        ids.push_back(run.scenario_id);
+    }
+    return ids;
+}
+
+double CompressedResultSet::value(ScenarioID scenario_id, const std::string& code, PeriodID period_id) const {
+    const Run& run = find(scenario_id);
+    const uint32_t c = code_index(code);
+    auto period = std::find(period_ids_.begin(), period_ids_.end(), period_id);
+    if (period == period_ids_.end()) {
+        throw std::out_of_range("CompressedResultSet: no period " + std::to_string(period_id));
+    }
+    const size_t p = static_cast<size_t>(period - period_ids_.begin());
+    double block[BLOCK_PERIODS];
+    decode_block(run, c, p / BLOCK_PERIODS, block);
+    return visible(block[p % BLOCK_PERIODS]);
+}
+
+std::vector<double> CompressedResultSet::series(ScenarioID scenario_id, const std::string& code) const {
+    const Run& run = find(scenario_id);
+    std::vector<double> out(period_ids_.size());
+    decode_series(run, code_index(code), out.data());
+    std::transform(out.begin(), out.end(), out.begin(), visible);
+    return out;
+}
+
+void CompressedResultSet::scan(
+    const std::string& code,
+    const std::function<void(ScenarioID scenario_id, std::span<const double> series)>& visit) const {
+    const uint32_t c = code_index(code);
+    std::vector<double> buffer(period_ids_.size());
+    for (const auto& run : runs_) {
+        decode_series(run, c, buffer.data());
+        std::transform(buffer.begin(), buffer.end(), buffer.begin(), visible);
+        visit(run.scenario_id, buffer);
+    }
+}
+
+MultiPeriodResults CompressedResultSet::expand(ScenarioID scenario_id) const {
+    const Run& run = find(scenario_id);
+    const size_t periods = period_ids_.size();
+    std::vector<double> series(run.width * periods);
+    for (size_t c = 0; c < run.width; ++c) {
+        decode_series(run, c, series.data() + c * periods);
+    }
+
+    MultiPeriodResults results;
+    results.success = run.success;
+    results.errors = run.errors;
+    results.warnings = run.warnings;
+
+    // Periods with the same line items share a schema, as calculated ones do
+    std::vector<uint32_t> present;
+    std::vector<uint32_t> schema_codes;
+    std::shared_ptr<const unified::ResultSchema> schema;
+    for (size_t p = 0; p < run.period_success.size(); ++p) {
+        present.clear();
+        std::vector<double> values;
+        for (size_t c = 0; c < run.width; ++c) {
+            const double v = series[c * periods + p];
+            if (std::bit_cast<uint64_t>(v) != MISSING_BITS) {
+                present.push_back(static_cast<uint32_t>(c));
+                values.push_back(v);
+            }
+        }
+        if (!schema || present != schema_codes) {
+            std::vector<std::string> codes;
+            codes.reserve(present.size());
+            for (uint32_t c : present) {
+                codes.push_back(codes_[c]);
+            }
+            schema = std::make_shared<const unified::ResultSchema>(std::move(codes));
+            schema_codes = present;
+        }
+        unified::UnifiedResult result;
+        result.success = run.period_success[p] != 0;
+        result.line_items = unified::ResultRow(schema, std::move(values));
+        results.results.push_back(std::move(result));
+    }
+    return results;
+}
+
+size_t CompressedResultSet::bytes() const {
+    size_t total = 0;
+    for (const auto& run : runs_) {
+        total += run.bits.size() * sizeof(uint64_t) + run.offsets.size() * sizeof(uint32_t);
+    }
+    return total;
+}
+
+size_t CompressedResultSet::dense_bytes() const {
+    size_t total = 0;
+    for (const auto& run : runs_) {
+        total += period_ids_.size() * run.width * sizeof(double);
+    }
+    return total;
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,98 @@
+#include "orchestration/deferred_validation.h"
+#include "core/formula_evaluator.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace finmodel {
+namespace orchestration {
+
+size_t DeferredValidationReport::checks() const {
+    size_t total = 0;
+    for (const auto& rule : rules) {
+        total += rule.checked;
+    }
+    return total;
+}
+
+bool DeferredValidationReport::has_errors() const {
+    return std::any_of(rules.begin(), rules.end(), [](const unified::ColumnRuleResult& rule) {
+        return rule.failed > 0 && rule.severity == unified::ValidationSeverity::ERROR;
+    });
+}
+
+std::vector<std::string> DeferredValidationReport::skipped_rules() const {
+    std::vector<std::string> codes;
+    for (const auto& rule : rules) {
+        if (rule.skipped) {
+            codes.push_back(rule.rule_code);
+        }
+    }
+    return codes;
+}
+
+DeferredValidationReport validate_columnar(
+    std::shared_ptr<database::IDatabase> db,
+    const ColumnarResultReader& results,
+    const std::string& template_code,
+    bool skip_warnings,
+    size_t max_messages
+) {
+    unified::ValidationRuleEngine rule_engine(std::move(db));
+    rule_engine.load_rules_for_template(template_code);
+    rule_engine.set_skip_warnings(skip_warnings);
+    core::FormulaEvaluator evaluator;
+
+    // Line items of the file the rules read
+    const auto& file_codes = results.line_items();
+    std::vector<std::string> needed;
+    auto need = [&](const std::string& code) {
+        if (std::find(file_codes.begin(), file_codes.end(), code) != file_codes.end() &&
+            std::find(needed.begin(), needed.end(), code) == needed.end()) {
+            needed.push_back(code);
+        }
+    };
+    for (const auto& rule : rule_engine.get_rules()) {
+        for (const auto& item : rule.required_line_items) {
+            need(item.substr(0, item.find('[')));
+        }
+        try {
+            for (const auto& var : evaluator.compile(rule.formula)->variables()) {
+                need(var.code);
+            }
+        } catch (const std::exception&) {
+            // Reported per row by execute_rules_columnar()
+        }
+    }
+    if (needed.empty() && !file_codes.empty()) {
+        needed.push_back(file_codes.front());   // For the rows' scenarios and periods
+    }
+
+    DeferredValidationReport report;
+    std::unordered_map<std::string, std::vector<double>> values;
+    for (const auto& code : needed) {
+        ColumnarSeries series = results.read(code);
+        if (report.scenario_ids.empty()) {
+            report.scenario_ids = std::move(series.scenario_ids);
+            report.period_ids = std::move(series.period_ids);
+        }
+        values.emplace(code, std::move(series.values));
+    }
+
+    unified::ResultColumns block;
+    block.rows = report.rows();
+    for (const auto& [code, column] : values) {
+        block.columns.emplace(code, column.data());
+    }
+    block.history.resize(block.rows);
+    for (size_t row = 1; row < block.rows; ++row) {
+        const bool same_run = report.scenario_ids[row] == report.scenario_ids[row - 1] &&
+                              report.period_ids[row] > report.period_ids[row - 1];
+        block.history[row] = same_run ? block.history[row - 1] + 1 : 0;
+    }
+
+    report.rules = rule_engine.execute_rules_columnar(block, evaluator, max_messages);
+    return report;
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,556 @@
+/**
+ * @file delta_results.cpp
+ * @brief Delta-encoded result sets and their file encoding
+ *
+ * Layout of a .fmdr file:
+ *   "FMDR" u32 version
+ *   Periods, line item dictionary
+ *   Baseline: scenario, width, period success flags, messages, width × periods doubles
+ *   Variants: the same header, then changed cells as gaps and their doubles
+ *   u64 FNV-1a hash of everything before it
+ *
+ * Integers are varints (signed ones zigzag-encoded), strings a varint
+ * length and bytes. A variant's bitmap is stored as the gaps between its
+ * changed cells, so unchanged runs of cells cost nothing on disk.
+ */
+
+#include "orchestration/delta_results.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+constexpr char MAGIC[4] = {'F', 'M', 'D', 'R'};
+
+/// A NaN no calculation produces: the cell has no value (kept apart from calculated NaNs)
+constexpr uint64_t MISSING_BITS = 0x7FF80000000F4D15ULL;
+const double MISSING = std::bit_cast<double>(MISSING_BITS);
+
+bool same_bits(double a, double b) {
+    return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+}
+
+bool is_missing(double value) {
+    return std::bit_cast<uint64_t>(value) == MISSING_BITS;
+}
+
+/// Cells read by callers: missing ones are plain NaN
+double visible(double value) {
+    return is_missing(value) ? std::numeric_limits<double>::quiet_NaN() : value;
+}
+
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+class Encoder {
+public:
+    std::vector<uint8_t> out;
+
+    template <typename T>
+    void put(T value) {
+        const size_t at = out.size();
+        out.resize(at + sizeof(T));
+        std::memcpy(out.data() + at, &value, sizeof(T));
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void signed_varint(int64_t value) {
+        varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    void strings(const std::vector<std::string>& values) {
+        varint(values.size());
+        for (const auto& value : values) {
+            string(value);
+        }
+    }
+};
+
+class Decoder {
+public:
+    Decoder(const std::vector<uint8_t>& data, size_t begin, size_t end, const std::string& path)
+        : data_(data), pos_(begin), end_(end), path_(path) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            const uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        damaged();
+    }
+
+    int64_t signed_varint() {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string string() {
+        const uint64_t size = varint();
+        need(size);
+        std::string value(reinterpret_cast<const char*>(data_.data() + pos_), size);
+        pos_ += size;
+        return value;
+    }
+
+    std::vector<std::string> strings() {
+        std::vector<std::string> values(count());
+        for (auto& value : values) {
+            value = string();
+        }
+        return values;
+    }
+
+    /// A count whose elements take at least one byte each
+    size_t count() {
+        const uint64_t n = varint();
+        if (n > end_ - pos_) {
+            damaged();
+        }
+        return static_cast<size_t>(n);
+    }
+
+    bool at_end() const { return pos_ == end_; }
+
+    [[noreturn]] void damaged() const {
+        throw std::runtime_error("DeltaResultSet: damaged file " + path_);
+    }
+
+private:
+    const std::vector<uint8_t>& data_;
+    size_t pos_;
+    size_t end_;
+    const std::string& path_;
+
+    void need(uint64_t bytes) const {
+        if (bytes > end_ - pos_) {
+            damaged();
+        }
+    }
+};
+
+} // namespace
+
+// ============================================================================
+// Building
+// ============================================================================
+
+DeltaResultSet::DeltaResultSet(std::vector<PeriodID> period_ids, const MultiPeriodResults& baseline,
+                               ScenarioID baseline_id)
+    : period_ids_(std::move(period_ids)), baseline_id_(baseline_id) {
+    if (baseline.results.size() > period_ids_.size()) {
+        throw std::invalid_argument("DeltaResultSet: baseline has " + std::to_string(baseline.results.size()) +
+                                    " results for " + std::to_string(period_ids_.size()) + " periods");
+    }
+    baseline_ = cells(baseline);
+    baseline_width_ = codes_.size();
+    baseline_run_.scenario_id = baseline_id;
+    baseline_run_.success = baseline.success;
+    for (const auto& result : baseline.results) {
+        baseline_run_.period_success.push_back(result.success ? 1 : 0);
+    }
+    baseline_run_.errors = baseline.errors;
+    baseline_run_.warnings = baseline.warnings;
+}
+
+uint32_t DeltaResultSet::intern(const std::string& code) {
+    auto [it, added] = code_index_.emplace(code, static_cast<uint32_t>(codes_.size()));
+    if (added) {
+        codes_.push_back(code);
+    }
+    return it->second;
+}
+
+std::vector<double> DeltaResultSet::cells(const MultiPeriodResults& results) {
+    // Codes first: the width is the dictionary after this run's new codes.
+    // Periods of one template share a schema, which is looked up once.
+    std::vector<const std::vector<uint32_t>*> indexes(results.results.size());
+    std::map<const unified::ResultSchema*, std::vector<uint32_t>> schema_indexes;
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        const auto& row = results.results[p].line_items;
+        auto [it, added] = schema_indexes.try_emplace(row.schema().get());
+        if (added && row.schema()) {
+            for (const auto& code : row.schema()->codes()) {
+                it->second.push_back(intern(code));
+            }
+        }
+        indexes[p] = &it->second;
+    }
+    const size_t width = codes_.size();
+    std::vector<double> out(period_ids_.size() * width, MISSING);
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        const auto& values = results.results[p].line_items.values();
+        for (size_t i = 0; i < values.size(); ++i) {
+            out[p * width + (*indexes[p])[i]] = values[i];
+        }
+    }
+    return out;
+}
+
+void DeltaResultSet::add(ScenarioID scenario_id, const MultiPeriodResults& results) {
+    if (results.results.size() > period_ids_.size()) {
+        throw std::invalid_argument("DeltaResultSet: scenario " + std::to_string(scenario_id) + " has " +
+                                    std::to_string(results.results.size()) + " results for " +
+                                    std::to_string(period_ids_.size()) + " periods");
+    }
+    if (scenario_id == baseline_id_ || variant_index_.count(scenario_id)) {
+        throw std::invalid_argument("DeltaResultSet: scenario " + std::to_string(scenario_id) + " is already stored");
+    }
+
+    Variant variant;
+    variant.scenario_id = scenario_id;
+    const std::vector<double> dense = cells(results);
+    variant.width = codes_.size();
+    variant.bitmap.assign((dense.size() + 63) / 64, 0);
+    for (size_t p = 0; p < period_ids_.size(); ++p) {
+        for (size_t c = 0; c < variant.width; ++c) {
+            const size_t cell = p * variant.width + c;
+            if (!same_bits(dense[cell], baseline_cell(p, c))) {
+                variant.bitmap[cell / 64] |= uint64_t{1} << (cell % 64);
+                variant.values.push_back(dense[cell]);
+            }
+        }
+    }
+    variant.success = results.success;
+    for (const auto& result : results.results) {
+        variant.period_success.push_back(result.success ? 1 : 0);
+    }
+    variant.errors = results.errors;
+    variant.warnings = results.warnings;
+    build_ranks(variant);
+
+    variant_index_.emplace(scenario_id, variants_.size());
+    variants_.push_back(std::move(variant));
+}
+
+void DeltaResultSet::build_ranks(Variant& variant) {
+    variant.ranks.clear();
+    uint32_t rank = 0;
+    for (size_t w = 0; w < variant.bitmap.size(); ++w) {
+        if (w % RANK_WORDS == 0) {
+            variant.ranks.push_back(rank);
+        }
+        rank += static_cast<uint32_t>(std::popcount(variant.bitmap[w]));
+    }
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+double DeltaResultSet::baseline_cell(size_t period, size_t code) const {
+    return code < baseline_width_ ? baseline_[period * baseline_width_ + code] : MISSING;
+}
+
+double DeltaResultSet::cell(const Variant& variant, size_t period, size_t code) const {
+    if (code >= variant.width) {
+        return MISSING;   // Code first seen after the variant: neither run has it
+    }
+    const size_t cell = period * variant.width + code;
+    const size_t word = cell / 64;
+    const uint64_t bit = uint64_t{1} << (cell % 64);
+    if (!(variant.bitmap[word] & bit)) {
+        return baseline_cell(period, code);
+    }
+    size_t rank = variant.ranks[word / RANK_WORDS];
+    for (size_t w = word - word % RANK_WORDS; w < word; ++w) {
+        rank += static_cast<size_t>(std::popcount(variant.bitmap[w]));
+    }
+    rank += static_cast<size_t>(std::popcount(variant.bitmap[word] & (bit - 1)));
+    return variant.values[rank];
+}
+
+const DeltaResultSet::Variant* DeltaResultSet::find(ScenarioID scenario_id) const {
+    auto it = variant_index_.find(scenario_id);
+    if (it != variant_index_.end()) {
+        return &variants_[it->second];
+    }
+    if (scenario_id == baseline_id_) {
+        return nullptr;
+    }
+    throw std::out_of_range("DeltaResultSet: no scenario " + std::to_string(scenario_id));
+}
+
+std::vector<ScenarioID> DeltaResultSet::variant_ids() const {
+    std::vector<ScenarioID> ids;
+    ids.reserve(variants_.size());
+    for (const auto& variant : variants_) {
+        ids.push_back(variant.scenario_id);
+    }
+    return ids;
+}
+
+double DeltaResultSet::value(ScenarioID scenario_id, const std::string& code, PeriodID period_id) const {
+    const Variant* variant = find(scenario_id);
+    auto index = code_index_.find(code);
+    if (index == code_index_.end()) {
+        throw std::out_of_range("DeltaResultSet: no line item " + code);
+    }
+    auto period = std::find(period_ids_.begin(), period_ids_.end(), period_id);
+    if (period == period_ids_.end()) {
+        throw std::out_of_range("DeltaResultSet: no period " + std::to_string(period_id));
+    }
+    const size_t p = static_cast<size_t>(period - period_ids_.begin());
+    return visible(variant ? cell(*variant, p, index->second) : baseline_cell(p, index->second));
+}
+
+std::vector<ResultDelta> DeltaResultSet::changes(ScenarioID scenario_id) const {
+    std::vector<ResultDelta> out;
+    const Variant* variant = find(scenario_id);
+    if (!variant) {
+        return out;
+    }
+    out.reserve(variant->values.size());
+    size_t value = 0;
+    for (size_t w = 0; w < variant->bitmap.size(); ++w) {
+        for (uint64_t bits = variant->bitmap[w]; bits != 0; bits &= bits - 1) {
+            const size_t cell = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+            const size_t p = cell / variant->width;
+            const size_t c = cell % variant->width;
+            out.push_back({period_ids_[p], codes_[c], visible(baseline_cell(p, c)), visible(variant->values[value++])});
+        }
+    }
+    return out;
+}
+
+size_t DeltaResultSet::changed_cells(ScenarioID scenario_id) const {
+    const Variant* variant = find(scenario_id);
+    return variant ? variant->values.size() : 0;
+}
+
+MultiPeriodResults DeltaResultSet::expand(ScenarioID scenario_id) const {
+    const Variant* variant = find(scenario_id);
+    const Variant& run = variant ? *variant : baseline_run_;
+    const size_t width = variant ? variant->width : baseline_width_;
+
+    MultiPeriodResults results;
+    results.success = run.success;
+    results.errors = run.errors;
+    results.warnings = run.warnings;
+
+    // Periods with the same line items share a schema, as calculated ones do
+    std::vector<uint32_t> present;
+    std::vector<uint32_t> schema_codes;
+    std::shared_ptr<const unified::ResultSchema> schema;
+    for (size_t p = 0; p < run.period_success.size(); ++p) {
+        present.clear();
+        std::vector<double> values;
+        for (size_t c = 0; c < width; ++c) {
+            const double v = variant ? cell(*variant, p, c) : baseline_cell(p, c);
+            if (!is_missing(v)) {
+                present.push_back(static_cast<uint32_t>(c));
+                values.push_back(v);
+            }
+        }
+        if (!schema || present != schema_codes) {
+            std::vector<std::string> codes;
+            codes.reserve(present.size());
+            for (uint32_t c : present) {
+                codes.push_back(codes_[c]);
+            }
+            schema = std::make_shared<const unified::ResultSchema>(std::move(codes));
+            schema_codes = present;
+        }
+        unified::UnifiedResult result;
+        result.success = run.period_success[p] != 0;
+        result.line_items = unified::ResultRow(schema, std::move(values));
+        results.results.push_back(std::move(result));
+    }
+    return results;
+}
+
+size_t DeltaResultSet::bytes() const {
+    size_t total = baseline_.size() * sizeof(double);
+    for (const auto& variant : variants_) {
+        total += variant.bitmap.size() * sizeof(uint64_t) + variant.ranks.size() * sizeof(uint32_t) +
+                 variant.values.size() * sizeof(double);
+    }
+    return total;
+}
+
+size_t DeltaResultSet::dense_bytes() const {
+    size_t total = baseline_.size() * sizeof(double);
+    for (const auto& variant : variants_) {
+        total += period_ids_.size() * variant.width * sizeof(double);
+    }
+    return total;
+}
+
+// ============================================================================
+// Files
+// ============================================================================
+
+void DeltaResultSet::save(const std::string& path) const {
+    Encoder file;
+    file.out.assign(MAGIC, MAGIC + 4);
+    file.put(FORMAT_VERSION);
+    file.varint(period_ids_.size());
+    for (PeriodID period_id : period_ids_) {
+        file.signed_varint(period_id);
+    }
+    file.strings(codes_);
+
+    auto put_run = [&file](const Variant& run, size_t width) {
+        file.signed_varint(run.scenario_id);
+        file.varint(width);
+        file.put<uint8_t>(run.success ? 1 : 0);
+        file.varint(run.period_success.size());
+        file.out.insert(file.out.end(), run.period_success.begin(), run.period_success.end());
+        file.strings(run.errors);
+        file.strings(run.warnings.messages());
+    };
+    put_run(baseline_run_, baseline_width_);
+    for (double value : baseline_) {
+        file.put(value);
+    }
+    file.varint(variants_.size());
+    for (const auto& variant : variants_) {
+        put_run(variant, variant.width);
+        file.varint(variant.values.size());
+        uint64_t next = 0;   // Cell after the previous changed one
+        for (size_t w = 0; w < variant.bitmap.size(); ++w) {
+            for (uint64_t bits = variant.bitmap[w]; bits != 0; bits &= bits - 1) {
+                const uint64_t cell = w * 64 + static_cast<uint64_t>(std::countr_zero(bits));
+                file.varint(cell - next);
+                next = cell + 1;
+            }
+        }
+        for (double value : variant.values) {
+            file.put(value);
+        }
+    }
+    file.put(fnv1a(file.out.data(), file.out.size()));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.out.data()), static_cast<std::streamsize>(file.out.size()));
+    if (!out) {
+        throw std::runtime_error("DeltaResultSet: can't write " + path);
+    }
+}
+
+DeltaResultSet DeltaResultSet::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("DeltaResultSet: can't read " + path);
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const size_t header = sizeof(MAGIC) + sizeof(uint32_t);
+    if (data.size() < header + sizeof(uint64_t) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("DeltaResultSet: not a delta result file: " + path);
+    }
+    const size_t end = data.size() - sizeof(uint64_t);
+    uint64_t hash;
+    std::memcpy(&hash, data.data() + end, sizeof(hash));
+    Decoder dec(data, sizeof(MAGIC), end, path);
+    const uint32_t version = dec.get<uint32_t>();
+    if (version != FORMAT_VERSION) {
+        throw std::runtime_error("DeltaResultSet: " + path + " has format version " + std::to_string(version) +
+                                 ", expected " + std::to_string(FORMAT_VERSION));
+    }
+    if (hash != fnv1a(data.data(), end)) {
+        dec.damaged();
+    }
+
+    DeltaResultSet set;
+    set.period_ids_.resize(dec.count());
+    for (PeriodID& period_id : set.period_ids_) {
+        period_id = static_cast<PeriodID>(dec.signed_varint());
+    }
+    for (const auto& code : dec.strings()) {
+        set.intern(code);
+    }
+    auto get_run = [&dec, &set](Variant& run) {
+        run.scenario_id = static_cast<ScenarioID>(dec.signed_varint());
+        run.width = static_cast<size_t>(dec.varint());
+        if (run.width > set.codes_.size()) {
+            dec.damaged();
+        }
+        run.success = dec.get<uint8_t>() != 0;
+        run.period_success.resize(dec.count());
+        if (run.period_success.size() > set.period_ids_.size()) {
+            dec.damaged();
+        }
+        for (uint8_t& success : run.period_success) {
+            success = dec.get<uint8_t>();
+        }
+        run.errors = dec.strings();
+        run.warnings = unified::Diagnostics::from_messages(dec.strings());
+    };
+    get_run(set.baseline_run_);
+    set.baseline_id_ = set.baseline_run_.scenario_id;
+    set.baseline_width_ = set.baseline_run_.width;
+    set.baseline_.resize(set.period_ids_.size() * set.baseline_width_);
+    for (double& value : set.baseline_) {
+        value = dec.get<double>();
+    }
+    for (size_t i = dec.count(); i > 0; --i) {
+        Variant variant;
+        get_run(variant);
+        if (variant.width < set.baseline_width_ || set.variant_index_.count(variant.scenario_id)) {
+            dec.damaged();
+        }
+        const size_t cells = set.period_ids_.size() * variant.width;
+        variant.bitmap.assign((cells + 63) / 64, 0);
+        variant.values.resize(dec.count());
+        uint64_t next = 0;
+        for (size_t v = 0; v < variant.values.size(); ++v) {
+            const uint64_t cell = next + dec.varint();
+            if (cell >= cells) {
+                dec.damaged();
+            }
+            variant.bitmap[cell / 64] |= uint64_t{1} << (cell % 64);
+            next = cell + 1;
+        }
+        for (double& value : variant.values) {
+            value = dec.get<double>();
+        }
+        build_ranks(variant);
+        set.variant_index_.emplace(variant.scenario_id, set.variants_.size());
+        set.variants_.push_back(std::move(variant));
+    }
+    if (!dec.at_end()) {
+        dec.damaged();
+    }
+    return set;
+}
+
+} // namespace orchestration
+} // namespace finmodel
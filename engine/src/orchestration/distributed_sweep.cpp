@@ -0,0 +1,491 @@
+/**
+ * @file distributed_sweep.cpp
+ * @brief Distributed sweep coordinator and worker implementation
+ */
+
+#include "orchestration/distributed_sweep.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/period_runner.h"
+#include "database/input_snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+using Properties = std::map<std::string, std::string>;
+
+const char* const INPUTS_FILE = "inputs.db";
+const char* const SPEC_FILE = "sweep.spec";
+const char* const FINISHED_FILE = "sweep.finished";
+
+/// Scenarios calculated per heartbeat of a running shard
+constexpr size_t SCENARIOS_PER_HEARTBEAT = 16;
+
+std::string shard_name(int shard) {
+    std::ostringstream name;
+    name << std::setw(4) << std::setfill('0') << shard;
+    return name.str();
+}
+
+/// Shard number of a file named NNNN.<anything> (-1 if not a shard file)
+int shard_of(const fs::path& file) {
+    const std::string name = file.filename().string();
+    const size_t dot = name.find('.');
+    if (dot == 0 || dot == std::string::npos ||
+        !std::all_of(name.begin(), name.begin() + dot, [](char c) { return c >= '0' && c <= '9'; })) {
+        return -1;
+    }
+    return std::stoi(name.substr(0, dot));
+}
+
+/// Files of a directory belonging to a shard
+std::vector<fs::path> shard_files(const fs::path& dir, int shard) {
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (shard_of(entry.path()) == shard && entry.path().extension() != ".tmp") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+long long now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/// key=value lines (values may contain '=')
+Properties read_properties(const fs::path& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Sweep: can't read " + path.string());
+    }
+    Properties properties;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t eq = line.find('=');
+        if (eq != std::string::npos) {
+            properties[line.substr(0, eq)] = line.substr(eq + 1);
+        }
+    }
+    return properties;
+}
+
+/// Written to a temporary file and renamed, so readers never see half a file
+void write_properties(const fs::path& path, const Properties& properties) {
+    const fs::path tmp = path.string() + "." + std::to_string(now_ms()) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto& [key, value] : properties) {
+            out << key << '=' << value << '\n';
+        }
+        if (!out) {
+            throw std::runtime_error("Sweep: can't write " + tmp.string());
+        }
+    }
+    fs::rename(tmp, path);
+}
+
+std::string get(const Properties& properties, const std::string& key) {
+    auto it = properties.find(key);
+    return (it != properties.end()) ? it->second : std::string();
+}
+
+template <typename T>
+std::string join(const std::vector<T>& values) {
+    std::ostringstream out;
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << (i ? "," : "") << values[i];
+    }
+    return out.str();
+}
+
+std::vector<int> split_ints(const std::string& text) {
+    std::vector<int> values;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(std::stoi(item));
+        }
+    }
+    return values;
+}
+
+/// Codes go into key=value lines and file names
+void check_code(const std::string& what, const std::string& code) {
+    if (code.empty() || code.find_first_of("=\n\r") != std::string::npos) {
+        throw std::invalid_argument("Sweep: invalid " + what + ": '" + code + "'");
+    }
+}
+
+/// Copy a shard into pending/ (renamed, so workers never claim half a file)
+void publish(const fs::path& shard_path, const fs::path& pending) {
+    const fs::path tmp = pending.string() + "." + std::to_string(now_ms()) + ".tmp";
+    fs::copy_file(shard_path, tmp, fs::copy_options::overwrite_existing);
+    fs::rename(tmp, pending);
+}
+
+double seconds_since(fs::file_time_type time) {
+    return std::chrono::duration<double>(fs::file_time_type::clock::now() - time).count();
+}
+
+} // namespace
+
+// ============================================================================
+// SweepCoordinator
+// ============================================================================
+
+SweepCoordinator::SweepCoordinator(std::string work_dir, int max_attempts, double lease_seconds)
+    : work_dir_(std::move(work_dir)),
+      max_attempts_(std::max(1, max_attempts)),
+      lease_seconds_(lease_seconds)
+{
+}
+
+size_t SweepCoordinator::prepare(const std::string& source_db_path, const SweepSpec& spec) {
+    if (spec.entities.empty() || spec.scenario_ids.empty() || spec.period_ids.empty()) {
+        throw std::invalid_argument("Sweep: entities, scenarios and periods must not be empty");
+    }
+    check_code("template code", spec.template_code);
+    for (const auto& entity : spec.entities) {
+        check_code("entity code", entity);
+    }
+    for (const auto& [code, value] : spec.opening_balances) {
+        check_code("line item code", code);
+    }
+
+    const fs::path dir(work_dir_);
+    if (fs::exists(dir / SPEC_FILE)) {
+        throw std::runtime_error("Sweep: " + work_dir_ + " already holds a sweep");
+    }
+    for (const char* sub : {"shards", "pending", "running", "done", "failed", "results"}) {
+        fs::create_directories(dir / sub);
+    }
+
+    // Inputs once, for every worker
+    database::InputSnapshot::compile(source_db_path, (dir / INPUTS_FILE).string(), spec.scenario_ids);
+
+    Properties sweep;
+    sweep["template"] = spec.template_code;
+    sweep["periods"] = join(spec.period_ids);
+    for (const auto& [code, value] : spec.opening_balances) {
+        std::ostringstream text;
+        text << std::setprecision(17) << value;
+        sweep["opening." + code] = text.str();
+    }
+    write_properties(dir / SPEC_FILE, sweep);
+
+    const size_t per_shard = std::max<size_t>(1, spec.scenarios_per_shard);
+    int shard = 0;
+    for (const auto& entity : spec.entities) {
+        for (size_t begin = 0; begin < spec.scenario_ids.size(); begin += per_shard) {
+            const size_t end = std::min(begin + per_shard, spec.scenario_ids.size());
+            Properties properties;
+            properties["entity"] = entity;
+            properties["scenarios"] = join(std::vector<ScenarioID>(
+                spec.scenario_ids.begin() + begin, spec.scenario_ids.begin() + end));
+
+            const std::string name = shard_name(shard++) + ".shard";
+            write_properties(dir / "shards" / name, properties);
+            publish(dir / "shards" / name, dir / "pending" / name);
+        }
+    }
+    return static_cast<size_t>(shard);
+}
+
+std::vector<ShardStatus> SweepCoordinator::poll() {
+    const fs::path dir(work_dir_);
+    std::vector<fs::path> shard_paths;
+    for (const auto& entry : fs::directory_iterator(dir / "shards")) {
+        if (entry.path().extension() == ".shard" && shard_of(entry.path()) >= 0) {
+            shard_paths.push_back(entry.path());
+        }
+    }
+    std::sort(shard_paths.begin(), shard_paths.end());
+
+    std::vector<ShardStatus> shards;
+    bool active = false;
+    for (const auto& shard_path : shard_paths) {
+        ShardStatus status;
+        status.shard = shard_of(shard_path);
+        const std::string name = shard_name(status.shard);
+        const Properties shard = read_properties(shard_path);
+        status.entity_id = get(shard, "entity");
+        status.scenarios = split_ints(get(shard, "scenarios")).size();
+
+        // Workers write done/ or failed/ before they release running/, so a
+        // shard is always in at least one place
+        if (fs::exists(dir / "done" / (name + ".result"))) {
+            const Properties done = read_properties(dir / "done" / (name + ".result"));
+            status.state = ShardStatus::State::DONE;
+            status.worker = get(done, "worker");
+            status.seconds = std::stod(get(done, "seconds"));
+            status.rows = std::stoul(get(done, "rows"));
+            status.failed_runs = std::stoul(get(done, "failed_runs"));
+            status.result_path = (dir / get(done, "file")).string();
+            // Requeued after a late heartbeat, finished by the first worker after all
+            std::error_code ec;
+            fs::remove(dir / "pending" / (name + ".shard"), ec);
+        } else {
+            for (const auto& running : shard_files(dir / "running", status.shard)) {
+                std::error_code ec;
+                const auto heartbeat = fs::last_write_time(running, ec);
+                if (ec) {
+                    continue;  // Released meanwhile
+                }
+                if (seconds_since(heartbeat) <= lease_seconds_) {
+                    status.state = ShardStatus::State::RUNNING;
+                    status.worker = running.extension().string().substr(1);
+                    continue;
+                }
+                // Abandoned: turn the lease into a failed attempt
+                const fs::path expired = dir / "failed" /
+                    (name + ".lease." + std::to_string(now_ms()) + ".error");
+                fs::rename(running, expired, ec);
+                if (!ec) {
+                    std::ofstream(expired, std::ios::trunc)
+                        << "worker=" << running.extension().string().substr(1) << "\n"
+                        << "error=No heartbeat for " << lease_seconds_ << " s\n";
+                }
+            }
+
+            const auto errors = shard_files(dir / "failed", status.shard);
+            status.attempts = static_cast<int>(errors.size());
+            if (!errors.empty()) {
+                status.error = get(read_properties(errors.back()), "error");
+            }
+
+            if (status.state != ShardStatus::State::RUNNING) {
+                const fs::path pending = dir / "pending" / (name + ".shard");
+                if (fs::exists(pending)) {
+                    status.state = ShardStatus::State::PENDING;
+                } else if (status.attempts < max_attempts_) {
+                    publish(shard_path, pending);
+                    status.state = ShardStatus::State::PENDING;
+                } else {
+                    status.state = ShardStatus::State::FAILED;
+                }
+            }
+        }
+
+        active = active || status.state == ShardStatus::State::PENDING ||
+                 status.state == ShardStatus::State::RUNNING;
+        shards.push_back(std::move(status));
+    }
+
+    if (!active && !fs::exists(dir / FINISHED_FILE)) {
+        write_properties(dir / FINISHED_FILE, {{"shards", std::to_string(shards.size())}});
+    }
+    return shards;
+}
+
+std::vector<ShardStatus> SweepCoordinator::wait(double poll_seconds, double timeout_seconds) {
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+        auto shards = poll();
+        const bool active = std::any_of(shards.begin(), shards.end(), [](const ShardStatus& s) {
+            return s.state == ShardStatus::State::PENDING || s.state == ShardStatus::State::RUNNING;
+        });
+        const double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!active || (timeout_seconds > 0.0 && waited >= timeout_seconds)) {
+            return shards;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(poll_seconds));
+    }
+}
+
+std::string SweepCoordinator::report(const std::vector<ShardStatus>& shards) {
+    static const char* const STATES[] = {"pending", "running", "done", "FAILED"};
+
+    std::ostringstream out;
+    out << std::left << std::setw(7) << "shard" << std::setw(16) << "entity"
+        << std::right << std::setw(10) << "scenarios" << "  " << std::left << std::setw(9) << "state"
+        << std::right << std::setw(9) << "attempts" << "  " << std::left << std::setw(20) << "worker"
+        << std::right << std::setw(10) << "seconds" << std::setw(10) << "rows" << '\n';
+
+    size_t done = 0;
+    size_t rows = 0;
+    double seconds = 0.0;
+    for (const auto& shard : shards) {
+        out << std::left << std::setw(7) << shard_name(shard.shard) << std::setw(16) << shard.entity_id
+            << std::right << std::setw(10) << shard.scenarios << "  "
+            << std::left << std::setw(9) << STATES[static_cast<int>(shard.state)]
+            << std::right << std::setw(9) << shard.attempts << "  " << std::left << std::setw(20) << shard.worker
+            << std::right << std::setw(10) << std::fixed << std::setprecision(2) << shard.seconds
+            << std::setw(10) << shard.rows << '\n';
+        if (shard.state == ShardStatus::State::FAILED && !shard.error.empty()) {
+            out << "       error: " << shard.error << '\n';
+        }
+        if (shard.state == ShardStatus::State::DONE) {
+            ++done;
+            rows += shard.rows;
+            seconds += shard.seconds;
+        }
+    }
+    out << done << "/" << shards.size() << " shards done, " << rows << " rows, "
+        << std::fixed << std::setprecision(2) << seconds << " worker seconds\n";
+    return out.str();
+}
+
+// ============================================================================
+// SweepWorker
+// ============================================================================
+
+SweepWorker::SweepWorker(std::string work_dir, std::string name, size_t threads)
+    : work_dir_(std::move(work_dir)), name_(std::move(name)), threads_(threads)
+{
+    check_code("worker name", name_);
+    if (name_.find_first_of("/\\.") != std::string::npos) {
+        throw std::invalid_argument("Sweep: invalid worker name: '" + name_ + "'");
+    }
+}
+
+bool SweepWorker::run_one() {
+    const fs::path dir(work_dir_);
+
+    // Workers may start before the coordinator published the sweep
+    std::vector<fs::path> pending;
+    std::error_code listed;
+    for (const auto& entry : fs::directory_iterator(dir / "pending", listed)) {
+        if (entry.path().extension() == ".shard" && shard_of(entry.path()) >= 0) {
+            pending.push_back(entry.path());
+        }
+    }
+    std::sort(pending.begin(), pending.end());
+
+    // Claim: the first rename wins, others see the file gone
+    int shard = -1;
+    fs::path lease;
+    for (const auto& path : pending) {
+        const int candidate = shard_of(path);
+        const fs::path target = dir / "running" / (shard_name(candidate) + "." + name_);
+        std::error_code ec;
+        fs::rename(path, target, ec);
+        if (!ec) {
+            shard = candidate;
+            lease = target;
+            break;
+        }
+    }
+    if (shard < 0) {
+        return false;
+    }
+
+    const std::string name = shard_name(shard);
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        const Properties properties = read_properties(lease);
+        const Properties sweep = read_properties(dir / SPEC_FILE);
+        const EntityID entity_id = get(properties, "entity");
+        const std::vector<ScenarioID> scenario_ids = split_ints(get(properties, "scenarios"));
+        const std::vector<PeriodID> period_ids = split_ints(get(sweep, "periods"));
+        const std::string template_code = get(sweep, "template");
+
+        BalanceSheet opening{};
+        for (const auto& [key, value] : sweep) {
+            if (key.rfind("opening.", 0) == 0) {
+                opening.line_items[key.substr(8)] = std::stod(value);
+            }
+        }
+
+        const std::string inputs = (dir / INPUTS_FILE).string();
+        auto runner_db = database::InputSnapshot::open(inputs);
+        PeriodRunner runner(runner_db, std::make_shared<core::ReferenceDataStore>(runner_db));  // Shared by the workers
+        if (threads_ != 1) {
+            runner.set_scenario_parallel(threads_, [inputs] { return database::InputSnapshot::open(inputs); });
+        }
+
+        const std::string file = "results/" + name + ".fmcr";
+        const fs::path tmp = dir / (file + "." + name_ + ".tmp");
+        ColumnarResultWriter writer(tmp.string());
+        size_t failed_runs = 0;
+        std::string first_error;
+        bool lease_lost = false;
+        for (size_t begin = 0; !lease_lost && begin < scenario_ids.size(); begin += SCENARIOS_PER_HEARTBEAT) {
+            const size_t end = std::min(begin + SCENARIOS_PER_HEARTBEAT, scenario_ids.size());
+            std::vector<ScenarioJob> jobs;
+            for (size_t i = begin; i < end; ++i) {
+                jobs.push_back(ScenarioJob{entity_id, scenario_ids[i]});
+            }
+            auto results = runner.run_jobs(jobs, period_ids, opening, template_code);
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                if (!results[i].success) {
+                    ++failed_runs;
+                    if (first_error.empty() && !results[i].errors.empty()) {
+                        first_error = results[i].errors.front();
+                    }
+                }
+                writer.append(jobs[i].scenario_id, period_ids, results[i]);
+            }
+            // Heartbeat; fails once the coordinator gave the shard to another worker
+            std::error_code ec;
+            fs::last_write_time(lease, fs::file_time_type::clock::now(), ec);
+            lease_lost = static_cast<bool>(ec);
+        }
+        const ColumnarFileInfo info = writer.close();
+        if (lease_lost) {
+            fs::remove(tmp);
+            return true;
+        }
+        fs::rename(tmp, dir / file);
+
+        Properties done;
+        done["worker"] = name_;
+        done["seconds"] = std::to_string(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        done["rows"] = std::to_string(info.rows);
+        done["bytes"] = std::to_string(info.bytes);
+        done["failed_runs"] = std::to_string(failed_runs);
+        done["first_error"] = first_error.substr(0, first_error.find('\n'));
+        done["file"] = file;
+        write_properties(dir / "done" / (name + ".result"), done);
+    } catch (const std::exception& e) {
+        std::string error = e.what();
+        std::replace(error.begin(), error.end(), '\n', ' ');
+        // Attempt number in the name: failures can come faster than the clock ticks
+        const size_t attempt = shard_files(dir / "failed", shard).size() + 1;
+        write_properties(dir / "failed" / (name + "." + std::to_string(attempt) + "." + name_ + ".error"),
+                         {{"worker", name_}, {"error", error}});
+    }
+
+    std::error_code ec;
+    fs::remove(lease, ec);
+    return true;
+}
+
+size_t SweepWorker::run(double idle_seconds) {
+    const fs::path dir(work_dir_);
+    size_t shards = 0;
+    auto idle_since = std::chrono::steady_clock::now();
+    while (!fs::exists(dir / FINISHED_FILE)) {
+        if (run_one()) {
+            ++shards;
+            idle_since = std::chrono::steady_clock::now();
+            continue;
+        }
+        // Shards come back when the coordinator requeues them
+        const double idle = std::chrono::duration<double>(std::chrono::steady_clock::now() - idle_since).count();
+        if (idle >= idle_seconds) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    return shards;
+}
+
+} // namespace orchestration
+} // namespace finmodel
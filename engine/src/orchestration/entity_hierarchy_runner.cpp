@@ -0,0 +1,489 @@
+/**
+ * @file entity_hierarchy_runner.cpp
+ * @brief Entity hierarchy rollup implementation
+ */
+
+#include "orchestration/entity_hierarchy_runner.h"
+#include "orchestration/lane_triggers.h"
+#include "database/result_set.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+/// Deeper entities are ignored (guards against parent cycles)
+constexpr int MAX_DEPTH = 64;
+
+} // namespace
+
+std::vector<int> EntityTree::leaves() const {
+    std::vector<int> leaves;
+    for (int node = 0; node < static_cast<int>(nodes.size()); ++node) {
+        if (is_leaf(node)) {
+            leaves.push_back(node);
+        }
+    }
+    return leaves;
+}
+
+EntityTree EntityTree::load(database::IDatabase& db, const EntityID& root_code) {
+    auto result_set = db.execute_query(
+        "WITH RECURSIVE tree(entity_id, code, parent_entity_id, depth) AS ("
+        "  SELECT entity_id, code, NULL, 0 FROM entity WHERE code = :root"
+        "  UNION ALL"
+        "  SELECT e.entity_id, e.code, e.parent_entity_id, t.depth + 1"
+        "  FROM entity e JOIN tree t ON e.parent_entity_id = t.entity_id"
+        "  WHERE t.depth < :max_depth"
+        ") SELECT entity_id, code, parent_entity_id, depth FROM tree ORDER BY depth, code",
+        {{"root", root_code}, {"max_depth", MAX_DEPTH}});
+
+    EntityTree tree;
+    std::unordered_map<int64_t, int> node_of;   // entity_id → node
+    for (auto [entity_id, code, parent_id, depth] :
+         result_set->rows<int64_t, std::string, std::optional<int64_t>, int>()) {
+        Node node;
+        node.code = std::move(code);
+        node.depth = depth;
+        if (parent_id) {
+            auto parent = node_of.find(*parent_id);
+            if (parent == node_of.end()) {
+                continue;  // Reached twice through a cycle
+            }
+            node.parent = parent->second;
+        }
+        const int index = static_cast<int>(tree.nodes.size());
+        if (!node_of.emplace(entity_id, index).second) {
+            continue;
+        }
+        if (node.parent >= 0) {
+            tree.nodes[node.parent].children.push_back(index);
+        }
+        tree.nodes.push_back(std::move(node));
+    }
+
+    if (tree.nodes.empty()) {
+        throw std::runtime_error("EntityTree: entity not found: " + root_code);
+    }
+    return tree;
+}
+
+void EntityTree::load_currencies(database::IDatabase& db) {
+    std::unordered_map<std::string, int> node_of;
+    for (int node = 0; node < static_cast<int>(nodes.size()); ++node) {
+        node_of.emplace(nodes[node].code, node);
+    }
+
+    std::unique_ptr<ResultSet> result_set;
+    try {
+        result_set = db.execute_query("SELECT code, base_currency FROM entity", {});
+    } catch (const std::exception& e) {
+        throw std::runtime_error("EntityTree: can't read entity currencies: " + std::string(e.what()));
+    }
+    for (auto [code, currency] : result_set->rows<std::string_view, std::optional<std::string>>()) {
+        auto node = node_of.find(std::string(code));
+        if (node != node_of.end()) {
+            nodes[node->second].currency = currency.value_or("");
+        }
+    }
+}
+
+std::optional<std::pair<double, double>> EntityHierarchyRunner::Translator::rates(
+    const std::string& from, const std::string& to, PeriodID period_id) const {
+    std::optional<double> average_rate = average->find_rate(average->currency_id(from),
+                                                            average->currency_id(to), period_id);
+    std::optional<double> closing_rate = closing->find_rate(closing->currency_id(from),
+                                                            closing->currency_id(to), period_id);
+    if (!closing_rate) {
+        closing_rate = average_rate;
+    }
+    if (!average_rate) {
+        average_rate = closing_rate;
+    }
+    if (!average_rate) {
+        return std::nullopt;
+    }
+    return std::make_pair(*average_rate, *closing_rate);
+}
+
+EntityHierarchyRunner::EntityHierarchyRunner(std::shared_ptr<database::IDatabase> db)
+    : db_(db), runner_(db)
+{
+}
+
+void EntityHierarchyRunner::set_parallel(size_t threads, PeriodRunner::ConnectionFactory connect) {
+    runner_.set_scenario_parallel(threads, std::move(connect));
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    pool_ = (threads > 1) ? std::make_unique<core::ThreadPool>(threads) : nullptr;
+}
+
+void EntityHierarchyRunner::set_entity_lanes(size_t width) {
+    lane_width_ = width;
+}
+
+void EntityHierarchyRunner::set_currency_translation(CurrencyTranslation translation) {
+    translation_ = std::move(translation);
+}
+
+void EntityHierarchyRunner::set_eliminations(std::vector<EliminationRule> rules) {
+    eliminations_ = std::move(rules);
+}
+
+std::map<EntityID, MultiPeriodResults> EntityHierarchyRunner::run_hierarchy(
+    const EntityID& root_code,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const std::map<EntityID, BalanceSheet>& initial_bs_by_entity,
+    const std::string& template_code
+) {
+    EntityTree tree = EntityTree::load(*db_, root_code);
+    std::vector<MultiPeriodResults> results(tree.nodes.size());
+
+    std::optional<Translator> translator;
+    if (translation_.enabled) {
+        tree.load_currencies(*db_);
+        translator.emplace();
+        translator->settings = &translation_;
+        translator->period_ids = period_ids;
+        translator->average = std::make_shared<const fx::FXProvider>(db_, "average");
+        translator->closing = std::make_shared<const fx::FXProvider>(db_, "closing");
+    }
+
+    // Leaves: entity lanes, batches of leaves with the same opening codes
+    std::vector<int> leaves = tree.leaves();
+    auto opening_of = [&](int leaf) -> const BalanceSheet* {
+        auto opening = initial_bs_by_entity.find(tree.nodes[leaf].code);
+        return opening != initial_bs_by_entity.end() ? &opening->second : nullptr;
+    };
+    if (lane_width_ > 1 && leaves.size() > 1 && LaneTriggers::query(*db_, scenario_id).empty()) {
+        std::map<std::set<std::string>, std::vector<int>> by_codes;
+        for (int leaf : leaves) {
+            std::set<std::string> codes;
+            if (const BalanceSheet* opening = opening_of(leaf)) {
+                for (const auto& [code, value] : opening->line_items) {
+                    codes.insert(code);
+                }
+            }
+            by_codes[codes].push_back(leaf);
+        }
+
+        std::vector<int> remaining;
+        for (const auto& [codes, group] : by_codes) {
+            for (size_t begin = 0; begin < group.size(); begin += lane_width_) {
+                const size_t end = std::min(group.size(), begin + lane_width_);
+                std::vector<EntityID> entity_ids;
+                std::vector<const BalanceSheet*> openings;
+                for (size_t i = begin; i < end; ++i) {
+                    entity_ids.push_back(tree.nodes[group[i]].code);
+                    openings.push_back(opening_of(group[i]));
+                }
+                std::vector<MultiPeriodResults> batch;
+                if (end - begin > 1 &&
+                    run_lanes(entity_ids, scenario_id, period_ids, openings, template_code, batch)) {
+                    for (size_t i = begin; i < end; ++i) {
+                        results[group[i]] = std::move(batch[i - begin]);
+                    }
+                } else {
+                    remaining.insert(remaining.end(), group.begin() + begin, group.begin() + end);
+                }
+            }
+        }
+        leaves = std::move(remaining);
+    }
+
+    // Other leaves: independent runs, one scheduler job each
+    std::vector<ScenarioJob> jobs;
+    jobs.reserve(leaves.size());
+    for (int leaf : leaves) {
+        ScenarioJob job{tree.nodes[leaf].code, scenario_id};
+        job.initial_bs = opening_of(leaf);
+        jobs.push_back(std::move(job));
+    }
+    if (!jobs.empty()) {
+        auto leaf_results = runner_.run_jobs(jobs, period_ids, BalanceSheet{}, template_code);
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            results[leaves[i]] = std::move(leaf_results[i]);
+        }
+    }
+
+    std::optional<EliminationMatrix> eliminations;
+    EliminationMatrix::Rate rate;
+    if (!eliminations_.empty()) {
+        eliminations.emplace(tree, eliminations_);
+    }
+    if (eliminations && translator) {
+        rate = [&](const std::string& from, const std::string& to, size_t p, const std::string& line_item) {
+            const PeriodID period_id = p < period_ids.size() ? period_ids[p] : 0;
+            auto found = translator->rates(from, to, period_id);
+            if (!found) {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            const auto& stocks = translation_.stocks;
+            const bool stock = line_item == translation_.cta_code ||
+                               std::find(stocks.begin(), stocks.end(), line_item) != stocks.end();
+            return stock ? found->second : found->first;
+        };
+    }
+
+    // Parents: deepest level first, each level's parents independent
+    const int max_depth = tree.nodes.back().depth;
+    for (int depth = max_depth - 1; depth >= 0; --depth) {
+        std::vector<int> parents;
+        for (int node = 0; node < static_cast<int>(tree.nodes.size()); ++node) {
+            if (tree.nodes[node].depth == depth && !tree.is_leaf(node)) {
+                parents.push_back(node);
+            }
+        }
+        auto aggregate_range = [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                results[parents[i]] = aggregate(tree, parents[i], results, translator ? &*translator : nullptr);
+            }
+        };
+        if (pool_) {
+            pool_->parallel_for(parents.size(), aggregate_range);
+        } else {
+            aggregate_range(0, parents.size(), 0);
+        }
+        if (eliminations) {
+            eliminations->apply(tree, depth, results, rate);
+        }
+    }
+
+    std::map<EntityID, MultiPeriodResults> by_entity;
+    for (size_t node = 0; node < tree.nodes.size(); ++node) {
+        by_entity.emplace(tree.nodes[node].code, std::move(results[node]));
+    }
+    return by_entity;
+}
+
+bool EntityHierarchyRunner::run_lanes(const std::vector<EntityID>& entity_ids, ScenarioID scenario_id,
+                                      const std::vector<PeriodID>& period_ids,
+                                      const std::vector<const BalanceSheet*>& openings,
+                                      const std::string& template_code,
+                                      std::vector<MultiPeriodResults>& results) {
+    if (!lane_engine_) {
+        lane_engine_ = std::make_unique<unified::UnifiedEngine>(db_);
+    }
+    const size_t lanes = entity_ids.size();
+    const auto n = static_cast<Eigen::Index>(lanes);
+
+    // Opening lanes: the batch's leaves share their codes
+    unified::LaneResult state;
+    std::vector<std::string> codes;
+    if (openings.front()) {
+        for (const auto& [code, value] : openings.front()->line_items) {
+            codes.push_back(code);
+        }
+    }
+    state.schema = std::make_shared<const unified::ResultSchema>(codes);
+    for (const auto& code : codes) {
+        core::LaneArray values(n);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            values[static_cast<Eigen::Index>(lane)] = openings[lane]->line_items.at(code);
+        }
+        state.values.push_back(std::move(values));
+    }
+
+    std::vector<MultiPeriodResults> batch(lanes);
+    try {
+        lane_engine_->clear_driver_cache();
+        lane_engine_->prefetch_drivers(entity_ids, scenario_id, period_ids);
+        for (PeriodID period_id : period_ids) {
+            state = lane_engine_->calculate_entity_lanes(entity_ids, scenario_id, period_id, state, template_code);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                std::vector<double> values;
+                values.reserve(state.values.size());
+                for (const auto& column : state.values) {
+                    values.push_back(column[static_cast<Eigen::Index>(lane)]);
+                }
+                unified::UnifiedResult result;
+                result.line_items = unified::ResultRow(state.schema, std::move(values));
+                batch[lane].results.push_back(std::move(result));
+            }
+        }
+    } catch (const std::exception&) {
+        return false;  // Run per leaf, which reports each leaf's errors
+    }
+    results = std::move(batch);
+    return true;
+}
+
+MultiPeriodResults EntityHierarchyRunner::aggregate(const EntityTree& tree, int node,
+                                                    const std::vector<MultiPeriodResults>& results,
+                                                    const Translator* translator) {
+    const auto& children = tree.nodes[node].children;
+    const std::string& currency = tree.nodes[node].currency;
+    MultiPeriodResults total;
+
+    size_t periods = 0;
+    for (int child : children) {
+        periods = std::max(periods, results[child].results.size());
+        for (const auto& error : results[child].errors) {
+            total.add_error("Entity " + tree.nodes[child].code + ": " + error);
+        }
+    }
+
+    // Children in another currency than the node's are translated as they are summed
+    const CurrencyTranslation* settings = translator ? translator->settings : nullptr;
+    auto translated = [&](int child) {
+        const std::string& child_currency = tree.nodes[child].currency;
+        return settings && !currency.empty() && !child_currency.empty() && child_currency != currency;
+    };
+    const bool with_cta = settings && !settings->net_assets.empty() &&
+                          std::any_of(children.begin(), children.end(), translated);
+
+    // Closing-rate items of each child schema, and the rate of each item of a child's row
+    std::unordered_map<const unified::ResultSchema*, std::vector<uint8_t>> stock_masks;
+    auto stock_mask = [&](const unified::ResultSchema& row_schema) -> const std::vector<uint8_t>& {
+        auto [mask, added] = stock_masks.try_emplace(&row_schema);
+        if (added) {
+            mask->second.assign(row_schema.size(), 0);
+            for (const auto& code : settings->stocks) {
+                const uint32_t index = row_schema.find(code);
+                if (index != unified::ResultSchema::NO_INDEX) {
+                    mask->second[index] = 1;
+                }
+            }
+            const uint32_t cta = row_schema.find(settings->cta_code);
+            if (cta != unified::ResultSchema::NO_INDEX) {
+                mask->second[cta] = 1;
+            }
+        }
+        return mask->second;
+    };
+    std::vector<double> rates;
+    std::vector<double> history(children.size(), 0.0);    // Net assets at average rates, by child
+    std::vector<double> previous(children.size(), 0.0);   // Net assets of the previous period, by child
+
+    // Schemas known to have the parent's layout (engines of other workers
+    // build equal schemas as separate objects), and parent layouts with a CTA column
+    std::vector<const unified::ResultSchema*> same_layout;
+    std::unordered_map<const unified::ResultSchema*, std::shared_ptr<const unified::ResultSchema>> cta_layouts;
+
+    total.results.resize(periods);
+    for (size_t p = 0; p < periods; ++p) {
+        std::shared_ptr<const unified::ResultSchema> base;
+        for (int child : children) {
+            if (p < results[child].results.size() && results[child].results[p].line_items.schema()) {
+                base = results[child].results[p].line_items.schema();
+                break;
+            }
+        }
+        if (!base) {
+            continue;
+        }
+
+        // The CTA column is appended, so children with the base layout still sum densely
+        std::shared_ptr<const unified::ResultSchema> schema = base;
+        uint32_t cta = unified::ResultSchema::NO_INDEX;
+        if (with_cta) {
+            cta = base->find(settings->cta_code);
+            if (cta == unified::ResultSchema::NO_INDEX) {
+                auto& layout = cta_layouts[base.get()];
+                if (!layout) {
+                    std::vector<std::string> codes;
+                    for (uint32_t i = 0; i < base->size(); ++i) {
+                        codes.push_back(base->code(i));
+                    }
+                    codes.push_back(settings->cta_code);
+                    layout = std::make_shared<const unified::ResultSchema>(std::move(codes));
+                }
+                schema = layout;
+                cta = static_cast<uint32_t>(base->size());
+            }
+        }
+
+        std::vector<double> values(schema->size(), 0.0);
+        bool success = true;
+        for (size_t c = 0; c < children.size(); ++c) {
+            const int child = children[c];
+            if (p >= results[child].results.size()) {
+                success = false;
+                continue;
+            }
+            const auto& result = results[child].results[p];
+            success = success && result.success;
+            const auto& row = result.line_items;
+            if (row.empty()) {
+                continue;
+            }
+            const auto* row_schema = row.schema().get();
+
+            // Translated child: average or closing rate per item, and its translation difference
+            const double* rate = nullptr;
+            if (translated(child)) {
+                const std::string& child_currency = tree.nodes[child].currency;
+                const PeriodID period_id = p < translator->period_ids.size() ? translator->period_ids[p] : 0;
+                auto found = translator->rates(child_currency, currency, period_id);
+                if (!found) {
+                    total.add_error("Entity " + tree.nodes[child].code + ": no " + child_currency + " to " +
+                                    currency + " rate in period " + std::to_string(period_id));
+                    success = false;
+                    continue;
+                }
+                const auto [average, closing] = *found;
+                const std::vector<uint8_t>& mask = stock_mask(*row_schema);
+                rates.resize(row.size());
+                for (size_t i = 0; i < rates.size(); ++i) {
+                    rates[i] = mask[i] ? closing : average;
+                }
+                rate = rates.data();
+
+                if (cta != unified::ResultSchema::NO_INDEX) {
+                    const double* found_net = row.find(settings->net_assets);
+                    const double net = found_net ? *found_net : 0.0;
+                    history[c] = (p == 0) ? net * average : history[c] + (net - previous[c]) * average;
+                    previous[c] = net;
+                    values[cta] += net * closing - history[c];
+                }
+            }
+
+            bool dense = (row_schema == base.get()) ||
+                         std::find(same_layout.begin(), same_layout.end(), row_schema) != same_layout.end();
+            if (!dense && row_schema->symbols() == base->symbols()) {
+                same_layout.push_back(row_schema);
+                dense = true;
+            }
+
+            if (dense) {
+                const double* in = row.values().data();
+                double* out = values.data();
+                const size_t n = row.size();
+                if (rate) {
+                    for (size_t i = 0; i < n; ++i) {
+                        out[i] += in[i] * rate[i];
+                    }
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        out[i] += in[i];
+                    }
+                }
+            } else {
+                // Different line items: match by code
+                for (uint32_t i = 0; i < row.size(); ++i) {
+                    uint32_t index = schema->find(row_schema->symbol(i));
+                    if (index != unified::ResultSchema::NO_INDEX) {
+                        values[index] += row.values()[i] * (rate ? rate[i] : 1.0);
+                    }
+                }
+            }
+        }
+
+        auto& period = total.results[p];
+        period.line_items = unified::ResultRow(schema, std::move(values));
+        period.success = success;
+    }
+
+    return total;
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,374 @@
+/**
+ * @file goal_seek.cpp
+ * @brief Goal seek by Newton steps on adjoint gradients or by Brent's method
+ */
+
+#include "orchestration/goal_seek.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Halvings of a Newton step before giving up on it
+constexpr int MAX_HALVINGS = 10;
+
+/**
+ * @brief Runs of one goal seek: the driver rows read once, shifted for each trial
+ */
+class Problem {
+public:
+    Problem(PeriodRunner& runner, const GoalSeekSpec& spec, std::vector<PeriodID> periods,
+            unified::DriverValueProvider::DriverRows rows, GoalSeekResult& result)
+        : runner_(runner), spec_(spec), periods_(std::move(periods)), rows_(std::move(rows)),
+          trial_(rows_), result_(result) {}
+
+    const GoalSeekSpec& spec() const { return spec_; }
+
+    /**
+     * @brief Value of the target with the free drivers shifted
+     * @return False if the run failed (errors in the result)
+     */
+    bool value(const std::map<std::string, double>& shifts, double& value) {
+        shift(shifts);
+        ++result_.evaluations;
+        auto run = runner_.run_periods(spec_.entity_id, spec_.scenario_id, periods_, spec_.initial_bs,
+                                       spec_.template_code, trial_);
+        if (!run.success) {
+            return failed(run.errors);
+        }
+        if (run.results.size() != periods_.size() || !run.results.back().has_value(spec_.target_code)) {
+            return failed({"Target '" + spec_.target_code + "' not calculated in period " +
+                           std::to_string(periods_.back())});
+        }
+        value = run.results.back().get_value(spec_.target_code);
+        return true;
+    }
+
+    /**
+     * @brief Value and adjoint gradient of the target with the free drivers shifted
+     * @return False if the run failed (errors in the result)
+     */
+    bool gradient(const std::map<std::string, double>& shifts, DriverGradient& gradient) {
+        shift(shifts);
+        ++result_.evaluations;
+        gradient = runner_.gradient(spec_.entity_id, spec_.scenario_id, periods_, spec_.initial_bs,
+                                    spec_.template_code, spec_.target_code, trial_);
+        return gradient.success || failed(gradient.errors);
+    }
+
+private:
+    void shift(const std::map<std::string, double>& shifts) {
+        for (size_t i = 0; i < rows_.rows.size(); ++i) {
+            auto it = shifts.find(rows_.rows[i].driver_code);
+            trial_.rows[i].value = rows_.rows[i].value + (it != shifts.end() ? it->second : 0.0);
+        }
+    }
+
+    bool failed(const std::vector<std::string>& errors) {
+        result_.success = false;
+        result_.errors.insert(result_.errors.end(), errors.begin(), errors.end());
+        return false;
+    }
+
+    PeriodRunner& runner_;
+    const GoalSeekSpec& spec_;
+    const std::vector<PeriodID> periods_;
+    const unified::DriverValueProvider::DriverRows rows_;
+    unified::DriverValueProvider::DriverRows trial_;
+    GoalSeekResult& result_;
+};
+
+/**
+ * @brief Newton steps: the smallest shift of the free drivers that closes the linearised gap
+ */
+void newton(Problem& problem, GoalSeekResult& result) {
+    const GoalSeekSpec& spec = problem.spec();
+    std::map<std::string, double> shifts;
+    for (const auto& code : spec.free_drivers) {
+        shifts[code] = std::clamp(0.0, spec.lower, spec.upper);
+    }
+    DriverGradient gradient;
+    if (!problem.gradient(shifts, gradient)) {
+        return;
+    }
+    result.shifts = shifts;
+    result.value = gradient.value;
+    double residual = gradient.value - spec.target_value;
+
+    while (std::abs(residual) > spec.tolerance) {
+        if (result.iterations == spec.max_iterations) {
+            result.errors.push_back("Goal seek: no convergence in " + std::to_string(spec.max_iterations) +
+                                    " iterations");
+            return;
+        }
+        ++result.iterations;
+
+        std::map<std::string, double> slopes;
+        double norm = 0.0;
+        for (const auto& code : spec.free_drivers) {
+            auto it = gradient.drivers.find(code);
+            const double slope = (it != gradient.drivers.end()) ? it->second : 0.0;
+            slopes[code] = slope;
+            norm += slope * slope;
+        }
+        if (norm == 0.0) {
+            result.errors.push_back("Goal seek: '" + spec.target_code + "' doesn't move with the free drivers");
+            return;
+        }
+
+        // Halve the step while it doesn't bring the target closer
+        std::map<std::string, double> next;
+        double value = 0.0;
+        bool closer = false;
+        double scale = 1.0;
+        for (int halving = 0; halving <= MAX_HALVINGS && !closer; ++halving, scale *= 0.5) {
+            for (const auto& [code, slope] : slopes) {
+                next[code] = std::clamp(shifts[code] - scale * residual * slope / norm, spec.lower, spec.upper);
+            }
+            if (!problem.value(next, value)) {
+                return;
+            }
+            closer = std::abs(value - spec.target_value) < std::abs(residual);
+        }
+        if (!closer) {
+            result.errors.push_back("Goal seek: no step brings '" + spec.target_code + "' closer to the target");
+            return;
+        }
+        shifts = next;
+        result.shifts = shifts;
+        result.value = value;
+        residual = value - spec.target_value;
+        if (std::abs(residual) <= spec.tolerance) {
+            break;
+        }
+        if (!problem.gradient(shifts, gradient)) {
+            return;
+        }
+    }
+    result.converged = true;
+}
+
+/**
+ * @brief Brent's method on one common shift of the free drivers, bracketed by [lower, upper]
+ */
+void brent(Problem& problem, GoalSeekResult& result) {
+    const GoalSeekSpec& spec = problem.spec();
+    auto residual = [&](double shift, double& f) {
+        std::map<std::string, double> shifts;
+        for (const auto& code : spec.free_drivers) {
+            shifts[code] = shift;
+        }
+        double value = 0.0;
+        if (!problem.value(shifts, value)) {
+            return false;
+        }
+        f = value - spec.target_value;
+        return true;
+    };
+    auto finish = [&](double shift, double f) {
+        for (const auto& code : spec.free_drivers) {
+            result.shifts[code] = shift;
+        }
+        result.value = f + spec.target_value;
+        result.converged = std::abs(f) <= spec.tolerance;
+    };
+
+    double a = spec.lower;
+    double b = spec.upper;
+    double fa = 0.0;
+    double fb = 0.0;
+    if (!residual(a, fa) || !residual(b, fb)) {
+        return;
+    }
+    if (std::abs(fa) <= spec.tolerance) {
+        return finish(a, fa);
+    }
+    if ((fa > 0.0) == (fb > 0.0) && std::abs(fb) > spec.tolerance) {
+        result.errors.push_back("Goal seek: the target is not bracketed by shifts " + std::to_string(a) +
+                                " and " + std::to_string(b));
+        finish(std::abs(fa) < std::abs(fb) ? a : b, std::abs(fa) < std::abs(fb) ? fa : fb);
+        return;
+    }
+
+    // b is the best estimate, [b, c] brackets the root, a is the previous b
+    double c = b;
+    double fc = fb;
+    double d = b - a;
+    double e = d;
+    const double epsilon = std::numeric_limits<double>::epsilon();
+    while (std::abs(fb) > spec.tolerance) {
+        if ((fb > 0.0) == (fc > 0.0)) {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (std::abs(fc) < std::abs(fb)) {
+            a = b;  b = c;  c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+        const double tolerance = 2.0 * epsilon * std::abs(b);
+        const double middle = 0.5 * (c - b);
+        if (std::abs(middle) <= tolerance) {
+            result.errors.push_back("Goal seek: '" + spec.target_code + "' jumps across the target at shift " +
+                                    std::to_string(b));
+            break;
+        }
+        if (result.iterations == spec.max_iterations) {
+            result.errors.push_back("Goal seek: no convergence in " + std::to_string(spec.max_iterations) +
+                                    " iterations");
+            break;
+        }
+        ++result.iterations;
+
+        if (std::abs(e) >= tolerance && std::abs(fa) > std::abs(fb)) {
+            // Secant (a == c) or inverse quadratic interpolation, if it stays well inside the bracket
+            const double s = fb / fa;
+            double p = 0.0;
+            double q = 0.0;
+            if (a == c) {
+                p = 2.0 * middle * s;
+                q = 1.0 - s;
+            } else {
+                const double r = fb / fc;
+                q = fa / fc;
+                p = s * (2.0 * middle * q * (q - r) - (b - a) * (r - 1.0));
+                q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+            if (p > 0.0) {
+                q = -q;
+            }
+            p = std::abs(p);
+            if (2.0 * p < std::min(3.0 * middle * q - std::abs(tolerance * q), std::abs(e * q))) {
+                e = d;
+                d = p / q;
+            } else {
+                d = e = middle;
+            }
+        } else {
+            d = e = middle;
+        }
+        a = b;
+        fa = fb;
+        b += (std::abs(d) > tolerance) ? d : std::copysign(tolerance, middle);
+        if (!residual(b, fb)) {
+            return;
+        }
+    }
+    finish(b, fb);
+}
+
+GoalSeekResult failed(const GoalSeekSpec& spec, const std::string& error) {
+    GoalSeekResult result;
+    result.target_code = spec.target_code;
+    result.target_period = spec.target_period;
+    result.target_value = spec.target_value;
+    result.success = false;
+    result.errors.push_back(error);
+    return result;
+}
+
+} // namespace
+
+GoalSeeker::GoalSeeker(ConnectionFactory connect, size_t threads)
+    : connect_(std::move(connect)), pool_(threads)
+{
+    if (!connect_) {
+        throw std::invalid_argument("GoalSeeker: a connection factory is required");
+    }
+    workers_.resize(pool_.size());
+}
+
+GoalSeekResult GoalSeeker::solve(const GoalSeekSpec& spec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    try {
+        return solve(worker(0), spec);
+    } catch (const std::exception& e) {
+        return failed(spec, std::string("Goal seek: ") + e.what());
+    }
+}
+
+std::vector<GoalSeekResult> GoalSeeker::solve_all(const std::vector<GoalSeekSpec>& specs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<GoalSeekResult> results(specs.size());
+    pool_.parallel_for(specs.size(), [&](size_t begin, size_t end, size_t index) {
+        for (size_t i = begin; i < end; ++i) {
+            try {
+                results[i] = solve(worker(index), specs[i]);
+            } catch (const std::exception& e) {
+                results[i] = failed(specs[i], std::string("Goal seek: ") + e.what());
+            }
+        }
+    });
+    return results;
+}
+
+GoalSeeker::Worker& GoalSeeker::worker(size_t index) {
+    Worker& worker = workers_[index];
+    if (!worker.runner) {
+        worker.db = connect_();
+        worker.runner = std::make_unique<PeriodRunner>(worker.db);
+        worker.runner->set_incremental(true);
+    }
+    return worker;
+}
+
+GoalSeekResult GoalSeeker::solve(Worker& worker, const GoalSeekSpec& spec) {
+    if (spec.target_code.empty()) {
+        return failed(spec, "Goal seek: no target line item");
+    }
+    if (spec.free_drivers.empty()) {
+        return failed(spec, "Goal seek: no free drivers");
+    }
+    if (spec.period_ids.empty()) {
+        return failed(spec, "Goal seek: no periods");
+    }
+    if (!(spec.tolerance > 0.0)) {
+        return failed(spec, "Goal seek: tolerance must be positive");
+    }
+    if (!(spec.lower < spec.upper)) {
+        return failed(spec, "Goal seek: lower must be below upper");
+    }
+    if (spec.method == GoalSeekMethod::BRENT && !(std::isfinite(spec.lower) && std::isfinite(spec.upper))) {
+        return failed(spec, "Goal seek: Brent's method needs finite lower and upper shifts");
+    }
+
+    // Later periods don't change the target's
+    std::vector<PeriodID> periods = spec.period_ids;
+    if (spec.target_period != 0) {
+        auto it = std::find(periods.begin(), periods.end(), spec.target_period);
+        if (it == periods.end()) {
+            return failed(spec, "Goal seek: period " + std::to_string(spec.target_period) +
+                                " is not one of the run's");
+        }
+        periods.erase(it + 1, periods.end());
+    }
+
+    auto rows = unified::DriverValueProvider::fetch_rows(*worker.db, spec.entity_id, spec.scenario_id, periods);
+    for (const auto& code : spec.free_drivers) {
+        if (std::none_of(rows.rows.begin(), rows.rows.end(), [&](const auto& row) { return row.driver_code == code; })) {
+            return failed(spec, "Goal seek: free driver '" + code + "' has no values in scenario " +
+                                std::to_string(spec.scenario_id));
+        }
+    }
+
+    GoalSeekResult result;
+    result.target_code = spec.target_code;
+    result.target_period = periods.back();
+    result.target_value = spec.target_value;
+    Problem problem(*worker.runner, spec, std::move(periods), std::move(rows), result);
+    if (spec.method == GoalSeekMethod::NEWTON) {
+        newton(problem, result);
+    } else {
+        brent(problem, result);
+    }
+    return result;
+}
+
+} // namespace orchestration
+} // namespace finmodel
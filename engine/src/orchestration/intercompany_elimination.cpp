@@ -0,0 +1,216 @@
+/**
+ * @file intercompany_elimination.cpp
+ * @brief Intercompany eliminations of an entity hierarchy rollup
+ */
+
+#include "orchestration/intercompany_elimination.h"
+#include "orchestration/entity_hierarchy_runner.h"
+#include "database/result_set.h"
+#include "core/eigen_solvers.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace orchestration {
+
+std::vector<EliminationRule> EliminationMatrix::query(database::IDatabase& db) {
+    auto result_set = db.execute_query(
+        "SELECT entity_code, counterparty_code, line_item_code, share, also_reduce "
+        "FROM intercompany_elimination ORDER BY entity_code, counterparty_code, line_item_code", {});
+
+    std::vector<EliminationRule> rules;
+    for (auto [entity, counterparty, line_item, share, also_reduce] :
+         result_set->rows<std::string, std::string, std::string, std::optional<double>,
+                          std::optional<std::string>>()) {
+        EliminationRule rule;
+        rule.entity_id = std::move(entity);
+        rule.counterparty_id = std::move(counterparty);
+        rule.line_item = std::move(line_item);
+        rule.share = share.value_or(1.0);
+        if (also_reduce && !also_reduce->empty()) {
+            try {
+                rule.also_reduce = nlohmann::json::parse(*also_reduce).get<std::vector<std::string>>();
+            } catch (const nlohmann::json::exception& e) {
+                throw std::runtime_error("EliminationMatrix: also_reduce of " + rule.entity_id + "/" +
+                                         rule.line_item + " is not an array of codes: " + e.what());
+            }
+        }
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+EliminationMatrix::EliminationMatrix(const EntityTree& tree, const std::vector<EliminationRule>& rules) {
+    std::unordered_map<std::string, int> node_of;
+    for (int node = 0; node < static_cast<int>(tree.nodes.size()); ++node) {
+        node_of.emplace(tree.nodes[node].code, node);
+    }
+    auto common_parent = [&tree](int a, int b) {
+        while (tree.nodes[a].depth > tree.nodes[b].depth) {
+            a = tree.nodes[a].parent;
+        }
+        while (tree.nodes[b].depth > tree.nodes[a].depth) {
+            b = tree.nodes[b].parent;
+        }
+        while (a != b) {
+            a = tree.nodes[a].parent;
+            b = tree.nodes[b].parent;
+        }
+        return a;
+    };
+
+    // Triplets per (group, depth of the common parent)
+    struct Entries {
+        std::map<int, int> rows;        // node → row
+        std::map<int, int> columns;     // node → column
+        std::vector<std::tuple<int, int, double>> shares;   // (parent node, source node, share)
+    };
+    std::map<std::vector<std::string>, size_t> group_of;
+    std::map<std::pair<size_t, int>, Entries> entries;
+    for (const auto& rule : rules) {
+        auto entity = node_of.find(rule.entity_id);
+        auto counterparty = node_of.find(rule.counterparty_id);
+        if (entity == node_of.end() || counterparty == node_of.end() || entity->second == counterparty->second) {
+            continue;
+        }
+
+        std::vector<std::string> reduced{rule.line_item};
+        for (const auto& code : rule.also_reduce) {
+            if (std::find(reduced.begin(), reduced.end(), code) == reduced.end()) {
+                reduced.push_back(code);
+            }
+        }
+        auto [group, added] = group_of.emplace(reduced, groups_.size());
+        if (added) {
+            groups_.push_back({rule.line_item, std::move(reduced)});
+        }
+
+        const int parent = common_parent(entity->second, counterparty->second);
+        Entries& block = entries[{group->second, tree.nodes[parent].depth}];
+        block.rows.emplace(parent, 0);
+        block.columns.emplace(entity->second, 0);
+        block.shares.emplace_back(parent, entity->second, rule.share);
+        ++rules_;
+    }
+
+    for (auto& [key, block_entries] : entries) {
+        Block block;
+        block.group = key.first;
+        block.depth = key.second;
+        for (auto& [node, row] : block_entries.rows) {
+            row = static_cast<int>(block.parents.size());
+            block.parents.push_back(node);
+        }
+        for (auto& [node, column] : block_entries.columns) {
+            column = static_cast<int>(block.sources.size());
+            block.sources.push_back(node);
+        }
+
+        // Duplicate (parent, source) entries add up
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(block_entries.shares.size());
+        for (const auto& [parent, source, share] : block_entries.shares) {
+            triplets.emplace_back(block_entries.rows.at(parent), block_entries.columns.at(source), share);
+        }
+        block.shares.resize(static_cast<Eigen::Index>(block.parents.size()),
+                            static_cast<Eigen::Index>(block.sources.size()));
+        block.shares.setFromTriplets(triplets.begin(), triplets.end());
+        blocks_.push_back(std::move(block));
+    }
+    std::stable_sort(blocks_.begin(), blocks_.end(),
+                     [](const Block& a, const Block& b) { return a.depth > b.depth; });
+}
+
+void EliminationMatrix::apply(const EntityTree& tree, int depth, std::vector<MultiPeriodResults>& results,
+                              const Rate& rate) const {
+    for (const Block& block : blocks_) {
+        if (block.depth != depth) {
+            continue;
+        }
+        const Group& group = groups_[block.group];
+
+        size_t periods = 0;
+        for (int parent : block.parents) {
+            periods = std::max(periods, results[parent].results.size());
+        }
+        if (periods == 0) {
+            continue;
+        }
+
+        // Positions of the sources, periods stacked as columns (read before the
+        // block reduces anything: a parent with a position against its own child
+        // uses its summed value)
+        const auto columns = static_cast<Eigen::Index>(periods);
+        Eigen::MatrixXd positions = Eigen::MatrixXd::Zero(static_cast<Eigen::Index>(block.sources.size()), columns);
+        for (size_t k = 0; k < block.sources.size(); ++k) {
+            const auto& source = results[block.sources[k]].results;
+            for (size_t p = 0; p < std::min(periods, source.size()); ++p) {
+                if (const double* value = source[p].line_items.find(group.line_item)) {
+                    positions(static_cast<Eigen::Index>(k), static_cast<Eigen::Index>(p)) = *value;
+                }
+            }
+        }
+
+        // One product per parent currency (a single one without translation)
+        std::vector<std::string> currencies{std::string()};
+        if (rate) {
+            currencies.clear();
+            for (int parent : block.parents) {
+                if (std::find(currencies.begin(), currencies.end(), tree.nodes[parent].currency) == currencies.end()) {
+                    currencies.push_back(tree.nodes[parent].currency);
+                }
+            }
+        }
+        for (const std::string& currency : currencies) {
+            Eigen::MatrixXd amounts;
+            if (rate) {
+                Eigen::MatrixXd translated = positions;
+                for (size_t k = 0; k < block.sources.size(); ++k) {
+                    const std::string& from = tree.nodes[block.sources[k]].currency;
+                    if (from.empty() || currency.empty() || from == currency) {
+                        continue;
+                    }
+                    for (size_t p = 0; p < periods; ++p) {
+                        const double fx = rate(from, currency, p, group.line_item);
+                        translated(static_cast<Eigen::Index>(k), static_cast<Eigen::Index>(p)) *=
+                            std::isnan(fx) ? 0.0 : fx;
+                    }
+                }
+                amounts = block.shares * translated;
+            } else {
+                amounts = block.shares * positions;
+            }
+
+            for (size_t r = 0; r < block.parents.size(); ++r) {
+                const int parent = block.parents[r];
+                if (rate && tree.nodes[parent].currency != currency) {
+                    continue;
+                }
+                auto& parent_results = results[parent].results;
+                for (size_t p = 0; p < parent_results.size(); ++p) {
+                    const double amount = amounts(static_cast<Eigen::Index>(r), static_cast<Eigen::Index>(p));
+                    const auto& row = parent_results[p].line_items;
+                    if (amount == 0.0 || row.empty()) {
+                        continue;
+                    }
+                    std::vector<double> values = row.values();
+                    for (const auto& code : group.reduced) {
+                        const uint32_t index = row.schema()->find(code);
+                        if (index < values.size()) {
+                            values[index] -= amount;
+                        }
+                    }
+                    parent_results[p].line_items = unified::ResultRow(row.schema(), std::move(values));
+                }
+            }
+        }
+    }
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,360 @@
+/**
+ * @file job_queue.cpp
+ * @brief Asynchronous job queue implementation
+ */
+
+#include "orchestration/job_queue.h"
+#include "orchestration/period_runner.h"
+#include "orchestration/result_writer.h"
+#include "database/idatabase.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+const char* to_string(JobPriority priority) {
+    return (priority == JobPriority::BATCH) ? "batch" : "interactive";
+}
+
+const char* to_string(JobState state) {
+    switch (state) {
+        case JobState::QUEUED: return "queued";
+        case JobState::RUNNING: return "running";
+        case JobState::SUCCEEDED: return "succeeded";
+        case JobState::FAILED: return "failed";
+        case JobState::CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+// ============================================================================
+// JobSpec / JobStatus
+// ============================================================================
+
+JobSpec JobSpec::from_json(const std::string& text) {
+    JobSpec spec;
+    try {
+        const json j = json::parse(text);
+        if (!j.is_object()) {
+            throw std::invalid_argument("Job spec must be a JSON object");
+        }
+        spec.template_code = j.at("template").get<std::string>();
+        if (j.contains("entities")) {
+            spec.entities = j["entities"].get<std::vector<EntityID>>();
+        } else {
+            spec.entities.push_back(j.at("entity").get<std::string>());
+        }
+        spec.scenario_ids = j.at("scenarios").get<std::vector<ScenarioID>>();
+        spec.period_ids = j.at("periods").get<std::vector<PeriodID>>();
+        if (j.contains("opening")) {
+            spec.opening_balances = j["opening"].get<std::map<std::string, double>>();
+        }
+        const std::string priority = j.value("priority", "interactive");
+        if (priority == "batch") {
+            spec.priority = JobPriority::BATCH;
+        } else if (priority != "interactive") {
+            throw std::invalid_argument("Job spec: priority must be interactive or batch, not " + priority);
+        }
+        spec.write_results = j.value("write_results", false);
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("Job spec: ") + e.what());
+    }
+    spec.validate();
+    return spec;
+}
+
+void JobSpec::validate() const {
+    if (template_code.empty()) {
+        throw std::invalid_argument("Job spec: template must not be empty");
+    }
+    if (entities.empty() || scenario_ids.empty() || period_ids.empty()) {
+        throw std::invalid_argument("Job spec: entities, scenarios and periods must not be empty");
+    }
+}
+
+std::string JobStatus::to_json() const {
+    json j = {
+        {"job_id", id},
+        {"state", to_string(state)},
+        {"priority", to_string(priority)},
+        {"runs", runs},
+        {"runs_done", runs_done},
+        {"failed_runs", failed_runs},
+        {"periods", periods},
+        {"periods_done", periods_done},
+        {"seconds", seconds},
+    };
+    if (!error.empty()) {
+        j["error"] = error;
+    }
+    return j.dump();
+}
+
+// ============================================================================
+// JobQueue
+// ============================================================================
+
+JobQueue::JobQueue(ConnectionFactory connect, size_t workers, size_t batch_workers)
+    : connect_(std::move(connect)), batch_workers_(std::min(batch_workers, workers)) {
+    if (workers == 0) {
+        throw std::invalid_argument("JobQueue: needs at least one worker");
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+JobQueue::~JobQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for (auto& [id, job] : jobs_) {
+            job->cancel_requested = true;
+        }
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+uint64_t JobQueue::submit(JobSpec spec) {
+    spec.validate();
+    auto job = std::make_shared<Job>();
+    job->status.priority = spec.priority;
+    job->status.runs = spec.entities.size() * spec.scenario_ids.size();
+    job->status.periods = job->status.runs * spec.period_ids.size();
+    job->spec = std::move(spec);
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = next_id_++;
+        job->status.id = id;
+        jobs_[id] = job;
+        (job->spec.priority == JobPriority::BATCH ? batch_ : interactive_).push_back(job);
+        emit_status(*job);
+        forget_finished();
+    }
+    work_ready_.notify_one();
+    return id;
+}
+
+bool JobQueue::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end() || it->second->status.finished()) {
+        return false;
+    }
+    Job& job = *it->second;
+    job.cancel_requested = true;
+    if (job.status.state == JobState::QUEUED) {
+        auto& queue = (job.spec.priority == JobPriority::BATCH) ? batch_ : interactive_;
+        queue.erase(std::remove(queue.begin(), queue.end(), it->second), queue.end());
+        job.status.state = JobState::CANCELLED;
+        emit_status(job);
+    }
+    return true;
+}
+
+std::optional<JobStatus> JobQueue::status(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) {
+        return std::nullopt;
+    }
+    JobStatus status = it->second->status;
+    if (status.state == JobState::RUNNING) {
+        status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - it->second->started).count();
+    }
+    return status;
+}
+
+std::vector<JobStatus> JobQueue::list() const {
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [id, job] : jobs_) {
+            ids.push_back(id);
+        }
+    }
+    std::vector<JobStatus> statuses;
+    for (uint64_t id : ids) {
+        if (auto status = this->status(id)) {
+            statuses.push_back(*status);
+        }
+    }
+    return statuses;
+}
+
+std::vector<JobEvent> JobQueue::events(uint64_t id, uint64_t after, std::chrono::milliseconds wait,
+                                       bool* finished) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) {
+        throw std::out_of_range("JobQueue: no job " + std::to_string(id));
+    }
+    const std::shared_ptr<Job> job = it->second;   // Kept even if forgotten meanwhile
+    progress_.wait_for(lock, wait, [&] { return job->next_sequence > after + 1 || job->status.finished(); });
+
+    std::vector<JobEvent> events;
+    for (const auto& event : job->events) {
+        if (event.sequence > after) {
+            events.push_back(event);
+        }
+    }
+    if (finished) {
+        *finished = job->status.finished();
+    }
+    return events;
+}
+
+void JobQueue::emit(Job& job, std::string type, std::string data) {
+    job.events.push_back({job.next_sequence++, std::move(type), std::move(data)});
+    if (job.events.size() > MAX_EVENTS) {
+        job.events.pop_front();
+    }
+    progress_.notify_all();
+}
+
+void JobQueue::emit_status(Job& job) {
+    if (job.status.state == JobState::RUNNING || job.status.finished()) {
+        job.status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started).count();
+    }
+    emit(job, "status", job.status.to_json());
+}
+
+void JobQueue::forget_finished() {
+    size_t finished = 0;
+    for (const auto& [id, job] : jobs_) {
+        finished += job->status.finished() ? 1 : 0;
+    }
+    for (auto it = jobs_.begin(); it != jobs_.end() && finished > MAX_FINISHED_JOBS;) {
+        if (it->second->status.finished()) {
+            it = jobs_.erase(it);
+            --finished;
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<JobQueue::Job> JobQueue::next_job() {
+    std::shared_ptr<Job> job;
+    if (!interactive_.empty()) {
+        job = interactive_.front();
+        interactive_.pop_front();
+    } else if (!batch_.empty() && running_batch_ < batch_workers_) {
+        job = batch_.front();
+        batch_.pop_front();
+        ++running_batch_;
+    }
+    return job;
+}
+
+void JobQueue::worker_loop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this] {
+                return stopping_ || !interactive_.empty() || (!batch_.empty() && running_batch_ < batch_workers_);
+            });
+            if (stopping_) {
+                return;
+            }
+            job = next_job();
+            job->status.state = JobState::RUNNING;
+            job->started = std::chrono::steady_clock::now();
+            emit_status(*job);
+        }
+
+        const std::string error = run(job);
+
+        {
+            // Final state and its event together: a reader seeing the job finished has seen all its events
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (job->spec.priority == JobPriority::BATCH) {
+                --running_batch_;
+            }
+            if (job->cancel_requested) {
+                job->status.state = JobState::CANCELLED;
+            } else {
+                job->status.state = error.empty() ? JobState::SUCCEEDED : JobState::FAILED;
+                job->status.error = error;
+            }
+            emit_status(*job);
+            forget_finished();
+        }
+        work_ready_.notify_all();
+    }
+}
+
+std::string JobQueue::run(const std::shared_ptr<Job>& job) {
+    const JobSpec& spec = job->spec;
+    std::string error;
+    try {
+        auto db = connect_();
+        PeriodRunner runner(db);
+        std::shared_ptr<ResultWriter> writer;
+        if (spec.write_results) {
+            writer = std::make_shared<ResultWriter>(connect_());
+            runner.set_result_writer(writer);
+        }
+        runner.set_period_observer([this, job](const EntityID& entity, ScenarioID scenario, PeriodID period,
+                                               const unified::UnifiedResult& result) {
+            json data = {{"entity", entity}, {"scenario", scenario}, {"period", period},
+                         {"success", result.success}, {"line_items", result.line_items.size()}};
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++job->status.periods_done;
+            emit(*job, "period", data.dump());
+            return !job->cancel_requested;
+        });
+
+        BalanceSheet opening{};
+        opening.line_items = spec.opening_balances;
+
+        for (const auto& entity : spec.entities) {
+            for (ScenarioID scenario : spec.scenario_ids) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (job->cancel_requested) {
+                        break;
+                    }
+                }
+                auto results = runner.run_periods(entity, scenario, spec.period_ids, opening, spec.template_code);
+
+                json data = {{"entity", entity}, {"scenario", scenario}, {"success", results.success},
+                             {"periods", results.results.size()}};
+                if (!results.errors.empty()) {
+                    data["error"] = results.errors.front();
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (job->cancel_requested && !results.success) {
+                    break;   // The cancelled run: not a failure of the job
+                }
+                ++job->status.runs_done;
+                if (!results.success) {
+                    ++job->status.failed_runs;
+                    if (error.empty() && !results.errors.empty()) {
+                        error = results.errors.front();
+                    }
+                }
+                emit(*job, "run", data.dump());
+            }
+        }
+        if (writer) {
+            writer->flush();
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    return error;
+}
+
+} // namespace orchestration
+} // namespace finmodel
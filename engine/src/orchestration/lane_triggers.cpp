@@ -0,0 +1,179 @@
+/**
+ * @file lane_triggers.cpp
+ * @brief Management action triggers evaluated over scenario lanes
+ */
+
+#include "orchestration/lane_triggers.h"
+#include "core/formula_evaluator.h"
+#include "database/result_set.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+LaneTriggers::LaneTriggers(std::vector<ActionTrigger> triggers, size_t lanes)
+    : triggers_(std::move(triggers))
+    , lanes_(lanes)
+    , words_((lanes + 63) / 64)
+    , evaluator_(lanes)
+    , zeros_(core::LaneArray::Zero(static_cast<Eigen::Index>(lanes)))
+{
+    // Prepared as PeriodRunner::compiled_triggers_for()
+    core::FormulaEvaluator compiler;
+    std::map<std::string, size_t> sticky;
+    for (const auto& row : triggers_) {
+        Compiled trigger;
+        trigger.last = (row.end_period > 0) ? row.end_period : -1;
+        if (row.trigger_type == "UNCONDITIONAL") {
+            trigger.kind = Kind::WINDOW;
+            trigger.first = row.start_period;
+        } else if (row.trigger_type == "TIMED") {
+            trigger.kind = (row.trigger_period > 0) ? Kind::WINDOW : Kind::NEVER;
+            trigger.first = row.trigger_period;
+        } else if (row.trigger_type == "CONDITIONAL" && !row.trigger_condition.empty()) {
+            trigger.kind = Kind::CONDITIONAL;
+            trigger.first = row.start_period;
+            try {
+                trigger.condition = compiler.compile(row.trigger_condition);
+            } catch (const std::exception&) {
+                // A condition that doesn't compile is never met
+            }
+        }
+        trigger.sticky = sticky.emplace(row.action_code, sticky.size()).first->second;
+        compiled_.push_back(std::move(trigger));
+    }
+
+    active_.assign(triggers_.size(), std::vector<uint64_t>(words_, 0));
+    triggered_.assign(sticky.size(), std::vector<uint64_t>(words_, 0));
+}
+
+std::vector<ActionTrigger> LaneTriggers::query(database::IDatabase& db, ScenarioID scenario_id) {
+    std::string sql = R"(
+        SELECT action_code, trigger_type, trigger_condition, trigger_period,
+               start_period, end_period, trigger_sticky
+        FROM scenario_action
+        WHERE scenario_id = :scenario_id
+        ORDER BY action_code
+    )";
+
+    auto result = db.execute_query(sql, {{"scenario_id", scenario_id}});
+
+    std::vector<ActionTrigger> triggers;
+    while (result->next()) {
+        ActionTrigger trigger;
+        trigger.action_code = result->get_string("action_code");
+        trigger.trigger_type = result->get_string("trigger_type");
+        trigger.trigger_condition = result->is_null("trigger_condition") ? "" : result->get_string("trigger_condition");
+        trigger.trigger_period = result->is_null("trigger_period") ? -1 : result->get_int("trigger_period");
+        trigger.start_period = result->get_int("start_period");
+        trigger.end_period = result->is_null("end_period") ? -1 : result->get_int("end_period");
+        trigger.trigger_sticky = result->is_null("trigger_sticky") ? true : (result->get_int("trigger_sticky") != 0);
+        triggers.push_back(std::move(trigger));
+    }
+    return triggers;
+}
+
+void LaneTriggers::reset() {
+    for (auto& lanes : triggered_) {
+        std::fill(lanes.begin(), lanes.end(), 0);
+    }
+}
+
+void LaneTriggers::condition_lanes(const Compiled& trigger, const unified::LaneResult* prior,
+                                   std::vector<uint64_t>& out) {
+    std::fill(out.begin(), out.end(), 0);
+    if (!trigger.condition) {
+        return;
+    }
+
+    core::LaneArray met;
+    try {
+        met = evaluator_.evaluate(*trigger.condition, [&](const core::VariableRef& var, uint32_t,
+                                                          core::LaneArray& values) {
+            const core::LaneArray* found = prior ? prior->find(var.code) : nullptr;
+            values = found ? *found : zeros_;
+        });
+    } catch (const std::exception&) {
+        return;  // A failing condition is treated as false
+    }
+    for (size_t lane = 0; lane < lanes_; ++lane) {
+        if (met[static_cast<Eigen::Index>(lane)] != 0.0) {
+            out[lane / 64] |= uint64_t{1} << (lane % 64);
+        }
+    }
+}
+
+void LaneTriggers::evaluate(PeriodID period_id, const unified::LaneResult* prior) {
+    if (prior) {
+        for (const auto& values : prior->values) {
+            if (static_cast<size_t>(values.size()) != lanes_) {
+                throw std::invalid_argument("LaneTriggers: prior values need " + std::to_string(lanes_) +
+                                            " lanes, got " + std::to_string(values.size()));
+            }
+        }
+    }
+    const bool has_prior = prior && !prior->values.empty();
+
+    std::vector<uint64_t> met(words_, 0);
+    for (size_t t = 0; t < compiled_.size(); ++t) {
+        const Compiled& trigger = compiled_[t];
+        std::vector<uint64_t>& active = active_[t];
+        const bool in_window = period_id >= trigger.first && (trigger.last < 0 || period_id <= trigger.last);
+        std::fill(active.begin(), active.end(), 0);
+
+        if (trigger.kind == Kind::WINDOW) {
+            if (in_window) {
+                std::fill(active.begin(), active.end(), ~uint64_t{0});
+            }
+        } else if (trigger.kind == Kind::CONDITIONAL && period_id >= trigger.first) {
+            std::vector<uint64_t>& triggered = triggered_[trigger.sticky];
+            if (triggers_[t].trigger_sticky) {
+                // Fired lanes stay active in the window and are released after it; the
+                // others fire where the condition holds
+                const std::vector<uint64_t> before = triggered;
+                condition_lanes(trigger, prior, met);
+                for (size_t w = 0; w < words_; ++w) {
+                    const uint64_t fired = met[w] & ~before[w];
+                    active[w] = (in_window ? before[w] : 0) | fired;
+                    triggered[w] = active[w];
+                }
+            } else if (period_id != 1 && has_prior && in_window) {
+                // Non-sticky: active in the periods its condition holds (not evaluable in period 1)
+                condition_lanes(trigger, prior, active);
+            }
+        }
+
+        // Bits past the last lane stay clear
+        if (lanes_ % 64 != 0 && words_ > 0) {
+            const uint64_t used = (uint64_t{1} << (lanes_ % 64)) - 1;
+            active[words_ - 1] &= used;
+            triggered_[trigger.sticky][words_ - 1] &= used;
+        }
+    }
+}
+
+std::vector<LaneTriggers::Group> LaneTriggers::groups() const {
+    const size_t trigger_words = (triggers_.size() + 63) / 64;
+    std::map<std::vector<uint64_t>, size_t> index;
+    std::vector<Group> groups;
+    std::vector<uint64_t> key(trigger_words);
+    for (size_t lane = 0; lane < lanes_; ++lane) {
+        std::fill(key.begin(), key.end(), 0);
+        for (size_t t = 0; t < triggers_.size(); ++t) {
+            if (active(t, lane)) {
+                key[t / 64] |= uint64_t{1} << (t % 64);
+            }
+        }
+        auto [it, added] = index.emplace(key, groups.size());
+        if (added) {
+            groups.push_back({key, {}});
+        }
+        groups[it->second].lanes.push_back(lane);
+    }
+    return groups;
+}
+
+} // namespace orchestration
+} // namespace finmodel
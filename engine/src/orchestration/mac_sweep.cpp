@@ -0,0 +1,245 @@
+/**
+ * @file mac_sweep.cpp
+ * @brief Implementation of the interaction-aware MAC sweep
+ */
+
+#include "orchestration/mac_sweep.h"
+#include "orchestration/scenario_generator.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Returned by MACCurveEngine for reductions too small to divide by
+constexpr double UNBOUNDED_MAC = 1e9;
+
+/// Groups of actions linked by interactions (union-find)
+class ActionGroups {
+public:
+    explicit ActionGroups(size_t n) : parent_(n) {
+        std::iota(parent_.begin(), parent_.end(), size_t{0});
+    }
+
+    size_t find(size_t i) {
+        while (parent_[i] != i) {
+            parent_[i] = parent_[parent_[i]];
+            i = parent_[i];
+        }
+        return i;
+    }
+
+    void join(size_t a, size_t b) { parent_[find(a)] = find(b); }
+
+private:
+    std::vector<size_t> parent_;
+};
+
+double factorial(size_t n) {
+    double f = 1.0;
+    for (size_t i = 2; i <= n; ++i) {
+        f *= static_cast<double>(i);
+    }
+    return f;
+}
+
+} // namespace
+
+MACSweep::MACSweep(std::vector<MACAction> actions, ScenarioRun run, MACSweepOptions options)
+    : actions_(std::move(actions))
+    , run_(std::move(run))
+    , options_(options)
+{
+    if (actions_.size() > CombinationRange::MAX_ACTIONS) {
+        throw std::invalid_argument("MACSweep: " + std::to_string(actions_.size()) +
+                                    " actions, at most " + std::to_string(CombinationRange::MAX_ACTIONS));
+    }
+    if (!run_) {
+        throw std::invalid_argument("MACSweep: no scenario run function");
+    }
+    if (options_.capex_amortization_years <= 0) {
+        throw std::invalid_argument("MACSweep: amortization years must be positive");
+    }
+    if (options_.max_group_size > 20) {
+        throw std::invalid_argument("MACSweep: groups of more than 20 actions can't be combined in full");
+    }
+}
+
+double MACSweep::emissions(uint64_t active_actions) {
+    auto it = emissions_.find(active_actions);
+    if (it == emissions_.end()) {
+        it = emissions_.emplace(active_actions, run_(active_actions)).first;
+    }
+    return it->second;
+}
+
+double MACSweep::marginal_cost(const MACAction& action, double reduction) const {
+    if (std::abs(reduction) < 1e-6) {
+        return UNBOUNDED_MAC;
+    }
+    const double capex_annual = action.capex / static_cast<double>(options_.capex_amortization_years);
+    return (capex_annual + action.opex_annual) / reduction;
+}
+
+MACSweepResult MACSweep::run() {
+    emissions_.clear();
+    MACSweepResult result;
+    const size_t n = actions_.size();
+    auto bit = [](size_t i) { return uint64_t{1} << i; };
+
+    // 1. Baseline and single actions
+    result.baseline_emissions = emissions(0);
+    std::vector<double> reduction(n);
+    for (size_t i = 0; i < n; ++i) {
+        reduction[i] = result.baseline_emissions - emissions(bit(i));
+    }
+
+    // 2. Sampled pairs: interaction = pair reduction - sum of single reductions
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            pairs.emplace_back(i, j);
+        }
+    }
+    if (pairs.size() > options_.max_pairs) {
+        std::mt19937_64 rng(options_.seed);
+        std::shuffle(pairs.begin(), pairs.end(), rng);
+        pairs.resize(options_.max_pairs);
+        std::sort(pairs.begin(), pairs.end());
+    }
+
+    ActionGroups groups(n);
+    std::vector<double> largest_interaction(n, -1.0);   // -1: no pair of the action measured
+    double largest_overall = 0.0;
+    for (const auto& [i, j] : pairs) {
+        const double pair_reduction = result.baseline_emissions - emissions(bit(i) | bit(j));
+        const double interaction = std::abs(pair_reduction - reduction[i] - reduction[j]);
+        largest_interaction[i] = std::max(largest_interaction[i], interaction);
+        largest_interaction[j] = std::max(largest_interaction[j], interaction);
+        largest_overall = std::max(largest_overall, interaction);
+
+        const double scale = std::abs(reduction[i]) + std::abs(reduction[j]);
+        if (interaction > options_.min_interaction && interaction > options_.interaction_threshold * scale) {
+            result.interacting_pairs.emplace_back(actions_[i].action_code, actions_[j].action_code);
+            groups.join(i, j);
+        }
+    }
+    result.pairs_measured = pairs.size();
+
+    // Points start from the single-action reductions; unmeasured actions are
+    // bounded by the largest interaction seen anywhere
+    std::vector<MACSweepPoint> points(n);
+    for (size_t i = 0; i < n; ++i) {
+        points[i].point.annual_reduction_tco2e = reduction[i];
+        points[i].reduction_error = (largest_interaction[i] < 0.0) ? largest_overall : largest_interaction[i];
+    }
+
+    // 3. Full combinations within interacting groups, others off
+    std::map<size_t, std::vector<size_t>> members;
+    for (size_t i = 0; i < n; ++i) {
+        members[groups.find(i)].push_back(i);
+    }
+    for (const auto& [root, group] : members) {
+        if (group.size() < 2 || group.size() > options_.max_group_size) {
+            continue;
+        }
+        std::vector<std::string> codes;
+        for (size_t i : group) {
+            codes.push_back(actions_[i].action_code);
+        }
+        result.combined_groups.push_back(codes);
+
+        // Gray code order: neighbouring runs differ by one action
+        const CombinationRange range(codes, 0, "MAC", CombinationOrder::GRAY);
+        auto global_mask = [&](uint64_t local) {
+            uint64_t mask = 0;
+            for (size_t k = 0; k < group.size(); ++k) {
+                if (local & bit(k)) {
+                    mask |= bit(group[k]);
+                }
+            }
+            return mask;
+        };
+        for (const ScenarioMask& combination : range) {
+            emissions(global_mask(combination.actions));
+        }
+
+        // Shapley value: marginal reductions weighted by |S|! (k - |S| - 1)! / k!
+        const size_t k = group.size();
+        const double all_orders = factorial(k);
+        for (size_t m = 0; m < k; ++m) {
+            std::vector<double> marginals;
+            double shapley = 0.0;
+            for (const ScenarioMask& combination : range) {
+                if (combination.actions & bit(m)) {
+                    continue;
+                }
+                const uint64_t without = global_mask(combination.actions);
+                const double marginal = emissions(without) - emissions(without | bit(group[m]));
+                const size_t size = static_cast<size_t>(std::popcount(combination.actions));
+                shapley += marginal * factorial(size) * factorial(k - size - 1) / all_orders;
+                marginals.push_back(marginal);
+            }
+            double deviation = 0.0;
+            for (double marginal : marginals) {
+                deviation = std::max(deviation, std::abs(marginal - shapley));
+            }
+            auto& point = points[group[m]];
+            point.point.annual_reduction_tco2e = shapley;
+            point.reduction_error = deviation;
+            point.combined = true;
+        }
+    }
+
+    // Costs and MAC ranges
+    for (size_t i = 0; i < n; ++i) {
+        auto& entry = points[i];
+        auto& point = entry.point;
+        const MACAction& action = actions_[i];
+        point.action_code = action.action_code;
+        point.action_name = action.action_name;
+        point.action_category = action.action_category;
+        point.capex = action.capex;
+        point.opex_annual = action.opex_annual;
+        point.total_annual_cost = action.capex / static_cast<double>(options_.capex_amortization_years) +
+                                  action.opex_annual;
+        point.marginal_cost_per_tco2e = marginal_cost(action, point.annual_reduction_tco2e);
+        point.start_period = 1;
+        point.end_period = -1;
+
+        const double low_reduction = point.annual_reduction_tco2e - entry.reduction_error;
+        const double high_reduction = point.annual_reduction_tco2e + entry.reduction_error;
+        if (low_reduction <= 1e-6 && high_reduction >= -1e-6) {
+            // The reduction may be zero: any cost per tonne
+            entry.mac_low = -UNBOUNDED_MAC;
+            entry.mac_high = UNBOUNDED_MAC;
+        } else {
+            const double a = marginal_cost(action, low_reduction);
+            const double b = marginal_cost(action, high_reduction);
+            entry.mac_low = std::min(a, b);
+            entry.mac_high = std::max(a, b);
+        }
+    }
+
+    std::sort(points.begin(), points.end(), [](const MACSweepPoint& a, const MACSweepPoint& b) {
+        return a.point.marginal_cost_per_tco2e < b.point.marginal_cost_per_tco2e;
+    });
+    double cumulative = 0.0;
+    for (auto& entry : points) {
+        cumulative += entry.point.annual_reduction_tco2e;
+        entry.point.cumulative_reduction_tco2e = cumulative;
+    }
+
+    result.points = std::move(points);
+    result.scenarios_run = emissions_.size();
+    return result;
+}
+
+} // namespace orchestration
+} // namespace finmodel
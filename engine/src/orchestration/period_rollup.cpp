@@ -0,0 +1,132 @@
+/**
+ * @file period_rollup.cpp
+ * @brief Calendar buckets of a run's periods
+ */
+
+#include "orchestration/period_rollup.h"
+#include "database/result_set.h"
+#include <stdexcept>
+#include <unordered_map>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+struct PeriodRow {
+    std::string start_date;
+    std::string end_date;
+    int days = 0;
+    std::string label;
+};
+
+// Bucket key of a date: 2024, 2024-Q1 or 2024-01
+std::string bucket_key(const std::string& date, PeriodGranularity granularity) {
+    if (date.size() < 7) {
+        throw std::invalid_argument("PeriodRollup: invalid date " + date);
+    }
+    switch (granularity) {
+        case PeriodGranularity::ANNUAL:
+            return date.substr(0, 4);
+        case PeriodGranularity::QUARTERLY:
+            return date.substr(0, 4) + "-Q" + std::to_string((std::stoi(date.substr(5, 2)) - 1) / 3 + 1);
+        case PeriodGranularity::MONTHLY:
+            break;
+    }
+    return date.substr(0, 7);
+}
+
+} // namespace
+
+PeriodRollup PeriodRollup::load(database::IDatabase& db, const std::vector<PeriodID>& period_ids,
+                                PeriodGranularity granularity) {
+    std::unordered_map<PeriodID, PeriodRow> rows;
+    auto result_set = db.execute_query("SELECT period_id, start_date, end_date, days_in_period, label FROM period", {});
+    if (result_set) {
+        for (auto [period_id, start_date, end_date, days, label] :
+             result_set->rows<int, std::string_view, std::string_view, int, std::string_view>()) {
+            rows[period_id] = {std::string(start_date), std::string(end_date), days, std::string(label)};
+        }
+    }
+
+    std::vector<RollupBucket> buckets;
+    std::vector<int> period_days;
+    std::string open_key;   // Key of the last bucket, empty if it can't take more periods
+    for (size_t i = 0; i < period_ids.size(); ++i) {
+        auto row = rows.find(period_ids[i]);
+        if (row == rows.end()) {
+            throw std::invalid_argument("PeriodRollup: period " + std::to_string(period_ids[i]) +
+                                        " is not in the period table");
+        }
+        const PeriodRow& period = row->second;
+        period_days.push_back(period.days);
+
+        const std::string key = bucket_key(period.start_date, granularity);
+        if (key != bucket_key(period.end_date, granularity)) {
+            // Longer than a bucket: reported as it is
+            buckets.push_back({period.label, i, i, period.days});
+            open_key.clear();
+        } else if (!buckets.empty() && key == open_key) {
+            buckets.back().last = i;
+            buckets.back().days += period.days;
+        } else {
+            buckets.push_back({key, i, i, period.days});
+            open_key = key;
+        }
+    }
+    return PeriodRollup(std::move(buckets), std::move(period_days));
+}
+
+PeriodRollup::PeriodRollup(std::vector<RollupBucket> buckets, std::vector<int> period_days)
+    : buckets_(std::move(buckets))
+    , period_days_(std::move(period_days))
+{
+    size_t next = 0;
+    for (const auto& bucket : buckets_) {
+        if (bucket.first != next || bucket.last < bucket.first || bucket.last >= period_days_.size()) {
+            throw std::invalid_argument("PeriodRollup: buckets must cover the periods in order");
+        }
+        next = bucket.last + 1;
+    }
+    if (next != period_days_.size()) {
+        throw std::invalid_argument("PeriodRollup: buckets must cover the periods in order");
+    }
+}
+
+void PeriodRollup::set_time_scaling(const core::TimeScaling& scaling) {
+    stocks_ = std::unordered_set<std::string>(scaling.stocks.begin(), scaling.stocks.end());
+    rates_ = std::unordered_set<std::string>(scaling.rates.begin(), scaling.rates.end());
+}
+
+double PeriodRollup::value(const MultiPeriodResults& results, const std::string& code, size_t bucket) const {
+    if (results.results.size() != period_days_.size()) {
+        throw std::invalid_argument("PeriodRollup: results have " + std::to_string(results.results.size()) +
+                                    " periods, the rollup " + std::to_string(period_days_.size()));
+    }
+    const RollupBucket& b = buckets_.at(bucket);
+    if (stocks_.count(code)) {
+        return results.results[b.last].get_value(code);
+    }
+
+    const bool rate = rates_.count(code) != 0;
+    double total = 0.0;
+    double days = 0.0;
+    for (size_t i = b.first; i <= b.last; ++i) {
+        const double weight = rate ? static_cast<double>(period_days_[i]) : 1.0;
+        total += weight * results.results[i].get_value(code);
+        days += weight;
+    }
+    return (rate && days > 0.0) ? total / days : total;
+}
+
+std::vector<double> PeriodRollup::series(const MultiPeriodResults& results, const std::string& code) const {
+    std::vector<double> out;
+    out.reserve(buckets_.size());
+    for (size_t b = 0; b < buckets_.size(); ++b) {
+        out.push_back(value(results, code, b));
+    }
+    return out;
+}
+
+} // namespace orchestration
+} // namespace finmodel
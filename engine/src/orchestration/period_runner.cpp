@@ -4,14 +4,78 @@
  */
 
 #include "orchestration/period_runner.h"
+#include "orchestration/budgeted_results.h"
 #include "actions/action_engine.h"
+#include "core/engine_metrics.h"
+#include "core/time_series.h"
 #include "database/result_set.h"
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
 
 namespace finmodel {
 namespace orchestration {
 
+namespace {
+
+/**
+ * @brief A ResultCache miss claimed by a run: released unless its results are stored
+ */
+class CacheClaim {
+public:
+    CacheClaim(ResultCache* cache, const std::optional<RunFingerprint>& fingerprint)
+        : cache_(fingerprint ? cache : nullptr), fingerprint_(fingerprint.value_or(RunFingerprint{})) {}
+    CacheClaim(const CacheClaim&) = delete;
+    CacheClaim& operator=(const CacheClaim&) = delete;
+
+    ~CacheClaim() {
+        if (cache_) {
+            cache_->release(fingerprint_);
+        }
+    }
+
+    explicit operator bool() const { return cache_ != nullptr; }
+
+    void store(CachedRun run) {
+        std::exchange(cache_, nullptr)->store(fingerprint_, std::move(run));
+    }
+
+private:
+    ResultCache* cache_;
+    RunFingerprint fingerprint_;
+};
+
+/**
+ * @brief Add every column of a query's rows (a missing table adds a marker)
+ *
+ * Values go in as text and as doubles: SQLite's text of a REAL keeps only
+ * 15 digits.
+ */
+void add_rows(FingerprintBuilder& builder, database::IDatabase& db, const std::string& sql, const ParamMap& params) {
+    try {
+        auto rows = db.execute_query(sql, params);
+        int64_t count = 0;
+        while (rows && rows->next()) {
+            for (size_t i = 0; i < rows->column_count(); ++i) {
+                builder.add_int(rows->is_null(i) ? 0 : 1).add_text(rows->get_text(i)).add_double(rows->get_double(i));
+            }
+            ++count;
+        }
+        builder.add_int(count);
+    } catch (const database::DatabaseException&) {
+        builder.add_int(-1);
+    }
+}
+
+} // namespace
+
 PeriodRunner::PeriodRunner(std::shared_ptr<database::IDatabase> db)
     : db_(db)
 {
@@ -21,6 +85,21 @@ PeriodRunner::PeriodRunner(std::shared_ptr<database::IDatabase> db)
 
     // Create unified engine
     engine_ = std::make_unique<unified::UnifiedEngine>(db_);
+    engine_->set_arena(&arena_);
+}
+
+PeriodRunner::PeriodRunner(std::shared_ptr<database::IDatabase> db,
+                           std::shared_ptr<core::ReferenceDataStore> reference)
+    : db_(db)
+    , reference_(reference)
+{
+    if (!db_) {
+        throw std::runtime_error("PeriodRunner: null database pointer");
+    }
+
+    // Create unified engine on the shared FX rates and unit factors
+    engine_ = std::make_unique<unified::UnifiedEngine>(db_, std::move(reference));
+    engine_->set_arena(&arena_);
 }
 
 MultiPeriodResults PeriodRunner::run_periods(
@@ -29,8 +108,141 @@ MultiPeriodResults PeriodRunner::run_periods(
     const std::vector<PeriodID>& period_ids,
     const BalanceSheet& initial_bs,
     const std::string& template_code
+) {
+    return run_periods(entity_id, scenario_id, period_ids, initial_bs, template_code, nullptr);
+}
+
+MultiPeriodResults PeriodRunner::run_periods(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const unified::DriverValueProvider::DriverRows& drivers
+) {
+    JobInputs inputs;
+    inputs.drivers = drivers;
+    return run_periods(entity_id, scenario_id, period_ids, initial_bs, template_code, &inputs);
+}
+
+MultiPeriodResults PeriodRunner::run_periods(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const JobInputs* prefetched
 ) {
     MultiPeriodResults results;
+    const auto started = std::chrono::steady_clock::now();
+
+    // A reload published since the last run applies from this one on
+    engine_->refresh_reference_data();
+
+    ResultWriter::RunHandle run = 0;
+    if (writer_) {
+        std::ostringstream config;
+        config << "{\"entity\": " << std::quoted(entity_id)
+               << ", \"template\": " << std::quoted(template_code)
+               << ", \"periods\": " << period_ids.size()
+               << ", \"validation\": " << validation_policy_.to_json() << "}";
+        run = writer_->begin_run(scenario_id, config.str());
+    }
+
+    // Slow-run trace (set_tail_latency()): a few clock reads per period
+    std::optional<RunTrace> trace;
+    if (tail_latency_) {
+        trace.emplace();
+        trace->entity_id = entity_id;
+        trace->scenario_id = scenario_id;
+    }
+
+    // Actions are read once per run (see triggers_for() / actions_for())
+    scenario_triggers_.clear();
+    scenario_actions_.clear();
+    compiled_triggers_.clear();
+    if (prefetched && prefetched->triggers) {
+        scenario_triggers_[scenario_id] = *prefetched->triggers;
+    }
+
+    // A run with the same inputs was calculated before (set_result_cache()): replay its periods
+    const unified::DriverValueProvider::DriverRows* drivers =
+        (prefetched && prefetched->drivers) ? &*prefetched->drivers : nullptr;
+    unified::DriverValueProvider::DriverRows fetched_drivers;
+    std::optional<RunFingerprint> fingerprint;
+    if (result_cache_ && !checkpoints_ && sensitivity_drivers_.empty()) {
+        if (!drivers) {
+            fetched_drivers = unified::DriverValueProvider::fetch_rows(*db_, entity_id, scenario_id, period_ids);
+            drivers = &fetched_drivers;
+        }
+        fingerprint = run_fingerprint(entity_id, scenario_id, period_ids, initial_bs, template_code, *drivers);
+        if (fingerprint) {
+            if (auto cached = result_cache_->acquire(*fingerprint)) {
+                core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_CACHE_HITS);
+                results.errors = cached->errors;
+                results.warnings = cached->warnings;
+                for (size_t p = 0; p < cached->periods.size() && p < period_ids.size(); ++p) {
+                    unified::UnifiedResult result = cached->periods[p];
+                    results.success = results.success && result.success;
+                    if (writer_) {
+                        writer_->write_period(run, entity_id, scenario_id, period_ids[p], result.line_items);
+                    }
+                    const bool proceed = !period_observer_ ||
+                                         period_observer_(entity_id, scenario_id, period_ids[p], result);
+                    results.results.push_back(std::move(result));
+                    if (!proceed) {
+                        results.add_error("Run cancelled after period " + std::to_string(period_ids[p]));
+                        break;
+                    }
+                    if (!stop_.empty()) {
+                        results.stop_reason = stop_reason(scenario_id, period_ids[p], results.results.back());
+                        if (!results.stop_reason.empty()) {
+                            results.stopped_period = period_ids[p];
+                            break;
+                        }
+                    }
+                }
+                triggered_actions_[scenario_id] = cached->triggered_actions;
+                if (trace) {
+                    trace->cached = true;
+                }
+                const std::string exemplar = record_trace(trace, started);
+                if (writer_) {
+                    writer_->end_run(run, results.success, results.errors.empty() ? "" : results.errors.front(),
+                                     std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(),
+                                     exemplar);
+                }
+                core::EngineMetrics::add(core::EngineMetrics::Counter::SCENARIOS);
+                add_horizon_measures(results);
+                return results;
+            }
+            core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_CACHE_MISSES);
+        }
+    }
+    CacheClaim claim(result_cache_.get(), fingerprint);
+
+    // Validation rules once per run and template
+    engine_->clear_validation_rules();
+
+    // Drivers are read once per run: one query for all periods
+    [[maybe_unused]] core::Profiler* profiler = core::PROFILING_BUILT ? engine_->profiler().get() : nullptr;
+    {
+        FINMODEL_PROFILE_STAGE(profiler, core::Profiler::Stage::DRIVER_LOAD);
+        const auto load_started = std::chrono::steady_clock::now();
+        engine_->clear_driver_cache();
+        if (drivers) {
+            engine_->prefetch_drivers(*drivers, period_ids);
+        } else {
+            engine_->prefetch_drivers(entity_id, scenario_id, period_ids);
+        }
+        if (trace) {
+            trace->driver_load_seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - load_started).count();
+        }
+    }
+
+    // [t-k] history starts with the run's first period
+    engine_->clear_statement_history();
 
     // Start with initial balance sheet
     BalanceSheet current_bs = initial_bs;
@@ -38,58 +250,371 @@ MultiPeriodResults PeriodRunner::run_periods(
     // Track prior period values for [t-1] references (all statements)
     std::map<std::string, double> prior_period_values;
 
+    // Path-dependent taxes (register_tax_strategy()) start from their initial state
+    unified::TaxState tax_state;
+
     // Initialize prior period values from initial BS
     for (const auto& [code, value] : initial_bs.line_items) {
         prior_period_values[code] = value;
     }
 
-    // Calculate each period sequentially
-    for (PeriodID period_id : period_ids) {
-        // Set prior period values in engine for [t-1] references
-        engine_->set_prior_period_values(prior_period_values);
-
-        // Determine which template to use for this period based on active actions
-        std::string period_template_code = get_template_for_period(
-            scenario_id,
-            period_id,
-            template_code,  // base template
-            prior_period_values  // for conditional evaluation
-        );
-
-        // Run unified calculation with period-specific template
-        auto unified_result = engine_->calculate(
-            entity_id,
-            scenario_id,
-            period_id,
-            current_bs,
-            period_template_code  // May differ per period!
-        );
-
-        // Check for errors
-        if (!unified_result.success) {
-            results.success = false;
-            for (const auto& err : unified_result.errors) {
-                results.add_error("Period " + std::to_string(period_id) + ": " + err);
+    // Continue after the last checkpoint of this run
+    size_t first = 0;
+    size_t periods_done = 0;
+    std::deque<std::pair<PeriodID, std::map<std::string, double>>> history;
+    std::optional<RunCheckpoint> resumed;
+    if (resume_from_) {
+        resumed = *resume_from_;
+    } else if (checkpoints_) {
+        resumed = checkpoints_->load(entity_id, scenario_id);
+        if (resumed && resumed->template_code != template_code) {
+            throw std::runtime_error("PeriodRunner: checkpoint of run '" + checkpoints_->run_id() +
+                                     "' used template " + resumed->template_code + ", not " + template_code);
+        }
+    }
+    if (resumed) {
+        while (first < period_ids.size() && period_ids[first] <= resumed->last_period) {
+            ++first;
+        }
+        periods_done = resumed->periods_done;
+        current_bs = std::move(resumed->closing_bs);
+        prior_period_values = std::move(resumed->prior_values);
+        tax_state = std::move(resumed->tax_state);
+        triggered_actions_[scenario_id] = std::move(resumed->triggered_actions);
+        for (auto& [period_id, values] : resumed->history) {
+            engine_->restore_statement_history(entity_id, scenario_id, period_id, values);
+            history.emplace_back(period_id, std::move(values));
+        }
+        for (const auto& error : resumed->errors) {
+            results.add_error(error);
+        }
+        results.resumed_periods = first;
+    }
+
+    try {
+        // Calculate each period sequentially
+        for (size_t p = first; p < period_ids.size(); ++p) {
+            const PeriodID period_id = period_ids[p];
+            const auto period_started = std::chrono::steady_clock::now();
+            const size_t templates_before = templates_created_;
+            const size_t reads_before = trace ? engine_->database_reads() : 0;
+            arena_.reset();
+            // Set prior period values in engine for [t-1] references
+            engine_->set_prior_period_values(prior_period_values);
+            if (!tax_strategies_.empty()) {
+                engine_->set_tax_state(tax_state);
+            }
+
+            // Determine which template to use for this period based on active actions
+            std::string period_template_code = get_template_for_period(
+                scenario_id,
+                period_id,
+                template_code,  // base template
+                prior_period_values  // for conditional evaluation
+            );
+
+            engine_->set_validation(validation_policy_.validates(scenario_id, p, period_ids.size()),
+                                    validation_policy_.skip_warnings);
+
+            // Run unified calculation with period-specific template
+            const auto calculate_started = std::chrono::steady_clock::now();
+            auto unified_result = engine_->calculate(
+                entity_id,
+                scenario_id,
+                period_id,
+                current_bs,
+                period_template_code  // May differ per period!
+            );
+            const auto calculated = std::chrono::steady_clock::now();
+
+            core::EngineMetrics::add(core::EngineMetrics::Counter::PERIODS);
+            core::EngineMetrics::add(core::EngineMetrics::Counter::LINE_ITEMS, unified_result.line_items.size());
+
+            // Check for errors
+            if (!unified_result.success) {
+                results.success = false;
+                for (const auto& err : unified_result.errors) {
+                    results.add_error("Period " + std::to_string(period_id) + ": " + err);
+                }
+                // Continue to next period even on error (collect all errors)
             }
-            // Continue to next period even on error (collect all errors)
+
+            // Collect warnings (a rule failing every period stays one record)
+            results.warnings.merge(unified_result.warnings, period_id, scenario_id);
+
+            {
+                FINMODEL_PROFILE_STAGE(profiler, core::Profiler::Stage::ROLL_FORWARD);
+
+                // Roll forward: closing BS becomes opening BS for next period
+                // (in place: the same codes every period reuse their map nodes)
+                unified_result.extract_balance_sheet(current_bs);
+
+                // Roll forward: store ALL line item values for [t-1] references
+                unified_result.get_all_values().assign_to(prior_period_values);
+                if (!tax_strategies_.empty()) {
+                    tax_state = engine_->tax_state();
+                }
+            }
+
+            if (!outputs_.empty()) {
+                project_outputs(unified_result.line_items);
+            }
+
+            if (writer_) {
+                FINMODEL_PROFILE_STAGE(profiler, core::Profiler::Stage::WRITE);
+                writer_->write_period(run, entity_id, scenario_id, period_id, unified_result.line_items);
+            }
+
+            if (checkpoints_ || checkpoint_sink_) {
+                if (unified_result.success && engine_->history_depth() > 0) {
+                    history.emplace_back(period_id, prior_period_values);
+                    if (history.size() > engine_->history_depth()) {
+                        history.pop_front();
+                    }
+                }
+                if (++periods_done % checkpoint_every_ == 0 || p + 1 == period_ids.size()) {
+                    RunCheckpoint checkpoint;
+                    checkpoint.entity_id = entity_id;
+                    checkpoint.scenario_id = scenario_id;
+                    checkpoint.template_code = template_code;
+                    checkpoint.last_period = period_id;
+                    checkpoint.periods_done = periods_done;
+                    checkpoint.closing_bs = current_bs;
+                    checkpoint.prior_values = prior_period_values;
+                    checkpoint.tax_state = tax_state;
+                    checkpoint.triggered_actions = triggered_actions_[scenario_id];
+                    checkpoint.history.assign(history.begin(), history.end());
+                    checkpoint.errors = results.errors;
+                    if (checkpoints_) {
+                        checkpoints_->save(checkpoint);
+                    }
+                    if (checkpoint_sink_) {
+                        checkpoint_sink_(checkpoint);
+                    }
+                }
+            }
+
+            if (trace) {
+                PeriodTrace period;
+                period.period_id = period_id;
+                period.template_code = period_template_code;
+                period.template_created = templates_created_ > templates_before;
+                period.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - period_started).count();
+                period.calculate_seconds = std::chrono::duration<double>(calculated - calculate_started).count();
+                period.evaluations = unified_result.line_items.size();
+                period.database_reads = engine_->database_reads() - reads_before;
+                trace->periods.push_back(std::move(period));
+            }
+
+            const bool proceed = !period_observer_ ||
+                                 period_observer_(entity_id, scenario_id, period_id, unified_result);
+
+            // Store result
+            results.results.push_back(std::move(unified_result));
+            if (!proceed) {
+                results.add_error("Run cancelled after period " + std::to_string(period_id));
+                break;
+            }
+            if (!stop_.empty()) {
+                results.stop_reason = stop_reason(scenario_id, period_id, results.results.back());
+                if (!results.stop_reason.empty()) {
+                    results.stopped_period = period_id;
+                    break;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        if (writer_) {
+            writer_->end_run(run, false, e.what(),
+                             std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        }
+        throw;
+    }
+
+    const std::string exemplar = record_trace(trace, started);
+    if (writer_) {
+        writer_->end_run(run, results.success, results.errors.empty() ? "" : results.errors.front(),
+                         std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(), exemplar);
+    }
+    core::EngineMetrics::add(core::EngineMetrics::Counter::SCENARIOS);
+
+    if (claim && results.success && !results.stopped_period) {
+        CachedRun cached;
+        cached.periods = results.results;
+        cached.errors = results.errors;
+        cached.warnings = results.warnings;
+        cached.triggered_actions = triggered_actions_[scenario_id];
+        try {
+            claim.store(std::move(cached));
+        } catch (const std::runtime_error& e) {
+            results.add_warning(e.what());
+        }
+    }
+
+    add_horizon_measures(results);
+    return results;
+}
+
+std::string PeriodRunner::record_trace(std::optional<RunTrace>& trace, std::chrono::steady_clock::time_point started) {
+    if (!trace) {
+        return "";
+    }
+    trace->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return tail_latency_->record(*trace) ? trace->to_json() : "";
+}
+
+void PeriodRunner::add_horizon_measures(MultiPeriodResults& results) const {
+    if (horizon_measures_.empty() || !results.success) {
+        return;
+    }
+    std::vector<double> values(results.results.size());
+    for (const auto& measure : horizon_measures_) {
+        for (size_t p = 0; p < results.results.size(); ++p) {
+            values[p] = results.results[p].get_value(measure.code);
         }
+        results.horizon[measure.name] = measure.kind == HorizonMeasure::Kind::NPV
+            ? core::npv(measure.rate, values.data(), values.size())
+            : core::irr(values.data(), values.size());
+    }
+}
 
-        // Collect warnings
-        for (const auto& warn : unified_result.warnings) {
-            results.add_warning("Period " + std::to_string(period_id) + ": " + warn);
+std::optional<RunFingerprint> PeriodRunner::run_fingerprint(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const unified::DriverValueProvider::DriverRows& drivers
+) {
+    auto tmpl = engine_->find_template(template_code);
+    if (!tmpl) {
+        return std::nullopt;
+    }
+    if (tmpl != fingerprinted_template_) {
+        FingerprintBuilder builder;
+        builder.add_text(tmpl->to_json());
+        add_rows(builder, *db_,
+                 "SELECT vr.rule_code, vr.rule_type, vr.formula, vr.required_line_items, vr.tolerance, vr.severity "
+                 "FROM validation_rule vr "
+                 "JOIN template_validation_rule tvr ON vr.rule_code = tvr.rule_code "
+                 "WHERE tvr.template_code = :template_code AND tvr.is_enabled = 1 AND vr.is_active = 1 "
+                 "ORDER BY vr.rule_code",
+                 {{"template_code", template_code}});
+        template_fingerprint_ = builder.finish();
+        fingerprinted_template_ = std::move(tmpl);
+    }
+    if (!reference_fingerprint_) {
+        FingerprintBuilder builder;
+        for (const char* table : {"unit_definition", "fx_rate", "wc_policy", "capex_policy"}) {
+            builder.add_text(table);
+            add_rows(builder, *db_, std::string("SELECT * FROM ") + table, {});
         }
+        reference_fingerprint_ = builder.finish();
+    }
 
-        // Store result
-        results.results.push_back(unified_result);
+    FingerprintBuilder builder;
+    builder.add_int(ResultCache::FORMAT_VERSION)
+        .add_fingerprint(template_fingerprint_)
+        .add_fingerprint(*reference_fingerprint_)
+        .add_text(entity_id)
+        .add_text(template_code);
 
-        // Roll forward: closing BS becomes opening BS for next period
-        current_bs = unified_result.extract_balance_sheet();
+    builder.add_int(static_cast<int64_t>(outputs_.size()));
+    for (const auto& code : outputs_) {
+        builder.add_text(code);
+    }
 
-        // Roll forward: store ALL line item values for [t-1] references
-        prior_period_values = unified_result.get_all_values();
+    builder.add_int(static_cast<int64_t>(period_ids.size()));
+    for (size_t p = 0; p < period_ids.size(); ++p) {
+        builder.add_int(period_ids[p]).add_int(validation_policy_.validates(scenario_id, p, period_ids.size()));
     }
+    builder.add_int(validation_policy_.skip_warnings);
 
-    return results;
+    // Effective drivers: a descendant's row overrides its ancestors', a later row an earlier one
+    using Row = unified::DriverValueProvider::DriverRows::Row;
+    const std::set<PeriodID> periods(period_ids.begin(), period_ids.end());
+    std::map<std::pair<PeriodID, std::string_view>, std::pair<size_t, const Row*>> effective;
+    for (const Row& row : drivers.rows) {
+        if (periods.count(row.period_id) == 0) {
+            continue;
+        }
+        const size_t depth = std::find(drivers.chain.begin(), drivers.chain.end(), row.scenario_id) -
+                             drivers.chain.begin();
+        auto [it, added] = effective.try_emplace({row.period_id, row.driver_code}, depth, &row);
+        if (!added && depth >= it->second.first) {
+            it->second = {depth, &row};
+        }
+    }
+    builder.add_int(static_cast<int64_t>(effective.size()));
+    for (const auto& [key, chosen] : effective) {
+        builder.add_int(key.first).add_text(key.second).add_double(chosen.second->value).add_text(chosen.second->unit_code);
+    }
+
+    // Scope 3 emissions the templates may read
+    if (scope3_results_) {
+        builder.add_int(static_cast<int64_t>(scope3_results_->categories.size()));
+        for (const auto& category : scope3_results_->categories) {
+            builder.add_text(category);
+        }
+        for (PeriodID period_id : periods) {
+            if (const auto* row = scope3_results_->find(entity_id, scenario_id, period_id)) {
+                builder.add_int(period_id);
+                for (double emissions : row->emissions) {
+                    builder.add_double(emissions);
+                }
+            }
+        }
+    }
+    builder.add_int(-1);
+
+    // Policies the templates may read as policy:NAME
+    builder.add_text(policies_ ? policies_->first : "DEFAULT").add_text(policies_ ? policies_->second : "DEFAULT");
+
+    // Actions: trigger rows, what each action patches, and the sticky triggers carried in
+    const auto& triggers = triggers_for(scenario_id);
+    builder.add_int(static_cast<int64_t>(triggers.size()));
+    for (const auto& trigger : triggers) {
+        builder.add_text(trigger.action_code)
+            .add_text(trigger.trigger_type)
+            .add_text(trigger.trigger_condition)
+            .add_int(trigger.trigger_period)
+            .add_int(trigger.start_period)
+            .add_int(trigger.end_period)
+            .add_int(trigger.trigger_sticky);
+    }
+    if (!triggers.empty()) {
+        for (const auto& action : actions_for(scenario_id)) {
+            builder.add_text(action.action.action_code).add_text(action.signature);
+        }
+    }
+    auto sticky = triggered_actions_.find(scenario_id);
+    builder.add_int(sticky == triggered_actions_.end() ? 0 : static_cast<int64_t>(sticky->second.size()));
+    if (sticky != triggered_actions_.end()) {
+        for (const auto& action : sticky->second) {
+            builder.add_text(action);
+        }
+    }
+
+    // History before the first period reads the entity's actuals
+    add_rows(builder, *db_,
+             "SELECT period_id, line_item_code, value FROM balance_sheet_actuals "
+             "WHERE entity_id = :entity_id AND scenario_id = :scenario_id ORDER BY period_id, line_item_code",
+             {{"entity_id", entity_id}, {"scenario_id", scenario_id}});
+
+    builder.add_double(initial_bs.total_assets)
+        .add_double(initial_bs.total_liabilities)
+        .add_double(initial_bs.total_equity)
+        .add_double(initial_bs.cash)
+        .add_int(static_cast<int64_t>(initial_bs.line_items.size()));
+    for (const auto& [code, value] : initial_bs.line_items) {
+        builder.add_text(code).add_double(value);
+    }
+
+    builder.add_int(static_cast<int64_t>(tax_strategies_.size()));
+    for (const auto& [name, strategy] : tax_strategies_) {
+        builder.add_text(name);
+    }
+    return builder.finish();
 }
 
 std::map<ScenarioID, MultiPeriodResults> PeriodRunner::run_multiple_scenarios(
@@ -99,22 +624,682 @@ std::map<ScenarioID, MultiPeriodResults> PeriodRunner::run_multiple_scenarios(
     const BalanceSheet& initial_bs,
     const std::string& template_code
 ) {
+    std::vector<ScenarioJob> jobs;
+    for (ScenarioID scenario_id : scenario_ids) {
+        jobs.push_back({entity_id, scenario_id});
+    }
+    auto results = run_jobs(jobs, period_ids, initial_bs, template_code);
+
     std::map<ScenarioID, MultiPeriodResults> all_results;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        all_results[jobs[i].scenario_id] = std::move(results[i]);
+    }
+    return all_results;
+}
+
+std::vector<MultiPeriodResults> PeriodRunner::run_jobs(
+    const std::vector<ScenarioJob>& jobs,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code
+) {
+    std::vector<MultiPeriodResults> results(jobs.size());
+    for_each_job(jobs, period_ids, initial_bs, template_code,
+                 [&](size_t job, size_t, MultiPeriodResults&& result) { results[job] = std::move(result); });
+    return results;
+}
 
-    // Run each scenario independently
+void PeriodRunner::aggregate_jobs(
+    const std::vector<ScenarioJob>& jobs,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    ResultAggregator& into
+) {
+    // One aggregator per worker: no locking while jobs finish
+    std::vector<ResultAggregator> partial(scheduler_ ? scheduler_->size() : 1, into.empty_copy());
+    for_each_job(jobs, period_ids, initial_bs, template_code,
+                 [&](size_t, size_t worker, MultiPeriodResults&& result) {
+                     partial[worker].add(result, period_ids);
+                 });
+    for (const auto& worker : partial) {
+        into.merge(worker);
+    }
+}
+
+void PeriodRunner::collect_scenarios(
+    const EntityID& entity_id,
+    const std::vector<ScenarioID>& scenario_ids,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    BudgetedResults& into
+) {
+    std::vector<ScenarioJob> jobs;
     for (ScenarioID scenario_id : scenario_ids) {
-        auto results = run_periods(
-            entity_id,
-            scenario_id,
-            period_ids,
-            initial_bs,
-            template_code
-        );
+        jobs.push_back({entity_id, scenario_id});
+    }
+    std::mutex mutex;
+    for_each_job(jobs, period_ids, initial_bs, template_code,
+                 [&](size_t job, size_t, MultiPeriodResults&& result) {
+                     std::lock_guard<std::mutex> lock(mutex);
+                     into.add(jobs[job].scenario_id, std::move(result));
+                 });
+}
 
-        all_results[scenario_id] = results;
+void PeriodRunner::aggregate_scenarios(
+    const EntityID& entity_id,
+    const std::vector<ScenarioID>& scenario_ids,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    ResultAggregator& into
+) {
+    std::vector<ScenarioJob> jobs;
+    for (ScenarioID scenario_id : scenario_ids) {
+        jobs.push_back({entity_id, scenario_id});
     }
+    aggregate_jobs(jobs, period_ids, initial_bs, template_code, into);
+}
 
-    return all_results;
+void PeriodRunner::for_each_job(
+    const std::vector<ScenarioJob>& jobs,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const JobSink& sink
+) {
+    const size_t count = jobs.size();
+
+    if (!scheduler_ || count <= 1) {
+        if (prefetch_connect_ && count > 1) {
+            run_jobs_prefetched(jobs, period_ids, initial_bs, template_code, sink);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            sink(i, 0, run_periods(jobs[i].entity_id, jobs[i].scenario_id, period_ids,
+                                   jobs[i].initial_bs ? *jobs[i].initial_bs : initial_bs, template_code));
+        }
+        return;
+    }
+
+    // Sticky triggers travel with their job to whichever worker runs it
+    std::vector<std::set<std::string>> triggered(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto found = triggered_actions_.find(jobs[i].scenario_id);
+        if (found != triggered_actions_.end()) {
+            triggered[i] = found->second;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        scheduler_->submit([&, i](size_t worker) {
+            PeriodRunner& runner = scenario_worker(worker);
+            auto& sticky = runner.triggered_actions_[jobs[i].scenario_id];
+            sticky = std::move(triggered[i]);
+            auto result = runner.run_periods(jobs[i].entity_id, jobs[i].scenario_id, period_ids,
+                                             jobs[i].initial_bs ? *jobs[i].initial_bs : initial_bs,
+                                             template_code);
+            triggered[i] = std::move(sticky);
+            sink(i, worker, std::move(result));
+        });
+    }
+    scheduler_->wait();
+
+    for (const auto& job : jobs) {
+        triggered_actions_[job.scenario_id].clear();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        triggered_actions_[jobs[i].scenario_id].merge(triggered[i]);
+    }
+}
+
+void PeriodRunner::run_jobs_prefetched(
+    const std::vector<ScenarioJob>& jobs,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const JobSink& sink
+) {
+    if (!prefetch_db_) {
+        prefetch_db_ = std::make_unique<database::AsyncDatabase>(prefetch_connect_, prefetch_connections_);
+    }
+
+    // Up to depth jobs' reads in flight, spread over the stage's connections
+    auto read = [this, &period_ids](const ScenarioJob& job) {
+        return prefetch_db_->run([entity_id = job.entity_id, scenario_id = job.scenario_id,
+                                  &period_ids](database::IDatabase& db) {
+            // A failed read is left to run_periods(), which reports it in place
+            JobInputs inputs;
+            try {
+                inputs.drivers = unified::DriverValueProvider::fetch_rows(db, entity_id, scenario_id, period_ids);
+            } catch (const std::exception&) {
+            }
+            try {
+                inputs.triggers = LaneTriggers::query(db, scenario_id);
+            } catch (const std::exception&) {
+            }
+            return inputs;
+        });
+    };
+    std::deque<database::AsyncResult<JobInputs>> ahead;
+    size_t next = 0;
+    auto read_ahead = [&] {
+        while (next < jobs.size() && ahead.size() < prefetch_depth_) {
+            ahead.push_back(read(jobs[next++]));
+        }
+    };
+
+    try {
+        read_ahead();
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            database::AsyncResult<JobInputs> pending = std::move(ahead.front());
+            ahead.pop_front();
+            read_ahead();
+            std::optional<JobInputs> inputs;
+            try {
+                inputs = pending.get();
+            } catch (const std::exception&) {
+                // The stage couldn't connect: read as usual
+            }
+            sink(i, 0, run_periods(jobs[i].entity_id, jobs[i].scenario_id, period_ids,
+                                   jobs[i].initial_bs ? *jobs[i].initial_bs : initial_bs, template_code,
+                                   inputs ? &*inputs : nullptr));
+        }
+    } catch (...) {
+        for (const auto& pending : ahead) {
+            pending.wait();  // Reads still refer to period_ids
+        }
+        throw;
+    }
+}
+
+void PeriodRunner::set_prefetch(ConnectionFactory connect, size_t depth, size_t connections) {
+    prefetch_connect_ = std::move(connect);
+    prefetch_db_.reset();
+    prefetch_depth_ = std::max<size_t>(1, depth);
+    prefetch_connections_ = std::max<size_t>(1, connections);
+}
+
+void PeriodRunner::set_result_writer(std::shared_ptr<ResultWriter> writer) {
+    writer_ = std::move(writer);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->writer_ = writer_;
+        }
+    }
+}
+
+void PeriodRunner::set_checkpoints(std::shared_ptr<CheckpointStore> store, size_t every_periods) {
+    checkpoints_ = std::move(store);
+    checkpoint_every_ = std::max<size_t>(1, every_periods);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_checkpoints(checkpoints_, checkpoint_every_);
+        }
+    }
+}
+
+void PeriodRunner::set_result_cache(std::shared_ptr<ResultCache> cache) {
+    result_cache_ = std::move(cache);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->result_cache_ = result_cache_;
+        }
+    }
+}
+
+void PeriodRunner::set_sensitivity_drivers(std::vector<std::string> driver_codes) {
+    sensitivity_drivers_ = std::move(driver_codes);
+    engine_->set_sensitivity_drivers(sensitivity_drivers_);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_sensitivity_drivers(sensitivity_drivers_);
+        }
+    }
+}
+
+DriverGradient PeriodRunner::gradient(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const std::string& output_code,
+    size_t checkpoint_every
+) {
+    return gradient(entity_id, scenario_id, period_ids, initial_bs, template_code, output_code,
+                    checkpoint_every, nullptr);
+}
+
+DriverGradient PeriodRunner::gradient(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const std::string& output_code,
+    const unified::DriverValueProvider::DriverRows& drivers,
+    size_t checkpoint_every
+) {
+    JobInputs inputs;
+    inputs.drivers = drivers;
+    return gradient(entity_id, scenario_id, period_ids, initial_bs, template_code, output_code,
+                    checkpoint_every, &inputs);
+}
+
+DriverGradient PeriodRunner::gradient(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const std::string& output_code,
+    size_t checkpoint_every,
+    const JobInputs* prefetched
+) {
+    DriverGradient gradient;
+    gradient.output = output_code;
+    if (period_ids.empty()) {
+        gradient.success = false;
+        gradient.errors.push_back("No periods to differentiate");
+        return gradient;
+    }
+    gradient.period_id = period_ids.back();
+    unified::AdjointTape tape(period_ids);
+
+    // The passes are internal: nothing is written, observed or cached, and
+    // the run's own checkpoint store is left alone
+    struct Restore {
+        PeriodRunner& runner;
+        std::shared_ptr<ResultWriter> writer;
+        std::shared_ptr<CheckpointStore> checkpoints;
+        std::shared_ptr<ResultCache> result_cache;
+        PeriodObserver observer;
+        size_t checkpoint_every;
+        ~Restore() {
+            runner.writer_ = std::move(writer);
+            runner.checkpoints_ = std::move(checkpoints);
+            runner.result_cache_ = std::move(result_cache);
+            runner.period_observer_ = std::move(observer);
+            runner.checkpoint_every_ = checkpoint_every;
+            runner.checkpoint_sink_ = nullptr;
+            runner.resume_from_ = nullptr;
+            runner.engine_->set_tape(nullptr);
+        }
+    } restore{*this, writer_, checkpoints_, result_cache_, period_observer_, checkpoint_every_};
+    writer_.reset();
+    checkpoints_.reset();
+    result_cache_.reset();
+    period_observer_ = nullptr;
+
+    auto succeeded = [&](const MultiPeriodResults& run) {
+        if (!run.success) {
+            gradient.success = false;
+            gradient.errors.insert(gradient.errors.end(), run.errors.begin(), run.errors.end());
+        }
+        return run.success;
+    };
+    auto seed_output = [&](const MultiPeriodResults& run) {
+        if (run.results.size() != period_ids.size() || !run.results.back().has_value(output_code)) {
+            gradient.success = false;
+            gradient.errors.push_back("Output '" + output_code + "' not calculated in period " +
+                                      std::to_string(gradient.period_id));
+            return false;
+        }
+        gradient.value = run.results.back().get_value(output_code);
+        tape.seed(gradient.period_id, output_code);
+        return true;
+    };
+
+    const size_t n = period_ids.size();
+    const size_t segment = (checkpoint_every == 0 || checkpoint_every >= n) ? n : checkpoint_every;
+    if (segment == n) {
+        // The whole run on one tape
+        engine_->set_tape(&tape);
+        auto run = run_periods(entity_id, scenario_id, period_ids, initial_bs, template_code, prefetched);
+        engine_->set_tape(nullptr);
+        if (!succeeded(run) || !seed_output(run)) {
+            return gradient;
+        }
+        tape.sweep();
+    } else {
+        // Forward pass untaped, keeping the state after every segment
+        std::vector<RunCheckpoint> checkpoints;
+        checkpoint_every_ = segment;
+        checkpoint_sink_ = [&](const RunCheckpoint& checkpoint) { checkpoints.push_back(checkpoint); };
+        auto run = run_periods(entity_id, scenario_id, period_ids, initial_bs, template_code, prefetched);
+        checkpoint_sink_ = nullptr;
+        if (!succeeded(run) || !seed_output(run)) {
+            return gradient;
+        }
+
+        // Segments last first: recompute from the checkpoint before it, tape it, sweep it
+        engine_->set_tape(&tape);
+        for (size_t s = (n + segment - 1) / segment; s-- > 0;) {
+            resume_from_ = (s > 0) ? &checkpoints[s - 1] : nullptr;
+            const size_t end = std::min(n, (s + 1) * segment);
+            const std::vector<PeriodID> through(period_ids.begin(), period_ids.begin() + static_cast<std::ptrdiff_t>(end));
+            auto rerun = run_periods(entity_id, scenario_id, through, initial_bs, template_code, prefetched);
+            gradient.recomputed_periods += rerun.results.size();
+            if (!succeeded(rerun)) {
+                return gradient;
+            }
+            tape.sweep();
+        }
+    }
+
+    gradient.drivers = tape.driver_adjoints();
+    gradient.peak_tape_bytes = tape.peak_bytes();
+    return gradient;
+}
+
+void PeriodRunner::set_horizon_measures(std::vector<HorizonMeasure> measures) {
+    for (const auto& measure : measures) {
+        if (measure.kind == HorizonMeasure::Kind::NPV && measure.rate <= -1.0) {
+            throw std::invalid_argument("PeriodRunner: NPV rate of " + measure.name + " must be greater than -1");
+        }
+    }
+    horizon_measures_ = std::move(measures);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->horizon_measures_ = horizon_measures_;
+        }
+    }
+}
+
+void PeriodRunner::set_stop_conditions(StopConditions stop) {
+    std::shared_ptr<const core::CompiledFormula> condition;
+    if (!stop.condition.empty()) {
+        try {
+            condition = trigger_evaluator_.compile(stop.condition);
+        } catch (const std::exception& e) {
+            throw std::invalid_argument("PeriodRunner: stop condition '" + stop.condition + "': " + e.what());
+        }
+    }
+    stop_ = std::move(stop);
+    stop_condition_ = std::move(condition);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_stop_conditions(stop_);
+        }
+    }
+}
+
+std::string PeriodRunner::stop_reason(ScenarioID scenario_id, PeriodID period_id,
+                                      const unified::UnifiedResult& result) const {
+    if (stop_.on_error && !result.success) {
+        return "Period " + std::to_string(period_id) + " failed";
+    }
+    if (!stop_condition_) {
+        return {};
+    }
+
+    // The condition reads the period's own line items
+    class PeriodValueProvider : public core::IValueProvider {
+    public:
+        explicit PeriodValueProvider(const unified::ResultRow& row) : row_(row) {}
+
+        bool has_value(const std::string& key) const override {
+            return row_.contains(key);
+        }
+
+        double get_value(const std::string& key, const core::Context&) const override {
+            const double* value = row_.find(key);
+            return value ? *value : 0.0;
+        }
+
+    private:
+        const unified::ResultRow& row_;
+    };
+
+    PeriodValueProvider provider(result.line_items);
+    const std::vector<core::IValueProvider*> providers = {&provider};
+    try {
+        if (trigger_evaluator_.evaluate(*stop_condition_, providers, core::Context(scenario_id, period_id, 0)) != 0.0) {
+            return "Condition met in period " + std::to_string(period_id) + ": " + stop_.condition;
+        }
+    } catch (const std::exception&) {
+        // A failing condition is not met
+    }
+    return {};
+}
+
+void PeriodRunner::set_output_selection(std::vector<std::string> outputs) {
+    outputs_ = std::move(outputs);
+    output_projections_.clear();
+    engine_->set_output_selection(outputs_);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_output_selection(outputs_);
+        }
+    }
+}
+
+void PeriodRunner::project_outputs(unified::ResultRow& row) {
+    if (!row.schema()) {
+        return;
+    }
+    auto& projection = output_projections_[row.schema().get()];
+    if (projection.source != row.schema()) {
+        std::vector<std::string> codes;
+        projection.indexes.clear();
+        const std::set<std::string> selected(outputs_.begin(), outputs_.end());
+        for (uint32_t i = 0; i < row.schema()->size(); ++i) {
+            if (selected.count(row.schema()->code(i))) {
+                codes.push_back(row.schema()->code(i));
+                projection.indexes.push_back(i);
+            }
+        }
+        projection.schema = std::make_shared<const unified::ResultSchema>(std::move(codes));
+        projection.source = row.schema();
+    }
+
+    // A failed period keeps a prefix of the schema, so its projection is a prefix too
+    std::vector<double> values;
+    values.reserve(projection.indexes.size());
+    for (uint32_t index : projection.indexes) {
+        if (index >= row.size()) {
+            break;
+        }
+        values.push_back(row.values()[index]);
+    }
+    row = unified::ResultRow(projection.schema, std::move(values));
+}
+
+void PeriodRunner::set_scenario_parallel(size_t threads, ConnectionFactory connect) {
+    scenario_workers_.clear();
+    scheduler_.reset();
+    connect_ = std::move(connect);
+
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    if (threads > 1) {
+        if (!connect_ && !connect_node_) {
+            throw std::invalid_argument("PeriodRunner: parallel scenarios need a connection factory");
+        }
+        scheduler_ = std::make_unique<TaskScheduler>(threads, numa_);
+        scenario_workers_.resize(scheduler_->size());
+    }
+}
+
+void PeriodRunner::set_scenario_parallel(size_t threads, database::ConnectionPool& pool) {
+    if (pool.shared_reader()) {
+        threads = 1;   // Every worker would get the writer
+    }
+    set_scenario_parallel(threads, [&pool] { return pool.reader(); });
+}
+
+void PeriodRunner::set_numa_placement(bool enabled, NodeConnectionFactory connect_node) {
+    numa_ = enabled;
+    connect_node_ = std::move(connect_node);
+    if (scheduler_) {
+        set_scenario_parallel(scheduler_->size(), connect_);
+    }
+}
+
+TaskSchedulerStats PeriodRunner::scenario_stats() const {
+    return scheduler_ ? scheduler_->stats() : TaskSchedulerStats{};
+}
+
+PeriodRunner& PeriodRunner::scenario_worker(size_t worker) {
+    auto& runner = scenario_workers_[worker];
+    if (!runner) {
+        auto db = connect_node_ ? connect_node_(scheduler_->node_of(worker)) : connect_();
+        runner = reference_ ? std::make_unique<PeriodRunner>(db, reference_)
+                            : std::make_unique<PeriodRunner>(db);
+        runner->set_incremental(incremental_);
+        runner->set_incremental_seeding(incremental_seeding_);
+        runner->parametric_actions_ = parametric_actions_;
+        runner->action_catalog_ = action_catalog_;
+        if (scope3_results_) {
+            runner->set_scope3_results(scope3_results_);
+        }
+        if (policies_) {
+            runner->select_policies(policies_->first, policies_->second);
+        }
+        runner->validation_policy_ = validation_policy_;
+        for (const auto& [name, strategy] : tax_strategies_) {
+            runner->register_tax_strategy(name, strategy);
+        }
+        runner->writer_ = writer_;
+        runner->tail_latency_ = tail_latency_;
+        runner->set_checkpoints(checkpoints_, checkpoint_every_);
+        runner->result_cache_ = result_cache_;
+        if (!outputs_.empty()) {
+            runner->set_output_selection(outputs_);
+        }
+        runner->horizon_measures_ = horizon_measures_;
+        runner->stop_ = stop_;
+        runner->stop_condition_ = stop_condition_;
+        if (!sensitivity_drivers_.empty()) {
+            runner->set_sensitivity_drivers(sensitivity_drivers_);
+        }
+    }
+    return *runner;
+}
+
+void PeriodRunner::set_incremental(bool enabled) {
+    incremental_ = enabled;
+    incremental_seeding_ = incremental_seeding_ && enabled;
+    engine_->set_incremental(enabled);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_incremental(enabled);
+        }
+    }
+}
+
+void PeriodRunner::set_action_catalog(std::shared_ptr<const actions::ActionCatalog> catalog) {
+    action_catalog_ = std::move(catalog);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_action_catalog(action_catalog_);
+        }
+    }
+}
+
+void PeriodRunner::set_scope3_results(std::shared_ptr<const carbon::Scope3Results> results) {
+    scope3_results_ = std::move(results);
+    engine_->set_scope3_results(scope3_results_);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_scope3_results(scope3_results_);
+        }
+    }
+}
+
+void PeriodRunner::select_policies(const std::string& wc_code, const std::string& capex_code) {
+    engine_->select_policies(wc_code, capex_code);
+    policies_ = {wc_code, capex_code};
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->select_policies(wc_code, capex_code);
+        }
+    }
+}
+
+void PeriodRunner::set_parametric_actions(bool enabled) {
+    parametric_actions_ = enabled;
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_parametric_actions(enabled);
+        }
+    }
+}
+
+void PeriodRunner::set_incremental_seeding(bool enabled) {
+    if (enabled) {
+        set_incremental(true);
+    }
+    incremental_seeding_ = enabled;
+    engine_->set_incremental_seeding(enabled);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->set_incremental_seeding(enabled);
+        }
+    }
+}
+
+void PeriodRunner::register_tax_strategy(const std::string& name,
+                                         std::shared_ptr<const pl::IStatefulTaxStrategy> strategy) {
+    tax_strategies_.emplace_back(name, strategy);
+    engine_->register_tax_strategy(name, strategy);
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->register_tax_strategy(name, strategy);
+        }
+    }
+}
+
+void PeriodRunner::set_profiler(std::shared_ptr<core::Profiler> profiler) {
+    engine_->set_profiler(std::move(profiler));
+}
+
+void PeriodRunner::set_validation_policy(const unified::ValidationPolicy& policy) {
+    validation_policy_ = policy;
+    for (auto& worker : scenario_workers_) {
+        if (worker) {
+            worker->validation_policy_ = policy;
+        }
+    }
+}
+
+void PeriodRunner::set_parallel(size_t threads, size_t min_level_width) {
+    engine_->set_parallel(threads, min_level_width);
+}
+
+PeriodRunner::ScenarioTriggers& PeriodRunner::compiled_triggers_for(ScenarioID scenario_id) {
+    auto cached = compiled_triggers_.find(scenario_id);
+    if (cached != compiled_triggers_.end()) {
+        return cached->second;
+    }
+
+    ScenarioTriggers compiled;
+    for (const auto& row : triggers_for(scenario_id)) {
+        CompiledTrigger trigger;
+        trigger.row = &row;
+        trigger.last = (row.end_period > 0) ? row.end_period : -1;
+        if (row.trigger_type == "UNCONDITIONAL") {
+            trigger.kind = CompiledTrigger::Kind::WINDOW;
+            trigger.first = row.start_period;
+        } else if (row.trigger_type == "TIMED") {
+            // Starts at trigger_period, ends at end_period
+            trigger.kind = (row.trigger_period > 0) ? CompiledTrigger::Kind::WINDOW : CompiledTrigger::Kind::NEVER;
+            trigger.first = row.trigger_period;
+        } else if (row.trigger_type == "CONDITIONAL" && !row.trigger_condition.empty()) {
+            trigger.kind = CompiledTrigger::Kind::CONDITIONAL;
+            trigger.first = row.start_period;
+            try {
+                trigger.condition = trigger_evaluator_.compile(row.trigger_condition);
+            } catch (const std::exception&) {
+                // A condition that doesn't compile is never met
+            }
+        }
+        compiled.triggers.push_back(std::move(trigger));
+    }
+    return compiled_triggers_[scenario_id] = std::move(compiled);
 }
 
 std::string PeriodRunner::get_template_for_period(
@@ -123,185 +1308,143 @@ std::string PeriodRunner::get_template_for_period(
     const std::string& base_template_code,
     const std::map<std::string, double>& prior_values
 ) {
-    // Query scenario_action for this scenario
-    std::string sql = R"(
-        SELECT action_code, trigger_type, trigger_condition, trigger_period,
-               start_period, end_period, trigger_sticky
-        FROM scenario_action
-        WHERE scenario_id = :scenario_id
-        ORDER BY action_code
-    )";
+    // Condition variables read the prior period's values; missing ones are 0
+    class PriorValueProvider : public core::IValueProvider {
+    public:
+        explicit PriorValueProvider(const std::map<std::string, double>& values) : values_(values) {}
 
-    auto result = db_->execute_query(sql, {{"scenario_id", scenario_id}});
+        bool has_value(const std::string& key) const override {
+            return values_.find(key) != values_.end();
+        }
 
-    std::vector<std::string> active_actions;
+        double get_value(const std::string& key, const core::Context&) const override {
+            auto it = values_.find(key);
+            return (it != values_.end()) ? it->second : 0.0;
+        }
 
-    while (result->next()) {
-        std::string action_code = result->get_string("action_code");
-        std::string trigger_type = result->get_string("trigger_type");
-        int start_period = result->get_int("start_period");
-        int end_period = result->is_null("end_period") ? -1 : result->get_int("end_period");
-        bool trigger_sticky = result->is_null("trigger_sticky") ? true : (result->get_int("trigger_sticky") != 0);
+    private:
+        const std::map<std::string, double>& values_;
+    };
 
-        bool is_active = false;
+    ScenarioTriggers& compiled = compiled_triggers_for(scenario_id);
+    if (compiled.triggers.empty()) {
+        return base_template_code;
+    }
 
-        // Check trigger type
-        if (trigger_type == "UNCONDITIONAL") {
-            // Active if current period >= start_period and <= end_period (if set)
-            is_active = (period_id >= start_period);
-            if (end_period > 0 && period_id > end_period) {
-                is_active = false;
-            }
+    PriorValueProvider provider(prior_values);
+    const std::vector<core::IValueProvider*> providers = {&provider};
+    const core::Context ctx(scenario_id, period_id, 0);
+    auto condition_met = [&](const CompiledTrigger& trigger) {
+        if (!trigger.condition) {
+            return false;
+        }
+        try {
+            return trigger_evaluator_.evaluate(*trigger.condition, providers, ctx) != 0.0;
+        } catch (const std::exception&) {
+            return false;  // A failing condition is treated as false
+        }
+    };
 
-        } else if (trigger_type == "TIMED") {
-            // Active if triggered at specific period
-            int trigger_period = result->is_null("trigger_period") ? -1 : result->get_int("trigger_period");
-            if (trigger_period > 0) {
-                // Starts at trigger_period, ends at end_period
-                is_active = (period_id >= trigger_period);
-                if (end_period > 0 && period_id > end_period) {
-                    is_active = false;
-                }
-            }
+    std::set<std::string>& triggered = triggered_actions_[scenario_id];
+    std::pmr::vector<uint64_t> active((compiled.triggers.size() + 63) / 64, 0, &arena_);
+    bool any_active = false;
+    for (size_t t = 0; t < compiled.triggers.size(); ++t) {
+        const CompiledTrigger& trigger = compiled.triggers[t];
+        const bool in_window = period_id >= trigger.first && (trigger.last < 0 || period_id <= trigger.last);
+        bool is_active = false;
 
-        } else if (trigger_type == "CONDITIONAL") {
-            std::string trigger_condition = result->is_null("trigger_condition") ? "" : result->get_string("trigger_condition");
-
-            // Check if we're past start_period
-            if (period_id < start_period) {
-                // Not yet at start_period
-                is_active = false;
-            } else if (!trigger_condition.empty()) {
-                if (trigger_sticky) {
-                    // STICKY TRIGGER: Once triggered, stays active until end_period
-                    bool already_triggered = (triggered_actions_[scenario_id].find(action_code) != triggered_actions_[scenario_id].end());
-
-                    if (already_triggered) {
-                        // Action was triggered in previous period - stays active
-                        is_active = true;
-                        // Check if we've passed end_period
-                        if (end_period > 0 && period_id > end_period) {
-                            is_active = false;
-                            // Remove from triggered set if past end_period
-                            triggered_actions_[scenario_id].erase(action_code);
-                        }
-                    } else {
-                        // Not yet triggered - evaluate condition
-                        try {
-                            core::FormulaEvaluator evaluator;
-
-                            // Create temporary provider that returns values from prior_values map
-                            class PriorValueProvider : public core::IValueProvider {
-                            private:
-                                const std::map<std::string, double>& values_;
-                            public:
-                                explicit PriorValueProvider(const std::map<std::string, double>& vals) : values_(vals) {}
-
-                                bool has_value(const std::string& key) const override {
-                                    return values_.find(key) != values_.end();
-                                }
-
-                                double get_value(const std::string& key, const core::Context& ctx) const override {
-                                    auto it = values_.find(key);
-                                    if (it != values_.end()) {
-                                        return it->second;
-                                    }
-                                    return 0.0;
-                                }
-                            };
-
-                            PriorValueProvider provider(prior_values);
-                            std::vector<core::IValueProvider*> providers = {&provider};
-                            core::Context ctx(scenario_id, period_id, 0);
-
-                            // Evaluate condition
-                            double condition_result = evaluator.evaluate(trigger_condition, providers, ctx);
-
-                            // Condition is true if result is non-zero
-                            if (condition_result != 0.0) {
-                                // Condition met - action becomes active (sticky)
-                                is_active = true;
-                                triggered_actions_[scenario_id].insert(action_code);
-                            }
-                        } catch (const std::exception& e) {
-                            // If condition evaluation fails, treat as false
-                            is_active = false;
-                        }
-                    }
-                } else {
-                    // NON-STICKY TRIGGER: Re-evaluate every period
-                    // Action is only active while condition is true
-
-                    // Safety check: If this is period 1, prior_values may be empty
-                    // In that case, we cannot evaluate the condition (treat as false)
-                    if (period_id == 1 || prior_values.empty()) {
-                        is_active = false;
-                    } else {
-                        try {
-                            core::FormulaEvaluator evaluator;
-
-                            // Create temporary provider that returns values from prior_values map
-                            class PriorValueProvider : public core::IValueProvider {
-                            private:
-                                const std::map<std::string, double>& values_;
-                            public:
-                                explicit PriorValueProvider(const std::map<std::string, double>& vals) : values_(vals) {}
-
-                                bool has_value(const std::string& key) const override {
-                                    return values_.find(key) != values_.end();
-                                }
-
-                                double get_value(const std::string& key, const core::Context& ctx) const override {
-                                    auto it = values_.find(key);
-                                    if (it != values_.end()) {
-                                        return it->second;
-                                    }
-                                    return 0.0;
-                                }
-                            };
-
-                            PriorValueProvider provider(prior_values);
-                            std::vector<core::IValueProvider*> providers = {&provider};
-                            core::Context ctx(scenario_id, period_id, 0);
-
-                            // Evaluate condition
-                            double condition_result = evaluator.evaluate(trigger_condition, providers, ctx);
-
-                            // Condition is true if result is non-zero
-                            if (condition_result != 0.0) {
-                                // Condition met - action is active for this period only
-                                is_active = true;
-                                // Check if we've passed end_period
-                                if (end_period > 0 && period_id > end_period) {
-                                    is_active = false;
-                                }
-                            }
-                        } catch (const std::exception& e) {
-                            // If condition evaluation fails, treat as false
-                            is_active = false;
-                        }
+        if (trigger.kind == CompiledTrigger::Kind::WINDOW) {
+            is_active = in_window;
+        } else if (trigger.kind == CompiledTrigger::Kind::CONDITIONAL && period_id >= trigger.first) {
+            const std::string& action_code = trigger.row->action_code;
+            if (trigger.row->trigger_sticky) {
+                // Sticky: once triggered, active until end_period
+                auto found = triggered.find(action_code);
+                if (found != triggered.end()) {
+                    is_active = in_window;
+                    if (!in_window) {
+                        triggered.erase(found);
                     }
+                } else if (condition_met(trigger)) {
+                    is_active = true;
+                    triggered.insert(action_code);
                 }
+            } else if (period_id != 1 && !prior_values.empty()) {
+                // Non-sticky: active in the periods its condition holds (not evaluable in period 1)
+                is_active = condition_met(trigger) && in_window;
             }
         }
 
         if (is_active) {
-            active_actions.push_back(action_code);
+            active[t / 64] |= uint64_t{1} << (t % 64);
+            any_active = true;
         }
     }
-
-    // If no actions are active, return base template
-    if (active_actions.empty()) {
+    if (!any_active && !parametric_actions_) {
         return base_template_code;
     }
 
-    // Otherwise, create/get template for this action combination
-    return create_or_get_action_template(
+    // Actions of the active triggers that are in their own period window
+    const auto& catalog = catalog_for(scenario_id);
+    const auto& actions = catalog.actions(scenario_id);
+    if (!compiled.actions_mapped) {
+        compiled.trigger_actions.resize(compiled.triggers.size());
+        for (size_t t = 0; t < compiled.triggers.size(); ++t) {
+            compiled.trigger_actions[t] = catalog.find(scenario_id, compiled.triggers[t].row->action_code);
+        }
+        compiled.actions_mapped = true;
+    }
+    std::vector<uint64_t> effective((actions.size() + 63) / 64, 0);
+    for (size_t t = 0; t < compiled.triggers.size(); ++t) {
+        if (active[t / 64] & (uint64_t{1} << (t % 64))) {
+            for (size_t a : compiled.trigger_actions[t]) {
+                if (actions[a].action.is_active_in_period(period_id)) {
+                    effective[a / 64] |= uint64_t{1} << (a % 64);
+                }
+            }
+        }
+    }
+
+    // Parametric: one overlay for the run, the effective actions are its activations
+    if (parametric_actions_) {
+        std::map<std::string, double> activation;
+        for (size_t a = 0; a < actions.size(); ++a) {
+            if (effective[a / 64] & (uint64_t{1} << (a % 64))) {
+                activation[actions[a].action.action_code] = 1.0;
+            }
+        }
+        engine_->set_action_activation(activation);
+
+        auto parametric = compiled.parametric_templates.find(base_template_code);
+        if (parametric == compiled.parametric_templates.end()) {
+            parametric = compiled.parametric_templates
+                             .emplace(base_template_code,
+                                      create_or_get_parametric_template(base_template_code, scenario_id))
+                             .first;
+        }
+        return parametric->second;
+    }
+
+    // The overlay only depends on the effective actions (see create_or_get_action_template())
+    auto key = std::make_pair(base_template_code, std::move(effective));
+    auto known = compiled.templates.find(key);
+    if (known != compiled.templates.end()) {
+        return known->second;
+    }
+    std::vector<std::string> active_actions;
+    for (size_t t = 0; t < compiled.triggers.size(); ++t) {
+        if (active[t / 64] & (uint64_t{1} << (t % 64))) {
+            active_actions.push_back(compiled.triggers[t].row->action_code);
+        }
+    }
+    std::string template_code = create_or_get_action_template(
         base_template_code,
         scenario_id,
         period_id,
         active_actions
     );
+    compiled.templates.emplace(std::move(key), template_code);
+    return template_code;
 }
 
 std::string PeriodRunner::create_or_get_action_template(
@@ -310,54 +1453,152 @@ std::string PeriodRunner::create_or_get_action_template(
     PeriodID period_id,
     const std::vector<std::string>& active_action_codes
 ) {
-    // Generate template code based on active actions
-    // Format: BASE_S{scenario}_P{period}_A{action1}_{action2}...
-    std::string template_code = base_template_code +
-                                "_S" + std::to_string(scenario_id) +
-                                "_P" + std::to_string(period_id);
+    // Filter to only the active actions
+    const auto& all_actions = actions_for(scenario_id);
+    std::vector<const ScenarioAction*> active_actions;
+    for (const auto& action : all_actions) {
+        if (std::find(active_action_codes.begin(), active_action_codes.end(), action.action.action_code)
+            != active_action_codes.end()) {
+            active_actions.push_back(&action);
+        }
+    }
 
-    for (const auto& action_code : active_action_codes) {
-        template_code += "_" + action_code;
+    auto base_template = core::StatementTemplate::load_cached(db_, base_template_code);
+    if (!base_template) {
+        throw std::runtime_error("Base template not found: " + base_template_code);
     }
+    const std::string base_key = base_template_code + "@" + std::to_string(base_template->content_hash());
 
-    // Check if template already exists
-    auto check_result = db_->execute_query(
-        "SELECT template_id FROM statement_template WHERE code = :code",
-        {{"code", template_code}}
-    );
+    // Same base, active actions and action parameters → same overlay,
+    // whichever scenario or period asks
+    std::vector<std::string> action_keys;
+    for (const auto* action : active_actions) {
+        if (action->action.is_active_in_period(period_id)) {
+            action_keys.push_back(action->action.action_code + ":" + action->signature);
+        }
+    }
+    std::sort(action_keys.begin(), action_keys.end());
+    std::string action_key = base_key;
+    for (const auto& key : action_keys) {
+        action_key += '\n' + key;
+    }
+    auto known = action_set_templates_.find(action_key);
+    if (known != action_set_templates_.end()) {
+        return known->second;
+    }
+
+    // Formula patches from all active actions, over the base template
+    std::vector<actions::ManagementAction> patching;
+    for (const auto* action : active_actions) {
+        patching.push_back(action->action);
+    }
+    auto patches = actions::ActionEngine(db_).formula_patches(*base_template, patching, period_id);
 
-    if (check_result->next()) {
-        // Template already exists, reuse it
-        return template_code;
+    // Different action sets with the same effect share a template too
+    std::string key = base_key;
+    for (const auto& [code, formula] : patches) {
+        key += '\n' + code + '=' + formula;
+    }
+    auto existing = action_templates_.find(key);
+    if (existing != action_templates_.end()) {
+        action_set_templates_.emplace(std::move(action_key), existing->second);
+        return existing->second;
     }
 
-    // Template doesn't exist - need to create it
-    // Load ActionEngine and create the template
-    auto action_engine = std::make_shared<actions::ActionEngine>(db_);
+    // Format: BASE+{action1}+{action2}..., numbered if the same actions
+    // patch differently in another period
+    std::string template_code = base_template_code;
+    for (const auto& action_code : active_action_codes) {
+        template_code += "+" + action_code;
+    }
+    if (engine_->has_registered_template(template_code)) {
+        int variant = 2;
+        while (engine_->has_registered_template(template_code + "#" + std::to_string(variant))) {
+            ++variant;
+        }
+        template_code += "#" + std::to_string(variant);
+    }
 
-    // Clone base template
-    auto new_template = action_engine->clone_template(base_template_code, template_code);
+    engine_->register_template(base_template->with_formulas(template_code, patches));
+    ++templates_created_;
+    action_templates_.emplace(std::move(key), template_code);
+    action_set_templates_.emplace(std::move(action_key), template_code);
+    return template_code;
+}
 
-    // Load actions for this scenario
-    auto all_actions = action_engine->load_actions(scenario_id);
+std::string PeriodRunner::create_or_get_parametric_template(
+    const std::string& base_template_code,
+    ScenarioID scenario_id
+) {
+    const auto& all_actions = actions_for(scenario_id);
+    auto base_template = core::StatementTemplate::load_cached(db_, base_template_code);
+    if (!base_template) {
+        throw std::runtime_error("Base template not found: " + base_template_code);
+    }
 
-    // Filter to only the active actions
-    std::vector<actions::ManagementAction> active_actions;
+    // Same base and action parameters → same overlay, whichever scenario asks
+    std::vector<std::string> action_keys;
+    std::vector<std::string> action_codes;
     for (const auto& action : all_actions) {
-        if (std::find(active_action_codes.begin(), active_action_codes.end(), action.action_code)
-            != active_action_codes.end()) {
-            active_actions.push_back(action);
-        }
+        action_keys.push_back(action.action.action_code + ":" + action.signature);
+        action_codes.push_back(action.action.action_code);
+    }
+    std::sort(action_keys.begin(), action_keys.end());
+    std::string key = base_template_code + "@" + std::to_string(base_template->content_hash());
+    for (const auto& action_key : action_keys) {
+        key += '\n' + action_key;
+    }
+    auto known = parametric_templates_.find(key);
+    if (known != parametric_templates_.end()) {
+        return known->second;
     }
 
-    // Apply transformations from all active actions
-    action_engine->apply_actions_to_template(new_template, active_actions, period_id);
+    std::vector<actions::ManagementAction> patching;
+    for (const auto& action : all_actions) {
+        patching.push_back(action.action);
+    }
+    auto patches = actions::ActionEngine(db_).parametric_patches(*base_template, patching);
 
-    // Save the modified template
-    new_template->save_to_database(db_.get());
+    // Format: BASE+{action1}+{action2}...@periods, numbered if the actions differ in parameters
+    std::sort(action_codes.begin(), action_codes.end());
+    std::string template_code = base_template_code;
+    for (const auto& action_code : action_codes) {
+        template_code += "+" + action_code;
+    }
+    template_code += "@periods";
+    if (engine_->has_registered_template(template_code)) {
+        int variant = 2;
+        while (engine_->has_registered_template(template_code + "#" + std::to_string(variant))) {
+            ++variant;
+        }
+        template_code += "#" + std::to_string(variant);
+    }
 
+    engine_->register_template(base_template->with_formulas(template_code, patches));
+    ++templates_created_;
+    parametric_templates_.emplace(std::move(key), template_code);
     return template_code;
 }
 
+const std::vector<ActionTrigger>& PeriodRunner::triggers_for(ScenarioID scenario_id) {
+    auto cached = scenario_triggers_.find(scenario_id);
+    if (cached != scenario_triggers_.end()) {
+        return cached->second;
+    }
+
+    return scenario_triggers_[scenario_id] = LaneTriggers::query(*db_, scenario_id);
+}
+
+const actions::ActionCatalog& PeriodRunner::catalog_for(ScenarioID scenario_id) {
+    if (action_catalog_ && action_catalog_->covers(scenario_id)) {
+        return *action_catalog_;
+    }
+    auto& catalog = scenario_actions_[scenario_id];
+    if (!catalog) {
+        catalog = actions::ActionCatalog::load(*db_, {scenario_id});
+    }
+    return *catalog;
+}
+
 } // namespace orchestration
 } // namespace finmodel
@@ -17,64 +17,88 @@ std::vector<PeriodID> PeriodSetup::create_monthly_periods(
     database::IDatabase* db,
     const std::string& start_date,
     int num_periods
+) {
+    if (num_periods <= 0) {
+        throw std::runtime_error("PeriodSetup: num_periods must be positive");
+    }
+    return create_period_schedule(db, start_date, {{PeriodGranularity::MONTHLY, num_periods}});
+}
+
+std::vector<PeriodID> PeriodSetup::create_period_schedule(
+    database::IDatabase* db,
+    const std::string& start_date,
+    const std::vector<PeriodSegment>& segments
 ) {
     if (!db) {
         throw std::runtime_error("PeriodSetup: null database pointer");
     }
-
-    if (num_periods <= 0) {
-        throw std::runtime_error("PeriodSetup: num_periods must be positive");
+    if (segments.empty()) {
+        throw std::runtime_error("PeriodSetup: schedule needs at least one segment");
     }
 
     std::vector<PeriodID> period_ids;
+    int months = 0;  // From start_date to the current period's start
+    int period_index = 0;
 
-    for (int i = 0; i < num_periods; i++) {
-        // Calculate start and end dates for this period
-        std::string period_start = (i == 0) ? start_date : add_months(start_date, i);
-        std::string period_end = add_months(start_date, i + 1);
-
-        // Adjust end date to last day of month
-        Date end_date = parse_date(period_end);
-        int last_day = last_day_of_month(end_date.year, end_date.month);
-
-        std::ostringstream end_oss;
-        end_oss << end_date.year << "-"
-                << std::setfill('0') << std::setw(2) << end_date.month << "-"
-                << std::setfill('0') << std::setw(2) << last_day;
-        period_end = end_oss.str();
-
-        // Calculate days in period
-        // Simple approximation: 30 days (for testing purposes)
-        int days_in_period = 30;
-
-        // Create period label
-        Date start_parsed = parse_date(period_start);
-        std::ostringstream label_oss;
-        label_oss << start_parsed.year << "-"
-                  << std::setfill('0') << std::setw(2) << start_parsed.month;
-        std::string label = label_oss.str();
-
-        // Insert period into database
-        std::ostringstream query;
-        query << "INSERT INTO period (start_date, end_date, days_in_period, label, period_type, period_index) "
-              << "VALUES (:start_date, :end_date, :days, :label, 'calendar', :period_index)";
-
-        ParamMap params;
-        params["start_date"] = period_start;
-        params["end_date"] = period_end;
-        params["days"] = days_in_period;
-        params["label"] = label;
-        params["period_index"] = i;  // Sequential index starting from 0
-
-        db->execute_update(query.str(), params);
-
-        // Get the inserted period_id
-        auto result = db->execute_query("SELECT last_insert_rowid()", {});
-        if (result && result->next()) {
-            PeriodID period_id = result->get_int(0);
-            period_ids.push_back(period_id);
-        } else {
-            throw std::runtime_error("Failed to retrieve inserted period_id");
+    for (const auto& segment : segments) {
+        if (segment.count <= 0) {
+            throw std::runtime_error("PeriodSetup: segment count must be positive");
+        }
+        const int step = segment.granularity == PeriodGranularity::ANNUAL      ? 12
+                         : segment.granularity == PeriodGranularity::QUARTERLY ? 3
+                                                                               : 1;
+
+        for (int i = 0; i < segment.count; i++, months += step) {
+            // Calculate start and end dates for this period
+            std::string period_start = (months == 0) ? start_date : add_months(start_date, months);
+            std::string period_end = add_months(start_date, months + step - 1);
+
+            // Adjust end date to last day of month
+            Date end_date = parse_date(period_end);
+            end_date.day = last_day_of_month(end_date.year, end_date.month);
+
+            std::ostringstream end_oss;
+            end_oss << end_date.year << "-"
+                    << std::setfill('0') << std::setw(2) << end_date.month << "-"
+                    << std::setfill('0') << std::setw(2) << end_date.day;
+            period_end = end_oss.str();
+
+            // Calendar days, both ends included
+            Date start_parsed = parse_date(period_start);
+            int days_in_period = static_cast<int>(days_from_civil(end_date) - days_from_civil(start_parsed) + 1);
+
+            // Create period label: 2024-01, 2024-Q1 or 2024
+            std::ostringstream label_oss;
+            label_oss << start_parsed.year;
+            if (segment.granularity == PeriodGranularity::MONTHLY) {
+                label_oss << "-" << std::setfill('0') << std::setw(2) << start_parsed.month;
+            } else if (segment.granularity == PeriodGranularity::QUARTERLY) {
+                label_oss << "-Q" << (start_parsed.month - 1) / 3 + 1;
+            }
+            std::string label = label_oss.str();
+
+            // Insert period into database
+            std::ostringstream query;
+            query << "INSERT INTO period (start_date, end_date, days_in_period, label, period_type, period_index) "
+                  << "VALUES (:start_date, :end_date, :days, :label, 'calendar', :period_index)";
+
+            ParamMap params;
+            params["start_date"] = period_start;
+            params["end_date"] = period_end;
+            params["days"] = days_in_period;
+            params["label"] = label;
+            params["period_index"] = period_index++;  // Sequential index starting from 0
+
+            db->execute_update(query.str(), params);
+
+            // Get the inserted period_id
+            auto result = db->execute_query("SELECT last_insert_rowid()", {});
+            if (result && result->next()) {
+                PeriodID period_id = result->get_int(0);
+                period_ids.push_back(period_id);
+            } else {
+                throw std::runtime_error("Failed to retrieve inserted period_id");
+            }
         }
     }
 
@@ -227,5 +251,15 @@ int PeriodSetup::last_day_of_month(int year, int month) {
     return days;
 }
 
+long PeriodSetup::days_from_civil(const Date& date) {
+    // Proleptic Gregorian calendar, years starting in March
+    const int year = date.year - (date.month <= 2 ? 1 : 0);
+    const long era = (year >= 0 ? year : year - 399) / 400;
+    const long year_of_era = year - era * 400;
+    const long day_of_year = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+    const long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
 } // namespace orchestration
 } // namespace finmodel
@@ -0,0 +1,96 @@
+#include "orchestration/result_aggregator.h"
+#include "orchestration/period_runner.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+ResultAggregator::ResultAggregator(std::vector<PeriodID> period_ids, double relative_accuracy,
+                                   std::vector<std::string> line_items)
+    : period_ids_(std::move(period_ids)), relative_accuracy_(relative_accuracy), tracked_(std::move(line_items)) {
+    core::QuantileSketch check(relative_accuracy_);   // Throws for a bad accuracy
+    for (const auto& code : tracked_) {
+        slot(code);
+    }
+}
+
+ResultAggregator ResultAggregator::empty_copy() const {
+    return ResultAggregator(period_ids_, relative_accuracy_, tracked_);
+}
+
+void ResultAggregator::add(PeriodID period_id, const unified::ResultRow& values) {
+    const ptrdiff_t period = period_index(period_id);
+    if (period < 0 || !values.schema()) {
+        return;
+    }
+    if (values.schema() != schema_) {
+        schema_ = values.schema();
+        schema_slots_.assign(schema_->size(), -1);
+        for (uint32_t i = 0; i < schema_->size(); ++i) {
+            schema_slots_[i] = slot(schema_->code(i));
+        }
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (schema_slots_[i] >= 0) {
+            statistics_[static_cast<size_t>(schema_slots_[i])][static_cast<size_t>(period)].add(values.values()[i]);
+        }
+    }
+}
+
+void ResultAggregator::add(const MultiPeriodResults& results, const std::vector<PeriodID>& period_ids) {
+    ++runs_;
+    if (!results.success) {
+        ++failed_runs_;
+        return;
+    }
+    for (size_t i = 0; i < results.results.size() && results.resumed_periods + i < period_ids.size(); ++i) {
+        add(period_ids[results.resumed_periods + i], results.results[i].line_items);
+    }
+}
+
+void ResultAggregator::merge(const ResultAggregator& other) {
+    if (other.period_ids_ != period_ids_ || other.relative_accuracy_ != relative_accuracy_ ||
+        other.tracked_ != tracked_) {
+        throw std::invalid_argument("ResultAggregator: merged aggregators need the same settings");
+    }
+    for (size_t s = 0; s < other.codes_.size(); ++s) {
+        auto& periods = statistics_[static_cast<size_t>(slot(other.codes_[s]))];
+        for (size_t p = 0; p < period_ids_.size(); ++p) {
+            periods[p].merge(other.statistics_[s][p]);
+        }
+    }
+    runs_ += other.runs_;
+    failed_runs_ += other.failed_runs_;
+}
+
+const core::StreamingStatistics* ResultAggregator::get(const std::string& code, PeriodID period_id) const {
+    auto it = slots_.find(code);
+    const ptrdiff_t period = period_index(period_id);
+    if (it == slots_.end() || period < 0) {
+        return nullptr;
+    }
+    return &statistics_[it->second][static_cast<size_t>(period)];
+}
+
+long ResultAggregator::slot(const std::string& code) {
+    auto it = slots_.find(code);
+    if (it != slots_.end()) {
+        return static_cast<long>(it->second);
+    }
+    if (!tracked_.empty() && std::find(tracked_.begin(), tracked_.end(), code) == tracked_.end()) {
+        return -1;
+    }
+    slots_.emplace(code, codes_.size());
+    codes_.push_back(code);
+    statistics_.emplace_back(period_ids_.size(), core::StreamingStatistics(relative_accuracy_));
+    return static_cast<long>(codes_.size() - 1);
+}
+
+ptrdiff_t ResultAggregator::period_index(PeriodID period_id) const {
+    auto it = std::find(period_ids_.begin(), period_ids_.end(), period_id);
+    return it == period_ids_.end() ? -1 : it - period_ids_.begin();
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,443 @@
+/**
+ * @file result_cache.cpp
+ * @brief Run fingerprints and the cache file encoding
+ *
+ * Layout of <dir>/<fingerprint hex>.fmrc:
+ *   "FMRC" u32 version, fingerprint (u64 high, u64 low)
+ *   Code dictionary (every line item code once)
+ *   Periods: success, errors, warnings (rendered), (code index, double) per line item
+ *   Run errors, warnings, triggered actions
+ *   u64 FNV-1a hash of everything before it
+ *
+ * Integers are varints, strings a varint length and bytes.
+ */
+
+#include "orchestration/result_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+constexpr char MAGIC[4] = {'F', 'M', 'R', 'C'};
+
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// splitmix64 finalizer: spreads every input bit over the output
+uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// ----------------------------------------------------------------------------
+// Encoding
+// ----------------------------------------------------------------------------
+
+class Encoder {
+public:
+    std::vector<uint8_t> out;
+
+    template <typename T>
+    void put(T value) {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    void strings(const std::vector<std::string>& values) {
+        varint(values.size());
+        for (const auto& value : values) {
+            string(value);
+        }
+    }
+};
+
+/// Thrown on anything but a valid file of this version: acquire() treats it as a miss
+struct DamagedFile {};
+
+class Decoder {
+public:
+    Decoder(const std::vector<uint8_t>& data, size_t begin, size_t end) : data_(data), pos_(begin), end_(end) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            const uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw DamagedFile{};
+    }
+
+    std::string string() {
+        const uint64_t size = varint();
+        need(size);
+        std::string value(reinterpret_cast<const char*>(data_.data() + pos_), size);
+        pos_ += size;
+        return value;
+    }
+
+    std::vector<std::string> strings() {
+        std::vector<std::string> values(count());
+        for (auto& value : values) {
+            value = string();
+        }
+        return values;
+    }
+
+    /// A count whose elements take at least one byte each
+    size_t count() {
+        const uint64_t n = varint();
+        if (n > end_ - pos_) {
+            throw DamagedFile{};
+        }
+        return static_cast<size_t>(n);
+    }
+
+    bool at_end() const { return pos_ == end_; }
+
+private:
+    const std::vector<uint8_t>& data_;
+    size_t pos_;
+    size_t end_;
+
+    void need(uint64_t bytes) const {
+        if (bytes > end_ - pos_) {
+            throw DamagedFile{};
+        }
+    }
+};
+
+std::vector<uint8_t> encode(const RunFingerprint& fingerprint, const CachedRun& run) {
+    // Periods first, into the body, collecting the dictionary on the way
+    std::unordered_map<std::string, uint64_t> index;
+    std::vector<const std::string*> codes;
+    Encoder body;
+    body.varint(run.periods.size());
+    for (const auto& period : run.periods) {
+        body.put<uint8_t>(period.success ? 1 : 0);
+        body.strings(period.errors);
+        body.strings(period.warnings.messages());
+        body.varint(period.line_items.size());
+        for (const auto& [code, value] : period.line_items) {
+            auto [it, added] = index.emplace(code, codes.size());
+            if (added) {
+                codes.push_back(&code);
+            }
+            body.varint(it->second);
+            body.put(value);
+        }
+    }
+    body.strings(run.errors);
+    body.strings(run.warnings.messages());
+    body.varint(run.triggered_actions.size());
+    for (const auto& action : run.triggered_actions) {
+        body.string(action);
+    }
+
+    Encoder file;
+    file.out.insert(file.out.end(), MAGIC, MAGIC + 4);
+    file.put(ResultCache::FORMAT_VERSION);
+    file.put(fingerprint.high);
+    file.put(fingerprint.low);
+    file.varint(codes.size());
+    for (const std::string* code : codes) {
+        file.string(*code);
+    }
+    file.out.insert(file.out.end(), body.out.begin(), body.out.end());
+    file.put(fnv1a(file.out.data(), file.out.size()));
+    return std::move(file.out);
+}
+
+CachedRun decode(const std::vector<uint8_t>& data, const RunFingerprint& fingerprint) {
+    const size_t header = sizeof(MAGIC) + sizeof(uint32_t);
+    if (data.size() < header + sizeof(uint64_t) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw DamagedFile{};
+    }
+    const size_t end = data.size() - sizeof(uint64_t);
+    uint64_t hash;
+    std::memcpy(&hash, data.data() + end, sizeof(hash));
+    Decoder in(data, sizeof(MAGIC), end);
+    if (in.get<uint32_t>() != ResultCache::FORMAT_VERSION || hash != fnv1a(data.data(), end)) {
+        throw DamagedFile{};
+    }
+    RunFingerprint stored;
+    stored.high = in.get<uint64_t>();
+    stored.low = in.get<uint64_t>();
+    if (stored != fingerprint) {
+        throw DamagedFile{};
+    }
+    const std::vector<std::string> codes = in.strings();
+
+    CachedRun run;
+    run.periods.resize(in.count());
+    std::vector<uint64_t> previous_layout;
+    std::shared_ptr<const unified::ResultSchema> schema;
+    for (auto& period : run.periods) {
+        period.success = in.get<uint8_t>() != 0;
+        period.errors = in.strings();
+        period.warnings = unified::Diagnostics::from_messages(in.strings());
+        std::vector<uint64_t> layout(in.count());
+        std::vector<double> values(layout.size());
+        for (size_t i = 0; i < layout.size(); ++i) {
+            layout[i] = in.varint();
+            if (layout[i] >= codes.size()) {
+                throw DamagedFile{};
+            }
+            values[i] = in.get<double>();
+        }
+        // Periods of one template share their schema, as calculated ones do
+        if (!schema || layout != previous_layout) {
+            std::vector<std::string> row_codes;
+            row_codes.reserve(layout.size());
+            for (uint64_t code : layout) {
+                row_codes.push_back(codes[code]);
+            }
+            try {
+                schema = std::make_shared<const unified::ResultSchema>(std::move(row_codes));
+            } catch (const std::invalid_argument&) {
+                throw DamagedFile{};
+            }
+            previous_layout = std::move(layout);
+        }
+        period.line_items = unified::ResultRow(schema, std::move(values));
+    }
+    run.errors = in.strings();
+    run.warnings = unified::Diagnostics::from_messages(in.strings());
+    for (size_t i = in.count(); i > 0; --i) {
+        run.triggered_actions.insert(in.string());
+    }
+    if (!in.at_end()) {
+        throw DamagedFile{};
+    }
+    return run;
+}
+
+} // namespace
+
+// ============================================================================
+// RunFingerprint / FingerprintBuilder
+// ============================================================================
+
+std::string RunFingerprint::hex() const {
+    static const char* const HEX = "0123456789abcdef";
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        out[15 - i] = HEX[(high >> (4 * i)) & 0xF];
+        out[31 - i] = HEX[(low >> (4 * i)) & 0xF];
+    }
+    return out;
+}
+
+void FingerprintBuilder::bytes(const void* data, size_t size) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        a_ = (a_ ^ p[i]) * 1099511628211ULL;
+        b_ = (b_ ^ p[i]) * 0xFF51AFD7ED558CCDULL;
+        b_ ^= b_ >> 32;
+    }
+    length_ += size;
+}
+
+FingerprintBuilder& FingerprintBuilder::add_int(int64_t value) {
+    bytes(&value, sizeof(value));
+    return *this;
+}
+
+FingerprintBuilder& FingerprintBuilder::add_double(double value) {
+    bytes(&value, sizeof(value));
+    return *this;
+}
+
+FingerprintBuilder& FingerprintBuilder::add_text(std::string_view text) {
+    const uint64_t size = text.size();
+    bytes(&size, sizeof(size));
+    bytes(text.data(), text.size());
+    return *this;
+}
+
+FingerprintBuilder& FingerprintBuilder::add_fingerprint(const RunFingerprint& fingerprint) {
+    bytes(&fingerprint.high, sizeof(fingerprint.high));
+    bytes(&fingerprint.low, sizeof(fingerprint.low));
+    return *this;
+}
+
+RunFingerprint FingerprintBuilder::finish() const {
+    RunFingerprint fingerprint;
+    fingerprint.high = mix(a_ ^ mix(length_));
+    fingerprint.low = mix(b_ + length_);
+    return fingerprint;
+}
+
+// ============================================================================
+// ResultCache
+// ============================================================================
+
+ResultCache::ResultCache(std::string dir, size_t memory_entries)
+    : dir_(std::move(dir)), memory_entries_(std::max<size_t>(1, memory_entries)) {}
+
+std::string ResultCache::path(const RunFingerprint& fingerprint) const {
+    return (fs::path(dir_) / (fingerprint.hex() + ".fmrc")).string();
+}
+
+std::shared_ptr<const CachedRun> ResultCache::acquire(const RunFingerprint& fingerprint) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool waited = false;
+        while (true) {
+            auto entry = entries_.find(fingerprint);
+            if (entry != entries_.end()) {
+                entry->second.last_used = ++clock_;
+                ++(waited ? stats_.shared : stats_.memory_hits);
+                return entry->second.run;
+            }
+            if (in_flight_.count(fingerprint) == 0) {
+                break;
+            }
+            released_.wait(lock);
+            waited = true;
+        }
+        in_flight_.insert(fingerprint);
+    }
+
+    // Claimed: read the file outside the lock
+    std::shared_ptr<const CachedRun> run;
+    if (!dir_.empty()) {
+        const std::string file = path(fingerprint);
+        std::ifstream in(file, std::ios::binary);
+        if (in) {
+            const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            in.close();
+            try {
+                run = std::make_shared<const CachedRun>(decode(data, fingerprint));
+            } catch (const DamagedFile&) {
+                std::error_code ec;
+                fs::remove(file, ec);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!run) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.disk_hits;
+    in_flight_.erase(fingerprint);
+    remember(fingerprint, run);
+    released_.notify_all();
+    return run;
+}
+
+void ResultCache::store(const RunFingerprint& fingerprint, CachedRun run) {
+    auto shared = std::make_shared<const CachedRun>(std::move(run));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.stores;
+        in_flight_.erase(fingerprint);
+        remember(fingerprint, shared);
+        released_.notify_all();
+    }
+    if (dir_.empty()) {
+        return;
+    }
+
+    // Written under a temporary name and renamed: readers never see part of a file
+    const std::vector<uint8_t> data = encode(fingerprint, *shared);
+    const std::string target = path(fingerprint);
+    const std::string tmp = target + "." + std::to_string(reinterpret_cast<uintptr_t>(shared.get())) + ".tmp";
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            throw std::runtime_error("ResultCache: can't write " + tmp);
+        }
+    }
+    fs::rename(tmp, target, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("ResultCache: can't replace " + target);
+    }
+}
+
+void ResultCache::release(const RunFingerprint& fingerprint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(fingerprint);
+    released_.notify_all();
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResultCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    return stats;
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    if (!dir_.empty()) {
+        std::error_code ec;
+        for (const auto& file : fs::directory_iterator(dir_, ec)) {
+            if (file.path().extension() == ".fmrc") {
+                fs::remove(file.path(), ec);
+            }
+        }
+    }
+}
+
+void ResultCache::remember(const RunFingerprint& fingerprint, std::shared_ptr<const CachedRun> run) {
+    while (entries_.size() >= memory_entries_ && entries_.count(fingerprint) == 0) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+            return a.second.last_used < b.second.last_used;
+        });
+        entries_.erase(oldest);
+    }
+    entries_[fingerprint] = Entry{std::move(run), ++clock_};
+}
+
+} // namespace orchestration
+} // namespace finmodel
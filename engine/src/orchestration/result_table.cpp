@@ -0,0 +1,518 @@
+/**
+ * @file result_table.cpp
+ * @brief Result sources and the SQLite virtual table module over them
+ */
+
+#include "orchestration/result_table.h"
+#include "database/sqlite_database.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace finmodel {
+namespace orchestration {
+
+// ============================================================================
+// Sources
+// ============================================================================
+
+CompressedResultSource::CompressedResultSource(std::shared_ptr<const CompressedResultSet> results)
+    : results_(std::move(results)) {
+    if (!results_) {
+        throw std::invalid_argument("CompressedResultSource: null result set");
+    }
+}
+
+void CompressedResultSource::read(size_t code, const ResultTableFilter& filter, ColumnarSeries& out) const {
+    out = ColumnarSeries{};
+    const auto& periods = results_->period_ids();
+    const std::string& name = results_->line_items()[code];
+    auto add = [&](ScenarioID scenario_id, std::span<const double> series) {
+        for (size_t p = 0; p < series.size(); ++p) {
+            if (filter.matches(scenario_id, periods[p], series[p])) {
+                out.scenario_ids.push_back(scenario_id);
+                out.period_ids.push_back(periods[p]);
+                out.values.push_back(series[p]);
+            }
+        }
+    };
+
+    // One scenario: decode its run only
+    if (filter.scenario_min == filter.scenario_max) {
+        std::vector<double> series;
+        try {
+            series = results_->series(filter.scenario_min, name);
+        } catch (const std::out_of_range&) {
+            return;
+        }
+        add(filter.scenario_min, series);
+        return;
+    }
+    results_->scan(name, [&](ScenarioID scenario_id, std::span<const double> series) {
+        if (scenario_id >= filter.scenario_min && scenario_id <= filter.scenario_max) {
+            add(scenario_id, series);
+        }
+    });
+}
+
+size_t CompressedResultSource::rows_per_line_item() const {
+    return results_->scenario_ids().size() * results_->period_ids().size();
+}
+
+ColumnarResultSource::ColumnarResultSource(std::shared_ptr<const ColumnarResultReader> reader)
+    : reader_(std::move(reader)) {
+    if (!reader_) {
+        throw std::invalid_argument("ColumnarResultSource: null reader");
+    }
+}
+
+void ColumnarResultSource::read(size_t code, const ResultTableFilter& filter, ColumnarSeries& out) const {
+    const std::string& name = reader_->line_items()[code];
+    // A value range skips row groups by their statistics
+    ColumnarSeries rows = (std::isinf(filter.value_min) && std::isinf(filter.value_max))
+        ? reader_->read(name)
+        : reader_->read_where(name, filter.value_min, filter.value_max);
+
+    out = ColumnarSeries{};
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (filter.matches(rows.scenario_ids[i], rows.period_ids[i], rows.values[i])) {
+            out.scenario_ids.push_back(rows.scenario_ids[i]);
+            out.period_ids.push_back(rows.period_ids[i]);
+            out.values.push_back(rows.values[i]);
+        }
+    }
+}
+
+// ============================================================================
+// ResultTable
+// ============================================================================
+
+void ResultTable::add(const EntityID& entity_id, std::shared_ptr<const ResultTableSource> source) {
+    if (!source) {
+        throw std::invalid_argument("ResultTable: null source for entity " + entity_id);
+    }
+    entries_.push_back({entity_id, std::move(source)});
+}
+
+void ResultTable::add(const EntityID& entity_id, std::shared_ptr<const CompressedResultSet> results) {
+    add(entity_id, std::make_shared<CompressedResultSource>(std::move(results)));
+}
+
+void ResultTable::add(const EntityID& entity_id, std::shared_ptr<const ColumnarResultReader> reader) {
+    add(entity_id, std::make_shared<ColumnarResultSource>(std::move(reader)));
+}
+
+namespace {
+
+enum Column { SCENARIO_ID = 0, ENTITY_ID, PERIOD_ID, LINE_ITEM, VALUE };
+
+// Pushed constraint in idxStr: column digit, then an operator letter
+constexpr char OP_EQ = 'e';
+constexpr char OP_GT = 'g';
+constexpr char OP_GE = 'G';
+constexpr char OP_LT = 'l';
+constexpr char OP_LE = 'L';
+constexpr char OP_IN = 'i';   // line_item IN (...), all values at once
+
+struct Table : sqlite3_vtab {
+    std::shared_ptr<const ResultTable> results;
+};
+
+struct Cursor : sqlite3_vtab_cursor {
+    ResultTableFilter filter;
+    bool empty = false;                     ///< A constraint no row can meet
+    bool has_entity = false;
+    std::string entity;
+    bool has_codes = false;
+    std::vector<std::string> codes;         ///< line_item = / IN values
+
+    size_t entry = 0;                       ///< Source being read
+    std::vector<size_t> entry_codes;        ///< Its line items to read (indexes)
+    size_t next_code = 0;                   ///< Next of entry_codes to decode
+    size_t code = 0;                        ///< Line item of rows
+    ColumnarSeries rows;
+    size_t row = 0;
+    sqlite3_int64 rowid = 0;
+};
+
+const ResultTable& results_of(sqlite3_vtab_cursor* cursor) {
+    return *static_cast<Table*>(cursor->pVtab)->results;
+}
+
+int connect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** out, char** error) {
+    const int rc = sqlite3_declare_vtab(db,
+        "CREATE TABLE x(scenario_id INTEGER, entity_id TEXT, period_id INTEGER, line_item TEXT, value REAL)");
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    auto* table = new (std::nothrow) Table();
+    if (!table) {
+        return SQLITE_NOMEM;
+    }
+    table->results = *static_cast<std::shared_ptr<const ResultTable>*>(aux);
+    *out = table;
+    (void)error;
+    return SQLITE_OK;
+}
+
+int disconnect(sqlite3_vtab* vtab) {
+    delete static_cast<Table*>(vtab);
+    return SQLITE_OK;
+}
+
+int best_index(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+    const ResultTable& results = *static_cast<Table*>(vtab)->results;
+    double rows = 0.0;
+    double line_items = 1.0;
+    for (const auto& entry : results.entries()) {
+        rows += static_cast<double>(entry.source->rows_per_line_item() * entry.source->line_items().size());
+        line_items = std::max(line_items, static_cast<double>(entry.source->line_items().size()));
+    }
+
+    std::string pushed;
+    int argv = 0;
+    double selectivity = 1.0;
+    bool line_item_used = false;
+    for (int i = 0; i < info->nConstraint; ++i) {
+        const auto& constraint = info->aConstraint[i];
+        if (!constraint.usable || constraint.iColumn < 0) {
+            continue;
+        }
+        const int column = constraint.iColumn;
+        char op = 0;
+        switch (constraint.op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ: op = OP_EQ; break;
+            case SQLITE_INDEX_CONSTRAINT_GT: op = OP_GT; break;
+            case SQLITE_INDEX_CONSTRAINT_GE: op = OP_GE; break;
+            case SQLITE_INDEX_CONSTRAINT_LT: op = OP_LT; break;
+            case SQLITE_INDEX_CONSTRAINT_LE: op = OP_LE; break;
+            default: continue;
+        }
+        const bool text = column == ENTITY_ID || column == LINE_ITEM;
+        if (text && op != OP_EQ) {
+            continue;
+        }
+        if (column == LINE_ITEM) {
+            if (line_item_used) {
+                continue;
+            }
+            line_item_used = true;
+            if (sqlite3_vtab_in(info, i, -1)) {
+                sqlite3_vtab_in(info, i, 1);
+                op = OP_IN;
+            }
+            selectivity /= line_items;
+        } else {
+            selectivity *= (op == OP_EQ) ? 0.1 : 0.5;
+        }
+
+        // Constraints are rechecked by SQLite (omit stays 0): pushdown only has to narrow
+        info->aConstraintUsage[i].argvIndex = ++argv;
+        pushed += static_cast<char>('0' + column);
+        pushed += op;
+    }
+
+    info->idxStr = sqlite3_mprintf("%s", pushed.c_str());
+    if (!info->idxStr) {
+        return SQLITE_NOMEM;
+    }
+    info->needToFreeIdxStr = 1;
+    info->estimatedRows = static_cast<sqlite3_int64>(std::max(1.0, rows * selectivity));
+    info->estimatedCost = std::max(1.0, rows * selectivity);
+    return SQLITE_OK;
+}
+
+int open_cursor(sqlite3_vtab*, sqlite3_vtab_cursor** out) {
+    auto* cursor = new (std::nothrow) Cursor();
+    if (!cursor) {
+        return SQLITE_NOMEM;
+    }
+    *out = cursor;
+    return SQLITE_OK;
+}
+
+int close_cursor(sqlite3_vtab_cursor* cursor) {
+    delete static_cast<Cursor*>(cursor);
+    return SQLITE_OK;
+}
+
+/**
+ * @brief Narrow an integer range by a numeric bound (other types don't narrow)
+ */
+template <typename Id>
+void narrow(Id& min, Id& max, char op, sqlite3_value* value, bool& empty) {
+    const int type = sqlite3_value_numeric_type(value);
+    if (type == SQLITE_NULL) {
+        empty = true;   // Comparisons with NULL are never true
+        return;
+    }
+    if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) {
+        return;
+    }
+    const double bound = sqlite3_value_double(value);
+    const double lowest = static_cast<double>(std::numeric_limits<Id>::min());
+    const double highest = static_cast<double>(std::numeric_limits<Id>::max());
+    auto clamp = [&](double v) { return static_cast<Id>(std::min(highest, std::max(lowest, v))); };
+    double lo = lowest;
+    double hi = highest;
+    switch (op) {
+        case OP_EQ: lo = std::ceil(bound); hi = std::floor(bound); break;
+        case OP_GT: lo = std::floor(bound) + 1.0; break;
+        case OP_GE: lo = std::ceil(bound); break;
+        case OP_LT: hi = std::ceil(bound) - 1.0; break;
+        case OP_LE: hi = std::floor(bound); break;
+        default: return;
+    }
+    if (lo > highest || hi < lowest || lo > hi) {
+        empty = true;
+        return;
+    }
+    min = std::max(min, clamp(lo));
+    max = std::min(max, clamp(hi));
+    if (min > max) {
+        empty = true;
+    }
+}
+
+void narrow_value(ResultTableFilter& filter, char op, sqlite3_value* value, bool& empty) {
+    const int type = sqlite3_value_numeric_type(value);
+    if (type == SQLITE_NULL) {
+        empty = true;
+        return;
+    }
+    if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) {
+        return;
+    }
+    // Inclusive bounds: strict comparisons are rechecked by SQLite
+    const double bound = sqlite3_value_double(value);
+    if (op == OP_EQ || op == OP_GT || op == OP_GE) {
+        filter.value_min = std::max(filter.value_min, bound);
+    }
+    if (op == OP_EQ || op == OP_LT || op == OP_LE) {
+        filter.value_max = std::min(filter.value_max, bound);
+    }
+    if (filter.value_min > filter.value_max) {
+        empty = true;
+    }
+}
+
+/**
+ * @brief Move to the next line item with rows (or past the last source)
+ */
+void load_next(Cursor& cursor) {
+    const auto& entries = results_of(&cursor).entries();
+    while (cursor.entry < entries.size()) {
+        const auto& entry = entries[cursor.entry];
+        if (cursor.next_code == 0 && cursor.entry_codes.empty()) {
+            if (!cursor.has_entity || entry.entity_id == cursor.entity) {
+                const auto& items = entry.source->line_items();
+                if (cursor.has_codes) {
+                    std::unordered_map<std::string, size_t> index;
+                    for (size_t c = 0; c < items.size(); ++c) {
+                        index.emplace(items[c], c);
+                    }
+                    for (const auto& code : cursor.codes) {
+                        auto it = index.find(code);
+                        if (it != index.end()) {
+                            cursor.entry_codes.push_back(it->second);
+                        }
+                    }
+                } else {
+                    for (size_t c = 0; c < items.size(); ++c) {
+                        cursor.entry_codes.push_back(c);
+                    }
+                }
+            }
+        }
+        while (cursor.next_code < cursor.entry_codes.size()) {
+            cursor.code = cursor.entry_codes[cursor.next_code++];
+            entry.source->read(cursor.code, cursor.filter, cursor.rows);
+            cursor.row = 0;
+            if (cursor.rows.size() > 0) {
+                return;
+            }
+        }
+        ++cursor.entry;
+        cursor.entry_codes.clear();
+        cursor.next_code = 0;
+    }
+    cursor.rows = ColumnarSeries{};
+    cursor.row = 0;
+}
+
+int filter(sqlite3_vtab_cursor* base, int, const char* idx_str, int argc, sqlite3_value** argv) {
+    auto& cursor = *static_cast<Cursor*>(base);
+    cursor.filter = ResultTableFilter{};
+    cursor.empty = false;
+    cursor.has_entity = false;
+    cursor.has_codes = false;
+    cursor.codes.clear();
+    cursor.entry = 0;
+    cursor.entry_codes.clear();
+    cursor.next_code = 0;
+    cursor.rows = ColumnarSeries{};
+    cursor.row = 0;
+    cursor.rowid = 0;
+
+    const std::string pushed = idx_str ? idx_str : "";
+    for (int i = 0; i < argc && 2 * static_cast<size_t>(i) + 1 < pushed.size(); ++i) {
+        const int column = pushed[2 * i] - '0';
+        const char op = pushed[2 * i + 1];
+        sqlite3_value* value = argv[i];
+        switch (column) {
+            case SCENARIO_ID:
+                narrow(cursor.filter.scenario_min, cursor.filter.scenario_max, op, value, cursor.empty);
+                break;
+            case PERIOD_ID:
+                narrow(cursor.filter.period_min, cursor.filter.period_max, op, value, cursor.empty);
+                break;
+            case VALUE:
+                narrow_value(cursor.filter, op, value, cursor.empty);
+                break;
+            case ENTITY_ID:
+                if (sqlite3_value_type(value) == SQLITE_NULL) {
+                    cursor.empty = true;
+                } else {
+                    cursor.has_entity = true;
+                    cursor.entity = reinterpret_cast<const char*>(sqlite3_value_text(value));
+                }
+                break;
+            case LINE_ITEM: {
+                cursor.has_codes = true;
+                if (op == OP_IN) {
+                    sqlite3_value* item = nullptr;
+                    for (int rc = sqlite3_vtab_in_first(value, &item); rc == SQLITE_OK && item;
+                         rc = sqlite3_vtab_in_next(value, &item)) {
+                        if (sqlite3_value_type(item) != SQLITE_NULL) {
+                            cursor.codes.emplace_back(reinterpret_cast<const char*>(sqlite3_value_text(item)));
+                        }
+                    }
+                } else if (sqlite3_value_type(value) != SQLITE_NULL) {
+                    cursor.codes.emplace_back(reinterpret_cast<const char*>(sqlite3_value_text(value)));
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    if (cursor.empty) {
+        cursor.entry = results_of(base).entries().size();
+        return SQLITE_OK;
+    }
+    try {
+        load_next(cursor);
+    } catch (const std::exception& e) {
+        sqlite3_free(base->pVtab->zErrMsg);
+        base->pVtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+int next(sqlite3_vtab_cursor* base) {
+    auto& cursor = *static_cast<Cursor*>(base);
+    ++cursor.rowid;
+    if (++cursor.row < cursor.rows.size()) {
+        return SQLITE_OK;
+    }
+    try {
+        load_next(cursor);
+    } catch (const std::exception& e) {
+        sqlite3_free(base->pVtab->zErrMsg);
+        base->pVtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+int eof(sqlite3_vtab_cursor* base) {
+    const auto& cursor = *static_cast<Cursor*>(base);
+    return cursor.row >= cursor.rows.size() ? 1 : 0;
+}
+
+int column(sqlite3_vtab_cursor* base, sqlite3_context* context, int column) {
+    const auto& cursor = *static_cast<Cursor*>(base);
+    const auto& entry = results_of(base).entries()[cursor.entry];
+    switch (column) {
+        case SCENARIO_ID:
+            sqlite3_result_int64(context, cursor.rows.scenario_ids[cursor.row]);
+            break;
+        case ENTITY_ID:
+            sqlite3_result_text(context, entry.entity_id.data(), static_cast<int>(entry.entity_id.size()),
+                                SQLITE_TRANSIENT);
+            break;
+        case PERIOD_ID:
+            sqlite3_result_int64(context, cursor.rows.period_ids[cursor.row]);
+            break;
+        case LINE_ITEM: {
+            const std::string& code = entry.source->line_items()[cursor.code];
+            sqlite3_result_text(context, code.data(), static_cast<int>(code.size()), SQLITE_TRANSIENT);
+            break;
+        }
+        case VALUE:
+            sqlite3_result_double(context, cursor.rows.values[cursor.row]);
+            break;
+        default:
+            sqlite3_result_null(context);
+            break;
+    }
+    return SQLITE_OK;
+}
+
+int rowid(sqlite3_vtab_cursor* base, sqlite3_int64* out) {
+    *out = static_cast<Cursor*>(base)->rowid;
+    return SQLITE_OK;
+}
+
+sqlite3_module make_module() {
+    sqlite3_module module{};
+    module.iVersion = 0;
+    module.xCreate = nullptr;   // Eponymous only: no CREATE VIRTUAL TABLE
+    module.xConnect = connect;
+    module.xBestIndex = best_index;
+    module.xDisconnect = disconnect;
+    module.xDestroy = disconnect;
+    module.xOpen = open_cursor;
+    module.xClose = close_cursor;
+    module.xFilter = filter;
+    module.xNext = next;
+    module.xEof = eof;
+    module.xColumn = column;
+    module.xRowid = rowid;
+    return module;
+}
+
+const sqlite3_module result_module = make_module();
+
+} // namespace
+
+void ResultTable::register_module(database::IDatabase& db, std::shared_ptr<const ResultTable> table,
+                                  const std::string& name) {
+    auto* sqlite = dynamic_cast<database::SQLiteDatabase*>(&db);
+    if (!sqlite || !sqlite->native_handle()) {
+        throw std::invalid_argument("ResultTable: " + name + " needs a connected SQLite database");
+    }
+    if (!table) {
+        throw std::invalid_argument("ResultTable: null table for " + name);
+    }
+
+    // Statements prepared against an earlier registration would keep its table
+    sqlite->clear_statement_cache();
+    auto* aux = new std::shared_ptr<const ResultTable>(std::move(table));
+    const int rc = sqlite3_create_module_v2(sqlite->native_handle(), name.c_str(), &result_module, aux,
+        [](void* p) { delete static_cast<std::shared_ptr<const ResultTable>*>(p); });
+    if (rc != SQLITE_OK) {
+        // The destructor has run (sqlite3_create_module_v2 calls it on failure)
+        throw database::DatabaseException("Failed to register " + name + ": " +
+                                          sqlite3_errmsg(sqlite->native_handle()));
+    }
+}
+
+} // namespace orchestration
+} // namespace finmodel
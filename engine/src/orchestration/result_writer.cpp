@@ -0,0 +1,368 @@
+/**
+ * @file result_writer.cpp
+ * @brief Asynchronous result persistence implementation
+ */
+
+#include "orchestration/result_writer.h"
+#include "core/engine_metrics.h"
+#include "database/sqlite_database.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+const char* const INSERT_RUN_SQL =
+    "INSERT INTO run_log (scenario_id, status, json_config) "
+    "VALUES (:scenario_id, 'running', :json_config)";
+
+const char* const INSERT_ROW_SQL =
+    "INSERT INTO unified_result (run_id, entity_id, scenario_id, period_id, line_item_code, value) "
+    "VALUES (:run_id, :entity_id, :scenario_id, :period_id, :line_item_code, :value)";
+
+const char* const END_RUN_SQL =
+    "UPDATE run_log SET status = :status, completed_at = datetime('now'), "
+    "error_message = :error_message, "
+    "json_config = json_set(json_config, '$.calculation_ms', :calculation_ms, '$.write_ms', :write_ms) "
+    "WHERE run_id = :run_id";
+
+const char* const EXEMPLAR_SQL =
+    "UPDATE run_log SET json_config = json_set(json_config, '$.exemplar', json(:exemplar)) "
+    "WHERE run_id = :run_id";
+
+const char* const INSERT_SUMMARY_SQL =
+    "INSERT OR REPLACE INTO run_summary (run_id, scenario_id, entity_id, periods, summary) "
+    "VALUES (:run_id, :scenario_id, :entity_id, :periods, :summary)";
+
+} // namespace
+
+ResultWriter::ResultWriter(std::shared_ptr<database::IDatabase> db, size_t max_rows_per_transaction,
+                           bool defer_indexes, size_t queue_capacity)
+    : db_(std::move(db)),
+      max_rows_per_transaction_(std::max<size_t>(1, max_rows_per_transaction)),
+      queue_(queue_capacity)
+{
+    if (!db_) {
+        throw std::runtime_error("ResultWriter: null database pointer");
+    }
+    // Started before the thread: the session's pragmas run outside any write pass
+    auto* sqlite = dynamic_cast<database::SQLiteDatabase*>(db_.get());
+    if (sqlite && !sqlite->in_transaction()) {
+        database::BulkLoadOptions options;
+        options.tables = {"unified_result"};   // run_log only gains a row per run
+        options.drop_indexes = defer_indexes;
+        bulk_ = std::make_unique<database::BulkLoadSession>(*sqlite, options);
+    }
+    thread_ = std::thread([this] { writer_loop(); });
+}
+
+ResultWriter::~ResultWriter() {
+    queue_.close();
+    thread_.join();
+    bulk_.reset();  // Rebuilds deferred indexes and analyzes
+}
+
+void ResultWriter::set_summary(RunSummarySpec spec) {
+    auto shared = spec.empty() ? nullptr : std::make_shared<const RunSummarySpec>(std::move(spec));
+    std::lock_guard<std::mutex> lock(mutex_);
+    summary_ = std::move(shared);
+}
+
+template <typename Fill>
+void ResultWriter::enqueue(JobType type, RunHandle run, Fill&& fill) {
+    const uint64_t waited = queue_.push([&](Job& job) {
+        job.type = type;
+        job.run = run;
+        job.scenario_id = 0;
+        job.period_id = 0;
+        job.entity_id.clear();
+        job.text.clear();
+        job.exemplar.clear();
+        job.success = true;
+        job.calculation_seconds = 0.0;
+        job.summary.reset();
+        fill(job);
+    });
+    core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_JOBS_QUEUED);
+    if (waited > 0) {
+        core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_QUEUE_STALLS);
+        core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_STALL_NANOSECONDS, waited);
+    }
+}
+
+ResultWriter::RunHandle ResultWriter::begin_run(ScenarioID scenario_id, const std::string& config_json) {
+    RunHandle run;
+    std::shared_ptr<const RunSummarySpec> summary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        run = next_run_++;
+        summary = summary_;
+        runs_[run];
+    }
+    // Outside the lock: a full queue waits for the writer thread, which takes it
+    enqueue(JobType::BEGIN, run, [&](Job& job) {
+        job.scenario_id = scenario_id;
+        job.text = config_json.empty() ? "{}" : config_json;
+        job.summary = std::move(summary);
+    });
+    return run;
+}
+
+void ResultWriter::write_period(RunHandle run, const EntityID& entity_id, ScenarioID scenario_id,
+                                PeriodID period_id, const unified::ResultRow& values) {
+    enqueue(JobType::PERIOD, run, [&](Job& job) {
+        job.entity_id = entity_id;
+        job.scenario_id = scenario_id;
+        job.period_id = period_id;
+        job.values = values;   // Into the slot's buffer
+    });
+}
+
+void ResultWriter::end_run(RunHandle run, bool success, const std::string& error_message,
+                           double calculation_seconds, const std::string& exemplar_json) {
+    enqueue(JobType::END, run, [&](Job& job) {
+        job.success = success;
+        job.text = error_message;
+        job.calculation_seconds = calculation_seconds;
+        job.exemplar = exemplar_json;
+    });
+}
+
+void ResultWriter::flush() {
+    const uint64_t queued = queue_.pushes();
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [&] { return written_ >= queued; });
+    if (!error_.empty()) {
+        std::string error = std::move(error_);
+        error_.clear();
+        throw database::DatabaseException("ResultWriter: " + error);
+    }
+}
+
+int64_t ResultWriter::run_id(RunHandle run) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = runs_.find(run);
+    return (it != runs_.end()) ? it->second.run_id : -1;
+}
+
+ResultWriterStats ResultWriter::stats() const {
+    ResultWriterStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats = stats_;
+    }
+    const core::MpscRingStats queue = queue_.stats();
+    stats.queue_capacity = queue.capacity;
+    stats.queue_depth = queue.depth;
+    stats.max_queue_depth = queue.max_depth;
+    stats.stalls = static_cast<size_t>(queue.stalls);
+    stats.stall_seconds = static_cast<double>(queue.stall_nanoseconds) * 1e-9;
+    return stats;
+}
+
+void ResultWriter::writer_loop() {
+    // Swapped with queue slots: their buffers go back to the queue for reuse
+    std::vector<Job> jobs(queue_.capacity());
+    while (true) {
+        // Everything queued so far is one write pass
+        const size_t count = queue_.pop(jobs.data(), jobs.size());
+        if (count == 0) {
+            if (queue_.closed()) {
+                return;  // Stopping with nothing left to store
+            }
+            queue_.wait();
+            continue;
+        }
+
+        write_jobs(jobs, count);
+        core::EngineMetrics::add(core::EngineMetrics::Counter::RESULT_JOBS_WRITTEN, count);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_ += count;
+        idle_.notify_all();
+    }
+}
+
+void ResultWriter::write_jobs(std::vector<Job>& jobs, size_t count) {
+    std::vector<ParamMap> rows;
+    std::vector<const Job*> ended;
+    std::map<RunHandle, size_t> run_rows;
+
+    size_t next = 0;
+    while (next < count) {
+        const auto started = std::chrono::steady_clock::now();
+        const size_t first = next;
+        rows.clear();
+        ended.clear();
+        run_rows.clear();
+        size_t summary_count = 0;
+        size_t exemplar_count = 0;
+        bool batched = false;
+
+        try {
+            db_->begin_transaction();
+
+            // Runs first so their rows reference a run_id; at most
+            // max_rows_per_transaction_ rows (whole periods) per transaction
+            for (; next < count && rows.size() < max_rows_per_transaction_; ++next) {
+                const Job& job = jobs[next];
+                switch (job.type) {
+                    case JobType::BEGIN: {
+                        db_->execute_update(INSERT_RUN_SQL, {
+                            {"scenario_id", job.scenario_id},
+                            {"json_config", job.text}
+                        });
+                        int64_t id = db_->last_insert_id();
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        RunInfo& info = runs_[job.run];
+                        info.run_id = id;
+                        ++stats_.runs;
+                        if (job.summary) {
+                            summary_specs_[job.run] = job.summary;
+                        }
+                        break;
+                    }
+                    case JobType::PERIOD: {
+                        int64_t id = run_id(job.run);
+                        if (id < 0) {
+                            break;  // The run's row failed in an earlier pass
+                        }
+                        for (const auto& [code, value] : job.values) {
+                            ParamMap row;
+                            row["run_id"] = static_cast<int>(id);
+                            row["entity_id"] = job.entity_id;
+                            row["scenario_id"] = job.scenario_id;
+                            row["period_id"] = job.period_id;
+                            row["line_item_code"] = code;
+                            if (std::isfinite(value)) {
+                                row["value"] = value;
+                            } else {
+                                row["value"] = nullptr;
+                            }
+                            rows.push_back(std::move(row));
+                        }
+                        run_rows[job.run] += job.values.size();
+
+                        // Folded as the rows stream past
+                        auto spec = summary_specs_.find(job.run);
+                        if (spec != summary_specs_.end()) {
+                            auto& summaries = summaries_[job.run];
+                            auto key = std::make_pair(job.scenario_id, job.entity_id);
+                            auto summary = summaries.find(key);
+                            if (summary == summaries.end()) {
+                                summary = summaries.emplace(std::move(key), RunSummary(spec->second)).first;
+                            }
+                            summary->second.add(job.values);
+                        }
+                        break;
+                    }
+                    case JobType::END:
+                        ended.push_back(&job);
+                        break;
+                }
+            }
+
+            batched = true;
+            db_->execute_batch(INSERT_ROW_SQL, rows);
+
+            // Share of this pass's time spent on each run's rows
+            const double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - started).count();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& [run, count] : run_rows) {
+                    if (!rows.empty()) {
+                        runs_[run].write_seconds += seconds * count / rows.size();
+                    }
+                }
+            }
+
+            for (const Job* job : ended) {
+                int64_t id;
+                double write_seconds;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    const RunInfo& info = runs_[job->run];
+                    id = info.run_id;
+                    write_seconds = info.write_seconds;
+                }
+                if (id < 0) {
+                    continue;
+                }
+                ParamMap params = {
+                    {"run_id", static_cast<int>(id)},
+                    {"status", std::string(job->success ? "completed" : "failed")},
+                    {"calculation_ms", job->calculation_seconds * 1000.0},
+                    {"write_ms", write_seconds * 1000.0}
+                };
+                if (job->success || job->text.empty()) {
+                    params["error_message"] = nullptr;
+                } else {
+                    params["error_message"] = job->text;
+                }
+                db_->execute_update(END_RUN_SQL, params);
+                if (!job->exemplar.empty()) {
+                    db_->execute_update(EXEMPLAR_SQL, {{"run_id", static_cast<int>(id)}, {"exemplar", job->exemplar}});
+                    ++exemplar_count;
+                }
+
+                auto summaries = summaries_.find(job->run);
+                if (summaries != summaries_.end()) {
+                    std::vector<ParamMap> summary_rows;
+                    for (const auto& [key, summary] : summaries->second) {
+                        summary_rows.push_back({
+                            {"run_id", static_cast<int>(id)},
+                            {"scenario_id", key.first},
+                            {"entity_id", key.second},
+                            {"periods", static_cast<int>(summary.periods())},
+                            {"summary", summary.to_json()}
+                        });
+                    }
+                    db_->execute_batch(INSERT_SUMMARY_SQL, summary_rows);
+                    summary_count += summary_rows.size();
+                    summaries_.erase(summaries);
+                }
+                summary_specs_.erase(job->run);
+            }
+
+            db_->commit();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = first; i < next; ++i) {
+                if (jobs[i].type == JobType::PERIOD && run_rows.count(jobs[i].run)) {
+                    ++stats_.periods;
+                }
+            }
+            stats_.rows += rows.size();
+            stats_.summaries += summary_count;
+            stats_.exemplars += exemplar_count;
+            ++stats_.transactions;
+            stats_.write_seconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - started).count();
+        } catch (const std::exception& e) {
+            if (db_->in_transaction()) {
+                db_->rollback();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Runs inserted by the rolled back pass have no row
+            for (size_t i = first; i <= next && i < count; ++i) {
+                if (jobs[i].type == JobType::BEGIN) {
+                    runs_[jobs[i].run].run_id = -1;
+                }
+            }
+            if (error_.empty()) {
+                error_ = e.what();
+            }
+            if (!batched) {
+                ++next;  // Drop the failing job with the rest of its pass
+            }
+        }
+    }
+}
+
+} // namespace orchestration
+} // namespace finmodel
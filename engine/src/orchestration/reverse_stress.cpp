@@ -0,0 +1,527 @@
+/**
+ * @file reverse_stress.cpp
+ * @brief Reverse stress search by bisection along directions, gradient steps and adaptive refinement
+ */
+
+#include "orchestration/reverse_stress.h"
+#include "core/low_discrepancy.h"
+#include "core/philox_stream.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Bracket tried around a neighbour's boundary, as a fraction of its distance (ADAPTIVE)
+constexpr double NEIGHBOUR_WINDOW = 0.1;
+
+// Boundary scenarios that seed each adaptive round, as a fraction of the directions
+constexpr size_t SEEDS_PER_ROUND_DIVISOR = 4;
+
+/**
+ * @brief Margin of one run
+ */
+struct Probe {
+    double margin = 0.0;            ///< Smallest distance to the threshold over the periods run
+    size_t worst = 0;               ///< Index of that period
+    PeriodID breach_period = 0;     ///< First breaching period (0: none)
+
+    bool breached() const { return breach_period != 0; }
+};
+
+/**
+ * @brief A boundary scenario with the direction and distance it was found at
+ */
+struct Found {
+    std::vector<double> direction;  ///< Unit vector in driver ranges
+    double distance = 0.0;
+    BoundaryScenario scenario;
+};
+
+/**
+ * @brief Runs of one search: the driver rows read once, shifted for each trial
+ */
+class Problem {
+public:
+    Problem(const ReverseStressSpec& spec, unified::DriverValueProvider::DriverRows rows,
+            std::atomic<size_t>& evaluations)
+        : spec_(spec), rows_(std::move(rows)), evaluations_(evaluations) {
+        for (const auto& driver : spec_.drivers) {
+            const double range = driver.upper - driver.lower;
+            ranges_.push_back(range);
+            lower_.push_back(driver.lower / range);
+            upper_.push_back(driver.upper / range);
+        }
+    }
+
+    const ReverseStressSpec& spec() const { return spec_; }
+    const unified::DriverValueProvider::DriverRows& rows() const { return rows_; }
+    size_t dimensions() const { return ranges_.size(); }
+
+    /**
+     * @brief Shifts of a point in driver ranges
+     */
+    std::map<std::string, double> shifts(const std::vector<double>& x) const {
+        std::map<std::string, double> out;
+        for (size_t i = 0; i < x.size(); ++i) {
+            out[spec_.drivers[i].driver_code] = x[i] * ranges_[i];
+        }
+        return out;
+    }
+
+    /**
+     * @brief Furthest distance along a unit direction that stays in the driver box
+     */
+    double edge(const std::vector<double>& direction) const {
+        double t = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < direction.size(); ++i) {
+            if (direction[i] > 0.0) {
+                t = std::min(t, upper_[i] / direction[i]);
+            } else if (direction[i] < 0.0) {
+                t = std::min(t, lower_[i] / direction[i]);
+            }
+        }
+        return t;
+    }
+
+    /**
+     * @brief A direction without the components the box doesn't extend into
+     */
+    std::vector<double> feasible(std::vector<double> direction) const {
+        for (size_t i = 0; i < direction.size(); ++i) {
+            if ((direction[i] > 0.0 && upper_[i] == 0.0) || (direction[i] < 0.0 && lower_[i] == 0.0)) {
+                direction[i] = 0.0;
+            }
+        }
+        return direction;
+    }
+
+    /**
+     * @brief Point of the box from unit-cube coordinates
+     */
+    double box_coordinate(size_t i, double u) const {
+        return lower_[i] + u * (upper_[i] - lower_[i]);
+    }
+
+    std::vector<double> clamp(std::vector<double> x) const {
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = std::clamp(x[i], lower_[i], upper_[i]);
+        }
+        return x;
+    }
+
+    /**
+     * @brief Run the periods at a point
+     * @param trial Rows of the calling worker, overwritten
+     * @throws std::runtime_error if the run fails or doesn't calculate the breach line item
+     */
+    Probe probe(PeriodRunner& runner, unified::DriverValueProvider::DriverRows& trial,
+                const std::vector<double>& x) const {
+        shift(trial, x);
+        ++evaluations_;
+        auto run = runner.run_periods(spec_.entity_id, spec_.scenario_id, spec_.period_ids, spec_.initial_bs,
+                                      spec_.template_code, trial);
+        if (!run.success) {
+            throw std::runtime_error(run.errors.empty() ? "Run failed" : run.errors.front());
+        }
+        Probe probe;
+        probe.margin = std::numeric_limits<double>::infinity();
+        for (size_t p = 0; p < run.results.size(); ++p) {
+            if (!run.results[p].has_value(spec_.breach_code)) {
+                throw std::runtime_error("'" + spec_.breach_code + "' not calculated in period " +
+                                         std::to_string(spec_.period_ids[p]));
+            }
+            const double margin = margin_of(run.results[p].get_value(spec_.breach_code));
+            if (margin < probe.margin) {
+                probe.margin = margin;
+                probe.worst = p;
+            }
+            if (margin < 0.0 && !probe.breached()) {
+                probe.breach_period = spec_.period_ids[p];
+            }
+        }
+        return probe;
+    }
+
+    /**
+     * @brief Gradient of the margin in the worst period, by the point's coordinates
+     * @throws std::runtime_error if the gradient fails
+     */
+    std::vector<double> gradient(PeriodRunner& runner, unified::DriverValueProvider::DriverRows& trial,
+                                 const std::vector<double>& x, size_t worst) const {
+        shift(trial, x);
+        ++evaluations_;
+        const std::vector<PeriodID> periods(spec_.period_ids.begin(), spec_.period_ids.begin() + worst + 1);
+        auto gradient = runner.gradient(spec_.entity_id, spec_.scenario_id, periods, spec_.initial_bs,
+                                        spec_.template_code, spec_.breach_code, trial);
+        if (!gradient.success) {
+            throw std::runtime_error(gradient.errors.empty() ? "Gradient failed" : gradient.errors.front());
+        }
+        std::vector<double> out(x.size(), 0.0);
+        for (size_t i = 0; i < x.size(); ++i) {
+            auto it = gradient.drivers.find(spec_.drivers[i].driver_code);
+            if (it != gradient.drivers.end()) {
+                out[i] = (spec_.breach_below ? 1.0 : -1.0) * it->second * ranges_[i];
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief Boundary along a unit direction, bisected to the tolerance
+     * @param hint Distance of a neighbour's boundary to bracket first (0: none)
+     * @return Nothing if the direction reaches the box edge unbreached
+     */
+    std::optional<Found> bisect(PeriodRunner& runner, unified::DriverValueProvider::DriverRows& trial,
+                                const std::vector<double>& direction, double hint) const {
+        const double edge_distance = edge(direction);
+        if (!(edge_distance > 0.0)) {
+            return std::nullopt;
+        }
+        auto at = [&](double t) {
+            std::vector<double> x(direction.size());
+            for (size_t i = 0; i < x.size(); ++i) {
+                x[i] = t * direction[i];
+            }
+            return clamp(std::move(x));
+        };
+
+        // [low, high]: unbreached at low (the base at 0), breached at high
+        double low = 0.0;
+        double high = edge_distance;
+        std::optional<Probe> at_high;
+        if (hint > 0.0 && hint < edge_distance) {
+            const double a = hint * (1.0 - NEIGHBOUR_WINDOW);
+            const double b = std::min(hint * (1.0 + NEIGHBOUR_WINDOW), edge_distance);
+            Probe pa = probe(runner, trial, at(a));
+            if (pa.breached()) {
+                high = a;
+                at_high = pa;
+            } else {
+                low = a;
+                Probe pb = probe(runner, trial, at(b));
+                if (pb.breached()) {
+                    high = b;
+                    at_high = pb;
+                } else {
+                    low = b;
+                }
+            }
+        }
+        if (!at_high) {
+            if (low >= edge_distance) {
+                return std::nullopt;
+            }
+            Probe edge_probe = probe(runner, trial, at(edge_distance));
+            if (!edge_probe.breached()) {
+                return std::nullopt;
+            }
+            high = edge_distance;
+            at_high = edge_probe;
+        }
+
+        while (high - low > spec_.tolerance) {
+            const double middle = 0.5 * (low + high);
+            Probe p = probe(runner, trial, at(middle));
+            if (p.breached()) {
+                high = middle;
+                at_high = p;
+            } else {
+                low = middle;
+            }
+        }
+
+        Found found;
+        found.direction = direction;
+        found.distance = high;
+        const auto x = at(high);
+        found.scenario.shifts = shifts(x);
+        found.scenario.severity = norm(x);
+        found.scenario.margin = at_high->margin;
+        found.scenario.breach_period = at_high->breach_period;
+        return found;
+    }
+
+    static double norm(const std::vector<double>& x) {
+        double sum = 0.0;
+        for (double v : x) {
+            sum += v * v;
+        }
+        return std::sqrt(sum);
+    }
+
+private:
+    double margin_of(double value) const {
+        return spec_.breach_below ? value - spec_.threshold : spec_.threshold - value;
+    }
+
+    void shift(unified::DriverValueProvider::DriverRows& trial, const std::vector<double>& x) const {
+        const auto by_code = shifts(x);
+        for (size_t i = 0; i < rows_.rows.size(); ++i) {
+            auto it = by_code.find(rows_.rows[i].driver_code);
+            trial.rows[i].value = rows_.rows[i].value + (it != by_code.end() ? it->second : 0.0);
+        }
+    }
+
+    const ReverseStressSpec& spec_;
+    const unified::DriverValueProvider::DriverRows rows_;
+    std::vector<double> ranges_;
+    std::vector<double> lower_;     // Box in driver ranges
+    std::vector<double> upper_;
+    std::atomic<size_t>& evaluations_;
+};
+
+std::vector<double> normalised(std::vector<double> x) {
+    const double length = Problem::norm(x);
+    if (length > 0.0) {
+        for (double& v : x) {
+            v /= length;
+        }
+    }
+    return x;
+}
+
+/**
+ * @brief Every driver axis both ways (where the box extends), then directions to Sobol points of the box
+ */
+std::vector<std::vector<double>> initial_directions(const ReverseStressSpec& spec, const Problem& problem) {
+    const size_t k = spec.drivers.size();
+    std::vector<std::vector<double>> directions;
+    for (size_t i = 0; i < k; ++i) {
+        for (double sign : {1.0, -1.0}) {
+            if ((sign > 0.0 ? spec.drivers[i].upper : spec.drivers[i].lower) != 0.0) {
+                std::vector<double> axis(k, 0.0);
+                axis[i] = sign;
+                directions.push_back(std::move(axis));
+            }
+        }
+    }
+    if (k < 2) {
+        return directions;
+    }
+    core::SobolSequence sobol(k, spec.seed);
+    const auto shift = sobol.scramble(0);
+    for (uint32_t point = 0; directions.size() < spec.directions; ++point) {
+        std::vector<double> x(k);
+        for (size_t i = 0; i < k; ++i) {
+            x[i] = problem.box_coordinate(i, sobol.coordinate(point, i, shift[i]));
+        }
+        if (Problem::norm(x) > 0.0) {
+            directions.push_back(normalised(std::move(x)));
+        }
+    }
+    return directions;
+}
+
+ReverseStressResult failed(const std::string& error) {
+    ReverseStressResult result;
+    result.success = false;
+    result.errors.push_back(error);
+    return result;
+}
+
+std::string stop_condition(const ReverseStressSpec& spec) {
+    std::ostringstream condition;
+    condition << spec.breach_code << (spec.breach_below ? " < " : " > ")
+              << std::setprecision(17) << spec.threshold;
+    return condition.str();
+}
+
+} // namespace
+
+ReverseStressSearch::ReverseStressSearch(ConnectionFactory connect, size_t threads)
+    : connect_(std::move(connect)), pool_(threads)
+{
+    if (!connect_) {
+        throw std::invalid_argument("ReverseStressSearch: a connection factory is required");
+    }
+    workers_.resize(pool_.size());
+}
+
+ReverseStressSearch::Worker& ReverseStressSearch::worker(size_t index) {
+    Worker& worker = workers_[index];
+    if (!worker.runner) {
+        worker.db = connect_();
+        worker.runner = std::make_unique<PeriodRunner>(worker.db);
+        worker.runner->set_incremental(true);
+    }
+    return worker;
+}
+
+ReverseStressResult ReverseStressSearch::search(const ReverseStressSpec& spec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (spec.breach_code.empty()) {
+        return failed("Reverse stress: no breach line item");
+    }
+    if (spec.drivers.empty()) {
+        return failed("Reverse stress: no drivers");
+    }
+    if (spec.period_ids.empty()) {
+        return failed("Reverse stress: no periods");
+    }
+    if (!(spec.tolerance > 0.0)) {
+        return failed("Reverse stress: tolerance must be positive");
+    }
+    for (const auto& driver : spec.drivers) {
+        if (!(driver.lower <= 0.0 && driver.upper >= 0.0 && driver.lower < driver.upper) ||
+            !std::isfinite(driver.lower) || !std::isfinite(driver.upper)) {
+            return failed("Reverse stress: driver '" + driver.driver_code +
+                          "' needs finite shifts lower ≤ 0 ≤ upper, lower < upper");
+        }
+    }
+
+    ReverseStressResult result;
+    std::atomic<size_t> evaluations{0};
+    try {
+        Worker& first = worker(0);
+        auto rows = unified::DriverValueProvider::fetch_rows(*first.db, spec.entity_id, spec.scenario_id,
+                                                             spec.period_ids);
+        for (const auto& driver : spec.drivers) {
+            if (std::none_of(rows.rows.begin(), rows.rows.end(),
+                             [&](const auto& row) { return row.driver_code == driver.driver_code; })) {
+                return failed("Reverse stress: driver '" + driver.driver_code + "' has no values in scenario " +
+                              std::to_string(spec.scenario_id));
+            }
+        }
+        const Problem problem(spec, std::move(rows), evaluations);
+        const StopConditions stop{stop_condition(spec)};
+        first.runner->set_stop_conditions(stop);
+
+        auto base_trial = problem.rows();
+        const std::vector<double> base(problem.dimensions(), 0.0);
+        const Probe at_base = problem.probe(*first.runner, base_trial, base);
+        if (at_base.breached()) {
+            result.base_breached = true;
+            result.evaluations = evaluations;
+            return result;
+        }
+
+        std::vector<Found> found;
+        std::mutex found_mutex;
+
+        // Directions bisected in parallel; a failed run drops its direction
+        auto bisect_all = [&](const std::vector<std::vector<double>>& directions, const std::vector<double>& hints) {
+            std::vector<std::optional<Found>> out(directions.size());
+            std::vector<std::string> errors(directions.size());
+            pool_.parallel_for(directions.size(), [&](size_t begin, size_t end, size_t index) {
+                Worker& w = worker(index);
+                w.runner->set_stop_conditions(stop);
+                auto trial = problem.rows();
+                for (size_t d = begin; d < end; ++d) {
+                    try {
+                        out[d] = problem.bisect(*w.runner, trial, directions[d], hints[d]);
+                    } catch (const std::exception& e) {
+                        errors[d] = e.what();
+                    }
+                }
+            });
+            std::lock_guard<std::mutex> guard(found_mutex);
+            for (size_t d = 0; d < directions.size(); ++d) {
+                if (!errors[d].empty()) {
+                    result.success = false;
+                    result.errors.push_back("Reverse stress: " + errors[d]);
+                } else if (out[d]) {
+                    found.push_back(std::move(*out[d]));
+                } else {
+                    ++result.unbreached_directions;
+                }
+            }
+        };
+
+        if (spec.method == ReverseStressMethod::GRADIENT) {
+            // Hasofer-Lind: x ← ((∇g·x - g) / |∇g|²) ∇g, the closest point of the linearised boundary
+            std::vector<double> x = base;
+            Probe at_x = at_base;
+            bool converged = false;
+            for (size_t iteration = 0; iteration < spec.max_iterations && !converged; ++iteration) {
+                const auto g = problem.gradient(*first.runner, base_trial, x, at_x.worst);
+                double dot = 0.0;
+                double squares = 0.0;
+                for (size_t i = 0; i < x.size(); ++i) {
+                    dot += g[i] * x[i];
+                    squares += g[i] * g[i];
+                }
+                if (squares == 0.0) {
+                    result.errors.push_back("Reverse stress: '" + spec.breach_code + "' doesn't move with the drivers");
+                    break;
+                }
+                std::vector<double> next(x.size());
+                for (size_t i = 0; i < x.size(); ++i) {
+                    next[i] = (dot - at_x.margin) / squares * g[i];
+                }
+                next = problem.clamp(std::move(next));
+                double step = 0.0;
+                for (size_t i = 0; i < x.size(); ++i) {
+                    step += (next[i] - x[i]) * (next[i] - x[i]);
+                }
+                converged = std::sqrt(step) <= spec.tolerance;
+                x = std::move(next);
+                at_x = problem.probe(*first.runner, base_trial, x);
+            }
+            if (!converged && result.errors.empty()) {
+                result.errors.push_back("Reverse stress: no convergence in " + std::to_string(spec.max_iterations) +
+                                        " iterations");
+            }
+            // Settled on the breaching side along the direction found
+            const double distance = Problem::norm(x);
+            if (distance > 0.0) {
+                bisect_all({normalised(x)}, {distance});
+            }
+        } else {
+            const auto directions = initial_directions(spec, problem);
+            bisect_all(directions, std::vector<double>(directions.size(), 0.0));
+
+            const size_t rounds = spec.method == ReverseStressMethod::ADAPTIVE ? spec.refinements : 0;
+            double spread = 0.5;
+            for (size_t round = 1; round <= rounds && !found.empty(); ++round, spread *= 0.5) {
+                // Directions scattered around the least severe breaches, bracketed near their boundary
+                std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+                    return a.scenario.severity < b.scenario.severity;
+                });
+                const size_t seeds = std::min(found.size(),
+                                              std::max<size_t>(1, spec.directions / SEEDS_PER_ROUND_DIVISOR));
+                std::vector<std::vector<double>> scattered;
+                std::vector<double> hints;
+                for (size_t j = 0; j < spec.directions; ++j) {
+                    const Found& seed = found[j % seeds];
+                    core::PhiloxStream stream(spec.seed, round * spec.directions + j);
+                    std::vector<double> direction = seed.direction;
+                    for (double& v : direction) {
+                        v += spread * stream.normal();
+                    }
+                    direction = problem.feasible(std::move(direction));
+                    if (Problem::norm(direction) == 0.0) {
+                        continue;
+                    }
+                    scattered.push_back(normalised(std::move(direction)));
+                    hints.push_back(seed.distance);
+                }
+                bisect_all(scattered, hints);
+            }
+        }
+
+        std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+            return a.scenario.severity < b.scenario.severity;
+        });
+        for (auto& f : found) {
+            result.boundary.push_back(std::move(f.scenario));
+        }
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.errors.push_back(std::string("Reverse stress: ") + e.what());
+    }
+    result.evaluations = evaluations;
+    return result;
+}
+
+} // namespace orchestration
+} // namespace finmodel
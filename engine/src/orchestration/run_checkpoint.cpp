@@ -0,0 +1,366 @@
+/**
+ * @file run_checkpoint.cpp
+ * @brief Checkpoint file encoding and storage
+ *
+ * Layout:
+ *   "FMCK" u32 version
+ *   entity, scenario, template, last period, periods done
+ *   Code dictionary (every line item code once)
+ *   Closing balance sheet, prior values, triggers, history, errors
+ *   u64 FNV-1a hash of everything before it
+ *
+ * Integers are varints (signed ones zigzag-encoded), strings are a varint
+ * length and bytes, value maps are (code index, double) pairs.
+ */
+
+#include "orchestration/run_checkpoint.h"
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+constexpr char MAGIC[4] = {'F', 'M', 'C', 'K'};
+
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// Encoding
+// ----------------------------------------------------------------------------
+
+class Encoder {
+public:
+    std::vector<uint8_t> out;
+
+    template <typename T>
+    void put(T value) {
+        uint8_t bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void signed_varint(int64_t value) {
+        varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void string(const std::string& value) {
+        varint(value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+};
+
+class Decoder {
+public:
+    Decoder(const std::vector<uint8_t>& data, size_t begin, size_t end, const std::string& path)
+        : data_(data), pos_(begin), end_(end), path_(path) {}
+
+    template <typename T>
+    T get() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            const uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        damaged();
+    }
+
+    int64_t signed_varint() {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    std::string string() {
+        const uint64_t size = varint();
+        need(size);
+        std::string value(reinterpret_cast<const char*>(data_.data() + pos_), size);
+        pos_ += size;
+        return value;
+    }
+
+    /// A count whose elements take at least one byte each
+    size_t count() {
+        const uint64_t n = varint();
+        if (n > end_ - pos_) {
+            damaged();
+        }
+        return static_cast<size_t>(n);
+    }
+
+    bool at_end() const { return pos_ == end_; }
+
+    [[noreturn]] void damaged() const {
+        throw std::runtime_error("CheckpointStore: damaged checkpoint " + path_);
+    }
+
+private:
+    const std::vector<uint8_t>& data_;
+    size_t pos_;
+    size_t end_;
+    const std::string& path_;
+
+    void need(uint64_t bytes) const {
+        if (bytes > end_ - pos_) {
+            damaged();
+        }
+    }
+};
+
+/// Line item codes, each stored once
+class CodeDictionary {
+public:
+    uint64_t index(const std::string& code) {
+        auto [it, added] = index_.emplace(code, codes_.size());
+        if (added) {
+            codes_.push_back(code);
+        }
+        return it->second;
+    }
+
+    const std::vector<std::string>& codes() const { return codes_; }
+
+private:
+    std::unordered_map<std::string, uint64_t> index_;
+    std::vector<std::string> codes_;
+};
+
+void put_values(Encoder& out, CodeDictionary& codes, const std::map<std::string, double>& values) {
+    out.varint(values.size());
+    for (const auto& [code, value] : values) {
+        out.varint(codes.index(code));
+        out.put(value);
+    }
+}
+
+std::map<std::string, double> get_values(Decoder& in, const std::vector<std::string>& codes) {
+    std::map<std::string, double> values;
+    for (size_t i = in.count(); i > 0; --i) {
+        const uint64_t code = in.varint();
+        if (code >= codes.size()) {
+            in.damaged();
+        }
+        values.emplace_hint(values.end(), codes[code], in.get<double>());
+    }
+    return values;
+}
+
+std::vector<uint8_t> encode(const RunCheckpoint& checkpoint) {
+    // Maps first, into the body, collecting the dictionary on the way
+    CodeDictionary codes;
+    Encoder body;
+    body.put(checkpoint.closing_bs.total_assets);
+    body.put(checkpoint.closing_bs.total_liabilities);
+    body.put(checkpoint.closing_bs.total_equity);
+    body.put(checkpoint.closing_bs.cash);
+    put_values(body, codes, checkpoint.closing_bs.line_items);
+    put_values(body, codes, checkpoint.prior_values);
+    body.varint(checkpoint.triggered_actions.size());
+    for (const auto& action : checkpoint.triggered_actions) {
+        body.string(action);
+    }
+    body.varint(checkpoint.history.size());
+    for (const auto& [period_id, values] : checkpoint.history) {
+        body.signed_varint(period_id);
+        put_values(body, codes, values);
+    }
+    body.varint(checkpoint.errors.size());
+    for (const auto& error : checkpoint.errors) {
+        body.string(error);
+    }
+    body.varint(checkpoint.tax_state.size());
+    for (const auto& [name, state] : checkpoint.tax_state) {
+        body.string(name);
+        body.varint(state.size());
+        for (double value : state) {
+            body.put(value);
+        }
+    }
+
+    Encoder file;
+    file.out.insert(file.out.end(), MAGIC, MAGIC + 4);
+    file.put(CheckpointStore::FORMAT_VERSION);
+    file.string(checkpoint.entity_id);
+    file.signed_varint(checkpoint.scenario_id);
+    file.string(checkpoint.template_code);
+    file.signed_varint(checkpoint.last_period);
+    file.varint(checkpoint.periods_done);
+    file.varint(codes.codes().size());
+    for (const auto& code : codes.codes()) {
+        file.string(code);
+    }
+    file.out.insert(file.out.end(), body.out.begin(), body.out.end());
+    file.put(fnv1a(file.out.data(), file.out.size()));
+    return std::move(file.out);
+}
+
+RunCheckpoint decode(const std::vector<uint8_t>& data, const std::string& path) {
+    const size_t header = sizeof(MAGIC) + sizeof(uint32_t);
+    if (data.size() < header + sizeof(uint64_t) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("CheckpointStore: not a checkpoint file: " + path);
+    }
+    const size_t end = data.size() - sizeof(uint64_t);
+    uint64_t hash;
+    std::memcpy(&hash, data.data() + end, sizeof(hash));
+    Decoder in(data, sizeof(MAGIC), end, path);
+    const uint32_t version = in.get<uint32_t>();
+    if (version != CheckpointStore::FORMAT_VERSION) {
+        throw std::runtime_error("CheckpointStore: " + path + " has format version " +
+                                 std::to_string(version) + ", expected " +
+                                 std::to_string(CheckpointStore::FORMAT_VERSION));
+    }
+    if (hash != fnv1a(data.data(), end)) {
+        in.damaged();
+    }
+
+    RunCheckpoint checkpoint;
+    checkpoint.entity_id = in.string();
+    checkpoint.scenario_id = static_cast<ScenarioID>(in.signed_varint());
+    checkpoint.template_code = in.string();
+    checkpoint.last_period = static_cast<PeriodID>(in.signed_varint());
+    checkpoint.periods_done = static_cast<size_t>(in.varint());
+
+    std::vector<std::string> codes(in.count());
+    for (auto& code : codes) {
+        code = in.string();
+    }
+
+    checkpoint.closing_bs.total_assets = in.get<double>();
+    checkpoint.closing_bs.total_liabilities = in.get<double>();
+    checkpoint.closing_bs.total_equity = in.get<double>();
+    checkpoint.closing_bs.cash = in.get<double>();
+    checkpoint.closing_bs.line_items = get_values(in, codes);
+    checkpoint.prior_values = get_values(in, codes);
+    for (size_t i = in.count(); i > 0; --i) {
+        checkpoint.triggered_actions.insert(in.string());
+    }
+    for (size_t i = in.count(); i > 0; --i) {
+        const auto period_id = static_cast<PeriodID>(in.signed_varint());
+        checkpoint.history.emplace_back(period_id, get_values(in, codes));
+    }
+    for (size_t i = in.count(); i > 0; --i) {
+        checkpoint.errors.push_back(in.string());
+    }
+    for (size_t i = in.count(); i > 0; --i) {
+        std::vector<double>& state = checkpoint.tax_state[in.string()];
+        state.resize(in.count());
+        for (double& value : state) {
+            value = in.get<double>();
+        }
+    }
+    if (!in.at_end()) {
+        in.damaged();
+    }
+    return checkpoint;
+}
+
+/// Entity codes in file names: letters, digits, '-' and '_' kept, others %XX
+std::string file_name_part(const std::string& text) {
+    static const char* const HEX = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || c == '-' || c == '_') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += HEX[c >> 4];
+            out += HEX[c & 0xF];
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+CheckpointStore::CheckpointStore(std::string root, std::string run_id)
+    : run_id_(std::move(run_id))
+{
+    if (run_id_.empty()) {
+        throw std::invalid_argument("CheckpointStore: empty run ID");
+    }
+    dir_ = (fs::path(root) / file_name_part(run_id_)).string();
+}
+
+std::string CheckpointStore::path(const EntityID& entity_id, ScenarioID scenario_id) const {
+    return (fs::path(dir_) / (file_name_part(entity_id) + "." + std::to_string(scenario_id) + ".ckpt")).string();
+}
+
+void CheckpointStore::save(const RunCheckpoint& checkpoint) const {
+    const std::vector<uint8_t> data = encode(checkpoint);
+    const std::string target = path(checkpoint.entity_id, checkpoint.scenario_id);
+    const std::string tmp = target + ".tmp";
+
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            throw std::runtime_error("CheckpointStore: can't write " + tmp);
+        }
+    }
+    fs::rename(tmp, target, ec);
+    if (ec) {
+        throw std::runtime_error("CheckpointStore: can't replace " + target + ": " + ec.message());
+    }
+}
+
+std::optional<RunCheckpoint> CheckpointStore::load(const EntityID& entity_id, ScenarioID scenario_id) const {
+    const std::string file = path(entity_id, scenario_id);
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    RunCheckpoint checkpoint = decode(data, file);
+    if (checkpoint.entity_id != entity_id || checkpoint.scenario_id != scenario_id) {
+        throw std::runtime_error("CheckpointStore: " + file + " belongs to another run");
+    }
+    return checkpoint;
+}
+
+void CheckpointStore::remove(const EntityID& entity_id, ScenarioID scenario_id) const {
+    std::error_code ec;
+    fs::remove(path(entity_id, scenario_id), ec);
+}
+
+void CheckpointStore::clear() const {
+    std::error_code ec;
+    fs::remove_all(dir_, ec);
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,321 @@
+/**
+ * @file run_estimate.cpp
+ * @brief Run cost estimates from plan statistics, run size and calibrated costs
+ */
+
+#include "orchestration/run_estimate.h"
+#include "database/database_factory.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+namespace {
+
+size_t ceil_div(size_t a, size_t b) {
+    return (a + b - 1) / b;
+}
+
+/**
+ * @brief cpu_time of a benchmark entry in nanoseconds
+ */
+double benchmark_ns(const json& entry) {
+    const double time = entry.at("cpu_time").get<double>();
+    const std::string unit = entry.value("time_unit", "ns");
+    if (unit == "us") return time * 1e3;
+    if (unit == "ms") return time * 1e6;
+    if (unit == "s") return time * 1e9;
+    return time;
+}
+
+/**
+ * @brief First benchmark entry whose name starts with prefix (null if none)
+ */
+const json* find_benchmark(const json& benchmarks, const std::string& prefix) {
+    for (const auto& entry : benchmarks) {
+        const std::string name = entry.value("name", "");
+        if (name.compare(0, prefix.size(), prefix) == 0 && entry.value("run_type", "iteration") == "iteration") {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+std::string format_bytes(size_t bytes) {
+    static const char* const UNITS[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < std::size(UNITS)) {
+        value /= 1024.0;
+        ++unit;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << " " << UNITS[unit];
+    return out.str();
+}
+
+std::string format_seconds(double seconds) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (seconds < 120.0) {
+        out << seconds << " s";
+    } else if (seconds < 7200.0) {
+        out << seconds / 60.0 << " min";
+    } else {
+        out << seconds / 3600.0 << " h";
+    }
+    return out.str();
+}
+
+} // namespace
+
+// ============================================================================
+// CostCalibration
+// ============================================================================
+
+CostCalibration CostCalibration::from_json(const std::string& text) {
+    CostCalibration c;
+    try {
+        const json j = json::parse(text);
+        if (j.contains("benchmarks")) {
+            const json& benchmarks = j.at("benchmarks");
+            if (const json* bound = find_benchmark(benchmarks, "BM_FormulaEvaluator_EvaluateBound/1")) {
+                c.instruction_ns = benchmark_ns(*bound) / 9.0;
+            }
+            const json* run = find_benchmark(benchmarks, "BM_PeriodRunner_RunPeriods/1000/20");
+            if (!run) {
+                run = find_benchmark(benchmarks, "BM_PeriodRunner_RunPeriods/");
+            }
+            if (run && run->value("items_per_second", 0.0) > 0.0) {
+                // The workload's formulas are about the size of the arithmetic benchmark's
+                c.line_item_ns = std::max(0.0, 1e9 / run->at("items_per_second").get<double>() - 9.0 * c.instruction_ns);
+            }
+            if (const json* slot = find_benchmark(benchmarks, "BM_DriverValueProvider_GetSlotValue")) {
+                c.input_ns = benchmark_ns(*slot);
+            }
+            if (const json* prior = find_benchmark(benchmarks, "BM_StatementValueProvider_GetValue/1")) {
+                c.prior_period_read_ns = benchmark_ns(*prior);
+            }
+        } else {
+            c.period_ns = j.value("period_ns", c.period_ns);
+            c.line_item_ns = j.value("line_item_ns", c.line_item_ns);
+            c.instruction_ns = j.value("instruction_ns", c.instruction_ns);
+            c.input_ns = j.value("input_ns", c.input_ns);
+            c.prior_period_read_ns = j.value("prior_period_read_ns", c.prior_period_read_ns);
+            c.history_read_ns = j.value("history_read_ns", c.history_read_ns);
+            c.lane_line_item_ns = j.value("lane_line_item_ns", c.lane_line_item_ns);
+            c.lane_instruction_ns = j.value("lane_instruction_ns", c.lane_instruction_ns);
+            c.lane_interpreter_instruction_ns =
+                j.value("lane_interpreter_instruction_ns", c.lane_interpreter_instruction_ns);
+            c.lanes = j.value("lanes", c.lanes);
+            c.node_startup_s = j.value("node_startup_s", c.node_startup_s);
+            c.shard_s = j.value("shard_s", c.shard_s);
+            c.scenarios_per_shard = j.value("scenarios_per_shard", c.scenarios_per_shard);
+            c.process_bytes = j.value("process_bytes", c.process_bytes);
+            c.line_item_bytes = j.value("line_item_bytes", c.line_item_bytes);
+            c.result_value_bytes = j.value("result_value_bytes", c.result_value_bytes);
+            c.database_row_bytes = j.value("database_row_bytes", c.database_row_bytes);
+        }
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("Cost calibration: ") + e.what());
+    }
+
+    for (double cost : {c.period_ns, c.line_item_ns, c.instruction_ns, c.input_ns, c.prior_period_read_ns,
+                        c.history_read_ns, c.lane_line_item_ns, c.lane_instruction_ns,
+                        c.lane_interpreter_instruction_ns, c.node_startup_s, c.shard_s}) {
+        if (!(cost >= 0.0)) {
+            throw std::invalid_argument("Cost calibration: costs must not be negative");
+        }
+    }
+    if (c.lanes == 0 || c.scenarios_per_shard == 0) {
+        throw std::invalid_argument("Cost calibration: lanes and scenarios_per_shard must be at least 1");
+    }
+    return c;
+}
+
+CostCalibration CostCalibration::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::invalid_argument("Cost calibration: can't read " + path);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return from_json(text.str());
+}
+
+// ============================================================================
+// RunEstimate
+// ============================================================================
+
+const char* to_string(EstimateBackend backend) {
+    switch (backend) {
+        case EstimateBackend::SCALAR: return "scalar";
+        case EstimateBackend::LANES: return "lanes";
+        case EstimateBackend::DISTRIBUTED: return "distributed";
+    }
+    return "unknown";
+}
+
+std::string RunEstimate::report() const {
+    std::ostringstream out;
+    out << "Plan:        " << plan.line_items() << " line items (" << plan.formulas << " formulas, "
+        << plan.instructions << " instructions), " << plan.inputs << " inputs ("
+        << plan.prior_period_reads << " at [t-1], " << plan.history_reads << " history)\n"
+        << "             " << plan.levels << " levels (widest " << plan.widest_level << "), "
+        << plan.circular_blocks << " circular blocks"
+        << (plan.kernel_eligible ? ", kernel eligible" : "") << "\n"
+        << "Runs:        " << runs << "\n"
+        << "Periods:     " << periods << "\n"
+        << "Stored:      " << stored_line_items << " line items per period, " << format_bytes(output_bytes) << "\n";
+    for (const auto& backend : backends) {
+        std::string name = to_string(backend.backend);
+        name.resize(12, ' ');
+        out << name << " " << format_seconds(backend.wall_seconds) << " on " << backend.workers << " workers ("
+            << format_seconds(backend.cpu_seconds) << " CPU), peak " << format_bytes(backend.peak_memory_bytes)
+            << "\n";
+    }
+    return out.str();
+}
+
+std::string RunEstimate::to_json() const {
+    json j = {{"plan", {{"line_items", plan.line_items()},
+                        {"formulas", plan.formulas},
+                        {"instructions", plan.instructions},
+                        {"function_calls", plan.function_calls},
+                        {"inputs", plan.inputs},
+                        {"prior_period_reads", plan.prior_period_reads},
+                        {"history_reads", plan.history_reads},
+                        {"levels", plan.levels},
+                        {"widest_level", plan.widest_level},
+                        {"circular_blocks", plan.circular_blocks},
+                        {"kernel_eligible", plan.kernel_eligible}}},
+              {"runs", runs},
+              {"periods", periods},
+              {"stored_line_items", stored_line_items},
+              {"output_bytes", output_bytes},
+              {"backends", json::array()}};
+    for (const auto& backend : backends) {
+        j["backends"].push_back({{"backend", to_string(backend.backend)},
+                                 {"workers", backend.workers},
+                                 {"cpu_seconds", backend.cpu_seconds},
+                                 {"wall_seconds", backend.wall_seconds},
+                                 {"peak_memory_bytes", backend.peak_memory_bytes}});
+    }
+    return j.dump();
+}
+
+// ============================================================================
+// RunEstimator
+// ============================================================================
+
+RunEstimate RunEstimator::estimate(const unified::PlanStatistics& plan, const RunManifest& manifest,
+                                   const CostCalibration& c, size_t nodes) {
+    if (nodes == 0) {
+        throw std::invalid_argument("RunEstimator: nodes must be at least 1");
+    }
+    const size_t entities = manifest.entities.size();
+    const size_t scenarios = manifest.scenario_ids.size();
+    const size_t periods_per_run = manifest.period_ids.size();
+    const size_t threads = manifest.threads > 0 ? manifest.threads
+                                                : std::max(1u, std::thread::hardware_concurrency());
+
+    RunEstimate estimate;
+    estimate.plan = plan;
+    estimate.runs = entities * scenarios;
+    estimate.periods = estimate.runs * periods_per_run;
+
+    // What the output stores
+    std::vector<std::string> stored = manifest.outputs.empty() ? plan.codes : manifest.outputs;
+    estimate.stored_line_items = stored.size();
+    const size_t rows = scenarios * periods_per_run * entities;
+    switch (manifest.output) {
+        case BatchOutput::NONE:
+            break;
+        case BatchOutput::COLUMNAR:
+        case BatchOutput::DELTA: {
+            // (scenario, period) keys, then one value per stored line item
+            size_t row_bytes = 8;
+            for (const auto& code : stored) {
+                row_bytes += manifest.precision.is_float32(code) ? 4 : 8;
+            }
+            estimate.output_bytes = rows * row_bytes;
+            break;
+        }
+        case BatchOutput::DATABASE:
+            estimate.output_bytes = rows * stored.size() * c.database_row_bytes;
+            break;
+    }
+
+    // Results of a chunk are held until it is written
+    const size_t held_bytes = manifest.output == BatchOutput::NONE
+        ? 0 : std::min(manifest.jobs_per_chunk, estimate.runs) * periods_per_run * stored.size() * c.result_value_bytes;
+    const size_t worker_bytes = plan.line_items() * c.line_item_bytes + plan.state_size * sizeof(double);
+    const double history_ns = static_cast<double>(plan.history_reads) * c.history_read_ns;
+
+    // SCALAR: one run per job, jobs spread over the threads
+    const double run_ns = static_cast<double>(periods_per_run) *
+        (c.period_ns + static_cast<double>(plan.line_items()) * c.line_item_ns +
+         static_cast<double>(plan.instructions) * c.instruction_ns +
+         static_cast<double>(plan.inputs) * c.input_ns +
+         static_cast<double>(plan.prior_period_reads) * c.prior_period_read_ns + history_ns);
+    BackendEstimate scalar;
+    scalar.backend = EstimateBackend::SCALAR;
+    scalar.workers = std::min(threads, estimate.runs);
+    scalar.cpu_seconds = static_cast<double>(estimate.runs) * run_ns * 1e-9;
+    scalar.wall_seconds = static_cast<double>(ceil_div(estimate.runs, scalar.workers)) * run_ns * 1e-9;
+    scalar.peak_memory_bytes = c.process_bytes + scalar.workers * worker_bytes + held_bytes;
+    estimate.backends.push_back(scalar);
+
+    // LANES: an entity's scenarios in batches of lanes, one batch per job
+    const size_t lanes = std::min(c.lanes, scenarios);
+    const size_t batches = entities * ceil_div(scenarios, lanes);
+    const double lane_instruction_ns = plan.kernel_eligible ? c.lane_instruction_ns
+                                                            : c.lane_interpreter_instruction_ns;
+    const double batch_ns = static_cast<double>(periods_per_run) *
+        (c.period_ns + static_cast<double>(lanes) *
+             (static_cast<double>(plan.line_items()) * c.lane_line_item_ns +
+              static_cast<double>(plan.instructions) * lane_instruction_ns +
+              static_cast<double>(plan.inputs) * c.input_ns + history_ns));
+    BackendEstimate lane;
+    lane.backend = EstimateBackend::LANES;
+    lane.workers = std::min(threads, batches);
+    lane.cpu_seconds = static_cast<double>(batches) * batch_ns * 1e-9;
+    lane.wall_seconds = static_cast<double>(ceil_div(batches, lane.workers)) * batch_ns * 1e-9;
+    lane.peak_memory_bytes = c.process_bytes + lane.workers * lanes * worker_bytes + held_bytes;
+    estimate.backends.push_back(lane);
+
+    // DISTRIBUTED: shards of an entity's scenarios, each a scalar run on some node's worker
+    const size_t shard_scenarios = std::min(c.scenarios_per_shard, scenarios);
+    const size_t shards = entities * ceil_div(scenarios, shard_scenarios);
+    const double shard_seconds = c.shard_s + static_cast<double>(shard_scenarios) * run_ns * 1e-9;
+    BackendEstimate distributed;
+    distributed.backend = EstimateBackend::DISTRIBUTED;
+    distributed.workers = std::min(nodes * threads, shards);
+    distributed.cpu_seconds = static_cast<double>(shards) * shard_seconds +
+                              static_cast<double>(distributed.workers) * c.node_startup_s;
+    distributed.wall_seconds = c.node_startup_s +
+                               static_cast<double>(ceil_div(shards, distributed.workers)) * shard_seconds;
+    distributed.peak_memory_bytes = c.process_bytes + std::min(threads, shards) * worker_bytes +
+        (manifest.output == BatchOutput::NONE ? 0 : shard_scenarios * periods_per_run * stored.size() * c.result_value_bytes);
+    estimate.backends.push_back(distributed);
+    return estimate;
+}
+
+RunEstimate RunEstimator::estimate(const RunManifest& manifest, const CostCalibration& calibration, size_t nodes) {
+    unified::UnifiedEngine engine(database::DatabaseFactory::create_sqlite(manifest.database));
+    if (!manifest.outputs.empty()) {
+        engine.set_output_selection(manifest.outputs);
+    }
+    return estimate(engine.plan_statistics(manifest.template_code), manifest, calibration, nodes);
+}
+
+} // namespace orchestration
+} // namespace finmodel
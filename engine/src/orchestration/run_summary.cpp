@@ -0,0 +1,155 @@
+/**
+ * @file run_summary.cpp
+ * @brief Summary measures folded period by period
+ */
+
+#include "orchestration/run_summary.h"
+#include <cmath>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+SummaryAggregate aggregate_from_string(const std::string& name, const std::string& text) {
+    if (name == "final") return SummaryAggregate::FINAL;
+    if (name == "sum") return SummaryAggregate::SUM;
+    if (name == "min") return SummaryAggregate::MIN;
+    if (name == "max") return SummaryAggregate::MAX;
+    if (name == "mean") return SummaryAggregate::MEAN;
+    if (name == "below") return SummaryAggregate::BELOW;
+    if (name == "above") return SummaryAggregate::ABOVE;
+    throw std::invalid_argument("Summary measure '" + text + "': unknown aggregate '" + name + "'");
+}
+
+} // namespace
+
+SummaryMeasure SummaryMeasure::parse(const std::string& text) {
+    SummaryMeasure measure;
+    std::string rest = text;
+    const size_t equals = rest.find('=');
+    if (equals != std::string::npos) {
+        measure.name = rest.substr(0, equals);
+        rest = rest.substr(equals + 1);
+    }
+
+    const size_t colon = rest.find(':');
+    if (colon == std::string::npos) {
+        throw std::invalid_argument("Summary measure '" + text + "': expected aggregate:LINE_ITEM");
+    }
+    const std::string aggregate = rest.substr(0, colon);
+    measure.aggregate = aggregate_from_string(aggregate, text);
+    measure.line_item = rest.substr(colon + 1);
+
+    const bool thresholded = measure.aggregate == SummaryAggregate::BELOW ||
+                             measure.aggregate == SummaryAggregate::ABOVE;
+    const size_t second = measure.line_item.find(':');
+    if (thresholded != (second != std::string::npos)) {
+        throw std::invalid_argument("Summary measure '" + text + "': " +
+                                    (thresholded ? "below and above need a threshold"
+                                                 : "only below and above take a threshold"));
+    }
+    if (thresholded) {
+        const std::string threshold = measure.line_item.substr(second + 1);
+        measure.line_item = measure.line_item.substr(0, second);
+        size_t used = 0;
+        try {
+            measure.threshold = std::stod(threshold, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != threshold.size()) {
+            throw std::invalid_argument("Summary measure '" + text + "': threshold '" + threshold + "' isn't a number");
+        }
+    }
+    if (measure.line_item.empty()) {
+        throw std::invalid_argument("Summary measure '" + text + "': no line item");
+    }
+    if (measure.name.empty()) {
+        measure.name = aggregate + "_" + measure.line_item;
+    }
+    return measure;
+}
+
+RunSummarySpec RunSummarySpec::parse(const std::vector<std::string>& measures) {
+    RunSummarySpec spec;
+    std::set<std::string> names;
+    for (const auto& text : measures) {
+        spec.measures.push_back(SummaryMeasure::parse(text));
+        if (!names.insert(spec.measures.back().name).second) {
+            throw std::invalid_argument("Summary measure '" + spec.measures.back().name + "' defined twice");
+        }
+    }
+    return spec;
+}
+
+RunSummary::RunSummary(std::shared_ptr<const RunSummarySpec> spec)
+    : spec_(std::move(spec)), states_(spec_ ? spec_->measures.size() : 0) {
+    if (!spec_) {
+        throw std::invalid_argument("RunSummary: null spec");
+    }
+}
+
+void RunSummary::add(const unified::ResultRow& values) {
+    ++periods_;
+    if (values.schema() != schema_) {
+        schema_ = values.schema();
+        positions_.clear();
+        for (const auto& measure : spec_->measures) {
+            positions_.push_back(schema_ ? schema_->find(measure.line_item) : unified::ResultSchema::NO_INDEX);
+        }
+    }
+
+    const auto& row = values.values();
+    const auto& measures = spec_->measures;
+    for (size_t i = 0; i < measures.size(); ++i) {
+        if (positions_[i] == unified::ResultSchema::NO_INDEX || positions_[i] >= row.size()) {
+            continue;
+        }
+        const double value = row[positions_[i]];
+        if (!std::isfinite(value)) {
+            continue;
+        }
+        State& state = states_[i];
+        switch (measures[i].aggregate) {
+            case SummaryAggregate::FINAL: state.value = value; break;
+            case SummaryAggregate::SUM:
+            case SummaryAggregate::MEAN: state.value += value; break;
+            case SummaryAggregate::MIN: state.value = state.count == 0 ? value : std::min(state.value, value); break;
+            case SummaryAggregate::MAX: state.value = state.count == 0 ? value : std::max(state.value, value); break;
+            case SummaryAggregate::BELOW: state.value += value < measures[i].threshold ? 1.0 : 0.0; break;
+            case SummaryAggregate::ABOVE: state.value += value > measures[i].threshold ? 1.0 : 0.0; break;
+        }
+        ++state.count;
+    }
+}
+
+double RunSummary::value(size_t measure) const {
+    const State& state = states_.at(measure);
+    if (state.count == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return spec_->measures[measure].aggregate == SummaryAggregate::MEAN
+        ? state.value / static_cast<double>(state.count)
+        : state.value;
+}
+
+std::string RunSummary::to_json() const {
+    nlohmann::json j = nlohmann::json::object();
+    for (size_t i = 0; i < states_.size(); ++i) {
+        const double v = value(i);
+        if (std::isnan(v)) {
+            j[spec_->measures[i].name] = nullptr;
+        } else {
+            j[spec_->measures[i].name] = v;
+        }
+    }
+    return j.dump();
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,279 @@
+/**
+ * @file scenario_diff.cpp
+ * @brief Column differences of stored scenario results and their top-k ranking
+ */
+
+#include "orchestration/scenario_diff.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+namespace {
+
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+/// out = values - base, element by element (NaN where either is NaN)
+void subtract(const double* values, const double* base, double* out, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = values[i] - base[i];
+    }
+}
+
+std::vector<PeriodID> sorted_periods(std::vector<PeriodID> period_ids) {
+    std::sort(period_ids.begin(), period_ids.end());
+    period_ids.erase(std::unique(period_ids.begin(), period_ids.end()), period_ids.end());
+    return period_ids;
+}
+
+/**
+ * @brief Rank the cells with the largest |difference| into diff.top
+ * @param value_of Value of (scenario, line item, period) slots
+ */
+template <typename ValueOf>
+void rank(ScenarioDiff& diff, size_t top, ValueOf&& value_of) {
+    if (top == 0) {
+        return;
+    }
+    std::vector<size_t> cells;
+    for (size_t c = 0; c < diff.differences.size(); ++c) {
+        const double d = diff.differences[c];
+        if (d != 0.0 && std::isfinite(d)) {
+            cells.push_back(c);
+        }
+    }
+    // Cells are in (scenario, line item, period) order, which breaks ties
+    auto larger = [&diff](size_t a, size_t b) {
+        const double x = std::abs(diff.differences[a]);
+        const double y = std::abs(diff.differences[b]);
+        return x != y ? x > y : a < b;
+    };
+    const size_t k = std::min(top, cells.size());
+    std::partial_sort(cells.begin(), cells.begin() + static_cast<std::ptrdiff_t>(k), cells.end(), larger);
+
+    const size_t periods = diff.period_ids.size();
+    const size_t items = diff.line_items.size();
+    diff.top.reserve(k);
+    for (size_t n = 0; n < k; ++n) {
+        const size_t c = cells[n];
+        const size_t s = c / (items * periods);
+        const size_t i = c / periods % items;
+        const size_t p = c % periods;
+        diff.top.push_back({diff.scenario_ids[s], diff.line_items[i], diff.period_ids[p], diff.base_of(i, p),
+                            value_of(s, i, p), diff.differences[c]});
+    }
+}
+
+} // namespace
+
+std::string ScenarioDiff::to_json(bool with_differences) const {
+    json j = {{"base_id", base_id}, {"scenario_ids", scenario_ids}, {"line_items", line_items},
+              {"period_ids", period_ids}};
+    if (with_differences) {
+        const size_t periods = period_ids.size();
+        json base_items = json::array();
+        for (size_t i = 0; i < line_items.size(); ++i) {
+            base_items.push_back(std::vector<double>(base.begin() + i * periods, base.begin() + (i + 1) * periods));
+        }
+        json scenarios = json::array();
+        for (size_t s = 0; s < scenario_ids.size(); ++s) {
+            json items = json::array();
+            for (size_t i = 0; i < line_items.size(); ++i) {
+                const auto first = differences.begin() + (s * line_items.size() + i) * periods;
+                items.push_back(std::vector<double>(first, first + periods));
+            }
+            scenarios.push_back(std::move(items));
+        }
+        j["base"] = std::move(base_items);
+        j["differences"] = std::move(scenarios);
+    }
+    json cells = json::array();
+    for (const auto& cell : top) {
+        cells.push_back({{"scenario_id", cell.scenario_id}, {"line_item", cell.line_item},
+                         {"period_id", cell.period_id}, {"base", cell.base}, {"value", cell.value},
+                         {"difference", cell.difference}});
+    }
+    j["top"] = std::move(cells);
+    return j.dump();
+}
+
+ScenarioDiff ScenarioDiffer::diff(const ColumnarResultReader& reader, const ScenarioDiffQuery& query) {
+    ScenarioDiff out;
+    out.base_id = query.base_id;
+    out.line_items = query.line_items.empty() ? reader.line_items() : query.line_items;
+    for (const auto& code : out.line_items) {
+        reader.is_float32(code);   // Throws for an unknown line item
+    }
+    const size_t items = out.line_items.size();
+    const std::unordered_set<ScenarioID> listed(query.scenario_ids.begin(), query.scenario_ids.end());
+    const std::unordered_set<PeriodID> wanted(query.period_ids.begin(), query.period_ids.end());
+
+    // Rows of the base and the compared scenarios in the requested periods
+    std::vector<ScenarioID> row_scenarios;
+    std::vector<PeriodID> row_periods;
+    std::vector<std::vector<double>> columns(items);
+    for (size_t g = 0; g < reader.row_group_count(); ++g) {
+        const ColumnarBlock block = reader.read_group(g, out.line_items);
+        for (size_t r = 0; r < block.size(); ++r) {
+            const ScenarioID scenario = block.scenario_ids[r];
+            if ((!listed.empty() && scenario != query.base_id && !listed.count(scenario)) ||
+                (!wanted.empty() && !wanted.count(block.period_ids[r]))) {
+                continue;
+            }
+            row_scenarios.push_back(scenario);
+            row_periods.push_back(block.period_ids[r]);
+            for (size_t i = 0; i < items; ++i) {
+                columns[i].push_back(block.columns[i][r]);
+            }
+        }
+    }
+
+    // Slots: compared scenarios, then the base
+    std::unordered_set<ScenarioID> present(row_scenarios.begin(), row_scenarios.end());
+    if (!present.count(query.base_id)) {
+        throw std::out_of_range("ScenarioDiffer: no scenario " + std::to_string(query.base_id));
+    }
+    if (query.scenario_ids.empty()) {
+        out.scenario_ids.assign(present.begin(), present.end());
+        out.scenario_ids.erase(std::remove(out.scenario_ids.begin(), out.scenario_ids.end(), query.base_id),
+                               out.scenario_ids.end());
+        std::sort(out.scenario_ids.begin(), out.scenario_ids.end());
+    } else {
+        out.scenario_ids = query.scenario_ids;
+        for (ScenarioID scenario : out.scenario_ids) {
+            if (!present.count(scenario)) {
+                throw std::out_of_range("ScenarioDiffer: no scenario " + std::to_string(scenario));
+            }
+        }
+    }
+    out.period_ids = sorted_periods(query.period_ids.empty() ? row_periods : query.period_ids);
+
+    const size_t compared = out.scenario_ids.size();
+    const size_t periods = out.period_ids.size();
+    std::unordered_map<ScenarioID, std::vector<size_t>> slots_of;   // A scenario may be listed twice
+    for (size_t s = 0; s < compared; ++s) {
+        slots_of[out.scenario_ids[s]].push_back(s);
+    }
+    slots_of[query.base_id].push_back(compared);
+    std::unordered_map<PeriodID, size_t> period_slot;
+    for (size_t p = 0; p < periods; ++p) {
+        period_slot.emplace(out.period_ids[p], p);
+    }
+
+    // Dense columns per (slot, line item), then one subtraction per column
+    const size_t slot_cells = items * periods;
+    std::vector<double> values((compared + 1) * slot_cells, NaN);
+    for (size_t r = 0; r < row_scenarios.size(); ++r) {
+        const auto slots = slots_of.find(row_scenarios[r]);
+        const auto p = period_slot.find(row_periods[r]);
+        if (slots == slots_of.end() || p == period_slot.end()) {
+            continue;
+        }
+        for (size_t s : slots->second) {
+            double* cells = values.data() + s * slot_cells + p->second;
+            for (size_t i = 0; i < items; ++i) {
+                cells[i * periods] = columns[i][r];
+            }
+        }
+    }
+    const double* base = values.data() + compared * slot_cells;
+    out.base.assign(base, base + slot_cells);
+    out.differences.resize(compared * slot_cells);
+    for (size_t s = 0; s < compared; ++s) {
+        subtract(values.data() + s * slot_cells, base, out.differences.data() + s * slot_cells, slot_cells);
+    }
+
+    rank(out, query.top, [&](size_t s, size_t i, size_t p) { return values[s * slot_cells + i * periods + p]; });
+    return out;
+}
+
+ScenarioDiff ScenarioDiffer::diff(const DeltaResultSet& set, const ScenarioDiffQuery& query) {
+    ScenarioDiff out;
+    out.base_id = query.base_id;
+    out.line_items = query.line_items.empty() ? set.line_items() : query.line_items;
+    out.period_ids = query.period_ids.empty() ? set.period_ids() : sorted_periods(query.period_ids);
+    if (query.scenario_ids.empty()) {
+        if (set.baseline_id() != query.base_id) {
+            out.scenario_ids.push_back(set.baseline_id());
+        }
+        for (ScenarioID variant : set.variant_ids()) {
+            if (variant != query.base_id) {
+                out.scenario_ids.push_back(variant);
+            }
+        }
+    } else {
+        out.scenario_ids = query.scenario_ids;
+    }
+
+    const size_t items = out.line_items.size();
+    const size_t periods = out.period_ids.size();
+    const size_t slot_cells = items * periods;
+    std::unordered_map<std::string, size_t> item_slot;
+    for (size_t i = 0; i < items; ++i) {
+        item_slot.emplace(out.line_items[i], i);
+    }
+    std::unordered_map<PeriodID, size_t> period_slot;
+    for (size_t p = 0; p < periods; ++p) {
+        period_slot.emplace(out.period_ids[p], p);
+    }
+    auto cell_of = [&](const ResultDelta& delta) -> long {
+        const auto i = item_slot.find(delta.code);
+        const auto p = period_slot.find(delta.period_id);
+        return i == item_slot.end() || p == period_slot.end() ? -1 : static_cast<long>(i->second * periods + p->second);
+    };
+
+    // Unchanged cells are the baseline minus itself: 0, or NaN without a value
+    std::vector<double> baseline(slot_cells);
+    for (size_t i = 0; i < items; ++i) {
+        for (size_t p = 0; p < periods; ++p) {
+            baseline[i * periods + p] = set.value(set.baseline_id(), out.line_items[i], out.period_ids[p]);
+        }
+    }
+    std::vector<double> unchanged(slot_cells);
+    subtract(baseline.data(), baseline.data(), unchanged.data(), slot_cells);
+
+    const std::vector<ResultDelta> base_changes = set.changes(query.base_id);
+    out.base = baseline;
+    for (const auto& delta : base_changes) {
+        const long c = cell_of(delta);
+        if (c >= 0) {
+            out.base[static_cast<size_t>(c)] = delta.value;
+        }
+    }
+
+    // Cells the base changed: the compared run has the baseline's value
+    // there unless it changed them too
+    out.differences.resize(out.scenario_ids.size() * slot_cells);
+    for (size_t s = 0; s < out.scenario_ids.size(); ++s) {
+        double* row = out.differences.data() + s * slot_cells;
+        std::copy(unchanged.begin(), unchanged.end(), row);
+        for (const auto& delta : base_changes) {
+            const long c = cell_of(delta);
+            if (c >= 0) {
+                row[c] = delta.baseline - delta.value;
+            }
+        }
+        for (const auto& delta : set.changes(out.scenario_ids[s])) {
+            const long c = cell_of(delta);
+            if (c >= 0) {
+                row[c] = delta.value - out.base[static_cast<size_t>(c)];
+            }
+        }
+    }
+
+    rank(out, query.top, [&](size_t s, size_t i, size_t p) {
+        return set.value(out.scenario_ids[s], out.line_items[i], out.period_ids[p]);
+    });
+    return out;
+}
+
+} // namespace orchestration
+} // namespace finmodel
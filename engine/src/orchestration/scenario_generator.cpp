@@ -4,57 +4,127 @@
  */
 
 #include "orchestration/scenario_generator.h"
+#include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <stdexcept>
 
 namespace finmodel {
 namespace orchestration {
 
-std::vector<ScenarioConfig> ScenarioGenerator::generate_all_combinations(
-    const std::vector<std::string>& action_codes,
-    int base_scenario_id,
-    const std::string& base_code_prefix
-) {
-    std::vector<ScenarioConfig> scenarios;
-    int n = action_codes.size();
-    int num_combinations = 1 << n;  // 2^n
+CombinationRange::CombinationRange(std::vector<std::string> action_codes,
+                                   int base_scenario_id,
+                                   std::string base_code_prefix,
+                                   CombinationOrder order)
+    : action_codes_(std::move(action_codes))
+    , base_scenario_id_(base_scenario_id)
+    , base_code_prefix_(std::move(base_code_prefix))
+    , order_(order)
+{
+    if (action_codes_.size() > MAX_ACTIONS) {
+        throw std::invalid_argument("CombinationRange: " + std::to_string(action_codes_.size()) +
+                                    " actions, at most " + std::to_string(MAX_ACTIONS) + " can be combined");
+    }
+    count_ = uint64_t{1} << action_codes_.size();
+}
 
-    for (int i = 0; i < num_combinations; i++) {
-        ScenarioConfig config;
-        config.scenario_id = base_scenario_id + i;
-
-        // Build active actions list based on bit pattern
-        std::vector<std::string> active_actions;
-        for (int j = 0; j < n; j++) {
-            bool is_active = (i & (1 << j)) != 0;
-            config.action_flags[action_codes[j]] = is_active;
-            if (is_active) {
-                active_actions.push_back(action_codes[j]);
-            }
+size_t CombinationRange::toggled_action(size_t index) {
+    // Gray codes of index - 1 and index differ in the lowest set bit of index
+    size_t action = 0;
+    while (index > 1 && !(index & 1)) {
+        index >>= 1;
+        ++action;
+    }
+    return action;
+}
+
+std::vector<ScenarioMask> CombinationRange::chunk(size_t first, size_t count) const {
+    std::vector<ScenarioMask> masks;
+    if (first >= count_) {
+        return masks;
+    }
+    const uint64_t last = std::min<uint64_t>(count_, first + std::min<uint64_t>(count, count_ - first));
+    masks.reserve(last - first);
+    for (auto it = begin() + first, stop = begin() + last; it != stop; ++it) {
+        masks.push_back(*it);
+    }
+    return masks;
+}
+
+bool CombinationRange::is_active(const ScenarioMask& mask, const std::string& action_code) const {
+    for (size_t j = 0; j < action_codes_.size(); j++) {
+        if (action_codes_[j] == action_code) {
+            return (mask.actions & (uint64_t{1} << j)) != 0;
         }
+    }
+    return false;
+}
 
-        // Generate name and description
-        config.name = generate_name(active_actions);
-        config.description = generate_description(active_actions);
-
-        // Generate code
-        if (active_actions.empty()) {
-            config.code = base_code_prefix + "_BASE";
-        } else {
-            config.code = base_code_prefix + "_" + config.name;
-            // Replace + with _ for valid code
-            for (char& c : config.code) {
-                if (c == '+') c = '_';
-                if (c == ' ') c = '_';
-            }
+std::vector<std::string> CombinationRange::active_actions(const ScenarioMask& mask) const {
+    std::vector<std::string> active;
+    for (size_t j = 0; j < action_codes_.size(); j++) {
+        if (mask.actions & (uint64_t{1} << j)) {
+            active.push_back(action_codes_[j]);
         }
+    }
+    return active;
+}
 
-        scenarios.push_back(config);
+ScenarioConfig CombinationRange::config(const ScenarioMask& mask) const {
+    ScenarioConfig config;
+    config.scenario_id = mask.scenario_id;
+
+    // Build active actions list based on bit pattern
+    std::vector<std::string> active_actions;
+    for (size_t j = 0; j < action_codes_.size(); j++) {
+        bool is_active = (mask.actions & (uint64_t{1} << j)) != 0;
+        config.action_flags[action_codes_[j]] = is_active;
+        if (is_active) {
+            active_actions.push_back(action_codes_[j]);
+        }
     }
 
+    // Generate name and description
+    config.name = ScenarioGenerator::generate_name(active_actions);
+    config.description = ScenarioGenerator::generate_description(active_actions);
+
+    // Generate code
+    if (active_actions.empty()) {
+        config.code = base_code_prefix_ + "_BASE";
+    } else {
+        config.code = base_code_prefix_ + "_" + config.name;
+        // Replace + with _ for valid code
+        for (char& c : config.code) {
+            if (c == '+') c = '_';
+            if (c == ' ') c = '_';
+        }
+    }
+    return config;
+}
+
+std::vector<ScenarioConfig> ScenarioGenerator::generate_all_combinations(
+    const std::vector<std::string>& action_codes,
+    int base_scenario_id,
+    const std::string& base_code_prefix
+) {
+    const CombinationRange range(action_codes, base_scenario_id, base_code_prefix);
+    std::vector<ScenarioConfig> scenarios;
+    scenarios.reserve(range.size());
+    for (const ScenarioMask& mask : range) {
+        scenarios.push_back(range.config(mask));
+    }
     return scenarios;
 }
 
+CombinationRange ScenarioGenerator::combinations(
+    const std::vector<std::string>& action_codes,
+    int base_scenario_id,
+    const std::string& base_code_prefix,
+    CombinationOrder order
+) {
+    return CombinationRange(action_codes, base_scenario_id, base_code_prefix, order);
+}
+
 bool ScenarioGenerator::is_action_active(const ScenarioConfig& config, const std::string& action_code) {
     auto it = config.action_flags.find(action_code);
     if (it != config.action_flags.end()) {
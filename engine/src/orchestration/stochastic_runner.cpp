@@ -0,0 +1,1129 @@
+#include "orchestration/stochastic_runner.h"
+#include "core/philox_stream.h"
+#include "core/low_discrepancy.h"
+#include "core/statement_template.h"
+#include "core/formula_evaluator.h"
+#include "core/lane_evaluator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Sums over the paths and batches of one period for the control variates
+struct PeriodMoments {
+    size_t paths = 0;
+    size_t batches = 0;
+    std::vector<double> sum;              // Σ control
+    std::vector<double> squares;          // Σ control × control (controls × controls)
+    std::vector<double> batch_sum;        // Σ batch mean control
+    std::vector<double> batch_squares;
+
+    explicit PeriodMoments(size_t controls)
+        : sum(controls), squares(controls * controls), batch_sum(controls), batch_squares(controls * controls) {}
+
+    void add(const PeriodMoments& other) {
+        paths += other.paths;
+        batches += other.batches;
+        for (size_t i = 0; i < sum.size(); ++i) {
+            sum[i] += other.sum[i];
+            batch_sum[i] += other.batch_sum[i];
+        }
+        for (size_t i = 0; i < squares.size(); ++i) {
+            squares[i] += other.squares[i];
+            batch_squares[i] += other.batch_squares[i];
+        }
+    }
+};
+
+// Sums for one line item and period; values less the baseline, so that
+// squares don't cancel
+struct ItemMoments {
+    double batch_sum = 0.0;               // Σ batch mean
+    double batch_squares = 0.0;
+    std::vector<double> cross;            // Σ control × value
+    std::vector<double> batch_cross;      // Σ batch mean control × batch mean
+
+    explicit ItemMoments(size_t controls) : cross(controls), batch_cross(controls) {}
+
+    void add(const ItemMoments& other) {
+        batch_sum += other.batch_sum;
+        batch_squares += other.batch_squares;
+        for (size_t c = 0; c < cross.size(); ++c) {
+            cross[c] += other.cross[c];
+            batch_cross[c] += other.batch_cross[c];
+        }
+    }
+};
+
+struct Estimate {
+    double mean = 0.0;
+    double standard_error = 0.0;
+};
+
+// Solution of a x = b for a symmetric positive semi-definite a (LDLᵀ);
+// directions without variance of their own (a constant or duplicated
+// control) get a zero coefficient
+std::vector<double> solve_regression(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t m = b.size();
+    std::vector<double> lower(m * m, 0.0);
+    std::vector<double> diagonal(m, 0.0);
+    for (size_t j = 0; j < m; ++j) {
+        double d = a[j * m + j];
+        for (size_t k = 0; k < j; ++k) {
+            d -= lower[j * m + k] * lower[j * m + k] * diagonal[k];
+        }
+        if (!(d > 1e-10 * a[j * m + j])) {
+            continue;
+        }
+        diagonal[j] = d;
+        lower[j * m + j] = 1.0;
+        for (size_t i = j + 1; i < m; ++i) {
+            double sum = a[i * m + j];
+            for (size_t k = 0; k < j; ++k) {
+                sum -= lower[i * m + k] * lower[j * m + k] * diagonal[k];
+            }
+            lower[i * m + j] = sum / d;
+        }
+    }
+
+    std::vector<double> x(m, 0.0);
+    for (size_t i = 0; i < m; ++i) {
+        x[i] = b[i];
+        for (size_t k = 0; k < i; ++k) {
+            x[i] -= lower[i * m + k] * x[k];
+        }
+    }
+    for (size_t i = 0; i < m; ++i) {
+        x[i] = diagonal[i] > 0.0 ? x[i] / diagonal[i] : 0.0;
+    }
+    for (size_t i = m; i-- > 0;) {
+        for (size_t k = i + 1; k < m; ++k) {
+            x[i] -= lower[k * m + i] * x[k];
+        }
+    }
+    return x;
+}
+
+// Mean (less the baseline) and its standard error from the batch means;
+// with controls, both adjusted by β = Cov(x, x)⁻¹ Cov(x, y) of the paths
+Estimate estimate(const LineItemDistribution& dist, const ItemMoments& item,
+                  const PeriodMoments& period, double baseline) {
+    const size_t m = item.cross.size();
+    const auto batches = static_cast<double>(period.batches);
+    const double mean = dist.mean() - baseline;
+
+    std::vector<double> beta(m, 0.0);
+    Estimate result{mean, 0.0};
+    if (m > 0 && period.paths > m + 1) {
+        const auto n = static_cast<double>(period.paths);
+        std::vector<double> covariance(m * m);
+        std::vector<double> cross(m);
+        for (size_t c = 0; c < m; ++c) {
+            const double x = period.sum[c] / n;
+            cross[c] = item.cross[c] - n * x * mean;
+            for (size_t d = 0; d < m; ++d) {
+                covariance[c * m + d] = period.squares[c * m + d] - n * x * period.sum[d] / n;
+            }
+        }
+        beta = solve_regression(covariance, cross);
+        for (size_t c = 0; c < m; ++c) {
+            result.mean -= beta[c] * period.sum[c] / n;
+        }
+    }
+
+    if (period.batches > 1) {
+        // Var(ȳ_b - βᵀ x̄_b) over the batches
+        const double y = item.batch_sum / batches;
+        double variance = item.batch_squares - batches * y * y;
+        for (size_t c = 0; c < m; ++c) {
+            const double x = period.batch_sum[c] / batches;
+            variance -= 2.0 * beta[c] * (item.batch_cross[c] - batches * x * y);
+            for (size_t d = 0; d < m; ++d) {
+                const double x_d = period.batch_sum[d] / batches;
+                variance += beta[c] * beta[d] * (period.batch_squares[c * m + d] - batches * x * x_d);
+            }
+        }
+        result.standard_error = std::sqrt(std::max(variance, 0.0) / (batches - 1.0) / batches);
+    }
+    return result;
+}
+
+// Streams of the sensitivity design, apart from the samples' own (stream = sample index)
+constexpr uint64_t STRATA_STREAMS = uint64_t{1} << 62;
+constexpr uint64_t BOOTSTRAP_STREAMS = uint64_t{1} << 63;
+
+// Sums of one output and period over (weighted) base samples, values less a shift
+struct SobolSums {
+    double weight = 0.0;                  // Σ w
+    double a = 0.0;                       // Σ w f(A)
+    double a_squares = 0.0;
+    double b = 0.0;                       // Σ w f(B)
+    double b_squares = 0.0;
+    std::vector<double> first;            // Σ w f(B) (f(AB_i) - f(A))   (Saltelli 2010)
+    std::vector<double> total;            // Σ w (f(A) - f(AB_i))²       (Jansen)
+
+    explicit SobolSums(size_t drivers) : first(drivers), total(drivers) {}
+
+    void add(double w, double fa, double fb, const std::vector<double>& fab) {
+        weight += w;
+        a += w * fa;
+        a_squares += w * fa * fa;
+        b += w * fb;
+        b_squares += w * fb * fb;
+        for (size_t i = 0; i < fab.size(); ++i) {
+            first[i] += w * fb * (fab[i] - fa);
+            total[i] += w * (fa - fab[i]) * (fa - fab[i]);
+        }
+    }
+
+    double mean() const { return (a + b) / (2.0 * weight); }
+
+    double variance() const {
+        const double m = mean();
+        return std::max((a_squares + b_squares) / (2.0 * weight) - m * m, 0.0);
+    }
+
+    double first_order(size_t i) const {
+        const double v = variance();
+        return v > 0.0 ? first[i] / weight / v : 0.0;
+    }
+
+    double total_effect(size_t i) const {
+        const double v = variance();
+        return v > 0.0 ? total[i] / (2.0 * weight) / v : 0.0;
+    }
+};
+
+// Streamed estimates of one output and period, with their bootstrap replicates
+struct OutputSums {
+    bool shifted = false;
+    double shift = 0.0;                   // First f(A), so that squares don't cancel
+    SobolSums sums;
+    std::vector<SobolSums> replicates;
+
+    OutputSums(size_t drivers, size_t bootstrap) : sums(drivers), replicates(bootstrap, SobolSums(drivers)) {}
+};
+
+// Poisson(1) count by inversion
+unsigned poisson_one(core::PhiloxStream& stream) {
+    const double u = stream.uniform();
+    unsigned k = 0;
+    double p = std::exp(-1.0);
+    double cumulative = p;
+    while (u > cumulative && k < 32) {
+        ++k;
+        p /= k;
+        cumulative += p;
+    }
+    return k;
+}
+
+// Percentile interval of replicate estimates
+std::pair<double, double> interval(std::vector<double> values, double confidence) {
+    std::sort(values.begin(), values.end());
+    const double tail = (1.0 - confidence) / 2.0;
+    const auto last = static_cast<double>(values.size() - 1);
+    return {values[static_cast<size_t>(std::floor(tail * last))],
+            values[static_cast<size_t>(std::ceil((1.0 - tail) * last))]};
+}
+
+} // namespace
+
+double LineItemDistribution::relative_error() const {
+    if (standard_error == 0.0) {
+        return 0.0;
+    }
+    return estimate == 0.0 ? std::numeric_limits<double>::infinity() : standard_error / std::abs(estimate);
+}
+
+const LineItemDistribution* StochasticResults::get(const std::string& code, PeriodID period_id) const {
+    auto it = line_items.find(code);
+    if (it == line_items.end()) {
+        return nullptr;
+    }
+    auto period = std::find(period_ids.begin(), period_ids.end(), period_id);
+    if (period == period_ids.end()) {
+        return nullptr;
+    }
+    return &it->second[static_cast<size_t>(period - period_ids.begin())];
+}
+
+const OutputSensitivity* SensitivityResults::get(const std::string& code, PeriodID period_id) const {
+    auto it = outputs.find(code);
+    if (it == outputs.end()) {
+        return nullptr;
+    }
+    auto period = std::find(period_ids.begin(), period_ids.end(), period_id);
+    if (period == period_ids.end()) {
+        return nullptr;
+    }
+    return &it->second[static_cast<size_t>(period - period_ids.begin())];
+}
+
+StochasticRunner::StochasticRunner(std::shared_ptr<database::IDatabase> db,
+                                   std::vector<StochasticDriver> drivers,
+                                   const Eigen::MatrixXd& correlation)
+    : db_(std::move(db)), drivers_(std::move(drivers)) {
+    engine_ = std::make_unique<unified::UnifiedEngine>(db_);
+
+    for (const auto& driver : drivers_) {
+        if (!(driver.stddev >= 0.0) || !std::isfinite(driver.stddev) || !std::isfinite(driver.mean)) {
+            throw std::invalid_argument("StochasticRunner: driver " + driver.driver_code +
+                                        " needs a finite mean and a non-negative standard deviation");
+        }
+        if (driver.distribution == DriverDistribution::LOGNORMAL) {
+            if (!(driver.mean > 0.0)) {
+                throw std::invalid_argument("StochasticRunner: lognormal driver " + driver.driver_code +
+                                            " needs a positive mean");
+            }
+            // Normal parameters giving the lognormal value this mean and deviation
+            const double cv = driver.stddev / driver.mean;
+            const double variance = std::log1p(cv * cv);
+            location_.push_back(std::log(driver.mean) - variance / 2.0);
+            scale_.push_back(std::sqrt(variance));
+        } else {
+            location_.push_back(driver.mean);
+            scale_.push_back(driver.stddev);
+        }
+    }
+
+    const auto k = static_cast<Eigen::Index>(drivers_.size());
+    if (correlation.size() == 0) {
+        cholesky_ = Eigen::MatrixXd::Identity(k, k);
+        return;
+    }
+    if (correlation.rows() != k || correlation.cols() != k) {
+        throw std::invalid_argument("StochasticRunner: correlation matrix must be " +
+                                    std::to_string(k) + " x " + std::to_string(k));
+    }
+    for (Eigen::Index i = 0; i < k; ++i) {
+        if (std::abs(correlation(i, i) - 1.0) > 1e-12) {
+            throw std::invalid_argument("StochasticRunner: correlation matrix diagonal must be 1");
+        }
+        for (Eigen::Index j = 0; j < i; ++j) {
+            if (std::abs(correlation(i, j) - correlation(j, i)) > 1e-12) {
+                throw std::invalid_argument("StochasticRunner: correlation matrix must be symmetric");
+            }
+        }
+    }
+
+    // Cholesky-Banachiewicz (a handful of drivers: no blocked factorisation needed)
+    cholesky_ = Eigen::MatrixXd::Zero(k, k);
+    for (Eigen::Index i = 0; i < k; ++i) {
+        for (Eigen::Index j = 0; j <= i; ++j) {
+            double sum = correlation(i, j);
+            for (Eigen::Index m = 0; m < j; ++m) {
+                sum -= cholesky_(i, m) * cholesky_(j, m);
+            }
+            if (i == j) {
+                if (!(sum > 0.0)) {
+                    throw std::invalid_argument("StochasticRunner: correlation matrix is not positive definite");
+                }
+                cholesky_(i, i) = std::sqrt(sum);
+            } else {
+                cholesky_(i, j) = sum / cholesky_(j, j);
+            }
+        }
+    }
+}
+
+StochasticResults StochasticRunner::run(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const StochasticOptions& options
+) {
+    if (options.lanes == 0) {
+        throw std::invalid_argument("StochasticRunner: lanes must be at least 1");
+    }
+    if (options.antithetic && options.lanes % 2 != 0) {
+        throw std::invalid_argument("StochasticRunner: antithetic paths need an even number of lanes");
+    }
+    if (options.target_relative_error > 0.0 && options.min_batches < 2) {
+        throw std::invalid_argument("StochasticRunner: an early stop needs at least 2 batches");
+    }
+    const LineItemDistribution empty(options.relative_accuracy);
+    const std::set<std::string> tracked(options.line_items.begin(), options.line_items.end());
+    const std::set<std::string> watched(options.convergence_line_items.begin(),
+                                        options.convergence_line_items.end());
+
+    std::shared_ptr<const core::CompiledFormula> stop_condition;
+    if (!options.stop_condition.empty()) {
+        try {
+            stop_condition = core::FormulaEvaluator().compile(options.stop_condition);
+        } catch (const std::exception& e) {
+            throw std::invalid_argument("StochasticRunner: stop condition '" + options.stop_condition + "': " +
+                                        e.what());
+        }
+    }
+
+    StochasticResults results;
+    results.period_ids = period_ids;
+    results.stopped_paths.assign(period_ids.size(), 0);
+    std::set<std::string> reported;
+    auto report = [&](size_t p, const std::string& message) {
+        const std::string error = "Period " + std::to_string(period_ids[p]) + ": " + message;
+        if (reported.insert(error).second) {
+            results.errors.push_back(error);
+        }
+        results.success = false;
+    };
+
+    engine_->set_lane_kernels(options.lane_kernels);
+
+    // Non-sampled drivers of all periods, read once
+    engine_->clear_driver_cache();
+    engine_->prefetch_drivers(entity_id, scenario_id, period_ids);
+
+    // Management actions: trigger rows and actions read once, overlays per active set
+    std::vector<ActionTrigger> trigger_rows;
+    std::shared_ptr<const actions::ActionCatalog> catalog;
+    action_sets_.clear();
+    if (options.apply_actions) {
+        trigger_rows = LaneTriggers::query(*db_, scenario_id);
+        if (!trigger_rows.empty()) {
+            catalog = actions::ActionCatalog::load(*db_, {scenario_id});
+        }
+    }
+
+    std::vector<std::string> opening_codes;
+    for (const auto& [code, value] : initial_bs.line_items) {
+        opening_codes.push_back(code);
+    }
+    const auto opening_schema = std::make_shared<const unified::ResultSchema>(opening_codes);
+    auto opening = [&](Eigen::Index lanes) {
+        unified::LaneResult state;
+        state.schema = opening_schema;
+        for (const auto& [code, value] : initial_bs.line_items) {
+            state.values.push_back(core::LaneArray::Constant(lanes, value));
+        }
+        return state;
+    };
+
+    // Deterministic baseline: one lane with the sampled drivers at their means
+    std::map<std::string, std::vector<double>> baselines;
+    {
+        unified::LaneResult state = opening(1);
+        unified::LaneValues means;
+        for (const auto& driver : drivers_) {
+            means[driver.driver_code] = core::LaneArray::Constant(1, driver.mean);
+        }
+        std::optional<LaneTriggers> triggers;
+        if (catalog) {
+            triggers.emplace(trigger_rows, 1);
+        }
+        for (size_t p = 0; p < period_ids.size(); ++p) {
+            try {
+                state = calculate_period(entity_id, {scenario_id}, period_ids[p], state, template_code, &means,
+                                         triggers ? &*triggers : nullptr, catalog.get());
+            } catch (const std::runtime_error& e) {
+                report(p, e.what());
+                break;
+            }
+            for (size_t i = 0; i < state.values.size(); ++i) {
+                auto& values = baselines[state.schema->code(static_cast<uint32_t>(i))];
+                values.resize(period_ids.size(), 0.0);
+                values[p] = state.values[i][0];
+            }
+        }
+    }
+    auto baseline = [&](const std::string& code, size_t p) {
+        auto it = baselines.find(code);
+        return it == baselines.end() ? 0.0 : it->second[p];
+    };
+
+    const auto k = static_cast<Eigen::Index>(drivers_.size());
+    const size_t dimensions = drivers_.size() * period_ids.size();
+    std::optional<core::SobolSequence> sobol;
+    std::optional<core::HaltonSequence> halton;
+    if (options.sampling == SamplingMethod::SOBOL) {
+        sobol.emplace(dimensions, options.seed);
+    } else if (options.sampling == SamplingMethod::HALTON) {
+        halton.emplace(dimensions, options.seed);
+    }
+
+    // Controls: each driver's deviation from its mean in the period, then summed to it
+    const size_t controls = options.control_variate ? 2 * drivers_.size() : 0;
+    std::vector<PeriodMoments> period_moments(period_ids.size(), PeriodMoments(controls));
+    std::map<std::string, std::vector<ItemMoments>> item_moments;
+
+    auto converged = [&]() {
+        bool checked = false;
+        for (const auto& [code, moments] : item_moments) {
+            if (!watched.empty() && !watched.count(code)) {
+                continue;
+            }
+            const auto& periods = results.line_items.at(code);
+            for (size_t p = 0; p < period_ids.size(); ++p) {
+                if (period_moments[p].batches < 2) {
+                    continue;
+                }
+                const Estimate e = estimate(periods[p], moments[p], period_moments[p], baseline(code, p));
+                const double value = std::abs(e.mean + baseline(code, p));
+                if (e.standard_error > options.target_relative_error * value) {
+                    return false;
+                }
+                checked = true;
+            }
+        }
+        return checked;
+    };
+
+    size_t simulated = 0;
+    for (size_t first = 0; first < options.paths; first += options.lanes) {
+        const size_t lanes = std::min(options.lanes, options.paths - first);
+        const auto n = static_cast<Eigen::Index>(lanes);
+        std::vector<ScenarioID> scenario_ids(lanes, scenario_id);
+        const size_t batch = first / options.lanes;
+        simulated += lanes;
+        ++results.batches;
+
+        std::optional<LaneTriggers> triggers;
+        if (catalog) {
+            triggers.emplace(trigger_rows, lanes);
+        }
+
+        // A pair of antithetic paths shares the draws of one stream or point
+        std::vector<core::PhiloxStream> streams;
+        std::vector<uint32_t> shifts;
+        std::vector<double> rotations;
+        if (sobol) {
+            shifts = sobol->scramble(batch);
+        } else if (halton) {
+            rotations = halton->scramble(batch);
+        } else {
+            streams.reserve(lanes);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                streams.emplace_back(options.seed, options.antithetic ? (first + lane) / 2 : first + lane);
+            }
+        }
+
+        // The batch's statistics, added to the run's only if every period calculates
+        std::vector<PeriodMoments> batch_periods(period_ids.size(), PeriodMoments(controls));
+        std::map<std::string, std::vector<LineItemDistribution>> batch_items;
+        std::map<std::string, std::vector<ItemMoments>> batch_item_moments;
+        std::vector<size_t> batch_stopped(period_ids.size(), 0);
+        bool batch_failed = false;
+
+        unified::LaneResult state = opening(n);
+        unified::LaneValues overrides;
+        Eigen::MatrixXd correlated;
+        Eigen::VectorXd normals(k);
+        std::vector<core::LaneArray> deviations(controls, core::LaneArray::Zero(n));
+
+        // Slot → path of the batch; paths that met the stop condition are
+        // masked, and dropped once they are half of the slots
+        std::vector<size_t> live(lanes);
+        std::iota(live.begin(), live.end(), size_t{0});
+        std::vector<char> masked(lanes, 0);
+        size_t masked_count = 0;
+        std::vector<Eigen::Index> kept;
+        auto keep = [&](const core::LaneArray& values) {
+            core::LaneArray out(static_cast<Eigen::Index>(kept.size()));
+            for (size_t i = 0; i < kept.size(); ++i) {
+                out[static_cast<Eigen::Index>(i)] = values[kept[i]];
+            }
+            return out;
+        };
+
+        for (size_t p = 0; p < period_ids.size(); ++p) {
+            const auto slots = static_cast<Eigen::Index>(live.size());
+
+            // Correlated normals → driver values, path by path
+            correlated.resize(k, slots);
+            for (Eigen::Index slot = 0; slot < slots; ++slot) {
+                const size_t lane = live[static_cast<size_t>(slot)];
+                const auto point = static_cast<uint32_t>(options.antithetic ? lane / 2 : lane);
+                for (Eigen::Index j = 0; j < k; ++j) {
+                    const size_t dim = p * drivers_.size() + static_cast<size_t>(j);
+                    if (sobol) {
+                        normals[j] = core::normal_quantile(sobol->coordinate(point, dim, shifts[dim]));
+                    } else if (halton) {
+                        normals[j] = core::normal_quantile(halton->coordinate(point, dim, rotations[dim]));
+                    } else {
+                        normals[j] = streams[lane].normal();
+                    }
+                }
+                const double sign = options.antithetic && lane % 2 == 1 ? -1.0 : 1.0;
+                for (Eigen::Index j = 0; j < k; ++j) {
+                    double sum = 0.0;
+                    for (Eigen::Index m = 0; m <= j; ++m) {
+                        sum += cholesky_(j, m) * normals[m];
+                    }
+                    correlated(j, slot) = sign * sum;
+                }
+            }
+            for (size_t j = 0; j < drivers_.size(); ++j) {
+                const auto row = static_cast<Eigen::Index>(j);
+                core::LaneArray values = location_[j] + scale_[j] * correlated.row(row).transpose().array();
+                if (drivers_[j].distribution == DriverDistribution::LOGNORMAL) {
+                    values = values.exp();
+                }
+                if (controls > 0) {
+                    deviations[j] = values - drivers_[j].mean;
+                    deviations[drivers_.size() + j] += deviations[j];
+                }
+                overrides[drivers_[j].driver_code] = std::move(values);
+            }
+
+            try {
+                state = calculate_period(entity_id, scenario_ids, period_ids[p], state, template_code,
+                                         &overrides, triggers ? &*triggers : nullptr, catalog.get());
+            } catch (const std::runtime_error& e) {
+                report(p, e.what());
+                results.failed_paths += lanes;
+                batch_failed = true;
+                break;
+            }
+
+            // Statistics of the paths still running
+            kept.clear();
+            if (masked_count > 0) {
+                for (Eigen::Index slot = 0; slot < slots; ++slot) {
+                    if (!masked[static_cast<size_t>(slot)]) {
+                        kept.push_back(slot);
+                    }
+                }
+            }
+            std::vector<core::LaneArray> kept_deviations;
+            if (masked_count > 0) {
+                for (const auto& values : deviations) {
+                    kept_deviations.push_back(keep(values));
+                }
+            }
+            const auto& running_deviations = masked_count > 0 ? kept_deviations : deviations;
+            const size_t running = live.size() - masked_count;
+
+            PeriodMoments& period = batch_periods[p];
+            std::vector<double> control_means(controls);
+            period.paths += running;
+            ++period.batches;
+            for (size_t c = 0; c < controls; ++c) {
+                control_means[c] = running_deviations[c].mean();
+                period.sum[c] += running_deviations[c].sum();
+                period.batch_sum[c] += control_means[c];
+            }
+            for (size_t c = 0; c < controls; ++c) {
+                for (size_t d = 0; d < controls; ++d) {
+                    period.squares[c * controls + d] += (running_deviations[c] * running_deviations[d]).sum();
+                    period.batch_squares[c * controls + d] += control_means[c] * control_means[d];
+                }
+            }
+
+            // Statistics of the batch, combined with earlier batches
+            for (size_t i = 0; i < state.values.size(); ++i) {
+                const std::string& code = state.schema->code(static_cast<uint32_t>(i));
+                if (!tracked.empty() && !tracked.count(code)) {
+                    continue;
+                }
+                auto& periods = batch_items[code];
+                if (periods.empty()) {
+                    periods.assign(period_ids.size(), empty);
+                    batch_item_moments[code].assign(period_ids.size(), ItemMoments(controls));
+                }
+                LineItemDistribution& dist = periods[p];
+                ItemMoments& moments = batch_item_moments[code][p];
+
+                core::LaneArray running_values;
+                if (masked_count > 0) {
+                    running_values = keep(state.values[i]);
+                }
+                const core::LaneArray& values = masked_count > 0 ? running_values : state.values[i];
+                const double batch_mean = values.mean();
+                dist.add(values.data(), running);
+
+                const double shift = baseline(code, p);
+                const double shifted_mean = batch_mean - shift;
+                moments.batch_sum += shifted_mean;
+                moments.batch_squares += shifted_mean * shifted_mean;
+                for (size_t c = 0; c < controls; ++c) {
+                    moments.cross[c] += (running_deviations[c] * (values - shift)).sum();
+                    moments.batch_cross[c] += control_means[c] * shifted_mean;
+                }
+            }
+
+            if (!stop_condition) {
+                continue;
+            }
+            core::LaneArray met;
+            try {
+                met = core::LaneEvaluator(live.size()).evaluate(
+                    *stop_condition, [&](const core::VariableRef& var, uint32_t, core::LaneArray& values) {
+                        const core::LaneArray* found = state.find(var.code);
+                        if (!found) {
+                            throw std::runtime_error("Unknown line item: " + var.code);
+                        }
+                        values = *found;
+                    });
+            } catch (const std::exception&) {
+                continue;  // A failing condition is not met
+            }
+            for (size_t slot = 0; slot < live.size(); ++slot) {
+                if (!masked[slot] && met[static_cast<Eigen::Index>(slot)] != 0.0) {
+                    masked[slot] = 1;
+                    ++masked_count;
+                    ++batch_stopped[p];
+                }
+            }
+            if (masked_count == live.size()) {
+                break;
+            }
+
+            // Compacted once half the slots are stopped paths; LaneTriggers keeps its lane count
+            if (!triggers && 2 * masked_count >= live.size()) {
+                kept.clear();
+                std::vector<size_t> still;
+                for (size_t slot = 0; slot < live.size(); ++slot) {
+                    if (!masked[slot]) {
+                        kept.push_back(static_cast<Eigen::Index>(slot));
+                        still.push_back(live[slot]);
+                    }
+                }
+                for (auto& values : state.values) {
+                    values = keep(values);
+                }
+                for (auto& values : deviations) {
+                    values = keep(values);
+                }
+                live = std::move(still);
+                masked.assign(live.size(), 0);
+                masked_count = 0;
+                scenario_ids.resize(live.size());
+            }
+        }
+
+        // A batch failing in a later period leaves no paths in the earlier ones either
+        if (!batch_failed) {
+            for (size_t p = 0; p < period_ids.size(); ++p) {
+                period_moments[p].add(batch_periods[p]);
+                results.stopped_paths[p] += batch_stopped[p];
+            }
+            for (auto& [code, periods] : batch_items) {
+                auto& merged = results.line_items[code];
+                auto& moments = item_moments[code];
+                if (merged.empty()) {
+                    merged = std::move(periods);
+                    moments = std::move(batch_item_moments.at(code));
+                    continue;
+                }
+                const auto& added = batch_item_moments.at(code);
+                for (size_t p = 0; p < period_ids.size(); ++p) {
+                    merged[p].merge(periods[p]);
+                    moments[p].add(added[p]);
+                }
+            }
+        }
+
+        if (options.target_relative_error > 0.0 && results.batches >= options.min_batches &&
+            first + lanes < options.paths && converged()) {
+            results.converged = true;
+            break;
+        }
+    }
+
+    for (auto& [code, periods] : results.line_items) {
+        const auto& moments = item_moments.at(code);
+        for (size_t p = 0; p < period_ids.size(); ++p) {
+            LineItemDistribution& dist = periods[p];
+            dist.baseline = baseline(code, p);
+            const Estimate e = estimate(dist, moments[p], period_moments[p], dist.baseline);
+            dist.estimate = e.mean + dist.baseline;
+            dist.standard_error = e.standard_error;
+        }
+    }
+
+    results.paths = simulated - results.failed_paths;
+    return results;
+}
+
+double StochasticRunner::driver_value(size_t j, double z) const {
+    const double value = location_[j] + scale_[j] * z;
+    return drivers_[j].distribution == DriverDistribution::LOGNORMAL ? std::exp(value) : value;
+}
+
+SensitivityResults StochasticRunner::sensitivity(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    const std::vector<PeriodID>& period_ids,
+    const BalanceSheet& initial_bs,
+    const std::string& template_code,
+    const SensitivityOptions& options
+) {
+    const size_t k = drivers_.size();
+    const size_t blocks = k + 2;                       // A, B, AB_1 … AB_k
+    if (options.samples == 0) {
+        throw std::invalid_argument("StochasticRunner: a sensitivity analysis needs at least 1 sample");
+    }
+    if (options.outputs.empty()) {
+        throw std::invalid_argument("StochasticRunner: a sensitivity analysis needs outputs");
+    }
+    if (options.lanes < blocks) {
+        throw std::invalid_argument("StochasticRunner: a sensitivity analysis needs at least " +
+                                    std::to_string(blocks) + " lanes");
+    }
+    if (!(options.confidence > 0.0 && options.confidence < 1.0)) {
+        throw std::invalid_argument("StochasticRunner: confidence must be in (0, 1)");
+    }
+
+    SensitivityResults results;
+    results.period_ids = period_ids;
+    for (const auto& driver : drivers_) {
+        results.driver_codes.push_back(driver.driver_code);
+    }
+    std::set<std::string> reported;
+    auto report = [&](size_t p, const std::string& message) {
+        const std::string error = "Period " + std::to_string(period_ids[p]) + ": " + message;
+        if (reported.insert(error).second) {
+            results.errors.push_back(error);
+        }
+        results.success = false;
+    };
+
+    engine_->set_lane_kernels(options.lane_kernels);
+    engine_->clear_driver_cache();
+    engine_->prefetch_drivers(entity_id, scenario_id, period_ids);
+
+    std::vector<ActionTrigger> trigger_rows;
+    std::shared_ptr<const actions::ActionCatalog> catalog;
+    action_sets_.clear();
+    if (options.apply_actions) {
+        trigger_rows = LaneTriggers::query(*db_, scenario_id);
+        if (!trigger_rows.empty()) {
+            catalog = actions::ActionCatalog::load(*db_, {scenario_id});
+        }
+    }
+
+    // Dimensions: A's drivers period by period, then B's
+    const size_t n_samples = options.samples;
+    const size_t half = k * period_ids.size();
+    const size_t dimensions = 2 * half;
+    std::optional<core::SobolSequence> sobol;
+    std::vector<uint32_t> shifts;
+    std::vector<std::vector<uint32_t>> strata;
+    if (options.design == SensitivityDesign::SOBOL) {
+        sobol.emplace(dimensions, options.seed);
+        shifts = sobol->scramble(0);
+    } else {
+        strata.resize(dimensions);
+        for (size_t d = 0; d < dimensions; ++d) {
+            strata[d].resize(n_samples);
+            std::iota(strata[d].begin(), strata[d].end(), uint32_t{0});
+            core::PhiloxStream stream(options.seed, STRATA_STREAMS + d);
+            for (size_t i = n_samples; i > 1; --i) {
+                const auto j = std::min(static_cast<size_t>(stream.uniform() * static_cast<double>(i)), i - 1);
+                std::swap(strata[d][i - 1], strata[d][j]);
+            }
+        }
+    }
+
+    std::vector<std::vector<OutputSums>> sums(options.outputs.size(),
+                                              std::vector<OutputSums>(period_ids.size(),
+                                                                      OutputSums(k, options.bootstrap)));
+
+    std::vector<std::string> opening_codes;
+    for (const auto& [code, value] : initial_bs.line_items) {
+        opening_codes.push_back(code);
+    }
+    const auto opening_schema = std::make_shared<const unified::ResultSchema>(opening_codes);
+
+    const size_t per_batch = options.lanes / blocks;
+    for (size_t first = 0; first < n_samples; first += per_batch) {
+        const size_t m = std::min(per_batch, n_samples - first);
+        const size_t lanes = m * blocks;
+        const auto n = static_cast<Eigen::Index>(lanes);
+        const std::vector<ScenarioID> scenario_ids(lanes, scenario_id);
+        results.evaluations += lanes;
+
+        // Unit-cube coordinates of the batch's samples, sample-major
+        std::vector<double> unit(m * dimensions);
+        for (size_t s = 0; s < m; ++s) {
+            const size_t sample = first + s;
+            if (sobol) {
+                for (size_t d = 0; d < dimensions; ++d) {
+                    unit[s * dimensions + d] = sobol->coordinate(static_cast<uint32_t>(sample), d, shifts[d]);
+                }
+            } else {
+                core::PhiloxStream stream(options.seed, sample);
+                for (size_t d = 0; d < dimensions; ++d) {
+                    unit[s * dimensions + d] = (strata[d][sample] + stream.uniform()) / static_cast<double>(n_samples);
+                }
+            }
+        }
+
+        // Bootstrap weights of the batch's samples, replicate-major
+        std::vector<double> weights(options.bootstrap * m);
+        for (size_t s = 0; s < m; ++s) {
+            core::PhiloxStream stream(options.seed, BOOTSTRAP_STREAMS + first + s);
+            for (size_t r = 0; r < options.bootstrap; ++r) {
+                weights[r * m + s] = poisson_one(stream);
+            }
+        }
+
+        std::optional<LaneTriggers> triggers;
+        if (catalog) {
+            triggers.emplace(trigger_rows, lanes);
+        }
+
+        unified::LaneResult state;
+        state.schema = opening_schema;
+        for (const auto& [code, value] : initial_bs.line_items) {
+            state.values.push_back(core::LaneArray::Constant(n, value));
+        }
+        unified::LaneValues overrides;
+        std::vector<double> fab(k);
+        for (size_t p = 0; p < period_ids.size(); ++p) {
+            // Block A, block B, then AB_i: A with driver i from B
+            for (size_t j = 0; j < k; ++j) {
+                core::LaneArray values(n);
+                const size_t dim_a = p * k + j;
+                const size_t dim_b = half + dim_a;
+                for (size_t s = 0; s < m; ++s) {
+                    const double a = driver_value(j, core::normal_quantile(unit[s * dimensions + dim_a]));
+                    const double b = driver_value(j, core::normal_quantile(unit[s * dimensions + dim_b]));
+                    values[static_cast<Eigen::Index>(s)] = a;
+                    values[static_cast<Eigen::Index>(m + s)] = b;
+                    for (size_t i = 0; i < k; ++i) {
+                        values[static_cast<Eigen::Index>((2 + i) * m + s)] = (i == j) ? b : a;
+                    }
+                }
+                overrides[drivers_[j].driver_code] = std::move(values);
+            }
+
+            try {
+                state = calculate_period(entity_id, scenario_ids, period_ids[p], state, template_code,
+                                         &overrides, triggers ? &*triggers : nullptr, catalog.get());
+            } catch (const std::runtime_error& e) {
+                report(p, e.what());
+                break;
+            }
+
+            for (size_t o = 0; o < options.outputs.size(); ++o) {
+                const core::LaneArray* values = state.find(options.outputs[o]);
+                if (!values) {
+                    report(p, "Output '" + options.outputs[o] + "' not calculated");
+                    continue;
+                }
+                OutputSums& out = sums[o][p];
+                if (!out.shifted) {
+                    out.shift = (*values)[0];
+                    out.shifted = true;
+                }
+                auto at = [&](size_t lane) { return (*values)[static_cast<Eigen::Index>(lane)] - out.shift; };
+                for (size_t s = 0; s < m; ++s) {
+                    for (size_t i = 0; i < k; ++i) {
+                        fab[i] = at((2 + i) * m + s);
+                    }
+                    const double fa = at(s);
+                    const double fb = at(m + s);
+                    out.sums.add(1.0, fa, fb, fab);
+                    for (size_t r = 0; r < options.bootstrap; ++r) {
+                        if (const double w = weights[r * m + s]; w > 0.0) {
+                            out.replicates[r].add(w, fa, fb, fab);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t o = 0; o < options.outputs.size(); ++o) {
+        auto& periods = results.outputs[options.outputs[o]];
+        periods.resize(period_ids.size());
+        for (size_t p = 0; p < period_ids.size(); ++p) {
+            const OutputSums& out = sums[o][p];
+            OutputSensitivity& sensitivity = periods[p];
+            sensitivity.drivers.resize(k);
+            if (out.sums.weight == 0.0) {
+                continue;
+            }
+            sensitivity.samples = static_cast<size_t>(out.sums.weight);
+            sensitivity.mean = out.sums.mean() + out.shift;
+            sensitivity.variance = out.sums.variance();
+            for (size_t i = 0; i < k; ++i) {
+                SobolIndex& index = sensitivity.drivers[i];
+                index.first_order = index.first_order_low = index.first_order_high = out.sums.first_order(i);
+                index.total = index.total_low = index.total_high = out.sums.total_effect(i);
+                if (out.replicates.empty()) {
+                    continue;
+                }
+                std::vector<double> first_orders;
+                std::vector<double> totals;
+                for (const auto& replicate : out.replicates) {
+                    if (replicate.weight > 0.0) {
+                        first_orders.push_back(replicate.first_order(i));
+                        totals.push_back(replicate.total_effect(i));
+                    }
+                }
+                if (!first_orders.empty()) {
+                    std::tie(index.first_order_low, index.first_order_high) =
+                        interval(std::move(first_orders), options.confidence);
+                    std::tie(index.total_low, index.total_high) = interval(std::move(totals), options.confidence);
+                }
+            }
+        }
+    }
+    return results;
+}
+
+unified::LaneResult StochasticRunner::calculate_period(
+    const EntityID& entity_id,
+    const std::vector<ScenarioID>& scenario_ids,
+    PeriodID period_id,
+    const unified::LaneResult& opening,
+    const std::string& template_code,
+    const unified::LaneValues* overrides,
+    LaneTriggers* triggers,
+    const actions::ActionCatalog* catalog
+) {
+    if (!triggers) {
+        return engine_->calculate_lane_values(entity_id, scenario_ids, period_id, opening, template_code, overrides);
+    }
+
+    // Conditions read the lanes' opening values, as run_periods() reads the prior period's
+    triggers->evaluate(period_id, &opening);
+    const auto groups = triggers->groups();
+    if (groups.size() == 1) {
+        return engine_->calculate_lane_values(
+            entity_id, scenario_ids, period_id, opening,
+            action_template(template_code, *catalog, scenario_ids.front(), *triggers, groups[0].triggers, period_id),
+            overrides);
+    }
+
+    // Lanes of each group gathered, calculated with the group's template and scattered back
+    auto gather = [](const core::LaneArray& values, const std::vector<size_t>& lanes) {
+        core::LaneArray out(static_cast<Eigen::Index>(lanes.size()));
+        for (size_t i = 0; i < lanes.size(); ++i) {
+            out[static_cast<Eigen::Index>(i)] = values[static_cast<Eigen::Index>(lanes[i])];
+        }
+        return out;
+    };
+    const auto n = static_cast<Eigen::Index>(scenario_ids.size());
+    unified::LaneResult merged;
+    for (const auto& group : groups) {
+        unified::LaneResult part_opening;
+        part_opening.schema = opening.schema;
+        for (const auto& values : opening.values) {
+            part_opening.values.push_back(gather(values, group.lanes));
+        }
+        unified::LaneValues part_overrides;
+        if (overrides) {
+            for (const auto& [code, values] : *overrides) {
+                part_overrides.emplace(code, gather(values, group.lanes));
+            }
+        }
+        std::vector<ScenarioID> part_ids;
+        for (size_t lane : group.lanes) {
+            part_ids.push_back(scenario_ids[lane]);
+        }
+
+        const auto part = engine_->calculate_lane_values(
+            entity_id, part_ids, period_id, part_opening,
+            action_template(template_code, *catalog, scenario_ids.front(), *triggers, group.triggers, period_id),
+            overrides ? &part_overrides : nullptr);
+
+        // Overlays have the base template's line items, possibly in another order
+        if (!merged.schema) {
+            merged.schema = part.schema;
+            merged.values.assign(part.values.size(), core::LaneArray::Zero(n));
+        }
+        for (size_t i = 0; i < part.values.size(); ++i) {
+            const uint32_t j = (part.schema == merged.schema)
+                                   ? static_cast<uint32_t>(i)
+                                   : merged.schema->find(part.schema->code(static_cast<uint32_t>(i)));
+            if (j == unified::ResultSchema::NO_INDEX) {
+                continue;
+            }
+            for (size_t k = 0; k < group.lanes.size(); ++k) {
+                merged.values[j][static_cast<Eigen::Index>(group.lanes[k])] = part.values[i][static_cast<Eigen::Index>(k)];
+            }
+        }
+    }
+    return merged;
+}
+
+std::string StochasticRunner::action_template(
+    const std::string& base_template_code,
+    const actions::ActionCatalog& catalog,
+    ScenarioID scenario_id,
+    const LaneTriggers& triggers,
+    const std::vector<uint64_t>& active,
+    PeriodID period_id
+) {
+    // Actions of the active triggers that are in their own period window
+    const auto& all_actions = catalog.actions(scenario_id);
+    std::vector<size_t> effective;
+    for (size_t t = 0; t < triggers.size(); ++t) {
+        if ((active[t / 64] >> (t % 64)) & 1) {
+            for (size_t a : catalog.find(scenario_id, triggers.trigger(t).action_code)) {
+                if (all_actions[a].action.is_active_in_period(period_id)) {
+                    effective.push_back(a);
+                }
+            }
+        }
+    }
+    if (effective.empty()) {
+        return base_template_code;
+    }
+    std::sort(effective.begin(), effective.end());
+    effective.erase(std::unique(effective.begin(), effective.end()), effective.end());
+
+    auto set_key = std::make_pair(base_template_code, effective);
+    auto known = action_sets_.find(set_key);
+    if (known != action_sets_.end()) {
+        return known->second;
+    }
+
+    auto base_template = core::StatementTemplate::load_cached(db_, base_template_code);
+    if (!base_template) {
+        throw std::runtime_error("Base template not found: " + base_template_code);
+    }
+    std::vector<actions::ManagementAction> patching;
+    for (size_t a : effective) {
+        patching.push_back(all_actions[a].action);
+    }
+    auto patches = actions::ActionEngine(db_).formula_patches(*base_template, patching, period_id);
+
+    // Same patches → same overlay, as PeriodRunner::create_or_get_action_template()
+    std::string key = base_template_code + "@" + std::to_string(base_template->content_hash());
+    for (const auto& [code, formula] : patches) {
+        key += '\n' + code + '=' + formula;
+    }
+    auto existing = action_templates_.find(key);
+    if (existing != action_templates_.end()) {
+        return action_sets_[std::move(set_key)] = existing->second;
+    }
+
+    // Format: BASE+{action1}+{action2}... in action code order, as PeriodRunner's overlays
+    std::set<std::string> action_codes;
+    for (const auto& action : patching) {
+        action_codes.insert(action.action_code);
+    }
+    std::string template_code = base_template_code;
+    for (const auto& action_code : action_codes) {
+        template_code += "+" + action_code;
+    }
+    if (engine_->has_registered_template(template_code)) {
+        int variant = 2;
+        while (engine_->has_registered_template(template_code + "#" + std::to_string(variant))) {
+            ++variant;
+        }
+        template_code += "#" + std::to_string(variant);
+    }
+    engine_->register_template(base_template->with_formulas(template_code, patches));
+    action_templates_.emplace(std::move(key), template_code);
+    return action_sets_[std::move(set_key)] = template_code;
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,145 @@
+/**
+ * @file tail_latency.cpp
+ * @brief Latency histograms and exemplar traces of scenario runs
+ */
+
+#include "orchestration/tail_latency.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+size_t RunTrace::templates_created() const {
+    return static_cast<size_t>(std::count_if(periods.begin(), periods.end(),
+                                             [](const PeriodTrace& period) { return period.template_created; }));
+}
+
+size_t RunTrace::evaluations() const {
+    size_t total = 0;
+    for (const auto& period : periods) {
+        total += period.evaluations;
+    }
+    return total;
+}
+
+size_t RunTrace::database_reads() const {
+    size_t total = 0;
+    for (const auto& period : periods) {
+        total += period.database_reads;
+    }
+    return total;
+}
+
+std::string RunTrace::to_json() const {
+    json out_periods = json::array();
+    for (const auto& period : periods) {
+        out_periods.push_back({
+            {"period", period.period_id},
+            {"template", period.template_code},
+            {"template_created", period.template_created},
+            {"ms", period.seconds * 1e3},
+            {"calculate_ms", period.calculate_seconds * 1e3},
+            {"evaluations", period.evaluations},
+            {"database_reads", period.database_reads}
+        });
+    }
+    return json{
+        {"entity", entity_id},
+        {"scenario", scenario_id},
+        {"reason", reason},
+        {"ms", seconds * 1e3},
+        {"driver_load_ms", driver_load_seconds * 1e3},
+        {"cached", cached},
+        {"templates_created", templates_created()},
+        {"evaluations", evaluations()},
+        {"database_reads", database_reads()},
+        {"periods", std::move(out_periods)}
+    }.dump();
+}
+
+TailLatencyTracker::TailLatencyTracker(TailLatencyPolicy policy)
+    : policy_(policy) {
+    if (!(policy_.percentile > 0.0 && policy_.percentile <= 1.0)) {
+        throw std::invalid_argument("TailLatencyTracker: percentile must be in (0, 1]");
+    }
+    if (policy_.threshold_seconds < 0.0) {
+        throw std::invalid_argument("TailLatencyTracker: threshold must not be negative");
+    }
+}
+
+bool TailLatencyTracker::record(RunTrace& trace) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Against the runs before this one, so a single slow run stands out
+    trace.reason.clear();
+    if (policy_.threshold_seconds > 0.0 && trace.seconds >= policy_.threshold_seconds) {
+        trace.reason = "threshold";
+    } else if (policy_.percentile < 1.0 && run_seconds_.count() >= policy_.min_runs &&
+               trace.seconds > run_seconds_.quantile(policy_.percentile)) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "p%g", policy_.percentile * 100.0);
+        trace.reason = name;
+    }
+
+    run_seconds_.add(trace.seconds);
+    for (const auto& period : trace.periods) {
+        period_seconds_.add(period.seconds);
+    }
+    if (trace.reason.empty()) {
+        return false;
+    }
+
+    // Keep the slowest: a full set gives up its fastest
+    if (exemplars_.size() < policy_.max_exemplars) {
+        exemplars_.push_back(trace);
+    } else if (!exemplars_.empty()) {
+        auto fastest = std::min_element(exemplars_.begin(), exemplars_.end(),
+                                        [](const RunTrace& a, const RunTrace& b) { return a.seconds < b.seconds; });
+        if (fastest->seconds < trace.seconds) {
+            *fastest = trace;
+        }
+    }
+    return true;
+}
+
+size_t TailLatencyTracker::runs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(run_seconds_.count());
+}
+
+double TailLatencyTracker::run_quantile(double q) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return run_seconds_.quantile(q);
+}
+
+double TailLatencyTracker::period_quantile(double q) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return period_seconds_.quantile(q);
+}
+
+std::vector<RunTrace> TailLatencyTracker::exemplars() const {
+    std::vector<RunTrace> out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out = exemplars_;
+    }
+    std::stable_sort(out.begin(), out.end(), [](const RunTrace& a, const RunTrace& b) {
+        return a.seconds > b.seconds;
+    });
+    return out;
+}
+
+void TailLatencyTracker::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    run_seconds_ = core::QuantileSketch();
+    period_seconds_ = core::QuantileSketch();
+    exemplars_.clear();
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,214 @@
+/**
+ * @file task_scheduler.cpp
+ * @brief Work-stealing scheduler implementation
+ */
+
+#include "orchestration/task_scheduler.h"
+#include "core/engine_metrics.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Scheduler and worker index of the task running on this thread
+thread_local const TaskScheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+TaskScheduler::TaskScheduler(size_t threads, bool numa) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    if (!numa) {
+        start(threads, std::vector<size_t>(threads, 0), nullptr);
+        return;
+    }
+    const auto& topology = core::NumaTopology::system();
+    // One node: nothing to keep local, let the OS move threads freely
+    start(threads, topology.place(threads), topology.node_count() > 1 ? &topology : nullptr);
+}
+
+TaskScheduler::TaskScheduler(size_t threads, const core::NumaTopology& topology, bool pin) {
+    if (threads == 0) {
+        throw std::invalid_argument("TaskScheduler: at least one thread needed");
+    }
+    start(threads, topology.place(threads), pin ? &topology : nullptr);
+}
+
+void TaskScheduler::start(size_t threads, std::vector<size_t> nodes, const core::NumaTopology* topology) {
+    nodes_ = std::move(nodes);
+    node_count_ = 1 + *std::max_element(nodes_.begin(), nodes_.end());
+    for (size_t worker = 0; worker < threads; ++worker) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    // Victims in ring order from the thief, its own node's first
+    victims_.resize(threads);
+    for (size_t worker = 0; worker < threads; ++worker) {
+        for (int remote = 0; remote < 2; ++remote) {
+            for (size_t i = 1; i < threads; ++i) {
+                const size_t victim = (worker + i) % threads;
+                if ((nodes_[victim] != nodes_[worker]) == static_cast<bool>(remote)) {
+                    victims_[worker].push_back(victim);
+                }
+            }
+        }
+    }
+
+    core::EngineMetrics::add(core::EngineMetrics::Counter::WORKERS_STARTED, threads);
+    // The caller of wait() is worker 0, threads are 1..threads-1
+    for (size_t worker = 1; worker < threads; ++worker) {
+        size_t slot = 0;
+        for (size_t other = 0; other < worker; ++other) {
+            slot += nodes_[other] == nodes_[worker] ? 1 : 0;
+        }
+        threads_.emplace_back([this, worker, topology, slot] {
+            if (topology) {
+                topology->pin_current_thread(nodes_[worker], slot);
+            }
+            worker_loop(worker);
+        });
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    // Without worker threads, queued tasks run here
+    while (run_one(0)) {
+    }
+    core::EngineMetrics::add(core::EngineMetrics::Counter::WORKERS_STOPPED, queues_.size());
+}
+
+void TaskScheduler::submit(Task task) {
+    ++pending_;
+    core::EngineMetrics::add(core::EngineMetrics::Counter::TASKS_QUEUED);
+    const size_t queue = (current_scheduler == this) ? current_worker
+                                                     : next_queue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+        queues_[queue]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+void TaskScheduler::wait() {
+    if (current_scheduler == this) {
+        throw std::logic_error("TaskScheduler: wait() called from inside a task");
+    }
+
+    while (true) {
+        if (run_one(0)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return pending_ == 0 || queued_ > 0; });
+        if (pending_ == 0) {
+            break;
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+TaskSchedulerStats TaskScheduler::stats() const {
+    TaskSchedulerStats stats;
+    stats.executed = executed_;
+    stats.stolen = stolen_;
+    stats.stolen_remote = stolen_remote_;
+    return stats;
+}
+
+void TaskScheduler::worker_loop(size_t worker) {
+    while (true) {
+        if (run_one(worker)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::run_one(size_t worker) {
+    Task task;
+    {
+        // Newest first: a task's subtasks run while their inputs are warm
+        std::lock_guard<std::mutex> lock(queues_[worker]->mutex);
+        auto& tasks = queues_[worker]->tasks;
+        if (!tasks.empty()) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+    }
+    for (size_t i = 0; !task && i < victims_[worker].size(); ++i) {
+        // Steal the oldest task: usually the biggest piece of the victim's work
+        const size_t from = victims_[worker][i];
+        auto& victim = *queues_[from];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++stolen_;
+            if (nodes_[from] != nodes_[worker]) {
+                ++stolen_remote_;
+            }
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --queued_;
+    core::EngineMetrics::add(core::EngineMetrics::Counter::TASKS_STARTED);
+    const auto started = std::chrono::steady_clock::now();
+
+    const TaskScheduler* outer_scheduler = current_scheduler;
+    const size_t outer_worker = current_worker;
+    current_scheduler = this;
+    current_worker = worker;
+    try {
+        task(worker);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+            error_ = std::current_exception();
+        }
+    }
+    current_scheduler = outer_scheduler;
+    current_worker = outer_worker;
+    core::EngineMetrics::add(core::EngineMetrics::Counter::TASK_NANOSECONDS,
+                             core::EngineMetrics::elapsed_nanoseconds(started));
+
+    ++executed_;
+    if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_all();
+    }
+    return true;
+}
+
+} // namespace orchestration
+} // namespace finmodel
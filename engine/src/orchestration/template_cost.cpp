@@ -0,0 +1,296 @@
+/**
+ * @file template_cost.cpp
+ * @brief Static cost analysis of template formulas and their action overlays
+ */
+
+#include "orchestration/template_cost.h"
+#include "actions/action_catalog.h"
+#include "actions/action_engine.h"
+#include "core/formula_evaluator.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+namespace {
+
+/**
+ * @brief Line item costs with their same-period dependencies
+ */
+struct Analysis {
+    std::vector<LineItemCost> items;
+    CostTotals totals;
+    std::vector<std::string> critical_path;
+};
+
+Analysis analyze_items(const core::StatementTemplate& tmpl, size_t history_depth) {
+    const core::FormulaEvaluator evaluator;
+    const auto& line_items = tmpl.get_line_items();
+
+    Analysis analysis;
+    analysis.items.resize(line_items.size());
+    std::unordered_map<std::string, size_t> index;
+    for (size_t i = 0; i < line_items.size(); ++i) {
+        index.emplace(line_items[i].code, i);
+    }
+
+    // Formula costs and the same-period edges between line items
+    std::vector<std::vector<size_t>> reads(line_items.size());
+    std::vector<std::vector<size_t>> readers(line_items.size());
+    for (size_t i = 0; i < line_items.size(); ++i) {
+        LineItemCost& item = analysis.items[i];
+        item.code = line_items[i].code;
+        if (!line_items[i].formula) {
+            continue;
+        }
+        item.has_formula = true;
+        std::shared_ptr<const core::CompiledFormula> compiled;
+        try {
+            compiled = evaluator.compile(*line_items[i].formula);
+        } catch (const std::exception& e) {
+            item.error = e.what();
+            continue;
+        }
+        item.ops = compiled->code().size();
+        item.loads = compiled->variables().size();
+        item.calls = compiled->functions().size();
+        for (const auto& instruction : compiled->code()) {
+            if (instruction.op == core::OpCode::JUMP_IF_FALSE) {
+                ++item.if_branches;
+            }
+        }
+        for (const auto& variable : compiled->variables()) {
+            // Provider lookups (driver:, action:, ...) aren't line items
+            if (variable.code.find(':') != std::string::npos) {
+                continue;
+            }
+            if (variable.time_offset < 0 && static_cast<size_t>(-variable.time_offset) > history_depth) {
+                ++item.far_references;
+            }
+            auto dependency = index.find(variable.code);
+            if (variable.time_offset != 0 || dependency == index.end()) {
+                continue;
+            }
+            if (dependency->second == i) {
+                item.circular = true;   // Reads itself at [t]
+            } else if (std::find(reads[i].begin(), reads[i].end(), dependency->second) == reads[i].end()) {
+                reads[i].push_back(dependency->second);
+                readers[dependency->second].push_back(i);
+            }
+        }
+    }
+
+    // Depths in topological order (Kahn); what is left is circular or behind a cycle
+    std::vector<size_t> pending(line_items.size());
+    std::vector<size_t> ready;
+    std::vector<size_t> longest_from(line_items.size(), SIZE_MAX);   // Predecessor on the longest chain
+    for (size_t i = 0; i < line_items.size(); ++i) {
+        pending[i] = reads[i].size();
+        analysis.items[i].fan_in = reads[i].size();
+        analysis.items[i].fan_out = readers[i].size();
+        if (pending[i] == 0 && !analysis.items[i].circular) {
+            analysis.items[i].depth = 1;
+            ready.push_back(i);
+        }
+    }
+    while (!ready.empty()) {
+        const size_t done = ready.back();
+        ready.pop_back();
+        for (size_t reader : readers[done]) {
+            LineItemCost& item = analysis.items[reader];
+            if (analysis.items[done].depth + 1 > item.depth) {
+                item.depth = analysis.items[done].depth + 1;
+                longest_from[reader] = done;
+            }
+            if (--pending[reader] == 0 && !item.circular) {
+                ready.push_back(reader);
+            }
+        }
+    }
+
+    CostTotals& totals = analysis.totals;
+    size_t deepest = SIZE_MAX;
+    for (size_t i = 0; i < analysis.items.size(); ++i) {
+        LineItemCost& item = analysis.items[i];
+        if (item.circular || pending[i] > 0) {
+            item.circular = true;
+            item.depth = 0;
+            ++totals.circular;
+        }
+        ++totals.line_items;
+        totals.formulas += item.has_formula ? 1 : 0;
+        totals.errors += item.error.empty() ? 0 : 1;
+        totals.ops += item.ops;
+        totals.loads += item.loads;
+        totals.calls += item.calls;
+        totals.if_branches += item.if_branches;
+        totals.far_references += item.far_references;
+        totals.max_fan_in = std::max(totals.max_fan_in, item.fan_in);
+        totals.max_fan_out = std::max(totals.max_fan_out, item.fan_out);
+        if (item.depth > totals.critical_path) {
+            totals.critical_path = item.depth;
+            deepest = i;
+        }
+    }
+    for (size_t i = deepest; i != SIZE_MAX; i = longest_from[i]) {
+        analysis.critical_path.push_back(analysis.items[i].code);
+    }
+    std::reverse(analysis.critical_path.begin(), analysis.critical_path.end());
+    return analysis;
+}
+
+json totals_json(const CostTotals& totals) {
+    return {{"line_items", totals.line_items},
+            {"formulas", totals.formulas},
+            {"ops", totals.ops},
+            {"loads", totals.loads},
+            {"calls", totals.calls},
+            {"if_branches", totals.if_branches},
+            {"far_references", totals.far_references},
+            {"critical_path", totals.critical_path},
+            {"max_fan_in", totals.max_fan_in},
+            {"max_fan_out", totals.max_fan_out},
+            {"circular", totals.circular},
+            {"errors", totals.errors}};
+}
+
+} // namespace
+
+std::string TemplateCost::report(size_t top) const {
+    std::ostringstream out;
+    out << "Template:    " << template_code << ": " << totals.line_items << " line items ("
+        << totals.formulas << " formulas)\n"
+        << "Ops:         " << totals.ops << " instructions, " << totals.loads << " loads, "
+        << totals.calls << " calls, " << totals.if_branches << " IF branches\n"
+        << "Far reads:   " << totals.far_references << " [t-k] references beyond " << history_depth
+        << " periods (database reads per period)\n"
+        << "Critical:    " << totals.critical_path << " deep";
+    if (!critical_path.empty()) {
+        out << " (" << critical_path.front();
+        if (critical_path.size() > 1) {
+            out << " .. " << critical_path.back();
+        }
+        out << ")";
+    }
+    out << ", fan-in up to " << totals.max_fan_in << ", fan-out up to " << totals.max_fan_out << "\n";
+    if (totals.circular > 0 || totals.errors > 0) {
+        out << "Problems:    " << totals.circular << " circular line items, " << totals.errors
+            << " formulas that don't compile\n";
+    }
+
+    std::vector<const LineItemCost*> costliest;
+    for (const auto& item : line_items) {
+        if (item.has_formula) {
+            costliest.push_back(&item);
+        }
+    }
+    std::stable_sort(costliest.begin(), costliest.end(), [](const LineItemCost* a, const LineItemCost* b) {
+        return a->ops > b->ops;
+    });
+    costliest.resize(std::min(costliest.size(), top));
+    for (const auto* item : costliest) {
+        out << "  " << item->code << ": " << item->ops << " ops, " << item->if_branches << " IF, fan-in "
+            << item->fan_in << ", fan-out " << item->fan_out << ", depth " << item->depth;
+        if (item->far_references > 0) {
+            out << ", " << item->far_references << " far";
+        }
+        if (!item->error.empty()) {
+            out << ", error: " << item->error;
+        }
+        out << "\n";
+    }
+
+    for (const auto& overlay : overlays) {
+        out << "Scenario " << overlay.scenario_id << ": " << overlay.actions << " actions patch "
+            << overlay.patched_line_items << " line items: " << overlay.totals.ops << " instructions, "
+            << overlay.totals.if_branches << " IF branches, " << overlay.totals.far_references
+            << " far reads, " << overlay.totals.critical_path << " deep\n";
+    }
+    return out.str();
+}
+
+std::string TemplateCost::to_json() const {
+    json items = json::array();
+    for (const auto& item : line_items) {
+        json entry = {{"code", item.code},
+                      {"ops", item.ops},
+                      {"loads", item.loads},
+                      {"calls", item.calls},
+                      {"if_branches", item.if_branches},
+                      {"far_references", item.far_references},
+                      {"fan_in", item.fan_in},
+                      {"fan_out", item.fan_out},
+                      {"depth", item.depth},
+                      {"circular", item.circular}};
+        if (!item.error.empty()) {
+            entry["error"] = item.error;
+        }
+        items.push_back(std::move(entry));
+    }
+    json out_overlays = json::array();
+    for (const auto& overlay : overlays) {
+        out_overlays.push_back({{"scenario", overlay.scenario_id},
+                                {"actions", overlay.actions},
+                                {"patched_line_items", overlay.patched_line_items},
+                                {"totals", totals_json(overlay.totals)}});
+    }
+    return json{{"template", template_code},
+                {"history_depth", history_depth},
+                {"totals", totals_json(totals)},
+                {"critical_path", critical_path},
+                {"line_items", std::move(items)},
+                {"overlays", std::move(out_overlays)}}.dump();
+}
+
+TemplateCost TemplateCostAnalyzer::analyze(const core::StatementTemplate& tmpl, size_t history_depth) {
+    Analysis analysis = analyze_items(tmpl, history_depth);
+    TemplateCost cost;
+    cost.template_code = tmpl.get_template_code();
+    cost.history_depth = history_depth;
+    cost.line_items = std::move(analysis.items);
+    cost.totals = analysis.totals;
+    cost.critical_path = std::move(analysis.critical_path);
+    return cost;
+}
+
+TemplateCost TemplateCostAnalyzer::analyze(std::shared_ptr<database::IDatabase> db, const std::string& template_code,
+                                           const std::vector<ScenarioID>& scenario_ids, size_t history_depth) {
+    auto tmpl = core::StatementTemplate::load_from_database(db.get(), template_code);
+    if (!tmpl) {
+        throw std::invalid_argument("TemplateCostAnalyzer: template not found: " + template_code);
+    }
+    TemplateCost cost = analyze(*tmpl, history_depth);
+    if (scenario_ids.empty()) {
+        return cost;
+    }
+
+    // Each scenario's actions as one parametric overlay, as PeriodRunner builds it
+    const auto catalog = actions::ActionCatalog::load(*db, scenario_ids);
+    const actions::ActionEngine engine(db);
+    for (ScenarioID scenario_id : scenario_ids) {
+        std::vector<actions::ManagementAction> scenario_actions;
+        for (const auto& entry : catalog->actions(scenario_id)) {
+            scenario_actions.push_back(entry.action);
+        }
+        OverlayCost overlay;
+        overlay.scenario_id = scenario_id;
+        overlay.actions = scenario_actions.size();
+        const auto patches = engine.parametric_patches(*tmpl, scenario_actions);
+        overlay.patched_line_items = patches.size();
+        overlay.totals = patches.empty()
+            ? cost.totals
+            : analyze_items(*tmpl->with_formulas(template_code + "@actions", patches), history_depth).totals;
+        cost.overlays.push_back(std::move(overlay));
+    }
+    return cost;
+}
+
+} // namespace orchestration
+} // namespace finmodel
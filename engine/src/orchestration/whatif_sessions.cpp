@@ -0,0 +1,204 @@
+/**
+ * @file whatif_sessions.cpp
+ * @brief What-if session store implementation
+ */
+
+#include "orchestration/whatif_sessions.h"
+#include "database/idatabase.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+using json = nlohmann::json;
+
+// ============================================================================
+// DriverEdit / SessionResult
+// ============================================================================
+
+std::vector<DriverEdit> DriverEdit::list_from_json(const std::string& text) {
+    std::vector<DriverEdit> edits;
+    try {
+        json j = json::parse(text);
+        if (j.is_object()) {
+            j = json::array({j});
+        }
+        if (!j.is_array() || j.empty()) {
+            throw std::invalid_argument("Driver edits must be an object or a non-empty array");
+        }
+        for (const auto& item : j) {
+            DriverEdit edit;
+            edit.period_id = item.at("period").get<PeriodID>();
+            edit.driver_code = item.at("driver").get<std::string>();
+            edit.value = item.at("value").get<double>();
+            edit.unit_code = item.value("unit", "");
+            edits.push_back(std::move(edit));
+        }
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("Driver edits: ") + e.what());
+    }
+    return edits;
+}
+
+std::string SessionResult::to_json() const {
+    json periods = json::array();
+    for (size_t p = 0; p < results.results.size(); ++p) {
+        const auto& result = results.results[p];
+        json values = json::object();
+        for (auto [code, value] : result.get_all_values()) {
+            values[std::string(code)] = value;
+        }
+        periods.push_back({{"period", period_ids[p]}, {"success", result.success}, {"values", std::move(values)}});
+    }
+    json j = {
+        {"session_id", session_id},
+        {"entity", entity_id},
+        {"scenario", scenario_id},
+        {"success", results.success},
+        {"recalculated", recalculated},
+        {"milliseconds", milliseconds},
+        {"periods", std::move(periods)},
+    };
+    if (!results.errors.empty()) {
+        j["errors"] = results.errors;
+    }
+    return j.dump();
+}
+
+// ============================================================================
+// WhatIfSessions
+// ============================================================================
+
+WhatIfSessions::WhatIfSessions(ConnectionFactory connect, size_t max_sessions)
+    : connect_(std::move(connect)), max_sessions_(max_sessions) {
+    if (max_sessions == 0) {
+        throw std::invalid_argument("WhatIfSessions: max_sessions must be at least 1");
+    }
+}
+
+SessionResult WhatIfSessions::open(const JobSpec& spec) {
+    spec.validate();
+    if (spec.entities.size() != 1 || spec.scenario_ids.size() != 1) {
+        throw std::invalid_argument("What-if session: needs exactly one entity and one scenario");
+    }
+
+    auto session = std::make_shared<Session>();
+    session->spec = spec;
+    session->opening.line_items = spec.opening_balances;
+
+    auto db = connect_();
+    session->drivers = unified::DriverValueProvider::fetch_rows(
+        *db, spec.entities.front(), spec.scenario_ids.front(), spec.period_ids);
+    session->runner = std::make_unique<PeriodRunner>(std::move(db));
+    session->runner->set_incremental(true);
+    Session* counted = session.get();
+    session->runner->set_period_observer(
+        [counted](const EntityID&, ScenarioID, PeriodID, const unified::UnifiedResult&) {
+            counted->recalculated += counted->runner->engine().last_recalculated_count();
+            return true;
+        });
+
+    run(*session);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    session->last.session_id = next_id_++;
+    session->last_used = ++clock_;
+    // Make room: the least recently used sessions go (one still running finishes first)
+    while (sessions_.size() >= max_sessions_) {
+        auto oldest = std::min_element(sessions_.begin(), sessions_.end(), [](const auto& a, const auto& b) {
+            return a.second->last_used < b.second->last_used;
+        });
+        sessions_.erase(oldest);
+    }
+    sessions_.emplace(session->last.session_id, session);
+    return session->last;
+}
+
+SessionResult WhatIfSessions::edit(uint64_t id, const std::vector<DriverEdit>& edits) {
+    auto session = find(id);
+    std::lock_guard<std::mutex> running(session->mutex);
+    const auto& period_ids = session->spec.period_ids;
+    for (const auto& edit : edits) {
+        if (std::find(period_ids.begin(), period_ids.end(), edit.period_id) == period_ids.end()) {
+            throw std::invalid_argument("What-if session: period " + std::to_string(edit.period_id) +
+                                        " is not one of the session's");
+        }
+    }
+
+    // Edits become rows of the session's own scenario, which override its ancestors'
+    const auto started = std::chrono::steady_clock::now();
+    auto& rows = session->drivers.rows;
+    const ScenarioID scenario_id = session->drivers.scenario_id;
+    for (const auto& edit : edits) {
+        auto own = std::find_if(rows.begin(), rows.end(), [&](const auto& row) {
+            return row.scenario_id == scenario_id && row.period_id == edit.period_id &&
+                   row.driver_code == edit.driver_code;
+        });
+        if (own != rows.end()) {
+            own->value = edit.value;
+            if (!edit.unit_code.empty()) {
+                own->unit_code = edit.unit_code;
+            }
+            continue;
+        }
+        std::string unit_code = edit.unit_code;
+        if (unit_code.empty()) {
+            auto known = std::find_if(rows.begin(), rows.end(), [&](const auto& row) {
+                return row.driver_code == edit.driver_code;
+            });
+            unit_code = (known != rows.end()) ? known->unit_code : "";
+        }
+        rows.push_back({scenario_id, edit.period_id, edit.driver_code, edit.value, std::move(unit_code)});
+    }
+    run(*session);
+    session->last.milliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return session->last;
+}
+
+SessionResult WhatIfSessions::result(uint64_t id) const {
+    auto session = find(id);
+    std::lock_guard<std::mutex> running(session->mutex);
+    return session->last;
+}
+
+bool WhatIfSessions::close(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.erase(id) > 0;
+}
+
+size_t WhatIfSessions::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.size();
+}
+
+std::shared_ptr<WhatIfSessions::Session> WhatIfSessions::find(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+        throw std::out_of_range("No what-if session " + std::to_string(id));
+    }
+    it->second->last_used = ++clock_;
+    return it->second;
+}
+
+void WhatIfSessions::run(Session& session) {
+    const auto started = std::chrono::steady_clock::now();
+    const JobSpec& spec = session.spec;
+    session.recalculated = 0;
+    SessionResult& last = session.last;
+    last.entity_id = spec.entities.front();
+    last.scenario_id = spec.scenario_ids.front();
+    last.period_ids = spec.period_ids;
+    last.results = session.runner->run_periods(last.entity_id, last.scenario_id, spec.period_ids,
+                                               session.opening, spec.template_code, session.drivers);
+    last.recalculated = session.recalculated;
+    last.milliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -0,0 +1,412 @@
+#include "orchestration/workload_generator.h"
+#include "orchestration/period_setup.h"
+#include "core/philox_stream.h"
+#include "core/statement_template.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace finmodel {
+namespace orchestration {
+
+namespace {
+
+// Uniform index in [0, n)
+size_t pick(core::PhiloxStream& rng, size_t n) {
+    return std::min(static_cast<size_t>(rng.uniform() * static_cast<double>(n)), n - 1);
+}
+
+// Coefficient with two decimals, so formulas read like hand-written ones
+std::string coefficient(core::PhiloxStream& rng, double low, double high) {
+    const double value = std::round((low + (high - low) * rng.uniform()) * 100.0) / 100.0;
+    std::string text = std::to_string(value);
+    text.erase(text.find_last_not_of('0') + 1);
+    if (text.back() == '.') {
+        text.pop_back();
+    }
+    return text;
+}
+
+struct Region {
+    double lat_min, lat_max, lon_min, lon_max;
+};
+
+// Asset and peril locations cluster in a few industrial regions
+constexpr Region REGIONS[] = {
+    {47.0, 48.0, 7.0, 9.5},      // Swiss plateau
+    {50.5, 51.8, 6.0, 8.0},      // Rhine-Ruhr
+    {45.0, 45.8, 8.5, 12.0},     // Po valley
+    {51.8, 53.0, 4.0, 6.0},      // Randstad
+};
+
+} // namespace
+
+void WorkloadSpec::validate() const {
+    if (line_items < 2 || drivers == 0 || drivers >= line_items) {
+        throw std::invalid_argument("WorkloadSpec: need 0 < drivers < line_items");
+    }
+    if (depth < 2 || depth - 1 > line_items - drivers) {
+        throw std::invalid_argument("WorkloadSpec: depth must be at least 2 and at most one level per formula");
+    }
+    if (max_fan_in == 0 || periods == 0 || scenarios == 0 || entities == 0) {
+        throw std::invalid_argument("WorkloadSpec: fan-in, periods, scenarios and entities must be positive");
+    }
+    if (entities > 1 && entity_fan_out == 0) {
+        throw std::invalid_argument("WorkloadSpec: a hierarchy of several entities needs entity_fan_out > 0");
+    }
+    if (prior_share < 0.0 || prior_share > 1.0 || override_share < 0.0 || override_share > 1.0) {
+        throw std::invalid_argument("WorkloadSpec: shares must be in [0, 1]");
+    }
+}
+
+WorkloadGenerator::WorkloadGenerator(WorkloadSpec spec) : spec_(std::move(spec)) {
+    spec_.validate();
+}
+
+std::string WorkloadGenerator::code(const std::string& prefix, size_t index) {
+    std::string letters;
+    do {
+        letters.insert(letters.begin(), static_cast<char>('A' + index % 26));
+        index /= 26;
+    } while (index > 0);
+    return prefix + "_" + letters;
+}
+
+void WorkloadGenerator::create_schema(database::IDatabase& db) {
+    db.execute_raw(
+        "CREATE TABLE IF NOT EXISTS statement_template (template_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "  code TEXT UNIQUE NOT NULL, statement_type TEXT, industry TEXT, version TEXT NOT NULL, "
+        "  json_structure TEXT NOT NULL, is_active INTEGER NOT NULL DEFAULT 1, created_at TEXT, updated_at TEXT);"
+        "CREATE TABLE IF NOT EXISTS scenario (scenario_id INTEGER PRIMARY KEY, code TEXT UNIQUE, name TEXT, "
+        "  parent_scenario_id INTEGER);"
+        "CREATE TABLE IF NOT EXISTS period (period_id INTEGER PRIMARY KEY AUTOINCREMENT, start_date TEXT, "
+        "  end_date TEXT, days_in_period INTEGER, period_type TEXT, period_index INTEGER, label TEXT);"
+        "CREATE TABLE IF NOT EXISTS entity (entity_id INTEGER PRIMARY KEY AUTOINCREMENT, code TEXT UNIQUE NOT NULL, "
+        "  name TEXT, parent_entity_id INTEGER, granularity_level TEXT);"
+        "CREATE TABLE IF NOT EXISTS scenario_drivers (entity_id TEXT, scenario_id INTEGER, period_id INTEGER, "
+        "  driver_code TEXT, value REAL, unit_code TEXT);"
+        "CREATE INDEX IF NOT EXISTS idx_scenario_drivers ON scenario_drivers(entity_id, scenario_id, period_id);"
+        "CREATE TABLE IF NOT EXISTS unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "CREATE TABLE IF NOT EXISTS fx_rate (scenario_id INTEGER, period_id INTEGER, from_currency TEXT, "
+        "  to_currency TEXT, rate_type TEXT, rate REAL);"
+        "CREATE VIEW IF NOT EXISTS v_fx_rates AS SELECT * FROM fx_rate;"
+        "CREATE TABLE IF NOT EXISTS scenario_action (scenario_action_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "  scenario_id INTEGER, action_code TEXT, trigger_type TEXT, trigger_condition TEXT, "
+        "  trigger_period INTEGER, start_period INTEGER, end_period INTEGER, trigger_sticky INTEGER, "
+        "  capex REAL DEFAULT 0, opex_annual REAL DEFAULT 0, emission_reduction_annual REAL DEFAULT 0, "
+        "  financial_transformations TEXT, carbon_transformations TEXT, notes TEXT DEFAULT '');"
+        "CREATE TABLE IF NOT EXISTS management_action (action_code TEXT, action_name TEXT, action_category TEXT);"
+        "CREATE TABLE IF NOT EXISTS validation_rule (rule_code TEXT, rule_name TEXT, rule_type TEXT, "
+        "  description TEXT, formula TEXT, required_line_items TEXT, tolerance REAL, severity TEXT, "
+        "  is_active INTEGER);"
+        "CREATE TABLE IF NOT EXISTS template_validation_rule (template_code TEXT, rule_code TEXT, is_enabled INTEGER);"
+        "CREATE TABLE IF NOT EXISTS asset_exposure (asset_id INTEGER PRIMARY KEY, asset_code TEXT NOT NULL UNIQUE, "
+        "  asset_name TEXT NOT NULL, asset_type TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL, "
+        "  entity_code TEXT, replacement_value REAL NOT NULL, replacement_currency TEXT NOT NULL DEFAULT 'EUR', "
+        "  inventory_value REAL DEFAULT 0, inventory_currency TEXT DEFAULT 'EUR', annual_revenue REAL DEFAULT 0, "
+        "  revenue_currency TEXT DEFAULT 'EUR', is_active INTEGER DEFAULT 1);"
+        "CREATE TABLE IF NOT EXISTS physical_peril (peril_id INTEGER PRIMARY KEY, scenario_id INTEGER NOT NULL, "
+        "  peril_type TEXT NOT NULL, peril_code TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL, "
+        "  intensity REAL NOT NULL, intensity_unit TEXT NOT NULL, start_period INTEGER NOT NULL, "
+        "  end_period INTEGER, radius_km REAL DEFAULT 0, description TEXT);"
+        "CREATE TABLE IF NOT EXISTS damage_function_definition (damage_function_id INTEGER PRIMARY KEY, "
+        "  function_code TEXT NOT NULL UNIQUE, function_name TEXT NOT NULL, peril_type TEXT NOT NULL, "
+        "  damage_target TEXT NOT NULL, function_type TEXT NOT NULL DEFAULT 'PIECEWISE_LINEAR', "
+        "  curve_definition TEXT NOT NULL, description TEXT);"
+        "CREATE TABLE IF NOT EXISTS physical_risk_damage (scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL, "
+        "  asset_id INTEGER NOT NULL, peril_id INTEGER, distance_km REAL NOT NULL, "
+        "  adjusted_intensity REAL NOT NULL, ppe_loss REAL NOT NULL, inventory_loss REAL NOT NULL, "
+        "  bi_loss REAL NOT NULL, currency TEXT NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS physical_event (event_id INTEGER PRIMARY KEY, catalogue_code TEXT NOT NULL, "
+        "  peril_type TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL, intensity REAL NOT NULL, "
+        "  radius_km REAL DEFAULT 0, annual_rate REAL NOT NULL, description TEXT);"
+    );
+}
+
+std::vector<size_t> WorkloadGenerator::level_sizes() const {
+    // Formulas spread evenly over levels 1 .. depth-1
+    const size_t formulas = spec_.line_items - spec_.drivers;
+    const size_t levels = spec_.depth - 1;
+    std::vector<size_t> sizes(spec_.depth);
+    sizes[0] = spec_.drivers;
+    for (size_t level = 1; level < spec_.depth; ++level) {
+        sizes[level] = formulas / levels + (level - 1 < formulas % levels ? 1 : 0);
+    }
+    return sizes;
+}
+
+std::string WorkloadGenerator::template_json() const {
+    core::PhiloxStream rng(spec_.seed, TEMPLATE);
+    static const char* const STATEMENTS[] = {"pl", "bs", "cf"};
+
+    nlohmann::json items = nlohmann::json::array();
+    std::vector<size_t> level_start;   // First line item index of each level
+    size_t next = 0;
+    for (size_t size : level_sizes()) {
+        level_start.push_back(next);
+        next += size;
+    }
+    level_start.push_back(next);
+
+    for (size_t level = 0; level < spec_.depth; ++level) {
+        for (size_t i = level_start[level]; i < level_start[level + 1]; ++i) {
+            const std::string item = code("LI", i);
+            nlohmann::json line = {
+                {"code", item},
+                {"display_name", "Synthetic line item " + std::to_string(i)},
+                {"statement_type", STATEMENTS[pick(rng, 3)]},
+                {"level", level},
+            };
+            if (level == 0) {
+                line["formula"] = nullptr;
+                line["base_value_source"] = "driver:" + code("DRV", i);
+                line["is_computed"] = false;
+                items.push_back(std::move(line));
+                continue;
+            }
+
+            // One input from the level below fixes the depth, the rest from any lower level
+            const size_t fan_in = 1 + pick(rng, spec_.max_fan_in);
+            std::string formula;
+            for (size_t k = 0; k < fan_in; ++k) {
+                const size_t from = (k == 0) ? level - 1 : pick(rng, level);
+                const size_t input = level_start[from] + pick(rng, level_start[from + 1] - level_start[from]);
+                const std::string term = code("LI", input) + " * " + coefficient(rng, 0.05, 0.6);
+                if (k == 0) {
+                    formula = term;
+                } else {
+                    formula += (rng.uniform() < 0.7 ? " + " : " - ") + term;
+                }
+            }
+            const double shape = rng.uniform();
+            if (shape < 0.1) {
+                formula = "MAX(0, " + formula + ")";
+            } else if (shape < 0.15) {
+                formula = "MIN(" + formula + ", " + code("LI", level_start[level - 1]) + ")";
+            }
+            if (rng.uniform() < spec_.prior_share) {
+                formula = item + "[t-1] * " + coefficient(rng, 0.5, 0.95) + " + " + formula;   // Accumulator
+            }
+            line["formula"] = formula;
+            line["is_computed"] = true;
+            items.push_back(std::move(line));
+        }
+    }
+
+    nlohmann::json tmpl = {
+        {"template_code", spec_.template_code},
+        {"template_name", "Synthetic workload"},
+        {"statement_type", "unified"},
+        {"description", "Generated by WorkloadGenerator (seed " + std::to_string(spec_.seed) + ")"},
+        {"version", "1.0"},
+        {"line_items", std::move(items)},
+    };
+    return tmpl.dump();
+}
+
+Workload WorkloadGenerator::generate(database::IDatabase& db) const {
+    create_schema(db);
+
+    Workload workload;
+    workload.template_code = spec_.template_code;
+    workload.levels = spec_.depth;
+
+    db.begin_transaction();
+    try {
+        db.execute_update(
+            "INSERT INTO unit_definition (unit_code, unit_name, unit_category, conversion_type, "
+            "static_conversion_factor, base_unit_code, display_symbol, description, is_active) "
+            "SELECT 'EUR', 'Euro', 'CURRENCY', 'STATIC', 1.0, 'EUR', 'EUR', '', 1 "
+            "WHERE NOT EXISTS (SELECT 1 FROM unit_definition WHERE unit_code = 'EUR')", {});
+        auto tmpl = core::StatementTemplate::load_from_json(template_json());
+        tmpl->save_to_database(&db);
+        for (const auto& item : tmpl->get_line_items()) {
+            if (item.formula && item.formula->find(item.code + "[t-1]") != std::string::npos) {
+                workload.opening.line_items[item.code] = 0.0;
+            }
+        }
+
+        workload.period_ids = PeriodSetup::create_monthly_periods(&db, spec_.start_date,
+                                                                  static_cast<int>(spec_.periods));
+        workload.scenario_ids = write_scenarios(db);
+        workload.leaf_entities = write_entities(db, workload.root_entity);
+        workload.driver_rows = write_drivers(db, workload.leaf_entities, workload.scenario_ids, workload.period_ids);
+        write_physical_risk(db, workload.leaf_entities, workload.scenario_ids, workload.period_ids);
+        db.commit();
+    } catch (...) {
+        db.rollback();
+        throw;
+    }
+    return workload;
+}
+
+std::vector<ScenarioID> WorkloadGenerator::write_scenarios(database::IDatabase& db) const {
+    std::vector<ScenarioID> ids;
+    std::vector<ParamMap> rows;
+    for (size_t s = 0; s < spec_.scenarios; ++s) {
+        const ScenarioID id = static_cast<ScenarioID>(s + 1);
+        ParamMap row = {{"id", id}, {"code", spec_.template_code + (s == 0 ? "_BASE" : "_S" + std::to_string(s))},
+                        {"parent", nullptr}};
+        if (s > 0) {
+            row["parent"] = ids.front();
+        }
+        row["name"] = std::get<std::string>(row["code"]);
+        rows.push_back(std::move(row));
+        ids.push_back(id);
+    }
+    db.execute_batch("INSERT INTO scenario (scenario_id, code, name, parent_scenario_id) "
+                     "VALUES (:id, :code, :name, :parent)", rows);
+    return ids;
+}
+
+std::vector<EntityID> WorkloadGenerator::write_entities(database::IDatabase& db, EntityID& root) const {
+    // Breadth-first: entity i's parent is entity (i - 1) / fan_out
+    std::vector<size_t> children(spec_.entities, 0);
+    std::vector<ParamMap> rows;
+    for (size_t i = 0; i < spec_.entities; ++i) {
+        ParamMap row = {{"code", code("ENT", i)}, {"name", "Synthetic entity " + std::to_string(i)},
+                        {"parent", nullptr}, {"level", i == 0 ? "group" : "entity"}};
+        if (i > 0) {
+            const size_t parent = (i - 1) / spec_.entity_fan_out;
+            ++children[parent];
+            row["parent"] = code("ENT", parent);
+        }
+        rows.push_back(std::move(row));
+    }
+    db.execute_batch("INSERT INTO entity (code, name, parent_entity_id, granularity_level) "
+                     "VALUES (:code, :name, (SELECT entity_id FROM entity WHERE code = :parent), :level)", rows);
+
+    root = code("ENT", 0);
+    std::vector<EntityID> leaves;
+    for (size_t i = 0; i < spec_.entities; ++i) {
+        if (children[i] == 0) {
+            leaves.push_back(code("ENT", i));
+        }
+    }
+    return leaves;
+}
+
+size_t WorkloadGenerator::write_drivers(database::IDatabase& db, const std::vector<EntityID>& leaves,
+                                        const std::vector<ScenarioID>& scenario_ids,
+                                        const std::vector<PeriodID>& period_ids) const {
+    core::PhiloxStream rng(spec_.seed, DRIVERS);
+
+    // Per driver: a log-normal level and a monthly growth rate; per entity: a size
+    std::vector<double> level(spec_.drivers);
+    std::vector<double> growth(spec_.drivers);
+    for (size_t d = 0; d < spec_.drivers; ++d) {
+        level[d] = 1000.0 * std::exp(1.5 * rng.normal());
+        growth[d] = 0.005 + 0.01 * rng.normal();
+    }
+    std::vector<double> size(leaves.size());
+    for (auto& s : size) {
+        s = std::exp(0.5 * rng.normal());
+    }
+
+    const std::string sql = "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, "
+                            "unit_code) VALUES (:entity, :scenario, :period, :code, :value, 'EUR')";
+    std::vector<ParamMap> rows;
+    size_t written = 0;
+    for (size_t s = 0; s < scenario_ids.size(); ++s) {
+        // Children of the base scenario inherit it and shock part of the drivers
+        std::vector<double> shock(spec_.drivers, 0.0);
+        for (size_t d = 0; s > 0 && d < spec_.drivers; ++d) {
+            shock[d] = rng.uniform() < spec_.override_share ? 0.2 * rng.normal() : 0.0;
+        }
+        for (size_t e = 0; e < leaves.size(); ++e) {
+            for (size_t p = 0; p < period_ids.size(); ++p) {
+                for (size_t d = 0; d < spec_.drivers; ++d) {
+                    if (s > 0 && shock[d] == 0.0) {
+                        continue;
+                    }
+                    const double value = level[d] * size[e] * std::pow(1.0 + growth[d], static_cast<double>(p)) *
+                                         (1.0 + shock[d]);
+                    rows.push_back({{"entity", leaves[e]}, {"scenario", scenario_ids[s]},
+                                    {"period", period_ids[p]}, {"code", code("DRV", d)},
+                                    {"value", std::round(value * 100.0) / 100.0}});
+                }
+            }
+            if (rows.size() >= 10000) {
+                written += static_cast<size_t>(db.execute_batch(sql, rows));
+                rows.clear();
+            }
+        }
+    }
+    written += static_cast<size_t>(db.execute_batch(sql, rows));
+    return written;
+}
+
+void WorkloadGenerator::write_physical_risk(database::IDatabase& db, const std::vector<EntityID>& leaves,
+                                            const std::vector<ScenarioID>& scenario_ids,
+                                            const std::vector<PeriodID>& period_ids) const {
+    db.execute_raw(
+        "INSERT OR IGNORE INTO damage_function_definition (function_code, function_name, peril_type, "
+        "damage_target, curve_definition, description) VALUES "
+        "('SYN_FLOOD_PPE', 'Flood PPE', 'FLOOD', 'PPE', '[[0,0],[0.5,0.1],[1,0.25],[2,0.5],[4,0.8],[6,1]]', "
+        "  'Flood depth (m) to share of replacement value'),"
+        "('SYN_FLOOD_INV', 'Flood inventory', 'FLOOD', 'INVENTORY', '[[0,0],[0.3,0.2],[1,0.6],[2,1]]', "
+        "  'Flood depth (m) to share of inventory'),"
+        "('SYN_FLOOD_BI', 'Flood BI', 'FLOOD', 'BI', '[[0,0],[0.5,5],[1,20],[3,60]]', "
+        "  'Flood depth (m) to days of interruption'),"
+        "('SYN_WIND_PPE', 'Wind PPE', 'WINDSTORM', 'PPE', '[[0,0],[25,0],[35,0.05],[45,0.2],[60,0.6]]', "
+        "  'Gust speed (m/s) to share of replacement value'),"
+        "('SYN_WIND_BI', 'Wind BI', 'WINDSTORM', 'BI', '[[0,0],[30,0],[40,3],[60,14]]', "
+        "  'Gust speed (m/s) to days of interruption');");
+
+    core::PhiloxStream asset_rng(spec_.seed, ASSETS);
+    static const char* const ASSET_TYPES[] = {"FACTORY", "WAREHOUSE", "OFFICE", "DATA_CENTER"};
+    std::vector<ParamMap> rows;
+    for (size_t a = 0; a < spec_.assets; ++a) {
+        const Region& region = REGIONS[pick(asset_rng, std::size(REGIONS))];
+        const double value = std::round(5e6 * std::exp(asset_rng.normal()));
+        rows.push_back({
+            {"code", code("AST", a)},
+            {"name", "Synthetic asset " + std::to_string(a)},
+            {"type", ASSET_TYPES[pick(asset_rng, std::size(ASSET_TYPES))]},
+            {"lat", region.lat_min + (region.lat_max - region.lat_min) * asset_rng.uniform()},
+            {"lon", region.lon_min + (region.lon_max - region.lon_min) * asset_rng.uniform()},
+            {"entity", leaves[a % leaves.size()]},
+            {"value", value},
+            {"inventory", std::round(value * 0.2 * asset_rng.uniform())},
+            {"revenue", std::round(value * (0.5 + asset_rng.uniform()))},
+        });
+    }
+    db.execute_batch(
+        "INSERT INTO asset_exposure (asset_code, asset_name, asset_type, latitude, longitude, entity_code, "
+        "replacement_value, replacement_currency, inventory_value, inventory_currency, annual_revenue, "
+        "revenue_currency) VALUES (:code, :name, :type, :lat, :lon, :entity, :value, 'EUR', :inventory, 'EUR', "
+        ":revenue, 'EUR')", rows);
+
+    core::PhiloxStream peril_rng(spec_.seed, PERILS);
+    rows.clear();
+    for (ScenarioID scenario_id : scenario_ids) {
+        for (size_t p = 0; p < spec_.perils; ++p) {
+            const Region& region = REGIONS[pick(peril_rng, std::size(REGIONS))];
+            const bool flood = peril_rng.uniform() < 0.6;
+            const size_t start = pick(peril_rng, period_ids.size());
+            ParamMap row = {
+                {"scenario", scenario_id},
+                {"type", flood ? "FLOOD" : "WINDSTORM"},
+                {"code", code(flood ? "FLD" : "WND", p) + "_S" + std::to_string(scenario_id)},
+                {"lat", region.lat_min + (region.lat_max - region.lat_min) * peril_rng.uniform()},
+                {"lon", region.lon_min + (region.lon_max - region.lon_min) * peril_rng.uniform()},
+                {"intensity", flood ? 0.2 + 3.0 * peril_rng.uniform() : 25.0 + 30.0 * peril_rng.uniform()},
+                {"unit", flood ? "m" : "m/s"},
+                {"start", period_ids[start]},
+                {"end", period_ids[std::min(start + pick(peril_rng, 3), period_ids.size() - 1)]},
+                {"radius", flood ? 5.0 + 20.0 * peril_rng.uniform() : 30.0 + 120.0 * peril_rng.uniform()},
+            };
+            rows.push_back(std::move(row));
+        }
+    }
+    db.execute_batch(
+        "INSERT INTO physical_peril (scenario_id, peril_type, peril_code, latitude, longitude, intensity, "
+        "intensity_unit, start_period, end_period, radius_km, description) VALUES (:scenario, :type, :code, "
+        ":lat, :lon, :intensity, :unit, :start, :end, :radius, 'Synthetic peril')", rows);
+}
+
+} // namespace orchestration
+} // namespace finmodel
@@ -6,6 +6,15 @@
 
 namespace physical_risk {
 
+void IDamageFunction::calculate_batch(std::span<const double> intensities, std::span<double> out) const {
+    if (out.size() != intensities.size()) {
+        throw std::invalid_argument("calculate_batch: output size differs from input size");
+    }
+    for (size_t i = 0; i < intensities.size(); ++i) {
+        out[i] = calculate(intensities[i]);
+    }
+}
+
 // PiecewiseLinearDamageFunction implementation
 
 PiecewiseLinearDamageFunction::PiecewiseLinearDamageFunction(
@@ -13,6 +22,12 @@ PiecewiseLinearDamageFunction::PiecewiseLinearDamageFunction(
     std::string description
 ) : curve_points_(std::move(curve_points)), description_(std::move(description)) {
     validate_curve_points();
+    xs_.reserve(curve_points_.size());
+    ys_.reserve(curve_points_.size());
+    for (const auto& [intensity, damage] : curve_points_) {
+        xs_.push_back(intensity);
+        ys_.push_back(damage);
+    }
 }
 
 void PiecewiseLinearDamageFunction::validate_curve_points() const {
@@ -39,39 +54,48 @@ double PiecewiseLinearDamageFunction::calculate(double intensity) const {
     if (curve_points_.empty()) {
         return 0.0;
     }
+    return interpolate(intensity);
+}
+
+void PiecewiseLinearDamageFunction::calculate_batch(std::span<const double> intensities,
+                                                    std::span<double> out) const {
+    if (out.size() != intensities.size()) {
+        throw std::invalid_argument("calculate_batch: output size differs from input size");
+    }
+    for (size_t i = 0; i < intensities.size(); ++i) {
+        out[i] = interpolate(intensities[i]);
+    }
+}
 
+double PiecewiseLinearDamageFunction::interpolate(double intensity) const {
     // Before first point: use first point's damage value (constant extrapolation)
-    if (intensity <= curve_points_.front().first) {
-        return curve_points_.front().second;
+    if (intensity <= xs_.front()) {
+        return ys_.front();
     }
 
     // After last point: use last point's damage value (constant extrapolation)
-    if (intensity >= curve_points_.back().first) {
-        return curve_points_.back().second;
+    if (intensity >= xs_.back()) {
+        return ys_.back();
     }
 
-    // Find the two points to interpolate between
-    for (size_t i = 1; i < curve_points_.size(); ++i) {
-        if (intensity <= curve_points_[i].first) {
-            // Interpolate between points i-1 and i
-            double x0 = curve_points_[i-1].first;
-            double y0 = curve_points_[i-1].second;
-            double x1 = curve_points_[i].first;
-            double y1 = curve_points_[i].second;
-
-            // Linear interpolation: y = y0 + (y1-y0) * (x-x0) / (x1-x0)
-            if (std::abs(x1 - x0) < 1e-10) {
-                // Points are essentially at same x-coordinate
-                return y0;
-            }
-
-            double t = (intensity - x0) / (x1 - x0);
-            return y0 + t * (y1 - y0);
-        }
+    // First point at or above the intensity; interpolate between it and the previous one
+    const size_t i = static_cast<size_t>(std::lower_bound(xs_.begin(), xs_.end(), intensity) - xs_.begin());
+    if (i == xs_.size()) {
+        return ys_.back();   // NaN intensity, as the previous scan
+    }
+    const double x0 = xs_[i - 1];
+    const double y0 = ys_[i - 1];
+    const double x1 = xs_[i];
+    const double y1 = ys_[i];
+
+    // Linear interpolation: y = y0 + (y1-y0) * (x-x0) / (x1-x0)
+    if (std::abs(x1 - x0) < 1e-10) {
+        // Points are essentially at same x-coordinate
+        return y0;
     }
 
-    // Should never reach here due to earlier bounds checks
-    return curve_points_.back().second;
+    const double t = (intensity - x0) / (x1 - x0);
+    return y0 + t * (y1 - y0);
 }
 
 std::unique_ptr<PiecewiseLinearDamageFunction> PiecewiseLinearDamageFunction::from_json(
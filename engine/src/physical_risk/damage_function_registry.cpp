@@ -1,5 +1,6 @@
 #include "physical_risk/damage_function_registry.h"
 #include "database/result_set.h"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
@@ -9,105 +10,191 @@ DamageFunctionRegistry::DamageFunctionRegistry(finmodel::database::IDatabase* db
     if (!db_) {
         throw std::runtime_error("Database connection is null");
     }
+    reload();
 }
 
-std::unique_ptr<IDamageFunction> DamageFunctionRegistry::load_function_from_db(
-    const std::string& function_code
-) {
+void DamageFunctionRegistry::reload() {
+    // In definition order: when several functions share a peril type and
+    // target, the first one is used
     auto result = db_->execute_query(
-        "SELECT function_type, curve_definition, description "
+        "SELECT function_code, peril_type, damage_target, function_type, curve_definition, description "
         "FROM damage_function_definition "
-        "WHERE function_code = :code",
-        {{"code", function_code}}
+        "ORDER BY damage_function_id",
+        {}
     );
 
-    std::unique_ptr<IDamageFunction> func = nullptr;
+    std::vector<std::unique_ptr<IDamageFunction>> functions;
+    std::unordered_map<std::string, const IDamageFunction*> by_code;
+    std::unordered_map<std::string, PerilTypeId> peril_types;
+    std::vector<Curves> by_peril;
+    std::map<std::pair<PerilTypeId, std::string>, Curves> by_archetype;
+
+    auto intern = [&](const std::string& peril_type) {
+        auto [it, added] = peril_types.emplace(peril_type, static_cast<PerilTypeId>(by_peril.size()));
+        if (added) {
+            Curves none;
+            none.fill(NO_CURVE);
+            by_peril.push_back(none);
+        }
+        return it->second;
+    };
 
-    if (result->next()) {
+    while (result->next()) {
+        std::string function_code = result->get_string("function_code");
+        std::string peril_type = result->get_string("peril_type");
+        std::string damage_target = result->get_string("damage_target");
         std::string function_type = result->get_string("function_type");
         std::string curve_definition = result->get_string("curve_definition");
         std::string description = result->is_null("description") ? "" : result->get_string("description");
 
-        func = DamageFunctionFactory::create(function_type, curve_definition, description);
-
+        std::unique_ptr<IDamageFunction> func;
+        try {
+            func = DamageFunctionFactory::create(function_type, curve_definition, description);
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Damage function '" + function_code + "': " + e.what());
+        }
         if (!func) {
             std::cerr << "Warning: Unknown damage function type '" << function_type
                       << "' for function_code '" << function_code << "'" << std::endl;
+            continue;
         }
-    }
 
-    return func;
-}
+        const auto id = static_cast<CurveId>(functions.size());
+        by_code.emplace(function_code, func.get());
+        functions.push_back(std::move(func));
 
-const IDamageFunction* DamageFunctionRegistry::get_function(const std::string& function_code) {
-    // Check cache first
-    auto it = cache_.find(function_code);
-    if (it != cache_.end()) {
-        return it->second.get();
+        if (auto target = parse_damage_target(damage_target)) {
+            CurveId& slot = by_peril[intern(peril_type)][static_cast<size_t>(*target)];
+            if (slot == NO_CURVE) {
+                slot = id;
+            }
+        }
     }
-
-    // Load from database
-    auto function = load_function_from_db(function_code);
-    if (!function) {
-        return nullptr;
+    result.reset();
+
+    // Location-specific curves (scripts/migrate_add_location_damage_curves.sh)
+    const auto tables = db_->list_tables();
+    if (std::find(tables.begin(), tables.end(), "damage_curve") != tables.end()) {
+        auto curves = db_->execute_query(
+            "SELECT curve_code, peril_type, archetype, value_type, curve_points "
+            "FROM damage_curve ORDER BY curve_id", {});
+        for (auto [curve_code, peril_type, archetype, value_type, curve_points] :
+             curves->rows<std::string, std::string, std::string, std::string, std::string>()) {
+            auto target = parse_damage_target(value_type);
+            if (!target) {
+                continue;
+            }
+            std::unique_ptr<IDamageFunction> func;
+            try {
+                func = PiecewiseLinearDamageFunction::from_json(curve_points);
+            } catch (const std::exception& e) {
+                throw std::runtime_error("Damage curve '" + curve_code + "': " + e.what());
+            }
+
+            const auto id = static_cast<CurveId>(functions.size());
+            by_code.emplace(curve_code, func.get());
+            functions.push_back(std::move(func));
+
+            auto [it, added] = by_archetype.try_emplace({intern(peril_type), std::move(archetype)});
+            if (added) {
+                it->second.fill(NO_CURVE);
+            }
+            CurveId& slot = it->second[static_cast<size_t>(*target)];
+            if (slot == NO_CURVE) {
+                slot = id;
+            }
+        }
     }
 
-    // Store in cache and return
-    const IDamageFunction* ptr = function.get();
-    cache_[function_code] = std::move(function);
-    return ptr;
+    functions_ = std::move(functions);
+    by_code_ = std::move(by_code);
+    peril_types_ = std::move(peril_types);
+    by_peril_ = std::move(by_peril);
+    by_archetype_ = std::move(by_archetype);
+}
+
+const IDamageFunction* DamageFunctionRegistry::get_function(const std::string& function_code) const {
+    auto it = by_code_.find(function_code);
+    return (it != by_code_.end()) ? it->second : nullptr;
 }
 
 const IDamageFunction* DamageFunctionRegistry::get_function_for_peril(
     const std::string& peril_type,
     const std::string& damage_target
-) {
-    // First check if we have a cached result for this peril+target combination
-    std::string peril_key = make_peril_cache_key(peril_type, damage_target);
-    auto it = cache_.find(peril_key);
-    if (it != cache_.end()) {
-        return it->second.get();
-    }
-
-    // Query database for matching function
-    auto result = db_->execute_query(
-        "SELECT function_code, function_type, curve_definition, description "
-        "FROM damage_function_definition "
-        "WHERE peril_type = :peril_type AND damage_target = :damage_target "
-        "LIMIT 1",
-        {{"peril_type", peril_type}, {"damage_target", damage_target}}
-    );
+) const {
+    auto target = parse_damage_target(damage_target);
+    return target ? get_function_for_peril(peril_type_id(peril_type), *target) : nullptr;
+}
 
-    std::unique_ptr<IDamageFunction> func = nullptr;
-    std::string function_code;
+DamageFunctionRegistry::CurveId DamageFunctionRegistry::curve_id(
+    PerilTypeId peril_type,
+    DamageTarget damage_target,
+    const std::string& archetype
+) const {
+    if (!by_archetype_.empty()) {
+        auto it = by_archetype_.find({peril_type, archetype});
+        if (it != by_archetype_.end() && it->second[static_cast<size_t>(damage_target)] != NO_CURVE) {
+            return it->second[static_cast<size_t>(damage_target)];
+        }
+    }
+    return curve_id(peril_type, damage_target);
+}
 
-    if (result->next()) {
-        function_code = result->get_string("function_code");
-        std::string function_type = result->get_string("function_type");
-        std::string curve_definition = result->get_string("curve_definition");
-        std::string description = result->is_null("description") ? "" : result->get_string("description");
+DamageFunctionRegistry::PerilTypeId DamageFunctionRegistry::peril_type_id(const std::string& peril_type) const {
+    auto it = peril_types_.find(peril_type);
+    return (it != peril_types_.end()) ? it->second : UNKNOWN_PERIL;
+}
 
-        func = DamageFunctionFactory::create(function_type, curve_definition, description);
+std::optional<DamageTarget> DamageFunctionRegistry::parse_damage_target(const std::string& damage_target) {
+    if (damage_target == "PPE") {
+        return DamageTarget::PPE;
+    }
+    if (damage_target == "INVENTORY") {
+        return DamageTarget::INVENTORY;
+    }
+    if (damage_target == "BI") {
+        return DamageTarget::BI;
+    }
+    return std::nullopt;
+}
 
-        if (!func) {
-            std::cerr << "Warning: Unknown damage function type '" << function_type
-                      << "' for peril '" << peril_type << "' target '" << damage_target << "'" << std::endl;
+DamageCurveAssignment::DamageCurveAssignment(const DamageFunctionRegistry& registry,
+                                             const std::vector<std::string>& archetypes)
+    : assets_(archetypes.size()), peril_types_(registry.peril_type_count()) {
+    constexpr size_t targets = DAMAGE_TARGET_COUNT;
+    const size_t width = peril_types_ * targets;
+
+    // Resolved once per distinct archetype, then copied to its assets
+    std::unordered_map<std::string, size_t> resolved;
+    std::vector<CurveId> rows;
+    curves_.resize(assets_ * width);
+    for (size_t a = 0; a < assets_; ++a) {
+        auto [it, added] = resolved.emplace(archetypes[a], rows.size());
+        if (added) {
+            for (PerilTypeId peril = 0; peril < peril_types_; ++peril) {
+                for (size_t t = 0; t < targets; ++t) {
+                    rows.push_back(registry.curve_id(peril, static_cast<DamageTarget>(t), archetypes[a]));
+                }
+            }
         }
+        std::copy_n(rows.begin() + static_cast<std::ptrdiff_t>(it->second), width,
+                    curves_.begin() + static_cast<std::ptrdiff_t>(a * width));
     }
 
-    if (!func) {
-        return nullptr;
+    shared_.assign(width, DamageFunctionRegistry::NO_CURVE);
+    for (size_t j = 0; j < width; ++j) {
+        if (resolved.empty()) {
+            shared_[j] = registry.curve_id(static_cast<PerilTypeId>(j / targets), static_cast<DamageTarget>(j % targets));
+            continue;
+        }
+        shared_[j] = rows[j];
+        for (size_t row = width; row < rows.size(); row += width) {
+            if (rows[row + j] != shared_[j]) {
+                shared_[j] = MIXED;
+                break;
+            }
+        }
     }
-
-    // Cache both by function_code and by peril_key
-    const IDamageFunction* ptr = func.get();
-    cache_[peril_key] = std::move(func);
-
-    return ptr;
-}
-
-void DamageFunctionRegistry::clear_cache() {
-    cache_.clear();
 }
 
 } // namespace physical_risk
@@ -0,0 +1,16 @@
+#include "physical_risk/event_simulation.h"
+
+namespace physical_risk {
+
+// LossStatistics implementation
+
+const TailLoss* LossStatistics::at(double return_period) const {
+    for (const auto& t : tail) {
+        if (t.return_period == return_period) {
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace physical_risk
@@ -1,9 +1,23 @@
 #include "physical_risk/geo_utils.h"
+#include <algorithm>
 #include <limits>
 #include <cmath>
 
 namespace physical_risk {
 
+GeoCoordinates::GeoCoordinates(const std::vector<std::pair<double, double>>& locations) {
+    x_.reserve(locations.size());
+    y_.reserve(locations.size());
+    z_.reserve(locations.size());
+    for (const auto& [lat, lon] : locations) {
+        const double lat_rad = lat * M_PI / 180.0;
+        const double lon_rad = lon * M_PI / 180.0;
+        x_.push_back(std::cos(lat_rad) * std::cos(lon_rad));
+        y_.push_back(std::cos(lat_rad) * std::sin(lon_rad));
+        z_.push_back(std::sin(lat_rad));
+    }
+}
+
 double GeoUtils::haversine_distance(double lat1, double lon1, double lat2, double lon2) {
     // Convert all coordinates to radians
     double lat1_rad = to_radians(lat1);
@@ -75,4 +89,51 @@ double GeoUtils::calculate_intensity_with_decay(double base_intensity,
     return base_intensity * decay_factor;
 }
 
+void GeoUtils::haversine_distance_batch(const GeoCoordinates& points,
+                                        const size_t* indices, size_t count,
+                                        double center_lat, double center_lon,
+                                        double* distances_km) {
+    const double lat_rad = to_radians(center_lat);
+    const double lon_rad = to_radians(center_lon);
+    const double cx = std::cos(lat_rad) * std::cos(lon_rad);
+    const double cy = std::cos(lat_rad) * std::sin(lon_rad);
+    const double cz = std::sin(lat_rad);
+    const double* x = points.x();
+    const double* y = points.y();
+    const double* z = points.z();
+
+    // Haversine term a = sin²(angle / 2) = chord² / 4 (vectorizable)
+    for (size_t i = 0; i < count; ++i) {
+        const size_t p = indices[i];
+        const double dx = x[p] - cx;
+        const double dy = y[p] - cy;
+        const double dz = z[p] - cz;
+        distances_km[i] = std::min(0.25 * (dx * dx + dy * dy + dz * dz), 1.0);
+    }
+
+    // As haversine_distance(): 2 atan2(√a, √(1 − a))
+    for (size_t i = 0; i < count; ++i) {
+        const double a = distances_km[i];
+        distances_km[i] = EARTH_RADIUS_KM * 2.0 * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+    }
+}
+
+void GeoUtils::intensity_with_decay_batch(double base_intensity,
+                                          const double* distances_km, size_t count,
+                                          double radius_km,
+                                          double* intensities) {
+    // If no radius specified, intensity doesn't decay
+    if (radius_km <= 0.0) {
+        std::fill(intensities, intensities + count, base_intensity);
+        return;
+    }
+
+    // Linear decay inside the radius, no impact outside
+    const double inverse_radius = 1.0 / radius_km;
+    for (size_t i = 0; i < count; ++i) {
+        const double d = distances_km[i];
+        intensities[i] = (d >= radius_km) ? 0.0 : base_intensity * (1.0 - d * inverse_radius);
+    }
+}
+
 } // namespace physical_risk
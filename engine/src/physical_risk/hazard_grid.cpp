@@ -0,0 +1,354 @@
+#include "physical_risk/hazard_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace physical_risk {
+
+namespace {
+
+constexpr char MAGIC[4] = {'F', 'M', 'H', 'G'};
+constexpr size_t FIXED_HEADER = sizeof(MAGIC) + 5 * sizeof(uint32_t) + 4 * sizeof(double);
+
+constexpr double NO_DATA = std::numeric_limits<double>::quiet_NaN();
+
+/// Values start 8-byte aligned after the band keys
+size_t values_offset(size_t bands) {
+    return (FIXED_HEADER + bands * sizeof(int32_t) + 7) & ~size_t(7);
+}
+
+size_t tiles_along(uint32_t cells, uint32_t tile) {
+    return (static_cast<size_t>(cells) + tile - 1) / tile;
+}
+
+template <typename T>
+T read_at(const uint8_t* data, size_t& pos) {
+    T value;
+    std::memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+template <typename T>
+void put(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/// Smallest spacing between distinct sorted coordinates (1 if there is one)
+double grid_step(std::vector<double> coordinates) {
+    std::sort(coordinates.begin(), coordinates.end());
+    double step = std::numeric_limits<double>::infinity();
+    for (size_t i = 1; i < coordinates.size(); ++i) {
+        const double delta = coordinates[i] - coordinates[i - 1];
+        if (delta > 1e-9) {
+            step = std::min(step, delta);
+        }
+    }
+    return std::isfinite(step) ? step : 1.0;
+}
+
+} // namespace
+
+HazardGrid::HazardGrid(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("HazardGrid: cannot open " + path);
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < FIXED_HEADER) {
+        ::close(fd);
+        throw std::runtime_error("HazardGrid: not a hazard grid file: " + path);
+    }
+    map_size_ = static_cast<size_t>(info.st_size);
+    void* map = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("HazardGrid: cannot map " + path);
+    }
+    map_ = static_cast<const uint8_t*>(map);
+
+    auto invalid = [&](const std::string& why) {
+        ::munmap(const_cast<uint8_t*>(map_), map_size_);
+        map_ = nullptr;
+        return std::runtime_error("HazardGrid: " + path + ": " + why);
+    };
+    if (std::memcmp(map_, MAGIC, sizeof(MAGIC)) != 0) {
+        throw invalid("not a hazard grid file");
+    }
+    size_t pos = sizeof(MAGIC);
+    const auto version = read_at<uint32_t>(map_, pos);
+    if (version != FORMAT_VERSION) {
+        throw invalid("format version " + std::to_string(version) + ", expected " +
+                      std::to_string(FORMAT_VERSION));
+    }
+    spec_.rows = read_at<uint32_t>(map_, pos);
+    spec_.cols = read_at<uint32_t>(map_, pos);
+    const auto bands = read_at<uint32_t>(map_, pos);
+    tile_ = read_at<uint32_t>(map_, pos);
+    spec_.lat_origin = read_at<double>(map_, pos);
+    spec_.lon_origin = read_at<double>(map_, pos);
+    spec_.lat_step = read_at<double>(map_, pos);
+    spec_.lon_step = read_at<double>(map_, pos);
+    if (spec_.rows == 0 || spec_.cols == 0 || bands == 0 || tile_ == 0 ||
+        !(spec_.lat_step > 0.0) || !(spec_.lon_step > 0.0)) {
+        throw invalid("damaged header");
+    }
+
+    // Compare sizes without overflow: the header may be damaged
+    const size_t offset = values_offset(bands);
+    const long double expected = static_cast<long double>(offset) +
+        static_cast<long double>(tiles_along(spec_.rows, tile_)) * tiles_along(spec_.cols, tile_) *
+        bands * tile_ * tile_ * sizeof(float);
+    if (expected != static_cast<long double>(map_size_)) {
+        throw invalid("size doesn't match its header");
+    }
+    for (uint32_t b = 0; b < bands; ++b) {
+        band_keys_.push_back(read_at<int32_t>(map_, pos));
+    }
+    tile_cols_ = static_cast<uint32_t>(tiles_along(spec_.cols, tile_));
+    values_ = map_ + offset;
+}
+
+HazardGrid::~HazardGrid() {
+    if (map_) {
+        ::munmap(const_cast<uint8_t*>(map_), map_size_);
+    }
+}
+
+size_t HazardGrid::band_index(int key) const {
+    return static_cast<size_t>(std::find(band_keys_.begin(), band_keys_.end(), key) - band_keys_.begin());
+}
+
+double HazardGrid::value(uint32_t row, uint32_t col, size_t band) const {
+    const size_t tile_cells = static_cast<size_t>(tile_) * tile_;
+    const size_t tile_index = static_cast<size_t>(row / tile_) * tile_cols_ + col / tile_;
+    const size_t cell = static_cast<size_t>(row % tile_) * tile_ + col % tile_;
+    float v;
+    std::memcpy(&v, values_ + ((tile_index * bands() + band) * tile_cells + cell) * sizeof(float), sizeof(v));
+    return v;
+}
+
+double HazardGrid::cell_value(double lat, double lon, size_t band) const {
+    if (band >= bands()) {
+        throw std::out_of_range("HazardGrid: no band " + std::to_string(band));
+    }
+    const double y = std::round((lat - spec_.lat_origin) / spec_.lat_step);
+    const double x = std::round((lon - spec_.lon_origin) / spec_.lon_step);
+    if (!(y >= 0.0 && y < spec_.rows && x >= 0.0 && x < spec_.cols)) {
+        return NO_DATA;   // Outside, or not a finite location
+    }
+    return value(static_cast<uint32_t>(y), static_cast<uint32_t>(x), band);
+}
+
+double HazardGrid::sample(double lat, double lon, size_t band) const {
+    if (band >= bands()) {
+        throw std::out_of_range("HazardGrid: no band " + std::to_string(band));
+    }
+    double y = (lat - spec_.lat_origin) / spec_.lat_step;
+    double x = (lon - spec_.lon_origin) / spec_.lon_step;
+    if (!(y >= -0.5 && y < spec_.rows - 0.5 && x >= -0.5 && x < spec_.cols - 0.5)) {
+        return NO_DATA;
+    }
+
+    // Surrounding centers; half a cell beyond the outermost ones, the edge cells
+    y = std::clamp(y, 0.0, spec_.rows - 1.0);
+    x = std::clamp(x, 0.0, spec_.cols - 1.0);
+    const auto r0 = static_cast<uint32_t>(y);
+    const auto c0 = static_cast<uint32_t>(x);
+    const uint32_t r1 = std::min(r0 + 1, spec_.rows - 1);
+    const uint32_t c1 = std::min(c0 + 1, spec_.cols - 1);
+    const double fy = y - r0;
+    const double fx = x - c0;
+
+    double sum = 0.0;
+    double weights = 0.0;
+    auto add = [&](uint32_t r, uint32_t c, double w) {
+        const double v = value(r, c, band);
+        if (w > 0.0 && !std::isnan(v)) {
+            sum += w * v;
+            weights += w;
+        }
+    };
+    add(r0, c0, (1.0 - fy) * (1.0 - fx));
+    add(r0, c1, (1.0 - fy) * fx);
+    add(r1, c0, fy * (1.0 - fx));
+    add(r1, c1, fy * fx);
+    return (weights > 0.0) ? sum / weights : NO_DATA;
+}
+
+void HazardGrid::sample_batch(const double* lats, const double* lons, size_t count, size_t band,
+                              bool bilinear, double* out) const {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = bilinear ? sample(lats[i], lons[i], band) : cell_value(lats[i], lons[i], band);
+    }
+}
+
+void HazardGrid::write(const std::string& path, const HazardGridSpec& spec,
+                       const std::vector<int>& band_keys, const std::vector<float>& values,
+                       uint32_t tile) {
+    if (spec.rows == 0 || spec.cols == 0 || !(spec.lat_step > 0.0) || !(spec.lon_step > 0.0) ||
+        band_keys.empty() || tile == 0) {
+        throw std::invalid_argument("HazardGrid::write: empty grid, band list or tile");
+    }
+    const size_t cells = static_cast<size_t>(spec.rows) * spec.cols;
+    if (values.size() != cells * band_keys.size()) {
+        throw std::invalid_argument("HazardGrid::write: " + std::to_string(values.size()) +
+                                    " values for " + std::to_string(cells * band_keys.size()) + " cells");
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("HazardGrid::write: cannot create " + path);
+    }
+    write_header(out, spec, band_keys, tile);
+
+    // One block per (tile, band); cells beyond the grid's edge have no data
+    std::vector<float> block(static_cast<size_t>(tile) * tile);
+    for (size_t tr = 0; tr < tiles_along(spec.rows, tile); ++tr) {
+        for (size_t tc = 0; tc < tiles_along(spec.cols, tile); ++tc) {
+            for (size_t band = 0; band < band_keys.size(); ++band) {
+                std::fill(block.begin(), block.end(), std::numeric_limits<float>::quiet_NaN());
+                for (size_t r = 0; r < tile && tr * tile + r < spec.rows; ++r) {
+                    for (size_t c = 0; c < tile && tc * tile + c < spec.cols; ++c) {
+                        block[r * tile + c] = values[(band * spec.rows + tr * tile + r) * spec.cols + tc * tile + c];
+                    }
+                }
+                out.write(reinterpret_cast<const char*>(block.data()),
+                          static_cast<std::streamsize>(block.size() * sizeof(float)));
+            }
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("HazardGrid::write: cannot write " + path);
+    }
+}
+
+void HazardGrid::write_header(std::ostream& out, const HazardGridSpec& spec,
+                              const std::vector<int>& band_keys, uint32_t tile) {
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, FORMAT_VERSION);
+    put(out, spec.rows);
+    put(out, spec.cols);
+    put(out, static_cast<uint32_t>(band_keys.size()));
+    put(out, tile);
+    put(out, spec.lat_origin);
+    put(out, spec.lon_origin);
+    put(out, spec.lat_step);
+    put(out, spec.lon_step);
+    for (int key : band_keys) {
+        put(out, static_cast<int32_t>(key));
+    }
+    const size_t header = FIXED_HEADER + band_keys.size() * sizeof(int32_t);
+    const std::vector<char> padding(values_offset(band_keys.size()) - header, 0);
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+}
+
+size_t HazardGrid::block_offset(size_t bands, uint32_t tile, size_t tile_index, size_t band) {
+    return values_offset(bands) + (tile_index * bands + band) * tile * tile * sizeof(float);
+}
+
+HazardGridSpec HazardGrid::from_csv(const std::string& csv_path, const std::string& grid_path, uint32_t tile) {
+    std::ifstream in(csv_path);
+    if (!in) {
+        throw std::runtime_error("HazardGrid::from_csv: cannot open " + csv_path);
+    }
+    auto split = [](const std::string& line) {
+        std::vector<std::string> fields;
+        std::istringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            fields.push_back(field);
+        }
+        return fields;
+    };
+
+    // Header: latitude, longitude and period_<N>_intensity... columns
+    std::string line;
+    std::getline(in, line);
+    const std::vector<std::string> header = split(line);
+    size_t lat_column = header.size();
+    size_t lon_column = header.size();
+    std::map<int, size_t> band_columns;   // Band key → column
+    for (size_t i = 0; i < header.size(); ++i) {
+        const std::string& name = header[i];
+        if (name == "latitude") {
+            lat_column = i;
+        } else if (name == "longitude") {
+            lon_column = i;
+        } else if (name.rfind("period_", 0) == 0) {
+            const size_t end = name.find('_', 7);
+            if (end != std::string::npos && end > 7 && name.compare(end + 1, 9, "intensity") == 0) {
+                band_columns.emplace(std::stoi(name.substr(7, end - 7)), i);
+            }
+        }
+    }
+    if (lat_column == header.size() || lon_column == header.size() || band_columns.empty()) {
+        throw std::runtime_error("HazardGrid::from_csv: " + csv_path +
+                                 " needs latitude, longitude and period_<N>_intensity columns");
+    }
+
+    std::vector<double> lats;
+    std::vector<double> lons;
+    std::vector<std::vector<float>> intensities(band_columns.size());
+    size_t line_number = 1;
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+        const std::vector<std::string> fields = split(line);
+        try {
+            lats.push_back(std::stod(fields.at(lat_column)));
+            lons.push_back(std::stod(fields.at(lon_column)));
+            size_t band = 0;
+            for (const auto& [key, column] : band_columns) {
+                intensities[band++].push_back(std::stof(fields.at(column)));
+            }
+        } catch (const std::exception&) {
+            throw std::runtime_error("HazardGrid::from_csv: " + csv_path + " line " +
+                                     std::to_string(line_number) + " is malformed");
+        }
+    }
+    if (lats.empty()) {
+        throw std::runtime_error("HazardGrid::from_csv: " + csv_path + " has no points");
+    }
+
+    HazardGridSpec spec;
+    spec.lat_step = grid_step(lats);
+    spec.lon_step = grid_step(lons);
+    spec.lat_origin = *std::min_element(lats.begin(), lats.end());
+    spec.lon_origin = *std::min_element(lons.begin(), lons.end());
+    const double lat_max = *std::max_element(lats.begin(), lats.end());
+    const double lon_max = *std::max_element(lons.begin(), lons.end());
+    spec.rows = static_cast<uint32_t>(std::llround((lat_max - spec.lat_origin) / spec.lat_step)) + 1;
+    spec.cols = static_cast<uint32_t>(std::llround((lon_max - spec.lon_origin) / spec.lon_step)) + 1;
+
+    const size_t cells = static_cast<size_t>(spec.rows) * spec.cols;
+    std::vector<float> values(cells * band_columns.size(), std::numeric_limits<float>::quiet_NaN());
+    for (size_t p = 0; p < lats.size(); ++p) {
+        const auto row = static_cast<size_t>(std::llround((lats[p] - spec.lat_origin) / spec.lat_step));
+        const auto col = static_cast<size_t>(std::llround((lons[p] - spec.lon_origin) / spec.lon_step));
+        for (size_t band = 0; band < band_columns.size(); ++band) {
+            values[(band * spec.rows + row) * spec.cols + col] = intensities[band][p];
+        }
+    }
+
+    std::vector<int> band_keys;
+    for (const auto& [key, column] : band_columns) {
+        band_keys.push_back(key);
+    }
+    write(grid_path, spec, band_keys, values, tile);
+    return spec;
+}
+
+} // namespace physical_risk
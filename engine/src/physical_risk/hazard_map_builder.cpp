@@ -0,0 +1,405 @@
+#include "physical_risk/hazard_map_builder.h"
+#include "physical_risk/physical_risk_engine.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace physical_risk {
+
+namespace {
+
+constexpr double EARTH_RADIUS_KM = 6371.0;   // As GeoUtils
+constexpr double DEGREES = M_PI / 180.0;
+
+/// Write all of a buffer at an offset (threads write disjoint blocks)
+void write_at(int fd, const std::string& path, const void* data, size_t bytes, size_t offset) {
+    const auto* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        const ssize_t written = ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("HazardMapBuilder: cannot write " + path + ": " + std::strerror(errno));
+        }
+        p += written;
+        bytes -= static_cast<size_t>(written);
+        offset += static_cast<size_t>(written);
+    }
+}
+
+/// Cell range [lo, hi] whose centers lie within [from, to] degrees, widened by a cell
+bool cell_range(double from, double to, double origin, double step, uint32_t cells,
+                uint32_t& lo, uint32_t& hi) {
+    const double first = std::floor((from - origin) / step);
+    const double last = std::ceil((to - origin) / step);
+    if (last < 0.0 || first > cells - 1.0) {
+        return false;
+    }
+    lo = static_cast<uint32_t>(std::max(first, 0.0));
+    hi = static_cast<uint32_t>(std::min(last, cells - 1.0));
+    return true;
+}
+
+} // namespace
+
+PerilFootprint PerilFootprint::from_peril(const PhysicalPeril& peril, const std::vector<int>& periods) {
+    PerilFootprint footprint;
+    footprint.peril_id = peril.peril_id;
+    footprint.latitude = peril.latitude;
+    footprint.longitude = peril.longitude;
+    footprint.intensity = peril.intensity;
+    footprint.radius_km = peril.radius_km;
+    const int end_period = (peril.end_period < 0) ? peril.start_period : peril.end_period;
+    for (int period : periods) {
+        const long offset = static_cast<long>(period) - peril.start_period;
+        double factor = 0.0;
+        if (!peril.intensity_pathway.empty()) {
+            if (offset >= 0 && offset < static_cast<long>(peril.intensity_pathway.size())) {
+                factor = peril.intensity_pathway[static_cast<size_t>(offset)];
+            }
+        } else if (period >= peril.start_period && period <= end_period) {
+            factor = 1.0;
+        }
+        footprint.band_factors.push_back(factor);
+    }
+    return footprint;
+}
+
+struct HazardMapBuilder::Footprint {
+    double cx = 0.0;                // Unit vector of the center
+    double cy = 0.0;
+    double cz = 0.0;
+    double chord2_limit = 0.0;      // Squared chord of the radius (cells strictly inside)
+    double radius_km = 0.0;         // <= 0: only the center's cell
+    DecayShape decay = DecayShape::LINEAR;
+    std::vector<double> band_intensities;
+    bool empty = true;              // Reaches no cell of the grid
+    uint32_t row_lo = 0, row_hi = 0, col_lo = 0, col_hi = 0;   // Bounding box, inclusive
+};
+
+struct HazardMapBuilder::Scratch {
+    std::vector<float> values;      // Blocks of one tile, band-major
+    std::vector<double> chord2;     // One row of a footprint's cells
+};
+
+HazardMapBuilder::HazardMapBuilder(const HazardGridSpec& spec, std::vector<int> band_keys, uint32_t tile)
+    : spec_(spec), band_keys_(std::move(band_keys)), tile_(tile) {
+    if (spec_.rows == 0 || spec_.cols == 0 || !(spec_.lat_step > 0.0) || !(spec_.lon_step > 0.0) ||
+        band_keys_.empty() || tile_ == 0) {
+        throw std::invalid_argument("HazardMapBuilder: empty grid, band list or tile");
+    }
+    tile_rows_ = (static_cast<size_t>(spec_.rows) + tile_ - 1) / tile_;
+    tile_cols_ = (static_cast<size_t>(spec_.cols) + tile_ - 1) / tile_;
+    for (uint32_t r = 0; r < spec_.rows; ++r) {
+        const double lat = (spec_.lat_origin + r * spec_.lat_step) * DEGREES;
+        sin_lat_.push_back(std::sin(lat));
+        cos_lat_.push_back(std::cos(lat));
+    }
+    for (uint32_t c = 0; c < spec_.cols; ++c) {
+        const double lon = (spec_.lon_origin + c * spec_.lon_step) * DEGREES;
+        sin_lon_.push_back(std::sin(lon));
+        cos_lon_.push_back(std::cos(lon));
+    }
+}
+
+HazardMapBuilder::~HazardMapBuilder() = default;
+
+void HazardMapBuilder::set_parallel(size_t threads) {
+    pool_.reset();
+    if (threads > 1) {
+        pool_ = std::make_unique<finmodel::core::ThreadPool>(threads);
+    }
+}
+
+HazardMapBuilder::Footprint HazardMapBuilder::prepare(const PerilFootprint& footprint) const {
+    if (!std::isfinite(footprint.latitude) || !std::isfinite(footprint.longitude) ||
+        std::abs(footprint.latitude) > 90.0 || !std::isfinite(footprint.radius_km)) {
+        throw std::invalid_argument("HazardMapBuilder: peril " + std::to_string(footprint.peril_id) +
+                                    " has no valid location or radius");
+    }
+    if (!footprint.band_factors.empty() && footprint.band_factors.size() != band_keys_.size()) {
+        throw std::invalid_argument("HazardMapBuilder: peril " + std::to_string(footprint.peril_id) + " has " +
+                                    std::to_string(footprint.band_factors.size()) + " band factors for " +
+                                    std::to_string(band_keys_.size()) + " bands");
+    }
+
+    Footprint prepared;
+    const double lat = footprint.latitude * DEGREES;
+    const double lon = footprint.longitude * DEGREES;
+    prepared.cx = std::cos(lat) * std::cos(lon);
+    prepared.cy = std::cos(lat) * std::sin(lon);
+    prepared.cz = std::sin(lat);
+    prepared.radius_km = footprint.radius_km;
+    prepared.decay = footprint.decay;
+    for (size_t band = 0; band < band_keys_.size(); ++band) {
+        const double factor = footprint.band_factors.empty() ? 1.0 : footprint.band_factors[band];
+        prepared.band_intensities.push_back(footprint.intensity * factor);
+    }
+
+    if (footprint.radius_km <= 0.0) {
+        // The cell containing the center, as HazardGrid::cell_value()
+        const double y = std::round((footprint.latitude - spec_.lat_origin) / spec_.lat_step);
+        const double x = std::round((footprint.longitude - spec_.lon_origin) / spec_.lon_step);
+        if (y >= 0.0 && y < spec_.rows && x >= 0.0 && x < spec_.cols) {
+            prepared.empty = false;
+            prepared.row_lo = prepared.row_hi = static_cast<uint32_t>(y);
+            prepared.col_lo = prepared.col_hi = static_cast<uint32_t>(x);
+        }
+        return prepared;
+    }
+
+    // Spherical cap of the radius: its latitude band, and its widest
+    // longitude span (unless it reaches a pole)
+    const double angle = std::min(footprint.radius_km / EARTH_RADIUS_KM, M_PI);
+    const double chord = 2.0 * std::sin(angle / 2.0);
+    prepared.chord2_limit = chord * chord;
+    const double dlat = angle / DEGREES;
+    double lon_from = spec_.lon_origin - spec_.lon_step;
+    double lon_to = spec_.lon_origin + spec_.cols * spec_.lon_step;
+    const double reach = std::sin(angle) / std::cos(lat);
+    if (std::abs(footprint.latitude) + dlat < 90.0 && angle < M_PI / 2.0 && reach < 1.0) {
+        const double dlon = std::asin(reach) / DEGREES;
+        lon_from = footprint.longitude - dlon;
+        lon_to = footprint.longitude + dlon;
+    }
+    prepared.empty =
+        !cell_range(footprint.latitude - dlat, footprint.latitude + dlat, spec_.lat_origin, spec_.lat_step,
+                    spec_.rows, prepared.row_lo, prepared.row_hi) ||
+        !cell_range(lon_from, lon_to, spec_.lon_origin, spec_.lon_step, spec_.cols, prepared.col_lo,
+                    prepared.col_hi);
+    return prepared;
+}
+
+void HazardMapBuilder::covered_tiles(const Footprint& footprint, std::vector<size_t>& tiles) const {
+    if (footprint.empty) {
+        return;
+    }
+    for (size_t tr = footprint.row_lo / tile_; tr <= footprint.row_hi / tile_; ++tr) {
+        for (size_t tc = footprint.col_lo / tile_; tc <= footprint.col_hi / tile_; ++tc) {
+            tiles.push_back(tr * tile_cols_ + tc);
+        }
+    }
+}
+
+size_t HazardMapBuilder::compute_tile(size_t tile_index, const std::vector<Footprint>& footprints,
+                                      const std::vector<size_t>& members, Scratch& scratch) const {
+    const size_t tile_cells = static_cast<size_t>(tile_) * tile_;
+    const size_t bands = band_keys_.size();
+    const uint32_t row0 = static_cast<uint32_t>(tile_index / tile_cols_) * tile_;
+    const uint32_t col0 = static_cast<uint32_t>(tile_index % tile_cols_) * tile_;
+    const uint32_t row_end = std::min<uint32_t>(row0 + tile_, spec_.rows);
+    const uint32_t col_end = std::min<uint32_t>(col0 + tile_, spec_.cols);
+
+    // NaN until a footprint reaches the cell
+    scratch.values.assign(tile_cells * bands, std::numeric_limits<float>::quiet_NaN());
+    scratch.chord2.resize(tile_);
+    const bool sum = (combine_ == HazardCombine::SUM);
+    auto deposit = [&](uint32_t r, uint32_t c, const Footprint& footprint, double weight) {
+        float* cell = scratch.values.data() + static_cast<size_t>(r - row0) * tile_ + (c - col0);
+        for (size_t band = 0; band < bands; ++band, cell += tile_cells) {
+            const auto v = static_cast<float>(footprint.band_intensities[band] * weight);
+            *cell = std::isnan(*cell) ? v : (sum ? *cell + v : std::max(*cell, v));
+        }
+    };
+
+    size_t evaluations = 0;
+    for (size_t member : members) {
+        const Footprint& footprint = footprints[member];
+        const uint32_t r_lo = std::max(footprint.row_lo, row0);
+        const uint32_t r_hi = std::min(footprint.row_hi + 1, row_end);
+        const uint32_t c_lo = std::max(footprint.col_lo, col0);
+        const uint32_t c_hi = std::min(footprint.col_hi + 1, col_end);
+        if (footprint.radius_km <= 0.0) {
+            deposit(r_lo, c_lo, footprint, 1.0);
+            ++evaluations;
+            continue;
+        }
+        const size_t n = c_hi - c_lo;
+        const double* cos_lon = cos_lon_.data() + c_lo;
+        const double* sin_lon = sin_lon_.data() + c_lo;
+        double* chord2 = scratch.chord2.data();
+        for (uint32_t r = r_lo; r < r_hi; ++r) {
+            // |cell - center|² = 2 - 2 cell·center (vectorizable)
+            const double a = cos_lat_[r];
+            const double b = footprint.cz * sin_lat_[r];
+            for (size_t k = 0; k < n; ++k) {
+                chord2[k] = 2.0 - 2.0 * (a * (footprint.cx * cos_lon[k] + footprint.cy * sin_lon[k]) + b);
+            }
+            evaluations += n;
+
+            // Arc distance and decay only inside the radius
+            for (size_t k = 0; k < n; ++k) {
+                if (!(chord2[k] < footprint.chord2_limit)) {
+                    continue;
+                }
+                const double half_chord = std::min(std::sqrt(std::max(chord2[k], 0.0)) / 2.0, 1.0);
+                const double ratio = 2.0 * EARTH_RADIUS_KM * std::asin(half_chord) / footprint.radius_km;
+                double weight = 1.0;
+                switch (footprint.decay) {
+                    case DecayShape::LINEAR:   weight = std::max(1.0 - ratio, 0.0); break;
+                    case DecayShape::CONSTANT: break;
+                    case DecayShape::GAUSSIAN: weight = std::exp(-4.5 * ratio * ratio); break;
+                }
+                deposit(r, c_lo + static_cast<uint32_t>(k), footprint, weight);
+            }
+        }
+    }
+
+    // Cells no footprint reached; padding beyond the grid's edge has no data
+    for (size_t band = 0; band < bands; ++band) {
+        float* block = scratch.values.data() + band * tile_cells;
+        for (uint32_t r = row0; r < row_end; ++r) {
+            for (uint32_t c = col0; c < col_end; ++c) {
+                float& cell = block[static_cast<size_t>(r - row0) * tile_ + (c - col0)];
+                if (std::isnan(cell)) {
+                    cell = background_;
+                }
+            }
+        }
+    }
+    return evaluations;
+}
+
+HazardBuildStats HazardMapBuilder::write_tiles(int fd, const std::string& path,
+                                               const std::vector<Footprint>& footprints,
+                                               const std::vector<size_t>& tiles) const {
+    // Footprints of every tile, in footprint order (SUM adds in that order)
+    std::vector<std::vector<size_t>> members(tile_rows_ * tile_cols_);
+    std::vector<size_t> covered;
+    for (size_t i = 0; i < footprints.size(); ++i) {
+        covered.clear();
+        covered_tiles(footprints[i], covered);
+        for (size_t tile_index : covered) {
+            members[tile_index].push_back(i);
+        }
+    }
+
+    const size_t workers = pool_ ? pool_->size() : 1;
+    std::vector<Scratch> scratch(workers);
+    std::vector<size_t> evaluations(workers, 0);
+    const size_t bands = band_keys_.size();
+    auto run = [&](size_t begin, size_t end, size_t worker) {
+        for (size_t i = begin; i < end; ++i) {
+            evaluations[worker] += compute_tile(tiles[i], footprints, members[tiles[i]], scratch[worker]);
+            // A tile's band blocks are contiguous in the file
+            write_at(fd, path, scratch[worker].values.data(), scratch[worker].values.size() * sizeof(float),
+                     HazardGrid::block_offset(bands, tile_, tiles[i], 0));
+        }
+    };
+    if (pool_) {
+        pool_->parallel_for(tiles.size(), run);
+    } else {
+        run(0, tiles.size(), 0);
+    }
+
+    HazardBuildStats stats;
+    stats.tiles = tile_rows_ * tile_cols_;
+    stats.tiles_written = tiles.size();
+    for (size_t count : evaluations) {
+        stats.cell_evaluations += count;
+    }
+    return stats;
+}
+
+HazardBuildStats HazardMapBuilder::build(const std::vector<PerilFootprint>& footprints,
+                                         const std::string& path) const {
+    std::vector<Footprint> prepared;
+    prepared.reserve(footprints.size());
+    for (const auto& footprint : footprints) {
+        prepared.push_back(prepare(footprint));
+    }
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        HazardGrid::write_header(out, spec_, band_keys_, tile_);
+        if (!out) {
+            throw std::runtime_error("HazardMapBuilder: cannot create " + path);
+        }
+    }
+    std::error_code error;
+    std::filesystem::resize_file(path, HazardGrid::block_offset(band_keys_.size(), tile_,
+                                                                tile_rows_ * tile_cols_, 0), error);
+    const int fd = error ? -1 : ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        throw std::runtime_error("HazardMapBuilder: cannot write " + path);
+    }
+    std::vector<size_t> tiles(tile_rows_ * tile_cols_);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        tiles[i] = i;
+    }
+    try {
+        const HazardBuildStats stats = write_tiles(fd, path, prepared, tiles);
+        ::close(fd);
+        return stats;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+HazardBuildStats HazardMapBuilder::update(const std::string& path, const std::vector<PerilFootprint>& previous,
+                                          const std::vector<PerilFootprint>& current) const {
+    {
+        const HazardGrid grid(path);
+        const HazardGridSpec& spec = grid.spec();
+        if (spec.rows != spec_.rows || spec.cols != spec_.cols || spec.lat_origin != spec_.lat_origin ||
+            spec.lon_origin != spec_.lon_origin || spec.lat_step != spec_.lat_step ||
+            spec.lon_step != spec_.lon_step || grid.band_keys() != band_keys_ || grid.tile() != tile_) {
+            throw std::runtime_error("HazardMapBuilder: " + path + " isn't a grid of this spec, bands and tile");
+        }
+    }
+
+    std::vector<Footprint> prepared;
+    prepared.reserve(current.size());
+    for (const auto& footprint : current) {
+        prepared.push_back(prepare(footprint));
+    }
+
+    // Tiles of both versions of every added, removed or changed peril
+    std::map<int, const PerilFootprint*> before;
+    for (const auto& footprint : previous) {
+        before[footprint.peril_id] = &footprint;
+    }
+    std::vector<size_t> tiles;
+    for (size_t i = 0; i < current.size(); ++i) {
+        auto match = before.find(current[i].peril_id);
+        if (match != before.end() && *match->second == current[i]) {
+            before.erase(match);
+            continue;
+        }
+        covered_tiles(prepared[i], tiles);
+        if (match != before.end()) {
+            covered_tiles(prepare(*match->second), tiles);
+            before.erase(match);
+        }
+    }
+    for (const auto& [peril_id, footprint] : before) {
+        covered_tiles(prepare(*footprint), tiles);   // Removed
+    }
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+    const int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        throw std::runtime_error("HazardMapBuilder: cannot write " + path);
+    }
+    try {
+        const HazardBuildStats stats = write_tiles(fd, path, prepared, tiles);
+        ::close(fd);
+        return stats;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+} // namespace physical_risk
@@ -1,16 +1,32 @@
 #include "physical_risk/physical_risk_engine.h"
 #include "database/result_set.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
+#include <unordered_map>
 #include <sstream>
 
 namespace physical_risk {
 
 PhysicalRiskEngine::PhysicalRiskEngine(finmodel::database::IDatabase* db)
-    : db_(db), registry_(db) {
+    : PhysicalRiskEngine(db, std::make_shared<const DamageFunctionRegistry>(db)) {
+}
+
+PhysicalRiskEngine::PhysicalRiskEngine(finmodel::database::IDatabase* db,
+                                       std::shared_ptr<const DamageFunctionRegistry> registry)
+    : db_(db), registry_(std::move(registry)) {
     if (!db_) {
         throw std::runtime_error("Database connection is null");
     }
+    if (!registry_) {
+        throw std::runtime_error("Damage function registry is null");
+    }
 }
 
 std::vector<PhysicalPeril> PhysicalRiskEngine::load_perils(int scenario_id) {
@@ -26,31 +42,79 @@ std::vector<PhysicalPeril> PhysicalRiskEngine::load_perils(int scenario_id) {
 
     std::vector<PhysicalPeril> perils;
 
-    while (result->next()) {
+    for (auto [peril_id, sid, peril_type, peril_code, latitude, longitude, intensity, intensity_unit,
+               start_period, end_period, radius_km, description] :
+         result->rows<int, int, std::string, std::string, double, double, double, std::string,
+                      int, std::optional<int>, double, std::optional<std::string>>()) {
         PhysicalPeril peril;
-        peril.peril_id = result->get_int("peril_id");
-        peril.scenario_id = result->get_int("scenario_id");
-        peril.peril_type = result->get_string("peril_type");
-        peril.peril_code = result->get_string("peril_code");
-        peril.latitude = result->get_double("latitude");
-        peril.longitude = result->get_double("longitude");
-        peril.intensity = result->get_double("intensity");
-        peril.intensity_unit = result->get_string("intensity_unit");
-        peril.start_period = result->get_int("start_period");
-
-        if (result->is_null("end_period")) {
-            peril.end_period = -1;
-        } else {
-            peril.end_period = result->get_int("end_period");
-        }
+        peril.peril_id = peril_id;
+        peril.scenario_id = sid;
+        peril.peril_type = std::move(peril_type);
+        peril.peril_code = std::move(peril_code);
+        peril.latitude = latitude;
+        peril.longitude = longitude;
+        peril.intensity = intensity;
+        peril.intensity_unit = std::move(intensity_unit);
+        peril.start_period = start_period;
+        peril.end_period = end_period.value_or(-1);
+        peril.radius_km = radius_km;
+        peril.description = description.value_or("");
+
+        perils.push_back(std::move(peril));
+    }
 
-        peril.radius_km = result->get_double("radius_km");
-        peril.description = result->is_null("description") ? "" : result->get_string("description");
+    load_pathways(scenario_id, perils);
+    return perils;
+}
 
-        perils.push_back(peril);
+void PhysicalRiskEngine::load_pathways(int scenario_id, std::vector<PhysicalPeril>& perils) {
+    if (perils.empty()) {
+        return;
+    }
+    const auto tables = db_->list_tables();
+    if (std::find(tables.begin(), tables.end(), "physical_peril_pathway") == tables.end()) {
+        return;
     }
 
-    return perils;
+    // A peril's own factors override those of its peril type
+    auto result = db_->execute_query(
+        "SELECT peril_id, peril_type, period_id, intensity_factor "
+        "FROM physical_peril_pathway "
+        "WHERE scenario_id = :sid",
+        {{"sid", scenario_id}}
+    );
+    std::map<std::pair<int, int>, double> peril_factors;                // (peril, period)
+    std::map<std::pair<std::string, int>, double> type_factors;         // (peril type, period)
+    for (auto [peril_id, peril_type, period_id, factor] :
+         result->rows<std::optional<int>, std::optional<std::string>, int, double>()) {
+        if (peril_id) {
+            peril_factors[{*peril_id, period_id}] = factor;
+        } else if (peril_type) {
+            type_factors[{*peril_type, period_id}] = factor;
+        }
+    }
+    if (peril_factors.empty() && type_factors.empty()) {
+        return;
+    }
+
+    for (auto& peril : perils) {
+        const int last = (peril.end_period < 0) ? peril.start_period : peril.end_period;
+        std::vector<double> pathway;
+        bool constant = true;
+        for (int period = peril.start_period; period <= last; ++period) {
+            double factor = 1.0;
+            if (auto own = peril_factors.find({peril.peril_id, period}); own != peril_factors.end()) {
+                factor = own->second;
+            } else if (auto shared = type_factors.find({peril.peril_type, period}); shared != type_factors.end()) {
+                factor = shared->second;
+            }
+            constant = constant && factor == 1.0;
+            pathway.push_back(factor);
+        }
+        if (!constant) {
+            peril.intensity_pathway = std::move(pathway);
+        }
+    }
 }
 
 std::vector<AssetExposure> PhysicalRiskEngine::load_assets() {
@@ -67,33 +131,60 @@ std::vector<AssetExposure> PhysicalRiskEngine::load_assets() {
 
     std::vector<AssetExposure> assets;
 
-    while (result->next()) {
+    for (auto [asset_id, asset_code, asset_name, asset_type, latitude, longitude, entity_code,
+               replacement_value, replacement_currency, inventory_value, inventory_currency,
+               annual_revenue, revenue_currency] :
+         result->rows<int, std::string, std::string, std::string, double, double, std::optional<std::string>,
+                      double, std::string, double, std::string, double, std::string>()) {
         AssetExposure asset;
-        asset.asset_id = result->get_int("asset_id");
-        asset.asset_code = result->get_string("asset_code");
-        asset.asset_name = result->get_string("asset_name");
-        asset.asset_type = result->get_string("asset_type");
-        asset.latitude = result->get_double("latitude");
-        asset.longitude = result->get_double("longitude");
-        asset.entity_code = result->is_null("entity_code") ? "" : result->get_string("entity_code");
-        asset.replacement_value = result->get_double("replacement_value");
-        asset.replacement_currency = result->get_string("replacement_currency");
-        asset.inventory_value = result->get_double("inventory_value");
-        asset.inventory_currency = result->get_string("inventory_currency");
-        asset.annual_revenue = result->get_double("annual_revenue");
-        asset.revenue_currency = result->get_string("revenue_currency");
-
-        assets.push_back(asset);
+        asset.asset_id = asset_id;
+        asset.asset_code = std::move(asset_code);
+        asset.asset_name = std::move(asset_name);
+        asset.asset_type = std::move(asset_type);
+        asset.latitude = latitude;
+        asset.longitude = longitude;
+        asset.entity_code = entity_code.value_or("");
+        asset.replacement_value = replacement_value;
+        asset.replacement_currency = std::move(replacement_currency);
+        asset.inventory_value = inventory_value;
+        asset.inventory_currency = std::move(inventory_currency);
+        asset.annual_revenue = annual_revenue;
+        asset.revenue_currency = std::move(revenue_currency);
+
+        assets.push_back(std::move(asset));
     }
 
     return assets;
 }
 
+std::vector<StochasticEvent> PhysicalRiskEngine::load_events(const std::string& catalogue_code) {
+    auto result = db_->execute_query(
+        "SELECT event_id, peril_type, latitude, longitude, intensity, radius_km, annual_rate "
+        "FROM physical_event "
+        "WHERE catalogue_code = :code "
+        "ORDER BY event_id",
+        {{"code", catalogue_code}}
+    );
+
+    std::vector<StochasticEvent> events;
+
+    for (auto [event_id, peril_type, latitude, longitude, intensity, radius_km, annual_rate] :
+         result->rows<int, std::string, double, double, double, std::optional<double>, double>()) {
+        events.push_back({event_id, std::move(peril_type), latitude, longitude, intensity,
+                          radius_km.value_or(0.0), annual_rate});
+    }
+
+    return events;
+}
+
 DamageResult PhysicalRiskEngine::calculate_damage(
     const AssetExposure& asset,
     const PhysicalPeril& peril,
-    int period
-) {
+    int period,
+    const DamageBlock& block,
+    size_t i,
+    size_t k
+) const {
     DamageResult result;
     result.asset_id = asset.asset_id;
     result.asset_code = asset.asset_code;
@@ -103,24 +194,19 @@ DamageResult PhysicalRiskEngine::calculate_damage(
     result.period = period;
     result.currency = asset.replacement_currency;
 
-    // Calculate distance
-    result.distance_km = GeoUtils::haversine_distance(
-        asset.latitude, asset.longitude,
-        peril.latitude, peril.longitude
-    );
+    result.distance_km = block.distances_km[i];
+    const size_t j = i * block.periods + (block.periods > 1 ? k : 0);
 
     // Check if asset is affected
     bool is_affected = false;
     if (peril.radius_km <= 0.0) {
         // Point peril - only affects if very close (within 1km tolerance)
         is_affected = (result.distance_km <= 1.0);
-        result.adjusted_intensity = is_affected ? peril.intensity : 0.0;
+        result.adjusted_intensity = is_affected ? block.intensities[j] : 0.0;
     } else {
-        // Area peril - apply intensity decay
+        // Area peril - intensity decayed with distance
         is_affected = (result.distance_km <= peril.radius_km);
-        result.adjusted_intensity = GeoUtils::calculate_intensity_with_decay(
-            peril.intensity, result.distance_km, peril.radius_km
-        );
+        result.adjusted_intensity = block.intensities[j];
     }
 
     // Initialize damage values
@@ -135,60 +221,302 @@ DamageResult PhysicalRiskEngine::calculate_damage(
         return result;
     }
 
-    // Apply damage functions
-    const IDamageFunction* ppe_func = registry_.get_function_for_peril(peril.peril_type, "PPE");
-    if (ppe_func) {
-        result.ppe_damage_pct = ppe_func->calculate(result.adjusted_intensity);
-        result.ppe_loss_amount = asset.replacement_value * result.ppe_damage_pct;
+    // Damage functions (evaluated by evaluate_block())
+    result.ppe_damage_pct = block.ppe_damage_pct[j];
+    result.ppe_loss_amount = asset.replacement_value * result.ppe_damage_pct;
+
+    result.inventory_damage_pct = block.inventory_damage_pct[j];
+    result.inventory_loss_amount = asset.inventory_value * result.inventory_damage_pct;
+
+    result.bi_downtime_days = block.bi_downtime_days[j];
+    if (asset.annual_revenue > 0.0) {
+        result.bi_loss_amount = (asset.annual_revenue / 365.0) * result.bi_downtime_days;
+    }
+
+    return result;
+}
+
+void PhysicalRiskEngine::evaluate_block(
+    const PhysicalPeril& peril,
+    const GeoCoordinates& coordinates,
+    const DamageCurveAssignment& curves,
+    const size_t* assets,
+    size_t count,
+    DamageBlock& block
+) const {
+    block.assets.assign(assets, assets + count);
+    const size_t n = count;
+
+    block.distances_km.resize(n);
+    block.intensities.resize(n);
+    GeoUtils::haversine_distance_batch(coordinates, block.assets.data(), n,
+                                       peril.latitude, peril.longitude, block.distances_km.data());
+    GeoUtils::intensity_with_decay_batch(peril.intensity, block.distances_km.data(), n,
+                                         peril.radius_km, block.intensities.data());
+
+    // Decay is linear in the intensity: a pathway scales each asset's
+    // decayed intensity, and every period goes through one kernel call
+    const auto& pathway = peril.intensity_pathway;
+    block.periods = std::max<size_t>(pathway.size(), 1);
+    if (!pathway.empty()) {
+        std::vector<double> decayed = std::move(block.intensities);
+        block.intensities.resize(n * block.periods);
+        for (size_t i = 0; i < n; ++i) {
+            double* out = block.intensities.data() + i * block.periods;
+            for (size_t k = 0; k < block.periods; ++k) {
+                out[k] = decayed[i] * pathway[k];
+            }
+        }
     }
+    apply_damage_functions(peril.peril_type, curves, block);
+}
 
-    const IDamageFunction* inv_func = registry_.get_function_for_peril(peril.peril_type, "INVENTORY");
-    if (inv_func) {
-        result.inventory_damage_pct = inv_func->calculate(result.adjusted_intensity);
-        result.inventory_loss_amount = asset.inventory_value * result.inventory_damage_pct;
+void PhysicalRiskEngine::evaluate_hazard_block(
+    const HazardMapPeril& map,
+    size_t band,
+    const std::vector<double>& lats,
+    const std::vector<double>& lons,
+    const DamageCurveAssignment& curves,
+    size_t first,
+    size_t count,
+    DamageBlock& block
+) const {
+    block.assets.resize(count);
+    block.periods = 1;
+    std::iota(block.assets.begin(), block.assets.end(), first);
+    block.distances_km.assign(count, 0.0);
+    block.intensities.resize(count);
+    map.grid->sample_batch(lats.data() + first, lons.data() + first, count, band, map.bilinear,
+                           block.intensities.data());
+    for (double& intensity : block.intensities) {
+        if (std::isnan(intensity)) {
+            intensity = 0.0;   // Outside the map or no data: no hazard
+        }
     }
+    apply_damage_functions(map.peril_type, curves, block);
+}
+
+void PhysicalRiskEngine::apply_damage_functions(const std::string& peril_type_name,
+                                                const DamageCurveAssignment& curves,
+                                                DamageBlock& block) const {
+    const size_t n = block.intensities.size();
+
+    // Targets without a damage function do no damage
+    const auto peril_type = registry_->peril_type_id(peril_type_name);
+    auto apply = [&](DamageTarget target, std::vector<double>& out) {
+        out.assign(n, 0.0);
+        const auto shared = curves.shared_curve(peril_type, target);
+        if (shared != DamageCurveAssignment::MIXED) {
+            if (const IDamageFunction* func = registry_->curve(shared)) {
+                func->calculate_batch(block.intensities, out);
+            }
+            return;
+        }
+
+        // Counting sort of the entries by curve (NO_CURVE last), then one
+        // gathered batch per curve
+        const size_t curve_count = registry_->size();
+        auto bucket = [&](size_t j) {
+            const auto id = curves.curve(block.assets[j / block.periods], peril_type, target);
+            return std::min<size_t>(id, curve_count);
+        };
+        block.curve_starts.assign(curve_count + 3, 0);
+        for (size_t j = 0; j < n; ++j) {
+            ++block.curve_starts[bucket(j) + 2];
+        }
+        for (size_t c = 2; c < block.curve_starts.size(); ++c) {
+            block.curve_starts[c] += block.curve_starts[c - 1];
+        }
+        block.curve_order.resize(n);
+        for (size_t j = 0; j < n; ++j) {
+            block.curve_order[block.curve_starts[bucket(j) + 1]++] = static_cast<uint32_t>(j);
+        }
 
-    const IDamageFunction* bi_func = registry_.get_function_for_peril(peril.peril_type, "BI");
-    if (bi_func) {
-        result.bi_downtime_days = bi_func->calculate(result.adjusted_intensity);
-        if (asset.annual_revenue > 0.0) {
-            result.bi_loss_amount = (asset.annual_revenue / 365.0) * result.bi_downtime_days;
+        for (size_t c = 0; c < curve_count; ++c) {
+            const size_t begin = block.curve_starts[c];
+            const size_t count = block.curve_starts[c + 1] - begin;
+            if (count == 0) {
+                continue;
+            }
+            const uint32_t* entries = block.curve_order.data() + begin;
+            block.gathered.resize(count);
+            block.computed.resize(count);
+            for (size_t e = 0; e < count; ++e) {
+                block.gathered[e] = block.intensities[entries[e]];
+            }
+            registry_->curve(static_cast<DamageCurveAssignment::CurveId>(c))->calculate_batch(block.gathered,
+                                                                                          block.computed);
+            for (size_t e = 0; e < count; ++e) {
+                out[entries[e]] = block.computed[e];
+            }
         }
+    };
+    apply(DamageTarget::PPE, block.ppe_damage_pct);
+    apply(DamageTarget::INVENTORY, block.inventory_damage_pct);
+    apply(DamageTarget::BI, block.bi_downtime_days);
+}
+
+DamageCurveAssignment PhysicalRiskEngine::assign_curves(const std::vector<AssetExposure>& assets) const {
+    std::vector<std::string> archetypes;
+    archetypes.reserve(assets.size());
+    for (const auto& asset : assets) {
+        archetypes.push_back(asset.asset_type);
     }
+    return DamageCurveAssignment(*registry_, archetypes);
+}
 
-    return result;
+void PhysicalRiskEngine::add_hazard_map(int scenario_id, HazardMapPeril map) {
+    if (!map.grid) {
+        throw std::invalid_argument("PhysicalRiskEngine: hazard map " + map.peril_code + " has no grid");
+    }
+    hazard_maps_[scenario_id].push_back(std::move(map));
+}
+
+void PhysicalRiskEngine::set_parallel(size_t threads, size_t shard_assets) {
+    if (shard_assets == 0) {
+        throw std::invalid_argument("PhysicalRiskEngine: shard size must be at least 1");
+    }
+    pool_.reset();
+    if (threads > 1) {
+        pool_ = std::make_unique<finmodel::core::ThreadPool>(threads);
+    }
+    shard_assets_ = shard_assets;
+}
+
+void PhysicalRiskEngine::for_each(size_t count, const finmodel::core::ThreadPool::RangeFunction& fn) const {
+    if (pool_) {
+        pool_->parallel_for(count, fn);
+    } else {
+        fn(0, count, 0);
+    }
 }
 
 std::vector<DamageResult> PhysicalRiskEngine::calculate_damages(int scenario_id) {
     std::vector<PhysicalPeril> perils = load_perils(scenario_id);
     std::vector<AssetExposure> assets = load_assets();
 
-    std::vector<DamageResult> results;
-
-    for (const auto& peril : perils) {
-        // Determine which periods this peril affects
-        std::vector<int> affected_periods;
-        if (peril.end_period < 0) {
-            affected_periods.push_back(peril.start_period);
-        } else {
-            for (int p = peril.start_period; p <= peril.end_period; ++p) {
-                affected_periods.push_back(p);
+    // Built once per asset load; each peril only visits assets near it
+    std::vector<std::pair<double, double>> locations;
+    locations.reserve(assets.size());
+    for (const auto& asset : assets) {
+        locations.emplace_back(asset.latitude, asset.longitude);
+    }
+    const SpatialIndex index(locations);
+    const GeoCoordinates coordinates(locations);
+    const DamageCurveAssignment curves = assign_curves(assets);
+
+    // Assets near each peril; point perils reach assets within 1km (see calculate_damage())
+    std::vector<std::vector<size_t>> nearby(perils.size());
+    for_each(perils.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t p = begin; p < end; ++p) {
+            const auto& peril = perils[p];
+            const double reach_km = (peril.radius_km <= 0.0) ? 1.0 : peril.radius_km;
+            nearby[p] = index.query_radius(peril.latitude, peril.longitude, reach_km);
+        }
+    });
+
+    // Each hazard map band as an area peril of one period reaching every
+    // asset; its block holds sampled intensities at distance 0
+    struct MapBand {
+        const HazardMapPeril* map;
+        size_t band;
+    };
+    std::vector<MapBand> map_bands;
+    auto maps = hazard_maps_.find(scenario_id);
+    if (maps != hazard_maps_.end()) {
+        for (const auto& map : maps->second) {
+            for (size_t band = 0; band < map.grid->bands(); ++band) {
+                map_bands.push_back({&map, band});
+                PhysicalPeril peril{};
+                peril.peril_id = HAZARD_MAP_PERIL_ID;
+                peril.scenario_id = scenario_id;
+                peril.peril_type = map.peril_type;
+                peril.peril_code = map.peril_code;
+                peril.start_period = map.grid->band_keys()[band];
+                peril.end_period = peril.start_period;
+                peril.radius_km = std::numeric_limits<double>::infinity();
+                perils.push_back(std::move(peril));
             }
         }
+    }
+    std::vector<double> lats;
+    std::vector<double> lons;
+    if (!map_bands.empty()) {
+        for (const auto& [lat, lon] : locations) {
+            lats.push_back(lat);
+            lons.push_back(lon);
+        }
+    }
+    const size_t point_perils = perils.size() - map_bands.size();
+
+    // Shards in result order: by peril, then by position among its nearby
+    // assets (all assets for hazard map bands)
+    struct Shard {
+        size_t peril;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Shard> shards;
+    for (size_t p = 0; p < perils.size(); ++p) {
+        const size_t reached = (p < point_perils) ? nearby[p].size() : assets.size();
+        for (size_t begin = 0; begin < reached; begin += shard_assets_) {
+            shards.push_back({p, begin, std::min(begin + shard_assets_, reached)});
+        }
+    }
 
-        // Calculate damage for each asset in each affected period
-        for (const auto& asset : assets) {
-            for (int period : affected_periods) {
-                DamageResult damage = calculate_damage(asset, peril, period);
+    std::vector<std::vector<DamageResult>> shard_results(shards.size());
+    std::vector<DamageBlock> blocks(workers());
+    for_each(shards.size(), [&](size_t begin, size_t end, size_t worker) {
+        DamageBlock& block = blocks[worker];
+        for (size_t s = begin; s < end; ++s) {
+            const Shard& shard = shards[s];
+            const auto& peril = perils[shard.peril];
+
+            // Determine which periods this peril affects
+            std::vector<int> affected_periods;
+            if (peril.end_period < 0) {
+                affected_periods.push_back(peril.start_period);
+            } else {
+                for (int p = peril.start_period; p <= peril.end_period; ++p) {
+                    affected_periods.push_back(p);
+                }
+            }
+
+            if (shard.peril < point_perils) {
+                evaluate_block(peril, coordinates, curves, nearby[shard.peril].data() + shard.begin,
+                               shard.end - shard.begin, block);
+            } else {
+                const MapBand& map_band = map_bands[shard.peril - point_perils];
+                evaluate_hazard_block(*map_band.map, map_band.band, lats, lons, curves,
+                                      shard.begin, shard.end - shard.begin, block);
+            }
 
-                // Only keep results with actual damage
-                if (damage.ppe_loss_amount > 0.0 ||
-                    damage.inventory_loss_amount > 0.0 ||
-                    damage.bi_loss_amount > 0.0) {
-                    results.push_back(damage);
+            // Calculate damage for each nearby asset in each affected period
+            auto& results = shard_results[s];
+            for (size_t i = 0; i < block.assets.size(); ++i) {
+                const auto& asset = assets[block.assets[i]];
+                for (size_t k = 0; k < affected_periods.size(); ++k) {
+                    DamageResult damage = calculate_damage(asset, peril, affected_periods[k], block, i, k);
+
+                    // Only keep results with actual damage
+                    if (damage.ppe_loss_amount > 0.0 ||
+                        damage.inventory_loss_amount > 0.0 ||
+                        damage.bi_loss_amount > 0.0) {
+                        results.push_back(std::move(damage));
+                    }
                 }
             }
         }
+    });
+
+    size_t total = 0;
+    for (const auto& results : shard_results) {
+        total += results.size();
+    }
+    std::vector<DamageResult> results;
+    results.reserve(total);
+    for (auto& shard : shard_results) {
+        std::move(shard.begin(), shard.end(), std::back_inserter(results));
     }
 
     return results;
@@ -207,78 +535,393 @@ int PhysicalRiskEngine::generate_drivers(
     int scenario_id,
     const std::vector<DamageResult>& damages
 ) {
-    // Delete existing physical risk drivers for this scenario
-    // Use pattern matching to identify physical risk drivers
+    int driver_count = 0;
+
+    // Replace the scenario's physical risk drivers atomically
+    const bool own_transaction = !db_->in_transaction();
+    if (own_transaction) {
+        db_->begin_transaction();
+    }
+    try {
+        // Delete existing physical risk drivers for this scenario
+        // Use pattern matching to identify physical risk drivers
+        db_->execute_update(
+            "DELETE FROM scenario_drivers "
+            "WHERE scenario_id = :sid AND ("
+            "  driver_code LIKE '%_PPE_%' OR "
+            "  driver_code LIKE '%_INVENTORY_%' OR "
+            "  driver_code LIKE '%_BI_%'"
+            ")",
+            {{"sid", scenario_id}}
+        );
+
+        // Non-zero losses (PPE, inventory, business interruption) summed per
+        // period and driver code, in order of first occurrence
+        struct Driver {
+            int period;
+            std::string code;
+            double loss;
+            const std::string* currency;
+        };
+        std::vector<Driver> drivers;
+        drivers.reserve(damages.size() * 3);
+        std::unordered_map<int, std::unordered_map<std::string, size_t>> driver_index;
+        auto add_driver = [&](const DamageResult& damage, const char* target, double loss) {
+            if (loss > 0.0) {
+                std::string code = map_damage_to_driver(damage.peril_type, target, damage.asset_code);
+                auto [it, added] = driver_index[damage.period].emplace(code, drivers.size());
+                if (added) {
+                    drivers.push_back({damage.period, std::move(code), loss, &damage.currency});
+                } else {
+                    drivers[it->second].loss += loss;
+                }
+            }
+        };
+        for (const auto& damage : damages) {
+            add_driver(damage, "PPE", damage.ppe_loss_amount);
+            add_driver(damage, "INVENTORY", damage.inventory_loss_amount);
+            add_driver(damage, "BI", damage.bi_loss_amount);
+        }
+
+        std::vector<finmodel::ParamMap> rows;
+        rows.reserve(drivers.size());
+        for (const auto& driver : drivers) {
+            rows.push_back({
+                {"entity_id", "PHYSICAL_RISK"},
+                {"sid", scenario_id},
+                {"period_id", driver.period},
+                {"code", driver.code},
+                {"value", -driver.loss},  // Negative = loss
+                {"unit_code", *driver.currency}
+            });
+        }
+
+        db_->execute_batch(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES (:entity_id, :sid, :period_id, :code, :value, :unit_code)",
+            rows
+        );
+
+        if (damage_breakdown_) {
+            store_damage_breakdown(scenario_id, damages);
+        }
+        driver_count = static_cast<int>(rows.size());
+    } catch (...) {
+        if (own_transaction) {
+            db_->rollback();
+        }
+        throw;
+    }
+    if (own_transaction) {
+        db_->commit();
+    }
+
+    return driver_count;
+}
+
+void PhysicalRiskEngine::store_damage_breakdown(
+    int scenario_id,
+    const std::vector<DamageResult>& damages
+) {
     db_->execute_update(
-        "DELETE FROM scenario_drivers "
-        "WHERE scenario_id = :sid AND ("
-        "  driver_code LIKE '%_PPE_%' OR "
-        "  driver_code LIKE '%_INVENTORY_%' OR "
-        "  driver_code LIKE '%_BI_%'"
-        ")",
+        "DELETE FROM physical_risk_damage WHERE scenario_id = :sid",
         {{"sid", scenario_id}}
     );
 
-    // Insert new drivers
-    int driver_count = 0;
-
+    std::vector<finmodel::ParamMap> rows;
+    rows.reserve(damages.size());
     for (const auto& damage : damages) {
-        // PPE driver
-        if (damage.ppe_loss_amount > 0.0) {
-            std::string driver_code = map_damage_to_driver(damage.peril_type, "PPE", damage.asset_code);
-            db_->execute_update(
-                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
-                "VALUES (:entity_id, :sid, :period_id, :code, :value, :unit_code)",
-                {
-                    {"entity_id", "PHYSICAL_RISK"},
-                    {"sid", scenario_id},
-                    {"period_id", damage.period},
-                    {"code", driver_code},
-                    {"value", -damage.ppe_loss_amount},  // Negative = loss
-                    {"unit_code", damage.currency}
-                }
-            );
-            driver_count++;
+        rows.push_back({
+            {"sid", scenario_id},
+            {"period_id", damage.period},
+            {"asset_id", damage.asset_id},
+            {"peril_id", (damage.peril_id == HAZARD_MAP_PERIL_ID)
+                             ? finmodel::ParamValue(nullptr) : finmodel::ParamValue(damage.peril_id)},
+            {"distance_km", damage.distance_km},
+            {"intensity", damage.adjusted_intensity},
+            {"ppe_loss", damage.ppe_loss_amount},
+            {"inventory_loss", damage.inventory_loss_amount},
+            {"bi_loss", damage.bi_loss_amount},
+            {"currency", damage.currency}
+        });
+    }
+    db_->execute_batch(
+        "INSERT INTO physical_risk_damage (scenario_id, period_id, asset_id, peril_id, distance_km, "
+        "adjusted_intensity, ppe_loss, inventory_loss, bi_loss, currency) "
+        "VALUES (:sid, :period_id, :asset_id, :peril_id, :distance_km, :intensity, "
+        ":ppe_loss, :inventory_loss, :bi_loss, :currency)",
+        rows
+    );
+}
+
+MonteCarloResult PhysicalRiskEngine::simulate_annual_losses(
+    const std::string& catalogue_code,
+    const MonteCarloOptions& options
+) {
+    if (options.years == 0) {
+        throw std::invalid_argument("PhysicalRiskEngine: simulation needs at least one year");
+    }
+    for (double return_period : options.return_periods) {
+        if (!(return_period >= 1.0) || !std::isfinite(return_period)) {
+            throw std::invalid_argument("PhysicalRiskEngine: return periods must be at least 1 year");
         }
+    }
+    const LossSketch empty_sketch(options.relative_accuracy);
 
-        // INVENTORY driver
-        if (damage.inventory_loss_amount > 0.0) {
-            std::string driver_code = map_damage_to_driver(damage.peril_type, "INVENTORY", damage.asset_code);
-            db_->execute_update(
-                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
-                "VALUES (:entity_id, :sid, :period_id, :code, :value, :unit_code)",
-                {
-                    {"entity_id", "PHYSICAL_RISK"},
-                    {"sid", scenario_id},
-                    {"period_id", damage.period},
-                    {"code", driver_code},
-                    {"value", -damage.inventory_loss_amount},
-                    {"unit_code", damage.currency}
+    std::vector<StochasticEvent> events = load_events(catalogue_code);
+    std::vector<AssetExposure> assets = load_assets();
+
+    std::vector<std::pair<double, double>> locations;
+    locations.reserve(assets.size());
+    for (const auto& asset : assets) {
+        locations.emplace_back(asset.latitude, asset.longitude);
+    }
+    const SpatialIndex index(locations);
+    const GeoCoordinates coordinates(locations);
+    const DamageCurveAssignment curves = assign_curves(assets);
+
+    // Event loss table: each event's non-zero losses per asset, calculated once
+    struct EventLoss {
+        size_t asset;
+        double ppe;
+        double inventory;
+        double bi;
+    };
+    std::vector<std::vector<EventLoss>> event_losses(events.size());
+    std::vector<DamageBlock> blocks(workers());
+    for_each(events.size(), [&](size_t begin, size_t end, size_t worker) {
+        DamageBlock& block = blocks[worker];
+        for (size_t e = begin; e < end; ++e) {
+            const auto& event = events[e];
+            PhysicalPeril peril{};
+            peril.peril_id = HAZARD_MAP_PERIL_ID;
+            peril.peril_type = event.peril_type;
+            peril.latitude = event.latitude;
+            peril.longitude = event.longitude;
+            peril.intensity = event.intensity;
+            peril.radius_km = event.radius_km;
+
+            const double reach_km = (peril.radius_km <= 0.0) ? 1.0 : peril.radius_km;
+            const std::vector<size_t> nearby = index.query_radius(peril.latitude, peril.longitude, reach_km);
+            evaluate_block(peril, coordinates, curves, nearby.data(), nearby.size(), block);
+            for (size_t i = 0; i < block.assets.size(); ++i) {
+                const DamageResult damage = calculate_damage(assets[block.assets[i]], peril, 0, block, i);
+                const double total = damage.ppe_loss_amount + damage.inventory_loss_amount + damage.bi_loss_amount;
+                if (total > 0.0) {
+                    event_losses[e].push_back({block.assets[i], damage.ppe_loss_amount,
+                                               damage.inventory_loss_amount, damage.bi_loss_amount});
                 }
-            );
-            driver_count++;
+            }
+        }
+    });
+
+    MonteCarloResult result;
+    result.catalogue_code = catalogue_code;
+    result.years = options.years;
+    result.events = events.size();
+
+    // Expected annual losses are exact: rate × loss summed over events
+    std::map<std::pair<size_t, std::string>, AssetExpectedLoss> expected;
+    std::vector<double> asset_eal(assets.size(), 0.0);
+    for (size_t e = 0; e < events.size(); ++e) {
+        const double rate = events[e].annual_rate;
+        for (const auto& loss : event_losses[e]) {
+            const auto& asset = assets[loss.asset];
+            auto [it, added] = expected.try_emplace({loss.asset, events[e].peril_type});
+            if (added) {
+                it->second = {asset.asset_id, asset.asset_code, asset.entity_code,
+                              events[e].peril_type, asset.replacement_currency};
+            }
+            it->second.ppe += rate * loss.ppe;
+            it->second.inventory += rate * loss.inventory;
+            it->second.bi += rate * loss.bi;
+            asset_eal[loss.asset] += rate * (loss.ppe + loss.inventory + loss.bi);
+        }
+    }
+    for (auto& [key, loss] : expected) {
+        result.expected_losses.push_back(std::move(loss));
+    }
+
+    // Affected assets and their entities get distributions
+    std::vector<size_t> asset_slot(assets.size(), SIZE_MAX);
+    std::vector<size_t> affected;
+    std::map<std::string, size_t> entity_slots;
+    for (size_t a = 0; a < assets.size(); ++a) {
+        if (asset_eal[a] > 0.0) {
+            asset_slot[a] = affected.size();
+            affected.push_back(a);
+            entity_slots.try_emplace(assets[a].entity_code, 0);
+        }
+    }
+    size_t next_entity = 0;
+    for (auto& [code, slot] : entity_slots) {
+        slot = next_entity++;
+    }
+    std::vector<size_t> entity_of(affected.size());
+    std::vector<double> entity_eal(entity_slots.size(), 0.0);
+    for (size_t s = 0; s < affected.size(); ++s) {
+        entity_of[s] = entity_slots[assets[affected[s]].entity_code];
+        entity_eal[entity_of[s]] += asset_eal[affected[s]];
+        result.portfolio.expected_annual_loss += asset_eal[affected[s]];
+    }
+
+    // Occurrences: Poisson(total rate) events a year, each picked in
+    // proportion to its rate
+    std::vector<double> cumulative_rate;
+    std::vector<size_t> rated_events;
+    double total_rate = 0.0;
+    for (size_t e = 0; e < events.size(); ++e) {
+        if (events[e].annual_rate > 0.0 && !event_losses[e].empty()) {
+            total_rate += events[e].annual_rate;
+            cumulative_rate.push_back(total_rate);
+            rated_events.push_back(e);
         }
+    }
+
+    // Per worker: sketches of the years it simulated (only years with a
+    // loss are added; the others are added as zeros after merging)
+    struct YearAccumulator {
+        LossSketch portfolio;
+        std::vector<LossSketch> entities;
+        std::vector<LossSketch> assets;
+        std::vector<double> asset_loss;
+        std::vector<double> entity_loss;
+        std::vector<size_t> touched_assets;
+        std::vector<size_t> touched_entities;
+    };
+    std::vector<YearAccumulator> accumulators;
+    accumulators.reserve(workers());
+    for (size_t w = 0; w < workers(); ++w) {
+        accumulators.push_back({
+            empty_sketch,
+            std::vector<LossSketch>(entity_slots.size(), empty_sketch),
+            std::vector<LossSketch>(options.per_asset ? affected.size() : 0, empty_sketch),
+            std::vector<double>(affected.size(), 0.0),
+            std::vector<double>(entity_slots.size(), 0.0),
+            {},
+            {}
+        });
+    }
 
-        // BI driver
-        if (damage.bi_loss_amount > 0.0) {
-            std::string driver_code = map_damage_to_driver(damage.peril_type, "BI", damage.asset_code);
-            db_->execute_update(
-                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
-                "VALUES (:entity_id, :sid, :period_id, :code, :value, :unit_code)",
-                {
-                    {"entity_id", "PHYSICAL_RISK"},
-                    {"sid", scenario_id},
-                    {"period_id", damage.period},
-                    {"code", driver_code},
-                    {"value", -damage.bi_loss_amount},
-                    {"unit_code", damage.currency}
+    for_each(options.years, [&](size_t begin, size_t end, size_t worker) {
+        YearAccumulator& acc = accumulators[worker];
+        for (size_t year = begin; year < end; ++year) {
+            PhiloxStream rng(options.seed, year);
+            const uint64_t occurrences = rng.poisson(total_rate);
+            double year_loss = 0.0;
+            for (uint64_t k = 0; k < occurrences; ++k) {
+                const double u = rng.uniform() * total_rate;
+                const size_t pick = std::min<size_t>(
+                    std::upper_bound(cumulative_rate.begin(), cumulative_rate.end(), u) - cumulative_rate.begin(),
+                    cumulative_rate.size() - 1);
+                for (const auto& loss : event_losses[rated_events[pick]]) {
+                    const size_t slot = asset_slot[loss.asset];
+                    if (acc.asset_loss[slot] == 0.0) {
+                        acc.touched_assets.push_back(slot);
+                    }
+                    const double amount = loss.ppe + loss.inventory + loss.bi;
+                    acc.asset_loss[slot] += amount;
+                    year_loss += amount;
+                }
+            }
+            if (year_loss <= 0.0) {
+                continue;
+            }
+
+            acc.portfolio.add(year_loss);
+            for (size_t slot : acc.touched_assets) {
+                const size_t entity = entity_of[slot];
+                if (acc.entity_loss[entity] == 0.0) {
+                    acc.touched_entities.push_back(entity);
+                }
+                acc.entity_loss[entity] += acc.asset_loss[slot];
+                if (options.per_asset) {
+                    acc.assets[slot].add(acc.asset_loss[slot]);
                 }
-            );
-            driver_count++;
+                acc.asset_loss[slot] = 0.0;
+            }
+            for (size_t entity : acc.touched_entities) {
+                acc.entities[entity].add(acc.entity_loss[entity]);
+                acc.entity_loss[entity] = 0.0;
+            }
+            acc.touched_assets.clear();
+            acc.touched_entities.clear();
+        }
+    });
+
+    // Merge (integer bucket counts: the same for any split of the years)
+    YearAccumulator& merged = accumulators[0];
+    for (size_t w = 1; w < accumulators.size(); ++w) {
+        merged.portfolio.merge(accumulators[w].portfolio);
+        for (size_t i = 0; i < merged.entities.size(); ++i) {
+            merged.entities[i].merge(accumulators[w].entities[i]);
+        }
+        for (size_t i = 0; i < merged.assets.size(); ++i) {
+            merged.assets[i].merge(accumulators[w].assets[i]);
         }
     }
 
-    return driver_count;
+    // VaR at return period T: the (years / T)-th worst year; TVaR: mean of
+    // those worst years
+    auto statistics = [&](LossSketch& sketch, double expected_annual_loss) {
+        sketch.add(0.0, options.years - sketch.count());
+        LossStatistics stats;
+        stats.expected_annual_loss = expected_annual_loss;
+        for (double return_period : options.return_periods) {
+            const auto worst = std::max<uint64_t>(
+                1, static_cast<uint64_t>(std::llround(static_cast<double>(options.years) / return_period)));
+            stats.tail.push_back({return_period, sketch.top_value(worst), sketch.top_mean(worst)});
+        }
+        return stats;
+    };
+    result.portfolio = statistics(merged.portfolio, result.portfolio.expected_annual_loss);
+    for (const auto& [code, slot] : entity_slots) {
+        result.entities[code] = statistics(merged.entities[slot], entity_eal[slot]);
+    }
+    for (size_t s = 0; s < merged.assets.size(); ++s) {
+        result.assets[assets[affected[s]].asset_id] = statistics(merged.assets[s], asset_eal[affected[s]]);
+    }
+
+    return result;
+}
+
+int PhysicalRiskEngine::generate_loss_drivers(
+    int scenario_id,
+    const MonteCarloResult& result,
+    const std::vector<int>& periods,
+    double return_period
+) {
+    std::vector<DamageResult> damages;
+    damages.reserve(result.expected_losses.size() * periods.size());
+    for (const auto& loss : result.expected_losses) {
+        double scale = 1.0;
+        if (return_period > 0.0) {
+            auto asset = result.assets.find(loss.asset_id);
+            const TailLoss* tail = (asset != result.assets.end()) ? asset->second.at(return_period) : nullptr;
+            if (!tail) {
+                throw std::invalid_argument(
+                    "PhysicalRiskEngine: no " + std::to_string(return_period) +
+                    "-year statistics of asset " + loss.asset_code + " (simulate with per_asset)");
+            }
+            scale = tail->var / asset->second.expected_annual_loss;
+        }
+
+        for (int period : periods) {
+            DamageResult damage{};
+            damage.asset_id = loss.asset_id;
+            damage.asset_code = loss.asset_code;
+            damage.peril_id = HAZARD_MAP_PERIL_ID;
+            damage.peril_code = result.catalogue_code;
+            damage.peril_type = loss.peril_type;
+            damage.period = period;
+            damage.ppe_loss_amount = loss.ppe * scale;
+            damage.inventory_loss_amount = loss.inventory * scale;
+            damage.bi_loss_amount = loss.bi * scale;
+            damage.currency = loss.currency;
+            damages.push_back(std::move(damage));
+        }
+    }
+    return generate_drivers(scenario_id, damages);
 }
 
 int PhysicalRiskEngine::process_scenario(int scenario_id) {
@@ -0,0 +1,253 @@
+#include "physical_risk/spatial_index.h"
+#include "database/result_set.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace physical_risk {
+
+namespace {
+
+// Must match GeoUtils (mean Earth radius)
+constexpr double EARTH_RADIUS_KM = 6371.0;
+
+// Added to every query radius so rounding in the chord conversion can't drop
+// a location that haversine_distance() puts exactly on the boundary
+constexpr double QUERY_MARGIN_KM = 1e-3;
+
+// Great circle distance of a chord² between unit vectors (as GeoUtils)
+double chord_to_km(double chord_sq) {
+    const double a = std::min(chord_sq / 4.0, 1.0);
+    return EARTH_RADIUS_KM * 2.0 * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+}
+
+} // namespace
+
+SpatialIndex::SpatialIndex(const std::vector<std::pair<double, double>>& locations) {
+    std::vector<Point> source;
+    source.reserve(locations.size());
+    for (const auto& [lat, lon] : locations) {
+        source.push_back(to_unit_vector(lat, lon));
+    }
+    ids_.resize(locations.size());
+    std::iota(ids_.begin(), ids_.end(), 0u);
+    build(source, 0, ids_.size(), 0);
+
+    // Points in tree order, so queries read them sequentially
+    points_.reserve(ids_.size());
+    for (uint32_t id : ids_) {
+        points_.push_back(source[id]);
+    }
+}
+
+SpatialIndex::Point SpatialIndex::to_unit_vector(double lat, double lon) {
+    const double lat_rad = lat * M_PI / 180.0;
+    const double lon_rad = lon * M_PI / 180.0;
+    return {std::cos(lat_rad) * std::cos(lon_rad), std::cos(lat_rad) * std::sin(lon_rad), std::sin(lat_rad)};
+}
+
+void SpatialIndex::build(const std::vector<Point>& source, size_t begin, size_t end, int axis) {
+    if (end - begin <= 1) {
+        return;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    std::nth_element(ids_.begin() + begin, ids_.begin() + mid, ids_.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return source[a][axis] < source[b][axis]; });
+
+    const int next = (axis + 1) % 3;
+    build(source, begin, mid, next);
+    build(source, mid + 1, end, next);
+}
+
+std::vector<size_t> SpatialIndex::query_radius(double lat, double lon, double radius_km) const {
+    std::vector<size_t> out;
+    if (points_.empty() || radius_km < 0.0) {
+        return out;
+    }
+
+    // Great circle distance d → chord 2 sin(d / 2R) on the unit sphere
+    const double angle = std::min((radius_km + QUERY_MARGIN_KM) / EARTH_RADIUS_KM, M_PI);
+    const double chord = 2.0 * std::sin(angle / 2.0) + 1e-12;
+    query(0, points_.size(), 0, to_unit_vector(lat, lon), chord * chord, out);
+
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void SpatialIndex::query(size_t begin, size_t end, int axis, const Point& center, double chord_sq,
+                         std::vector<size_t>& out) const {
+    while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        const Point& p = points_[mid];
+        const double dx = p[0] - center[0];
+        const double dy = p[1] - center[1];
+        const double dz = p[2] - center[2];
+        if (dx * dx + dy * dy + dz * dz <= chord_sq) {
+            out.push_back(ids_[mid]);
+        }
+
+        // Left holds coordinates <= the median's, right >= it
+        const double offset = center[axis] - p[axis];
+        const int next = (axis + 1) % 3;
+        const bool reach_left = offset <= 0.0 || offset * offset <= chord_sq;
+        const bool reach_right = offset >= 0.0 || offset * offset <= chord_sq;
+        if (reach_left && reach_right) {
+            query(mid + 1, end, next, center, chord_sq, out);
+            end = mid;
+        } else if (reach_left) {
+            end = mid;
+        } else {
+            begin = mid + 1;
+        }
+        axis = next;
+    }
+}
+
+std::vector<SpatialIndex::Neighbor> SpatialIndex::query_nearest(double lat, double lon, size_t k) const {
+    std::vector<Neighbor> out;
+    k = std::min(k, points_.size());
+    if (k == 0) {
+        return out;
+    }
+
+    std::vector<Candidate> heap;
+    heap.reserve(k);
+    nearest(0, points_.size(), 0, to_unit_vector(lat, lon), k, heap);
+    std::sort_heap(heap.begin(), heap.end());
+
+    out.reserve(heap.size());
+    for (const auto& [chord_sq, id] : heap) {
+        out.push_back({id, chord_to_km(chord_sq)});
+    }
+    return out;
+}
+
+size_t SpatialIndex::nearest(double lat, double lon) const {
+    auto found = query_nearest(lat, lon, 1);
+    return found.empty() ? NO_LOCATION : found.front().index;
+}
+
+void SpatialIndex::nearest(size_t begin, size_t end, int axis, const Point& center, size_t k,
+                           std::vector<Candidate>& heap) const {
+    if (begin >= end) {
+        return;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    const Point& p = points_[mid];
+    const double dx = p[0] - center[0];
+    const double dy = p[1] - center[1];
+    const double dz = p[2] - center[2];
+    const Candidate candidate{dx * dx + dy * dy + dz * dz, ids_[mid]};
+    if (heap.size() < k) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (candidate < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    // The center's side first; the other one only if its half-space can
+    // hold something as near as the worst kept (ties decided by index)
+    const double offset = center[axis] - p[axis];
+    const int next = (axis + 1) % 3;
+    if (offset <= 0.0) {
+        nearest(begin, mid, next, center, k, heap);
+        if (heap.size() < k || offset * offset <= heap.front().first) {
+            nearest(mid + 1, end, next, center, k, heap);
+        }
+    } else {
+        nearest(mid + 1, end, next, center, k, heap);
+        if (heap.size() < k || offset * offset <= heap.front().first) {
+            nearest(begin, mid, next, center, k, heap);
+        }
+    }
+}
+
+void SpatialIndex::query_nearest_batch(const double* lats, const double* lons, size_t count, size_t k,
+                                       size_t* indices, double* distances_km,
+                                       finmodel::core::ThreadPool* pool) const {
+    if (k == 0) {
+        return;
+    }
+    auto run = [&](size_t begin, size_t end, size_t) {
+        for (size_t q = begin; q < end; ++q) {
+            const auto found = query_nearest(lats[q], lons[q], k);
+            for (size_t j = 0; j < k; ++j) {
+                const bool hit = j < found.size();
+                indices[q * k + j] = hit ? found[j].index : NO_LOCATION;
+                if (distances_km) {
+                    distances_km[q * k + j] = hit ? found[j].distance_km : std::numeric_limits<double>::infinity();
+                }
+            }
+        }
+    };
+    if (pool) {
+        pool->parallel_for(count, run, 64);
+    } else {
+        run(0, count, 0);
+    }
+}
+
+void SpatialIndex::store(finmodel::database::IDatabase& db, const std::string& index_code) const {
+    std::vector<finmodel::ParamMap> rows;
+    rows.reserve(points_.size());
+    for (size_t slot = 0; slot < points_.size(); ++slot) {
+        rows.push_back({{"code", index_code},
+                        {"slot", static_cast<int>(slot)},
+                        {"location", static_cast<int>(ids_[slot])},
+                        {"x", points_[slot][0]},
+                        {"y", points_[slot][1]},
+                        {"z", points_[slot][2]}});
+    }
+
+    const bool own_transaction = !db.in_transaction();
+    if (own_transaction) {
+        db.begin_transaction();
+    }
+    try {
+        db.execute_update("DELETE FROM spatial_index_point WHERE index_code = :code", {{"code", index_code}});
+        db.execute_batch(
+            "INSERT INTO spatial_index_point (index_code, slot, location_index, x, y, z) "
+            "VALUES (:code, :slot, :location, :x, :y, :z)", rows);
+        if (own_transaction) {
+            db.commit();
+        }
+    } catch (...) {
+        if (own_transaction) {
+            db.rollback();
+        }
+        throw;
+    }
+}
+
+SpatialIndex SpatialIndex::load(finmodel::database::IDatabase& db, const std::string& index_code) {
+    auto result = db.execute_query(
+        "SELECT slot, location_index, x, y, z FROM spatial_index_point "
+        "WHERE index_code = :code ORDER BY slot",
+        {{"code", index_code}});
+
+    SpatialIndex index;
+    for (auto [slot, location, x, y, z] : result->rows<int, int, double, double, double>()) {
+        if (slot != static_cast<int>(index.ids_.size()) || location < 0) {
+            throw std::runtime_error("SpatialIndex: slots of index " + index_code + " aren't a tree");
+        }
+        index.ids_.push_back(static_cast<uint32_t>(location));
+        index.points_.push_back({x, y, z});
+    }
+    if (index.ids_.empty()) {
+        throw std::runtime_error("SpatialIndex: no index " + index_code);
+    }
+
+    // Every location once
+    std::vector<uint8_t> seen(index.ids_.size(), 0);
+    for (uint32_t id : index.ids_) {
+        if (id >= seen.size() || seen[id]++) {
+            throw std::runtime_error("SpatialIndex: slots of index " + index_code + " aren't a tree");
+        }
+    }
+    return index;
+}
+
+} // namespace physical_risk
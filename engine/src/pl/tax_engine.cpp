@@ -24,13 +24,54 @@ double TaxEngine::compute_tax(
     const core::Context& ctx,
     const std::string& strategy_name
 ) {
-    auto it = strategies_.find(strategy_name);
-    if (it == strategies_.end()) {
+    return compute_tax(resolve(strategy_name), pre_tax_income, ctx);
+}
+
+TaxStrategyHandle TaxEngine::resolve(const std::string& strategy_name) const {
+    auto it = handles_.find(strategy_name);
+    if (it == handles_.end()) {
         throw std::runtime_error("Tax strategy not found: " + strategy_name);
     }
+    return it->second;
+}
 
-    std::map<std::string, double> params;  // Empty for now
-    return it->second->calculate_tax(pre_tax_income, ctx, params);
+double TaxEngine::compute_tax(TaxStrategyHandle strategy, double pre_tax_income, const core::Context& ctx) const {
+    return strategies_.at(strategy)->calculate_tax(pre_tax_income, ctx, no_params_);
+}
+
+void TaxEngine::compute_tax(
+    TaxStrategyHandle strategy,
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    const core::Context& ctx
+) const {
+    strategies_.at(strategy)->calculate_tax_batch(pre_tax_income, tax, ctx, no_params_);
+}
+
+core::FormulaEvaluator::CustomFunctionHandler TaxEngine::bind(const core::CompiledFormula& compiled) const {
+    static const std::string prefix = "TAX_COMPUTE:";
+    std::vector<std::pair<const std::string*, TaxStrategyHandle>> calls;
+    for (const auto& call : compiled.functions()) {
+        if (call.name.rfind(prefix, 0) == 0) {
+            calls.emplace_back(&call.name, resolve(call.name.substr(prefix.size())));
+        }
+    }
+
+    return [this, calls = std::move(calls)](const std::string& name, const std::vector<double>& args) {
+        if (args.size() != 1) {
+            throw std::runtime_error("TAX_COMPUTE requires exactly 1 argument (pre-tax income)");
+        }
+        const core::Context ctx;
+        for (const auto& [call_name, strategy] : calls) {
+            if (call_name == &name) {
+                return compute_tax(strategy, args[0], ctx);
+            }
+        }
+        if (name.rfind(prefix, 0) != 0) {
+            throw std::runtime_error("Unknown custom function: " + name);
+        }
+        return compute_tax(resolve(name.substr(prefix.size())), args[0], ctx);
+    };
 }
 
 double TaxEngine::get_effective_rate(
@@ -50,11 +91,17 @@ void TaxEngine::register_strategy(
     const std::string& name,
     std::unique_ptr<ITaxStrategy> strategy
 ) {
-    strategies_[name] = std::move(strategy);
+    auto it = handles_.find(name);
+    if (it != handles_.end()) {
+        strategies_[it->second] = std::move(strategy);
+        return;
+    }
+    handles_.emplace(name, static_cast<TaxStrategyHandle>(strategies_.size()));
+    strategies_.push_back(std::move(strategy));
 }
 
 bool TaxEngine::has_strategy(const std::string& name) const {
-    return strategies_.find(name) != strategies_.end();
+    return handles_.find(name) != handles_.end();
 }
 
 void TaxEngine::load_default_strategies() {
@@ -6,6 +6,7 @@
 #include "pl/tax_strategies/flat_rate_strategy.h"
 #include <algorithm>
 #include <sstream>
+#include <stdexcept>
 
 namespace finmodel {
 namespace pl {
@@ -28,6 +29,20 @@ double FlatRateTaxStrategy::calculate_tax(
     return pre_tax_income * rate_;
 }
 
+void FlatRateTaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    const core::Context& /*ctx*/,
+    const std::map<std::string, double>& /*params*/
+) const {
+    if (tax.size() != pre_tax_income.size()) {
+        throw std::invalid_argument("calculate_tax_batch: output size differs from input size");
+    }
+    for (size_t i = 0; i < pre_tax_income.size(); ++i) {
+        tax[i] = pre_tax_income[i] <= 0.0 ? 0.0 : pre_tax_income[i] * rate_;
+    }
+}
+
 std::string FlatRateTaxStrategy::name() const {
     return "FLAT_RATE";
 }
@@ -5,6 +5,7 @@
 
 #include "pl/tax_strategies/minimum_tax_strategy.h"
 #include <algorithm>
+#include <vector>
 
 namespace finmodel {
 namespace pl {
@@ -29,6 +30,20 @@ double MinimumTaxStrategy::calculate_tax(
     return std::max(regular_tax, alternative_tax);
 }
 
+void MinimumTaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    const core::Context& ctx,
+    const std::map<std::string, double>& params
+) const {
+    regular_->calculate_tax_batch(pre_tax_income, tax, ctx, params);
+    std::vector<double> alternative_tax(pre_tax_income.size());
+    alternative_->calculate_tax_batch(pre_tax_income, alternative_tax, ctx, params);
+    for (size_t i = 0; i < tax.size(); ++i) {
+        tax[i] = std::max(tax[i], alternative_tax[i]);
+    }
+}
+
 std::string MinimumTaxStrategy::name() const {
     return "MINIMUM_TAX";
 }
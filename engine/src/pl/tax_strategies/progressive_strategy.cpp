@@ -6,6 +6,7 @@
 #include "pl/tax_strategies/progressive_strategy.h"
 #include <algorithm>
 #include <sstream>
+#include <stdexcept>
 
 namespace finmodel {
 namespace pl {
@@ -18,6 +19,22 @@ ProgressiveTaxStrategy::ProgressiveTaxStrategy(const std::vector<Bracket>& brack
         [](const Bracket& a, const Bracket& b) {
             return a.threshold < b.threshold;
         });
+
+    // Income fills the brackets from the first, whatever its threshold
+    starts_.reserve(brackets_.size());
+    rates_.reserve(brackets_.size());
+    base_tax_.reserve(brackets_.size());
+    for (size_t i = 0; i < brackets_.size(); ++i) {
+        if (i == 0) {
+            starts_.push_back(0.0);
+            base_tax_.push_back(0.0);
+        } else {
+            const double bracket_size = brackets_[i].threshold - brackets_[i - 1].threshold;
+            starts_.push_back(starts_.back() + bracket_size);
+            base_tax_.push_back(base_tax_.back() + bracket_size * rates_.back());
+        }
+        rates_.push_back(brackets_[i].rate);
+    }
 }
 
 double ProgressiveTaxStrategy::calculate_tax(
@@ -25,46 +42,32 @@ double ProgressiveTaxStrategy::calculate_tax(
     const core::Context& ctx,
     const std::map<std::string, double>& params
 ) const {
-    // No tax on negative income
-    if (pre_tax_income <= 0.0) {
-        return 0.0;
-    }
+    return bracket_tax(pre_tax_income);
+}
 
-    if (brackets_.empty()) {
-        return 0.0;
+void ProgressiveTaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    const core::Context& /*ctx*/,
+    const std::map<std::string, double>& /*params*/
+) const {
+    if (tax.size() != pre_tax_income.size()) {
+        throw std::invalid_argument("calculate_tax_batch: output size differs from input size");
     }
-
-    double tax = 0.0;
-    double remaining_income = pre_tax_income;
-
-    // Process each bracket
-    for (size_t i = 0; i < brackets_.size(); ++i) {
-        const auto& bracket = brackets_[i];
-
-        // Skip if income hasn't reached this bracket
-        if (remaining_income <= 0.0) {
-            break;
-        }
-
-        // Determine the amount of income in this bracket
-        double bracket_income = 0.0;
-
-        if (i + 1 < brackets_.size()) {
-            // Not the last bracket - income is capped by next threshold
-            double next_threshold = brackets_[i + 1].threshold;
-            double bracket_size = next_threshold - bracket.threshold;
-            bracket_income = std::min(remaining_income, bracket_size);
-        } else {
-            // Last bracket - all remaining income
-            bracket_income = remaining_income;
-        }
-
-        // Apply tax rate to bracket income
-        tax += bracket_income * bracket.rate;
-        remaining_income -= bracket_income;
+    for (size_t i = 0; i < pre_tax_income.size(); ++i) {
+        tax[i] = bracket_tax(pre_tax_income[i]);
     }
+}
 
-    return tax;
+double ProgressiveTaxStrategy::bracket_tax(double pre_tax_income) const {
+    // No tax on negative income
+    if (pre_tax_income <= 0.0 || starts_.empty()) {
+        return 0.0;
+    }
+    // Last bracket starting below the income (the first starts at 0)
+    const size_t i = static_cast<size_t>(
+        std::lower_bound(starts_.begin(), starts_.end(), pre_tax_income) - starts_.begin()) - 1;
+    return base_tax_[i] + (pre_tax_income - starts_[i]) * rates_[i];
 }
 
 std::string ProgressiveTaxStrategy::name() const {
@@ -0,0 +1,50 @@
+/**
+ * @file tax_strategy.cpp
+ * @brief Default batch calculations of tax strategies
+ */
+
+#include "pl/tax_strategy.h"
+#include <stdexcept>
+#include <vector>
+
+namespace finmodel {
+namespace pl {
+
+void ITaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    const core::Context& ctx,
+    const std::map<std::string, double>& params
+) const {
+    if (tax.size() != pre_tax_income.size()) {
+        throw std::invalid_argument("calculate_tax_batch: output size differs from input size");
+    }
+    for (size_t i = 0; i < pre_tax_income.size(); ++i) {
+        tax[i] = calculate_tax(pre_tax_income[i], ctx, params);
+    }
+}
+
+void IStatefulTaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    std::span<double> states
+) const {
+    const size_t lanes = pre_tax_income.size();
+    const size_t size = state_size();
+    if (tax.size() != lanes || states.size() != size * lanes) {
+        throw std::invalid_argument("calculate_tax_batch: output or state size differs from input size");
+    }
+    std::vector<double> state(size);
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        for (size_t i = 0; i < size; ++i) {
+            state[i] = states[i * lanes + lane];
+        }
+        tax[lane] = calculate_tax(pre_tax_income[lane], state);
+        for (size_t i = 0; i < size; ++i) {
+            states[i * lanes + lane] = state[i];
+        }
+    }
+}
+
+} // namespace pl
+} // namespace finmodel
@@ -0,0 +1,50 @@
+/**
+ * @file capex_policy.cpp
+ * @brief Loading of capex policies
+ */
+
+#include "policy/capex_policy.h"
+#include "database/result_set.h"
+#include <optional>
+
+namespace finmodel {
+namespace policy {
+
+CapexPolicy::Method CapexPolicy::parse_method(const std::string& method) {
+    if (method == "fixed") {
+        return Method::FIXED;
+    }
+    if (method == "revenue_pct") {
+        return Method::REVENUE_PCT;
+    }
+    if (method == "depreciation_pct") {
+        return Method::DEPRECIATION_PCT;
+    }
+    throw std::invalid_argument("CapexPolicy: unknown method '" + method + "'");
+}
+
+std::map<std::string, CapexPolicy> CapexPolicy::load(database::IDatabase& db) {
+    std::map<std::string, CapexPolicy> policies;
+    auto rows = db.execute_query(
+        "SELECT code, method, fixed_amount, revenue_pct, depreciation_pct, useful_life_periods "
+        "FROM capex_policy WHERE is_active = 1 ORDER BY code", {});
+    for (auto [code, method, fixed, revenue, depreciation, life] :
+         rows->rows<std::string, std::string, std::optional<double>, std::optional<double>,
+                    std::optional<double>, std::optional<int>>()) {
+        CapexPolicy policy;
+        policy.code = code;
+        policy.method = parse_method(method);
+        policy.fixed_amount = fixed.value_or(policy.fixed_amount);
+        policy.revenue_pct = revenue.value_or(policy.revenue_pct);
+        policy.depreciation_pct = depreciation.value_or(policy.depreciation_pct);
+        policy.useful_life_periods = life.value_or(policy.useful_life_periods);
+        if (policy.useful_life_periods < 1) {
+            throw std::invalid_argument("CapexPolicy: useful life below 1 period in policy " + code);
+        }
+        policies.emplace(std::move(code), std::move(policy));
+    }
+    return policies;
+}
+
+} // namespace policy
+} // namespace finmodel
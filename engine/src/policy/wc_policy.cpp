@@ -1 +1,34 @@
-// TODO: Implement (M1/M2)
+/**
+ * @file wc_policy.cpp
+ * @brief Loading of working capital policies
+ */
+
+#include "policy/wc_policy.h"
+#include "database/result_set.h"
+#include <optional>
+#include <stdexcept>
+
+namespace finmodel {
+namespace policy {
+
+std::map<std::string, WorkingCapitalPolicy> WorkingCapitalPolicy::load(database::IDatabase& db) {
+    std::map<std::string, WorkingCapitalPolicy> policies;
+    auto rows = db.execute_query(
+        "SELECT code, dso_days, dpo_days, dio_days FROM wc_policy WHERE is_active = 1 ORDER BY code", {});
+    for (auto [code, dso, dpo, dio] :
+         rows->rows<std::string, std::optional<double>, std::optional<double>, std::optional<double>>()) {
+        WorkingCapitalPolicy policy;
+        policy.code = code;
+        policy.dso_days = dso.value_or(policy.dso_days);
+        policy.dpo_days = dpo.value_or(policy.dpo_days);
+        policy.dio_days = dio.value_or(policy.dio_days);
+        if (policy.dso_days < 0.0 || policy.dpo_days < 0.0 || policy.dio_days < 0.0) {
+            throw std::invalid_argument("WorkingCapitalPolicy: negative days in policy " + code);
+        }
+        policies.emplace(std::move(code), std::move(policy));
+    }
+    return policies;
+}
+
+} // namespace policy
+} // namespace finmodel
@@ -1 +1,106 @@
-// TODO: Implement (M1/M2)
+/**
+ * @file loss_carryforward_tax_strategy.cpp
+ * @brief Loss carryforward tax strategy implementation
+ */
+
+#include "tax/loss_carryforward_tax_strategy.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace pl {
+
+namespace {
+constexpr size_t POOL = 0;      // Losses available
+constexpr size_t OLDEST = 1;    // Ring position of the oldest vintage
+constexpr size_t VINTAGES = 2;  // First of expiry_periods vintages
+}
+
+LossCarryforwardTaxStrategy::LossCarryforwardTaxStrategy(double rate, size_t expiry_periods,
+                                                         double utilisation_limit)
+    : rate_(rate), expiry_(expiry_periods), limit_(utilisation_limit)
+{
+    if (!(utilisation_limit >= 0.0 && utilisation_limit <= 1.0)) {
+        throw std::invalid_argument("LossCarryforwardTaxStrategy: utilisation limit must be in [0, 1]");
+    }
+}
+
+size_t LossCarryforwardTaxStrategy::state_size() const {
+    return expiry_ == 0 ? 1 : VINTAGES + expiry_;
+}
+
+void LossCarryforwardTaxStrategy::initial_state(std::span<double> state) const {
+    std::fill(state.begin(), state.end(), 0.0);
+}
+
+template <typename State>
+double LossCarryforwardTaxStrategy::step(double pre_tax_income, State&& value) const {
+    double& pool = value(POOL);
+    double tax = 0.0;
+    double loss = 0.0;
+    if (pre_tax_income > 0.0) {
+        double used = std::min(pool, limit_ * pre_tax_income);
+        tax = (pre_tax_income - used) * rate_;
+        pool -= used;
+        // Oldest losses first
+        for (size_t i = 0; expiry_ > 0 && used > 0.0 && i < expiry_; ++i) {
+            double& vintage = value(VINTAGES + (static_cast<size_t>(value(OLDEST)) + i) % expiry_);
+            const double taken = std::min(vintage, used);
+            vintage -= taken;
+            used -= taken;
+        }
+    } else {
+        loss = -pre_tax_income;
+    }
+
+    if (expiry_ > 0) {
+        // The oldest vintage can't be used after this period: its slot takes this period's loss
+        const auto oldest = static_cast<size_t>(value(OLDEST));
+        double& vintage = value(VINTAGES + oldest);
+        pool -= vintage;
+        vintage = loss;
+        value(OLDEST) = static_cast<double>((oldest + 1) % expiry_);
+    }
+    pool = std::max(0.0, pool + loss);
+    return tax;
+}
+
+double LossCarryforwardTaxStrategy::calculate_tax(double pre_tax_income, std::span<double> state) const {
+    if (state.size() != state_size()) {
+        throw std::invalid_argument("LossCarryforwardTaxStrategy: state has the wrong size");
+    }
+    return step(pre_tax_income, [&](size_t i) -> double& { return state[i]; });
+}
+
+void LossCarryforwardTaxStrategy::calculate_tax_batch(
+    std::span<const double> pre_tax_income,
+    std::span<double> tax,
+    std::span<double> states
+) const {
+    const size_t lanes = pre_tax_income.size();
+    if (tax.size() != lanes || states.size() != state_size() * lanes) {
+        throw std::invalid_argument("calculate_tax_batch: output or state size differs from input size");
+    }
+    if (expiry_ == 0) {
+        // One pool per lane: a branch-free loop the compiler vectorises
+        double* pool = states.data();
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const double income = pre_tax_income[lane];
+            const double profit = std::max(income, 0.0);
+            const double used = std::min(pool[lane], limit_ * profit);
+            tax[lane] = (profit - used) * rate_;
+            pool[lane] = std::max(0.0, pool[lane] - used + std::max(-income, 0.0));
+        }
+        return;
+    }
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        tax[lane] = step(pre_tax_income[lane], [&](size_t i) -> double& { return states[i * lanes + lane]; });
+    }
+}
+
+std::string LossCarryforwardTaxStrategy::name() const {
+    return "LOSS_CARRYFORWARD";
+}
+
+} // namespace pl
+} // namespace finmodel
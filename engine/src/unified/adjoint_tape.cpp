@@ -0,0 +1,151 @@
+/**
+ * @file adjoint_tape.cpp
+ * @brief Tape of local derivatives and its reverse sweep
+ */
+
+#include "unified/adjoint_tape.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace unified {
+
+AdjointTape::AdjointTape(std::vector<PeriodID> period_ids)
+    : period_ids_(std::move(period_ids))
+{
+    for (size_t i = 0; i < period_ids_.size(); ++i) {
+        if (i > 0 && period_ids_[i] <= period_ids_[i - 1]) {
+            throw std::invalid_argument("AdjointTape: periods must be ascending");
+        }
+        period_index_.emplace(period_ids_[i], i);
+    }
+}
+
+std::optional<PeriodID> AdjointTape::previous(PeriodID period_id) const {
+    auto it = period_index_.find(period_id);
+    if (it == period_index_.end() || it->second == 0) {
+        return std::nullopt;
+    }
+    return period_ids_[it->second - 1];
+}
+
+void AdjointTape::begin_period(PeriodID period_id, std::shared_ptr<const ResultSchema> schema) {
+    while (!periods_.empty() && periods_.back().period_id >= period_id) {
+        periods_.pop_back();
+    }
+    Period period;
+    period.period_id = period_id;
+    period.schema = std::move(schema);
+    period.offsets.push_back(0);
+    periods_.push_back(std::move(period));
+}
+
+void AdjointTape::add_step(const std::vector<Edge>& edges) {
+    if (periods_.empty()) {
+        throw std::logic_error("AdjointTape: add_step() before begin_period()");
+    }
+    Period& period = periods_.back();
+    const size_t step = period.codes.size();
+    if (!period.schema || step >= period.schema->size()) {
+        throw std::logic_error("AdjointTape: more steps than the period's line items");
+    }
+    period.codes.push_back(code_id(period.schema->code(static_cast<uint32_t>(step))));
+    period.edges.insert(period.edges.end(), edges.begin(), edges.end());
+    period.offsets.push_back(static_cast<uint32_t>(period.edges.size()));
+    peak_bytes_ = std::max(peak_bytes_, bytes());
+}
+
+uint32_t AdjointTape::driver_id(const std::string& driver_code) {
+    auto [it, added] = driver_ids_.emplace(driver_code, static_cast<uint32_t>(drivers_.size()));
+    if (added) {
+        drivers_.push_back(driver_code);
+        driver_adjoints_.push_back(0.0);
+    }
+    return it->second;
+}
+
+uint32_t AdjointTape::code_id(const std::string& code) {
+    auto [it, added] = code_ids_.emplace(code, static_cast<uint32_t>(codes_.size()));
+    if (added) {
+        codes_.push_back(code);
+    }
+    return it->second;
+}
+
+void AdjointTape::seed(PeriodID period_id, const std::string& code, double adjoint) {
+    pending_[{period_id, code_id(code)}] += adjoint;
+}
+
+void AdjointTape::sweep() {
+    for (auto period = periods_.rbegin(); period != periods_.rend(); ++period) {
+        const size_t steps = period->codes.size();
+        step_adjoints_.assign(steps, 0.0);
+
+        // Adjoints flowing into this period: from later periods and seeds
+        auto first = pending_.lower_bound({period->period_id, 0});
+        auto last = pending_.lower_bound({period->period_id + 1, 0});
+        if (first == last) {
+            continue;
+        }
+        std::unordered_map<uint32_t, double> incoming;
+        for (auto it = first; it != last; ++it) {
+            incoming.emplace(it->first.second, it->second);
+        }
+        pending_.erase(first, last);
+        for (size_t i = 0; i < steps; ++i) {
+            auto it = incoming.find(period->codes[i]);
+            if (it != incoming.end()) {
+                step_adjoints_[i] = it->second;
+            }
+        }
+
+        // Steps read only earlier steps, so one pass in reverse order
+        for (size_t i = steps; i-- > 0;) {
+            const double adjoint = step_adjoints_[i];
+            if (adjoint == 0.0) {
+                continue;
+            }
+            for (uint32_t e = period->offsets[i]; e < period->offsets[i + 1]; ++e) {
+                const Edge& edge = period->edges[e];
+                const double flow = adjoint * edge.weight;
+                switch (edge.kind) {
+                    case Edge::Kind::STEP:
+                        step_adjoints_[edge.index] += flow;
+                        break;
+                    case Edge::Kind::DRIVER:
+                        driver_adjoints_[edge.index] += flow;
+                        break;
+                    case Edge::Kind::PERIOD:
+                        pending_[{edge.period, edge.index}] += flow;
+                        break;
+                }
+            }
+        }
+    }
+    periods_.clear();
+}
+
+std::map<std::string, double> AdjointTape::driver_adjoints() const {
+    std::map<std::string, double> out;
+    for (size_t i = 0; i < drivers_.size(); ++i) {
+        out[drivers_[i]] += driver_adjoints_[i];
+    }
+    return out;
+}
+
+double AdjointTape::driver_adjoint(const std::string& driver_code) const {
+    auto it = driver_ids_.find(driver_code);
+    return it == driver_ids_.end() ? 0.0 : driver_adjoints_[it->second];
+}
+
+size_t AdjointTape::bytes() const {
+    size_t total = 0;
+    for (const auto& period : periods_) {
+        total += sizeof(Period) + period.codes.capacity() * sizeof(uint32_t) +
+                 period.offsets.capacity() * sizeof(uint32_t) + period.edges.capacity() * sizeof(Edge);
+    }
+    return total;
+}
+
+} // namespace unified
+} // namespace finmodel
@@ -0,0 +1,179 @@
+/**
+ * @file diagnostics.cpp
+ * @brief Diagnostic catalog and record folding
+ */
+
+#include "unified/diagnostics.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace finmodel {
+namespace unified {
+
+static_assert(sizeof(Diagnostic) == 32, "Diagnostic records are meant to stay compact");
+
+namespace {
+
+struct CatalogEntry {
+    std::string before;
+    std::string after;
+    bool has_value = false;
+};
+
+class Catalog {
+public:
+    Catalog() { entries_.push_back({}); }   // 0: the empty message
+
+    uint32_t intern(std::string_view before, std::string_view after, bool has_value) {
+        // Before and after can't be told apart once joined: key on both, and the value flag
+        std::string key;
+        key.reserve(before.size() + after.size() + 2);
+        key.append(before).push_back('\0');
+        key.append(after).push_back(has_value ? '1' : '0');
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto [it, added] = index_.emplace(std::move(key), static_cast<uint32_t>(entries_.size()));
+        if (added) {
+            entries_.push_back({std::string(before), std::string(after), has_value});
+        }
+        return it->second;
+    }
+
+    std::string render(uint32_t id, double value) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (id >= entries_.size()) {
+            throw std::out_of_range("DiagnosticCatalog: no message " + std::to_string(id));
+        }
+        const CatalogEntry& entry = entries_[id];
+        if (!entry.has_value) {
+            return entry.before;
+        }
+        std::ostringstream out;
+        out << entry.before << value << entry.after;
+        return out.str();
+    }
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<CatalogEntry> entries_;   // Never moved: IDs index it
+    std::unordered_map<std::string, uint32_t> index_;
+};
+
+Catalog& catalog() {
+    static Catalog instance;
+    return instance;
+}
+
+} // namespace
+
+uint32_t DiagnosticCatalog::intern(std::string_view text) {
+    return catalog().intern(text, {}, false);
+}
+
+uint32_t DiagnosticCatalog::intern(std::string_view before, std::string_view after) {
+    return catalog().intern(before, after, true);
+}
+
+std::string DiagnosticCatalog::render(uint32_t id, double value) {
+    return catalog().render(id, value);
+}
+
+void Diagnostics::add(uint32_t code, double value, core::Symbol line_item) {
+    Diagnostic diagnostic;
+    diagnostic.code = code;
+    diagnostic.line_item = line_item;
+    diagnostic.value = value;
+    add(diagnostic);
+}
+
+void Diagnostics::add(std::string_view text) {
+    add(DiagnosticCatalog::intern(text));
+}
+
+void Diagnostics::add(const Diagnostic& diagnostic) {
+    // Distinct diagnostics of a run are few: a linear scan beats hashing
+    for (Diagnostic& record : records_) {
+        if (record.code == diagnostic.code && record.line_item == diagnostic.line_item &&
+            record.scenario == diagnostic.scenario) {
+            record.count += diagnostic.count;
+            if (diagnostic.period != Diagnostic::NO_PERIOD) {
+                if (record.period == Diagnostic::NO_PERIOD || diagnostic.period < record.period) {
+                    record.period = diagnostic.period;
+                }
+                record.last_period = std::max(record.last_period, diagnostic.last_period);
+            }
+            return;
+        }
+    }
+    records_.push_back(diagnostic);
+}
+
+void Diagnostics::merge(const Diagnostics& other, PeriodID period, ScenarioID scenario) {
+    for (Diagnostic record : other.records_) {
+        if (record.period == Diagnostic::NO_PERIOD) {
+            record.period = period;
+            record.last_period = period;
+            record.scenario = scenario;
+        }
+        add(record);
+    }
+}
+
+size_t Diagnostics::occurrences() const {
+    size_t total = 0;
+    for (const Diagnostic& record : records_) {
+        total += record.count;
+    }
+    return total;
+}
+
+std::string Diagnostics::message(size_t index) const {
+    const Diagnostic& record = records_.at(index);
+    std::string text;
+    if (record.period != Diagnostic::NO_PERIOD) {
+        text = "Period " + std::to_string(record.period) + ": ";
+    }
+    if (record.line_item != core::NO_SYMBOL) {
+        text += core::SymbolTable::global().name(record.line_item) + ": ";
+    }
+    text += DiagnosticCatalog::render(record.code, record.value);
+    if (record.count > 1) {
+        text += " (" + std::to_string(record.count) + " times";
+        if (record.period != Diagnostic::NO_PERIOD && record.last_period != record.period) {
+            text += ", periods " + std::to_string(record.period) + "-" + std::to_string(record.last_period);
+        }
+        text += ")";
+    }
+    return text;
+}
+
+std::vector<std::string> Diagnostics::messages() const {
+    std::vector<std::string> out;
+    out.reserve(records_.size());
+    for (size_t i = 0; i < records_.size(); ++i) {
+        out.push_back(message(i));
+    }
+    return out;
+}
+
+Diagnostics Diagnostics::from_messages(const std::vector<std::string>& messages) {
+    Diagnostics diagnostics;
+    for (const auto& text : messages) {
+        diagnostics.add(text);
+    }
+    return diagnostics;
+}
+
+} // namespace unified
+} // namespace finmodel
@@ -0,0 +1,44 @@
+/**
+ * @file action_activation_provider.cpp
+ * @brief Implementation of the action activation provider
+ */
+
+#include "unified/providers/action_activation_provider.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace unified {
+
+void ActionActivationProvider::set_activation(const std::map<std::string, double>& activation) {
+    clear();
+    for (const auto& [action_code, value] : activation) {
+        values_[static_cast<size_t>(resolve_slot("action:" + action_code))] = value;
+    }
+}
+
+void ActionActivationProvider::clear() {
+    std::fill(values_.begin(), values_.end(), 0.0);
+}
+
+double ActionActivationProvider::get_value(const std::string& key, const core::Context& ctx) const {
+    if (!is_action_key(key)) {
+        throw std::runtime_error("ActionActivationProvider: not an action key: " + key);
+    }
+    auto it = slots_.find(key.substr(7));
+    return (it != slots_.end()) ? get_slot_value(it->second, ctx) : 0.0;
+}
+
+int ActionActivationProvider::resolve_slot(const std::string& key) {
+    if (!is_action_key(key)) {
+        return NONE;
+    }
+    auto [it, added] = slots_.emplace(key.substr(7), static_cast<int>(values_.size()));
+    if (added) {
+        values_.push_back(0.0);
+    }
+    return it->second;
+}
+
+} // namespace unified
+} // namespace finmodel
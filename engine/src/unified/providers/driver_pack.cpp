@@ -0,0 +1,184 @@
+/**
+ * @file driver_pack.cpp
+ * @brief Implementation of packed scenario drivers
+ */
+
+#include "unified/providers/driver_pack.h"
+#include "database/result_set.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace unified {
+
+DriverPack DriverPack::build(database::IDatabase& db, const EntityID& entity_id, ScenarioID scenario_id) {
+    DriverPack pack;
+    pack.entity_id = entity_id;
+    pack.scenario_id = scenario_id;
+
+    struct Cell {
+        PeriodID period_id;
+        size_t column;
+        double value;
+    };
+    std::vector<Cell> cells;
+    std::map<std::pair<std::string, std::string>, size_t> columns;
+    auto result_set = db.execute_query(
+        "SELECT period_id, driver_code, unit_code, value FROM scenario_drivers "
+        "WHERE entity_id = :entity_id AND scenario_id = :scenario_id AND period_id IS NOT NULL ORDER BY rowid",
+        {{"entity_id", entity_id}, {"scenario_id", scenario_id}});
+    for (auto [period_id, driver_code, unit_code, value] :
+         result_set->rows<int, std::string_view, std::string_view, double>()) {
+        auto [column, added] = columns.try_emplace(std::make_pair(std::string(driver_code), std::string(unit_code)),
+                                                   columns.size());
+        if (added) {
+            pack.driver_codes.emplace_back(driver_code);
+            pack.unit_codes.emplace_back(unit_code);
+        }
+        cells.push_back({period_id, column->second, value});
+        pack.period_ids.push_back(period_id);
+    }
+
+    std::sort(pack.period_ids.begin(), pack.period_ids.end());
+    pack.period_ids.erase(std::unique(pack.period_ids.begin(), pack.period_ids.end()), pack.period_ids.end());
+    pack.values.assign(pack.period_ids.size() * pack.columns(), std::numeric_limits<double>::quiet_NaN());
+    for (const Cell& cell : cells) {   // In insertion order: the last duplicate wins
+        const size_t period = static_cast<size_t>(
+            std::lower_bound(pack.period_ids.begin(), pack.period_ids.end(), cell.period_id) -
+            pack.period_ids.begin());
+        pack.values[period * pack.columns() + cell.column] = cell.value;
+    }
+    return pack;
+}
+
+void DriverPack::store(database::IDatabase& db, const DriverPack& pack) {
+    if (pack.unit_codes.size() != pack.driver_codes.size() ||
+        pack.values.size() != pack.period_ids.size() * pack.columns()) {
+        throw std::invalid_argument("DriverPack: " + std::to_string(pack.values.size()) + " values for " +
+                                    std::to_string(pack.period_ids.size()) + " periods × " +
+                                    std::to_string(pack.columns()) + " drivers of " + pack.entity_id);
+    }
+
+    nlohmann::json drivers = nlohmann::json::array();
+    for (size_t c = 0; c < pack.columns(); ++c) {
+        drivers.push_back({pack.driver_codes[c], pack.unit_codes[c]});
+    }
+    Blob values(pack.values.size() * sizeof(double));
+    if (!values.empty()) {
+        std::memcpy(values.data(), pack.values.data(), values.size());
+    }
+
+    db.execute_update(
+        "INSERT OR REPLACE INTO scenario_driver_pack (entity_id, scenario_id, period_ids, drivers, driver_values) "
+        "VALUES (:entity_id, :scenario_id, :period_ids, :drivers, :driver_values)",
+        {{"entity_id", pack.entity_id},
+         {"scenario_id", pack.scenario_id},
+         {"period_ids", nlohmann::json(pack.period_ids).dump()},
+         {"drivers", drivers.dump()},
+         {"driver_values", std::move(values)}});
+}
+
+size_t DriverPack::pack(database::IDatabase& db, const EntityID& entity_id, ScenarioID scenario_id) {
+    DriverPack packed = build(db, entity_id, scenario_id);
+    store(db, packed);
+    return static_cast<size_t>(std::count_if(packed.values.begin(), packed.values.end(),
+                                             [](double value) { return !std::isnan(value); }));
+}
+
+size_t DriverPack::pack_all(database::IDatabase& db) {
+    std::vector<std::pair<EntityID, ScenarioID>> keys;
+    auto result_set = db.execute_query(
+        "SELECT DISTINCT entity_id, scenario_id FROM scenario_drivers "
+        "WHERE entity_id IS NOT NULL AND scenario_id IS NOT NULL ORDER BY entity_id, scenario_id", {});
+    for (auto [entity_id, scenario_id] : result_set->rows<std::string, int>()) {
+        keys.emplace_back(std::move(entity_id), scenario_id);
+    }
+    result_set.reset();
+
+    const bool own_transaction = !db.in_transaction();
+    if (own_transaction) {
+        db.begin_transaction();
+    }
+    try {
+        for (const auto& [entity_id, scenario_id] : keys) {
+            pack(db, entity_id, scenario_id);
+        }
+        if (own_transaction) {
+            db.commit();
+        }
+    } catch (...) {
+        if (own_transaction) {
+            db.rollback();
+        }
+        throw;
+    }
+    return keys.size();
+}
+
+std::vector<DriverPack> DriverPack::load(database::IDatabase& db, const std::vector<EntityID>& entity_ids,
+                                         const std::vector<ScenarioID>& scenario_ids) {
+    std::vector<DriverPack> packs;
+    if (entity_ids.empty() || scenario_ids.empty()) {
+        return packs;
+    }
+
+    std::ostringstream query;
+    query << "SELECT entity_id, scenario_id, period_ids, drivers, driver_values FROM scenario_driver_pack "
+          << "WHERE entity_id IN (";
+    ParamMap params;
+    for (size_t i = 0; i < entity_ids.size(); ++i) {
+        const std::string name = "entity_" + std::to_string(i);
+        query << (i ? ", :" : ":") << name;
+        params[name] = entity_ids[i];
+    }
+    query << ") AND scenario_id IN (";
+    for (size_t i = 0; i < scenario_ids.size(); ++i) {
+        const std::string name = "scenario_" + std::to_string(i);
+        query << (i ? ", :" : ":") << name;
+        params[name] = scenario_ids[i];
+    }
+    query << ")";
+
+    auto result_set = db.execute_query(query.str(), params);
+    for (auto [entity_id, scenario_id, period_ids, drivers, values] :
+         result_set->rows<std::string, int, std::string_view, std::string_view, std::span<const std::uint8_t>>()) {
+        DriverPack pack;
+        pack.entity_id = std::move(entity_id);
+        pack.scenario_id = scenario_id;
+        pack.period_ids = nlohmann::json::parse(period_ids).get<std::vector<PeriodID>>();
+        for (const auto& column : nlohmann::json::parse(drivers)) {
+            pack.driver_codes.push_back(column.at(0).get<std::string>());
+            pack.unit_codes.push_back(column.at(1).get<std::string>());
+        }
+        if (values.size() != pack.period_ids.size() * pack.columns() * sizeof(double)) {
+            throw std::runtime_error("DriverPack: pack of " + pack.entity_id + " in scenario " +
+                                     std::to_string(scenario_id) + " has " + std::to_string(values.size()) +
+                                     " bytes for " + std::to_string(pack.period_ids.size()) + " periods × " +
+                                     std::to_string(pack.columns()) + " drivers");
+        }
+        // Straight from SQLite's buffer into the matrix (the BLOB need not be aligned)
+        pack.values.resize(values.size() / sizeof(double));
+        if (!values.empty()) {
+            std::memcpy(pack.values.data(), values.data(), values.size());
+        }
+        packs.push_back(std::move(pack));
+    }
+    return packs;
+}
+
+bool DriverPack::available(database::IDatabase& db) {
+    auto result_set = db.execute_query(
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'scenario_driver_pack'", {});
+    return result_set && result_set->next();
+}
+
+} // namespace unified
+} // namespace finmodel
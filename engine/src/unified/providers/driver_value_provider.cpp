@@ -6,19 +6,30 @@
 #include "unified/providers/driver_value_provider.h"
 #include "database/result_set.h"
 #include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <set>
 #include <sstream>
 #include <nlohmann/json.hpp>
 
 namespace finmodel {
 namespace unified {
 
+namespace {
+
+// Entity of the physical risk drivers every entity reads
+const std::string PHYSICAL_RISK_ENTITY = "PHYSICAL_RISK";
+
+} // namespace
+
 DriverValueProvider::DriverValueProvider(
     std::shared_ptr<database::IDatabase> db,
-    std::shared_ptr<core::UnitConverter> unit_converter
+    std::shared_ptr<const core::UnitConverter> unit_converter,
+    std::shared_ptr<core::EntityDictionary> entities
 )
     : db_(db)
     , unit_converter_(unit_converter)
-    , entity_id_("")
+    , entities_(entities)
     , scenario_id_(0)
     , period_id_(0)
     , cache_loaded_(false)
@@ -26,20 +37,338 @@ DriverValueProvider::DriverValueProvider(
     if (!db_) {
         throw std::runtime_error("DriverValueProvider: null database pointer");
     }
+    if (!entities_) {
+        entities_ = std::make_shared<core::EntityDictionary>(db_);
+    }
 }
 
-void DriverValueProvider::set_context(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id) {
-    entity_id_ = entity_id;
+void DriverValueProvider::set_context(int entity, ScenarioID scenario_id, PeriodID period_id) {
+    entity_ = entity;
     scenario_id_ = scenario_id;
     period_id_ = period_id;
+    if (basis_days_ > 0.0) {
+        update_period_scale();
+    }
+
+    // Prefetched period: select its row
+    if (!prefetch_blocks_.empty() && scenario_id == prefetch_scenario_) {
+        auto block = prefetch_blocks_.find(entity);
+        auto row = prefetch_rows_.find(period_id);
+        if (block != prefetch_blocks_.end() && row != prefetch_rows_.end()) {
+            const PrefetchBlock& prefetched = block->second;
+            row_prefetched_ = true;
+            row_values_ = prefetched.values.data() + row->second * prefetched.width;
+            row_present_ = prefetched.present.data() + row->second * prefetched.width;
+            row_width_ = prefetched.width;
+            cache_loaded_ = true;
+            return;
+        }
+    }
 
     // Clear cache when context changes
-    driver_cache_.clear();
+    row_prefetched_ = false;
+    std::fill(driver_present_.begin(), driver_present_.end(), 0);
+    use_loaded_row();
     cache_loaded_ = false;
 }
 
+void DriverValueProvider::prefetch(int entity, ScenarioID scenario_id,
+                                   const std::vector<PeriodID>& period_ids) {
+    prefetch(std::vector<int>{entity}, scenario_id, period_ids);
+}
+
+void DriverValueProvider::prefetch(const std::vector<int>& entities, ScenarioID scenario_id,
+                                   const std::vector<PeriodID>& period_ids) {
+    std::vector<DriverRows> rows(entities.size());
+    if (!period_ids.empty() && !entities.empty()) {
+        std::vector<ScenarioID> chain = ancestors(scenario_id);
+        chain.push_back(scenario_id);
+        for (size_t i = 0; i < entities.size(); ++i) {
+            rows[i].entity_id = entities_->code(entities[i]);
+            rows[i].scenario_id = scenario_id;
+            rows[i].chain = chain;
+        }
+        query_rows(*db_, period_ids, rows);
+    }
+
+    reset_prefetch(period_ids);
+    if (period_ids.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < entities.size(); ++i) {
+        build_block(rows[i], prefetch_blocks_[entities[i]]);
+    }
+    prefetch_scenario_ = scenario_id;
+}
+
+DriverValueProvider::DriverRows DriverValueProvider::fetch_rows(database::IDatabase& db, const EntityID& entity_id,
+                                                                ScenarioID scenario_id,
+                                                                const std::vector<PeriodID>& period_ids) {
+    DriverRows rows;
+    rows.entity_id = entity_id;
+    rows.scenario_id = scenario_id;
+    if (!period_ids.empty()) {
+        rows.chain = ancestor_chain(scenario_id, [&db](ScenarioID id) { return query_parent(db, id); });
+        rows.chain.push_back(scenario_id);
+        query_rows(db, period_ids, rows);
+    }
+    return rows;
+}
+
+void DriverValueProvider::query_rows(database::IDatabase& db, const std::vector<PeriodID>& period_ids,
+                                     DriverRows& out) {
+    std::vector<DriverRows> one{std::move(out)};
+    query_rows(db, period_ids, one);
+    out = std::move(one.front());
+}
+
+void DriverValueProvider::query_rows(database::IDatabase& db, const std::vector<PeriodID>& period_ids,
+                                     std::vector<DriverRows>& out) {
+    if (out.empty()) {
+        return;
+    }
+    auto [first, last] = std::minmax_element(period_ids.begin(), period_ids.end());
+    const std::vector<ScenarioID>& chain = out.front().chain;
+    const bool packs_available = DriverPack::available(db);
+
+    // Bound parameters per statement stay well under SQLite's limit
+    constexpr size_t ENTITIES_PER_QUERY = 500;
+    for (size_t begin = 0; begin < out.size(); begin += ENTITIES_PER_QUERY) {
+        const size_t end = std::min(out.size(), begin + ENTITIES_PER_QUERY);
+
+        std::unordered_map<std::string, std::vector<size_t>, StringHash, std::equal_to<>> targets;
+        for (size_t i = begin; i < end; ++i) {
+            targets[out[i].entity_id].push_back(i);
+        }
+
+        // Packed keys: one row each, and none of their driver rows
+        std::set<std::pair<std::string, ScenarioID>> packed;
+        if (packs_available) {
+            std::vector<EntityID> entity_ids;
+            for (const auto& [entity_id, indexes] : targets) {
+                entity_ids.push_back(entity_id);
+            }
+            entity_ids.push_back(PHYSICAL_RISK_ENTITY);
+            for (auto& loaded : DriverPack::load(db, entity_ids, chain)) {
+                auto pack = std::make_shared<const DriverPack>(std::move(loaded));
+                packed.emplace(pack->entity_id, pack->scenario_id);
+                auto target = targets.find(pack->entity_id);
+                if (target != targets.end()) {
+                    for (size_t i : target->second) {
+                        out[i].packs.push_back(pack);
+                    }
+                } else {
+                    for (size_t i = begin; i < end; ++i) {
+                        out[i].packs.push_back(pack);
+                    }
+                }
+            }
+        }
+
+        std::ostringstream query;
+        query << "SELECT entity_id, scenario_id, period_id, driver_code, value, unit_code FROM scenario_drivers WHERE ";
+        ParamMap params;
+        if (packed.empty()) {
+            query << "(entity_id IN (";
+            for (size_t i = begin; i < end; ++i) {
+                const std::string name = "entity_" + std::to_string(i - begin);
+                query << (i > begin ? ", :" : ":") << name;
+                params[name] = out[i].entity_id;
+            }
+            query << ") OR entity_id = 'PHYSICAL_RISK') AND scenario_id IN (";
+            for (size_t i = 0; i < chain.size(); ++i) {
+                const std::string name = "scenario_" + std::to_string(i);
+                query << (i ? ", :" : ":") << name;
+                params[name] = chain[i];
+            }
+            query << ")";
+        } else {
+            // Per scenario of the chain, the entities without a pack in it
+            query << "(";
+            bool any = false;
+            for (size_t s = 0; s < chain.size(); ++s) {
+                std::ostringstream entities;
+                bool listed = false;
+                for (size_t i = begin; i < end; ++i) {
+                    if (packed.count({out[i].entity_id, chain[s]})) {
+                        continue;
+                    }
+                    const std::string name = "entity_" + std::to_string(i - begin);
+                    entities << (listed ? ", :" : ":") << name;
+                    params[name] = out[i].entity_id;
+                    listed = true;
+                }
+                if (!packed.count({PHYSICAL_RISK_ENTITY, chain[s]})) {
+                    entities << (listed ? ", " : "") << "'PHYSICAL_RISK'";
+                    listed = true;
+                }
+                if (!listed) {
+                    continue;
+                }
+                const std::string name = "scenario_" + std::to_string(s);
+                query << (any ? " OR " : "") << "(scenario_id = :" << name << " AND entity_id IN ("
+                      << entities.str() << "))";
+                params[name] = chain[s];
+                any = true;
+            }
+            if (!any) {
+                continue;  // Every key is packed
+            }
+            query << ")";
+        }
+        query << " AND period_id >= :first_period AND period_id <= :last_period";
+        params["first_period"] = *first;
+        params["last_period"] = *last;
+
+        auto result_set = db.execute_query(query.str(), params);
+        if (!result_set) {
+            continue;
+        }
+        for (auto [row_entity, row_scenario, period_id, driver_code, value, unit_code] :
+             result_set->rows<std::string_view, int, int, std::string_view, double, std::string_view>()) {
+            DriverRows::Row row{row_scenario, period_id, std::string(driver_code), value, std::string(unit_code)};
+            auto target = targets.find(row_entity);
+            if (target != targets.end()) {
+                for (size_t i : target->second) {
+                    out[i].rows.push_back(row);
+                }
+            } else {
+                for (size_t i = begin; i < end; ++i) {   // PHYSICAL_RISK: shared by every entity
+                    out[i].rows.push_back(row);
+                }
+            }
+        }
+    }
+}
+
+void DriverValueProvider::prefetch(const DriverRows& fetched, const std::vector<PeriodID>& period_ids) {
+    reset_prefetch(period_ids);
+    if (period_ids.empty()) {
+        return;
+    }
+    build_block(fetched, prefetch_blocks_[entities_->intern(fetched.entity_id)]);
+    prefetch_scenario_ = fetched.scenario_id;
+}
+
+void DriverValueProvider::reset_prefetch(const std::vector<PeriodID>& period_ids) {
+    prefetch_rows_.clear();
+    prefetch_blocks_.clear();
+    if (row_prefetched_) {
+        row_prefetched_ = false;
+        cache_loaded_ = false;
+    }
+    for (PeriodID period_id : period_ids) {
+        prefetch_rows_.emplace(period_id, prefetch_rows_.size());
+    }
+}
+
+void DriverValueProvider::build_block(const DriverRows& fetched, PrefetchBlock& block) {
+    const std::vector<ScenarioID>& chain = fetched.chain;   // Ancestors first: children override
+    struct Row {
+        size_t depth;
+        size_t row;
+        int slot;
+        double value;
+        int unit_id;    ///< Time-varying unit still to convert (NO_UNIT: value is in its base unit)
+    };
+    const core::UnitConverter* units = (fetched.rows.empty() && fetched.packs.empty()) ? nullptr : this->units();
+
+    // Static units convert with one constant, multiplied in as the rows are gathered;
+    // only time-varying units (currencies) are left for the per-period pass below
+    bool time_varying = false;
+    auto static_factor = [&](std::string_view unit_code, int& unit_id) {
+        unit_id = units ? units->unit_id(unit_code) : core::UnitConverter::NO_UNIT;
+        if (unit_id == core::UnitConverter::NO_UNIT) {
+            return 1.0;  // Unknown unit: value is used as-is
+        }
+        if (auto factor = units->static_factor(unit_id)) {
+            unit_id = core::UnitConverter::NO_UNIT;
+            return *factor;
+        }
+        time_varying = true;
+        return 1.0;
+    };
+
+    std::vector<Row> rows;
+    rows.reserve(fetched.rows.size());
+    for (const auto& fetched_row : fetched.rows) {
+        auto row = prefetch_rows_.find(fetched_row.period_id);
+        if (row == prefetch_rows_.end()) {
+            continue;  // Period in range but not part of the run
+        }
+        size_t depth = std::find(chain.begin(), chain.end(), fetched_row.scenario_id) - chain.begin();
+        int unit_id;
+        const double factor = static_factor(fetched_row.unit_code, unit_id);
+        rows.push_back({depth, row->second, driver_slot(fetched_row.driver_code), fetched_row.value * factor, unit_id});
+    }
+    for (const auto& pack : fetched.packs) {
+        size_t depth = std::find(chain.begin(), chain.end(), pack->scenario_id) - chain.begin();
+        std::vector<int> slots(pack->columns());
+        std::vector<int> unit_ids(pack->columns());
+        std::vector<double> factors(pack->columns());
+        for (size_t c = 0; c < pack->columns(); ++c) {
+            slots[c] = driver_slot(pack->driver_codes[c]);
+            factors[c] = static_factor(pack->unit_codes[c], unit_ids[c]);
+        }
+        for (size_t p = 0; p < pack->period_ids.size(); ++p) {
+            auto row = prefetch_rows_.find(pack->period_ids[p]);
+            if (row == prefetch_rows_.end()) {
+                continue;
+            }
+            for (size_t c = 0; c < pack->columns(); ++c) {
+                const double value = pack->value(p, c);
+                if (!std::isnan(value)) {
+                    rows.push_back({depth, row->second, slots[c], value * factors[c], unit_ids[c]});
+                }
+            }
+        }
+    }
+
+    // Convert time-varying units: one factor per (unit, period), applied as a multiply per row
+    if (time_varying) {
+        std::vector<PeriodID> row_periods(prefetch_rows_.size());
+        for (const auto& [period_id, row] : prefetch_rows_) {
+            row_periods[row] = period_id;
+        }
+        std::unordered_map<int, std::vector<double>> factor_columns;
+        for (Row& row : rows) {
+            if (row.unit_id == core::UnitConverter::NO_UNIT) {
+                continue;  // Unknown unit: value is used as-is
+            }
+            auto column = factor_columns.find(row.unit_id);
+            if (column == factor_columns.end()) {
+                column = factor_columns.emplace(row.unit_id, std::vector<double>()).first;
+                try {
+                    units->base_factors(row.unit_id, row_periods, column->second);
+                } catch (const std::exception&) {
+                    // Some periods can't be converted (e.g., a missing FX rate): those stay unconverted
+                    column->second.assign(row_periods.size(), 1.0);
+                    for (size_t i = 0; i < row_periods.size(); ++i) {
+                        try {
+                            column->second[i] = units->base_factor(row.unit_id, row_periods[i]);
+                        } catch (const std::exception&) {
+                        }
+                    }
+                }
+            }
+            row.value *= column->second[row.row];
+        }
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.depth < b.depth; });
+
+    // Slots created after the prefetch are absent in every row (no rows matched them)
+    block.width = driver_codes_.size();
+    block.values.assign(prefetch_rows_.size() * block.width, 0.0);
+    block.present.assign(prefetch_rows_.size() * block.width, 0);
+    for (const Row& row : rows) {
+        block.values[row.row * block.width + row.slot] = row.value;
+        block.present[row.row * block.width + row.slot] = 1;
+    }
+}
+
 void DriverValueProvider::load_template_mappings(const std::string& template_code) {
     line_item_to_driver_map_.clear();
+    set_time_scaling(core::TimeScaling());
 
     // Query template JSON from database
     std::ostringstream query;
@@ -101,6 +430,89 @@ void DriverValueProvider::load_template_mappings(const std::string& template_cod
     } catch (const nlohmann::json::exception& e) {
         throw std::runtime_error("DriverValueProvider: failed to parse template JSON: " + std::string(e.what()));
     }
+
+    remap_keys();
+}
+
+void DriverValueProvider::load_template_mappings(const core::StatementTemplate& tmpl) {
+    line_item_to_driver_map_.clear();
+
+    // Same rule as the JSON path: driver-sourced line items without a formula
+    for (const auto& item : tmpl.get_line_items()) {
+        if (item.formula.has_value() && !item.formula->empty()) {
+            continue;
+        }
+        if (!item.base_value_source.has_value()) {
+            continue;
+        }
+        const std::string& base_value_source = *item.base_value_source;
+        if (base_value_source.substr(0, 7) == "driver:") {
+            line_item_to_driver_map_[item.code] = base_value_source.substr(7);
+        }
+    }
+
+    remap_keys();
+    set_time_scaling(tmpl.get_time_scaling());
+}
+
+void DriverValueProvider::set_time_scaling(const core::TimeScaling& scaling) {
+    std::fill(driver_flow_.begin(), driver_flow_.end(), 0);
+    basis_days_ = 0.0;
+    period_scale_ = 1.0;
+    if (!scaling.enabled) {
+        return;
+    }
+    for (const auto& code : scaling.flow_drivers) {
+        driver_flow_[driver_slot(code)] = 1;
+    }
+    basis_days_ = scaling.basis_days;
+    update_period_scale();
+}
+
+double DriverValueProvider::time_scale(const std::string& key) const {
+    const int driver = find_driver_slot(key);
+    return (driver == NO_SLOT) ? 1.0 : flow_scale(driver);
+}
+
+void DriverValueProvider::update_period_scale() {
+    // Periods added since the table was read are looked up again
+    auto days = period_days_.find(period_id_);
+    if (days == period_days_.end()) {
+        period_days_.clear();
+        try {
+            auto result_set = db_->execute_query("SELECT period_id, days_in_period FROM period", {});
+            if (result_set) {
+                for (auto [period_id, period_days] : result_set->rows<int, int>()) {
+                    period_days_.emplace(period_id, period_days);
+                }
+            }
+        } catch (const std::exception&) {
+            // No period table: flow drivers can't be read (see flow_scale())
+        }
+        days = period_days_.find(period_id_);
+    }
+    period_scale_ = (days != period_days_.end()) ? days->second / basis_days_
+                                                 : std::numeric_limits<double>::quiet_NaN();
+}
+
+void DriverValueProvider::remap_keys() {
+    // Re-point bound line item keys at their drivers under the new mappings
+    for (size_t i = 0; i < key_codes_.size(); ++i) {
+        key_driver_[i] = key_to_driver_slot(key_codes_[i]);
+    }
+}
+
+void DriverValueProvider::preload() const {
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+}
+
+std::string DriverValueProvider::driver_code(const std::string& key) const {
+    if (key.length() > 7 && key.compare(0, 7, "driver:") == 0) {
+        return key.substr(7);
+    }
+    return resolve_driver_code(key);
 }
 
 std::string DriverValueProvider::resolve_driver_code(const std::string& line_item_code) const {
@@ -115,33 +527,114 @@ std::string DriverValueProvider::resolve_driver_code(const std::string& line_ite
     return line_item_code;
 }
 
-bool DriverValueProvider::has_value(const std::string& key) const {
-    // Load cache if needed
-    if (!cache_loaded_) {
-        load_drivers();
+int DriverValueProvider::driver_slot(std::string_view driver_code) const {
+    auto it = driver_index_.find(driver_code);
+    if (it != driver_index_.end()) {
+        return it->second;
     }
 
-    // Case 1: Explicit driver: prefix (e.g., "driver:REVENUE" or "driver:FLOOD_BI_FACTORY_ZRH")
-    // This is used in formulas to explicitly fetch from drivers
-    if (key.length() > 7 && key.substr(0, 7) == "driver:") {
-        std::string driver_code = key.substr(7);
-        return driver_cache_.find(driver_code) != driver_cache_.end();
+    int slot = static_cast<int>(driver_codes_.size());
+    driver_index_.emplace(std::string(driver_code), slot);
+    driver_codes_.emplace_back(driver_code);
+    driver_values_.push_back(0.0);
+    driver_present_.push_back(0);
+    driver_flow_.push_back(0);
+    if (!row_prefetched_) {
+        use_loaded_row();  // The vectors may have moved
+    }
+    return slot;
+}
+
+int DriverValueProvider::key_to_driver_slot(const std::string& key) const {
+    if (key.length() > 7 && key.compare(0, 7, "driver:") == 0) {
+        return driver_slot(key.substr(7));
     }
 
-    // Case 2: Bare line item code (e.g., "REVENUE")
-    // This is used when line item has base_value_source but no formula
-    // Check if we have a mapping for this line item
     auto it = line_item_to_driver_map_.find(key);
     if (it == line_item_to_driver_map_.end()) {
-        return false;  // No mapping, this provider doesn't handle this key
+        return NO_SLOT;  // No mapping, this provider doesn't handle this key
     }
+    return driver_slot(it->second);
+}
 
-    // Check if the mapped driver exists in cache
-    std::string driver_code = it->second;
-    return driver_cache_.find(driver_code) != driver_cache_.end();
+int DriverValueProvider::find_driver_slot(const std::string& key) const {
+    std::string driver_code;
+    if (key.length() > 7 && key.compare(0, 7, "driver:") == 0) {
+        driver_code = key.substr(7);
+    } else {
+        auto it = line_item_to_driver_map_.find(key);
+        if (it == line_item_to_driver_map_.end()) {
+            return NO_SLOT;
+        }
+        driver_code = it->second;
+    }
+
+    auto it = driver_index_.find(driver_code);
+    return (it != driver_index_.end()) ? it->second : NO_SLOT;
 }
 
-double DriverValueProvider::get_value(const std::string& key, const core::Context& ctx) const {
+int DriverValueProvider::resolve_slot(const std::string& key) {
+    auto it = key_index_.find(key);
+    if (it != key_index_.end()) {
+        return it->second;
+    }
+
+    int slot = static_cast<int>(key_codes_.size());
+    key_index_.emplace(key, slot);
+    key_codes_.push_back(key);
+    key_driver_.push_back(key_to_driver_slot(key));
+    return slot;
+}
+
+bool DriverValueProvider::has_slot_value(int slot) const {
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+
+    return row_has(key_driver_[slot]);
+}
+
+double DriverValueProvider::get_slot_value(int slot, const core::Context& ctx [[maybe_unused]]) const {
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+
+    int driver = key_driver_[slot];
+    if (!row_has(driver)) {
+        throw std::runtime_error("DriverValueProvider: driver not found (key: " + key_codes_[slot] + ")");
+    }
+    return row_values_[driver] * flow_scale(driver);
+}
+
+std::optional<double> DriverValueProvider::find_slot_value(int slot, const core::Context&) const {
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+    return find_driver(key_driver_[slot]);
+}
+
+std::optional<double> DriverValueProvider::find_value(const std::string& key, const core::Context&) const {
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+    return find_driver(find_driver_slot(key));
+}
+
+bool DriverValueProvider::has_value(const std::string& key) const {
+    // Load cache if needed
+    if (!cache_loaded_) {
+        load_drivers();
+    }
+
+    // Case 1: Explicit driver: prefix (e.g., "driver:REVENUE" or "driver:FLOOD_BI_FACTORY_ZRH")
+    //         This is used in formulas to explicitly fetch from drivers
+    // Case 2: Bare line item code (e.g., "REVENUE")
+    //         This is used when line item has base_value_source but no formula;
+    //         only handled if we have a mapping for this line item
+    return row_has(find_driver_slot(key));
+}
+
+double DriverValueProvider::get_value(const std::string& key, const core::Context& ctx [[maybe_unused]]) const {
     // Load cache if needed
     if (!cache_loaded_) {
         load_drivers();
@@ -160,17 +653,143 @@ double DriverValueProvider::get_value(const std::string& key, const core::Contex
     }
 
     // Look up driver in cache
-    auto it = driver_cache_.find(driver_code);
-    if (it == driver_cache_.end()) {
+    auto it = driver_index_.find(driver_code);
+    if (it == driver_index_.end() || !row_has(it->second)) {
         throw std::runtime_error("DriverValueProvider: driver not found: " + driver_code + " (key: " + key + ")");
     }
 
-    return it->second;
+    return row_values_[it->second] * flow_scale(it->second);
 }
 
 void DriverValueProvider::load_drivers() const {
-    driver_cache_.clear();
+    std::fill(driver_present_.begin(), driver_present_.end(), 0);
+
+    auto apply = [this](const DriverLayer& layer) {
+        for (const auto& [slot, value] : layer) {
+            driver_values_[slot] = value;
+            driver_present_[slot] = 1;
+        }
+    };
+
+    // Ancestors first, so each child's rows override its parent's
+    for (ScenarioID ancestor : ancestors(scenario_id_)) {
+        auto key = std::make_tuple(entity_, ancestor, period_id_);
+        auto it = ancestor_layers_.find(key);
+        if (it == ancestor_layers_.end()) {
+            it = ancestor_layers_.emplace(key, std::make_shared<const DriverLayer>(query_layer(ancestor))).first;
+        }
+        apply(*it->second);
+    }
+    apply(query_layer(scenario_id_));
+
+    use_loaded_row();
+    cache_loaded_ = true;
+}
+
+void DriverValueProvider::use_loaded_row() const {
+    row_values_ = driver_values_.data();
+    row_present_ = driver_present_.data();
+    row_width_ = driver_values_.size();
+}
+
+void DriverValueProvider::clear_driver_cache() {
+    prefetch(entity_, scenario_id_, {});
+    scenario_parents_.clear();
+    ancestor_layers_.clear();
+    cache_loaded_ = false;
+}
+
+void DriverValueProvider::set_unit_converter(std::shared_ptr<const core::UnitConverter> unit_converter) {
+    unit_converter_ = std::move(unit_converter);
+    unit_loader_ = nullptr;
+    clear_driver_cache();
+}
+
+void DriverValueProvider::set_unit_converter_loader(UnitConverterLoader loader) {
+    unit_converter_ = nullptr;
+    unit_loader_ = std::move(loader);
+    clear_driver_cache();
+}
+
+const core::UnitConverter* DriverValueProvider::units() const {
+    if (unit_loader_) {
+        unit_converter_ = unit_loader_();   // Throws before the loader is dropped: retried next time
+        unit_loader_ = nullptr;
+    }
+    return unit_converter_.get();
+}
+
+std::vector<ScenarioID> DriverValueProvider::ancestors(ScenarioID scenario_id) const {
+    return ancestor_chain(scenario_id, [this](ScenarioID id) {
+        auto it = scenario_parents_.find(id);
+        if (it == scenario_parents_.end()) {
+            it = scenario_parents_.emplace(id, query_parent(*db_, id)).first;
+        }
+        return it->second;
+    });
+}
+
+std::optional<ScenarioID> DriverValueProvider::query_parent(database::IDatabase& db, ScenarioID scenario_id) {
+    std::optional<ScenarioID> parent;
+    try {
+        ParamMap params;
+        params["scenario_id"] = scenario_id;
+        auto result_set = db.execute_query(
+            "SELECT parent_scenario_id FROM scenario WHERE scenario_id = :scenario_id", params);
+        if (result_set && result_set->next() && !result_set->is_null(0)) {
+            parent = result_set->get_int(0);
+        }
+    } catch (const std::exception&) {
+        // No scenario table (standalone driver databases): no inheritance
+    }
+    return parent;
+}
+
+template <typename ParentOf>
+std::vector<ScenarioID> DriverValueProvider::ancestor_chain(ScenarioID scenario_id, ParentOf parent_of) {
+    std::vector<ScenarioID> chain;
+    ScenarioID current = scenario_id;
+    while (true) {
+        std::optional<ScenarioID> parent = parent_of(current);
+        if (!parent) {
+            break;
+        }
+        current = *parent;
+        // A parent cycle would never reach a root; stop at the first repeat
+        if (current == scenario_id || std::find(chain.begin(), chain.end(), current) != chain.end()) {
+            break;
+        }
+        chain.push_back(current);
+    }
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+double DriverValueProvider::to_base_unit(double value, std::string_view unit_code,
+                                         std::string_view driver_code, PeriodID period_id) const {
+    // Convert to base unit if unit converter is available
+    if (const core::UnitConverter* units = this->units()) {
+        try {
+            // Static units ignore the period; time-varying ones (e.g., currency) need it
+            value *= units->base_factor(units->unit_id(unit_code), period_id);
+        } catch (const std::exception& e) {
+            // Log warning but continue with unconverted value
+            // In production, this should use proper logging
+            std::ostringstream err;
+            err << "Warning: Failed to convert driver " << driver_code
+                << " from unit " << unit_code << ": " << e.what();
+            // For now, just use the value as-is
+        }
+    }
+    return value;
+}
+
+const EntityID& DriverValueProvider::entity_code() const {
+    static const EntityID none;
+    return (entity_ == core::EntityDictionary::NO_ENTITY) ? none : entities_->code(entity_);
+}
 
+DriverValueProvider::DriverLayer DriverValueProvider::query_layer(ScenarioID scenario_id) const {
     // Query drivers for both the specified entity AND global physical risk drivers
     // Physical risk drivers use entity_id = 'PHYSICAL_RISK' and apply to all entities
     std::ostringstream query;
@@ -180,42 +799,22 @@ void DriverValueProvider::load_drivers() const {
           << "AND period_id = :period_id";
 
     ParamMap params;
-    params["entity_id"] = entity_id_;
-    params["scenario_id"] = scenario_id_;
+    params["entity_id"] = entity_code();
+    params["scenario_id"] = scenario_id;
     params["period_id"] = period_id_;
 
     auto result_set = db_->execute_query(query.str(), params);
 
-    while (result_set && result_set->next()) {
-        std::string driver_code = result_set->get_string(0);
-        double value = result_set->get_double(1);
-        std::string unit_code = result_set->get_string(2);
-
-        // Convert to base unit if unit converter is available
-        if (unit_converter_) {
-            try {
-                // Check if unit is time-varying (e.g., currency)
-                if (unit_converter_->is_time_varying(unit_code)) {
-                    // Convert with period_id for time-varying units
-                    value = unit_converter_->to_base_unit(value, unit_code, period_id_);
-                } else {
-                    // Convert with no period_id for static units
-                    value = unit_converter_->to_base_unit(value, unit_code);
-                }
-            } catch (const std::exception& e) {
-                // Log warning but continue with unconverted value
-                // In production, this should use proper logging
-                std::ostringstream err;
-                err << "Warning: Failed to convert driver " << driver_code
-                    << " from unit " << unit_code << ": " << e.what();
-                // For now, just use the value as-is
-            }
-        }
+    DriverLayer layer;
 
-        driver_cache_[driver_code] = value;
+    if (!result_set) {
+        return layer;
+    }
+    for (auto [driver_code, value, unit_code] : result_set->rows<std::string_view, double, std::string_view>()) {
+        layer.emplace_back(driver_slot(driver_code), to_base_unit(value, unit_code, driver_code, period_id_));
     }
 
-    cache_loaded_ = true;
+    return layer;
 }
 
 } // namespace unified
@@ -0,0 +1,275 @@
+/**
+ * @file policy_provider.cpp
+ * @brief Implementation of the policy provider
+ */
+
+#include "unified/providers/policy_provider.h"
+#include "database/result_set.h"
+#include <functional>
+#include <stdexcept>
+
+namespace finmodel {
+namespace unified {
+
+PolicyProvider::PolicyProvider(std::shared_ptr<database::IDatabase> db)
+    : db_(std::move(db))
+{
+    reload();
+}
+
+void PolicyProvider::reload() {
+    const std::string wc_code = wc_ ? wc_->code : "DEFAULT";
+    const std::string capex_code = capex_ ? capex_->code : "DEFAULT";
+    wc_policies_.clear();
+    capex_policies_.clear();
+    read_periods();
+    try {
+        wc_policies_ = policy::WorkingCapitalPolicy::load(*db_);
+    } catch (const database::DatabaseException&) {
+        // No wc_policy table: no working capital values
+    }
+    try {
+        capex_policies_ = policy::CapexPolicy::load(*db_);
+    } catch (const database::DatabaseException&) {
+        // No capex_policy table (or before migration 017): no capex values
+    }
+
+    auto wc = wc_policies_.find(wc_code);
+    auto capex = capex_policies_.find(capex_code);
+    wc_ = (wc != wc_policies_.end()) ? std::optional<policy::WorkingCapitalPolicy>(wc->second) : std::nullopt;
+    capex_ = (capex != capex_policies_.end()) ? std::optional<policy::CapexPolicy>(capex->second) : std::nullopt;
+    clear_history();
+}
+
+void PolicyProvider::select(const std::string& wc_code, const std::string& capex_code) {
+    auto wc = wc_policies_.find(wc_code);
+    if (wc == wc_policies_.end()) {
+        throw std::out_of_range("PolicyProvider: no active working capital policy " + wc_code);
+    }
+    auto capex = capex_policies_.find(capex_code);
+    if (capex == capex_policies_.end()) {
+        throw std::out_of_range("PolicyProvider: no active capex policy " + capex_code);
+    }
+    wc_ = wc->second;
+    capex_ = capex->second;
+    clear_history();   // Vintages depend on the useful life
+}
+
+void PolicyProvider::clear_history() {
+    runs_.clear();
+    lane_runs_.clear();
+}
+
+void PolicyProvider::record(int entity_id, ScenarioID scenario_id, PeriodID period_id, double capex) {
+    if (!capex_) {
+        return;
+    }
+    auto key = std::make_pair(entity_id, scenario_id);
+    auto it = runs_.find(key);
+    if (it == runs_.end()) {
+        it = runs_.emplace(key, Vintages{policy::VintageSchedule<double>(capex_->useful_life_periods, 0.0), 0}).first;
+    }
+    Vintages& run = it->second;
+    if (run.schedule.periods() > 0 && period_id == run.last) {
+        run.schedule.replace_newest(capex);
+        return;
+    }
+    if (period_id < run.last) {
+        run.schedule.clear();
+    }
+    run.schedule.add(capex);
+    run.last = period_id;
+}
+
+void PolicyProvider::record_lanes(size_t run_key, PeriodID period_id, const core::LaneArray& capex) {
+    if (!capex_) {
+        return;
+    }
+    auto it = lane_runs_.find(run_key);
+    if (it == lane_runs_.end() || (it->second.schedule.periods() > 0 && period_id < it->second.last)) {
+        lane_runs_.erase(run_key);
+        it = lane_runs_.emplace(run_key, LaneVintages{policy::VintageSchedule<core::LaneArray>(
+                                             capex_->useful_life_periods, core::LaneArray::Zero(capex.size())), 0})
+                 .first;
+    }
+    LaneVintages& run = it->second;
+    if (run.schedule.periods() > 0 && period_id == run.last) {
+        run.schedule.replace_newest(capex);
+        return;
+    }
+    run.schedule.add(capex);
+    run.last = period_id;
+}
+
+size_t PolicyProvider::lane_run(const std::vector<int>& entities, const std::vector<ScenarioID>& scenario_ids,
+                                size_t lanes) {
+    size_t seed = lanes;
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+    };
+    for (int entity : entities) {
+        combine(std::hash<int>{}(entity));
+    }
+    combine(entities.size());
+    for (ScenarioID scenario_id : scenario_ids) {
+        combine(std::hash<ScenarioID>{}(scenario_id));
+    }
+    return seed;
+}
+
+int PolicyProvider::field_of(const std::string& key) {
+    if (!is_policy_key(key)) {
+        return NONE;
+    }
+    static const std::unordered_map<std::string, int> fields = {
+        {"DSO_DAYS", DSO_DAYS}, {"DPO_DAYS", DPO_DAYS}, {"DIO_DAYS", DIO_DAYS},
+        {"DSO_FACTOR", DSO_FACTOR}, {"DPO_FACTOR", DPO_FACTOR}, {"DIO_FACTOR", DIO_FACTOR},
+        {"DEPRECIATION", DEPRECIATION}, {"USEFUL_LIFE", USEFUL_LIFE}, {"CAPEX", CAPEX}, {"CAPEX_RATE", CAPEX_RATE},
+    };
+    auto it = fields.find(key.substr(7));
+    return (it != fields.end()) ? it->second : NONE;
+}
+
+void PolicyProvider::set_period(PeriodID period_id) {
+    // Periods added since the table was read are looked up again
+    if (!period_days_.count(period_id)) {
+        read_periods();
+    }
+}
+
+void PolicyProvider::read_periods() {
+    period_days_.clear();
+    try {
+        auto rows = db_->execute_query("SELECT period_id, days_in_period FROM period", {});
+        for (auto [period, days] : rows->rows<int, double>()) {
+            period_days_.emplace(period, days);
+        }
+    } catch (const database::DatabaseException&) {
+        // No period table: no period lengths
+    }
+}
+
+std::optional<double> PolicyProvider::period_days(PeriodID period_id) const {
+    auto it = period_days_.find(period_id);
+    if (it == period_days_.end() || it->second <= 0.0) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+double PolicyProvider::period_share(double days, PeriodID period_id) const {
+    const std::optional<double> period = period_days(period_id);
+    if (!period) {
+        throw std::runtime_error("PolicyProvider: period " + std::to_string(period_id) + " has no days_in_period");
+    }
+    return policy::WorkingCapitalPolicy::balance(1.0, days, *period);
+}
+
+double PolicyProvider::policy_value(int field, PeriodID period_id) const {
+    switch (field) {
+        case DSO_DAYS: return wc_->dso_days;
+        case DPO_DAYS: return wc_->dpo_days;
+        case DIO_DAYS: return wc_->dio_days;
+        case DSO_FACTOR: return period_share(wc_->dso_days, period_id);
+        case DPO_FACTOR: return period_share(wc_->dpo_days, period_id);
+        case DIO_FACTOR: return period_share(wc_->dio_days, period_id);
+        case USEFUL_LIFE: return capex_->useful_life_periods;
+        case CAPEX_RATE: return capex_->revenue_pct;
+        default: return 0.0;
+    }
+}
+
+bool PolicyProvider::has_value(const std::string& key) const {
+    return has_slot_value(field_of(key));
+}
+
+double PolicyProvider::get_value(const std::string& key, const core::Context& ctx) const {
+    const int field = field_of(key);
+    if (!has_slot_value(field)) {
+        throw std::runtime_error("PolicyProvider: no policy value " + key);
+    }
+    return get_slot_value(field, ctx);
+}
+
+std::optional<double> PolicyProvider::find_value(const std::string& key, const core::Context& ctx) const {
+    return find_slot_value(field_of(key), ctx);
+}
+
+std::optional<double> PolicyProvider::find_slot_value(int slot, const core::Context& ctx) const {
+    if (!has_slot_value(slot) ||
+        ((slot == DSO_FACTOR || slot == DPO_FACTOR || slot == DIO_FACTOR) && !period_days(ctx.period_id))) {
+        return std::nullopt;
+    }
+    return get_slot_value(slot, ctx);
+}
+
+int PolicyProvider::resolve_slot(const std::string& key) {
+    return field_of(key);
+}
+
+bool PolicyProvider::has_slot_value(int slot) const {
+    switch (slot) {
+        case DSO_DAYS: case DPO_DAYS: case DIO_DAYS:
+        case DSO_FACTOR: case DPO_FACTOR: case DIO_FACTOR:
+            return wc_.has_value();
+        case DEPRECIATION: case USEFUL_LIFE:
+            return capex_.has_value();
+        case CAPEX:
+            return capex_ && capex_->method != policy::CapexPolicy::Method::REVENUE_PCT;
+        case CAPEX_RATE:
+            return capex_ && capex_->method == policy::CapexPolicy::Method::REVENUE_PCT;
+        default:
+            return false;
+    }
+}
+
+double PolicyProvider::get_slot_value(int slot, const core::Context& ctx) const {
+    if (slot != DEPRECIATION && slot != CAPEX) {
+        return policy_value(slot, ctx.period_id);
+    }
+
+    // D&A of the vintages recorded before this period
+    double depreciation = 0.0;
+    auto it = runs_.find(std::make_pair(ctx.entity_id, ctx.scenario_id));
+    if (it != runs_.end() && it->second.schedule.periods() > 0 && ctx.period_id >= it->second.last) {
+        const auto& schedule = it->second.schedule;
+        depreciation = (ctx.period_id == it->second.last) ? schedule.depreciation_of_newest()
+                                                          : schedule.depreciation();
+    }
+    return slot == DEPRECIATION ? depreciation : capex_->capex(0.0, depreciation);
+}
+
+bool PolicyProvider::lane_values(const std::string& key, size_t run_key, PeriodID period_id, size_t lanes,
+                                 core::LaneArray& out) {
+    const int field = field_of(key);
+    if (!has_slot_value(field)) {
+        return false;
+    }
+    const auto size = static_cast<Eigen::Index>(lanes);
+    if (field != DEPRECIATION && field != CAPEX) {
+        set_period(period_id);
+        out = core::LaneArray::Constant(size, policy_value(field, period_id));
+        return true;
+    }
+
+    core::LaneArray depreciation = core::LaneArray::Zero(size);
+    auto it = lane_runs_.find(run_key);
+    if (it != lane_runs_.end() && it->second.schedule.periods() > 0 && period_id >= it->second.last) {
+        const auto& schedule = it->second.schedule;
+        core::LaneArray vintages = (period_id == it->second.last) ? schedule.depreciation_of_newest()
+                                                                  : schedule.depreciation();
+        if (vintages.size() == size) {
+            depreciation = std::move(vintages);
+        }
+    }
+    if (field == DEPRECIATION) {
+        out = std::move(depreciation);
+    } else {
+        const core::LaneArray revenue = core::LaneArray::Zero(size);   // Not read: CAPEX has no revenue_pct value
+        out = capex_->capex(revenue, depreciation);
+    }
+    return true;
+}
+
+} // namespace unified
+} // namespace finmodel
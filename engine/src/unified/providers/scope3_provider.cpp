@@ -0,0 +1,75 @@
+/**
+ * @file scope3_provider.cpp
+ * @brief Implementation of the Scope 3 provider
+ */
+
+#include "unified/providers/scope3_provider.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace finmodel {
+namespace unified {
+
+Scope3Provider::Scope3Provider(std::shared_ptr<core::EntityDictionary> entities)
+    : entities_(std::move(entities))
+{
+}
+
+void Scope3Provider::set_results(std::shared_ptr<const carbon::Scope3Results> results) {
+    results_ = std::move(results);
+    rows_.clear();
+    if (results_) {
+        for (size_t r = 0; r < results_->rows.size(); ++r) {
+            const auto& row = results_->rows[r];
+            rows_.emplace(std::make_tuple(entities_->intern(row.entity_id), row.scenario_id, row.period_id), r);
+        }
+    }
+    for (size_t slot = NONE + 1; slot < categories_.size(); ++slot) {
+        bind_slot(slot);
+    }
+}
+
+void Scope3Provider::bind_slot(size_t slot) {
+    columns_[slot] = -1;
+    if (!results_) {
+        return;
+    }
+    const auto& categories = results_->categories;
+    auto it = std::lower_bound(categories.begin(), categories.end(), categories_[slot]);
+    if (it != categories.end() && *it == categories_[slot]) {
+        columns_[slot] = static_cast<int>(it - categories.begin());
+    }
+}
+
+double Scope3Provider::get_value(const std::string& key, const core::Context& ctx) const {
+    if (!is_scope3_key(key)) {
+        throw std::runtime_error("Scope3Provider: not a scope3 key: " + key);
+    }
+    auto it = slots_.find(key.substr(7));
+    return (it != slots_.end()) ? get_slot_value(it->second, ctx) : 0.0;
+}
+
+int Scope3Provider::resolve_slot(const std::string& key) {
+    if (!is_scope3_key(key)) {
+        return NONE;
+    }
+    auto [it, added] = slots_.emplace(key.substr(7), static_cast<int>(categories_.size()));
+    if (added) {
+        categories_.push_back(key.substr(7));
+        columns_.push_back(-1);
+        bind_slot(categories_.size() - 1);
+    }
+    return it->second;
+}
+
+double Scope3Provider::get_slot_value(int slot, const core::Context& ctx) const {
+    const int column = columns_[static_cast<size_t>(slot)];
+    if (column < 0) {
+        return 0.0;
+    }
+    auto row = rows_.find(std::make_tuple(ctx.entity_id, ctx.scenario_id, ctx.period_id));
+    return (row != rows_.end()) ? results_->rows[row->second].emissions[static_cast<size_t>(column)] : 0.0;
+}
+
+} // namespace unified
+} // namespace finmodel
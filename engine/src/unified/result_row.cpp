@@ -0,0 +1,112 @@
+/**
+ * @file result_row.cpp
+ * @brief Dense result storage implementation
+ */
+
+#include "unified/result_row.h"
+#include <iterator>
+#include <stdexcept>
+
+namespace finmodel {
+namespace unified {
+
+ResultSchema::ResultSchema(std::vector<std::string> codes) : codes_(std::move(codes)) {
+    auto& symbols = core::SymbolTable::global();
+    symbols_.reserve(codes_.size());
+    index_.reserve(codes_.size());
+    symbol_index_.reserve(codes_.size());
+    for (uint32_t i = 0; i < codes_.size(); ++i) {
+        if (!index_.emplace(codes_[i], i).second) {
+            throw std::invalid_argument("ResultSchema: duplicate line item '" + codes_[i] + "'");
+        }
+        symbols_.push_back(symbols.intern(codes_[i]));
+        symbol_index_.emplace(symbols_.back(), i);
+    }
+}
+
+uint32_t ResultSchema::find(const std::string& code) const {
+    auto it = index_.find(code);
+    return (it != index_.end()) ? it->second : NO_INDEX;
+}
+
+uint32_t ResultSchema::find(core::Symbol symbol) const {
+    auto it = symbol_index_.find(symbol);
+    return (it != symbol_index_.end()) ? it->second : NO_INDEX;
+}
+
+ResultRow::ResultRow(std::shared_ptr<const ResultSchema> schema, std::vector<double> values)
+    : schema_(std::move(schema)), values_(std::move(values)) {
+    const size_t items = schema_ ? schema_->size() : 0;
+    if (values_.size() > items) {
+        throw std::invalid_argument("ResultRow: " + std::to_string(values_.size()) +
+                                    " values for " + std::to_string(items) + " line items");
+    }
+}
+
+const double* ResultRow::find(const std::string& code) const {
+    if (!schema_) {
+        return nullptr;
+    }
+    uint32_t index = schema_->find(code);
+    return (index < values_.size()) ? &values_[index] : nullptr;
+}
+
+const double* ResultRow::find(core::Symbol symbol) const {
+    if (!schema_) {
+        return nullptr;
+    }
+    uint32_t index = schema_->find(symbol);
+    return (index < values_.size()) ? &values_[index] : nullptr;
+}
+
+double ResultRow::at(const std::string& code) const {
+    const double* value = find(code);
+    if (!value) {
+        throw std::out_of_range("ResultRow: no value for '" + code + "'");
+    }
+    return *value;
+}
+
+std::map<std::string, double> ResultRow::to_map() const {
+    std::map<std::string, double> values;
+    for (const auto& [code, value] : *this) {
+        values.emplace(code, value);
+    }
+    return values;
+}
+
+void ResultRow::assign_to(std::map<std::string, double>& values) const {
+    for (const auto& [code, value] : *this) {
+        auto [it, added] = values.try_emplace(code, value);
+        if (!added) {
+            it->second = value;
+        }
+    }
+    // Codes of another layout left over
+    if (values.size() != size()) {
+        for (auto it = values.begin(); it != values.end();) {
+            it = contains(it->first) ? std::next(it) : values.erase(it);
+        }
+    }
+}
+
+bool ResultRow::operator==(const ResultRow& other) const {
+    if (values_.size() != other.values_.size()) {
+        return false;
+    }
+    if (schema_ == other.schema_) {
+        return values_ == other.values_;
+    }
+
+    // Different schema objects: match by code
+    for (uint32_t i = 0; i < values_.size(); ++i) {
+        const double* theirs = other.find(schema_->symbol(i));
+        if (!theirs || *theirs != values_[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace unified
+} // namespace finmodel
@@ -7,14 +7,55 @@
 #include "database/result_set.h"
 #include "core/unit_converter.h"
 #include "fx/fx_provider.h"
+#include "core/lane_evaluator.h"
+#include "core/time_series.h"
+#include "core/engine_metrics.h"
+#include "core/eigen_solvers.h"
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
+#include <atomic>
 #include <iostream>
+#include <unordered_set>
 
 namespace finmodel {
 namespace unified {
 
+/**
+ * @brief Per-lane values of one code from one source (drivers or opening BS)
+ */
+struct UnifiedEngine::LaneColumn {
+    core::LaneArray values;
+    std::vector<uint8_t> present;
+    size_t present_count = 0;
+
+    explicit LaneColumn(size_t lanes)
+        : values(core::LaneArray::Zero(static_cast<Eigen::Index>(lanes)))
+        , present(lanes, 0)
+    {
+    }
+
+    void set(size_t lane, double value) {
+        values[static_cast<Eigen::Index>(lane)] = value;
+        if (!present[lane]) {
+            present[lane] = 1;
+            ++present_count;
+        }
+    }
+
+    void set_all(const core::LaneArray& lane_values) {
+        values = lane_values;
+        std::fill(present.begin(), present.end(), 1);
+        present_count = present.size();
+    }
+};
+
+struct UnifiedEngine::LaneStep {
+    std::string code;
+    std::shared_ptr<const core::CompiledFormula> compiled;  // null → provider lookup
+};
+
 UnifiedEngine::UnifiedEngine(std::shared_ptr<database::IDatabase> db)
     : db_(db) {
 
@@ -22,151 +63,1990 @@ UnifiedEngine::UnifiedEngine(std::shared_ptr<database::IDatabase> db)
         throw std::runtime_error("UnifiedEngine: null database pointer");
     }
 
-    // Create FX provider for time-varying currency conversions
-    auto fx_provider = std::make_shared<fx::FXProvider>(db_);
+    // FX rates and unit definitions are read when a driver is first converted, not here
+    init_providers(nullptr);
+    driver_provider_->set_unit_converter_loader([db = db_] {
+        auto fx_provider = std::make_shared<const fx::FXProvider>(db);
+        return std::make_shared<const core::UnitConverter>(db, std::move(fx_provider));
+    });
+}
+
+UnifiedEngine::UnifiedEngine(std::shared_ptr<database::IDatabase> db,
+                             std::shared_ptr<core::ReferenceDataStore> reference)
+    : db_(db)
+    , reference_(std::move(reference)) {
+
+    if (!db_) {
+        throw std::runtime_error("UnifiedEngine: null database pointer");
+    }
+    if (!reference_) {
+        throw std::runtime_error("UnifiedEngine: null reference data store");
+    }
+
+    // FX rates and unit factors of the shared snapshot, not a load of our own
+    reference_snapshot_ = reference_->current();
+    init_providers(reference_snapshot_->units);
+}
+
+bool UnifiedEngine::refresh_reference_data() {
+    if (!reference_) {
+        return false;
+    }
+    auto latest = reference_->current();
+    if (latest == reference_snapshot_) {
+        return false;
+    }
+    reference_snapshot_ = std::move(latest);
+    driver_provider_->set_unit_converter(reference_snapshot_->units);
+    return true;
+}
+
+void UnifiedEngine::init_providers(std::shared_ptr<const core::UnitConverter> unit_converter) {
+    // Entity codes → dense IDs, shared by the providers so contexts and caches agree
+    entities_ = std::make_shared<core::EntityDictionary>(db_);
+
+    // Initialize value providers
+    driver_provider_ = std::make_unique<DriverValueProvider>(db_, unit_converter, entities_);
+    statement_provider_ = std::make_unique<bs::StatementValueProvider>(db_, entities_);
+    action_provider_ = std::make_unique<ActionActivationProvider>();
+    scope3_provider_ = std::make_unique<Scope3Provider>(entities_);
+    policy_provider_ = std::make_unique<PolicyProvider>(db_);
+
+    // Initialize validation rule engine
+    validation_engine_ = std::make_unique<ValidationRuleEngine>(db_);
+
+    // Register providers with evaluator
+    // Order matters: try more specific providers first
+    // Register providers with evaluator
+    // Order: drivers first for "driver:XXX" syntax, then statement values for "XXX" references
+    providers_.push_back(driver_provider_.get());      // Scenario drivers (with driver: prefix)
+    providers_.push_back(action_provider_.get());      // Action activations (action: prefix)
+    providers_.push_back(scope3_provider_.get());      // Scope 3 emissions (scope3: prefix)
+    providers_.push_back(policy_provider_.get());      // Working capital and capex policies (policy: prefix)
+    providers_.push_back(statement_provider_.get());   // Financial statement values (calculated)
+}
+
+UnifiedResult UnifiedEngine::calculate(
+    const EntityID& entity_id,
+    ScenarioID scenario_id,
+    PeriodID period_id,
+    const BalanceSheet& opening_bs,
+    const std::string& template_code
+) {
+    core::EngineMetrics::CalculateTimer metrics_timer;
+    UnifiedResult result;
+    result.success = true;
+    core::Profiler* profiler = core::PROFILING_BUILT ? profiler_.get() : nullptr;
+    const core::Profiler::Mark load_begin = profiler ? core::Profiler::stage_mark() : core::Profiler::Mark{};
+
+    // Taxes not computed this period carry their state over
+    if (!tax_strategies_.empty()) {
+        tax_state_ = opening_tax_state_;
+    }
+
+    // Set context for value providers
+    const int entity = entities_->intern(entity_id);
+    driver_provider_->set_context(entity, scenario_id, period_id);
+    statement_provider_->set_context(entity, scenario_id);
+    policy_provider_->set_period(period_id);   // Lookups during parallel steps only read
+
+    // Populate opening balance sheet values
+    populate_opening_values(opening_bs);
+
+    // Load unified template and its driver mappings (base_value_source → driver_code)
+    std::shared_ptr<const core::StatementTemplate> tmpl;
+    try {
+        tmpl = load_template(template_code);
+    } catch (const std::invalid_argument& e) {
+        result.success = false;
+        result.errors.push_back(e.what());
+        return result;
+    }
+    if (!tmpl) {
+        result.success = false;
+        result.errors.push_back("Failed to load unified template: " + template_code);
+        return result;
+    }
+
+    // Compute calculation order from dependencies
+    try {
+        tmpl->compute_calculation_order();
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.errors.push_back("Failed to compute calculation order: " + std::string(e.what()));
+        return result;
+    }
+
+    // Debug: Check if template loaded
+    if (tmpl->get_line_items().empty()) {
+        result.success = false;
+        result.errors.push_back("Template loaded but has no line items!");
+        return result;
+    }
+
+    // Create context for this calculation
+    core::Context ctx(scenario_id, period_id, entity);
+
+    // Calculation order resolved against the providers (cached between calls)
+    CalculationPlan& plan = plan_for(*tmpl);
+    core::Profiler::Mark calculate_begin;
+    if (profiler) {
+        if (plan.profiled_by != profiler) {
+            plan.profile_ids.clear();
+            for (const auto& step : plan.steps) {
+                plan.profile_ids.push_back(profiler->line_item_id(step.code));
+            }
+            plan.profiled_by = profiler;
+        }
+        calculate_begin = core::Profiler::stage_mark();
+        profiler->record_stage(core::Profiler::Stage::TEMPLATE_LOAD, load_begin, calculate_begin);
+    }
+    shared_values_.reset(plan.shared_count);
+    calc_values_.assign(plan.steps.size(), 0.0);
+    last_circular_iterations_ = 0;
+    last_skipped_ = 0;
+
+    // Clear current values (trailing windows are set for this period)
+    statement_provider_->clear_current_values();
+    statement_provider_->begin_period(period_id);
+
+    // Incremental rerun of a period calculated before
+    bool calculated = false;
+    PreviousRun* previous = nullptr;
+    if (incremental_ && plan.compile_errors.empty() && plan.cycles.empty()) {
+        const auto key = std::make_tuple(entity, scenario_id, period_id, template_code);
+        const bool seeded = seeding_ && previous_runs_.find(key) == previous_runs_.end() && seed_run(plan, key);
+        previous = &previous_runs_[key];
+        if (seeding_) {
+            latest_runs_[std::make_pair(entity, period_id)] = key;
+        }
+        if (previous->signature == plan.signature && !previous->values.empty()) {
+            calculated = calculate_incremental(plan, ctx, *previous, seeded);
+            if (!calculated) {
+                statement_provider_->clear_current_values();
+            }
+        }
+    }
+    const bool incremental_run = calculated;
+    if (previous && !incremental_run) {
+        remember_inputs(plan, ctx, *previous);
+    }
+
+    // Native backend: the whole calculation order in one call
+    if (!calculated && native_options_.enabled && plan.cycles.empty()) {
+        if (!plan.kernel_built) {
+            build_kernel(plan);
+            if (!plan.kernel) {
+                result.warnings.add("Native kernel unavailable for '" + template_code +
+                                    "': " + plan.kernel_error);
+            }
+        }
+        calculated = plan.kernel && calculate_native(plan, ctx);
+    }
+
+    // Statement history is fetched from the database, which isn't shared
+    // between threads
+    if (!calculated && pool_ && plan.compile_errors.empty() && !plan.reads_history && plan.cycles.empty()) {
+        calculated = calculate_parallel(plan, ctx);
+        if (!calculated) {
+            statement_provider_->clear_current_values();
+        }
+    }
+
+    // Sparse run: zero-preserving formulas over all-zero inputs aren't evaluated
+    bool sparse_run = false;
+    if (!calculated && sparse_ && plan.compile_errors.empty() && plan.cycles.empty()) {
+        calculated = sparse_run = calculate_sparse(plan, ctx);
+        if (!calculated) {
+            statement_provider_->clear_current_values();
+        }
+    }
+
+    // Calculate line items in dependency order, circular blocks as a whole
+    size_t done = calculated ? plan.steps.size() : 0;
+    size_t next_cycle = 0;
+    for (; done < plan.steps.size(); ++done) {
+        const auto& step = plan.steps[done];
+        if (!step.found) {
+            result.success = false;
+            result.errors.push_back("Line item '" + step.code + "' not found in template");
+            break;
+        }
+
+        if (next_cycle < plan.cycles.size() && plan.cycles[next_cycle].begin == done) {
+            const core::CircularBlock& cycle = plan.cycles[next_cycle++];
+            try {
+                last_circular_iterations_ += solve_cycle(plan, cycle, ctx);
+            } catch (const std::exception& e) {
+                std::string codes;
+                for (size_t i = cycle.begin; i < cycle.end; ++i) {
+                    codes += (i > cycle.begin ? ", " : "") + plan.steps[i].code;
+                }
+                result.success = false;
+                result.errors.push_back("Failed to solve circular block '" + codes + "': " + e.what());
+                break;
+            }
+            done = cycle.end - 1;
+            continue;
+        }
+
+        try {
+            // Calculate value using formula or provider lookup
+            if (profiler) {
+                const core::Profiler::Mark begin = core::Profiler::mark();
+                calc_values_[done] = calculate_step(step, ctx, shared_values_);
+                profiler->record_line_item(plan.profile_ids[done], begin, core::Profiler::mark());
+            } else {
+                calc_values_[done] = calculate_step(step, ctx, shared_values_);
+            }
+
+            // Update statement provider so subsequent formulas can reference this
+            statement_provider_->set_current_slot_value(step.statement_slot, calc_values_[done]);
+
+        } catch (const std::exception& e) {
+            result.success = false;
+            result.errors.push_back("Failed to calculate '" + step.code + "': " + e.what());
+            break;
+        }
+    }
+
+    if (profiler) {
+        profiler->record_stage(core::Profiler::Stage::CALCULATE, calculate_begin, core::Profiler::stage_mark());
+    }
+
+    // Store in result (steps calculated before any failure)
+    result.line_items = ResultRow(plan.schema,
+                                  std::vector<double>(calc_values_.begin(), calc_values_.begin() + done));
+    if (!incremental_run && !sparse_run) {
+        last_recalculated_ = plan.bindings.size();
+    }
+    if (previous) {
+        if (!result.success) {
+            previous->values.clear();  // A partial state can't seed the next run
+        } else if (!incremental_run) {
+            std::copy(calc_values_.begin(), calc_values_.end(), previous->values.begin());
+            previous->signature = plan.signature;
+            previous->template_code = template_code;
+        }
+    }
+    if (!result.success) {
+        return result;
+    }
+
+    // Derivatives by the sensitivity drivers, from the values just calculated
+    if (sensitivity_drivers_) {
+        calculate_sensitivities(plan, ctx, result);
+    }
+
+    // Local derivatives for a reverse sweep (set_tape())
+    if (tape_) {
+        record_tape(plan, ctx, result);
+    }
+
+    // Later periods read this one through [t-k] without a database query
+    statement_provider_->record_period(period_id);
+    if (const double* capex = result.line_items.find(PolicyProvider::CAPEX_LINE_ITEM)) {
+        policy_provider_->record(entity, scenario_id, period_id, *capex);   // Next period's D&A vintage
+    }
+
+    // Validate result using data-driven rules (pass context for time-series refs)
+    if (validation_enabled_) {
+        FINMODEL_PROFILE_STAGE(profiler, core::Profiler::Stage::VALIDATE);
+        check_rules(result, template_code, ctx);
+    }
+
+    // [t-k] reads can come from formulas and rules alike
+    if (profiler) {
+        const size_t reads = statement_provider_->database_reads();
+        profiler->count_lookup(core::Profiler::Lookup::DATABASE, true, reads - profiled_database_reads_);
+        profiled_database_reads_ = reads;
+    }
+
+    return result;
+}
+
+const core::LaneArray* LaneResult::find(const std::string& code) const {
+    if (!schema) {
+        return nullptr;
+    }
+    const uint32_t index = schema->find(code);
+    return (index < values.size()) ? &values[index] : nullptr;
+}
+
+const core::LaneArray* Sensitivities::find(const std::string& code) const {
+    if (!schema) {
+        return nullptr;
+    }
+    const uint32_t index = schema->find(code);
+    return (index < tangents.size()) ? &tangents[index] : nullptr;
+}
+
+double Sensitivities::get(const std::string& code, const std::string& driver) const {
+    const core::LaneArray* tangent = find(code);
+    if (!tangent) {
+        throw std::out_of_range("Sensitivities: no line item " + code);
+    }
+    for (size_t d = 0; drivers && d < drivers->size(); ++d) {
+        if ((*drivers)[d] == driver) {
+            return (*tangent)[static_cast<Eigen::Index>(d)];
+        }
+    }
+    throw std::out_of_range("Sensitivities: no driver " + driver);
+}
+
+void UnifiedEngine::gather_lane_drivers(
+    const std::vector<int>& entities,
+    const std::vector<ScenarioID>& scenario_ids,
+    PeriodID period_id,
+    const std::vector<std::string>& keys,
+    LaneColumns& drivers
+) {
+    std::vector<int> driver_slots;
+    driver_slots.reserve(keys.size());
+    for (const auto& key : keys) {
+        driver_slots.push_back(driver_provider_->resolve_slot(key));
+    }
+
+    // Drivers are loaded once per distinct (entity, scenario) and copied to its other lanes
+    const size_t lanes = std::max(entities.size(), scenario_ids.size());
+    std::map<std::pair<int, ScenarioID>, size_t> first_lane;
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        const int entity = entities[entities.size() == 1 ? 0 : lane];
+        const ScenarioID scenario_id = scenario_ids[scenario_ids.size() == 1 ? 0 : lane];
+        auto [seen, added] = first_lane.emplace(std::make_pair(entity, scenario_id), lane);
+        if (!added) {
+            const auto from = static_cast<Eigen::Index>(seen->second);
+            for (const auto& key : keys) {
+                LaneColumn& column = drivers.at(key);
+                if (column.present[seen->second]) {
+                    column.set(lane, column.values[from]);
+                }
+            }
+            continue;
+        }
+
+        driver_provider_->set_context(entity, scenario_id, period_id);
+        core::Context lane_ctx(scenario_id, period_id, entity);
+        for (size_t k = 0; k < keys.size(); ++k) {
+            if (driver_provider_->has_slot_value(driver_slots[k])) {
+                drivers.at(keys[k]).set(lane, driver_provider_->get_slot_value(driver_slots[k], lane_ctx));
+            }
+        }
+    }
+
+    // Policy values, with each lane's own capex vintages
+    const size_t run = PolicyProvider::lane_run(entities, scenario_ids, lanes);
+    core::LaneArray policy_values;
+    for (const auto& key : keys) {
+        if (PolicyProvider::is_policy_key(key) && policy_provider_->lane_values(key, run, period_id, lanes, policy_values)) {
+            drivers.at(key).set_all(policy_values);
+        }
+    }
+}
+
+std::string UnifiedEngine::evaluate_lanes(
+    const std::string& template_code,
+    size_t lanes,
+    const LaneGather& gather,
+    LaneResult& out
+) {
+    std::shared_ptr<const core::StatementTemplate> tmpl;
+    try {
+        tmpl = load_template(template_code);
+    } catch (const std::invalid_argument& e) {
+        return e.what();
+    }
+    if (!tmpl) {
+        return "Failed to load unified template: " + template_code;
+    }
+
+    try {
+        tmpl->compute_calculation_order();
+    } catch (const std::exception& e) {
+        return "Failed to compute calculation order: " + std::string(e.what());
+    }
+
+    if (tmpl->get_line_items().empty()) {
+        return "Template loaded but has no line items!";
+    }
+    if (!tmpl->get_circular_blocks().empty()) {
+        return "Circular references are not supported in lane runs: " + template_code;
+    }
+    out.schema = plan_for(*tmpl).schema;
+
+    // Compile every formula up front and collect the codes they read
+    std::vector<LaneStep> steps;
+    std::vector<std::string> keys;
+    std::unordered_set<std::string> seen_keys;
+    auto add_key = [&](const std::string& key) {
+        if (seen_keys.insert(key).second) {
+            keys.push_back(key);
+        }
+    };
+
+    const auto& calc_order = tmpl->get_calculation_order();
+    steps.reserve(calc_order.size());
+    for (const auto& code : calc_order) {
+        auto line_item = tmpl->get_line_item(code);
+        if (!line_item) {
+            return "Line item '" + code + "' not found in template";
+        }
+
+        LaneStep step{code, nullptr};
+        if (line_item->formula.has_value() && !line_item->formula->empty()) {
+            try {
+                step.compiled = evaluator_.compile(line_item->formula.value());
+            } catch (const std::exception& e) {
+                return "Failed to calculate '" + code + "': Failed to evaluate formula for '" +
+                       code + "': " + e.what();
+            }
+            for (const auto& var : step.compiled->variables()) {
+                add_key(var.code);
+            }
+        } else {
+            add_key(code);
+        }
+        steps.push_back(std::move(step));
+    }
+
+    // Driver and opening values of every code read, as lane arrays
+    LaneColumns drivers;
+    LaneColumns opening;
+    for (const auto& key : keys) {
+        drivers.emplace(key, LaneColumn(lanes));
+        opening.emplace(key, LaneColumn(lanes));
+    }
+    gather(keys, drivers, opening);
+
+    if (lane_options_.enabled &&
+        evaluate_lane_kernel(template_code, lanes, steps, drivers, opening, out)) {
+        return {};
+    }
+    last_lane_backend_ = LaneBackend::INTERPRETER;
+
+    // Evaluate the calculation order once for all lanes
+    std::unordered_map<std::string, core::LaneArray> current;
+    core::LaneEvaluator lane_evaluator(lanes);
+
+    // Same lookup order as the scalar provider chain: drivers, then
+    // statement values (opening first for [t-1], current first otherwise)
+    auto resolve = [&](const std::string& code, int time_offset, core::LaneArray& out) -> bool {
+        const LaneColumn& driver = drivers.at(code);
+        const LaneColumn& open = opening.at(code);
+        auto cur = current.find(code);
+        const core::LaneArray* cur_values = (cur != current.end()) ? &cur->second : nullptr;
+        const bool prefer_opening = (time_offset == -1);
+
+        // Whole-array fast paths
+        if (driver.present_count == lanes) {
+            out = driver.values;
+            return true;
+        }
+        if (driver.present_count == 0) {
+            if (cur_values && (!prefer_opening || open.present_count == 0)) {
+                out = *cur_values;
+                return true;
+            }
+            if (open.present_count == lanes && (prefer_opening || !cur_values)) {
+                out = open.values;
+                return true;
+            }
+        }
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const auto i = static_cast<Eigen::Index>(lane);
+            if (driver.present[lane]) {
+                out[i] = driver.values[i];
+            } else if (prefer_opening && open.present[lane]) {
+                out[i] = open.values[i];
+            } else if (cur_values) {
+                out[i] = (*cur_values)[i];
+            } else if (open.present[lane]) {
+                out[i] = open.values[i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    out.values.reserve(steps.size());
+    for (const auto& step : steps) {
+        core::LaneArray values(static_cast<Eigen::Index>(lanes));
+        try {
+            if (!step.compiled) {
+                // No formula: provider lookup, 0.0 when nothing has a value
+                if (!resolve(step.code, 0, values)) {
+                    const LaneColumn& driver = drivers.at(step.code);
+                    const LaneColumn& open = opening.at(step.code);
+                    for (size_t lane = 0; lane < lanes; ++lane) {
+                        const auto i = static_cast<Eigen::Index>(lane);
+                        values[i] = driver.present[lane] ? driver.values[i]
+                                  : open.present[lane] ? open.values[i] : 0.0;
+                    }
+                }
+            } else {
+                try {
+                    values = lane_evaluator.evaluate(*step.compiled,
+                        [&](const core::VariableRef& var, uint32_t, core::LaneArray& out) {
+                            if (!resolve(var.code, var.time_offset, out)) {
+                                throw core::FormulaEvaluator::variable_not_found(var);
+                            }
+                        });
+                } catch (const std::exception& e) {
+                    throw std::runtime_error("Failed to evaluate formula for '" + step.code + "': " + e.what());
+                }
+            }
+        } catch (const std::exception& e) {
+            return "Failed to calculate '" + step.code + "': " + e.what();
+        }
+
+        out.values.push_back(values);
+        current[step.code] = std::move(values);
+    }
+    return {};
+}
+
+bool UnifiedEngine::evaluate_lane_kernel(
+    const std::string& template_code,
+    size_t lanes,
+    const std::vector<LaneStep>& steps,
+    const LaneColumns& drivers,
+    const LaneColumns& opening,
+    LaneResult& out
+) {
+    // Slot layout: step i in slot i, then one input per code read from a
+    // driver or opening (driver first, as resolve() in evaluate_lanes())
+    std::unordered_map<std::string, uint32_t> step_slots;
+    for (uint32_t i = 0; i < steps.size(); ++i) {
+        if (!step_slots.emplace(steps[i].code, i).second) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> input_codes;
+    std::unordered_map<std::string, uint32_t> input_slots;
+    auto input_slot = [&](const std::string& code) -> int64_t {
+        auto it = input_slots.find(code);
+        if (it != input_slots.end()) {
+            return it->second;
+        }
+        const LaneColumn& driver = drivers.at(code);
+        const LaneColumn& open = opening.at(code);
+        if (driver.present_count < lanes && open.present_count < lanes) {
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                if (!driver.present[lane] && !open.present[lane]) {
+                    return -1;  // Not found: the interpreter reports it
+                }
+            }
+        }
+        const auto slot = static_cast<uint32_t>(steps.size() + input_codes.size());
+        input_slots.emplace(code, slot);
+        input_codes.push_back(code);
+        return slot;
+    };
+    // Lanes reading a line item from a driver or the opening instead of its computed value
+    auto host_lanes = [&](const std::string& code, bool prefer_opening) -> size_t {
+        const LaneColumn& driver = drivers.at(code);
+        if (!prefer_opening || driver.present_count == lanes) {
+            return driver.present_count;
+        }
+        const LaneColumn& open = opening.at(code);
+        size_t count = 0;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            count += (driver.present[lane] || open.present[lane]) ? 1 : 0;
+        }
+        return count;
+    };
+
+    std::vector<core::NativeKernel::Formula> formulas;
+    size_t shared_count = 0;
+    size_t layout = std::hash<std::string>{}(template_code);
+    auto combine = [&](size_t value) {
+        layout ^= value + 0x9e3779b97f4a7c15ULL + (layout << 6) + (layout >> 2);
+    };
+    for (uint32_t i = 0; i < steps.size(); ++i) {
+        const auto& compiled = steps[i].compiled;
+        if (!compiled) {
+            continue;
+        }
+
+        // The interpreter runs both sides of a branch the lanes disagree on,
+        // so an error in the side a lane didn't take would be missed
+        bool branches = false;
+        bool can_fail = false;
+        for (const auto& ins : compiled->code()) {
+            switch (ins.op) {
+                case core::OpCode::JUMP_IF_FALSE:
+                case core::OpCode::SHORT_AND:
+                case core::OpCode::SHORT_OR:
+                    branches = true;
+                    break;
+                case core::OpCode::DIV:
+                case core::OpCode::CALL_BUILTIN:
+                    can_fail = true;
+                    break;
+                case core::OpCode::MEMO_CHECK:
+                case core::OpCode::MEMO_STORE:
+                    shared_count = std::max<size_t>(shared_count, ins.operand + 1);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (branches && can_fail) {
+            return false;
+        }
+
+        core::NativeKernel::Formula formula{compiled, i, {}};
+        combine(std::hash<std::string>{}(compiled->source()));
+        for (const auto& var : compiled->variables()) {
+            auto earlier = step_slots.find(var.code);
+            int64_t slot = -1;
+            if (earlier != step_slots.end() && earlier->second < i) {
+                const size_t host = host_lanes(var.code, var.time_offset == -1);
+                if (host == 0) {
+                    slot = earlier->second;
+                } else if (host == lanes) {
+                    slot = input_slot(var.code);
+                }
+            } else {
+                slot = input_slot(var.code);
+            }
+            if (slot < 0) {
+                return false;
+            }
+            formula.variable_slots.push_back(static_cast<uint32_t>(slot));
+            combine(static_cast<size_t>(slot));
+        }
+        formulas.push_back(std::move(formula));
+    }
+
+    LaneKernel& cached = lane_kernels_[template_code];
+    if (cached.layout != layout) {
+        cached.layout = layout;
+        try {
+            cached.kernel = core::NativeKernel::build_lanes(formulas, shared_count, lane_options_);
+        } catch (const std::exception&) {
+            cached.kernel.reset();
+        }
+    }
+    if (!cached.kernel) {
+        return false;
+    }
+
+    // Provider lookups as evaluate_lanes(): driver, then opening, then 0.0
+    const size_t slots = steps.size() + input_codes.size();
+    lane_state_.assign(slots * lanes, 0.0);
+    auto fill = [&](size_t slot, const std::string& code) {
+        const LaneColumn& driver = drivers.at(code);
+        const LaneColumn& open = opening.at(code);
+        double* column = lane_state_.data() + slot * lanes;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const auto i = static_cast<Eigen::Index>(lane);
+            column[lane] = driver.present[lane] ? driver.values[i]
+                         : open.present[lane] ? open.values[i] : 0.0;
+        }
+    };
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (!steps[i].compiled) {
+            fill(i, steps[i].code);
+        }
+    }
+    for (size_t k = 0; k < input_codes.size(); ++k) {
+        fill(steps.size() + k, input_codes[k]);
+    }
+
+    try {
+        if (cached.kernel->run_lanes(lane_state_.data(), slots, lanes) != 0) {
+            return false;  // Division by zero (the interpreter reports it) or a device error
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    out.values.clear();
+    out.values.reserve(steps.size());
+    for (size_t i = 0; i < steps.size(); ++i) {
+        out.values.push_back(Eigen::Map<const core::LaneArray>(lane_state_.data() + i * lanes,
+                                                              static_cast<Eigen::Index>(lanes)));
+    }
+    last_lane_backend_ = lane_options_.device == core::LaneDevice::CUDA ? LaneBackend::DEVICE_KERNEL
+                                                                        : LaneBackend::HOST_KERNEL;
+    return true;
+}
+
+std::vector<UnifiedResult> UnifiedEngine::calculate_lanes(
+    const EntityID& entity_id,
+    const std::vector<ScenarioID>& scenario_ids,
+    PeriodID period_id,
+    const std::vector<BalanceSheet>& opening_bs,
+    const std::string& template_code
+) {
+    const size_t lanes = scenario_ids.size();
+    std::vector<UnifiedResult> results(lanes);
+    if (lanes == 0) {
+        return results;
+    }
+    if (opening_bs.size() != lanes && opening_bs.size() != 1) {
+        throw std::invalid_argument("calculate_lanes: expected 1 or " + std::to_string(lanes) +
+                                    " opening balance sheets, got " + std::to_string(opening_bs.size()));
+    }
+    auto opening_for = [&](size_t lane) -> const BalanceSheet& {
+        return opening_bs.size() == 1 ? opening_bs[0] : opening_bs[lane];
+    };
+
+    // Gather driver and opening values into lane arrays (one driver load per scenario)
+    const int entity = entities_->intern(entity_id);
+    LaneResult lane_result;
+    const std::string error = evaluate_lanes(template_code, lanes,
+        [&](const std::vector<std::string>& keys, LaneColumns& drivers, LaneColumns& opening) {
+            gather_lane_drivers({entity}, scenario_ids, period_id, keys, drivers);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const auto& opening_items = opening_for(lane).line_items;
+                for (const auto& key : keys) {
+                    auto it = opening_items.find(key);
+                    if (it != opening_items.end()) {
+                        opening.at(key).set(lane, it->second);
+                    }
+                }
+            }
+        },
+        lane_result);
+
+    // Line items calculated so far, per lane (in plan step order)
+    if (lane_result.schema) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const auto i = static_cast<Eigen::Index>(lane);
+            std::vector<double> values;
+            values.reserve(lane_result.values.size());
+            for (const auto& column : lane_result.values) {
+                values.push_back(column[i]);
+            }
+            results[lane].line_items = ResultRow(lane_result.schema, std::move(values));
+        }
+    }
+    if (!error.empty()) {
+        for (auto& result : results) {
+            result.success = false;
+            result.errors.push_back(error);
+        }
+        return results;
+    }
+    for (auto& result : results) {
+        result.success = true;
+    }
+    if (const core::LaneArray* capex = lane_result.find(PolicyProvider::CAPEX_LINE_ITEM)) {
+        policy_provider_->record_lanes(PolicyProvider::lane_run({entity}, scenario_ids, lanes), period_id, *capex);
+    }
+
+    // Validation rules are scalar: replay each lane through the provider chain
+    for (size_t lane = 0; lane < lanes && validation_enabled_; ++lane) {
+        driver_provider_->set_context(entity, scenario_ids[lane], period_id);
+        statement_provider_->set_context(entity, scenario_ids[lane]);
+        populate_opening_values(opening_for(lane));
+        statement_provider_->clear_current_values();
+        for (const auto& [code, value] : results[lane].line_items) {
+            statement_provider_->set_current_value(code, value);
+        }
+
+        core::Context lane_ctx(scenario_ids[lane], period_id, entity);
+        check_rules(results[lane], template_code, lane_ctx);
+    }
+
+    return results;
+}
+
+LaneResult UnifiedEngine::calculate_lane_values(
+    const EntityID& entity_id,
+    const std::vector<ScenarioID>& scenario_ids,
+    PeriodID period_id,
+    const LaneResult& opening,
+    const std::string& template_code,
+    const LaneValues* driver_overrides
+) {
+    return lane_values("calculate_lane_values", {entities_->intern(entity_id)}, scenario_ids, scenario_ids.size(),
+                       period_id, opening, template_code, driver_overrides);
+}
+
+LaneResult UnifiedEngine::calculate_entity_lanes(
+    const std::vector<EntityID>& entity_ids,
+    ScenarioID scenario_id,
+    PeriodID period_id,
+    const LaneResult& opening,
+    const std::string& template_code
+) {
+    std::vector<int> entities;
+    entities.reserve(entity_ids.size());
+    for (const auto& entity_id : entity_ids) {
+        entities.push_back(entities_->intern(entity_id));
+    }
+    return lane_values("calculate_entity_lanes", entities, {scenario_id}, entities.size(),
+                       period_id, opening, template_code, nullptr);
+}
+
+LaneResult UnifiedEngine::lane_values(
+    const char* caller,
+    const std::vector<int>& entities,
+    const std::vector<ScenarioID>& scenario_ids,
+    size_t lanes,
+    PeriodID period_id,
+    const LaneResult& opening,
+    const std::string& template_code,
+    const LaneValues* driver_overrides
+) {
+    auto check_lanes = [&](const core::LaneArray& values, const std::string& what) {
+        if (static_cast<size_t>(values.size()) != lanes) {
+            throw std::invalid_argument(std::string(caller) + ": " + what + " has " +
+                                        std::to_string(values.size()) + " lanes, expected " +
+                                        std::to_string(lanes));
+        }
+    };
+    for (const auto& values : opening.values) {
+        check_lanes(values, "opening value");
+    }
+    if (driver_overrides) {
+        for (const auto& [code, values] : *driver_overrides) {
+            check_lanes(values, "driver " + code);
+        }
+    }
+
+    LaneResult result;
+    if (lanes == 0) {
+        return result;
+    }
+    const std::string error = evaluate_lanes(template_code, lanes,
+        [&](const std::vector<std::string>& keys, LaneColumns& drivers, LaneColumns& opening_columns) {
+            gather_lane_drivers(entities, scenario_ids, period_id, keys, drivers);
+            for (const auto& key : keys) {
+                if (driver_overrides) {
+                    auto it = driver_overrides->find(key);
+                    if (it != driver_overrides->end()) {
+                        drivers.at(key).set_all(it->second);
+                    }
+                }
+                if (const core::LaneArray* values = opening.find(key)) {
+                    opening_columns.at(key).set_all(*values);
+                }
+            }
+        },
+        result);
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    if (const core::LaneArray* capex = result.find(PolicyProvider::CAPEX_LINE_ITEM)) {
+        policy_provider_->record_lanes(PolicyProvider::lane_run(entities, scenario_ids, lanes), period_id, *capex);
+    }
+    return result;
+}
+
+double UnifiedEngine::calculate_step(
+    const CalculationPlan::Step& step,
+    const core::Context& ctx,
+    core::SubexpressionCache& shared_values
+) {
+    if (!step.binding) {
+        if (step.compile_error) {
+            throw std::runtime_error("Failed to evaluate formula for '" + step.code + "': " + *step.compile_error);
+        }
+
+        // No formula: try to get from providers
+        // Note: We do NOT apply sign convention to driver values - they are already signed correctly
+        core::Profiler* profiler = core::PROFILING_BUILT ? profiler_.get() : nullptr;
+        for (const auto& source : step.sources) {
+            double value = 0.0;
+            int direct = source.read_direct(ctx.time_index, value);
+            if (direct < 0) {
+                if (source.slot != core::IValueProvider::NO_SLOT) {
+                    direct = source.provider->has_slot_value(source.slot) ? 1 : 0;
+                    if (direct) {
+                        value = source.provider->get_slot_value(source.slot, ctx);
+                    }
+                } else {
+                    direct = source.provider->has_value(step.code) ? 1 : 0;
+                    if (direct) {
+                        value = source.provider->get_value(step.code, ctx);  // Return as-is, no sign conversion
+                    }
+                }
+            }
+            if (profiler) {
+                profiler->count_lookup(profiled_source(source.provider), direct == 1);
+            }
+            if (direct == 1) {
+                return value;
+            }
+        }
+        if (profiler) {
+            profiler->count_lookup(core::Profiler::Lookup::NOT_FOUND, false);
+        }
+        return 0.0;
+    }
+
+    // Has formula: evaluate it (compiled and bound to providers once)
+    try {
+        double value = evaluator_.evaluate(*step.binding, ctx, tax_function_, &shared_values);
+        // Sign convention already applied in formula for computed values
+        return value;
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to evaluate formula for '" + step.code + "': " + e.what());
+    }
+}
+
+void UnifiedEngine::read_sources(const CalculationPlan& plan, const std::string& code, int time_offset, size_t done,
+                                 const core::Context& ctx, std::optional<PeriodID> previous, bool driver,
+                                 std::vector<ReadSource>& out) const {
+    out.clear();
+    if (driver) {
+        // A flow driver's value is its input times the period's time scale
+        out.push_back({ReadSource::Kind::DRIVER, driver_provider_->driver_code(code), 0, 0,
+                       driver_provider_->time_scale(code)});
+        return;
+    }
+
+    // A window is its periods t-1 .. t-n (an average divides by the periods with a value)
+    if (auto window = core::WindowRef::parse(code)) {
+        double weight = 1.0;
+        if (window->average) {
+            const core::RollingWindow* values = statement_provider_->window(code);
+            weight = (values && values->count() > 0) ? 1.0 / static_cast<double>(values->count()) : 0.0;
+        }
+        for (size_t k = 1; k <= window->periods; ++k) {
+            out.push_back({ReadSource::Kind::PERIOD, window->code, 0,
+                           ctx.period_id - static_cast<PeriodID>(k), weight});
+        }
+        return;
+    }
+
+    // Same preference as the statement provider: a step calculated earlier
+    // this period, else the opening value (the period before)
+    if (time_offset == 0) {
+        const uint32_t index = plan.schema->find(code);
+        if (index < done) {
+            out.push_back({ReadSource::Kind::STEP, code, index});
+            return;
+        }
+        time_offset = -1;
+    }
+    if (time_offset == -1) {
+        if (previous) {
+            out.push_back({ReadSource::Kind::PERIOD, code, 0, *previous});
+        }
+    } else {
+        out.push_back({ReadSource::Kind::PERIOD, code, 0, ctx.period_id + time_offset});
+    }
+}
+
+template <typename Visit>
+void UnifiedEngine::visit_reads(const CalculationPlan& plan, const core::Context& ctx, size_t done,
+                                core::TangentEvaluator& evaluator, core::LaneArray& partials, Visit&& visit) {
+    const auto& step = plan.steps[done];
+    if (step.binding) {
+        const auto& vars = step.binding->formula().variables();
+        evaluator.evaluate(
+            step.binding->formula(),
+            [&](const core::VariableRef&, uint32_t var_index, double& value, core::LaneArray& t) {
+                value = core::FormulaEvaluator::get_bound_value(*step.binding, var_index, ctx);
+                visit.seed(var_index, t);
+            },
+            partials, tax_function_);
+        for (size_t v = 0; v < vars.size(); ++v) {
+            visit.read(vars[v].code, vars[v].time_offset, driver_provider_->has_value(vars[v].code), v);
+        }
+        return;
+    }
+
+    // Provider lookup: the first source with a value, as calculate_step()
+    for (const auto& source : step.sources) {
+        const bool has = (source.slot != core::IValueProvider::NO_SLOT)
+                             ? source.provider->has_slot_value(source.slot)
+                             : source.provider->has_value(step.code);
+        if (has) {
+            visit.read(step.code, 0, source.provider == driver_provider_.get(), SIZE_MAX);
+            return;
+        }
+    }
+}
+
+void UnifiedEngine::calculate_sensitivities(const CalculationPlan& plan, const core::Context& ctx,
+                                            UnifiedResult& result) {
+    if (!plan.cycles.empty()) {
+        result.warnings.add("Sensitivities not calculated: circular references");
+        return;
+    }
+    const std::vector<std::string>& drivers = *sensitivity_drivers_;
+    const Eigen::Index directions = static_cast<Eigen::Index>(drivers.size());
+    const PeriodID period_id = ctx.period_id;
+
+    // Recorded tangents belong to one entity and scenario; a period
+    // calculated again replaces its own and those after it
+    const std::pair<int, ScenarioID> context(ctx.entity_id, ctx.scenario_id);
+    if (context != tangent_context_) {
+        tangent_history_.clear();
+        tangent_context_ = context;
+    }
+    while (!tangent_history_.empty() && tangent_history_.back().first >= period_id) {
+        tangent_history_.pop_back();
+    }
+    const std::optional<PeriodID> previous =
+        tangent_history_.empty() ? std::nullopt : std::optional<PeriodID>(tangent_history_.back().first);
+
+    Sensitivities out;
+    out.drivers = sensitivity_drivers_;
+    out.schema = plan.schema;
+    out.tangents.assign(plan.steps.size(), core::LaneArray::Zero(directions));
+    size_t keep = std::max<size_t>(1, history_depth());
+
+    // A formula's variables get the tangents of what they read: the
+    // formula's own dual-number pass combines them
+    struct {
+        UnifiedEngine& engine;
+        const CalculationPlan& plan;
+        const core::Context& ctx;
+        const std::optional<PeriodID>& previous;
+        const std::vector<std::string>& drivers;
+        Sensitivities& out;
+        size_t& keep;
+        size_t done = 0;
+        std::vector<ReadSource> sources;
+
+        void tangent_of(const std::string& code, int time_offset, bool driver, core::LaneArray& t) {
+            t.setZero();
+            engine.read_sources(plan, code, time_offset, done, ctx, previous, driver, sources);
+            keep = std::max(keep, sources.size());
+            for (const auto& source : sources) {
+                switch (source.kind) {
+                    case ReadSource::Kind::DRIVER:
+                        for (size_t d = 0; d < drivers.size(); ++d) {
+                            t[static_cast<Eigen::Index>(d)] += (drivers[d] == source.code) ? source.weight : 0.0;
+                        }
+                        break;
+                    case ReadSource::Kind::STEP:
+                        t += source.weight * out.tangents[source.step];
+                        break;
+                    case ReadSource::Kind::PERIOD:
+                        if (const auto* recorded = engine.recorded_tangent(source.code, source.period)) {
+                            t += source.weight * *recorded;
+                        }
+                        break;
+                }
+            }
+        }
+        void seed(uint32_t var_index, core::LaneArray& t) {
+            const auto& var = plan.steps[done].binding->formula().variables()[var_index];
+            tangent_of(var.code, var.time_offset, engine.driver_provider_->has_value(var.code), t);
+        }
+        void read(const std::string& code, int time_offset, bool driver, size_t var_index) {
+            if (var_index == SIZE_MAX) {
+                tangent_of(code, time_offset, driver, out.tangents[done]);
+            }
+        }
+    } visit{*this, plan, ctx, previous, drivers, out, keep, 0, {}};
+
+    // TAX_COMPUTE is evaluated again (and beside its argument): keep the
+    // state the value pass left
+    const TaxState tax_state = tax_state_;
+    try {
+        for (size_t done = 0; done < plan.steps.size(); ++done) {
+            visit.done = done;
+            visit_reads(plan, ctx, done, *tangent_evaluator_, out.tangents[done], visit);
+        }
+    } catch (const std::exception& e) {
+        tax_state_ = tax_state;
+        result.warnings.add("Sensitivities not calculated: " + std::string(e.what()));
+        return;
+    }
+    tax_state_ = tax_state;
+
+    tangent_history_.emplace_back(period_id, out);
+    while (tangent_history_.size() > keep) {
+        tangent_history_.pop_front();
+    }
+    result.sensitivities = std::move(out);
+}
+
+void UnifiedEngine::record_tape(const CalculationPlan& plan, const core::Context& ctx, UnifiedResult& result) {
+    if (!plan.cycles.empty()) {
+        result.success = false;
+        result.errors.push_back("Failed to record the adjoint tape: circular references");
+        return;
+    }
+    tape_->begin_period(ctx.period_id, plan.schema);
+    const std::optional<PeriodID> previous = tape_->previous(ctx.period_id);
+
+    // Each variable of a formula is its own direction: the tangent is the
+    // formula's gradient by its variables, one edge per source they read
+    struct {
+        UnifiedEngine& engine;
+        const CalculationPlan& plan;
+        const core::Context& ctx;
+        const std::optional<PeriodID>& previous;
+        const core::LaneArray* partials = nullptr;
+        size_t done = 0;
+        std::vector<ReadSource> sources;
+        std::vector<AdjointTape::Edge> edges;
+
+        void seed(uint32_t var_index, core::LaneArray& t) {
+            t.setZero();
+            t[var_index] = 1.0;
+        }
+        void read(const std::string& code, int time_offset, bool driver, size_t var_index) {
+            const double partial = (var_index == SIZE_MAX) ? 1.0 : (*partials)[static_cast<Eigen::Index>(var_index)];
+            if (partial == 0.0) {
+                return;
+            }
+            AdjointTape& tape = *engine.tape_;
+            engine.read_sources(plan, code, time_offset, done, ctx, previous, driver, sources);
+            for (const auto& source : sources) {
+                AdjointTape::Edge edge;
+                edge.weight = partial * source.weight;
+                switch (source.kind) {
+                    case ReadSource::Kind::DRIVER:
+                        edge.kind = AdjointTape::Edge::Kind::DRIVER;
+                        edge.index = tape.driver_id(source.code);
+                        break;
+                    case ReadSource::Kind::STEP:
+                        edge.kind = AdjointTape::Edge::Kind::STEP;
+                        edge.index = source.step;
+                        break;
+                    case ReadSource::Kind::PERIOD:
+                        if (!tape.in_run(source.period)) {
+                            continue;  // Before the run: actuals or opening values
+                        }
+                        edge.kind = AdjointTape::Edge::Kind::PERIOD;
+                        edge.index = tape.code_id(source.code);
+                        edge.period = source.period;
+                        break;
+                }
+                edges.push_back(edge);
+            }
+        }
+    } visit{*this, plan, ctx, previous, nullptr, 0, {}, {}};
+
+    const TaxState tax_state = tax_state_;
+    try {
+        core::LaneArray partials;
+        for (size_t done = 0; done < plan.steps.size(); ++done) {
+            const auto& step = plan.steps[done];
+            const size_t variables = step.binding ? step.binding->formula().variables().size() : 0;
+            if (tape_evaluators_.size() <= variables) {
+                tape_evaluators_.resize(variables + 1);
+            }
+            auto& evaluator = tape_evaluators_[variables];
+            if (!evaluator) {
+                evaluator = std::make_unique<core::TangentEvaluator>(std::max<size_t>(1, variables));
+            }
+            partials.resize(static_cast<Eigen::Index>(evaluator->directions()));
+            visit.done = done;
+            visit.partials = &partials;
+            visit.edges.clear();
+            visit_reads(plan, ctx, done, *evaluator, partials, visit);
+            tape_->add_step(visit.edges);
+        }
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.errors.push_back("Failed to record the adjoint tape: " + std::string(e.what()));
+    }
+    tax_state_ = tax_state;
+}
+
+const core::LaneArray* UnifiedEngine::recorded_tangent(const std::string& code, PeriodID period_id) const {
+    for (auto it = tangent_history_.rbegin(); it != tangent_history_.rend(); ++it) {
+        if (it->first == period_id) {
+            return it->second.find(code);
+        }
+        if (it->first < period_id) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void UnifiedEngine::set_tape(AdjointTape* tape) {
+    tape_ = tape;
+}
+
+void UnifiedEngine::set_sensitivity_drivers(std::vector<std::string> driver_codes) {
+    tangent_history_.clear();
+    if (driver_codes.empty()) {
+        sensitivity_drivers_.reset();
+        tangent_evaluator_.reset();
+        return;
+    }
+    tangent_evaluator_ = std::make_unique<core::TangentEvaluator>(driver_codes.size());
+    sensitivity_drivers_ = std::make_shared<const std::vector<std::string>>(std::move(driver_codes));
+}
+
+UnifiedEngine::CalculationPlan& UnifiedEngine::plan_for(const core::StatementTemplate& tmpl) {
+    // Templates are edited in place (e.g. by actions), so key on content too
+    const size_t signature = tmpl.content_hash();
+
+    auto it = template_plans_.find(tmpl.get_template_code());
+    if (it != template_plans_.end() && it->second.signature == signature) {
+        return it->second;
+    }
+
+    CalculationPlan plan;
+    plan.signature = signature;
+
+    std::vector<std::string> codes;
+    std::vector<std::shared_ptr<const core::CompiledFormula>> compiled;
+    for (const auto& code : tmpl.get_calculation_order()) {
+        const auto* item = tmpl.get_line_item(code);
+        if (!item || !item->formula.has_value() || item->formula->empty()) {
+            continue;
+        }
+        try {
+            compiled.push_back(evaluator_.compile(item->formula.value()));
+            codes.push_back(code);
+        } catch (const std::exception& e) {
+            plan.compile_errors[code] = e.what();
+        }
+    }
+
+    auto shared = core::FormulaOptimizer::share_subexpressions(compiled);
+    plan.shared_count = shared.shared_count;
+    for (size_t i = 0; i < codes.size(); ++i) {
+        plan.bindings.emplace(codes[i], core::FormulaBinding(shared.formulas[i], providers_));
+    }
+
+    // Dense steps (map nodes don't move, so binding pointers stay valid)
+    for (const auto& code : tmpl.get_calculation_order()) {
+        CalculationPlan::Step step;
+        step.code = code;
+        step.statement_slot = statement_provider_->resolve_slot(code);
+
+        const auto* item = tmpl.get_line_item(code);
+        step.found = item != nullptr;
+        if (item) {
+            step.sign = item->sign_convention;
+        }
+
+        auto bound = plan.bindings.find(code);
+        if (bound != plan.bindings.end()) {
+            step.binding = &bound->second;
+        } else {
+            auto error = plan.compile_errors.find(code);
+            if (error != plan.compile_errors.end()) {
+                step.compile_error = &error->second;
+            }
+            for (auto* provider : providers_) {
+                core::ProviderSlot source;
+                if (core::ProviderSlot::resolve(provider, code, 0, source)) {
+                    step.sources.push_back(source);
+                }
+            }
+        }
+        plan.steps.push_back(std::move(step));
+    }
+
+    std::vector<std::string> step_codes;
+    step_codes.reserve(plan.steps.size());
+    for (const auto& step : plan.steps) {
+        step_codes.push_back(step.code);
+    }
+    plan.schema = std::make_shared<const ResultSchema>(std::move(step_codes));
+    plan.cycles = tmpl.get_circular_blocks();
+    plan.circular = tmpl.get_circular_policy();
+
+    // State layout: a formula reads an earlier step of this period straight
+    // from its slot, anything else becomes an input loaded from the providers
+    std::unordered_map<std::string, uint32_t> computed;  // Line item → state slot
+    std::unordered_map<std::string, uint32_t> inputs;    // "code[offset]" → state slot
+    std::unordered_set<int> overrides;
+    uint32_t next_slot = static_cast<uint32_t>(plan.steps.size());
+
+    // Topological levels for the parallel executor. A shifted read of a
+    // later step must also run before it (it would see the step's current
+    // value otherwise, see below)
+    const uint32_t step_count = static_cast<uint32_t>(plan.steps.size());
+    std::unordered_map<std::string, uint32_t> step_of;
+    for (uint32_t slot = 0; slot < step_count; ++slot) {
+        step_of.emplace(plan.steps[slot].code, slot);
+    }
+    std::vector<uint32_t> level(step_count, 0);
+    std::vector<uint32_t> read_before;   // Later steps this step reads shifted
+
+    for (uint32_t slot = 0; slot < plan.steps.size(); ++slot) {
+        auto& step = plan.steps[slot];
+        read_before.clear();
+        if (step.binding) {
+            for (const auto& call : step.binding->formula().functions()) {
+                step.is_volatile = step.is_volatile || !call.pure;
+            }
+            step.preserves_zero = !step.is_volatile && core::FormulaEvaluator::preserves_zero(step.binding->formula());
+
+            const auto& vars = step.binding->formula().variables();
+            for (uint32_t v = 0; v < vars.size(); ++v) {
+                // Drivers come first in providers_, so one mapped to a
+                // computed line item would win over the computed value
+                auto earlier = computed.find(vars[v].code);
+                if (vars[v].time_offset == 0 && earlier != computed.end()) {
+                    step.variable_slots.push_back(earlier->second);
+                    step.reads.push_back(earlier->second);
+                    if (plan.steps[earlier->second].binding) {
+                        overrides.insert(driver_provider_->resolve_slot(vars[v].code));
+                    }
+                    continue;
+                }
+
+                plan.reads_history = plan.reads_history || vars[v].time_offset < -1 || vars[v].time_offset > 0;
+
+                auto key = vars[v].code + "[" + std::to_string(vars[v].time_offset) + "]";
+                auto [input, inserted] = inputs.emplace(key, next_slot);
+                if (inserted) {
+                    plan.inputs.push_back({next_slot, step.binding, v, key});
+                    ++next_slot;
+                }
+                step.variable_slots.push_back(input->second);
+                step.reads.push_back(input->second);
+
+                // Statement values prefer the current period for offsets
+                // other than [t-1], so this also reads the earlier step
+                if (earlier != computed.end() && vars[v].time_offset != 0) {
+                    step.reads.push_back(earlier->second);
+                    plan.reads_current_shifted = plan.reads_current_shifted || vars[v].time_offset != -1;
+                }
+                auto later = step_of.find(vars[v].code);
+                if (later != step_of.end() && later->second > slot) {
+                    read_before.push_back(later->second);
+                }
+            }
+        }
+        computed.emplace(step.code, slot);
+
+        for (uint32_t read : step.reads) {
+            if (read < step_count) {
+                level[slot] = std::max(level[slot], level[read] + 1);
+            }
+        }
+        for (uint32_t later : read_before) {
+            level[later] = std::max(level[later], level[slot] + 1);
+        }
+        if (level[slot] >= plan.levels.size()) {
+            plan.levels.resize(level[slot] + 1);
+        }
+    }
+    for (uint32_t slot = 0; slot < step_count; ++slot) {
+        plan.levels[level[slot]].push_back(slot);
+    }
+
+    overrides.erase(core::IValueProvider::NO_SLOT);
+    plan.overrides.assign(overrides.begin(), overrides.end());
+    plan.state_size = next_slot;
+
+    // Identities for seeding: a step of another plan with the same identity
+    // computes the same value when what it reads is unchanged
+    std::hash<std::string> hasher;
+    std::vector<size_t> read_hashes(plan.state_size);
+    for (uint32_t slot = 0; slot < step_count; ++slot) {
+        read_hashes[slot] = hasher("S:" + plan.steps[slot].code);
+    }
+    for (const auto& input : plan.inputs) {
+        read_hashes[input.slot] = hasher("I:" + input.key);
+    }
+    for (auto& step : plan.steps) {
+        const auto* item = tmpl.get_line_item(step.code);
+        size_t hash = hasher(step.code) ^ (hasher(item ? item->formula.value_or("") : "") * 31);
+        for (uint32_t read : step.reads) {
+            hash ^= read_hashes[read] + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        }
+        step.identity = hash;
+    }
+
+    return template_plans_[tmpl.get_template_code()] = std::move(plan);
+}
+
+void UnifiedEngine::build_kernel(CalculationPlan& plan) {
+    plan.kernel_built = true;
+    if (!plan.compile_errors.empty()) {
+        plan.kernel_error = "template has formulas that don't compile";
+        return;
+    }
+    if (plan.reads_current_shifted) {
+        plan.kernel_error = "template reads a line item at an offset other than [t-1] after calculating it";
+        return;
+    }
 
-    // Create unit converter with FX provider for driver value conversion
-    auto unit_converter = std::make_shared<core::UnitConverter>(db_, fx_provider);
+    std::vector<core::NativeKernel::Formula> formulas;
+    for (uint32_t slot = 0; slot < plan.steps.size(); ++slot) {
+        const auto& step = plan.steps[slot];
+        if (!step.found) {
+            plan.kernel_error = "line item '" + step.code + "' not found in template";
+            return;
+        }
+        if (step.binding) {
+            formulas.push_back({step.binding->compiled(), slot, step.variable_slots});
+        }
+    }
 
-    // Initialize value providers
-    driver_provider_ = std::make_unique<DriverValueProvider>(db_, unit_converter);
-    statement_provider_ = std::make_unique<bs::StatementValueProvider>(db_);
+    try {
+        plan.kernel = core::NativeKernel::build(formulas, plan.shared_count, native_options_);
+    } catch (const std::exception& e) {
+        plan.kernel_error = e.what();
+    }
+}
 
-    // Initialize validation rule engine
-    validation_engine_ = std::make_unique<ValidationRuleEngine>(db_);
+bool UnifiedEngine::calculate_native(const CalculationPlan& plan, const core::Context& ctx) {
+    for (int slot : plan.overrides) {
+        if (driver_provider_->has_slot_value(slot)) {
+            return false;
+        }
+    }
 
-    // Legacy providers (not used but kept for backward compatibility)
-    pl_provider_ = std::make_unique<pl::PLValueProvider>();
-    cf_provider_ = std::make_unique<cf::CFValueProvider>();
+    // Provider lookups and inputs don't depend on this period's values, so
+    // they are the same whether loaded up front or step by step
+    kernel_state_.assign(plan.state_size, 0.0);
+    try {
+        for (size_t i = 0; i < plan.steps.size(); ++i) {
+            if (!plan.steps[i].binding) {
+                kernel_state_[i] = calculate_step(plan.steps[i], ctx, shared_values_);
+            }
+        }
+        for (const auto& input : plan.inputs) {
+            kernel_state_[input.slot] = core::FormulaEvaluator::get_bound_value(*input.binding, input.var_index, ctx);
+        }
+        if (plan.kernel->run(kernel_state_.data()) != 0) {
+            return false;  // Division by zero: the interpreter reports it
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
 
-    // Register providers with evaluator
-    // Order matters: try more specific providers first
-    // Register providers with evaluator
-    // Order: drivers first for "driver:XXX" syntax, then statement values for "XXX" references
-    providers_.push_back(driver_provider_.get());      // Scenario drivers (with driver: prefix)
-    providers_.push_back(statement_provider_.get());   // Financial statement values (calculated)
+    for (size_t i = 0; i < plan.steps.size(); ++i) {
+        calc_values_[i] = kernel_state_[i];
+        statement_provider_->set_current_slot_value(plan.steps[i].statement_slot, kernel_state_[i]);
+    }
+    return true;
 }
 
-UnifiedResult UnifiedEngine::calculate(
-    const EntityID& entity_id,
-    ScenarioID scenario_id,
-    PeriodID period_id,
-    const BalanceSheet& opening_bs,
-    const std::string& template_code
-) {
-    UnifiedResult result;
-    result.success = true;
-
-    // Set context for value providers
-    driver_provider_->set_context(entity_id, scenario_id, period_id);
-    statement_provider_->set_context(entity_id, scenario_id);
+bool UnifiedEngine::seed_run(const CalculationPlan& plan,
+                             const std::tuple<int, ScenarioID, PeriodID, std::string>& key) {
+    auto latest = latest_runs_.find(std::make_pair(std::get<0>(key), std::get<2>(key)));
+    if (latest == latest_runs_.end()) {
+        return false;
+    }
+    auto seed = previous_runs_.find(latest->second);
+    if (seed == previous_runs_.end() || seed->second.values.empty()) {
+        return false;
+    }
+    auto from = template_plans_.find(seed->second.template_code);
+    if (from == template_plans_.end() || from->second.signature != seed->second.signature) {
+        return false;
+    }
+    const CalculationPlan& seed_plan = from->second;
 
-    // Load driver mappings from template (base_value_source → driver_code)
-    driver_provider_->load_template_mappings(template_code);
+    PreviousRun run;
+    run.signature = plan.signature;
+    run.template_code = std::get<3>(key);
+    run.values.assign(plan.state_size, 0.0);
+    run.present.assign(plan.state_size, 1);
+    unseeded_.assign(plan.steps.size(), 1);
 
-    // Populate opening balance sheet values
-    populate_opening_values(opening_bs);
+    std::unordered_map<std::string, uint32_t> seed_steps;
+    for (uint32_t slot = 0; slot < seed_plan.steps.size(); ++slot) {
+        seed_steps.emplace(seed_plan.steps[slot].code, slot);
+    }
+    for (uint32_t slot = 0; slot < plan.steps.size(); ++slot) {
+        auto match = seed_steps.find(plan.steps[slot].code);
+        if (match != seed_steps.end() && seed_plan.steps[match->second].identity == plan.steps[slot].identity) {
+            run.values[slot] = seed->second.values[match->second];
+            unseeded_[slot] = 0;
+        }
+    }
 
-    // Load unified template
-    auto tmpl = core::StatementTemplate::load_from_database(db_.get(), template_code);
-    if (!tmpl) {
-        result.success = false;
-        result.errors.push_back("Failed to load unified template: " + template_code);
-        return result;
+    // An input the seed didn't load counts as changed
+    std::unordered_map<std::string, uint32_t> seed_inputs;
+    for (const auto& input : seed_plan.inputs) {
+        seed_inputs.emplace(input.key, input.slot);
+    }
+    for (const auto& input : plan.inputs) {
+        auto match = seed_inputs.find(input.key);
+        if (match != seed_inputs.end()) {
+            run.values[input.slot] = seed->second.values[match->second];
+            run.present[input.slot] = seed->second.present[match->second];
+        } else {
+            run.present[input.slot] = 0;
+        }
     }
 
-    // Compute calculation order from dependencies
-    try {
-        tmpl->compute_calculation_order();
-    } catch (const std::exception& e) {
-        result.success = false;
-        result.errors.push_back("Failed to compute calculation order: " + std::string(e.what()));
-        return result;
+    previous_runs_.erase(seed);
+    previous_runs_.emplace(key, std::move(run));
+    return true;
+}
+
+bool UnifiedEngine::calculate_incremental(const CalculationPlan& plan, const core::Context& ctx, PreviousRun& run,
+                                          bool seeded) {
+    for (int slot : plan.overrides) {
+        if (driver_provider_->has_slot_value(slot)) {
+            return false;
+        }
     }
 
-    // Debug: Check if template loaded
-    auto line_items = tmpl->get_line_items();
-    if (line_items.empty()) {
-        result.success = false;
-        result.errors.push_back("Template loaded but has no line items!");
-        return result;
+    // Inputs are loaded before any step, as remember_inputs() does. One that
+    // can't be loaded isn't an error yet: the formula may not read it
+    changed_.assign(plan.state_size, 0);
+    for (const auto& input : plan.inputs) {
+        double value = 0.0;
+        uint8_t present = 1;
+        try {
+            value = core::FormulaEvaluator::get_bound_value(*input.binding, input.var_index, ctx);
+        } catch (const std::exception&) {
+            present = 0;
+        }
+        // Not loadable before the pass: the formula may resolve it through a
+        // provider fallback mid-pass, so always re-evaluate its readers
+        changed_[input.slot] = !present || !run.present[input.slot] || value != run.values[input.slot];
+        run.values[input.slot] = value;
+        run.present[input.slot] = present;
     }
 
-    // Create context for this calculation
-    int entity_id_int = std::hash<std::string>{}(entity_id);
-    core::Context ctx(scenario_id, period_id, entity_id_int);
+    // Any failure leaves run half-updated; the full calculation that
+    // follows replaces it (or drops it if that fails too)
+    size_t recalculated = 0;
+    for (size_t i = 0; i < plan.steps.size(); ++i) {
+        const auto& step = plan.steps[i];
+        if (!step.found) {
+            return false;
+        }
 
-    // Clear current values
-    current_values_.clear();
+        const bool unseeded = seeded && unseeded_[i];
+        bool dirty = !step.binding || step.is_volatile || unseeded;
+        for (size_t r = 0; !dirty && r < step.reads.size(); ++r) {
+            dirty = changed_[step.reads[r]] != 0;
+        }
 
-    // Calculate line items in dependency order
-    const auto& calc_order = tmpl->get_calculation_order();
+        double value = run.values[i];
+        if (dirty) {
+            try {
+                value = calculate_step(step, ctx, shared_values_);
+            } catch (const std::exception&) {
+                return false;  // The full calculation reports it
+            }
+            if (step.binding) {
+                ++recalculated;
+            }
+        }
 
+        changed_[i] = unseeded || value != run.values[i];
+        run.values[i] = value;
+        calc_values_[i] = value;
+        statement_provider_->set_current_slot_value(step.statement_slot, value);
+    }
 
-    for (const auto& code : calc_order) {
-        auto line_item = tmpl->get_line_item(code);
-        if (!line_item) {
-            result.success = false;
-            result.errors.push_back("Line item '" + code + "' not found in template");
-            return result;
+    last_recalculated_ = recalculated;
+    return true;
+}
+
+bool UnifiedEngine::calculate_sparse(const CalculationPlan& plan, const core::Context& ctx) {
+    for (int slot : plan.overrides) {
+        if (driver_provider_->has_slot_value(slot)) {
+            return false;
         }
+    }
 
+    // The period's non-zero bitmap starts with its inputs. One that can't be
+    // loaded counts as non-zero: its readers are evaluated and either find a
+    // provider fallback or report the error
+    nonzero_.assign(plan.state_size, 0);
+    for (const auto& input : plan.inputs) {
         try {
-            // Calculate value using formula or provider lookup
-            double value = calculate_line_item(code, line_item->formula, line_item->sign_convention, ctx);
+            nonzero_[input.slot] =
+                core::FormulaEvaluator::get_bound_value(*input.binding, input.var_index, ctx) != 0.0;
+        } catch (const std::exception&) {
+            nonzero_[input.slot] = 1;
+        }
+    }
 
-            // Store in result
-            result.line_items[code] = value;
-            current_values_[code] = value;
+    size_t evaluated = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < plan.steps.size(); ++i) {
+        const auto& step = plan.steps[i];
+        if (!step.found) {
+            return false;
+        }
 
-            // Update statement provider so subsequent formulas can reference this
-            statement_provider_->set_current_values(current_values_);
+        bool zero = step.preserves_zero;
+        for (size_t r = 0; zero && r < step.reads.size(); ++r) {
+            zero = nonzero_[step.reads[r]] == 0;
+        }
 
-        } catch (const std::exception& e) {
-            result.success = false;
-            result.errors.push_back("Failed to calculate '" + code + "': " + e.what());
-            return result;
+        double value = 0.0;
+        if (zero) {
+            ++skipped;
+        } else {
+            try {
+                value = calculate_step(step, ctx, shared_values_);
+            } catch (const std::exception&) {
+                return false;  // The full calculation reports it
+            }
+            if (step.binding) {
+                ++evaluated;
+            }
         }
+
+        nonzero_[i] = value != 0.0;
+        calc_values_[i] = value;
+        statement_provider_->set_current_slot_value(step.statement_slot, value);
     }
 
-    // Validate result using data-driven rules (pass context for time-series refs)
-    auto validation = validate(result, template_code, ctx);
-    if (!validation.is_valid) {
-        result.success = false;
-        result.errors.insert(result.errors.end(), validation.errors.begin(), validation.errors.end());
+    last_recalculated_ = evaluated;
+    last_skipped_ = skipped;
+    return true;
+}
+
+void UnifiedEngine::remember_inputs(const CalculationPlan& plan, const core::Context& ctx, PreviousRun& run) {
+    run.signature = 0;  // Set once the step values are in
+    run.values.assign(plan.state_size, 0.0);
+    run.present.assign(plan.state_size, 1);
+    for (const auto& input : plan.inputs) {
+        try {
+            run.values[input.slot] = core::FormulaEvaluator::get_bound_value(*input.binding, input.var_index, ctx);
+        } catch (const std::exception&) {
+            run.present[input.slot] = 0;
+        }
     }
-    result.warnings.insert(result.warnings.end(), validation.warnings.begin(), validation.warnings.end());
+}
 
-    return result;
+std::shared_ptr<const core::StatementTemplate> UnifiedEngine::find_template(const std::string& template_code) const {
+    auto registered = registered_templates_.find(template_code);
+    if (registered != registered_templates_.end()) {
+        return registered->second;
+    }
+    return core::StatementTemplate::load_cached(db_, template_code);
+}
+
+std::shared_ptr<const core::StatementTemplate> UnifiedEngine::load_template(const std::string& template_code) {
+    // Mappings of the template of the previous period are still loaded
+    auto use_mappings = [this](std::shared_ptr<const core::StatementTemplate> tmpl) {
+        if (tmpl != mapped_template_) {
+            driver_provider_->load_template_mappings(*tmpl);
+            mapped_template_ = std::move(tmpl);
+        }
+    };
+
+    auto registered = registered_templates_.find(template_code);
+    if (registered != registered_templates_.end()) {
+        auto tmpl = select_outputs(registered->second);
+        use_mappings(tmpl);
+        return tmpl;
+    }
+
+    // Database templates are shared and parsed once (see load_cached()),
+    // so their driver mappings need no query either
+    auto tmpl = core::StatementTemplate::load_cached(db_, template_code);
+    if (tmpl) {
+        tmpl = select_outputs(std::move(tmpl));
+        use_mappings(tmpl);
+    } else {
+        driver_provider_->load_template_mappings(template_code);
+        mapped_template_.reset();
+    }
+    return tmpl;
 }
 
-double UnifiedEngine::calculate_line_item(
-    const std::string& code,
-    const std::optional<std::string>& formula,
-    SignConvention sign [[maybe_unused]],
-    const core::Context& ctx
+std::shared_ptr<const core::StatementTemplate> UnifiedEngine::select_outputs(
+    std::shared_ptr<const core::StatementTemplate> tmpl
 ) {
-    if (!formula.has_value() || formula->empty()) {
-        // No formula: try to get from providers
-        // Note: We do NOT apply sign convention to driver values - they are already signed correctly
-        // The sign parameter is kept for potential future use but not currently applied
-        for (auto* provider : providers_) {
-            if (provider->has_value(code)) {
-                double value = provider->get_value(code, ctx);
-                return value;  // Return as-is, no sign conversion
+    if (outputs_.empty()) {
+        return tmpl;
+    }
+    auto& pruned = pruned_templates_[tmpl.get()];
+    if (pruned.first != tmpl) {
+        // The source is held, so its address can't be reused for another template
+        pruned.second = tmpl->with_outputs(outputs_);
+        pruned.first = std::move(tmpl);
+    }
+    return pruned.second;
+}
+
+void UnifiedEngine::set_output_selection(std::vector<std::string> outputs) {
+    outputs_ = std::move(outputs);
+    pruned_templates_.clear();
+    mapped_template_.reset();
+}
+
+void UnifiedEngine::register_template(std::shared_ptr<const core::StatementTemplate> tmpl) {
+    if (!tmpl) {
+        throw std::invalid_argument("register_template: null template");
+    }
+    std::string code = tmpl->get_template_code();
+    registered_templates_[code] = std::move(tmpl);
+}
+
+size_t UnifiedEngine::solve_cycle(const CalculationPlan& plan, const core::CircularBlock& cycle,
+                                  const core::Context& ctx) {
+    const core::CircularPolicy& policy = plan.circular;
+    const Eigen::Index n = static_cast<Eigen::Index>(cycle.end - cycle.begin);
+    auto step_at = [&](Eigen::Index i) -> const CalculationPlan::Step& {
+        return plan.steps[cycle.begin + static_cast<size_t>(i)];
+    };
+
+    // Start from the opening values (the period before), 0 without one
+    Eigen::VectorXd x(n);
+    for (Eigen::Index i = 0; i < n; ++i) {
+        const int slot = step_at(i).statement_slot;
+        x[i] = (slot != core::IValueProvider::NO_SLOT && statement_provider_->has_slot_value(slot))
+                   ? statement_provider_->get_slot_value(slot, ctx)
+                   : 0.0;
+    }
+
+    // One sweep: sweep[i] from the start value of steps i.. and the
+    // sweep's own values of the steps before i
+    Eigen::VectorXd sweep(n);
+    auto start = [&](const Eigen::VectorXd& at) {
+        for (Eigen::Index i = 0; i < n; ++i) {
+            statement_provider_->set_current_slot_value(step_at(i).statement_slot, at[i]);
+        }
+        shared_values_.reset(plan.shared_count);  // Shared subexpressions may read the block
+    };
+    auto value_sweep = [&](const Eigen::VectorXd& at) {
+        start(at);
+        for (Eigen::Index i = 0; i < n; ++i) {
+            sweep[i] = calculate_step(step_at(i), ctx, shared_values_);
+            statement_provider_->set_current_slot_value(step_at(i).statement_slot, sweep[i]);
+        }
+    };
+
+    // Newton: the sweep and its Jacobian by the start values in one dual-number pass
+    Eigen::MatrixXd jacobian;
+    auto newton_sweep = [&](const Eigen::VectorXd& at) {
+        const size_t size = static_cast<size_t>(n);
+        if (circular_evaluators_.size() <= size) {
+            circular_evaluators_.resize(size + 1);
+        }
+        if (!circular_evaluators_[size]) {
+            circular_evaluators_[size] = std::make_unique<core::TangentEvaluator>(size);
+        }
+        core::TangentEvaluator& evaluator = *circular_evaluators_[size];
+        start(at);
+        jacobian.setZero(n, n);
+        core::LaneArray tangent(n);
+        for (Eigen::Index i = 0; i < n; ++i) {
+            const auto& step = step_at(i);
+            if (!step.binding) {
+                sweep[i] = calculate_step(step, ctx, shared_values_);
+            } else {
+                sweep[i] = evaluator.evaluate(
+                    step.binding->formula(),
+                    [&](const core::VariableRef& var, uint32_t var_index, double& value, core::LaneArray& t) {
+                        value = core::FormulaEvaluator::get_bound_value(*step.binding, var_index, ctx);
+                        t.setZero();
+                        const uint32_t index = (var.time_offset == 0) ? plan.schema->find(var.code) : ResultSchema::NO_INDEX;
+                        if (index != ResultSchema::NO_INDEX && index >= cycle.begin && index < cycle.end) {
+                            const Eigen::Index j = static_cast<Eigen::Index>(index - cycle.begin);
+                            if (j < i) {
+                                t = jacobian.row(j).transpose().array();
+                            } else {
+                                t[j] = 1.0;
+                            }
+                        }
+                    },
+                    tangent, tax_function_);
+                jacobian.row(i) = tangent.matrix().transpose();
             }
+            statement_provider_->set_current_slot_value(step.statement_slot, sweep[i]);
         }
-        return 0.0;
+    };
+
+    // Anderson: residuals and sweeps of the last depth + 1 iterations
+    std::deque<Eigen::VectorXd> residuals;
+    std::deque<Eigen::VectorXd> sweeps;
+    double change = 0.0;
+    for (size_t iteration = 1; iteration <= policy.max_iterations; ++iteration) {
+        if (policy.method == core::CircularPolicy::Method::NEWTON) {
+            newton_sweep(x);
+        } else {
+            value_sweep(x);
+        }
+        if (!sweep.allFinite()) {
+            throw std::runtime_error("diverged at iteration " + std::to_string(iteration));
+        }
+
+        change = 0.0;
+        for (Eigen::Index i = 0; i < n; ++i) {
+            change = std::max(change, std::abs(sweep[i] - x[i]) / std::max(1.0, std::abs(sweep[i])));
+        }
+        if (change <= policy.tolerance) {
+            for (Eigen::Index i = 0; i < n; ++i) {
+                calc_values_[cycle.begin + static_cast<size_t>(i)] = sweep[i];
+            }
+            return iteration;
+        }
+
+        Eigen::VectorXd next = sweep;
+        if (policy.method == core::CircularPolicy::Method::NEWTON) {
+            // Root of sweep(x) - x: (J - I) dx = x - sweep(x)
+            const Eigen::MatrixXd system = jacobian - Eigen::MatrixXd::Identity(n, n);
+            const Eigen::VectorXd dx = system.colPivHouseholderQr().solve(x - sweep);
+            if (dx.allFinite()) {
+                next = x + dx;
+            }
+        } else {
+            // Sweep minus the combination of earlier steps that best cancels the residual
+            residuals.push_back(sweep - x);
+            sweeps.push_back(sweep);
+            if (residuals.size() > policy.depth + 1) {
+                residuals.pop_front();
+                sweeps.pop_front();
+            }
+            const Eigen::Index m = static_cast<Eigen::Index>(residuals.size()) - 1;
+            if (m > 0) {
+                Eigen::MatrixXd residual_steps(n, m);
+                Eigen::MatrixXd sweep_steps(n, m);
+                for (Eigen::Index k = 0; k < m; ++k) {
+                    residual_steps.col(k) = residuals[k + 1] - residuals[k];
+                    sweep_steps.col(k) = sweeps[k + 1] - sweeps[k];
+                }
+                const Eigen::VectorXd gamma = residual_steps.colPivHouseholderQr().solve(residuals.back());
+                const Eigen::VectorXd mixed = sweep - sweep_steps * gamma;
+                if (mixed.allFinite()) {
+                    next = mixed;
+                }
+            }
+        }
+        x = next;
     }
 
-    // Has formula: evaluate it
-    try {
-        double value = evaluator_.evaluate(formula.value(), providers_, ctx);
-        // Sign convention already applied in formula for computed values
-        return value;
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Failed to evaluate formula for '" + code + "': " + e.what());
+    std::ostringstream oss;
+    oss << "no convergence in " << policy.max_iterations << " iterations (largest change " << change << ")";
+    throw std::runtime_error(oss.str());
+}
+
+bool UnifiedEngine::calculate_parallel(const CalculationPlan& plan, const core::Context& ctx) {
+    // Lookups only read provider state from here on
+    driver_provider_->preload();
+    worker_shared_values_.resize(pool_->size());
+    for (auto& shared : worker_shared_values_) {
+        shared.reset(plan.shared_count);
+    }
+
+    std::atomic<bool> failed{false};
+    auto run_steps = [&](const std::vector<uint32_t>& level, size_t begin, size_t end, size_t worker) {
+        for (size_t k = begin; k < end && !failed.load(std::memory_order_relaxed); ++k) {
+            const auto& step = plan.steps[level[k]];
+            try {
+                if (!step.found) {
+                    throw std::runtime_error("line item not found");
+                }
+                const double value = calculate_step(step, ctx, worker_shared_values_[worker]);
+                calc_values_[level[k]] = value;
+                statement_provider_->set_current_slot_value(step.statement_slot, value);
+            } catch (const std::exception&) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    for (const auto& level : plan.levels) {
+        if (level.size() < parallel_min_width_) {
+            run_steps(level, 0, level.size(), 0);
+        } else {
+            pool_->parallel_for(level.size(), [&](size_t begin, size_t end, size_t worker) {
+                run_steps(level, begin, end, worker);
+            });
+        }
+        if (failed.load()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UnifiedEngine::set_parallel(size_t threads, size_t min_level_width) {
+    pool_.reset();
+    if (threads > 1) {
+        pool_ = std::make_unique<core::ThreadPool>(threads);
+    }
+    parallel_min_width_ = min_level_width;
+}
+
+void UnifiedEngine::set_incremental(bool enabled) {
+    incremental_ = enabled;
+    if (!enabled) {
+        previous_runs_.clear();
+        latest_runs_.clear();
+        seeding_ = false;
+    }
+}
+
+void UnifiedEngine::set_incremental_seeding(bool enabled) {
+    if (enabled) {
+        set_incremental(true);
+    }
+    seeding_ = enabled;
+    latest_runs_.clear();
+}
+
+void UnifiedEngine::set_profiler(std::shared_ptr<core::Profiler> profiler) {
+    profiler_ = std::move(profiler);
+    profiled_database_reads_ = statement_provider_->database_reads();
+}
+
+core::Profiler::Lookup UnifiedEngine::profiled_source(const core::IValueProvider* provider) const {
+    if (provider == driver_provider_.get()) {
+        return core::Profiler::Lookup::DRIVER;
+    }
+    if (provider == statement_provider_.get()) {
+        return core::Profiler::Lookup::STATEMENT;
+    }
+    return core::Profiler::Lookup::OTHER;
+}
+
+void UnifiedEngine::set_native_kernels(const core::NativeKernelOptions& options) {
+    native_options_ = options;
+    // Kernels are rebuilt under the new options when next needed
+    for (auto& [code, plan] : template_plans_) {
+        plan.kernel_built = false;
+        plan.kernel.reset();
+        plan.kernel_error.clear();
+    }
+}
+
+bool UnifiedEngine::has_native_kernel(const std::string& template_code) const {
+    auto it = template_plans_.find(template_code);
+    return it != template_plans_.end() && it->second.kernel != nullptr;
+}
+
+PlanStatistics UnifiedEngine::plan_statistics(const std::string& template_code) {
+    auto tmpl = load_template(template_code);
+    if (!tmpl) {
+        throw std::invalid_argument("plan_statistics: template not found: " + template_code);
+    }
+    tmpl->compute_calculation_order();
+    const CalculationPlan& plan = plan_for(*tmpl);
+
+    PlanStatistics stats;
+    for (const auto& step : plan.steps) {
+        stats.codes.push_back(step.code);
+        if (step.binding) {
+            ++stats.formulas;
+            stats.instructions += step.binding->formula().code().size();
+            stats.function_calls += step.binding->formula().functions().size();
+        }
+    }
+    stats.inputs = plan.inputs.size();
+    for (const auto& input : plan.inputs) {
+        const int offset = input.binding->formula().variables()[input.var_index].time_offset;
+        if (offset == -1) {
+            ++stats.prior_period_reads;
+        } else if (offset != 0) {
+            ++stats.history_reads;
+        }
+    }
+    stats.levels = plan.levels.size();
+    for (const auto& level : plan.levels) {
+        stats.widest_level = std::max(stats.widest_level, level.size());
     }
+    stats.circular_blocks = plan.cycles.size();
+    stats.shared_subexpressions = plan.shared_count;
+    stats.state_size = plan.state_size;
+    stats.kernel_eligible = plan.compile_errors.empty() && !plan.reads_current_shifted && plan.cycles.empty();
+    return stats;
+}
+
+void UnifiedEngine::set_lane_kernels(const core::LaneKernelOptions& options) {
+    lane_options_ = options;
+    lane_kernels_.clear();
 }
 
 void UnifiedEngine::populate_opening_values(const BalanceSheet& opening_bs) {
@@ -178,21 +2058,14 @@ ValidationResult UnifiedEngine::validate(const UnifiedResult& result, const std:
     ValidationResult validation;
     validation.is_valid = true;
 
-    // Load validation rules for this template
-    validation_engine_->load_rules_for_template(template_code);
-
-    // Execute all active rules using the same provider chain and context as calculation
-    // This ensures time-series references [t-1] are resolved correctly
-    auto rule_results = validation_engine_->execute_rules(result, evaluator_, providers_, ctx);
-
     // Process rule results
-    for (const auto& rule_result : rule_results) {
+    for (const auto& rule_result : run_rules(result, template_code, ctx)) {
         if (!rule_result.passed) {
             if (rule_result.severity == ValidationSeverity::ERROR) {
                 validation.is_valid = false;
-                validation.errors.push_back(rule_result.message);
+                validation.errors.push_back(rule_result.message());
             } else {
-                validation.warnings.push_back(rule_result.message);
+                validation.warnings.push_back(rule_result.message());
             }
         }
     }
@@ -200,6 +2073,33 @@ ValidationResult UnifiedEngine::validate(const UnifiedResult& result, const std:
     return validation;
 }
 
+std::pmr::vector<ValidationRuleResult> UnifiedEngine::run_rules(const UnifiedResult& result, const std::string& template_code,
+                                                                const core::Context& ctx) {
+    // Load validation rules for this template
+    validation_engine_->load_rules_for_template(template_code);
+    validation_engine_->compile_rules(evaluator_, providers_, result.line_items.schema());
+
+    // Execute all active rules using the same provider chain and context as calculation
+    // This ensures time-series references [t-1] are resolved correctly
+    return validation_engine_->execute_rules(
+        result, evaluator_, providers_, ctx, arena_ ? arena_ : std::pmr::get_default_resource());
+}
+
+void UnifiedEngine::check_rules(UnifiedResult& result, const std::string& template_code, const core::Context& ctx) {
+    for (const auto& rule_result : run_rules(result, template_code, ctx)) {
+        if (rule_result.passed) {
+            continue;
+        }
+        if (rule_result.severity == ValidationSeverity::ERROR) {
+            result.success = false;
+            result.errors.push_back(rule_result.message());
+        } else {
+            // No string: the rule's message was interned when it was loaded
+            result.warnings.add(rule_result.diagnostic, rule_result.calculated_value);
+        }
+    }
+}
+
 // Extract methods for backward compatibility
 
 PLResult UnifiedResult::extract_pl_result() const {
@@ -237,6 +2137,17 @@ BalanceSheet UnifiedResult::extract_balance_sheet() const {
     return bs;
 }
 
+void UnifiedResult::extract_balance_sheet(BalanceSheet& bs) const {
+    // Built once: "TOTAL_LIABILITIES" is too long for a small string
+    static const std::string CASH = "CASH", TOTAL_ASSETS = "TOTAL_ASSETS",
+                             TOTAL_LIABILITIES = "TOTAL_LIABILITIES", TOTAL_EQUITY = "TOTAL_EQUITY";
+    bs.cash = get_value(CASH);
+    bs.total_assets = get_value(TOTAL_ASSETS);
+    bs.total_liabilities = get_value(TOTAL_LIABILITIES);
+    bs.total_equity = get_value(TOTAL_EQUITY);
+    line_items.assign_to(bs.line_items);
+}
+
 CashFlowStatement UnifiedResult::extract_cash_flow() const {
     CashFlowStatement cf;
 
@@ -296,5 +2207,109 @@ void UnifiedEngine::set_prior_period_values(const std::map<std::string, double>&
     statement_provider_->set_prior_period_values(prior_values);
 }
 
+void UnifiedEngine::clear_driver_cache() {
+    driver_provider_->clear_driver_cache();
+}
+
+void UnifiedEngine::set_history_depth(size_t periods) {
+    statement_provider_->set_history_depth(periods);
+}
+
+size_t UnifiedEngine::history_depth() const {
+    return statement_provider_->history_depth();
+}
+
+size_t UnifiedEngine::database_reads() const {
+    return statement_provider_->database_reads();
+}
+
+void UnifiedEngine::clear_statement_history() {
+    statement_provider_->clear_history();
+    policy_provider_->clear_history();
+    tangent_history_.clear();
+}
+
+void UnifiedEngine::restore_statement_history(const EntityID& entity_id, ScenarioID scenario_id, PeriodID period_id,
+                                              const std::map<std::string, double>& values) {
+    statement_provider_->set_context(entity_id, scenario_id);
+    statement_provider_->restore_period(period_id, values);
+    auto capex = values.find(PolicyProvider::CAPEX_LINE_ITEM);
+    if (capex != values.end()) {
+        policy_provider_->record(entities_->intern(entity_id), scenario_id, period_id, capex->second);
+    }
+}
+
+void UnifiedEngine::prefetch_drivers(const EntityID& entity_id, ScenarioID scenario_id,
+                                     const std::vector<PeriodID>& period_ids) {
+    driver_provider_->prefetch(entity_id, scenario_id, period_ids);
+}
+
+void UnifiedEngine::prefetch_drivers(const DriverValueProvider::DriverRows& rows,
+                                     const std::vector<PeriodID>& period_ids) {
+    driver_provider_->prefetch(rows, period_ids);
+}
+
+void UnifiedEngine::prefetch_drivers(const std::vector<EntityID>& entity_ids, ScenarioID scenario_id,
+                                     const std::vector<PeriodID>& period_ids) {
+    std::vector<int> entities;
+    entities.reserve(entity_ids.size());
+    for (const auto& entity_id : entity_ids) {
+        entities.push_back(entities_->intern(entity_id));
+    }
+    driver_provider_->prefetch(entities, scenario_id, period_ids);
+}
+
+void UnifiedEngine::clear_validation_rules() {
+    validation_engine_->clear_rules();
+}
+
+void UnifiedEngine::register_tax_strategy(const std::string& name,
+                                          std::shared_ptr<const pl::IStatefulTaxStrategy> strategy) {
+    tax_strategies_["TAX_COMPUTE:" + name] = {name, std::move(strategy)};
+    tax_function_ = [this](const std::string& call_name, const std::vector<double>& args) {
+        return compute_stateful_tax(call_name, args);
+    };
+}
+
+void UnifiedEngine::set_tax_state(const TaxState& opening) {
+    for (const auto& [call_name, tax] : tax_strategies_) {
+        auto it = opening.find(tax.name);
+        if (it != opening.end() && it->second.size() != tax.strategy->state_size()) {
+            throw std::invalid_argument("UnifiedEngine: tax state of " + tax.name + " has the wrong size");
+        }
+    }
+    opening_tax_state_ = opening;
+}
+
+double UnifiedEngine::compute_stateful_tax(const std::string& call_name, const std::vector<double>& args) {
+    auto it = tax_strategies_.find(call_name);
+    if (it == tax_strategies_.end()) {
+        throw std::runtime_error("Unknown tax strategy: " + call_name);
+    }
+    if (args.size() != 1) {
+        throw std::runtime_error("TAX_COMPUTE requires exactly 1 argument (pre-tax income)");
+    }
+    const StatefulTax& tax = it->second;
+
+    // From the opening state whenever evaluated, so reruns of a period agree
+    std::vector<double> state(tax.strategy->state_size());
+    auto opening = opening_tax_state_.find(tax.name);
+    if (opening != opening_tax_state_.end()) {
+        state = opening->second;
+    } else {
+        tax.strategy->initial_state(state);
+    }
+    const double value = tax.strategy->calculate_tax(args[0], state);
+
+    std::lock_guard<std::mutex> lock(tax_mutex_);
+    tax_state_[tax.name] = std::move(state);
+    return value;
+}
+
+void UnifiedEngine::set_validation(bool enabled, bool skip_warnings) {
+    validation_enabled_ = enabled;
+    validation_engine_->set_skip_warnings(skip_warnings);
+}
+
 } // namespace unified
 } // namespace finmodel
@@ -5,9 +5,15 @@
 
 #include "unified/validation_rule_engine.h"
 #include "unified/unified_engine.h"  // For UnifiedResult definition
+#include "unified/diagnostics.h"
 #include "database/result_set.h"
+#include "core/lane_evaluator.h"
+#include "core/philox_stream.h"
+#include <algorithm>
 #include <sstream>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -15,13 +21,136 @@ using json = nlohmann::json;
 namespace finmodel {
 namespace unified {
 
+namespace {
+
+// Line item of a required item ("CASH[t-1]" → "CASH")
+std::string base_item(const std::string& item) {
+    size_t bracket_pos = item.find('[');
+    return bracket_pos == std::string::npos ? item : item.substr(0, bracket_pos);
+}
+
+/**
+ * @brief One row of a ResultColumns block (and the rows before it)
+ */
+class BlockRowProvider : public core::IValueProvider {
+public:
+    explicit BlockRowProvider(const ResultColumns& block) : block_(block) {}
+
+    void set_row(size_t row) { row_ = row; }
+
+    std::optional<double> find_value(const std::string& code, const core::Context& ctx) const override {
+        auto it = block_.columns.find(code);
+        if (it == block_.columns.end()) {
+            return std::nullopt;
+        }
+        const size_t history = block_.history.empty() ? 0 : block_.history[row_];
+        if (ctx.time_index > 0 || static_cast<size_t>(-ctx.time_index) > history) {
+            return std::nullopt;
+        }
+        const double value = it->second[row_ - static_cast<size_t>(-ctx.time_index)];
+        if (std::isnan(value)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    double get_value(const std::string& code, const core::Context& ctx) const override {
+        if (auto value = find_value(code, ctx)) {
+            return *value;
+        }
+        // The message is only built for a miss that is reported
+        if (!has_value(code)) {
+            throw std::runtime_error("Line item not in results: " + code);
+        }
+        const size_t history = block_.history.empty() ? 0 : block_.history[row_];
+        if (ctx.time_index > 0 || static_cast<size_t>(-ctx.time_index) > history) {
+            throw std::runtime_error("No results for " + code + " at offset " + std::to_string(ctx.time_index));
+        }
+        throw std::runtime_error("Line item has no value: " + code);
+    }
+
+    bool has_value(const std::string& code) const override {
+        return block_.columns.count(code) > 0;
+    }
+
+private:
+    const ResultColumns& block_;
+    size_t row_ = 0;
+};
+
+} // namespace
+
+// ValidationPolicy implementation
+
+bool ValidationPolicy::validates(ScenarioID scenario_id, size_t period_index, size_t period_count) const {
+    const bool last = period_index + 1 == period_count;
+    switch (mode) {
+        case ValidationMode::FULL:
+            return true;
+        case ValidationMode::FINAL_PERIOD:
+            return last;
+        case ValidationMode::EVERY_K_PERIODS:
+            return last || (period_index + 1) % std::max<size_t>(1, every_periods) == 0;
+        case ValidationMode::SAMPLED:
+            return core::PhiloxStream(seed, static_cast<uint64_t>(scenario_id)).uniform() < sample_fraction;
+        case ValidationMode::DEFERRED:
+            return false;
+    }
+    return true;
+}
+
+namespace {
+const char* const VALIDATION_MODES[] = {"full", "final_period", "every_k_periods", "sampled", "deferred"};
+}
+
+std::string ValidationPolicy::to_json() const {
+    json policy = {{"mode", VALIDATION_MODES[static_cast<int>(mode)]}, {"skip_warnings", skip_warnings}};
+    if (mode == ValidationMode::EVERY_K_PERIODS) {
+        policy["every_periods"] = every_periods;
+    } else if (mode == ValidationMode::SAMPLED) {
+        policy["sample_fraction"] = sample_fraction;
+        policy["seed"] = seed;
+    }
+    return policy.dump();
+}
+
+ValidationPolicy ValidationPolicy::from_json(const std::string& text) {
+    ValidationPolicy policy;
+    try {
+        const json j = json::parse(text);
+        const std::string mode = j.value("mode", "full");
+        const auto* found = std::find(std::begin(VALIDATION_MODES), std::end(VALIDATION_MODES), mode);
+        if (found == std::end(VALIDATION_MODES)) {
+            throw std::invalid_argument("Validation policy: unknown mode " + mode);
+        }
+        policy.mode = static_cast<ValidationMode>(found - std::begin(VALIDATION_MODES));
+        policy.every_periods = j.value("every_periods", policy.every_periods);
+        policy.sample_fraction = j.value("sample_fraction", policy.sample_fraction);
+        policy.seed = j.value("seed", policy.seed);
+        policy.skip_warnings = j.value("skip_warnings", policy.skip_warnings);
+    } catch (const json::exception& e) {
+        throw std::invalid_argument(std::string("Validation policy: ") + e.what());
+    }
+    if (policy.every_periods == 0) {
+        throw std::invalid_argument("Validation policy: every_periods must be at least 1");
+    }
+    return policy;
+}
+
+// ValidationRuleEngine implementation
+
 ValidationRuleEngine::ValidationRuleEngine(std::shared_ptr<database::IDatabase> db)
-    : db_(db)
+    : db_(db), rules_(&no_rules_)
 {
 }
 
 void ValidationRuleEngine::load_rules_for_template(const std::string& template_code) {
-    rules_.clear();
+    auto loaded = loaded_.find(template_code);
+    if (loaded != loaded_.end()) {
+        rules_ = &loaded->second;
+        return;
+    }
+    std::vector<ValidationRule> rules;
 
     // Query to get enabled rules for this template
     std::ostringstream query;
@@ -39,6 +168,7 @@ void ValidationRuleEngine::load_rules_for_template(const std::string& template_c
 
     auto result_set = db_->execute_query(query.str(), params);
     if (!result_set) {
+        rules_ = &loaded_[template_code];
         return;  // No rules defined for this template
     }
 
@@ -47,7 +177,7 @@ void ValidationRuleEngine::load_rules_for_template(const std::string& template_c
         rule.rule_code = result_set->get_string(0);
         rule.rule_name = result_set->get_string(1);
         rule.rule_type = result_set->get_string(2);
-        rule.rule_name = result_set->get_string(3);
+        rule.description = result_set->get_string(3);
         rule.formula = result_set->get_string(4);
 
         // Parse required_line_items JSON array
@@ -69,26 +199,91 @@ void ValidationRuleEngine::load_rules_for_template(const std::string& template_c
         rule.tolerance = result_set->get_double(6);
         rule.severity = parse_severity(result_set->get_string(7));
         rule.is_active = result_set->get_int(8) != 0;
+        rule.diagnostic = intern_diagnostic(rule, parse_check(rule.rule_type));
 
-        rules_.push_back(rule);
+        rules.push_back(rule);
     }
+    rules_ = &loaded_[template_code];
+    rules_->rules = std::move(rules);
 }
 
-std::vector<ValidationRuleResult> ValidationRuleEngine::execute_rules(
+void ValidationRuleEngine::compile_rules(
+    const core::FormulaEvaluator& evaluator,
+    const std::vector<core::IValueProvider*>& providers,
+    const std::shared_ptr<const ResultSchema>& schema
+) {
+    if (rules_->rules.empty() || !schema || rules_->schema == schema) {
+        return;
+    }
+
+    std::vector<CompiledRule> compiled;
+    compiled.reserve(rules_->rules.size());
+    for (const auto& rule : rules_->rules) {
+        CompiledRule entry;
+        entry.rule = &rule;
+        entry.check = parse_check(rule.rule_type);
+        for (const auto& item : rule.required_line_items) {
+            const uint32_t index = schema->find(base_item(item));
+            if (index == ResultSchema::NO_INDEX) {
+                entry.required_size = ResultSchema::NO_INDEX;
+                break;
+            }
+            entry.required_size = std::max(entry.required_size, index + 1);
+        }
+        try {
+            entry.binding.emplace(evaluator.compile(rule.formula), providers);
+        } catch (const std::exception& e) {
+            entry.compile_error = e.what();
+        }
+        compiled.push_back(std::move(entry));
+    }
+    rules_->compiled = std::move(compiled);
+    rules_->schema = schema;
+}
+
+void ValidationRuleEngine::clear_rules() {
+    loaded_.clear();
+    rules_ = &no_rules_;
+}
+
+std::pmr::vector<ValidationRuleResult> ValidationRuleEngine::execute_rules(
     const UnifiedResult& result,
-    core::FormulaEvaluator& evaluator,
+    const core::FormulaEvaluator& evaluator,
     const std::vector<core::IValueProvider*>& providers,
-    const core::Context& ctx
+    const core::Context& ctx,
+    std::pmr::memory_resource* memory
 ) const {
-    std::vector<ValidationRuleResult> results;
+    std::pmr::vector<ValidationRuleResult> results(memory);
 
-    for (const auto& rule : rules_) {
-        ValidationRuleResult rule_result;
-        rule_result.rule_code = rule.rule_code;
-        rule_result.rule_name = rule.rule_name;
-        rule_result.severity = rule.severity;
-        rule_result.tolerance = rule.tolerance;
-        rule_result.passed = true;  // Assume pass unless proven otherwise
+    // Compiled for this layout: positions and slots were resolved once
+    if (rules_->schema && result.line_items.schema() == rules_->schema) {
+        const size_t present = result.line_items.size();
+        results.reserve(rules_->compiled.size());
+        for (const auto& compiled : rules_->compiled) {
+            const ValidationRule& rule = *compiled.rule;
+            if (compiled.required_size > present ||
+                (skip_warnings_ && rule.severity == ValidationSeverity::WARNING)) {
+                continue;   // Required items not present, or a skipped warning
+            }
+            if (!compiled.binding) {
+                results.push_back(failed_rule(rule, compiled.compile_error));
+                continue;
+            }
+            try {
+                const double value = evaluator.evaluate(*compiled.binding, ctx);
+                ValidationRuleResult& rule_result = results.emplace_back(start_result(rule));
+                check_value(rule, compiled.check, value, rule_result);
+            } catch (const std::exception& e) {
+                results.push_back(failed_rule(rule, e.what()));
+            }
+        }
+        return results;
+    }
+
+    for (const auto& rule : rules_->rules) {
+        if (skip_warnings_ && rule.severity == ValidationSeverity::WARNING) {
+            continue;
+        }
 
         // Check if all required line items exist
         if (!has_required_items(result, rule.required_line_items)) {
@@ -99,45 +294,203 @@ std::vector<ValidationRuleResult> ValidationRuleEngine::execute_rules(
         // Evaluate the rule formula using the same provider chain as the calculation
         // This ensures time-series references like [t-1] are resolved correctly
         try {
-            double value = evaluator.evaluate(rule.formula, providers, ctx);
-            rule_result.calculated_value = value;
-
-            // Check based on rule type
-            if (rule.rule_type == "equation" || rule.rule_type == "reconciliation") {
-                // Formula should evaluate to ~0 (within tolerance)
-                if (std::abs(value) > rule.tolerance) {
-                    rule_result.passed = false;
-                    std::ostringstream msg;
-                    msg << rule.rule_name << " failed: "
-                        << rule.description << " (difference: " << value
-                        << ", tolerance: " << rule.tolerance << ")";
-                    rule_result.message = msg.str();
-                }
-            } else if (rule.rule_type == "boundary") {
-                // For boundary checks, negative value indicates failure
-                if (value < -rule.tolerance) {
-                    rule_result.passed = false;
-                    std::ostringstream msg;
-                    msg << rule.rule_name << " failed: "
-                        << rule.description << " (value: " << value << ")";
-                    rule_result.message = msg.str();
-                }
-            }
-
+            results.push_back(check_rule(rule, evaluator.evaluate(rule.formula, providers, ctx)));
         } catch (const std::exception& e) {
             // Formula evaluation failed
-            rule_result.passed = false;
-            std::ostringstream msg;
-            msg << rule.rule_name << " failed: Unable to evaluate formula - " << e.what();
-            rule_result.message = msg.str();
+            results.push_back(failed_rule(rule, e.what()));
         }
-
-        results.push_back(rule_result);
     }
 
     return results;
 }
 
+std::vector<ColumnRuleResult> ValidationRuleEngine::execute_rules_columnar(
+    const ResultColumns& block,
+    const core::FormulaEvaluator& evaluator,
+    size_t max_messages
+) const {
+    const size_t rows = block.rows;
+    auto column = [&](const std::string& code) -> const double* {
+        auto it = block.columns.find(code);
+        return it == block.columns.end() ? nullptr : it->second;
+    };
+    core::LaneEvaluator lanes(rows);
+    BlockRowProvider row_values(block);
+    const std::vector<core::IValueProvider*> providers{&row_values};
+    std::vector<char> applies(rows);
+    std::vector<char> missing(rows);
+
+    std::vector<ColumnRuleResult> results;
+    for (const auto& rule : rules_->rules) {
+        if (skip_warnings_ && rule.severity == ValidationSeverity::WARNING) {
+            continue;
+        }
+        ColumnRuleResult& out = results.emplace_back();
+        out.rule_code = rule.rule_code;
+        out.severity = rule.severity;
+
+        std::shared_ptr<const core::CompiledFormula> formula;
+        std::string compile_error;
+        try {
+            formula = evaluator.compile(rule.formula);
+        } catch (const std::exception& e) {
+            compile_error = e.what();
+        }
+
+        // Rows the rule applies to: required items present, enough history for its [t-k]
+        std::fill(applies.begin(), applies.end(), 1);
+        for (const auto& item : rule.required_line_items) {
+            const double* values = column(base_item(item));
+            if (!values) {
+                out.skipped = true;
+                break;
+            }
+            for (size_t row = 0; row < rows; ++row) {
+                applies[row] = applies[row] && !std::isnan(values[row]);
+            }
+        }
+        size_t lags = 0;
+        for (size_t v = 0; formula && v < formula->variables().size(); ++v) {
+            const core::VariableRef& var = formula->variables()[v];
+            out.skipped = out.skipped || !column(var.code) || var.time_offset > 0;
+            lags = std::max(lags, static_cast<size_t>(std::max(0, -var.time_offset)));
+        }
+        if (out.skipped) {
+            continue;
+        }
+        for (size_t row = 0; row < rows && lags > 0; ++row) {
+            applies[row] = applies[row] && !block.history.empty() && block.history[row] >= lags;
+        }
+
+        // Scalar check of one row, as execute_rules() would do it
+        auto check_row = [&](size_t row) {
+            if (!formula) {
+                return failed_rule(rule, compile_error);
+            }
+            row_values.set_row(row);
+            try {
+                return check_rule(rule, evaluator.evaluate(*formula, providers, core::Context()));
+            } catch (const std::exception& e) {
+                return failed_rule(rule, e.what());
+            }
+        };
+
+        // One pass over all rows; rows reading a missing value are checked alone
+        core::LaneArray values;
+        bool vectorised = false;
+        std::fill(missing.begin(), missing.end(), 0);
+        if (formula && rows > 0) {
+            try {
+                values = lanes.evaluate(*formula, [&](const core::VariableRef& var, uint32_t, core::LaneArray& lane) {
+                    const double* source = column(var.code);
+                    const auto lag = static_cast<size_t>(-var.time_offset);
+                    for (size_t row = 0; row < rows; ++row) {
+                        lane[static_cast<Eigen::Index>(row)] =
+                            row >= lag ? source[row - lag] : std::numeric_limits<double>::quiet_NaN();
+                        missing[row] = missing[row] || std::isnan(lane[static_cast<Eigen::Index>(row)]);
+                    }
+                });
+                vectorised = true;
+            } catch (const std::exception&) {
+                // An error in some row (possibly one the rule doesn't apply to): row by row
+            }
+        }
+
+        const RuleCheck check = parse_check(rule.rule_type);
+        out.failed_rows.assign((rows + 63) / 64, 0);
+        for (size_t row = 0; row < rows; ++row) {
+            if (!applies[row]) {
+                continue;
+            }
+            ++out.checked;
+            std::optional<ValidationRuleResult> row_result;
+            if (!vectorised || missing[row]) {
+                row_result = check_row(row);
+                if (row_result->passed) {
+                    continue;
+                }
+            } else if (passes(rule, check, values[static_cast<Eigen::Index>(row)])) {
+                continue;
+            }
+            out.failed_rows[row / 64] |= uint64_t{1} << (row % 64);
+            if (++out.failed <= max_messages) {
+                out.messages.emplace_back(row, row_result ? row_result->message() : check_row(row).message());
+            }
+        }
+    }
+    return results;
+}
+
+ValidationRuleResult ValidationRuleEngine::check_rule(const ValidationRule& rule, double value) {
+    ValidationRuleResult rule_result = start_result(rule);
+    check_value(rule, parse_check(rule.rule_type), value, rule_result);
+    return rule_result;
+}
+
+ValidationRuleResult ValidationRuleEngine::failed_rule(const ValidationRule& rule, const std::string& error) {
+    ValidationRuleResult rule_result = start_result(rule);
+    rule_result.passed = false;
+    rule_result.diagnostic = DiagnosticCatalog::intern(rule.rule_name + " failed: Unable to evaluate formula - " + error);
+    return rule_result;
+}
+
+ValidationRuleResult ValidationRuleEngine::start_result(const ValidationRule& rule) {
+    ValidationRuleResult rule_result;
+    rule_result.rule_code = rule.rule_code;
+    rule_result.rule_name = rule.rule_name;
+    rule_result.severity = rule.severity;
+    rule_result.tolerance = rule.tolerance;
+    rule_result.passed = true;  // Assume pass unless proven otherwise
+    rule_result.calculated_value = 0.0;
+    return rule_result;
+}
+
+void ValidationRuleEngine::check_value(const ValidationRule& rule, RuleCheck check, double value,
+                                       ValidationRuleResult& rule_result) {
+    rule_result.calculated_value = value;
+    if (passes(rule, check, value)) {
+        return;
+    }
+    rule_result.passed = false;
+    rule_result.diagnostic = rule.diagnostic != 0 ? rule.diagnostic : intern_diagnostic(rule, check);
+}
+
+uint32_t ValidationRuleEngine::intern_diagnostic(const ValidationRule& rule, RuleCheck check) {
+    const std::string prefix = rule.rule_name + " failed: " + rule.description;
+    if (check == RuleCheck::ZERO) {
+        // Formula should evaluate to ~0 (within tolerance)
+        std::ostringstream after;
+        after << ", tolerance: " << rule.tolerance << ")";
+        return DiagnosticCatalog::intern(prefix + " (difference: ", after.str());
+    }
+    // For boundary checks, negative value indicates failure
+    return DiagnosticCatalog::intern(prefix + " (value: ", ")");
+}
+
+std::string ValidationRuleResult::message() const {
+    return passed ? std::string() : DiagnosticCatalog::render(diagnostic, calculated_value);
+}
+
+bool ValidationRuleEngine::passes(const ValidationRule& rule, RuleCheck check, double value) {
+    if (check == RuleCheck::ZERO) {
+        return !(std::abs(value) > rule.tolerance);
+    }
+    if (check == RuleCheck::NON_NEGATIVE) {
+        return !(value < -rule.tolerance);
+    }
+    return true;
+}
+
+ValidationRuleEngine::RuleCheck ValidationRuleEngine::parse_check(const std::string& rule_type) {
+    if (rule_type == "equation" || rule_type == "reconciliation") {
+        return RuleCheck::ZERO;
+    }
+    if (rule_type == "boundary") {
+        return RuleCheck::NON_NEGATIVE;
+    }
+    return RuleCheck::NONE;
+}
+
 bool ValidationRuleEngine::has_errors(const std::vector<ValidationRuleResult>& rule_results) {
     for (const auto& result : rule_results) {
         if (!result.passed && result.severity == ValidationSeverity::ERROR) {
@@ -154,13 +507,7 @@ bool ValidationRuleEngine::has_required_items(
     for (const auto& item : required_items) {
         // Handle time-shifted references like CASH[t-1]
         // For now, just check the base item name
-        std::string base_item = item;
-        size_t bracket_pos = item.find('[');
-        if (bracket_pos != std::string::npos) {
-            base_item = item.substr(0, bracket_pos);
-        }
-
-        if (!result.has_value(base_item)) {
+        if (!result.has_value(base_item(item))) {
             return false;
         }
     }
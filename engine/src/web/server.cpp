@@ -1 +1,845 @@
-// TODO: Implement (M1/M2)
+/**
+ * @file server.cpp
+ * @brief Monitoring and job endpoints over a minimal HTTP/1.1 listener
+ */
+
+#include "web/server.h"
+#include "core/engine_metrics.h"
+#include "core/thread_pool.h"
+#include "core/unit_converter.h"
+#include "database/csv_importer.h"
+#include "database/idatabase.h"
+#include "database/result_set.h"
+#include "orchestration/arrow_stream.h"
+#include "orchestration/chart_views.h"
+#include "orchestration/scenario_diff.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/job_queue.h"
+#include "orchestration/template_cost.h"
+#include "orchestration/whatif_sessions.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+namespace finmodel {
+namespace web {
+
+namespace {
+
+const char* reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+/// Bodies larger than this are refused (run specs are small)
+constexpr size_t MAX_BODY = 1 << 20;
+
+/// False if the client went away
+bool send_all(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = ::send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+HttpResponse json_response(int status, std::string body) {
+    HttpResponse response;
+    response.status = status;
+    response.content_type = "application/json";
+    response.body = std::move(body) + "\n";
+    return response;
+}
+
+HttpResponse error_response(int status, const std::string& message) {
+    HttpResponse response;
+    response.status = status;
+    response.body = message + "\n";
+    return response;
+}
+
+/// Value of a query parameter ("" if absent)
+std::string query_parameter(const std::string& path, const std::string& name) {
+    const size_t query = path.find('?');
+    if (query == std::string::npos) {
+        return "";
+    }
+    std::istringstream in(path.substr(query + 1));
+    std::string item;
+    while (std::getline(in, item, '&')) {
+        if (item.rfind(name + "=", 0) == 0) {
+            return item.substr(name.size() + 1);
+        }
+    }
+    return "";
+}
+
+/// "%2C" → ","; "+" stays (codes don't hold spaces)
+std::string url_decode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() &&
+            std::isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+            out += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+/// Comma-separated items of a query parameter (none if absent)
+std::vector<std::string> query_list(const std::string& path, const std::string& name) {
+    std::vector<std::string> items;
+    std::istringstream in(url_decode(query_parameter(path, name)));
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/// IDs and ranges of IDs ("1,4-6" → 1, 4, 5, 6); nullopt if malformed
+std::optional<std::vector<int>> parse_id_list(const std::vector<std::string>& items) {
+    constexpr long MAX_IDS = 1 << 20;
+    std::vector<int> ids;
+    for (const auto& item : items) {
+        const size_t dash = item.find('-', 1);
+        const std::string first = item.substr(0, dash);
+        const std::string last = dash == std::string::npos ? first : item.substr(dash + 1);
+        char* end = nullptr;
+        const long from = std::strtol(first.c_str(), &end, 10);
+        if (first.empty() || *end != '\0') {
+            return std::nullopt;
+        }
+        const long to = std::strtol(last.c_str(), &end, 10);
+        if (last.empty() || *end != '\0' || to < from || to - from >= MAX_IDS ||
+            static_cast<long>(ids.size()) + (to - from) >= MAX_IDS) {
+            return std::nullopt;
+        }
+        for (long id = from; id <= to; ++id) {
+            ids.push_back(static_cast<int>(id));
+        }
+    }
+    return ids;
+}
+
+std::string response_head(int status, const std::string& content_type) {
+    std::ostringstream out;
+    out << "HTTP/1.1 " << status << ' ' << reason(status) << "\r\n"
+        << "Content-Type: " << content_type << "\r\n";
+    return out.str();
+}
+
+std::optional<uint64_t> parse_id(const std::string& text) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 18) {
+        return std::nullopt;
+    }
+    return std::stoull(text);
+}
+
+std::string sse(const std::vector<orchestration::JobEvent>& events) {
+    std::ostringstream out;
+    for (const auto& event : events) {
+        out << "id: " << event.sequence << "\nevent: " << event.type << "\ndata: " << event.data << "\n\n";
+    }
+    return out.str();
+}
+
+/// "/jobs/12/events" under "/jobs/" → {12, "events"}
+struct ItemRoute {
+    std::optional<uint64_t> id;
+    std::string action;
+};
+
+std::optional<ItemRoute> parse_item_route(const std::string& route, const std::string& prefix) {
+    if (route.rfind(prefix, 0) != 0) {
+        return std::nullopt;
+    }
+    const std::string rest = route.substr(prefix.size());
+    const size_t slash = rest.find('/');
+    ItemRoute parsed;
+    parsed.id = parse_id(rest.substr(0, slash));
+    if (slash != std::string::npos) {
+        parsed.action = rest.substr(slash + 1);
+    }
+    return parsed.id ? std::optional<ItemRoute>(parsed) : std::nullopt;
+}
+
+} // namespace
+
+Server::Server(uint16_t port, std::string address) : port_(port), address_(std::move(address)) {}
+
+Server::~Server() {
+    stop();
+}
+
+void Server::set_max_connections(size_t max_connections) {
+    if (max_connections == 0) {
+        throw std::invalid_argument("Server: max_connections must be at least 1");
+    }
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    max_connections_ = max_connections;
+}
+
+HttpResponse Server::handle(const std::string& method, const std::string& path, const std::string& body) const {
+    const std::string route = path.substr(0, path.find('?'));
+
+    if (route == "/metrics" || route == "/health") {
+        if (method != "GET" && method != "HEAD") {
+            return error_response(405, "Method not allowed: " + method);
+        }
+        if (route == "/health") {
+            std::ostringstream out;
+            out << "{\"status\": \"ok\", \"uptime_seconds\": "
+                << core::EngineMetrics::global().snapshot().uptime_seconds << "}";
+            return json_response(200, out.str());
+        }
+        HttpResponse response;
+        response.content_type = "text/plain; version=0.0.4; charset=utf-8";
+        response.body = core::EngineMetrics::global().prometheus_text();
+        return response;
+    }
+
+    if (jobs_ && (route == "/jobs" || parse_item_route(route, "/jobs/"))) {
+        return handle_jobs(method, path, body);
+    }
+    if (sessions_ && (route == "/sessions" || parse_item_route(route, "/sessions/"))) {
+        return handle_sessions(method, path, body);
+    }
+    if (imports_ && !import_dir_.empty() && route == "/imports") {
+        return handle_imports(method, body);
+    }
+    if (results_ && parse_item_route(route, "/results/")) {
+        return handle_results(method, path);
+    }
+    if (templates_ && route.rfind("/templates/", 0) == 0) {
+        return handle_template_cost(method, path);
+    }
+    return error_response(404, "Not found: " + route);
+}
+
+HttpResponse Server::handle_jobs(const std::string& method, const std::string& path, const std::string& body) const {
+    const std::string route = path.substr(0, path.find('?'));
+    const auto job_route = parse_item_route(route, "/jobs/");
+
+    if (route == "/jobs") {
+        if (method == "POST") {
+            try {
+                const uint64_t id = jobs_->submit(orchestration::JobSpec::from_json(body));
+                return json_response(202, jobs_->status(id)->to_json());
+            } catch (const std::invalid_argument& e) {
+                return error_response(400, e.what());
+            }
+        }
+        if (method != "GET") {
+            return error_response(405, "Method not allowed: " + method);
+        }
+        std::string list = "[";
+        for (const auto& status : jobs_->list()) {
+            list += (list.size() > 1 ? ", " : "") + status.to_json();
+        }
+        return json_response(200, list + "]");
+    }
+
+    const uint64_t id = *job_route->id;
+    const auto status = jobs_->status(id);
+    if (!status) {
+        return error_response(404, "No job " + std::to_string(id));
+    }
+    if ((job_route->action.empty() && method == "DELETE") || (job_route->action == "cancel" && method == "POST")) {
+        const bool cancelled = jobs_->cancel(id);
+        return json_response(200, "{\"job_id\": " + std::to_string(id) +
+                                  ", \"cancelled\": " + (cancelled ? "true" : "false") + "}");
+    }
+    if (job_route->action.empty() && method == "GET") {
+        return json_response(200, status->to_json());
+    }
+    if (job_route->action == "events" && method == "GET") {
+        const auto after = parse_id(query_parameter(path, "after")).value_or(0);
+        HttpResponse response;
+        response.content_type = "text/event-stream";
+        response.body = sse(jobs_->events(id, after, std::chrono::milliseconds(0)));
+        return response;
+    }
+    return error_response(job_route->action.empty() || job_route->action == "events" ||
+                          job_route->action == "cancel" ? 405 : 404,
+                          "Not supported: " + method + " " + route);
+}
+
+HttpResponse Server::handle_sessions(const std::string& method, const std::string& path, const std::string& body) const {
+    const std::string route = path.substr(0, path.find('?'));
+    try {
+        if (route == "/sessions") {
+            if (method != "POST") {
+                return error_response(405, "Method not allowed: " + method);
+            }
+            return json_response(201, sessions_->open(orchestration::JobSpec::from_json(body)).to_json());
+        }
+
+        const auto session_route = parse_item_route(route, "/sessions/");
+        const uint64_t id = *session_route->id;
+        if (session_route->action.empty() && method == "GET") {
+            return json_response(200, sessions_->result(id).to_json());
+        }
+        if (session_route->action.empty() && method == "DELETE") {
+            if (!sessions_->close(id)) {
+                return error_response(404, "No what-if session " + std::to_string(id));
+            }
+            return json_response(200, "{\"session_id\": " + std::to_string(id) + ", \"closed\": true}");
+        }
+        if (session_route->action == "drivers" && method == "POST") {
+            return json_response(200, sessions_->edit(id, orchestration::DriverEdit::list_from_json(body)).to_json());
+        }
+        return error_response(session_route->action.empty() || session_route->action == "drivers" ? 405 : 404,
+                              "Not supported: " + method + " " + route);
+    } catch (const std::out_of_range& e) {
+        return error_response(404, e.what());
+    } catch (const std::invalid_argument& e) {
+        return error_response(400, e.what());
+    }
+}
+
+HttpResponse Server::handle_imports(const std::string& method, const std::string& body) const {
+    if (method != "POST") {
+        return error_response(405, "Method not allowed: " + method);
+    }
+    std::string file;
+    std::string table;
+    database::CsvImportOptions options;
+    try {
+        const auto spec = nlohmann::json::parse(body);
+        file = spec.at("file").get<std::string>();
+        table = spec.at("table").get<std::string>();
+        options.replace = spec.value("replace", true);
+        const std::string delimiter = spec.value("delimiter", std::string(","));
+        if (delimiter.size() != 1) {
+            return error_response(400, "delimiter must be one character");
+        }
+        options.delimiter = delimiter[0];
+        if (spec.contains("numeric")) {
+            options.numeric_columns = spec.at("numeric").get<std::map<std::string, std::string>>();
+        }
+    } catch (const nlohmann::json::exception& e) {
+        return error_response(400, std::string("Invalid import: ") + e.what());
+    }
+    // Only staging tables: an upload must not replace model tables
+    if (table.rfind("staging_", 0) != 0 || table.size() == 8) {
+        return error_response(400, "Imports go into staging_* tables, not " + table);
+    }
+    // Only files of the import directory: a bare name, still inside it once links are resolved
+    namespace fs = std::filesystem;
+    std::error_code error;
+    const fs::path dir = fs::weakly_canonical(import_dir_, error);
+    const fs::path resolved = error ? fs::path() : fs::weakly_canonical(dir / file, error);
+    if (file.empty() || file == "." || file == ".." || file.find('/') != std::string::npos ||
+        error || resolved.parent_path() != dir) {
+        return error_response(400, "file must name a file in the import directory");
+    }
+    if (!fs::is_regular_file(resolved, error)) {
+        return error_response(404, "No file " + file + " in the import directory");
+    }
+
+    try {
+        auto db = imports_();
+        std::unique_ptr<core::UnitConverter> units;
+        if (std::any_of(options.numeric_columns.begin(), options.numeric_columns.end(),
+                        [](const auto& column) { return !column.second.empty(); })) {
+            units = std::make_unique<core::UnitConverter>(db);
+            options.units = units.get();
+        }
+        std::unique_ptr<core::ThreadPool> pool;
+        if (import_threads_ > 1) {
+            pool = std::make_unique<core::ThreadPool>(import_threads_);
+            options.pool = pool.get();
+        }
+        const auto result = database::CsvImporter::import_file(*db, resolved.string(), table, options);
+        nlohmann::json out = {{"table", result.table}, {"columns", result.columns},
+                              {"rows", result.rows}, {"chunks", result.chunks}};
+        return json_response(200, out.dump());
+    } catch (const std::invalid_argument& e) {
+        return error_response(400, e.what());
+    } catch (const std::exception& e) {
+        return error_response(500, e.what());
+    }
+}
+
+HttpResponse Server::handle_template_cost(const std::string& method, const std::string& path) const {
+    // "/templates/CODE/cost"
+    const std::string route = path.substr(0, path.find('?'));
+    const std::string rest = route.substr(std::string("/templates/").size());
+    const size_t slash = rest.find('/');
+    if (slash == 0 || slash == std::string::npos || rest.substr(slash + 1) != "cost") {
+        return error_response(404, "Not found: " + route);
+    }
+    if (method != "GET") {
+        return error_response(405, "Method not allowed: " + method);
+    }
+    const std::string code = url_decode(rest.substr(0, slash));
+    const auto scenarios = parse_id_list(query_list(path, "scenarios"));
+    if (!scenarios) {
+        return error_response(400, "scenarios is a list of IDs and ranges (1,4-6)");
+    }
+    size_t history = orchestration::TemplateCostAnalyzer::DEFAULT_HISTORY_DEPTH;
+    if (!query_parameter(path, "history").empty()) {
+        const auto requested = parse_id(query_parameter(path, "history"));
+        if (!requested) {
+            return error_response(400, "history must be a number of periods");
+        }
+        history = static_cast<size_t>(*requested);
+    }
+
+    try {
+        const auto cost = orchestration::TemplateCostAnalyzer::analyze(templates_(), code, *scenarios, history);
+        return json_response(200, cost.to_json());
+    } catch (const std::invalid_argument& e) {
+        return error_response(404, e.what());
+    } catch (const std::exception& e) {
+        return error_response(500, e.what());
+    }
+}
+
+void Server::set_results(ConnectionFactory connect, size_t cached_views) {
+    results_ = std::move(connect);
+    charts_ = results_ ? std::make_shared<orchestration::ChartViewCache>(cached_views) : nullptr;
+}
+
+std::string Server::result_file(uint64_t snapshot) const {
+    auto db = results_();
+    auto row = db->execute_query(
+        "SELECT file_path FROM run_output_snapshot "
+        "WHERE snapshot_id = :id AND format = 'columnar' AND file_path IS NOT NULL",
+        {{"id", static_cast<int>(snapshot)}});
+    return row->next() ? row->get_string(0) : "";
+}
+
+HttpResponse Server::open_results(const std::string& path,
+                                  std::unique_ptr<orchestration::ColumnarResultReader>& reader,
+                                  orchestration::ArrowResultQuery& query) const {
+    const uint64_t id = *parse_item_route(path.substr(0, path.find('?')), "/results/")->id;
+    const auto scenarios = parse_id_list(query_list(path, "scenarios"));
+    const auto periods = parse_id_list(query_list(path, "periods"));
+    if (!scenarios || !periods) {
+        return error_response(400, "scenarios and periods are lists of IDs and ranges (1,4-6)");
+    }
+    query.line_items = query_list(path, "line_items");
+    query.scenario_ids = *scenarios;
+    query.period_ids = *periods;
+
+    try {
+        const std::string file = result_file(id);
+        if (file.empty()) {
+            return error_response(404, "No columnar result snapshot " + std::to_string(id));
+        }
+        reader = std::make_unique<orchestration::ColumnarResultReader>(file);
+    } catch (const std::exception& e) {
+        return error_response(500, e.what());
+    }
+    for (const auto& code : query.line_items) {
+        const auto& codes = reader->line_items();
+        if (std::find(codes.begin(), codes.end(), code) == codes.end()) {
+            return error_response(400, "Snapshot " + std::to_string(id) + " has no line item " + code);
+        }
+    }
+    HttpResponse ready;
+    ready.content_type = orchestration::ArrowResultStream::CONTENT_TYPE;
+    return ready;
+}
+
+HttpResponse Server::handle_results(const std::string& method, const std::string& path) const {
+    const auto result_route = parse_item_route(path.substr(0, path.find('?')), "/results/");
+    const std::string& view = result_route->action;
+    if (!view.empty() && view != "fan" && view != "series" && view != "yearly" && view != "diff") {
+        return error_response(404, "Not found: " + path.substr(0, path.find('?')));
+    }
+    if (method != "GET") {
+        return error_response(405, "Method not allowed: " + method);
+    }
+    if (view == "diff") {
+        return handle_diff(path, *result_route->id);
+    }
+    if (!view.empty()) {
+        return handle_chart(path, *result_route->id, view);
+    }
+
+    std::unique_ptr<orchestration::ColumnarResultReader> reader;
+    orchestration::ArrowResultQuery query;
+    HttpResponse response = open_results(path, reader, query);
+    if (response.status == 200) {
+        response.body = orchestration::ArrowResultStream::to_string(*reader, query);
+    }
+    return response;
+}
+
+HttpResponse Server::handle_chart(const std::string& path, uint64_t snapshot, const std::string& view) const {
+    const std::string code = url_decode(query_parameter(path, "line_item"));
+    if (code.empty()) {
+        return error_response(400, "line_item is required");
+    }
+
+    // Parameters checked before anything is read
+    std::vector<double> quantiles = {0.05, 0.25, 0.5, 0.75, 0.95};
+    ScenarioID scenario = 0;
+    size_t points = 500;
+    auto aggregate = orchestration::YearAggregate::SUM;
+    try {
+        if (view == "fan") {
+            const auto listed = query_list(path, "quantiles");
+            if (!listed.empty()) {
+                quantiles.clear();
+                for (const auto& q : listed) {
+                    size_t used = 0;
+                    quantiles.push_back(std::stod(q, &used));
+                    if (used != q.size()) {
+                        throw std::invalid_argument(q);
+                    }
+                }
+            }
+        } else {
+            const auto id = parse_id_list(query_list(path, "scenario"));
+            if (!id || id->size() != 1) {
+                return error_response(400, "scenario is required (one scenario ID)");
+            }
+            scenario = id->front();
+            if (view == "series" && !query_parameter(path, "points").empty()) {
+                const auto requested = parse_id(query_parameter(path, "points"));
+                if (!requested || *requested < 3) {
+                    return error_response(400, "points must be a number of at least 3");
+                }
+                points = static_cast<size_t>(*requested);
+            }
+            if (view == "yearly" && !query_parameter(path, "aggregate").empty()) {
+                aggregate = orchestration::year_aggregate_from_string(query_parameter(path, "aggregate"));
+            }
+        }
+    } catch (const std::exception& e) {
+        return error_response(400, std::string("Invalid chart query: ") + e.what());
+    }
+
+    try {
+        auto render = [&]() -> std::string {
+            const std::string file = result_file(snapshot);
+            if (file.empty()) {
+                throw std::out_of_range("No columnar result snapshot " + std::to_string(snapshot));
+            }
+            orchestration::ColumnarResultReader reader(file);
+            if (view == "fan") {
+                return orchestration::ChartViews::fan_chart(reader, code, quantiles).to_json();
+            }
+            if (view == "series") {
+                return orchestration::ChartViews::downsample(reader, code, scenario, points).to_json();
+            }
+            std::unordered_map<PeriodID, int> year_of;
+            auto db = results_();
+            auto rows = db->execute_query(
+                "SELECT period_id, COALESCE(fiscal_year, CAST(substr(end_date, 1, 4) AS INTEGER)) FROM period", {});
+            while (rows->next()) {
+                year_of[rows->get_int(0)] = rows->get_int(1);
+            }
+            return orchestration::ChartViews::yearly(reader, code, scenario, year_of, aggregate).to_json();
+        };
+        return json_response(200, charts_->get(path, render));
+    } catch (const std::out_of_range& e) {
+        return error_response(404, e.what());
+    } catch (const std::invalid_argument& e) {
+        return error_response(400, e.what());
+    } catch (const std::exception& e) {
+        return error_response(500, e.what());
+    }
+}
+
+HttpResponse Server::handle_diff(const std::string& path, uint64_t snapshot) const {
+    const auto base = parse_id_list(query_list(path, "base"));
+    if (!base || base->size() != 1) {
+        return error_response(400, "base is required (one scenario ID)");
+    }
+    const auto scenarios = parse_id_list(query_list(path, "scenarios"));
+    const auto periods = parse_id_list(query_list(path, "periods"));
+    if (!scenarios || !periods) {
+        return error_response(400, "scenarios and periods are lists of IDs and ranges (1,4-6)");
+    }
+    orchestration::ScenarioDiffQuery query;
+    query.base_id = base->front();
+    query.scenario_ids = *scenarios;
+    query.period_ids.assign(periods->begin(), periods->end());
+    query.line_items = query_list(path, "line_items");
+    if (!query_parameter(path, "top").empty()) {
+        const auto top = parse_id(query_parameter(path, "top"));
+        if (!top || *top == 0) {
+            return error_response(400, "top must be a positive number");
+        }
+        query.top = static_cast<size_t>(*top);
+    }
+
+    try {
+        auto render = [&]() -> std::string {
+            const std::string file = result_file(snapshot);
+            if (file.empty()) {
+                throw std::out_of_range("No columnar result snapshot " + std::to_string(snapshot));
+            }
+            orchestration::ColumnarResultReader reader(file);
+            return orchestration::ScenarioDiffer::diff(reader, query).to_json(query.top == 0);
+        };
+        return json_response(200, charts_->get(path, render));
+    } catch (const std::out_of_range& e) {
+        return error_response(404, e.what());
+    } catch (const std::exception& e) {
+        return error_response(500, e.what());
+    }
+}
+
+void Server::listen() {
+    if (listener_ >= 0) {
+        return;
+    }
+    listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+        throw std::runtime_error(std::string("Server: socket() failed: ") + std::strerror(errno));
+    }
+    const int reuse = 1;
+    ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    if (::inet_pton(AF_INET, address_.c_str(), &addr.sin_addr) != 1) {
+        ::close(listener_);
+        listener_ = -1;
+        throw std::runtime_error("Server: invalid address " + address_);
+    }
+    if (::bind(listener_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listener_, 64) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(listener_);
+        listener_ = -1;
+        throw std::runtime_error("Server: can't listen on " + address_ + ":" + std::to_string(port_) + ": " + error);
+    }
+    socklen_t length = sizeof(addr);
+    ::getsockname(listener_, reinterpret_cast<sockaddr*>(&addr), &length);
+    port_ = ntohs(addr.sin_port);
+}
+
+void Server::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    listen();
+    running_ = true;
+    thread_ = std::thread([this] { serve_until_stopped(); });
+}
+
+void Server::run() {
+    listen();
+    running_ = true;
+    serve_until_stopped();
+}
+
+void Server::serve_until_stopped() {
+    while (running_) {
+        // Wake up now and then to notice stop()
+        pollfd fd{listener_, POLLIN, 0};
+        if (::poll(&fd, 1, 200) <= 0) {
+            continue;
+        }
+        const int client = ::accept(listener_, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        // Own thread per connection: an event stream may stay open for the length of a job
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            if (connections_ >= max_connections_) {
+                // Refused without waiting on the client: it may not be reading
+                const std::string busy = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+                                         "Retry-After: 1\r\nConnection: close\r\n\r\n";
+                ::send(client, busy.data(), busy.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                ::close(client);
+                continue;
+            }
+            ++connections_;
+        }
+        std::thread([this, client] {
+            serve(client);
+            {
+                // Free the slot before the client sees the connection close
+                std::lock_guard<std::mutex> lock(connections_mutex_);
+                --connections_;
+                connections_done_.notify_all();
+            }
+            ::close(client);
+        }).detach();
+    }
+}
+
+void Server::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    {
+        std::unique_lock<std::mutex> lock(connections_mutex_);
+        connections_done_.wait(lock, [this] { return connections_ == 0; });
+    }
+    if (listener_ >= 0) {
+        ::close(listener_);
+        listener_ = -1;
+    }
+}
+
+void Server::serve(int client) {
+    // Read the headers, then as much body as Content-Length announces, all before one deadline
+    const auto deadline = std::chrono::steady_clock::now() + request_timeout_;
+    std::string request;
+    char buffer[4096];
+    size_t header_end = std::string::npos;
+    size_t content_length = 0;
+    while (true) {
+        if (header_end == std::string::npos) {
+            header_end = request.find("\r\n\r\n");
+            if (header_end != std::string::npos) {
+                std::string headers = request.substr(0, header_end);
+                std::transform(headers.begin(), headers.end(), headers.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                const size_t length = headers.find("\r\ncontent-length:");
+                if (length != std::string::npos) {
+                    content_length = std::strtoull(headers.c_str() + length + 17, nullptr, 10);
+                }
+                if (content_length > MAX_BODY) {
+                    send_all(client, "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                    return;
+                }
+            } else if (request.size() > 16384) {
+                return;
+            }
+        }
+        if (header_end != std::string::npos && request.size() >= header_end + 4 + content_length) {
+            break;
+        }
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        pollfd fd{client, POLLIN, 0};
+        if (left.count() <= 0 || ::poll(&fd, 1, static_cast<int>(left.count())) == 0) {
+            send_all(client, "HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return;
+        }
+        if (fd.revents == 0) {
+            return;
+        }
+        const ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::istringstream line(request.substr(0, request.find("\r\n")));
+    std::string method;
+    std::string path;
+    HttpResponse response;
+    if (!(line >> method >> path)) {
+        response = error_response(400, "Bad request");
+    } else {
+        const std::string route = path.substr(0, path.find('?'));
+        const auto job_route = parse_item_route(route, "/jobs/");
+        if (jobs_ && method == "GET" && job_route && job_route->action == "events" && jobs_->status(*job_route->id)) {
+            stream_events(client, *job_route->id, parse_id(query_parameter(path, "after")).value_or(0));
+            return;
+        }
+        const auto result_route = parse_item_route(route, "/results/");
+        if (results_ && method == "GET" && result_route && result_route->action.empty()) {
+            stream_results(client, path);
+            return;
+        }
+        try {
+            response = handle(method, path, request.substr(header_end + 4, content_length));
+        } catch (const std::exception& e) {
+            response = error_response(500, e.what());   // E.g. a session's database failed
+        }
+    }
+
+    std::ostringstream out;
+    out << response_head(response.status, response.content_type)
+        << "Content-Length: " << response.body.size() << "\r\n"
+        << "Connection: close\r\n\r\n";
+    if (method != "HEAD") {
+        out << response.body;
+    }
+    send_all(client, out.str());
+}
+
+void Server::stream_events(int client, uint64_t job, uint64_t after) {
+    send_all(client, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                     "Cache-Control: no-cache\r\nConnection: close\r\n\r\n");
+    bool finished = false;
+    while (running_ && !finished) {
+        std::vector<orchestration::JobEvent> events;
+        try {
+            events = jobs_->events(job, after, std::chrono::milliseconds(500), &finished);
+        } catch (const std::out_of_range&) {
+            return;   // Forgotten (too many finished jobs since)
+        }
+        if (!events.empty()) {
+            after = events.back().sequence;
+            if (!send_all(client, sse(events))) {
+                return;
+            }
+        }
+    }
+}
+
+void Server::stream_results(int client, const std::string& path) const {
+    std::unique_ptr<orchestration::ColumnarResultReader> reader;
+    orchestration::ArrowResultQuery query;
+    const HttpResponse response = open_results(path, reader, query);
+    if (response.status != 200) {
+        send_all(client, response_head(response.status, response.content_type) +
+                         "Content-Length: " + std::to_string(response.body.size()) +
+                         "\r\nConnection: close\r\n\r\n" + response.body);
+        return;
+    }
+    // No Content-Length: the stream ends when the connection closes
+    if (!send_all(client, response_head(200, response.content_type) +
+                          "Cache-Control: no-cache\r\nConnection: close\r\n\r\n")) {
+        return;
+    }
+    try {
+        orchestration::ArrowResultStream::write(*reader, query, [this, client](const std::string& bytes) {
+            return running_ && send_all(client, bytes);
+        });
+    } catch (const std::exception&) {
+        // Too late for an error status: the truncated stream has no end marker
+    }
+}
+
+} // namespace web
+} // namespace finmodel
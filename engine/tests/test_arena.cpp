@@ -0,0 +1,95 @@
+/**
+ * @file test_arena.cpp
+ * @brief Tests for the per-period scratch arena
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "core/arena.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("Arena: Periods reuse one block of scratch memory", "[orchestration][arena]") {
+    core::Arena arena(256);
+    void* small = arena.allocate(100, 8);
+    void* large = arena.allocate(1000, 8);
+    REQUIRE(small != large);
+    CHECK(arena.heap_allocations() == 2);
+    CHECK(arena.bytes_used() == 1100);
+    // Unaligned bytes neither overlap their neighbours nor misalign what follows
+    auto disjoint = [](const void* a, size_t a_bytes, const void* b, size_t b_bytes) {
+        const auto x = reinterpret_cast<uintptr_t>(a);
+        const auto y = reinterpret_cast<uintptr_t>(b);
+        return x + a_bytes <= y || y + b_bytes <= x;
+    };
+    void* byte = arena.allocate(1, 1);
+    REQUIRE(byte != nullptr);
+    CHECK(arena.bytes_used() == 1101);
+    CHECK(disjoint(byte, 1, small, 100));
+    CHECK(disjoint(byte, 1, large, 1000));
+    void* number = arena.allocate(sizeof(double), alignof(double));
+    CHECK(reinterpret_cast<uintptr_t>(number) % alignof(double) == 0);
+    CHECK(disjoint(number, sizeof(double), byte, 1));
+    CHECK(arena.bytes_used() == 1101 + sizeof(double));
+    void* aligned = arena.allocate(8, 64);
+    REQUIRE(aligned != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(aligned) % 64 == 0);
+
+    // Reset merges the blocks; the same period then fits without the heap
+    const size_t capacity = arena.capacity();
+    const uint64_t blocks = arena.heap_allocations() + 1;
+    arena.reset();
+    CHECK(arena.bytes_used() == 0);
+    CHECK(arena.capacity() == capacity);
+    CHECK(arena.heap_allocations() == blocks);
+    for (int period = 0; period < 3; ++period) {
+        std::pmr::vector<double> scratch(100, 1.0, &arena);
+        std::pmr::vector<double> more(25, 2.0, &arena);
+        CHECK(scratch.back() + more.back() == 3.0);
+        arena.reset();
+    }
+    CHECK(arena.heap_allocations() == blocks);
+
+    // Roll-forward maps keep their nodes and drop codes of another layout
+    auto schema = std::make_shared<unified::ResultSchema>(std::vector<std::string>{"A", "B"});
+    std::map<std::string, double> values{{"A", 0.0}, {"STALE", 1.0}};
+    unified::ResultRow(schema, {1.0, 2.0}).assign_to(values);
+    CHECK(values == std::map<std::string, double>{{"A", 1.0}, {"B", 2.0}});
+
+    // Only the first period inserts roll-forward nodes, however long the run
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "ARENA_TEST", "statement_type": "unified", "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "CASH", "formula": "CASH[t-1] + REVENUE"}
+        ]
+    })json")->save_to_database(db.get());
+    for (int period = 1; period <= 6; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 100.0, 'EUR')", {{"period", period}});
+    }
+    BalanceSheet opening;
+    opening.line_items["CASH"] = 0.0;
+    auto roll_forward_allocations = [&](const std::vector<PeriodID>& periods) {
+        auto profiler = std::make_shared<core::Profiler>();
+        profiler->track_allocations(true);
+        PeriodRunner runner(db);
+        runner.set_profiler(profiler);
+        auto results = runner.run_periods("E", 1, periods, opening, "ARENA_TEST");
+        REQUIRE(results.success);
+        CHECK(results.results.back().get_value("CASH") == Approx(100.0 * periods.size()));
+        runner.set_profiler(nullptr);
+        return profiler->stages()[static_cast<size_t>(core::Profiler::Stage::ROLL_FORWARD)].allocated.allocations;
+    };
+    roll_forward_allocations({1});   // Function-local statics
+    const auto two_periods = roll_forward_allocations({1, 2});
+    CHECK(roll_forward_allocations({1, 2, 3, 4, 5, 6}) == two_periods);
+}
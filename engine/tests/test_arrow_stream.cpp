@@ -0,0 +1,239 @@
+/**
+ * @file test_arrow_stream.cpp
+ * @brief Tests for streaming columnar results as Arrow IPC
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/arrow_stream.h"
+#include "orchestration/columnar_results.h"
+#include "database/database_factory.h"
+#include "web/server.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+
+TEST_CASE("ArrowResultStream: Columnar results streamed as Arrow IPC", "[orchestration][arrow]") {
+    auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"REVENUE", "COSTS", "CASH"});
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // 6 scenarios × 4 periods in row groups of 8; CASH missing in scenario 2 period 3
+    const std::string path = "test_arrow.fmcr";
+    ColumnarFileInfo info;
+    {
+        ColumnarResultWriter writer(path, 8);
+        for (ScenarioID scenario = 1; scenario <= 6; ++scenario) {
+            for (PeriodID period = 1; period <= 4; ++period) {
+                const double cash = (scenario == 2 && period == 3) ? nan : scenario * 100.0 + period;
+                writer.append(scenario, period, unified::ResultRow(schema, {1000.0, 600.0, cash}));
+            }
+        }
+        info = writer.close();
+    }
+    ColumnarResultReader reader(path);
+    REQUIRE(reader.row_group_count() == 3);
+
+    // Framing and just enough flatbuffer reading to check the messages
+    struct Message {
+        std::string metadata;
+        std::string body;
+    };
+    auto messages = [](const std::string& stream) {
+        std::vector<Message> out;
+        size_t at = 0;
+        while (true) {
+            uint32_t continuation = 0;
+            int32_t size = 0;
+            REQUIRE(at + 8 <= stream.size());
+            std::memcpy(&continuation, stream.data() + at, 4);
+            std::memcpy(&size, stream.data() + at + 4, 4);
+            REQUIRE(continuation == 0xFFFFFFFFu);
+            if (size == 0) {
+                CHECK(at + 8 == stream.size());
+                return out;
+            }
+            CHECK((8 + size) % 8 == 0);
+            Message message;
+            message.metadata = stream.substr(at + 8, static_cast<size_t>(size));
+            at += 8 + static_cast<size_t>(size);
+            out.push_back(message);
+            // bodyLength is Message field 3
+            int64_t body = 0;
+            const auto& fb = out.back().metadata;
+            uint32_t root = 0;
+            std::memcpy(&root, fb.data(), 4);
+            int32_t vtable = 0;
+            std::memcpy(&vtable, fb.data() + root, 4);
+            uint16_t field = 0;
+            std::memcpy(&field, fb.data() + root - vtable + 4 + 2 * 3, 2);
+            if (field != 0) {
+                std::memcpy(&body, fb.data() + root + field, 8);
+            }
+            out.back().body = stream.substr(at, static_cast<size_t>(body));
+            at += static_cast<size_t>(body);
+        }
+    };
+    // Position of a table field (0: absent) and of the object a reference field points to
+    auto field = [](const std::string& fb, size_t table, int id) -> size_t {
+        int32_t vtable = 0;
+        std::memcpy(&vtable, fb.data() + table, 4);
+        const size_t entries = table - static_cast<size_t>(vtable);
+        uint16_t vtable_size = 0;
+        std::memcpy(&vtable_size, fb.data() + entries, 2);
+        if (4 + 2 * static_cast<size_t>(id) >= vtable_size) {
+            return 0;
+        }
+        uint16_t offset = 0;
+        std::memcpy(&offset, fb.data() + entries + 4 + 2 * id, 2);
+        return offset == 0 ? 0 : table + offset;
+    };
+    auto deref = [](const std::string& fb, size_t at) {
+        uint32_t offset = 0;
+        std::memcpy(&offset, fb.data() + at, 4);
+        return at + offset;
+    };
+    auto scalar = [](const std::string& fb, size_t at, auto value) {
+        std::memcpy(&value, fb.data() + at, sizeof(value));
+        return value;
+    };
+    auto root = [&](const Message& message) { return deref(message.metadata, 0); };
+
+    SECTION("Schema, then a batch per row group") {
+        const auto stream = messages(ArrowResultStream::to_string(reader, {}));
+        REQUIRE(stream.size() == 4);
+
+        const auto& fb = stream[0].metadata;
+        CHECK(scalar(fb, field(fb, root(stream[0]), 0), int16_t{}) == 4);     // MetadataVersion V5
+        CHECK(scalar(fb, field(fb, root(stream[0]), 1), uint8_t{}) == 1);     // Schema
+        const size_t schema = deref(fb, field(fb, root(stream[0]), 2));
+        const size_t fields = deref(fb, field(fb, schema, 1));
+        REQUIRE(scalar(fb, fields, uint32_t{}) == 5);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < 5; ++i) {
+            const size_t column = deref(fb, fields + 4 + 4 * i);
+            const size_t name = deref(fb, field(fb, column, 0));
+            names.push_back(fb.substr(name + 4, scalar(fb, name, uint32_t{})));
+            CHECK(scalar(fb, field(fb, column, 2), uint8_t{}) == (i < 2 ? 2 : 3));   // Int / FloatingPoint
+            CHECK(field(fb, column, 5) != 0);                                        // children: []
+        }
+        CHECK(names == std::vector<std::string>{"scenario_id", "period_id", "REVENUE", "COSTS", "CASH"});
+
+        // Second row group: scenarios 3-4; buffers are (validity, data) per column
+        const auto& batch = stream[2];
+        const auto& meta = batch.metadata;
+        CHECK(scalar(meta, field(meta, root(batch), 1), uint8_t{}) == 3);   // RecordBatch
+        const size_t record = deref(meta, field(meta, root(batch), 2));
+        CHECK(scalar(meta, field(meta, record, 0), int64_t{}) == 8);
+        const size_t buffers = deref(meta, field(meta, record, 2));
+        REQUIRE(scalar(meta, buffers, uint32_t{}) == 10);
+        CHECK((buffers + 4) % 8 == 0);
+        auto buffer = [&](size_t index) {
+            const int64_t offset = scalar(meta, buffers + 4 + 16 * index, int64_t{});
+            const int64_t length = scalar(meta, buffers + 12 + 16 * index, int64_t{});
+            CHECK(offset % 8 == 0);
+            return batch.body.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+        };
+        const std::string scenarios = buffer(1);
+        REQUIRE(scenarios.size() == 8 * sizeof(int32_t));
+        CHECK(scalar(scenarios, 0, int32_t{}) == 3);
+        CHECK(scalar(scenarios, 28, int32_t{}) == 4);
+        CHECK(buffer(8).empty());                                   // CASH: all valid, no bitmap
+        CHECK(scalar(buffer(9), 8 * 5, double{}) == 402.0);
+
+        // First row group: CASH of scenario 2 period 3 (row 6) is null
+        const auto& first = stream[1].metadata;
+        const size_t nodes = deref(first, field(first, deref(first, field(first, root(stream[1]), 2)), 1));
+        CHECK(scalar(first, nodes + 4 + 16 * 4 + 8, int64_t{}) == 1);   // CASH null_count
+        const int64_t validity = scalar(first, deref(first, field(first, deref(first, field(first, root(stream[1]), 2)), 2))
+                                               + 4 + 16 * 8, int64_t{});
+        CHECK(static_cast<uint8_t>(stream[1].body[static_cast<size_t>(validity)]) == 0xBF);
+    }
+
+    SECTION("Projection and filters") {
+        ArrowResultQuery query;
+        query.line_items = {"CASH"};
+        query.scenario_ids = {5, 2};
+        query.period_ids = {4};
+        size_t rows = 0;
+        std::string bytes;
+        rows = ArrowResultStream::write(reader, query, [&](const std::string& piece) {
+            bytes += piece;
+            return true;
+        });
+        CHECK(rows == 2);
+        const auto stream = messages(bytes);
+        REQUIRE(stream.size() == 3);   // Schema and two of the three row groups
+
+        // The client going away stops the stream
+        size_t pieces = 0;
+        CHECK(ArrowResultStream::write(reader, {}, [&](const std::string&) { return ++pieces < 2; }) == 0);
+        CHECK(pieces == 2);
+
+        query.line_items = {"EBITDA"};
+        CHECK_THROWS_AS(ArrowResultStream::write(reader, query, [&](const std::string&) {
+            FAIL("Nothing is written for an unknown line item");
+            return true;
+        }), std::out_of_range);
+    }
+
+    SECTION("Served from run_output_snapshot") {
+        auto db = DatabaseFactory::create_sqlite(":memory:");
+        db->execute_raw(
+            "CREATE TABLE run_output_snapshot (snapshot_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "  run_id INTEGER NOT NULL, output_type TEXT NOT NULL, json_data TEXT NOT NULL, "
+            "  format TEXT NOT NULL DEFAULT 'json', file_path TEXT, file_size_bytes INTEGER, created_at TEXT);"
+        );
+        const int64_t snapshot = ColumnarResultWriter::record_snapshot(*db, 3, info);
+        web::Server server(0, "127.0.0.1");
+        const std::string route = "/results/" + std::to_string(snapshot);
+        CHECK(server.handle("GET", route).status == 404);   // No results database
+
+        server.set_results([db] { return db; });
+        ArrowResultQuery query;
+        query.line_items = {"CASH", "REVENUE"};
+        query.scenario_ids = {1, 4, 5, 6};
+        query.period_ids = {1, 2};
+        auto response = server.handle("GET", route + "?line_items=CASH%2CREVENUE&scenarios=1,4-6&periods=1-2");
+        REQUIRE(response.status == 200);
+        CHECK(response.content_type == ArrowResultStream::CONTENT_TYPE);
+        CHECK(response.body == ArrowResultStream::to_string(reader, query));
+        CHECK(server.handle("GET", route + "?line_items=EBITDA").status == 400);
+        CHECK(server.handle("GET", route + "?scenarios=4-x").status == 400);
+        CHECK(server.handle("GET", "/results/99").status == 404);
+        CHECK(server.handle("POST", route).status == 405);
+
+        // Over a socket: streamed until the connection closes
+        server.start();
+        const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server.port());
+        ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        const std::string request = "GET " + route + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        REQUIRE(::send(client, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+        std::string reply;
+        char buffer[1024];
+        for (ssize_t n; (n = ::recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+            reply.append(buffer, static_cast<size_t>(n));
+        }
+        ::close(client);
+        server.stop();
+        REQUIRE(reply.rfind("HTTP/1.1 200 OK", 0) == 0);
+        CHECK(reply.find("Content-Length") == std::string::npos);
+        CHECK(reply.substr(reply.find("\r\n\r\n") + 4) == ArrowResultStream::to_string(reader, {}));
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,166 @@
+/**
+ * @file test_batch_run.cpp
+ * @brief Tests for manifest-driven batch runs
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/columnar_results.h"
+#include "orchestration/delta_results.h"
+#include "orchestration/batch_run.h"
+#include "core/numa_topology.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include "test_databases.h"
+#include <cstdio>
+#include <filesystem>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("BatchRunner: Manifest runs go from a snapshot to the output", "[orchestration][batch]") {
+    namespace fs = std::filesystem;
+    const std::string path = "test_batch.db";
+    auto remove_files = [&] {
+        for (const std::string& file : {path, path + "-wal", path + "-shm", std::string("test_batch_inputs.db"),
+                                       std::string("test_batch_E.fmcr"), std::string("test_batch_E.fmdr")}) {
+            std::remove(file.c_str());
+        }
+    };
+    remove_files();
+    {
+        auto db = create_incremental_db(path);
+        std::vector<ParamMap> drivers;
+        for (int scenario = 2; scenario <= 5; ++scenario) {
+            for (int period = 1; period <= 3; ++period) {
+                for (auto [code, value] : {std::pair{"REVENUE", 1000.0 + 10.0 * scenario},
+                                           std::pair{"COSTS", 600.0}, std::pair{"OTHER", 1.0 * scenario}}) {
+                    drivers.push_back({{"scenario", scenario}, {"period", period},
+                                       {"code", std::string(code)}, {"value", value}});
+                }
+            }
+        }
+        db->execute_batch(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', :scenario, :period, :code, :value, 'EUR')", drivers);
+        db->execute_raw(
+            "CREATE TABLE run_log (run_id INTEGER PRIMARY KEY AUTOINCREMENT, scenario_id INTEGER NOT NULL, "
+            "  started_at TEXT NOT NULL DEFAULT (datetime('now')), completed_at TEXT, status TEXT NOT NULL, "
+            "  error_message TEXT, user TEXT, json_config TEXT NOT NULL DEFAULT '{}');"
+            "CREATE TABLE unified_result (run_id INTEGER NOT NULL, entity_id TEXT NOT NULL, "
+            "  scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL, line_item_code TEXT NOT NULL, value REAL);");
+    }
+    auto manifest_json = [&](const std::string& output) {
+        return R"({"database": ")" + path + R"(", "template": "INCREMENTAL_TEST", "entity": "E",
+                   "scenarios": {"first": 1, "count": 5}, "periods": "1-3", "opening": {"CASH": 100},
+                   "validation": {"mode": "final_period"}, "snapshot": "test_batch_inputs.db",
+                   "threads": 2, "jobs_per_chunk": 2, "output": )" + output + "}";
+    };
+
+    SECTION("Manifests are parsed and checked") {
+        const RunManifest manifest = RunManifest::from_json(manifest_json(R"({"type": "none"})"));
+        CHECK(manifest.scenario_ids == std::vector<ScenarioID>{1, 2, 3, 4, 5});
+        CHECK(manifest.period_ids == std::vector<PeriodID>{1, 2, 3});
+        CHECK(manifest.validation.mode == unified::ValidationMode::FINAL_PERIOD);
+        CHECK(manifest.opening_balances.at("CASH") == Approx(100.0));
+        CHECK(RunManifest::parse_ids("1-3,7") == std::vector<int>{1, 2, 3, 7});
+        CHECK_THROWS_AS(RunManifest::parse_ids("1-x"), std::invalid_argument);
+        CHECK_THROWS_AS(RunManifest::from_json(manifest_json(R"({"type": "parquet"})")), std::invalid_argument);
+        CHECK_THROWS_AS(RunManifest::from_json(R"({"database": "a.db", "template": "T",
+            "entities": ["A", "B"], "scenarios": [1], "periods": [1],
+            "output": {"type": "columnar", "path": "out.fmcr"}})"), std::invalid_argument);
+        CHECK_THROWS_AS(RunManifest::load("no_such_manifest.json"), std::invalid_argument);
+
+        unified::ValidationPolicy policy;
+        policy.mode = unified::ValidationMode::SAMPLED;
+        policy.sample_fraction = 0.25;
+        policy.seed = 7;
+        const auto parsed = unified::ValidationPolicy::from_json(policy.to_json());
+        CHECK(parsed.to_json() == policy.to_json());
+        CHECK_THROWS_AS(unified::ValidationPolicy::from_json(R"({"mode": "often"})"), std::invalid_argument);
+    }
+
+    SECTION("Columnar output") {
+        BatchRunner runner(RunManifest::from_json(
+            manifest_json(R"({"type": "columnar", "path": "test_batch_{entity}.fmcr"})")));
+        size_t progress_calls = 0;
+        runner.set_progress([&](const BatchSummary&) { ++progress_calls; });
+        const BatchSummary summary = runner.run();
+        CHECK(summary.runs == 5);
+        CHECK(summary.failed_runs == 0);
+        CHECK(summary.periods == 15);
+        CHECK(summary.line_items == 15 * 8);
+        CHECK(summary.rows_written == 15);
+        CHECK(progress_calls == 3);
+        CHECK(fs::exists("test_batch_inputs.db"));
+        CHECK(summary.report().find("Runs:        5 (0 failed)") != std::string::npos);
+
+        ColumnarResultReader reader("test_batch_E.fmcr");
+        auto cash = reader.read("CASH");
+        REQUIRE(cash.size() == 15);
+        CHECK(cash.scenario_ids[14] == 5);
+        CHECK(cash.values[14] == Approx(100.0 + 3 * 0.75 * 450.0));
+    }
+
+    SECTION("Workers placed by NUMA node") {
+        std::string text = manifest_json(R"({"type": "columnar", "path": "test_batch_{entity}.fmcr"})");
+        text.insert(text.find("\"threads\""), "\"numa\": true, ");
+        const RunManifest manifest = RunManifest::from_json(text);
+        CHECK(manifest.numa);
+        const BatchSummary summary = BatchRunner(manifest).run();
+        CHECK(summary.runs == 5);
+        CHECK(summary.failed_runs == 0);
+        CHECK(summary.numa_nodes == core::NumaTopology::system().node_count());
+
+        ColumnarResultReader reader("test_batch_E.fmcr");
+        auto cash = reader.read("CASH");
+        REQUIRE(cash.size() == 15);
+        CHECK(cash.values[14] == Approx(100.0 + 3 * 0.75 * 450.0));
+        for (size_t node = 1; node < summary.numa_nodes; ++node) {
+            fs::remove("test_batch_inputs.db.node" + std::to_string(node));
+        }
+    }
+
+    SECTION("Delta output") {
+        const BatchSummary summary = BatchRunner(RunManifest::from_json(
+            manifest_json(R"({"type": "delta", "path": "test_batch_{entity}.fmdr"})"))).run();
+        CHECK(summary.rows_written == 15);
+        auto deltas = DeltaResultSet::load("test_batch_E.fmdr");
+        CHECK(deltas.baseline_id() == 1);
+        CHECK(deltas.variant_ids() == std::vector<ScenarioID>{2, 3, 4, 5});
+        CHECK(deltas.value(5, "CASH", 3) == Approx(100.0 + 3 * 0.75 * 450.0));
+        CHECK(deltas.changed_cells(5) < 3 * 8);
+    }
+
+    SECTION("Database output") {
+        const BatchSummary summary = BatchRunner(RunManifest::from_json(manifest_json(R"({"type": "database"})"))).run();
+        CHECK(summary.runs == 5);
+        CHECK(summary.rows_written == 15 * 8);
+        auto db = DatabaseFactory::create_sqlite(path);
+        auto rows = db->execute_query("SELECT COUNT(*) FROM unified_result", {});
+        REQUIRE(rows->next());
+        CHECK(rows->get_int(0) == 15 * 8);
+    }
+
+    SECTION("Database output from an in-memory copy") {
+        RunManifest manifest = RunManifest::from_json(manifest_json(R"({"type": "database"})"));
+        manifest.in_memory = true;
+        const BatchSummary summary = BatchRunner(manifest).run();
+        CHECK(summary.failed_runs == 0);
+        CHECK(summary.rows_written == 15 * 8);
+        CHECK(summary.report().find("Write-back:") != std::string::npos);
+        auto db = DatabaseFactory::create_sqlite(path);
+        auto rows = db->execute_query(
+            "SELECT COUNT(*), COUNT(DISTINCT r.run_id), MIN(l.status) FROM unified_result r "
+            "JOIN run_log l ON l.run_id = r.run_id", {});
+        REQUIRE(rows->next());
+        CHECK(rows->get_int(0) == 15 * 8);
+        CHECK(rows->get_int(1) == 5);
+        CHECK(rows->get_string(2) == "completed");
+    }
+
+    remove_files();
+}
@@ -0,0 +1,189 @@
+/**
+ * @file test_chart_views.cpp
+ * @brief Tests for pre-aggregated chart views of columnar results
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/chart_views.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/scenario_diff.h"
+#include "web/server.h"
+#include "database/database_factory.h"
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using Catch::Approx;
+
+TEST_CASE("ChartViews: Fan charts, downsampled series and years of a sweep", "[orchestration][charts]") {
+    auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"CASH", "REVENUE"});
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // 50 scenarios × 24 monthly periods; CASH = scenario + 1000 × period, missing for scenario 7 in period 5
+    const std::string path = "test_charts.fmcr";
+    ColumnarFileInfo info;
+    {
+        ColumnarResultWriter writer(path, 100);
+        for (ScenarioID scenario = 1; scenario <= 50; ++scenario) {
+            for (PeriodID period = 1; period <= 24; ++period) {
+                const double cash = (scenario == 7 && period == 5) ? nan : scenario + 1000.0 * period;
+                writer.append(scenario, period, unified::ResultRow(schema, {cash, 10.0 * period}));
+            }
+        }
+        info = writer.close();
+    }
+    ColumnarResultReader reader(path);
+
+    SECTION("Quantiles across scenarios per period") {
+        auto fan = ChartViews::fan_chart(reader, "CASH", {0.95, 0.0, 0.5, 1.0});
+        CHECK(fan.quantiles == std::vector<double>{0.0, 0.5, 0.95, 1.0});
+        REQUIRE(fan.period_ids.size() == 24);
+        CHECK(fan.bands[0][0] == 1001.0);
+        CHECK(fan.bands[1][0] == 1025.5);
+        CHECK(fan.bands[2][0] == Approx(1047.55));
+        CHECK(fan.bands[3][23] == 24050.0);
+        CHECK(fan.scenarios[4] == 49);
+        CHECK(fan.scenarios[5] == 50);
+        CHECK_THROWS_AS(ChartViews::fan_chart(reader, "CASH", {1.5}), std::invalid_argument);
+        CHECK_THROWS_AS(ChartViews::fan_chart(reader, "EBITDA", {0.5}), std::out_of_range);
+    }
+
+    SECTION("LTTB keeps the ends and the spikes") {
+        std::vector<double> x(1000);
+        std::vector<double> y(1000);
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = static_cast<double>(i);
+            y[i] = std::sin(static_cast<double>(i) / 50.0);
+        }
+        y[500] = 25.0;
+        const auto kept = ChartViews::lttb(x, y, 40);
+        REQUIRE(kept.size() == 40);
+        CHECK(kept.front() == 0);
+        CHECK(kept.back() == 999);
+        CHECK(std::is_sorted(kept.begin(), kept.end()));
+        CHECK(std::find(kept.begin(), kept.end(), 500) != kept.end());
+        CHECK(ChartViews::lttb(x, y, 2000).size() == 1000);
+
+        auto series = ChartViews::downsample(reader, "CASH", 7, 10);
+        CHECK(series.source_points == 23);   // Period 5 has no value
+        REQUIRE(series.values.size() == 10);
+        CHECK(series.x.front() == 1);
+        CHECK(series.x.back() == 24);
+        CHECK(series.values.back() == 24007.0);
+    }
+
+    SECTION("Periods aggregated per year") {
+        std::unordered_map<PeriodID, int> year_of;
+        for (PeriodID period = 1; period <= 24; ++period) {
+            year_of[period] = 2025 + (period - 1) / 12;
+        }
+        auto sum = ChartViews::yearly(reader, "CASH", 3, year_of, YearAggregate::SUM);
+        CHECK(sum.x == std::vector<int>{2025, 2026});
+        CHECK(sum.values[0] == 12 * 3.0 + 1000.0 * 78);
+        auto last = ChartViews::yearly(reader, "CASH", 3, year_of, year_aggregate_from_string("last"));
+        CHECK(last.values == std::vector<double>{12003.0, 24003.0});
+        auto mean = ChartViews::yearly(reader, "REVENUE", 3, year_of, YearAggregate::MEAN);
+        CHECK(mean.values[1] == 185.0);
+        CHECK_THROWS_AS(year_aggregate_from_string("max"), std::invalid_argument);
+    }
+
+    SECTION("Served as JSON and cached by request") {
+        auto db = DatabaseFactory::create_sqlite(":memory:");
+        db->execute_raw(
+            "CREATE TABLE run_output_snapshot (snapshot_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "  run_id INTEGER NOT NULL, output_type TEXT NOT NULL, json_data TEXT NOT NULL, "
+            "  format TEXT NOT NULL DEFAULT 'json', file_path TEXT, file_size_bytes INTEGER, created_at TEXT);"
+            "CREATE TABLE period (period_id INTEGER PRIMARY KEY, end_date TEXT, fiscal_year INTEGER);"
+        );
+        for (PeriodID period = 1; period <= 24; ++period) {
+            db->execute_update("INSERT INTO period VALUES (:id, :end, NULL)",
+                               {{"id", period}, {"end", std::to_string(2025 + (period - 1) / 12) + "-06-30"}});
+        }
+        const int64_t snapshot = ColumnarResultWriter::record_snapshot(*db, 3, info);
+        web::Server server(0, "127.0.0.1");
+        server.set_results([db] { return db; }, 2);
+        const std::string route = "/results/" + std::to_string(snapshot);
+
+        const auto fan = server.handle("GET", route + "/fan?line_item=CASH&quantiles=0.5");
+        REQUIRE(fan.status == 200);
+        CHECK(fan.content_type == "application/json");
+        CHECK(fan.body.find("\"bands\":[[1025.5,2025.5,") != std::string::npos);
+        CHECK(server.handle("GET", route + "/fan?line_item=CASH&quantiles=0.5").body == fan.body);
+        CHECK(server.chart_cache()->hits() == 1);
+
+        const auto series = server.handle("GET", route + "/series?line_item=CASH&scenario=7&points=5").body;
+        CHECK(series.find("\"source_points\":23") != std::string::npos);
+        CHECK(series.find("\"x\":[1,") != std::string::npos);
+        const auto years = server.handle("GET", route + "/yearly?line_item=CASH&scenario=3&aggregate=last").body;
+        CHECK(years.find("\"values\":[12003.0,24003.0]") != std::string::npos);
+        CHECK(years.find("\"x\":[2025,2026]") != std::string::npos);
+        CHECK(server.chart_cache()->size() == 2);   // The fan chart was evicted
+
+        CHECK(server.handle("GET", route + "/fan").status == 400);
+        CHECK(server.handle("GET", route + "/fan?line_item=CASH&quantiles=2").status == 400);
+        CHECK(server.handle("GET", route + "/series?line_item=CASH").status == 400);
+        CHECK(server.handle("GET", route + "/yearly?line_item=CASH&scenario=3&aggregate=max").status == 400);
+        CHECK(server.handle("GET", route + "/fan?line_item=EBITDA").status == 404);
+        CHECK(server.handle("GET", "/results/99/fan?line_item=CASH").status == 404);
+        CHECK(server.handle("GET", route + "/pie?line_item=CASH").status == 404);
+        CHECK(server.handle("POST", route + "/fan?line_item=CASH").status == 405);
+
+        const auto diff = server.handle("GET", route + "/diff?base=1&scenarios=3,7&line_items=CASH&periods=4-5");
+        REQUIRE(diff.status == 200);
+        CHECK(diff.body.find("\"differences\":[[[2.0,2.0]],[[6.0,null]]]") != std::string::npos);
+        const auto top = server.handle("GET", route + "/diff?base=50&top=1").body;
+        CHECK(top.find("\"differences\"") == std::string::npos);
+        CHECK(top.find("\"top\":[{\"base\":1050.0,\"difference\":-49.0,\"line_item\":\"CASH\",\"period_id\":1,"
+                       "\"scenario_id\":1,") != std::string::npos);
+        CHECK(server.handle("GET", route + "/diff?scenarios=3").status == 400);
+        CHECK(server.handle("GET", route + "/diff?base=1&top=0").status == 400);
+        CHECK(server.handle("GET", route + "/diff?base=99").status == 404);
+        CHECK(server.handle("GET", route + "/diff?base=1&line_items=EBITDA").status == 404);
+    }
+
+    SECTION("Scenarios minus a base, largest deviations first") {
+        ScenarioDiffQuery query;
+        query.base_id = 50;
+        query.top = 3;
+        auto diff = ScenarioDiffer::diff(reader, query);
+        CHECK(diff.scenario_ids.size() == 49);
+        CHECK(diff.line_items == std::vector<std::string>{"CASH", "REVENUE"});
+        CHECK(diff.period_ids.size() == 24);
+        CHECK(diff.base_of(0, 23) == 24050.0);
+        CHECK(diff.difference(0, 0, 0) == -49.0);
+        CHECK(diff.difference(48, 0, 23) == -1.0);
+        CHECK(diff.difference(10, 1, 5) == 0.0);
+        CHECK(std::isnan(diff.difference(6, 0, 4)));
+        REQUIRE(diff.top.size() == 3);
+        for (size_t k = 0; k < 3; ++k) {   // Ties in period order
+            CHECK(diff.top[k].scenario_id == 1);
+            CHECK(diff.top[k].period_id == static_cast<PeriodID>(k + 1));
+            CHECK(diff.top[k].value == 1.0 + 1000.0 * (k + 1));
+            CHECK(diff.top[k].difference == -49.0);
+        }
+
+        query.base_id = 1;
+        query.scenario_ids = {7, 3};
+        query.line_items = {"CASH"};
+        query.period_ids = {5, 4};
+        query.top = 0;
+        diff = ScenarioDiffer::diff(reader, query);
+        CHECK(diff.period_ids == std::vector<PeriodID>{4, 5});
+        CHECK(diff.differences[0] == 6.0);
+        CHECK(std::isnan(diff.differences[1]));
+        CHECK(diff.differences[2] == 2.0);
+        CHECK(diff.top.empty());
+
+        query.scenario_ids = {51};
+        CHECK_THROWS_AS(ScenarioDiffer::diff(reader, query), std::out_of_range);
+        query.scenario_ids.clear();
+        query.line_items = {"EBITDA"};
+        CHECK_THROWS_AS(ScenarioDiffer::diff(reader, query), std::out_of_range);
+    }
+
+    std::remove(path.c_str());
+}
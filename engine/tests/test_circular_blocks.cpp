@@ -0,0 +1,100 @@
+/**
+ * @file test_circular_blocks.cpp
+ * @brief Tests for circular references solved as fixed-point blocks
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("PeriodRunner: Circular blocks solved within each period", "[orchestration][circular]") {
+    auto db = create_runner_db();
+    auto make_template = [](const std::string& code, const std::string& circular) {
+        return core::StatementTemplate::load_from_json(R"json({
+            "template_code": ")json" + code + R"json(",
+            "statement_type": "unified",
+            "version": "1.0",)json" + circular + R"json(
+            "line_items": [
+                {"code": "EBIT", "base_value_source": "driver:EBIT"},
+                {"code": "INTEREST", "formula": "(CASH[t-1] + CASH) / 2 * 0.04"},
+                {"code": "NET", "formula": "EBIT + INTEREST"},
+                {"code": "CASH", "formula": "CASH[t-1] + NET"},
+                {"code": "DIVIDEND", "formula": "NET * 0.5"}
+            ]
+        })json");
+    };
+    make_template("CIRCULAR_ANDERSON", R"json("circular": {"method": "anderson", "tolerance": 1e-12},)json")
+        ->save_to_database(db.get());
+    make_template("CIRCULAR_NEWTON", R"json("circular": {"method": "newton", "tolerance": 1e-12},)json")
+        ->save_to_database(db.get());
+    make_template("CIRCULAR_REJECTED", "")->save_to_database(db.get());
+
+    const std::vector<PeriodID> periods = {1, 2, 3};
+    for (PeriodID period : periods) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'EBIT', :ebit, 'EUR')",
+            {{"period", period}, {"ebit", 100.0 * static_cast<double>(period)}});
+    }
+    BalanceSheet opening;
+    opening.line_items["CASH"] = 1000.0;
+
+    // Interest on average cash: I = r (2 c0 + E) / (2 - r)
+    auto check = [&](const std::string& template_code, size_t max_iterations) {
+        PeriodRunner runner(db);
+        double cash = 1000.0;
+        for (PeriodID period : periods) {
+            auto run = runner.run_periods("E", 1, {period}, opening, template_code);
+            REQUIRE(run.success);
+            const auto& result = run.results.back();
+            const double ebit = 100.0 * static_cast<double>(period);
+            const double interest = 0.04 * (2.0 * cash + ebit) / (2.0 - 0.04);
+            CHECK(result.get_value("INTEREST") == Approx(interest).epsilon(1e-10));
+            CHECK(result.get_value("NET") == Approx(ebit + interest).epsilon(1e-10));
+            CHECK(result.get_value("CASH") == Approx(cash + ebit + interest).epsilon(1e-10));
+            CHECK(result.get_value("DIVIDEND") == Approx((ebit + interest) * 0.5).epsilon(1e-10));
+            CHECK(runner.engine().last_circular_iterations() >= 1);
+            CHECK(runner.engine().last_circular_iterations() <= max_iterations);
+            cash = result.get_value("CASH");
+            opening.line_items["CASH"] = cash;
+        }
+    };
+
+    SECTION("Anderson-accelerated iteration") {
+        check("CIRCULAR_ANDERSON", 8);
+    }
+
+    SECTION("Newton on the Jacobian of the block") {
+        check("CIRCULAR_NEWTON", 3);
+    }
+
+    SECTION("Without a policy the cycle is an error") {
+        PeriodRunner runner(db);
+        auto run = runner.run_periods("E", 1, periods, opening, "CIRCULAR_REJECTED");
+        CHECK_FALSE(run.success);
+    }
+
+    SECTION("Blocks and the policy round-trip through JSON") {
+        auto tmpl = make_template("CIRCULAR_ANDERSON", R"json("circular": {"method": "newton", "depth": 3},)json");
+        tmpl->compute_calculation_order();
+        const auto& blocks = tmpl->get_circular_blocks();
+        REQUIRE(blocks.size() == 1);
+        CHECK(blocks[0].end - blocks[0].begin == 3);
+        CHECK(blocks[0].begin == 1);
+        CHECK(tmpl->get_calculation_order()[4] == "DIVIDEND");
+
+        auto copy = core::StatementTemplate::load_from_json(tmpl->to_json());
+        CHECK(copy->get_circular_policy().enabled);
+        CHECK(copy->get_circular_policy().method == core::CircularPolicy::Method::NEWTON);
+        CHECK(copy->get_circular_policy().depth == 3);
+        CHECK_THROWS(core::StatementTemplate::load_from_json(
+            R"json({"template_code": "X", "circular": {"method": "secant"}, "line_items": []})json"));
+    }
+}
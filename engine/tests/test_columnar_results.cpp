@@ -0,0 +1,199 @@
+/**
+ * @file test_columnar_results.cpp
+ * @brief Tests for columnar result files and float32 result precision
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/batch_run.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/compressed_results.h"
+#include "orchestration/result_precision.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using Catch::Approx;
+
+TEST_CASE("ColumnarResultWriter: Line items read back by column", "[orchestration][columnar]") {
+    const std::string path = "test_results.fmcr";
+    auto schema = std::make_shared<const unified::ResultSchema>(
+        std::vector<std::string>{"REVENUE", "COSTS", "CASH"});
+    auto overlay_schema = std::make_shared<const unified::ResultSchema>(
+        std::vector<std::string>{"REVENUE", "COSTS", "CASH", "SAVINGS"});
+
+    // 40 scenarios × 12 periods in row groups of 100 rows; scenario 39 adds SAVINGS
+    ColumnarFileInfo info;
+    {
+        ColumnarResultWriter writer(path, 100);
+        for (ScenarioID scenario = 0; scenario < 40; ++scenario) {
+            for (PeriodID period = 1; period <= 12; ++period) {
+                const double cash = scenario * 1000.0 + period * 10.0;
+                if (scenario == 39) {
+                    writer.append(scenario, period, unified::ResultRow(overlay_schema, {500.0, 300.0, cash, 7.0}));
+                } else {
+                    writer.append(scenario, period, unified::ResultRow(schema, {500.0, 300.0, cash}));
+                }
+            }
+        }
+        info = writer.close();
+    }
+    CHECK(info.rows == 480);
+    CHECK(info.line_items == 4);
+    CHECK(info.row_groups == 5);
+    // Constant columns take one byte per value
+    CHECK(info.bytes < 480 * 3 * sizeof(double) / 2);
+
+    ColumnarResultReader reader(path);
+    REQUIRE(reader.row_count() == 480);
+    CHECK(reader.line_items() == std::vector<std::string>{"REVENUE", "COSTS", "CASH", "SAVINGS"});
+
+    SECTION("A full column matches what was written") {
+        const uint64_t footer = reader.bytes_read();
+        auto cash = reader.read("CASH");
+        REQUIRE(cash.size() == 480);
+        CHECK(cash.scenario_ids[25] == 2);
+        CHECK(cash.period_ids[25] == 2);
+        CHECK(cash.values[25] == 2020.0);
+        CHECK(cash.values[479] == 39120.0);
+        const uint64_t cash_bytes = reader.bytes_read() - footer;
+        CHECK(cash_bytes < info.bytes - footer);
+
+        // Only the key and REVENUE chunks: REVENUE never changes
+        reader.read("REVENUE");
+        CHECK(reader.bytes_read() - footer - cash_bytes < cash_bytes);
+
+        auto savings = reader.read("SAVINGS");
+        REQUIRE(savings.size() == 480);
+        CHECK(std::isnan(savings.values[0]));
+        CHECK(savings.values[470] == 7.0);
+        CHECK_THROWS_AS(reader.read("MISSING"), std::out_of_range);
+    }
+
+    SECTION("Range reads skip row groups by their statistics") {
+        auto high = reader.read_where("CASH", 38000.0, 1.0e9);
+        REQUIRE(high.size() == 24);
+        CHECK(high.scenario_ids.front() == 38);
+
+        ColumnarResultReader cold(path);
+        const uint64_t footer = cold.bytes_read();
+        cold.read_where("SAVINGS", 0.0, 10.0);
+        const uint64_t one_group = cold.bytes_read() - footer;
+        cold.read("SAVINGS");
+        CHECK(cold.bytes_read() - footer - one_group > 4 * one_group);
+    }
+
+    SECTION("Snapshots reference the file") {
+        auto db = DatabaseFactory::create_sqlite(":memory:");
+        db->execute_raw(
+            "CREATE TABLE run_output_snapshot (snapshot_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "  run_id INTEGER NOT NULL, output_type TEXT NOT NULL, json_data TEXT NOT NULL, "
+            "  format TEXT NOT NULL DEFAULT 'json', file_path TEXT, file_size_bytes INTEGER, created_at TEXT);"
+        );
+        int64_t snapshot = ColumnarResultWriter::record_snapshot(*db, 7, info);
+        auto row = db->execute_query(
+            "SELECT run_id, format, file_path, file_size_bytes, json_extract(json_data, '$.rows') "
+            "FROM run_output_snapshot WHERE snapshot_id = :id", {{"id", static_cast<int>(snapshot)}});
+        for (auto [run_id, format, file, bytes, rows] : row->rows<int, std::string, std::string, int64_t, int>()) {
+            CHECK(run_id == 7);
+            CHECK(format == "columnar");
+            CHECK(file == path);
+            CHECK(static_cast<uint64_t>(bytes) == info.bytes);
+            CHECK(rows == 480);
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ResultPrecision: Non-key line items stored as float32", "[orchestration][columnar][precision]") {
+    const std::string path = "test_results_float32.fmcr";
+    auto schema = std::make_shared<const unified::ResultSchema>(
+        std::vector<std::string>{"REVENUE", "EBITDA", "CASH", "TOTAL_ASSETS"});
+    auto row = [&](size_t scenario, size_t period) {
+        const double x = 1000.0 + 0.1234567 * static_cast<double>(scenario * 100 + period);
+        return std::vector<double>{x * 1.0001, x / 3.0, x * 7.77, x * 11.3};
+    };
+    auto write = [&](const std::string& file, const ResultPrecision& precision) {
+        ColumnarResultWriter writer(file, 256, precision);
+        for (ScenarioID scenario = 0; scenario < 20; ++scenario) {
+            for (PeriodID period = 1; period <= 24; ++period) {
+                writer.append(scenario, period, unified::ResultRow(schema, row(scenario, period)));
+            }
+        }
+        return writer.close();
+    };
+
+    ResultPrecision precision;
+    CHECK_FALSE(precision.is_float32("REVENUE"));
+    precision.float32 = true;
+    CHECK(precision.is_float32("REVENUE"));
+    CHECK_FALSE(precision.is_float32("CASH"));            // Key items stay double
+    CHECK_FALSE(precision.is_float32("TOTAL_EQUITY"));
+    ResultPrecision only = precision;
+    only.float32_items = {"EBITDA", "CASH"};
+    CHECK_FALSE(only.is_float32("REVENUE"));
+    CHECK(only.is_float32("EBITDA"));
+    CHECK_FALSE(only.is_float32("CASH"));
+
+    const auto full = write("test_results_double.fmcr", ResultPrecision{});
+    const auto reduced = write(path, precision);
+    CHECK(reduced.bytes < full.bytes);
+
+    ColumnarResultReader reader(path);
+    CHECK(reader.is_float32("REVENUE"));
+    CHECK_FALSE(reader.is_float32("CASH"));
+    CHECK_FALSE(ColumnarResultReader("test_results_double.fmcr").is_float32("REVENUE"));
+    auto revenue = reader.read("REVENUE");
+    auto cash = reader.read("CASH");
+    REQUIRE(revenue.size() == 480);
+    for (size_t i : {size_t{0}, size_t{199}, size_t{479}}) {
+        const auto expected = row(static_cast<size_t>(revenue.scenario_ids[i]), static_cast<size_t>(revenue.period_ids[i]));
+        CHECK(revenue.values[i] == static_cast<double>(static_cast<float>(expected[0])));
+        CHECK(revenue.values[i] == Approx(expected[0]).epsilon(1e-7));
+        CHECK(cash.values[i] == expected[2]);            // Bit for bit
+    }
+    // Range reads filter on the stored values
+    CHECK(reader.read_where("REVENUE", 0.0, 1.0e9).size() == 480);
+
+    // The in-memory store rounds the same line items
+    std::vector<PeriodID> periods(24);
+    std::iota(periods.begin(), periods.end(), 1);
+    CompressedResultSet dense(periods);
+    CompressedResultSet rounded(periods, precision);
+    for (ScenarioID scenario = 0; scenario < 20; ++scenario) {
+        MultiPeriodResults results;
+        for (PeriodID period : periods) {
+            unified::UnifiedResult result;
+            result.line_items = unified::ResultRow(schema, row(scenario, period));
+            results.results.push_back(std::move(result));
+        }
+        dense.add(scenario, results);
+        rounded.add(scenario, results);
+    }
+    CHECK(rounded.is_float32("EBITDA"));
+    CHECK(rounded.value(3, "EBITDA", 5) == static_cast<double>(static_cast<float>(row(3, 5)[1])));
+    CHECK(rounded.value(3, "TOTAL_ASSETS", 5) == row(3, 5)[3]);
+    CHECK(rounded.bytes() < dense.bytes());
+
+    // Manifest form
+    auto manifest = RunManifest::from_json(R"({"database": "x.db", "template": "T", "entity": "E",
+        "scenarios": "1-2", "periods": "1-3", "precision": {"double": ["EBITDA"]}})");
+    CHECK(manifest.precision.is_float32("REVENUE"));
+    CHECK_FALSE(manifest.precision.is_float32("EBITDA"));
+    CHECK_FALSE(manifest.precision.is_float32("CASH"));
+    CHECK_THROWS_AS(RunManifest::from_json(R"({"database": "x.db", "template": "T", "entity": "E",
+        "scenarios": "1", "periods": "1", "precision": "half"})"), std::invalid_argument);
+
+    std::remove(path.c_str());
+    std::remove("test_results_double.fmcr");
+}
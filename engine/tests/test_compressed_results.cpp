@@ -0,0 +1,95 @@
+/**
+ * @file test_compressed_results.cpp
+ * @brief Tests for the XOR-compressed in-memory result set
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/compressed_results.h"
+#include "core/quantile_sketch.h"
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+
+TEST_CASE("CompressedResultSet: Series round-trip through XOR blocks", "[orchestration][compressed]") {
+    auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"REVENUE", "CASH", "FLAT"});
+    auto overlay_schema = std::make_shared<const unified::ResultSchema>(
+        std::vector<std::string>{"REVENUE", "CASH", "FLAT", "SAVINGS"});
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // 150 monthly periods: three blocks, the last one partial
+    std::vector<PeriodID> periods(150);
+    std::iota(periods.begin(), periods.end(), 1);
+    auto run = [&](double growth, size_t count, bool overlay = false) {
+        MultiPeriodResults results;
+        double cash = 100.0;
+        for (size_t p = 0; p < count; ++p) {
+            const double revenue = 1000.0 * std::pow(1.0 + growth, static_cast<double>(p));
+            cash += revenue * 0.1;
+            std::vector<double> values = {revenue, cash, 42.0};
+            if (overlay) {
+                values.push_back(p == 7 ? nan : -0.0);
+            }
+            unified::UnifiedResult result;
+            result.line_items = unified::ResultRow(overlay ? overlay_schema : schema, std::move(values));
+            results.results.push_back(std::move(result));
+        }
+        return results;
+    };
+
+    CompressedResultSet set(periods);
+    const auto base = run(0.01, periods.size());
+    set.add(1, base);
+    set.add(2, run(0.02, periods.size(), true));
+    auto cancelled = run(0.01, 70);
+    cancelled.add_error("Run cancelled after period 70");
+    set.add(3, cancelled);
+    CHECK_THROWS_AS(set.add(2, cancelled), std::invalid_argument);
+    CHECK(set.scenario_ids() == std::vector<ScenarioID>{1, 2, 3});
+    CHECK(set.line_items() == std::vector<std::string>{"REVENUE", "CASH", "FLAT", "SAVINGS"});
+
+    // Bit for bit, at every block boundary
+    for (size_t p : {size_t{0}, size_t{63}, size_t{64}, size_t{127}, size_t{128}, size_t{149}}) {
+        INFO("period " << periods[p]);
+        CHECK(std::bit_cast<uint64_t>(set.value(1, "REVENUE", periods[p])) ==
+              std::bit_cast<uint64_t>(base.results[p].get_value("REVENUE")));
+        CHECK(set.value(1, "CASH", periods[p]) == base.results[p].get_value("CASH"));
+    }
+    CHECK(std::signbit(set.value(2, "SAVINGS", 1)));
+    CHECK(std::isnan(set.value(2, "SAVINGS", 8)));
+    CHECK(std::isnan(set.value(1, "SAVINGS", 1)));        // Code added after the run
+    CHECK(std::isnan(set.value(3, "CASH", 71)));          // Period the run didn't reach
+    CHECK_THROWS_AS(set.value(9, "CASH", 1), std::out_of_range);
+    CHECK_THROWS_AS(set.value(1, "EBITDA", 1), std::out_of_range);
+    CHECK_THROWS_AS(set.value(1, "CASH", 999), std::out_of_range);
+
+    auto expanded = set.expand(1);
+    REQUIRE(expanded.results.size() == periods.size());
+    for (size_t p = 0; p < periods.size(); ++p) {
+        CHECK(expanded.results[p].get_all_values() == base.results[p].get_all_values());
+    }
+    auto stopped = set.expand(3);
+    CHECK(stopped.results.size() == 70);
+    CHECK_FALSE(stopped.success);
+    CHECK(set.expand(2).results[3].line_items.size() == 4);
+
+    // Streaming aggregation over one line item of every run
+    core::QuantileSketch final_cash;
+    size_t visited = 0;
+    set.scan("CASH", [&](ScenarioID scenario, std::span<const double> series) {
+        REQUIRE(series.size() == periods.size());
+        CHECK(series[69] == set.value(scenario, "CASH", 70));
+        final_cash.add(series.back());
+        ++visited;
+    });
+    CHECK(visited == 3);
+    CHECK(final_cash.count() == 2);   // The cancelled run has no last period
+    CHECK(set.series(2, "FLAT") == std::vector<double>(periods.size(), 42.0));
+
+    // Smooth series: a fraction of 64 bits per value
+    CHECK(set.bytes() * 2 < set.dense_bytes());
+}
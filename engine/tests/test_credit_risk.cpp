@@ -0,0 +1,133 @@
+/**
+ * @file test_credit_risk.cpp
+ * @brief Tests for expected credit loss under scenario factor paths
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "credit/credit_risk_engine.h"
+#include "orchestration/period_runner.h"
+#include "core/low_discrepancy.h"
+#include "core/statement_template.h"
+#include "test_databases.h"
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("CreditRiskEngine: Expected credit loss of a portfolio fed back as drivers", "[orchestration][credit]") {
+    using credit::CreditPosition;
+    // Conditional PD of the one-factor model
+    auto vasicek = [](double pd, double rho, double z) {
+        const double x = (core::normal_quantile(pd) - std::sqrt(rho) * z) / std::sqrt(1.0 - rho);
+        return 0.5 * std::erfc(-x / std::sqrt(2.0));
+    };
+
+    const std::vector<CreditPosition> positions = {
+        {"BANK_B", "CORP", 500.0, 0.6, 0.05, 0.2, -1, false},
+        {"BANK_A", "RETAIL", 1000.0, 0.4, 0.02, 0.15, -1, false},
+        {"BANK_A", "CORP", 200.0, 0.5, 0.10, 0.2, 2, true},
+    };
+    auto portfolio = std::make_shared<const credit::CreditPortfolio>(positions);
+    REQUIRE(portfolio->size() == 3);
+    CHECK(portfolio->entities() == std::vector<EntityID>{"BANK_A", "BANK_B"});
+    CHECK(portfolio->entity_starts() == std::vector<size_t>{0, 2, 3});
+
+    credit::CreditRiskEngine engine(portfolio);
+    credit::CreditFactorPath path;
+    path.period_ids = {1, 2, 3};
+
+    SECTION("Without factors the through-the-cycle PD applies") {
+        const auto losses = engine.calculate(path);
+        CHECK(losses.ecl_of(0, 0) == Approx(1000.0 * 0.02 * 0.4 + 200.0 * 0.10 * 0.5));
+        CHECK(losses.ecl_of(1, 0) == Approx(500.0 * 0.05 * 0.6));
+        // Survivors of period 1 default in period 2; the amortising loan is half repaid
+        CHECK(losses.ecl_of(0, 1) == Approx(0.98 * 1000.0 * 0.02 * 0.4 + 0.9 * 100.0 * 0.10 * 0.5));
+        CHECK(losses.exposure_of(0, 1) == Approx(0.98 * 1000.0 + 0.9 * 100.0));
+        // Matured
+        CHECK(losses.exposure_of(0, 2) == Approx(0.98 * 0.98 * 1000.0));
+    }
+
+    SECTION("Scenario factors by segment") {
+        path.z[""] = {0.5, 0.5, 0.0};
+        path.z["RETAIL"] = {-2.0, std::nan(""), -1.0};
+        path.lgd_scale["CORP"] = {1.2, 1.2, 1.2};
+        const auto losses = engine.calculate(path);
+        const double retail = vasicek(0.02, 0.15, -2.0);
+        CHECK(losses.ecl_of(0, 0) == Approx(1000.0 * retail * 0.4 + 200.0 * vasicek(0.10, 0.2, 0.5) * 0.5 * 1.2));
+        CHECK(losses.ecl_of(1, 0) == Approx(500.0 * vasicek(0.05, 0.2, 0.5) * 0.6 * 1.2));
+        CHECK(retail > 0.02);
+        // Z = 0 is the median economy, below the through-the-cycle PD
+        const double corp = vasicek(0.05, 0.2, 0.5);
+        CHECK(losses.ecl_of(1, 2) == Approx(500.0 * (1.0 - corp) * (1.0 - corp) * vasicek(0.05, 0.2, 0.0) * 0.6 * 1.2));
+        CHECK(vasicek(0.05, 0.2, 0.0) < 0.05);
+        // A missing segment value falls back to the common factor
+        CHECK(path.z_of("RETAIL", 1) == 0.5);
+        CHECK(path.lgd_scale_of("RETAIL", 0) == 1.0);
+
+        // Shards summed in order: the same totals on any number of threads
+        engine.set_parallel(4, 1);
+        const auto parallel = engine.calculate(path);
+        CHECK(parallel.ecl == losses.ecl);
+        CHECK(parallel.exposure == losses.exposure);
+        CHECK_THROWS_AS(engine.set_parallel(2, 0), std::invalid_argument);
+    }
+
+    SECTION("Monthly periods use the period PD") {
+        const credit::CreditPortfolio monthly({positions[1]}, 12);
+        const double period_pd = 1.0 - std::pow(0.98, 1.0 / 12.0);
+        CHECK(0.5 * std::erfc(-monthly.threshold()[0] * std::sqrt(1.0 - 0.15) / std::sqrt(2.0)) == Approx(period_pd));
+    }
+
+    SECTION("Drivers written for the templates") {
+        auto db = create_runner_db(":memory:");
+        std::ifstream migration("../data/migrations/016_credit_risk.sql");
+        REQUIRE(migration);
+        db->execute_raw(std::string(std::istreambuf_iterator<char>(migration), std::istreambuf_iterator<char>()));
+        db->execute_raw(
+            "INSERT INTO credit_exposure (entity_id, segment, ead, lgd, pd, asset_correlation) VALUES "
+            "  ('BANK_A', 'RETAIL', 1000.0, 0.4, 0.02, 0.15);"
+            "INSERT INTO credit_exposure (entity_id, ead, lgd, pd, asset_correlation) VALUES "
+            "  ('BANK_A', 300.0, 0.5, 0.01, NULL);"
+            "INSERT INTO scenario_drivers VALUES ('CREDIT', 1, 1, 'CREDIT_Z_RETAIL', -2.0, ''), "
+            "  ('CREDIT', 1, 1, 'CREDIT_LGD_SCALE', 1.5, ''), ('CREDIT', 1, 2, 'CREDIT_Z', -1.0, ''), "
+            "  ('BANK_A', 1, 1, 'ECL', 999.0, 'EUR');"
+        );
+        auto tmpl = core::StatementTemplate::load_from_json(R"({
+            "template_code": "CREDIT_TEST",
+            "statement_type": "unified",
+            "version": "1.0",
+            "line_items": [
+                {"code": "IMPAIRMENT", "base_value_source": "driver:ECL"},
+                {"code": "LOSS_RATE", "formula": "IMPAIRMENT / driver:CREDIT_EAD"}
+            ]
+        })");
+        tmpl->save_to_database(db.get());
+
+        auto loaded = std::make_shared<const credit::CreditPortfolio>(credit::CreditPortfolio::load(*db));
+        REQUIRE(loaded->size() == 2);
+        CHECK(loaded->segments() == std::vector<std::string>{"RETAIL", "DEFAULT"});
+        credit::CreditRiskEngine bank(loaded);
+        CHECK(bank.process_scenario(*db, 1, {1, 2}) == 4);
+
+        const double ecl_1 = 1.5 * (1000.0 * vasicek(0.02, 0.15, -2.0) * 0.4 + 300.0 * 0.01 * 0.5);
+        BalanceSheet initial_bs;
+        PeriodRunner runner(db);
+        auto run = runner.run_periods("BANK_A", 1, {1, 2}, initial_bs, "CREDIT_TEST");
+        REQUIRE(run.success);
+        CHECK(run.results[0].get_value("IMPAIRMENT") == Approx(ecl_1));   // Replaced, not added to
+        CHECK(run.results[0].get_value("LOSS_RATE") == Approx(ecl_1 / 1300.0));
+        CHECK(run.results[1].get_value("IMPAIRMENT") > 0.0);
+    }
+
+    CHECK_THROWS_AS(credit::CreditPortfolio({{"X", "S", 1.0, 0.5, 1.5}}), std::invalid_argument);
+    CHECK_THROWS_AS(credit::CreditPortfolio(positions, 0), std::invalid_argument);
+}
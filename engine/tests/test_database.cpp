@@ -3,8 +3,25 @@
 #include "database/database_factory.h"
 #include "database/idatabase.h"
 #include "database/result_set.h"
+#include "database/sqlite_database.h"
+#include "database/connection.h"
+#include "database/input_snapshot.h"
+#include "database/async_database.h"
+#include "database/csv_importer.h"
+#include "database/postgresql_database.h"
+#include "core/thread_pool.h"
+#include "core/unit_converter.h"
+#include "web/server.h"
 #include <memory>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <thread>
 
 using namespace finmodel;
 using namespace finmodel::database;
@@ -439,6 +456,40 @@ TEST_CASE("ResultSet type conversions work correctly", "[database][resultset]")
     REQUIRE(result->get_string("text_val") == "123");
 }
 
+TEST_CASE("ResultSet typed rows bind columns by position", "[database][resultset]") {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+
+    db->execute_raw("CREATE TABLE test (code TEXT, value REAL, unit TEXT, big INTEGER)");
+    db->execute_raw("INSERT INTO test VALUES ('REVENUE', 100.5, 'EUR', 5000000000), "
+                    "('COSTS', 40.0, NULL, NULL)");
+
+    auto result = db->execute_query("SELECT code, value, unit, big FROM test ORDER BY value DESC", {});
+    std::vector<std::string> codes;
+    std::vector<std::optional<std::string>> units;
+    double total = 0.0;
+    int64_t big = 0;
+    for (auto [code, value, unit, number] :
+         result->rows<std::string_view, double, std::optional<std::string>, std::optional<int64_t>>()) {
+        codes.emplace_back(code);
+        units.push_back(unit);
+        total += value;
+        big += number.value_or(0);
+    }
+    REQUIRE(codes == std::vector<std::string>{"REVENUE", "COSTS"});
+    REQUIRE(units[0] == "EUR");
+    REQUIRE_FALSE(units[1].has_value());
+    REQUIRE(total == Catch::Approx(140.5));
+    REQUIRE(big == 5000000000LL);
+
+    // Views of NULL text are empty
+    auto nulls = db->execute_query("SELECT unit FROM test WHERE code = 'COSTS'", {});
+    REQUIRE(nulls->next());
+    REQUIRE(nulls->get_text(0).empty());
+
+    auto narrow = db->execute_query("SELECT code FROM test", {});
+    REQUIRE_THROWS_AS((narrow->rows<std::string_view, double>()), DatabaseException);
+}
+
 // ============================================================================
 // Error Handling Tests
 // ============================================================================
@@ -513,3 +564,790 @@ TEST_CASE("describe_table returns correct columns", "[database][metadata]") {
     REQUIRE(columns[1] == "name");
     REQUIRE(columns[2] == "value");
 }
+
+// ============================================================================
+// Prepared Statement Cache Tests
+// ============================================================================
+
+TEST_CASE("Repeated SQL reuses cached prepared statements", "[database][statements]") {
+    auto db = std::make_shared<SQLiteDatabase>();
+    db->connect(":memory:");
+    db->execute_raw("CREATE TABLE test (id INTEGER, value TEXT)");
+    auto before = db->statement_cache_stats();
+
+    for (int i = 0; i < 10; ++i) {
+        db->execute_update("INSERT INTO test (id, value) VALUES (:id, :value)",
+                           {{"id", i}, {"value", std::string("v") + std::to_string(i)}});
+    }
+    auto after = db->statement_cache_stats();
+    REQUIRE(after.misses == before.misses + 1);
+    REQUIRE(after.hits == before.hits + 9);
+
+    SECTION("Reused statements are rebound") {
+        for (int id : {3, 7}) {
+            auto result = db->execute_query("SELECT value FROM test WHERE id = :id", {{"id", id}});
+            REQUIRE(result->next());
+            REQUIRE(result->get_string(0) == "v" + std::to_string(id));
+        }
+        // Bindings don't leak into the next execution
+        db->execute_update("INSERT INTO test (id, value) VALUES (:id, :value)", {{"id", 20}});
+        auto result = db->execute_query("SELECT value FROM test WHERE id = :id", {{"id", 20}});
+        REQUIRE(result->next());
+        REQUIRE(result->is_null(0));
+    }
+
+    SECTION("Same SQL while its results are still open") {
+        const std::string sql = "SELECT id FROM test WHERE id < :limit ORDER BY id";
+        auto outer = db->execute_query(sql, {{"limit", 3}});
+        int rows = 0;
+        while (outer->next()) {
+            auto inner = db->execute_query(sql, {{"limit", 5}});
+            int inner_rows = 0;
+            while (inner->next()) {
+                ++inner_rows;
+            }
+            REQUIRE(inner_rows == 5);
+            REQUIRE(outer->get_int(0) == rows++);
+        }
+        REQUIRE(rows == 3);
+    }
+
+    SECTION("Capacity limits cached statements") {
+        db->set_statement_cache_capacity(2);
+        db->execute_query("SELECT 1", {});
+        db->execute_query("SELECT 2", {});
+        db->execute_query("SELECT 3", {});
+        REQUIRE(db->statement_cache_stats().size == 2);
+
+        db->set_statement_cache_capacity(0);
+        auto misses = db->statement_cache_stats().misses;
+        db->execute_query("SELECT 1", {});
+        db->execute_query("SELECT 1", {});
+        REQUIRE(db->statement_cache_stats().size == 0);
+        REQUIRE(db->statement_cache_stats().misses == misses + 2);
+    }
+
+    SECTION("Open results outlive disconnect") {
+        auto result = db->execute_query("SELECT id FROM test ORDER BY id", {});
+        REQUIRE(result->next());
+        db->disconnect();
+        REQUIRE(db->statement_cache_stats().size == 0);
+        result.reset();
+    }
+}
+
+TEST_CASE("PreparedStatement re-executes one cached statement", "[database][statements]") {
+    auto db = std::make_shared<SQLiteDatabase>();
+    db->connect(":memory:");
+    db->execute_raw("CREATE TABLE test (id INTEGER, value REAL)");
+    db->execute_raw("INSERT INTO test VALUES (1, 1.5), (2, 2.5)");
+
+    DatabaseConnection connection(db);
+    auto stmt = connection.prepare("SELECT value FROM test WHERE id = ?");
+    auto before = db->statement_cache_stats();
+    for (int id : {1, 2, 1}) {
+        stmt.reset();
+        stmt.bind(1, id);
+        REQUIRE(stmt.step());
+        REQUIRE(stmt.column_double(0) == Catch::Approx(id + 0.5));
+    }
+    REQUIRE(db->statement_cache_stats().misses == before.misses + 1);
+    REQUIRE(db->statement_cache_stats().hits == before.hits + 2);
+}
+
+TEST_CASE("execute_batch writes all rows with one statement", "[database][statements]") {
+    auto db = std::make_shared<SQLiteDatabase>();
+    db->connect(":memory:");
+    db->execute_raw("CREATE TABLE test (id INTEGER NOT NULL, value REAL)");
+
+    std::vector<ParamMap> rows;
+    for (int i = 0; i < 1000; ++i) {
+        rows.push_back({{"id", i}, {"value", i * 0.5}});
+    }
+    rows.push_back({{"id", 1000}});  // Different names: value binds as NULL
+
+    auto before = db->statement_cache_stats();
+    REQUIRE(db->execute_batch("INSERT INTO test (id, value) VALUES (:id, :value)", rows) == 1001);
+    REQUIRE(db->statement_cache_stats().misses == before.misses + 1);
+    REQUIRE_FALSE(db->in_transaction());
+
+    auto result = db->execute_query("SELECT COUNT(*), SUM(value), COUNT(value) FROM test", {});
+    REQUIRE(result->next());
+    REQUIRE(result->get_int(0) == 1001);
+    REQUIRE(result->get_double(1) == Catch::Approx(999 * 1000 / 2 * 0.5));
+    REQUIRE(result->get_int(2) == 1000);
+
+    SECTION("A failing row rolls back the whole batch") {
+        std::vector<ParamMap> bad = {{{"id", 2000}}, {{"id", nullptr}}};
+        REQUIRE_THROWS_AS(db->execute_batch("INSERT INTO test (id) VALUES (:id)", bad), DatabaseException);
+        REQUIRE_FALSE(db->in_transaction());
+        auto count = db->execute_query("SELECT COUNT(*) FROM test WHERE id = 2000", {});
+        REQUIRE(count->next());
+        REQUIRE(count->get_int(0) == 0);
+    }
+
+    SECTION("Joins the caller's transaction") {
+        db->begin_transaction();
+        std::vector<ParamMap> more = {{{"id", 3000}}};
+        db->execute_batch("INSERT INTO test (id) VALUES (:id)", more);
+        REQUIRE(db->in_transaction());
+        db->rollback();
+        auto count = db->execute_query("SELECT COUNT(*) FROM test WHERE id = 3000", {});
+        REQUIRE(count->next());
+        REQUIRE(count->get_int(0) == 0);
+    }
+}
+
+TEST_CASE("ConnectionPool gives each thread its own read connection", "[database][pool]") {
+    const std::string path = "test_pool.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        pool.writer()->execute_raw("CREATE TABLE test (id INTEGER)");
+        std::vector<ParamMap> rows;
+        for (int i = 0; i < 100; ++i) {
+            rows.push_back({{"id", i}});
+        }
+        pool.writer()->execute_batch("INSERT INTO test (id) VALUES (:id)", rows);
+
+        auto mine = pool.reader();
+        REQUIRE(pool.reader() == mine);
+        REQUIRE(mine != pool.writer());
+        REQUIRE_THROWS_AS(mine->execute_update("INSERT INTO test (id) VALUES (1)", {}), DatabaseException);
+
+        std::vector<int> counts(4, 0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < counts.size(); ++t) {
+            threads.emplace_back([&pool, &counts, t] {
+                auto result = pool.reader()->execute_query("SELECT COUNT(*) FROM test", {});
+                if (result->next()) {
+                    counts[t] = result->get_int(0);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(counts == std::vector<int>(4, 100));
+        REQUIRE(pool.reader_count() == 5);
+
+        pool.close_readers();
+        REQUIRE(pool.reader_count() == 0);
+    }
+    remove_files();
+
+    // In-memory databases exist per connection: readers share the writer
+    ConnectionPool memory(":memory:");
+    REQUIRE(memory.shared_reader());
+    REQUIRE(memory.reader() == memory.writer());
+}
+
+TEST_CASE("InputSnapshot copies a run's inputs into a read-only file", "[database][snapshot]") {
+    const std::string source_path = "test_snapshot_source.db";
+    const std::string snapshot_path = "test_snapshot.db";
+    auto remove_files = [&] {
+        for (const auto& path : {source_path, snapshot_path}) {
+            std::remove(path.c_str());
+            std::remove((path + "-wal").c_str());
+            std::remove((path + "-shm").c_str());
+        }
+    };
+    remove_files();
+    {
+        auto source = DatabaseFactory::create_sqlite(source_path);
+        source->execute_raw(
+            "CREATE TABLE scenario (scenario_id INTEGER PRIMARY KEY, code TEXT, parent_scenario_id INTEGER);"
+            "CREATE TABLE scenario_drivers (entity_id TEXT, scenario_id INTEGER, period_id INTEGER, "
+            "  driver_code TEXT, value REAL, unit_code TEXT);"
+            "CREATE INDEX idx_drivers ON scenario_drivers(scenario_id, period_id);"
+            "CREATE TABLE fx_rate (scenario_id INTEGER, from_currency TEXT, to_currency TEXT, rate REAL);"
+            "CREATE VIEW v_fx_rates AS SELECT * FROM fx_rate;"
+            "CREATE TABLE pl_result (pl_result_id INTEGER PRIMARY KEY, value REAL);"
+            "INSERT INTO scenario VALUES (1, 'BASE', NULL), (2, 'OTHER', NULL), (3, 'CHILD', 1);"
+            "INSERT INTO scenario_drivers VALUES ('E', 1, 1, 'REVENUE', 100.0, 'EUR'), "
+            "  ('E', 2, 1, 'REVENUE', 200.0, 'EUR'), ('E', 3, 1, 'COSTS', 50.0, 'EUR');"
+            "INSERT INTO fx_rate VALUES (NULL, 'USD', 'EUR', 0.9), (2, 'USD', 'EUR', 0.8);"
+            "INSERT INTO pl_result VALUES (1, 1.0);"
+        );
+    }
+
+    auto info = InputSnapshot::compile(source_path, snapshot_path, {3});
+    REQUIRE(info.format_version == InputSnapshot::FORMAT_VERSION);
+    REQUIRE(info.tables == std::vector<std::string>{"scenario", "scenario_drivers", "fx_rate"});
+    REQUIRE(info.scenario_ids == std::vector<ScenarioID>{1, 3});
+    REQUIRE(info.rows == 2 + 2 + 1);
+
+    auto db = InputSnapshot::open(snapshot_path);
+    auto drivers = db->execute_query(
+        "SELECT scenario_id, driver_code FROM scenario_drivers ORDER BY scenario_id", {});
+    std::vector<std::string> codes;
+    for (auto [scenario_id, code] : drivers->rows<int, std::string>()) {
+        codes.push_back(std::to_string(scenario_id) + ":" + code);
+    }
+    REQUIRE(codes == std::vector<std::string>{"1:REVENUE", "3:COSTS"});
+
+    // Scenario-free rows, views and indexes come along; outputs don't
+    auto rates = db->execute_query("SELECT COUNT(*) FROM v_fx_rates", {});
+    REQUIRE(rates->next());
+    REQUIRE(rates->get_int(0) == 1);
+    auto tables = db->list_tables();
+    REQUIRE(std::find(tables.begin(), tables.end(), "scenario_drivers") != tables.end());
+    REQUIRE(std::find(tables.begin(), tables.end(), "pl_result") == tables.end());
+    auto index = db->execute_query("SELECT COUNT(*) FROM sqlite_master WHERE name = 'idx_drivers'", {});
+    REQUIRE(index->next());
+    REQUIRE(index->get_int(0) == 1);
+
+    REQUIRE_THROWS_AS(db->execute_update("DELETE FROM scenario_drivers", {}), DatabaseException);
+    REQUIRE_THROWS_AS(InputSnapshot::open(source_path), DatabaseException);
+
+    rates.reset();
+    index.reset();
+    db.reset();
+    remove_files();
+}
+
+TEST_CASE("Working copies run in memory and write new rows back once", "[database][working_copy]") {
+    const std::string path = "test_working_copy.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    auto count = [](IDatabase& db, const std::string& table) {
+        auto result = db.execute_query("SELECT COUNT(*) FROM " + table, {});
+        return result->next() ? result->get_int(0) : -1;
+    };
+    remove_files();
+    auto disk = DatabaseFactory::create_sqlite(path);
+    disk->execute_raw(
+        "CREATE TABLE run_log (run_id INTEGER PRIMARY KEY AUTOINCREMENT, status TEXT);"
+        "CREATE TABLE unified_result (run_id INTEGER, line_item_code TEXT, value REAL);"
+        "CREATE TABLE scenario_drivers (driver_code TEXT, value REAL);"
+        "INSERT INTO run_log (status) VALUES ('completed');"
+        "INSERT INTO unified_result VALUES (1, 'NET', 1.0);"
+        "INSERT INTO scenario_drivers VALUES ('REVENUE', 100.0);");
+
+    WorkingCopyOptions options;
+    options.write_back = {"run_log", "unified_result"};
+    options.shared_name = "test_working_copy";
+    auto copy = DatabaseFactory::create_working_copy(path, options);
+    REQUIRE(count(*copy, "scenario_drivers") == 1);
+
+    // Every connection to the URI shares the copy
+    auto worker = DatabaseFactory::create_sqlite(options.uri());
+    worker->execute_raw(
+        "INSERT INTO run_log (status) VALUES ('completed');"
+        "INSERT INTO unified_result VALUES (2, 'NET', 2.0), (2, 'CASH', 3.0);"
+        "INSERT INTO scenario_drivers VALUES ('COSTS', 60.0);"
+        "UPDATE run_log SET status = 'archived' WHERE run_id = 1;");
+    REQUIRE(count(*disk, "unified_result") == 1);
+
+    REQUIRE(copy->flush() == 3);
+    REQUIRE(count(*disk, "run_log") == 2);
+    REQUIRE(count(*disk, "unified_result") == 3);
+    REQUIRE(count(*disk, "scenario_drivers") == 1);   // Not written back
+    auto status = disk->execute_query("SELECT status FROM run_log WHERE run_id = 1", {});
+    REQUIRE(status->next());
+    REQUIRE(status->get_string(0) == "completed");    // Updates of copied rows stay in memory
+    status.reset();
+    REQUIRE(copy->flush() == 0);
+
+    SECTION("A conflicting row fails the whole flush") {
+        disk->execute_raw("INSERT INTO run_log (status) VALUES ('other');");
+        worker->execute_raw(
+            "INSERT INTO unified_result VALUES (3, 'NET', 4.0);"
+            "INSERT INTO run_log (status) VALUES ('completed');");
+        REQUIRE_THROWS_AS(copy->flush(), DatabaseException);
+        REQUIRE(count(*disk, "unified_result") == 3);
+        REQUIRE_FALSE(copy->in_transaction());
+    }
+
+    SECTION("Outputs a snapshot doesn't have are created as in the target") {
+        const std::string inputs = "test_working_copy_inputs.db";
+        std::remove(inputs.c_str());
+        DatabaseFactory::create_sqlite(inputs)->execute_raw("CREATE TABLE scenario_drivers (driver_code TEXT, value REAL);");
+        options.target = path;
+        options.shared_name.clear();
+        auto from_inputs = DatabaseFactory::create_working_copy(inputs, options);
+        REQUIRE(count(*from_inputs, "run_log") == 0);
+        from_inputs->execute_raw("INSERT INTO run_log (status) VALUES ('completed');");
+        REQUIRE(from_inputs->last_insert_id() == 3);
+        REQUIRE(from_inputs->flush() == 1);
+        REQUIRE(count(*disk, "run_log") == 3);
+        from_inputs.reset();
+        for (const std::string& file : {inputs, inputs + "-wal", inputs + "-shm"}) {
+            std::remove(file.c_str());
+        }
+    }
+
+    SECTION("From a config, into another target") {
+        const std::string target = "test_working_copy_target.db";
+        std::remove(target.c_str());
+        auto out = DatabaseFactory::create_sqlite(target);
+        out->execute_raw("CREATE TABLE unified_result (run_id INTEGER, line_item_code TEXT, value REAL);");
+        DatabaseConfig config{"sqlite", path, {{"working_copy", "1"}, {"write_back", "unified_result"},
+                                               {"target", target}}};
+        auto configured = DatabaseFactory::create(config);
+        configured->execute_raw("INSERT INTO unified_result VALUES (4, 'NET', 5.0);");
+        REQUIRE(configured->flush() == 1);
+        REQUIRE(count(*out, "unified_result") == 1);
+        REQUIRE(DatabaseFactory::create_sqlite(":memory:")->flush() == 0);
+        out.reset();
+        std::remove(target.c_str());
+    }
+
+    REQUIRE_THROWS_AS(DatabaseFactory::create_working_copy("no_such_dir/missing.db", options), DatabaseException);
+    worker.reset();
+    copy.reset();
+    disk.reset();
+    remove_files();
+}
+
+TEST_CASE("BulkLoadSession defers indexes and restores the connection", "[database][bulk]") {
+    const std::string path = "test_bulk_load.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    auto pragma = [](IDatabase& db, const std::string& name) {
+        auto result = db.execute_query("PRAGMA " + name, {});
+        return result->next() ? result->get_int64(0) : -1;
+    };
+    auto has_index = [](IDatabase& db, const std::string& name) {
+        auto result = db.execute_query("SELECT 1 FROM sqlite_master WHERE type = 'index' AND name = :name",
+                                       {{"name", name}});
+        return result->next();
+    };
+    remove_files();
+    {
+        SQLiteDatabase db;
+        db.connect(path);
+        db.execute_raw(
+            "CREATE TABLE loaded (id INTEGER PRIMARY KEY, code TEXT UNIQUE, value REAL);"
+            "CREATE INDEX idx_loaded_value ON loaded(value);");
+        const int64_t synchronous = pragma(db, "synchronous");
+        const int64_t cache_size = pragma(db, "cache_size");
+        const int64_t autocheckpoint = pragma(db, "wal_autocheckpoint");
+
+        SECTION("Settings and indexes come back, and the table is analyzed") {
+            BulkLoadOptions options;
+            options.tables = {"loaded"};
+            options.drop_indexes = true;
+            BulkLoadSession bulk(db, options);
+            CHECK(pragma(db, "synchronous") == 0);
+            CHECK(pragma(db, "cache_size") == -options.cache_size_kib);
+            CHECK(pragma(db, "wal_autocheckpoint") == options.wal_autocheckpoint);
+            CHECK(bulk.dropped_indexes() == std::vector<std::string>{"idx_loaded_value"});
+            CHECK_FALSE(has_index(db, "idx_loaded_value"));
+
+            std::vector<ParamMap> rows;
+            for (int i = 0; i < 500; ++i) {
+                rows.push_back({{"code", std::string("C").append(std::to_string(i))}, {"value", i * 0.5}});
+            }
+            db.begin_transaction();
+            db.execute_batch("INSERT INTO loaded (code, value) VALUES (:code, :value)", rows);
+            // UNIQUE constraints stay while loading
+            CHECK_THROWS_AS(db.execute_update("INSERT INTO loaded (code, value) VALUES ('C1', 0)", {}),
+                            DatabaseException);
+            db.commit();
+            bulk.finish();
+
+            CHECK(has_index(db, "idx_loaded_value"));
+            CHECK(pragma(db, "synchronous") == synchronous);
+            CHECK(pragma(db, "cache_size") == cache_size);
+            CHECK(pragma(db, "wal_autocheckpoint") == autocheckpoint);
+            auto stats = db.execute_query("SELECT COUNT(*) FROM sqlite_stat1 WHERE tbl = 'loaded'", {});
+            REQUIRE(stats->next());
+            CHECK(stats->get_int(0) > 0);
+            auto found = db.execute_query("SELECT COUNT(*) FROM loaded INDEXED BY idx_loaded_value "
+                                          "WHERE value >= 100", {});
+            REQUIRE(found->next());
+            CHECK(found->get_int(0) == 300);
+        }
+
+        SECTION("Leaving the scope finishes the session") {
+            {
+                BulkLoadOptions options;
+                options.tables = {"loaded"};
+                options.drop_indexes = true;
+                BulkLoadSession bulk(db, options);
+                CHECK_FALSE(has_index(db, "idx_loaded_value"));
+            }
+            CHECK(has_index(db, "idx_loaded_value"));
+            CHECK(pragma(db, "synchronous") == synchronous);
+        }
+
+        SECTION("Not inside a transaction") {
+            db.begin_transaction();
+            CHECK_THROWS_AS(BulkLoadSession(db), DatabaseException);
+            db.rollback();
+        }
+        db.disconnect();
+    }
+    remove_files();
+}
+
+TEST_CASE("PostgreSQL statements use positional parameters and COPY", "[database][postgresql]") {
+    SECTION("Named parameters become $n once per name") {
+        auto positional = PostgreSQLDatabase::to_positional(
+            "SELECT value::text, ':skip', \"col:umn\" FROM t -- :comment\n"
+            "WHERE a = :a AND b = :b AND c = :a AND body = $$ :quoted $$ /* :block */");
+        CHECK(positional.sql ==
+              "SELECT value::text, ':skip', \"col:umn\" FROM t -- :comment\n"
+              "WHERE a = $1 AND b = $2 AND c = $1 AND body = $$ :quoted $$ /* :block */");
+        CHECK(positional.parameters == std::vector<std::string>{"a", "b"});
+    }
+
+    SECTION("Plain INSERTs are COPY targets") {
+        auto target = PostgreSQLDatabase::copy_target(
+            "INSERT INTO unified_result (run_id, entity_id, value) VALUES (:run_id, :entity, :value)");
+        REQUIRE(target);
+        CHECK(target->table == "unified_result");
+        CHECK(target->columns == std::vector<std::string>{"run_id", "entity_id", "value"});
+        CHECK(target->parameters == std::vector<std::string>{"run_id", "entity", "value"});
+
+        CHECK(PostgreSQLDatabase::copy_target("insert into public.\"Results\" (a) values (:a);"));
+        CHECK_FALSE(PostgreSQLDatabase::copy_target("INSERT INTO t (a, b) VALUES (:a, 1)"));
+        CHECK_FALSE(PostgreSQLDatabase::copy_target("INSERT INTO t (a) VALUES (:a) ON CONFLICT DO NOTHING"));
+        CHECK_FALSE(PostgreSQLDatabase::copy_target("UPDATE t SET a = :a"));
+    }
+
+    SECTION("Without the backend built the factory refuses it") {
+        CHECK(DatabaseFactory::is_postgresql("postgresql://db/finmodel"));
+        CHECK_FALSE(DatabaseFactory::is_postgresql("finmodel.db"));
+#if !FINMODEL_POSTGRESQL
+        CHECK_THROWS_AS(DatabaseFactory::create({"postgresql", "postgresql://localhost/finmodel", {}}),
+                        DatabaseException);
+#endif
+    }
+
+#if FINMODEL_POSTGRESQL
+    // Against a server when FINMODEL_TEST_POSTGRESQL holds its connection string
+    if (const char* url = std::getenv("FINMODEL_TEST_POSTGRESQL")) {
+        SECTION("Batches written with COPY read back") {
+            auto db = DatabaseFactory::create_postgresql(url);
+            db->execute_raw(
+                "DROP TABLE IF EXISTS finmodel_copy_test;"
+                "CREATE TABLE finmodel_copy_test (id BIGSERIAL PRIMARY KEY, code TEXT, n INTEGER, "
+                "  value DOUBLE PRECISION, payload BYTEA, created TIMESTAMP DEFAULT now())");
+            std::vector<ParamMap> rows;
+            for (int i = 0; i < 1000; ++i) {
+                ParamMap row{{"code", std::string("C").append(std::to_string(i))}, {"n", i}, {"value", i / 8.0},
+                             {"payload", Blob{static_cast<std::uint8_t>(i % 256), 0, 255}}};
+                if (i % 100 == 0) {
+                    row["value"] = nullptr;
+                }
+                rows.push_back(std::move(row));
+            }
+            CHECK(db->execute_batch("INSERT INTO finmodel_copy_test (code, n, value, payload) "
+                                    "VALUES (:code, :n, :value, :payload)", rows) == 1000);
+            // A timestamp column isn't COPY-encoded: prepared per row
+            CHECK(db->execute_batch("INSERT INTO finmodel_copy_test (code, created) VALUES (:code, :created)",
+                                    std::vector<ParamMap>{{{"code", "T"}, {"created", "2026-01-01 00:00:00"}}}) == 1);
+            CHECK(db->last_insert_id() == 1001);
+
+            auto result = db->execute_query(
+                "SELECT code, n, value, payload FROM finmodel_copy_test WHERE n = :n OR n = :m ORDER BY n",
+                {{"n", 100}, {"m", 257}});
+            REQUIRE(result->next());
+            CHECK(result->get_string(0) == "C100");
+            CHECK(result->is_null(2));
+            REQUIRE(result->next());
+            CHECK(result->get_double("value") == Catch::Approx(257 / 8.0));
+            auto payload = result->get_blob(3);
+            CHECK(std::vector<std::uint8_t>(payload.begin(), payload.end()) == std::vector<std::uint8_t>{1, 0, 255});
+            CHECK_FALSE(result->next());
+            db->execute_raw("DROP TABLE finmodel_copy_test");
+        }
+    }
+#endif
+}
+
+namespace {
+
+AsyncResult<double> async_total(AsyncDatabase& db, int group) {
+    ParamMap params;
+    params["grp"] = group;
+    auto rows = co_await db.query<double>("SELECT value FROM async_values WHERE grp = :grp", std::move(params));
+    double total = 0.0;
+    for (auto [value] : rows) {
+        total += value;
+    }
+    co_return total;
+}
+
+AsyncResult<std::string> async_failure(AsyncDatabase& db) {
+    try {
+        co_await db.update("INSERT INTO no_such_table VALUES (1)");
+    } catch (const DatabaseException&) {
+        co_return std::string("caught");
+    }
+    co_return std::string("not caught");
+}
+
+} // namespace
+
+TEST_CASE("AsyncDatabase runs queries on executors for coroutines", "[database][async]") {
+    const std::string path = "test_async_database.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        pool.writer()->execute_raw("CREATE TABLE async_values (grp INTEGER, value REAL)");
+        std::vector<ParamMap> rows;
+        for (int i = 0; i < 100; ++i) {
+            rows.push_back({{"grp", i % 4}, {"value", static_cast<double>(i)}});
+        }
+        pool.writer()->execute_batch("INSERT INTO async_values (grp, value) VALUES (:grp, :value)", rows);
+
+        AsyncDatabase db([&pool] { return pool.reader(); }, 3);
+        CHECK(db.executors() == 3);
+
+        SECTION("Coroutines in flight together") {
+            std::vector<AsyncResult<double>> totals;
+            for (int group = 0; group < 4; ++group) {
+                totals.push_back(async_total(db, group));
+            }
+            for (int group = 0; group < 4; ++group) {
+                double expected = 0.0;
+                for (int i = group; i < 100; i += 4) {
+                    expected += i;
+                }
+                CHECK(totals[group].get() == Catch::Approx(expected));
+            }
+            CHECK(pool.reader_count() <= 3);
+        }
+
+        SECTION("Typed rows and run() without a coroutine") {
+            auto counts = db.query<int, int>("SELECT grp, COUNT(*) FROM async_values GROUP BY grp ORDER BY grp");
+            auto tables = db.run([](IDatabase& connection) { return connection.list_tables(); });
+            const auto grouped = counts.get();
+            REQUIRE(grouped.size() == 4);
+            CHECK(std::get<1>(grouped[2]) == 25);
+            CHECK(tables.get() == std::vector<std::string>{"async_values"});
+        }
+
+        SECTION("Errors reach the awaiting coroutine or get()") {
+            CHECK(async_failure(db).get() == "caught");
+            auto failed = db.query<int>("SELECT * FROM no_such_table");
+            CHECK_THROWS_AS(failed.get(), DatabaseException);
+
+            AsyncDatabase unreachable([]() -> std::shared_ptr<IDatabase> {
+                throw DatabaseException("unreachable");
+            });
+            CHECK_THROWS_AS(unreachable.update("DELETE FROM async_values").get(), DatabaseException);
+        }
+    }
+    remove_files();
+}
+
+TEST_CASE("CsvImporter loads staging tables in parallel chunks", "[database][csv]") {
+    std::shared_ptr<IDatabase> db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "INSERT INTO unit_definition VALUES "
+        "  ('EUR', 'Euro', 'CURRENCY', 'STATIC', 1.0, 'EUR', 'EUR', '', 1), "
+        "  ('kEUR', 'Thousand euro', 'CURRENCY', 'STATIC', 1000.0, 'EUR', 'kEUR', '', 1), "
+        "  ('USD', 'Dollar', 'CURRENCY', 'TIME_VARYING', NULL, 'EUR', '$', '', 1);");
+    core::UnitConverter units(db);
+
+    // Quoted delimiters, quotes and line breaks, CRLF lines, blanks and empty lines
+    std::mt19937 rng(92);
+    std::vector<std::vector<std::string>> expected;
+    std::string text = "\xEF\xBB\xBF" "code, \"note\" ,value\r\n";
+    for (int i = 0; i < 5000; ++i) {
+        const std::string code = std::string("E").append(std::to_string(i));
+        std::string note;
+        std::string cell;
+        switch (rng() % 5) {
+            case 0: note = "plain"; cell = "  plain "; break;
+            case 1: note = "a, b"; cell = "\"a, b\""; break;
+            case 2: note = "say \"hi\""; cell = "\"say \"\"hi\"\"\""; break;
+            case 3: note = "two\nlines"; cell = "\"two\nlines\""; break;
+            default: note = ""; cell = ""; break;
+        }
+        const double value = static_cast<int>(rng() % 100000) / 8.0;
+        std::string value_cell = std::to_string(value);
+        if (i % 97 == 0) {
+            value_cell = "";
+        }
+        expected.push_back({code, note, value_cell});
+        text += code + "," + cell + "," + value_cell + ((i % 3 == 0) ? "\r\n" : "\n");
+        if (i % 250 == 0) {
+            text += "\n";
+        }
+    }
+
+    auto records = CsvImporter::parse(text);
+    REQUIRE(records.size() == expected.size() + 1);
+    REQUIRE(records[0] == std::vector<std::string>{"code", "note", "value"});
+    for (size_t r = 0; r < expected.size(); ++r) {
+        REQUIRE(records[r + 1] == expected[r]);
+    }
+
+    auto load = [&](core::ThreadPool* pool, size_t chunk_bytes) {
+        CsvImportOptions options;
+        options.pool = pool;
+        options.chunk_bytes = chunk_bytes;
+        options.numeric_columns = {{"value", "kEUR"}};
+        options.units = &units;
+        return CsvImporter::import_text(*db, text, "staging_scenario_1", options);
+    };
+    auto check = [&](const CsvImportResult& result) {
+        REQUIRE(result.columns == std::vector<std::string>{"code", "note", "value"});
+        REQUIRE(result.rows == expected.size());
+        auto rows = db->execute_query(
+            "SELECT code, note, value, is_mapped FROM staging_scenario_1 ORDER BY _rowid", {});
+        size_t r = 0;
+        for (auto [code, note, value, mapped] : rows->rows<std::string, std::string, std::optional<double>, int>()) {
+            REQUIRE(code == expected[r][0]);
+            REQUIRE(note == expected[r][1]);
+            if (expected[r][2].empty()) {
+                REQUIRE(!value);
+            } else {
+                REQUIRE(value);
+                REQUIRE(*value == Catch::Approx(std::stod(expected[r][2]) * 1000.0));
+            }
+            REQUIRE(mapped == 0);
+            ++r;
+        }
+        REQUIRE(r == expected.size());
+    };
+
+    check(load(nullptr, 1 << 20));
+    core::ThreadPool pool(4);
+    for (size_t chunk_bytes : {size_t(1), size_t(7), size_t(1000), size_t(65536)}) {
+        const auto result = load(&pool, chunk_bytes);
+        REQUIRE(result.chunks > 1);
+        check(result);   // Replaced, never appended
+    }
+
+    SECTION("Quotes inside unquoted cells don't move chunk boundaries") {
+        // The stray quote is a literal: the multi-line cell after it is still quoted
+        const std::string stray = "code,note,value\n"
+                                  "P1,12\" pipe,1\n"
+                                  "P2,\"bends,\nelbows\",2\n"
+                                  "P3, \"tee\" ,3\n"
+                                  "P4,\"3\"\" cap\"\"\",4\r\n"
+                                  "P5,plain,5\n";
+        const std::vector<std::vector<std::string>> notes = {
+            {"P1", "12\" pipe"}, {"P2", "bends,\nelbows"}, {"P3", "tee"}, {"P4", "3\" cap\""}, {"P5", "plain"}};
+        REQUIRE(CsvImporter::parse(stray).size() == notes.size() + 1);
+        for (size_t chunk_bytes = 1; chunk_bytes <= stray.size(); ++chunk_bytes) {
+            CAPTURE(chunk_bytes);
+            CsvImportOptions options;
+            options.pool = &pool;
+            options.chunk_bytes = chunk_bytes;
+            REQUIRE(CsvImporter::import_text(*db, stray, "staging_stray", options).rows == notes.size());
+            auto rows = db->execute_query("SELECT code, note FROM staging_stray ORDER BY _rowid", {});
+            size_t r = 0;
+            for (auto [code, note] : rows->rows<std::string, std::string>()) {
+                REQUIRE(r < notes.size());
+                CHECK(code == notes[r][0]);
+                CHECK(note == notes[r][1]);
+                ++r;
+            }
+            CHECK(r == notes.size());
+        }
+    }
+
+    SECTION("Files are mapped; appending keeps the rows") {
+        const std::string path = "test_csv_importer.csv";
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << "a;b\n1;x\n2\n";
+        }
+        CsvImportOptions options;
+        options.delimiter = ';';
+        options.numeric_columns = {{"a", ""}};
+        REQUIRE(CsvImporter::import_file(*db, path, "staging_small", options).rows == 2);
+        options.replace = false;
+        REQUIRE(CsvImporter::import_file(*db, path, "staging_small", options).rows == 2);
+        auto rows = db->execute_query("SELECT SUM(a), COUNT(*), MIN(b) FROM staging_small", {});
+        REQUIRE(rows->next());
+        REQUIRE(rows->get_double(0) == 6.0);
+        REQUIRE(rows->get_int(1) == 4);
+        REQUIRE(rows->get_string(2) == "");   // Missing cells are empty
+        rows.reset();
+        std::remove(path.c_str());
+        REQUIRE_THROWS_AS(CsvImporter::import_file(*db, path, "staging_small"), std::runtime_error);
+    }
+
+    SECTION("POST /imports loads files of the import directory into staging tables") {
+        namespace fs = std::filesystem;
+        const fs::path dir = fs::temp_directory_path() / "finmodel_import_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        {
+            std::ofstream out(dir / "upload.csv", std::ios::binary);
+            out << text;
+        }
+        std::ofstream(fs::path("test_csv_outside.csv")) << "code,value\nA,1\n";
+        web::Server server(0, "127.0.0.1");
+        const std::string body = R"({"file": "upload.csv", "table": "staging_scenario_2", "numeric": {"value": "kEUR"}})";
+        CHECK(server.handle("POST", "/imports", body).status == 404);   // No staging database
+        server.set_imports([db] { return db; }, "", 3);
+        CHECK(server.handle("POST", "/imports", body).status == 404);   // No import directory
+        server.set_imports([db] { return db; }, dir.string(), 3);
+
+        const auto response = server.handle("POST", "/imports", body);
+        REQUIRE(response.status == 200);
+        CHECK(response.body.find("\"rows\":5000") != std::string::npos);
+        auto count = db->execute_query("SELECT COUNT(*), SUM(value) FROM staging_scenario_2", {});
+        REQUIRE(count->next());
+        CHECK(static_cast<size_t>(count->get_int(0)) == expected.size());
+        count.reset();
+
+        CHECK(server.handle("GET", "/imports").status == 405);
+        CHECK(server.handle("POST", "/imports", "{\"file\": 1}").status == 400);
+        CHECK(server.handle("POST", "/imports", R"({"file": "x.csv", "table": "scenario_drivers"})").status == 400);
+        CHECK(server.handle("POST", "/imports", R"({"file": "x.csv", "table": "staging_x", "delimiter": ";;"})").status == 400);
+        CHECK(server.handle("POST", "/imports", R"({"file": "missing.csv", "table": "staging_x"})").status == 404);
+
+        // Nothing outside the import directory: no paths, no links out of it
+        const std::string outside = fs::absolute("test_csv_outside.csv").string();
+        fs::create_symlink(outside, dir / "link.csv");
+        const std::vector<std::string> refused = {"../upload.csv", outside, "/etc/passwd", "sub/upload.csv", "..", "", "link.csv"};
+        for (const std::string& file : refused) {
+            CAPTURE(file);
+            CHECK(server.handle("POST", "/imports", R"({"file": ")" + file + R"(", "table": "staging_x"})").status == 400);
+        }
+        fs::remove_all(dir);
+        fs::remove("test_csv_outside.csv");
+    }
+
+    SECTION("Bad input fails the whole import") {
+        CsvImportOptions options;
+        options.numeric_columns = {{"value", ""}};
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "code,value\nA,1\nB,x1\n", "staging_scenario_1", options),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "code,value\nA,1,2\n", "staging_scenario_1"),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "code,code\n", "staging_scenario_1"), std::runtime_error);
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "\n\n", "staging_scenario_1"), std::runtime_error);
+        options.numeric_columns = {{"missing", ""}};
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "code,value\n", "staging_scenario_1", options),
+                          std::invalid_argument);
+        options.numeric_columns = {{"value", "USD"}};
+        options.units = &units;
+        REQUIRE_THROWS_AS(CsvImporter::import_text(*db, "code,value\n", "staging_scenario_1", options),
+                          std::invalid_argument);
+
+        // The earlier import is untouched
+        auto count = db->execute_query("SELECT COUNT(*) FROM staging_scenario_1", {});
+        REQUIRE(count->next());
+        REQUIRE(static_cast<size_t>(count->get_int(0)) == expected.size());
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file test_databases.h
+ * @brief In-memory databases shared by the orchestration test files
+ */
+
+#pragma once
+#include "core/statement_template.h"
+#include "database/database_factory.h"
+#include "database/idatabase.h"
+#include <memory>
+#include <string>
+
+namespace finmodel {
+namespace test {
+
+// Just the tables a PeriodRunner run touches
+inline std::shared_ptr<database::IDatabase> create_runner_db(const std::string& connection_string = ":memory:") {
+    auto db = database::DatabaseFactory::create_sqlite(connection_string);
+    db->execute_raw(
+        "CREATE TABLE statement_template (template_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "  code TEXT UNIQUE NOT NULL, statement_type TEXT, industry TEXT, version TEXT NOT NULL, "
+        "  json_structure TEXT NOT NULL, is_active INTEGER NOT NULL DEFAULT 1, created_at TEXT, updated_at TEXT);"
+        "CREATE TABLE scenario_drivers (entity_id TEXT, scenario_id INTEGER, period_id INTEGER, "
+        "  driver_code TEXT, value REAL, unit_code TEXT);"
+        "CREATE TABLE scenario_action (scenario_action_id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "  scenario_id INTEGER, action_code TEXT, trigger_type TEXT, trigger_condition TEXT, "
+        "  trigger_period INTEGER, start_period INTEGER, end_period INTEGER, trigger_sticky INTEGER, "
+        "  capex REAL DEFAULT 0, opex_annual REAL DEFAULT 0, emission_reduction_annual REAL DEFAULT 0, "
+        "  financial_transformations TEXT, carbon_transformations TEXT, notes TEXT DEFAULT '');"
+        "CREATE TABLE management_action (action_code TEXT, action_name TEXT, action_category TEXT);"
+        "CREATE TABLE validation_rule (rule_code TEXT, rule_name TEXT, rule_type TEXT, description TEXT, "
+        "  formula TEXT, required_line_items TEXT, tolerance REAL, severity TEXT, is_active INTEGER);"
+        "CREATE TABLE template_validation_rule (template_code TEXT, rule_code TEXT, is_enabled INTEGER);"
+        "CREATE TABLE unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "CREATE TABLE fx_rate (from_currency TEXT, to_currency TEXT, period_id INTEGER, rate REAL);"
+        "INSERT INTO unit_definition VALUES ('EUR', 'Euro', 'CURRENCY', 'STATIC', 1.0, 'EUR', 'EUR', '', 1);"
+    );
+    return db;
+}
+
+inline std::shared_ptr<database::IDatabase> create_incremental_db(const std::string& connection_string = ":memory:") {
+    auto db = create_runner_db(connection_string);
+    auto tmpl = core::StatementTemplate::load_from_json(R"({
+        "template_code": "INCREMENTAL_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "COSTS", "base_value_source": "driver:COSTS"},
+            {"code": "OTHER", "base_value_source": "driver:OTHER"},
+            {"code": "GROSS", "formula": "REVENUE - COSTS"},
+            {"code": "TAX", "formula": "GROSS * 0.25"},
+            {"code": "NET", "formula": "GROSS - TAX"},
+            {"code": "CASH", "formula": "CASH[t-1] + NET"},
+            {"code": "OTHER_SCALED", "formula": "OTHER * 2"}
+        ]
+    })");
+    tmpl->save_to_database(db.get());
+
+    for (int period = 1; period <= 3; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 1000.0, 'EUR'), ('E', 1, :period, 'COSTS', 600.0, 'EUR'), "
+            "       ('E', 1, :period, 'OTHER', 5.0, 'EUR')",
+            {{"period", period}}
+        );
+    }
+    return db;
+}
+
+} // namespace test
+} // namespace finmodel
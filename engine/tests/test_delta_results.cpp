@@ -0,0 +1,160 @@
+/**
+ * @file test_delta_results.cpp
+ * @brief Tests for sweep variants stored as deltas against a baseline
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/delta_results.h"
+#include "orchestration/scenario_diff.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+
+TEST_CASE("DeltaResultSet: Variants stored as changed cells of a baseline", "[orchestration][delta]") {
+    const std::string path = "test_results.fmdr";
+    auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"A", "B", "C", "D"});
+    auto overlay_schema = std::make_shared<const unified::ResultSchema>(
+        std::vector<std::string>{"A", "B", "C", "D", "SAVINGS"});
+    auto run = [&](std::vector<std::vector<double>> periods, bool overlay = false) {
+        MultiPeriodResults results;
+        for (auto& values : periods) {
+            unified::UnifiedResult result;
+            result.line_items = unified::ResultRow(overlay ? overlay_schema : schema, std::move(values));
+            results.results.push_back(std::move(result));
+        }
+        return results;
+    };
+    const std::vector<PeriodID> periods = {1, 2, 3};
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    DeltaResultSet set(periods, run({{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}}), 1);
+    set.add(2, run({{1, 2, 3, 4}, {5, 6, 70, 8}, {9, 10, 11, 120}}));
+    set.add(3, run({{1, 2, 3, 4, 0.5}, {5, 6, 7, 8, 0.5}, {9, 10, nan, 12, 0.5}}, true));
+    auto cancelled = run({{1, 2, 3, 4}});
+    cancelled.add_error("Run cancelled after period 1");
+    set.add(4, cancelled);
+    CHECK_THROWS_AS(set.add(2, cancelled), std::invalid_argument);
+
+    CHECK(set.changed_cells(2) == 2);
+    CHECK(set.changed_cells(3) == 4);   // SAVINGS in each period, and a NaN
+    CHECK(set.changed_cells(4) == 8);   // Periods 2 and 3 have no values
+    CHECK(set.value(2, "C", 2) == 70.0);
+    CHECK(set.value(2, "C", 3) == 11.0);
+    CHECK(std::isnan(set.value(2, "SAVINGS", 3)));
+    CHECK(set.value(3, "SAVINGS", 1) == 0.5);
+    CHECK(std::isnan(set.value(3, "C", 3)));
+    CHECK_THROWS_AS(set.value(9, "C", 3), std::out_of_range);
+
+    auto changes = set.changes(2);
+    REQUIRE(changes.size() == 2);
+    CHECK(changes[0].period_id == 2);
+    CHECK(changes[0].code == "C");
+    CHECK(changes[0].baseline == 7.0);
+    CHECK(changes[0].value == 70.0);
+    CHECK(changes[1].code == "D");
+    CHECK(changes[1].value == 120.0);
+
+    auto check_expanded = [&](const DeltaResultSet& s) {
+        auto variant = s.expand(2);
+        REQUIRE(variant.results.size() == 3);
+        CHECK(variant.results[1].get_all_values() == run({{5, 6, 70, 8}}).results[0].get_all_values());
+        auto overlay = s.expand(3);
+        REQUIRE(overlay.results.size() == 3);
+        CHECK(overlay.results[0].get_value("SAVINGS") == 0.5);
+        CHECK(std::isnan(overlay.results[2].get_value("C")));
+        auto stopped = s.expand(4);
+        CHECK(stopped.results.size() == 1);
+        CHECK_FALSE(stopped.success);
+        CHECK(s.expand(1).results[2].get_all_values() == run({{9, 10, 11, 12}}).results[0].get_all_values());
+    };
+    check_expanded(set);
+
+    set.save(path);
+    auto loaded = DeltaResultSet::load(path);
+    CHECK(loaded.variant_ids() == std::vector<ScenarioID>{2, 3, 4});
+    CHECK(loaded.line_items() == set.line_items());
+    CHECK(loaded.changes(2).size() == 2);
+    check_expanded(loaded);
+    {
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(20);
+        out.put('\x7F');
+    }
+    CHECK_THROWS_AS(DeltaResultSet::load(path), std::runtime_error);
+    std::remove(path.c_str());
+
+    SECTION("A sparse sweep takes a fraction of its dense size") {
+        std::vector<std::string> codes(200);
+        for (size_t i = 0; i < codes.size(); ++i) {
+            codes[i] = "ITEM_" + std::to_string(i);
+        }
+        auto wide = std::make_shared<const unified::ResultSchema>(codes);
+        auto wide_run = [&](size_t changed_item, double bump) {
+            MultiPeriodResults results;
+            for (size_t p = 0; p < 12; ++p) {
+                std::vector<double> values(codes.size());
+                for (size_t i = 0; i < values.size(); ++i) {
+                    values[i] = static_cast<double>(p * 1000 + i);
+                }
+                values[changed_item] += bump;   // One driver moves one line item
+                unified::UnifiedResult result;
+                result.line_items = unified::ResultRow(wide, std::move(values));
+                results.results.push_back(std::move(result));
+            }
+            return results;
+        };
+        const std::vector<PeriodID> months = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+        DeltaResultSet sweep(months, wide_run(0, 0.0), 0);
+        for (ScenarioID s = 1; s <= 100; ++s) {
+            sweep.add(s, wide_run(static_cast<size_t>(s), 1.0));
+        }
+        CHECK(sweep.changed_cells(50) == 12);
+        CHECK(sweep.value(50, "ITEM_50", 7) == 6051.0);
+        CHECK(sweep.bytes() * 10 < sweep.dense_bytes());
+    }
+
+    SECTION("Runs minus a base from the changed cells") {
+        ScenarioDiffQuery query;
+        query.base_id = 1;
+        query.line_items = {"C", "D"};
+        query.top = 1;
+        auto diff = ScenarioDiffer::diff(set, query);
+        CHECK(diff.scenario_ids == std::vector<ScenarioID>{2, 3, 4});
+        CHECK(diff.period_ids == periods);
+        CHECK(diff.base == std::vector<double>{3, 7, 11, 4, 8, 12});
+        CHECK(diff.difference(0, 0, 1) == 63.0);
+        CHECK(diff.difference(0, 1, 2) == 108.0);
+        CHECK(diff.difference(0, 0, 0) == 0.0);
+        CHECK(std::isnan(diff.difference(1, 0, 2)));
+        CHECK(std::isnan(diff.difference(2, 1, 1)));   // Cancelled after period 1
+        REQUIRE(diff.top.size() == 1);
+        CHECK(diff.top[0].scenario_id == 2);
+        CHECK(diff.top[0].line_item == "D");
+        CHECK(diff.top[0].period_id == 3);
+        CHECK(diff.top[0].base == 12.0);
+        CHECK(diff.top[0].value == 120.0);
+
+        // A variant as the base, the baseline among the compared runs
+        query.base_id = 2;
+        query.scenario_ids = {3, 1};
+        query.top = 0;
+        diff = ScenarioDiffer::diff(set, query);
+        CHECK(diff.base == std::vector<double>{3, 70, 11, 4, 8, 120});
+        CHECK(diff.difference(0, 0, 1) == -63.0);
+        CHECK(std::isnan(diff.difference(0, 0, 2)));
+        CHECK(diff.difference(1, 1, 2) == -108.0);
+        CHECK(diff.difference(1, 1, 0) == 0.0);
+        CHECK(diff.top.empty());
+
+        query.base_id = 9;
+        CHECK_THROWS_AS(ScenarioDiffer::diff(set, query), std::out_of_range);
+        query.base_id = 1;
+        query.line_items = {"E"};
+        CHECK_THROWS_AS(ScenarioDiffer::diff(set, query), std::out_of_range);
+    }
+}
@@ -147,6 +147,24 @@ TEST_CASE("DependencyGraph - Simple topological sort", "[dependency][topsort]")
     }
 }
 
+TEST_CASE("DependencyGraph - Topological levels", "[dependency][topsort]") {
+    DependencyGraph graph;
+    graph.add_edge("GROSS_PROFIT", "REVENUE");
+    graph.add_edge("GROSS_PROFIT", "COGS");
+    graph.add_edge("NET_INCOME", "GROSS_PROFIT");
+    graph.add_edge("NET_INCOME", "TAX");
+
+    auto levels = graph.topological_levels();
+
+    REQUIRE(levels.size() == 3);
+    REQUIRE(levels[0] == std::vector<std::string>{"COGS", "REVENUE", "TAX"});
+    REQUIRE(levels[1] == std::vector<std::string>{"GROSS_PROFIT"});
+    REQUIRE(levels[2] == std::vector<std::string>{"NET_INCOME"});
+
+    graph.add_edge("REVENUE", "NET_INCOME");
+    REQUIRE_THROWS_AS(graph.topological_levels(), std::runtime_error);
+}
+
 TEST_CASE("DependencyGraph - Complex topological sort", "[dependency][topsort]") {
     DependencyGraph graph;
 
@@ -585,3 +603,114 @@ TEST_CASE("DependencyGraph - Real-world circular dependency detection", "[depend
         REQUIRE(std::find(cycle.begin(), cycle.end(), "B") != cycle.end());
     }
 }
+
+// ============================================================================
+// Node IDs and Large Graphs
+// ============================================================================
+
+TEST_CASE("DependencyGraph - Node IDs", "[dependency][ids]") {
+    DependencyGraph graph;
+
+    SECTION("IDs are dense and stable") {
+        uint32_t revenue = graph.add_node("REVENUE");
+        uint32_t cogs = graph.add_node("COGS");
+        REQUIRE(revenue == 0);
+        REQUIRE(cogs == 1);
+        REQUIRE(graph.add_node("REVENUE") == revenue);
+        REQUIRE(graph.find_node("COGS") == cogs);
+        REQUIRE(graph.find_node("UNKNOWN") == DependencyGraph::NO_NODE);
+        REQUIRE(graph.node_code(cogs) == "COGS");
+    }
+
+    SECTION("ID and string overloads give the same order") {
+        uint32_t gp = graph.add_node("GROSS_PROFIT");
+        uint32_t revenue = graph.add_node("REVENUE");
+        uint32_t cogs = graph.add_node("COGS");
+        graph.add_edge(gp, revenue);
+        graph.add_edge(gp, cogs);
+        graph.add_edge(gp, cogs);  // Duplicate edges count once
+
+        REQUIRE(graph.topological_order() == std::vector<uint32_t>{cogs, revenue, gp});
+        REQUIRE(graph.topological_sort() == std::vector<std::string>{"COGS", "REVENUE", "GROSS_PROFIT"});
+        REQUIRE(graph.get_dependencies("GROSS_PROFIT") == std::vector<std::string>{"COGS", "REVENUE"});
+    }
+
+    SECTION("Cycle excludes nodes leading into it") {
+        graph.add_edge("A", "B");
+        graph.add_edge("B", "C");
+        graph.add_edge("C", "B");
+
+        REQUIRE(graph.find_cycle() == std::vector<std::string>{"B", "C", "B"});
+    }
+}
+
+TEST_CASE("DependencyGraph - Large generated template", "[dependency][large]") {
+    // Chain of 20000 items, each also depending on an early item
+    const int count = 20000;
+    DependencyGraph graph;
+    for (int i = 1; i < count; ++i) {
+        graph.add_edge("ITEM_" + std::to_string(i), "ITEM_" + std::to_string(i - 1));
+        graph.add_edge("ITEM_" + std::to_string(i), "ITEM_" + std::to_string(i / 2));
+    }
+
+    auto order = graph.topological_order();
+    REQUIRE(order.size() == static_cast<size_t>(count));
+    std::vector<size_t> position(order.size());
+    for (size_t p = 0; p < order.size(); ++p) {
+        position[order[p]] = p;
+    }
+    for (int i = 1; i < count; ++i) {
+        uint32_t item = graph.find_node("ITEM_" + std::to_string(i));
+        REQUIRE(position[graph.find_node("ITEM_" + std::to_string(i - 1))] < position[item]);
+    }
+    REQUIRE(graph.topological_levels().size() == static_cast<size_t>(count));
+
+    // Closing the chain gives cycles thousands of items long (no deep recursion)
+    graph.add_edge("ITEM_0", "ITEM_" + std::to_string(count - 1));
+    REQUIRE(graph.has_cycles());
+    auto cycle = graph.find_cycle();
+    REQUIRE(cycle.size() > 1000);
+    REQUIRE(cycle.front() == cycle.back());
+    REQUIRE_THROWS_AS(graph.topological_sort(), std::runtime_error);
+}
+
+TEST_CASE("DependencyGraph - Strongly connected components", "[dependency][scc]") {
+    DependencyGraph graph;
+
+    SECTION("Acyclic graph: single nodes in topological order") {
+        graph.add_edge("NET", "GROSS");
+        graph.add_edge("NET", "TAX");
+        graph.add_edge("GROSS", "REVENUE");
+        graph.add_edge("GROSS", "COGS");
+        graph.add_edge("TAX", "GROSS");
+
+        std::vector<std::string> flat;
+        for (const auto& component : graph.strongly_connected_components()) {
+            REQUIRE(component.size() == 1);
+            flat.push_back(component.front());
+        }
+        REQUIRE(flat == graph.topological_sort());
+    }
+
+    SECTION("Cycle as one component after its dependencies") {
+        graph.add_edge("INTEREST", "CASH");
+        graph.add_edge("CASH", "NET");
+        graph.add_edge("NET", "EBIT");
+        graph.add_edge("NET", "INTEREST");
+        graph.add_edge("DIVIDEND", "NET");
+
+        auto components = graph.strongly_connected_components();
+        REQUIRE(components.size() == 3);
+        REQUIRE(components[0] == std::vector<std::string>{"EBIT"});
+        REQUIRE(components[1] == std::vector<std::string>{"CASH", "INTEREST", "NET"});
+        REQUIRE(components[2] == std::vector<std::string>{"DIVIDEND"});
+    }
+
+    SECTION("Self-dependency stays a single node") {
+        graph.add_edge("A", "A");
+        graph.add_edge("B", "A");
+
+        auto components = graph.strongly_connected_components();
+        REQUIRE(components == std::vector<std::vector<std::string>>{{"A"}, {"B"}});
+    }
+}
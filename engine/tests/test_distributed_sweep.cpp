@@ -0,0 +1,123 @@
+/**
+ * @file test_distributed_sweep.cpp
+ * @brief Tests for distributed sweep coordinators and workers
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/columnar_results.h"
+#include "orchestration/distributed_sweep.h"
+#include "test_databases.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("SweepWorker: Shards of a distributed sweep run and retry", "[orchestration][sweep]") {
+    namespace fs = std::filesystem;
+    const std::string path = "test_sweep.db";
+    const fs::path work_dir = "test_sweep_work";
+    auto remove_files = [&] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+        fs::remove_all(work_dir);
+    };
+    remove_files();
+    {
+        auto db = create_incremental_db(path);
+        std::vector<ParamMap> drivers;
+        for (int scenario = 2; scenario <= 5; ++scenario) {
+            for (int period = 1; period <= 3; ++period) {
+                for (auto [code, value] : {std::pair{"REVENUE", 1000.0 + 10.0 * scenario},
+                                           std::pair{"COSTS", 600.0}, std::pair{"OTHER", 1.0 * scenario}}) {
+                    drivers.push_back({{"scenario", scenario}, {"period", period},
+                                       {"code", std::string(code)}, {"value", value}});
+                }
+            }
+        }
+        db->execute_batch(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', :scenario, :period, :code, :value, 'EUR')", drivers);
+    }
+
+    SweepSpec spec;
+    spec.entities = {"E"};
+    spec.scenario_ids = {1, 2, 3, 4, 5};
+    spec.period_ids = {1, 2, 3};
+    spec.template_code = "INCREMENTAL_TEST";
+    spec.opening_balances["CASH"] = 100.0;
+    spec.scenarios_per_shard = 2;
+
+    SweepCoordinator coordinator(work_dir.string(), 2, 60.0);
+    REQUIRE(coordinator.prepare(path, spec) == 3);
+    CHECK_THROWS_AS(coordinator.prepare(path, spec), std::runtime_error);
+
+    SECTION("Abandoned shards are requeued, results land in columnar files") {
+        // A worker claimed shard 0 and died an hour ago
+        const fs::path lease = work_dir / "running" / "0000.dead-worker";
+        fs::rename(work_dir / "pending" / "0000.shard", lease);
+        fs::last_write_time(lease, fs::file_time_type::clock::now() - std::chrono::hours(1));
+
+        auto shards = coordinator.poll();
+        REQUIRE(shards.size() == 3);
+        CHECK(shards[0].state == ShardStatus::State::PENDING);
+        CHECK(shards[0].attempts == 1);
+        CHECK(shards[0].error.find("heartbeat") != std::string::npos);
+
+        SweepWorker worker(work_dir.string(), "worker-1");
+        size_t runs = 0;
+        while (worker.run_one()) {
+            ++runs;
+        }
+        CHECK(runs == 3);
+
+        shards = coordinator.wait(0.01, 5.0);
+        for (const auto& shard : shards) {
+            REQUIRE(shard.state == ShardStatus::State::DONE);
+            CHECK(shard.worker == "worker-1");
+            CHECK(shard.failed_runs == 0);
+        }
+        CHECK(shards[2].scenarios == 1);
+        CHECK(shards[2].rows == 3);
+        CHECK(fs::exists(work_dir / "sweep.finished"));
+        CHECK(worker.run(0.0) == 0);
+
+        // Scenario 5 is shard 2's only scenario
+        ColumnarResultReader reader(shards[2].result_path);
+        auto cash = reader.read("CASH");
+        REQUIRE(cash.size() == 3);
+        CHECK(cash.scenario_ids[2] == 5);
+        CHECK(cash.values[2] == Approx(100.0 + 3 * 0.75 * 450.0));
+
+        const std::string report = SweepCoordinator::report(shards);
+        CHECK(report.find("3/3 shards done") != std::string::npos);
+    }
+
+    SECTION("Shards failing every attempt are given up") {
+        fs::remove(work_dir / "inputs.db");
+        SweepWorker worker(work_dir.string(), "worker-1");
+        CHECK(worker.run(0.0) == 3);
+
+        auto shards = coordinator.poll();
+        CHECK(shards[0].state == ShardStatus::State::PENDING);
+        CHECK(shards[0].attempts == 1);
+        CHECK(worker.run(0.0) == 3);
+
+        shards = coordinator.poll();
+        for (const auto& shard : shards) {
+            CHECK(shard.state == ShardStatus::State::FAILED);
+            CHECK(shard.attempts == 2);
+            CHECK_FALSE(shard.error.empty());
+        }
+        CHECK(fs::exists(work_dir / "sweep.finished"));
+        CHECK(SweepCoordinator::report(shards).find("FAILED") != std::string::npos);
+    }
+
+    remove_files();
+}
@@ -0,0 +1,85 @@
+/**
+ * @file test_eeio_model.cpp
+ * @brief Tests for spend-based Scope 3 emissions through the EEIO model
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "carbon/eeio_model.h"
+#include "orchestration/period_runner.h"
+#include "core/statement_template.h"
+#include "test_databases.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("EEIOModel: Scope 3 from spend through the Leontief inverse", "[orchestration][eeio]") {
+    auto db = create_runner_db(":memory:");
+    db->execute_raw(
+        "CREATE TABLE eeio_sector (sector_code TEXT PRIMARY KEY, sector_name TEXT, direct_intensity REAL);"
+        "CREATE TABLE eeio_coefficient (from_sector TEXT, to_sector TEXT, coefficient REAL);"
+        "CREATE TABLE eeio_spend (spend_id INTEGER PRIMARY KEY, entity_id TEXT, scenario_id INTEGER, "
+        "  period_id INTEGER, sector_code TEXT, category TEXT, amount REAL);"
+        "INSERT INTO eeio_sector VALUES ('METALS_DE', 'Basic metals', 1.0), ('POWER_DE', 'Electricity', 2.0);"
+        // Metals buy 0.1 of power per unit of output, power 0.5 of metals
+        "INSERT INTO eeio_coefficient VALUES ('POWER_DE', 'METALS_DE', 0.1), ('METALS_DE', 'POWER_DE', 0.5);"
+        "INSERT INTO eeio_spend (entity_id, scenario_id, period_id, sector_code, category, amount) VALUES "
+        "  ('E', 1, 1, 'METALS_DE', 'UPSTREAM', 60), ('E', 1, 1, 'METALS_DE', 'UPSTREAM', 40), "
+        "  ('E', 1, 1, 'POWER_DE', 'DOWNSTREAM', 10), ('E', 1, 2, 'METALS_DE', 'UPSTREAM', 200), "
+        "  ('F', 1, 1, 'POWER_DE', NULL, 50), ('E', 2, 1, 'POWER_DE', 'UPSTREAM', 1);"
+    );
+    auto tmpl = core::StatementTemplate::load_from_json(R"({
+        "template_code": "SCOPE3_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "SCOPE3_UPSTREAM", "formula": "scope3:UPSTREAM"},
+            {"code": "SCOPE3_DOWNSTREAM", "formula": "scope3:DOWNSTREAM"},
+            {"code": "SCOPE3_INTENSITY", "formula": "(SCOPE3_UPSTREAM + SCOPE3_DOWNSTREAM) / REVENUE * 1000"}
+        ]
+    })");
+    tmpl->save_to_database(db.get());
+    for (int period = 1; period <= 3; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 1000.0, 'EUR')",
+            {{"period", period}});
+    }
+
+    // m = f (I - A)^-1: m_metals = 1 + 0.1 m_power, m_power = 2 + 0.5 m_metals
+    auto model = carbon::EEIOModel::load(*db);
+    REQUIRE(model.size() == 2);
+    const double metals = 1.2 / 0.95;
+    const double power = 2.0 + 0.5 * metals;
+    CHECK(model.total_intensity()[model.sector("METALS_DE")] == Approx(metals));
+    CHECK(model.total_intensity()[model.sector("POWER_DE")] == Approx(power));
+
+    auto scope3 = std::make_shared<const carbon::Scope3Results>(model.evaluate(*db, {1}));
+    REQUIRE(scope3->categories == std::vector<std::string>{"DOWNSTREAM", "UPSTREAM"});
+    REQUIRE(scope3->rows.size() == 3);
+    CHECK(scope3->get("E", 1, 1, "UPSTREAM") == Approx(100.0 * metals));
+    CHECK(scope3->get("F", 1, 1, "UPSTREAM") == Approx(50.0 * power));
+    CHECK(scope3->get("E", 2, 1, "UPSTREAM") == 0.0);   // Scenario 2 not evaluated
+
+    BalanceSheet initial_bs;
+    PeriodRunner runner(db);
+    runner.set_scope3_results(scope3);
+    auto run = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "SCOPE3_TEST");
+    REQUIRE(run.success);
+    CHECK(run.results[0].get_value("SCOPE3_UPSTREAM") == Approx(100.0 * metals));
+    CHECK(run.results[0].get_value("SCOPE3_DOWNSTREAM") == Approx(10.0 * power));
+    CHECK(run.results[0].get_value("SCOPE3_INTENSITY") == Approx(100.0 * metals + 10.0 * power));
+    CHECK(run.results[1].get_value("SCOPE3_UPSTREAM") == Approx(200.0 * metals));
+    CHECK(run.results[2].get_value("SCOPE3_UPSTREAM") == 0.0);   // No spend
+
+    // Singular tables and unknown sectors are rejected
+    CHECK_THROWS_AS(carbon::EEIOModel({"A"}, {1.0}, {{"A", "A", 1.0}}), std::runtime_error);
+    CHECK_THROWS_AS(model.evaluate({{"E", 1, 1, "MINING_DE", "UPSTREAM", 1.0}}), std::invalid_argument);
+}
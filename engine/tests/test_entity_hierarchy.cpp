@@ -0,0 +1,338 @@
+/**
+ * @file test_entity_hierarchy.cpp
+ * @brief Tests for entity hierarchy rollups, currency translation and eliminations
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/entity_hierarchy_runner.h"
+#include "test_databases.h"
+#include <cstdio>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("EntityHierarchyRunner: Parents are the sum of their children", "[orchestration][hierarchy]") {
+    const std::string path = "test_hierarchy.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        {
+            // GROUP → DIV_A → [A1, A2], DIV_B → [B1]; deeper: A2 → [A2X]
+            auto db = create_incremental_db(path);
+            db->execute_raw(
+                "CREATE TABLE entity (entity_id INTEGER PRIMARY KEY, code TEXT UNIQUE NOT NULL, parent_entity_id INTEGER);"
+                "INSERT INTO entity VALUES (1, 'GROUP', NULL), (2, 'DIV_A', 1), (3, 'DIV_B', 1), "
+                "  (4, 'A1', 2), (5, 'A2', 2), (6, 'B1', 3), (7, 'A2X', 5), (8, 'OTHER_GROUP', NULL);"
+            );
+            std::vector<ParamMap> drivers;
+            for (auto [code, revenue] : {std::pair{"A1", 1000.0}, std::pair{"A2X", 2000.0}, std::pair{"B1", 3000.0}}) {
+                for (int period = 1; period <= 3; ++period) {
+                    drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                                       {"code", std::string("REVENUE")}, {"value", revenue}});
+                    drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                                       {"code", std::string("COSTS")}, {"value", revenue / 2}});
+                }
+            }
+            db->execute_batch(
+                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                "VALUES (:entity, 1, :period, :code, :value, 'EUR')", drivers);
+        }
+
+        auto tree = EntityTree::load(*pool.writer(), "GROUP");
+        REQUIRE(tree.nodes.size() == 7);
+        CHECK(tree.nodes[0].code == "GROUP");
+        CHECK(tree.leaves().size() == 3);
+        CHECK_THROWS_AS(EntityTree::load(*pool.writer(), "MISSING"), std::runtime_error);
+
+        std::map<EntityID, BalanceSheet> opening;
+        opening["A1"].line_items["CASH"] = 10.0;
+        opening["B1"].line_items["CASH"] = 20.0;
+        opening["A2X"].line_items["CASH"] = 0.0;
+        const std::vector<PeriodID> periods = {1, 2, 3};
+
+        EntityHierarchyRunner sequential(pool.writer());
+        auto expected = sequential.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+        REQUIRE(expected.size() == 7);
+        REQUIRE(expected.count("OTHER_GROUP") == 0);
+        for (const auto& [code, results] : expected) {
+            INFO(code);
+            REQUIRE(results.success);
+            REQUIRE(results.results.size() == 3);
+        }
+        CHECK(expected["A2"].results[0].get_all_values() == expected["A2X"].results[0].get_all_values());
+        CHECK(expected["DIV_A"].results[0].get_value("REVENUE") == Approx(3000.0));
+        CHECK(expected["GROUP"].results[0].get_value("GROSS") == Approx(3000.0));
+        CHECK(expected["GROUP"].results[2].get_value("CASH") == Approx(30.0 + 3 * 0.75 * 3000.0));
+
+        EntityHierarchyRunner parallel(pool.writer());
+        parallel.set_parallel(3, [&pool] { return pool.reader(); });
+        auto actual = parallel.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+        for (const auto& [code, results] : expected) {
+            INFO(code);
+            for (size_t p = 0; p < periods.size(); ++p) {
+                CHECK(actual[code].results[p].get_all_values() == results.results[p].get_all_values());
+            }
+        }
+
+        parallel.set_parallel(1, nullptr);
+        pool.close_readers();
+    }
+    remove_files();
+}
+
+TEST_CASE("EntityHierarchyRunner: Leaves run as entity lanes", "[orchestration][hierarchy][lanes]") {
+    const std::string path = "test_hierarchy_lanes.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        // GROUP → DIV_A → [A1, A2, A3], DIV_B → [B1, B2]; OTHER shared through PHYSICAL_RISK
+        auto db = create_incremental_db(path);
+        db->execute_raw(
+            "CREATE TABLE entity (entity_id INTEGER PRIMARY KEY, code TEXT UNIQUE NOT NULL, parent_entity_id INTEGER);"
+            "INSERT INTO entity VALUES (1, 'GROUP', NULL), (2, 'DIV_A', 1), (3, 'DIV_B', 1), "
+            "  (4, 'A1', 2), (5, 'A2', 2), (6, 'A3', 2), (7, 'B1', 3), (8, 'B2', 3);"
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "  VALUES ('PHYSICAL_RISK', 1, 2, 'OTHER', 7.0, 'EUR');"
+        );
+        std::vector<ParamMap> drivers;
+        double revenue = 1000.0;
+        for (const std::string code : {"A1", "A2", "A3", "B1", "B2"}) {
+            for (int period = 1; period <= 3; ++period) {
+                drivers.push_back({{"entity", code}, {"period", period},
+                                   {"code", std::string("REVENUE")}, {"value", revenue + 10.0 * period}});
+                drivers.push_back({{"entity", code}, {"period", period},
+                                   {"code", std::string("COSTS")}, {"value", revenue / 3}});
+            }
+            revenue += 250.0;
+        }
+        db->execute_batch(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES (:entity, 1, :period, :code, :value, 'EUR')", drivers);
+
+        // Entity lanes of one period: one column per line item, one value per entity
+        unified::UnifiedEngine engine(db);
+        engine.prefetch_drivers({"A1", "A2", "B1"}, 1, {1, 2, 3});
+        unified::LaneResult opening;
+        opening.schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"CASH"});
+        opening.values.push_back((core::LaneArray(3) << 10.0, 20.0, 30.0).finished());
+        auto lanes = engine.calculate_entity_lanes({"A1", "A2", "B1"}, 1, 2, opening, "INCREMENTAL_TEST");
+        REQUIRE(lanes.find("REVENUE"));
+        CHECK((*lanes.find("REVENUE"))[0] == 1020.0);
+        CHECK((*lanes.find("REVENUE"))[1] == 1270.0);
+        CHECK((*lanes.find("REVENUE"))[2] == 1770.0);
+        CHECK((*lanes.find("OTHER_SCALED"))[2] == 14.0);
+        CHECK((*lanes.find("CASH"))[1] == Approx(20.0 + 0.75 * (1270.0 - 1250.0 / 3)));
+        CHECK_THROWS_AS(engine.calculate_entity_lanes({"A1", "A2"}, 1, 2, opening, "INCREMENTAL_TEST"),
+                        std::invalid_argument);
+
+        // Same rollup as a run per leaf; B2 has other opening codes and runs alone
+        std::map<EntityID, BalanceSheet> initial;
+        initial["A1"].line_items["CASH"] = 10.0;
+        initial["A2"].line_items["CASH"] = 20.0;
+        initial["A3"].line_items["CASH"] = 0.0;
+        initial["B1"].line_items["CASH"] = 30.0;
+        initial["B2"].line_items["CASH"] = 40.0;
+        initial["B2"].line_items["DEBT"] = 5.0;
+        const std::vector<PeriodID> periods = {1, 2, 3};
+
+        EntityHierarchyRunner per_leaf(db);
+        auto expected = per_leaf.run_hierarchy("GROUP", 1, periods, initial, "INCREMENTAL_TEST");
+        EntityHierarchyRunner batched(db);
+        batched.set_entity_lanes(2);
+        auto actual = batched.run_hierarchy("GROUP", 1, periods, initial, "INCREMENTAL_TEST");
+        REQUIRE(actual.size() == expected.size());
+        for (const auto& [code, results] : expected) {
+            INFO(code);
+            REQUIRE(results.success);
+            REQUIRE(actual[code].success);
+            REQUIRE(actual[code].results.size() == periods.size());
+            for (size_t p = 0; p < periods.size(); ++p) {
+                for (const auto& [item, value] : results.results[p].get_all_values()) {
+                    INFO(item);
+                    CHECK(actual[code].results[p].get_value(item) == Approx(value));
+                }
+            }
+        }
+        CHECK(actual["GROUP"].results[1].get_value("OTHER_SCALED") == Approx(5 * 14.0));
+
+        // A scenario with management actions runs per leaf
+        db->execute_raw(
+            "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX');"
+            "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, "
+            "  financial_transformations) "
+            "VALUES (1, 'CUT', 'UNCONDITIONAL', 2, '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}]');"
+        );
+        auto with_actions = batched.run_hierarchy("GROUP", 1, periods, initial, "INCREMENTAL_TEST");
+        auto reference = per_leaf.run_hierarchy("GROUP", 1, periods, initial, "INCREMENTAL_TEST");
+        CHECK(with_actions["GROUP"].results[2].get_value("GROSS") ==
+              Approx(reference["GROUP"].results[2].get_value("GROSS")));
+        CHECK(with_actions["GROUP"].results[2].get_value("GROSS") ==
+              Approx(expected["GROUP"].results[2].get_value("GROSS") + 5 * 100.0));
+    }
+    remove_files();
+}
+
+TEST_CASE("EntityHierarchyRunner: Children are translated into their parent's currency", "[orchestration][hierarchy][translation]") {
+    // GROUP (EUR) → [A1 (EUR), U1 (USD)]
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "CREATE TABLE entity (entity_id INTEGER PRIMARY KEY, code TEXT UNIQUE NOT NULL, parent_entity_id INTEGER, "
+        "  base_currency TEXT DEFAULT 'USD');"
+        "INSERT INTO entity VALUES (1, 'GROUP', NULL, 'EUR'), (2, 'A1', 1, 'EUR'), (3, 'U1', 1, 'USD');"
+        "DROP TABLE fx_rate;"
+        "CREATE TABLE fx_rate (scenario_id INTEGER, period_id INTEGER, from_currency TEXT, to_currency TEXT, "
+        "  rate REAL, rate_type TEXT DEFAULT 'average');"
+        "INSERT INTO fx_rate VALUES (1, 1, 'USD', 'EUR', 0.90, 'average'), (1, 2, 'USD', 'EUR', 0.80, 'average'), "
+        "  (1, 3, 'USD', 'EUR', 0.85, 'average'), (1, 1, 'USD', 'EUR', 0.88, 'closing'), "
+        "  (1, 2, 'USD', 'EUR', 0.82, 'closing');"
+    );
+    std::vector<ParamMap> drivers;
+    for (auto [code, revenue] : {std::pair{"A1", 1000.0}, std::pair{"U1", 2000.0}}) {
+        for (int period = 1; period <= 3; ++period) {
+            drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                               {"code", std::string("REVENUE")}, {"value", revenue * period}});
+            drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                               {"code", std::string("COSTS")}, {"value", revenue / 2}});
+        }
+    }
+    db->execute_batch(
+        "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+        "VALUES (:entity, 1, :period, :code, :value, 'EUR')", drivers);
+
+    std::map<EntityID, BalanceSheet> opening;
+    opening["A1"].line_items["CASH"] = 10.0;
+    opening["U1"].line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    EntityHierarchyRunner plain(db);
+    auto summed = plain.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+    REQUIRE(summed["GROUP"].success);
+    CHECK(summed["GROUP"].results[0].line_items.find("CTA") == nullptr);
+
+    EntityHierarchyRunner runner(db);
+    CurrencyTranslation translation;
+    translation.enabled = true;
+    translation.stocks = {"CASH"};
+    translation.net_assets = "CASH";
+    runner.set_currency_translation(translation);
+    auto group = runner.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+
+    // Flows at the average rate, stocks at the closing rate (period 3: no closing rate, the average one)
+    const double average[] = {0.90, 0.80, 0.85};
+    const double closing[] = {0.88, 0.82, 0.85};
+    double history = 0.0;
+    double previous = 0.0;
+    for (size_t p = 0; p < periods.size(); ++p) {
+        INFO("period " << periods[p]);
+        const auto& a1 = group["A1"].results[p];
+        const auto& u1 = group["U1"].results[p];
+        const auto& total = group["GROUP"].results[p];
+        REQUIRE(total.success);
+        CHECK(u1.get_all_values() == summed["U1"].results[p].get_all_values());
+        CHECK(total.get_value("REVENUE") == Approx(a1.get_value("REVENUE") + u1.get_value("REVENUE") * average[p]));
+        CHECK(total.get_value("NET") == Approx(a1.get_value("NET") + u1.get_value("NET") * average[p]));
+        CHECK(total.get_value("CASH") == Approx(a1.get_value("CASH") + u1.get_value("CASH") * closing[p]));
+
+        const double net = u1.get_value("CASH");
+        history = (p == 0) ? net * average[p] : history + (net - previous) * average[p];
+        previous = net;
+        REQUIRE(total.line_items.find("CTA"));
+        CHECK(total.get_value("CTA") == Approx(net * closing[p] - history));
+    }
+    CHECK(group["GROUP"].results[1].get_value("CTA") != Approx(0.0));
+
+    // No rate at all: the parent's period fails
+    db->execute_update("DELETE FROM fx_rate WHERE period_id = 3", {});
+    auto missing = runner.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+    CHECK(missing["U1"].success);
+    CHECK(missing["GROUP"].results[1].success);
+    CHECK_FALSE(missing["GROUP"].results[2].success);
+    REQUIRE_FALSE(missing["GROUP"].errors.empty());
+    CHECK(missing["GROUP"].errors[0].find("no USD to EUR rate in period 3") != std::string::npos);
+}
+
+TEST_CASE("EntityHierarchyRunner: Intercompany positions are eliminated at the common parent", "[orchestration][hierarchy][eliminations]") {
+    // GROUP → DIV_A → [A1, A2], DIV_B → [B1]
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "CREATE TABLE entity (entity_id INTEGER PRIMARY KEY, code TEXT UNIQUE NOT NULL, parent_entity_id INTEGER);"
+        "INSERT INTO entity VALUES (1, 'GROUP', NULL), (2, 'DIV_A', 1), (3, 'DIV_B', 1), "
+        "  (4, 'A1', 2), (5, 'A2', 2), (6, 'B1', 3);"
+        "CREATE TABLE intercompany_elimination (elimination_id INTEGER PRIMARY KEY, entity_code TEXT, "
+        "  counterparty_code TEXT, line_item_code TEXT, share REAL DEFAULT 1.0, also_reduce TEXT);"
+        "INSERT INTO intercompany_elimination (entity_code, counterparty_code, line_item_code, share, also_reduce) "
+        "  VALUES ('A1', 'A2', 'REVENUE', 0.1, NULL), ('A2', 'A1', 'COSTS', 0.2, NULL), "
+        "  ('A1', 'B1', 'REVENUE', 0.05, NULL), ('B1', 'A1', 'COSTS', 0.1, '[\"OTHER_SCALED\"]'), "
+        "  ('A1', 'OUTSIDE', 'REVENUE', 0.5, NULL);"
+    );
+    std::vector<ParamMap> drivers;
+    for (auto [code, revenue] : {std::pair{"A1", 1000.0}, std::pair{"A2", 2000.0}, std::pair{"B1", 3000.0}}) {
+        for (int period = 1; period <= 3; ++period) {
+            drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                               {"code", std::string("REVENUE")}, {"value", revenue + period}});
+            drivers.push_back({{"entity", std::string(code)}, {"period", period},
+                               {"code", std::string("COSTS")}, {"value", revenue / 4}});
+        }
+    }
+    db->execute_batch(
+        "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+        "VALUES (:entity, 1, :period, :code, :value, 'EUR')", drivers);
+
+    auto rules = EliminationMatrix::query(*db);
+    REQUIRE(rules.size() == 5);
+    auto tree = EntityTree::load(*db, "GROUP");
+    EliminationMatrix matrix(tree, rules);
+    CHECK(matrix.size() == 4);   // OUTSIDE isn't in the tree
+
+    std::map<EntityID, BalanceSheet> opening;
+    for (const EntityID code : {"A1", "A2", "B1"}) {
+        opening[code].line_items["CASH"] = 0.0;
+    }
+    const std::vector<PeriodID> periods = {1, 2, 3};
+    EntityHierarchyRunner plain(db);
+    auto summed = plain.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+    EntityHierarchyRunner runner(db);
+    runner.set_eliminations(rules);
+    auto group = runner.run_hierarchy("GROUP", 1, periods, opening, "INCREMENTAL_TEST");
+
+    for (size_t p = 0; p < periods.size(); ++p) {
+        INFO("period " << periods[p]);
+        auto value = [&](const EntityID& code, const std::string& item) {
+            return summed[code].results[p].get_value(item);
+        };
+        for (const EntityID code : {"A1", "A2", "B1", "DIV_B"}) {
+            CHECK(group[code].results[p].get_all_values() == summed[code].results[p].get_all_values());
+        }
+        REQUIRE(group["DIV_A"].results[p].success);
+        REQUIRE(group["GROUP"].results[p].success);
+
+        // A1 ↔ A2 at DIV_A (and so at GROUP), A1 ↔ B1 only at GROUP
+        const double div_a_revenue = value("DIV_A", "REVENUE") - 0.1 * value("A1", "REVENUE");
+        const double div_a_costs = value("DIV_A", "COSTS") - 0.2 * value("A2", "COSTS");
+        CHECK(group["DIV_A"].results[p].get_value("REVENUE") == Approx(div_a_revenue));
+        CHECK(group["DIV_A"].results[p].get_value("COSTS") == Approx(div_a_costs));
+        CHECK(group["DIV_A"].results[p].get_value("GROSS") == Approx(value("DIV_A", "GROSS")));
+        CHECK(group["GROUP"].results[p].get_value("REVENUE") ==
+              Approx(div_a_revenue + value("DIV_B", "REVENUE") - 0.05 * value("A1", "REVENUE")));
+        CHECK(group["GROUP"].results[p].get_value("COSTS") ==
+              Approx(div_a_costs + value("DIV_B", "COSTS") - 0.1 * value("B1", "COSTS")));
+        CHECK(group["GROUP"].results[p].get_value("OTHER_SCALED") ==
+              Approx(value("GROUP", "OTHER_SCALED") - 0.1 * value("B1", "COSTS")));
+    }
+
+    db->execute_update("UPDATE intercompany_elimination SET also_reduce = 'GROSS' WHERE entity_code = 'B1'", {});
+    CHECK_THROWS_AS(EliminationMatrix::query(*db), std::runtime_error);
+}
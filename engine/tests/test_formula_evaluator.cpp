@@ -6,10 +6,17 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include "core/formula_evaluator.h"
+#include "core/lane_evaluator.h"
+#include "core/formula_optimizer.h"
+#include "core/native_kernel.h"
+#include "core/tangent_evaluator.h"
+#include "core/time_series.h"
 #include "core/context.h"
 #include "core/ivalue_provider.h"
 #include <map>
 #include <cmath>
+#include <filesystem>
+#include <thread>
 
 using namespace finmodel::core;
 using Catch::Matchers::WithinAbs;
@@ -58,6 +65,55 @@ private:
     std::map<std::string, std::map<int, double>> period_values_;
 };
 
+/**
+ * Provider that stores values in slots (array-backed) like the engine providers
+ */
+class SlotValueProvider : public IValueProvider {
+public:
+    void set_value(const std::string& code, double value) {
+        int slot = resolve_slot(code);
+        values_[slot] = value;
+        present_[slot] = true;
+    }
+
+    double get_value(const std::string& code, const Context& ctx) const override {
+        auto it = index_.find(code);
+        if (it == index_.end() || !present_[it->second]) {
+            throw std::runtime_error("Variable not found: " + code);
+        }
+        return get_slot_value(it->second, ctx);
+    }
+
+    bool has_value(const std::string& code) const override {
+        auto it = index_.find(code);
+        return it != index_.end() && present_[it->second];
+    }
+
+    int resolve_slot(const std::string& code) override {
+        auto it = index_.find(code);
+        if (it != index_.end()) return it->second;
+        int slot = static_cast<int>(values_.size());
+        index_[code] = slot;
+        values_.push_back(0.0);
+        present_.push_back(false);
+        return slot;
+    }
+
+    bool has_slot_value(int slot) const override { return present_[slot]; }
+
+    double get_slot_value(int slot, const Context&) const override {
+        ++slot_reads;
+        return values_[slot];
+    }
+
+    mutable int slot_reads = 0;
+
+private:
+    std::map<std::string, int> index_;
+    std::vector<double> values_;
+    std::vector<bool> present_;
+};
+
 // ============================================================================
 // Basic Arithmetic Tests
 // ============================================================================
@@ -272,6 +328,74 @@ TEST_CASE("FormulaEvaluator - IF function", "[formula][functions]") {
     }
 }
 
+TEST_CASE("FormulaEvaluator - Lazy evaluation", "[formula][functions][lazy]") {
+    FormulaEvaluator eval;
+    SlotValueProvider slots;
+    slots.set_value("A", 5.0);
+    slots.set_value("B", 10.0);
+    slots.set_value("ZERO", 0.0);
+    std::vector<IValueProvider*> providers = {&slots};
+    Context ctx(1, 5, 1);
+
+    SECTION("IF only evaluates the taken branch") {
+        REQUIRE_THAT(eval.evaluate("IF(A > 0, B, MISSING)", providers, ctx), WithinAbs(10.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("IF(A < 0, B / ZERO, B * 2)", providers, ctx), WithinAbs(20.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("IF(ZERO, TAX_COMPUTE(A, \"US\"), A)", providers, ctx), WithinAbs(5.0, 1e-9));
+        REQUIRE_THROWS_AS(eval.evaluate("IF(A > 0, MISSING, B)", providers, ctx), std::runtime_error);
+
+        slots.slot_reads = 0;
+        eval.evaluate("IF(A > 0, B, A + B + A)", providers, ctx);
+        REQUIRE(slots.slot_reads == 2);  // A (condition) and B
+    }
+
+    SECTION("Nested IF") {
+        REQUIRE_THAT(eval.evaluate("IF(A > 10, 1, IF(B > 5, 2, 3)) + 1", providers, ctx), WithinAbs(3.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("IF(IF(A, ZERO, 1), 1, 2)", providers, ctx), WithinAbs(2.0, 1e-9));
+    }
+
+    SECTION("&& and || short-circuit") {
+        REQUIRE_THAT(eval.evaluate("A > 0 && B > 0", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("A > 0 && B", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("A > 0 && ZERO", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("ZERO && MISSING", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("A || MISSING", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("ZERO || ZERO", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THROWS_AS(eval.evaluate("A && MISSING", providers, ctx), std::runtime_error);
+    }
+
+    SECTION("&& binds tighter than ||") {
+        REQUIRE_THAT(eval.evaluate("1 || 0 && 0", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("(1 || 0) && 0", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("IF(A > 0 && B > 20 || ZERO == 0, 7, 8)", providers, ctx),
+                     WithinAbs(7.0, 1e-9));
+    }
+
+    SECTION("AND() and OR()") {
+        REQUIRE_THAT(eval.evaluate("AND(A, B, 1)", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("AND(A, ZERO, MISSING)", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("OR(ZERO, B, MISSING)", providers, ctx), WithinAbs(1.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("OR(ZERO)", providers, ctx), WithinAbs(0.0, 1e-9));
+    }
+
+    SECTION("Syntax errors") {
+        REQUIRE_THROWS_AS(eval.compile("A & B"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("A | B"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("A &&"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("AND()"), std::runtime_error);
+    }
+
+    SECTION("Jumps survive optimisation") {
+        auto shared = FormulaOptimizer::share_subexpressions({
+            eval.compile("IF(A > 0, A * B + 1, B)"),
+            eval.compile("A * B + 1 + IF(ZERO || A, 2 + 3, A * B + 1)")
+        });
+        REQUIRE(shared.shared_count == 1);
+        SubexpressionCache cache(shared.shared_count);
+        REQUIRE_THAT(eval.evaluate(*shared.formulas[0], providers, ctx, nullptr, &cache), WithinAbs(51.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate(*shared.formulas[1], providers, ctx, nullptr, &cache), WithinAbs(56.0, 1e-9));
+    }
+}
+
 TEST_CASE("FormulaEvaluator - Nested functions", "[formula][functions]") {
     FormulaEvaluator eval;
     MockValueProvider provider;
@@ -296,6 +420,81 @@ TEST_CASE("FormulaEvaluator - Nested functions", "[formula][functions]") {
     }
 }
 
+TEST_CASE("FormulaEvaluator - Aggregate and rounding functions", "[formula][functions]") {
+    FormulaEvaluator eval;
+    MockValueProvider provider;
+    Context ctx(1, 5, 1);
+    std::vector<IValueProvider*> providers = {&provider};
+
+    SECTION("SUM and AVG") {
+        REQUIRE_THAT(eval.evaluate("SUM(1, 2, 3)", providers, ctx), WithinAbs(6.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("SUM(5)", providers, ctx), WithinAbs(5.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("AVG(1, 2, 3, 6)", providers, ctx), WithinAbs(3.0, 1e-9));
+    }
+
+    SECTION("ROUND") {
+        REQUIRE_THAT(eval.evaluate("ROUND(2.5)", providers, ctx), WithinAbs(3.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("ROUND(-2.5)", providers, ctx), WithinAbs(-3.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("ROUND(3.14159, 2)", providers, ctx), WithinAbs(3.14, 1e-9));
+        REQUIRE_THAT(eval.evaluate("ROUND(1250, -2)", providers, ctx), WithinAbs(1300.0, 1e-9));
+    }
+
+    SECTION("CLAMP") {
+        REQUIRE_THAT(eval.evaluate("CLAMP(15, 0, 10)", providers, ctx), WithinAbs(10.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("CLAMP(-5, 0, 10)", providers, ctx), WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(eval.evaluate("CLAMP(5, 0, 10)", providers, ctx), WithinAbs(5.0, 1e-9));
+        REQUIRE_THROWS_AS(eval.evaluate("CLAMP(5, 10, 0)", providers, ctx), std::runtime_error);
+    }
+
+    SECTION("Arity is checked at compile time") {
+        REQUIRE_THROWS_AS(eval.compile("ROUND(1, 2, 3)"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("CLAMP(1, 2)"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("MIN(5)"), std::runtime_error);
+    }
+}
+
+TEST_CASE("FormulaEvaluator - Function registry", "[formula][functions]") {
+    FormulaEvaluator eval;
+    MockValueProvider provider;
+    Context ctx(1, 5, 1);
+    std::vector<IValueProvider*> providers = {&provider};
+
+    SECTION("Built-ins are resolved at compile time") {
+        auto compiled = eval.compile("MAX(REVENUE, 2) + FOO(3)");
+        REQUIRE(compiled->functions().size() == 2);
+        REQUIRE(compiled->functions()[0].builtin != nullptr);
+        REQUIRE(compiled->functions()[0].function_id == FunctionRegistry::FN_MAX);
+        REQUIRE(compiled->functions()[1].builtin == nullptr);
+    }
+
+    SECTION("Unregistered names go to the custom handler") {
+        int calls = 0;
+        FormulaEvaluator::CustomFunctionHandler custom = [&](const std::string& name, const std::vector<double>& args) {
+            ++calls;
+            if (name != "TRIPLE") throw std::runtime_error("not custom");
+            return args[0] * 3.0;
+        };
+        REQUIRE_THAT(eval.evaluate("TRIPLE(2) + MAX(1, 2)", providers, ctx, custom), WithinAbs(8.0, 1e-9));
+        REQUIRE(calls == 1);  // MAX never reaches the handler
+        REQUIRE_THROWS_AS(eval.evaluate("FOO(1)", providers, ctx, custom), std::runtime_error);
+    }
+
+    SECTION("Registered functions") {
+        auto before = eval.compile("SQUARE(3)");
+        REQUIRE(before->functions()[0].builtin == nullptr);
+
+        eval.register_function("SQUARE", 1, 1, [](const double* args, uint32_t) {
+            return args[0] * args[0];
+        });
+        REQUIRE(eval.cache_size() == 0);
+        REQUIRE_THAT(eval.evaluate("SQUARE(3) + 1", providers, ctx), WithinAbs(10.0, 1e-9));
+        REQUIRE_THROWS_AS(eval.compile("SQUARE(1, 2)"), std::runtime_error);
+
+        REQUIRE_THROWS_AS(eval.register_function("MIN", 2, 2, [](const double*, uint32_t) { return 0.0; }),
+                          std::invalid_argument);
+    }
+}
+
 // ============================================================================
 // Variable Tests
 // ============================================================================
@@ -427,7 +626,7 @@ TEST_CASE("FormulaEvaluator - Error handling", "[formula][errors]") {
 
     SECTION("Unknown function") {
         REQUIRE_THROWS_AS(eval.evaluate("SQRT(4)", providers, ctx), std::runtime_error);
-        REQUIRE_THROWS_AS(eval.evaluate("SUM(1, 2, 3)", providers, ctx), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.evaluate("PRODUCT(1, 2, 3)", providers, ctx), std::runtime_error);
     }
 
     SECTION("Invalid syntax") {
@@ -444,6 +643,62 @@ TEST_CASE("FormulaEvaluator - Error handling", "[formula][errors]") {
     }
 }
 
+/**
+ * Provider that claims every code but has no values: its misses are
+ * reported by find_value(), get_value() counts the messages it builds
+ */
+class MissingValueProvider : public IValueProvider {
+public:
+    double get_value(const std::string& code, const Context&) const override {
+        ++messages_built;
+        throw std::runtime_error("No value for " + code);
+    }
+    bool has_value(const std::string&) const override { return true; }
+    std::optional<double> find_value(const std::string&, const Context&) const override { return std::nullopt; }
+
+    mutable int messages_built = 0;
+};
+
+/**
+ * Provider with only the throwing API, as providers written before find_value()
+ */
+class ThrowingValueProvider : public IValueProvider {
+public:
+    double get_value(const std::string& code, const Context&) const override {
+        throw std::runtime_error("No value for " + code);
+    }
+    bool has_value(const std::string&) const override { return true; }
+};
+
+TEST_CASE("FormulaEvaluator - Misses fall through without errors", "[formula][errors]") {
+    FormulaEvaluator eval;
+    MissingValueProvider missing;
+    MockValueProvider provider;
+    provider.set_value("REVENUE", 1000.0);
+    Context ctx(1, 5, 1);
+
+    SECTION("A miss moves on to the next provider") {
+        std::vector<IValueProvider*> providers = {&missing, &provider};
+        REQUIRE_THAT(eval.evaluate("REVENUE * 2", providers, ctx), WithinAbs(2000.0, 1e-9));
+
+        FormulaBinding bound(eval.compile("REVENUE[t-1] + 1"), providers);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(1001.0, 1e-9));
+        REQUIRE(missing.messages_built == 0);
+    }
+
+    SECTION("Providers with only get_value() still fall through") {
+        ThrowingValueProvider throwing;
+        std::vector<IValueProvider*> providers = {&throwing, &provider};
+        REQUIRE_THAT(eval.evaluate("REVENUE", providers, ctx), WithinAbs(1000.0, 1e-9));
+        REQUIRE_FALSE(throwing.find_value("REVENUE", ctx).has_value());
+    }
+
+    SECTION("A value no provider has is still an error") {
+        std::vector<IValueProvider*> providers = {&missing};
+        REQUIRE_THROWS_AS(eval.evaluate("REVENUE", providers, ctx), std::runtime_error);
+    }
+}
+
 // ============================================================================
 // Dependency Extraction Tests
 // ============================================================================
@@ -504,6 +759,13 @@ TEST_CASE("FormulaEvaluator - Dependency extraction", "[formula][dependencies]")
         auto deps = eval.extract_dependencies("MIN(10, 20) + MAX(5, 15)");
         REQUIRE(deps.empty());
     }
+
+    SECTION("Nested calls, shifted references and string literals") {
+        auto deps = eval.extract_dependencies(
+            "TAX_COMPUTE(MAX(EBT, CASH[t-2]), \"EBT\") + CASH + driver:RATE * ABS(MIN(DEBT, 0))");
+        std::vector<std::string> expected = {"CASH", "CASH[t-1]", "DEBT", "EBT"};
+        REQUIRE(deps == expected);
+    }
 }
 
 // ============================================================================
@@ -593,3 +855,783 @@ TEST_CASE("FormulaEvaluator - Real-world formulas", "[formula][realworld]") {
         );
     }
 }
+
+// ============================================================================
+// Compiled Formula Tests
+// ============================================================================
+
+TEST_CASE("FormulaEvaluator - Compiled formulas", "[formula][compiled]") {
+    FormulaEvaluator eval;
+    MockValueProvider provider;
+    std::vector<IValueProvider*> providers = {&provider};
+
+    provider.set_value("REVENUE", 1000.0);
+    provider.set_value("COGS", 600.0);
+
+    SECTION("Compile once, evaluate many times") {
+        auto compiled = eval.compile("MAX(0, REVENUE - COGS) * 2");
+        REQUIRE(compiled->variables().size() == 2);
+
+        for (int period = 1; period <= 12; ++period) {
+            Context ctx(1, period, 1);
+            REQUIRE_THAT(eval.evaluate(*compiled, providers, ctx), WithinAbs(800.0, 1e-9));
+        }
+
+        provider.set_value("COGS", 1200.0);
+        Context ctx(1, 1, 1);
+        REQUIRE_THAT(eval.evaluate(*compiled, providers, ctx), WithinAbs(0.0, 1e-9));
+    }
+
+    SECTION("Formula text is compiled only once") {
+        Context ctx(1, 5, 1);
+        auto first = eval.compile("REVENUE - COGS");
+        auto second = eval.compile("REVENUE - COGS");
+        REQUIRE(first.get() == second.get());
+
+        eval.evaluate("REVENUE - COGS", providers, ctx);
+        REQUIRE(eval.cache_size() == 1);
+
+        eval.clear_cache();
+        REQUIRE(eval.cache_size() == 0);
+    }
+
+    SECTION("Repeated references share one variable slot") {
+        auto compiled = eval.compile("REVENUE + REVENUE * 0.1 + REVENUE[t-1]");
+        REQUIRE(compiled->variables().size() == 2);
+    }
+
+    SECTION("Syntax errors are raised at compile time") {
+        REQUIRE_THROWS_AS(eval.compile("(2 + 3"), std::runtime_error);
+        REQUIRE_THROWS_AS(eval.compile("2 +"), std::runtime_error);
+        REQUIRE(eval.cache_size() == 0);
+    }
+
+    SECTION("Runtime errors are raised at evaluation time") {
+        Context ctx(1, 5, 1);
+        auto div = eval.compile("REVENUE / (COGS - 600)");
+        REQUIRE_THROWS_AS(eval.evaluate(*div, providers, ctx), std::runtime_error);
+
+        auto missing = eval.compile("REVENUE + UNKNOWN");
+        REQUIRE_THROWS_AS(eval.evaluate(*missing, providers, ctx), std::runtime_error);
+    }
+}
+
+TEST_CASE("FormulaEvaluator - Bound formulas", "[formula][compiled]") {
+    FormulaEvaluator eval;
+    SlotValueProvider slots;
+    MockValueProvider strings;
+    std::vector<IValueProvider*> providers = {&slots, &strings};
+    Context ctx(1, 5, 1);
+
+    SECTION("Slot providers are read by slot") {
+        slots.set_value("REVENUE", 1000.0);
+        slots.set_value("COGS", 600.0);
+
+        FormulaBinding bound(eval.compile("REVENUE - COGS"), providers);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(400.0, 1e-9));
+        REQUIRE(slots.slot_reads == 2);
+
+        // Values set after binding are picked up through the same slots
+        slots.set_value("COGS", 700.0);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(300.0, 1e-9));
+    }
+
+    SECTION("Provider order is preserved") {
+        strings.set_value("OPEX", 50.0);
+        FormulaBinding bound(eval.compile("OPEX * 2"), providers);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(100.0, 1e-9));
+
+        // Once the first provider has the value it wins
+        slots.set_value("OPEX", 10.0);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(20.0, 1e-9));
+    }
+
+    SECTION("Matches unbound evaluation") {
+        slots.set_value("A", 3.0);
+        strings.set_value("B", 4.0);
+        const std::string formula = "IF(A < B, MAX(A, B) ^ 2, -A)";
+        FormulaBinding bound(eval.compile(formula), providers);
+        REQUIRE_THAT(eval.evaluate(bound, ctx),
+                     WithinAbs(eval.evaluate(formula, providers, ctx), 1e-12));
+    }
+
+    SECTION("Missing variables still throw") {
+        FormulaBinding bound(eval.compile("UNKNOWN + 1"), providers);
+        REQUIRE_THROWS_AS(eval.evaluate(bound, ctx), std::runtime_error);
+    }
+}
+
+/**
+ * Slot provider that resolves statically: serves only codes it was told
+ * about, and hands out its arrays for [t] lookups
+ */
+class DirectValueProvider : public IValueProvider {
+public:
+    void set_value(const std::string& code, double value) {
+        int slot = resolve_slot(code);
+        values_[slot] = value;
+        present_[slot] = 1;
+        served_[slot] = 1;
+    }
+    void serve(const std::string& code) { served_[resolve_slot(code)] = 1; }
+
+    double get_value(const std::string& code, const Context& ctx) const override {
+        return get_slot_value(index_.at(code), ctx);
+    }
+    bool has_value(const std::string& code) const override {
+        auto it = index_.find(code);
+        return it != index_.end() && present_[it->second];
+    }
+    int resolve_slot(const std::string& code) override {
+        auto [it, inserted] = index_.emplace(code, static_cast<int>(values_.size()));
+        if (inserted) {
+            values_.push_back(0.0);
+            present_.push_back(0);
+            served_.push_back(0);
+        }
+        return it->second;
+    }
+    bool has_slot_value(int slot) const override { ++virtual_calls; return present_[slot]; }
+    double get_slot_value(int slot, const Context&) const override {
+        ++virtual_calls;
+        if (!present_[slot]) throw std::runtime_error("not present");
+        return values_[slot];
+    }
+    bool slot_can_have_value(int slot) const override { return served_[slot] != 0; }
+    size_t direct_arrays(int time_index, SlotArrays* out) const override {
+        if (time_index != 0) return 0;
+        out[0] = {&values_, &present_};
+        return 1;
+    }
+
+    mutable int virtual_calls = 0;
+
+private:
+    std::map<std::string, int> index_;
+    std::vector<double> values_;
+    std::vector<uint8_t> present_;
+    std::vector<uint8_t> served_;
+};
+
+TEST_CASE("FormulaEvaluator - Statically resolved candidates", "[formula][compiled]") {
+    FormulaEvaluator eval;
+    DirectValueProvider direct;
+    SlotValueProvider slots;
+    std::vector<IValueProvider*> providers = {&direct, &slots};
+    Context ctx(1, 5, 1);
+
+    direct.set_value("REVENUE", 1000.0);
+    direct.serve("COGS");
+    slots.set_value("COGS", 600.0);
+    slots.set_value("OPEX", 50.0);
+
+    FormulaBinding bound(eval.compile("REVENUE - COGS - OPEX"), providers);
+
+    SECTION("Arrays are read without provider calls") {
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(350.0, 1e-9));
+        REQUIRE(direct.virtual_calls == 0);
+        REQUIRE(bound.candidates_end(2) - bound.candidates_begin(2) == 1);  // OPEX: direct can't serve it
+
+        // A value appearing later in a served slot wins, as with virtual lookups
+        direct.set_value("COGS", 700.0);
+        REQUIRE_THAT(eval.evaluate(bound, ctx), WithinAbs(250.0, 1e-9));
+    }
+
+    SECTION("Other time indices use the slot API") {
+        FormulaBinding shifted(eval.compile("REVENUE[t-1]"), providers);
+        REQUIRE_THAT(eval.evaluate(shifted, ctx), WithinAbs(1000.0, 1e-9));
+        REQUIRE(direct.virtual_calls == 2);
+    }
+}
+
+TEST_CASE("Context - Plain key with separately owned run state", "[formula][context]") {
+    static_assert(std::is_trivially_copyable_v<Context>, "Context must stay a plain key");
+
+    Context ctx(1, 5, 7);
+    Context prior = ctx.with_prior_period();
+    REQUIRE(prior.get_effective_period_id() == 4);
+    REQUIRE(ctx.with_time_offset(-3).get_effective_period_id() == 2);
+    REQUIRE(ctx.time_index == 0);
+
+    RunState state;
+    state.cache_value("REVENUE", 1000.0);
+    REQUIRE(state.has_cached_value("REVENUE"));
+    REQUIRE(state.get_cached_value("REVENUE") == 1000.0);
+    state.clear_cache();
+    REQUIRE_FALSE(state.has_cached_value("REVENUE"));
+    REQUIRE_THROWS_AS(state.get_cached_value("REVENUE"), std::out_of_range);
+}
+
+TEST_CASE("FormulaOptimizer - Constant folding", "[formula][optimizer]") {
+    FormulaEvaluator eval;
+    MockValueProvider provider;
+    provider.set_value("REVENUE", 1000.0);
+    std::vector<IValueProvider*> providers = {&provider};
+    Context ctx(1, 5, 1);
+
+    SECTION("Literal-only arithmetic folds to one constant") {
+        auto compiled = eval.compile("(1 + 2) * 4 - 2 ^ 3");
+        REQUIRE(compiled->code().size() == 1);
+        REQUIRE(compiled->code()[0].op == OpCode::PUSH_CONST);
+        REQUIRE_THAT(eval.evaluate(*compiled, providers, ctx), WithinAbs(4.0, 1e-12));
+    }
+
+    SECTION("Constant parts of mixed expressions fold") {
+        auto compiled = eval.compile("REVENUE * (1 - 0.25) + MAX(2, 3)");
+        // LOAD_VAR, PUSH_CONST, MUL, PUSH_CONST, ADD
+        REQUIRE(compiled->code().size() == 5);
+        REQUIRE_THAT(eval.evaluate(*compiled, providers, ctx), WithinAbs(753.0, 1e-9));
+    }
+
+    SECTION("Runtime errors are not folded away") {
+        auto div = eval.compile("REVENUE + 1 / 0");
+        REQUIRE_THROWS_AS(eval.evaluate(*div, providers, ctx), std::runtime_error);
+
+        auto clamp = eval.compile("CLAMP(1, 5, 0)");
+        REQUIRE_THROWS_AS(eval.evaluate(*clamp, providers, ctx), std::runtime_error);
+    }
+}
+
+TEST_CASE("FormulaEvaluator - Zero-preserving formulas", "[formula][sparse]") {
+    FormulaEvaluator eval;
+    auto preserves = [&eval](const std::string& formula) {
+        return FormulaEvaluator::preserves_zero(*eval.compile(formula));
+    };
+
+    CHECK(preserves("A + B - C"));
+    CHECK(preserves("A * driver:RATE"));
+    CHECK(preserves("-A * (B + 3)"));
+    CHECK(preserves("MAX(0, A) / 12"));
+    CHECK(preserves("IF(A > 0, A, 0)"));
+    CHECK(preserves("CASH[t-1] + NET"));
+    CHECK(preserves("0"));
+
+    CHECK_FALSE(preserves("A + 1"));
+    CHECK_FALSE(preserves("A / B"));              // Division by zero raises
+    CHECK_FALSE(preserves("IF(A == 0, 1, A)"));
+    CHECK_FALSE(preserves("A ^ 0"));
+    CHECK_FALSE(preserves("MY_CUSTOM(A)"));       // Unknown to the compiler
+}
+
+TEST_CASE("FormulaOptimizer - Shared subexpressions", "[formula][optimizer]") {
+    FormulaEvaluator eval;
+    SlotValueProvider slots;
+    slots.set_value("REVENUE", 1000.0);
+    slots.set_value("TAX_RATE", 0.25);
+    slots.set_value("COGS", 400.0);
+    std::vector<IValueProvider*> providers = {&slots};
+    Context ctx(1, 5, 1);
+
+    std::vector<std::string> sources = {
+        "REVENUE * TAX_RATE",
+        "REVENUE - REVENUE * TAX_RATE",
+        "MAX(0, REVENUE * TAX_RATE - COGS) + COGS"
+    };
+    std::vector<std::shared_ptr<const CompiledFormula>> formulas;
+    for (const auto& src : sources) {
+        formulas.push_back(eval.compile(src));
+    }
+
+    auto shared = FormulaOptimizer::share_subexpressions(formulas);
+    REQUIRE(shared.shared_count == 1);
+    REQUIRE(shared.formulas.size() == formulas.size());
+
+    SECTION("Results match unshared evaluation") {
+        SubexpressionCache cache(shared.shared_count);
+        for (size_t i = 0; i < formulas.size(); ++i) {
+            REQUIRE_THAT(eval.evaluate(*shared.formulas[i], providers, ctx, nullptr, &cache),
+                         WithinAbs(eval.evaluate(*formulas[i], providers, ctx), 1e-12));
+        }
+    }
+
+    SECTION("Shared subexpression is evaluated once per pass") {
+        SubexpressionCache cache(shared.shared_count);
+        for (const auto& formula : shared.formulas) {
+            eval.evaluate(FormulaBinding(formula, providers), ctx, nullptr, &cache);
+        }
+        // 2 loads for the first REVENUE * TAX_RATE, 1 REVENUE in the
+        // second formula, 2 COGS in the third
+        REQUIRE(slots.slot_reads == 5);
+
+        // Cleared cache picks up new inputs
+        cache.clear();
+        slots.set_value("TAX_RATE", 0.5);
+        REQUIRE_THAT(eval.evaluate(*shared.formulas[0], providers, ctx, nullptr, &cache),
+                     WithinAbs(500.0, 1e-12));
+    }
+
+    SECTION("Without a cache shared subexpressions evaluate in place") {
+        REQUIRE_THAT(eval.evaluate(*shared.formulas[1], providers, ctx), WithinAbs(750.0, 1e-12));
+    }
+
+    SECTION("Custom functions are never shared") {
+        auto custom = FormulaOptimizer::share_subexpressions({eval.compile("RAND(1) + REVENUE"),
+                                                              eval.compile("RAND(1) + REVENUE")});
+        REQUIRE(custom.shared_count == 0);
+    }
+}
+
+TEST_CASE("LaneEvaluator - Scenario lanes", "[formula][lanes]") {
+    FormulaEvaluator eval;
+    LaneEvaluator lanes(4);
+
+    std::map<std::string, LaneArray> inputs;
+    inputs["REVENUE"] = (LaneArray(4) << 1000.0, 2000.0, 500.0, 0.0).finished();
+    inputs["COGS"] = (LaneArray(4) << 600.0, 2500.0, 100.0, 50.0).finished();
+    auto load = [&](const VariableRef& var, uint32_t, LaneArray& out) {
+        auto it = inputs.find(var.code);
+        if (it == inputs.end()) {
+            throw FormulaEvaluator::variable_not_found(var);
+        }
+        out = it->second;
+    };
+
+    // Reference: scalar evaluation of each lane
+    auto scalar_lane = [&](const std::string& formula, Eigen::Index lane) {
+        MockValueProvider provider;
+        for (const auto& [code, values] : inputs) {
+            provider.set_value(code, values[lane]);
+        }
+        std::vector<IValueProvider*> providers = {&provider};
+        return eval.evaluate(formula, providers, Context(1, 1, 1));
+    };
+
+    SECTION("Lane results match scalar evaluation") {
+        for (const std::string formula : {
+                 "REVENUE - COGS",
+                 "MAX(0, REVENUE - COGS) * 0.25",
+                 "IF(REVENUE > COGS, REVENUE, -COGS)",
+                 "ABS(COGS - REVENUE) ^ 0.5 + (REVENUE >= 1000)",
+                 "MIN(REVENUE, COGS) / 10",
+                 "SUM(REVENUE, COGS, 1) + AVG(REVENUE, COGS)",
+                 "ROUND(REVENUE / 3, 1) + CLAMP(COGS, 100, 1000)",
+                 "IF(REVENUE > 600, IF(COGS > 500, 1, 2), REVENUE && COGS)",
+                 "(REVENUE > 100 || COGS > 100) + AND(REVENUE, COGS < 1000)"}) {
+            LaneArray result = lanes.evaluate(*eval.compile(formula), load);
+            REQUIRE(result.size() == 4);
+            for (Eigen::Index lane = 0; lane < 4; ++lane) {
+                REQUIRE_THAT(result[lane], WithinAbs(scalar_lane(formula, lane), 1e-9));
+            }
+        }
+    }
+
+    SECTION("Custom functions are called per lane") {
+        int calls = 0;
+        FormulaEvaluator::CustomFunctionHandler custom = [&](const std::string& name, const std::vector<double>& args) {
+            if (name != "DOUBLE") throw std::runtime_error("not custom");
+            ++calls;
+            return args[0] * 2.0;
+        };
+        LaneArray result = lanes.evaluate(*eval.compile("DOUBLE(COGS) + MAX(REVENUE, 0)"), load, custom);
+        REQUIRE(calls == 4);
+        REQUIRE_THAT(result[1], WithinAbs(7000.0, 1e-9));
+    }
+
+    SECTION("Untaken branches are skipped when all lanes agree") {
+        LaneArray result = lanes.evaluate(*eval.compile("IF(COGS > 0, REVENUE, COGS / 0)"), load);
+        REQUIRE_THAT(result[2], WithinAbs(500.0, 1e-9));
+        REQUIRE_THROWS_AS(lanes.evaluate(*eval.compile("IF(REVENUE > 0, 1, COGS / 0)"), load),
+                          std::runtime_error);  // Lane 3 has REVENUE == 0
+    }
+
+    SECTION("Errors in lanes a mixed branch discards are ignored") {
+        // Lane 3 has REVENUE == 0: the scalar evaluator never divides there
+        for (const std::string formula : {
+                 "IF(REVENUE != 0, COGS / REVENUE, 0)",
+                 "IF(REVENUE = 0, -1, IF(COGS > 100, COGS / REVENUE, 2))",
+                 "REVENUE != 0 && COGS / REVENUE > 0.5",
+                 "REVENUE = 0 || COGS / REVENUE > 0.5",
+                 "IF(REVENUE > 0, CLAMP(COGS, 0, REVENUE), 0)"}) {
+            CAPTURE(formula);
+            LaneArray result = lanes.evaluate(*eval.compile(formula), load);
+            for (Eigen::Index lane = 0; lane < 4; ++lane) {
+                REQUIRE_THAT(result[lane], WithinAbs(scalar_lane(formula, lane), 1e-9));
+            }
+        }
+        REQUIRE_THROWS_AS(lanes.evaluate(*eval.compile("IF(REVENUE = 0, COGS / REVENUE, 0)"), load),
+                          std::runtime_error);   // Taken by lane 3
+    }
+
+    SECTION("Tax strategies in lanes a mixed branch discards are ignored") {
+        // The strategy refuses a loss, which only lanes 1 and 3 (COGS > REVENUE) have
+        FormulaEvaluator::CustomFunctionHandler tax = [](const std::string& name, const std::vector<double>& args) {
+            if (name != "TAX_COMPUTE:US" || args.size() != 1) throw std::runtime_error("unexpected call " + name);
+            if (args[0] < 0.0) throw std::runtime_error("no tax on a loss");
+            return args[0] * 0.25;
+        };
+        LaneArray result = lanes.evaluate(
+            *eval.compile("IF(REVENUE > COGS, TAX_COMPUTE(REVENUE - COGS, \"US\"), 0)"), load, tax);
+        REQUIRE_THAT(result[0], WithinAbs(100.0, 1e-9));
+        REQUIRE_THAT(result[1], WithinAbs(0.0, 1e-9));
+        REQUIRE_THAT(result[2], WithinAbs(100.0, 1e-9));
+        REQUIRE_THAT(result[3], WithinAbs(0.0, 1e-9));
+        REQUIRE_THROWS_AS(lanes.evaluate(*eval.compile("TAX_COMPUTE(REVENUE - COGS, \"US\")"), load, tax),
+                          std::runtime_error);
+    }
+
+    SECTION("Errors in any lane throw") {
+        REQUIRE_THROWS_AS(lanes.evaluate(*eval.compile("COGS / REVENUE"), load), std::runtime_error);
+        REQUIRE_THROWS_AS(lanes.evaluate(*eval.compile("UNKNOWN + 1"), load), std::runtime_error);
+    }
+}
+
+TEST_CASE("TangentEvaluator - Dual numbers", "[formula][tangent]") {
+    FormulaEvaluator eval;
+    TangentEvaluator tangents(2);   // d/dREVENUE, d/dCOGS
+
+    std::map<std::string, double> inputs = {{"REVENUE", 1200.0}, {"COGS", 700.0}, {"RATE", 0.3}};
+    auto load = [&](const VariableRef& var, uint32_t, double& value, LaneArray& tangent) {
+        value = inputs.at(var.code);
+        tangent.setZero();
+        if (var.code == "REVENUE") tangent[0] = 1.0;
+        if (var.code == "COGS") tangent[1] = 1.0;
+    };
+
+    // Brackets: 10% up to 250, 40% above
+    FormulaEvaluator::CustomFunctionHandler custom = [](const std::string& name, const std::vector<double>& args) {
+        if (name == "DOUBLE") return args[0] * 2.0;
+        if (name.rfind("TAX_COMPUTE", 0) == 0) {
+            return args[0] <= 250.0 ? 0.1 * args[0] : 25.0 + 0.4 * (args[0] - 250.0);
+        }
+        throw std::runtime_error("not custom");
+    };
+
+    // Reference: central differences of the scalar evaluation
+    auto scalar = [&](const std::string& formula) {
+        MockValueProvider provider;
+        for (const auto& [code, value] : inputs) {
+            provider.set_value(code, value);
+        }
+        std::vector<IValueProvider*> providers = {&provider};
+        return eval.evaluate(formula, providers, Context(1, 1, 1), custom);
+    };
+    auto bumped = [&](const std::string& formula, const std::string& code) {
+        const double base = inputs[code];
+        inputs[code] = base + 1e-4;
+        const double up = scalar(formula);
+        inputs[code] = base - 1e-4;
+        const double down = scalar(formula);
+        inputs[code] = base;
+        return (up - down) / 2e-4;
+    };
+
+    SECTION("Values and derivatives match the scalar evaluator") {
+        for (const std::string formula : {
+                 "REVENUE - COGS",
+                 "REVENUE * (1 - RATE) - COGS * RATE",
+                 "REVENUE / COGS",
+                 "REVENUE ^ 2 / COGS + 2 ^ (COGS / 1000)",
+                 "MAX(0, REVENUE - COGS) * 0.25 + MIN(REVENUE, COGS)",
+                 "IF(REVENUE > COGS, REVENUE * COGS, -COGS)",
+                 "ABS(COGS - REVENUE) + (REVENUE >= 1000) + (COGS > 0 && REVENUE > 0)",
+                 "SUM(REVENUE, COGS, 1) + AVG(REVENUE, COGS)",
+                 "ROUND(REVENUE / 3, 1) + CLAMP(COGS, 100, 1000) + CLAMP(REVENUE, 0, 1000)",
+                 "DOUBLE(COGS) - TAX_COMPUTE(REVENUE - COGS, \"US\")"}) {
+            CAPTURE(formula);
+            LaneArray d(2);
+            const double value = tangents.evaluate(*eval.compile(formula), load, d, custom);
+            REQUIRE_THAT(value, WithinAbs(scalar(formula), 1e-9));
+            REQUIRE_THAT(d[0], WithinAbs(bumped(formula, "REVENUE"), 1e-5));
+            REQUIRE_THAT(d[1], WithinAbs(bumped(formula, "COGS"), 1e-5));
+        }
+    }
+
+    SECTION("Kinks take a one-sided derivative") {
+        inputs["COGS"] = 1200.0;
+        LaneArray d(2);
+        tangents.evaluate(*eval.compile("MAX(REVENUE, COGS)"), load, d);
+        CHECK(d[0] == 1.0);   // Tie: the first argument
+        CHECK(d[1] == 0.0);
+        tangents.evaluate(*eval.compile("ABS(REVENUE - COGS)"), load, d);
+        CHECK((d == 0.0).all());
+
+        // TAX_COMPUTE at a bracket threshold: the rate of the bracket above
+        inputs["COGS"] = 950.0;
+        tangents.evaluate(*eval.compile("TAX_COMPUTE(REVENUE - COGS, \"US\")"), load, d, custom);
+        CHECK_THAT(d[0], WithinAbs(0.4, 1e-6));
+        CHECK_THAT(d[1], WithinAbs(-0.4, 1e-6));
+    }
+
+    SECTION("Errors match the scalar evaluator") {
+        REQUIRE_THROWS_AS(TangentEvaluator(0), std::invalid_argument);
+        LaneArray d(2);
+        REQUIRE_THROWS_AS(tangents.evaluate(*eval.compile("REVENUE / (COGS - 700)"), load, d), std::runtime_error);
+        REQUIRE_THROWS_AS(tangents.evaluate(*eval.compile("TAX_COMPUTE(REVENUE, \"US\")"), load, d),
+                          std::runtime_error);
+        // An untaken branch isn't evaluated
+        REQUIRE_NOTHROW(tangents.evaluate(*eval.compile("IF(COGS > 0, REVENUE, COGS / 0)"), load, d));
+        CHECK(d[0] == 1.0);
+    }
+}
+
+TEST_CASE("NativeKernel - Compiled calculation order", "[formula][native]") {
+    FormulaEvaluator eval;
+    MockValueProvider provider;
+    provider.set_value("REVENUE", 1000.0);
+    provider.set_value("COGS", 400.0);
+    provider.set_value("TAX_RATE", 0.25);
+    std::vector<IValueProvider*> providers = {&provider};
+    Context ctx(1, 5, 1);
+
+    NativeKernelOptions options;
+    options.cache_dir = (std::filesystem::temp_directory_path() / "finmodel_kernels_test").string();
+    std::filesystem::remove_all(options.cache_dir);
+
+    // State: [REVENUE, COGS, TAX_RATE, outputs...]
+    std::vector<std::string> sources = {
+        "REVENUE - COGS",
+        "IF(REVENUE > 0 && COGS < REVENUE, ROUND(COGS / REVENUE, 2), 0)",
+        "MAX(0, (REVENUE - COGS) * TAX_RATE) + MIN(COGS, 100) + SUM(1, 2, 3) + AVG(REVENUE, COGS)",
+        "CLAMP(TAX_RATE, 0, 1) ^ 2 + ABS(-COGS) + (COGS >= 400 || REVENUE < 0)"
+    };
+    std::vector<NativeKernel::Formula> formulas;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        auto compiled = eval.compile(sources[i]);
+        NativeKernel::Formula formula{compiled, static_cast<uint32_t>(3 + i), {}};
+        for (const auto& var : compiled->variables()) {
+            formula.variable_slots.push_back(var.code == "REVENUE" ? 0 : var.code == "COGS" ? 1 : 2);
+        }
+        formulas.push_back(formula);
+    }
+
+    SECTION("Results match the interpreter") {
+        auto kernel = NativeKernel::build(formulas, 0, options);
+        std::vector<double> state = {1000.0, 400.0, 0.25, 0.0, 0.0, 0.0, 0.0};
+        REQUIRE(kernel->run(state.data()) == 0);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            REQUIRE(state[3 + i] == eval.evaluate(sources[i], providers, ctx));
+        }
+    }
+
+    SECTION("Libraries are cached on disk") {
+        auto first = NativeKernel::build(formulas, 0, options);
+        auto written = std::filesystem::last_write_time(first->library_path());
+        auto second = NativeKernel::build(formulas, 0, options);
+        REQUIRE(second->library_path() == first->library_path());
+        REQUIRE(std::filesystem::last_write_time(second->library_path()) == written);
+    }
+
+    SECTION("Only libraries private to this user are loaded") {
+        namespace fs = std::filesystem;
+        auto first = NativeKernel::build(formulas, 0, options);
+        CHECK((fs::status(options.cache_dir).permissions() & (fs::perms::group_all | fs::perms::others_all)) ==
+              fs::perms::none);
+        CHECK((fs::status(first->library_path()).permissions() & (fs::perms::group_write | fs::perms::others_write)) ==
+              fs::perms::none);
+
+        // A library others could have replaced is refused, as is a shared directory
+        fs::permissions(first->library_path(), fs::perms::group_write, fs::perm_options::add);
+        REQUIRE_THROWS_AS(NativeKernel::build(formulas, 0, options), std::runtime_error);
+        fs::remove(first->library_path());
+        fs::permissions(options.cache_dir, fs::perms::others_write, fs::perm_options::add);
+        REQUIRE_THROWS_AS(NativeKernel::build(formulas, 0, options), std::runtime_error);
+        fs::permissions(options.cache_dir, fs::perms::others_write, fs::perm_options::remove);
+
+        // No shell: any directory name works
+        NativeKernelOptions quoted = options;
+        quoted.cache_dir = (fs::path(options.cache_dir) / "it's; a \"dir\"").string();
+        auto kernel = NativeKernel::build(formulas, 0, quoted);
+        std::vector<double> state = {1000.0, 400.0, 0.25, 0.0, 0.0, 0.0, 0.0};
+        REQUIRE(kernel->run(state.data()) == 0);
+        REQUIRE(state[3] == 600.0);
+    }
+
+    SECTION("Earlier results and shared subexpressions feed later formulas") {
+        auto gross = eval.compile("REVENUE - COGS");
+        auto shared = FormulaOptimizer::share_subexpressions({eval.compile("GROSS * TAX_RATE + 1"),
+                                                              eval.compile("GROSS * TAX_RATE + 2")});
+        REQUIRE(shared.shared_count == 1);
+        std::vector<NativeKernel::Formula> chained = {
+            {gross, 3, {0, 1}},
+            {shared.formulas[0], 4, {3, 2}},
+            {shared.formulas[1], 5, {3, 2}}
+        };
+        auto kernel = NativeKernel::build(chained, shared.shared_count, options);
+        std::vector<double> state = {1000.0, 400.0, 0.25, 0.0, 0.0, 0.0};
+        REQUIRE(kernel->run(state.data()) == 0);
+        REQUIRE(state[4] == 151.0);
+        REQUIRE(state[5] == 152.0);
+    }
+
+    SECTION("Division by zero reports the formula") {
+        std::vector<NativeKernel::Formula> dividing = {
+            {eval.compile("REVENUE + 1"), 3, {0}},
+            {eval.compile("REVENUE / COGS"), 4, {0, 1}}
+        };
+        auto kernel = NativeKernel::build(dividing, 0, options);
+        std::vector<double> state = {1000.0, 0.0, 0.0, 0.0, 0.0};
+        REQUIRE(kernel->run(state.data()) == 2);
+    }
+
+    SECTION("Formulas spanning lines stay in their comment") {
+        // The text after the line break would otherwise be code of the kernel
+        const std::string source = "REVENUE\n    - COGS\r\n+ 1";
+        std::vector<NativeKernel::Formula> multiline = {{eval.compile(source), 3, {0, 1}}};
+        std::vector<BuiltinFunction> builtins;
+        const std::string code = NativeKernel::generate_source(multiline, 0, builtins);
+        CHECK(code.find("// REVENUE     - COGS  + 1\n") != std::string::npos);
+        CHECK(code.find("\n    - COGS") == std::string::npos);
+        auto kernel = NativeKernel::build(multiline, 0, options);
+        std::vector<double> state = {1000.0, 400.0, 0.0, 0.0};
+        REQUIRE(kernel->run(state.data()) == 0);
+        REQUIRE(state[3] == 601.0);
+    }
+
+    SECTION("Custom functions can't be lowered") {
+        std::vector<BuiltinFunction> builtins;
+        REQUIRE_THROWS_AS(NativeKernel::generate_source({{eval.compile("RAND(1)"), 0, {}}}, 0, builtins),
+                          std::invalid_argument);
+    }
+
+    SECTION("Lane kernels run the formulas lane by lane") {
+        LaneKernelOptions lane_options;
+        lane_options.cache_dir = options.cache_dir;
+        auto kernel = NativeKernel::build_lanes(formulas, 0, lane_options);
+
+        // Slot-major: slot s of lane l at state[s * lanes + l]
+        const size_t lanes = 3;
+        const size_t slots = 3 + sources.size();
+        const double revenue[lanes] = {1000.0, 0.0, -50.0};
+        std::vector<double> state(slots * lanes, 0.0);
+        for (size_t l = 0; l < lanes; ++l) {
+            state[0 * lanes + l] = revenue[l];
+            state[1 * lanes + l] = 400.0;
+            state[2 * lanes + l] = 0.25;
+        }
+        REQUIRE(kernel->run_lanes(state.data(), slots, lanes) == 0);
+        for (size_t l = 0; l < lanes; ++l) {
+            provider.set_value("REVENUE", revenue[l]);
+            for (size_t i = 0; i < sources.size(); ++i) {
+                CHECK(state[(3 + i) * lanes + l] == eval.evaluate(sources[i], providers, ctx));
+            }
+        }
+
+        std::vector<NativeKernel::Formula> dividing = {{eval.compile("REVENUE / COGS"), 2, {0, 1}}};
+        auto divide = NativeKernel::build_lanes(dividing, 0, lane_options);
+        std::vector<double> zero_in_one_lane = {1.0, 2.0, 4.0, 0.0, 0.0, 0.0};
+        REQUIRE(divide->run_lanes(zero_in_one_lane.data(), 3, 2) == 1);
+    }
+
+    SECTION("Device lane kernels only inline built-ins") {
+        std::vector<BuiltinFunction> builtins;
+        REQUIRE_NOTHROW(NativeKernel::generate_lane_source(formulas, 0, LaneDevice::HOST, builtins));
+        REQUIRE_FALSE(builtins.empty());
+        REQUIRE_THROWS_AS(NativeKernel::generate_lane_source(formulas, 0, LaneDevice::CUDA, builtins),
+                          std::invalid_argument);
+        REQUIRE_NOTHROW(NativeKernel::generate_lane_source({formulas[0], formulas[2]}, 0, LaneDevice::CUDA,
+                                                           builtins));
+
+        // Without a CUDA toolchain the build fails rather than running elsewhere
+        LaneKernelOptions lane_options;
+        lane_options.cache_dir = options.cache_dir;
+        lane_options.device = LaneDevice::CUDA;
+        lane_options.device_compiler = "finmodel-no-such-nvcc";
+        REQUIRE_THROWS_AS(NativeKernel::build_lanes({formulas[0]}, 0, lane_options), std::runtime_error);
+    }
+
+    std::filesystem::remove_all(options.cache_dir);
+}
+
+TEST_CASE("FormulaEvaluator - Shared between threads", "[formula][threads]") {
+    const FormulaEvaluator eval;
+    MockValueProvider provider;
+    provider.set_value("REVENUE", 1000.0);
+    provider.set_value("COGS", 400.0);
+    std::vector<IValueProvider*> providers = {&provider};
+
+    constexpr int kThreads = 8;
+    constexpr int kFormulas = 50;
+    std::vector<int> mismatches(kThreads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&, t] {
+            Context ctx(t, 5, 1);
+            for (int i = 0; i < kFormulas; ++i) {
+                // Same texts in every thread, so compiles race on the cache
+                std::string formula = "IF(REVENUE > COGS, REVENUE - COGS, 0) * " + std::to_string(i);
+                if (eval.evaluate(formula, providers, ctx) != 600.0 * i) {
+                    ++mismatches[t];
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (int t = 0; t < kThreads; ++t) {
+        REQUIRE(mismatches[t] == 0);
+    }
+    REQUIRE(eval.cache_size() == static_cast<size_t>(kFormulas));
+}
+
+TEST_CASE("FormulaEvaluator - Trailing windows and growth", "[formula][time_series]") {
+    FormulaEvaluator eval;
+
+    SECTION("A window compiles to one variable over earlier periods") {
+        auto compiled = eval.compile("SUM_WINDOW(REVENUE, 4) + AVG_WINDOW( COSTS ,12) + SUM_WINDOW(REVENUE,4)");
+        REQUIRE(compiled->variables().size() == 2);
+        CHECK(compiled->variables()[0].code == "SUM_WINDOW(REVENUE,4)");
+        CHECK(compiled->variables()[1].code == "AVG_WINDOW(COSTS,12)");
+
+        auto window = WindowRef::parse("AVG_WINDOW(COSTS,12)");
+        REQUIRE(window);
+        CHECK(window->code == "COSTS");
+        CHECK(window->periods == 12);
+        CHECK(window->average);
+        CHECK_FALSE(WindowRef::parse("SUM_WINDOW(REVENUE)"));
+        CHECK_FALSE(WindowRef::parse("REVENUE"));
+
+        // Windows end at t-1: no dependency within the period
+        CHECK(eval.extract_dependencies("SUM_WINDOW(REVENUE, 4) + COSTS") ==
+              std::vector<std::string>{"COSTS", "REVENUE[t-1]"});
+        CHECK(eval.extract_dependencies("GROWTH(REVENUE)") ==
+              std::vector<std::string>{"REVENUE", "REVENUE[t-1]"});
+
+        CHECK_THROWS_AS(eval.compile("SUM_WINDOW(REVENUE, 0)"), std::runtime_error);
+        CHECK_THROWS_AS(eval.compile("SUM_WINDOW(REVENUE, N)"), std::runtime_error);
+        CHECK_THROWS_AS(eval.compile("SUM_WINDOW(REVENUE * 2, 4)"), std::runtime_error);
+        CHECK_THROWS_AS(eval.compile("AVG_WINDOW(REVENUE, 5000)"), std::runtime_error);
+    }
+
+    SECTION("GROWTH is the change on the prior period") {
+        MockValueProvider provider;
+        provider.set_value_for_period("REVENUE", 5, 1100.0);
+        provider.set_value_for_period("REVENUE", 4, 1000.0);
+        std::vector<IValueProvider*> providers = {&provider};
+        Context ctx(1, 5, 1);
+        CHECK_THAT(eval.evaluate("GROWTH(REVENUE)", providers, ctx), WithinAbs(0.1, 1e-12));
+    }
+
+    SECTION("Rolling windows drop the oldest period") {
+        RollingWindow window(3);
+        for (int p = 1; p <= 5; ++p) {
+            window.push(p, p * 10.0);
+        }
+        CHECK(window.full());
+        CHECK(window.sum() == 120.0);   // 30 + 40 + 50
+        window.push(6, std::nan(""));
+        CHECK(window.sum() == 90.0);
+        CHECK(window.count() == 2);
+        CHECK(window.mean() == 45.0);
+        window.push(9, 7.0);            // A gap starts over
+        CHECK(window.size() == 1);
+        CHECK(window.sum() == 7.0);
+        CHECK_THROWS_AS(RollingWindow(0), std::invalid_argument);
+    }
+
+    SECTION("NPV and IRR over a series") {
+        const std::vector<double> flows = {-1000.0, 300.0, 400.0, 500.0};
+        CHECK_THAT(npv(0.1, flows.data(), flows.size()),
+                   WithinAbs(-1000.0 / 1.1 + 300.0 / 1.21 + 400.0 / 1.331 + 500.0 / 1.4641, 1e-9));
+        CHECK(npv(0.1, flows.data(), 0) == 0.0);
+        CHECK_THROWS_AS(npv(-1.0, flows.data(), flows.size()), std::invalid_argument);
+
+        const double rate = irr(flows.data(), flows.size());
+        CHECK_THAT(rate, WithinAbs(0.0889633947, 1e-8));
+        CHECK_THAT(-1000.0 + npv(rate, flows.data() + 1, 3), WithinAbs(0.0, 1e-8));
+
+        const std::vector<double> gains = {100.0, 200.0};
+        CHECK(std::isnan(irr(gains.data(), gains.size())));
+    }
+}
@@ -0,0 +1,170 @@
+/**
+ * @file test_goal_seek.cpp
+ * @brief Tests for the goal-seek solver
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/goal_seek.h"
+#include "test_databases.h"
+#include <cstdio>
+#include <limits>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("GoalSeeker: Driver shifts that hit a target", "[orchestration][goal_seek]") {
+    const std::string path = "test_goal_seek.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        const std::vector<PeriodID> periods = {1, 2, 3, 4, 5};
+        {
+            auto db = create_runner_db(path);
+            core::StatementTemplate::load_from_json(R"json({
+                "template_code": "GOAL_SEEK_TEST",
+                "statement_type": "unified",
+                "version": "1.0",
+                "line_items": [
+                    {"code": "SALES", "formula": "SALES[t-1] * (1 + driver:GROWTH)"},
+                    {"code": "COSTS", "base_value_source": "driver:COSTS"},
+                    {"code": "EBIT", "formula": "SALES - COSTS"},
+                    {"code": "TAX", "formula": "MAX(0, EBIT) * 0.25"},
+                    {"code": "CASH", "formula": "CASH[t-1] + EBIT - TAX"}
+                ]
+            })json")->save_to_database(db.get());
+            for (PeriodID period : periods) {
+                db->execute_update(
+                    "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                    "VALUES ('E', 1, :period, 'GROWTH', 0.05, 'EUR'), ('E', 1, :period, 'COSTS', 800.0, 'EUR')",
+                    {{"period", period}});
+            }
+        }
+
+        GoalSeekSpec spec;
+        spec.entity_id = "E";
+        spec.scenario_id = 1;
+        spec.period_ids = periods;
+        spec.initial_bs.line_items["SALES"] = 1000.0;
+        spec.initial_bs.line_items["CASH"] = 100.0;
+        spec.template_code = "GOAL_SEEK_TEST";
+        spec.target_code = "CASH";
+        spec.target_value = 2000.0;
+        spec.free_drivers = {"GROWTH"};
+
+        // Check a solution by rerunning with the shifts written as a scenario
+        auto rerun = [&](const GoalSeekResult& solved, PeriodID last) {
+            auto db = pool.writer();
+            db->execute_update("DELETE FROM scenario_drivers WHERE scenario_id = 2", {});
+            for (PeriodID period : periods) {
+                const double growth = 0.05 + (solved.shifts.count("GROWTH") ? solved.shifts.at("GROWTH") : 0.0);
+                const double costs = 800.0 + (solved.shifts.count("COSTS") ? solved.shifts.at("COSTS") : 0.0);
+                db->execute_update(
+                    "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                    "VALUES ('E', 2, :period, 'GROWTH', :growth, 'EUR'), ('E', 2, :period, 'COSTS', :costs, 'EUR')",
+                    {{"period", period}, {"growth", growth}, {"costs", costs}});
+            }
+            PeriodRunner runner(db);
+            std::vector<PeriodID> through(periods.begin(), std::find(periods.begin(), periods.end(), last) + 1);
+            auto run = runner.run_periods("E", 2, through, spec.initial_bs, "GOAL_SEEK_TEST");
+            REQUIRE(run.success);
+            return run.results.back().get_value("CASH");
+        };
+
+        GoalSeeker seeker([&pool] { return pool.reader(); }, 4);
+
+        SECTION("Newton on one driver") {
+            auto solved = seeker.solve(spec);
+            REQUIRE(solved.success);
+            CHECK(solved.converged);
+            CHECK(solved.target_period == 5);
+            CHECK(solved.value == Approx(2000.0).margin(1e-6));
+            CHECK(solved.iterations >= 1);
+            CHECK(solved.iterations < 10);
+            CHECK(solved.evaluations >= 2 * solved.iterations);
+            CHECK(solved.shifts.at("GROWTH") > 0.0);
+            CHECK(rerun(solved, 5) == Approx(2000.0).margin(1e-5));
+        }
+
+        SECTION("Newton on several drivers, for an earlier period") {
+            spec.free_drivers = {"GROWTH", "COSTS"};
+            spec.target_period = 3;
+            spec.target_value = 500.0;
+            auto solved = seeker.solve(spec);
+            REQUIRE(solved.success);
+            CHECK(solved.converged);
+            CHECK(solved.target_period == 3);
+            CHECK(solved.shifts.size() == 2);
+            CHECK(solved.shifts.at("COSTS") != 0.0);
+            CHECK(rerun(solved, 3) == Approx(500.0).margin(1e-5));
+        }
+
+        SECTION("Brent within a bracket") {
+            spec.method = GoalSeekMethod::BRENT;
+            spec.lower = 0.0;
+            spec.upper = 0.5;
+            auto solved = seeker.solve(spec);
+            REQUIRE(solved.success);
+            CHECK(solved.converged);
+            CHECK(rerun(solved, 5) == Approx(2000.0).margin(1e-5));
+
+            spec.upper = 0.01;
+            auto unbracketed = seeker.solve(spec);
+            CHECK(unbracketed.success);
+            CHECK_FALSE(unbracketed.converged);
+            REQUIRE_FALSE(unbracketed.errors.empty());
+            CHECK(unbracketed.errors[0].find("not bracketed") != std::string::npos);
+
+            spec.lower = -std::numeric_limits<double>::infinity();
+            CHECK_FALSE(seeker.solve(spec).success);
+        }
+
+        SECTION("Independent goal seeks in parallel") {
+            std::vector<GoalSeekSpec> specs;
+            for (int i = 0; i < 12; ++i) {
+                GoalSeekSpec target = spec;
+                target.target_value = 1000.0 + 200.0 * i;
+                target.method = (i % 2) ? GoalSeekMethod::BRENT : GoalSeekMethod::NEWTON;
+                target.lower = -0.5;
+                target.upper = 1.0;
+                specs.push_back(target);
+            }
+            specs[5].free_drivers = {"UNKNOWN"};
+            auto results = seeker.solve_all(specs);
+            REQUIRE(results.size() == specs.size());
+            for (size_t i = 0; i < specs.size(); ++i) {
+                CAPTURE(i);
+                if (i == 5) {
+                    CHECK_FALSE(results[i].success);
+                    continue;
+                }
+                REQUIRE(results[i].success);
+                CHECK(results[i].converged);
+                CHECK(results[i].value == Approx(specs[i].target_value).margin(1e-6));
+                auto alone = seeker.solve(specs[i]);
+                CHECK(alone.shifts.at("GROWTH") == Approx(results[i].shifts.at("GROWTH")).margin(1e-9));
+            }
+        }
+
+        SECTION("Invalid specs") {
+            spec.period_ids.clear();
+            CHECK_FALSE(seeker.solve(spec).success);
+            spec.period_ids = periods;
+            spec.target_period = 9;
+            CHECK_FALSE(seeker.solve(spec).success);
+            spec.target_period = 0;
+            spec.free_drivers.clear();
+            CHECK_FALSE(seeker.solve(spec).success);
+        }
+    }
+    remove_files();
+}
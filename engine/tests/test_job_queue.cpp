@@ -0,0 +1,157 @@
+/**
+ * @file test_job_queue.cpp
+ * @brief Tests for the asynchronous job queue
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/job_queue.h"
+#include "orchestration/workload_generator.h"
+#include "web/server.h"
+#include "database/database_factory.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+
+TEST_CASE("JobQueue: Jobs run by priority, report progress and cancel", "[orchestration][jobs]") {
+    const std::string path = "test_jobs.db";
+    std::remove(path.c_str());
+    WorkloadSpec workload_spec;
+    workload_spec.line_items = 40;
+    workload_spec.drivers = 5;
+    workload_spec.depth = 4;
+    workload_spec.periods = 3;
+    workload_spec.scenarios = 2;
+    Workload workload;
+    {
+        auto db = DatabaseFactory::create_sqlite(path);
+        workload = WorkloadGenerator(workload_spec).generate(*db);
+    }
+    auto connect = [path] { return DatabaseFactory::create_sqlite(path); };
+
+    std::ostringstream opening;
+    opening << "{";
+    for (const auto& [code, value] : workload.opening.line_items) {
+        opening << (opening.tellp() > 1 ? ", " : "") << std::quoted(code) << ": " << value;
+    }
+    opening << "}";
+    auto spec_json = [&](const std::string& priority, size_t repeats) {
+        std::ostringstream json;
+        json << "{\"template\": \"" << workload.template_code << "\", \"entity\": \""
+             << workload.leaf_entities.front() << "\", \"periods\": [1, 2, 3], \"opening\": " << opening.str()
+             << ", \"priority\": \"" << priority << "\", \"scenarios\": [";
+        for (size_t i = 0; i < repeats; ++i) {
+            json << (i ? ", " : "") << workload.scenario_ids[i % workload.scenario_ids.size()];
+        }
+        json << "]}";
+        return json.str();
+    };
+
+    SECTION("Run specs are parsed and checked") {
+        const JobSpec spec = JobSpec::from_json(spec_json("batch", 2));
+        CHECK(spec.priority == JobPriority::BATCH);
+        CHECK(spec.entities == std::vector<EntityID>{workload.leaf_entities.front()});
+        CHECK(spec.period_ids.size() == 3);
+        CHECK_THROWS_AS(JobSpec::from_json("{\"entity\": \"A\"}"), std::invalid_argument);
+        CHECK_THROWS_AS(JobSpec::from_json("not json"), std::invalid_argument);
+        CHECK_THROWS_AS(JobSpec::from_json(spec_json("urgent", 1)), std::invalid_argument);
+    }
+
+    SECTION("Progress events, batch cap and cancellation") {
+        JobQueue jobs(connect, 2, 1);
+        const uint64_t sweep = jobs.submit(JobSpec::from_json(spec_json("batch", 5000)));
+        const uint64_t second_sweep = jobs.submit(JobSpec::from_json(spec_json("batch", 2)));
+        const uint64_t what_if = jobs.submit(JobSpec::from_json(spec_json("interactive", 2)));
+
+        // The what-if runs on the worker the sweeps may not take
+        std::vector<JobEvent> events;
+        bool finished = false;
+        while (!finished) {
+            auto more = jobs.events(what_if, events.empty() ? 0 : events.back().sequence,
+                                    std::chrono::seconds(5), &finished);
+            events.insert(events.end(), more.begin(), more.end());
+        }
+        auto status = jobs.status(what_if);
+        REQUIRE(status);
+        INFO(status->error);
+        CHECK(status->state == JobState::SUCCEEDED);
+        CHECK(status->periods_done == 6);
+        CHECK(status->runs_done == 2);
+        CHECK(jobs.status(sweep)->state == JobState::RUNNING);
+        CHECK(jobs.status(second_sweep)->state == JobState::QUEUED);
+
+        std::vector<std::string> types;
+        for (const auto& event : events) {
+            types.push_back(event.type);
+        }
+        CHECK(types == std::vector<std::string>{"status", "status", "period", "period", "period", "run",
+                                                "period", "period", "period", "run", "status"});
+        CHECK(events.back().data.find("\"state\":\"succeeded\"") != std::string::npos);
+        CHECK(events[2].data.find("\"period\":1") != std::string::npos);
+
+        // Cancelling the sweep frees its batch slot for the next one
+        CHECK(jobs.cancel(sweep));
+        finished = false;
+        while (!finished) {
+            jobs.events(second_sweep, 0, std::chrono::seconds(5), &finished);
+        }
+        CHECK(jobs.status(sweep)->state == JobState::CANCELLED);
+        CHECK(jobs.status(sweep)->runs_done < 5000);
+        CHECK(jobs.status(second_sweep)->state == JobState::SUCCEEDED);
+        CHECK_FALSE(jobs.cancel(sweep));
+        CHECK_FALSE(jobs.status(12345));
+        CHECK(jobs.list().size() == 3);
+    }
+
+    SECTION("HTTP job API with an event stream") {
+        web::Server server(0, "127.0.0.1");
+        CHECK(server.handle("POST", "/jobs", "{}").status == 404);   // No job queue
+        server.set_jobs(std::make_shared<JobQueue>(connect, 1, 1));
+        server.start();
+
+        auto http = [&server](const std::string& request) {
+            const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(server.port());
+            ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+            REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+            REQUIRE(::send(client, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+            std::string reply;
+            char buffer[4096];
+            for (ssize_t n; (n = ::recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+                reply.append(buffer, static_cast<size_t>(n));
+            }
+            ::close(client);
+            return reply;
+        };
+
+        const std::string body = spec_json("interactive", 2);
+        const std::string submitted = http("POST /jobs HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: " +
+                                           std::to_string(body.size()) + "\r\n\r\n" + body);
+        REQUIRE(submitted.rfind("HTTP/1.1 202 Accepted", 0) == 0);
+        CHECK(submitted.find("\"job_id\":1") != std::string::npos);
+
+        // Streams until the job finished, then the server closes the connection
+        const std::string stream = http("GET /jobs/1/events HTTP/1.1\r\n\r\n");
+        CHECK(stream.find("Content-Type: text/event-stream") != std::string::npos);
+        CHECK(stream.find("event: period\ndata: {") != std::string::npos);
+        CHECK(stream.find("\"state\":\"succeeded\"") != std::string::npos);
+
+        CHECK(server.handle("GET", "/jobs/1/events?after=10").body.find("id: 11\n") != std::string::npos);
+        CHECK(server.handle("GET", "/jobs/1").body.find("\"periods_done\":6") != std::string::npos);
+        CHECK(server.handle("GET", "/jobs").body.rfind("[{", 0) == 0);
+        CHECK(server.handle("DELETE", "/jobs/1").body.find("\"cancelled\": false") != std::string::npos);
+        CHECK(server.handle("DELETE", "/jobs/9").status == 404);
+        CHECK(server.handle("POST", "/jobs", "{\"template\": 1}").status == 400);
+        CHECK(http("POST /jobs HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}").rfind("HTTP/1.1 400", 0) == 0);
+        server.stop();
+    }
+    std::remove(path.c_str());
+}
@@ -5,20 +5,29 @@
  * Tests physical risk components using real database data:
  * - GeoUtils: Haversine distance, radius checks, intensity decay
  * - DamageFunction: Piecewise linear interpolation, JSON parsing
- * - DamageFunctionRegistry: Loading from database, caching
+ * - DamageFunctionRegistry: Loading from database, lookups
  * - PhysicalRiskEngine: Damage calculation, driver generation
  */
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include "physical_risk/geo_utils.h"
+#include "physical_risk/spatial_index.h"
+#include "physical_risk/hazard_grid.h"
+#include "physical_risk/hazard_map_builder.h"
 #include "physical_risk/damage_function.h"
 #include "physical_risk/damage_function_registry.h"
+#include "physical_risk/event_simulation.h"
 #include "physical_risk/physical_risk_engine.h"
 #include "database/database_factory.h"
 #include "database/result_set.h"
+#include <algorithm>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <random>
 
 using namespace physical_risk;
 using namespace finmodel::database;
@@ -74,6 +83,458 @@ TEST_CASE("Level 18: GeoUtils - Intensity decay", "[level18][geo]") {
     REQUIRE(GeoUtils::calculate_intensity_with_decay(base_intensity, 100.0, 0.0) == base_intensity);
 }
 
+TEST_CASE("Level 18: SpatialIndex - Radius queries match a full scan", "[level18][geo]") {
+    std::mt19937 rng(18);
+    std::uniform_real_distribution<double> lat(-90.0, 90.0);
+    std::uniform_real_distribution<double> lon(-180.0, 180.0);
+
+    std::vector<std::pair<double, double>> locations;
+    for (int i = 0; i < 4000; ++i) {
+        locations.emplace_back(lat(rng), lon(rng));
+    }
+    // A cluster around Zurich, and points on the date line and the poles
+    std::normal_distribution<double> jitter(0.0, 0.2);
+    for (int i = 0; i < 1000; ++i) {
+        locations.emplace_back(47.3769 + jitter(rng), 8.5417 + jitter(rng));
+    }
+    locations.emplace_back(0.0, 180.0);
+    locations.emplace_back(0.0, -179.99);
+    locations.emplace_back(90.0, 0.0);
+    locations.emplace_back(89.99, 123.0);
+
+    SpatialIndex index(locations);
+    REQUIRE(index.size() == locations.size());
+
+    std::vector<std::tuple<double, double, double>> queries = {
+        {47.3769, 8.5417, 20.0}, {47.3769, 8.5417, 0.5}, {0.0, 179.9, 50.0},
+        {90.0, 0.0, 10.0}, {-33.9, 151.2, 2000.0}, {10.0, 10.0, 25000.0}};
+    for (int i = 0; i < 50; ++i) {
+        queries.emplace_back(lat(rng), lon(rng), 10.0 + 90.0 * i);
+    }
+
+    for (const auto& [qlat, qlon, radius] : queries) {
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < locations.size(); ++i) {
+            if (GeoUtils::haversine_distance(locations[i].first, locations[i].second, qlat, qlon) <= radius) {
+                expected.push_back(i);
+            }
+        }
+        auto candidates = index.query_radius(qlat, qlon, radius);
+        REQUIRE(std::is_sorted(candidates.begin(), candidates.end()));
+        REQUIRE(std::includes(candidates.begin(), candidates.end(), expected.begin(), expected.end()));
+        for (size_t i : candidates) {
+            REQUIRE(GeoUtils::haversine_distance(locations[i].first, locations[i].second, qlat, qlon) <=
+                    radius + 0.01);
+        }
+    }
+    CHECK(SpatialIndex().query_radius(0.0, 0.0, 100.0).empty());
+}
+
+TEST_CASE("Level 18: SpatialIndex - Nearest neighbours match a full scan", "[level18][geo]") {
+    std::mt19937 rng(90);
+    std::uniform_real_distribution<double> lat(-90.0, 90.0);
+    std::uniform_real_distribution<double> lon(-180.0, 180.0);
+
+    std::vector<std::pair<double, double>> locations;
+    std::vector<std::tuple<double, double, int>> candidates;
+    for (int i = 0; i < 3000; ++i) {
+        locations.emplace_back(lat(rng), lon(rng));
+    }
+    // Duplicates tie: the lower index comes first
+    locations.push_back(locations[17]);
+    locations.emplace_back(0.0, 180.0);
+    locations.emplace_back(0.0, -180.0);
+    for (size_t i = 0; i < locations.size(); ++i) {
+        candidates.emplace_back(locations[i].first, locations[i].second, static_cast<int>(i));
+    }
+    SpatialIndex index(locations);
+
+    std::vector<double> qlats = {locations[17].first, 0.0, 90.0, -90.0};
+    std::vector<double> qlons = {locations[17].second, 179.999, 0.0, 0.0};
+    for (int i = 0; i < 300; ++i) {
+        qlats.push_back(lat(rng));
+        qlons.push_back(lon(rng));
+    }
+
+    const size_t k = 5;
+    for (size_t q = 0; q < qlats.size(); ++q) {
+        std::vector<double> distances;
+        for (const auto& [plat, plon] : locations) {
+            distances.push_back(GeoUtils::haversine_distance(qlats[q], qlons[q], plat, plon));
+        }
+        std::vector<double> sorted = distances;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto found = index.query_nearest(qlats[q], qlons[q], k);
+        REQUIRE(found.size() == k);
+        for (size_t j = 0; j < k; ++j) {
+            CHECK_THAT(found[j].distance_km, Catch::Matchers::WithinAbs(sorted[j], 1e-6));
+            CHECK_THAT(distances[found[j].index], Catch::Matchers::WithinAbs(sorted[j], 1e-6));
+            if (j > 0) {
+                REQUIRE(found[j - 1].distance_km <= found[j].distance_km);
+            }
+        }
+        const size_t nearest = index.nearest(qlats[q], qlons[q]);
+        CHECK_THAT(distances[nearest], Catch::Matchers::WithinAbs(sorted[0], 1e-6));
+        CHECK_THAT(distances[static_cast<size_t>(GeoUtils::find_nearest_location(qlats[q], qlons[q], candidates))],
+                   Catch::Matchers::WithinAbs(distances[nearest], 1e-6));
+    }
+    auto tied = index.query_nearest(locations[17].first, locations[17].second, 2);
+    CHECK(tied[0].index == 17);
+    CHECK(tied[1].index == 3000);
+
+    SECTION("Batches match single queries, with and without threads") {
+        const size_t count = qlats.size();
+        std::vector<size_t> indices(count * k), pooled(count * k);
+        std::vector<double> km(count * k), pooled_km(count * k);
+        index.query_nearest_batch(qlats.data(), qlons.data(), count, k, indices.data(), km.data());
+        finmodel::core::ThreadPool pool(4);
+        index.query_nearest_batch(qlats.data(), qlons.data(), count, k, pooled.data(), pooled_km.data(), &pool);
+        CHECK(indices == pooled);
+        CHECK(km == pooled_km);
+        for (size_t q = 0; q < count; ++q) {
+            auto found = index.query_nearest(qlats[q], qlons[q], k);
+            for (size_t j = 0; j < k; ++j) {
+                REQUIRE(indices[q * k + j] == found[j].index);
+            }
+        }
+
+        // More neighbours than locations
+        SpatialIndex small(std::vector<std::pair<double, double>>{{1.0, 1.0}, {2.0, 2.0}});
+        std::vector<size_t> few(3);
+        std::vector<double> few_km(3);
+        small.query_nearest_batch(qlats.data(), qlons.data(), 1, 3, few.data(), few_km.data());
+        CHECK(few[2] == SpatialIndex::NO_LOCATION);
+        CHECK(std::isinf(few_km[2]));
+        CHECK(SpatialIndex().nearest(0.0, 0.0) == SpatialIndex::NO_LOCATION);
+    }
+
+    SECTION("Stored and loaded trees answer alike") {
+        auto db = DatabaseFactory::create_sqlite(":memory:");
+        db->execute_raw(
+            "CREATE TABLE spatial_index_point (index_code TEXT NOT NULL, slot INTEGER NOT NULL, "
+            "location_index INTEGER NOT NULL, x REAL NOT NULL, y REAL NOT NULL, z REAL NOT NULL, "
+            "PRIMARY KEY (index_code, slot))");
+        SpatialIndex(std::vector<std::pair<double, double>>{{5.0, 5.0}}).store(*db, "GRID");
+        index.store(*db, "GRID");   // Replaces the first one
+
+        SpatialIndex loaded = SpatialIndex::load(*db, "GRID");
+        REQUIRE(loaded.size() == index.size());
+        for (size_t q = 0; q < qlats.size(); ++q) {
+            auto expected = index.query_nearest(qlats[q], qlons[q], k);
+            auto actual = loaded.query_nearest(qlats[q], qlons[q], k);
+            for (size_t j = 0; j < k; ++j) {
+                REQUIRE(actual[j].index == expected[j].index);
+            }
+        }
+        CHECK(loaded.query_radius(0.0, 180.0, 1.0) == index.query_radius(0.0, 180.0, 1.0));
+        CHECK_THROWS_AS(SpatialIndex::load(*db, "MISSING"), std::runtime_error);
+
+        db->execute_update("DELETE FROM spatial_index_point WHERE slot = 7", {});
+        CHECK_THROWS_AS(SpatialIndex::load(*db, "GRID"), std::runtime_error);
+    }
+}
+
+TEST_CASE("Level 18: GeoUtils - Batch distances and decay match the scalar functions", "[level18][geo]") {
+    std::mt19937 rng(47);
+    std::uniform_real_distribution<double> lat(-90.0, 90.0);
+    std::uniform_real_distribution<double> lon(-180.0, 180.0);
+
+    std::vector<std::pair<double, double>> locations = {
+        {47.3769, 8.5417}, {47.37691, 8.5417}, {-47.3769, -171.4583}, {0.0, 180.0}, {90.0, 0.0}};
+    for (int i = 0; i < 2000; ++i) {
+        locations.emplace_back(lat(rng), lon(rng));
+    }
+    const GeoCoordinates coordinates(locations);
+    REQUIRE(coordinates.size() == locations.size());
+
+    // Every other location, as after a spatial index query
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < locations.size(); i += 2) {
+        indices.push_back(i);
+    }
+
+    const double center_lat = 47.3769;
+    const double center_lon = 8.5417;
+    std::vector<double> distances(indices.size());
+    GeoUtils::haversine_distance_batch(coordinates, indices.data(), indices.size(),
+                                       center_lat, center_lon, distances.data());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        const auto& [alat, alon] = locations[indices[i]];
+        REQUIRE_THAT(distances[i], Catch::Matchers::WithinAbs(
+            GeoUtils::haversine_distance(alat, alon, center_lat, center_lon), 1e-6));
+    }
+
+    for (double radius : {0.0, 50.0, 5000.0}) {
+        std::vector<double> intensities(distances.size());
+        GeoUtils::intensity_with_decay_batch(3.0, distances.data(), distances.size(), radius,
+                                             intensities.data());
+        for (size_t i = 0; i < distances.size(); ++i) {
+            REQUIRE_THAT(intensities[i], Catch::Matchers::WithinAbs(
+                GeoUtils::calculate_intensity_with_decay(3.0, distances[i], radius), 1e-12));
+        }
+    }
+}
+
+TEST_CASE("Level 18: HazardGrid - Tiled grid files", "[level18][geo]") {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "finmodel_hazard_grid_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // 5 x 7 cells of 0.5°, two bands; tiles of 2 leave padded edge tiles
+    HazardGridSpec spec;
+    spec.rows = 5;
+    spec.cols = 7;
+    spec.lat_origin = 45.0;
+    spec.lon_origin = 6.0;
+    spec.lat_step = 0.5;
+    spec.lon_step = 0.5;
+    std::vector<float> values(2 * 5 * 7);
+    for (uint32_t band = 0; band < 2; ++band) {
+        for (uint32_t r = 0; r < 5; ++r) {
+            for (uint32_t c = 0; c < 7; ++c) {
+                values[(band * 5 + r) * 7 + c] = static_cast<float>((band + 1) * (10 * r + c));
+            }
+        }
+    }
+    values[(0 * 5 + 4) * 7 + 6] = std::numeric_limits<float>::quiet_NaN();   // No data
+    const std::string path = (dir / "grid.fmhg").string();
+    HazardGrid::write(path, spec, {1, 3}, values, 2);
+
+    HazardGrid grid(path);
+    REQUIRE(grid.spec().rows == 5);
+    REQUIRE(grid.spec().cols == 7);
+    REQUIRE(grid.bands() == 2);
+    REQUIRE(grid.band_index(3) == 1);
+    REQUIRE(grid.band_index(2) == grid.bands());
+
+    // Every cell, nearest-center lookups from anywhere within the cell
+    for (uint32_t band = 0; band < 2; ++band) {
+        for (uint32_t r = 0; r < 5; ++r) {
+            for (uint32_t c = 0; c < 7; ++c) {
+                const double expected = values[(band * 5 + r) * 7 + c];
+                const double v = grid.cell_value(45.0 + 0.5 * r + 0.2, 6.0 + 0.5 * c - 0.2, band);
+                if (std::isnan(expected)) {
+                    REQUIRE(std::isnan(v));
+                } else {
+                    REQUIRE(v == expected);
+                    REQUIRE(grid.sample(45.0 + 0.5 * r, 6.0 + 0.5 * c, band) == expected);
+                }
+            }
+        }
+    }
+
+    // Bilinear between centers; cells without data drop out
+    REQUIRE_THAT(grid.sample(45.25, 6.25, 0), Catch::Matchers::WithinAbs((0 + 1 + 10 + 11) / 4.0, 1e-9));
+    REQUIRE_THAT(grid.sample(45.5, 7.1, 1), Catch::Matchers::WithinAbs(2 * (10 + 2.2), 1e-5));
+    REQUIRE_THAT(grid.sample(46.75, 8.75, 0), Catch::Matchers::WithinAbs((35 + 36 + 45) / 3.0, 1e-9));
+    REQUIRE(grid.sample(45.0, 6.0 - 0.2, 0) == 0.0);   // Within the edge cell
+    REQUIRE(std::isnan(grid.sample(44.0, 7.0, 0)));     // Outside
+    REQUIRE(std::isnan(grid.cell_value(47.0, 9.6, 0)));
+    REQUIRE_THROWS_AS(grid.sample(45.0, 6.0, 2), std::out_of_range);
+
+    std::vector<double> lats = {45.0, 45.25, 44.0};
+    std::vector<double> lons = {6.0, 6.25, 7.0};
+    std::vector<double> out(3);
+    grid.sample_batch(lats.data(), lons.data(), 3, 0, true, out.data());
+    REQUIRE(out[0] == 0.0);
+    REQUIRE(out[1] == grid.sample(45.25, 6.25, 0));
+    REQUIRE(std::isnan(out[2]));
+
+    // CSV export of scripts/generate_improved_hazard_maps.py, one point missing
+    const std::string csv = (dir / "hazard.csv").string();
+    {
+        std::ofstream out_csv(csv);
+        out_csv << "location_id,latitude,longitude,period_1_intensity_m,period_1_variance,"
+                   "period_2_intensity_m,period_2_variance,hazard_type,unit\n";
+        int id = 0;
+        for (double lat : {35.0, 35.09, 35.18}) {
+            for (double lon : {-10.0, -9.91, -9.82, -9.73}) {
+                if (lat == 35.18 && lon == -9.73) {
+                    continue;
+                }
+                ++id;
+                out_csv << "EUR_" << id << "," << lat << "," << lon << "," << id * 0.1 << ",0.2,"
+                        << id * 0.2 << ",0.3,flood,meters\n";
+            }
+        }
+    }
+    const HazardGridSpec converted = HazardGrid::from_csv(csv, (dir / "csv.fmhg").string(), 3);
+    REQUIRE(converted.rows == 3);
+    REQUIRE(converted.cols == 4);
+    HazardGrid csv_grid((dir / "csv.fmhg").string());
+    REQUIRE(csv_grid.band_keys() == std::vector<int>{1, 2});
+    REQUIRE_THAT(csv_grid.cell_value(35.09, -9.82, 0), Catch::Matchers::WithinAbs(0.7, 1e-6));
+    REQUIRE_THAT(csv_grid.cell_value(35.09, -9.82, 1), Catch::Matchers::WithinAbs(1.4, 1e-6));
+    REQUIRE(std::isnan(csv_grid.cell_value(35.18, -9.73, 0)));
+
+    // Truncated or foreign files are rejected
+    fs::resize_file(dir / "csv.fmhg", fs::file_size(dir / "csv.fmhg") - 4);
+    REQUIRE_THROWS_AS(HazardGrid((dir / "csv.fmhg").string()), std::runtime_error);
+    REQUIRE_THROWS_AS(HazardGrid(csv), std::runtime_error);
+    REQUIRE_THROWS_AS(HazardGrid((dir / "missing.fmhg").string()), std::runtime_error);
+    REQUIRE_THROWS_AS(HazardGrid::write(path, spec, {1}, values), std::invalid_argument);
+    fs::remove_all(dir);
+}
+
+TEST_CASE("Level 18: HazardMapBuilder - Rasterised footprints and incremental rebuilds", "[level18][geo]") {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "finmodel_hazard_builder_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    auto bytes = [](const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    // 40 x 50 cells of 0.1°, two bands; tiles of 16 leave padded edge tiles
+    HazardGridSpec spec;
+    spec.rows = 40;
+    spec.cols = 50;
+    spec.lat_origin = 45.0;
+    spec.lon_origin = 5.0;
+    spec.lat_step = 0.1;
+    spec.lon_step = 0.1;
+    const std::vector<int> bands = {1, 2};
+
+    PerilFootprint flood;
+    flood.peril_id = 1;
+    flood.latitude = 46.03;
+    flood.longitude = 6.01;
+    flood.intensity = 2.0;
+    flood.radius_km = 30.0;
+    flood.band_factors = {1.0, 0.5};
+    PerilFootprint storm = flood;
+    storm.peril_id = 2;
+    storm.latitude = 47.5;
+    storm.longitude = 8.5;
+    storm.intensity = 3.0;
+    storm.radius_km = 20.0;
+    storm.decay = DecayShape::CONSTANT;
+    storm.band_factors.clear();
+    PerilFootprint point = storm;
+    point.peril_id = 3;
+    point.latitude = 45.52;
+    point.longitude = 5.31;
+    point.intensity = 5.0;
+    point.radius_km = 0.0;
+    const std::vector<PerilFootprint> footprints = {flood, storm, point};
+
+    HazardMapBuilder builder(spec, bands, 16);
+    const HazardBuildStats stats = builder.build(footprints, (dir / "built.fmhg").string());
+    REQUIRE(stats.tiles == 3 * 4);
+    REQUIRE(stats.tiles_written == 12);
+    REQUIRE(stats.cell_evaluations < 40 * 50);   // Only cells near a footprint
+
+    // Every cell against GeoUtils' distances and decay (MAX of footprints, background 0)
+    auto expected = [&](const std::vector<PerilFootprint>& set, uint32_t r, uint32_t c, size_t band) {
+        const double lat = 45.0 + 0.1 * r;
+        const double lon = 5.0 + 0.1 * c;
+        double value = 0.0;
+        for (const auto& f : set) {
+            const double factor = f.band_factors.empty() ? 1.0 : f.band_factors[band];
+            if (f.radius_km <= 0.0) {
+                if (std::lround((f.latitude - 45.0) / 0.1) == r && std::lround((f.longitude - 5.0) / 0.1) == c) {
+                    value = std::max(value, f.intensity * factor);
+                }
+                continue;
+            }
+            const double d = GeoUtils::haversine_distance(f.latitude, f.longitude, lat, lon);
+            if (d < f.radius_km) {
+                const double decayed = (f.decay == DecayShape::CONSTANT)
+                    ? f.intensity
+                    : GeoUtils::calculate_intensity_with_decay(f.intensity, d, f.radius_km);
+                value = std::max(value, decayed * factor);
+            }
+        }
+        return value;
+    };
+    {
+        HazardGrid grid((dir / "built.fmhg").string());
+        REQUIRE(grid.tile() == 16);
+        REQUIRE(grid.band_keys() == bands);
+        size_t reached = 0;
+        for (size_t band = 0; band < 2; ++band) {
+            for (uint32_t r = 0; r < 40; ++r) {
+                for (uint32_t c = 0; c < 50; ++c) {
+                    const double v = grid.cell_value(45.0 + 0.1 * r, 5.0 + 0.1 * c, band);
+                    REQUIRE_THAT(v, Catch::Matchers::WithinAbs(expected(footprints, r, c, band), 1e-5));
+                    reached += (v > 0.0) ? 1 : 0;
+                }
+            }
+        }
+        REQUIRE(reached > 50);
+        REQUIRE(grid.cell_value(45.52, 5.31, 1) == 5.0);
+        REQUIRE(grid.cell_value(47.5, 8.5, 0) == 3.0);
+        REQUIRE_THAT(grid.cell_value(46.0, 6.0, 1), Catch::Matchers::WithinAbs(0.5 * expected(footprints, 10, 10, 0), 1e-5));
+    }
+
+    // Any thread count writes the same file
+    HazardMapBuilder parallel(spec, bands, 16);
+    parallel.set_parallel(4);
+    parallel.build(footprints, (dir / "parallel.fmhg").string());
+    REQUIRE(bytes(dir / "parallel.fmhg") == bytes(dir / "built.fmhg"));
+
+    // A stronger storm, the point event gone, a new event: only their tiles
+    // are rewritten, into the same file as a full rebuild
+    std::vector<PerilFootprint> changed = {flood, storm};
+    changed[1].intensity = 4.0;
+    PerilFootprint hail = flood;
+    hail.peril_id = 4;
+    hail.latitude = 48.6;
+    hail.longitude = 9.6;
+    hail.decay = DecayShape::GAUSSIAN;
+    changed.push_back(hail);
+    const HazardBuildStats updated = parallel.update((dir / "built.fmhg").string(), footprints, changed);
+    REQUIRE(updated.tiles_written > 0);
+    REQUIRE(updated.tiles_written < updated.tiles);
+    builder.build(changed, (dir / "rebuilt.fmhg").string());
+    REQUIRE(bytes(dir / "built.fmhg") == bytes(dir / "rebuilt.fmhg"));
+    {
+        HazardGrid grid((dir / "built.fmhg").string());
+        REQUIRE(grid.cell_value(47.5, 8.5, 0) == 4.0);
+        REQUIRE(grid.cell_value(45.52, 5.31, 0) == 0.0);
+        REQUIRE_THAT(grid.cell_value(48.6, 9.6, 0), Catch::Matchers::WithinAbs(2.0, 1e-6));
+    }
+    REQUIRE(builder.update((dir / "built.fmhg").string(), changed, changed).tiles_written == 0);
+
+    // Overlaps add up with SUM; cells without a footprint can have no data
+    HazardMapBuilder summed(spec, {1}, 16);
+    summed.set_combine(HazardCombine::SUM);
+    summed.set_background(std::numeric_limits<float>::quiet_NaN());
+    point.band_factors.clear();
+    summed.build({point, point}, (dir / "summed.fmhg").string());
+    {
+        HazardGrid grid((dir / "summed.fmhg").string());
+        REQUIRE(grid.cell_value(45.52, 5.31, 0) == 10.0);
+        REQUIRE(std::isnan(grid.cell_value(46.0, 6.0, 0)));
+    }
+
+    // Footprints of physical_peril rows: one band per period
+    PhysicalPeril peril{};
+    peril.peril_id = 7;
+    peril.latitude = 46.0;
+    peril.longitude = 6.0;
+    peril.intensity = 1.5;
+    peril.start_period = 2;
+    peril.end_period = 3;
+    peril.radius_km = 10.0;
+    REQUIRE(PerilFootprint::from_peril(peril, {1, 2, 3, 4}).band_factors == std::vector<double>{0, 1, 1, 0});
+    peril.intensity_pathway = {1.0, 1.2};
+    REQUIRE(PerilFootprint::from_peril(peril, {2, 3, 4}).band_factors == std::vector<double>{1.0, 1.2, 0.0});
+
+    // Files of another layout, footprints of the wrong shape
+    REQUIRE_THROWS_AS(HazardMapBuilder(spec, bands, 32).update((dir / "built.fmhg").string(), changed, changed),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(HazardMapBuilder(spec, {1, 2, 3}).update((dir / "built.fmhg").string(), changed, changed),
+                      std::runtime_error);
+    hail.band_factors = {1.0};
+    REQUIRE_THROWS_AS(builder.build({hail}, (dir / "bad.fmhg").string()), std::invalid_argument);
+    REQUIRE_THROWS_AS(HazardMapBuilder(spec, {}), std::invalid_argument);
+    fs::remove_all(dir);
+}
+
 TEST_CASE("Level 18: DamageFunction - Piecewise linear basic", "[level18][damage]") {
     std::vector<std::pair<double, double>> curve = {
         {0.0, 0.0},
@@ -123,6 +584,52 @@ TEST_CASE("Level 18: DamageFunction - Validation", "[level18][damage]") {
     REQUIRE_THROWS(PiecewiseLinearDamageFunction(negative));
 }
 
+TEST_CASE("Level 18: DamageFunction - Batch evaluation matches a segment scan", "[level18][damage]") {
+    // Many segments, a step (repeated intensity) and a flat part
+    std::vector<std::pair<double, double>> curve = {{0.0, 0.0}, {0.5, 0.1}, {1.0, 0.1}, {1.0, 0.4}};
+    for (int i = 1; i <= 40; ++i) {
+        curve.emplace_back(1.0 + 0.25 * i, std::min(1.0, 0.4 + 0.02 * i));
+    }
+    PiecewiseLinearDamageFunction func(curve);
+
+    // Reference: first point at or above the intensity, interpolated from the previous one
+    auto scan = [&](double x) {
+        if (x <= curve.front().first) return curve.front().second;
+        if (x >= curve.back().first) return curve.back().second;
+        for (size_t i = 1; i < curve.size(); ++i) {
+            if (x <= curve[i].first) {
+                const auto [x0, y0] = curve[i - 1];
+                const auto [x1, y1] = curve[i];
+                return (std::abs(x1 - x0) < 1e-10) ? y0 : y0 + (x - x0) / (x1 - x0) * (y1 - y0);
+            }
+        }
+        return curve.back().second;
+    };
+
+    std::vector<double> intensities = {-1.0, 0.0, 0.25, 0.5, 1.0, 1.0000001, 7.3, 11.0, 12.0};
+    std::mt19937 rng(48);
+    std::uniform_real_distribution<double> intensity(-0.5, 12.5);
+    for (int i = 0; i < 1000; ++i) {
+        intensities.push_back(intensity(rng));
+    }
+
+    std::vector<double> out(intensities.size());
+    func.calculate_batch(intensities, out);
+    for (size_t i = 0; i < intensities.size(); ++i) {
+        REQUIRE(out[i] == scan(intensities[i]));
+        REQUIRE(func.calculate(intensities[i]) == out[i]);
+    }
+
+    // The interface's default evaluates one intensity at a time
+    const IDamageFunction& base = func;
+    std::vector<double> via_default(intensities.size());
+    base.IDamageFunction::calculate_batch(intensities, via_default);
+    REQUIRE(via_default == out);
+
+    std::vector<double> too_small(intensities.size() - 1);
+    REQUIRE_THROWS_AS(func.calculate_batch(intensities, too_small), std::invalid_argument);
+}
+
 TEST_CASE("Level 18: DamageFunctionRegistry - Load from real database", "[level18][registry]") {
     std::cout << "\n=== LEVEL 18: DAMAGE FUNCTION REGISTRY ===" << std::endl;
 
@@ -172,24 +679,575 @@ TEST_CASE("Level 18: DamageFunctionRegistry - Get by peril type from database",
     std::cout << "✓ Found HURRICANE->PPE function" << std::endl;
 }
 
-TEST_CASE("Level 18: DamageFunctionRegistry - Cache behavior", "[level18][registry]") {
+TEST_CASE("Level 18: DamageFunctionRegistry - Preloaded functions", "[level18][registry]") {
     auto db = DatabaseFactory::create_sqlite("data/database/finmodel.db");
     DamageFunctionRegistry registry(db.get());
 
-    size_t initial_size = registry.get_cache_size();
-
-    // Load a function
+    // Everything is loaded at construction; lookups don't add functions
+    const size_t loaded = registry.size();
+    REQUIRE(loaded > 0);
     const IDamageFunction* func1 = registry.get_function("FLOOD_PPE_STANDARD");
-    REQUIRE(registry.get_cache_size() == initial_size + 1);
-
-    // Load again - should use cache (same pointer)
     const IDamageFunction* func2 = registry.get_function("FLOOD_PPE_STANDARD");
+    REQUIRE(func1 != nullptr);
     REQUIRE(func1 == func2);
-    REQUIRE(registry.get_cache_size() == initial_size + 1);
+    REQUIRE(registry.size() == loaded);
+
+    // Interned lookups find the same functions as names
+    const auto flood = registry.peril_type_id("FLOOD");
+    REQUIRE(registry.get_function_for_peril(flood, DamageTarget::PPE) ==
+            registry.get_function_for_peril("FLOOD", "PPE"));
+
+    registry.reload();
+    REQUIRE(registry.size() == loaded);
+}
+
+TEST_CASE("Level 18: DamageFunctionRegistry - Bulk load and interned lookups", "[level18][damage]") {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_update(
+        "CREATE TABLE damage_function_definition ("
+        "  damage_function_id INTEGER PRIMARY KEY, function_code TEXT NOT NULL UNIQUE,"
+        "  function_name TEXT NOT NULL, peril_type TEXT NOT NULL, damage_target TEXT NOT NULL,"
+        "  function_type TEXT NOT NULL DEFAULT 'PIECEWISE_LINEAR', curve_definition TEXT NOT NULL,"
+        "  description TEXT)", {});
+    auto add = [&](int id, const std::string& code, const std::string& peril, const std::string& target,
+                   const std::string& type, const std::string& curve) {
+        db->execute_update(
+            "INSERT INTO damage_function_definition (damage_function_id, function_code, function_name, "
+            "peril_type, damage_target, function_type, curve_definition) "
+            "VALUES (:id, :code, :code, :peril, :target, :type, :curve)",
+            {{"id", id}, {"code", code}, {"peril", peril}, {"target", target}, {"type", type}, {"curve", curve}});
+    };
+    add(3, "FLOOD_PPE_ALT", "FLOOD", "PPE", "PIECEWISE_LINEAR", "[[0,0],[1,1]]");
+    add(1, "FLOOD_PPE", "FLOOD", "PPE", "PIECEWISE_LINEAR", "[[0,0],[1,0.5]]");
+    add(2, "FLOOD_BI", "FLOOD", "BI", "PIECEWISE_LINEAR", "[[0,0],[1,30]]");
+    add(4, "HEAT_INVENTORY", "HEAT", "INVENTORY", "PIECEWISE_LINEAR", "[[0,0],[40,0.2]]");
+    add(5, "HEAT_PPE_LOGISTIC", "HEAT", "PPE", "LOGISTIC", "k=1");
 
-    // Clear cache
-    registry.clear_cache();
-    REQUIRE(registry.get_cache_size() == 0);
+    DamageFunctionRegistry registry(db.get());
+    REQUIRE(registry.size() == 4);   // Unknown function type skipped
+
+    const auto flood = registry.peril_type_id("FLOOD");
+    const auto heat = registry.peril_type_id("HEAT");
+    REQUIRE(flood != DamageFunctionRegistry::UNKNOWN_PERIL);
+    REQUIRE(heat != DamageFunctionRegistry::UNKNOWN_PERIL);
+    REQUIRE(registry.peril_type_id("WILDFIRE") == DamageFunctionRegistry::UNKNOWN_PERIL);
+
+    // First definition of a peril type and target wins
+    REQUIRE(registry.get_function_for_peril(flood, DamageTarget::PPE) == registry.get_function("FLOOD_PPE"));
+    REQUIRE(registry.get_function_for_peril(flood, DamageTarget::PPE)->calculate(1.0) == 0.5);
+    REQUIRE(registry.get_function_for_peril(flood, DamageTarget::BI)->calculate(1.0) == 30.0);
+    REQUIRE(registry.get_function_for_peril(flood, DamageTarget::INVENTORY) == nullptr);
+    REQUIRE(registry.get_function_for_peril(heat, DamageTarget::PPE) == nullptr);
+    REQUIRE(registry.get_function_for_peril(DamageFunctionRegistry::UNKNOWN_PERIL, DamageTarget::PPE) == nullptr);
+    REQUIRE(registry.get_function("FLOOD_PPE_ALT") != nullptr);
+
+    REQUIRE(registry.get_function_for_peril("HEAT", "INVENTORY") == registry.get_function("HEAT_INVENTORY"));
+    REQUIRE(registry.get_function_for_peril("HEAT", "CARGO") == nullptr);
+
+    // Later definitions are only seen after reload()
+    add(6, "HEAT_PPE", "HEAT", "PPE", "PIECEWISE_LINEAR", "[[0,0],[40,0.1]]");
+    REQUIRE(registry.get_function("HEAT_PPE") == nullptr);
+    registry.reload();
+    REQUIRE(registry.size() == 5);
+    REQUIRE(registry.get_function_for_peril(registry.peril_type_id("HEAT"), DamageTarget::PPE) ==
+            registry.get_function("HEAT_PPE"));
+
+    // Invalid curves fail the load; the registry keeps what it had
+    add(7, "BAD", "HEAT", "BI", "PIECEWISE_LINEAR", "[[1,0],[0,1]]");
+    REQUIRE_THROWS_AS(registry.reload(), std::runtime_error);
+    REQUIRE(registry.size() == 5);
+}
+
+namespace {
+
+/// In-memory physical risk tables with FLOOD and HURRICANE damage functions
+std::shared_ptr<IDatabase> create_physical_risk_db() {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_update(
+        "CREATE TABLE physical_peril (peril_id INTEGER PRIMARY KEY, scenario_id INTEGER NOT NULL,"
+        "  peril_type TEXT NOT NULL, peril_code TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL,"
+        "  intensity REAL NOT NULL, intensity_unit TEXT NOT NULL, start_period INTEGER NOT NULL,"
+        "  end_period INTEGER, radius_km REAL DEFAULT 0, description TEXT)", {});
+    db->execute_update(
+        "CREATE TABLE asset_exposure (asset_id INTEGER PRIMARY KEY, asset_code TEXT NOT NULL UNIQUE,"
+        "  asset_name TEXT NOT NULL, asset_type TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL,"
+        "  entity_code TEXT, replacement_value REAL NOT NULL, replacement_currency TEXT NOT NULL DEFAULT 'CHF',"
+        "  inventory_value REAL DEFAULT 0, inventory_currency TEXT DEFAULT 'CHF', annual_revenue REAL DEFAULT 0,"
+        "  revenue_currency TEXT DEFAULT 'CHF', is_active INTEGER DEFAULT 1)", {});
+    db->execute_update(
+        "CREATE TABLE damage_function_definition (damage_function_id INTEGER PRIMARY KEY,"
+        "  function_code TEXT NOT NULL UNIQUE, function_name TEXT NOT NULL, peril_type TEXT NOT NULL,"
+        "  damage_target TEXT NOT NULL, function_type TEXT NOT NULL DEFAULT 'PIECEWISE_LINEAR',"
+        "  curve_definition TEXT NOT NULL, description TEXT)", {});
+    db->execute_update(
+        "INSERT INTO damage_function_definition (function_code, function_name, peril_type, damage_target, "
+        "curve_definition) VALUES "
+        "('F_PPE', 'F_PPE', 'FLOOD', 'PPE', '[[0,0],[1,0.3],[3,1]]'),"
+        "('F_INV', 'F_INV', 'FLOOD', 'INVENTORY', '[[0,0],[2,0.8]]'),"
+        "('F_BI', 'F_BI', 'FLOOD', 'BI', '[[0,0],[3,60]]'),"
+        "('H_PPE', 'H_PPE', 'HURRICANE', 'PPE', '[[50,0],[250,0.9]]')", {});
+    db->execute_update(
+        "CREATE TABLE scenario_drivers (entity_id TEXT, scenario_id INTEGER, period_id INTEGER, "
+        "  driver_code TEXT, value REAL, unit_code TEXT)", {});
+    db->execute_update(
+        "CREATE TABLE physical_risk_damage (scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL,"
+        "  asset_id INTEGER NOT NULL, peril_id INTEGER, distance_km REAL NOT NULL,"
+        "  adjusted_intensity REAL NOT NULL, ppe_loss REAL NOT NULL, inventory_loss REAL NOT NULL,"
+        "  bi_loss REAL NOT NULL, currency TEXT NOT NULL)", {});
+    db->execute_update(
+        "CREATE TABLE physical_event (event_id INTEGER PRIMARY KEY, catalogue_code TEXT NOT NULL,"
+        "  peril_type TEXT NOT NULL, latitude REAL NOT NULL, longitude REAL NOT NULL, intensity REAL NOT NULL,"
+        "  radius_km REAL DEFAULT 0, annual_rate REAL NOT NULL, description TEXT)", {});
+    return db;
+}
+
+} // namespace
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Parallel damages match sequential ones", "[level18][damage]") {
+    auto db = create_physical_risk_db();
+
+    // Assets across central Europe, a flood-prone cluster around Zurich
+    std::mt19937 rng(50);
+    std::uniform_real_distribution<double> lat(44.0, 52.0);
+    std::uniform_real_distribution<double> lon(2.0, 16.0);
+    std::normal_distribution<double> jitter(0.0, 0.1);
+    std::vector<finmodel::ParamMap> rows;
+    for (int i = 0; i < 3000; ++i) {
+        const bool zurich = (i % 3 == 0);
+        rows.push_back({{"code", std::string("A").append(std::to_string(i))},
+                        {"lat", zurich ? 47.3769 + jitter(rng) : lat(rng)},
+                        {"lon", zurich ? 8.5417 + jitter(rng) : lon(rng)},
+                        {"value", 1.0e6 + i},
+                        {"active", (i % 17 == 0) ? 0 : 1}});
+    }
+    db->execute_batch(
+        "INSERT INTO asset_exposure (asset_code, asset_name, asset_type, latitude, longitude, "
+        "replacement_value, inventory_value, annual_revenue, is_active) "
+        "VALUES (:code, :code, 'FACTORY', :lat, :lon, :value, :value / 4, :value * 2, :active)", rows);
+    db->execute_update(
+        "INSERT INTO physical_peril (scenario_id, peril_type, peril_code, latitude, longitude, intensity, "
+        "intensity_unit, start_period, end_period, radius_km) VALUES "
+        "(1, 'FLOOD', 'ZRH', 47.3769, 8.5417, 2.5, 'm', 1, 3, 30),"
+        "(1, 'FLOOD', 'RHINE', 48.5, 7.7, 1.5, 'm', 2, NULL, 120),"
+        "(1, 'HURRICANE', 'STORM', 46.0, 6.0, 220, 'km/h', 1, 2, 300),"
+        "(1, 'FLOOD', 'POINT', 47.3769, 8.5417, 3.0, 'm', 4, NULL, 0),"
+        "(1, 'HEATWAVE', 'HEAT', 47.0, 9.0, 40, 'C', 1, NULL, 500)", {});
+
+    PhysicalRiskEngine engine(db.get());
+    const auto expected = engine.calculate_damages(1);
+    REQUIRE(expected.size() > 1000);
+
+    auto same = [](const DamageResult& a, const DamageResult& b) {
+        return a.asset_id == b.asset_id && a.peril_id == b.peril_id && a.period == b.period &&
+               a.distance_km == b.distance_km && a.adjusted_intensity == b.adjusted_intensity &&
+               a.ppe_loss_amount == b.ppe_loss_amount && a.inventory_loss_amount == b.inventory_loss_amount &&
+               a.bi_loss_amount == b.bi_loss_amount;
+    };
+    for (auto [threads, shard] : {std::pair<size_t, size_t>{4, 7}, {3, 4096}, {8, 1}, {1, 100}}) {
+        engine.set_parallel(threads, shard);
+        const auto parallel = engine.calculate_damages(1);
+        REQUIRE(parallel.size() == expected.size());
+        REQUIRE(std::equal(parallel.begin(), parallel.end(), expected.begin(), same));
+    }
+    REQUIRE_THROWS_AS(engine.set_parallel(4, 0), std::invalid_argument);
+}
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Drivers summed per period and code", "[level18][damage]") {
+    auto db = create_physical_risk_db();
+    db->execute_update(
+        "INSERT INTO asset_exposure (asset_id, asset_code, asset_name, asset_type, latitude, longitude, "
+        "replacement_value, inventory_value, annual_revenue) VALUES "
+        "(1, 'ZRH', 'Zurich', 'FACTORY', 47.3769, 8.5417, 1000000, 200000, 3650000),"
+        "(2, 'BSL', 'Basel', 'WAREHOUSE', 47.5596, 7.5886, 500000, 0, 0)", {});
+    // Two floods over Zurich in period 2, one spanning periods 1-2
+    db->execute_update(
+        "INSERT INTO physical_peril (peril_id, scenario_id, peril_type, peril_code, latitude, longitude, "
+        "intensity, intensity_unit, start_period, end_period, radius_km) VALUES "
+        "(1, 7, 'FLOOD', 'LIMMAT', 47.3769, 8.5417, 1.0, 'm', 1, 2, 20),"
+        "(2, 7, 'FLOOD', 'LAKE', 47.3769, 8.5417, 0.5, 'm', 2, NULL, 0),"
+        "(3, 7, 'FLOOD', 'RHINE', 47.5596, 7.5886, 2.0, 'm', 2, NULL, 5)", {});
+    db->execute_update(
+        "INSERT INTO scenario_drivers VALUES ('PHYSICAL_RISK', 7, 1, 'FLOOD_PPE_OLD', -1, 'CHF'),"
+        "('E', 7, 1, 'REVENUE', 100, 'CHF')", {});
+
+    PhysicalRiskEngine engine(db.get());
+    engine.set_damage_breakdown(true);
+    const int drivers = engine.process_scenario(7);
+
+    // Zurich: PPE, inventory and BI in both periods; Basel: PPE only (no inventory or revenue)
+    REQUIRE(drivers == 7);
+    auto value = [&](int period, const std::string& code) {
+        auto rs = db->execute_query(
+            "SELECT COUNT(*), SUM(value) FROM scenario_drivers "
+            "WHERE scenario_id = 7 AND period_id = :p AND driver_code = :code",
+            {{"p", period}, {"code", code}});
+        REQUIRE(rs->next());
+        REQUIRE(rs->get_int(0) == 1);
+        return rs->get_double(1);
+    };
+    // LIMMAT at its center: 1m → 30% PPE; LAKE adds 0.5m → 15%
+    REQUIRE_THAT(value(1, "FLOOD_PPE_ZRH"), Catch::Matchers::WithinAbs(-300000.0, 1e-6));
+    REQUIRE_THAT(value(2, "FLOOD_PPE_ZRH"), Catch::Matchers::WithinAbs(-450000.0, 1e-6));
+    REQUIRE_THAT(value(2, "FLOOD_BI_ZRH"), Catch::Matchers::WithinAbs(-10000.0 * 30.0, 1e-6));
+    REQUIRE(value(2, "FLOOD_PPE_BSL") < 0.0);
+
+    // Old physical risk drivers replaced, other drivers kept
+    auto count = [&](const std::string& where) {
+        auto rs = db->execute_query("SELECT COUNT(*) FROM scenario_drivers WHERE " + where, {});
+        REQUIRE(rs->next());
+        return rs->get_int(0);
+    };
+    REQUIRE(count("driver_code = 'FLOOD_PPE_OLD'") == 0);
+    REQUIRE(count("driver_code = 'REVENUE'") == 1);
+
+    // The breakdown keeps one row per asset, peril and period
+    auto breakdown = db->execute_query(
+        "SELECT COUNT(*), SUM(ppe_loss) FROM physical_risk_damage WHERE scenario_id = 7 AND asset_id = 1", {});
+    REQUIRE(breakdown->next());
+    REQUIRE(breakdown->get_int(0) == 3);
+    REQUIRE_THAT(breakdown->get_double(1), Catch::Matchers::WithinAbs(750000.0, 1e-6));
+
+    // Reprocessing replaces rather than appends
+    REQUIRE(engine.process_scenario(7) == 7);
+    REQUIRE(count("scenario_id = 7 AND entity_id = 'PHYSICAL_RISK'") == 7);
+    REQUIRE(count("1 = 1") == 8);
+    auto rows = db->execute_query("SELECT COUNT(*) FROM physical_risk_damage", {});
+    REQUIRE(rows->next());
+    REQUIRE(rows->get_int(0) == 4);
+}
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Damage curves assigned per asset archetype", "[level18][damage]") {
+    auto db = create_physical_risk_db();
+    db->execute_update(
+        "CREATE TABLE damage_curve (curve_id INTEGER PRIMARY KEY, curve_code TEXT NOT NULL UNIQUE,"
+        "  peril_type TEXT NOT NULL, archetype TEXT NOT NULL, value_type TEXT NOT NULL,"
+        "  curve_points TEXT NOT NULL, intensity_unit TEXT NOT NULL, driver_code TEXT,"
+        "  UNIQUE(peril_type, archetype, value_type))", {});
+    db->execute_update(
+        "INSERT INTO damage_curve (curve_code, peril_type, archetype, value_type, curve_points, intensity_unit) "
+        "VALUES ('WH_FLOOD_PPE', 'FLOOD', 'WAREHOUSE', 'PPE', '[[0,0],[1,1]]', 'm'),"
+        "('TW_FLOOD_BI', 'FLOOD', 'TOWER', 'BI', '[[0,0],[1,5]]', 'm'),"
+        "('TW_WIND_PPE', 'WIND', 'TOWER', 'PPE', '[[0,0],[100,0.5]]', 'km/h'),"
+        "('TW_FLOOD_CARGO', 'FLOOD', 'TOWER', 'CARGO', '[[0,0],[1,1]]', 'm')", {});
+
+    const std::vector<std::string> types = {"FACTORY", "WAREHOUSE", "TOWER"};
+    std::mt19937 rng(91);
+    std::normal_distribution<double> jitter(0.0, 0.1);
+    std::vector<finmodel::ParamMap> rows;
+    for (int i = 1; i <= 600; ++i) {
+        rows.push_back({{"id", i}, {"code", std::string("A").append(std::to_string(i))},
+                        {"type", types[static_cast<size_t>(i) % 3]},
+                        {"lat", 47.3769 + jitter(rng)}, {"lon", 8.5417 + jitter(rng)}});
+    }
+    db->execute_batch(
+        "INSERT INTO asset_exposure (asset_id, asset_code, asset_name, asset_type, latitude, longitude, "
+        "replacement_value, inventory_value, annual_revenue) "
+        "VALUES (:id, :code, :code, :type, :lat, :lon, 1000000, 100000, 3650000)", rows);
+    db->execute_update(
+        "INSERT INTO physical_peril (scenario_id, peril_type, peril_code, latitude, longitude, intensity, "
+        "intensity_unit, start_period, end_period, radius_km) VALUES "
+        "(1, 'FLOOD', 'ZRH', 47.3769, 8.5417, 1.5, 'm', 1, 2, 100),"
+        "(1, 'WIND', 'GUST', 47.3769, 8.5417, 120, 'km/h', 1, NULL, 100)", {});
+
+    PhysicalRiskEngine engine(db.get());
+    const auto& registry = engine.get_registry();
+    REQUIRE(registry.size() == 7);   // Value types other than PPE, INVENTORY and BI skipped
+
+    // Archetype curves override the peril type's, target by target
+    const auto flood = registry.peril_type_id("FLOOD");
+    const auto wind = registry.peril_type_id("WIND");
+    REQUIRE(wind != DamageFunctionRegistry::UNKNOWN_PERIL);
+    const IDamageFunction* warehouse_ppe = registry.get_function("WH_FLOOD_PPE");
+    const IDamageFunction* tower_bi = registry.get_function("TW_FLOOD_BI");
+    REQUIRE(registry.curve(registry.curve_id(flood, DamageTarget::PPE, "WAREHOUSE")) == warehouse_ppe);
+    REQUIRE(registry.curve(registry.curve_id(flood, DamageTarget::PPE, "TOWER")) == registry.get_function("F_PPE"));
+    REQUIRE(registry.curve(registry.curve_id(flood, DamageTarget::BI, "TOWER")) == tower_bi);
+    REQUIRE(registry.curve_id(wind, DamageTarget::PPE, "FACTORY") == DamageFunctionRegistry::NO_CURVE);
+    REQUIRE(registry.get_function_for_peril(wind, DamageTarget::PPE) == nullptr);
+
+    const DamageCurveAssignment curves(registry, {"FACTORY", "WAREHOUSE", "FACTORY"});
+    CHECK(curves.shared_curve(flood, DamageTarget::PPE) == DamageCurveAssignment::MIXED);
+    CHECK(curves.shared_curve(flood, DamageTarget::BI) == registry.curve_id(flood, DamageTarget::BI));
+    CHECK(curves.curve(1, flood, DamageTarget::PPE) == registry.curve_id(flood, DamageTarget::PPE, "WAREHOUSE"));
+    CHECK(curves.shared_curve(DamageFunctionRegistry::UNKNOWN_PERIL, DamageTarget::PPE) ==
+          DamageFunctionRegistry::NO_CURVE);
+
+    const auto damages = engine.calculate_damages(1);
+    size_t flood_damages = 0;
+    size_t wind_damages = 0;
+    for (const auto& damage : damages) {
+        const std::string& type = types[static_cast<size_t>(damage.asset_id) % 3];
+        const double intensity = damage.adjusted_intensity;
+        if (damage.peril_type == "WIND") {
+            REQUIRE(type == "TOWER");
+            REQUIRE(damage.ppe_damage_pct == registry.get_function("TW_WIND_PPE")->calculate(intensity));
+            ++wind_damages;
+            continue;
+        }
+        const IDamageFunction* ppe = (type == "WAREHOUSE") ? warehouse_ppe : registry.get_function("F_PPE");
+        const IDamageFunction* bi = (type == "TOWER") ? tower_bi : registry.get_function("F_BI");
+        REQUIRE(damage.ppe_damage_pct == ppe->calculate(intensity));
+        REQUIRE(damage.inventory_damage_pct == registry.get_function("F_INV")->calculate(intensity));
+        REQUIRE(damage.bi_downtime_days == bi->calculate(intensity));
+        ++flood_damages;
+    }
+    CHECK(flood_damages == 2 * 600);
+    CHECK(wind_damages == 200);
+
+    // Grouping by curve doesn't depend on the shards
+    engine.set_parallel(4, 7);
+    const auto parallel = engine.calculate_damages(1);
+    REQUIRE(parallel.size() == damages.size());
+    for (size_t i = 0; i < damages.size(); ++i) {
+        REQUIRE(parallel[i].asset_id == damages[i].asset_id);
+        REQUIRE(parallel[i].ppe_loss_amount == damages[i].ppe_loss_amount);
+        REQUIRE(parallel[i].bi_loss_amount == damages[i].bi_loss_amount);
+    }
+}
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Intensity pathways scale perils per period", "[level18][damage]") {
+    auto db = create_physical_risk_db();
+    db->execute_update(
+        "CREATE TABLE physical_peril_pathway (scenario_id INTEGER NOT NULL, peril_id INTEGER, peril_type TEXT,"
+        "  period_id INTEGER NOT NULL, intensity_factor REAL NOT NULL)", {});
+    db->execute_update(
+        "INSERT INTO asset_exposure (asset_id, asset_code, asset_name, asset_type, latitude, longitude, "
+        "replacement_value, inventory_value, annual_revenue) VALUES "
+        "(1, 'ZRH', 'Zurich', 'FACTORY', 47.3769, 8.5417, 1000000, 0, 0),"
+        "(2, 'WIN', 'Winterthur', 'FACTORY', 47.4988, 8.7237, 1000000, 0, 0)", {});
+    db->execute_update(
+        "INSERT INTO physical_peril (peril_id, scenario_id, peril_type, peril_code, latitude, longitude, "
+        "intensity, intensity_unit, start_period, end_period, radius_km) VALUES "
+        "(1, 3, 'FLOOD', 'LIMMAT', 47.3769, 8.5417, 1.0, 'm', 1, 4, 40),"
+        "(2, 3, 'HURRICANE', 'STORM', 47.3769, 8.5417, 200, 'km/h', 1, 2, 100),"
+        "(3, 4, 'FLOOD', 'LIMMAT', 47.3769, 8.5417, 1.0, 'm', 1, 4, 40)", {});
+    // A climate pathway for floods of scenario 3; LIMMAT's own period 4 wins over it
+    db->execute_update(
+        "INSERT INTO physical_peril_pathway VALUES "
+        "(3, NULL, 'FLOOD', 2, 1.5), (3, NULL, 'FLOOD', 3, 2.0), (3, NULL, 'FLOOD', 4, 2.5), (3, 1, NULL, 4, 3.0),"
+        "(4, NULL, 'HURRICANE', 2, 9.0)", {});
+
+    PhysicalRiskEngine engine(db.get());
+    const auto damages = engine.calculate_damages(3);
+    std::map<std::pair<std::string, int>, DamageResult> by_peril_period;
+    for (const auto& damage : damages) {
+        if (damage.asset_code == "ZRH") {
+            by_peril_period.emplace(std::make_pair(damage.peril_code, damage.period), damage);
+        }
+    }
+
+    // Zurich at the center: PPE curve [[0,0],[1,0.3],[3,1]]
+    const std::vector<std::pair<double, double>> expected = {{1.0, 0.3}, {1.5, 0.475}, {2.0, 0.65}, {3.0, 1.0}};
+    for (int period = 1; period <= 4; ++period) {
+        const auto& damage = by_peril_period.at({"LIMMAT", period});
+        REQUIRE_THAT(damage.adjusted_intensity, Catch::Matchers::WithinAbs(expected[period - 1].first, 1e-9));
+        REQUIRE_THAT(damage.ppe_damage_pct, Catch::Matchers::WithinAbs(expected[period - 1].second, 1e-9));
+    }
+    REQUIRE(by_peril_period.at({"STORM", 1}).ppe_loss_amount == by_peril_period.at({"STORM", 2}).ppe_loss_amount);
+
+    // Winterthur (~19km): decayed once, scaled per period
+    const DamageResult* first = nullptr;
+    for (const auto& damage : damages) {
+        if (damage.asset_code == "WIN" && damage.peril_code == "LIMMAT") {
+            if (!first) {
+                first = &damage;
+            }
+            REQUIRE(damage.distance_km == first->distance_km);
+            REQUIRE_THAT(damage.adjusted_intensity,
+                         Catch::Matchers::WithinAbs(first->adjusted_intensity * expected[damage.period - 1].first, 1e-9));
+        }
+    }
+    REQUIRE(first);
+
+    // Another scenario's pathway doesn't apply
+    for (const auto& damage : engine.calculate_damages(4)) {
+        REQUIRE(damage.adjusted_intensity <= 1.0);
+    }
+}
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Hazard maps sampled at every asset", "[level18][damage]") {
+    namespace fs = std::filesystem;
+    const fs::path path = fs::temp_directory_path() / "finmodel_hazard_engine_test.fmhg";
+
+    // Flood depths over Switzerland: 1m everywhere in period 2, 2m in period 5
+    HazardGridSpec spec;
+    spec.rows = 40;
+    spec.cols = 60;
+    spec.lat_origin = 45.5;
+    spec.lon_origin = 5.5;
+    spec.lat_step = 0.1;
+    spec.lon_step = 0.1;
+    std::vector<float> values(2 * 40 * 60, 1.0f);
+    std::fill(values.begin() + 40 * 60, values.end(), 2.0f);
+    HazardGrid::write(path.string(), spec, {2, 5}, values, 16);
+
+    auto db = create_physical_risk_db();
+    db->execute_update(
+        "INSERT INTO asset_exposure (asset_id, asset_code, asset_name, asset_type, latitude, longitude, "
+        "replacement_value, inventory_value, annual_revenue) VALUES "
+        "(1, 'ZRH', 'Zurich', 'FACTORY', 47.3769, 8.5417, 1000000, 0, 0),"
+        "(2, 'NYC', 'New York', 'OFFICE', 40.71, -74.0, 1000000, 0, 0)", {});
+    db->execute_update(
+        "INSERT INTO physical_peril (peril_id, scenario_id, peril_type, peril_code, latitude, longitude, "
+        "intensity, intensity_unit, start_period, end_period, radius_km) VALUES "
+        "(1, 8, 'FLOOD', 'LIMMAT', 47.3769, 8.5417, 1.0, 'm', 2, NULL, 20)", {});
+
+    PhysicalRiskEngine engine(db.get());
+    engine.add_hazard_map(8, {"FLOOD", "CH_FLOOD", std::make_shared<const HazardGrid>(path.string())});
+    engine.add_hazard_map(9, {"FLOOD", "OTHER", std::make_shared<const HazardGrid>(path.string())});
+    const auto damages = engine.calculate_damages(8);
+
+    // The point peril first, then the map's bands; New York is off the map
+    REQUIRE(damages.size() == 3);
+    REQUIRE(damages[0].peril_code == "LIMMAT");
+    REQUIRE(damages[1].peril_code == "CH_FLOOD");
+    REQUIRE(damages[1].peril_id == HAZARD_MAP_PERIL_ID);
+    REQUIRE(damages[1].asset_code == "ZRH");
+    REQUIRE(damages[1].period == 2);
+    REQUIRE_THAT(damages[1].ppe_loss_amount, Catch::Matchers::WithinAbs(300000.0, 1e-6));
+    REQUIRE(damages[2].period == 5);
+    REQUIRE_THAT(damages[2].ppe_loss_amount, Catch::Matchers::WithinAbs(650000.0, 1e-6));
+
+    // Map and peril losses of a period add up in its driver
+    engine.set_damage_breakdown(true);
+    REQUIRE(engine.process_scenario(8) == 2);
+    auto rs = db->execute_query(
+        "SELECT value FROM scenario_drivers WHERE scenario_id = 8 AND period_id = 2 AND driver_code = 'FLOOD_PPE_ZRH'", {});
+    REQUIRE(rs->next());
+    REQUIRE_THAT(rs->get_double(0), Catch::Matchers::WithinAbs(-600000.0, 1e-6));
+    auto breakdown = db->execute_query(
+        "SELECT COUNT(*) FROM physical_risk_damage WHERE scenario_id = 8 AND peril_id IS NULL", {});
+    REQUIRE(breakdown->next());
+    REQUIRE(breakdown->get_int(0) == 2);
+
+    engine.clear_hazard_maps();
+    REQUIRE(engine.calculate_damages(8).size() == 1);
+    REQUIRE_THROWS_AS(engine.add_hazard_map(8, {"FLOOD", "NONE", nullptr}), std::invalid_argument);
+    fs::remove(path);
+}
+
+TEST_CASE("Level 18: EventSimulation - Philox streams and loss sketches", "[level18][damage]") {
+    // Philox4x32-10 known-answer vectors (Random123)
+    REQUIRE(PhiloxStream::block({0, 0, 0, 0}, {0, 0}) ==
+            std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    REQUIRE(PhiloxStream::block({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) ==
+            std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+    // Streams are reproducible and Poisson counts have the right mean
+    PhiloxStream a(42, 7);
+    PhiloxStream b(42, 7);
+    double total = 0.0;
+    for (int i = 0; i < 20000; ++i) {
+        const double u = a.uniform();
+        REQUIRE(u == b.uniform());
+        REQUIRE((u > 0.0 && u < 1.0));
+        total += static_cast<double>(a.poisson(40.0));
+        b.poisson(40.0);
+    }
+    REQUIRE_THAT(total / 20000, Catch::Matchers::WithinRel(40.0, 0.01));
+
+    // Quantiles within the relative accuracy, however the losses are split
+    std::vector<double> losses;
+    std::mt19937 rng(53);
+    std::lognormal_distribution<double> loss(10.0, 2.0);
+    LossSketch whole(0.01);
+    LossSketch part1(0.01);
+    LossSketch part2(0.01);
+    for (int i = 0; i < 5000; ++i) {
+        losses.push_back(i % 5 == 0 ? 0.0 : loss(rng));
+        whole.add(losses.back());
+        (i % 3 == 0 ? part1 : part2).add(losses.back());
+    }
+    part1.merge(part2);
+    std::sort(losses.begin(), losses.end(), std::greater<>());
+    REQUIRE(whole.count() == 5000);
+    for (uint64_t k : {1, 10, 50, 999, 3999}) {
+        REQUIRE_THAT(whole.top_value(k), Catch::Matchers::WithinRel(losses[k - 1], 0.01));
+        REQUIRE(part1.top_value(k) == whole.top_value(k));
+    }
+    REQUIRE(whole.top_value(4500) == 0.0);
+    double top_sum = 0.0;
+    for (int i = 0; i < 50; ++i) {
+        top_sum += losses[i];
+    }
+    REQUIRE_THAT(whole.top_mean(50), Catch::Matchers::WithinRel(top_sum / 50, 0.01));
+    REQUIRE_THAT(whole.quantile(0.99), Catch::Matchers::WithinRel(losses[50], 0.01));
+    REQUIRE_THROWS_AS(LossSketch(0.0), std::invalid_argument);
+    REQUIRE_THROWS_AS(part1.merge(LossSketch(0.02)), std::invalid_argument);
+}
+
+TEST_CASE("Level 18: PhysicalRiskEngine - Event catalogue annual losses", "[level18][damage]") {
+    auto db = create_physical_risk_db();
+    db->execute_update(
+        "INSERT INTO asset_exposure (asset_id, asset_code, asset_name, asset_type, latitude, longitude, "
+        "entity_code, replacement_value, inventory_value, annual_revenue) VALUES "
+        "(1, 'ZRH', 'Zurich', 'FACTORY', 47.3769, 8.5417, 'E1', 1000000, 200000, 3650000),"
+        "(2, 'BSL', 'Basel', 'WAREHOUSE', 47.5596, 7.5886, 'E2', 500000, 0, 0)", {});
+    db->execute_update(
+        "INSERT INTO physical_event (event_id, catalogue_code, peril_type, latitude, longitude, intensity, "
+        "radius_km, annual_rate) VALUES "
+        "(1, 'CH', 'FLOOD', 47.3769, 8.5417, 3.0, 0, 0.05),"
+        "(2, 'CH', 'FLOOD', 47.5596, 7.5886, 1.0, 0, 0.2),"
+        "(3, 'CH', 'FLOOD', 40.71, -74.0, 3.0, 0, 1.0),"
+        "(4, 'OTHER', 'FLOOD', 47.3769, 8.5417, 3.0, 0, 1.0)", {});
+
+    // One Zurich flood: 1.0M PPE, 160k inventory, 60 days of BI (600k)
+    const double zrh_loss = 1760000.0;
+    const double bsl_loss = 150000.0;
+
+    PhysicalRiskEngine engine(db.get());
+    MonteCarloOptions options;
+    options.years = 100000;
+    options.per_asset = true;
+    const MonteCarloResult result = engine.simulate_annual_losses("CH", options);
+
+    REQUIRE(result.events == 3);
+    REQUIRE(result.entities.size() == 2);
+    REQUIRE_THAT(result.entities.at("E1").expected_annual_loss, Catch::Matchers::WithinRel(0.05 * zrh_loss, 1e-12));
+    REQUIRE_THAT(result.portfolio.expected_annual_loss,
+                 Catch::Matchers::WithinRel(0.05 * zrh_loss + 0.2 * bsl_loss, 1e-12));
+
+    // Zurich floods in ~4.9% of years, twice in ~0.12%: one flood at 1-in-100
+    // and 1-in-250. Basel floods twice in ~1.75% of years, three times in ~0.1%
+    const auto& e1 = result.entities.at("E1");
+    REQUIRE_THAT(e1.at(100)->var, Catch::Matchers::WithinRel(zrh_loss, 0.01));
+    REQUIRE_THAT(e1.at(250)->var, Catch::Matchers::WithinRel(zrh_loss, 0.01));
+    REQUIRE(e1.at(100)->tvar > e1.at(100)->var);
+    REQUIRE(e1.at(100)->tvar < 1.2 * zrh_loss);
+    const auto& e2 = result.entities.at("E2");
+    REQUIRE_THAT(e2.at(100)->var, Catch::Matchers::WithinRel(2 * bsl_loss, 0.01));
+    REQUIRE_THAT(e2.at(250)->var, Catch::Matchers::WithinRel(2 * bsl_loss, 0.01));
+    REQUIRE(result.assets.at(1).at(100)->var == e1.at(100)->var);
+    REQUIRE(result.portfolio.at(250)->var >= e1.at(250)->var);
+    REQUIRE(result.portfolio.at(50) == nullptr);
+
+    // The same statistics on any number of threads
+    engine.set_parallel(4);
+    const MonteCarloResult parallel = engine.simulate_annual_losses("CH", options);
+    REQUIRE(parallel.portfolio.at(100)->var == result.portfolio.at(100)->var);
+    REQUIRE(parallel.portfolio.at(250)->tvar == result.portfolio.at(250)->tvar);
+    REQUIRE(parallel.entities.at("E2").at(100)->tvar == e2.at(100)->tvar);
+
+    // Expected-loss drivers, then 1-in-100 drivers (the asset's VaR)
+    REQUIRE(engine.generate_loss_drivers(5, result, {1, 2}) == 2 * 4);
+    auto driver = [&](const char* code) {
+        auto rs = db->execute_query(
+            "SELECT value FROM scenario_drivers WHERE scenario_id = 5 AND period_id = 2 AND driver_code = :code",
+            {{"code", std::string(code)}});
+        REQUIRE(rs->next());
+        return rs->get_double(0);
+    };
+    REQUIRE_THAT(driver("FLOOD_PPE_ZRH"), Catch::Matchers::WithinRel(-0.05 * 1000000.0, 1e-12));
+    REQUIRE_THAT(driver("FLOOD_PPE_BSL"), Catch::Matchers::WithinRel(-0.2 * 150000.0, 1e-12));
+    REQUIRE(engine.generate_loss_drivers(5, result, {2}, 100) == 4);
+    REQUIRE_THAT(driver("FLOOD_PPE_ZRH"), Catch::Matchers::WithinRel(-1000000.0, 0.01));
+    REQUIRE_THAT(driver("FLOOD_BI_ZRH"), Catch::Matchers::WithinRel(-600000.0, 0.01));
+
+    options.per_asset = false;
+    REQUIRE_THROWS_AS(engine.generate_loss_drivers(5, engine.simulate_annual_losses("CH", options), {2}, 100),
+                      std::invalid_argument);
+    options.years = 0;
+    REQUIRE_THROWS_AS(engine.simulate_annual_losses("CH", options), std::invalid_argument);
 }
 
 TEST_CASE("Level 18: PhysicalRiskEngine - Load real assets from database", "[level18][engine]") {
@@ -105,7 +105,7 @@ TEST_CASE("Level 3: Three-statement circular link (5 periods)", "[level3]") {
             }
             if (!result.warnings.empty()) {
                 std::cout << "  WARNINGS in Period " << period << ":\n";
-                for (const auto& warn : result.warnings) {
+                for (const auto& warn : result.warnings.messages()) {
                     std::cout << "    " << warn << "\n";
                 }
             }
@@ -6,10 +6,12 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
 #include "database/database_factory.h"
+#include "database/result_set.h"
 #include "carbon/mac_curve_engine.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <random>
 
 using Catch::Approx;
 using namespace finmodel;
@@ -278,3 +280,213 @@ TEST_CASE("Level 10: MAC Curves - Cost-Effectiveness Analysis", "[mac][level10]"
         std::cout << "  ✓ Exported: test_output/level10_mac_summary.csv\n";
     }
 }
+
+namespace {
+
+// Just the MAC tables, with three actions in scenario 1 and one in scenario 2
+std::shared_ptr<IDatabase> create_mac_db() {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE management_action (action_code TEXT, action_name TEXT, action_category TEXT, "
+        "  is_active INTEGER);"
+        "CREATE TABLE scenario_action (scenario_id INTEGER, action_code TEXT, capex REAL, opex_annual REAL, "
+        "  emission_reduction_annual REAL, start_period INTEGER, end_period INTEGER);"
+        "CREATE TABLE mac_curve_point (scenario_id INTEGER, period_id INTEGER, action_code TEXT, "
+        "  cumulative_reduction_tco2e REAL, marginal_cost_per_tco2e REAL, annual_reduction_tco2e REAL, "
+        "  annual_cost_chf REAL);"
+        "INSERT INTO management_action VALUES ('LED', 'LED', 'EFFICIENCY', 1), ('SOLAR', 'Solar', 'TECH', 1), "
+        "  ('HEAT', 'Heat pump', 'TECH', 1), ('OLD', 'Retired', 'TECH', 0);"
+        "INSERT INTO scenario_action VALUES "
+        "  (1, 'LED', 50000, -10000, 30, 1, NULL), (1, 'SOLAR', 800000, 5000, 1500, 2, NULL), "
+        "  (1, 'HEAT', 200000, 1000, 400, 1, 2), (1, 'OLD', 0, 0, 10, 1, NULL), "
+        "  (2, 'SOLAR', 600000, 0, 1500, 3, NULL);"
+    );
+
+    return db;
+}
+
+} // namespace
+
+TEST_CASE("MACCurveEngine: Batch curves match per-period curves", "[mac_batch]") {
+    auto db = create_mac_db();
+    MACCurveEngine engine(db);
+    const std::vector<int> scenarios = {1, 2, 3};
+    const std::vector<int> periods = {1, 2, 3};
+    auto curves = engine.calculate_mac_curves(scenarios, periods);
+    REQUIRE(curves.size() == 9);
+
+    size_t k = 0;
+    for (int scenario_id : scenarios) {
+        for (int period_id : periods) {
+            const MACCurve& batch = curves[k++];
+            MACCurve single = engine.calculate_mac_curve(scenario_id, period_id);
+            REQUIRE(batch.scenario_id == scenario_id);
+            REQUIRE(batch.period_id == period_id);
+            REQUIRE(batch.points.size() == single.points.size());
+            for (size_t i = 0; i < batch.points.size(); ++i) {
+                CHECK(batch.points[i].action_code == single.points[i].action_code);
+                CHECK(batch.points[i].cumulative_reduction_tco2e == single.points[i].cumulative_reduction_tco2e);
+            }
+            CHECK(batch.total_annual_cost == single.total_annual_cost);
+        }
+    }
+
+    // Scenario 1 period 1: LED (savings) before HEAT; SOLAR starts in period 2
+    REQUIRE(curves[0].points.size() == 2);
+    CHECK(curves[0].points[0].action_code == "LED");
+    CHECK(curves[0].points[1].action_code == "HEAT");
+    CHECK(curves[0].points[1].cumulative_reduction_tco2e == Approx(430.0));
+    CHECK(curves[1].points.size() == 3);
+    CHECK(curves[2].points.size() == 2);   // HEAT ends after period 2
+    CHECK(curves[5].points.size() == 1);   // Scenario 2 period 3
+    CHECK(curves[6].points.empty());       // Scenario 3 has no actions
+
+    engine.store_mac_curves(curves);
+    auto count = db->execute_query("SELECT COUNT(*) AS n FROM mac_curve_point", {});
+    REQUIRE(count->next());
+    CHECK(count->get_int("n") == 2 + 3 + 2 + 1);
+
+    // Storing again replaces the curves
+    engine.store_mac_curves(curves);
+    auto stored = engine.load_mac_curve(1, 2);
+    REQUIRE(stored.points.size() == 3);
+    CHECK(stored.total_reduction_potential == Approx(1930.0));
+}
+
+TEST_CASE("MACCurveEngine: Cost edits reposition cached curve points", "[mac_batch]") {
+    auto db = create_mac_db();
+    MACCurveEngine engine(db);
+
+    const MACCurve& curve = engine.cached_mac_curve(1, 2);
+    REQUIRE(curve.points.size() == 3);
+    REQUIRE(curve.points[2].action_code == "SOLAR");
+    engine.cached_mac_curve(1, 1);   // Without SOLAR
+
+    auto check_matches_recalculation = [&](int period_id) {
+        MACCurve expected = engine.calculate_mac_curve(1, period_id);
+        const MACCurve& live = engine.cached_mac_curve(1, period_id);
+        REQUIRE(live.points.size() == expected.points.size());
+        for (size_t i = 0; i < live.points.size(); ++i) {
+            CHECK(live.points[i].action_code == expected.points[i].action_code);
+            CHECK(live.points[i].marginal_cost_per_tco2e == Approx(expected.points[i].marginal_cost_per_tco2e));
+            CHECK(live.points[i].cumulative_reduction_tco2e == Approx(expected.points[i].cumulative_reduction_tco2e));
+        }
+        CHECK(live.total_annual_cost == Approx(expected.total_annual_cost));
+        CHECK(live.weighted_average_cost == Approx(expected.weighted_average_cost));
+        CHECK(live.negative_cost_count == expected.negative_cost_count);
+        CHECK(live.low_cost_count == expected.low_cost_count);
+        CHECK(live.medium_cost_count == expected.medium_cost_count);
+        CHECK(live.high_cost_count == expected.high_cost_count);
+    };
+
+    // A subsidy makes SOLAR the cheapest action; only period 2 has it
+    CHECK(engine.update_action_cost(1, "SOLAR", 0.0, -300000.0) == 1);
+    db->execute_update("UPDATE scenario_action SET capex = 0, opex_annual = -300000 "
+                       "WHERE scenario_id = 1 AND action_code = 'SOLAR'", {});
+    CHECK(curve.points[0].action_code == "SOLAR");
+    CHECK(curve.points[0].cumulative_reduction_tco2e == Approx(1500.0));
+    check_matches_recalculation(2);
+
+    // HEAT moves from the middle to the end, in both cached periods
+    CHECK(engine.update_action_cost(1, "HEAT", 2000000.0, 0.0) == 2);
+    db->execute_update("UPDATE scenario_action SET capex = 2000000, opex_annual = 0 "
+                       "WHERE scenario_id = 1 AND action_code = 'HEAT'", {});
+    CHECK(curve.points[2].action_code == "HEAT");
+    check_matches_recalculation(1);
+    check_matches_recalculation(2);
+
+    CHECK(engine.update_action_cost(1, "MISSING", 0.0, 0.0) == 0);
+    CHECK(engine.update_action_cost(2, "HEAT", 0.0, 0.0) == 0);
+
+    // Cleared curves are calculated again
+    engine.clear_cached_curves(1);
+    CHECK(engine.cached_mac_curve(1, 2).points.size() == 3);
+}
+
+TEST_CASE("MACCurveEngine: Portfolio optimiser matches exhaustive search", "[mac_portfolio]") {
+    auto db = create_mac_db();
+    MACCurveEngine engine(db);
+
+    // Period 1 offers LED (saves CHF 5000/year) and HEAT; SOLAR only starts in period 2
+    auto both = engine.optimize_portfolio(1, {250000.0, 400.0, {1}});
+    REQUIRE(both.feasible);
+    CHECK(both.optimal);
+    CHECK(both.action_codes() == std::vector<std::string>{"LED", "HEAT"});
+    CHECK(both.total_annual_cost == Approx(16000.0));
+    CHECK(both.reductions == std::vector<double>{430.0});
+
+    auto tight = engine.optimize_portfolio(1, {200000.0, 400.0, {1}});
+    REQUIRE(tight.feasible);
+    CHECK(tight.action_codes() == std::vector<std::string>{"HEAT"});
+    CHECK_FALSE(engine.optimize_portfolio(1, {150000.0, 400.0, {1}}).feasible);
+    CHECK_FALSE(engine.optimize_portfolio(1, {900000.0, 400.0, {1, 3}}).feasible);   // HEAT ends in period 2
+    CHECK(engine.optimize_portfolio(1, {2000000.0, 400.0, {2, 3}}).action_codes() ==
+          std::vector<std::string>{"LED", "SOLAR"});
+
+    // The full engine finds the actions interact: 10% less than their sum
+    auto run = [](const std::vector<std::string>& codes) {
+        return std::vector<double>{codes.size() > 1 ? 0.9 * 430.0 : 400.0};
+    };
+    CHECK_FALSE(MACCurveEngine::verify_portfolio(both, run));
+    CHECK(both.verified_reductions == std::vector<double>{387.0});
+    CHECK(MACCurveEngine::verify_portfolio(tight, run));
+
+    // Random instances: the cheapest of all 2^12 subsets
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const std::vector<int> periods = {1, 2, 3};
+    for (int instance = 0; instance < 20; ++instance) {
+        std::vector<MACPoint> points(12);
+        for (size_t i = 0; i < points.size(); ++i) {
+            MACPoint& point = points[i];
+            point.action_code = "A" + std::to_string(i);
+            point.capex = 100000.0 * uniform(rng);
+            point.opex_annual = 20000.0 * (uniform(rng) - 0.3);
+            point.total_annual_cost = point.capex / 10.0 + point.opex_annual;
+            point.annual_reduction_tco2e = 100.0 * uniform(rng);
+            point.marginal_cost_per_tco2e = point.total_annual_cost / point.annual_reduction_tco2e;
+            point.start_period = 1 + static_cast<int>(uniform(rng) * 2.0);
+            point.end_period = uniform(rng) < 0.3 ? 2 : -1;
+        }
+        const PortfolioOptions options{300000.0, 150.0 + 100.0 * uniform(rng), periods};
+
+        bool feasible = false;
+        double cheapest = 0.0;
+        for (uint32_t mask = 0; mask < (1u << points.size()); ++mask) {
+            double capex = 0.0;
+            double cost = 0.0;
+            std::vector<double> reached(periods.size(), 0.0);
+            for (size_t i = 0; i < points.size(); ++i) {
+                if (!(mask >> i & 1)) {
+                    continue;
+                }
+                capex += points[i].capex;
+                cost += points[i].total_annual_cost;
+                for (size_t p = 0; p < periods.size(); ++p) {
+                    if (points[i].start_period <= periods[p] &&
+                        (points[i].end_period < 0 || points[i].end_period >= periods[p])) {
+                        reached[p] += points[i].annual_reduction_tco2e;
+                    }
+                }
+            }
+            const bool meets = std::all_of(reached.begin(), reached.end(),
+                                           [&](double r) { return r >= options.target_reduction_tco2e; });
+            if (capex <= options.capex_budget && meets && (!feasible || cost < cheapest)) {
+                feasible = true;
+                cheapest = cost;
+            }
+        }
+
+        auto portfolio = MACCurveEngine::optimize_portfolio(points, options);
+        REQUIRE(portfolio.feasible == feasible);
+        CHECK(portfolio.optimal);
+        CHECK(portfolio.nodes < (2u << points.size()));
+        if (feasible) {
+            CHECK(portfolio.total_annual_cost == Approx(cheapest));
+            CHECK(portfolio.total_capex <= options.capex_budget);
+            for (double reduction : portfolio.reductions) {
+                CHECK(reduction >= options.target_reduction_tco2e - 1e-6);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file test_mpsc_ring.cpp
+ * @brief Tests for the bounded multi-producer, single-consumer ring
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "core/mpsc_ring.h"
+#include <thread>
+#include <vector>
+
+using namespace finmodel;
+
+TEST_CASE("MpscRing: A full ring holds producers back", "[core][mpsc_ring]") {
+    // Until the consumer takes something
+    core::MpscRing<int> ring(2);
+    ring.push([](int& v) { v = 1; });
+    ring.push([](int& v) { v = 2; });
+    std::thread producer([&] { ring.push([](int& v) { v = 3; }); });
+    while (ring.stats().stalls == 0) {
+        std::this_thread::yield();
+    }
+    std::vector<int> taken(2);
+    CHECK(ring.pop(taken.data(), 2) == 2);
+    producer.join();
+    CHECK(taken == std::vector<int>{1, 2});
+    CHECK(ring.pop(taken.data(), 2) == 1);
+    CHECK(taken[0] == 3);
+    CHECK(ring.stats().depth == 0);
+    CHECK(ring.stats().max_depth == 2);
+}
+
+TEST_CASE("MpscRing: Every producer's items reach the consumer in order", "[core][mpsc_ring]") {
+    core::MpscRing<std::vector<int>> ring(3);
+    REQUIRE(ring.capacity() == 4);
+
+    constexpr int producers = 4;
+    constexpr int items = 500;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < items; ++i) {
+                ring.push([&](std::vector<int>& item) { item.assign({p, i}); });
+            }
+        });
+    }
+    std::thread closer([&] {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ring.close();
+    });
+
+    std::vector<int> next(producers, 0);
+    std::vector<std::vector<int>> batch(ring.capacity());
+    size_t received = 0;
+    while (true) {
+        // Closed before the pop: every item was pushed before it
+        const bool closed = ring.closed();
+        size_t n = ring.pop(batch.data(), batch.size());
+        if (n == 0) {
+            if (closed) {
+                break;
+            }
+            ring.wait();
+            continue;
+        }
+        for (size_t k = 0; k < n; ++k) {
+            REQUIRE(batch[k].size() == 2);
+            CHECK(batch[k][1] == next[batch[k][0]]++);
+        }
+        received += n;
+    }
+    closer.join();
+
+    CHECK(received == producers * items);
+    CHECK(ring.stats().pushes == producers * items);
+    CHECK(ring.stats().depth == 0);
+    CHECK(ring.stats().max_depth <= ring.capacity());
+}
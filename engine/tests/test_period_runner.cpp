@@ -7,14 +7,31 @@
 #include <catch2/catch_approx.hpp>
 #include "orchestration/period_runner.h"
 #include "orchestration/period_setup.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/deferred_validation.h"
+#include "orchestration/budgeted_results.h"
+#include "orchestration/scenario_generator.h"
+#include "core/engine_metrics.h"
+#include "core/formula_evaluator.h"
+#include "tax/loss_carryforward_tax_strategy.h"
+#include "bs/providers/statement_value_provider.h"
+#include "unified/providers/driver_pack.h"
 #include "database/database_factory.h"
 #include "database/result_set.h"
+#include "test_databases.h"
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <set>
 
 using namespace finmodel;
 using namespace finmodel::orchestration;
 using namespace finmodel::database;
+using namespace finmodel::test;
 using Catch::Approx;
 
 // ============================================================================
@@ -37,7 +54,11 @@ struct PeriodRunnerFixture {
     }
 
     ~PeriodRunnerFixture() {
-        cleanup_test_periods();
+        try {
+            cleanup_test_periods();
+        } catch (const std::exception&) {
+            // No period table (database missing): nothing to clean up, and destructors mustn't throw
+        }
     }
 };
 
@@ -341,3 +362,1822 @@ TEST_CASE_METHOD(PeriodRunnerFixture, "PeriodRunner: Performance - 10 scenarios
     // Performance target: < 5 seconds for 10 scenarios × 12 periods
     CHECK(duration.count() < 5000);
 }
+
+// ============================================================================
+// Incremental Recalculation Tests
+// ============================================================================
+
+TEST_CASE("PeriodRunner: Incremental rerun after a driver change", "[orchestration][incremental]") {
+    auto db = create_incremental_db();
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    PeriodRunner runner(db);
+    runner.set_incremental(true);
+    auto first = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(first.success);
+    CHECK(runner.engine().last_recalculated_count() == 5);
+    CHECK(first.results[2].get_value("CASH") == Approx(100.0 + 3 * 300.0));
+
+    db->execute_update(
+        "UPDATE scenario_drivers SET value = 500.0 WHERE period_id = 2 AND driver_code = 'COSTS'", {});
+    auto rerun = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(rerun.success);
+
+    // Period 3 only re-evaluates CASH, reached through CASH[t-1]
+    CHECK(runner.engine().last_recalculated_count() == 1);
+
+    PeriodRunner full_runner(db);
+    auto full = full_runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(full.success);
+    for (size_t p = 0; p < periods.size(); ++p) {
+        CHECK(rerun.results[p].get_all_values() == full.results[p].get_all_values());
+    }
+    CHECK(rerun.results[1].get_value("NET") == Approx(375.0));
+    CHECK(rerun.results[2].get_value("CASH") == Approx(100.0 + 300.0 + 375.0 + 300.0));
+
+    // Unchanged rerun evaluates nothing
+    runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    CHECK(runner.engine().last_recalculated_count() == 0);
+}
+
+TEST_CASE("UnifiedEngine: Sparse runs skip all-zero subgraphs", "[orchestration][sparse]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO scenario_drivers VALUES ('E', 2, 1, 'REVENUE', 1000.0, 'EUR'), ('E', 2, 1, 'COSTS', 600.0, 'EUR'), "
+        "  ('E', 2, 1, 'OTHER', 0.0, 'EUR'), "
+        "  ('E', 3, 1, 'REVENUE', 0.0, 'EUR'), ('E', 3, 1, 'COSTS', 0.0, 'EUR'), ('E', 3, 1, 'OTHER', 0.0, 'EUR');"
+    );
+    BalanceSheet zero_bs;
+    zero_bs.line_items["CASH"] = 0.0;
+
+    unified::UnifiedEngine full(db);
+    unified::UnifiedEngine sparse(db);
+    sparse.set_sparse(true);
+    for (ScenarioID scenario : {1, 2, 3}) {
+        auto expected = full.calculate("E", scenario, 1, zero_bs, "INCREMENTAL_TEST");
+        auto actual = sparse.calculate("E", scenario, 1, zero_bs, "INCREMENTAL_TEST");
+        REQUIRE(actual.success);
+        CHECK(actual.get_all_values() == expected.get_all_values());
+    }
+
+    // Scenario 3: every driver and the opening are zero, no formula runs
+    CHECK(sparse.last_skipped_count() == 5);
+    CHECK(sparse.last_recalculated_count() == 0);
+
+    // Scenario 2: only OTHER_SCALED reads zeros only
+    sparse.calculate("E", 2, 1, zero_bs, "INCREMENTAL_TEST");
+    CHECK(sparse.last_skipped_count() == 1);
+    CHECK(sparse.last_recalculated_count() == 4);
+
+    // A non-zero opening reaches CASH through CASH[t-1]
+    BalanceSheet opening_bs;
+    opening_bs.line_items["CASH"] = 100.0;
+    auto result = sparse.calculate("E", 3, 1, opening_bs, "INCREMENTAL_TEST");
+    CHECK(result.get_value("CASH") == Approx(100.0));
+    CHECK(sparse.last_skipped_count() == 4);
+
+    sparse.set_sparse(false);
+    sparse.calculate("E", 3, 1, zero_bs, "INCREMENTAL_TEST");
+    CHECK(sparse.last_skipped_count() == 0);
+    CHECK(sparse.last_recalculated_count() == 5);
+}
+
+TEST_CASE("ReferenceDataStore: Reloads reach runners at their next run", "[orchestration][reference]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO unit_definition VALUES ('kEUR', 'Thousand euro', 'CURRENCY', 'STATIC', 1000.0, 'EUR', 'kEUR', '', 1);"
+        "INSERT INTO fx_rate VALUES ('USD', 'EUR', 1, 0.90);"
+        "UPDATE scenario_drivers SET value = 1.0, unit_code = 'kEUR' WHERE driver_code = 'REVENUE';"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    auto reference = std::make_shared<core::ReferenceDataStore>(db);
+    auto first = reference->current();
+    CHECK(first->version == 1);
+    CHECK(first->units->base_factor(first->units->unit_id("kEUR"), 1) == Approx(1000.0));
+    CHECK(first->fx->get_rate("USD", "EUR", 1) == Approx(0.90));
+
+    PeriodRunner runner(db, reference);
+    PeriodRunner other(db, reference);
+    auto before = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(before.success);
+    CHECK(before.results[0].get_value("GROSS") == Approx(400.0));
+    CHECK(runner.engine().reference_version() == 1);
+
+    // The runners share one snapshot; a reload replaces it without touching the old one
+    db->execute_raw(
+        "UPDATE unit_definition SET static_conversion_factor = 2000.0 WHERE unit_code = 'kEUR';"
+        "UPDATE fx_rate SET rate = 0.80;"
+    );
+    auto second = reference->reload();
+    CHECK(second->version == 2);
+    CHECK(reference->version() == 2);
+    CHECK(first->units->base_factor(first->units->unit_id("kEUR"), 1) == Approx(1000.0));
+    CHECK(first->fx->get_rate("USD", "EUR", 1) == Approx(0.90));
+    CHECK(second->units->base_factor(second->units->unit_id("kEUR"), 1) == Approx(2000.0));
+    CHECK(second->fx->get_rate("USD", "EUR", 1) == Approx(0.80));
+    CHECK(runner.engine().reference_version() == 1);
+
+    auto after = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(after.success);
+    CHECK(runner.engine().reference_version() == 2);
+    CHECK(after.results[0].get_value("GROSS") == Approx(1400.0));
+    CHECK(other.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST").results[2].get_value("CASH")
+          == Approx(100.0 + 3 * 1400.0 * 0.75));
+
+    unified::UnifiedEngine engine(db, reference);
+    CHECK(engine.reference_version() == 2);
+    CHECK_FALSE(engine.refresh_reference_data());
+}
+
+TEST_CASE("UnifiedEngine: Units and FX rates are read on the first conversion", "[orchestration][reference]") {
+    auto db = create_incremental_db();
+    db->execute_raw("ALTER TABLE unit_definition RENAME TO unit_definition_later;"
+                    "ALTER TABLE fx_rate RENAME TO fx_rate_later;");
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    // Constructing reads neither table
+    PeriodRunner runner(db);
+    CHECK(runner.engine().reference_version() == 0);
+
+    db->execute_raw("ALTER TABLE unit_definition_later RENAME TO unit_definition;"
+                    "ALTER TABLE fx_rate_later RENAME TO fx_rate;");
+    auto results = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(results.success);
+    CHECK(results.results[2].get_value("CASH") == Approx(100.0 + 3 * 300.0));
+}
+
+TEST_CASE("PeriodRunner: Loss carryforward carried between periods", "[orchestration][tax]") {
+    auto db = create_runner_db();
+    auto tmpl = core::StatementTemplate::load_from_json(R"json({
+        "template_code": "NOL_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "COSTS", "base_value_source": "driver:COSTS"},
+            {"code": "GROSS", "formula": "REVENUE - COSTS"},
+            {"code": "TAX", "formula": "TAX_COMPUTE(GROSS, \"NOL\")"},
+            {"code": "NET", "formula": "GROSS - TAX"}
+        ]
+    })json");
+    tmpl->save_to_database(db.get());
+    // Gross -500, -200, 400, 400
+    const double costs[] = {1500.0, 1200.0, 600.0, 600.0};
+    for (int period = 1; period <= 4; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 1000.0, 'EUR'), ('E', 1, :period, 'COSTS', :costs, 'EUR')",
+            {{"period", period}, {"costs", costs[period - 1]}}
+        );
+    }
+    const std::vector<PeriodID> periods = {1, 2, 3, 4};
+
+    SECTION("Losses offset later profits") {
+        PeriodRunner runner(db);
+        runner.register_tax_strategy("NOL", std::make_shared<pl::LossCarryforwardTaxStrategy>(0.25));
+        auto results = runner.run_periods("E", 1, periods, BalanceSheet{}, "NOL_TEST");
+        REQUIRE(results.success);
+        CHECK(results.results[0].get_value("TAX") == 0.0);
+        CHECK(results.results[2].get_value("TAX") == 0.0);
+        CHECK(results.results[3].get_value("TAX") == Approx(25.0));   // 300 of losses left for 400
+        CHECK(runner.engine().tax_state().at("NOL") == std::vector<double>{0.0});
+
+        // Every run starts without losses
+        auto profitable = runner.run_periods("E", 1, {3, 4}, BalanceSheet{}, "NOL_TEST");
+        CHECK(profitable.results[0].get_value("TAX") == Approx(100.0));
+    }
+
+    SECTION("Losses expire") {
+        PeriodRunner runner(db);
+        runner.register_tax_strategy("NOL", std::make_shared<pl::LossCarryforwardTaxStrategy>(0.25, 2));
+        auto results = runner.run_periods("E", 1, periods, BalanceSheet{}, "NOL_TEST");
+        REQUIRE(results.success);
+        // Period 3 uses 400 of period 1's loss; the other 100 expires with it
+        CHECK(results.results[2].get_value("TAX") == 0.0);
+        CHECK(results.results[3].get_value("TAX") == Approx(50.0));
+    }
+
+    SECTION("Checkpoints keep the loss pool") {
+        namespace fs = std::filesystem;
+        const fs::path root = "test_nol_checkpoints";
+        fs::remove_all(root);
+        auto store = std::make_shared<CheckpointStore>(root.string(), "nol");
+        auto strategy = std::make_shared<pl::LossCarryforwardTaxStrategy>(0.25);
+
+        PeriodRunner first(db);
+        first.register_tax_strategy("NOL", strategy);
+        first.set_checkpoints(store, 1);
+        first.run_periods("E", 1, {1, 2, 3}, BalanceSheet{}, "NOL_TEST");
+        CHECK(store->load("E", 1)->tax_state.at("NOL") == std::vector<double>{300.0});
+
+        PeriodRunner rerun(db);
+        rerun.register_tax_strategy("NOL", strategy);
+        rerun.set_checkpoints(store);
+        auto resumed = rerun.run_periods("E", 1, periods, BalanceSheet{}, "NOL_TEST");
+        REQUIRE(resumed.results.size() == 1);
+        CHECK(resumed.results[0].get_value("TAX") == Approx(25.0));
+        fs::remove_all(root);
+    }
+
+    SECTION("Lanes carry one state each") {
+        pl::LossCarryforwardTaxStrategy unlimited(0.25, 0, 0.8);
+        pl::LossCarryforwardTaxStrategy expiring(0.25, 2, 0.8);
+        const std::vector<std::vector<double>> incomes = {
+            {-500.0, 100.0, 0.0, -50.0}, {-200.0, -100.0, 300.0, 1000.0},
+            {400.0, 50.0, 200.0, -10.0}, {400.0, 700.0, 50.0, 20.0}
+        };
+        for (const pl::IStatefulTaxStrategy* strategy : {static_cast<const pl::IStatefulTaxStrategy*>(&unlimited),
+                                                         static_cast<const pl::IStatefulTaxStrategy*>(&expiring)}) {
+            const size_t lanes = 4;
+            std::vector<double> states(strategy->state_size() * lanes);
+            std::vector<std::vector<double>> scalar(lanes, std::vector<double>(strategy->state_size()));
+            for (auto& state : scalar) {
+                strategy->initial_state(state);
+            }
+            std::vector<double> tax(lanes);
+            for (const auto& period : incomes) {
+                strategy->calculate_tax_batch(period, tax, states);
+                for (size_t lane = 0; lane < lanes; ++lane) {
+                    CHECK(tax[lane] == Approx(strategy->calculate_tax(period[lane], scalar[lane])));
+                }
+            }
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                CHECK(states[lane] == Approx(scalar[lane][0]));
+            }
+        }
+    }
+}
+
+TEST_CASE("PeriodRunner: Profiler times stages and line items", "[orchestration][profiler]") {
+    auto db = create_runner_db();
+    auto tmpl = core::StatementTemplate::load_from_json(R"json({
+        "template_code": "PROFILE_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "COSTS", "base_value_source": "driver:COSTS"},
+            {"code": "GROSS", "formula": "REVENUE - COSTS"},
+            {"code": "NET", "formula": "GROSS * 0.75"}
+        ]
+    })json");
+    tmpl->save_to_database(db.get());
+    for (int period = 1; period <= 3; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 1000.0, 'EUR'), ('E', 1, :period, 'COSTS', 400.0, 'EUR')",
+            {{"period", period}}
+        );
+    }
+
+    auto profiler = std::make_shared<core::Profiler>();
+    PeriodRunner runner(db);
+    runner.set_profiler(profiler);
+    auto results = runner.run_periods("E", 1, {1, 2, 3}, BalanceSheet{}, "PROFILE_TEST");
+    REQUIRE(results.success);
+    CHECK(results.results[2].get_value("NET") == Approx(450.0));
+
+    const auto stages = profiler->stages();
+    auto count = [&](core::Profiler::Stage stage) { return stages[static_cast<size_t>(stage)].count; };
+    CHECK(count(core::Profiler::Stage::DRIVER_LOAD) == 1);
+    CHECK(count(core::Profiler::Stage::TEMPLATE_LOAD) == 3);
+    CHECK(count(core::Profiler::Stage::CALCULATE) == 3);
+    CHECK(count(core::Profiler::Stage::ROLL_FORWARD) == 3);
+    CHECK(count(core::Profiler::Stage::WRITE) == 0);   // No writer
+
+    const auto items = profiler->line_items();
+    REQUIRE(items.size() == 4);
+    for (size_t i = 0; i < items.size(); ++i) {
+        CHECK(items[i].evaluations == 3);
+        if (i > 0) {
+            CHECK(items[i - 1].seconds >= items[i].seconds);
+        }
+    }
+
+    // REVENUE and COSTS are looked up among the drivers each period
+    const auto drivers = profiler->lookups()[static_cast<size_t>(core::Profiler::Lookup::DRIVER)];
+    CHECK(drivers.hits == 6);
+
+    const std::string report = profiler->report(2);
+    CHECK(report.find("calculate") != std::string::npos);
+    CHECK(report.find("Line items (2 of 4") != std::string::npos);
+    const std::string trace = profiler->trace_json();
+    CHECK(trace.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[{", 0) == 0);
+    CHECK(trace.find("\"ph\":\"X\"") != std::string::npos);
+    CHECK(trace.find("\"name\":\"driver_load\"") != std::string::npos);
+
+    // Detached profilers see nothing more
+    runner.set_profiler(nullptr);
+    runner.run_periods("E", 1, {1}, BalanceSheet{}, "PROFILE_TEST");
+    CHECK(profiler->line_items()[0].evaluations == 3);
+
+    profiler->clear();
+    CHECK(profiler->line_items().empty());
+    CHECK(profiler->stages()[static_cast<size_t>(core::Profiler::Stage::CALCULATE)].count == 0);
+}
+
+TEST_CASE("Profiler: Allocations counted per stage and line item", "[orchestration][profiler][allocations]") {
+    CHECK_FALSE(core::AllocationTracker::enabled());
+    auto allocate = [] {
+        const auto before = core::AllocationTracker::thread_counts();
+        ::operator delete(::operator new(100));
+        return core::AllocationTracker::thread_counts() - before;
+    };
+    CHECK(allocate().allocations == 0);   // Not tracking
+    {
+        core::ScopedAllocationTracking tracking;
+        const auto counted = allocate();
+        CHECK(counted.allocations == (core::ALLOCATION_TRACKING_BUILT ? 1u : 0u));
+        CHECK(counted.bytes == (core::ALLOCATION_TRACKING_BUILT ? 100u : 0u));
+    }
+    CHECK_FALSE(core::AllocationTracker::enabled());
+
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "ALLOC_TEST", "statement_type": "unified", "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "NET", "formula": "REVENUE * 0.75"}
+        ]
+    })json")->save_to_database(db.get());
+    db->execute_raw(
+        "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+        "VALUES ('E', 1, 1, 'REVENUE', 1000.0, 'EUR'), ('E', 1, 2, 'REVENUE', 1100.0, 'EUR')");
+
+    auto profiler = std::make_shared<core::Profiler>();
+    profiler->track_allocations(true);
+    CHECK(core::AllocationTracker::enabled());
+    PeriodRunner runner(db);
+    runner.set_profiler(profiler);
+    REQUIRE(runner.run_periods("E", 1, {1, 2}, BalanceSheet{}, "ALLOC_TEST").success);
+
+    const auto stages = profiler->stages();
+    const auto& load = stages[static_cast<size_t>(core::Profiler::Stage::DRIVER_LOAD)].allocated;
+    CHECK((load.allocations > 0) == core::ALLOCATION_TRACKING_BUILT);   // Query results, driver maps
+    CHECK(load.bytes >= load.allocations);
+    const std::string report = profiler->report();
+    CHECK(report.find("allocs/eval") != std::string::npos);
+    CHECK(profiler->trace_json().find("\"allocations\":") != std::string::npos);
+
+    runner.set_profiler(nullptr);
+    profiler.reset();   // Tracking ends with the profiler
+    CHECK_FALSE(core::AllocationTracker::enabled());
+}
+
+TEST_CASE("Profiler: Hardware counters per stage", "[orchestration][profiler][counters]") {
+    CHECK_FALSE(core::HardwareCounters::enabled());
+    CHECK(core::HardwareCounters::thread_counts().cycles() == 0);   // Not counting
+
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "COUNTER_TEST", "statement_type": "unified", "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "NET", "formula": "REVENUE * 0.75"}
+        ]
+    })json")->save_to_database(db.get());
+    db->execute_raw(
+        "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+        "VALUES ('E', 1, 1, 'REVENUE', 1000.0, 'EUR'), ('E', 1, 2, 'REVENUE', 1100.0, 'EUR')");
+
+    auto profiler = std::make_shared<core::Profiler>();
+    profiler->track_hardware_counters(true);
+    CHECK(core::HardwareCounters::enabled());
+    PeriodRunner runner(db);
+    runner.set_profiler(profiler);
+    REQUIRE(runner.run_periods("E", 1, {1, 2}, BalanceSheet{}, "COUNTER_TEST").success);
+    CHECK(profiler->line_item_evaluations() == 4);
+
+    // Where perf_event_open is refused (containers, some VMs) counts stay 0 and the report says why
+    const auto& calculate = profiler->stages()[static_cast<size_t>(core::Profiler::Stage::CALCULATE)].counters;
+    const std::string report = profiler->report();
+    if (core::HardwareCounters::has(core::HardwareCounters::Event::INSTRUCTIONS)) {
+        CHECK(calculate.instructions() > 0);
+        CHECK(profiler->trace_json().find("\"instructions\":") != std::string::npos);
+    } else {
+        CHECK(calculate.instructions() == 0);
+    }
+    if (core::HardwareCounters::available()) {
+        CHECK(report.find("ipc") != std::string::npos);
+    } else {
+        CHECK(report.find("no hardware counters") != std::string::npos);
+    }
+
+    runner.set_profiler(nullptr);
+    profiler.reset();   // Counting ends with the profiler
+    CHECK_FALSE(core::HardwareCounters::enabled());
+}
+
+// ============================================================================
+// Parallel Evaluation Tests
+// ============================================================================
+
+namespace {
+
+// One line item per asset, rolled up into a total: two wide levels
+std::shared_ptr<IDatabase> create_wide_db(size_t assets, const std::string& asset_formula) {
+    auto db = create_runner_db();
+
+    std::string items = R"({"code": "REVENUE", "base_value_source": "driver:REVENUE"})";
+    std::string total;
+    for (size_t i = 0; i < assets; ++i) {
+        const std::string code = "ASSET_" + std::to_string(i);
+        const std::string formula = "REVENUE * " + std::to_string(i + 1) + asset_formula;
+        items += R"(, {"code": ")" + code + R"(", "formula": ")" + formula + R"("})";
+        items += R"(, {"code": "LOSS_)" + std::to_string(i) + R"(", "formula": ")" + code + R"( * 0.1"})";
+        total += (i ? " + LOSS_" : "LOSS_") + std::to_string(i);
+    }
+    items += R"(, {"code": "TOTAL_LOSS", "formula": ")" + total + R"("})";
+    items += R"(, {"code": "CASH", "formula": "CASH[t-1] - TOTAL_LOSS"})";
+
+    auto tmpl = core::StatementTemplate::load_from_json(
+        R"({"template_code": "WIDE_TEST", "statement_type": "unified", "version": "1.0", "line_items": [)" +
+        items + "]}");
+    tmpl->save_to_database(db.get());
+
+    for (int period = 1; period <= 3; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', :value, 'EUR')",
+            {{"period", period}, {"value", 100.0 * period}}
+        );
+    }
+    return db;
+}
+
+} // namespace
+
+TEST_CASE("PeriodRunner: Validation rules checked every period", "[orchestration][validation]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO validation_rule VALUES "
+        "  ('R1', 'Gross identity', 'equation', 'Gross is revenue less costs', 'GROSS - (REVENUE - COSTS)', "
+        "   '[\"GROSS\", \"REVENUE\", \"COSTS\"]', 0.01, 'error', 1),"
+        "  ('R2', 'Gross floor', 'boundary', 'Gross below 500', 'GROSS - 500', '[\"GROSS\"]', 0.0, 'warning', 1),"
+        "  ('R3', 'Needs a missing item', 'equation', '', '1 / 0', '[\"MISSING\"]', 0.0, 'error', 1),"
+        "  ('R4', 'Cash roll', 'equation', 'Cash rolls forward', 'CASH - CASH[t-1] - NET', "
+        "   '[\"CASH[t-1]\", \"NET\"]', 0.01, 'error', 1),"
+        "  ('R5', 'Broken', 'equation', '', 'GROSS +', '[]', 0.0, 'error', 1);"
+        "INSERT INTO template_validation_rule VALUES "
+        "  ('INCREMENTAL_TEST', 'R1', 1), ('INCREMENTAL_TEST', 'R2', 1), ('INCREMENTAL_TEST', 'R3', 1), "
+        "  ('INCREMENTAL_TEST', 'R4', 1), ('OTHER_TEMPLATE', 'R5', 1);"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    PeriodRunner runner(db);
+    auto results = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(results.success);
+    for (const auto& period : results.results) {
+        REQUIRE(period.warnings.size() == 1);
+        CHECK(period.warnings.message(0) == "Gross floor failed: Gross below 500 (value: -100)");
+    }
+    // The run keeps one record for the rule, not one message per period
+    REQUIRE(results.warnings.size() == 1);
+    CHECK(results.warnings.occurrences() == 3);
+    CHECK(results.warnings.message(0) ==
+          "Period 1: Gross floor failed: Gross below 500 (value: -100) (3 times, periods 1-3)");
+    CHECK(results.results[0].warnings.records()[0].code == results.results[2].warnings.records()[0].code);
+
+    SECTION("Diagnostics fold by message, line item and scenario") {
+        const uint32_t low = unified::DiagnosticCatalog::intern("Cash below floor (value: ", ")");
+        CHECK(unified::DiagnosticCatalog::intern("Cash below floor (value: ", ")") == low);
+        CHECK(unified::DiagnosticCatalog::render(low, -12.5) == "Cash below floor (value: -12.5)");
+        CHECK(unified::DiagnosticCatalog::render(0, 1.0).empty());
+        CHECK_THROWS_AS(unified::DiagnosticCatalog::render(UINT32_MAX, 1.0), std::out_of_range);
+
+        unified::Diagnostics period;
+        period.add(low, -12.5);
+        period.add(low, -20.0);
+        period.add(low, -1.0, core::SymbolTable::global().intern("CASH"));
+        period.add("Plain note");
+        REQUIRE(period.size() == 3);
+        CHECK(period.message(0) == "Cash below floor (value: -12.5) (2 times)");
+        CHECK(period.message(1) == "CASH: Cash below floor (value: -1)");
+        CHECK(period.message(2) == "Plain note");
+
+        unified::Diagnostics run;
+        run.merge(period, 4, 1);
+        run.merge(period, 2, 1);
+        run.merge(period, 3, 2);
+        CHECK(run.size() == 6);
+        CHECK(run.occurrences() == 12);
+        CHECK(run.message(0) == "Period 2: Cash below floor (value: -12.5) (4 times, periods 2-4)");
+        CHECK(unified::Diagnostics::from_messages(run.messages()).messages() == run.messages());
+    }
+
+    SECTION("A policy checks only some periods") {
+        unified::ValidationPolicy policy;
+        policy.mode = unified::ValidationMode::EVERY_K_PERIODS;
+        policy.every_periods = 2;
+        PeriodRunner sparse(db);
+        sparse.set_validation_policy(policy);
+        auto every_second = sparse.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(every_second.success);
+        CHECK(every_second.results[0].warnings.empty());
+        CHECK(every_second.results[1].warnings.size() == 1);
+        CHECK(every_second.results[2].warnings.size() == 1);   // The final period always
+        CHECK(policy.to_json() == R"({"every_periods":2,"mode":"every_k_periods","skip_warnings":false})");
+
+        policy.mode = unified::ValidationMode::FULL;
+        policy.skip_warnings = true;
+        sparse.set_validation_policy(policy);
+        auto no_warnings = sparse.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(no_warnings.success);
+        CHECK(no_warnings.results[2].warnings.empty());
+
+        policy.mode = unified::ValidationMode::SAMPLED;
+        policy.sample_fraction = 0.5;
+        size_t sampled = 0;
+        for (ScenarioID scenario = 0; scenario < 1000; ++scenario) {
+            sampled += policy.validates(scenario, 0, 3) ? 1 : 0;
+            CHECK(policy.validates(scenario, 0, 3) == policy.validates(scenario, 2, 3));
+        }
+        CHECK(sampled > 400);
+        CHECK(sampled < 600);
+    }
+
+    SECTION("Deferred validation checks the written results") {
+        unified::ValidationPolicy policy;
+        policy.mode = unified::ValidationMode::DEFERRED;
+        PeriodRunner deferred(db);
+        deferred.set_validation_policy(policy);
+        const std::string path = "test_deferred_validation.fmcr";
+        {
+            ColumnarResultWriter writer(path);
+            for (ScenarioID scenario = 1; scenario <= 2; ++scenario) {
+                auto run = deferred.run_periods("E", scenario, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+                REQUIRE(run.success);
+                CHECK(run.results[2].warnings.empty());
+                writer.append(scenario, {1, 2, 3}, run);
+            }
+            writer.close();
+        }
+
+        auto report = validate_columnar(db, ColumnarResultReader(path), "INCREMENTAL_TEST");
+        CHECK(report.rows() == 6);
+        CHECK(report.skipped_rules() == std::vector<std::string>{"R3"});
+        // R1 and R2 in every row, R4 from each scenario's second period
+        CHECK(report.checks() == 6 + 6 + 4);
+        CHECK_FALSE(report.has_errors());
+        REQUIRE(report.rules.size() == 4);
+        const auto& floor = report.rules[1];
+        CHECK(floor.rule_code == "R2");
+        CHECK(floor.failed == 6);
+        CHECK(floor.failed_at(0));
+        CHECK(floor.failed_at(5));
+        CHECK_FALSE(floor.failed_at(6));
+        REQUIRE(floor.messages.size() == 6);
+        CHECK(floor.messages[0].second == "Gross floor failed: Gross below 500 (value: -100)");
+        CHECK(report.scenario_ids[floor.messages[3].first] == 2);
+        CHECK(report.period_ids[floor.messages[3].first] == 1);
+
+        auto errors_only = validate_columnar(db, ColumnarResultReader(path), "INCREMENTAL_TEST", true, 2);
+        CHECK(errors_only.rules.size() == 3);
+        CHECK(errors_only.checks() == 6 + 4);
+        std::remove(path.c_str());
+    }
+
+    SECTION("Rules are checked a column at a time") {
+        // Rows 0-3 are one scenario; row 2 has no NET, row 3 breaks the cash roll
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        const std::vector<double> revenue{500, 500, 500, 500}, costs{600, 600, 600, 600};
+        const std::vector<double> gross{-100, -100, -100, 900}, net{-100, -100, nan, -100};
+        const std::vector<double> cash{0, -100, -200, -250};
+        unified::ResultColumns block;
+        block.rows = 4;
+        block.columns = {{"REVENUE", revenue.data()}, {"COSTS", costs.data()}, {"GROSS", gross.data()},
+                         {"NET", net.data()}, {"CASH", cash.data()}};
+        block.history = {0, 1, 2, 3};
+
+        unified::ValidationRuleEngine rule_engine(db);
+        rule_engine.load_rules_for_template("INCREMENTAL_TEST");
+        core::FormulaEvaluator evaluator;
+        auto rules = rule_engine.execute_rules_columnar(block, evaluator, 1);
+        REQUIRE(rules.size() == 4);
+        CHECK(rules[0].failed == 1);
+        CHECK(rules[0].failed_at(3));
+        REQUIRE(rules[0].messages.size() == 1);
+        CHECK(rules[0].messages[0].first == 3);
+        CHECK(rules[1].failed == 3);
+        CHECK(rules[1].messages.size() == 1);   // Only the first one kept
+        CHECK(rules[2].skipped);
+        CHECK(rules[3].checked == 2);           // Not row 0 (no [t-1]) or row 2 (no NET)
+        CHECK(rules[3].failed == 1);
+        REQUIRE(rules[3].messages.size() == 1);
+        CHECK(rules[3].messages[0].first == 3);
+        CHECK(rules[3].messages[0].second == "Cash roll failed: Cash rolls forward (difference: 50, tolerance: 0.01)");
+    }
+
+    // A formula that doesn't compile fails every period it applies to
+    db->execute_raw("INSERT INTO template_validation_rule VALUES ('INCREMENTAL_TEST', 'R5', 1);");
+    PeriodRunner fresh(db);
+    auto failed = fresh.run_periods("E", 1, {1, 2}, initial_bs, "INCREMENTAL_TEST");
+    CHECK_FALSE(failed.success);
+    REQUIRE_FALSE(failed.results.empty());
+    REQUIRE(failed.results[0].errors.size() == 1);
+    CHECK(failed.results[0].errors[0].rfind("Broken failed: Unable to evaluate formula - ", 0) == 0);
+}
+
+TEST_CASE("PeriodRunner: Parallel levels match sequential calculation", "[orchestration][parallel]") {
+    const std::vector<PeriodID> periods = {1, 2, 3};
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 1.0e6;
+
+    SECTION("Results are identical") {
+        auto db = create_wide_db(200, "");
+        PeriodRunner sequential(db);
+        auto expected = sequential.run_periods("E", 1, periods, initial_bs, "WIDE_TEST");
+        REQUIRE(expected.success);
+
+        PeriodRunner parallel(db);
+        parallel.set_parallel(4, 8);
+        auto actual = parallel.run_periods("E", 1, periods, initial_bs, "WIDE_TEST");
+        REQUIRE(actual.success);
+        for (size_t p = 0; p < periods.size(); ++p) {
+            CHECK(actual.results[p].get_all_values() == expected.results[p].get_all_values());
+        }
+        CHECK(actual.results[0].get_value("TOTAL_LOSS") == Approx(10.0 * 200 * 201 / 2));
+    }
+
+    SECTION("Errors are reported as in sequential calculation") {
+        auto db = create_wide_db(50, " / (REVENUE - 200)");
+        PeriodRunner sequential(db);
+        auto expected = sequential.run_periods("E", 1, periods, initial_bs, "WIDE_TEST");
+
+        PeriodRunner parallel(db);
+        parallel.set_parallel(4, 8);
+        auto actual = parallel.run_periods("E", 1, periods, initial_bs, "WIDE_TEST");
+        REQUIRE_FALSE(expected.success);
+        REQUIRE_FALSE(actual.success);
+        CHECK(actual.errors == expected.errors);
+    }
+}
+
+// ============================================================================
+// Management Action Overlay Tests
+// ============================================================================
+
+TEST_CASE("PeriodRunner: Actions patch the template in memory", "[orchestration][overlay]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, "
+        "  financial_transformations) "
+        "VALUES (1, 'CUT', 'UNCONDITIONAL', 2, "
+        "  '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}, "
+        "    {\"line_item\": \"GROSS\", \"type\": \"multiply\", \"factor\": 2}]');"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    PeriodRunner runner(db);
+    auto results = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(results.success);
+
+    // Transformations of one line item compose: (GROSS + 100) * 2
+    CHECK(results.results[0].get_value("GROSS") == Approx(400.0));
+    CHECK(results.results[1].get_value("GROSS") == Approx(1000.0));
+    CHECK(results.results[2].get_value("NET") == Approx(750.0));
+    CHECK(results.results[2].get_value("CASH") == Approx(100.0 + 300.0 + 2 * 750.0));
+
+    // Another scenario with the same action shares the overlay too
+    db->execute_raw(
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, "
+        "  financial_transformations) "
+        "SELECT 2, action_code, trigger_type, start_period, financial_transformations "
+        "FROM scenario_action WHERE scenario_id = 1;"
+        "INSERT INTO scenario_drivers SELECT entity_id, 2, period_id, driver_code, value, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1;"
+    );
+    auto other = runner.run_periods("E", 2, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(other.success);
+    CHECK(other.results[2].get_all_values() == results.results[2].get_all_values());
+
+    // Periods 2 and 3 of both scenarios use one overlay; no template rows were written
+    CHECK(runner.engine().has_registered_template("INCREMENTAL_TEST+CUT"));
+    CHECK_FALSE(runner.engine().has_registered_template("INCREMENTAL_TEST+CUT#2"));
+    auto count = db->execute_query("SELECT COUNT(*) AS n FROM statement_template", {});
+    REQUIRE(count->next());
+    CHECK(count->get_int("n") == 1);
+}
+
+TEST_CASE("PeriodRunner: Parametric actions serve every period with one template", "[orchestration][overlay][parametric]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO scenario_drivers SELECT entity_id, scenario_id, period_id + 3, driver_code, value, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1;"
+        "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX'), ('RELIEF', 'Tax relief', 'TAX'), "
+        "  ('SIDE', 'Side business', 'OTHER');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, end_period, "
+        "  financial_transformations) "
+        "VALUES (1, 'CUT', 'UNCONDITIONAL', 2, 3, '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}]'), "
+        "       (1, 'RELIEF', 'UNCONDITIONAL', 4, NULL, "
+        "        '[{\"line_item\": \"TAX\", \"type\": \"formula_override\", \"new_formula\": \"GROSS * 0.1\"}]');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, trigger_condition, start_period, "
+        "  trigger_sticky, financial_transformations) "
+        "VALUES (1, 'SIDE', 'CONDITIONAL', 'CASH > 1000', 1, 1, "
+        "  '[{\"line_item\": \"OTHER_SCALED\", \"type\": \"multiply\", \"factor\": 3}]');"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3, 4, 5, 6};
+
+    PeriodRunner overlays(db);
+    auto expected = overlays.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(expected.success);
+
+    auto check_same = [&](const MultiPeriodResults& actual) {
+        REQUIRE(actual.success);
+        REQUIRE(actual.results.size() == periods.size());
+        for (size_t p = 0; p < periods.size(); ++p) {
+            for (const std::string code : {"GROSS", "TAX", "NET", "CASH", "OTHER_SCALED"}) {
+                CHECK(actual.results[p].get_value(code) == Approx(expected.results[p].get_value(code)));
+            }
+        }
+    };
+
+    PeriodRunner parametric(db);
+    parametric.set_parametric_actions(true);
+    auto actual = parametric.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    check_same(actual);
+
+    // Phased: CUT in 2-3; RELIEF from 4; SIDE once the opening cash exceeds 1000 (period 4)
+    CHECK(actual.results[0].get_value("GROSS") == Approx(400.0));
+    CHECK(actual.results[1].get_value("GROSS") == Approx(500.0));
+    CHECK(actual.results[3].get_value("GROSS") == Approx(400.0));
+    CHECK(actual.results[3].get_value("TAX") == Approx(40.0));
+    CHECK(actual.results[2].get_value("OTHER_SCALED") == Approx(10.0));
+    CHECK(actual.results[3].get_value("OTHER_SCALED") == Approx(30.0));
+
+    // One overlay for the run, where the per-set overlays needed one per active set
+    CHECK(parametric.engine().has_registered_template("INCREMENTAL_TEST+CUT+RELIEF+SIDE@periods"));
+    CHECK_FALSE(parametric.engine().has_registered_template("INCREMENTAL_TEST+CUT"));
+    CHECK(overlays.engine().has_registered_template("INCREMENTAL_TEST+CUT"));
+    CHECK(overlays.engine().has_registered_template("INCREMENTAL_TEST+RELIEF+SIDE"));
+
+    // Incremental runs see the activations as inputs (sticky triggers carry over, as with overlays)
+    PeriodRunner incremental(db);
+    incremental.set_parametric_actions(true);
+    incremental.set_incremental(true);
+    check_same(incremental.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST"));
+    expected = overlays.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(expected.success);
+    CHECK(expected.results[0].get_value("OTHER_SCALED") == Approx(30.0));
+    check_same(incremental.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST"));
+}
+
+TEST_CASE("PeriodRunner: A shared action catalogue replaces per-run action loads", "[orchestration][overlay][catalog]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX'), ('RELIEF', 'Tax relief', 'TAX');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, end_period, "
+        "  financial_transformations) "
+        "VALUES (1, 'CUT', 'UNCONDITIONAL', 2, NULL, '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}]'), "
+        "       (1, 'RELIEF', 'UNCONDITIONAL', 3, NULL, "
+        "        '[{\"line_item\": \"TAX\", \"type\": \"formula_override\", \"new_formula\": \"GROSS * 0.1\"}]'), "
+        "       (2, 'RELIEF', 'UNCONDITIONAL', 1, NULL, "
+        "        '[{\"line_item\": \"TAX\", \"type\": \"formula_override\", \"new_formula\": \"GROSS * (\"}]');"
+    );
+
+    auto catalog = actions::ActionCatalog::load(*db);
+    CHECK(catalog->size() == 3);
+    CHECK(catalog->covers(1));
+    CHECK(catalog->covers(7));
+    CHECK(catalog->actions(7).empty());
+    REQUIRE(catalog->find(1, "RELIEF").size() == 1);
+    CHECK(catalog->find(1, "LED").empty());
+    const auto& relief = catalog->actions(1)[catalog->find(1, "RELIEF")[0]];
+    REQUIRE(relief.action.financial_transformations.size() == 1);
+    CHECK(relief.action.financial_transformations[0].kind == actions::TransformationKind::FORMULA_OVERRIDE);
+    CHECK(relief.action.financial_transformations[0].compiled_formula != nullptr);
+    CHECK(relief.signature == actions::ActionCatalog::signature(relief.action));
+    const auto& broken = catalog->actions(2)[0].action.financial_transformations[0];
+    CHECK(broken.compiled_formula == nullptr);
+    CHECK(actions::ActionCatalog::load(*db, {2})->covers(2));
+    CHECK_FALSE(actions::ActionCatalog::load(*db, {2})->covers(1));
+
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    PeriodRunner loading(db);
+    auto expected = loading.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(expected.success);
+    CHECK(expected.results[2].get_value("TAX") == Approx(50.0));
+
+    PeriodRunner shared(db);
+    shared.set_action_catalog(catalog);
+    auto actual = shared.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(actual.success);
+    for (size_t p = 0; p < periods.size(); ++p) {
+        for (const std::string code : {"GROSS", "TAX", "NET", "CASH"}) {
+            CHECK(actual.results[p].get_value(code) == Approx(expected.results[p].get_value(code)));
+        }
+    }
+
+    // Runs read the transformations from the catalogue, not scenario_action
+    db->execute_update("UPDATE scenario_action SET financial_transformations = "
+                       "'[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 50}]' "
+                       "WHERE action_code = 'CUT'", {});
+    auto cached = shared.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(cached.success);
+    CHECK(cached.results[1].get_value("GROSS") == Approx(500.0));
+    auto reloaded = loading.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(reloaded.success);
+    CHECK(reloaded.results[1].get_value("GROSS") == Approx(450.0));
+}
+
+TEST_CASE("PeriodRunner: Gray code sweeps reuse the previous scenario", "[orchestration][overlay][incremental]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX'), ('RELIEF', 'Tax relief', 'TAX'), "
+        "  ('SIDE', 'Side business', 'OTHER');"
+    );
+    const std::vector<std::string> transformations = {
+        R"([{"line_item": "GROSS", "type": "add", "amount": 100}])",
+        R"([{"line_item": "TAX", "type": "multiply", "factor": 0.5}])",
+        R"([{"line_item": "OTHER_SCALED", "type": "add", "amount": 1}])",
+    };
+    auto range = ScenarioGenerator::combinations({"CUT", "RELIEF", "SIDE"}, 10, "GRAY", CombinationOrder::GRAY);
+    for (const ScenarioMask& mask : range) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers SELECT entity_id, :scenario, period_id, driver_code, value, unit_code "
+            "FROM scenario_drivers WHERE scenario_id = 1", {{"scenario", mask.scenario_id}});
+        for (size_t a = 0; a < range.action_codes().size(); ++a) {
+            if (mask.actions & (uint64_t{1} << a)) {
+                db->execute_update(
+                    "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, "
+                    "  financial_transformations) VALUES (:scenario, :action, 'UNCONDITIONAL', 1, :json)",
+                    {{"scenario", mask.scenario_id}, {"action", range.action_codes()[a]},
+                     {"json", transformations[a]}});
+            }
+        }
+    }
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    PeriodRunner sweep(db);
+    sweep.set_incremental_seeding(true);
+    PeriodRunner full(db);
+
+    // Line items re-evaluated in period 3 when an action is toggled
+    const std::vector<size_t> downstream = {4, 3, 1};   // GROSS TAX NET CASH / TAX NET CASH / OTHER_SCALED
+    for (size_t i = 0; i < range.size(); ++i) {
+        const ScenarioMask mask = range[i];
+        auto seeded = sweep.run_periods("E", mask.scenario_id, periods, initial_bs, "INCREMENTAL_TEST");
+        auto expected = full.run_periods("E", mask.scenario_id, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(seeded.success);
+        REQUIRE(expected.success);
+        for (size_t p = 0; p < periods.size(); ++p) {
+            CHECK(seeded.results[p].get_all_values() == expected.results[p].get_all_values());
+        }
+        if (i == 0) {
+            CHECK(sweep.engine().last_recalculated_count() == 5);
+        } else {
+            CHECK(sweep.engine().last_recalculated_count() == downstream[CombinationRange::toggled_action(i)]);
+        }
+    }
+
+    // All three actions: (1000 - 600 + 100) gross, half the tax, other + 1
+    auto all = full.run_periods("E", 17, periods, initial_bs, "INCREMENTAL_TEST");
+    CHECK(all.results[0].get_value("NET") == Approx(500.0 - 62.5));
+    CHECK(all.results[0].get_value("OTHER_SCALED") == Approx(11.0));
+}
+
+TEST_CASE("PeriodRunner: Triggers switch actions on and off by period", "[orchestration][overlay][triggers]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO scenario_drivers SELECT entity_id, scenario_id, period_id + 3, driver_code, value, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1;"
+        "UPDATE scenario_drivers SET value = 2000.0 WHERE driver_code = 'REVENUE' AND period_id IN (2, 4);"
+        "INSERT INTO management_action VALUES ('STICKY', 'Sticky response', 'OTHER'), "
+        "  ('PULSE', 'Pulsed response', 'OPEX'), ('TIMED', 'Timed relief', 'TAX');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, trigger_condition, trigger_period, "
+        "  start_period, end_period, trigger_sticky, financial_transformations) "
+        "VALUES (1, 'STICKY', 'CONDITIONAL', 'REVENUE > 1500', NULL, 1, 5, 1, "
+        "        '[{\"line_item\": \"OTHER_SCALED\", \"type\": \"add\", \"amount\": 1}]'), "
+        "       (1, 'PULSE', 'CONDITIONAL', 'REVENUE > 1500', NULL, 1, NULL, 0, "
+        "        '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}]'), "
+        "       (1, 'TIMED', 'TIMED', NULL, 4, 1, 5, 0, "
+        "        '[{\"line_item\": \"TAX\", \"type\": \"formula_override\", \"new_formula\": \"GROSS * 0.1\"}]');"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3, 4, 5, 6};
+
+    PeriodRunner runner(db);
+    auto results = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(results.success);
+    REQUIRE(results.results.size() == periods.size());
+
+    // The actions applied in each period, read off the line items they change
+    auto applied = [](const unified::UnifiedResult& result) {
+        std::set<std::string> actions;
+        const double gross = result.get_value("REVENUE") - result.get_value("COSTS");
+        if (result.get_value("OTHER_SCALED") == Approx(11.0)) {
+            actions.insert("STICKY");
+        }
+        if (result.get_value("GROSS") == Approx(gross + 100.0)) {
+            actions.insert("PULSE");
+        }
+        if (result.get_value("TAX") == Approx(result.get_value("GROSS") * 0.1)) {
+            actions.insert("TIMED");
+        }
+        return actions;
+    };
+
+    // Conditions read the prior period's REVENUE, which exceeds 1500 in periods 2 and 4:
+    // STICKY fires in period 3 and holds to its end period; PULSE holds only in 3 and 5
+    const std::vector<std::set<std::string>> expected = {
+        {}, {}, {"STICKY", "PULSE"}, {"STICKY", "TIMED"}, {"STICKY", "PULSE", "TIMED"}, {}
+    };
+    for (size_t p = 0; p < periods.size(); ++p) {
+        INFO("period " << periods[p]);
+        CHECK(applied(results.results[p]) == expected[p]);
+    }
+
+    // Same actions as the per-period interpretation of the trigger rows the compiled triggers replaced
+    struct PriorValues : core::IValueProvider {
+        const std::map<std::string, double>& values;
+        explicit PriorValues(const std::map<std::string, double>& v) : values(v) {}
+        bool has_value(const std::string& code) const override { return values.count(code) > 0; }
+        double get_value(const std::string& code, const core::Context&) const override {
+            auto it = values.find(code);
+            return (it != values.end()) ? it->second : 0.0;
+        }
+    };
+    struct Trigger {
+        std::string action_code;
+        std::string trigger_type;
+        std::string condition;
+        int trigger_period;
+        int start_period;
+        int end_period;
+        bool sticky;
+    };
+    const std::vector<Trigger> triggers = {
+        {"STICKY", "CONDITIONAL", "REVENUE > 1500", 0, 1, 5, true},
+        {"PULSE", "CONDITIONAL", "REVENUE > 1500", 0, 1, 0, false},
+        {"TIMED", "TIMED", "", 4, 1, 5, false},
+    };
+    core::FormulaEvaluator evaluator;
+    std::set<std::string> triggered;
+    std::map<std::string, double> prior = initial_bs.line_items;
+    for (size_t p = 0; p < periods.size(); ++p) {
+        const PeriodID period = periods[p];
+        PriorValues provider(prior);
+        const std::vector<core::IValueProvider*> providers = {&provider};
+        auto condition_met = [&](const Trigger& trigger) {
+            try {
+                return evaluator.evaluate(trigger.condition, providers, core::Context(1, period, 0)) != 0.0;
+            } catch (const std::exception&) {
+                return false;  // Failing conditions count as false (no REVENUE before period 1)
+            }
+        };
+        const auto past_end = [&](const Trigger& trigger) {
+            return trigger.end_period > 0 && period > trigger.end_period;
+        };
+
+        std::set<std::string> active;
+        for (const auto& trigger : triggers) {
+            bool is_active = false;
+            if (trigger.trigger_type == "TIMED") {
+                is_active = trigger.trigger_period > 0 && period >= trigger.trigger_period && !past_end(trigger);
+            } else if (period >= trigger.start_period && trigger.sticky) {
+                if (triggered.count(trigger.action_code)) {
+                    is_active = !past_end(trigger);
+                    if (!is_active) {
+                        triggered.erase(trigger.action_code);
+                    }
+                } else if (condition_met(trigger)) {
+                    is_active = true;
+                    triggered.insert(trigger.action_code);
+                }
+            } else if (period >= trigger.start_period && period != 1 && !prior.empty()) {
+                is_active = condition_met(trigger) && !past_end(trigger);
+            }
+            if (is_active) {
+                active.insert(trigger.action_code);
+            }
+        }
+        INFO("period " << period);
+        CHECK(applied(results.results[p]) == active);
+        results.results[p].get_all_values().assign_to(prior);
+    }
+
+    // The sticky trigger was cleared after its end period; a rerun reuses the compiled triggers
+    auto rerun = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(rerun.success);
+    for (size_t p = 0; p < periods.size(); ++p) {
+        CHECK(rerun.results[p].get_all_values() == results.results[p].get_all_values());
+    }
+}
+
+TEST_CASE("PeriodRunner: Child scenarios store only overridden drivers", "[orchestration][drivers]") {
+    auto db = create_incremental_db();
+    // Scenario 1 is the base; 2 changes COSTS from period 2; 3 inherits from 2 and changes OTHER
+    db->execute_raw(
+        "CREATE TABLE scenario (scenario_id INTEGER PRIMARY KEY, code TEXT, parent_scenario_id INTEGER);"
+        "INSERT INTO scenario VALUES (1, 'BASE', NULL), (2, 'LEAN', 1), (3, 'LEAN_PLUS', 2), "
+        "  (4, 'FULL', NULL);"
+        "INSERT INTO scenario_drivers VALUES ('E', 2, 2, 'COSTS', 500.0, 'EUR'), "
+        "  ('E', 2, 3, 'COSTS', 500.0, 'EUR'), ('E', 3, 3, 'OTHER', 7.0, 'EUR');"
+        // Scenario 4 materialises all of scenario 3's drivers
+        "INSERT INTO scenario_drivers SELECT entity_id, 4, period_id, driver_code, value, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1 AND NOT (driver_code = 'COSTS' AND period_id > 1) "
+        "  AND NOT (driver_code = 'OTHER' AND period_id = 3);"
+        "INSERT INTO scenario_drivers VALUES ('E', 4, 2, 'COSTS', 500.0, 'EUR'), "
+        "  ('E', 4, 3, 'COSTS', 500.0, 'EUR'), ('E', 4, 3, 'OTHER', 7.0, 'EUR');"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    PeriodRunner runner(db);
+    auto lean = runner.run_periods("E", 2, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(lean.success);
+    CHECK(lean.results[0].get_value("GROSS") == Approx(400.0));
+    CHECK(lean.results[1].get_value("GROSS") == Approx(500.0));
+    CHECK(lean.results[2].get_value("OTHER_SCALED") == Approx(10.0));
+
+    auto lean_plus = runner.run_periods("E", 3, periods, initial_bs, "INCREMENTAL_TEST");
+    auto full = runner.run_periods("E", 4, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(lean_plus.success);
+    REQUIRE(full.success);
+    for (size_t i = 0; i < periods.size(); ++i) {
+        CHECK(lean_plus.results[i].get_all_values() == full.results[i].get_all_values());
+    }
+    CHECK(lean_plus.results[2].get_value("OTHER_SCALED") == Approx(14.0));
+
+    // Parent drivers are re-read by the next run
+    db->execute_raw("UPDATE scenario_drivers SET value = 1100.0 WHERE scenario_id = 1 AND driver_code = 'REVENUE';");
+    auto updated = runner.run_periods("E", 3, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(updated.success);
+    CHECK(updated.results[2].get_value("GROSS") == Approx(600.0));
+}
+
+TEST_CASE("UnifiedEngine: Prefetched drivers match per-period loading", "[orchestration][drivers]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "CREATE TABLE scenario (scenario_id INTEGER PRIMARY KEY, code TEXT, parent_scenario_id INTEGER);"
+        "INSERT INTO scenario VALUES (1, 'BASE', NULL), (2, 'LEAN', 1);"
+        "INSERT INTO scenario_drivers VALUES ('E', 2, 2, 'COSTS', 500.0, 'EUR'), "
+        "  ('E', 1, 4, 'REVENUE', 2000.0, 'EUR'), ('E', 1, 4, 'COSTS', 600.0, 'EUR'), "
+        "  ('E', 1, 4, 'OTHER', 5.0, 'EUR');"
+    );
+    BalanceSheet opening_bs;
+    opening_bs.line_items["CASH"] = 100.0;
+
+    unified::UnifiedEngine loading(db);
+    unified::UnifiedEngine prefetched(db);
+    prefetched.prefetch_drivers("E", 2, {1, 2, 3});
+
+    // Period 4 is outside the prefetch and is queried as before
+    for (PeriodID period : {1, 2, 3, 4}) {
+        auto expected = loading.calculate("E", 2, period, opening_bs, "INCREMENTAL_TEST");
+        auto actual = prefetched.calculate("E", 2, period, opening_bs, "INCREMENTAL_TEST");
+        REQUIRE(expected.success);
+        REQUIRE(actual.success);
+        CHECK(actual.get_all_values() == expected.get_all_values());
+    }
+    CHECK(prefetched.calculate("E", 2, 2, opening_bs, "INCREMENTAL_TEST").get_value("GROSS") == Approx(500.0));
+
+    // Prefetched rows are kept until the cache is cleared
+    db->execute_raw("UPDATE scenario_drivers SET value = 400.0 WHERE scenario_id = 2;");
+    CHECK(prefetched.calculate("E", 2, 2, opening_bs, "INCREMENTAL_TEST").get_value("GROSS") == Approx(500.0));
+    prefetched.clear_driver_cache();
+    CHECK(prefetched.calculate("E", 2, 2, opening_bs, "INCREMENTAL_TEST").get_value("GROSS") == Approx(600.0));
+}
+
+TEST_CASE("UnifiedEngine: Packed drivers match their rows", "[orchestration][drivers]") {
+    auto db = create_incremental_db();
+    std::ifstream migration("../data/migrations/013_scenario_driver_pack.sql");
+    REQUIRE(migration);
+    db->execute_raw(std::string(std::istreambuf_iterator<char>(migration), std::istreambuf_iterator<char>()));
+    db->execute_raw(
+        "CREATE TABLE scenario (scenario_id INTEGER PRIMARY KEY, code TEXT, parent_scenario_id INTEGER);"
+        "INSERT INTO scenario VALUES (1, 'BASE', NULL), (2, 'LEAN', 1);"
+        "INSERT INTO scenario_drivers VALUES ('E', 2, 2, 'COSTS', 500.0, 'EUR'), "
+        "  ('E', 2, 3, 'COSTS', 450.0, 'EUR'), ('E', 2, 2, 'OTHER', 6.0, 'EUR'), "
+        "  ('PHYSICAL_RISK', 2, 3, 'OTHER', 9.0, 'EUR');"
+    );
+    BalanceSheet opening_bs;
+    opening_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    std::vector<unified::ResultRow> expected;
+    unified::UnifiedEngine loading(db);
+    for (PeriodID period : periods) {
+        expected.push_back(loading.calculate("E", 2, period, opening_bs, "INCREMENTAL_TEST").get_all_values());
+    }
+    auto check_prefetched = [&]() {
+        unified::UnifiedEngine prefetched(db);
+        prefetched.prefetch_drivers("E", 2, periods);
+        for (size_t i = 0; i < periods.size(); ++i) {
+            auto actual = prefetched.calculate("E", 2, periods[i], opening_bs, "INCREMENTAL_TEST");
+            REQUIRE(actual.success);
+            CHECK(actual.get_all_values() == expected[i]);
+        }
+    };
+
+    CHECK(unified::DriverPack::pack_all(*db) == 3);
+    auto packs = unified::DriverPack::load(*db, {"E"}, {1});
+    REQUIRE(packs.size() == 1);
+    CHECK(packs[0].period_ids == periods);
+    CHECK(packs[0].driver_codes == std::vector<std::string>{"REVENUE", "COSTS", "OTHER"});
+    CHECK(packs[0].value(2, 1) == Approx(600.0));
+
+    SECTION("Every key packed") {
+        check_prefetched();
+        auto sparse = unified::DriverPack::load(*db, {"E"}, {2});
+        REQUIRE(sparse.size() == 1);
+        CHECK(sparse[0].period_ids == std::vector<PeriodID>{2, 3});
+        CHECK(sparse[0].driver_codes == std::vector<std::string>{"COSTS", "OTHER"});
+        CHECK(std::isnan(sparse[0].value(1, 1)));  // OTHER of scenario 2 isn't set in period 3
+    }
+
+    SECTION("Writes to a key's rows drop its pack") {
+        db->execute_raw("INSERT INTO scenario_drivers VALUES ('PHYSICAL_RISK', 2, 1, 'OTHER', 4.0, 'EUR');");
+        CHECK(unified::DriverPack::load(*db, {"PHYSICAL_RISK"}, {2}).empty());
+        CHECK(unified::DriverPack::load(*db, {"E"}, {1, 2}).size() == 2);
+
+        expected[0] = loading.calculate("E", 2, 1, opening_bs, "INCREMENTAL_TEST").get_all_values();
+        CHECK(expected[0].at("OTHER_SCALED") == Approx(8.0));
+        check_prefetched();   // Packs of E, rows of PHYSICAL_RISK
+
+        db->execute_raw("DELETE FROM scenario_drivers WHERE entity_id = 'E' AND scenario_id = 1 AND period_id = 1;");
+        CHECK(unified::DriverPack::load(*db, {"E"}, {1}).empty());
+    }
+}
+
+TEST_CASE("StatementValueProvider: Recorded periods serve [t-k] references", "[orchestration][history]") {
+    // No balance_sheet_actuals table: any database lookup would fail
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    bs::StatementValueProvider provider(db);
+    provider.set_history_depth(3);
+    provider.set_context("E", 1);
+
+    for (PeriodID period = 1; period <= 4; ++period) {
+        provider.clear_current_values();
+        provider.set_current_value("REVENUE", 100.0 * period);
+        provider.record_period(period);
+    }
+    core::Context ctx(1, 5, 0);
+    int slot = provider.resolve_slot("REVENUE");
+
+    SECTION("Keys and slots read the ring") {
+        CHECK(provider.get_value("REVENUE[t-2]", ctx) == Approx(300.0));
+        CHECK(provider.get_value("REVENUE[t-3]", ctx) == Approx(200.0));
+        CHECK(provider.get_slot_value(slot, ctx.with_time_offset(-2)) == Approx(300.0));
+        CHECK(provider.get_slot_value(slot, ctx.with_time_offset(-4)) == Approx(400.0));  // Not recorded: current
+    }
+
+    SECTION("Periods outside the window go to the database") {
+        CHECK_THROWS(provider.get_value("REVENUE[t-4]", ctx));
+    }
+
+    SECTION("Another scenario starts without history") {
+        provider.set_context("E", 2);
+        CHECK_THROWS(provider.get_value("REVENUE[t-2]", ctx));
+    }
+
+    SECTION("Time-series key syntax") {
+        CHECK(provider.has_value("REVENUE[t+1]"));
+        CHECK(provider.has_value("REVENUE[t]"));
+        CHECK_FALSE(provider.has_value("revenue[t-1]"));
+        CHECK_FALSE(provider.has_value("REVENUE[t-]"));
+        CHECK_FALSE(provider.has_value("REVENUE[t-1x]"));
+        CHECK(provider.resolve_slot("REVENUE[t-12]") == core::IValueProvider::NO_SLOT);
+    }
+}
+
+TEST_CASE("PeriodRunner: Rolling averages read earlier periods from memory", "[orchestration][history]") {
+    auto db = create_runner_db();
+    auto tmpl = core::StatementTemplate::load_from_json(R"({
+        "template_code": "ROLLING_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "SALES", "formula": "REVENUE"},
+            {"code": "ROLLING_3", "formula": "(SALES + SALES[t-1] + SALES[t-2]) / 3"},
+            {"code": "LAG_3", "formula": "SALES[t-3]"}
+        ]
+    })");
+    tmpl->save_to_database(db.get());
+    for (int period = 1; period <= 6; ++period) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers VALUES ('E', 1, :period, 'REVENUE', :value, 'EUR')",
+            {{"period", period}, {"value", 100.0 * period}}
+        );
+    }
+
+    PeriodRunner runner(db);
+    auto results = runner.run_periods("E", 1, {1, 2, 3, 4, 5, 6}, BalanceSheet(), "ROLLING_TEST");
+    REQUIRE(results.success);
+    CHECK(results.results[3].get_value("ROLLING_3") == Approx(300.0));
+    CHECK(results.results[5].get_value("ROLLING_3") == Approx(500.0));
+    CHECK(results.results[3].get_value("LAG_3") == Approx(100.0));
+    CHECK(results.results[5].get_value("LAG_3") == Approx(300.0));
+}
+
+TEST_CASE("EntityDictionary: Entity codes map to dense IDs", "[orchestration][entities]") {
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "CREATE TABLE entity (entity_id INTEGER PRIMARY KEY, code TEXT UNIQUE NOT NULL);"
+        "INSERT INTO entity VALUES (9, 'F'), (5, 'E');"
+        "INSERT INTO scenario_drivers VALUES ('F', 1, 1, 'REVENUE', 3000.0, 'EUR'), "
+        "  ('F', 1, 1, 'COSTS', 1000.0, 'EUR');"
+    );
+
+    SECTION("Table rows first, then codes in first-use order") {
+        core::EntityDictionary entities(db);
+        REQUIRE(entities.size() == 2);
+        CHECK(entities.find("E") == 0);
+        CHECK(entities.find("F") == 1);
+        CHECK(entities.database_id(1) == 9);
+        CHECK(entities.find("G") == core::EntityDictionary::NO_ENTITY);
+
+        CHECK(entities.intern("G") == 2);
+        CHECK(entities.intern("E") == 0);
+        CHECK(entities.code(2) == "G");
+        CHECK_FALSE(entities.database_id(2).has_value());
+
+        db->execute_raw("INSERT INTO entity VALUES (12, 'H'), (13, 'G');");
+        entities.reload();
+        CHECK(entities.find("H") == 3);
+        CHECK(entities.find("G") == 2);  // IDs are never renumbered
+        CHECK(entities.database_id(2) == 13);
+    }
+
+    SECTION("Contexts and caches don't mix entities") {
+        unified::UnifiedEngine engine(db);
+        engine.set_incremental(true);
+        BalanceSheet opening_bs;
+        for (int pass = 0; pass < 2; ++pass) {
+            CHECK(engine.calculate("E", 1, 1, opening_bs, "INCREMENTAL_TEST").get_value("GROSS") == Approx(400.0));
+            CHECK(engine.calculate("F", 1, 1, opening_bs, "INCREMENTAL_TEST").get_value("GROSS") == Approx(2000.0));
+        }
+        CHECK(engine.entities().find("F") == 1);
+    }
+}
+
+TEST_CASE("PeriodRunner: Parallel scenarios match sequential runs", "[orchestration][scenarios][parallel][prefetch]") {
+    const std::string path = "test_parallel_scenarios.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        {
+            auto db = create_incremental_db(path);
+            std::vector<ParamMap> drivers;
+            for (int scenario = 2; scenario <= 16; ++scenario) {
+                for (int period = 1; period <= 3; ++period) {
+                    for (auto [code, value] : {std::pair{"REVENUE", 1000.0 + 10.0 * scenario},
+                                               std::pair{"COSTS", 600.0 - period}, std::pair{"OTHER", 1.0 * scenario}}) {
+                        drivers.push_back({{"scenario", scenario}, {"period", period},
+                                           {"code", std::string(code)}, {"value", value}});
+                    }
+                }
+            }
+            db->execute_batch(
+                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                "VALUES ('E', :scenario, :period, :code, :value, 'EUR')", drivers);
+        }
+
+        std::vector<ScenarioID> scenarios;
+        for (ScenarioID scenario = 1; scenario <= 16; ++scenario) {
+            scenarios.push_back(scenario);
+        }
+        BalanceSheet initial_bs;
+        initial_bs.line_items["CASH"] = 100.0;
+        const std::vector<PeriodID> periods = {1, 2, 3};
+
+        PeriodRunner sequential(pool.writer());
+        auto expected = sequential.run_multiple_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST");
+
+        PeriodRunner parallel(pool.writer());
+        REQUIRE_THROWS_AS(parallel.set_scenario_parallel(4, nullptr), std::invalid_argument);
+        parallel.set_scenario_parallel(4, pool);
+        for (int pass = 0; pass < 2; ++pass) {
+            auto actual = parallel.run_multiple_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST");
+            REQUIRE(actual.size() == scenarios.size());
+            for (ScenarioID scenario : scenarios) {
+                REQUIRE(actual[scenario].success);
+                for (size_t p = 0; p < periods.size(); ++p) {
+                    CHECK(actual[scenario].results[p].get_all_values() == expected[scenario].results[p].get_all_values());
+                }
+            }
+        }
+        CHECK(expected[16].results[2].get_value("CASH") == Approx(100.0 + 0.75 * (3 * 560.0 + 6.0)));
+        CHECK(pool.reader_count() >= 1);
+
+        // An in-memory pool has one connection: its scenarios run one after another
+        const std::string uri = "file:test_parallel_scenarios?mode=memory&cache=shared";
+        ConnectionPool memory(uri);
+        auto memory_db = create_incremental_db(uri);
+        PeriodRunner shared(memory.writer());
+        shared.set_scenario_parallel(4, memory);
+        auto serial = shared.run_multiple_scenarios("E", {1}, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(serial[1].success);
+        CHECK(serial[1].results[2].get_all_values() == expected[1].results[2].get_all_values());
+        CHECK(shared.scenario_stats().executed == 0);
+        CHECK(memory.reader_count() == 0);
+
+        // Sequential, each scenario's drivers read while the previous one calculates
+        PeriodRunner prefetched(pool.writer());
+        prefetched.set_prefetch([&pool] { return pool.reader(); }, 1);
+        auto pipelined = prefetched.run_multiple_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(pipelined.size() == scenarios.size());
+        for (ScenarioID scenario : scenarios) {
+            REQUIRE(pipelined[scenario].success);
+            for (size_t p = 0; p < periods.size(); ++p) {
+                CHECK(pipelined[scenario].results[p].get_all_values() == expected[scenario].results[p].get_all_values());
+            }
+        }
+
+        // Statistics only, from worker aggregators or the prefetching runner
+        ResultAggregator stats(periods, 0.01, {"CASH", "REVENUE"});
+        parallel.aggregate_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST", stats);
+        CHECK(stats.runs() == scenarios.size());
+        CHECK(stats.failed_runs() == 0);
+        CHECK(stats.line_items() == std::vector<std::string>{"CASH", "REVENUE"});
+        CHECK(stats.get("NET_INCOME", 1) == nullptr);
+        ResultAggregator piped = stats.empty_copy();
+        prefetched.aggregate_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST", piped);
+        for (size_t p = 0; p < periods.size(); ++p) {
+            core::StreamingStatistics exact(0.01);
+            for (ScenarioID scenario : scenarios) {
+                exact.add(expected[scenario].results[p].get_value("CASH"));
+            }
+            for (const auto* cash : {stats.get("CASH", periods[p]), piped.get("CASH", periods[p])}) {
+                REQUIRE(cash);
+                CHECK(cash->count == scenarios.size());
+                CHECK(cash->mean() == exact.mean());
+                CHECK(cash->variance() == exact.variance());
+                CHECK(cash->min == exact.min);
+                CHECK(cash->max == exact.max);
+                CHECK(cash->quantile(0.5) == exact.quantile(0.5));
+            }
+        }
+        stats.merge(piped);
+        CHECK(stats.get("REVENUE", 3)->count == 2 * scenarios.size());
+        CHECK_THROWS_AS(stats.merge(ResultAggregator({1, 2})), std::invalid_argument);
+        prefetched.set_prefetch(nullptr);
+
+        // Results within a memory budget: about four scenarios resident, the rest spilled
+        const std::string spill_path = "test_budget_spill.fmcr";
+        const size_t run_bytes = BudgetedResults::bytes(expected[1]);
+        CHECK(run_bytes > 3 * 8 * expected[1].results[0].line_items.size());
+        const ResultBudget no_spill_file{.memory_bytes = run_bytes, .spill_path = "", .rows_per_group = 8192, .precision = {}};
+        CHECK_THROWS_AS(BudgetedResults(periods, no_spill_file, piped.empty_copy()), std::invalid_argument);
+        using Counter = core::EngineMetrics::Counter;
+        const auto metrics_before = core::EngineMetrics::global().snapshot();
+        {
+            BudgetedResults collected(
+                periods, {.memory_bytes = 4 * run_bytes, .spill_path = spill_path, .rows_per_group = 5, .precision = {}},
+                piped.empty_copy());
+            parallel.collect_scenarios("E", scenarios, periods, initial_bs, "INCREMENTAL_TEST", collected);
+            CHECK(collected.scenarios() == scenarios.size());
+            CHECK(collected.spilled().size() >= 8);
+            CHECK(collected.resident().size() + collected.spilled().size() == scenarios.size());
+            CHECK(collected.peak_resident_bytes() <= 5 * run_bytes);
+            CHECK(collected.resident_bytes() <= 4 * run_bytes);
+            CHECK(collected.spilled_bytes() == collected.spilled().size() * run_bytes);
+            CHECK_THROWS_AS(collected.add(3, MultiPeriodResults{}), std::invalid_argument);
+            for (PeriodID period : periods) {
+                CHECK(collected.statistics().get("CASH", period)->mean() == piped.get("CASH", period)->mean());
+                CHECK(collected.statistics().get("CASH", period)->variance() == piped.get("CASH", period)->variance());
+            }
+
+            const auto file = collected.close();
+            REQUIRE(file);
+            CHECK(file->rows == collected.spilled().size() * periods.size());
+            ColumnarResultReader reader(spill_path);
+            const auto cash = reader.read("CASH");
+            REQUIRE(cash.size() == file->rows);
+            for (size_t row = 0; row < cash.size(); ++row) {
+                const auto& run = expected[cash.scenario_ids[row]].results[cash.period_ids[row] - 1];
+                CHECK(cash.values[row] == run.get_value("CASH"));
+            }
+            for (const auto& [scenario, results] : collected.resident()) {
+                CHECK(results.results[2].get_all_values() == expected[scenario].results[2].get_all_values());
+            }
+            CHECK(collected.take_resident().size() + collected.spilled().size() == scenarios.size());
+            CHECK(collected.resident_bytes() == 0);
+            CHECK_THROWS_AS(collected.close(), std::runtime_error);
+        }
+        const auto metrics_after = core::EngineMetrics::global().snapshot();
+        CHECK(metrics_after[Counter::RESULT_SPILLED_SCENARIOS] - metrics_before[Counter::RESULT_SPILLED_SCENARIOS] >= 8);
+        CHECK(metrics_after[Counter::RESULT_SPILLED_BYTES] > metrics_before[Counter::RESULT_SPILLED_BYTES]);
+        std::remove(spill_path.c_str());
+
+        parallel.set_scenario_parallel(1, nullptr);
+        pool.close_readers();
+    }
+    remove_files();
+}
+
+// ============================================================================
+// Output, Stop Condition and Sensitivity Tests
+// ============================================================================
+
+TEST_CASE("PeriodRunner: Output selection calculates only the ancestors of the outputs", "[orchestration][outputs]") {
+    const std::string path = "test_outputs.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        auto db = create_incremental_db(path);
+        db->execute_raw(
+            "CREATE TABLE run_log (run_id INTEGER PRIMARY KEY AUTOINCREMENT, scenario_id INTEGER NOT NULL, "
+            "  started_at TEXT NOT NULL DEFAULT (datetime('now')), completed_at TEXT, status TEXT NOT NULL, "
+            "  error_message TEXT, user TEXT, json_config TEXT NOT NULL DEFAULT '{}');"
+            "CREATE TABLE unified_result (run_id INTEGER NOT NULL, entity_id TEXT NOT NULL, "
+            "  scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL, line_item_code TEXT NOT NULL, value REAL);");
+        auto tmpl = core::StatementTemplate::load_from_json(R"({
+            "template_code": "OUTPUTS_TEST",
+            "statement_type": "unified",
+            "version": "1.0",
+            "line_items": [
+                {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+                {"code": "COSTS", "base_value_source": "driver:COSTS"},
+                {"code": "OTHER", "base_value_source": "driver:OTHER"},
+                {"code": "GROSS", "formula": "REVENUE - COSTS"},
+                {"code": "NET", "formula": "GROSS * 0.75"},
+                {"code": "LAGGED_NET", "formula": "NET[t-1] + 1"},
+                {"code": "CASH", "formula": "CASH[t-1] + NET"},
+                {"code": "OTHER_SCALED", "formula": "OTHER * 2"}
+            ]
+        })");
+        tmpl->save_to_database(db.get());
+        db->execute_update(
+            "UPDATE scenario_drivers SET value = 800.0 WHERE period_id = 2 AND driver_code = 'COSTS'", {});
+        BalanceSheet initial_bs;
+        initial_bs.line_items["CASH"] = 100.0;
+        const std::vector<PeriodID> periods = {1, 2, 3};
+
+        PeriodRunner full_runner(db);
+        auto full = full_runner.run_periods("E", 1, periods, initial_bs, "OUTPUTS_TEST");
+        REQUIRE(full.success);
+
+        SECTION("Time-shifted ancestors are calculated every period") {
+            auto pruned = tmpl->with_outputs({"LAGGED_NET", "NOT_A_LINE_ITEM"});
+            CHECK(pruned->get_template_code() == "OUTPUTS_TEST");
+            CHECK(pruned->get_calculation_order().size() == 5);
+            CHECK(pruned->get_line_item("OTHER_SCALED") == nullptr);
+            CHECK(pruned->get_line_item("CASH") == nullptr);
+            CHECK_THROWS_AS(tmpl->with_outputs({"NOT_A_LINE_ITEM"}), std::invalid_argument);
+
+            auto writer = std::make_shared<ResultWriter>(db);
+            PeriodRunner runner(db);
+            runner.set_incremental(true);
+            runner.set_result_writer(writer);
+            runner.set_output_selection({"LAGGED_NET"});
+            auto selected = runner.run_periods("E", 1, periods, initial_bs, "OUTPUTS_TEST");
+            REQUIRE(selected.success);
+            CHECK(runner.engine().last_recalculated_count() == 3);   // GROSS, NET, LAGGED_NET
+            for (size_t p = 0; p < periods.size(); ++p) {
+                CHECK(selected.results[p].get_all_values().size() == 1);
+                CHECK(selected.results[p].get_value("LAGGED_NET") == Approx(full.results[p].get_value("LAGGED_NET")));
+            }
+            CHECK(selected.results[2].get_value("LAGGED_NET") == Approx(0.75 * 200.0 + 1.0));
+
+            writer->flush();
+            CHECK(writer->stats().rows == 3);
+            auto rows = db->execute_query("SELECT DISTINCT line_item_code FROM unified_result", {});
+            REQUIRE(rows->next());
+            CHECK(rows->get_string("line_item_code") == "LAGGED_NET");
+            CHECK_FALSE(rows->next());
+        }
+
+        SECTION("Selected outputs equal the full run on parallel workers") {
+            PeriodRunner runner(db);
+            runner.set_output_selection({"CASH", "OTHER_SCALED"});
+            runner.set_scenario_parallel(2, [path] { return DatabaseFactory::create_sqlite(path); });
+            const std::vector<ScenarioJob> jobs = {{"E", 1}, {"E", 1}};
+            auto runs = runner.run_jobs(jobs, periods, initial_bs, "OUTPUTS_TEST");
+            REQUIRE(runs.size() == 2);
+            for (const auto& run : runs) {
+                REQUIRE(run.success);
+                for (size_t p = 0; p < periods.size(); ++p) {
+                    CHECK(run.results[p].get_all_values().size() == 2);
+                    CHECK(run.results[p].get_value("CASH") == Approx(full.results[p].get_value("CASH")));
+                    CHECK(run.results[p].get_value("OTHER_SCALED") == Approx(10.0));
+                }
+            }
+        }
+    }
+    remove_files();
+}
+
+TEST_CASE("PeriodRunner: Trailing windows and horizon measures", "[orchestration][time_series]") {
+    auto db = create_runner_db();
+    db->execute_raw(
+        "CREATE TABLE balance_sheet_actuals (entity_id TEXT, scenario_id INTEGER, period_id INTEGER, "
+        "  line_item_code TEXT, value REAL);"
+        "INSERT INTO balance_sheet_actuals VALUES ('E', 1, 1, 'SALES', 900.0), ('E', 1, 2, 'SALES', 950.0);");
+    auto tmpl = core::StatementTemplate::load_from_json(R"json({
+        "template_code": "WINDOW_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "SALES", "formula": "REVENUE"},
+            {"code": "TRAILING", "formula": "SUM_WINDOW(SALES, 3)"},
+            {"code": "TRAILING_TERMS", "formula": "SALES[t-1] + SALES[t-2] + SALES[t-3]"},
+            {"code": "AVERAGE", "formula": "AVG_WINDOW(SALES, 3)"},
+            {"code": "LONG", "formula": "SUM_WINDOW(SALES, 24)"},
+            {"code": "SALES_GROWTH", "formula": "GROWTH(SALES)"},
+            {"code": "FLOW", "formula": "SALES - 1500"}
+        ]
+    })json");
+    tmpl->save_to_database(db.get());
+    std::vector<PeriodID> periods;
+    for (PeriodID period = 3; period <= 10; ++period) {
+        periods.push_back(period);
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', :revenue, 'EUR')",
+            {{"period", period}, {"revenue", 1000.0 + 100.0 * period}});
+    }
+    BalanceSheet initial_bs;
+    initial_bs.line_items["SALES"] = 1000.0;   // Period 2 as carried in (actuals say 950)
+
+    PeriodRunner runner(db);
+    runner.set_horizon_measures({{"NPV", HorizonMeasure::Kind::NPV, "SALES", 0.1},
+                                 {"IRR", HorizonMeasure::Kind::IRR, "FLOW"}});
+    auto results = runner.run_periods("E", 1, periods, initial_bs, "WINDOW_TEST");
+    REQUIRE(results.success);
+
+    // Before the run: the opening value for t-1, actuals further back
+    CHECK(results.results[0].get_value("TRAILING") == Approx(1000.0 + 900.0));
+    CHECK(results.results[0].get_value("AVERAGE") == Approx(950.0));
+    CHECK(results.results[0].get_value("LONG") == Approx(1900.0));
+    CHECK(results.results[1].get_value("TRAILING") == Approx(1300.0 + 1000.0 + 900.0));
+    CHECK(results.results[2].get_value("TRAILING") == Approx(1400.0 + 1300.0 + 1000.0));
+    for (size_t p = 3; p < periods.size(); ++p) {
+        CHECK(results.results[p].get_value("TRAILING") == Approx(results.results[p].get_value("TRAILING_TERMS")));
+        CHECK(results.results[p].get_value("AVERAGE") ==
+              Approx(results.results[p].get_value("TRAILING_TERMS") / 3.0));
+    }
+    for (size_t p = 1; p < periods.size(); ++p) {
+        CHECK(results.results[p].get_value("SALES_GROWTH") ==
+              Approx(100.0 / (1000.0 + 100.0 * (periods[p] - 1))));
+    }
+    CHECK(results.results[7].get_value("LONG") == Approx(1900.0 + 7 * 1000.0 + 100.0 * (3 + 4 + 5 + 6 + 7 + 8 + 9)));
+
+    // Horizon measures over the eight periods
+    std::vector<double> revenue, flow;
+    for (const auto& period : results.results) {
+        revenue.push_back(period.get_value("SALES"));
+        flow.push_back(period.get_value("FLOW"));
+    }
+    CHECK(results.horizon.at("NPV") == Approx(core::npv(0.1, revenue.data(), revenue.size())));
+    CHECK(results.horizon.at("IRR") == Approx(core::irr(flow.data(), flow.size())));
+    CHECK_THROWS_AS(runner.set_horizon_measures({{"BAD", HorizonMeasure::Kind::NPV, "SALES", -1.0}}),
+                    std::invalid_argument);
+
+    // A second run starts its windows over
+    auto again = runner.run_periods("E", 1, periods, initial_bs, "WINDOW_TEST");
+    REQUIRE(again.success);
+    for (size_t p = 0; p < periods.size(); ++p) {
+        CHECK(again.results[p].get_all_values() == results.results[p].get_all_values());
+    }
+}
+
+TEST_CASE("PeriodRunner: Runs stop at the first period meeting a stop condition", "[orchestration][stop]") {
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "STOP_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "LEVERAGE", "formula": "REVENUE / 1000"},
+            {"code": "HEADROOM", "formula": "100 / (REVENUE - 1500)"}
+        ]
+    })json")->save_to_database(db.get());
+    std::vector<PeriodID> periods;
+    for (PeriodID period = 1; period <= 8; ++period) {
+        periods.push_back(period);
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', :revenue, 'EUR')",
+            {{"period", period}, {"revenue", 1000.0 + 100.0 * period}});
+    }
+    BalanceSheet initial_bs;
+
+    PeriodRunner runner(db);
+    auto full = runner.run_periods("E", 1, periods, initial_bs, "STOP_TEST");
+    CHECK(full.results.size() == periods.size());
+    CHECK_FALSE(full.success);   // HEADROOM divides by zero in period 5
+    CHECK_FALSE(full.stopped_period);
+
+    // Breach: the run ends with the first period meeting the condition
+    runner.set_stop_conditions({"LEVERAGE > 1.25"});
+    auto breached = runner.run_periods("E", 1, {1, 2, 3, 4}, initial_bs, "STOP_TEST");
+    REQUIRE(breached.success);
+    REQUIRE(breached.stopped_period);
+    CHECK(*breached.stopped_period == 3);
+    CHECK(breached.results.size() == 3);
+    CHECK(breached.stop_reason.find("LEVERAGE > 1.25") != std::string::npos);
+    CHECK(breached.results.back().get_all_values() == full.results[2].get_all_values());
+
+    // Never met: every period, as without conditions
+    runner.set_stop_conditions({"LEVERAGE > 10"});
+    auto unmet = runner.run_periods("E", 1, {1, 2, 3, 4}, initial_bs, "STOP_TEST");
+    CHECK(unmet.results.size() == 4);
+    CHECK_FALSE(unmet.stopped_period);
+    CHECK(unmet.stop_reason.empty());
+
+    // First failed period
+    runner.set_stop_conditions({"", true});
+    auto failed = runner.run_periods("E", 1, periods, initial_bs, "STOP_TEST");
+    CHECK_FALSE(failed.success);
+    REQUIRE(failed.stopped_period);
+    CHECK(*failed.stopped_period == 5);
+    CHECK(failed.results.size() == 5);
+
+    // A condition reading a line item the period doesn't have is never met
+    runner.set_stop_conditions({"MISSING > 0"});
+    CHECK(runner.run_periods("E", 1, {1, 2}, initial_bs, "STOP_TEST").results.size() == 2);
+    CHECK_THROWS_AS(runner.set_stop_conditions({"LEVERAGE >"}), std::invalid_argument);
+}
+
+TEST_CASE("PeriodRunner: Driver sensitivities in one pass", "[orchestration][sensitivity]") {
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "SENSITIVITY_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "COSTS", "base_value_source": "driver:COSTS"},
+            {"code": "GROSS", "formula": "REVENUE - COSTS"},
+            {"code": "TAX", "formula": "MAX(0, GROSS) * 0.25"},
+            {"code": "NET", "formula": "GROSS - TAX"},
+            {"code": "MARGIN", "formula": "NET / REVENUE"},
+            {"code": "CASH", "formula": "CASH[t-1] + NET * (1 + driver:RATE)"}
+        ]
+    })json")->save_to_database(db.get());
+
+    // Scenarios 2-4 bump one driver in every period
+    const double h = 1e-3;
+    const std::vector<PeriodID> periods = {1, 2, 3, 4};
+    for (PeriodID period : periods) {
+        for (ScenarioID scenario = 1; scenario <= 4; ++scenario) {
+            db->execute_update(
+                "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                "VALUES ('E', :scenario, :period, 'REVENUE', :revenue, 'EUR'), "
+                "       ('E', :scenario, :period, 'COSTS', :costs, 'EUR'), "
+                "       ('E', :scenario, :period, 'RATE', :rate, 'EUR')",
+                {{"scenario", scenario}, {"period", period},
+                 {"revenue", 1000.0 + 50.0 * period + (scenario == 2 ? h : 0.0)},
+                 {"costs", 700.0 - 20.0 * period + (scenario == 3 ? h : 0.0)},
+                 {"rate", 0.05 + (scenario == 4 ? h : 0.0)}});
+        }
+    }
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    PeriodRunner runner(db);
+    auto bumped = [&](ScenarioID scenario) {
+        auto run = runner.run_periods("E", scenario, periods, initial_bs, "SENSITIVITY_TEST");
+        REQUIRE(run.success);
+        return run;
+    };
+    auto bumped_revenue = bumped(2);
+    auto bumped_costs = bumped(3);
+    auto bumped_rate = bumped(4);
+    auto plain = bumped(1);
+    CHECK(plain.results[0].sensitivities.empty());
+
+    runner.set_sensitivity_drivers({"REVENUE", "COSTS", "RATE"});
+    auto results = runner.run_periods("E", 1, periods, initial_bs, "SENSITIVITY_TEST");
+    REQUIRE(results.success);
+    for (size_t p = 0; p < periods.size(); ++p) {
+        const auto& result = results.results[p];
+        CHECK(result.get_all_values() == plain.results[p].get_all_values());
+        REQUIRE_FALSE(result.sensitivities.empty());
+        for (const std::string code : {"GROSS", "TAX", "NET", "MARGIN", "CASH"}) {
+            CAPTURE(p, code);
+            const double base = result.get_value(code);
+            CHECK(result.sensitivities.get(code, "REVENUE") ==
+                  Approx((bumped_revenue.results[p].get_value(code) - base) / h).margin(1e-6).epsilon(1e-4));
+            CHECK(result.sensitivities.get(code, "COSTS") ==
+                  Approx((bumped_costs.results[p].get_value(code) - base) / h).margin(1e-6).epsilon(1e-4));
+            CHECK(result.sensitivities.get(code, "RATE") ==
+                  Approx((bumped_rate.results[p].get_value(code) - base) / h).margin(1e-6).epsilon(1e-4));
+        }
+    }
+
+    // CASH accumulates NET through [t-1]: d CASH / d REVENUE = 0.75 (1 + RATE) per period
+    CHECK(results.results[3].sensitivities.get("CASH", "REVENUE") == Approx(4 * 0.75 * 1.05));
+    CHECK(results.results[0].sensitivities.get("REVENUE", "REVENUE") == 1.0);
+    CHECK(results.results[0].sensitivities.get("REVENUE", "COSTS") == 0.0);
+    CHECK_THROWS_AS(results.results[0].sensitivities.get("CASH", "OTHER"), std::out_of_range);
+    CHECK_THROWS_AS(results.results[0].sensitivities.get("UNKNOWN", "REVENUE"), std::out_of_range);
+
+    // The next run starts from the opening balance sheet again
+    auto again = runner.run_periods("E", 1, periods, initial_bs, "SENSITIVITY_TEST");
+    REQUIRE(again.success);
+    CHECK(again.results[3].sensitivities.get("CASH", "REVENUE") == Approx(4 * 0.75 * 1.05));
+
+    runner.set_sensitivity_drivers({});
+    CHECK(runner.run_periods("E", 1, periods, initial_bs, "SENSITIVITY_TEST").results[0].sensitivities.empty());
+}
+
+TEST_CASE("PeriodRunner: Adjoint gradient of an output by every driver", "[orchestration][adjoint]") {
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "ADJOINT_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "COSTS", "base_value_source": "driver:COSTS"},
+            {"code": "GROSS", "formula": "REVENUE - COSTS"},
+            {"code": "TAX", "formula": "MAX(0, GROSS) * 0.25"},
+            {"code": "NET", "formula": "GROSS - TAX"},
+            {"code": "MARGIN", "formula": "NET / REVENUE"},
+            {"code": "CASH", "formula": "CASH[t-1] + NET * (1 + driver:RATE)"}
+        ]
+    })json")->save_to_database(db.get());
+
+    const std::vector<PeriodID> periods = {1, 2, 3, 4, 5, 6, 7};
+    for (PeriodID period : periods) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', :revenue, 'EUR'), "
+            "       ('E', 1, :period, 'COSTS', :costs, 'EUR'), "
+            "       ('E', 1, :period, 'RATE', 0.05, 'EUR')",
+            {{"period", period}, {"revenue", 1000.0 + 50.0 * period}, {"costs", 700.0 - 20.0 * period}});
+    }
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    // Forward mode as the reference
+    PeriodRunner runner(db);
+    runner.set_sensitivity_drivers({"REVENUE", "COSTS", "RATE"});
+    auto forward = runner.run_periods("E", 1, periods, initial_bs, "ADJOINT_TEST");
+    REQUIRE(forward.success);
+    runner.set_sensitivity_drivers({});
+    const auto& last = forward.results.back();
+
+    auto whole = runner.gradient("E", 1, periods, initial_bs, "ADJOINT_TEST", "CASH");
+    REQUIRE(whole.success);
+    CHECK(whole.period_id == 7);
+    CHECK(whole.value == Approx(last.get_value("CASH")));
+    CHECK(whole.recomputed_periods == 0);
+    for (const std::string driver : {"REVENUE", "COSTS", "RATE"}) {
+        CAPTURE(driver);
+        REQUIRE(whole.drivers.count(driver) == 1);
+        CHECK(whole.drivers.at(driver) == Approx(last.sensitivities.get("CASH", driver)).epsilon(1e-6));
+    }
+    CHECK(whole.drivers.at("REVENUE") == Approx(7 * 0.75 * 1.05));
+
+    // Checkpointed segments give the same gradient with a smaller tape
+    for (size_t every : {2u, 3u}) {
+        CAPTURE(every);
+        auto segmented = runner.gradient("E", 1, periods, initial_bs, "ADJOINT_TEST", "CASH", every);
+        REQUIRE(segmented.success);
+        CHECK(segmented.value == whole.value);
+        CHECK(segmented.recomputed_periods == periods.size());
+        CHECK(segmented.peak_tape_bytes < whole.peak_tape_bytes);
+        for (const auto& [driver, adjoint] : whole.drivers) {
+            CAPTURE(driver);
+            CHECK(segmented.drivers.at(driver) == Approx(adjoint).epsilon(1e-12));
+        }
+    }
+
+    // An output of the last period only
+    auto margin = runner.gradient("E", 1, periods, initial_bs, "ADJOINT_TEST", "MARGIN", 3);
+    REQUIRE(margin.success);
+    CHECK(margin.drivers.at("REVENUE") == Approx(last.sensitivities.get("MARGIN", "REVENUE")).epsilon(1e-6));
+    CHECK(margin.drivers.at("RATE") == 0.0);
+
+    auto unknown = runner.gradient("E", 1, periods, initial_bs, "ADJOINT_TEST", "UNKNOWN");
+    CHECK_FALSE(unknown.success);
+    CHECK_FALSE(unknown.errors.empty());
+
+    // The runner is left as it was
+    auto plain = runner.run_periods("E", 1, periods, initial_bs, "ADJOINT_TEST");
+    REQUIRE(plain.success);
+    CHECK(plain.results.back().get_value("CASH") == whole.value);
+}
@@ -0,0 +1,133 @@
+/**
+ * @file test_period_schedule.cpp
+ * @brief Tests for mixed-granularity period schedules
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/period_rollup.h"
+#include "orchestration/period_setup.h"
+#include "database/result_set.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("PeriodRunner: Mixed-granularity schedules with scaled flows and rollups", "[orchestration][schedule]") {
+    auto db = create_runner_db();
+    db->execute_update(
+        "CREATE TABLE period (period_id INTEGER PRIMARY KEY AUTOINCREMENT, start_date TEXT, end_date TEXT, "
+        "  days_in_period INTEGER, period_type TEXT, period_index INTEGER, label TEXT)", {});
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "SCHEDULE_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "time_scaling": {"basis_days": 365, "flow_drivers": ["REVENUE"], "stocks": ["CASH"], "rates": ["MARGIN"]},
+        "line_items": [
+            {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+            {"code": "MARGIN", "base_value_source": "driver:MARGIN"},
+            {"code": "PROFIT", "formula": "REVENUE * MARGIN"},
+            {"code": "CASH", "formula": "CASH[t-1] + PROFIT"}
+        ]
+    })json")->save_to_database(db.get());
+
+    // 2024-01 .. 2024-03, 2024-Q2 .. 2024-Q4, 2025, 2026
+    const auto periods = PeriodSetup::create_period_schedule(
+        db.get(), "2024-01-01",
+        {{PeriodGranularity::MONTHLY, 3}, {PeriodGranularity::QUARTERLY, 3}, {PeriodGranularity::ANNUAL, 2}});
+    REQUIRE(periods.size() == 8);
+    const std::vector<int> days = {31, 29, 31, 91, 92, 92, 365, 365};
+    const std::vector<std::string> labels = {"2024-01", "2024-02", "2024-03", "2024-Q2",
+                                             "2024-Q3", "2024-Q4", "2025", "2026"};
+    for (size_t i = 0; i < periods.size(); ++i) {
+        auto row = db->execute_query("SELECT days_in_period, label, end_date FROM period WHERE period_id = :id",
+                                     {{"id", periods[i]}});
+        REQUIRE(row->next());
+        CHECK(row->get_int(0) == days[i]);
+        CHECK(row->get_string(1) == labels[i]);
+        if (i > 0) {
+            CHECK(periods[i] == periods[i - 1] + 1);   // [t-1] is the period before
+        }
+    }
+    auto last = db->execute_query("SELECT end_date FROM period WHERE period_id = :id", {{"id", periods.back()}});
+    REQUIRE(last->next());
+    CHECK(last->get_string(0) == "2026-12-31");
+
+    // Revenue is given per year, margin as a rate
+    for (size_t i = 0; i < periods.size(); ++i) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'REVENUE', 3650.0, 'EUR'), ('E', 1, :period, 'MARGIN', :margin, 'EUR')",
+            {{"period", periods[i]}, {"margin", 0.1 * static_cast<double>(i + 1)}});
+    }
+    BalanceSheet opening;
+    opening.line_items["CASH"] = 1000.0;
+
+    PeriodRunner runner(db);
+    auto run = runner.run_periods("E", 1, periods, opening, "SCHEDULE_TEST");
+    REQUIRE(run.success);
+    double cash = 1000.0;
+    for (size_t i = 0; i < periods.size(); ++i) {
+        const double revenue = 10.0 * days[i];
+        CHECK(run.results[i].get_value("REVENUE") == Approx(revenue));
+        CHECK(run.results[i].get_value("MARGIN") == Approx(0.1 * static_cast<double>(i + 1)));
+        cash += revenue * 0.1 * static_cast<double>(i + 1);
+        CHECK(run.results[i].get_value("CASH") == Approx(cash));
+    }
+
+    // A raw driver input moves a flow by the period's scale
+    auto gradient = runner.gradient("E", 1, periods, opening, "SCHEDULE_TEST", "CASH");
+    REQUIRE(gradient.success);
+    double expected = 0.0;
+    for (size_t i = 0; i < periods.size(); ++i) {
+        expected += days[i] / 365.0 * 0.1 * static_cast<double>(i + 1);
+    }
+    CHECK(gradient.drivers.at("REVENUE") == Approx(expected));
+
+    auto tmpl = core::StatementTemplate::load_from_database(db.get(), "SCHEDULE_TEST");
+    SECTION("Annual rollup") {
+        auto years = PeriodRollup::load(*db, periods, PeriodGranularity::ANNUAL);
+        years.set_time_scaling(tmpl->get_time_scaling());
+        REQUIRE(years.buckets().size() == 3);
+        CHECK(years.buckets()[0].label == "2024");
+        CHECK(years.buckets()[0].days == 366);
+        auto revenue = years.series(run, "REVENUE");
+        CHECK(revenue[0] == Approx(3660.0));
+        CHECK(revenue[1] == Approx(3650.0));
+        CHECK(years.value(run, "CASH", 0) == Approx(run.results[5].get_value("CASH")));
+        double margin = 0.0;
+        for (size_t i = 0; i < 6; ++i) {
+            margin += days[i] * 0.1 * static_cast<double>(i + 1);
+        }
+        CHECK(years.value(run, "MARGIN", 0) == Approx(margin / 366.0));
+    }
+
+    SECTION("Quarterly rollup keeps longer periods as they are") {
+        auto quarters = PeriodRollup::load(*db, periods, PeriodGranularity::QUARTERLY);
+        quarters.set_time_scaling(tmpl->get_time_scaling());
+        REQUIRE(quarters.buckets().size() == 6);
+        CHECK(quarters.buckets()[0].label == "2024-Q1");
+        CHECK(quarters.buckets()[0].last == 2);
+        CHECK(quarters.buckets()[4].label == "2025");
+        CHECK(quarters.value(run, "REVENUE", 0) == Approx(910.0));
+        CHECK(quarters.value(run, "MARGIN", 0) == Approx((31 * 0.1 + 29 * 0.2 + 31 * 0.3) / 91.0));
+        CHECK(quarters.value(run, "CASH", 0) == Approx(run.results[2].get_value("CASH")));
+
+        MultiPeriodResults partial;
+        partial.results.resize(3);
+        CHECK_THROWS_AS(quarters.value(partial, "REVENUE", 0), std::invalid_argument);
+    }
+
+    SECTION("Flow drivers need the period's days") {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, 999, 'REVENUE', 3650.0, 'EUR'), ('E', 1, 999, 'MARGIN', 0.1, 'EUR')", {});
+        auto unknown = runner.run_periods("E", 1, {999}, opening, "SCHEDULE_TEST");
+        CHECK_FALSE(unknown.success);
+        CHECK_THROWS_AS(PeriodRollup::load(*db, {999}, PeriodGranularity::ANNUAL), std::invalid_argument);
+    }
+}
@@ -0,0 +1,168 @@
+/**
+ * @file test_policy_kernels.cpp
+ * @brief Tests for the working capital and capex policy kernels
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "policy/capex_policy.h"
+#include "policy/wc_policy.h"
+#include "test_databases.h"
+#include <fstream>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("Policy kernels: working capital days and capex vintages", "[orchestration][policy]") {
+    SECTION("Vintages depreciate straight-line in O(1) per period") {
+        policy::VintageSchedule<double> vintages(3, 0.0);
+        CHECK(vintages.depreciation() == 0.0);
+        const std::vector<double> capex = {300.0, 0.0, 60.0, 0.0, 0.0, 0.0, 0.0};
+        std::vector<double> depreciation;
+        for (double spent : capex) {
+            vintages.add(spent);
+            depreciation.push_back(vintages.depreciation());   // Of the next period
+        }
+        CHECK(depreciation == std::vector<double>{100.0, 100.0, 120.0, 20.0, 20.0, 0.0, 0.0});
+
+        // A recalculated period replaces its vintage
+        vintages.add(90.0);
+        CHECK(vintages.depreciation_of_newest() == 0.0);
+        vintages.replace_newest(30.0);
+        CHECK(vintages.depreciation() == 10.0);
+        CHECK(vintages.periods() == 4);
+
+        // Lanes keep their own vintages side by side
+        policy::VintageSchedule<core::LaneArray> lanes(3, core::LaneArray::Zero(2));
+        for (double spent : capex) {
+            core::LaneArray values(2);
+            values << spent, 2.0 * spent;
+            lanes.add(values);
+        }
+        policy::VintageSchedule<double> single(3, 0.0);
+        for (double spent : capex) {
+            single.add(2.0 * spent);
+        }
+        CHECK(lanes.depreciation()[1] == single.depreciation());
+        CHECK_THROWS_AS(policy::VintageSchedule<double>(0, 0.0), std::invalid_argument);
+
+        policy::WorkingCapitalPolicy wc;
+        wc.dso_days = 45.0;
+        CHECK(wc.receivables(900.0, 90.0) == 450.0);
+        core::LaneArray revenue(2);
+        revenue << 900.0, 180.0;
+        CHECK(wc.receivables(revenue, 90.0)[1] == 90.0);
+
+        policy::CapexPolicy fixed;
+        fixed.method = policy::CapexPolicy::parse_method("fixed");
+        fixed.fixed_amount = 25.0;
+        CHECK(fixed.capex(revenue, revenue)[1] == 25.0);
+        CHECK_THROWS_AS(policy::CapexPolicy::parse_method("annuity"), std::invalid_argument);
+    }
+
+    SECTION("Templates read policy values") {
+        auto db = create_runner_db(":memory:");
+        db->execute_raw(
+            "CREATE TABLE period (period_id INTEGER PRIMARY KEY, days_in_period INTEGER);"
+            "INSERT INTO period VALUES (1, 90), (2, 91), (3, 92), (4, 92);"
+            "CREATE TABLE capex_policy (policy_id INTEGER PRIMARY KEY AUTOINCREMENT, code TEXT NOT NULL UNIQUE, "
+            "  name TEXT NOT NULL, method TEXT NOT NULL, fixed_amount NUMERIC, revenue_pct NUMERIC, "
+            "  depreciation_pct NUMERIC, is_active INTEGER NOT NULL DEFAULT 1);"
+            "CREATE TABLE wc_policy (policy_id INTEGER PRIMARY KEY AUTOINCREMENT, code TEXT NOT NULL UNIQUE, "
+            "  name TEXT NOT NULL, dso_days NUMERIC, dpo_days NUMERIC, dio_days NUMERIC, "
+            "  is_active INTEGER NOT NULL DEFAULT 1);"
+        );
+        std::ifstream migration("../data/migrations/017_policy_kernels.sql");
+        REQUIRE(migration);
+        db->execute_raw(std::string(std::istreambuf_iterator<char>(migration), std::istreambuf_iterator<char>()));
+        db->execute_raw(
+            "INSERT INTO capex_policy (code, name, method, depreciation_pct, useful_life_periods) "
+            "  VALUES ('DEFAULT', 'Default', 'depreciation_pct', 1.5, 2);"
+            "INSERT INTO capex_policy (code, name, method, revenue_pct) VALUES ('GROWTH', 'Growth', 'revenue_pct', 0.1);"
+            "INSERT INTO wc_policy (code, name, dso_days, dpo_days, dio_days) VALUES ('DEFAULT', 'Default', 45, 30, 60);"
+            "INSERT INTO scenario_drivers VALUES "
+            "  ('E', 1, 1, 'REVENUE', 900.0, ''), ('E', 1, 2, 'REVENUE', 910.0, ''), "
+            "  ('E', 1, 3, 'REVENUE', 920.0, ''), ('E', 1, 4, 'REVENUE', 920.0, ''), "
+            "  ('E', 1, 1, 'CAPEX', 400.0, ''), ('E', 1, 2, 'CAPEX', 100.0, ''), "
+            "  ('E', 1, 3, 'CAPEX', 0.0, ''), ('E', 1, 4, 'CAPEX', 0.0, ''), "
+            "  ('E', 2, 1, 'REVENUE', 900.0, ''), ('E', 2, 2, 'REVENUE', 910.0, ''), "
+            "  ('E', 2, 3, 'REVENUE', 920.0, ''), ('E', 2, 4, 'REVENUE', 920.0, ''), "
+            "  ('E', 2, 1, 'CAPEX', 0.0, ''), ('E', 2, 2, 'CAPEX', 200.0, ''), "
+            "  ('E', 2, 3, 'CAPEX', 0.0, ''), ('E', 2, 4, 'CAPEX', 0.0, '');"
+        );
+        auto tmpl = core::StatementTemplate::load_from_json(R"({
+            "template_code": "POLICY_TEST",
+            "statement_type": "unified",
+            "version": "1.0",
+            "line_items": [
+                {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+                {"code": "CAPEX", "base_value_source": "driver:CAPEX"},
+                {"code": "DEPRECIATION", "formula": "policy:DEPRECIATION"},
+                {"code": "REPLACEMENT_CAPEX", "formula": "policy:CAPEX"},
+                {"code": "ACCOUNTS_RECEIVABLE", "formula": "REVENUE * policy:DSO_FACTOR"}
+            ]
+        })");
+        tmpl->save_to_database(db.get());
+
+        // Vintages of earlier periods, over a life of 2 periods
+        BalanceSheet initial_bs;
+        PeriodRunner runner(db);
+        auto run = runner.run_periods("E", 1, {1, 2, 3, 4}, initial_bs, "POLICY_TEST");
+        REQUIRE(run.success);
+        std::vector<double> depreciation;
+        for (const auto& result : run.results) {
+            depreciation.push_back(result.get_value("DEPRECIATION"));
+        }
+        CHECK(depreciation == std::vector<double>{0.0, 200.0, 250.0, 50.0});
+        CHECK(run.results[2].get_value("REPLACEMENT_CAPEX") == 1.5 * 250.0);
+        CHECK(run.results[0].get_value("ACCOUNTS_RECEIVABLE") == Approx(450.0));
+        CHECK(run.results[1].get_value("ACCOUNTS_RECEIVABLE") == Approx(910.0 * 45.0 / 91.0));
+
+        // A second run starts its vintages over
+        auto again = runner.run_periods("E", 1, {1, 2, 3, 4}, initial_bs, "POLICY_TEST");
+        CHECK(again.results[3].get_value("DEPRECIATION") == 50.0);
+
+        // Parallel steps read the period lengths without querying
+        PeriodRunner parallel(db);
+        parallel.set_parallel(4, 1);
+        auto concurrent = parallel.run_periods("E", 1, {1, 2, 3, 4}, initial_bs, "POLICY_TEST");
+        REQUIRE(concurrent.success);
+        for (size_t p = 0; p < run.results.size(); ++p) {
+            CHECK(concurrent.results[p].get_all_values() == run.results[p].get_all_values());
+        }
+
+        // A period added since the table was read is read before it is calculated
+        db->execute_raw(
+            "INSERT INTO period VALUES (5, 30);"
+            "INSERT INTO scenario_drivers VALUES ('E', 1, 5, 'REVENUE', 300.0, ''), ('E', 1, 5, 'CAPEX', 0.0, '');");
+        auto added = parallel.run_periods("E", 1, {5}, initial_bs, "POLICY_TEST");
+        REQUIRE(added.success);
+        CHECK(added.results[0].get_value("ACCOUNTS_RECEIVABLE") == Approx(300.0 * 45.0 / 30.0));
+
+        // Lanes keep a schedule per lane
+        unified::UnifiedEngine engine(db);
+        std::vector<std::vector<double>> lane_depreciation(2);
+        for (PeriodID period_id : {1, 2, 3, 4}) {
+            auto lanes = engine.calculate_lanes("E", {1, 2}, period_id, {initial_bs}, "POLICY_TEST");
+            REQUIRE(lanes.size() == 2);
+            for (size_t lane = 0; lane < 2; ++lane) {
+                REQUIRE(lanes[lane].success);
+                lane_depreciation[lane].push_back(lanes[lane].get_value("DEPRECIATION"));
+            }
+        }
+        CHECK(lane_depreciation[0] == depreciation);
+        CHECK(lane_depreciation[1] == std::vector<double>{0.0, 0.0, 100.0, 100.0});
+
+        // A revenue_pct policy has a rate instead of an amount
+        CHECK_THROWS_AS(engine.select_policies("DEFAULT", "LEAN"), std::out_of_range);
+        engine.select_policies("DEFAULT", "GROWTH");
+        CHECK(engine.policies().capex()->revenue_pct == 0.1);
+        CHECK(engine.policies().has_value("policy:CAPEX_RATE"));
+        CHECK_FALSE(engine.policies().has_value("policy:CAPEX"));
+        CHECK(engine.policies().working_capital()->dio_days == 60.0);
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * @file test_result_cache.cpp
+ * @brief Tests for the content-addressed result cache
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "test_databases.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("PeriodRunner: Runs with known inputs are read from the result cache", "[orchestration][result_cache]") {
+    namespace fs = std::filesystem;
+    const fs::path dir = "test_result_cache";
+    fs::remove_all(dir);
+
+    auto db = create_incremental_db();
+    // Scenario 2 has the same drivers as scenario 1, scenario 3 another revenue
+    db->execute_raw(
+        "INSERT INTO scenario_drivers SELECT entity_id, 2, period_id, driver_code, value, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1;"
+        "INSERT INTO scenario_drivers SELECT entity_id, 3, period_id, driver_code, "
+        "  CASE driver_code WHEN 'REVENUE' THEN 1200.0 ELSE value END, unit_code "
+        "FROM scenario_drivers WHERE scenario_id = 1;"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    auto cache = std::make_shared<ResultCache>(dir.string());
+    PeriodRunner runner(db);
+    runner.set_result_cache(cache);
+    auto first = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(first.success);
+    CHECK(cache->stats().misses == 1);
+    CHECK(cache->stats().stores == 1);
+
+    // The same inputs again, and under another scenario: nothing is calculated
+    size_t observed = 0;
+    runner.set_period_observer([&](const EntityID&, ScenarioID, PeriodID, const unified::UnifiedResult&) {
+        ++observed;
+        return true;
+    });
+    auto again = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    auto same = runner.run_periods("E", 2, periods, initial_bs, "INCREMENTAL_TEST");
+    CHECK(cache->stats().memory_hits == 2);
+    CHECK(observed == 6);
+    REQUIRE(same.results.size() == 3);
+    for (size_t i = 0; i < periods.size(); ++i) {
+        CHECK(again.results[i].get_all_values() == first.results[i].get_all_values());
+        CHECK(same.results[i].get_all_values() == first.results[i].get_all_values());
+    }
+
+    // Other drivers or another opening balance are other runs
+    auto higher = runner.run_periods("E", 3, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(higher.success);
+    CHECK(higher.results[2].get_value("GROSS") == Approx(600.0));
+    BalanceSheet other_bs;
+    other_bs.line_items["CASH"] = 200.0;
+    auto other = runner.run_periods("E", 1, periods, other_bs, "INCREMENTAL_TEST");
+    CHECK(other.results[2].get_value("CASH") == Approx(first.results[2].get_value("CASH") + 100.0));
+    CHECK(cache->stats().misses == 3);
+
+    // A new process reads the files; a damaged one is recalculated
+    auto reopened = std::make_shared<ResultCache>(dir.string());
+    PeriodRunner later(db);
+    later.set_result_cache(reopened);
+    auto from_disk = later.run_periods("E", 2, periods, initial_bs, "INCREMENTAL_TEST");
+    CHECK(reopened->stats().disk_hits == 1);
+    REQUIRE(from_disk.results.size() == 3);
+    CHECK(from_disk.results[1].get_all_values() == first.results[1].get_all_values());
+
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        std::fstream out(entry.path(), std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(30);
+        out.put('\x7F');
+    }
+    auto fresh = std::make_shared<ResultCache>(dir.string());
+    later.set_result_cache(fresh);
+    auto recalculated = later.run_periods("E", 3, periods, initial_bs, "INCREMENTAL_TEST");
+    CHECK(fresh->stats().disk_hits == 0);
+    CHECK(fresh->stats().misses == 1);
+    CHECK(recalculated.results[2].get_all_values() == higher.results[2].get_all_values());
+
+    fs::remove_all(dir);
+}
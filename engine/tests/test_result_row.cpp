@@ -0,0 +1,114 @@
+/**
+ * @file test_result_row.cpp
+ * @brief Tests for dense result storage
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "unified/result_row.h"
+#include "unified/unified_engine.h"
+#include "core/symbol_table.h"
+#include <stdexcept>
+#include <thread>
+
+using namespace finmodel;
+using namespace finmodel::unified;
+
+TEST_CASE("ResultSchema - Code lookup", "[result][schema]") {
+    ResultSchema schema({"REVENUE", "COGS", "GROSS_PROFIT"});
+
+    REQUIRE(schema.size() == 3);
+    REQUIRE(schema.find("COGS") == 1);
+    REQUIRE(schema.code(2) == "GROSS_PROFIT");
+    REQUIRE(schema.find("EBIT") == ResultSchema::NO_INDEX);
+    REQUIRE_THROWS_AS(ResultSchema({"REVENUE", "REVENUE"}), std::invalid_argument);
+}
+
+TEST_CASE("SymbolTable - One Symbol per code across threads", "[result][symbols]") {
+    core::SymbolTable table;
+    const core::Symbol revenue = table.intern("REVENUE");
+    REQUIRE(table.intern(std::string("REVENUE")) == revenue);
+    REQUIRE(table.name(revenue) == "REVENUE");
+    REQUIRE(table.find("COGS") == core::NO_SYMBOL);
+
+    // Concurrent interning agrees on every code; names stay readable meanwhile
+    constexpr int codes = 5000;   // More than one chunk of names
+    std::vector<std::vector<core::Symbol>> seen(4, std::vector<core::Symbol>(codes));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < seen.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < codes; ++i) {
+                seen[t][i] = table.intern("LI_" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(table.size() == codes + 1);
+    for (int i = 0; i < codes; ++i) {
+        for (size_t t = 1; t < seen.size(); ++t) {
+            REQUIRE(seen[t][i] == seen[0][i]);
+        }
+        REQUIRE(table.name(seen[0][i]) == "LI_" + std::to_string(i));
+    }
+    REQUIRE(table.name(revenue) == "REVENUE");
+
+    // Schemas share the global table's Symbols
+    ResultSchema schema({"REVENUE", "COGS"});
+    const core::Symbol cogs = core::SymbolTable::global().find("COGS");
+    REQUIRE(schema.symbol(1) == cogs);
+    REQUIRE(schema.find(cogs) == 1);
+    REQUIRE(ResultSchema({"COGS"}).symbols() == std::vector<core::Symbol>{cogs});
+    REQUIRE(ResultRow(std::make_shared<const ResultSchema>(schema), {1.0, 2.0}).find(cogs) != nullptr);
+}
+
+TEST_CASE("ResultRow - Values against a shared schema", "[result][row]") {
+    auto schema = std::make_shared<const ResultSchema>(
+        std::vector<std::string>{"REVENUE", "COGS", "GROSS_PROFIT"});
+
+    SECTION("Lookup and iteration in schema order") {
+        ResultRow row(schema, {1000.0, 600.0, 400.0});
+        REQUIRE(row.size() == 3);
+        REQUIRE(row.at("GROSS_PROFIT") == 400.0);
+        REQUIRE(row.find("EBIT") == nullptr);
+        REQUIRE_THROWS_AS(row.at("EBIT"), std::out_of_range);
+
+        std::vector<std::string> codes;
+        double total = 0.0;
+        for (const auto& [code, value] : row) {
+            codes.push_back(code);
+            total += value;
+        }
+        REQUIRE(codes == schema->codes());
+        REQUIRE(total == 2000.0);
+        REQUIRE(row.to_map() == std::map<std::string, double>{
+            {"COGS", 600.0}, {"GROSS_PROFIT", 400.0}, {"REVENUE", 1000.0}});
+    }
+
+    SECTION("Partial row holds the leading line items") {
+        ResultRow row(schema, {1000.0});
+        REQUIRE(row.contains("REVENUE"));
+        REQUIRE_FALSE(row.contains("COGS"));
+        REQUIRE_THROWS_AS(ResultRow(schema, {1.0, 2.0, 3.0, 4.0}), std::invalid_argument);
+    }
+
+    SECTION("Equality compares codes and values") {
+        auto reordered = std::make_shared<const ResultSchema>(
+            std::vector<std::string>{"COGS", "REVENUE", "GROSS_PROFIT"});
+        ResultRow row(schema, {1000.0, 600.0, 400.0});
+        REQUIRE(row == ResultRow(schema, {1000.0, 600.0, 400.0}));
+        REQUIRE(row == ResultRow(reordered, {600.0, 1000.0, 400.0}));
+        REQUIRE(row != ResultRow(reordered, {1000.0, 600.0, 400.0}));
+        REQUIRE(row != ResultRow(schema, {1000.0, 600.0}));
+    }
+
+    SECTION("Copies share the schema") {
+        UnifiedResult result;
+        result.line_items = ResultRow(schema, {1000.0, 600.0, 400.0});
+        UnifiedResult copy = result;
+        REQUIRE(copy.line_items.schema() == schema);
+        REQUIRE(copy.get_value("COGS") == 600.0);
+        REQUIRE(copy.get_value("EBIT") == 0.0);
+        REQUIRE(copy.extract_pl_result().line_items.at("GROSS_PROFIT") == 400.0);
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * @file test_result_table.cpp
+ * @brief Tests for the run_results SQL virtual table
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/columnar_results.h"
+#include "orchestration/compressed_results.h"
+#include "orchestration/result_table.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include <cstdio>
+#include <limits>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+
+TEST_CASE("ResultTable: SQL over in-memory and columnar results", "[orchestration][result_table]") {
+    auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"REVENUE", "CASH"});
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // ACME: scenarios 1..3 in memory, CASH missing in scenario 3 period 2
+    std::vector<PeriodID> periods = {1, 2, 3, 4};
+    auto sweep = std::make_shared<CompressedResultSet>(periods);
+    for (ScenarioID scenario = 1; scenario <= 3; ++scenario) {
+        MultiPeriodResults results;
+        for (PeriodID period : periods) {
+            const double cash = (scenario == 3 && period == 2) ? nan : scenario * 100.0 + period;
+            unified::UnifiedResult result;
+            result.line_items = unified::ResultRow(schema, {1000.0 * scenario, cash});
+            results.results.push_back(std::move(result));
+        }
+        sweep->add(scenario, results);
+    }
+
+    // BETA: scenarios 0..9 of an earlier run in a columnar file
+    const std::string path = "test_result_table.fmcr";
+    {
+        ColumnarResultWriter writer(path, 8);
+        for (ScenarioID scenario = 0; scenario < 10; ++scenario) {
+            for (PeriodID period : periods) {
+                writer.append(scenario, period, unified::ResultRow(schema, {50.0, scenario * 10.0 + period}));
+            }
+        }
+        writer.close();
+    }
+
+    auto table = std::make_shared<ResultTable>();
+    table->add("ACME", sweep);
+    table->add("BETA", std::make_shared<ColumnarResultReader>(path));
+
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    ResultTable::register_module(*db, table);
+    db->execute_raw("CREATE TABLE entity (entity_id TEXT PRIMARY KEY, name TEXT)");
+    db->execute_raw("INSERT INTO entity VALUES ('ACME', 'Acme Corp'), ('BETA', 'Beta Ltd')");
+
+    auto scalar = [&db](const std::string& sql, const ParamMap& params = {}) {
+        auto result = db->execute_query(sql, params);
+        REQUIRE(result->next());
+        return result->get_double(0);
+    };
+
+    SECTION("Every cell with a value is a row") {
+        CHECK(scalar("SELECT COUNT(*) FROM run_results") == 3 * 4 * 2 - 1 + 10 * 4 * 2);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE entity_id = 'ACME' AND line_item = 'CASH'") == 11);
+        CHECK(scalar("SELECT value FROM run_results WHERE entity_id = 'ACME' AND scenario_id = 2 "
+                     "AND period_id = 3 AND line_item = 'CASH'") == sweep->value(2, "CASH", 3));
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE entity_id = 'NONE'") == 0);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE line_item = 'EBITDA'") == 0);
+    }
+
+    SECTION("Pushed ranges give the rows SQLite would") {
+        // Strict and inclusive bounds, fractional bounds on integer columns, parameters
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE entity_id = 'BETA' AND line_item = 'CASH' "
+                     "AND scenario_id > 2 AND scenario_id <= 5") == 3 * 4);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE entity_id = 'BETA' AND line_item = 'CASH' "
+                     "AND period_id < 2.5 AND period_id >= 1.5") == 10);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE line_item = 'CASH' AND value > 92 AND value < 203",
+                     {}) == 6 + 2);
+        CHECK(scalar("SELECT SUM(value) FROM run_results WHERE line_item = 'CASH' AND scenario_id = :sid "
+                     "AND period_id = :pid", {{"sid", 2}, {"pid", 4}}) == 204.0 + 24.0);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE scenario_id = NULL") == 0);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE scenario_id > 3 AND scenario_id < 2") == 0);
+    }
+
+    SECTION("Line item lists, aggregates and joins") {
+        CHECK(scalar("SELECT COUNT(*) FROM run_results WHERE line_item IN ('REVENUE', 'EBITDA') "
+                     "AND entity_id = 'ACME'") == 12);
+        auto result = db->execute_query(
+            "SELECT e.name, AVG(r.value) FROM run_results r JOIN entity e USING (entity_id) "
+            "WHERE r.line_item = 'CASH' AND r.period_id = 4 GROUP BY e.name ORDER BY e.name", {});
+        REQUIRE(result->next());
+        CHECK(result->get_string(0) == "Acme Corp");
+        CHECK(result->get_double(1) == (104.0 + 204.0 + 304.0) / 3.0);
+        REQUIRE(result->next());
+        CHECK(result->get_string(0) == "Beta Ltd");
+        CHECK(result->get_double(1) == 49.0);
+        CHECK_FALSE(result->next());
+    }
+
+    SECTION("Registering again replaces the results; the table is read-only") {
+        auto other = std::make_shared<ResultTable>();
+        other->add("ACME", sweep);
+        ResultTable::register_module(*db, other);
+        CHECK(scalar("SELECT COUNT(*) FROM run_results") == 23);
+        CHECK_THROWS_AS(db->execute_raw("DELETE FROM run_results"), DatabaseException);
+    }
+
+    CHECK_THROWS_AS(table->add("NONE", std::shared_ptr<const ResultTableSource>()), std::invalid_argument);
+    std::remove(path.c_str());
+}
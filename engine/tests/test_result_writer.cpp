@@ -0,0 +1,165 @@
+/**
+ * @file test_result_writer.cpp
+ * @brief Tests for the asynchronous result writer
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "core/engine_metrics.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include "test_databases.h"
+#include <fstream>
+#include <thread>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("ResultWriter: Runs are stored by the writer thread", "[orchestration][writer]") {
+    auto db = create_incremental_db();
+    auto results_db = DatabaseFactory::create_sqlite(":memory:");
+    results_db->execute_raw(
+        "CREATE TABLE run_log (run_id INTEGER PRIMARY KEY AUTOINCREMENT, scenario_id INTEGER NOT NULL, "
+        "  started_at TEXT NOT NULL DEFAULT (datetime('now')), completed_at TEXT, status TEXT NOT NULL, "
+        "  error_message TEXT, user TEXT, json_config TEXT NOT NULL DEFAULT '{}');"
+        "CREATE TABLE unified_result (run_id INTEGER NOT NULL, entity_id TEXT NOT NULL, "
+        "  scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL, line_item_code TEXT NOT NULL, value REAL);"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+
+    // Small transactions: a run spans several write passes
+    auto writer = std::make_shared<ResultWriter>(results_db, 10);
+    PeriodRunner runner(db);
+    runner.set_result_writer(writer);
+    auto first = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+    auto second = runner.run_periods("E", 1, {1, 2}, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(first.success);
+    REQUIRE(second.success);
+    writer->flush();
+
+    auto stats = writer->stats();
+    CHECK(stats.runs == 2);
+    CHECK(stats.periods == 5);
+    CHECK(stats.rows == 5 * first.results[0].get_all_values().size());
+
+    auto runs = results_db->execute_query(
+        "SELECT status, completed_at IS NOT NULL, json_extract(json_config, '$.periods'), "
+        "       json_extract(json_config, '$.write_ms') IS NOT NULL FROM run_log ORDER BY run_id", {});
+    std::vector<int> run_periods;
+    for (auto [status, completed, periods, timed] : runs->rows<std::string, int, int, int>()) {
+        CHECK(status == "completed");
+        CHECK(completed == 1);
+        CHECK(timed == 1);
+        run_periods.push_back(periods);
+    }
+    CHECK(run_periods == std::vector<int>{3, 2});
+
+    {
+        auto cash = results_db->execute_query(
+            "SELECT value FROM unified_result WHERE run_id = :run_id AND period_id = 3 AND line_item_code = 'CASH'",
+            {{"run_id", static_cast<int>(writer->run_id(0))}});
+        REQUIRE(cash->next());
+        CHECK(cash->get_double(0) == Approx(first.results[2].get_value("CASH")));
+    }
+
+    SECTION("Summary KPIs are folded in while the run is written") {
+        std::ifstream migration("../data/migrations/014_run_summary.sql");
+        REQUIRE(migration);
+        results_db->execute_raw(
+            std::string(std::istreambuf_iterator<char>(migration), std::istreambuf_iterator<char>()));
+        const double first_cash = first.results[0].get_value("CASH");
+        writer->set_summary(RunSummarySpec::parse({"final:CASH", "min:CASH", "mean:CASH", "rising=above:CASH:" +
+                                                   std::to_string(first_cash), "sum:MISSING"}));
+        auto third = runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(third.success);
+        writer->flush();
+        CHECK(writer->stats().summaries == 1);
+
+        double min_cash = first_cash;
+        double sum_cash = 0.0;
+        int rising = 0;
+        for (const auto& result : third.results) {
+            min_cash = std::min(min_cash, result.get_value("CASH"));
+            sum_cash += result.get_value("CASH");
+            rising += result.get_value("CASH") > first_cash ? 1 : 0;
+        }
+        auto summary = results_db->execute_query(
+            "SELECT entity_id, periods, json_extract(summary, '$.final_CASH'), json_extract(summary, '$.min_CASH'), "
+            "       json_extract(summary, '$.mean_CASH'), json_extract(summary, '$.rising'), "
+            "       json_type(summary, '$.sum_MISSING') "
+            "FROM run_summary WHERE run_id = :run_id AND scenario_id = 1",
+            {{"run_id", static_cast<int>(writer->run_id(2))}});
+        REQUIRE(summary->next());
+        CHECK(summary->get_string(0) == "E");
+        CHECK(summary->get_int(1) == 3);
+        CHECK(summary->get_double(2) == Approx(third.results[2].get_value("CASH")));
+        CHECK(summary->get_double(3) == Approx(min_cash));
+        CHECK(summary->get_double(4) == Approx(sum_cash / 3.0));
+        CHECK(summary->get_int(5) == rising);
+        CHECK(summary->get_string(6) == "null");
+        CHECK_FALSE(summary->next());
+
+        CHECK_THROWS_AS(RunSummarySpec::parse({"min:CASH", "min:CASH"}), std::invalid_argument);
+        CHECK_THROWS_AS(SummaryMeasure::parse("median:CASH"), std::invalid_argument);
+        CHECK_THROWS_AS(SummaryMeasure::parse("below:CASH"), std::invalid_argument);
+        CHECK_THROWS_AS(SummaryMeasure::parse("min:CASH:0"), std::invalid_argument);
+        CHECK_THROWS_AS(SummaryMeasure::parse("above:CASH:x"), std::invalid_argument);
+        CHECK(SummaryMeasure::parse("breaches=below:CASH:-1.5").threshold == -1.5);
+    }
+
+    SECTION("Workers hand periods over through a bounded queue") {
+        using Counter = core::EngineMetrics::Counter;
+        const auto metrics_before = core::EngineMetrics::global().snapshot();
+        auto small = std::make_shared<ResultWriter>(results_db, 1000, false, 3);
+        auto schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"A", "B"});
+        std::vector<std::thread> workers;
+        std::vector<ResultWriter::RunHandle> handles(4);
+        for (int w = 0; w < 4; ++w) {
+            workers.emplace_back([&, w] {
+                handles[w] = small->begin_run(10 + w);
+                for (PeriodID p = 1; p <= 50; ++p) {
+                    small->write_period(handles[w], "E", 10 + w, p, unified::ResultRow(schema, {double(w), double(p)}));
+                }
+                small->end_run(handles[w], true);
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        small->flush();
+
+        const auto stats = small->stats();
+        CHECK(stats.queue_capacity == 4);
+        CHECK(stats.queue_depth == 0);
+        CHECK(stats.max_queue_depth <= 4);
+        CHECK(stats.periods == 200);
+        CHECK(stats.rows == 400);
+        const auto metrics_after = core::EngineMetrics::global().snapshot();
+        CHECK(metrics_after[Counter::RESULT_JOBS_QUEUED] - metrics_before[Counter::RESULT_JOBS_QUEUED] == 4 * 52);
+        CHECK(metrics_after[Counter::RESULT_JOBS_WRITTEN] - metrics_before[Counter::RESULT_JOBS_WRITTEN] == 4 * 52);
+        CHECK(metrics_after[Counter::RESULT_QUEUE_STALLS] - metrics_before[Counter::RESULT_QUEUE_STALLS] == stats.stalls);
+
+        // Every run's periods follow its run_log row, with its own values
+        for (int w = 0; w < 4; ++w) {
+            auto stored = results_db->execute_query(
+                "SELECT COUNT(*), SUM(value) FROM unified_result WHERE run_id = :run_id AND line_item_code = 'B' "
+                "AND scenario_id = :scenario_id",
+                {{"run_id", static_cast<int>(small->run_id(handles[w]))}, {"scenario_id", 10 + w}});
+            REQUIRE(stored->next());
+            CHECK(stored->get_int(0) == 50);
+            CHECK(stored->get_double(1) == Approx(50 * 51 / 2));
+        }
+    }
+
+    SECTION("Write errors surface on flush") {
+        results_db->execute_raw("DROP TABLE unified_result;");
+        runner.run_periods("E", 1, {1}, initial_bs, "INCREMENTAL_TEST");
+        CHECK_THROWS_AS(writer->flush(), DatabaseException);
+        CHECK_NOTHROW(writer->flush());
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file test_reverse_stress.cpp
+ * @brief Tests for the reverse stress search
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/reverse_stress.h"
+#include "test_databases.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("ReverseStressSearch: Driver shocks that just breach a threshold", "[orchestration][reverse_stress]") {
+    const std::string path = "test_reverse_stress.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    {
+        ConnectionPool pool(path);
+        const std::vector<PeriodID> periods = {1, 2, 3, 4, 5};
+        {
+            auto db = create_runner_db(path);
+            core::StatementTemplate::load_from_json(R"json({
+                "template_code": "REVERSE_STRESS_TEST",
+                "statement_type": "unified",
+                "version": "1.0",
+                "line_items": [
+                    {"code": "PROFIT", "base_value_source": "driver:PROFIT"},
+                    {"code": "LOSSES", "formula": "driver:LOSS_RATE * 1000"},
+                    {"code": "CAPITAL", "formula": "CAPITAL[t-1] + PROFIT - LOSSES"}
+                ]
+            })json")->save_to_database(db.get());
+            for (PeriodID period : periods) {
+                db->execute_update(
+                    "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+                    "VALUES ('E', 1, :period, 'PROFIT', 10.0, 'EUR'), ('E', 1, :period, 'LOSS_RATE', 0.01, 'EUR')",
+                    {{"period", period}});
+            }
+        }
+
+        // CAPITAL in period p: 100 + p × (PROFIT shift - 1000 × LOSS_RATE shift), breached below 50
+        // from period 5 on 1000 × loss - profit = 10; in driver ranges (0.05, 20) 50 x - 20 y = 10
+        ReverseStressSpec spec;
+        spec.entity_id = "E";
+        spec.scenario_id = 1;
+        spec.period_ids = periods;
+        spec.initial_bs.line_items["CAPITAL"] = 100.0;
+        spec.template_code = "REVERSE_STRESS_TEST";
+        spec.breach_code = "CAPITAL";
+        spec.threshold = 50.0;
+        spec.drivers = {{"LOSS_RATE", 0.0, 0.05}, {"PROFIT", -20.0, 0.0}};
+        spec.tolerance = 1e-4;
+        const double least_severity = 10.0 / std::sqrt(50.0 * 50.0 + 20.0 * 20.0);
+
+        auto on_boundary = [](const BoundaryScenario& scenario) {
+            return 1000.0 * scenario.shifts.at("LOSS_RATE") - scenario.shifts.at("PROFIT");
+        };
+
+        ReverseStressSearch search([&pool] { return pool.reader(); }, 4);
+
+        SECTION("Bisection along directions") {
+            spec.method = ReverseStressMethod::BISECTION;
+            auto found = search.search(spec);
+            REQUIRE(found.success);
+            CHECK_FALSE(found.base_breached);
+            REQUIRE(found.boundary.size() == spec.directions);
+            CHECK(found.unbreached_directions == 0);
+            for (const auto& scenario : found.boundary) {
+                CHECK(on_boundary(scenario) == Approx(10.0).margin(0.1));
+                CHECK(on_boundary(scenario) >= 10.0);
+                CHECK(scenario.margin <= 0.0);
+                CHECK(scenario.breach_period == 5);
+            }
+            CHECK(found.boundary.front().severity >= least_severity - 1e-9);
+
+            // Either axis alone: LOSS_RATE + 0.01 or PROFIT - 10
+            bool loss_axis = false;
+            for (const auto& scenario : found.boundary) {
+                if (scenario.shifts.at("PROFIT") == 0.0) {
+                    loss_axis = true;
+                    CHECK(scenario.shifts.at("LOSS_RATE") == Approx(0.01).margin(1e-5));
+                }
+            }
+            CHECK(loss_axis);
+
+            // About log2(1 / tolerance) runs per direction, far below a grid of that resolution
+            CHECK(found.evaluations <= 1 + spec.directions * 16);
+        }
+
+        SECTION("Adaptive refinement concentrates on the least severe breaches") {
+            spec.method = ReverseStressMethod::BISECTION;
+            auto coarse = search.search(spec);
+            spec.method = ReverseStressMethod::ADAPTIVE;
+            auto refined = search.search(spec);
+            REQUIRE(refined.success);
+            CHECK(refined.boundary.size() > coarse.boundary.size());
+            CHECK(refined.boundary.front().severity <= coarse.boundary.front().severity);
+            CHECK(refined.boundary.front().severity == Approx(least_severity).epsilon(0.01));
+
+            // Brackets next to a neighbour's boundary cost fewer runs than the first round
+            const size_t refinement_runs = refined.evaluations - coarse.evaluations;
+            CHECK(refinement_runs < spec.refinements * (coarse.evaluations - 1));
+        }
+
+        SECTION("Gradient steps to the least severe breach") {
+            spec.method = ReverseStressMethod::GRADIENT;
+            auto found = search.search(spec);
+            REQUIRE(found.success);
+            CHECK(found.errors.empty());
+            REQUIRE(found.boundary.size() == 1);
+            const auto& scenario = found.boundary.front();
+            CHECK(scenario.severity == Approx(least_severity).epsilon(1e-3));
+            CHECK(scenario.shifts.at("LOSS_RATE") == Approx(0.05 * 50.0 / 2900.0 * 10.0).epsilon(1e-2));
+            CHECK(on_boundary(scenario) == Approx(10.0).margin(0.1));
+            CHECK(found.evaluations < 40);
+        }
+
+        SECTION("Unbreached directions, a breached base and invalid specs") {
+            spec.method = ReverseStressMethod::BISECTION;
+            spec.threshold = -400.0;
+            auto never = search.search(spec);
+            REQUIRE(never.success);
+            CHECK(never.boundary.empty());
+            CHECK(never.unbreached_directions == spec.directions);
+
+            spec.threshold = 150.0;
+            auto base = search.search(spec);
+            CHECK(base.success);
+            CHECK(base.base_breached);
+            CHECK(base.evaluations == 1);
+
+            spec.threshold = 50.0;
+            spec.drivers[0].lower = 0.01;
+            CHECK_FALSE(search.search(spec).success);
+            spec.drivers[0] = {"UNKNOWN", 0.0, 1.0};
+            CHECK_FALSE(search.search(spec).success);
+            spec.drivers.clear();
+            CHECK_FALSE(search.search(spec).success);
+        }
+    }
+    remove_files();
+}
@@ -0,0 +1,92 @@
+/**
+ * @file test_run_checkpoint.cpp
+ * @brief Tests for checkpointed, resumable runs
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "test_databases.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("PeriodRunner: Runs resume from their last checkpoint", "[orchestration][checkpoint]") {
+    namespace fs = std::filesystem;
+    const fs::path root = "test_checkpoints";
+    fs::remove_all(root);
+
+    auto db = create_incremental_db();
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    PeriodRunner uninterrupted(db);
+    auto expected = uninterrupted.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+    REQUIRE(expected.success);
+
+    auto store = std::make_shared<CheckpointStore>(root.string(), "run/42");
+    PeriodRunner runner(db);
+    runner.set_checkpoints(store, 1);
+
+    SECTION("A rerun calculates only the periods after the checkpoint") {
+        // The first attempt stopped after period 2
+        auto first = runner.run_periods("E", 1, {1, 2}, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(first.results.size() == 2);
+        auto checkpoint = store->load("E", 1);
+        REQUIRE(checkpoint);
+        CHECK(checkpoint->last_period == 2);
+        CHECK(checkpoint->periods_done == 2);
+        CHECK(checkpoint->prior_values.at("CASH") == Approx(expected.results[1].get_value("CASH")));
+        CHECK(checkpoint->history.size() == 2);
+
+        PeriodRunner rerun(db);
+        rerun.set_checkpoints(store);
+        auto resumed = rerun.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(resumed.success);
+        CHECK(resumed.resumed_periods == 2);
+        REQUIRE(resumed.results.size() == 1);
+        CHECK(resumed.results[0].get_all_values() == expected.results[2].get_all_values());
+        CHECK(store->load("E", 1)->last_period == 3);
+        CHECK_FALSE(store->load("E", 2));
+    }
+
+    SECTION("Windows of a horizon continue each other") {
+        runner.run_periods("E", 1, {1}, initial_bs, "INCREMENTAL_TEST");
+        auto window = runner.run_periods("E", 1, {2, 3}, BalanceSheet{}, "INCREMENTAL_TEST");
+        CHECK(window.resumed_periods == 0);
+        REQUIRE(window.results.size() == 2);
+        CHECK(window.results[1].get_all_values() == expected.results[2].get_all_values());
+
+        CHECK_THROWS_AS(runner.run_periods("E", 1, periods, initial_bs, "OTHER_TEMPLATE"), std::runtime_error);
+
+        store->remove("E", 1);
+        auto fresh = runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+        CHECK(fresh.resumed_periods == 0);
+        CHECK(fresh.results.size() == 3);
+    }
+
+    SECTION("Damaged checkpoints are rejected") {
+        runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+        fs::path file;
+        for (const auto& entry : fs::recursive_directory_iterator(root)) {
+            if (entry.path().extension() == ".ckpt") {
+                file = entry.path();
+            }
+        }
+        REQUIRE_FALSE(file.empty());
+        {
+            std::fstream out(file, std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(12);
+            out.put('\x7F');
+        }
+        CHECK_THROWS_AS(store->load("E", 1), std::runtime_error);
+    }
+
+    fs::remove_all(root);
+}
@@ -0,0 +1,121 @@
+/**
+ * @file test_run_estimate.cpp
+ * @brief Tests for run cost estimates
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/run_estimate.h"
+#include "orchestration/batch_run.h"
+#include "database/database_factory.h"
+#include "test_databases.h"
+#include <cstdio>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("RunEstimator: Run costs from plan statistics and run size", "[orchestration][estimate]") {
+    const std::string path = "test_estimate.db";
+    auto remove_files = [&path] {
+        std::remove(path.c_str());
+        std::remove((path + "-wal").c_str());
+        std::remove((path + "-shm").c_str());
+    };
+    remove_files();
+    create_incremental_db(path);
+
+    {
+        unified::UnifiedEngine engine(DatabaseFactory::create_sqlite(path));
+        const unified::PlanStatistics plan = engine.plan_statistics("INCREMENTAL_TEST");
+        CHECK(plan.line_items() == 8);
+        CHECK(plan.formulas == 5);
+        CHECK(plan.instructions > plan.formulas);
+        CHECK(plan.prior_period_reads == 1);
+        CHECK(plan.history_reads == 0);
+        CHECK(plan.levels >= 4);
+        CHECK(plan.circular_blocks == 0);
+        CHECK(plan.kernel_eligible);
+        CHECK_THROWS_AS(engine.plan_statistics("NO_SUCH_TEMPLATE"), std::invalid_argument);
+
+        auto manifest_json = [&](size_t scenarios, const std::string& output) {
+            return R"({"database": ")" + path + R"(", "template": "INCREMENTAL_TEST", "entity": "E",
+                       "scenarios": {"first": 1, "count": )" + std::to_string(scenarios) + R"(}, "periods": "1-12",
+                       "threads": 4, "output": )" + output + "}";
+        };
+
+        SECTION("Estimates scale with the run") {
+            const RunEstimate small = RunEstimator::estimate(plan, RunManifest::from_json(manifest_json(100, R"({"type": "none"})")));
+            const RunEstimate large = RunEstimator::estimate(plan, RunManifest::from_json(manifest_json(1000, R"({"type": "none"})")));
+            CHECK(small.runs == 100);
+            CHECK(small.periods == 1200);
+            CHECK(small.output_bytes == 0);
+            REQUIRE(small.backends.size() == 3);
+            REQUIRE(large.backends.size() == 3);
+            for (size_t b = 0; b < small.backends.size(); ++b) {
+                CHECK(large.backends[b].cpu_seconds > small.backends[b].cpu_seconds);
+                CHECK(large.backends[b].wall_seconds <= large.backends[b].cpu_seconds);
+                CHECK(small.backends[b].peak_memory_bytes > 0);
+            }
+            // 100 scenarios: 2 batches of 64 lanes, 2 shards
+            CHECK(small.backends[0].workers == 4);
+            CHECK(small.backends[1].workers == 2);
+            CHECK(small.backends[2].workers == 2);
+            CHECK(large.backends[0].cpu_seconds == Approx(10.0 * small.backends[0].cpu_seconds));
+            CHECK(large.backends[0].wall_seconds == Approx(large.backends[0].cpu_seconds / 4.0));
+            // Lanes share the per period work of a batch
+            CHECK(large.backends[1].cpu_seconds < large.backends[0].cpu_seconds);
+            CHECK(RunEstimator::estimate(plan, RunManifest::from_json(manifest_json(1000, R"({"type": "none"})")), {}, 4)
+                      .backends[2].workers == 16);
+            CHECK_THROWS_AS(RunEstimator::estimate(plan, RunManifest::from_json(manifest_json(1, R"({"type": "none"})")), {}, 0),
+                            std::invalid_argument);
+            CHECK(large.report().find("Runs:        1000") != std::string::npos);
+            CHECK(large.to_json().find("\"backend\":\"lanes\"") != std::string::npos);
+        }
+
+        SECTION("Output size follows the output type and precision") {
+            const RunEstimate columnar = RunEstimator::estimate(
+                plan, RunManifest::from_json(manifest_json(10, R"({"type": "columnar", "path": "out.fmcr"})")));
+            CHECK(columnar.stored_line_items == 8);
+            CHECK(columnar.output_bytes == 10 * 12 * (8 + 8 * 8));
+
+            RunManifest manifest = RunManifest::from_json(manifest_json(10, R"({"type": "database"})"));
+            manifest.outputs = {"CASH", "NET"};
+            CostCalibration calibration;
+            calibration.database_row_bytes = 50;
+            CHECK(RunEstimator::estimate(plan, manifest, calibration).output_bytes == 10 * 12 * 2 * 50);
+
+            // From the manifest's database, with its output selection
+            const RunEstimate selected = RunEstimator::estimate(manifest, calibration);
+            CHECK(selected.plan.line_items() < 8);
+            CHECK(selected.stored_line_items == 2);
+        }
+
+        SECTION("Calibration from costs or benchmark output") {
+            const CostCalibration costs = CostCalibration::from_json(R"({"instruction_ns": 2.0, "lanes": 32})");
+            CHECK(costs.instruction_ns == Approx(2.0));
+            CHECK(costs.lanes == 32);
+            CHECK(costs.period_ns == Approx(CostCalibration{}.period_ns));
+
+            const CostCalibration measured = CostCalibration::from_json(R"({"context": {}, "benchmarks": [
+                {"name": "BM_FormulaEvaluator_EvaluateBound/1", "run_type": "iteration", "cpu_time": 27.0, "time_unit": "ns"},
+                {"name": "BM_PeriodRunner_RunPeriods/1000/20", "run_type": "iteration", "cpu_time": 4.0,
+                 "time_unit": "ms", "items_per_second": 2.5e6},
+                {"name": "BM_DriverValueProvider_GetSlotValue", "run_type": "iteration", "cpu_time": 0.003, "time_unit": "us"}
+            ]})");
+            CHECK(measured.instruction_ns == Approx(3.0));
+            CHECK(measured.line_item_ns == Approx(400.0 - 27.0));
+            CHECK(measured.input_ns == Approx(3.0));
+            CHECK(measured.prior_period_read_ns == Approx(CostCalibration{}.prior_period_read_ns));
+
+            CHECK_THROWS_AS(CostCalibration::from_json("{"), std::invalid_argument);
+            CHECK_THROWS_AS(CostCalibration::from_json(R"({"input_ns": -1})"), std::invalid_argument);
+            CHECK_THROWS_AS(CostCalibration::load("no_such_calibration.json"), std::invalid_argument);
+        }
+    }
+
+    // The engine's connection is closed, so the WAL files go with the database
+    remove_files();
+}
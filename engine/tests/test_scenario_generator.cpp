@@ -5,9 +5,13 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include "orchestration/scenario_generator.h"
+#include "orchestration/mac_sweep.h"
+#include <catch2/catch_approx.hpp>
+#include <bit>
 #include <iostream>
 
 using namespace finmodel::orchestration;
+using Catch::Approx;
 
 TEST_CASE("ScenarioGenerator: Combination generation", "[scenario_generator]") {
     SECTION("Generate 2^3 = 8 combinations") {
@@ -109,4 +113,145 @@ TEST_CASE("ScenarioGenerator: Combination generation", "[scenario_generator]") {
         std::cout << "\n2^6 = 64 scenarios generated, total active actions across all scenarios: "
                   << total_active_actions << std::endl;
     }
+
+    SECTION("Lazy range matches the materialised combinations") {
+        std::vector<std::string> actions = {"LED", "Process", "Solar", "Wind"};
+        auto all = ScenarioGenerator::generate_all_combinations(actions, 700, "LAZY");
+        auto range = ScenarioGenerator::combinations(actions, 700, "LAZY");
+
+        REQUIRE(range.size() == all.size());
+        size_t i = 0;
+        for (const ScenarioMask& mask : range) {
+            auto config = range.config(mask);
+            REQUIRE(config.scenario_id == all[i].scenario_id);
+            REQUIRE(config.code == all[i].code);
+            REQUIRE(config.name == all[i].name);
+            REQUIRE(config.description == all[i].description);
+            REQUIRE(config.action_flags == all[i].action_flags);
+            REQUIRE(range.active_actions(mask).size() == ScenarioGenerator::get_active_actions(all[i]).size());
+            REQUIRE(range.is_active(mask, "Solar") == ScenarioGenerator::is_action_active(all[i], "Solar"));
+            ++i;
+        }
+        REQUIRE(i == 16);
+        REQUIRE_FALSE(range.is_active(range[15], "Unknown"));
+
+        // Chunks cover the range once, the last one clipped
+        size_t covered = 0;
+        for (size_t first = 0; first < range.size(); first += 6) {
+            auto chunk = range.chunk(first, 6);
+            REQUIRE(chunk.front().scenario_id == 700 + static_cast<int>(first));
+            covered += chunk.size();
+        }
+        REQUIRE(covered == 16);
+        REQUIRE(range.chunk(12, 100).size() == 4);
+        REQUIRE(range.chunk(16, 1).empty());
+    }
+
+    SECTION("Lazy range of 40 actions without materialising it") {
+        std::vector<std::string> actions;
+        for (int j = 0; j < 40; j++) {
+            actions.push_back("A" + std::to_string(j));
+        }
+        auto range = ScenarioGenerator::combinations(actions, 1);
+
+        REQUIRE(range.size() == (size_t{1} << 40));
+        ScenarioMask last = *(range.end() - 1);
+        REQUIRE(last.actions == (uint64_t{1} << 40) - 1);
+        REQUIRE(range.active_actions(last).size() == 40);
+        REQUIRE(range.config(range[5]).name == "A0+A2");
+
+        std::vector<std::string> too_many(64, "X");
+        REQUIRE_THROWS_AS(ScenarioGenerator::combinations(too_many, 1), std::invalid_argument);
+    }
+
+    SECTION("Gray code order toggles one action at a time") {
+        auto range = ScenarioGenerator::combinations({"A", "B", "C", "D", "E"}, 800, "GRAY", CombinationOrder::GRAY);
+
+        std::vector<bool> seen(range.size(), false);
+        for (size_t i = 0; i < range.size(); ++i) {
+            const ScenarioMask mask = range[i];
+            REQUIRE(mask.scenario_id == 800 + static_cast<int>(mask.actions));
+            REQUIRE_FALSE(seen[mask.actions]);
+            seen[mask.actions] = true;
+            if (i > 0) {
+                const uint64_t toggled = mask.actions ^ range[i - 1].actions;
+                REQUIRE(toggled == (uint64_t{1} << CombinationRange::toggled_action(i)));
+            }
+        }
+        REQUIRE(range.config(range[2]).name == "A+B");
+    }
+}
+
+TEST_CASE("MACSweep: Full combinations only where actions interact", "[scenario_generator]") {
+    SECTION("Overlapping actions are combined, additive ones keep their single run") {
+        // B and C abate the same source: together they save 600, not 800
+        const std::vector<double> saving = {1000.0, 500.0, 300.0, 200.0};
+        auto emissions = [&](uint64_t active) {
+            double total = 3000.0;
+            for (size_t i = 0; i < saving.size(); ++i) {
+                if (active & (uint64_t{1} << i)) {
+                    total -= saving[i];
+                }
+            }
+            if ((active & 0b0110) == 0b0110) {
+                total += 200.0;
+            }
+            return total;
+        };
+        std::vector<MACAction> actions = {
+            {"A", "", "", 100000.0, -5000.0}, {"B", "", "", 0.0, 8000.0},
+            {"C", "", "", 0.0, 3000.0}, {"D", "", "", 0.0, -1000.0}};
+        size_t calls = 0;
+        MACSweep sweep(actions, [&](uint64_t active) { ++calls; return emissions(active); });
+        auto result = sweep.run();
+
+        REQUIRE(result.baseline_emissions == Approx(3000.0));
+        REQUIRE(result.pairs_measured == 6);
+        REQUIRE(result.interacting_pairs.size() == 1);
+        REQUIRE(result.combined_groups == std::vector<std::vector<std::string>>{{"B", "C"}});
+        REQUIRE(result.scenarios_run == 11);   // Base, 4 singles, 6 pairs (B+C among them)
+        REQUIRE(calls == 11);
+
+        std::map<std::string, MACSweepPoint> by_code;
+        for (const auto& point : result.points) {
+            by_code[point.point.action_code] = point;
+        }
+        // Shapley values split the overlap evenly
+        CHECK(by_code["B"].combined);
+        CHECK(by_code["B"].point.annual_reduction_tco2e == Approx(400.0));
+        CHECK(by_code["B"].reduction_error == Approx(100.0));
+        CHECK(by_code["C"].point.annual_reduction_tco2e == Approx(200.0));
+        CHECK(by_code["C"].mac_low == Approx(3000.0 / 300.0));
+        CHECK(by_code["C"].mac_high == Approx(3000.0 / 100.0));
+        CHECK_FALSE(by_code["A"].combined);
+        CHECK(by_code["A"].point.annual_reduction_tco2e == Approx(1000.0));
+        CHECK(by_code["A"].reduction_error == Approx(0.0));
+        CHECK(by_code["A"].point.marginal_cost_per_tco2e == Approx(5.0));
+
+        // Sorted by MAC, cumulative reductions add up
+        CHECK(result.points.front().point.action_code == "D");
+        CHECK(result.points.back().point.cumulative_reduction_tco2e == Approx(1800.0));
+    }
+
+    SECTION("Many additive actions cost N + 1 + sampled pairs runs") {
+        std::vector<MACAction> actions;
+        for (int i = 0; i < 20; ++i) {
+            actions.push_back({"A" + std::to_string(i), "", "", 1000.0, 0.0});
+        }
+        MACSweepOptions options;
+        options.max_pairs = 30;
+        MACSweep sweep(actions, [](uint64_t active) {
+            return 10000.0 - 10.0 * static_cast<double>(std::popcount(active));
+        }, options);
+        auto result = sweep.run();
+
+        REQUIRE(result.scenarios_run == 1 + 20 + 30);
+        REQUIRE(result.interacting_pairs.empty());
+        REQUIRE(result.points.size() == 20);
+        for (const auto& point : result.points) {
+            CHECK(point.reduction_error == Approx(0.0));
+            CHECK(point.mac_low == Approx(10.0));
+            CHECK(point.mac_high == Approx(10.0));
+        }
+    }
 }
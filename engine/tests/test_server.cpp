@@ -0,0 +1,158 @@
+/**
+ * @file test_server.cpp
+ * @brief Tests for the metrics endpoint and connection handling of server mode
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/task_scheduler.h"
+#include "orchestration/workload_generator.h"
+#include "core/engine_metrics.h"
+#include "web/server.h"
+#include "database/database_factory.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using Catch::Approx;
+
+TEST_CASE("EngineMetrics: Runs counted per thread and served at /metrics", "[orchestration][metrics]") {
+    using Counter = core::EngineMetrics::Counter;
+    auto& metrics = core::EngineMetrics::global();
+
+    WorkloadSpec spec;
+    spec.line_items = 50;
+    spec.drivers = 5;
+    spec.depth = 4;
+    spec.periods = 3;
+    spec.scenarios = 2;
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    const Workload workload = WorkloadGenerator(spec).generate(*db);
+
+    const auto before = metrics.snapshot();
+    {
+        // Each scenario on a scheduler worker with its own runner (and shard)
+        TaskScheduler scheduler(2);
+        std::vector<std::unique_ptr<PeriodRunner>> runners;
+        for (size_t w = 0; w < scheduler.size(); ++w) {
+            runners.push_back(std::make_unique<PeriodRunner>(db));
+        }
+        for (ScenarioID scenario : workload.scenario_ids) {
+            scheduler.submit([&, scenario](size_t worker) {
+                runners[worker]->run_periods(workload.leaf_entities.front(), scenario, workload.period_ids,
+                                             workload.opening, workload.template_code);
+            });
+        }
+        scheduler.wait();
+    }
+    const auto after = metrics.snapshot();
+
+    auto delta = [&](Counter c) { return after[c] - before[c]; };
+    CHECK(delta(Counter::SCENARIOS) == 2);
+    CHECK(delta(Counter::PERIODS) == 6);
+    CHECK(delta(Counter::LINE_ITEMS) == 6 * spec.line_items);
+    CHECK(after.calculations() - before.calculations() == 6);
+    CHECK(delta(Counter::CALCULATE_NANOSECONDS) > 0);
+    CHECK(delta(Counter::DB_NANOSECONDS) > 0);
+    CHECK(delta(Counter::STATEMENT_CACHE_HITS) > 0);
+    CHECK(delta(Counter::TEMPLATE_CACHE_HITS) + delta(Counter::TEMPLATE_CACHE_MISSES) > 0);
+    CHECK(delta(Counter::TASKS_QUEUED) == 2);
+    CHECK(delta(Counter::TASKS_STARTED) == 2);
+    // The scheduler's workers exited: their shards were folded in, not lost
+    CHECK(delta(Counter::WORKERS_STARTED) == 2);
+    CHECK(delta(Counter::WORKERS_STOPPED) == 2);
+    CHECK(after.first_calculate_seconds > 0.0);
+    CHECK(after.first_calculate_seconds <= after.uptime_seconds);
+
+    // Quantiles from the latency histogram: 90 fast calculations, 10 slow ones
+    core::EngineMetrics::Snapshot latencies;
+    latencies.latency[core::EngineMetrics::latency_bucket(1000)] = 90;
+    latencies.latency[core::EngineMetrics::latency_bucket(1000000)] = 10;
+    CHECK(latencies.latency_quantile(0.5) == Catch::Approx(1e-6).epsilon(0.07));
+    CHECK(latencies.latency_quantile(0.95) == Catch::Approx(1e-3).epsilon(0.07));
+    CHECK(core::EngineMetrics::latency_bucket(UINT64_MAX) == core::EngineMetrics::LATENCY_BUCKETS - 1);
+
+    web::Server server(0, "127.0.0.1");
+    auto response = server.handle("GET", "/metrics");
+    CHECK(response.status == 200);
+    CHECK(response.body.find("finmodel_periods_total ") != std::string::npos);
+    CHECK(response.body.find("finmodel_calculate_latency_seconds{quantile=\"0.99\"}") != std::string::npos);
+    CHECK(response.body.find("finmodel_statement_cache_hit_ratio") != std::string::npos);
+    CHECK(server.handle("GET", "/nothing").status == 404);
+    CHECK(server.handle("POST", "/health").status == 405);
+
+    // Over a socket
+    server.start();
+    const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server.port());
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    const std::string request = "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    REQUIRE(::send(client, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+    std::string reply;
+    char buffer[1024];
+    for (ssize_t n; (n = ::recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+        reply.append(buffer, static_cast<size_t>(n));
+    }
+    ::close(client);
+    server.stop();
+    CHECK(reply.rfind("HTTP/1.1 200 OK", 0) == 0);
+    CHECK(reply.find("\"status\": \"ok\"") != std::string::npos);
+}
+
+TEST_CASE("Server: Connections are capped and requests have one deadline", "[orchestration][server]") {
+    web::Server server(0);
+    server.set_max_connections(1);
+    server.set_request_timeout(std::chrono::milliseconds(600));
+    CHECK_THROWS_AS(server.set_max_connections(0), std::invalid_argument);
+    server.start();
+
+    auto connect = [&] {
+        const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server.port());
+        ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);   // The default address
+        REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        return client;
+    };
+    auto read_all = [](int client) {
+        std::string reply;
+        char buffer[1024];
+        for (ssize_t n; (n = ::recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+            reply.append(buffer, static_cast<size_t>(n));
+        }
+        ::close(client);
+        return reply;
+    };
+
+    // A client sending a byte at a time doesn't extend its deadline; while it
+    // holds the only connection, others are refused
+    const auto started = std::chrono::steady_clock::now();
+    const int slow = connect();
+    const int refused = connect();
+    CHECK(read_all(refused).rfind("HTTP/1.1 503 Service Unavailable", 0) == 0);
+    const std::string request = "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    for (char c : request.substr(0, 10)) {
+        if (::send(slow, &c, 1, MSG_NOSIGNAL) != 1) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    CHECK(read_all(slow).rfind("HTTP/1.1 408 Request Timeout", 0) == 0);
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+
+    // The slot is free again
+    const int client = connect();
+    REQUIRE(::send(client, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size()));
+    CHECK(read_all(client).rfind("HTTP/1.1 200 OK", 0) == 0);
+    server.stop();
+}
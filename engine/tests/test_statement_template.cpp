@@ -9,6 +9,8 @@
 #include "database/database_factory.h"
 #include "database/idatabase.h"
 #include "database/result_set.h"
+#include <fstream>
+#include <sstream>
 
 using namespace finmodel;
 using namespace finmodel::core;
@@ -369,3 +371,178 @@ TEST_CASE("Load template with invalid JSON throws exception", "[template][error]
         std::runtime_error
     );
 }
+
+TEST_CASE("Calculation order is memoized per template content", "[template][json]") {
+    std::string json = R"({
+        "template_code": "MEMO_001",
+        "line_items": [
+            {"code": "TOTAL", "formula": "NET + GROSS[t-1]"},
+            {"code": "NET", "formula": "MAX(GROSS, 0) * 0.75"},
+            {"code": "GROSS", "formula": null}
+        ]
+    })";
+
+    auto tmpl = StatementTemplate::load_from_json(json);
+    tmpl->compute_calculation_order();
+    std::vector<std::string> expected = {"GROSS", "NET", "TOTAL"};
+    REQUIRE(tmpl->get_calculation_order() == expected);
+    REQUIRE(tmpl->get_formula_dependencies("TOTAL") == std::vector<std::string>{"GROSS[t-1]", "NET"});
+    REQUIRE(tmpl->get_formula_dependencies("NET") == std::vector<std::string>{"GROSS"});
+
+    SECTION("Re-loaded template reuses the cached order") {
+        auto reloaded = StatementTemplate::load_from_json(json);
+        REQUIRE(reloaded->content_hash() == tmpl->content_hash());
+        reloaded->compute_calculation_order();
+        REQUIRE(reloaded->get_calculation_order() == expected);
+        REQUIRE(reloaded->get_formula_dependencies("NET") == std::vector<std::string>{"GROSS"});
+    }
+
+    SECTION("Formula updates invalidate the order") {
+        const size_t before = tmpl->content_hash();
+        REQUIRE(tmpl->update_line_item_formula("GROSS", "EXTERNAL * 2"));
+        REQUIRE(tmpl->content_hash() != before);
+        REQUIRE(tmpl->get_formula_dependencies("GROSS") == std::vector<std::string>{"EXTERNAL"});
+
+        REQUIRE(tmpl->update_line_item_formula("NET", "1"));
+        REQUIRE(tmpl->get_formula_dependencies("NET").empty());
+        REQUIRE(tmpl->get_calculation_order().back() == "TOTAL");
+    }
+
+    SECTION("Circular update is rolled back") {
+        REQUIRE_THROWS(tmpl->update_line_item_formula("GROSS", "TOTAL * 2"));
+        REQUIRE_FALSE(tmpl->get_line_item("GROSS")->formula.has_value());
+        REQUIRE(tmpl->get_formula_dependencies("GROSS").empty());
+    }
+}
+
+TEST_CASE("Cached templates are shared until saved", "[template][json]") {
+    auto make_db = [] {
+        auto db = DatabaseFactory::create_sqlite(":memory:");
+        db->execute_raw(
+            "CREATE TABLE statement_template ("
+            "template_id INTEGER PRIMARY KEY AUTOINCREMENT, code TEXT UNIQUE NOT NULL, "
+            "statement_type TEXT, industry TEXT, version TEXT NOT NULL DEFAULT '1.0', "
+            "json_structure TEXT NOT NULL, is_active INTEGER NOT NULL DEFAULT 1, "
+            "created_at TEXT, updated_at TEXT)"
+        );
+        return db;
+    };
+    auto db = make_db();
+
+    auto tmpl = StatementTemplate::load_from_json(R"({
+        "template_code": "CACHE_001",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "NET", "formula": "GROSS * 0.75"},
+            {"code": "GROSS", "formula": null}
+        ]
+    })");
+    tmpl->save_to_database(db.get());
+
+    auto first = StatementTemplate::load_cached(db, "CACHE_001");
+    REQUIRE(first != nullptr);
+    REQUIRE(first->get_calculation_order() == std::vector<std::string>{"GROSS", "NET"});
+    REQUIRE(StatementTemplate::load_cached(db, "CACHE_001") == first);
+    REQUIRE(StatementTemplate::load_cached(db, "MISSING") == nullptr);
+
+    SECTION("Saving replaces the cached template") {
+        REQUIRE(tmpl->update_line_item_formula("NET", "GROSS * 0.5"));
+        tmpl->save_to_database(db.get());
+
+        auto second = StatementTemplate::load_cached(db, "CACHE_001");
+        REQUIRE(second != first);
+        REQUIRE(*second->get_line_item("NET")->formula == "GROSS * 0.5");
+        REQUIRE(*first->get_line_item("NET")->formula == "GROSS * 0.75");
+    }
+
+    SECTION("Another database gets its own entry") {
+        auto other = make_db();
+        REQUIRE(StatementTemplate::load_cached(other, "CACHE_001") == nullptr);
+        tmpl->save_to_database(other.get());
+        auto copy = StatementTemplate::load_cached(other, "CACHE_001");
+        REQUIRE(copy != nullptr);
+        REQUIRE(copy != first);
+    }
+
+    StatementTemplate::clear_cache();
+}
+
+TEST_CASE("Saved templates load from their compiled form", "[template][binary]") {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE statement_template ("
+        "template_id INTEGER PRIMARY KEY AUTOINCREMENT, code TEXT UNIQUE NOT NULL, "
+        "statement_type TEXT, industry TEXT, version TEXT NOT NULL DEFAULT '1.0', "
+        "json_structure TEXT NOT NULL, is_active INTEGER NOT NULL DEFAULT 1, "
+        "created_at TEXT, updated_at TEXT)"
+    );
+    std::ifstream migration("../data/migrations/015_template_binary.sql");
+    REQUIRE(migration.good());
+    std::stringstream sql;
+    sql << migration.rdbuf();
+    db->execute_raw(sql.str());
+
+    auto tmpl = StatementTemplate::load_from_json(R"({
+        "template_code": "BINARY_001",
+        "template_name": "Compiled",
+        "statement_type": "unified",
+        "version": "2.1",
+        "line_items": [
+            {"code": "TOTAL", "formula": "NET + GROSS[t-1]", "sign_convention": "positive"},
+            {"code": "NET", "formula": "GROSS * 0.75", "category": "subtotal", "level": 2},
+            {"code": "GROSS", "base_value_source": "driver:GROSS", "driver_applicable": true,
+             "dependencies": ["TOTAL"]}
+        ],
+        "time_scaling": {"basis_days": 360, "flow_drivers": ["GROSS"], "stocks": ["TOTAL"]},
+        "validation_rules": [{"rule_id": "R1", "rule": "TOTAL > 0", "severity": "warning", "message": "m"}]
+    })");
+    tmpl->save_to_database(db.get());
+
+    auto stored = db->execute_query("SELECT compiled_structure FROM statement_template WHERE code = 'BINARY_001'", {});
+    REQUIRE(stored->next());
+    REQUIRE_FALSE(stored->is_null(0));
+    stored.reset();
+
+    // Dependencies come with the blob: no compute_calculation_order() yet
+    auto loaded = StatementTemplate::load_from_database(db.get(), "BINARY_001");
+    REQUIRE(loaded != nullptr);
+    REQUIRE(loaded->get_formula_dependencies("NET") == std::vector<std::string>{"GROSS"});
+    REQUIRE(loaded->get_calculation_order() == std::vector<std::string>{"GROSS", "NET", "TOTAL"});
+    REQUIRE(loaded->to_json() == tmpl->to_json());
+    REQUIRE(loaded->content_hash() == tmpl->content_hash());
+    REQUIRE(loaded->get_time_scaling().basis_days == 360.0);
+    REQUIRE(loaded->get_line_item("TOTAL")->sign_convention == SignConvention::POSITIVE);
+    REQUIRE(loaded->get_line_item("GROSS")->dependencies == std::vector<std::string>{"TOTAL"});
+
+    SECTION("Blobs of other JSON or damaged ones are refused") {
+        const auto blob = tmpl->to_binary();
+        REQUIRE(StatementTemplate::load_from_binary(blob, tmpl->to_json()) != nullptr);
+        REQUIRE(StatementTemplate::load_from_binary(blob, tmpl->to_json() + " ") == nullptr);
+
+        auto damaged = blob;
+        damaged[damaged.size() / 2] ^= 0x01;
+        REQUIRE(StatementTemplate::load_from_binary(damaged, tmpl->to_json()) == nullptr);
+        REQUIRE(StatementTemplate::load_from_binary({}, tmpl->to_json()) == nullptr);
+    }
+
+    SECTION("JSON edited in place is parsed") {
+        db->execute_update(
+            "UPDATE statement_template SET json_structure = json_set(json_structure, '$.line_items[1].formula', "
+            "'GROSS * 0.5') WHERE code = 'BINARY_001'", {});
+        auto edited = StatementTemplate::load_from_database(db.get(), "BINARY_001");
+        REQUIRE(edited != nullptr);
+        REQUIRE(*edited->get_line_item("NET")->formula == "GROSS * 0.5");
+        REQUIRE(edited->get_formula_dependencies("NET").empty());  // Parsed: not computed yet
+    }
+
+    SECTION("Circular templates keep reporting the cycle") {
+        auto circular = StatementTemplate::load_from_json(R"({
+            "template_code": "BINARY_002",
+            "line_items": [{"code": "A", "formula": "B"}, {"code": "B", "formula": "A"}]
+        })");
+        auto reloaded = StatementTemplate::load_from_binary(circular->to_binary(), circular->to_json());
+        REQUIRE(reloaded != nullptr);
+        REQUIRE_THROWS_AS(reloaded->compute_calculation_order(), std::runtime_error);
+    }
+}
@@ -0,0 +1,582 @@
+/**
+ * @file test_stochastic_runner.cpp
+ * @brief Tests for Monte Carlo runs over scenario lanes
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/stochastic_runner.h"
+#include "core/low_discrepancy.h"
+#include "core/quantile_sketch.h"
+#include "core/statement_template.h"
+#include "test_databases.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("StochasticRunner: Sampled drivers kept as statistics per period", "[orchestration][stochastic]") {
+    auto db = create_incremental_db();
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    SECTION("Drivers without spread give the deterministic run") {
+        PeriodRunner period_runner(db);
+        auto expected = period_runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(expected.success);
+
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 0.0},
+                                     {"COSTS", DriverDistribution::LOGNORMAL, 600.0, 0.0}});
+        StochasticOptions options;
+        options.paths = 50;
+        options.lanes = 16;
+        auto stats = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(stats.success);
+        CHECK(stats.paths == 50);
+        for (size_t p = 0; p < periods.size(); ++p) {
+            for (const auto& [code, value] : expected.results[p].get_all_values()) {
+                const auto* dist = stats.get(code, periods[p]);
+                REQUIRE(dist);
+                CHECK(dist->count == 50);
+                CHECK(dist->mean() == Approx(value));
+                CHECK(dist->variance() == Approx(0.0).margin(1e-9));
+                CHECK(dist->quantile(0.9) == Approx(value).epsilon(0.01));
+            }
+        }
+    }
+
+    SECTION("Correlated drivers, in any batch size") {
+        Eigen::MatrixXd correlation(2, 2);
+        correlation << 1.0, 0.5,
+                       0.5, 1.0;
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::LOGNORMAL, 1000.0, 100.0},
+                                     {"COSTS", DriverDistribution::NORMAL, 600.0, 50.0}}, correlation);
+        StochasticOptions options;
+        options.paths = 20000;
+        options.lanes = 1000;
+        auto stats = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(stats.success);
+
+        // GROSS = REVENUE - COSTS: variance 100² + 50² - 2 × 0.5 × 100 × 50
+        const auto* gross = stats.get("GROSS", 2);
+        REQUIRE(gross);
+        CHECK(gross->mean() == Approx(400.0).epsilon(0.01));
+        CHECK(gross->variance() == Approx(7500.0).epsilon(0.05));
+        CHECK(stats.get("REVENUE", 1)->quantile(0.01) > 0.0);
+        CHECK(stats.get("CASH", 3)->mean() == Approx(100.0 + 3 * 300.0).epsilon(0.01));
+        CHECK(stats.get("NET", 3)->quantile(0.5) == Approx(300.0).epsilon(0.02));
+
+        // Each path has its own stream: the batch size changes nothing
+        options.lanes = 333;
+        auto rebatched = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        for (const char* code : {"GROSS", "CASH"}) {
+            const auto* a = stats.get(code, 3);
+            const auto* b = rebatched.get(code, 3);
+            CHECK(b->mean() == a->mean());
+            CHECK(b->variance() == a->variance());
+            CHECK(b->quantile(0.05) == a->quantile(0.05));
+            CHECK(b->quantile(0.99) == a->quantile(0.99));
+        }
+
+        options.line_items = {"CASH"};
+        CHECK(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options).line_items.size() == 1);
+    }
+
+    SECTION("Paths end at the stop condition") {
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 100.0}});
+        StochasticOptions options;
+        options.paths = 4000;
+        options.lanes = 1000;
+        options.stop_condition = "REVENUE < 1000";
+        auto stats = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(stats.success);
+        CHECK(stats.paths == 4000);
+        REQUIRE(stats.stopped_paths.size() == periods.size());
+
+        // About half the running paths stop each period; later periods count the others
+        size_t running = 4000;
+        for (size_t p = 0; p < periods.size(); ++p) {
+            const auto* revenue = stats.get("REVENUE", periods[p]);
+            REQUIRE(revenue);
+            CHECK(revenue->count == running);
+            CHECK(stats.stopped_paths[p] == Approx(running / 2.0).epsilon(0.1));
+            running -= stats.stopped_paths[p];
+        }
+        CHECK(stats.get("REVENUE", 1)->mean() == Approx(1000.0).epsilon(0.01));
+
+        // Smaller batches are compacted at other periods: the same paths stop
+        options.lanes = 64;
+        auto compacted = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        CHECK(compacted.stopped_paths == stats.stopped_paths);
+        for (const char* code : {"REVENUE", "CASH"}) {
+            const auto* a = stats.get(code, 3);
+            const auto* b = compacted.get(code, 3);
+            CHECK(b->count == a->count);
+            CHECK(b->mean() == a->mean());
+        }
+
+        // Every path stops in period 1
+        options.stop_condition = "REVENUE > 0";
+        auto all = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        CHECK(all.stopped_paths[0] == 4000);
+        CHECK(all.get("CASH", 2)->count == 0);
+
+        // Conditions on missing line items are never met
+        options.stop_condition = "MISSING > 0";
+        CHECK(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options).get("CASH", 3)->count == 4000);
+        options.stop_condition = "REVENUE >";
+        CHECK_THROWS_AS(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options), std::invalid_argument);
+    }
+
+    SECTION("Lane kernels give the interpreter's paths") {
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::LOGNORMAL, 1000.0, 100.0},
+                                     {"COSTS", DriverDistribution::NORMAL, 600.0, 50.0}});
+        StochasticOptions options;
+        options.paths = 2000;
+        options.lanes = 500;
+        auto interpreted = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(interpreted.success);
+        CHECK(runner.engine().last_lane_backend() == unified::LaneBackend::INTERPRETER);
+
+        const auto cache_dir = std::filesystem::temp_directory_path() / "finmodel_lane_kernels_test";
+        options.lane_kernels.enabled = true;
+        options.lane_kernels.cache_dir = cache_dir.string();
+        auto compiled = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(compiled.success);
+        CHECK(runner.engine().last_lane_backend() == unified::LaneBackend::HOST_KERNEL);
+        for (const char* code : {"GROSS", "NET", "CASH"}) {
+            for (PeriodID period : periods) {
+                const auto* a = interpreted.get(code, period);
+                const auto* b = compiled.get(code, period);
+                CHECK(b->mean() == a->mean());
+                CHECK(b->variance() == a->variance());
+                CHECK(b->quantile(0.05) == a->quantile(0.05));
+            }
+        }
+
+        // No CUDA toolchain: the interpreter takes over with the same paths
+        options.lane_kernels.device = core::LaneDevice::CUDA;
+        options.lane_kernels.device_compiler = "finmodel-no-such-nvcc";
+        auto fallback = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(fallback.success);
+        CHECK(runner.engine().last_lane_backend() == unified::LaneBackend::INTERPRETER);
+        CHECK(fallback.get("CASH", 3)->mean() == interpreted.get("CASH", 3)->mean());
+        std::filesystem::remove_all(cache_dir);
+    }
+
+    SECTION("Failed batches and bad settings") {
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 10.0}});
+        StochasticOptions options;
+        options.paths = 10;
+        options.lanes = 4;
+        auto failed = runner.run("E", 1, periods, initial_bs, "MISSING_TEMPLATE", options);
+        CHECK_FALSE(failed.success);
+        CHECK(failed.paths == 0);
+        CHECK(failed.failed_paths == 10);
+        REQUIRE(failed.errors.size() == 1);
+        CHECK(failed.errors[0] == "Period 1: Failed to load unified template: MISSING_TEMPLATE");
+
+        // Batches failing in period 2 leave no paths in period 1's statistics either
+        core::StatementTemplate::load_from_json(R"json({
+            "template_code": "LATE_FAILURE_TEST",
+            "statement_type": "unified",
+            "version": "1.0",
+            "line_items": [
+                {"code": "REVENUE", "base_value_source": "driver:REVENUE"},
+                {"code": "LATE", "base_value_source": "driver:LATE"},
+                {"code": "GUARD", "formula": "IF(LATE > 0, 1 / (REVENUE > 1000), 0)"},
+                {"code": "CASH", "formula": "CASH[t-1] + REVENUE"}
+            ]
+        })json")->save_to_database(db.get());
+        db->execute_raw(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, 1, 'LATE', 0.0, 'EUR'), ('E', 1, 2, 'LATE', 1.0, 'EUR'), ('E', 1, 3, 'LATE', 1.0, 'EUR')");
+        StochasticRunner late(db, {{"REVENUE", DriverDistribution::NORMAL, 1100.0, 100.0}});
+        options.paths = 40;
+        options.lanes = 2;
+        auto partial = late.run("E", 1, periods, initial_bs, "LATE_FAILURE_TEST", options);
+        CHECK_FALSE(partial.success);
+        CHECK(partial.failed_paths > 0);
+        CHECK(partial.paths > 0);
+        CHECK(partial.paths + partial.failed_paths == 40);
+        for (PeriodID period : periods) {
+            const auto* revenue = partial.get("REVENUE", period);
+            REQUIRE(revenue);
+            CHECK(revenue->count == partial.paths);
+            CHECK((period == 1 || revenue->min > 1000.0));
+        }
+
+        options.lanes = 0;
+        CHECK_THROWS_AS(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options), std::invalid_argument);
+        Eigen::MatrixXd not_definite(2, 2);
+        not_definite << 1.0, 2.0,
+                        2.0, 1.0;
+        CHECK_THROWS_AS(StochasticRunner(db, {{"A", DriverDistribution::NORMAL, 0.0, 1.0},
+                                              {"B", DriverDistribution::NORMAL, 0.0, 1.0}}, not_definite),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(StochasticRunner(db, {{"A", DriverDistribution::LOGNORMAL, 0.0, 1.0}}),
+                        std::invalid_argument);
+    }
+
+    SECTION("Sketches order negative, zero and positive values") {
+        core::QuantileSketch sketch(0.01);
+        for (int v = -100; v <= 100; ++v) {
+            sketch.add(static_cast<double>(v));
+        }
+        CHECK(sketch.count() == 201);
+        CHECK(sketch.quantile(0.0) == Approx(-100.0).epsilon(0.01));
+        CHECK(sketch.quantile(0.5) == 0.0);
+        CHECK(sketch.quantile(0.25) == Approx(-50.0).epsilon(0.01));
+        CHECK(sketch.top_value(1) == Approx(100.0).epsilon(0.01));
+        CHECK(sketch.top_mean(201) == Approx(0.0).margin(0.5));
+    }
+}
+
+TEST_CASE("StochasticRunner: Conditional actions fire path by path", "[orchestration][stochastic][triggers]") {
+    SECTION("Lane triggers") {
+        std::vector<ActionTrigger> rows(3);
+        rows[0].action_code = "LOW";
+        rows[0].trigger_type = "CONDITIONAL";
+        rows[0].trigger_condition = "CASH < 500";
+        rows[0].start_period = 1;
+        rows[1].action_code = "HIGH";
+        rows[1].trigger_type = "CONDITIONAL";
+        rows[1].trigger_condition = "CASH > 800";
+        rows[1].start_period = 1;
+        rows[1].trigger_sticky = false;
+        rows[2].action_code = "PHASE";
+        rows[2].trigger_type = "UNCONDITIONAL";
+        rows[2].start_period = 2;
+        rows[2].end_period = 2;
+        LaneTriggers triggers(rows, 3);
+
+        unified::LaneResult prior;
+        prior.schema = std::make_shared<const unified::ResultSchema>(std::vector<std::string>{"CASH"});
+        prior.values = {(core::LaneArray(3) << 100.0, 900.0, 600.0).finished()};
+        triggers.evaluate(1, &prior);
+        CHECK(triggers.active(0, 0));
+        CHECK_FALSE(triggers.active(0, 1));
+        CHECK_FALSE(triggers.active(1, 1));   // Non-sticky: not in period 1
+        CHECK_FALSE(triggers.active(2, 0));
+        auto groups = triggers.groups();
+        REQUIRE(groups.size() == 2);
+        CHECK(groups[0].lanes == std::vector<size_t>{0});
+        CHECK(groups[0].triggers == std::vector<uint64_t>{1});
+        CHECK(groups[1].lanes == std::vector<size_t>{1, 2});
+
+        prior.values = {(core::LaneArray(3) << 600.0, 900.0, 400.0).finished()};
+        triggers.evaluate(2, &prior);
+        CHECK(triggers.active_lanes(0) == std::vector<uint64_t>{0b101});   // Lane 0 stays, lane 2 fires
+        CHECK(triggers.active_lanes(1) == std::vector<uint64_t>{0b010});
+        CHECK(triggers.active_lanes(2) == std::vector<uint64_t>{0b111});
+        groups = triggers.groups();
+        REQUIRE(groups.size() == 2);
+        CHECK(groups[0].lanes == std::vector<size_t>{0, 2});
+        CHECK(groups[0].triggers == std::vector<uint64_t>{0b101});
+        CHECK(groups[1].triggers == std::vector<uint64_t>{0b110});
+
+        triggers.reset();
+        prior.values = {(core::LaneArray(3) << 600.0, 600.0, 600.0).finished()};
+        triggers.evaluate(3, &prior);
+        CHECK(triggers.active_lanes(0) == std::vector<uint64_t>{0});
+
+        unified::LaneResult short_prior = prior;
+        short_prior.values = {core::LaneArray::Zero(2)};
+        CHECK_THROWS_AS(triggers.evaluate(4, &short_prior), std::invalid_argument);
+    }
+
+    auto db = create_incremental_db();
+    db->execute_raw(
+        "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX'), ('SIDE', 'Side business', 'OTHER');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, end_period, "
+        "  financial_transformations) "
+        "VALUES (1, 'CUT', 'UNCONDITIONAL', 3, NULL, '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}]');"
+        "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, trigger_condition, start_period, "
+        "  trigger_sticky, financial_transformations) "
+        "VALUES (1, 'SIDE', 'CONDITIONAL', 'CASH > 400', 2, 1, "
+        "  '[{\"line_item\": \"OTHER_SCALED\", \"type\": \"add\", \"amount\": 1000}]');"
+    );
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+
+    SECTION("Without spread every path is the scenario's run") {
+        PeriodRunner period_runner(db);
+        auto expected = period_runner.run_periods("E", 1, periods, initial_bs, "INCREMENTAL_TEST");
+        REQUIRE(expected.success);
+        REQUIRE(expected.results[1].get_value("OTHER_SCALED") == Approx(10.0));     // CASH 400: not > 400
+        REQUIRE(expected.results[2].get_value("OTHER_SCALED") == Approx(1010.0));
+
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 0.0}});
+        StochasticOptions options;
+        options.paths = 20;
+        options.lanes = 8;
+        options.apply_actions = true;
+        auto stats = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(stats.success);
+        for (size_t p = 0; p < periods.size(); ++p) {
+            for (const std::string code : {"GROSS", "NET", "CASH", "OTHER_SCALED"}) {
+                const auto* dist = stats.get(code, periods[p]);
+                REQUIRE(dist);
+                CHECK(dist->mean() == Approx(expected.results[p].get_value(code)));
+                CHECK(dist->baseline == Approx(expected.results[p].get_value(code)));
+            }
+        }
+        CHECK(runner.engine().has_registered_template("INCREMENTAL_TEST+CUT+SIDE"));
+    }
+
+    SECTION("Paths fire where their own values meet the condition") {
+        // CASH after period 1 is 100 + 0.75 (REVENUE - 600): above 400 for half the paths
+        StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 200.0}});
+        StochasticOptions options;
+        options.paths = 2000;
+        options.lanes = 2000;
+        options.apply_actions = true;
+        auto one_batch = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(one_batch.success);
+        const auto* side = one_batch.get("OTHER_SCALED", 2);
+        REQUIRE(side);
+        CHECK(side->mean() == Approx(510.0).margin(60.0));
+        CHECK(side->min == Approx(10.0));
+        CHECK(side->max == Approx(1010.0));
+
+        // Sticky: period 3 keeps every path that fired in period 2
+        CHECK(one_batch.get("OTHER_SCALED", 3)->mean() >= side->mean());
+
+        // Each path draws from its own stream: batches don't change the paths
+        options.lanes = 64;
+        auto batched = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(batched.success);
+        for (PeriodID p : periods) {
+            for (const std::string code : {"CASH", "OTHER_SCALED", "GROSS"}) {
+                CHECK(batched.get(code, p)->mean() == Approx(one_batch.get(code, p)->mean()));
+            }
+        }
+
+        options.apply_actions = false;
+        auto ignored = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        CHECK(ignored.get("OTHER_SCALED", 2)->max == Approx(10.0));
+    }
+}
+
+TEST_CASE("StochasticRunner: Quasi-random paths, antithetic pairs and control variates", "[orchestration][stochastic]") {
+    auto db = create_incremental_db();
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    const std::vector<PeriodID> periods = {1, 2, 3};
+    StochasticRunner runner(db, {{"REVENUE", DriverDistribution::NORMAL, 1000.0, 100.0},
+                                 {"COSTS", DriverDistribution::NORMAL, 600.0, 50.0}});
+    StochasticOptions options;
+    options.paths = 4096;
+    options.lanes = 256;
+
+    SECTION("Sequences stratify every dimension") {
+        CHECK(core::normal_quantile(0.975) == Approx(1.959963984540054).epsilon(1e-14));
+        CHECK(core::normal_quantile(0.5) == Approx(0.0).margin(1e-15));
+        CHECK(core::normal_quantile(1e-10) == Approx(-6.361340902404056).epsilon(1e-12));
+
+        core::SobolSequence sobol(20, 7);
+        CHECK(sobol.coordinate(1, 1) == Approx(0.5));
+        CHECK(sobol.coordinate(2, 1) == Approx(0.75));
+        CHECK(sobol.coordinate(3, 1) == Approx(0.25));
+        const auto shift = sobol.scramble(3);
+        for (size_t dim = 0; dim < 20; ++dim) {
+            std::vector<int> bins(64, 0);
+            for (uint32_t i = 0; i < 64; ++i) {
+                ++bins[static_cast<size_t>(sobol.coordinate(i, dim, shift[dim]) * 64)];
+            }
+            CHECK(std::count(bins.begin(), bins.end(), 1) == 64);
+        }
+
+        core::HaltonSequence halton(5, 7);
+        CHECK(halton.coordinate(0, 0) == Approx(0.5));
+        CHECK(halton.coordinate(1, 0) == Approx(0.25));
+        for (size_t dim = 1; dim < 5; ++dim) {
+            const uint32_t bases[] = {2, 3, 5, 7, 11};
+            const uint32_t b = bases[dim] * bases[dim];
+            std::vector<int> bins(b, 0);
+            for (uint32_t i = 0; i < b; ++i) {
+                // Unrotated points sit on the left edges of the bins
+                ++bins[static_cast<size_t>(halton.coordinate(i, dim) * b + 1e-9)];
+            }
+            CHECK(std::count(bins.begin(), bins.end(), 1) == static_cast<long>(b));
+        }
+    }
+
+    SECTION("Estimates, baselines and standard errors") {
+        auto plain = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(plain.success);
+        CHECK(plain.batches == 16);
+        const auto* gross = plain.get("GROSS", 2);
+        CHECK(gross->baseline == Approx(400.0));
+        CHECK(plain.get("CASH", 3)->baseline == Approx(1000.0));
+        CHECK(gross->estimate == gross->mean());
+        CHECK(gross->standard_error == Approx(std::sqrt(gross->variance() / 4096.0)).epsilon(0.5));
+
+        // GROSS = REVENUE - COSTS is linear in the normals: pairs and controls remove all of its variance
+        options.antithetic = true;
+        auto antithetic = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        CHECK(antithetic.get("GROSS", 2)->estimate == Approx(400.0).epsilon(1e-12));
+        CHECK(antithetic.get("GROSS", 2)->standard_error == Approx(0.0).margin(1e-9));
+
+        options.antithetic = false;
+        options.control_variate = true;
+        auto controlled = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        for (const char* code : {"GROSS", "CASH"}) {
+            const auto* dist = controlled.get(code, 3);
+            CHECK(dist->mean() == plain.get(code, 3)->mean());
+            CHECK(dist->estimate == Approx(dist->baseline).epsilon(1e-9));
+            CHECK(dist->standard_error < 1e-6);
+        }
+
+        options.control_variate = false;
+        for (auto sampling : {SamplingMethod::SOBOL, SamplingMethod::HALTON}) {
+            options.sampling = sampling;
+            auto quasi = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+            REQUIRE(quasi.success);
+            const auto* dist = quasi.get("CASH", 3);
+            CHECK(dist->estimate == Approx(1000.0).epsilon(0.001));
+            CHECK(dist->standard_error < plain.get("CASH", 3)->standard_error / 4.0);
+            CHECK(dist->variance() == Approx(plain.get("CASH", 3)->variance()).epsilon(0.1));
+        }
+    }
+
+    SECTION("Early stop at the target error") {
+        options.paths = 1000000;
+        options.target_relative_error = 0.001;
+        options.convergence_line_items = {"GROSS"};
+        auto stats = runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options);
+        REQUIRE(stats.success);
+        CHECK(stats.converged);
+        CHECK(stats.paths == stats.batches * 256);
+        CHECK(stats.paths < options.paths);
+        for (PeriodID period : periods) {
+            CHECK(stats.get("GROSS", period)->relative_error() <= 0.001);
+        }
+
+        options.min_batches = 1;
+        CHECK_THROWS_AS(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options), std::invalid_argument);
+        options.min_batches = 4;
+        options.antithetic = true;
+        options.lanes = 255;
+        CHECK_THROWS_AS(runner.run("E", 1, periods, initial_bs, "INCREMENTAL_TEST", options), std::invalid_argument);
+    }
+}
+
+TEST_CASE("StochasticRunner: Sobol indices from streamed Saltelli designs", "[orchestration][stochastic][sensitivity]") {
+    auto db = create_runner_db();
+    core::StatementTemplate::load_from_json(R"json({
+        "template_code": "SENSITIVITY_TEST",
+        "statement_type": "unified",
+        "version": "1.0",
+        "line_items": [
+            {"code": "X", "base_value_source": "driver:X"},
+            {"code": "Y", "base_value_source": "driver:Y"},
+            {"code": "LINEAR", "formula": "X + 2 * Y"},
+            {"code": "PRODUCT", "formula": "X * Y"},
+            {"code": "TOTAL", "formula": "TOTAL[t-1] + LINEAR"}
+        ]
+    })json")->save_to_database(db.get());
+    const std::vector<PeriodID> periods = {1, 2};
+    for (PeriodID period : periods) {
+        db->execute_update(
+            "INSERT INTO scenario_drivers (entity_id, scenario_id, period_id, driver_code, value, unit_code) "
+            "VALUES ('E', 1, :period, 'X', 1.0, 'EUR'), ('E', 1, :period, 'Y', 1.0, 'EUR')",
+            {{"period", period}});
+    }
+    BalanceSheet initial_bs;
+    initial_bs.line_items["TOTAL"] = 0.0;
+
+    StochasticRunner runner(db, {{"X", DriverDistribution::NORMAL, 1.0, 1.0},
+                                 {"Y", DriverDistribution::NORMAL, 1.0, 1.0}});
+    SensitivityOptions options;
+    options.samples = 4096;
+    options.lanes = 1024;
+    options.outputs = {"LINEAR", "PRODUCT", "TOTAL"};
+
+    SECTION("Indices of additive and interacting outputs, in either design") {
+        for (auto design : {SensitivityDesign::LATIN_HYPERCUBE, SensitivityDesign::SOBOL}) {
+            options.design = design;
+            auto gsa = runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options);
+            REQUIRE(gsa.success);
+            CHECK(gsa.evaluations == 4096 * 4);
+            REQUIRE(gsa.driver_codes == std::vector<std::string>{"X", "Y"});
+
+            // X + 2Y: variances 1 and 4, no interaction
+            const auto* linear = gsa.get("LINEAR", 1);
+            REQUIRE(linear);
+            CHECK(linear->samples == 4096);
+            CHECK(linear->mean == Approx(3.0).margin(0.05));
+            CHECK(linear->variance == Approx(5.0).epsilon(0.05));
+            CHECK(linear->drivers[0].first_order == Approx(0.2).margin(0.03));
+            CHECK(linear->drivers[1].first_order == Approx(0.8).margin(0.03));
+            CHECK(linear->drivers[0].total == Approx(0.2).margin(0.03));
+            CHECK(linear->drivers[1].total == Approx(0.8).margin(0.03));
+
+            // XY with unit means and deviations: first order 1/3 each, total 2/3 each
+            const auto* product = gsa.get("PRODUCT", 2);
+            REQUIRE(product);
+            for (const auto& index : product->drivers) {
+                CHECK(index.first_order == Approx(1.0 / 3.0).margin(0.05));
+                CHECK(index.total == Approx(2.0 / 3.0).margin(0.05));
+            }
+
+            // Drivers are factors over all periods: TOTAL in period 2 sums both periods' draws
+            const auto* total = gsa.get("TOTAL", 2);
+            CHECK(total->variance == Approx(10.0).epsilon(0.05));
+            CHECK(total->drivers[1].first_order == Approx(0.8).margin(0.03));
+        }
+    }
+
+    SECTION("Batches only change rounding; bootstrap intervals") {
+        options.samples = 1000;
+        auto wide = runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options);
+        options.lanes = 36;
+        auto narrow = runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options);
+        const auto* a = wide.get("PRODUCT", 2);
+        const auto* b = narrow.get("PRODUCT", 2);
+        for (size_t i = 0; i < 2; ++i) {
+            CHECK(b->drivers[i].first_order == Approx(a->drivers[i].first_order).epsilon(1e-9));
+            CHECK(b->drivers[i].total == Approx(a->drivers[i].total).epsilon(1e-9));
+        }
+
+        options.bootstrap = 200;
+        auto bootstrapped = runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options);
+        const auto* product = bootstrapped.get("PRODUCT", 2);
+        for (const auto& index : product->drivers) {
+            CHECK(index.first_order_low < index.first_order);
+            CHECK(index.first_order < index.first_order_high);
+            CHECK(index.total_low < index.total);
+            CHECK(index.total < index.total_high);
+            CHECK(index.first_order_high - index.first_order_low < 0.5);
+        }
+        CHECK(product->drivers[0].first_order == b->drivers[0].first_order);
+    }
+
+    SECTION("Bad settings and missing outputs") {
+        options.samples = 16;
+        options.outputs = {"MISSING"};
+        auto missing = runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options);
+        CHECK_FALSE(missing.success);
+        REQUIRE_FALSE(missing.errors.empty());
+        CHECK(missing.get("MISSING", 1)->samples == 0);
+
+        options.outputs.clear();
+        CHECK_THROWS_AS(runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options),
+                        std::invalid_argument);
+        options.outputs = {"LINEAR"};
+        options.lanes = 3;
+        CHECK_THROWS_AS(runner.sensitivity("E", 1, periods, initial_bs, "SENSITIVITY_TEST", options),
+                        std::invalid_argument);
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * @file test_streaming_statistics.cpp
+ * @brief Tests for bit-reproducible streaming statistics
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "core/exact_sum.h"
+#include "core/streaming_statistics.h"
+#include <cmath>
+
+using namespace finmodel;
+using Catch::Approx;
+
+TEST_CASE("StreamingStatistics: Same bits for any order and split of the values", "[orchestration][aggregate]") {
+    core::ExactSum cancelled;
+    for (double x : {1e100, 1.0, -1e100, 1e-20}) {
+        cancelled.add(x);
+    }
+    CHECK(cancelled.value() == 1.0);
+    core::ExactSum tenths;
+    for (int i = 0; i < 10; ++i) {
+        tenths.add(0.1);
+    }
+    CHECK(tenths.value() == 1.0);
+    core::ExactSum square;
+    square.add_product(1.0 + 0x1p-30, 1.0 + 0x1p-30);
+    square.add(-1.0);
+    CHECK(square.value() == 0x1p-29 + 0x1p-60);
+
+    // Values over a wide range of magnitudes, as a sweep's line items
+    std::vector<double> values;
+    uint64_t state = 42;
+    for (int i = 0; i < 5000; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const double u = static_cast<double>(state >> 11) * 0x1p-53;
+        values.push_back((u - 0.3) * std::pow(10.0, static_cast<double>(i % 9)));
+    }
+
+    core::StreamingStatistics sequential(0.01);
+    for (double x : values) {
+        sequential.add(x);
+    }
+    core::StreamingStatistics reversed(0.01);
+    for (auto it = values.rbegin(); it != values.rend(); ++it) {
+        reversed.add(*it);
+    }
+    core::StreamingStatistics batched(0.01);
+    for (size_t begin = 0; begin < values.size(); begin += 333) {
+        batched.add(values.data() + begin, std::min<size_t>(333, values.size() - begin));
+    }
+    // Uneven parts merged out of order, as worker aggregators
+    std::vector<core::StreamingStatistics> parts(7, core::StreamingStatistics(0.01));
+    for (size_t i = 0; i < values.size(); ++i) {
+        parts[(i * i) % parts.size()].add(values[i]);
+    }
+    core::StreamingStatistics merged(0.01);
+    for (size_t k : {3, 0, 6, 1, 5, 2, 4}) {
+        merged.merge(parts[k]);
+    }
+
+    for (const auto* stats : {&reversed, &batched, &merged}) {
+        CHECK(stats->count == values.size());
+        CHECK(stats->sum() == sequential.sum());
+        CHECK(stats->mean() == sequential.mean());
+        CHECK(stats->m2() == sequential.m2());
+        CHECK(stats->variance() == sequential.variance());
+        CHECK(stats->min == sequential.min);
+        CHECK(stats->max == sequential.max);
+        CHECK(stats->quantile(0.99) == sequential.quantile(0.99));
+    }
+
+    // The two-pass formula agrees to rounding
+    long double sum = 0.0L;
+    for (double x : values) {
+        sum += x;
+    }
+    const long double mean = sum / values.size();
+    long double m2 = 0.0L;
+    for (double x : values) {
+        m2 += (x - mean) * (x - mean);
+    }
+    CHECK(sequential.mean() == Approx(static_cast<double>(mean)).epsilon(1e-12));
+    CHECK(sequential.m2() == Approx(static_cast<double>(m2)).epsilon(1e-12));
+
+    // No cancellation for a large mean and a small spread
+    core::StreamingStatistics offset(0.01);
+    for (double x : {1e9 + 4.0, 1e9 + 7.0, 1e9 + 13.0, 1e9 + 16.0}) {
+        offset.add(x);
+    }
+    CHECK(offset.mean() == 1e9 + 10.0);
+    CHECK(offset.variance() == 30.0);
+    core::StreamingStatistics constant(0.01);
+    for (int i = 0; i < 10; ++i) {
+        constant.add(0.1);
+    }
+    CHECK(constant.variance() == 0.0);
+}
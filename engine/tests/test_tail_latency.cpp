@@ -0,0 +1,106 @@
+/**
+ * @file test_tail_latency.cpp
+ * @brief Tests for tail-latency run traces
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("TailLatencyTracker: Slow runs are kept with their traces", "[orchestration][tail_latency]") {
+    SECTION("Runs above the percentile of earlier runs") {
+        TailLatencyPolicy policy;
+        policy.percentile = 0.9;
+        policy.min_runs = 10;
+        policy.max_exemplars = 2;
+        TailLatencyTracker tracker(policy);
+        auto run = [&](ScenarioID scenario_id, double seconds) {
+            RunTrace trace;
+            trace.scenario_id = scenario_id;
+            trace.seconds = seconds;
+            trace.periods.push_back({1, "BASE", false, seconds, seconds, 10, 0});
+            return tracker.record(trace);
+        };
+        for (ScenarioID s = 1; s <= 10; ++s) {
+            CHECK_FALSE(run(s, 0.001));   // Too few runs before, then none slower
+        }
+        CHECK(run(11, 0.050));
+        CHECK(run(12, 0.020));
+        CHECK(run(13, 0.080));            // Replaces the fastest exemplar
+        CHECK_FALSE(run(14, 0.001));
+        CHECK(tracker.runs() == 14);
+        CHECK(tracker.run_quantile(0.5) == Approx(0.001).epsilon(0.02));
+        CHECK(tracker.period_quantile(1.0) == Approx(0.080).epsilon(0.02));
+
+        const auto exemplars = tracker.exemplars();
+        REQUIRE(exemplars.size() == 2);
+        CHECK(exemplars[0].scenario_id == 13);
+        CHECK(exemplars[1].scenario_id == 11);
+        CHECK(exemplars[0].reason == "p90");
+        CHECK(exemplars[0].evaluations() == 10);
+
+        tracker.clear();
+        CHECK(tracker.runs() == 0);
+        CHECK(tracker.exemplars().empty());
+        CHECK_THROWS_AS(TailLatencyTracker(TailLatencyPolicy{0.0}), std::invalid_argument);
+    }
+
+    SECTION("Exemplars are stored with their run") {
+        auto db = create_incremental_db();
+        auto results_db = DatabaseFactory::create_sqlite(":memory:");
+        results_db->execute_raw(
+            "CREATE TABLE run_log (run_id INTEGER PRIMARY KEY AUTOINCREMENT, scenario_id INTEGER NOT NULL, "
+            "  started_at TEXT NOT NULL DEFAULT (datetime('now')), completed_at TEXT, status TEXT NOT NULL, "
+            "  error_message TEXT, user TEXT, json_config TEXT NOT NULL DEFAULT '{}');"
+            "CREATE TABLE unified_result (run_id INTEGER NOT NULL, entity_id TEXT NOT NULL, "
+            "  scenario_id INTEGER NOT NULL, period_id INTEGER NOT NULL, line_item_code TEXT NOT NULL, value REAL);"
+        );
+        BalanceSheet initial_bs;
+        initial_bs.line_items["CASH"] = 100.0;
+
+        TailLatencyPolicy policy;
+        policy.percentile = 1.0;
+        policy.threshold_seconds = 1e-9;   // Every run
+        auto tracker = std::make_shared<TailLatencyTracker>(policy);
+        auto writer = std::make_shared<ResultWriter>(results_db);
+        PeriodRunner runner(db);
+        runner.set_result_writer(writer);
+        runner.set_tail_latency(tracker);
+        REQUIRE(runner.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST").success);
+        writer->flush();
+        CHECK(writer->stats().exemplars == 1);
+
+        auto stored = results_db->execute_query(
+            "SELECT json_extract(json_config, '$.exemplar.reason'), "
+            "       json_array_length(json_config, '$.exemplar.periods'), "
+            "       json_extract(json_config, '$.exemplar.periods[0].template'), "
+            "       json_extract(json_config, '$.exemplar.evaluations'), "
+            "       json_extract(json_config, '$.periods') FROM run_log", {});
+        REQUIRE(stored->next());
+        CHECK(stored->get_string(0) == "threshold");
+        CHECK(stored->get_int(1) == 3);
+        CHECK(stored->get_string(2) == "INCREMENTAL_TEST");
+        CHECK(stored->get_int(3) > 0);
+        CHECK(stored->get_int(4) == 3);   // The run's configuration is kept
+
+        const auto exemplars = tracker->exemplars();
+        REQUIRE(exemplars.size() == 1);
+        CHECK(exemplars[0].templates_created() == 0);
+        CHECK(exemplars[0].periods[2].period_id == 3);
+
+        // Without a reason the run's row has no trace
+        runner.set_tail_latency(std::make_shared<TailLatencyTracker>());
+        REQUIRE(runner.run_periods("E", 1, {1}, initial_bs, "INCREMENTAL_TEST").success);
+        writer->flush();
+        CHECK(writer->stats().exemplars == 1);
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * @file test_task_scheduler.cpp
+ * @brief Tests for the work-stealing task scheduler and its NUMA placement
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/task_scheduler.h"
+#include "core/numa_topology.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+
+TEST_CASE("TaskScheduler: Idle workers steal queued tasks", "[orchestration][scheduler]") {
+    TaskScheduler scheduler(4);
+    REQUIRE(scheduler.size() == 4);
+
+    SECTION("Subtasks of one task spread over all workers") {
+        std::vector<int> done(64, 0);
+        std::vector<std::atomic<int>> per_worker(scheduler.size());
+        scheduler.submit([&](size_t) {
+            // All 64 land on this worker's deque; the others steal them
+            for (size_t i = 0; i < done.size(); ++i) {
+                scheduler.submit([&, i](size_t worker) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    done[i] = 1;
+                    ++per_worker[worker];
+                });
+            }
+        });
+        scheduler.wait();
+
+        CHECK(std::accumulate(done.begin(), done.end(), 0) == 64);
+        CHECK(scheduler.stats().executed == 65);
+        CHECK(scheduler.stats().stolen > 0);
+        size_t busy_workers = 0;
+        for (const auto& count : per_worker) {
+            busy_workers += (count > 0) ? 1 : 0;
+        }
+        CHECK(busy_workers > 1);
+    }
+
+    SECTION("Errors surface on wait() after all tasks ran") {
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 10; ++i) {
+            scheduler.submit([&, i](size_t) {
+                ++ran;
+                if (i == 3) {
+                    throw std::runtime_error("job failed");
+                }
+            });
+        }
+        CHECK_THROWS_AS(scheduler.wait(), std::runtime_error);
+        CHECK(ran == 10);
+        CHECK_NOTHROW(scheduler.wait());
+
+        bool nested_wait_rejected = false;
+        scheduler.submit([&](size_t) {
+            try {
+                scheduler.wait();
+            } catch (const std::logic_error&) {
+                nested_wait_rejected = true;
+            }
+        });
+        scheduler.wait();
+        CHECK(nested_wait_rejected);
+    }
+}
+
+TEST_CASE("TaskScheduler: Workers placed by NUMA node", "[orchestration][scheduler][numa]") {
+    namespace fs = std::filesystem;
+
+    SECTION("Nodes are read from sysfs") {
+        CHECK(core::NumaTopology::parse_cpu_list("0-3,8,10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+        CHECK_THROWS_AS(core::NumaTopology::parse_cpu_list("0-"), std::invalid_argument);
+        CHECK_THROWS_AS(core::NumaTopology::parse_cpu_list("3-1"), std::invalid_argument);
+
+        const fs::path root = fs::temp_directory_path() / "finmodel_numa_test";
+        fs::remove_all(root);
+        for (auto [node, cpus] : {std::pair{"node1", "4-7"}, std::pair{"node0", "0-3"}, std::pair{"nodex", "9"}}) {
+            fs::create_directories(root / node);
+            std::ofstream(root / node / "cpulist") << cpus << "\n";
+        }
+        fs::create_directories(root / "node2");   // Memory-only node: no CPUs
+        auto topology = core::NumaTopology::read(root.string());
+        REQUIRE(topology.node_count() == 2);
+        CHECK(topology.nodes()[0].id == 0);
+        CHECK(topology.nodes()[1].cpus == std::vector<int>{4, 5, 6, 7});
+        fs::remove_all(root);
+
+        // Nothing readable: one node of every CPU
+        auto fallback = core::NumaTopology::read((root / "missing").string());
+        CHECK(fallback.node_count() == 1);
+        CHECK_FALSE(fallback.nodes()[0].cpus.empty());
+        CHECK(core::NumaTopology::system().node_count() >= 1);
+    }
+
+    SECTION("Workers fill nodes in proportion to their CPUs") {
+        core::NumaTopology topology({{0, {0, 1}}, {1, {2, 3, 4, 5}}});
+        CHECK(topology.place(6) == std::vector<size_t>{0, 0, 1, 1, 1, 1});
+        CHECK(topology.place(3) == std::vector<size_t>{0, 1, 1});
+        CHECK(topology.place(1) == std::vector<size_t>{0});
+    }
+
+    SECTION("Stealing prefers workers of the same node") {
+        core::NumaTopology topology({{0, {0, 1}}, {1, {2, 3}}});
+        TaskScheduler scheduler(4, topology, false);
+        REQUIRE(scheduler.node_count() == 2);
+        CHECK(scheduler.node_of(1) == 0);
+        CHECK(scheduler.node_of(2) == 1);
+        CHECK(scheduler.node_of(3) == 1);
+
+        std::vector<int> done(64, 0);
+        scheduler.submit([&](size_t) {
+            for (size_t i = 0; i < done.size(); ++i) {
+                scheduler.submit([&, i](size_t) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    done[i] = 1;
+                });
+            }
+        });
+        scheduler.wait();
+        CHECK(std::accumulate(done.begin(), done.end(), 0) == 64);
+        const auto stats = scheduler.stats();
+        CHECK(stats.executed == 65);
+        CHECK(stats.stolen_remote <= stats.stolen);
+        CHECK_THROWS_AS(TaskScheduler(0, topology, false), std::invalid_argument);
+    }
+}
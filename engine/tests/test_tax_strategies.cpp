@@ -11,6 +11,7 @@
 #include "pl/tax_strategies/progressive_strategy.h"
 #include "pl/tax_strategies/minimum_tax_strategy.h"
 #include "database/connection.h"
+#include <algorithm>
 
 using namespace finmodel;
 using namespace finmodel::pl;
@@ -403,3 +404,62 @@ TEST_CASE("TaxEngine - Effective rate", "[tax][engine]") {
         REQUIRE_THAT(rate, WithinAbs(0.0, 1e-9));
     }
 }
+
+TEST_CASE("TaxEngine - Resolved strategies and batches", "[tax][engine]") {
+    database::DatabaseConnection db(":memory:");
+    TaxEngine engine(db);
+    Context ctx(1, 1, 1);
+    std::map<std::string, double> params;
+
+    SECTION("Flattened brackets match filling them one by one") {
+        // First threshold above zero: income still fills it from the first unit
+        std::vector<ProgressiveTaxStrategy::Bracket> brackets = {
+            {10000, 0.05}, {20000, 0.15}, {45000, 0.25}, {90000, 0.40}
+        };
+        ProgressiveTaxStrategy strategy(brackets);
+        auto reference = [&](double income) {
+            double tax = 0.0;
+            for (size_t i = 0; i < brackets.size() && income > 0.0; ++i) {
+                const double size = i + 1 < brackets.size()
+                    ? brackets[i + 1].threshold - brackets[i].threshold : income;
+                tax += std::min(income, size) * brackets[i].rate;
+                income -= std::min(income, size);
+            }
+            return tax;
+        };
+        std::vector<double> incomes = {-5000.0, 0.0, 1.0, 9999.0, 10000.0, 10001.0, 35000.0,
+                                       80000.0, 80000.5, 1.0e7};
+        std::vector<double> taxes(incomes.size());
+        strategy.calculate_tax_batch(incomes, taxes, ctx, params);
+        for (size_t i = 0; i < incomes.size(); ++i) {
+            REQUIRE_THAT(strategy.calculate_tax(incomes[i], ctx, params), WithinAbs(reference(incomes[i]), 1e-6));
+            REQUIRE(taxes[i] == strategy.calculate_tax(incomes[i], ctx, params));
+        }
+        std::vector<double> too_small(2);
+        REQUIRE_THROWS_AS(strategy.calculate_tax_batch(incomes, too_small, ctx, params), std::invalid_argument);
+    }
+
+    SECTION("Handles survive registering a strategy again") {
+        TaxStrategyHandle progressive = engine.resolve("US_PROGRESSIVE");
+        std::vector<double> incomes = {-1.0, 50000.0, 150000.0};
+        std::vector<double> taxes(3);
+        engine.compute_tax(progressive, incomes, taxes, ctx);
+        REQUIRE(taxes == std::vector<double>{0.0, 5000.0, 22000.0});
+
+        TaxStrategyHandle federal = engine.resolve("US_FEDERAL");
+        engine.register_strategy("US_FEDERAL", std::make_unique<FlatRateTaxStrategy>(0.25));
+        REQUIRE(engine.resolve("US_FEDERAL") == federal);
+        REQUIRE_THAT(engine.compute_tax(federal, 100000.0, ctx), WithinAbs(25000.0, 1e-9));
+        REQUIRE_THROWS_AS(engine.resolve("NONEXISTENT"), std::runtime_error);
+    }
+
+    SECTION("Formulas bind their TAX_COMPUTE calls once") {
+        FormulaEvaluator evaluator;
+        auto compiled = evaluator.compile("TAX_COMPUTE(150000, \"US_PROGRESSIVE\") + TAX_COMPUTE(100, \"HIGH_TAX\")");
+        auto handler = engine.bind(*compiled);
+        REQUIRE_THAT(evaluator.evaluate(*compiled, {}, ctx, handler), WithinAbs(22035.0, 1e-9));
+
+        auto unknown = evaluator.compile("TAX_COMPUTE(100, \"NONEXISTENT\")");
+        REQUIRE_THROWS_AS(engine.bind(*unknown), std::runtime_error);
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * @file test_template_cost.cpp
+ * @brief Tests for static template cost analysis
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/template_cost.h"
+#include "web/server.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+
+TEST_CASE("TemplateCostAnalyzer: Static cost of formulas and action overlays", "[orchestration][template_cost]") {
+    SECTION("Ops, branches, fan-in/out, depth and far references") {
+        auto tmpl = core::StatementTemplate::load_from_json(R"json({
+            "template_code": "COST_TEST",
+            "statement_type": "unified",
+            "version": "1.0",
+            "line_items": [
+                {"code": "SALES", "base_value_source": "driver:SALES"},
+                {"code": "COGS", "formula": "SALES * 0.6"},
+                {"code": "GROSS", "formula": "SALES - COGS"},
+                {"code": "BONUS", "formula": "IF(GROSS > 100, GROSS * 0.1, IF(GROSS > 50, 5, 0))"},
+                {"code": "TREND", "formula": "SALES[t-13] + SALES[t-2] + SALES[t-24]"},
+                {"code": "LOOP_A", "formula": "LOOP_B + 1"},
+                {"code": "LOOP_B", "formula": "LOOP_A * 2"},
+                {"code": "AFTER_LOOP", "formula": "LOOP_B + GROSS"},
+                {"code": "BROKEN", "formula": "SALES * (1 +"}
+            ]
+        })json");
+        const TemplateCost cost = TemplateCostAnalyzer::analyze(*tmpl);
+        REQUIRE(cost.line_items.size() == 9);
+        auto item = [&](const std::string& code) {
+            return *std::find_if(cost.line_items.begin(), cost.line_items.end(),
+                                 [&](const LineItemCost& c) { return c.code == code; });
+        };
+
+        CHECK(!item("SALES").has_formula);
+        CHECK(item("SALES").depth == 1);
+        CHECK(item("SALES").fan_out == 2);   // COGS and GROSS; TREND reads only earlier periods
+        CHECK(item("GROSS").fan_in == 2);
+        CHECK(item("GROSS").depth == 3);
+        CHECK(item("BONUS").if_branches == 2);
+        CHECK(item("BONUS").depth == 4);
+        CHECK(item("BONUS").ops > item("COGS").ops);
+        CHECK(item("TREND").far_references == 2);
+        CHECK(item("TREND").fan_in == 0);
+        CHECK(item("LOOP_A").circular);
+        CHECK(item("AFTER_LOOP").circular);
+        CHECK(item("AFTER_LOOP").depth == 0);
+        CHECK(!item("BROKEN").error.empty());
+        CHECK(item("BROKEN").ops == 0);
+
+        CHECK(cost.totals.formulas == 8);
+        CHECK(cost.totals.if_branches == 2);
+        CHECK(cost.totals.far_references == 2);
+        CHECK(cost.totals.critical_path == 4);
+        CHECK(cost.critical_path == std::vector<std::string>{"SALES", "COGS", "GROSS", "BONUS"});
+        CHECK(cost.totals.circular == 3);
+        CHECK(cost.totals.errors == 1);
+
+        // A longer in-memory history turns far references into memory reads
+        CHECK(TemplateCostAnalyzer::analyze(*tmpl, 24).totals.far_references == 0);
+        CHECK(cost.report().find("2 [t-k] references beyond 12 periods") != std::string::npos);
+        CHECK(cost.to_json().find("\"critical_path\":[\"SALES\"") != std::string::npos);
+    }
+
+    SECTION("Action overlays and the server endpoint") {
+        auto db = create_incremental_db();
+        db->execute_raw(
+            "INSERT INTO management_action VALUES ('CUT', 'Cost cut', 'OPEX');"
+            "INSERT INTO scenario_action (scenario_id, action_code, trigger_type, start_period, "
+            "  financial_transformations) "
+            "VALUES (1, 'CUT', 'UNCONDITIONAL', 2, "
+            "  '[{\"line_item\": \"GROSS\", \"type\": \"add\", \"amount\": 100}, "
+            "    {\"line_item\": \"NET\", \"type\": \"multiply\", \"factor\": 2}]');"
+        );
+
+        const TemplateCost cost = TemplateCostAnalyzer::analyze(db, "INCREMENTAL_TEST", {1, 2});
+        CHECK(cost.totals.line_items == 8);
+        CHECK(cost.totals.critical_path == 5);   // REVENUE, GROSS, TAX, NET, CASH
+        CHECK(cost.totals.max_fan_out == 2);
+        REQUIRE(cost.overlays.size() == 2);
+        CHECK(cost.overlays[0].actions == 1);
+        CHECK(cost.overlays[0].patched_line_items == 2);
+        CHECK(cost.overlays[0].totals.ops > cost.totals.ops);
+        CHECK(cost.overlays[1].actions == 0);
+        CHECK(cost.overlays[1].totals.ops == cost.totals.ops);
+        CHECK_THROWS_AS(TemplateCostAnalyzer::analyze(db, "NO_SUCH_TEMPLATE"), std::invalid_argument);
+
+        web::Server server(0, "127.0.0.1");
+        CHECK(server.handle("GET", "/templates/INCREMENTAL_TEST/cost").status == 404);   // No template database
+        server.set_templates([db] { return db; });
+        const auto response = server.handle("GET", "/templates/INCREMENTAL_TEST/cost?scenarios=1");
+        CHECK(response.status == 200);
+        CHECK(response.body.find("\"patched_line_items\":2") != std::string::npos);
+        CHECK(server.handle("GET", "/templates/NO_SUCH_TEMPLATE/cost").status == 404);
+        CHECK(server.handle("GET", "/templates/INCREMENTAL_TEST/cost?history=x").status == 400);
+        CHECK(server.handle("POST", "/templates/INCREMENTAL_TEST/cost").status == 405);
+        CHECK(server.handle("GET", "/templates/INCREMENTAL_TEST").status == 404);
+    }
+}
@@ -7,6 +7,7 @@
 #include <catch2/catch_approx.hpp>
 #include "database/database_factory.h"
 #include "fx/fx_provider.h"
+#include "core/static_units.h"
 #include "core/unit_converter.h"
 
 using Catch::Approx;
@@ -307,3 +308,139 @@ TEST_CASE("UnitConverter - Error: No FXProvider for time-varying", "[unit][error
 //         return converter.convert(1000000000.0, "kgCO2e", "MtCO2e");
 //     };
 // }
+
+TEST_CASE("FXProvider - Dense rate table", "[unit][fx][dense]") {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE fx_rate (from_currency TEXT, to_currency TEXT, period_id INTEGER, rate REAL);"
+        "CREATE TABLE unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "INSERT INTO fx_rate VALUES ('USD', 'CHF', 1, 0.90), ('USD', 'CHF', 5, 0.95), "
+        "  ('EUR', 'CHF', 1, 1.10), ('EUR', 'CHF', 5, 1.20), ('CHF', 'EUR', 5, 0.80);"
+        "INSERT INTO unit_definition VALUES "
+        "  ('CHF', 'Franc', 'CURRENCY', 'STATIC', 1.0, 'CHF', 'CHF', '', 1), "
+        "  ('USD', 'Dollar', 'CURRENCY', 'TIME_VARYING', NULL, 'CHF', '$', '', 1);"
+    );
+    auto fx_provider = std::make_shared<FXProvider>(db);
+
+    SECTION("Direct, inverse and cross rates") {
+        REQUIRE(fx_provider->get_rate("USD", "CHF", 1) == Approx(0.90));
+        REQUIRE(fx_provider->get_rate("CHF", "USD", 1) == Approx(1.0 / 0.90));
+        // A direct rate wins over the inverse of the opposite direction
+        REQUIRE(fx_provider->get_rate("CHF", "EUR", 5) == Approx(0.80));
+        REQUIRE(fx_provider->get_rate("EUR", "CHF", 5) == Approx(1.20));
+        // Cross rate through CHF, the most quoted currency
+        REQUIRE(fx_provider->get_rate("USD", "EUR", 1) == Approx(0.90 / 1.10));
+        REQUIRE(fx_provider->get_rate("USD", "EUR", 5) == Approx(0.95 * 0.80));
+        REQUIRE(fx_provider->get_rate("EUR", "EUR", 3) == Approx(1.0));
+    }
+
+    SECTION("Lookups by currency ID") {
+        int usd = fx_provider->currency_id("USD");
+        int chf = fx_provider->currency_id("CHF");
+        REQUIRE(usd != FXProvider::NO_CURRENCY);
+        REQUIRE(fx_provider->currency_id("JPY") == FXProvider::NO_CURRENCY);
+        REQUIRE(fx_provider->get_rate(usd, chf, 5) == Approx(0.95));
+        REQUIRE_FALSE(fx_provider->find_rate(usd, chf, 3).has_value());
+        REQUIRE_FALSE(fx_provider->find_rate(usd, chf, 6).has_value());
+        REQUIRE_THROWS_AS(fx_provider->get_rate(usd, chf, 0), std::runtime_error);
+        REQUIRE_FALSE(fx_provider->has_rate("USD", "JPY", 1));
+    }
+
+    SECTION("IDs survive reload") {
+        int usd = fx_provider->currency_id("USD");
+        db->execute_raw("INSERT INTO fx_rate VALUES ('JPY', 'CHF', 1, 0.006);");
+        fx_provider->reload();
+        REQUIRE(fx_provider->currency_id("USD") == usd);
+        REQUIRE(fx_provider->get_rate("JPY", "USD", 1) == Approx(0.006 / 0.90));
+        REQUIRE(fx_provider->get_available_currencies() == std::vector<std::string>{"CHF", "EUR", "JPY", "USD"});
+    }
+
+    SECTION("UnitConverter converts through the table") {
+        UnitConverter converter(db, fx_provider);
+        REQUIRE(converter.to_base_unit(100.0, "USD", 5) == Approx(95.0));
+        REQUIRE(converter.from_base_unit(90.0, "USD", 1) == Approx(100.0));
+        REQUIRE_THROWS(converter.to_base_unit(100.0, "USD", 3));
+    }
+}
+
+TEST_CASE("UnitConverter - Interned units and factor columns", "[unit][dense]") {
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE fx_rate (from_currency TEXT, to_currency TEXT, period_id INTEGER, rate REAL);"
+        "CREATE TABLE unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "INSERT INTO fx_rate VALUES ('USD', 'CHF', 1, 0.90), ('USD', 'CHF', 2, 0.95);"
+        "INSERT INTO unit_definition VALUES "
+        "  ('t', 'Tonne', 'MASS', 'STATIC', 1.0, 't', 't', '', 1), "
+        "  ('kg', 'Kilogram', 'MASS', 'STATIC', 0.001, 't', 'kg', '', 1), "
+        "  ('g', 'Gram', 'MASS', 'STATIC', 0.000001, 't', 'g', '', 1), "
+        "  ('CHF', 'Franc', 'CURRENCY', 'STATIC', 1.0, 'CHF', 'CHF', '', 1), "
+        "  ('USD', 'Dollar', 'CURRENCY', 'TIME_VARYING', NULL, 'CHF', '$', '', 1);"
+    );
+    UnitConverter converter(db, std::make_shared<FXProvider>(db));
+
+    int kg = converter.unit_id("kg");
+    int usd = converter.unit_id("USD");
+    REQUIRE(kg != UnitConverter::NO_UNIT);
+    REQUIRE(converter.unit_id("lb") == UnitConverter::NO_UNIT);
+
+    SECTION("Static factors") {
+        REQUIRE(converter.base_factor(kg) == Approx(0.001));
+        REQUIRE(converter.base_factor(converter.unit_id("t"), 7) == Approx(1.0));
+        REQUIRE(converter.convert(5000.0, "g", "kg") == Approx(5.0));
+        REQUIRE(converter.convert(2.0, "kg", "kg") == Approx(2.0));
+    }
+
+    SECTION("Factor columns") {
+        std::vector<double> factors;
+        converter.base_factors(usd, {2, 1, 2}, factors);
+        REQUIRE(factors == std::vector<double>{0.95, 0.90, 0.95});
+        converter.base_factors(kg, {1, 2}, factors);
+        REQUIRE(factors == std::vector<double>{0.001, 0.001});
+        REQUIRE_THROWS(converter.base_factors(usd, {1, 3}, factors));
+    }
+
+    SECTION("Errors match string lookups") {
+        REQUIRE_THROWS_AS(converter.base_factor(usd), std::invalid_argument);
+        REQUIRE_THROWS_AS(converter.base_factor(UnitConverter::NO_UNIT), std::invalid_argument);
+        REQUIRE_THROWS_AS(converter.convert(1.0, "kg", "USD", 1), std::invalid_argument);
+        REQUIRE(converter.convert(100.0, "USD", "CHF", 2) == Approx(95.0));
+    }
+}
+
+TEST_CASE("UnitConverter - Built-in units with compile-time factors", "[unit][static][builtin]") {
+    // Factors are constant expressions
+    static_assert(units::factor<units::kgCO2e, units::tCO2e>() == 1e-3);
+    static_assert(units::convert<units::GWh, units::MWh>(2.0) == 2000.0);
+    static_assert(units::builtin_factor("t", "kg") == 1000.0);
+    static_assert(units::find_builtin("USD") == nullptr);
+    REQUIRE(units::convert<units::GJ, units::kWh>(3.6) == Approx(1000.0));
+    REQUIRE(units::convert<units::lb, units::kg>(1.0) == 0.45359237);
+
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    db->execute_raw(
+        "CREATE TABLE unit_definition (unit_code TEXT, unit_name TEXT, unit_category TEXT, "
+        "  conversion_type TEXT, static_conversion_factor REAL, base_unit_code TEXT, "
+        "  display_symbol TEXT, description TEXT, is_active INTEGER);"
+        "INSERT INTO unit_definition VALUES "
+        "  ('kWh', 'Kilowatt Hour', 'ENERGY', 'STATIC', 1.0, 'kWh', 'kWh', '', 1), "
+        "  ('GJ', 'Gigajoule', 'ENERGY', 'STATIC', 277.778, 'kWh', 'GJ', '', 1), "
+        "  ('MWh', 'Megawatt Hour', 'ENERGY', 'STATIC', 1200.0, 'kWh', 'MWh', '', 1), "
+        "  ('CHF', 'Franc', 'CURRENCY', 'STATIC', 1.0, 'CHF', 'CHF', '', 1), "
+        "  ('USD', 'Dollar', 'CURRENCY', 'TIME_VARYING', NULL, 'CHF', '$', '', 1);"
+    );
+    UnitConverter converter(db, nullptr);
+
+    // A rounded factor of a built-in unit becomes exact; another factor is the row's own
+    REQUIRE(*converter.static_factor(converter.unit_id("GJ")) == units::factor<units::GJ, units::kWh>());
+    REQUIRE(*converter.static_factor(converter.unit_id("MWh")) == 1200.0);
+    REQUIRE(*converter.static_factor(converter.unit_id("kWh")) == 1.0);
+    REQUIRE(*converter.static_factor(converter.unit_id("CHF")) == 1.0);
+    REQUIRE_FALSE(converter.static_factor(converter.unit_id("USD")).has_value());
+    REQUIRE_FALSE(converter.static_factor(UnitConverter::NO_UNIT).has_value());
+    REQUIRE(converter.is_time_varying("USD"));
+    REQUIRE_FALSE(converter.is_time_varying("GJ"));
+}
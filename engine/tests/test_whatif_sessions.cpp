@@ -0,0 +1,80 @@
+/**
+ * @file test_whatif_sessions.cpp
+ * @brief Tests for warm what-if sessions
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/job_queue.h"
+#include "orchestration/whatif_sessions.h"
+#include "web/server.h"
+#include "test_databases.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+using namespace finmodel::test;
+using Catch::Approx;
+
+TEST_CASE("WhatIfSessions: Driver edits rerun warm sessions incrementally", "[orchestration][sessions]") {
+    auto db = create_incremental_db();
+    WhatIfSessions sessions([db] { return db; }, 2);
+    const std::string spec = R"({"template": "INCREMENTAL_TEST", "entity": "E", "scenarios": [1],
+                                 "periods": [1, 2, 3], "opening": {"CASH": 100}})";
+
+    const SessionResult opened = sessions.open(JobSpec::from_json(spec));
+    REQUIRE(opened.results.success);
+    REQUIRE(opened.results.results.size() == 3);
+    CHECK(opened.results.results[2].get_value("CASH") == Approx(100.0 + 3 * 300.0));
+
+    const SessionResult edited = sessions.edit(opened.session_id, DriverEdit::list_from_json(
+        R"([{"period": 2, "driver": "COSTS", "value": 500}, {"period": 3, "driver": "OTHER", "value": 7}])"));
+    REQUIRE(edited.results.success);
+    CHECK(edited.recalculated > 0);
+    CHECK(edited.recalculated < opened.recalculated);
+    CHECK(edited.results.results[1].get_value("NET") == Approx(375.0));
+    CHECK(edited.results.results[2].get_value("CASH") == Approx(100.0 + 300.0 + 375.0 + 300.0));
+    CHECK(edited.results.results[2].get_value("OTHER_SCALED") == Approx(14.0));
+    CHECK(sessions.result(opened.session_id).results.results[1].get_value("NET") == Approx(375.0));
+
+    // Edits stay in the session
+    BalanceSheet initial_bs;
+    initial_bs.line_items["CASH"] = 100.0;
+    PeriodRunner stored(db);
+    CHECK(stored.run_periods("E", 1, {1, 2, 3}, initial_bs, "INCREMENTAL_TEST").results[1].get_value("NET") ==
+          Approx(300.0));
+
+    CHECK_THROWS_AS(sessions.edit(opened.session_id, {{9, "COSTS", 1.0, ""}}), std::invalid_argument);
+    CHECK_THROWS_AS(sessions.edit(99, {{2, "COSTS", 1.0, ""}}), std::out_of_range);
+    CHECK_THROWS_AS(sessions.open(JobSpec::from_json(
+        R"({"template": "INCREMENTAL_TEST", "entity": "E", "scenarios": [1, 2], "periods": [1]})")),
+        std::invalid_argument);
+
+    // The least recently used session makes room
+    const uint64_t second = sessions.open(JobSpec::from_json(spec)).session_id;
+    sessions.result(opened.session_id);
+    const uint64_t third = sessions.open(JobSpec::from_json(spec)).session_id;
+    CHECK(sessions.size() == 2);
+    CHECK_THROWS_AS(sessions.result(second), std::out_of_range);
+    CHECK(sessions.close(third));
+    CHECK_FALSE(sessions.close(third));
+
+    web::Server server(0, "127.0.0.1");
+    server.set_sessions(std::make_shared<WhatIfSessions>([db] { return db; }));
+    const auto created = server.handle("POST", "/sessions", spec);
+    REQUIRE(created.status == 201);
+    CHECK(created.body.find("\"session_id\":1") != std::string::npos);
+    const auto recalculated = server.handle("POST", "/sessions/1/drivers",
+                                            R"({"period": 2, "driver": "COSTS", "value": 500})");
+    REQUIRE(recalculated.status == 200);
+    CHECK(recalculated.body.find("\"NET\":375.0") != std::string::npos);
+    CHECK(server.handle("GET", "/sessions/1").body == recalculated.body);
+    CHECK(server.handle("POST", "/sessions/1/drivers", "[]").status == 400);
+    CHECK(server.handle("POST", "/sessions/1/drivers", R"({"period": 9, "driver": "COSTS", "value": 1})").status == 400);
+    CHECK(server.handle("GET", "/sessions/2").status == 404);
+    CHECK(server.handle("GET", "/sessions").status == 405);
+    CHECK(server.handle("DELETE", "/sessions/1").status == 200);
+    CHECK(server.handle("DELETE", "/sessions/1").status == 404);
+    CHECK(server.handle("GET", "/jobs").status == 404);
+}
@@ -0,0 +1,74 @@
+/**
+ * @file test_workload_generator.cpp
+ * @brief Tests for synthetic scaling workloads
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include "orchestration/period_runner.h"
+#include "orchestration/entity_hierarchy_runner.h"
+#include "orchestration/workload_generator.h"
+#include "database/database_factory.h"
+#include "database/result_set.h"
+
+using namespace finmodel;
+using namespace finmodel::orchestration;
+using namespace finmodel::database;
+
+TEST_CASE("WorkloadGenerator: Synthetic workloads are reproducible and run", "[orchestration][workload]") {
+    WorkloadSpec spec;
+    spec.line_items = 200;
+    spec.drivers = 20;
+    spec.depth = 8;
+    spec.periods = 3;
+    spec.scenarios = 2;
+    spec.entities = 7;
+    spec.entity_fan_out = 2;
+    spec.assets = 30;
+    spec.perils = 4;
+
+    CHECK(WorkloadGenerator::code("LI", 0) == "LI_A");
+    CHECK(WorkloadGenerator::code("LI", 27) == "LI_BB");
+    CHECK(WorkloadGenerator(spec).template_json() == WorkloadGenerator(spec).template_json());
+    WorkloadSpec other = spec;
+    other.seed = 7;
+    CHECK(WorkloadGenerator(other).template_json() != WorkloadGenerator(spec).template_json());
+    other = spec;
+    other.drivers = spec.line_items;
+    CHECK_THROWS_AS(WorkloadGenerator(other), std::invalid_argument);
+
+    auto db = DatabaseFactory::create_sqlite(":memory:");
+    const Workload workload = WorkloadGenerator(spec).generate(*db);
+    REQUIRE(workload.period_ids.size() == 3);
+    REQUIRE(workload.scenario_ids.size() == 2);
+    CHECK(workload.levels == 8);
+
+    // ENT_A → [ENT_B, ENT_C] → [ENT_D .. ENT_G]
+    CHECK(workload.root_entity == "ENT_A");
+    CHECK(workload.leaf_entities == std::vector<EntityID>{"ENT_D", "ENT_E", "ENT_F", "ENT_G"});
+    auto tree = EntityTree::load(*db, workload.root_entity);
+    CHECK(tree.nodes.size() == 7);
+    CHECK(tree.leaves().size() == 4);
+
+    auto count = [&db](const std::string& sql) {
+        auto result = db->execute_query(sql, {});
+        REQUIRE(result->next());
+        return result->get_int(0);
+    };
+    const int base_rows = 20 * 4 * 3;
+    CHECK(count("SELECT COUNT(*) FROM scenario_drivers WHERE scenario_id = 1") == base_rows);
+    CHECK(count("SELECT COUNT(*) FROM scenario_drivers WHERE scenario_id = 2") < base_rows);
+    CHECK(count("SELECT COUNT(*) FROM scenario_drivers") == static_cast<int>(workload.driver_rows));
+    CHECK(count("SELECT COUNT(*) FROM asset_exposure") == 30);
+    CHECK(count("SELECT COUNT(*) FROM physical_peril") == 8);
+    CHECK(count("SELECT COUNT(*) FROM scenario WHERE parent_scenario_id = 1") == 1);
+
+    PeriodRunner runner(db);
+    for (ScenarioID scenario : workload.scenario_ids) {
+        auto results = runner.run_periods(workload.leaf_entities.front(), scenario, workload.period_ids,
+                                          workload.opening, workload.template_code);
+        INFO((results.errors.empty() ? "" : results.errors.front()));
+        REQUIRE(results.success);
+        REQUIRE(results.results.size() == 3);
+        CHECK(results.results[2].get_all_values().size() == spec.line_items);
+    }
+}